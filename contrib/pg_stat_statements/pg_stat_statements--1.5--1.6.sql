@@ -0,0 +1,130 @@
+/* contrib/pg_stat_statements/pg_stat_statements--1.5--1.6.sql */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION pg_stat_statements UPDATE TO '1.6'" to load this file. \quit
+
+/* First we have to remove them from the extension */
+ALTER EXTENSION pg_stat_statements DROP VIEW pg_stat_statements;
+ALTER EXTENSION pg_stat_statements DROP FUNCTION pg_stat_statements(boolean);
+
+/* Then we can drop them */
+DROP VIEW pg_stat_statements;
+DROP FUNCTION pg_stat_statements(boolean);
+
+/* Now redefine */
+CREATE FUNCTION pg_stat_statements(IN showtext boolean,
+    OUT userid oid,
+    OUT dbid oid,
+    OUT queryid bigint,
+    OUT query text,
+    OUT calls int8,
+    OUT total_time float8,
+    OUT min_time float8,
+    OUT max_time float8,
+    OUT mean_time float8,
+    OUT stddev_time float8,
+    OUT rows int8,
+    OUT shared_blks_hit int8,
+    OUT shared_blks_read int8,
+    OUT shared_blks_dirtied int8,
+    OUT shared_blks_written int8,
+    OUT local_blks_hit int8,
+    OUT local_blks_read int8,
+    OUT local_blks_dirtied int8,
+    OUT local_blks_written int8,
+    OUT temp_blks_read int8,
+    OUT temp_blks_written int8,
+    OUT blk_read_time float8,
+    OUT blk_write_time float8,
+    OUT net_bytes_sent int8,
+    OUT net_bytes_received int8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME', 'pg_stat_statements_1_6'
+LANGUAGE C STRICT VOLATILE PARALLEL SAFE;
+
+CREATE VIEW pg_stat_statements AS
+  SELECT * FROM pg_stat_statements(true);
+
+GRANT SELECT ON pg_stat_statements TO PUBLIC;
+
+/* Statistics of the other nodes of the cluster */
+CREATE FUNCTION pg_stat_statements_remote(
+    OUT node_name text,
+    OUT node_type "char",
+    OUT userid oid,
+    OUT dbid oid,
+    OUT queryid bigint,
+    OUT calls int8,
+    OUT total_time float8,
+    OUT rows int8,
+    OUT shared_blks_hit int8,
+    OUT shared_blks_read int8,
+    OUT shared_blks_dirtied int8,
+    OUT shared_blks_written int8,
+    OUT local_blks_hit int8,
+    OUT local_blks_read int8,
+    OUT local_blks_dirtied int8,
+    OUT local_blks_written int8,
+    OUT temp_blks_read int8,
+    OUT temp_blks_written int8,
+    OUT blk_read_time float8,
+    OUT blk_write_time float8,
+    OUT net_bytes_sent int8,
+    OUT net_bytes_received int8
+)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT VOLATILE PARALLEL RESTRICTED;
+
+/*
+ * One row per Coordinator query, with the work of the Datanodes charged to
+ * the query which shipped it.
+ */
+CREATE VIEW pg_stat_statements_cluster AS
+  SELECT s.userid,
+         s.dbid,
+         s.queryid,
+         max(s.query) AS query,
+         count(DISTINCT s.node_name) AS nodes,
+         sum(s.calls) FILTER (WHERE s.node_type = 'C') AS calls,
+         sum(s.total_time) FILTER (WHERE s.node_type = 'C') AS total_time,
+         sum(s.total_time) FILTER (WHERE s.node_type = 'D') AS datanode_time,
+         sum(s.rows) FILTER (WHERE s.node_type = 'C') AS rows,
+         sum(s.shared_blks_hit) AS shared_blks_hit,
+         sum(s.shared_blks_read) AS shared_blks_read,
+         sum(s.shared_blks_dirtied) AS shared_blks_dirtied,
+         sum(s.shared_blks_written) AS shared_blks_written,
+         sum(s.local_blks_hit) AS local_blks_hit,
+         sum(s.local_blks_read) AS local_blks_read,
+         sum(s.local_blks_dirtied) AS local_blks_dirtied,
+         sum(s.local_blks_written) AS local_blks_written,
+         sum(s.temp_blks_read) AS temp_blks_read,
+         sum(s.temp_blks_written) AS temp_blks_written,
+         sum(s.blk_read_time) AS blk_read_time,
+         sum(s.blk_write_time) AS blk_write_time,
+         sum(s.net_bytes_sent) AS net_bytes_sent,
+         sum(s.net_bytes_received) AS net_bytes_received
+  FROM (SELECT pgxc_node_str()::text AS node_name, 'C'::"char" AS node_type,
+               l.userid, l.dbid, l.queryid, l.query, l.calls, l.total_time,
+               l.rows, l.shared_blks_hit, l.shared_blks_read,
+               l.shared_blks_dirtied, l.shared_blks_written,
+               l.local_blks_hit, l.local_blks_read, l.local_blks_dirtied,
+               l.local_blks_written, l.temp_blks_read, l.temp_blks_written,
+               l.blk_read_time, l.blk_write_time,
+               l.net_bytes_sent, l.net_bytes_received
+        FROM pg_stat_statements(true) l
+        WHERE l.queryid IS NOT NULL
+        UNION ALL
+        SELECT r.node_name, r.node_type,
+               r.userid, r.dbid, r.queryid, NULL::text, r.calls, r.total_time,
+               r.rows, r.shared_blks_hit, r.shared_blks_read,
+               r.shared_blks_dirtied, r.shared_blks_written,
+               r.local_blks_hit, r.local_blks_read, r.local_blks_dirtied,
+               r.local_blks_written, r.temp_blks_read, r.temp_blks_written,
+               r.blk_read_time, r.blk_write_time,
+               r.net_bytes_sent, r.net_bytes_received
+        FROM pg_stat_statements_remote() r) s
+  GROUP BY s.userid, s.dbid, s.queryid;
+
+GRANT SELECT ON pg_stat_statements_cluster TO PUBLIC;
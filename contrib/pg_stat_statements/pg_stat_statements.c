@@ -62,6 +62,7 @@
 #include <unistd.h>
 
 #include "access/hash.h"
+#include "access/xact.h"
 #include "catalog/pg_authid.h"
 #include "executor/instrument.h"
 #include "funcapi.h"
@@ -78,6 +79,15 @@
 #include "tcop/utility.h"
 #include "utils/builtins.h"
 #include "utils/memutils.h"
+#ifdef PGXC
+#include "catalog/pgxc_node.h"
+#include "nodes/makefuncs.h"
+#include "pgxc/execRemote.h"
+#include "pgxc/pgxc.h"
+#include "pgxc/pgxcnode.h"
+#include "pgxc/planner.h"
+#include "utils/snapmgr.h"
+#endif
 
 PG_MODULE_MAGIC;
 
@@ -95,7 +105,7 @@ PG_MODULE_MAGIC;
 #define PGSS_TEXT_FILE	PG_STAT_TMP_DIR "/pgss_query_texts.stat"
 
 /* Magic number identifying the stats file format */
-static const uint32 PGSS_FILE_HEADER = 0x20140125;
+static const uint32 PGSS_FILE_HEADER = 0x20170801;
 
 /* PostgreSQL major version number, changes in which invalidate all entries */
 static const uint32 PGSS_PG_MAJOR_VERSION = PG_VERSION_NUM / 100;
@@ -119,7 +129,8 @@ typedef enum pgssVersion
 	PGSS_V1_0 = 0,
 	PGSS_V1_1,
 	PGSS_V1_2,
-	PGSS_V1_3
+	PGSS_V1_3,
+	PGSS_V1_6
 } pgssVersion;
 
 /*
@@ -157,6 +168,8 @@ typedef struct Counters
 	int64		temp_blks_written;	/* # of temp blocks written */
 	double		blk_read_time;	/* time spent reading, in msec */
 	double		blk_write_time; /* time spent writing, in msec */
+	int64		net_bytes_sent; /* bytes sent to other nodes */
+	int64		net_bytes_received; /* bytes received from other nodes */
 	double		usage;			/* usage factor */
 } Counters;
 
@@ -225,11 +238,25 @@ typedef struct pgssJumbleState
 	int			highest_extern_param_id;
 } pgssJumbleState;
 
+/*
+ * Inter-node traffic counters of this backend when a tracked statement
+ * started executing, see pgss_ExecutorStart().
+ */
+typedef struct pgssNetUsage
+{
+	QueryDesc  *queryDesc;
+	uint64		bytes_sent;
+	uint64		bytes_received;
+} pgssNetUsage;
+
 /*---- Local variables ----*/
 
 /* Current nesting depth of ExecutorRun+ProcessUtility calls */
 static int	nested_level = 0;
 
+/* pgssNetUsage of the statements being executed, innermost first */
+static List *pgss_net_usage = NIL;
+
 /* Saved hook values in case of unload */
 static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
 static post_parse_analyze_hook_type prev_post_parse_analyze_hook = NULL;
@@ -286,7 +313,9 @@ void		_PG_fini(void);
 PG_FUNCTION_INFO_V1(pg_stat_statements_reset);
 PG_FUNCTION_INFO_V1(pg_stat_statements_1_2);
 PG_FUNCTION_INFO_V1(pg_stat_statements_1_3);
+PG_FUNCTION_INFO_V1(pg_stat_statements_1_6);
 PG_FUNCTION_INFO_V1(pg_stat_statements);
+PG_FUNCTION_INFO_V1(pg_stat_statements_remote);
 
 static void pgss_shmem_startup(void);
 static void pgss_shmem_shutdown(int code, Datum arg);
@@ -312,7 +341,9 @@ static void pgss_store(const char *query, uint32 queryId,
 		   int query_location, int query_len,
 		   double total_time, uint64 rows,
 		   const BufferUsage *bufusage,
+		   uint64 net_sent, uint64 net_received,
 		   pgssJumbleState *jstate);
+static void pgss_xact_callback(XactEvent event, void *arg);
 static void pg_stat_statements_internal(FunctionCallInfo fcinfo,
 							pgssVersion api_version,
 							bool showtext);
@@ -435,6 +466,8 @@ _PG_init(void)
 	ExecutorEnd_hook = pgss_ExecutorEnd;
 	prev_ProcessUtility = ProcessUtility_hook;
 	ProcessUtility_hook = pgss_ProcessUtility;
+
+	RegisterXactCallback(pgss_xact_callback, NULL);
 }
 
 /*
@@ -451,6 +484,28 @@ _PG_fini(void)
 	ExecutorFinish_hook = prev_ExecutorFinish;
 	ExecutorEnd_hook = prev_ExecutorEnd;
 	ProcessUtility_hook = prev_ProcessUtility;
+
+	UnregisterXactCallback(pgss_xact_callback, NULL);
+}
+
+/*
+ * Forget the traffic counters of statements which did not reach
+ * ExecutorEnd, because of an error or because a portal was dropped.
+ */
+static void
+pgss_xact_callback(XactEvent event, void *arg)
+{
+	switch (event)
+	{
+		case XACT_EVENT_COMMIT:
+		case XACT_EVENT_ABORT:
+		case XACT_EVENT_PREPARE:
+			list_free_deep(pgss_net_usage);
+			pgss_net_usage = NIL;
+			break;
+		default:
+			break;
+	}
 }
 
 /*
@@ -825,6 +880,16 @@ pgss_post_parse_analyze(ParseState *pstate, Query *query)
 	if (query->queryId == 0)
 		query->queryId = 1;
 
+#ifdef PGXC
+	/*
+	 * A statement shipped by a Coordinator is accounted under the query id
+	 * of the Coordinator query, so that pg_stat_statements_cluster can put
+	 * the work done on all the nodes together.
+	 */
+	if (IS_PGXC_DATANODE && IsConnFromCoord() && PGXCRemoteQueryId != 0)
+		query->queryId = PGXCRemoteQueryId;
+#endif
+
 	/*
 	 * If we were able to identify any ignorable constants, we immediately
 	 * create a hash table entry for the query, so that we can record the
@@ -840,6 +905,8 @@ pgss_post_parse_analyze(ParseState *pstate, Query *query)
 				   0,
 				   0,
 				   NULL,
+				   0,
+				   0,
 				   &jstate);
 }
 
@@ -874,6 +941,22 @@ pgss_ExecutorStart(QueryDesc *queryDesc, int eflags)
 			queryDesc->totaltime = InstrAlloc(1, INSTRUMENT_ALL);
 			MemoryContextSwitchTo(oldcxt);
 		}
+
+#ifdef PGXC
+		/* Remember the traffic counters to charge the difference at the end */
+		{
+			MemoryContext oldcxt;
+			pgssNetUsage *usage;
+
+			oldcxt = MemoryContextSwitchTo(TopMemoryContext);
+			usage = (pgssNetUsage *) palloc(sizeof(pgssNetUsage));
+			usage->queryDesc = queryDesc;
+			usage->bytes_sent = PGXCNodeBytesSent;
+			usage->bytes_received = PGXCNodeBytesReceived;
+			pgss_net_usage = lcons(usage, pgss_net_usage);
+			MemoryContextSwitchTo(oldcxt);
+		}
+#endif
 	}
 }
 
@@ -931,6 +1014,25 @@ static void
 pgss_ExecutorEnd(QueryDesc *queryDesc)
 {
 	uint32		queryId = queryDesc->plannedstmt->queryId;
+	uint64		net_sent = 0;
+	uint64		net_received = 0;
+#ifdef PGXC
+	ListCell   *lc;
+
+	foreach(lc, pgss_net_usage)
+	{
+		pgssNetUsage *usage = (pgssNetUsage *) lfirst(lc);
+
+		if (usage->queryDesc == queryDesc)
+		{
+			net_sent = PGXCNodeBytesSent - usage->bytes_sent;
+			net_received = PGXCNodeBytesReceived - usage->bytes_received;
+			pgss_net_usage = list_delete_ptr(pgss_net_usage, usage);
+			pfree(usage);
+			break;
+		}
+	}
+#endif
 
 	if (queryId != 0 && queryDesc->totaltime && pgss_enabled())
 	{
@@ -947,6 +1049,8 @@ pgss_ExecutorEnd(QueryDesc *queryDesc)
 				   queryDesc->totaltime->total * 1000.0,	/* convert to msec */
 				   queryDesc->estate->es_processed,
 				   &queryDesc->totaltime->bufusage,
+				   net_sent,
+				   net_received,
 				   NULL);
 	}
 
@@ -1066,6 +1170,8 @@ pgss_ProcessUtility(PlannedStmt *pstmt, const char *queryString,
 				   INSTR_TIME_GET_MILLISEC(duration),
 				   rows,
 				   &bufusage,
+				   0,
+				   0,
 				   NULL);
 	}
 	else
@@ -1141,6 +1247,7 @@ pgss_store(const char *query, uint32 queryId,
 		   int query_location, int query_len,
 		   double total_time, uint64 rows,
 		   const BufferUsage *bufusage,
+		   uint64 net_sent, uint64 net_received,
 		   pgssJumbleState *jstate)
 {
 	pgssHashKey key;
@@ -1321,6 +1428,8 @@ pgss_store(const char *query, uint32 queryId,
 		e->counters.temp_blks_written += bufusage->temp_blks_written;
 		e->counters.blk_read_time += INSTR_TIME_GET_MILLISEC(bufusage->blk_read_time);
 		e->counters.blk_write_time += INSTR_TIME_GET_MILLISEC(bufusage->blk_write_time);
+		e->counters.net_bytes_sent += net_sent;
+		e->counters.net_bytes_received += net_received;
 		e->counters.usage += USAGE_EXEC(total_time);
 
 		SpinLockRelease(&e->mutex);
@@ -1353,7 +1462,8 @@ pg_stat_statements_reset(PG_FUNCTION_ARGS)
 #define PG_STAT_STATEMENTS_COLS_V1_1	18
 #define PG_STAT_STATEMENTS_COLS_V1_2	19
 #define PG_STAT_STATEMENTS_COLS_V1_3	23
-#define PG_STAT_STATEMENTS_COLS			23	/* maximum of above */
+#define PG_STAT_STATEMENTS_COLS_V1_6	25
+#define PG_STAT_STATEMENTS_COLS			25	/* maximum of above */
 
 /*
  * Retrieve statement statistics.
@@ -1365,6 +1475,16 @@ pg_stat_statements_reset(PG_FUNCTION_ARGS)
  * expected API version is identified by embedding it in the C name of the
  * function.  Unfortunately we weren't bright enough to do that for 1.1.
  */
+Datum
+pg_stat_statements_1_6(PG_FUNCTION_ARGS)
+{
+	bool		showtext = PG_GETARG_BOOL(0);
+
+	pg_stat_statements_internal(fcinfo, PGSS_V1_6, showtext);
+
+	return (Datum) 0;
+}
+
 Datum
 pg_stat_statements_1_3(PG_FUNCTION_ARGS)
 {
@@ -1471,6 +1591,10 @@ pg_stat_statements_internal(FunctionCallInfo fcinfo,
 			if (api_version != PGSS_V1_3)
 				elog(ERROR, "incorrect number of output arguments");
 			break;
+		case PG_STAT_STATEMENTS_COLS_V1_6:
+			if (api_version != PGSS_V1_6)
+				elog(ERROR, "incorrect number of output arguments");
+			break;
 		default:
 			elog(ERROR, "incorrect number of output arguments");
 	}
@@ -1667,11 +1791,17 @@ pg_stat_statements_internal(FunctionCallInfo fcinfo,
 			values[i++] = Float8GetDatumFast(tmp.blk_read_time);
 			values[i++] = Float8GetDatumFast(tmp.blk_write_time);
 		}
+		if (api_version >= PGSS_V1_6)
+		{
+			values[i++] = Int64GetDatumFast(tmp.net_bytes_sent);
+			values[i++] = Int64GetDatumFast(tmp.net_bytes_received);
+		}
 
 		Assert(i == (api_version == PGSS_V1_0 ? PG_STAT_STATEMENTS_COLS_V1_0 :
 					 api_version == PGSS_V1_1 ? PG_STAT_STATEMENTS_COLS_V1_1 :
 					 api_version == PGSS_V1_2 ? PG_STAT_STATEMENTS_COLS_V1_2 :
 					 api_version == PGSS_V1_3 ? PG_STAT_STATEMENTS_COLS_V1_3 :
+					 api_version == PGSS_V1_6 ? PG_STAT_STATEMENTS_COLS_V1_6 :
 					 -1 /* fail if you forget to update this assert */ ));
 
 		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
@@ -1686,6 +1816,157 @@ pg_stat_statements_internal(FunctionCallInfo fcinfo,
 	tuplestore_donestoring(tupstore);
 }
 
+#ifdef PGXC
+/* Number of output arguments of pg_stat_statements_remote() */
+#define PG_STAT_STATEMENTS_REMOTE_COLS	22
+
+/*
+ * Run pg_stat_statements() on all the Coordinators or Datanodes but this one
+ * and add the rows to tupstore. The query returns the same columns as
+ * pg_stat_statements_remote(), except for node_type, which is filled in here.
+ */
+static void
+pgss_gather_remote(Tuplestorestate *tupstore, TupleDesc tupdesc,
+				   RemoteQueryExecType exec_type, char node_type)
+{
+	RemoteQuery *step;
+	RemoteQueryState *node;
+	EState	   *estate;
+	TupleTableSlot *result;
+	MemoryContext oldcontext;
+	Datum		values[PG_STAT_STATEMENTS_REMOTE_COLS];
+	bool		nulls[PG_STAT_STATEMENTS_REMOTE_COLS];
+	int			i;
+
+	step = makeNode(RemoteQuery);
+	step->combine_type = COMBINE_TYPE_NONE;
+	step->exec_nodes = NULL;
+	step->sql_statement =
+		"SELECT pgxc_node_str()::text, userid, dbid, queryid, calls, "
+		"total_time, rows, shared_blks_hit, shared_blks_read, "
+		"shared_blks_dirtied, shared_blks_written, local_blks_hit, "
+		"local_blks_read, local_blks_dirtied, local_blks_written, "
+		"temp_blks_read, temp_blks_written, blk_read_time, blk_write_time, "
+		"net_bytes_sent, net_bytes_received "
+		"FROM pg_stat_statements(false) WHERE queryid IS NOT NULL";
+	step->force_autocommit = false;
+	step->read_only = true;
+	step->exec_type = exec_type;
+
+	/* All the columns of the result but node_type come from the query */
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		AttrNumber	resno = list_length(step->scan.plan.targetlist) + 1;
+		Var		   *var;
+
+		if (i == 1)
+			continue;
+
+		var = makeVar(1, resno,
+					  tupdesc->attrs[i]->atttypid,
+					  tupdesc->attrs[i]->atttypmod,
+					  InvalidOid,
+					  0);
+		step->scan.plan.targetlist = lappend(step->scan.plan.targetlist,
+											 makeTargetEntry((Expr *) var,
+															 resno,
+															 NULL,
+															 false));
+	}
+
+	estate = CreateExecutorState();
+
+	oldcontext = MemoryContextSwitchTo(estate->es_query_cxt);
+	estate->es_snapshot = GetActiveSnapshot();
+	node = ExecInitRemoteQuery(step, estate, 0);
+	MemoryContextSwitchTo(oldcontext);
+
+	result = ExecRemoteQuery((PlanState *) node);
+	while (result != NULL && !TupIsNull(result))
+	{
+		slot_getallattrs(result);
+
+		values[0] = result->tts_values[0];
+		nulls[0] = result->tts_isnull[0];
+		values[1] = CharGetDatum(node_type);
+		nulls[1] = false;
+		for (i = 2; i < tupdesc->natts; i++)
+		{
+			values[i] = result->tts_values[i - 1];
+			nulls[i] = result->tts_isnull[i - 1];
+		}
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+		result = ExecRemoteQuery((PlanState *) node);
+	}
+	ExecEndRemoteQuery(node);
+	FreeExecutorState(estate);
+}
+#endif
+
+/*
+ * Statement statistics of all the other nodes of the cluster, as seen by
+ * pg_stat_statements(false) there. Entries of the Datanodes are keyed by
+ * the query id of the Coordinator query which shipped them, so they can be
+ * matched with the local entries, see pg_stat_statements_cluster.
+ */
+Datum
+pg_stat_statements_remote(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+#ifdef PGXC
+	if (!IS_PGXC_COORDINATOR)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("pg_stat_statements_remote() can only be called on a Coordinator")));
+#endif
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+	if (tupdesc->natts != PG_STAT_STATEMENTS_REMOTE_COLS)
+		elog(ERROR, "incorrect number of output arguments");
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+#ifdef PGXC
+	/* Only the Coordinator the client is connected to gathers */
+	if (IsConnFromApp())
+	{
+		pgss_gather_remote(tupstore, tupdesc, EXEC_ON_COORDS, PGXC_NODE_COORDINATOR);
+		pgss_gather_remote(tupstore, tupdesc, EXEC_ON_DATANODES, PGXC_NODE_DATANODE);
+	}
+#endif
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
 /*
  * Estimate shared memory space needed.
  */
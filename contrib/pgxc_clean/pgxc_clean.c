@@ -24,6 +24,7 @@
  *  -d, --dbname=DBNAME		database name to clean up.   Multiple -d option
  *                          can be specified.
  *  -h, --host=HOSTNAME		Coordinator hostname to connect to.
+ *  -j, --jobs=NUM			number of transactions to recover concurrently.
  *  -N, --no-clean			only test.  no cleanup actually.
  *  -o, --output=FILENAME	output file name.
  *  -p, --port=PORT			Coordinator port number.
@@ -40,6 +41,7 @@
  */
 
 #include <sys/types.h>
+#include <sys/select.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <pwd.h>
@@ -82,6 +84,7 @@ passwd_opt try_password_opt = TRI_DEFAULT;
 bool status_opt = false;
 bool no_clean_opt = false;
 bool verbose_opt = false;
+int jobs_opt = 1;
 FILE *outf;
 FILE *errf;
 
@@ -92,6 +95,24 @@ int			pgxc_clean_node_count;
 database_info *head_database_info;
 database_info *last_database_info;
 
+/*
+ * Connection resolving one transaction at a time.  Each transaction needs
+ * one statement per node it is prepared on, followed by the global one on
+ * the connected Coordinator, which also reports the outcome to GTM.
+ */
+typedef struct resolver_conn
+{
+	PGconn	   *conn;
+	txn_info   *txn;			/* transaction being resolved, NULL if idle */
+	bool		is_commit;
+	int			next_node;		/* next node index to try */
+	int			cur_node;		/* node of the statement in flight, -1 for
+								 * the global statement */
+} resolver_conn;
+
+/* Number of transactions whose status is asked of a node at once */
+#define TXN_STATUS_BATCH_SIZE	1000
+
 static bool have_password = false;
 static char password[100];
 static char password_prompt[256];
@@ -106,7 +127,9 @@ static PGconn *loginDatabase(char *host, int port, char *user, char *password,
 							char *dbname, const char *progname, char *encoding, char *password_prompt);
 static void getMyNodename(PGconn *conn);
 static void recover2PCForDatabase(database_info *db_info);
-static void recover2PC(PGconn *conn, txn_info *txn);
+static bool recover2PC(txn_info *txn);
+static bool sendResolveStatement(resolver_conn *rc);
+static void receiveResolveResult(resolver_conn *rc);
 static void getDatabaseList(PGconn *conn);
 static void getNodeList(PGconn *conn);
 static void showVersion(void);
@@ -115,9 +138,6 @@ static void parse_pgxc_clean_options(int argc, char *argv[]);
 static void usage(void);
 static void getPreparedTxnList(PGconn *conn);
 static void getTxnInfoOnOtherNodesAll(PGconn *conn);
-static void do_commit(PGconn *conn, txn_info *txn);
-static void do_abort(PGconn *conn, txn_info *txn);
-static void do_commit_abort(PGconn *conn, txn_info *txn, bool is_commit);
 static bool setMaintenanceMode(PGconn *conn);
 
 /*
@@ -429,36 +449,154 @@ getMyNodename(PGconn *conn)
 static void
 recover2PCForDatabase(database_info *db_info)
 {
-	PGconn 		*coord_conn;
-	txn_info   	*cur_txn;
+	resolver_conn *resolvers;
+	int			nresolvers = 0;
+	int			maxresolvers = 0;
+	int			nbusy;
+	txn_info   *next_txn;
+	int			ii;
 
 	if (verbose_opt)
 		fprintf(outf, "%s: recovering 2PC for database \"%s\"\n", progname, db_info->database_name);
-	coord_conn = loginDatabase(coordinator_host, coordinator_port, username, password, db_info->database_name,
-							   progname, "auto", password_prompt);
-	if (coord_conn == NULL)
-	{
-		fprintf(errf, "Could not connect to the database %s.\n", db_info->database_name);
+
+	/* No point in more connections than transactions */
+	for (next_txn = db_info->head_txn_info;
+		 next_txn && maxresolvers < jobs_opt;
+		 next_txn = next_txn->next)
+		maxresolvers++;
+	if (maxresolvers == 0)
 		return;
+
+	resolvers = (resolver_conn *) malloc(sizeof(resolver_conn) * maxresolvers);
+	for (ii = 0; ii < maxresolvers; ii++)
+	{
+		PGconn	   *coord_conn;
+
+		coord_conn = loginDatabase(coordinator_host, coordinator_port, username, password,
+								   db_info->database_name, progname, "auto", password_prompt);
+		if (coord_conn == NULL)
+			break;
+		if (!setMaintenanceMode(coord_conn))
+		{
+			PQfinish(coord_conn);
+			break;
+		}
+		resolvers[nresolvers].conn = coord_conn;
+		resolvers[nresolvers].txn = NULL;
+		nresolvers++;
 	}
-	if (!setMaintenanceMode(coord_conn))
+	if (nresolvers == 0)
 	{
 		/* Cannot recover */
+		fprintf(errf, "Could not connect to the database %s.\n", db_info->database_name);
 		fprintf(errf, "Skipping database %s.\n", db_info->database_name);
-		PQfinish(coord_conn);
+		free(resolvers);
 		return;
 	}
 	if (verbose_opt)
-		fprintf(outf, "%s: connected to the database \"%s\"\n", progname, db_info->database_name);
-	for(cur_txn = db_info->head_txn_info; cur_txn; cur_txn = cur_txn->next)
+		fprintf(outf, "%s: connected to the database \"%s\" (%d connections)\n",
+				progname, db_info->database_name, nresolvers);
+
+	/*
+	 * Hand out the transactions to the connections as they become idle, so
+	 * that up to --jobs transactions are being committed or aborted at any
+	 * given time.
+	 */
+	next_txn = db_info->head_txn_info;
+	for (;;)
+	{
+		fd_set		input_mask;
+		int			maxfd = -1;
+
+		nbusy = 0;
+		for (ii = 0; ii < nresolvers; ii++)
+		{
+			resolver_conn *rc = &resolvers[ii];
+
+			if (rc->conn == NULL)
+				continue;
+			while (rc->txn == NULL && next_txn)
+			{
+				txn_info   *txn = next_txn;
+
+				next_txn = next_txn->next;
+				if (recover2PC(txn))
+				{
+					rc->txn = txn;
+					rc->is_commit = (check_txn_global_status(txn) == TXN_STATUS_COMMITTED);
+					rc->next_node = 0;
+					if (!sendResolveStatement(rc))
+						rc->txn = NULL;
+				}
+			}
+			if (rc->txn)
+				nbusy++;
+		}
+		if (nbusy == 0)
+			break;
+
+		FD_ZERO(&input_mask);
+		for (ii = 0; ii < nresolvers; ii++)
+		{
+			resolver_conn *rc = &resolvers[ii];
+
+			if (rc->conn && rc->txn)
+			{
+				int			sock = PQsocket(rc->conn);
+
+				FD_SET(sock, &input_mask);
+				if (sock > maxfd)
+					maxfd = sock;
+			}
+		}
+		if (select(maxfd + 1, &input_mask, NULL, NULL, NULL) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			fprintf(errf, "%s: select() failed: %s\n", progname, strerror(errno));
+			exit(1);
+		}
+
+		for (ii = 0; ii < nresolvers; ii++)
+		{
+			resolver_conn *rc = &resolvers[ii];
+
+			if (rc->conn == NULL || rc->txn == NULL ||
+				!FD_ISSET(PQsocket(rc->conn), &input_mask))
+				continue;
+			if (!PQconsumeInput(rc->conn))
+			{
+				fprintf(errf, "Lost connection while recovering TXN, gxid: %d, xid: \"%s\" (%s)\n",
+						rc->txn->gxid, rc->txn->xid, PQerrorMessage(rc->conn));
+				PQfinish(rc->conn);
+				rc->conn = NULL;
+				continue;
+			}
+			if (PQisBusy(rc->conn))
+				continue;
+			receiveResolveResult(rc);
+			if (!sendResolveStatement(rc))
+				rc->txn = NULL;
+		}
+	}
+
+	if (next_txn)
+		fprintf(errf, "Lost all the connections to the database %s, some transactions are not recovered.\n",
+				db_info->database_name);
+	for (ii = 0; ii < nresolvers; ii++)
 	{
-		recover2PC(coord_conn, cur_txn);
+		if (resolvers[ii].conn)
+			PQfinish(resolvers[ii].conn);
 	}
-	PQfinish(coord_conn);
+	free(resolvers);
 }
 
-static void
-recover2PC(PGconn *conn, txn_info *txn)
+/*
+ * Decide what to do with a transaction.  Returns true if it has to be
+ * committed or aborted.
+ */
+static bool
+recover2PC(txn_info *txn)
 {
 	TXN_STATUS txn_stat;
 
@@ -474,17 +612,14 @@ recover2PC(PGconn *conn, txn_info *txn)
 		case TXN_STATUS_UNKNOWN:
 			if (verbose_opt)
 				fprintf(outf, "        Recovery not needed.\n");
-			return;
+			return false;
 		case TXN_STATUS_PREPARED:
 			if (verbose_opt)
 				fprintf(outf, "        Recovery not needed.\n");
-			return;
+			return false;
 		case TXN_STATUS_COMMITTED:
-			do_commit(conn, txn);
-			return;
 		case TXN_STATUS_ABORTED:
-			do_abort(conn, txn);
-			return;
+			return true;
 		case TXN_STATUS_INPROGRESS:
 			fprintf(stderr, "        Can't recover a running transaction.\n");
 			exit(1);
@@ -492,86 +627,97 @@ recover2PC(PGconn *conn, txn_info *txn)
 			fprintf(stderr, "        Unknown TXN status, pgxc_clean error.\n");
 			exit(1);
 	}
-	return;
+	return false;
 }
 
-static void
-do_commit(PGconn *conn, txn_info *txn)
+/*
+ * Send the next statement needed to resolve the transaction of the
+ * connection.  Returns false once the global statement is done.
+ */
+static bool
+sendResolveStatement(resolver_conn *rc)
 {
-	do_commit_abort(conn, txn, true);
-}
+	static const char *EXEC_DIRECT_STMT_FMT = "EXECUTE DIRECT ON (%s) '%s PREPARED ''%s'';';";
+	static const char *GLOBAL_STMT_FMT = "%s PREPARED '%s';";
+	txn_info   *txn = rc->txn;
+	char	   *stmt;
 
-static void
-do_abort(PGconn *conn, txn_info *txn)
-{
-	do_commit_abort(conn, txn, false);
+	if (rc->next_node > pgxc_clean_node_count)
+		return false;
+
+	while (rc->next_node < pgxc_clean_node_count &&
+		   (txn->txn_stat[rc->next_node] != TXN_STATUS_PREPARED ||
+			rc->next_node == my_nodeidx))
+		rc->next_node++;
+
+	if (rc->next_node < pgxc_clean_node_count)
+	{
+		rc->cur_node = rc->next_node;
+		stmt = (char *) malloc(64 + strlen(pgxc_clean_node_info[rc->cur_node].node_name) +
+							   strlen(txn->xid));
+		sprintf(stmt, EXEC_DIRECT_STMT_FMT,
+				pgxc_clean_node_info[rc->cur_node].node_name,
+				rc->is_commit ? "COMMIT" : "ROLLBACK",
+				txn->xid);
+	}
+	else
+	{
+		/* Issue global statment */
+		rc->cur_node = -1;
+		stmt = (char *) malloc(64 + strlen(txn->xid));
+		sprintf(stmt, GLOBAL_STMT_FMT,
+				rc->is_commit ? "COMMIT" : "ROLLBACK",
+				txn->xid);
+	}
+	rc->next_node++;
+
+	if (!PQsendQuery(rc->conn, stmt))
+	{
+		fprintf(errf, "Failed to recover TXN, gxid: %d, xid: \"%s\", owner: \"%s\", node: \"%s\" (%s)\n",
+				txn->gxid, txn->xid, txn->owner,
+				rc->cur_node >= 0 ? pgxc_clean_node_info[rc->cur_node].node_name : my_nodename,
+				PQerrorMessage(rc->conn));
+		free(stmt);
+		PQfinish(rc->conn);
+		rc->conn = NULL;
+		return false;
+	}
+	free(stmt);
+	return true;
 }
 
+/*
+ * Collect and report the result of the statement in flight.
+ */
 static void
-do_commit_abort(PGconn *conn, txn_info *txn, bool is_commit)
+receiveResolveResult(resolver_conn *rc)
 {
-	int ii;
-	static const char *EXEC_DIRECT_STMT_FMT = "EXECUTE DIRECT ON (%s) '%s PREPARED ''%s'';';";
-	static const char *GLOBAL_STMT_FMT = "%s PREPARED '%s';";
-	char *stmt = (char *) malloc (64 + strlen(txn->xid));
-	PGresult *res;
-	ExecStatusType res_status;
+	txn_info   *txn = rc->txn;
+	char	   *node_name;
+	PGresult   *res;
 
-	if (verbose_opt)
-		fprintf(outf, "    %s... ", is_commit ? "committing" : "aborting");
-	for (ii = 0; ii < pgxc_clean_node_count; ii++)
+	node_name = rc->cur_node >= 0 ? pgxc_clean_node_info[rc->cur_node].node_name : my_nodename;
+	while ((res = PQgetResult(rc->conn)) != NULL)
 	{
-		if (txn->txn_stat[ii] == TXN_STATUS_PREPARED && ii != my_nodeidx)
-		{
+		ExecStatusType res_status = PQresultStatus(res);
 
-			sprintf(stmt, EXEC_DIRECT_STMT_FMT,
-					pgxc_clean_node_info[ii].node_name,
-					is_commit ? "COMMIT" : "ROLLBACK",
-					txn->xid);
-			res = PQexec(conn, stmt);
-			res_status = PQresultStatus(res);
+		if (res_status == PGRES_COMMAND_OK || res_status == PGRES_TUPLES_OK)
+		{
 			if (verbose_opt)
-			{
-				if (res_status == PGRES_COMMAND_OK || res_status == PGRES_TUPLES_OK)
-					fprintf(outf, "succeeded (%s), ", pgxc_clean_node_info[ii].node_name);
-				else
-					fprintf(outf, "failed (%s: %s), ",
-							pgxc_clean_node_info[ii].node_name,
-							PQresultErrorMessage(res));
-			}
-			else
-			{
-				if (res_status != PGRES_COMMAND_OK && res_status != PGRES_TUPLES_OK)
-				{
-					fprintf(errf, "Failed to recover TXN, gxid: %d, xid: \"%s\", owner: \"%s\", node: \"%s\" (%s)\n",
-							txn->gxid, txn->xid, txn->owner, pgxc_clean_node_info[ii].node_name,
-							PQresultErrorMessage(res));
-				}
-			}
-			PQclear(res);
+				fprintf(outf, "    %s gxid: %d succeeded (%s)\n",
+						rc->is_commit ? "committing" : "aborting",
+						txn->gxid, node_name);
 		}
-	}
-	/* Issue global statment */
-	sprintf(stmt, GLOBAL_STMT_FMT,
-			is_commit ? "COMMIT" : "ROLLBACK",
-			txn->xid);
-	res = PQexec(conn, stmt);
-	res_status = PQresultStatus(res);
-	if (verbose_opt)
-	{
-		if (res_status == PGRES_COMMAND_OK || res_status == PGRES_TUPLES_OK)
-			fprintf(outf, "succeeded (%s)\n", my_nodename);
+		else if (verbose_opt)
+			fprintf(outf, "    %s gxid: %d failed (%s: %s)\n",
+					rc->is_commit ? "committing" : "aborting",
+					txn->gxid, node_name, PQresultErrorMessage(res));
 		else
-			fprintf(outf, "failed (%s: %s)\n",
-					my_nodename,
+			fprintf(errf, "Failed to recover TXN, gxid: %d, xid: \"%s\", owner: \"%s\", node: \"%s\" (%s)\n",
+					txn->gxid, txn->xid, txn->owner, node_name,
 					PQresultErrorMessage(res));
+		PQclear(res);
 	}
-	else if (res_status != PGRES_COMMAND_OK && res_status != PGRES_TUPLES_OK)
-	{
-		fprintf(errf, "Failed to recover TXN, gxid: %d, xid: \"%s\", owner: \"%s\", node: \"%s\" (%s)\n",
-				txn->gxid, txn->xid, txn->owner, my_nodename, PQresultErrorMessage(res));
-	}
-	PQclear(res);
 }
 
 #if 0
@@ -679,28 +825,52 @@ getTxnStatus(PGconn *conn, GlobalTransactionId gxid, int node_idx)
 		return TXN_STATUS_ABORTED;
 }
 
+/*
+ * Get the status of a batch of transactions on a node with a single query,
+ * instead of one or two round trips per transaction.  Falls back to
+ * getTxnStatus() if the answer does not line up with the request.
+ */
 static void
-getTxnInfoOnOtherNodes(PGconn *conn, txn_info *txn)
+getTxnStatusBatch(PGconn *conn, int node_idx, txn_info **txns, int ntxns)
 {
+	static const char *STMT_HEAD =
+		"EXECUTE DIRECT ON (%s) 'SELECT x, pgxc_is_committed(x), pgxc_is_inprogress(x) "
+		"FROM unnest(''{";
+	static const char *STMT_TAIL = "}''::xid[]) x'";
+	char *node_name;
+	char *stmt;
+	char *p;
+	PGresult *res;
 	int ii;
 
-	for (ii = 0; ii < pgxc_clean_node_count; ii++)
-	{
-		if (txn->txn_stat[ii] == TXN_STATUS_INITIAL)
-			txn->txn_stat[ii] = getTxnStatus(conn, txn->gxid, ii);
-	}
-}
-
-
-static void
-getTxnInfoOnOtherNodesForDatabase(PGconn *conn, database_info *database)
-{
-	txn_info *cur_txn;
+	node_name = pgxc_clean_node_info[node_idx].node_name;
+	stmt = (char *) malloc(strlen(STMT_HEAD) + strlen(node_name) +
+						   12 * ntxns + strlen(STMT_TAIL) + 1);
+	p = stmt + sprintf(stmt, STMT_HEAD, node_name);
+	for (ii = 0; ii < ntxns; ii++)
+		p += sprintf(p, ii == 0 ? "%u" : ",%u", txns[ii]->gxid);
+	strcpy(p, STMT_TAIL);
 
-	for (cur_txn = database->head_txn_info; cur_txn; cur_txn = cur_txn->next)
+	res = PQexec(conn, stmt);
+	for (ii = 0; ii < ntxns; ii++)
 	{
-		getTxnInfoOnOtherNodes(conn, cur_txn);
+		txn_info *txn = txns[ii];
+
+		if (res == NULL || PQresultStatus(res) != PGRES_TUPLES_OK ||
+			PQntuples(res) != ntxns ||
+			strtoul(PQgetvalue(res, ii, 0), NULL, 10) != txn->gxid)
+			txn->txn_stat[node_idx] = getTxnStatus(conn, txn->gxid, node_idx);
+		else if (!PQgetisnull(res, ii, 1))
+			txn->txn_stat[node_idx] = strcmp(PQgetvalue(res, ii, 1), "t") == 0 ?
+				TXN_STATUS_COMMITTED : TXN_STATUS_ABORTED;
+		else if (!PQgetisnull(res, ii, 2) &&
+				 strcmp(PQgetvalue(res, ii, 2), "t") == 0)
+			txn->txn_stat[node_idx] = TXN_STATUS_INPROGRESS;
+		else
+			txn->txn_stat[node_idx] = TXN_STATUS_UNKNOWN;
 	}
+	PQclear(res);
+	free(stmt);
 }
 
 
@@ -708,11 +878,40 @@ static void
 getTxnInfoOnOtherNodesAll(PGconn *conn)
 {
 	database_info *cur_database;
+	txn_info *cur_txn;
+	txn_info **batch;
+	int ntxns = 0;
+	int ii;
 
 	for (cur_database = head_database_info; cur_database; cur_database = cur_database->next)
+		for (cur_txn = cur_database->head_txn_info; cur_txn; cur_txn = cur_txn->next)
+			ntxns++;
+	if (ntxns == 0)
+		return;
+	batch = (txn_info **) malloc(sizeof(txn_info *) * TXN_STATUS_BATCH_SIZE);
+
+	for (ii = 0; ii < pgxc_clean_node_count; ii++)
 	{
-		getTxnInfoOnOtherNodesForDatabase(conn, cur_database);
+		int nbatch = 0;
+
+		for (cur_database = head_database_info; cur_database; cur_database = cur_database->next)
+		{
+			for (cur_txn = cur_database->head_txn_info; cur_txn; cur_txn = cur_txn->next)
+			{
+				if (cur_txn->txn_stat[ii] != TXN_STATUS_INITIAL)
+					continue;
+				batch[nbatch++] = cur_txn;
+				if (nbatch == TXN_STATUS_BATCH_SIZE)
+				{
+					getTxnStatusBatch(conn, ii, batch, nbatch);
+					nbatch = 0;
+				}
+			}
+		}
+		if (nbatch > 0)
+			getTxnStatusBatch(conn, ii, batch, nbatch);
 	}
+	free(batch);
 }
 
 
@@ -926,6 +1125,7 @@ parse_pgxc_clean_options(int argc, char *argv[])
 		{"all", no_argument, NULL, 'a'},
 		{"dbname", required_argument, NULL, 'd'},
 		{"host", required_argument, NULL, 'h'},
+		{"jobs", required_argument, NULL, 'j'},
 		{"no-clean", no_argument, NULL, 'N'},
 		{"output", required_argument, NULL, 'o'},
 		{"port", required_argument, NULL, 'p'},
@@ -947,7 +1147,7 @@ parse_pgxc_clean_options(int argc, char *argv[])
 
 	progname = get_progname(argv[0]);		/* Should be more fancy */
 
-	while ((c = getopt_long(argc, argv, "ad:h:No:p:qU:vVwWs?", long_options, &optindex)) != -1)
+	while ((c = getopt_long(argc, argv, "ad:h:j:No:p:qU:vVwWs?", long_options, &optindex)) != -1)
 	{
 		switch(c)
 		{
@@ -960,6 +1160,14 @@ parse_pgxc_clean_options(int argc, char *argv[])
 			case 'h':
 				coordinator_host = optarg;
 				break;
+			case 'j':
+				jobs_opt = atoi(optarg);
+				if (jobs_opt <= 0)
+				{
+					fprintf(stderr, "%s: number of jobs must be at least 1\n", progname);
+					exit(1);
+				}
+				break;
 			case 'N':
 				no_clean_opt = true;
 				break;
@@ -1087,6 +1295,7 @@ static void usage(void)
 	printf("  -d, --dbname=DBNAME      database name to clean up (default: \"%s\")\n", env);
 	env = getenv("PGHOST");
 	printf("  -h, --host=HOSTNAME      target coordinator host address, (default: \"%s\")\n", env ? env : "local socket");
+	printf("  -j, --jobs=NUM           number of transactions to recover concurrently (default: 1)\n");
 	printf("  -N, no-clean             only collect 2PC information.  Do not recover them\n");
 	printf("  -o, --output=FILENAME    output file name.\n");
 	env = getenv("PGPORT");
@@ -455,6 +455,8 @@ void handle_no_slaves()
 			emptyCoordSlaves();
 		}
 	}
+	if (!find_var(VAR_datanodeAddByClone))
+		reset_var_val(VAR_datanodeAddByClone, "n");
 	/* Datanode Slaves */
 	if (!find_var(VAR_datanodeSlave))
 		reset_var_val(VAR_datanodeSlave, "n");
@@ -1163,8 +1165,8 @@ int backup_configuration(void)
 	if ((strcasecmp(sval(VAR_configBackup), "y") != 0) || is_none(sval(VAR_configBackupHost)) || 
 		is_none(sval(VAR_configBackupDir)) || is_none(sval(VAR_configBackupFile)))
 		return (2);
-	return(doImmediate(NULL, NULL, "scp %s %s@%s:%s/%s",
-					   pgxc_ctl_config_path,
+	return(doImmediate(NULL, NULL, "scp %s %s %s@%s:%s/%s",
+					   sshOpts(), pgxc_ctl_config_path,
 					   sval(VAR_pgxcUser), sval(VAR_configBackupHost),
 					   sval(VAR_configBackupDir), sval(VAR_configBackupFile)));
 }
@@ -976,6 +976,7 @@ int add_datanodeMaster(char *name, char *host, int port, int pooler, char *dir,
 	char **confFiles = NULL;
 	char **pgHbaConfFiles = NULL;
 	bool wal;
+	bool clone;
 
 	if (waldir && (strcasecmp(waldir, "none") != 0))
 		wal = true;
@@ -1037,6 +1038,12 @@ int add_datanodeMaster(char *name, char *host, int port, int pooler, char *dir,
 		return 1;
 	}
 
+	/*
+	 * A new datanode can be cloned only from an existing datanode. Otherwise
+	 * the schema is dumped from a coordinator and restored.
+	 */
+	clone = isVarYes(VAR_datanodeAddByClone) && restore_dnode_idx != -1;
+
 	if ((extendVar(VAR_datanodeNames, idx + 1, "none") != 0) ||
 		(extendVar(VAR_datanodeMasterServers, idx + 1, "none")  != 0) ||
 		(extendVar(VAR_datanodePorts, idx + 1, "none")  != 0) ||
@@ -1152,11 +1159,54 @@ int add_datanodeMaster(char *name, char *host, int port, int pooler, char *dir,
 	gtmHost = (gtmPxyIdx > 0) ? aval(VAR_gtmProxyServers)[gtmPxyIdx] : sval(VAR_gtmMasterServer);
 	gtmPort = (gtmPxyIdx > 0) ? aval(VAR_gtmProxyPorts)[gtmPxyIdx] : sval(VAR_gtmMasterPort);
 
-	/* initdb */
-	doImmediate(host, NULL, "PGXC_CTL_SILENT=1 initdb -D %s %s %s --nodename %s", dir,
-			wal ? "-X" : "",
-			wal ? waldir : "",
-			name);
+ 	/* Lock ddl */
+ 	if (restore_dnode_idx != -1)
+ 	{
+ 		if ((lockf = pgxc_popen_wRaw("psql -h %s -p %d %s", aval(VAR_datanodeMasterServers)[restore_dnode_idx], atoi(aval(VAR_datanodePorts)[restore_dnode_idx]), sval(VAR_defaultDatabase))) == NULL)
+ 		{
+ 			elog(ERROR, "ERROR: could not open datanode psql command, %s\n", strerror(errno));
+ 			return 1;
+ 		}
+ 	}
+ 	else if (restore_coord_idx != -1)
+ 	{
+ 		if ((lockf = pgxc_popen_wRaw("psql -h %s -p %d %s", aval(VAR_coordMasterServers)[restore_coord_idx], atoi(aval(VAR_coordPorts)[restore_coord_idx]), sval(VAR_defaultDatabase))) == NULL)
+ 		{
+ 			elog(ERROR, "ERROR: could not open coordinator psql command, %s\n", strerror(errno));
+  			return 1;
+  		}
+  	}
+  	else
+  	{
+ 		elog(ERROR, "ERROR: no valid datanode or coordinator configuration!");
+  		return 1;
+  	}
+ 
+	fprintf(lockf, "select pgxc_lock_for_backup();\n");	/* Keep open until the end of the addition. */
+	fflush(lockf);
+
+	if (clone)
+	{
+		/*
+		 * Physical copy of an existing datanode. This brings the whole
+		 * catalog of every database at once, which is much faster than
+		 * dumping and restoring the schema when there are many objects.
+		 * The data copied along is removed below.
+		 */
+		doImmediate(host, NULL, "pg_basebackup -p %s -h %s -D %s -X stream %s %s",
+					aval(VAR_datanodePorts)[restore_dnode_idx],
+					aval(VAR_datanodeMasterServers)[restore_dnode_idx], dir,
+					wal ? "--waldir" : "",
+					wal ? waldir : "");
+	}
+	else
+	{
+		/* initdb */
+		doImmediate(host, NULL, "PGXC_CTL_SILENT=1 initdb -D %s %s %s --nodename %s", dir,
+				wal ? "-X" : "",
+				wal ? waldir : "",
+				name);
+	}
 
 	/* Edit configurations */
 	if ((f = pgxc_popen_w(host, "cat >> %s/postgresql.conf", dir)))
@@ -1172,6 +1222,9 @@ int add_datanodeMaster(char *name, char *host, int port, int pooler, char *dir,
 				"# End of Additon\n",
 				timeStampString(date, MAXTOKEN+1),
 				port, pooler, gtmHost, gtmPort);
+		/* The clone still has the node name of its source */
+		if (clone)
+			fprintf(f, "pgxc_node_name = '%s'\n", name);
 		pclose(f);
 	}
 	CleanArray(confFiles);
@@ -1196,35 +1249,13 @@ int add_datanodeMaster(char *name, char *host, int port, int pooler, char *dir,
 		pclose(f);
 	}
 
- 	/* Lock ddl */
- 	if (restore_dnode_idx != -1)
- 	{
- 		if ((lockf = pgxc_popen_wRaw("psql -h %s -p %d %s", aval(VAR_datanodeMasterServers)[restore_dnode_idx], atoi(aval(VAR_datanodePorts)[restore_dnode_idx]), sval(VAR_defaultDatabase))) == NULL)
- 		{
- 			elog(ERROR, "ERROR: could not open datanode psql command, %s\n", strerror(errno));
- 			return 1;
- 		}
- 	}
- 	else if (restore_coord_idx != -1)
- 	{
- 		if ((lockf = pgxc_popen_wRaw("psql -h %s -p %d %s", aval(VAR_coordMasterServers)[restore_coord_idx], atoi(aval(VAR_coordPorts)[restore_coord_idx]), sval(VAR_defaultDatabase))) == NULL)
- 		{
- 			elog(ERROR, "ERROR: could not open coordinator psql command, %s\n", strerror(errno));
-  			return 1;
-  		}
-  	}
-  	else
-  	{
- 		elog(ERROR, "ERROR: no valid datanode or coordinator configuration!");
-  		return 1;
-  	}
- 
-	fprintf(lockf, "select pgxc_lock_for_backup();\n");	/* Keep open until the end of the addition. */
-	fflush(lockf);
-
 	/* pg_dumpall */
 	createLocalFileName(GENERAL, pgdumpall_out, MAXPATH);
- 	if (restore_dnode_idx != -1)
+	if (clone)
+	{
+		/* The clone has the schema already */
+	}
+ 	else if (restore_dnode_idx != -1)
  		doImmediateRaw("pg_dumpall -p %s -h %s -s --include-nodes --dump-nodes >%s",
 				   aval(VAR_datanodePorts)[restore_dnode_idx],
 				   aval(VAR_datanodeMasterServers)[restore_dnode_idx],
@@ -1246,9 +1277,31 @@ int add_datanodeMaster(char *name, char *host, int port, int pooler, char *dir,
 	/* Allow the new datanode to start up by sleeping for a couple of seconds */
 	pg_usleep(2000000L);
 
-	/* Restore the backup */
-	doImmediateRaw("psql -h %s -p %d -d %s -f %s", host, port, sval(VAR_defaultDatabase), pgdumpall_out);
-	doImmediateRaw("rm -f %s", pgdumpall_out);
+	if (clone)
+	{
+		/*
+		 * Empty all the tables of the clone, one database at a time in
+		 * parallel. Like after a schema restore, the new datanode gets its
+		 * rows, or the buckets it takes over, when the tables are altered
+		 * to ADD NODE. Then register the new node itself, its source did
+		 * not know about it.
+		 */
+		doImmediateRaw("psql -h %s -p %d -d %s -Atc \"SELECT datname FROM pg_database WHERE datallowconn\" | "
+					   "while read db; do "
+					   "(psql -h %s -p %d -d \"$db\" -Atc \"SELECT 'TRUNCATE ' || string_agg(pcrelid::regclass::text, ', ') FROM pgxc_class\" | "
+					   "psql -h %s -p %d -d \"$db\") & "
+					   "done; wait",
+					   host, port, sval(VAR_defaultDatabase),
+					   host, port, host, port);
+		doImmediateRaw("psql -h %s -p %d -d %s -c \"CREATE NODE %s WITH (TYPE = 'datanode', host='%s', PORT=%d)\"",
+					   host, port, sval(VAR_defaultDatabase), name, host, port);
+	}
+	else
+	{
+		/* Restore the backup */
+		doImmediateRaw("psql -h %s -p %d -d %s -f %s", host, port, sval(VAR_defaultDatabase), pgdumpall_out);
+		doImmediateRaw("rm -f %s", pgdumpall_out);
+	}
 
 	/* Quit the new datanode */
 	doImmediate(host, NULL, "pg_ctl stop -w -Z restoremode -D %s", dir);
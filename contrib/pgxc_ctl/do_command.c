@@ -191,8 +191,8 @@ static void deploy_xc(char **hostlist)
 		/* SCP tarball */
 		appendCmdEl(cmd, (cmdScp = initCmd(NULL)));
 		snprintf(newCommand(cmdScp), MAXLINE,
-				 "scp %s/%s %s@%s:%s",
-				 sval(VAR_localTmpDir), tarFile, sval(VAR_pgxcUser), hostlist[ii], sval(VAR_tmpDir));
+				 "scp %s %s/%s %s@%s:%s",
+				 sshOpts(), sval(VAR_localTmpDir), tarFile, sval(VAR_pgxcUser), hostlist[ii], sval(VAR_tmpDir));
 		/* Extract Tarball and remove it */
 		appendCmdEl(cmd, (cmdTarExtract = initCmd(hostlist[ii])));
 		snprintf(newCommand(cmdTarExtract), MAXLINE,
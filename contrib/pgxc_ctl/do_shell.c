@@ -54,6 +54,7 @@ static void echoPid(pid_t pid);
 #endif
 static char *allocActualCmd(cmd_t *cmd);
 static void prepareStdout(cmdList_t *cmdList);
+static char sshOptsBuf[MAXLINE+1];
 
 /*
  * SIGINT handler
@@ -135,6 +136,26 @@ char *createRemoteFileName(FileType type, char *buf, int len)
 	return buf;
 }
 
+/*
+ * Options given to every ssh and scp invocation.
+ *
+ * Unless sshControlPersist is 0, all the ssh and scp sessions to a host
+ * share a single master connection, which is kept open for that many
+ * seconds after its last use.  A remote command train runs several ssh and
+ * scp each, so this saves most of the connection setup and authentication
+ * round trips when operating on many servers.
+ */
+char *sshOpts(void)
+{
+	if (strcmp(sval(VAR_sshControlPersist), "0") == 0)
+		sshOptsBuf[0] = '\0';
+	else
+		snprintf(sshOptsBuf, MAXLINE,
+				 "-o ControlMaster=auto -o ControlPath=%s/pgxc_ctl_ssh_%%C -o ControlPersist=%s",
+				 sval(VAR_localTmpDir), sval(VAR_sshControlPersist));
+	return sshOptsBuf;
+}
+
 /*
  * ==============================================================================================
  *
@@ -182,7 +203,7 @@ FILE *pgxc_popen_w(char *host, const char *cmd_fmt, ...)
 	va_start(arg, cmd_fmt);
 	vsnprintf(actualCmd, MAXLINE, cmd_fmt, arg);
 	va_end(arg);
-	snprintf(sshCmd, MAXLINE, "ssh %s@%s \" %s \"", sval(VAR_pgxcUser), host, actualCmd);
+	snprintf(sshCmd, MAXLINE, "ssh %s %s@%s \" %s \"", sshOpts(), sval(VAR_pgxcUser), host, actualCmd);
 	if ((f = popen(sshCmd, "w")) == NULL)
 		elog(ERROR, "ERROR: could not open the command \"%s\" to write, %s\n", sshCmd, strerror(errno));
 	return f;
@@ -214,22 +235,22 @@ int doImmediate(char *host, char *stdIn, const char *cmd_fmt, ...)
 	{
 		int rc1;
 		/* Remote case */
-		snprintf(actualCmd, MAXLINE, "ssh %s@%s \"( %s ) > %s 2>&1\" < %s > /dev/null 2>&1",
-				 sval(VAR_pgxcUser), host, cmd_wk, 
+		snprintf(actualCmd, MAXLINE, "ssh %s %s@%s \"( %s ) > %s 2>&1\" < %s > /dev/null 2>&1",
+				 sshOpts(), sval(VAR_pgxcUser), host, cmd_wk,
 				 createRemoteFileName(STDOUT, remoteStdout, MAXPATH),
 				 ((stdIn == NULL) || (stdIn[0] == 0)) ? "/dev/null" : stdIn);
 		elog(INFO, "Actual Command: %s\n", actualCmd);
 		rc = system(actualCmd);
-		snprintf(actualCmd, MAXLINE, "scp %s@%s:%s %s > /dev/null 2>&1",
-				 sval(VAR_pgxcUser), host, remoteStdout,
+		snprintf(actualCmd, MAXLINE, "scp %s %s@%s:%s %s > /dev/null 2>&1",
+				 sshOpts(), sval(VAR_pgxcUser), host, remoteStdout,
 				 createLocalFileName(STDOUT, localStdout, MAXPATH));
 		elog(INFO, "Bring remote stdout: %s\n", actualCmd);
 		rc1 = system(actualCmd);
 		if (WEXITSTATUS(rc1) != 0)
 			elog(WARNING, "WARNING: Stdout transfer not successful, file: %s:%s->%s\n",
 				 host, remoteStdout, localStdout);
-		doImmediateRaw("ssh %s@%s \"rm -f %s < /dev/null > /dev/null\" < /dev/null > /dev/null",
-					   sval(VAR_pgxcUser), host, remoteStdout);
+		doImmediateRaw("ssh %s %s@%s \"rm -f %s < /dev/null > /dev/null\" < /dev/null > /dev/null",
+					   sshOpts(), sval(VAR_pgxcUser), host, remoteStdout);
 	}
 	elogFile(INFO, localStdout);
 	unlink(localStdout);
@@ -271,8 +292,8 @@ static void touchStdout(cmd_t *cmd)
 {
 	if (cmd->remoteStdout)
 		if (cmd->remoteStdout)
-			doImmediateRaw("(ssh %s@%s touch %s) < /dev/null > /dev/null 2>&1", 
-						   sval(VAR_pgxcUser), cmd->host,
+			doImmediateRaw("(ssh %s %s@%s touch %s) < /dev/null > /dev/null 2>&1",
+						   sshOpts(), sval(VAR_pgxcUser), cmd->host,
 						   cmd->remoteStdout);
 	if (cmd->localStdout)
 		doImmediateRaw("(touch %s) < /dev/null > /dev/null", cmd->localStdout);
@@ -328,7 +349,8 @@ int doCmdEl(cmd_t *cmd)
 	{
 		/* Build actual command */
 		snprintf(allocActualCmd(cmd), MAXLINE,
-				 "ssh %s@%s \"( %s ) > %s 2>&1\" < %s > /dev/null 2>&1",
+				 "ssh %s %s@%s \"( %s ) > %s 2>&1\" < %s > /dev/null 2>&1",
+				 sshOpts(),
 				 sval(VAR_pgxcUser),
 				 cmd->host,
 				 cmd->command,
@@ -340,9 +362,9 @@ int doCmdEl(cmd_t *cmd)
 		/* Handle stdout */
 		clearStdin(cmd);
 		touchStdout(cmd);
-		doImmediateRaw("(scp %s@%s:%s %s; ssh %s@%s rm -rf %s) < /dev/null > /dev/null",
-					   sval(VAR_pgxcUser), cmd->host, cmd->remoteStdout, cmd->localStdout,
-					   sval(VAR_pgxcUser), cmd->host, cmd->remoteStdout);
+		doImmediateRaw("(scp %s %s@%s:%s %s; ssh %s %s@%s rm -rf %s) < /dev/null > /dev/null",
+					   sshOpts(), sval(VAR_pgxcUser), cmd->host, cmd->remoteStdout, cmd->localStdout,
+					   sshOpts(), sval(VAR_pgxcUser), cmd->host, cmd->remoteStdout);
 		freeAndReset(cmd->remoteStdout);
 		/* Handle stdin */
 		return (cmd->excode);
@@ -393,10 +415,41 @@ int doCmdList(cmdList_t *cmds)
 	prepareStdout(cmds);
 	if (setjmp(dcJmpBufDoShell) == 0)
 	{
+		int running = 0;
+		int maxJobs = atoi(sval(VAR_parallelJobs));
+
 		for (ii = 0; cmds->cmds[ii]; ii++)
 		{
+			cmds->cmds[ii]->done = FALSE;
 			if (!isVarYes(VAR_debug))
 			{
+				/*
+				 * Bound the number of concurrent command trains: wait for
+				 * one of them to finish before starting the next.
+				 */
+				while (maxJobs > 0 && running >= maxJobs)
+				{
+					int status;
+					pid_t pid = wait(&status);
+
+					if (pid == -1)
+					{
+						if (errno == EINTR)
+							continue;
+						break;
+					}
+					for (jj = 0; jj < ii; jj++)
+					{
+						if (cmds->cmds[jj]->pid == pid)
+						{
+							cmds->cmds[jj]->pid = 0;
+							cmds->cmds[jj]->excode = status;
+							cmds->cmds[jj]->done = TRUE;
+							running--;
+							break;
+						}
+					}
+				}
 				if ((cmds->cmds[ii]->pid = fork()) != 0)
 				{
 					if (cmds->cmds[ii]->pid == -1)
@@ -406,6 +459,8 @@ int doCmdList(cmdList_t *cmds)
 									strerror(errno));
 						cmds->cmds[ii]->pid = 0;
 					}
+					else
+						running++;
 					continue;
 				}
 				else
@@ -471,6 +526,8 @@ int doCmdList(cmdList_t *cmds)
 					pid = waitpid(cmds->cmds[ii]->pid, &status, 0);
 					rc = WEXITSTATUS(status);
 				}
+				else if (cmds->cmds[ii]->done)
+					rc = WEXITSTATUS(cmds->cmds[ii]->excode);
 			}
 			cmds->cmds[ii]->pid = 0;
 			for (cur = cmds->cmds[ii]; cur; cur = cur->next)
@@ -540,7 +597,7 @@ void do_cleanCmdEl(cmd_t *cmd)
 			unlink(cmd->localStdin);
 		Free(cmd->localStdin);
 		if (cmd->remoteStdout)
-			doImmediateRaw("ssh %s@%s \"rm -f %s > /dev/null 2>&1\"", sval(VAR_pgxcUser), cmd->host, cmd->remoteStdout);
+			doImmediateRaw("ssh %s %s@%s \"rm -f %s > /dev/null 2>&1\"", sshOpts(), sval(VAR_pgxcUser), cmd->host, cmd->remoteStdout);
 		Free(cmd->remoteStdout);
 		Free(cmd->actualCmd);
 		Free(cmd->command);
@@ -685,9 +742,9 @@ cmd_t *makeConfigBackupCmd(void)
 {
 	cmd_t *rv = Malloc0(sizeof(cmd_t));
 	snprintf((rv->command = Malloc(MAXLINE+1)), MAXLINE,
-			 "ssh %s@%s mkdir -p %s;scp %s %s@%sp:%s",
-			 sval(VAR_pgxcUser), sval(VAR_configBackupHost), sval(VAR_configBackupDir),
-			 pgxc_ctl_config_path, sval(VAR_pgxcUser), sval(VAR_configBackupHost),
+			 "ssh %s %s@%s mkdir -p %s;scp %s %s %s@%sp:%s",
+			 sshOpts(), sval(VAR_pgxcUser), sval(VAR_configBackupHost), sval(VAR_configBackupDir),
+			 sshOpts(), pgxc_ctl_config_path, sval(VAR_pgxcUser), sval(VAR_configBackupHost),
 			 sval(VAR_configBackupFile));
 	return(rv);
 }
@@ -696,9 +753,9 @@ int doConfigBackup(void)
 {
 	int rc;
 
-	rc = doImmediateRaw("ssh %s@%s mkdir -p %s;scp %s %s@%s:%s/%s",
-						sval(VAR_pgxcUser), sval(VAR_configBackupHost), sval(VAR_configBackupDir),
-						pgxc_ctl_config_path, sval(VAR_pgxcUser), sval(VAR_configBackupHost),
+	rc = doImmediateRaw("ssh %s %s@%s mkdir -p %s;scp %s %s %s@%s:%s/%s",
+						sshOpts(), sval(VAR_pgxcUser), sval(VAR_configBackupHost), sval(VAR_configBackupDir),
+						sshOpts(), pgxc_ctl_config_path, sval(VAR_pgxcUser), sval(VAR_configBackupHost),
 						sval(VAR_configBackupDir), sval(VAR_configBackupFile));
 	return(rc);
 }
@@ -28,6 +28,7 @@ extern int doImmediate(char *host, char *stdIn, const char *cmd_fmt, ...) __attr
 extern int doImmediateRaw(const char *cmd_fmt, ...) __attribute__((format(printf, 1,2)));
 extern FILE *pgxc_popen_wRaw(const char *cmd_fmt, ...) __attribute__((format(printf, 1,2)));
 extern FILE *pgxc_popen_w(char *host, const char *cmd_fmt, ...) __attribute__((format(printf, 2,3)));
+extern char *sshOpts(void);
 
 /*
  * Flags
@@ -66,6 +67,7 @@ typedef struct cmd_t
 	pid_t pid;			/* internal use: valid only for cmd at the head of the list */
 	int	flag;			/* flags */
 	int excode;			/* exit code -> not used in parallel execution.  */
+	int done;			/* internal use: finished, and exit code collected in excode */
 	char *msg;			/* internal use: messages to write.  Has to be comsumed only by child process. */
 	char *remoteStdout;	/* internal use: remote stdout name.  Generated for remote case */
 } cmd_t;
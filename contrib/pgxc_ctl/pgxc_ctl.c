@@ -379,6 +379,8 @@ static void setup_my_env(void)
 		VAR_pgxcCtlName,
 		VAR_printLocation,
 		VAR_logLocation,
+		VAR_parallelJobs,
+		VAR_sshControlPersist,
 		NULL
 	};
 
@@ -419,6 +421,8 @@ static void setup_my_env(void)
 	defaultDatabase = Strdup(sval(VAR_defaultDatabase));
 	setDefaultIfNeeded(VAR_printLocation, "n");
 	setDefaultIfNeeded(VAR_logLocation, "n");
+	setDefaultIfNeeded(VAR_parallelJobs, "0");
+	setDefaultIfNeeded(VAR_sshControlPersist, "60");
 }
 
 int main(int argc, char *argv[])
@@ -272,9 +272,9 @@ pid_t get_prog_pid(char *host, char *pidfile, char *dir)
 	FILE *wkf;
 
 	snprintf(cmd, MAXLINE,
-			 "ssh %s@%s "
+			 "ssh %s %s@%s "
 			 "\"cat %s/%s.pid\"",
-			 sval(VAR_pgxcUser), host, dir, pidfile);
+			 sshOpts(), sval(VAR_pgxcUser), host, dir, pidfile);
 	wkf = popen(cmd, "r");
 	if (wkf == NULL)
 	{
@@ -340,8 +340,8 @@ int pingNodeSlave(char *host, char *datadir)
 	char line[MAXLINE+1];
 	int	 rv;
 
-	snprintf(cmd, MAXLINE, "ssh %s@%s pg_ctl -D %s status > /dev/null 2>&1; echo $?",
-			 sval(VAR_pgxcUser), host, datadir);
+	snprintf(cmd, MAXLINE, "ssh %s %s@%s pg_ctl -D %s status > /dev/null 2>&1; echo $?",
+			 sshOpts(), sval(VAR_pgxcUser), host, datadir);
 	wkf = popen(cmd, "r");
 	if (wkf == NULL)
 		return -1;
@@ -370,8 +370,8 @@ char *getChPidList(char *host, pid_t ppid)
 	char *rv = Malloc(MAXLINE+1);
 
 	rv[0] = 0;
-	snprintf(cmd, MAXLINE, "ssh %s@%s pgrep -P %d",
-			 sval(VAR_pgxcUser), host, ppid);
+	snprintf(cmd, MAXLINE, "ssh %s %s@%s pgrep -P %d",
+			 sshOpts(), sval(VAR_pgxcUser), host, ppid);
 	wkf = popen(cmd, "r");
 	if (wkf == NULL)
 		return NULL;
@@ -100,6 +100,7 @@
 #define VAR_datanodeMasterDirs		"datanodeMasterDirs"
 #define VAR_datanodeMasterWALDirs		"datanodeMasterWALDirs"
 #define VAR_datanodeMaxWALSenders	"datanodeMaxWALSenders"
+#define VAR_datanodeAddByClone		"datanodeAddByClone"
 
 /* Datanode slaves */
 #define VAR_datanodeSlave			"datanodeSlave"
@@ -148,5 +149,7 @@
 #define VAR_printMessage	"printMessage"	
 #define VAR_logLocation		"logLocation"
 #define VAR_printLocation	"printLocation"
+#define VAR_parallelJobs	"parallelJobs"
+#define VAR_sshControlPersist	"sshControlPersist"
 
 #endif /* VARNAMES_H */
@@ -58,6 +58,7 @@ typedef struct ConnCacheEntry
 	bool		invalidated;	/* true if reconnect is pending */
 	uint32		server_hashvalue;	/* hash value of foreign server OID */
 	uint32		mapping_hashvalue;	/* hash value of user mapping OID */
+	PgFdwConnState state;		/* extra per-connection state */
 } ConnCacheEntry;
 
 /*
@@ -102,9 +103,14 @@ static bool pgfdw_get_cleanup_result(PGconn *conn, TimestampTz endtime,
  * will_prep_stmt must be true if caller intends to create any prepared
  * statements.  Since those don't go away automatically at transaction end
  * (not even on error), we need this flag to cue manual cleanup.
+ *
+ * If state is not NULL, *state receives the per-connection state used to
+ * keep track of asynchronous requests.  Any request still in progress on the
+ * connection is completed before returning, so the caller can send commands
+ * right away.
  */
 PGconn *
-GetConnection(UserMapping *user, bool will_prep_stmt)
+GetConnection(UserMapping *user, bool will_prep_stmt, PgFdwConnState **state)
 {
 	bool		found;
 	ConnCacheEntry *entry;
@@ -196,6 +202,7 @@ GetConnection(UserMapping *user, bool will_prep_stmt)
 		entry->mapping_hashvalue =
 			GetSysCacheHashValue1(USERMAPPINGOID,
 								  ObjectIdGetDatum(user->umid));
+		memset(&entry->state, 0, sizeof(entry->state));
 
 		/* Now try to make the connection */
 		entry->conn = connect_pg_server(server, user);
@@ -204,6 +211,9 @@ GetConnection(UserMapping *user, bool will_prep_stmt)
 			 entry->conn, server->servername, user->umid, user->userid);
 	}
 
+	/* Finish any asynchronous FETCH still in progress */
+	process_pending_request(&entry->state);
+
 	/*
 	 * Start a new transaction or subtransaction if needed.
 	 */
@@ -212,6 +222,9 @@ GetConnection(UserMapping *user, bool will_prep_stmt)
 	/* Remember if caller will prepare statements */
 	entry->have_prep_stmt |= will_prep_stmt;
 
+	if (state)
+		*state = &entry->state;
+
 	return entry->conn;
 }
 
@@ -688,6 +701,12 @@ pgfdw_xact_callback(XactEvent event, void *arg)
 					 */
 					pgfdw_reject_incomplete_xact_state_change(entry);
 
+					/*
+					 * A scan that is still open, say a cursor that was not
+					 * closed, may have a FETCH in progress.
+					 */
+					process_pending_request(&entry->state);
+
 					/* Commit all remote transactions during pre-commit */
 					entry->changing_xact_state = true;
 					do_sql_command(entry->conn, "COMMIT TRANSACTION");
@@ -740,6 +759,9 @@ pgfdw_xact_callback(XactEvent event, void *arg)
 				case XACT_EVENT_PARALLEL_ABORT:
 				case XACT_EVENT_ABORT:
 
+					/* The scan waiting for a FETCH is going away */
+					entry->state.pending_scan = NULL;
+
 					/*
 					 * Don't try to clean up the connection if we're already
 					 * in error recursion trouble.
@@ -871,6 +893,13 @@ pgfdw_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
 			elog(ERROR, "missed cleaning up remote subtransaction at level %d",
 				 entry->xact_depth);
 
+		/*
+		 * On abort, a FETCH in progress is cancelled below; the scan that
+		 * sent it learns about that when it looks for the result.
+		 */
+		if (event == SUBXACT_EVENT_ABORT_SUB)
+			entry->state.pending_scan = NULL;
+
 		if (event == SUBXACT_EVENT_PRE_COMMIT_SUB)
 		{
 			/*
@@ -879,6 +908,9 @@ pgfdw_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
 			 */
 			pgfdw_reject_incomplete_xact_state_change(entry);
 
+			/* Finish any asynchronous FETCH before releasing the savepoint */
+			process_pending_request(&entry->state);
+
 			/* Commit all remote subtransactions during pre-commit */
 			snprintf(sql, sizeof(sql), "RELEASE SAVEPOINT s%d", curlevel);
 			entry->changing_xact_state = true;
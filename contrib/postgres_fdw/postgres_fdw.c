@@ -68,6 +68,8 @@ enum FdwScanPrivateIndex
 	FdwScanPrivateRetrievedAttrs,
 	/* Integer representing the desired fetch_size */
 	FdwScanPrivateFetchSize,
+	/* async-capable flag (as an integer Value node) */
+	FdwScanPrivateAsyncCapable,
 
 	/*
 	 * String describing join i.e. names of relations being joined and types
@@ -85,6 +87,7 @@ enum FdwScanPrivateIndex
  *	  (NIL for a DELETE)
  * 3) Boolean flag showing if the remote query has a RETURNING clause
  * 4) Integer list of attribute numbers retrieved by RETURNING, if any
+ * 5) Number of rows to insert per remote INSERT
  */
 enum FdwModifyPrivateIndex
 {
@@ -95,7 +98,9 @@ enum FdwModifyPrivateIndex
 	/* has-returning flag (as an integer Value node) */
 	FdwModifyPrivateHasReturning,
 	/* Integer list of attribute numbers retrieved by RETURNING */
-	FdwModifyPrivateRetrievedAttrs
+	FdwModifyPrivateRetrievedAttrs,
+	/* Integer representing the batch size */
+	FdwModifyPrivateBatchSize
 };
 
 /*
@@ -135,6 +140,7 @@ typedef struct PgFdwScanState
 
 	/* for remote query execution */
 	PGconn	   *conn;			/* connection for the scan */
+	PgFdwConnState *conn_state; /* extra per-connection state */
 	unsigned int cursor_number; /* quasi-unique ID for my cursor */
 	bool		cursor_exists;	/* have we created the cursor? */
 	int			numParams;		/* number of parameters passed to query */
@@ -156,6 +162,16 @@ typedef struct PgFdwScanState
 	MemoryContext temp_cxt;		/* context for per-tuple temporary data */
 
 	int			fetch_size;		/* number of tuples per fetch */
+
+	/*
+	 * For fetching asynchronously.  async_result is set when somebody else
+	 * needed the connection and read the result of our FETCH for us.  As for
+	 * the result of a direct modification, it is leaked if an error occurs
+	 * before we get to use it.
+	 */
+	bool		async_capable;	/* may we fetch ahead of the rows needed? */
+	bool		async_pending;	/* have we sent a FETCH not read yet? */
+	PGresult   *async_result;	/* result of our FETCH, if read already */
 } PgFdwScanState;
 
 /*
@@ -168,6 +184,7 @@ typedef struct PgFdwModifyState
 
 	/* for remote query execution */
 	PGconn	   *conn;			/* connection for the scan */
+	PgFdwConnState *conn_state; /* extra per-connection state */
 	char	   *p_name;			/* name of prepared statement, if created */
 
 	/* extracted fdw_private data */
@@ -181,8 +198,15 @@ typedef struct PgFdwModifyState
 	int			p_nums;			/* number of parameters to transmit */
 	FmgrInfo   *p_flinfo;		/* output conversion functions for them */
 
-	/* working memory context */
+	/* for inserting rows in batches */
+	int			batch_size;		/* number of rows per remote INSERT */
+	char	   *batch_query;	/* text of INSERT for a full batch */
+	int			num_batched;	/* number of rows collected so far */
+	const char **batch_values;	/* their parameter values, row after row */
+
+	/* working memory contexts */
 	MemoryContext temp_cxt;		/* context for per-tuple temporary data */
+	MemoryContext batch_cxt;	/* context holding the collected values */
 } PgFdwModifyState;
 
 /*
@@ -201,6 +225,7 @@ typedef struct PgFdwDirectModifyState
 
 	/* for remote query execution */
 	PGconn	   *conn;			/* connection for the update */
+	PgFdwConnState *conn_state; /* extra per-connection state */
 	int			numParams;		/* number of parameters passed to query */
 	FmgrInfo   *param_flinfo;	/* output conversion functions for them */
 	List	   *param_exprs;	/* executable expressions for param values */
@@ -369,8 +394,13 @@ static bool ec_member_matches_foreign(PlannerInfo *root, RelOptInfo *rel,
 						  void *arg);
 static void create_cursor(ForeignScanState *node);
 static void fetch_more_data(ForeignScanState *node);
+static void fetch_more_data_begin(ForeignScanState *node);
+static bool discard_pending_fetch(ForeignScanState *node);
 static void close_cursor(PGconn *conn, unsigned int cursor_number);
 static void prepare_foreign_modify(PgFdwModifyState *fmstate);
+static char *build_batch_insert_sql(PgFdwModifyState *fmstate, int nrows);
+static void execute_foreign_batch(PgFdwModifyState *fmstate);
+static int	get_batch_size_option(Relation rel);
 static const char **convert_prep_stmt_params(PgFdwModifyState *fmstate,
 						 ItemPointer tupleid,
 						 TupleTableSlot *slot);
@@ -517,6 +547,7 @@ postgresGetForeignRelSize(PlannerInfo *root,
 	fpinfo->fdw_tuple_cost = DEFAULT_FDW_TUPLE_COST;
 	fpinfo->shippable_extensions = NIL;
 	fpinfo->fetch_size = 100;
+	fpinfo->async_capable = false;
 
 	apply_server_options(fpinfo);
 	apply_table_options(fpinfo);
@@ -1248,9 +1279,10 @@ postgresGetForeignPlan(PlannerInfo *root,
 	 * Build the fdw_private list that will be available to the executor.
 	 * Items in the list must match order in enum FdwScanPrivateIndex.
 	 */
-	fdw_private = list_make3(makeString(sql.data),
+	fdw_private = list_make4(makeString(sql.data),
 							 retrieved_attrs,
-							 makeInteger(fpinfo->fetch_size));
+							 makeInteger(fpinfo->fetch_size),
+							 makeInteger(fpinfo->async_capable));
 	if (IS_JOIN_REL(foreignrel) || IS_UPPER_REL(foreignrel))
 		fdw_private = lappend(fdw_private,
 							  makeString(fpinfo->relation_name->data));
@@ -1322,7 +1354,7 @@ postgresBeginForeignScan(ForeignScanState *node, int eflags)
 	 * Get connection to the foreign server.  Connection manager will
 	 * establish new connection if necessary.
 	 */
-	fsstate->conn = GetConnection(user, false);
+	fsstate->conn = GetConnection(user, false, &fsstate->conn_state);
 
 	/* Assign a unique ID for my cursor */
 	fsstate->cursor_number = GetCursorNumber(fsstate->conn);
@@ -1335,6 +1367,8 @@ postgresBeginForeignScan(ForeignScanState *node, int eflags)
 												 FdwScanPrivateRetrievedAttrs);
 	fsstate->fetch_size = intVal(list_nth(fsplan->fdw_private,
 										  FdwScanPrivateFetchSize));
+	fsstate->async_capable = intVal(list_nth(fsplan->fdw_private,
+											 FdwScanPrivateAsyncCapable));
 
 	/* Create contexts for batches of tuples and per-tuple temp workspace. */
 	fsstate->batch_cxt = AllocSetContextCreate(estate->es_query_cxt,
@@ -1373,6 +1407,19 @@ postgresBeginForeignScan(ForeignScanState *node, int eflags)
 							 &fsstate->param_flinfo,
 							 &fsstate->param_exprs,
 							 &fsstate->param_values);
+
+	/*
+	 * If allowed, open the cursor and send the first FETCH right away, so
+	 * that the remote server works on it while the rest of the plan starts
+	 * up; all the foreign scans below an Append get going at once that way.
+	 * That's not possible if the query needs parameter values, which may not
+	 * be known yet.
+	 */
+	if (fsstate->async_capable && numParams == 0)
+	{
+		create_cursor(node);
+		fetch_more_data_begin(node);
+	}
 }
 
 /*
@@ -1432,6 +1479,10 @@ postgresReScanForeignScan(ForeignScanState *node)
 	if (!fsstate->cursor_exists)
 		return;
 
+	/* A FETCH sent ahead has moved the cursor past the rows we have */
+	if (discard_pending_fetch(node))
+		fsstate->fetch_ct_2 = 2;
+
 	/*
 	 * If any internal parameters affecting this node have changed, we'd
 	 * better destroy and recreate the cursor.  Otherwise, rewinding it should
@@ -1460,6 +1511,7 @@ postgresReScanForeignScan(ForeignScanState *node)
 	 * We don't use a PG_TRY block here, so be careful not to throw error
 	 * without releasing the PGresult.
 	 */
+	process_pending_request(fsstate->conn_state);
 	res = pgfdw_exec_query(fsstate->conn, sql);
 	if (PQresultStatus(res) != PGRES_COMMAND_OK)
 		pgfdw_report_error(ERROR, res, fsstate->conn, true, sql);
@@ -1488,7 +1540,11 @@ postgresEndForeignScan(ForeignScanState *node)
 
 	/* Close the cursor if open, to prevent accumulation of cursors */
 	if (fsstate->cursor_exists)
+	{
+		(void) discard_pending_fetch(node);
+		process_pending_request(fsstate->conn_state);
 		close_cursor(fsstate->conn, fsstate->cursor_number);
+	}
 
 	/* Release remote connection */
 	ReleaseConnection(fsstate->conn);
@@ -1552,6 +1608,7 @@ postgresPlanForeignModify(PlannerInfo *root,
 	List	   *returningList = NIL;
 	List	   *retrieved_attrs = NIL;
 	bool		doNothing = false;
+	int			batch_size = 1;
 
 	initStringInfo(&sql);
 
@@ -1640,16 +1697,31 @@ postgresPlanForeignModify(PlannerInfo *root,
 			break;
 	}
 
+	/*
+	 * Rows can be inserted in batches only if nothing needs to be known
+	 * about each of them as soon as it is inserted: there must be no
+	 * RETURNING, which local AFTER ROW triggers also need, no WITH CHECK
+	 * OPTION, and every row must be counted as inserted, which excludes ON
+	 * CONFLICT DO NOTHING.  AFTER STATEMENT triggers would run before the
+	 * last batch is sent.  The VALUES list of the statement is then the last
+	 * thing in it, which build_batch_insert_sql relies on.
+	 */
+	if (operation == CMD_INSERT && targetAttrs != NIL && !doNothing &&
+		retrieved_attrs == NIL && plan->withCheckOptionLists == NIL &&
+		!(rel->trigdesc && rel->trigdesc->trig_insert_after_statement))
+		batch_size = get_batch_size_option(rel);
+
 	heap_close(rel, NoLock);
 
 	/*
 	 * Build the fdw_private list that will be available to the executor.
 	 * Items in the list must match enum FdwModifyPrivateIndex, above.
 	 */
-	return list_make4(makeString(sql.data),
+	return list_make5(makeString(sql.data),
 					  targetAttrs,
 					  makeInteger((retrieved_attrs != NIL)),
-					  retrieved_attrs);
+					  retrieved_attrs,
+					  makeInteger(batch_size));
 }
 
 /*
@@ -1699,7 +1771,7 @@ postgresBeginForeignModify(ModifyTableState *mtstate,
 	user = GetUserMapping(userid, table->serverid);
 
 	/* Open connection; report that we'll create a prepared statement. */
-	fmstate->conn = GetConnection(user, true);
+	fmstate->conn = GetConnection(user, true, &fmstate->conn_state);
 	fmstate->p_name = NULL;		/* prepared statement not made yet */
 
 	/* Deconstruct fdw_private data. */
@@ -1711,6 +1783,8 @@ postgresBeginForeignModify(ModifyTableState *mtstate,
 											 FdwModifyPrivateHasReturning));
 	fmstate->retrieved_attrs = (List *) list_nth(fdw_private,
 												 FdwModifyPrivateRetrievedAttrs);
+	fmstate->batch_size = intVal(list_nth(fdw_private,
+										  FdwModifyPrivateBatchSize));
 
 	/* Create context for per-tuple temp workspace. */
 	fmstate->temp_cxt = AllocSetContextCreate(estate->es_query_cxt,
@@ -1760,6 +1834,24 @@ postgresBeginForeignModify(ModifyTableState *mtstate,
 
 	Assert(fmstate->p_nums <= n_params);
 
+	/*
+	 * Set up for collecting rows to insert, if they go in batches.  libpq
+	 * can't send more than 65535 parameters with a statement.
+	 */
+	if (fmstate->batch_size > 1)
+		fmstate->batch_size = Min(fmstate->batch_size,
+								  65535 / fmstate->p_nums);
+	if (fmstate->batch_size > 1)
+	{
+		fmstate->batch_values = (const char **)
+			palloc(sizeof(char *) * fmstate->batch_size * fmstate->p_nums);
+		fmstate->batch_cxt = AllocSetContextCreate(estate->es_query_cxt,
+												   "postgres_fdw batch data",
+												   ALLOCSET_DEFAULT_SIZES);
+		fmstate->batch_query = build_batch_insert_sql(fmstate,
+													  fmstate->batch_size);
+	}
+
 	resultRelInfo->ri_FdwState = fmstate;
 }
 
@@ -1778,6 +1870,37 @@ postgresExecForeignInsert(EState *estate,
 	PGresult   *res;
 	int			n_rows;
 
+	/* The connection may be busy with a FETCH of some scan */
+	process_pending_request(fmstate->conn_state);
+
+	/*
+	 * If rows are inserted in batches, just add this one to the current
+	 * batch, and send the batch once it is full.  The row is reported as
+	 * inserted right away.
+	 */
+	if (fmstate->batch_size > 1)
+	{
+		MemoryContext oldcontext;
+		const char **values;
+		int			i;
+
+		p_values = convert_prep_stmt_params(fmstate, NULL, slot);
+
+		values = fmstate->batch_values + fmstate->num_batched * fmstate->p_nums;
+		oldcontext = MemoryContextSwitchTo(fmstate->batch_cxt);
+		for (i = 0; i < fmstate->p_nums; i++)
+			values[i] = p_values[i] ? pstrdup(p_values[i]) : NULL;
+		MemoryContextSwitchTo(oldcontext);
+		fmstate->num_batched++;
+
+		MemoryContextReset(fmstate->temp_cxt);
+
+		if (fmstate->num_batched == fmstate->batch_size)
+			execute_foreign_batch(fmstate);
+
+		return slot;
+	}
+
 	/* Set up the prepared statement on the remote server, if we didn't yet */
 	if (!fmstate->p_name)
 		prepare_foreign_modify(fmstate);
@@ -1844,6 +1967,9 @@ postgresExecForeignUpdate(EState *estate,
 	PGresult   *res;
 	int			n_rows;
 
+	/* The connection may be busy with a FETCH of some scan */
+	process_pending_request(fmstate->conn_state);
+
 	/* Set up the prepared statement on the remote server, if we didn't yet */
 	if (!fmstate->p_name)
 		prepare_foreign_modify(fmstate);
@@ -1920,6 +2046,9 @@ postgresExecForeignDelete(EState *estate,
 	PGresult   *res;
 	int			n_rows;
 
+	/* The connection may be busy with a FETCH of some scan */
+	process_pending_request(fmstate->conn_state);
+
 	/* Set up the prepared statement on the remote server, if we didn't yet */
 	if (!fmstate->p_name)
 		prepare_foreign_modify(fmstate);
@@ -1993,6 +2122,12 @@ postgresEndForeignModify(EState *estate,
 	if (fmstate == NULL)
 		return;
 
+	process_pending_request(fmstate->conn_state);
+
+	/* Insert the rows of the last, partial batch */
+	if (fmstate->num_batched > 0)
+		execute_foreign_batch(fmstate);
+
 	/* If we created a prepared statement, destroy it */
 	if (fmstate->p_name)
 	{
@@ -2302,7 +2437,7 @@ postgresBeginDirectModify(ForeignScanState *node, int eflags)
 	 * Get connection to the foreign server.  Connection manager will
 	 * establish new connection if necessary.
 	 */
-	dmstate->conn = GetConnection(user, false);
+	dmstate->conn = GetConnection(user, false, &dmstate->conn_state);
 
 	/* Initialize state variable */
 	dmstate->num_tuples = -1;	/* -1 means not set yet */
@@ -2456,8 +2591,12 @@ postgresExplainForeignModify(ModifyTableState *mtstate,
 	{
 		char	   *sql = strVal(list_nth(fdw_private,
 										  FdwModifyPrivateUpdateSql));
+		int			batch_size = intVal(list_nth(fdw_private,
+												 FdwModifyPrivateBatchSize));
 
 		ExplainPropertyText("Remote SQL", sql, es);
+		if (batch_size > 1)
+			ExplainPropertyInteger("Batch Size", batch_size, es);
 	}
 }
 
@@ -2563,7 +2702,7 @@ estimate_path_cost_size(PlannerInfo *root,
 								&retrieved_attrs, NULL);
 
 		/* Get the remote estimate */
-		conn = GetConnection(fpinfo->user, false);
+		conn = GetConnection(fpinfo->user, false, NULL);
 		get_remote_estimate(sql.data, conn, &rows, &width,
 							&startup_cost, &total_cost);
 		ReleaseConnection(conn);
@@ -2945,6 +3084,9 @@ create_cursor(ForeignScanState *node)
 		MemoryContextSwitchTo(oldcontext);
 	}
 
+	/* The connection may be busy with a FETCH of some other scan */
+	process_pending_request(fsstate->conn_state);
+
 	/* Construct the DECLARE CURSOR command */
 	initStringInfo(&buf);
 	appendStringInfo(&buf, "DECLARE c%u CURSOR FOR\n%s",
@@ -3010,13 +3152,38 @@ fetch_more_data(ForeignScanState *node)
 		int			numrows;
 		int			i;
 
-		snprintf(sql, sizeof(sql), "FETCH %d FROM c%u",
-				 fsstate->fetch_size, fsstate->cursor_number);
+		/*
+		 * If we sent the FETCH already, its result may have been read while
+		 * somebody else needed the connection, or we wait for it now.  A
+		 * subtransaction abort may have cancelled it meanwhile.
+		 */
+		if (fsstate->async_pending)
+		{
+			if (fsstate->conn_state->pending_scan != node)
+				ereport(ERROR,
+						(errcode(ERRCODE_FDW_ERROR),
+						 errmsg("fetch from remote cursor was cancelled by a subtransaction abort")));
+			process_pending_request(fsstate->conn_state);
+		}
 
-		res = pgfdw_exec_query(conn, sql);
-		/* On error, report the original query, not the FETCH. */
-		if (PQresultStatus(res) != PGRES_TUPLES_OK)
-			pgfdw_report_error(ERROR, res, conn, false, fsstate->query);
+		if (fsstate->async_result)
+		{
+			res = fsstate->async_result;
+			fsstate->async_result = NULL;
+		}
+		else
+		{
+			/* The connection may be busy with a FETCH of some other scan */
+			process_pending_request(fsstate->conn_state);
+
+			snprintf(sql, sizeof(sql), "FETCH %d FROM c%u",
+					 fsstate->fetch_size, fsstate->cursor_number);
+
+			res = pgfdw_exec_query(conn, sql);
+			/* On error, report the original query, not the FETCH. */
+			if (PQresultStatus(res) != PGRES_TUPLES_OK)
+				pgfdw_report_error(ERROR, res, conn, false, fsstate->query);
+		}
 
 		/* Convert the data into HeapTuples */
 		numrows = PQntuples(res);
@@ -3056,6 +3223,91 @@ fetch_more_data(ForeignScanState *node)
 	PG_END_TRY();
 
 	MemoryContextSwitchTo(oldcontext);
+
+	/* Have the remote server work on the next batch while we use this one */
+	if (fsstate->async_capable && !fsstate->eof_reached)
+		fetch_more_data_begin(node);
+}
+
+/*
+ * Send a FETCH for the next batch of rows of node's cursor, without waiting
+ * for the result; fetch_more_data reads it when the rows are needed.
+ */
+static void
+fetch_more_data_begin(ForeignScanState *node)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	char		sql[64];
+
+	Assert(!fsstate->async_pending && fsstate->async_result == NULL);
+
+	/* The connection may be busy with a FETCH of some other scan */
+	process_pending_request(fsstate->conn_state);
+
+	snprintf(sql, sizeof(sql), "FETCH %d FROM c%u",
+			 fsstate->fetch_size, fsstate->cursor_number);
+
+	if (!PQsendQuery(fsstate->conn, sql))
+		pgfdw_report_error(ERROR, NULL, fsstate->conn, false, fsstate->query);
+
+	fsstate->async_pending = true;
+	fsstate->conn_state->pending_scan = node;
+}
+
+/*
+ * Read the result of the FETCH in progress on a connection, if any, and
+ * keep it for the scan that sent it.
+ */
+void
+process_pending_request(PgFdwConnState *state)
+{
+	ForeignScanState *node = state->pending_scan;
+	PgFdwScanState *fsstate;
+	PGresult   *res;
+
+	if (node == NULL)
+		return;
+
+	fsstate = (PgFdwScanState *) node->fdw_state;
+	Assert(fsstate->async_pending && fsstate->async_result == NULL);
+
+	state->pending_scan = NULL;
+	fsstate->async_pending = false;
+
+	/*
+	 * We don't use a PG_TRY block here, so be careful not to throw error
+	 * without releasing the PGresult.
+	 */
+	res = pgfdw_get_result(fsstate->conn, fsstate->query);
+	/* On error, report the original query, not the FETCH. */
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+		pgfdw_report_error(ERROR, res, fsstate->conn, true, fsstate->query);
+
+	fsstate->async_result = res;
+}
+
+/*
+ * Forget about a FETCH node's cursor sent ahead, waiting for it to complete
+ * if needed.  Returns whether there was one, that is, whether the cursor is
+ * past the rows we have.
+ */
+static bool
+discard_pending_fetch(ForeignScanState *node)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	bool		found = fsstate->async_pending || fsstate->async_result;
+
+	if (fsstate->async_pending && fsstate->conn_state->pending_scan == node)
+		process_pending_request(fsstate->conn_state);
+	fsstate->async_pending = false;
+
+	if (fsstate->async_result)
+	{
+		PQclear(fsstate->async_result);
+		fsstate->async_result = NULL;
+	}
+
+	return found;
 }
 
 /*
@@ -3138,8 +3390,12 @@ prepare_foreign_modify(PgFdwModifyState *fmstate)
 {
 	char		prep_name[NAMEDATALEN];
 	char	   *p_name;
+	const char *query;
 	PGresult   *res;
 
+	/* When inserting in batches, the statement inserts a full batch */
+	query = fmstate->batch_query ? fmstate->batch_query : fmstate->query;
+
 	/* Construct name we'll use for the prepared statement. */
 	snprintf(prep_name, sizeof(prep_name), "pgsql_fdw_prep_%u",
 			 GetPrepStmtNumber(fmstate->conn));
@@ -3154,10 +3410,10 @@ prepare_foreign_modify(PgFdwModifyState *fmstate)
 	 */
 	if (!PQsendPrepare(fmstate->conn,
 					   p_name,
-					   fmstate->query,
+					   query,
 					   0,
 					   NULL))
-		pgfdw_report_error(ERROR, NULL, fmstate->conn, false, fmstate->query);
+		pgfdw_report_error(ERROR, NULL, fmstate->conn, false, query);
 
 	/*
 	 * Get the result, and check for success.
@@ -3165,15 +3421,111 @@ prepare_foreign_modify(PgFdwModifyState *fmstate)
 	 * We don't use a PG_TRY block here, so be careful not to throw error
 	 * without releasing the PGresult.
 	 */
-	res = pgfdw_get_result(fmstate->conn, fmstate->query);
+	res = pgfdw_get_result(fmstate->conn, query);
 	if (PQresultStatus(res) != PGRES_COMMAND_OK)
-		pgfdw_report_error(ERROR, res, fmstate->conn, true, fmstate->query);
+		pgfdw_report_error(ERROR, res, fmstate->conn, true, query);
 	PQclear(res);
 
 	/* This action shows that the prepare has been done. */
 	fmstate->p_name = p_name;
 }
 
+/*
+ * build_batch_insert_sql
+ *		Construct the INSERT statement for nrows rows from the one for a
+ *		single row
+ *
+ * postgresPlanForeignModify made sure that the VALUES list is the last
+ * thing in the statement, so the other rows are simply appended to it.
+ */
+static char *
+build_batch_insert_sql(PgFdwModifyState *fmstate, int nrows)
+{
+	StringInfoData sql;
+	int			pindex = fmstate->p_nums + 1;
+	int			i,
+				j;
+
+	initStringInfo(&sql);
+	appendStringInfoString(&sql, fmstate->query);
+
+	for (i = 1; i < nrows; i++)
+	{
+		appendStringInfoString(&sql, ", (");
+		for (j = 0; j < fmstate->p_nums; j++)
+		{
+			if (j > 0)
+				appendStringInfoString(&sql, ", ");
+			appendStringInfo(&sql, "$%d", pindex);
+			pindex++;
+		}
+		appendStringInfoChar(&sql, ')');
+	}
+
+	return sql.data;
+}
+
+/*
+ * execute_foreign_batch
+ *		Insert the rows collected by postgresExecForeignInsert
+ *
+ * A full batch is inserted with the prepared statement; the last batch of
+ * the command, which usually isn't, with a statement of its own.
+ */
+static void
+execute_foreign_batch(PgFdwModifyState *fmstate)
+{
+	int			nrows = fmstate->num_batched;
+	int			nparams = nrows * fmstate->p_nums;
+	char	   *sql;
+	PGresult   *res;
+
+	Assert(nrows > 0);
+
+	if (nrows == fmstate->batch_size)
+	{
+		/* Set up the prepared statement, if we didn't yet */
+		if (!fmstate->p_name)
+			prepare_foreign_modify(fmstate);
+
+		sql = fmstate->batch_query;
+		if (!PQsendQueryPrepared(fmstate->conn,
+								 fmstate->p_name,
+								 nparams,
+								 fmstate->batch_values,
+								 NULL,
+								 NULL,
+								 0))
+			pgfdw_report_error(ERROR, NULL, fmstate->conn, false, sql);
+	}
+	else
+	{
+		MemoryContext oldcontext;
+
+		oldcontext = MemoryContextSwitchTo(fmstate->batch_cxt);
+		sql = build_batch_insert_sql(fmstate, nrows);
+		MemoryContextSwitchTo(oldcontext);
+
+		if (!PQsendQueryParams(fmstate->conn, sql, nparams,
+							   NULL, fmstate->batch_values, NULL, NULL, 0))
+			pgfdw_report_error(ERROR, NULL, fmstate->conn, false, sql);
+	}
+
+	/*
+	 * Get the result, and check for success.
+	 *
+	 * We don't use a PG_TRY block here, so be careful not to throw error
+	 * without releasing the PGresult.
+	 */
+	res = pgfdw_get_result(fmstate->conn, sql);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pgfdw_report_error(ERROR, res, fmstate->conn, true, sql);
+	PQclear(res);
+
+	fmstate->num_batched = 0;
+	MemoryContextReset(fmstate->batch_cxt);
+}
+
 /*
  * convert_prep_stmt_params
  *		Create array of text strings representing parameter values
@@ -3298,6 +3650,9 @@ execute_dml_stmt(ForeignScanState *node)
 	 * the desired result.  This allows us to avoid assuming that the remote
 	 * server has the same OIDs we do for the parameters' types.
 	 */
+	/* The connection may be busy with a FETCH of some scan */
+	process_pending_request(dmstate->conn_state);
+
 	if (!PQsendQueryParams(dmstate->conn, dmstate->query, numParams,
 						   NULL, values, NULL, NULL, 0))
 		pgfdw_report_error(ERROR, NULL, dmstate->conn, false, dmstate->query);
@@ -3500,7 +3855,7 @@ postgresAnalyzeForeignTable(Relation relation,
 	 */
 	table = GetForeignTable(RelationGetRelid(relation));
 	user = GetUserMapping(relation->rd_rel->relowner, table->serverid);
-	conn = GetConnection(user, false);
+	conn = GetConnection(user, false, NULL);
 
 	/*
 	 * Construct command to get page count for relation.
@@ -3590,7 +3945,7 @@ postgresAcquireSampleRowsFunc(Relation relation, int elevel,
 	table = GetForeignTable(RelationGetRelid(relation));
 	server = GetForeignServer(table->serverid);
 	user = GetUserMapping(relation->rd_rel->relowner, table->serverid);
-	conn = GetConnection(user, false);
+	conn = GetConnection(user, false, NULL);
 
 	/*
 	 * Construct cursor that retrieves whole rows from remote.
@@ -3813,7 +4168,7 @@ postgresImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
 	 */
 	server = GetForeignServer(serverOid);
 	mapping = GetUserMapping(GetUserId(), server->serverid);
-	conn = GetConnection(mapping, false);
+	conn = GetConnection(mapping, false, NULL);
 
 	/* Don't attempt to import collation if remote server hasn't got it */
 	if (PQserverVersion(conn) < 90100)
@@ -4371,6 +4726,8 @@ apply_server_options(PgFdwRelationInfo *fpinfo)
 				ExtractExtensionList(defGetString(def), false);
 		else if (strcmp(def->defname, "fetch_size") == 0)
 			fpinfo->fetch_size = strtol(defGetString(def), NULL, 10);
+		else if (strcmp(def->defname, "async_capable") == 0)
+			fpinfo->async_capable = defGetBoolean(def);
 	}
 }
 
@@ -4392,7 +4749,36 @@ apply_table_options(PgFdwRelationInfo *fpinfo)
 			fpinfo->use_remote_estimate = defGetBoolean(def);
 		else if (strcmp(def->defname, "fetch_size") == 0)
 			fpinfo->fetch_size = strtol(defGetString(def), NULL, 10);
+		else if (strcmp(def->defname, "async_capable") == 0)
+			fpinfo->async_capable = defGetBoolean(def);
+	}
+}
+
+/*
+ * Determine the batch size for inserting into a foreign table.  The option
+ * specified on the table overrides the one of the server.
+ */
+static int
+get_batch_size_option(Relation rel)
+{
+	ForeignTable *table = GetForeignTable(RelationGetRelid(rel));
+	ForeignServer *server = GetForeignServer(table->serverid);
+	List	   *options;
+	ListCell   *lc;
+	int			batch_size = 1;
+
+	options = list_concat(list_copy(server->options),
+						  list_copy(table->options));
+
+	foreach(lc, options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "batch_size") == 0)
+			batch_size = strtol(defGetString(def), NULL, 10);
 	}
+
+	return batch_size;
 }
 
 /*
@@ -4426,6 +4812,7 @@ merge_fdw_options(PgFdwRelationInfo *fpinfo,
 	fpinfo->shippable_extensions = fpinfo_o->shippable_extensions;
 	fpinfo->use_remote_estimate = fpinfo_o->use_remote_estimate;
 	fpinfo->fetch_size = fpinfo_o->fetch_size;
+	fpinfo->async_capable = fpinfo_o->async_capable;
 
 	/* Merge the table level options from either side of the join. */
 	if (fpinfo_i)
@@ -4447,6 +4834,10 @@ merge_fdw_options(PgFdwRelationInfo *fpinfo,
 		 * relation sizes.
 		 */
 		fpinfo->fetch_size = Max(fpinfo_o->fetch_size, fpinfo_i->fetch_size);
+
+		/* Fetch ahead if either side of the join is allowed to */
+		fpinfo->async_capable = fpinfo_o->async_capable ||
+			fpinfo_i->async_capable;
 	}
 }
 
@@ -19,6 +19,7 @@
 #include "utils/relcache.h"
 
 #include "libpq-fe.h"
+#include "nodes/execnodes.h"
 
 /*
  * FDW-specific planner information kept in RelOptInfo.fdw_private for a
@@ -77,6 +78,7 @@ typedef struct PgFdwRelationInfo
 	UserMapping *user;			/* only set in use_remote_estimate mode */
 
 	int			fetch_size;		/* fetch size for this remote table */
+	bool		async_capable;	/* may scans start fetching asynchronously? */
 
 	/*
 	 * Name of the relation while EXPLAINing ForeignScan. It is used for join
@@ -110,12 +112,28 @@ typedef struct PgFdwRelationInfo
 	int			relation_index;
 } PgFdwRelationInfo;
 
+/*
+ * Extra control information relating to a connection, kept by connection.c
+ * for postgres_fdw.c.
+ *
+ * At most one command can be in progress on a connection.  A foreign scan
+ * that sent a FETCH without waiting for its result registers itself here,
+ * and anybody else wanting to use the connection must first have the result
+ * read by process_pending_request().
+ */
+typedef struct PgFdwConnState
+{
+	ForeignScanState *pending_scan; /* scan whose FETCH is in progress */
+} PgFdwConnState;
+
 /* in postgres_fdw.c */
 extern int	set_transmission_modes(void);
 extern void reset_transmission_modes(int nestlevel);
+extern void process_pending_request(PgFdwConnState *state);
 
 /* in connection.c */
-extern PGconn *GetConnection(UserMapping *user, bool will_prep_stmt);
+extern PGconn *GetConnection(UserMapping *user, bool will_prep_stmt,
+			  PgFdwConnState **state);
 extern void ReleaseConnection(PGconn *conn);
 extern unsigned int GetCursorNumber(PGconn *conn);
 extern unsigned int GetPrepStmtNumber(PGconn *conn);
@@ -22,6 +22,7 @@
 #include "tcop/pquery.h"
 #include "utils/lsyscache.h"
 #ifdef PGXC
+#include "pgxc/execRemote.h"
 #include "pgxc/pgxc.h"
 #endif
 #include "utils/memdebug.h"
@@ -67,8 +68,27 @@ typedef struct
 	int			nattrs;
 	PrinttupAttrInfo *myinfo;	/* Cached info about each attr */
 	MemoryContext tmpcontext;	/* Memory context for per-row workspace */
+#ifdef PGXC
+	bool		anybinary;		/* any attribute in binary format? */
+	int			batchsize;		/* max rows per DataRow batch, 0 if disabled */
+	int			batchrows;		/* number of rows pending in the batch */
+	int		   *batchoffs;		/* offsets of the pending rows in batch */
+	StringInfoData batch;		/* pending DataRow message bodies */
+#endif
 } DR_printtup;
 
+#ifdef PGXC
+/*
+ * Flush a DataRow batch once it grows that large, even if it is not full yet,
+ * to bound memory usage and latency with wide rows.
+ */
+#define DATAROW_BATCH_MAXBYTES	(64 * 1024)
+
+static void printtup_send_datarow(DR_printtup *myState, const char *data,
+					  int len);
+static void printtup_flush_batch(DR_printtup *myState);
+#endif
+
 /* ----------------
  *		Initialize: create a DestReceiver for printtup
  * ----------------
@@ -94,6 +114,11 @@ printtup_create_DR(CommandDest dest)
 	self->nattrs = 0;
 	self->myinfo = NULL;
 	self->tmpcontext = NULL;
+#ifdef PGXC
+	self->batchsize = 0;
+	self->batchrows = 0;
+	self->batchoffs = NULL;
+#endif
 
 	return (DestReceiver *) self;
 }
@@ -141,6 +166,23 @@ printtup_startup(DestReceiver *self, int operation, TupleDesc typeinfo)
 												"printtup",
 												ALLOCSET_DEFAULT_SIZES);
 
+#ifdef PGXC
+	/*
+	 * Rows sent to another node of the cluster may be packed into DataRow
+	 * batches, the receiving side unpacks them in get_message().  Regular
+	 * clients always get one DataRow message per row.
+	 */
+	if (PGXLRemoteBatchSize > 1 &&
+		PG_PROTOCOL_MAJOR(FrontendProtocol) >= 3 &&
+		(IsConnFromCoord() || IsConnFromDatanode()))
+	{
+		myState->batchsize = PGXLRemoteBatchSize;
+		myState->batchrows = 0;
+		myState->batchoffs = (int *) palloc(myState->batchsize * sizeof(int));
+		initStringInfo(&myState->batch);
+	}
+#endif
+
 	if (PG_PROTOCOL_MAJOR(FrontendProtocol) < 3)
 	{
 		/*
@@ -276,6 +318,9 @@ printtup_prepare_info(DR_printtup *myState, TupleDesc typeinfo, int numAttrs)
 
 	myState->attrinfo = typeinfo;
 	myState->nattrs = numAttrs;
+#ifdef PGXC
+	myState->anybinary = false;
+#endif
 	if (numAttrs <= 0)
 		return;
 
@@ -301,6 +346,9 @@ printtup_prepare_info(DR_printtup *myState, TupleDesc typeinfo, int numAttrs)
 									&thisState->typsend,
 									&thisState->typisvarlena);
 			fmgr_info(thisState->typsend, &thisState->finfo);
+#ifdef PGXC
+			myState->anybinary = true;
+#endif
 		}
 		else
 			ereport(ERROR,
@@ -322,11 +370,16 @@ printtup(TupleTableSlot *slot, DestReceiver *self)
 	StringInfoData buf;
 	int			natts = typeinfo->natts;
 	int			i;
-	bool		binary = false;
 
 	/* Set or update my derived attribute info, if needed */
 	if (myState->attrinfo != typeinfo || myState->nattrs != natts)
+	{
+#ifdef PGXC
+		/* Pending rows are encoded according to the old descriptor */
+		printtup_flush_batch(myState);
+#endif
 		printtup_prepare_info(myState, typeinfo, natts);
+	}
 
 #ifdef PGXC
 	/*
@@ -335,21 +388,15 @@ printtup(TupleTableSlot *slot, DestReceiver *self)
 	 * then we must decode the datarow and send every attribute in the format
 	 * that the client has asked for. Otherwise its ok to just forward the
 	 * datarow as it is
-	 */
-	for (i = 0; i < natts; ++i)
-	{
-		PrinttupAttrInfo *thisState = myState->myinfo + i;
-		if (thisState->format != 0)
-			binary = true;
-	}
-	/*
+	 *
 	 * If we are having DataRow-based tuple we do not have to encode attribute
 	 * values, just send over the DataRow message as we received it from the
 	 * Datanode
 	 */
-	if (slot->tts_datarow && !binary)
+	if (slot->tts_datarow && !myState->anybinary)
 	{
-		pq_putmessage('D', slot->tts_datarow->msg, slot->tts_datarow->msglen);
+		printtup_send_datarow(myState, slot->tts_datarow->msg,
+							  slot->tts_datarow->msglen);
 		return true;
 	}
 #endif
@@ -412,7 +459,11 @@ printtup(TupleTableSlot *slot, DestReceiver *self)
 		}
 	}
 
+#ifdef PGXC
+	printtup_send_datarow(myState, buf.data, buf.len);
+#else
 	pq_endmessage(&buf);
+#endif
 
 	/* Return to caller's context, and flush row's temporary memory */
 	MemoryContextSwitchTo(oldcontext);
@@ -421,6 +472,128 @@ printtup(TupleTableSlot *slot, DestReceiver *self)
 	return true;
 }
 
+#ifdef PGXC
+/* ----------------
+ *		printtup_send_datarow --- send or batch up a DataRow message body
+ * ----------------
+ */
+static void
+printtup_send_datarow(DR_printtup *myState, const char *data, int len)
+{
+	uint16		n16 = 0;
+
+	if (myState->batchsize == 0)
+	{
+		pq_putmessage('D', data, len);
+		return;
+	}
+
+	/*
+	 * All rows of a batch share the attribute count, so anything that does
+	 * not match the current descriptor is sent on its own.
+	 */
+	if (len >= 2)
+		memcpy(&n16, data, 2);
+	if (len < 2 || ntohs(n16) != myState->nattrs)
+	{
+		printtup_flush_batch(myState);
+		pq_putmessage('D', data, len);
+		return;
+	}
+
+	myState->batchoffs[myState->batchrows++] = myState->batch.len;
+	appendBinaryStringInfo(&myState->batch, data, len);
+
+	if (myState->batchrows >= myState->batchsize ||
+		myState->batch.len >= DATAROW_BATCH_MAXBYTES)
+		printtup_flush_batch(myState);
+}
+
+/* ----------------
+ *		printtup_flush_batch --- send pending rows as a DataRow batch
+ *
+ * The batch ('B') message carries the attribute count (int16) and the row
+ * count (int32), followed by the columns one after another.  Each column is
+ * a null bitmap with a bit per row, set if the value is NULL, followed by
+ * the non-NULL values of the column in DataRow format (int32 length and the
+ * value bytes).
+ * ----------------
+ */
+static void
+printtup_flush_batch(DR_printtup *myState)
+{
+	int			nrows = myState->batchrows;
+	int			natts = myState->nattrs;
+	char	   *rows = myState->batch.data;
+	int		   *cursors;
+	bits8	   *nulls;
+	int			nullslen;
+	StringInfoData buf;
+	int			i;
+	int			r;
+
+	if (nrows == 0)
+		return;
+
+	/* Not worth it for a single row */
+	if (nrows == 1)
+	{
+		pq_putmessage('D', rows, myState->batch.len);
+		myState->batchrows = 0;
+		resetStringInfo(&myState->batch);
+		return;
+	}
+
+	nullslen = (nrows + 7) / 8;
+	nulls = (bits8 *) palloc(nullslen);
+	cursors = (int *) palloc(nrows * sizeof(int));
+	/* Skip the attribute count of each row */
+	for (r = 0; r < nrows; r++)
+		cursors[r] = myState->batchoffs[r] + 2;
+
+	pq_beginmessage(&buf, 'B');
+	pq_sendint(&buf, natts, 2);
+	pq_sendint(&buf, nrows, 4);
+
+	for (i = 0; i < natts; i++)
+	{
+		uint32		n32;
+
+		memset(nulls, 0, nullslen);
+		for (r = 0; r < nrows; r++)
+		{
+			memcpy(&n32, rows + cursors[r], 4);
+			if ((int32) ntohl(n32) == -1)
+				nulls[r >> 3] |= 1 << (r & 7);
+		}
+		pq_sendbytes(&buf, (char *) nulls, nullslen);
+
+		for (r = 0; r < nrows; r++)
+		{
+			int32		vlen;
+
+			memcpy(&n32, rows + cursors[r], 4);
+			vlen = (int32) ntohl(n32);
+			if (vlen == -1)
+			{
+				cursors[r] += 4;
+				continue;
+			}
+			pq_sendbytes(&buf, rows + cursors[r], 4 + vlen);
+			cursors[r] += 4 + vlen;
+		}
+	}
+
+	pq_endmessage(&buf);
+	pfree(cursors);
+	pfree(nulls);
+
+	myState->batchrows = 0;
+	resetStringInfo(&myState->batch);
+}
+#endif
+
+
 /* ----------------
  *		printtup_20 --- print a tuple in protocol 2.0
  * ----------------
@@ -508,6 +681,17 @@ printtup_shutdown(DestReceiver *self)
 {
 	DR_printtup *myState = (DR_printtup *) self;
 
+#ifdef PGXC
+	if (myState->batchsize > 0)
+	{
+		printtup_flush_batch(myState);
+		pfree(myState->batchoffs);
+		pfree(myState->batch.data);
+		myState->batchoffs = NULL;
+		myState->batchsize = 0;
+	}
+#endif
+
 	if (myState->myinfo)
 		pfree(myState->myinfo);
 	myState->myinfo = NULL;
@@ -39,6 +39,13 @@ int			gin_pending_list_limit = 0;
 #define GIN_PAGE_FREESIZE \
 	( BLCKSZ - MAXALIGN(SizeOfPageHeaderData) - MAXALIGN(sizeof(GinPageOpaqueData)) )
 
+/*
+ * While autovacuum is running, an inserter that finds the pending list over
+ * its limit asks autovacuum to clean it up, and only cleans it up itself
+ * once the list has grown to this many times the limit.
+ */
+#define GIN_PENDING_LIST_INLINE_FACTOR	4
+
 typedef struct KeyArray
 {
 	Datum	   *keys;			/* expansible array */
@@ -230,6 +237,7 @@ ginHeapTupleFastInsert(GinState *ginstate, GinTupleCollector *collector)
 	ginxlogUpdateMeta data;
 	bool		separateList = false;
 	bool		needCleanup = false;
+	bool		inlineCleanup = false;
 	int			cleanupSize;
 	bool		needWal;
 
@@ -430,18 +438,31 @@ ginHeapTupleFastInsert(GinState *ginstate, GinTupleCollector *collector)
 	 * while pending list is still small enough to fit into
 	 * gin_pending_list_limit.
 	 *
+	 * If autovacuum is running, leave the cleanup to it rather than making
+	 * this insert wait for it, unless it has fallen far behind.  We ask
+	 * again each time the list grows by a page, in case the request was
+	 * dropped.
+	 *
 	 * ginInsertCleanup() should not be called inside our CRIT_SECTION.
 	 */
 	cleanupSize = GinGetPendingListCleanupSize(index);
 	if (metadata->nPendingPages * GIN_PAGE_FREESIZE > cleanupSize * 1024L)
+	{
 		needCleanup = true;
+		inlineCleanup = !AutoVacuumingActive() ||
+			metadata->nPendingPages * GIN_PAGE_FREESIZE >
+			GIN_PENDING_LIST_INLINE_FACTOR * cleanupSize * 1024L;
+	}
 
 	UnlockReleaseBuffer(metabuffer);
 
 	END_CRIT_SECTION();
 
-	if (needCleanup)
+	if (needCleanup && inlineCleanup)
 		ginInsertCleanup(ginstate, false, true, NULL);
+	else if (needCleanup && separateList)
+		AutoVacuumRequestWork(AVW_GINCleanPendingList,
+							  RelationGetRelid(index), InvalidBlockNumber);
 }
 
 /*
@@ -34,6 +34,13 @@
  *	  the POSTGRES heap access method used for all POSTGRES
  *	  relations.
  *
+ *	  The heap is the only table storage format.  Callers above the
+ *	  executor's scan nodes reference heap tuples, buffers and visibility
+ *	  directly, so there is no table access method interface through
+ *	  which another format, such as columnar stripes, could be plugged
+ *	  in.  A scan still reads every column of the pages it visits, and
+ *	  only deforming stops at the last attribute the plan needs.
+ *
  *-------------------------------------------------------------------------
  */
 #include "postgres.h"
@@ -295,6 +302,7 @@ initscan(HeapScanDesc scan, ScanKey key, bool keep_startblock)
 	}
 
 	scan->rs_numblocks = InvalidBlockNumber;
+	scan->rs_prefetch_upto = InvalidBlockNumber;
 	scan->rs_inited = false;
 	scan->rs_ctup.t_data = NULL;
 	ItemPointerSetInvalid(&scan->rs_ctup.t_self);
@@ -335,8 +343,49 @@ heap_setscanlimits(HeapScanDesc scan, BlockNumber startBlk, BlockNumber numBlks)
 
 	scan->rs_startblock = startBlk;
 	scan->rs_numblocks = numBlks;
+	scan->rs_prefetch_upto = InvalidBlockNumber;
 }
 
+#ifdef USE_PREFETCH
+/*
+ * heap_prefetch_ahead - prefetch the blocks a forward seqscan reads next
+ *
+ * Keep prefetch requests issued for up to seqscan_prefetch_pages blocks past
+ * the given one, so the reads of these are in flight while the current page
+ * is processed. Positions are counted from rs_startblock, since a
+ * synchronized scan wraps around the end of the relation.
+ */
+static void
+heap_prefetch_ahead(HeapScanDesc scan, BlockNumber page)
+{
+	BlockNumber nblocks = scan->rs_nblocks;
+	BlockNumber total;
+	BlockNumber cur;
+	BlockNumber target;
+	BlockNumber pos;
+
+	total = nblocks;
+	if (scan->rs_numblocks != InvalidBlockNumber)
+		total = Min(total, scan->rs_numblocks);
+	if (total == 0)
+		return;
+
+	cur = (page + nblocks - scan->rs_startblock) % nblocks;
+	target = Min(cur + seqscan_prefetch_pages, total - 1);
+
+	pos = scan->rs_prefetch_upto;
+	if (pos == InvalidBlockNumber || pos < cur)
+		pos = cur;
+	while (pos < target)
+	{
+		pos++;
+		PrefetchBuffer(scan->rs_rd, MAIN_FORKNUM,
+					   (scan->rs_startblock + pos) % nblocks);
+	}
+	scan->rs_prefetch_upto = pos;
+}
+#endif							/* USE_PREFETCH */
+
 /*
  * heapgetpage - subroutine for heapgettup()
  *
@@ -372,6 +421,20 @@ heapgetpage(HeapScanDesc scan, BlockNumber page)
 	 */
 	CHECK_FOR_INTERRUPTS();
 
+#ifdef USE_PREFETCH
+
+	/*
+	 * Read ahead if this is the next page of a forward serial scan. Sample
+	 * scans and parallel scans go in an order we can't easily predict.
+	 */
+	if (seqscan_prefetch_pages > 0 &&
+		!scan->rs_samplescan && scan->rs_parallel == NULL &&
+		(scan->rs_cblock == InvalidBlockNumber ?
+		 page == scan->rs_startblock :
+		 page == (scan->rs_cblock + 1) % scan->rs_nblocks))
+		heap_prefetch_ahead(scan, page);
+#endif
+
 	/* read page using selected strategy */
 	scan->rs_cbuf = ReadBufferExtended(scan->rs_rd, MAIN_FORKNUM, page,
 									   RBM_NORMAL, scan->rs_strategy);
@@ -1613,14 +1676,21 @@ heap_endscan(HeapScanDesc scan)
  *		heap_parallelscan_estimate - estimate storage for ParallelHeapScanDesc
  *
  *		Sadly, this doesn't reduce to a constant, because the size required
- *		to serialize the snapshot can vary.
+ *		to serialize the snapshot can vary.  SnapshotAny, which index builds
+ *		use, needs no space at all.
  * ----------------
  */
 Size
 heap_parallelscan_estimate(Snapshot snapshot)
 {
-	return add_size(offsetof(ParallelHeapScanDescData, phs_snapshot_data),
-					EstimateSnapshotSpace(snapshot));
+	Size		sz = offsetof(ParallelHeapScanDescData, phs_snapshot_data);
+
+	if (IsMVCCSnapshot(snapshot))
+		sz = add_size(sz, EstimateSnapshotSpace(snapshot));
+	else
+		Assert(snapshot == SnapshotAny);
+
+	return sz;
 }
 
 /* ----------------
@@ -1644,7 +1714,16 @@ heap_parallelscan_initialize(ParallelHeapScanDesc target, Relation relation,
 	SpinLockInit(&target->phs_mutex);
 	target->phs_cblock = InvalidBlockNumber;
 	target->phs_startblock = InvalidBlockNumber;
-	SerializeSnapshot(snapshot, target->phs_snapshot_data);
+	if (IsMVCCSnapshot(snapshot))
+	{
+		SerializeSnapshot(snapshot, target->phs_snapshot_data);
+		target->phs_snapshot_any = false;
+	}
+	else
+	{
+		Assert(snapshot == SnapshotAny);
+		target->phs_snapshot_any = true;
+	}
 }
 
 /* ----------------
@@ -1659,11 +1738,18 @@ heap_beginscan_parallel(Relation relation, ParallelHeapScanDesc parallel_scan)
 	Snapshot	snapshot;
 
 	Assert(RelationGetRelid(relation) == parallel_scan->phs_relid);
-	snapshot = RestoreSnapshot(parallel_scan->phs_snapshot_data);
-	RegisterSnapshot(snapshot);
+
+	if (!parallel_scan->phs_snapshot_any)
+	{
+		snapshot = RestoreSnapshot(parallel_scan->phs_snapshot_data);
+		RegisterSnapshot(snapshot);
+	}
+	else
+		snapshot = SnapshotAny;
 
 	return heap_beginscan_internal(relation, snapshot, 0, NULL, parallel_scan,
-								   true, true, true, false, false, true);
+								   true, true, true, false, false,
+								   !parallel_scan->phs_snapshot_any);
 }
 
 /* ----------------
@@ -1827,6 +1913,64 @@ heap_getnext(HeapScanDesc scan, ScanDirection direction)
 	return &(scan->rs_ctup);
 }
 
+/*
+ * heap_count_tuples - count the tuples a forward scan would return
+ *
+ * This is for count(*) over a scan without quals, which needs to know how
+ * many tuples there are but not what is in them.  The pages are visited in
+ * the same order as heap_getnext would, and heapgetpage makes its usual
+ * visibility pass over each of them, which boils down to counting the
+ * normal line pointers for pages marked all-visible; no tuple is formed or
+ * returned, however.
+ *
+ * The scan must be in page-at-a-time mode, must not be parallel, and must
+ * not have started yet.  Afterwards it is in the same state as after
+ * heap_getnext has returned NULL.
+ */
+uint64
+heap_count_tuples(HeapScanDesc scan)
+{
+	uint64		ntuples = 0;
+	BlockNumber page;
+	bool		finished;
+
+	Assert(scan->rs_pageatatime);
+	Assert(scan->rs_parallel == NULL);
+	Assert(!scan->rs_inited);
+	Assert(scan->rs_nkeys == 0);
+
+	if (scan->rs_nblocks == 0 || scan->rs_numblocks == 0)
+		return 0;
+
+	page = scan->rs_startblock;
+	do
+	{
+		heapgetpage(scan, page);
+		ntuples += scan->rs_ntuples;
+
+		page++;
+		if (page >= scan->rs_nblocks)
+			page = 0;
+		finished = (page == scan->rs_startblock) ||
+			(scan->rs_numblocks != InvalidBlockNumber ? --scan->rs_numblocks == 0 : false);
+
+		/* as in heapgettup_pagemode */
+		if (scan->rs_syncscan)
+			ss_report_location(scan->rs_rd, page);
+	} while (!finished);
+
+	if (BufferIsValid(scan->rs_cbuf))
+		ReleaseBuffer(scan->rs_cbuf);
+	scan->rs_cbuf = InvalidBuffer;
+	scan->rs_cblock = InvalidBlockNumber;
+	scan->rs_ctup.t_data = NULL;
+
+	if (scan->rs_rd->pgstat_info != NULL)
+		scan->rs_rd->pgstat_info->t_counts.t_tuples_returned += ntuples;
+
+	return ntuples;
+}
+
 /*
  *	heap_fetch		- retrieve tuple with given tid
  *
@@ -2336,6 +2480,7 @@ GetBulkInsertState(void)
 	bistate = (BulkInsertState) palloc(sizeof(BulkInsertStateData));
 	bistate->strategy = GetAccessStrategy(BAS_BULKWRITE);
 	bistate->current_buf = InvalidBuffer;
+	bistate->extend_by = 0;
 	return bistate;
 }
 
@@ -4182,12 +4327,19 @@ l2:
 		 * for index columns. If so, HOT update is possible.
 		 */
 		if (hot_attrs_checked && !bms_overlap(modified_attrs, hot_attrs))
+		{
 			use_hot_update = true;
+			RelationAdjustUpdateFreeSpace(relation, newtupsize, true);
+		}
 	}
 	else
 	{
 		/* Set a hint that the old page could use prune/defrag */
 		PageSetFull(page);
+
+		/* Leave more space for updates if this one could have been HOT */
+		if (hot_attrs_checked && !bms_overlap(modified_attrs, hot_attrs))
+			RelationAdjustUpdateFreeSpace(relation, newtupsize, false);
 	}
 
 	/*
@@ -25,6 +25,13 @@
 #include "storage/smgr.h"
 
 
+/*
+ * Number of times an insert moves on to another page the FSM suggests when
+ * the one it picked is locked by someone else, rather than wait for it.
+ */
+#define MAX_BUSY_PAGES_SKIPPED	4
+
+
 /*
  * RelationPutHeapTuple - place tuple at specified page
  *
@@ -173,6 +180,13 @@ GetVisibilityMapPins(Relation relation, Buffer buffer1, Buffer buffer2,
  * relation extension lock.  Our goal is to pre-extend the relation by an
  * amount which ramps up as the degree of contention ramps up, but limiting
  * the result to some sane overall value.
+ *
+ * Bulk inserts pre-extend even without contention, by an amount that ramps
+ * up with the number of times they have had to extend the relation, so that
+ * a large load takes the extension lock once per batch of pages rather than
+ * once per page.
+ *
+ * The caller must hold the relation extension lock.
  */
 static void
 RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
@@ -187,8 +201,6 @@ RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
 
 	/* Use the length of the lock wait queue to judge how much to extend. */
 	lockWaiters = RelationExtensionLockWaiterCount(relation);
-	if (lockWaiters <= 0)
-		return;
 
 	/*
 	 * It might seem like multiplying the number of lock waiters by as much as
@@ -198,24 +210,37 @@ RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
 	 */
 	extraBlocks = Min(512, lockWaiters * 20);
 
-	while (extraBlocks-- >= 0)
+	if (bistate != NULL)
 	{
-		/* Ouch - an unnecessary lseek() each time through the loop! */
-		buffer = ReadBufferBI(relation, P_NEW, bistate);
+		bistate->extend_by = Min(512, Max(8, bistate->extend_by * 2));
+		extraBlocks = Max(extraBlocks, bistate->extend_by);
+	}
+
+	if (extraBlocks <= 0)
+		return;
 
-		/* Extend by one page. */
-		LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
+	/*
+	 * Write out all the new blocks at once, then initialize them in shared
+	 * buffers one by one.  Like the pages added by ReadBuffer with P_NEW,
+	 * they are not WAL-logged; heap code copes with all-zeroes pages left
+	 * behind by a crash.
+	 */
+	firstBlock = RelationGetNumberOfBlocks(relation);
+	RelationOpenSmgr(relation);
+	smgrzeroextend(relation->rd_smgr, MAIN_FORKNUM, firstBlock, extraBlocks,
+				   false);
+
+	for (blockNum = firstBlock; blockNum < firstBlock + extraBlocks; blockNum++)
+	{
+		buffer = ReadBufferExtended(relation, MAIN_FORKNUM, blockNum,
+									RBM_ZERO_AND_LOCK,
+									bistate ? bistate->strategy : NULL);
 		page = BufferGetPage(buffer);
 		PageInit(page, BufferGetPageSize(buffer), 0);
 		MarkBufferDirty(buffer);
-		blockNum = BufferGetBlockNumber(buffer);
 		freespace = PageGetHeapFreeSpace(page);
 		UnlockReleaseBuffer(buffer);
 
-		/* Remember first block number thus added. */
-		if (firstBlock == InvalidBlockNumber)
-			firstBlock = blockNum;
-
 		/*
 		 * Immediately update the bottom level of the FSM.  This has a good
 		 * chance of making this page visible to other concurrently inserting
@@ -234,7 +259,7 @@ RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
 	 * last block we added as if it were the freespace value for every block
 	 * we added.  That's actually true, because they're all equally empty.
 	 */
-	UpdateFreeSpaceMap(relation, firstBlock, blockNum, freespace);
+	UpdateFreeSpaceMap(relation, firstBlock, blockNum - 1, freespace);
 }
 
 /*
@@ -288,7 +313,9 @@ RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
  *	We always try to avoid filling existing pages further than the fillfactor.
  *	This is OK since this routine is not consulted when updating a tuple and
  *	keeping it on the same page, which is the scenario fillfactor is meant
- *	to reserve space for.
+ *	to reserve space for.  If updates that could have been HOT have recently
+ *	failed to fit on their page, more space than the fillfactor asks for may
+ *	be left free, see RelationAdjustUpdateFreeSpace.
  *
  *	ereport(ERROR) is allowed here, so this routine *must* be called
  *	before any (unlogged) changes are made in buffer pool.
@@ -307,6 +334,7 @@ RelationGetBufferForTuple(Relation relation, Size len,
 	BlockNumber targetBlock,
 				otherBlock;
 	bool		needLock;
+	int			busyPagesSkipped = 0;
 
 	len = MAXALIGN(len);		/* be conservative */
 
@@ -325,6 +353,7 @@ RelationGetBufferForTuple(Relation relation, Size len,
 	/* Compute desired extra freespace due to fillfactor option */
 	saveFreeSpace = RelationGetTargetPageFreeSpace(relation,
 												   HEAP_DEFAULT_FILLFACTOR);
+	saveFreeSpace = Max(saveFreeSpace, relation->rd_updatefreespace);
 
 	if (otherBuffer != InvalidBuffer)
 		otherBlock = BufferGetBlockNumber(otherBuffer);
@@ -396,10 +425,41 @@ loop:
 		if (otherBuffer == InvalidBuffer)
 		{
 			/* easy case */
+			bool		locked = false;
+
 			buffer = ReadBufferBI(relation, targetBlock, bistate);
 			if (PageIsAllVisible(BufferGetPage(buffer)))
 				visibilitymap_pin(relation, targetBlock, vmbuffer);
-			LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
+
+			/*
+			 * Many backends inserting into the same relation tend to pick the
+			 * same page.  If someone else has it locked, ask the FSM for
+			 * another one instead of queueing up behind them; since each FSM
+			 * search moves on to the next suitable slot, concurrent inserters
+			 * spread over different pages this way, and stick to them as
+			 * their cached target.
+			 */
+			if (use_fsm && busyPagesSkipped < MAX_BUSY_PAGES_SKIPPED)
+			{
+				locked = ConditionalLockBuffer(buffer);
+				if (!locked)
+				{
+					BlockNumber nextBlock;
+
+					busyPagesSkipped++;
+					nextBlock = GetPageWithFreeSpace(relation,
+													 len + saveFreeSpace);
+					if (nextBlock != InvalidBlockNumber &&
+						nextBlock != targetBlock)
+					{
+						ReleaseBuffer(buffer);
+						targetBlock = nextBlock;
+						continue;
+					}
+				}
+			}
+			if (!locked)
+				LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
 		}
 		else if (otherBlock == targetBlock)
 		{
@@ -544,6 +604,11 @@ loop:
 			/* Time to bulk-extend. */
 			RelationAddExtraBlocks(relation, bistate);
 		}
+		else if (bistate != NULL)
+		{
+			/* Bulk inserts extend in batches, contended or not. */
+			RelationAddExtraBlocks(relation, bistate);
+		}
 	}
 
 	/*
@@ -611,3 +676,30 @@ loop:
 
 	return buffer;
 }
+
+/*
+ * RelationAdjustUpdateFreeSpace
+ *
+ * Called by heap_update for updates that do not modify any indexed column,
+ * and thus could be HOT if the new tuple version fits on the page of the
+ * old one.  If it did not fit, the free space RelationGetBufferForTuple
+ * leaves on the pages it fills grows by the size of that version, up to
+ * what a fillfactor of HEAP_MIN_ADAPTIVE_FILLFACTOR would leave.  Every
+ * update that does fit lets it decay a little, so the pages of a relation
+ * whose rows are updated in place end up about as full as its updates
+ * allow, and those of a relation that is no longer updated fill up again.
+ *
+ * This is a per-backend estimate kept in the relcache entry, and it only
+ * ever adds to what the fillfactor reserves.
+ */
+void
+RelationAdjustUpdateFreeSpace(Relation relation, Size len, bool fits)
+{
+	Size		maxFreeSpace = BLCKSZ * (100 - HEAP_MIN_ADAPTIVE_FILLFACTOR) / 100;
+
+	if (!fits)
+		relation->rd_updatefreespace = Min(relation->rd_updatefreespace + MAXALIGN(len),
+										   maxFreeSpace);
+	else
+		relation->rd_updatefreespace -= relation->rd_updatefreespace / 32;
+}
@@ -55,6 +55,15 @@
  * This code isn't concerned about the FSM at all. The caller is responsible
  * for initializing that.
  *
+ * A big enough non-unique index can be built in parallel.  The leader and
+ * the workers scan the heap together, each getting a share of the pages
+ * from a parallel heap scan, and each sorts its share in its own tuplesort.
+ * The workers then send their sorted tuples through shared memory queues
+ * to the leader, which merges them with its own while loading the leaf
+ * pages.  The maintenance_work_mem budget is split between the processes.
+ * Unique indexes are always built serially, because duplicates in
+ * different processes would only be found by the merge.
+ *
  * Portions Copyright (c) 1996-2017, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
  *
@@ -67,9 +76,23 @@
 #include "postgres.h"
 
 #include "access/nbtree.h"
+#include "access/parallel.h"
+#include "access/relscan.h"
+#include "access/xact.h"
 #include "access/xlog.h"
 #include "access/xloginsert.h"
+#include "catalog/catalog.h"
+#include "catalog/index.h"
+#include "commands/progress.h"
+#include "lib/binaryheap.h"
 #include "miscadmin.h"
+#include "nodes/relation.h"
+#include "optimizer/clauses.h"
+#include "optimizer/paths.h"
+#include "pgstat.h"
+#include "storage/dsm_impl.h"
+#include "storage/proc.h"
+#include "storage/shm_mq.h"
 #include "storage/smgr.h"
 #include "tcop/tcopprot.h"
 #include "utils/rel.h"
@@ -77,6 +100,18 @@
 #include "utils/tuplesort.h"
 
 
+/* Keys of the parallel build's entries in the DSM table of contents */
+#define PARALLEL_KEY_BTREE_SHARED		UINT64CONST(0xA000000000000001)
+#define PARALLEL_KEY_BTREE_SCAN			UINT64CONST(0xA000000000000002)
+#define PARALLEL_KEY_BTREE_QUEUE		UINT64CONST(0xA000000000000003)
+
+/* Size of the queue that each worker sends its sorted tuples through */
+#define BT_PARALLEL_QUEUE_SIZE			65536
+
+/* Don't use workers unless each process gets at least this much sort memory */
+#define BT_PARALLEL_MIN_SORT_MEM		32768
+
+
 /*
  * Status record for spooling/sorting phase.  (Note we may have two of
  * these due to the special requirements for uniqueness-checking with
@@ -114,6 +149,57 @@ typedef struct BTPageState
 	struct BTPageState *btps_next;	/* link to parent level, if any */
 } BTPageState;
 
+/*
+ * State shared between the leader and the workers of a parallel build.
+ */
+typedef struct BTShared
+{
+	Oid			heaprelid;
+	Oid			indexrelid;
+	int			sortmem;		/* work memory of each tuplesort, in kB */
+
+	/* Totals of the workers, protected by mutex */
+	slock_t		mutex;
+	double		reltuples;		/* heap tuples scanned */
+	double		indtuples;		/* index tuples sent to the leader */
+	bool		brokenhotchain; /* did any worker see a broken HOT chain? */
+} BTShared;
+
+/*
+ * Leader-side input of the merge: the queues that the workers send their
+ * sorted tuples through.
+ */
+typedef struct BTLeader
+{
+	int			nqueues;
+	shm_mq_handle **queues;
+	double		nreceived;		/* tuples received from all the queues */
+} BTLeader;
+
+/*
+ * Working state of the merge done in the leader.  Source 0 is the leader's
+ * own sorted spool, source i > 0 is the queue of worker i - 1.
+ */
+typedef struct BTMergeState
+{
+	BTSpool    *btspool;
+	BTLeader   *btleader;
+	IndexTuple *tuples;			/* current tuple of each source */
+	SortSupport sortKeys;
+	int			keysz;
+	TupleDesc	tupdes;
+} BTMergeState;
+
+/*
+ * Per-process state of the heap scan in a parallel build.
+ */
+typedef struct BTParallelBuildState
+{
+	BTSpool    *spool;
+	double		indtuples;
+	bool		report;			/* report progress (leader only)? */
+} BTParallelBuildState;
+
 /*
  * Overall status record for index writing phase.
  */
@@ -125,6 +211,7 @@ typedef struct BTWriteState
 	BlockNumber btws_pages_alloced; /* # pages allocated */
 	BlockNumber btws_pages_written; /* # pages written out */
 	Page		btws_zeropage;	/* workspace for filling zeroes */
+	uint64		btws_tuples_loaded; /* # leaf tuples added */
 } BTWriteState;
 
 
@@ -136,8 +223,20 @@ static void _bt_sortaddtup(Page page, Size itemsize,
 static void _bt_buildadd(BTWriteState *wstate, BTPageState *state,
 			 IndexTuple itup);
 static void _bt_uppershutdown(BTWriteState *wstate, BTPageState *state);
+static void _bt_leafbuild_internal(BTSpool *btspool, BTSpool *btspool2,
+					   BTLeader *btleader);
 static void _bt_load(BTWriteState *wstate,
-		 BTSpool *btspool, BTSpool *btspool2);
+		 BTSpool *btspool, BTSpool *btspool2, BTLeader *btleader);
+static SortSupport _bt_merge_sortkeys(Relation index, int keysz);
+static int _bt_merge_compare(SortSupport sortKeys, int keysz, TupleDesc tupdes,
+				  IndexTuple itup, IndexTuple itup2);
+static IndexTuple _bt_merge_fetch(BTMergeState *mstate, int source);
+static int	_bt_merge_heap_compare(Datum a, Datum b, void *arg);
+static BTSpool *_bt_parallel_spoolinit(Relation heap, Relation index,
+					   int sortmem);
+static void _bt_parallel_build_callback(Relation index, HeapTuple htup,
+							Datum *values, bool *isnull,
+							bool tupleIsAlive, void *state);
 
 
 /*
@@ -199,6 +298,23 @@ _bt_spool(BTSpool *btspool, ItemPointer self, Datum *values, bool *isnull)
  */
 void
 _bt_leafbuild(BTSpool *btspool, BTSpool *btspool2)
+{
+	_bt_leafbuild_internal(btspool, btspool2, NULL);
+}
+
+
+/*
+ * Internal routines.
+ */
+
+
+/*
+ * As _bt_leafbuild, merging in the sorted tuples of the workers of a
+ * parallel build if btleader is given.
+ */
+static void
+_bt_leafbuild_internal(BTSpool *btspool, BTSpool *btspool2,
+					   BTLeader *btleader)
 {
 	BTWriteState wstate;
 
@@ -210,10 +326,15 @@ _bt_leafbuild(BTSpool *btspool, BTSpool *btspool2)
 	}
 #endif							/* BTREE_BUILD_STATS */
 
+	pgstat_progress_update_param(PROGRESS_CREATEIDX_PHASE,
+								 PROGRESS_CREATEIDX_PHASE_SORT);
 	tuplesort_performsort(btspool->sortstate);
 	if (btspool2)
 		tuplesort_performsort(btspool2->sortstate);
 
+	pgstat_progress_update_param(PROGRESS_CREATEIDX_PHASE,
+								 PROGRESS_CREATEIDX_PHASE_LOAD);
+
 	wstate.heap = btspool->heap;
 	wstate.index = btspool->index;
 
@@ -227,16 +348,12 @@ _bt_leafbuild(BTSpool *btspool, BTSpool *btspool2)
 	wstate.btws_pages_alloced = BTREE_METAPAGE + 1;
 	wstate.btws_pages_written = 0;
 	wstate.btws_zeropage = NULL;	/* until needed */
+	wstate.btws_tuples_loaded = 0;
 
-	_bt_load(&wstate, btspool, btspool2);
+	_bt_load(&wstate, btspool, btspool2, btleader);
 }
 
 
-/*
- * Internal routines.
- */
-
-
 /*
  * allocate workspace for a new, clean btree page, not linked to any siblings.
  */
@@ -463,6 +580,12 @@ _bt_buildadd(BTWriteState *wstate, BTPageState *state, IndexTuple itup)
 	 */
 	CHECK_FOR_INTERRUPTS();
 
+	/* ... and to report its progress, the upper levels are small */
+	if (state->btps_level == 0 &&
+		++wstate->btws_tuples_loaded % BTREE_BUILD_PROGRESS_INTERVAL == 0)
+		pgstat_progress_update_param(PROGRESS_CREATEIDX_TUPLES_LOADED,
+									 (int64) wstate->btws_tuples_loaded);
+
 	npage = state->btps_page;
 	nblkno = state->btps_blkno;
 	last_off = state->btps_lastoff;
@@ -674,7 +797,8 @@ _bt_uppershutdown(BTWriteState *wstate, BTPageState *state)
  * btree leaves.
  */
 static void
-_bt_load(BTWriteState *wstate, BTSpool *btspool, BTSpool *btspool2)
+_bt_load(BTWriteState *wstate, BTSpool *btspool, BTSpool *btspool2,
+		 BTLeader *btleader)
 {
 	BTPageState *state = NULL;
 	bool		merge = (btspool2 != NULL);
@@ -682,49 +806,71 @@ _bt_load(BTWriteState *wstate, BTSpool *btspool, BTSpool *btspool2)
 				itup2 = NULL;
 	bool		load1;
 	TupleDesc	tupdes = RelationGetDescr(wstate->index);
-	int			i,
-				keysz = RelationGetNumberOfAttributes(wstate->index);
-	ScanKey		indexScanKey = NULL;
+	int			keysz = RelationGetNumberOfAttributes(wstate->index);
 	SortSupport sortKeys;
 
-	if (merge)
+	if (btleader)
 	{
 		/*
-		 * Another BTSpool for dead tuples exists. Now we have to merge
-		 * btspool and btspool2.
+		 * Parallel build.  Merge our own spool with the sorted tuples that
+		 * the workers send, always loading the smallest of the tuples at the
+		 * heads of the sources next.
 		 */
-
-		/* the preparation of merge */
-		itup = tuplesort_getindextuple(btspool->sortstate, true);
-		itup2 = tuplesort_getindextuple(btspool2->sortstate, true);
-		indexScanKey = _bt_mkscankey_nodata(wstate->index);
-
-		/* Prepare SortSupport data for each column */
-		sortKeys = (SortSupport) palloc0(keysz * sizeof(SortSupportData));
-
-		for (i = 0; i < keysz; i++)
+		BTMergeState mstate;
+		binaryheap *heap;
+		int			nsources = btleader->nqueues + 1;
+		int			i;
+
+		Assert(!merge);
+
+		mstate.btspool = btspool;
+		mstate.btleader = btleader;
+		mstate.tuples = (IndexTuple *) palloc(nsources * sizeof(IndexTuple));
+		mstate.sortKeys = _bt_merge_sortkeys(wstate->index, keysz);
+		mstate.keysz = keysz;
+		mstate.tupdes = tupdes;
+
+		heap = binaryheap_allocate(nsources, _bt_merge_heap_compare, &mstate);
+		for (i = 0; i < nsources; i++)
 		{
-			SortSupport sortKey = sortKeys + i;
-			ScanKey		scanKey = indexScanKey + i;
-			int16		strategy;
+			mstate.tuples[i] = _bt_merge_fetch(&mstate, i);
+			if (mstate.tuples[i] != NULL)
+				binaryheap_add_unordered(heap, Int32GetDatum(i));
+		}
+		binaryheap_build(heap);
 
-			sortKey->ssup_cxt = CurrentMemoryContext;
-			sortKey->ssup_collation = scanKey->sk_collation;
-			sortKey->ssup_nulls_first =
-				(scanKey->sk_flags & SK_BT_NULLS_FIRST) != 0;
-			sortKey->ssup_attno = scanKey->sk_attno;
-			/* Abbreviation is not supported here */
-			sortKey->abbreviate = false;
+		while (!binaryheap_empty(heap))
+		{
+			i = DatumGetInt32(binaryheap_first(heap));
 
-			AssertState(sortKey->ssup_attno != 0);
+			/* When we see first tuple, create first index page */
+			if (state == NULL)
+				state = _bt_pagestate(wstate, 0);
 
-			strategy = (scanKey->sk_flags & SK_BT_DESC) != 0 ?
-				BTGreaterStrategyNumber : BTLessStrategyNumber;
+			_bt_buildadd(wstate, state, mstate.tuples[i]);
 
-			PrepareSortSupportFromIndexRel(wstate->index, strategy, sortKey);
+			mstate.tuples[i] = _bt_merge_fetch(&mstate, i);
+			if (mstate.tuples[i] != NULL)
+				binaryheap_replace_first(heap, Int32GetDatum(i));
+			else
+				(void) binaryheap_remove_first(heap);
 		}
 
-		_bt_freeskey(indexScanKey);
+		binaryheap_free(heap);
+		pfree(mstate.sortKeys);
+		pfree(mstate.tuples);
+	}
+	else if (merge)
+	{
+		/*
+		 * Another BTSpool for dead tuples exists. Now we have to merge
+		 * btspool and btspool2.
+		 */
+
+		/* the preparation of merge */
+		itup = tuplesort_getindextuple(btspool->sortstate, true);
+		itup2 = tuplesort_getindextuple(btspool2->sortstate, true);
+		sortKeys = _bt_merge_sortkeys(wstate->index, keysz);
 
 		for (;;)
 		{
@@ -735,32 +881,8 @@ _bt_load(BTWriteState *wstate, BTSpool *btspool, BTSpool *btspool2)
 					break;
 			}
 			else if (itup != NULL)
-			{
-				for (i = 1; i <= keysz; i++)
-				{
-					SortSupport entry;
-					Datum		attrDatum1,
-								attrDatum2;
-					bool		isNull1,
-								isNull2;
-					int32		compare;
-
-					entry = sortKeys + i - 1;
-					attrDatum1 = index_getattr(itup, i, tupdes, &isNull1);
-					attrDatum2 = index_getattr(itup2, i, tupdes, &isNull2);
-
-					compare = ApplySortComparator(attrDatum1, isNull1,
-												  attrDatum2, isNull2,
-												  entry);
-					if (compare > 0)
-					{
-						load1 = false;
-						break;
-					}
-					else if (compare < 0)
-						break;
-				}
-			}
+				load1 = _bt_merge_compare(sortKeys, keysz, tupdes,
+										  itup, itup2) <= 0;
 			else
 				load1 = false;
 
@@ -795,6 +917,9 @@ _bt_load(BTWriteState *wstate, BTSpool *btspool, BTSpool *btspool2)
 		}
 	}
 
+	pgstat_progress_update_param(PROGRESS_CREATEIDX_TUPLES_LOADED,
+								 (int64) wstate->btws_tuples_loaded);
+
 	/* Close down final pages and write the metapage */
 	_bt_uppershutdown(wstate, state);
 
@@ -819,3 +944,405 @@ _bt_load(BTWriteState *wstate, BTSpool *btspool, BTSpool *btspool2)
 		smgrimmedsync(wstate->index->rd_smgr, MAIN_FORKNUM);
 	}
 }
+
+/*
+ * Prepare SortSupport data for each key column of the index, for merging
+ * sorted streams of its tuples.
+ */
+static SortSupport
+_bt_merge_sortkeys(Relation index, int keysz)
+{
+	ScanKey		indexScanKey;
+	SortSupport sortKeys;
+	int			i;
+
+	indexScanKey = _bt_mkscankey_nodata(index);
+	sortKeys = (SortSupport) palloc0(keysz * sizeof(SortSupportData));
+
+	for (i = 0; i < keysz; i++)
+	{
+		SortSupport sortKey = sortKeys + i;
+		ScanKey		scanKey = indexScanKey + i;
+		int16		strategy;
+
+		sortKey->ssup_cxt = CurrentMemoryContext;
+		sortKey->ssup_collation = scanKey->sk_collation;
+		sortKey->ssup_nulls_first =
+			(scanKey->sk_flags & SK_BT_NULLS_FIRST) != 0;
+		sortKey->ssup_attno = scanKey->sk_attno;
+		/* Abbreviation is not supported here */
+		sortKey->abbreviate = false;
+
+		AssertState(sortKey->ssup_attno != 0);
+
+		strategy = (scanKey->sk_flags & SK_BT_DESC) != 0 ?
+			BTGreaterStrategyNumber : BTLessStrategyNumber;
+
+		PrepareSortSupportFromIndexRel(index, strategy, sortKey);
+	}
+
+	_bt_freeskey(indexScanKey);
+
+	return sortKeys;
+}
+
+/*
+ * Compare the keys of two index tuples, returning <0, 0 or >0 as the first
+ * sorts before, together with or after the second.
+ */
+static int
+_bt_merge_compare(SortSupport sortKeys, int keysz, TupleDesc tupdes,
+				  IndexTuple itup, IndexTuple itup2)
+{
+	int			i;
+
+	for (i = 1; i <= keysz; i++)
+	{
+		SortSupport entry;
+		Datum		attrDatum1,
+					attrDatum2;
+		bool		isNull1,
+					isNull2;
+		int32		compare;
+
+		entry = sortKeys + i - 1;
+		attrDatum1 = index_getattr(itup, i, tupdes, &isNull1);
+		attrDatum2 = index_getattr(itup2, i, tupdes, &isNull2);
+
+		compare = ApplySortComparator(attrDatum1, isNull1,
+									  attrDatum2, isNull2,
+									  entry);
+		if (compare != 0)
+			return compare;
+	}
+
+	return 0;
+}
+
+/*
+ * Get the next tuple of a source of the parallel merge, or NULL when the
+ * source is exhausted.  The tuple stays valid until the next fetch from the
+ * same source.
+ */
+static IndexTuple
+_bt_merge_fetch(BTMergeState *mstate, int source)
+{
+	shm_mq_result res;
+	Size		nbytes;
+	void	   *data;
+
+	if (source == 0)
+		return tuplesort_getindextuple(mstate->btspool->sortstate, true);
+
+	/* A worker detaches from its queue when it has sent everything */
+	res = shm_mq_receive(mstate->btleader->queues[source - 1],
+						 &nbytes, &data, false);
+	if (res == SHM_MQ_DETACHED)
+		return NULL;
+	Assert(res == SHM_MQ_SUCCESS);
+	Assert(nbytes == IndexTupleSize((IndexTuple) data));
+
+	mstate->btleader->nreceived += 1;
+
+	return (IndexTuple) data;
+}
+
+/*
+ * binaryheap comparator of the merge.  Equal keys are put in TID order, as
+ * tuplesort does.  The heap puts the largest element first, so the sense of
+ * the comparison is reversed.
+ */
+static int
+_bt_merge_heap_compare(Datum a, Datum b, void *arg)
+{
+	BTMergeState *mstate = (BTMergeState *) arg;
+	IndexTuple	itup = mstate->tuples[DatumGetInt32(a)];
+	IndexTuple	itup2 = mstate->tuples[DatumGetInt32(b)];
+	int			compare;
+
+	compare = _bt_merge_compare(mstate->sortKeys, mstate->keysz,
+								mstate->tupdes, itup, itup2);
+	if (compare == 0)
+		compare = ItemPointerCompare(&itup->t_tid, &itup2->t_tid);
+
+	return -compare;
+}
+
+/*
+ * _bt_parallel_workers() -- number of workers to build an index with
+ *
+ * Follows the planner's choice of workers for a scan of the heap, capped by
+ * max_parallel_maintenance_workers, and keeps each process's share of
+ * maintenance_work_mem reasonably large.  Returns 0 for a serial build.
+ */
+int
+_bt_parallel_workers(Relation heap, Relation index, IndexInfo *indexInfo)
+{
+	BlockNumber heap_blocks;
+	int			nworkers;
+
+	if (max_parallel_maintenance_workers == 0 || !IsUnderPostmaster ||
+		dynamic_shared_memory_type == DSM_IMPL_NONE || IsInParallelMode())
+		return 0;
+
+	/*
+	 * Uniqueness and exclusion checks need all the tuples in one sort, and
+	 * a concurrent build scans with an MVCC snapshot of its own.  System
+	 * catalogs may be locked more weakly than the scan expects, and the
+	 * workers can't see our local buffers.
+	 */
+	if (indexInfo->ii_Unique || indexInfo->ii_ExclusionOps != NULL ||
+		indexInfo->ii_Concurrent || IsSystemRelation(heap) ||
+		RelationUsesLocalBuffers(heap))
+		return 0;
+
+	/* Index expressions and predicates are evaluated in the workers */
+	if (indexInfo->ii_Expressions != NIL || indexInfo->ii_Predicate != NIL)
+	{
+		PlannerInfo *root = makeNode(PlannerInfo);
+
+		root->glob = makeNode(PlannerGlobal);
+		if (!is_parallel_safe(root, (Node *) indexInfo->ii_Expressions) ||
+			!is_parallel_safe(root, (Node *) indexInfo->ii_Predicate))
+			return 0;
+	}
+
+	nworkers = RelationGetParallelWorkers(heap, -1);
+	if (nworkers < 0)
+	{
+		int			heap_parallel_threshold;
+
+		heap_blocks = RelationGetNumberOfBlocks(heap);
+		heap_parallel_threshold = Max(min_parallel_table_scan_size, 1);
+		if (heap_blocks < (BlockNumber) heap_parallel_threshold)
+			return 0;
+
+		/* One more worker each time the heap triples, as for scans */
+		nworkers = 1;
+		while (heap_blocks >= (BlockNumber) (heap_parallel_threshold * 3))
+		{
+			nworkers++;
+			heap_parallel_threshold *= 3;
+			if (heap_parallel_threshold > INT_MAX / 3)
+				break;
+		}
+	}
+	nworkers = Min(nworkers, max_parallel_maintenance_workers);
+
+	while (nworkers > 0 &&
+		   maintenance_work_mem / (nworkers + 1) < BT_PARALLEL_MIN_SORT_MEM)
+		nworkers--;
+
+	return nworkers;
+}
+
+/*
+ * _bt_parallel_build() -- build an index with parallel workers
+ *
+ * Scans the heap and builds the whole index, like the serial code in
+ * btbuild.  Returns the number of heap tuples and sets *indtuples to the
+ * number of index tuples.
+ */
+double
+_bt_parallel_build(Relation heap, Relation index, IndexInfo *indexInfo,
+				   int nworkers, double *indtuples)
+{
+	ParallelContext *pcxt;
+	BTShared   *btshared;
+	ParallelHeapScanDesc pscan;
+	char	   *queuespace;
+	BTLeader	btleader;
+	BTParallelBuildState buildstate;
+	double		reltuples;
+	int			i;
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext("postgres", "_bt_parallel_build_main",
+								 nworkers);
+
+	shm_toc_estimate_chunk(&pcxt->estimator, sizeof(BTShared));
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   heap_parallelscan_estimate(SnapshotAny));
+	shm_toc_estimate_chunk(&pcxt->estimator,
+						   mul_size(BT_PARALLEL_QUEUE_SIZE, pcxt->nworkers));
+	shm_toc_estimate_keys(&pcxt->estimator, 3);
+	InitializeParallelDSM(pcxt);
+
+	btshared = (BTShared *) shm_toc_allocate(pcxt->toc, sizeof(BTShared));
+	btshared->heaprelid = RelationGetRelid(heap);
+	btshared->indexrelid = RelationGetRelid(index);
+	btshared->sortmem = Max(maintenance_work_mem / (pcxt->nworkers + 1), 64);
+	SpinLockInit(&btshared->mutex);
+	btshared->reltuples = 0;
+	btshared->indtuples = 0;
+	btshared->brokenhotchain = false;
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_BTREE_SHARED, btshared);
+
+	pscan = (ParallelHeapScanDesc)
+		shm_toc_allocate(pcxt->toc, heap_parallelscan_estimate(SnapshotAny));
+	heap_parallelscan_initialize(pscan, heap, SnapshotAny);
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_BTREE_SCAN, pscan);
+
+	queuespace = shm_toc_allocate(pcxt->toc,
+								  mul_size(BT_PARALLEL_QUEUE_SIZE,
+										   pcxt->nworkers));
+	btleader.queues = (shm_mq_handle **)
+		palloc(Max(pcxt->nworkers, 1) * sizeof(shm_mq_handle *));
+	for (i = 0; i < pcxt->nworkers; i++)
+	{
+		shm_mq	   *mq;
+
+		mq = shm_mq_create(queuespace + (Size) i * BT_PARALLEL_QUEUE_SIZE,
+						   BT_PARALLEL_QUEUE_SIZE);
+		shm_mq_set_receiver(mq, MyProc);
+		btleader.queues[i] = shm_mq_attach(mq, pcxt->seg, NULL);
+	}
+	shm_toc_insert(pcxt->toc, PARALLEL_KEY_BTREE_QUEUE, queuespace);
+
+	LaunchParallelWorkers(pcxt);
+
+	/* Notice workers that exit, or never start, without sending anything */
+	btleader.nqueues = pcxt->nworkers_launched;
+	btleader.nreceived = 0;
+	for (i = 0; i < btleader.nqueues; i++)
+		shm_mq_set_handle(btleader.queues[i], pcxt->worker[i].bgwhandle);
+
+	ereport(DEBUG1,
+			(errmsg_internal("building index \"%s\" with %d parallel workers (planned: %d)",
+							 RelationGetRelationName(index),
+							 pcxt->nworkers_launched, nworkers)));
+
+	/* Take our share of the heap, then merge it with the workers' */
+	buildstate.spool = _bt_parallel_spoolinit(heap, index, btshared->sortmem);
+	buildstate.indtuples = 0;
+	buildstate.report = true;
+	reltuples = IndexBuildHeapParallelScan(heap, index, indexInfo, pscan,
+										   _bt_parallel_build_callback,
+										   (void *) &buildstate);
+	pgstat_progress_update_param(PROGRESS_CREATEIDX_TUPLES_SCANNED,
+								 (int64) buildstate.indtuples);
+
+	_bt_leafbuild_internal(buildstate.spool, NULL, &btleader);
+	_bt_spooldestroy(buildstate.spool);
+
+	/* This reports any error of the workers */
+	WaitForParallelWorkersToFinish(pcxt);
+
+	if (btleader.nreceived != btshared->indtuples)
+		elog(ERROR, "parallel build of index \"%s\" received %.0f tuples from workers, expected %.0f",
+			 RelationGetRelationName(index),
+			 btleader.nreceived, btshared->indtuples);
+
+	reltuples += btshared->reltuples;
+	*indtuples = buildstate.indtuples + btshared->indtuples;
+	if (btshared->brokenhotchain)
+		indexInfo->ii_BrokenHotChain = true;
+
+	pfree(btleader.queues);
+	DestroyParallelContext(pcxt);
+	ExitParallelMode();
+
+	return reltuples;
+}
+
+/*
+ * _bt_parallel_build_main -- entry point of a parallel index build worker
+ */
+void
+_bt_parallel_build_main(dsm_segment *seg, shm_toc *toc)
+{
+	BTShared   *btshared;
+	ParallelHeapScanDesc pscan;
+	shm_mq	   *mq;
+	shm_mq_handle *mqh;
+	Relation	heapRel;
+	Relation	indexRel;
+	IndexInfo  *indexInfo;
+	BTParallelBuildState buildstate;
+	IndexTuple	itup;
+	double		reltuples;
+
+	btshared = (BTShared *) shm_toc_lookup(toc, PARALLEL_KEY_BTREE_SHARED,
+										   false);
+	pscan = (ParallelHeapScanDesc) shm_toc_lookup(toc, PARALLEL_KEY_BTREE_SCAN,
+												  false);
+	mq = (shm_mq *) ((char *) shm_toc_lookup(toc, PARALLEL_KEY_BTREE_QUEUE,
+											 false) +
+					 (Size) ParallelWorkerNumber * BT_PARALLEL_QUEUE_SIZE);
+	shm_mq_set_sender(mq, MyProc);
+	mqh = shm_mq_attach(mq, seg, NULL);
+
+	/* The leader holds stronger locks, and we are in its lock group */
+	heapRel = heap_open(btshared->heaprelid, ShareLock);
+	indexRel = index_open(btshared->indexrelid, RowExclusiveLock);
+	indexInfo = BuildIndexInfo(indexRel);
+
+	buildstate.spool = _bt_parallel_spoolinit(heapRel, indexRel,
+											  btshared->sortmem);
+	buildstate.indtuples = 0;
+	buildstate.report = false;
+	reltuples = IndexBuildHeapParallelScan(heapRel, indexRel, indexInfo, pscan,
+										   _bt_parallel_build_callback,
+										   (void *) &buildstate);
+	tuplesort_performsort(buildstate.spool->sortstate);
+
+	/* Send the sorted tuples; the leader only goes away if it fails */
+	while ((itup = tuplesort_getindextuple(buildstate.spool->sortstate,
+										   true)) != NULL)
+	{
+		if (shm_mq_send(mqh, IndexTupleSize(itup), itup, false) !=
+			SHM_MQ_SUCCESS)
+			break;
+	}
+	shm_mq_detach(mq);
+
+	SpinLockAcquire(&btshared->mutex);
+	btshared->reltuples += reltuples;
+	btshared->indtuples += buildstate.indtuples;
+	if (indexInfo->ii_BrokenHotChain)
+		btshared->brokenhotchain = true;
+	SpinLockRelease(&btshared->mutex);
+
+	_bt_spooldestroy(buildstate.spool);
+	index_close(indexRel, RowExclusiveLock);
+	heap_close(heapRel, ShareLock);
+}
+
+/*
+ * Create the spool of one process of a parallel build.
+ */
+static BTSpool *
+_bt_parallel_spoolinit(Relation heap, Relation index, int sortmem)
+{
+	BTSpool    *btspool = (BTSpool *) palloc0(sizeof(BTSpool));
+
+	btspool->heap = heap;
+	btspool->index = index;
+	btspool->isunique = false;
+	btspool->sortstate = tuplesort_begin_index_btree(heap, index, false,
+													 sortmem, false);
+
+	return btspool;
+}
+
+/*
+ * Per-tuple callback of the heap scans of a parallel build.
+ */
+static void
+_bt_parallel_build_callback(Relation index,
+							HeapTuple htup,
+							Datum *values,
+							bool *isnull,
+							bool tupleIsAlive,
+							void *state)
+{
+	BTParallelBuildState *buildstate = (BTParallelBuildState *) state;
+
+	_bt_spool(buildstate->spool, &htup->t_self, values, isnull);
+	buildstate->indtuples += 1;
+
+	if (buildstate->report &&
+		(uint64) buildstate->indtuples % BTREE_BUILD_PROGRESS_INTERVAL == 0)
+		pgstat_progress_update_param(PROGRESS_CREATEIDX_TUPLES_SCANNED,
+									 (int64) buildstate->indtuples);
+}
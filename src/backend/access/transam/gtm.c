@@ -17,17 +17,25 @@
 #include "access/gtm.h"
 #include "access/transam.h"
 #include "access/xact.h"
+#include "catalog/pg_type.h"
+#include "funcapi.h"
+#include "utils/builtins.h"
 #include "utils/elog.h"
 #include "miscadmin.h"
 #include "pgxc/pgxc.h"
+#include "pgstat.h"
 #include "gtm/gtm_c.h"
 #include "postmaster/autovacuum.h"
 #include "postmaster/clustermon.h"
+#include "port/atomics.h"
 #include "storage/backendid.h"
+#include "storage/shmem.h"
 #include "tcop/tcopprot.h"
 #include "utils/guc.h"
 #include "utils/lsyscache.h"
+#include "utils/memutils.h"
 #include "utils/pg_rusage.h"
+#include "utils/array.h"
 
 /* To access sequences */
 #define GetMyCoordName \
@@ -35,6 +43,8 @@
 /* Configuration variables */
 char *GtmHost = "localhost";
 int GtmPort = 6666;
+char *GtmStandbyHost = "";
+int GtmStandbyPort = 6666;
 static int GtmConnectTimeout = 60;
 bool IsXidFromGTM = false;
 bool gtm_backup_barrier = false;
@@ -42,9 +52,35 @@ extern bool FirstSnapshotSet;
 
 static GTM_Conn *conn;
 
+/*
+ * GTM the connections of the node are made to first, 0 for gtm_host or 1 for
+ * gtm_standby_host. The first backend which fails over to the other GTM
+ * switches it, so that the others do not wait for the failed one to time out
+ * before trying the new one.
+ */
+static pg_atomic_uint32 *GtmActiveServer = NULL;
+
+/*
+ * Identifier issued by GTM to the last connection of the process, resent
+ * when reconnecting. Children must not inherit the one of the postmaster.
+ */
+static uint32 GtmClientId = 0;
+static int	GtmClientIdPid = 0;
+
 /* Used to check if needed to commit/abort at datanodes */
 GlobalTransactionId currentGxid = InvalidGlobalTransactionId;
 
+/*
+ * Start prepared request sent by StartPreparedTranGTMAsync, which result has
+ * not been read yet. The gid and nodestring are kept to repeat the request
+ * if it fails.
+ */
+static GlobalTransactionId pendingPreparedGxid = InvalidGlobalTransactionId;
+static char *pendingPreparedGid = NULL;
+static char *pendingPreparedNodes = NULL;
+/* The request has been sent over current connection */
+static bool pendingPreparedSent = false;
+
 bool
 IsGTMConnected()
 {
@@ -54,6 +90,10 @@ IsGTMConnected()
 static void
 CheckConnection(void)
 {
+	/* Read result of the request in flight before sending anything else */
+	if (GlobalTransactionIdIsValid(pendingPreparedGxid))
+		StartPreparedTranGTMWait();
+
 	/* Be sure that a backend does not use a postmaster connection */
 	if (IsUnderPostmaster && GTMPQispostmaster(conn) == 1)
 	{
@@ -65,11 +105,49 @@ CheckConnection(void)
 		InitGTM();
 }
 
+/*
+ * Report shared memory space needed by GTMShmemInit
+ */
+Size
+GTMShmemSize(void)
+{
+	return sizeof(pg_atomic_uint32);
+}
+
 void
-InitGTM(void)
+GTMShmemInit(void)
+{
+	bool		found;
+
+	GtmActiveServer = (pg_atomic_uint32 *)
+		ShmemInitStruct("GTM Active Server", GTMShmemSize(), &found);
+	if (!found)
+		pg_atomic_init_u32(GtmActiveServer, 0);
+}
+
+/*
+ * Connect to GTM, or to the GTM standby if server is 1. Returns NULL on
+ * failure.
+ *
+ * When a standby is configured the connection is refused by a GTM which is
+ * not the active one, so a standby is used only once it has been promoted.
+ * Its copy of the transaction array is kept up to date by the master, and
+ * resending our client identifier lets it attach the transactions open on
+ * the failed master to the new connection.
+ */
+static GTM_Conn *
+ConnectGTMServer(int server)
 {
-	/* 256 bytes should be enough */
-	char conn_str[256];
+	/* 512 bytes should be enough */
+	char conn_str[512];
+	char	   *host = server ? GtmStandbyHost : GtmHost;
+	int			port = server ? GtmStandbyPort : GtmPort;
+	bool		failover = (GtmStandbyHost[0] != '\0');
+	uint32		client_id = 0;
+	GTM_Conn   *newconn;
+
+	if (GtmClientIdPid == MyProcPid)
+		client_id = GtmClientId;
 
 	/* If this thread is postmaster itself, it contacts gtm identifying itself */
 	if (!IsUnderPostmaster)
@@ -82,9 +160,9 @@ InitGTM(void)
 			remote_type = GTM_NODE_DATANODE;
 
 		/* Use 60s as connection timeout */
-		sprintf(conn_str, "host=%s port=%d node_name=%s remote_type=%d postmaster=1 connect_timeout=%d",
-								GtmHost, GtmPort, PGXCNodeName, remote_type,
-								GtmConnectTimeout);
+		sprintf(conn_str, "host=%s port=%d node_name=%s remote_type=%d postmaster=1 connect_timeout=%d active_only=%d client_id=%u",
+								host, port, PGXCNodeName, remote_type,
+								GtmConnectTimeout, failover, client_id);
 
 		/* Log activity of GTM connections */
 		elog(DEBUG1, "Postmaster: connection established to GTM with string %s", conn_str);
@@ -92,8 +170,9 @@ InitGTM(void)
 	else
 	{
 		/* Use 60s as connection timeout */
-		sprintf(conn_str, "host=%s port=%d node_name=%s connect_timeout=%d",
-				GtmHost, GtmPort, PGXCNodeName, GtmConnectTimeout);
+		sprintf(conn_str, "host=%s port=%d node_name=%s connect_timeout=%d active_only=%d client_id=%u",
+				host, port, PGXCNodeName, GtmConnectTimeout, failover,
+				client_id);
 
 		/* Log activity of GTM connections */
 		if (IsAutoVacuumWorkerProcess())
@@ -106,8 +185,43 @@ InitGTM(void)
 			elog(DEBUG1, "Postmaster child: connection established to GTM with string %s", conn_str);
 	}
 
-	conn = PQconnectGTM(conn_str);
-	if (GTMPQstatus(conn) != CONNECTION_OK)
+	newconn = PQconnectGTM(conn_str);
+	if (GTMPQstatus(newconn) != CONNECTION_OK)
+	{
+		int save_errno = errno;
+
+		GTMPQfinish(newconn);
+		errno = save_errno;
+		return NULL;
+	}
+
+	return newconn;
+}
+
+void
+InitGTM(void)
+{
+	int			server = 0;
+	int			nservers = 1;
+	int			i;
+
+	if (GtmStandbyHost[0] != '\0')
+	{
+		nservers = 2;
+		if (GtmActiveServer)
+			server = (int) pg_atomic_read_u32(GtmActiveServer);
+	}
+
+	/* Try the GTM known to be active first, then the other one */
+	for (i = 0; i < nservers; i++)
+	{
+		conn = ConnectGTMServer(server);
+		if (conn)
+			break;
+		server = 1 - server;
+	}
+
+	if (conn == NULL)
 	{
 		int save_errno = errno;
 
@@ -118,9 +232,22 @@ InitGTM(void)
 		errno = save_errno;
 
 		CloseGTM();
+		return;
+	}
+
+	if (i > 0)
+	{
+		ereport(LOG,
+				(errmsg("failed over to GTM on %s:%d",
+						server ? GtmStandbyHost : GtmHost,
+						server ? GtmStandbyPort : GtmPort)));
+		if (GtmActiveServer)
+			pg_atomic_write_u32(GtmActiveServer, (uint32) server);
 	}
+	GtmClientId = GTMPQclientid(conn);
+	GtmClientIdPid = MyProcPid;
 
-	else if (IS_PGXC_COORDINATOR)
+	if (IS_PGXC_COORDINATOR)
 		register_session(conn, PGXCNodeName, MyProcPid, MyBackendId);
 }
 
@@ -129,6 +256,8 @@ CloseGTM(void)
 {
 	GTMPQfinish(conn);
 	conn = NULL;
+	/* The result of request in flight, if any, is lost */
+	pendingPreparedSent = false;
 
 	/* Log activity of GTM connections */
 	if (!IsUnderPostmaster)
@@ -153,6 +282,7 @@ BeginTranGTM(GTM_Timestamp *timestamp, const char *globalSession)
 	if (log_gtm_stats)
 		ResetUsageCommon(&start_r, &start_t);
 
+	pgstat_report_wait_start(WAIT_EVENT_GTM_BEGIN);
 	CheckConnection();
 	// TODO Isolation level
 	if (conn)
@@ -168,6 +298,7 @@ BeginTranGTM(GTM_Timestamp *timestamp, const char *globalSession)
 		if (conn)
 			xid = begin_transaction(conn, GTM_ISOLATION_RC, globalSession, timestamp);
 	}
+	pgstat_report_wait_end();
 	if (xid)
 		IsXidFromGTM = true;
 	currentGxid = xid;
@@ -184,6 +315,7 @@ BeginTranAutovacuumGTM(void)
 {
 	GlobalTransactionId  xid = InvalidGlobalTransactionId;
 
+	pgstat_report_wait_start(WAIT_EVENT_GTM_BEGIN);
 	CheckConnection();
 	// TODO Isolation level
 	if (conn)
@@ -200,6 +332,7 @@ BeginTranAutovacuumGTM(void)
 		if (conn)
 			xid =  begin_transaction_autovacuum(conn, GTM_ISOLATION_RC);
 	}
+	pgstat_report_wait_end();
 	currentGxid = xid;
 
 	elog(DEBUG3, "BeginTranGTM - %d", xid);
@@ -222,6 +355,7 @@ CommitTranGTM(GlobalTransactionId gxid, int waited_xid_count,
 
 	elog(DEBUG3, "CommitTranGTM: %d", gxid);
 
+	pgstat_report_wait_start(WAIT_EVENT_GTM_COMMIT);
 	CheckConnection();
 	ret = -1;
 	if (conn)
@@ -239,6 +373,7 @@ CommitTranGTM(GlobalTransactionId gxid, int waited_xid_count,
 		if (conn)
 			ret = commit_transaction(conn, gxid, waited_xid_count, waited_xids);
 	}
+	pgstat_report_wait_end();
 
 	/* Close connection in case commit is done by autovacuum worker or launcher */
 	if (IsAutoVacuumWorkerProcess() || IsAutoVacuumLauncherProcess())
@@ -272,6 +407,7 @@ CommitPreparedTranGTM(GlobalTransactionId gxid,
 
 	elog(DEBUG3, "CommitPreparedTranGTM: %d:%d", gxid, prepared_gxid);
 
+	pgstat_report_wait_start(WAIT_EVENT_GTM_COMMIT_PREPARED);
 	CheckConnection();
 	ret = -1;
 	if (conn)
@@ -292,6 +428,7 @@ CommitPreparedTranGTM(GlobalTransactionId gxid,
 			ret = commit_prepared_transaction(conn, gxid, prepared_gxid,
 					waited_xid_count, waited_xids);
 	}
+	pgstat_report_wait_end();
 	currentGxid = InvalidGlobalTransactionId;
 
 	if (log_gtm_stats)
@@ -307,6 +444,8 @@ RollbackTranGTM(GlobalTransactionId gxid)
 
 	if (!GlobalTransactionIdIsValid(gxid))
 		return 0;
+
+	pgstat_report_wait_start(WAIT_EVENT_GTM_ROLLBACK);
 	CheckConnection();
 
 	if (conn)
@@ -324,6 +463,57 @@ RollbackTranGTM(GlobalTransactionId gxid)
 		if (conn)
 			ret = abort_transaction(conn, gxid);
 	}
+	pgstat_report_wait_end();
+
+	currentGxid = InvalidGlobalTransactionId;
+	return ret;
+}
+
+/*
+ * Roll back two GXIDs, typically the auxiliary and the top-level GXIDs of a
+ * prepared transaction, in a single round trip to GTM.  Both requests are
+ * pipelined on the connection and their results read back in order.
+ * Invalid GXIDs are ignored.
+ */
+int
+RollbackTranGTMPair(GlobalTransactionId gxid1, GlobalTransactionId gxid2)
+{
+	int ret = -1;
+
+	if (!GlobalTransactionIdIsValid(gxid1))
+		return RollbackTranGTM(gxid2);
+	if (!GlobalTransactionIdIsValid(gxid2))
+		return RollbackTranGTM(gxid1);
+
+	pgstat_report_wait_start(WAIT_EVENT_GTM_ROLLBACK);
+	CheckConnection();
+
+	if (conn &&
+		abort_transaction_send(conn, gxid1) == 0 &&
+		abort_transaction_send(conn, gxid2) == 0)
+	{
+		int ret1 = abort_transaction_receive(conn, gxid1);
+		int ret2 = (ret1 >= 0) ? abort_transaction_receive(conn, gxid2) : -1;
+
+		ret = (ret1 < 0 || ret2 < 0) ? -1 : Max(ret1, ret2);
+	}
+
+	/*
+	 * If something went wrong, the connection can not be trusted to be in
+	 * sync any more.  Reset it and fall back to one request at a time.
+	 */
+	if (ret < 0)
+	{
+		CloseGTM();
+		InitGTM();
+		if (conn)
+		{
+			ret = abort_transaction(conn, gxid1);
+			if (conn)
+				ret = Max(ret, abort_transaction(conn, gxid2));
+		}
+	}
+	pgstat_report_wait_end();
 
 	currentGxid = InvalidGlobalTransactionId;
 	return ret;
@@ -338,6 +528,8 @@ StartPreparedTranGTM(GlobalTransactionId gxid,
 
 	if (!GlobalTransactionIdIsValid(gxid))
 		return 0;
+
+	pgstat_report_wait_start(WAIT_EVENT_GTM_START_PREPARED);
 	CheckConnection();
 
 	ret = -1;
@@ -356,6 +548,70 @@ StartPreparedTranGTM(GlobalTransactionId gxid,
 		if (conn)
 			ret = start_prepared_transaction(conn, gxid, gid, nodestring);
 	}
+	pgstat_report_wait_end();
+
+	return ret;
+}
+
+/*
+ * Send start prepared request to GTM without waiting for the result.
+ * The result is read by StartPreparedTranGTMWait, or implicitly by the next
+ * request sent to GTM. If sending fails the request is repeated
+ * synchronously by StartPreparedTranGTMWait.
+ */
+void
+StartPreparedTranGTMAsync(GlobalTransactionId gxid,
+						  char *gid,
+						  char *nodestring)
+{
+	if (!GlobalTransactionIdIsValid(gxid))
+		return;
+	CheckConnection();
+
+	pendingPreparedGid = MemoryContextStrdup(TopMemoryContext, gid);
+	pendingPreparedNodes = MemoryContextStrdup(TopMemoryContext, nodestring);
+	pendingPreparedGxid = gxid;
+
+	/* On failure the request will be repeated */
+	if (conn)
+	{
+		pendingPreparedSent = true;
+		if (start_prepared_transaction_send(conn, gxid, gid, nodestring))
+			CloseGTM();
+	}
+}
+
+int
+StartPreparedTranGTMWait(void)
+{
+	GlobalTransactionId gxid = pendingPreparedGxid;
+	int 		ret = -1;
+
+	if (!GlobalTransactionIdIsValid(gxid))
+		return 0;
+
+	/* Clean up first, StartPreparedTranGTM calls CheckConnection */
+	pendingPreparedGxid = InvalidGlobalTransactionId;
+
+	if (conn && pendingPreparedSent)
+	{
+		pgstat_report_wait_start(WAIT_EVENT_GTM_START_PREPARED);
+		ret = start_prepared_transaction_receive(conn, gxid);
+		pgstat_report_wait_end();
+	}
+	pendingPreparedSent = false;
+
+	if (ret < 0)
+	{
+		CloseGTM();
+		ret = StartPreparedTranGTM(gxid, pendingPreparedGid,
+								   pendingPreparedNodes);
+	}
+
+	pfree(pendingPreparedGid);
+	pfree(pendingPreparedNodes);
+	pendingPreparedGid = NULL;
+	pendingPreparedNodes = NULL;
 
 	return ret;
 }
@@ -374,6 +630,7 @@ PrepareTranGTM(GlobalTransactionId gxid)
 	if (log_gtm_stats)
 		ResetUsageCommon(&start_r, &start_t);
 
+	pgstat_report_wait_start(WAIT_EVENT_GTM_PREPARE);
 	ret = -1;
 	if (conn)
 		ret = prepare_transaction(conn, gxid);
@@ -390,6 +647,7 @@ PrepareTranGTM(GlobalTransactionId gxid)
 		if (conn)
 			ret = prepare_transaction(conn, gxid);
 	}
+	pgstat_report_wait_end();
 	currentGxid = InvalidGlobalTransactionId;
 
 	if (log_gtm_stats)
@@ -442,6 +700,7 @@ GetSnapshotGTM(GlobalTransactionId gxid, bool canbe_grouped)
 	if (log_gtm_stats)
 		ResetUsageCommon(&start_r, &start_t);
 
+	pgstat_report_wait_start(WAIT_EVENT_GTM_SNAPSHOT);
 	if (conn)
 		ret_snapshot = get_snapshot(conn, gxid, canbe_grouped);
 	if (ret_snapshot == NULL)
@@ -451,6 +710,7 @@ GetSnapshotGTM(GlobalTransactionId gxid, bool canbe_grouped)
 		if (conn)
 			ret_snapshot = get_snapshot(conn, gxid, canbe_grouped);
 	}
+	pgstat_report_wait_end();
 
 	if (log_gtm_stats)
 		ShowUsageCommon("GetSnapshotGTM", &start_r, &start_t);
@@ -713,3 +973,126 @@ ReportGlobalXmin(GlobalTransactionId gxid, GlobalTransactionId *global_xmin,
 			gxid, global_xmin, latest_completed_xid, &errcode);
 	return errcode;
 }
+
+/*
+ * Get the request statistics of GTM and of the GTM proxy we are connected
+ * through. Returns the number of rows, allocated in the current memory
+ * context.
+ */
+int
+GetGTMStats(GTM_StatsEntry **entries)
+{
+	GTM_StatsEntry *stats = NULL;
+	int			count = -1;
+
+	CheckConnection();
+
+	if (conn)
+		count = get_gtm_stats(conn, &stats);
+	if (count < 0)
+	{
+		CloseGTM();
+		InitGTM();
+		if (conn)
+			count = get_gtm_stats(conn, &stats);
+	}
+	if (count < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_CONNECTION_FAILURE),
+				 errmsg("could not get statistics from GTM"),
+				 errdetail("%s", conn ? GTMPQerrorMessage(conn) : "")));
+
+	/* The rows belong to the connection, keep a copy */
+	*entries = (GTM_StatsEntry *) palloc(sizeof(GTM_StatsEntry) * Max(count, 1));
+	if (count > 0)
+		memcpy(*entries, stats, sizeof(GTM_StatsEntry) * count);
+
+	return count;
+}
+
+/*
+ * pgxc_gtm_stats
+ *		Request counters and histograms of GTM and GTM proxy
+ *
+ * Latencies are in microseconds, as measured by GTM itself. Sizes of
+ * snapshots are in GXIDs, sizes of proxy batches in commands.
+ */
+Datum
+pgxc_gtm_stats(PG_FUNCTION_ARGS)
+{
+#define PGXC_GTM_STATS_COLS	7
+	static const char *const kindnames[] =
+		{"latency", "snapshot", "threads", "batch"};
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	GTM_StatsEntry *stats;
+	int			count;
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	count = GetGTMStats(&stats);
+
+	for (i = 0; i < count; i++)
+	{
+		GTM_StatsEntry *entry = &stats[i];
+		Datum		values[PGXC_GTM_STATS_COLS];
+		bool		nulls[PGXC_GTM_STATS_COLS];
+		Datum		hist[GTM_STATS_BUCKETS];
+		int			j;
+
+		MemSet(nulls, 0, sizeof(nulls));
+
+		for (j = 0; j < GTM_STATS_BUCKETS; j++)
+			hist[j] = Int64GetDatum(entry->counter.hist[j]);
+
+		values[0] = CStringGetTextDatum(entry->source);
+		if (entry->kind >= 0 && entry->kind < lengthof(kindnames))
+			values[1] = CStringGetTextDatum(kindnames[entry->kind]);
+		else
+			nulls[1] = true;
+		values[2] = CStringGetTextDatum(entry->name);
+		values[3] = Int64GetDatum(entry->counter.count);
+		values[4] = Int64GetDatum(entry->counter.total);
+		values[5] = Int64GetDatum(entry->counter.max);
+		/* Thread counts are snapshots, without a distribution */
+		if (entry->kind == GTM_STATS_QUEUE)
+			nulls[6] = true;
+		else
+			values[6] = PointerGetDatum(construct_array(hist, GTM_STATS_BUCKETS,
+														INT8OID, sizeof(int64),
+														FLOAT8PASSBYVAL, 'd'));
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
@@ -14,11 +14,13 @@
 
 #include "postgres.h"
 
+#include "access/nbtree.h"
 #include "access/parallel.h"
 #include "access/xact.h"
 #include "access/xlog.h"
 #include "catalog/namespace.h"
 #include "commands/async.h"
+#include "commands/vacuum.h"
 #include "executor/execParallel.h"
 #include "libpq/libpq.h"
 #include "libpq/pqformat.h"
@@ -119,6 +121,12 @@ static const struct
 {
 	{
 		"ParallelQueryMain", ParallelQueryMain
+	},
+	{
+		"lazy_parallel_vacuum_main", lazy_parallel_vacuum_main
+	},
+	{
+		"_bt_parallel_build_main", _bt_parallel_build_main
 	}
 };
 
@@ -459,6 +459,8 @@ MarkAsPreparingGuts(GlobalTransaction gxact, TransactionId xid, const char *gid,
 {
 	PGPROC	   *proc;
 	PGXACT	   *pgxact;
+	uint64	   *fpLockBits;
+	Oid		   *fpRelId;
 	int			i;
 
 	Assert(LWLockHeldByMeInMode(TwoPhaseStateLock, LW_EXCLUSIVE));
@@ -467,8 +469,15 @@ MarkAsPreparingGuts(GlobalTransaction gxact, TransactionId xid, const char *gid,
 	proc = &ProcGlobal->allProcs[gxact->pgprocno];
 	pgxact = &ProcGlobal->allPgXact[gxact->pgprocno];
 
-	/* Initialize the PGPROC entry */
+	/*
+	 * Initialize the PGPROC entry, keeping the pointers to its fast-path lock
+	 * arrays, which were set up by InitProcGlobal.
+	 */
+	fpLockBits = proc->fpLockBits;
+	fpRelId = proc->fpRelId;
 	MemSet(proc, 0, sizeof(PGPROC));
+	proc->fpLockBits = fpLockBits;
+	proc->fpRelId = fpRelId;
 	proc->pgprocno = gxact->pgprocno;
 	SHMQueueElemInit(&(proc->links));
 	proc->waitStatus = STATUS_OK;
@@ -1594,8 +1603,8 @@ RemoveTwoPhaseFile(TransactionId xid, bool giveWarning)
 }
 
 /*
- * Recreates a state file. This is used in WAL replay and during
- * checkpoint creation.
+ * Recreates a state file. This is used during checkpoint creation, the
+ * caller is responsible for fsyncing the file.
  *
  * Note: content and len don't include CRC.
  */
@@ -1642,20 +1651,6 @@ RecreateTwoPhaseFile(TransactionId xid, void *content, int len)
 	}
 	pgstat_report_wait_end();
 
-	/*
-	 * We must fsync the file because the end-of-replay checkpoint will not do
-	 * so, there being no GXACT in shared memory yet to tell it to.
-	 */
-	pgstat_report_wait_start(WAIT_EVENT_TWOPHASE_FILE_SYNC);
-	if (pg_fsync(fd) != 0)
-	{
-		CloseTransientFile(fd);
-		ereport(ERROR,
-				(errcode_for_file_access(),
-				 errmsg("could not fsync two-phase state file: %m")));
-	}
-	pgstat_report_wait_end();
-
 	if (CloseTransientFile(fd) != 0)
 		ereport(ERROR,
 				(errcode_for_file_access(),
@@ -1686,6 +1681,9 @@ CheckPointTwoPhase(XLogRecPtr redo_horizon)
 {
 	int			i;
 	int			serialized_xacts = 0;
+	int			ncandidates = 0;
+	TransactionId *xids;
+	XLogRecPtr *lsns;
 
 	if (max_prepared_xacts <= 0)
 		return;					/* nothing to do */
@@ -1694,20 +1692,22 @@ CheckPointTwoPhase(XLogRecPtr redo_horizon)
 
 	/*
 	 * We are expecting there to be zero GXACTs that need to be copied to
-	 * disk, so we perform all I/O while holding TwoPhaseStateLock for
-	 * simplicity. This prevents any new xacts from preparing while this
-	 * occurs, which shouldn't be a problem since the presence of long-lived
-	 * prepared xacts indicates the transaction manager isn't active.
-	 *
-	 * It's also possible to move I/O out of the lock, but on every error we
-	 * should check whether somebody committed our transaction in different
-	 * backend. Let's leave this optimization for future, if somebody will
-	 * spot that this place cause bottleneck.
+	 * disk, but in Postgres-XL every multi-node write is committed with an
+	 * implicit two-phase commit, so there may be quite a few of them under
+	 * load, and holding TwoPhaseStateLock while doing the I/O would block all
+	 * the PREPAREs. So remember the candidates and do the I/O without the
+	 * lock. WAL is not recycled before the checkpoint is completed, so the
+	 * state data can be read even if the transaction finishes in the
+	 * meantime. Files are fsynced in a separate pass, letting the kernel write
+	 * them out together.
 	 *
 	 * Note that it isn't possible for there to be a GXACT with a
 	 * prepare_end_lsn set prior to the last checkpoint yet is marked invalid,
 	 * because of the efforts with delayChkpt.
 	 */
+	xids = (TransactionId *) palloc(max_prepared_xacts * sizeof(TransactionId));
+	lsns = (XLogRecPtr *) palloc(max_prepared_xacts * sizeof(XLogRecPtr));
+
 	LWLockAcquire(TwoPhaseStateLock, LW_SHARED);
 	for (i = 0; i < TwoPhaseState->numPrepXacts; i++)
 	{
@@ -1721,20 +1721,68 @@ CheckPointTwoPhase(XLogRecPtr redo_horizon)
 			!gxact->ondisk &&
 			gxact->prepare_end_lsn <= redo_horizon)
 		{
-			char	   *buf;
-			int			len;
+			xids[ncandidates] = gxact->xid;
+			lsns[ncandidates] = gxact->prepare_start_lsn;
+			ncandidates++;
+		}
+	}
+	LWLockRelease(TwoPhaseStateLock);
 
-			XlogReadTwoPhaseData(gxact->prepare_start_lsn, &buf, &len);
-			RecreateTwoPhaseFile(gxact->xid, buf, len);
-			gxact->ondisk = true;
-			gxact->prepare_start_lsn = InvalidXLogRecPtr;
-			gxact->prepare_end_lsn = InvalidXLogRecPtr;
-			pfree(buf);
-			serialized_xacts++;
+	for (i = 0; i < ncandidates; i++)
+	{
+		char	   *buf;
+		int			len;
+
+		XlogReadTwoPhaseData(lsns[i], &buf, &len);
+		RecreateTwoPhaseFile(xids[i], buf, len);
+		pfree(buf);
+	}
+
+	for (i = 0; i < ncandidates; i++)
+	{
+		char		path[MAXPGPATH];
+
+		TwoPhaseFilePath(path, xids[i]);
+		pgstat_report_wait_start(WAIT_EVENT_TWOPHASE_FILE_SYNC);
+		fsync_fname(path, false);
+		pgstat_report_wait_end();
+	}
+
+	/*
+	 * Now mark the survivors as being on disk. Files of the transactions
+	 * finished in the meantime are removed, nobody else knows about them.
+	 */
+	LWLockAcquire(TwoPhaseStateLock, LW_SHARED);
+	for (i = 0; i < ncandidates; i++)
+	{
+		bool		found = false;
+		int			j;
+
+		for (j = 0; j < TwoPhaseState->numPrepXacts; j++)
+		{
+			GlobalTransaction gxact = TwoPhaseState->prepXacts[j];
+
+			if (gxact->xid == xids[i] &&
+				(gxact->valid || gxact->inredo) &&
+				!gxact->ondisk &&
+				gxact->prepare_start_lsn == lsns[i])
+			{
+				gxact->ondisk = true;
+				gxact->prepare_start_lsn = InvalidXLogRecPtr;
+				gxact->prepare_end_lsn = InvalidXLogRecPtr;
+				serialized_xacts++;
+				found = true;
+				break;
+			}
 		}
+		if (!found)
+			RemoveTwoPhaseFile(xids[i], false);
 	}
 	LWLockRelease(TwoPhaseStateLock);
 
+	pfree(xids);
+	pfree(lsns);
+
 	/*
 	 * Flush unconditionally the parent directory to make any information
 	 * durable on disk.  Two-phase files could have been removed and those
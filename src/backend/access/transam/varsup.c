@@ -252,6 +252,14 @@ GetNewTransactionId(bool isSubXact)
 			 * This is the auto-commit, single datanode transaction. Just use
 			 * the local node-name and backend id in global session which
 			 * should give us a globally unique identifier
+			 *
+			 * The Coordinator does not assign a GXID to such a transaction,
+			 * so it is only requested here, on the first write. It still has
+			 * to come from GTM: a locally assigned XID may collide with the
+			 * GXIDs of distributed transactions writing to this node, and
+			 * the transaction would be invisible in the global snapshots
+			 * taken on the other nodes, so no local XID can be used even if
+			 * the transaction never escalates.
 			 */
 			sprintf(global_session, "%s_%d", PGXCNodeName, MyProcPid);
 			xid = (TransactionId) BeginTranGTM(timestamp, global_session);
@@ -517,6 +525,13 @@ GetNewTransactionId(bool isSubXact)
 	}
 
 	LWLockRelease(XidGenLock);
+
+#ifdef PGXC
+	/* The XID may be older than what cached snapshots consider running */
+	if (!useLocalXid)
+		ProcArrayNoteAssignedXid(xid);
+#endif
+
 	return xid;
 }
 
@@ -30,6 +30,7 @@
 #include "gtm/gtm_gxid.h"
 #include "pgxc/execRemote.h"
 #include "pgxc/pause.h"
+#include "pgxc/admission.h"
 /* PGXC_DATANODE */
 #include "postmaster/autovacuum.h"
 #include "libpq/pqformat.h"
@@ -331,6 +332,8 @@ static char *saveNodeString = NULL;
 static bool XactLocalNodePrepared;
 static bool  XactReadLocalNode;
 static bool  XactWriteLocalNode;
+/* Number of transactions of this session committed using implicit 2PC */
+static uint64 XactImplicit2PCCount = 0;
 
 /*
  * Some commands want to force synchronous commit.
@@ -2221,6 +2224,7 @@ StartTransaction(void)
 	 */
 	xactStartTimestamp = stmtStartTimestamp;
 	xactStopTimestamp = 0;
+	SetCatCacheClock(xactStartTimestamp);
 #ifdef PGXC
 	/* For Postgres-XC, transaction start timestamp has to follow the GTM timeline */
 	pgstat_report_xact_timestamp(GTMxactStartTimestamp ?
@@ -2367,6 +2371,7 @@ CommitTransaction(void)
 
 			prepareGID = GetImplicit2PCGID(implicit2PC_head, XactWriteLocalNode);
 			savePrepareGID = MemoryContextStrdup(TopMemoryContext, prepareGID);
+			XactImplicit2PCCount++;
 
 			if (XactWriteLocalNode)
 			{
@@ -2684,6 +2689,7 @@ CommitTransaction(void)
 
 #ifdef PGXC
 	AtEOXact_Remote();
+	AtEOXact_AdmissionControl();
 	GTMxactStartTimestamp = 0;
 #endif
 }
@@ -2719,14 +2725,9 @@ AtEOXact_GlobalTxn(bool commit)
 		}
 		else
 		{
-			/*
-			 * XXX Why don't we have a single API to abort both the GXIDs
-			 * together ?
-			 */
-			if (GlobalTransactionIdIsValid(s->auxilliaryTransactionId))
-				RollbackTranGTM(s->auxilliaryTransactionId);
-			if (GlobalTransactionIdIsValid(s->topGlobalTransansactionId))
-				RollbackTranGTM(s->topGlobalTransansactionId);
+			/* Abort both the GXIDs in one round trip */
+			RollbackTranGTMPair(s->auxilliaryTransactionId,
+								s->topGlobalTransansactionId);
 		}
 	}
 	/*
@@ -3067,6 +3068,7 @@ PrepareTransaction(void)
 	CleanGTMCallbacks();
 #ifdef XCP	
 	AtEOXact_Remote();	
+	AtEOXact_AdmissionControl();
 	GTMxactStartTimestamp = 0;
 #endif	
 #endif
@@ -3374,6 +3376,7 @@ AbortTransaction(void)
 
 #ifdef PGXC
 	AtEOXact_Remote();
+	AtEOXact_AdmissionControl();
 	GTMxactStartTimestamp = 0;
 #endif
 
@@ -6609,6 +6612,18 @@ IsXidImplicit(const char *xid)
 	return true;
 }
 
+/*
+ * pgxc_implicit_2pc_count
+ *		Number of transactions the current session committed, or tried to
+ *		commit, using implicit two-phase commit, because they wrote to more
+ *		than one node.
+ */
+Datum
+pgxc_implicit_2pc_count(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_INT64((int64) XactImplicit2PCCount);
+}
+
 /*
  * SaveReceivedCommandId
  * Save a received command ID from another node for future use.
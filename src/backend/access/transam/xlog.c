@@ -34,6 +34,7 @@
 #include "access/xact.h"
 #include "access/xlog_internal.h"
 #include "access/xloginsert.h"
+#include "access/xlogprefetch.h"
 #include "access/xlogreader.h"
 #include "access/xlogutils.h"
 #include "catalog/catversion.h"
@@ -596,6 +597,12 @@ typedef struct XLogCtlData
 	pg_time_t	lastSegSwitchTime;
 	XLogRecPtr	lastSegSwitchLSN;
 
+	/*
+	 * Moving average of the time WAL flushes take, in microseconds, used
+	 * when commit_delay is -1. Protected by WALWriteLock.
+	 */
+	uint32		avgFlushUsecs;
+
 	/*
 	 * Protected by info_lck and WALWriteLock (you must hold either lock to
 	 * read it, but both to update)
@@ -2575,7 +2582,24 @@ XLogWrite(XLogwrtRqst WriteRqst, bool flexible)
 				openLogOff = 0;
 			}
 
-			issue_xlog_fsync(openLogFile, openLogSegNo);
+			if (CommitDelay < 0)
+			{
+				instr_time	start;
+				instr_time	duration;
+				int64		usecs;
+
+				INSTR_TIME_SET_CURRENT(start);
+				issue_xlog_fsync(openLogFile, openLogSegNo);
+				INSTR_TIME_SET_CURRENT(duration);
+				INSTR_TIME_SUBTRACT(duration, start);
+
+				/* Smooth over the last 8 or so flushes */
+				usecs = Min(INSTR_TIME_GET_MICROSEC(duration), 1000000);
+				XLogCtl->avgFlushUsecs = (uint32)
+					((XLogCtl->avgFlushUsecs * 7 + usecs) / 8);
+			}
+			else
+				issue_xlog_fsync(openLogFile, openLogSegNo);
 		}
 
 		/* signal that we need to wakeup walsenders later */
@@ -2859,11 +2883,22 @@ XLogFlush(XLogRecPtr record)
 		 *
 		 * We do not sleep if enableFsync is not turned on, nor if there are
 		 * fewer than CommitSiblings other backends with active transactions.
+		 *
+		 * With commit_delay set to -1 the delay follows the storage: half the
+		 * time recent flushes took, so a flush covers the commits arriving
+		 * during the previous one without the delay dominating latency on
+		 * fast devices. With implicit two-phase commit this applies to the
+		 * PREPARE and COMMIT PREPARED flushes alike.
 		 */
-		if (CommitDelay > 0 && enableFsync &&
+		if (CommitDelay != 0 && enableFsync &&
 			MinimumActiveBackends(CommitSiblings))
 		{
-			pg_usleep(CommitDelay);
+			int			delay = CommitDelay;
+
+			if (delay < 0)
+				delay = Min(XLogCtl->avgFlushUsecs / 2, 100000);
+			if (delay > 0)
+				pg_usleep(delay);
 
 			/*
 			 * Re-check how far we can now flush the WAL. It's generally not
@@ -7081,6 +7116,7 @@ StartupXLOG(void)
 		{
 			ErrorContextCallback errcallback;
 			TimestampTz xtime;
+			XLogPrefetcher *prefetcher = NULL;
 
 			InRedo = true;
 
@@ -7241,6 +7277,21 @@ StartupXLOG(void)
 					TransactionIdIsValid(record->xl_xid))
 					RecordKnownAssignedTransactionIds(record->xl_xid);
 
+				/*
+				 * Get the kernel started on reading the blocks the next
+				 * records are going to need.  When streaming, don't look
+				 * past what the WAL receiver has written.
+				 */
+				if (RecoveryPrefetchDistance > 0)
+				{
+					if (prefetcher == NULL)
+						prefetcher = XLogPrefetcherAllocate(EndRecPtr);
+					XLogPrefetch(prefetcher, EndRecPtr, curFileTLI,
+								 currentSource == XLOG_FROM_STREAM ?
+								 GetWalRcvWriteRecPtr(NULL, NULL) :
+								 InvalidXLogRecPtr);
+				}
+
 				/* Now apply the WAL record itself */
 				RmgrTable[record->xl_rmid].rm_redo(xlogreader);
 
@@ -7349,6 +7400,9 @@ StartupXLOG(void)
 				}
 			}
 
+			if (prefetcher != NULL)
+				XLogPrefetcherFree(prefetcher);
+
 			/* Allow resource managers to do any required cleanup. */
 			for (rmid = 0; rmid <= RM_MAX_ID; rmid++)
 			{
@@ -0,0 +1,347 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogprefetch.c
+ *		Prefetching of the data blocks referenced by upcoming WAL records
+ *
+ * Redo in the startup process is single threaded, and on a standby
+ * following a primary that does bulk loads or redistributions most of its
+ * time goes into synchronous reads of the data blocks the records modify.
+ * The prefetcher reads the WAL ahead of the replay position with a reader
+ * of its own, and hints the kernel about the blocks the upcoming records
+ * will need, so that the reads are already in flight when redo gets there.
+ *
+ * The prefetcher never waits for WAL: it only looks at segments that are
+ * already present in pg_wal, and when streaming it does not look beyond
+ * what the WAL receiver has written.  When it runs out of WAL it simply
+ * tries again later.  Records that carry a full-page image, or that
+ * reinitialize the page, are skipped since redo does not read those blocks.
+ *
+ * Portions Copyright (c) 1996-2017, PostgreSQL Global Development Group
+ * Portions Copyright (c) 2010-2012 Postgres-XC Development Group
+ *
+ * src/backend/access/transam/xlogprefetch.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "access/xlog_internal.h"
+#include "access/xlogprefetch.h"
+#include "access/xlogreader.h"
+#include "access/xlogrecord.h"
+#include "common/relpath.h"
+#include "storage/fd.h"
+
+/* GUC parameter */
+int			RecoveryPrefetchDistance = 0;
+
+/* Number of block references remembered to avoid duplicate hints */
+#define PREFETCH_RECENT_BLOCKS	64
+
+/* Number of relation segment files kept open */
+#define PREFETCH_OPEN_FILES		16
+
+typedef struct PrefetchBlock
+{
+	RelFileNode rnode;
+	ForkNumber	forknum;
+	BlockNumber blkno;
+} PrefetchBlock;
+
+typedef struct PrefetchFile
+{
+	RelFileNode rnode;
+	ForkNumber	forknum;
+	BlockNumber segno;
+	int			fd;
+} PrefetchFile;
+
+struct XLogPrefetcher
+{
+	XLogReaderState *reader;
+
+	TimeLineID	tli;			/* timeline of the segments read ahead */
+	XLogRecPtr	limit;			/* do not read WAL past this, if valid */
+
+	XLogRecPtr	nextRecPtr;		/* next record to look at */
+	XLogRecPtr	failedAt;		/* replay position when lookahead failed */
+
+	/* WAL segment currently open by the lookahead reader */
+	int			walFile;
+	XLogSegNo	walSegNo;
+
+	PrefetchBlock recent[PREFETCH_RECENT_BLOCKS];
+	int			nextRecent;
+
+	PrefetchFile files[PREFETCH_OPEN_FILES];
+	int			nextFile;
+
+	uint64		prefetched;
+	uint64		skipped;
+};
+
+static int XLogPrefetchPageRead(XLogReaderState *reader,
+					 XLogRecPtr targetPagePtr, int reqLen,
+					 XLogRecPtr targetRecPtr, char *readBuf,
+					 TimeLineID *pageTLI);
+static void XLogPrefetchRecord(XLogPrefetcher *prefetcher,
+				   XLogReaderState *record);
+static void XLogPrefetchBlock(XLogPrefetcher *prefetcher, RelFileNode rnode,
+				  ForkNumber forknum, BlockNumber blkno);
+
+/*
+ * Set up a prefetcher that starts looking at the WAL from startPtr.
+ */
+XLogPrefetcher *
+XLogPrefetcherAllocate(XLogRecPtr startPtr)
+{
+	XLogPrefetcher *prefetcher;
+	int			i;
+
+	prefetcher = palloc0(sizeof(XLogPrefetcher));
+	prefetcher->reader = XLogReaderAllocate(&XLogPrefetchPageRead, prefetcher);
+	if (!prefetcher->reader)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory"),
+				 errdetail("Failed while allocating a WAL reading processor.")));
+	prefetcher->nextRecPtr = startPtr;
+	prefetcher->failedAt = InvalidXLogRecPtr;
+	prefetcher->walFile = -1;
+	for (i = 0; i < PREFETCH_OPEN_FILES; i++)
+		prefetcher->files[i].fd = -1;
+
+	return prefetcher;
+}
+
+/*
+ * Release the prefetcher and the files it holds open.
+ */
+void
+XLogPrefetcherFree(XLogPrefetcher *prefetcher)
+{
+	int			i;
+
+	elog(DEBUG1, "recovery prefetch hinted " UINT64_FORMAT " blocks, skipped " UINT64_FORMAT,
+		 prefetcher->prefetched, prefetcher->skipped);
+
+	if (prefetcher->walFile >= 0)
+		close(prefetcher->walFile);
+	for (i = 0; i < PREFETCH_OPEN_FILES; i++)
+	{
+		if (prefetcher->files[i].fd >= 0)
+			close(prefetcher->files[i].fd);
+	}
+	XLogReaderFree(prefetcher->reader);
+	pfree(prefetcher);
+}
+
+/*
+ * Read ahead of the record at replayPtr up to recovery_prefetch_distance,
+ * hinting the blocks the records in between reference.
+ *
+ * The lookahead reads segments of timeline tli and does not go past limit,
+ * unless that is InvalidXLogRecPtr.
+ */
+void
+XLogPrefetch(XLogPrefetcher *prefetcher, XLogRecPtr replayPtr,
+			 TimeLineID tli, XLogRecPtr limit)
+{
+	XLogRecPtr	horizon;
+
+	/*
+	 * Redo has caught up with, or skipped over, the lookahead; start again
+	 * just behind it.
+	 */
+	if (prefetcher->nextRecPtr <= replayPtr || tli != prefetcher->tli)
+	{
+		prefetcher->nextRecPtr = replayPtr;
+		prefetcher->failedAt = InvalidXLogRecPtr;
+		prefetcher->tli = tli;
+	}
+
+	/*
+	 * After running out of WAL, do not try again before redo has advanced
+	 * by a page, the lookahead would most likely fail again.
+	 */
+	if (!XLogRecPtrIsInvalid(prefetcher->failedAt) &&
+		replayPtr < prefetcher->failedAt + XLOG_BLCKSZ)
+		return;
+	prefetcher->failedAt = InvalidXLogRecPtr;
+	prefetcher->limit = limit;
+
+	horizon = replayPtr + (XLogRecPtr) RecoveryPrefetchDistance * 1024;
+	while (prefetcher->nextRecPtr < horizon)
+	{
+		XLogRecord *record;
+		char	   *errormsg;
+
+		record = XLogReadRecord(prefetcher->reader, prefetcher->nextRecPtr,
+								&errormsg);
+		if (record == NULL)
+		{
+			prefetcher->failedAt = replayPtr;
+			break;
+		}
+
+		XLogPrefetchRecord(prefetcher, prefetcher->reader);
+		prefetcher->nextRecPtr = prefetcher->reader->EndRecPtr;
+	}
+}
+
+/*
+ * Hint the blocks referenced by a decoded record.
+ */
+static void
+XLogPrefetchRecord(XLogPrefetcher *prefetcher, XLogReaderState *record)
+{
+	int			block_id;
+
+	for (block_id = 0; block_id <= record->max_block_id; block_id++)
+	{
+		RelFileNode rnode;
+		ForkNumber	forknum;
+		BlockNumber blkno;
+
+		if (!XLogRecGetBlockTag(record, block_id, &rnode, &forknum, &blkno))
+			continue;
+
+		/* Redo does not read the blocks it is going to overwrite anyway */
+		if (XLogRecHasBlockImage(record, block_id) ||
+			(record->blocks[block_id].flags & BKPBLOCK_WILL_INIT) != 0)
+		{
+			prefetcher->skipped++;
+			continue;
+		}
+
+		XLogPrefetchBlock(prefetcher, rnode, forknum, blkno);
+	}
+}
+
+/*
+ * Ask the kernel to start reading a block.  The relation may well be gone,
+ * or not created yet, at this point of the WAL; any failure is ignored.
+ */
+static void
+XLogPrefetchBlock(XLogPrefetcher *prefetcher, RelFileNode rnode,
+				  ForkNumber forknum, BlockNumber blkno)
+{
+#ifdef USE_PREFETCH
+	BlockNumber segno = blkno / ((BlockNumber) RELSEG_SIZE);
+	PrefetchFile *file = NULL;
+	int			i;
+
+	/* Consecutive records often touch the same block */
+	for (i = 0; i < PREFETCH_RECENT_BLOCKS; i++)
+	{
+		PrefetchBlock *recent = &prefetcher->recent[i];
+
+		if (recent->blkno == blkno && recent->forknum == forknum &&
+			RelFileNodeEquals(recent->rnode, rnode))
+		{
+			prefetcher->skipped++;
+			return;
+		}
+	}
+	prefetcher->recent[prefetcher->nextRecent].rnode = rnode;
+	prefetcher->recent[prefetcher->nextRecent].forknum = forknum;
+	prefetcher->recent[prefetcher->nextRecent].blkno = blkno;
+	prefetcher->nextRecent = (prefetcher->nextRecent + 1) % PREFETCH_RECENT_BLOCKS;
+
+	for (i = 0; i < PREFETCH_OPEN_FILES; i++)
+	{
+		if (prefetcher->files[i].fd >= 0 &&
+			prefetcher->files[i].segno == segno &&
+			prefetcher->files[i].forknum == forknum &&
+			RelFileNodeEquals(prefetcher->files[i].rnode, rnode))
+		{
+			file = &prefetcher->files[i];
+			break;
+		}
+	}
+
+	if (file == NULL)
+	{
+		char	   *path;
+		char		segpath[MAXPGPATH];
+		int			fd;
+
+		path = relpathperm(rnode, forknum);
+		if (segno > 0)
+			snprintf(segpath, MAXPGPATH, "%s.%u", path, segno);
+		else
+			strlcpy(segpath, path, MAXPGPATH);
+		pfree(path);
+
+		fd = BasicOpenFile(segpath, O_RDONLY | PG_BINARY, 0);
+		if (fd < 0)
+			return;
+
+		/* Evict the oldest open file */
+		file = &prefetcher->files[prefetcher->nextFile];
+		prefetcher->nextFile = (prefetcher->nextFile + 1) % PREFETCH_OPEN_FILES;
+		if (file->fd >= 0)
+			close(file->fd);
+		file->rnode = rnode;
+		file->forknum = forknum;
+		file->segno = segno;
+		file->fd = fd;
+	}
+
+	(void) posix_fadvise(file->fd,
+						 (off_t) BLCKSZ * (blkno % ((BlockNumber) RELSEG_SIZE)),
+						 BLCKSZ, POSIX_FADV_WILLNEED);
+	prefetcher->prefetched++;
+#endif							/* USE_PREFETCH */
+}
+
+/*
+ * Read callback of the lookahead reader.  Unlike XLogPageRead, it reads
+ * only segments present in pg_wal and never waits for more WAL.
+ */
+static int
+XLogPrefetchPageRead(XLogReaderState *reader, XLogRecPtr targetPagePtr,
+					 int reqLen, XLogRecPtr targetRecPtr, char *readBuf,
+					 TimeLineID *pageTLI)
+{
+	XLogPrefetcher *prefetcher = (XLogPrefetcher *) reader->private_data;
+	XLogSegNo	segno;
+	uint32		pageOff;
+
+	if (!XLogRecPtrIsInvalid(prefetcher->limit) &&
+		targetPagePtr + reqLen > prefetcher->limit)
+		return -1;
+
+	XLByteToSeg(targetPagePtr, segno);
+	pageOff = targetPagePtr % XLogSegSize;
+
+	if (prefetcher->walFile >= 0 && segno != prefetcher->walSegNo)
+	{
+		close(prefetcher->walFile);
+		prefetcher->walFile = -1;
+	}
+
+	if (prefetcher->walFile < 0)
+	{
+		char		fname[MAXFNAMELEN];
+		char		path[MAXPGPATH];
+
+		XLogFileName(fname, prefetcher->tli, segno);
+		snprintf(path, MAXPGPATH, XLOGDIR "/%s", fname);
+		prefetcher->walFile = BasicOpenFile(path, O_RDONLY | PG_BINARY, 0);
+		if (prefetcher->walFile < 0)
+			return -1;
+		prefetcher->walSegNo = segno;
+	}
+
+	if (lseek(prefetcher->walFile, (off_t) pageOff, SEEK_SET) < 0 ||
+		read(prefetcher->walFile, readBuf, XLOG_BLCKSZ) != XLOG_BLCKSZ)
+		return -1;
+
+	*pageTLI = prefetcher->tli;
+	return XLOG_BLCKSZ;
+}
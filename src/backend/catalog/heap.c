@@ -1086,6 +1086,7 @@ GetRelationDistributionItems(Oid relid,
 		switch (distributeby->disttype)
 		{
 			case DISTTYPE_HASH:
+			case DISTTYPE_BUCKET:
 				/*
 				 * Validate user-specified hash column.
 				 * System columns cannot be used.
@@ -1105,7 +1106,7 @@ GetRelationDistributionItems(Oid relid,
 						 errmsg("Column %s is not a hash distributable data type",
 							distributeby->colname)));
 				}
-				local_locatortype = LOCATOR_TYPE_HASH;
+				local_locatortype = ConvertToLocatorType(distributeby->disttype);
 				break;
 
 			case DISTTYPE_MODULO:
@@ -1147,7 +1148,8 @@ GetRelationDistributionItems(Oid relid,
 	}
 
 	/* Use default hash values */
-	if (local_locatortype == LOCATOR_TYPE_HASH)
+	if (local_locatortype == LOCATOR_TYPE_HASH ||
+		local_locatortype == LOCATOR_TYPE_BUCKET)
 	{
 		local_hashalgorithm = 1;
 		local_hashbuckets = HASH_SIZE;
@@ -139,6 +139,9 @@ static int32 partition_bound_cmp(PartitionKey key,
 static int partition_bound_bsearch(PartitionKey key,
 						PartitionBoundInfo boundinfo,
 						void *probe, bool probe_is_bound, bool *is_equal);
+static bool partition_bound_offset_matches(PartitionKey key,
+							   PartitionBoundInfo boundinfo,
+							   int offset, Datum *values, bool *is_equal);
 
 /*
  * RelationBuildPartitionDesc
@@ -1089,6 +1092,7 @@ RelationGetPartitionDispatchInfo(Relation rel, int lockmode,
 		pd[i]->key = partkey;
 		pd[i]->keystate = NIL;
 		pd[i]->partdesc = partdesc;
+		pd[i]->last_offset = -2;
 		if (parent != NULL)
 		{
 			/*
@@ -2011,11 +2015,33 @@ get_partition_for_tuple(PartitionDispatch *pd,
 			cur_index = partdesc->boundinfo->null_index;
 		else if (!isnull[0])
 		{
-			/* Else bsearch in partdesc->boundinfo */
 			bool		equal = false;
 
-			cur_offset = partition_bound_bsearch(key, partdesc->boundinfo,
-												 values, false, &equal);
+			/*
+			 * Rows being loaded usually arrive clustered on the partition
+			 * key, or with the key increasing (think timestamps), so first
+			 * see whether the bound found for the previous tuple, or the one
+			 * right after it, is also the one for this tuple.  That costs at
+			 * most a couple of comparisons.  Else bsearch in
+			 * partdesc->boundinfo.
+			 */
+			cur_offset = parent->last_offset;
+			if (cur_offset < -1 ||
+				!partition_bound_offset_matches(key, partdesc->boundinfo,
+												cur_offset, values, &equal))
+			{
+				cur_offset++;
+				if (cur_offset < 0 ||
+					!partition_bound_offset_matches(key, partdesc->boundinfo,
+													cur_offset, values,
+													&equal))
+					cur_offset = partition_bound_bsearch(key,
+														 partdesc->boundinfo,
+														 values, false,
+														 &equal);
+			}
+			parent->last_offset = cur_offset;
+
 			switch (key->strategy)
 			{
 				case PARTITION_STRATEGY_LIST:
@@ -2334,3 +2360,48 @@ partition_bound_bsearch(PartitionKey key, PartitionBoundInfo boundinfo,
 
 	return lo;
 }
+
+/*
+ * partition_bound_offset_matches
+ *
+ * Return whether offset is what partition_bound_bsearch would return for
+ * the partition key values of a tuple being routed, that is, whether the
+ * bound at offset is the greatest one less than or equal to values.  offset
+ * may be -1, meaning values is less than all the bounds.  *is_equal is set
+ * as partition_bound_bsearch would.
+ *
+ * For list partitioning only an exact match with the bound at offset is
+ * accepted, since the bsearch result is of no use otherwise.
+ */
+static bool
+partition_bound_offset_matches(PartitionKey key, PartitionBoundInfo boundinfo,
+							   int offset, Datum *values, bool *is_equal)
+{
+	int32		cmpval;
+
+	if (offset >= boundinfo->ndatums)
+		return false;
+
+	if (offset >= 0)
+	{
+		cmpval = partition_bound_cmp(key, boundinfo, offset, values, false);
+		if (cmpval > 0)
+			return false;
+		*is_equal = (cmpval == 0);
+		if (key->strategy == PARTITION_STRATEGY_LIST)
+			return *is_equal;
+		if (*is_equal)
+			return true;
+	}
+	else if (key->strategy == PARTITION_STRATEGY_LIST)
+		return false;
+
+	/* The next bound, if any, must be greater than values */
+	if (offset + 1 < boundinfo->ndatums &&
+		partition_bound_cmp(key, boundinfo, offset + 1, values, false) <= 0)
+		return false;
+
+	if (offset < 0)
+		*is_equal = false;
+	return true;
+}
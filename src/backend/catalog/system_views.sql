@@ -754,6 +754,97 @@ CREATE VIEW pg_stat_wal_receiver AS
     FROM pg_stat_get_wal_receiver() s
     WHERE s.pid IS NOT NULL;
 
+CREATE VIEW pg_stat_cluster_health AS
+    SELECT
+            s.sample_time,
+            s.nodeoid,
+            n.node_name,
+            s.node_type,
+            s.reachable,
+            s.rtt,
+            s.pool_active,
+            s.pool_saturation,
+            s.replication_lag
+    FROM pg_stat_get_cluster_health() s
+        LEFT JOIN pgxc_node n ON (n.oid = s.nodeoid);
+
+CREATE VIEW pg_stat_executor_samples AS
+    SELECT
+            s.dbid,
+            d.datname,
+            s.queryid,
+            s.plan_node_id,
+            s.node_type,
+            s.samples
+    FROM pg_stat_get_executor_samples() s
+        LEFT JOIN pg_database d ON (d.oid = s.dbid);
+
+CREATE VIEW pg_stat_executor_samples_cluster AS
+    SELECT
+            s.node_name,
+            s.datname,
+            s.queryid,
+            s.plan_node_id,
+            s.node_type,
+            s.samples
+    FROM pgxc_stat_get_executor_samples() s;
+
+CREATE VIEW pg_stat_redistributions AS
+    SELECT
+            s.relid,
+            c.relname,
+            s.attnum,
+            a.attname,
+            pa.attname AS distributed_by,
+            s.redistributions,
+            s.est_rows,
+            s.est_bytes
+    FROM pg_stat_get_redistributions() s
+        JOIN pg_class c ON (c.oid = s.relid)
+        LEFT JOIN pg_attribute a ON (a.attrelid = s.relid AND a.attnum = s.attnum)
+        LEFT JOIN pgxc_class x ON (x.pcrelid = s.relid)
+        LEFT JOIN pg_attribute pa ON (pa.attrelid = x.pcrelid AND pa.attnum = x.pcattnum);
+
+CREATE VIEW pg_stat_pooler AS
+    SELECT
+            s.nodeoid,
+            n.node_name,
+            n.node_type,
+            s.requests,
+            s.misses,
+            s.connects,
+            s.connect_failures,
+            s.exhausted,
+            s.closed,
+            s.wait_time,
+            s.wait_histogram,
+            s.stats_reset
+    FROM pg_stat_get_pooler() s
+        LEFT JOIN pgxc_node n ON (n.oid = s.nodeoid);
+
+CREATE VIEW pg_stat_shared_queues AS
+    SELECT
+            s.queue_name,
+            s.producer_pid,
+            pn.node_name AS producer_node,
+            s.consumer_pid,
+            cn.node_name AS consumer_node,
+            s.status,
+            s.queue_size,
+            s.queue_used,
+            s.queue_tuples,
+            s.tuples_written,
+            s.tuples_read,
+            s.tuples_buffered,
+            s.long_tuples,
+            s.spill_bytes,
+            s.spill_tuples,
+            s.producer_pauses,
+            s.producer_wait_time
+    FROM pg_stat_get_shared_queues() s
+        LEFT JOIN pgxc_node pn ON (pn.oid = s.producer_nodeoid)
+        LEFT JOIN pgxc_node cn ON (cn.oid = s.consumer_nodeoid);
+
 CREATE VIEW pg_stat_subscription AS
     SELECT
             su.oid AS subid,
@@ -899,6 +990,31 @@ CREATE VIEW pg_stat_progress_vacuum AS
     FROM pg_stat_get_progress_info('VACUUM') AS S
 		LEFT JOIN pg_database D ON S.datid = D.oid;
 
+CREATE VIEW pg_stat_progress_create_index AS
+	SELECT
+		S.pid AS pid, S.datid AS datid, D.datname AS datname,
+		S.relid AS relid, S.param2::oid AS index_relid,
+		CASE S.param1 WHEN 0 THEN 'initializing'
+					  WHEN 1 THEN 'building index'
+					  WHEN 2 THEN 'scanning heap'
+					  WHEN 3 THEN 'sorting tuples'
+					  WHEN 4 THEN 'loading tuples'
+					  END AS phase,
+		S.param3 AS tuples_scanned, S.param4 AS tuples_loaded
+    FROM pg_stat_get_progress_info('CREATE INDEX') AS S
+		LEFT JOIN pg_database D ON S.datid = D.oid;
+
+CREATE VIEW pg_stat_progress_create_index_cluster AS
+    SELECT
+            s.node_name,
+            s.pid,
+            s.datname,
+            s.relname,
+            s.phase,
+            s.tuples_scanned,
+            s.tuples_loaded
+    FROM pgxc_stat_get_progress_create_index() s;
+
 CREATE VIEW pg_user_mappings AS
     SELECT
         U.oid       AS umid,
@@ -1065,6 +1181,24 @@ LANGUAGE INTERNAL
 VOLATILE ROWS 1000 COST 1000
 AS 'pg_logical_slot_peek_binary_changes';
 
+CREATE OR REPLACE FUNCTION pgxc_logical_slot_get_changes(
+    IN slot_name name, IN upto_nchanges int, VARIADIC options text[] DEFAULT '{}',
+    OUT node_name name, OUT lsn pg_lsn, OUT xid xid, OUT commit_time timestamptz,
+    OUT data text)
+RETURNS SETOF RECORD
+LANGUAGE INTERNAL
+VOLATILE ROWS 1000 COST 1000
+AS 'pgxc_logical_slot_get_changes';
+
+CREATE OR REPLACE FUNCTION pgxc_logical_slot_peek_changes(
+    IN slot_name name, IN upto_nchanges int, VARIADIC options text[] DEFAULT '{}',
+    OUT node_name name, OUT lsn pg_lsn, OUT xid xid, OUT commit_time timestamptz,
+    OUT data text)
+RETURNS SETOF RECORD
+LANGUAGE INTERNAL
+VOLATILE ROWS 1000 COST 1000
+AS 'pgxc_logical_slot_peek_changes';
+
 CREATE OR REPLACE FUNCTION pg_create_physical_replication_slot(
     IN slot_name name, IN immediately_reserve boolean DEFAULT false,
     IN temporary boolean DEFAULT false,
@@ -1137,6 +1271,8 @@ REVOKE EXECUTE ON FUNCTION pg_stat_reset() FROM public;
 REVOKE EXECUTE ON FUNCTION pg_stat_reset_shared(text) FROM public;
 REVOKE EXECUTE ON FUNCTION pg_stat_reset_single_table_counters(oid) FROM public;
 REVOKE EXECUTE ON FUNCTION pg_stat_reset_single_function_counters(oid) FROM public;
+REVOKE EXECUTE ON FUNCTION pg_stat_reset_executor_samples() FROM public;
+REVOKE EXECUTE ON FUNCTION pg_stat_reset_redistributions() FROM public;
 
 REVOKE EXECUTE ON FUNCTION pg_ls_logdir() FROM public;
 REVOKE EXECUTE ON FUNCTION pg_ls_waldir() FROM public;
@@ -117,6 +117,9 @@ static Datum ind_fetch_func(VacAttrStatsP stats, int rownum, bool *isNull);
 static void analyze_rel_coordinator(Relation onerel, bool inh, int attr_cnt,
 						VacAttrStats **vacattrstats, int nindexes,
 						Relation *indexes, AnlIndexData *indexdata);
+static int coord_acquire_sample_rows(Relation onerel, int elevel,
+						  HeapTuple *rows, int targrows,
+						  double remote_tuples);
 #endif
 
 /*
@@ -337,6 +340,8 @@ do_analyze_rel(Relation onerel, int options, VacuumParams *params,
 	double		totalrows,
 				totaldeadrows;
 	HeapTuple  *rows;
+	bool		remote_sample = false;
+	double		remote_tuples = 0;
 	PGRUsage	ru0;
 	TimestampTz starttime = 0;
 	MemoryContext caller_context;
@@ -488,19 +493,34 @@ do_analyze_rel(Relation onerel, int options, VacuumParams *params,
 		/*
 		 * Fetch relation statistics from remote nodes and update
 		 */
-		vacuum_rel_coordinator(onerel, in_outer_xact);
+		remote_tuples = vacuum_rel_coordinator(onerel, in_outer_xact);
 
 		/*
-		 * Fetch attribute statistics from remote nodes.
+		 * The statistics of a table distributed over the nodes are computed
+		 * from a sample of its rows acquired from all of them, below, as for
+		 * a local table.  Replicated tables have complete statistics on
+		 * every node, so those are just fetched; so are the ones of
+		 * inheritance trees.
 		 */
-		analyze_rel_coordinator(onerel, inh, attr_cnt, vacattrstats,
-								nindexes, Irel, indexdata);
+		if (inh || IsRelationReplicated(RelationGetLocInfo(onerel)) ||
+			remote_tuples <= 0)
+		{
+			/*
+			 * Fetch attribute statistics from remote nodes.
+			 */
+			analyze_rel_coordinator(onerel, inh, attr_cnt, vacattrstats,
+									nindexes, Irel, indexdata);
 
-		/*
-		 * Skip acquiring local stats. Coordinator does not store data of
-		 * distributed tables.
-		 */
-		goto cleanup;
+			/*
+			 * Skip acquiring local stats. Coordinator does not store data of
+			 * distributed tables.
+			 */
+			totalrows = Max(remote_tuples, 0);
+			totaldeadrows = 0;
+			goto cleanup;
+		}
+
+		remote_sample = true;
 	}
 #endif
 
@@ -531,6 +551,17 @@ do_analyze_rel(Relation onerel, int options, VacuumParams *params,
 	 * Acquire the sample rows
 	 */
 	rows = (HeapTuple *) palloc(targrows * sizeof(HeapTuple));
+#ifdef XCP
+	if (remote_sample)
+	{
+		numrows = coord_acquire_sample_rows(onerel, elevel,
+											rows, targrows,
+											remote_tuples);
+		totalrows = remote_tuples;
+		totaldeadrows = 0;
+	}
+	else
+#endif
 	if (inh)
 		numrows = acquire_inherited_sample_rows(onerel, elevel,
 												rows, targrows,
@@ -617,9 +648,10 @@ do_analyze_rel(Relation onerel, int options, VacuumParams *params,
 
 	/*
 	 * Update pages/tuples stats in pg_class ... but not if we're doing
-	 * inherited stats.
+	 * inherited stats, nor if vacuum_rel_coordinator did from the ones of
+	 * the datanodes.
 	 */
-	if (!inh)
+	if (!inh && !remote_sample)
 	{
 		BlockNumber relallvisible;
 
@@ -640,7 +672,7 @@ do_analyze_rel(Relation onerel, int options, VacuumParams *params,
 	 * VACUUM ANALYZE, don't overwrite the accurate count already inserted by
 	 * VACUUM.
 	 */
-	if (!inh && !(options & VACOPT_VACUUM))
+	if (!inh && !remote_sample && !(options & VACOPT_VACUUM))
 	{
 		for (ind = 0; ind < nindexes; ind++)
 		{
@@ -2956,7 +2988,9 @@ compare_mcvs(const void *a, const void *b)
  * somehow. The current approach is very simple and cheap, but may have
  * negative impact on estimate accuracy as the stats only covers data
  * from a single node, and we may end up with stats from different node
- * for each attribute.
+ * for each attribute.  That's why it is only used for replicated tables,
+ * whose stats cover all the data on every node, and inheritance trees;
+ * other distributed tables get theirs from coord_acquire_sample_rows.
  */
 static void
 coord_collect_simple_stats(Relation onerel, bool inh, int attr_cnt,
@@ -3388,6 +3422,13 @@ coord_collect_simple_stats(Relation onerel, bool inh, int attr_cnt,
  * received statistics for each attribute (the first one we receive, but
  * it's mostly random).
  *
+ * Distributed tables do not get here, their extended statistics are built
+ * from the sample merged by coord_acquire_sample_rows, so that ndistinct
+ * coefficients and functional dependencies reflect the whole table rather
+ * than the fraction of it stored on one datanode.  Which leaves replicated
+ * tables, where all the datanodes hold the same data anyway, and
+ * inheritance trees.
+ *
  * XXX This has similar issues as coord_collect_simple_stats.
  */
 static void
@@ -3421,7 +3462,8 @@ coord_collect_extended_stats(Relation onerel, int attr_cnt)
 	 *
 	 * That seems to be working fairly well, although there are likely
 	 * some weaknesses too - e.g. on distribution keys it may easily
-	 * neglect large portions of the data.
+	 * neglect large portions of the data.  That is why distributed tables
+	 * use a merged sample instead (see coord_acquire_sample_rows).
 	 */
 
 	/* Make up query string fetching data from pg_statistic_ext */
@@ -3594,4 +3636,187 @@ analyze_rel_coordinator(Relation onerel, bool inh, int attr_cnt,
 	/* extended statistics (pg_statistic) for the relation */
 	coord_collect_extended_stats(onerel, attr_cnt);
 }
+
+/* A sample row with its relative position in the heap of its datanode */
+typedef struct
+{
+	double		position;
+	HeapTuple	tuple;
+} CoordSampleRow;
+
+/*
+ * qsort comparator for sorting CoordSampleRows by position
+ */
+static int
+compare_coord_sample_rows(const void *a, const void *b)
+{
+	double		pa = ((const CoordSampleRow *) a)->position;
+	double		pb = ((const CoordSampleRow *) b)->position;
+
+	if (pa < pb)
+		return -1;
+	if (pa > pb)
+		return 1;
+	return 0;
+}
+
+/*
+ * coord_acquire_sample_rows
+ *		Acquire a sample of the rows of a distributed table from the
+ *		datanodes.
+ *
+ * All the datanodes are asked at once for a block sample (TABLESAMPLE
+ * SYSTEM) of the same fraction of their rows, chosen from remote_tuples,
+ * the number of rows they reported in all, so that we get somewhat more
+ * than targrows rows.  The sample of each node is thus proportional to its
+ * share of the table, and together they make a sample of the whole table,
+ * from which ndistinct, MCVs and histograms are computed as for a local
+ * table, instead of being guessed from the statistics of the nodes.  If we
+ * get more than targrows rows, a random subset of them is kept.
+ *
+ * Each row comes with its position in the heap of its node, as a fraction
+ * of the size of the heap, and the sample is sorted on that, so that the
+ * correlation computed reflects the physical order of the rows on the
+ * nodes rather than the order in which the nodes were read.
+ */
+static int
+coord_acquire_sample_rows(Relation onerel, int elevel,
+						  HeapTuple *rows, int targrows,
+						  double remote_tuples)
+{
+	TupleDesc	tupdesc = RelationGetDescr(onerel);
+	int			natts = tupdesc->natts;
+	StringInfoData query;
+	RemoteQuery *step;
+	RemoteQueryState *node;
+	EState	   *estate;
+	MemoryContext oldcontext;
+	TupleTableSlot *result;
+	CoordSampleRow *sample;
+	Datum	   *values;
+	bool	   *nulls;
+	double		percent;
+	double		seenrows = 0;
+	int			numrows = 0;
+	int			resno = 1;
+	int			i;
+
+	/* Ask for 20% more rows than needed, block sampling is not exact */
+	percent = Min(100.0, 100.0 * targrows * 1.2 / remote_tuples);
+
+	initStringInfo(&query);
+	appendStringInfoString(&query,
+						   "SELECT (s.ctid::text::point)[0] / greatest(c.relpages, 1)");
+
+	step = makeNode(RemoteQuery);
+	step->combine_type = COMBINE_TYPE_NONE;
+	step->exec_nodes = NULL;
+	step->force_autocommit = true;
+	step->exec_type = EXEC_ON_DATANODES;
+
+	step->scan.plan.targetlist =
+		lappend(step->scan.plan.targetlist,
+				makeTargetEntry((Expr *) makeVar(1, resno,
+												 FLOAT8OID, -1,
+												 InvalidOid, 0),
+								resno, NULL, false));
+	resno++;
+
+	for (i = 0; i < natts; i++)
+	{
+		Form_pg_attribute attr = tupdesc->attrs[i];
+
+		if (attr->attisdropped)
+			continue;
+
+		appendStringInfo(&query, ", s.%s",
+						 quote_identifier(NameStr(attr->attname)));
+		step->scan.plan.targetlist =
+			lappend(step->scan.plan.targetlist,
+					makeTargetEntry((Expr *) makeVar(1, resno,
+													 attr->atttypid,
+													 attr->atttypmod,
+													 attr->attcollation, 0),
+									resno, NULL, false));
+		resno++;
+	}
+
+	appendStringInfo(&query,
+					 " FROM ONLY %s s TABLESAMPLE SYSTEM (%g), pg_catalog.pg_class c"
+					 " WHERE c.oid = s.tableoid",
+					 quote_qualified_identifier(get_namespace_name(RelationGetNamespace(onerel)),
+												RelationGetRelationName(onerel)),
+					 percent);
+	step->sql_statement = query.data;
+
+	sample = (CoordSampleRow *) palloc(targrows * sizeof(CoordSampleRow));
+	values = (Datum *) palloc(natts * sizeof(Datum));
+	nulls = (bool *) palloc(natts * sizeof(bool));
+
+	estate = CreateExecutorState();
+	oldcontext = MemoryContextSwitchTo(estate->es_query_cxt);
+	PushActiveSnapshot(GetTransactionSnapshot());
+	estate->es_snapshot = GetActiveSnapshot();
+	node = ExecInitRemoteQuery(step, estate, 0);
+	MemoryContextSwitchTo(oldcontext);
+
+	result = ExecRemoteQuery((PlanState *) node);
+	while (result != NULL && !TupIsNull(result))
+	{
+		int			k;
+		int			col = 1;
+
+		slot_getallattrs(result);
+
+		/* Reservoir sampling over the rows received from all the nodes */
+		seenrows += 1;
+		if (numrows < targrows)
+			k = numrows++;
+		else
+		{
+			k = (int) (anl_random_fract() * seenrows);
+			if (k >= targrows)
+			{
+				result = ExecRemoteQuery((PlanState *) node);
+				continue;
+			}
+			heap_freetuple(sample[k].tuple);
+		}
+
+		for (i = 0; i < natts; i++)
+		{
+			if (tupdesc->attrs[i]->attisdropped)
+			{
+				values[i] = (Datum) 0;
+				nulls[i] = true;
+				continue;
+			}
+			values[i] = result->tts_values[col];
+			nulls[i] = result->tts_isnull[col];
+			col++;
+		}
+
+		sample[k].position = result->tts_isnull[0] ? 0 :
+			DatumGetFloat8(result->tts_values[0]);
+		sample[k].tuple = heap_form_tuple(tupdesc, values, nulls);
+
+		result = ExecRemoteQuery((PlanState *) node);
+	}
+	ExecEndRemoteQuery(node);
+	PopActiveSnapshot();
+	FreeExecutorState(estate);
+
+	qsort(sample, numrows, sizeof(CoordSampleRow), compare_coord_sample_rows);
+	for (i = 0; i < numrows; i++)
+		rows[i] = sample[i].tuple;
+	pfree(sample);
+
+	ereport(elevel,
+			(errmsg("\"%s\": sampled %.0f of an estimated %.0f rows on the datanodes, "
+					"%d rows in sample",
+					RelationGetRelationName(onerel),
+					seenrows, remote_tuples, numrows)));
+
+	return numrows;
+}
 #endif
@@ -45,6 +45,7 @@
 #include "miscadmin.h"
 #include "optimizer/clauses.h"
 #include "optimizer/planner.h"
+#include "port/simd.h"
 #ifdef PGXC
 #include "pgxc/pgxc.h"
 #include "pgxc/execRemote.h"
@@ -236,6 +237,9 @@ typedef struct CopyStateData
 #ifdef PGXC
 	/* Remote COPY state data */
 	RemoteCopyData *remoteCopyState;
+	bool		datanode_files; /* COPY TO written by each Datanode itself? */
+	List	   *datanode_list;	/* Datanodes running the COPY TO */
+	List	   *datanode_queries;	/* COPY TO sent to each of them */
 #endif
 } CopyStateData;
 
@@ -336,6 +340,12 @@ static void CopyFromInsertBatch(CopyState cstate, EState *estate,
 					BulkInsertState bistate,
 					int nBufferedTuples, HeapTuple *bufferedTuples,
 					int firstBufferedLineNo);
+#ifdef PGXC
+static void CopyFromRouteBatch(CopyState cstate, int nRoutedLines,
+				   char **routedLines, int *routedLens,
+				   Datum *routedValues, bool *routedNulls,
+				   int *routedIndexes);
+#endif
 static bool CopyReadLine(CopyState cstate);
 static bool CopyReadLineText(CopyState cstate);
 static int	CopyReadAttributesText(CopyState cstate);
@@ -349,6 +359,10 @@ static void CopyAttributeOutCSV(CopyState cstate, char *string,
 					bool use_quote, bool single_attr);
 static List *CopyGetAttnums(TupleDesc tupDesc, Relation rel,
 			   List *attnamelist);
+#ifdef PGXC
+static void BuildDataNodeCopyTo(CopyState cstate, const char *filename,
+					bool is_program, List *attnamelist);
+#endif
 static char *limit_printout_length(const char *str);
 
 /* Low-level communications functions */
@@ -1237,6 +1251,17 @@ ProcessCopyOptions(ParseState *pstate,
 								defel->defname),
 						 parser_errposition(pstate, defel->location)));
 		}
+#ifdef PGXC
+		else if (strcmp(defel->defname, "datanode_files") == 0)
+		{
+			if (cstate->datanode_files)
+				ereport(ERROR,
+						(errcode(ERRCODE_SYNTAX_ERROR),
+						 errmsg("conflicting or redundant options"),
+						 parser_errposition(pstate, defel->location)));
+			cstate->datanode_files = defGetBoolean(defel);
+		}
+#endif
 		else if (strcmp(defel->defname, "encoding") == 0)
 		{
 			if (cstate->file_encoding >= 0)
@@ -1326,6 +1351,26 @@ ProcessCopyOptions(ParseState *pstate,
 				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 				 errmsg("COPY delimiter cannot be \"%s\"", cstate->delim)));
 
+#ifdef PGXC
+	/* Check datanode_files */
+	if (cstate->datanode_files && is_from)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("COPY DATANODE_FILES available only in COPY TO")));
+	if (cstate->datanode_files && cstate->binary)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("COPY DATANODE_FILES is not available in binary mode")));
+	if (cstate->datanode_files && cstate->header_line)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("COPY DATANODE_FILES cannot be used with HEADER")));
+	if (cstate->datanode_files && cstate->file_encoding >= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("COPY DATANODE_FILES cannot be used with ENCODING")));
+#endif
+
 	/* Check header */
 	if (!cstate->csv_mode && cstate->header_line)
 		ereport(ERROR,
@@ -1808,6 +1853,25 @@ BeginCopy(ParseState *pstate,
 		}
 	}
 
+#ifdef PGXC
+	/*
+	 * The Coordinator sends input lines to the Datanodes as they are, text or
+	 * binary, and they convert the values anyway. Only distribution column
+	 * value is needed here to route the line, so do not waste time converting
+	 * the rest of the fields. Malformed values are reported by the Datanodes.
+	 */
+	if (is_from && IS_PGXC_COORDINATOR &&
+			!cstate->convert_selectively &&
+			cstate->remoteCopyState && cstate->remoteCopyState->rel_loc)
+	{
+		AttrNumber	dist_col = cstate->remoteCopyState->rel_loc->partAttrNum;
+
+		cstate->convert_select_flags = (bool *) palloc0(num_phys_attrs * sizeof(bool));
+		if (AttributeNumberIsValid(dist_col))
+			cstate->convert_select_flags[dist_col - 1] = true;
+	}
+#endif
+
 	/* Use client encoding when ENCODING option is not specified. */
 	if (cstate->file_encoding < 0)
 		cstate->file_encoding = pg_get_client_encoding();
@@ -1836,9 +1900,11 @@ BeginCopy(ParseState *pstate,
 
 		/*
 		 * In the case of CopyOut, it is just necessary to pick up one node randomly.
-		 * This is done when rel_loc is found.
+		 * This is done when rel_loc is found. With DATANODE_FILES the
+		 * connections are taken once the statement of each node is known.
 		 */
-		if (remoteCopyState && remoteCopyState->rel_loc)
+		if (remoteCopyState && remoteCopyState->rel_loc &&
+			!cstate->datanode_files)
 		{
 			DataNodeCopyBegin(remoteCopyState);
 			if (!remoteCopyState->locator)
@@ -1889,7 +1955,9 @@ EndCopy(CopyState cstate)
 	}
 	else
 	{
-		if (cstate->filename != NULL && FreeFile(cstate->copy_file))
+		/* No file is open locally when the Datanodes wrote the output */
+		if (cstate->filename != NULL && cstate->copy_file != NULL &&
+			FreeFile(cstate->copy_file))
 			ereport(ERROR,
 					(errcode_for_file_access(),
 					 errmsg("could not close file \"%s\": %m",
@@ -1959,6 +2027,36 @@ BeginCopyTo(ParseState *pstate,
 					   options);
 	oldcontext = MemoryContextSwitchTo(cstate->copycontext);
 
+#ifdef PGXC
+	/*
+	 * With DATANODE_FILES the Datanodes write the output themselves and
+	 * nothing is opened here.
+	 */
+	if (cstate->datanode_files)
+	{
+		if (pipe)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("COPY DATANODE_FILES requires a file name or a program")));
+		if (cstate->rel == NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("COPY (query) TO with DATANODE_FILES is not supported")));
+		if (!IS_PGXC_COORDINATOR ||
+			cstate->remoteCopyState == NULL ||
+			cstate->remoteCopyState->rel_loc == NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("COPY DATANODE_FILES is available only for tables distributed on Datanodes")));
+
+		BuildDataNodeCopyTo(cstate, filename, is_program, attnamelist);
+		cstate->filename = pstrdup(filename);
+
+		MemoryContextSwitchTo(oldcontext);
+		return cstate;
+	}
+#endif
+
 	if (pipe)
 	{
 		Assert(!is_program);	/* the grammar does not allow this */
@@ -2197,7 +2295,10 @@ CopyTo(CopyState cstate)
 	}
 
 #ifdef PGXC
-	if (IS_PGXC_COORDINATOR &&
+	if (cstate->datanode_files)
+		processed = DataNodeCopyToFiles(cstate->datanode_list,
+										cstate->datanode_queries);
+	else if (IS_PGXC_COORDINATOR &&
 		cstate->remoteCopyState &&
 		cstate->remoteCopyState->rel_loc)
 	{
@@ -2502,6 +2603,20 @@ CopyFrom(CopyState cstate)
 	HeapTuple  *bufferedTuples = NULL;	/* initialize to silence warning */
 	Size		bufferedTuplesSize = 0;
 	int			firstBufferedLineNo = 0;
+#ifdef PGXC
+	/*
+	 * Lines to be sent to the Datanodes are collected to determine their
+	 * target nodes all at once, if the locator supports that.
+	 */
+	bool		useBatchRouting = false;
+	int			nRoutedLines = 0;
+	Size		routedLinesSize = 0;
+	char	  **routedLines = NULL;
+	int		   *routedLens = NULL;
+	Datum	   *routedValues = NULL;
+	bool	   *routedNulls = NULL;
+	int		   *routedIndexes = NULL;
+#endif
 
 	Assert(cstate->rel);
 
@@ -2645,13 +2760,19 @@ CopyFrom(CopyState cstate)
 	 * BEFORE/INSTEAD OF triggers, or we need to evaluate volatile default
 	 * expressions. Such triggers or expressions might query the table we're
 	 * inserting to, and act differently if the tuples that have already been
-	 * processed and prepared for insertion are not there.  We also can't do
-	 * it if the table is partitioned.
+	 * processed and prepared for insertion are not there.
+	 *
+	 * If the table is partitioned, the buffer only ever holds tuples routed
+	 * to the same leaf partition, and is flushed whenever a tuple goes to
+	 * another one; see below for the partitions that cannot use it.  We
+	 * don't bother when capturing transition tuples, whose conversion back
+	 * to the parent rowtype is set up tuple by tuple.
 	 */
 	if ((resultRelInfo->ri_TrigDesc != NULL &&
 		 (resultRelInfo->ri_TrigDesc->trig_insert_before_row ||
 		  resultRelInfo->ri_TrigDesc->trig_insert_instead_row)) ||
-		cstate->partition_dispatch_info != NULL ||
+		(cstate->partition_dispatch_info != NULL &&
+		 cstate->transition_capture != NULL) ||
 		cstate->volatile_defexprs)
 	{
 		useHeapMultiInsert = false;
@@ -2679,6 +2800,19 @@ CopyFrom(CopyState cstate)
 	bistate = GetBulkInsertState();
 	econtext = GetPerTupleExprContext(estate);
 
+#ifdef PGXC
+	if (IS_PGXC_COORDINATOR && cstate->remoteCopyState->rel_loc &&
+			canLocateBatch(cstate->remoteCopyState->locator))
+	{
+		useBatchRouting = true;
+		routedLines = (char **) palloc(MAX_BUFFERED_TUPLES * sizeof(char *));
+		routedLens = (int *) palloc(MAX_BUFFERED_TUPLES * sizeof(int));
+		routedValues = (Datum *) palloc(MAX_BUFFERED_TUPLES * sizeof(Datum));
+		routedNulls = (bool *) palloc(MAX_BUFFERED_TUPLES * sizeof(bool));
+		routedIndexes = (int *) palloc(MAX_BUFFERED_TUPLES * sizeof(int));
+	}
+#endif
+
 	/* Set up callback to identify error line number */
 	errcallback.callback = CopyFromErrorCallback;
 	errcallback.arg = (void *) cstate;
@@ -2689,11 +2823,16 @@ CopyFrom(CopyState cstate)
 	{
 		TupleTableSlot *slot;
 		bool		skip_tuple;
+		bool		buffer_tuple = useHeapMultiInsert;
 		Oid			loaded_oid = InvalidOid;
 
 		CHECK_FOR_INTERRUPTS();
 
+#ifdef PGXC
+		if (nBufferedTuples == 0 && nRoutedLines == 0)
+#else
 		if (nBufferedTuples == 0)
+#endif
 		{
 			/*
 			 * Reset the per-tuple exprcontext. We can only do this if the
@@ -2727,7 +2866,33 @@ CopyFrom(CopyState cstate)
 				isnull = nulls[dist_col-1];
 			}
 
-			if (DataNodeCopyIn(cstate->line_buf.data,
+			if (useBatchRouting)
+			{
+				/*
+				 * The line and the value are in the per-tuple memory, which
+				 * is not reset until the lines are sent.
+				 */
+				routedLines[nRoutedLines] = (char *) palloc(cstate->line_buf.len);
+				memcpy(routedLines[nRoutedLines], cstate->line_buf.data,
+					   cstate->line_buf.len);
+				routedLens[nRoutedLines] = cstate->line_buf.len;
+				routedValues[nRoutedLines] = value;
+				routedNulls[nRoutedLines] = isnull;
+				nRoutedLines++;
+				routedLinesSize += cstate->line_buf.len;
+
+				/* Send down if the buffer is full, limits are as for tuples */
+				if (nRoutedLines == MAX_BUFFERED_TUPLES ||
+					routedLinesSize > 65535)
+				{
+					CopyFromRouteBatch(cstate, nRoutedLines, routedLines,
+									   routedLens, routedValues, routedNulls,
+									   routedIndexes);
+					nRoutedLines = 0;
+					routedLinesSize = 0;
+				}
+			}
+			else if (DataNodeCopyIn(cstate->line_buf.data,
 							   cstate->line_buf.len,
 							   GET_NODES(rcstate->locator, value, isnull, NULL),
 							   (PGXCNodeHandle**) getLocatorResults(rcstate->locator),
@@ -2782,13 +2947,33 @@ CopyFrom(CopyState cstate)
 
 			/*
 			 * If this tuple is mapped to a partition that is not same as the
-			 * previous one, we'd better make the bulk insert mechanism gets a
-			 * new buffer.
+			 * previous one, the tuples buffered so far must be written to
+			 * the previous one, and we'd better make the bulk insert
+			 * mechanism gets a new buffer.
+			 *
+			 * The tuple itself is inserted right away then, so that the
+			 * per-tuple memory context can be reset before the next one even
+			 * if every tuple goes to a different partition.
 			 */
 			if (prev_leaf_part_index != leaf_part_index)
 			{
+				if (nBufferedTuples > 0)
+				{
+					ResultRelInfo *prevResultRelInfo;
+
+					prevResultRelInfo = cstate->partitions + prev_leaf_part_index;
+					estate->es_result_relation_info = prevResultRelInfo;
+					CopyFromInsertBatch(cstate, estate, mycid, hi_options,
+										prevResultRelInfo, myslot, bistate,
+										nBufferedTuples, bufferedTuples,
+										firstBufferedLineNo);
+					estate->es_result_relation_info = resultRelInfo;
+					nBufferedTuples = 0;
+					bufferedTuplesSize = 0;
+				}
 				ReleaseBulkInsertStatePin(bistate);
 				prev_leaf_part_index = leaf_part_index;
+				buffer_tuple = false;
 			}
 
 			/*
@@ -2844,6 +3029,19 @@ CopyFrom(CopyState cstate)
 			 * partition rowtype.
 			 */
 			map = cstate->partition_tupconv_maps[leaf_part_index];
+
+			/*
+			 * A converted tuple is owned by the partition's slot, which
+			 * frees it when the next one is stored, so it cannot stay in the
+			 * buffer.  Nor can tuples going to a partition with BEFORE ROW
+			 * or INSTEAD OF triggers, for the same reasons as above.
+			 */
+			if (map != NULL ||
+				(resultRelInfo->ri_TrigDesc != NULL &&
+				 (resultRelInfo->ri_TrigDesc->trig_insert_before_row ||
+				  resultRelInfo->ri_TrigDesc->trig_insert_instead_row)))
+				buffer_tuple = false;
+
 			if (map)
 			{
 				Relation	partrel = resultRelInfo->ri_RelationDesc;
@@ -2908,7 +3106,7 @@ CopyFrom(CopyState cstate)
 				if (cstate->rel->rd_att->constr || check_partition_constr)
 					ExecConstraints(resultRelInfo, slot, estate);
 
-				if (useHeapMultiInsert)
+				if (buffer_tuple)
 				{
 					/* Add this tuple to the tuple buffer */
 					if (nBufferedTuples == 0)
@@ -2975,12 +3173,28 @@ CopyFrom(CopyState cstate)
 #endif
 	}
 
+#ifdef PGXC
+	/* Send down any remaining buffered lines */
+	if (nRoutedLines > 0)
+		CopyFromRouteBatch(cstate, nRoutedLines, routedLines, routedLens,
+						   routedValues, routedNulls, routedIndexes);
+#endif
+
 	/* Flush any remaining buffered tuples */
 	if (nBufferedTuples > 0)
+	{
+		ResultRelInfo *batchResultRelInfo = resultRelInfo;
+
+		/* With tuple routing, they all belong to the last partition used */
+		if (cstate->partition_dispatch_info)
+			batchResultRelInfo = cstate->partitions + prev_leaf_part_index;
+		estate->es_result_relation_info = batchResultRelInfo;
 		CopyFromInsertBatch(cstate, estate, mycid, hi_options,
-							resultRelInfo, myslot, bistate,
+							batchResultRelInfo, myslot, bistate,
 							nBufferedTuples, bufferedTuples,
 							firstBufferedLineNo);
+		estate->es_result_relation_info = resultRelInfo;
+	}
 
 #ifdef XCP
 	/*
@@ -3074,6 +3288,35 @@ CopyFrom(CopyState cstate)
 	return processed;
 }
 
+#ifdef PGXC
+/*
+ * A subroutine of CopyFrom, to send the current batch of buffered lines to
+ * the Datanodes. Target nodes of all the lines are determined at once.
+ */
+static void
+CopyFromRouteBatch(CopyState cstate, int nRoutedLines, char **routedLines,
+				   int *routedLens, Datum *routedValues, bool *routedNulls,
+				   int *routedIndexes)
+{
+	RemoteCopyData *rcstate = cstate->remoteCopyState;
+	PGXCNodeHandle **connections;
+	int			i;
+
+	GET_NODES_BATCH(rcstate->locator, nRoutedLines, routedValues,
+					routedNulls, routedIndexes);
+
+	connections = (PGXCNodeHandle **) getLocatorNodeMap(rcstate->locator);
+	for (i = 0; i < nRoutedLines; i++)
+	{
+		if (DataNodeCopyIn(routedLines[i], routedLens[i], 1,
+						   &connections[routedIndexes[i]], cstate->binary))
+			ereport(ERROR,
+					(errcode(ERRCODE_CONNECTION_EXCEPTION),
+					 errmsg("Copy failed on a data node")));
+	}
+}
+#endif
+
 /*
  * A subroutine of CopyFrom, to write the current batch of buffered heap
  * tuples to the heap. Also updates indexes and runs AFTER ROW INSERT
@@ -3102,7 +3345,7 @@ CopyFromInsertBatch(CopyState cstate, EState *estate, CommandId mycid,
 	 * before calling it.
 	 */
 	oldcontext = MemoryContextSwitchTo(GetPerTupleMemoryContext(estate));
-	heap_multi_insert(cstate->rel,
+	heap_multi_insert(resultRelInfo->ri_RelationDesc,
 					  bufferedTuples,
 					  nBufferedTuples,
 					  mycid,
@@ -3800,7 +4043,9 @@ NextCopyFrom(CopyState cstate, ExprContext *econtext,
 			i++;
 			values[m] = CopyReadBinaryAttribute(cstate,
 												i,
-												&in_functions[m],
+												(cstate->convert_select_flags &&
+												 !cstate->convert_select_flags[m]) ?
+												NULL : &in_functions[m],
 												typioparams[m],
 												attr[m]->atttypmod,
 												&nulls[m]);
@@ -4043,6 +4288,7 @@ CopyReadLineText(CopyState cstate)
 	bool		hit_eof = false;
 	bool		result = false;
 	char		mblen_str[2];
+	int			vector_resume_ptr = 0;
 
 	/* CSV variables */
 	bool		first_char_in_line = true;
@@ -4113,6 +4359,7 @@ CopyReadLineText(CopyState cstate)
 			if (!CopyLoadRawBuf(cstate))
 				hit_eof = true;
 			raw_buf_ptr = 0;
+			vector_resume_ptr = 0;
 			copy_buf_len = cstate->raw_buf_len;
 
 			/*
@@ -4127,6 +4374,37 @@ CopyReadLineText(CopyState cstate)
 			need_data = false;
 		}
 
+		/*
+		 * Skip over whole blocks of bytes none of which needs a look: no
+		 * newline characters, backslashes, CSV quote or escape characters,
+		 * nor bytes that may start a multi-byte character embedding ASCII.
+		 * Once a block has something of interest, we go through it a byte
+		 * at a time below, and only try the vector path again after it.
+		 */
+		while (raw_buf_ptr >= vector_resume_ptr &&
+			   raw_buf_ptr + (int) sizeof(Vector8) <= copy_buf_len)
+		{
+			Vector8		chunk;
+
+			vector8_load(&chunk, (const uint8 *) copy_raw_buf + raw_buf_ptr);
+			if (vector8_has(chunk, '\n') ||
+				vector8_has(chunk, '\r') ||
+				vector8_has(chunk, '\\') ||
+				(cstate->csv_mode &&
+				 (vector8_has(chunk, quotec) ||
+				  (escapec != '\0' && vector8_has(chunk, escapec)))) ||
+				(cstate->encoding_embeds_ascii && vector8_is_highbit_set(chunk)))
+			{
+				vector_resume_ptr = raw_buf_ptr + sizeof(Vector8);
+				break;
+			}
+			raw_buf_ptr += sizeof(Vector8);
+			first_char_in_line = false;
+			last_was_esc = false;
+		}
+		if (raw_buf_ptr >= copy_buf_len)
+			continue;
+
 		/* OK to fetch a character */
 		prev_raw_ptr = raw_buf_ptr;
 		c = copy_raw_buf[raw_buf_ptr++];
@@ -4428,6 +4706,7 @@ CopyReadAttributesText(CopyState cstate)
 	char	   *output_ptr;
 	char	   *cur_ptr;
 	char	   *line_end_ptr;
+	char	   *vector_resume_ptr;
 
 	/*
 	 * We need a special case for zero-column tables: check that the input
@@ -4457,6 +4736,7 @@ CopyReadAttributesText(CopyState cstate)
 
 	/* set pointer variables for loop */
 	cur_ptr = cstate->line_buf.data;
+	vector_resume_ptr = cur_ptr;
 	line_end_ptr = cstate->line_buf.data + cstate->line_buf.len;
 
 	/* Outer loop iterates over fields */
@@ -4496,6 +4776,27 @@ CopyReadAttributesText(CopyState cstate)
 		{
 			char		c;
 
+			/*
+			 * Copy whole blocks of bytes with neither delimiters nor
+			 * backslashes in them at once.  As in CopyReadLineText, a block
+			 * that has any is gone through a byte at a time.
+			 */
+			while (cur_ptr >= vector_resume_ptr &&
+				   line_end_ptr - cur_ptr >= (int) sizeof(Vector8))
+			{
+				Vector8		chunk;
+
+				vector8_load(&chunk, (const uint8 *) cur_ptr);
+				if (vector8_has(chunk, delimc) || vector8_has(chunk, '\\'))
+				{
+					vector_resume_ptr = cur_ptr + sizeof(Vector8);
+					break;
+				}
+				memcpy(output_ptr, cur_ptr, sizeof(Vector8));
+				output_ptr += sizeof(Vector8);
+				cur_ptr += sizeof(Vector8);
+			}
+
 			end_ptr = cur_ptr;
 			if (cur_ptr >= line_end_ptr)
 				break;
@@ -4658,6 +4959,7 @@ CopyReadAttributesCSV(CopyState cstate)
 	char	   *output_ptr;
 	char	   *cur_ptr;
 	char	   *line_end_ptr;
+	char	   *vector_resume_ptr;
 
 	/*
 	 * We need a special case for zero-column tables: check that the input
@@ -4687,6 +4989,7 @@ CopyReadAttributesCSV(CopyState cstate)
 
 	/* set pointer variables for loop */
 	cur_ptr = cstate->line_buf.data;
+	vector_resume_ptr = cur_ptr;
 	line_end_ptr = cstate->line_buf.data + cstate->line_buf.len;
 
 	/* Outer loop iterates over fields */
@@ -4725,6 +5028,23 @@ CopyReadAttributesCSV(CopyState cstate)
 			/* Not in quote */
 			for (;;)
 			{
+				/* Copy blocks without delimiters or quotes at once */
+				while (cur_ptr >= vector_resume_ptr &&
+					   line_end_ptr - cur_ptr >= (int) sizeof(Vector8))
+				{
+					Vector8		chunk;
+
+					vector8_load(&chunk, (const uint8 *) cur_ptr);
+					if (vector8_has(chunk, delimc) || vector8_has(chunk, quotec))
+					{
+						vector_resume_ptr = cur_ptr + sizeof(Vector8);
+						break;
+					}
+					memcpy(output_ptr, cur_ptr, sizeof(Vector8));
+					output_ptr += sizeof(Vector8);
+					cur_ptr += sizeof(Vector8);
+				}
+
 				end_ptr = cur_ptr;
 				if (cur_ptr >= line_end_ptr)
 					goto endfield;
@@ -4748,6 +5068,23 @@ CopyReadAttributesCSV(CopyState cstate)
 			/* In quote */
 			for (;;)
 			{
+				/* Copy blocks without quotes or escapes at once */
+				while (cur_ptr >= vector_resume_ptr &&
+					   line_end_ptr - cur_ptr >= (int) sizeof(Vector8))
+				{
+					Vector8		chunk;
+
+					vector8_load(&chunk, (const uint8 *) cur_ptr);
+					if (vector8_has(chunk, quotec) || vector8_has(chunk, escapec))
+					{
+						vector_resume_ptr = cur_ptr + sizeof(Vector8);
+						break;
+					}
+					memcpy(output_ptr, cur_ptr, sizeof(Vector8));
+					output_ptr += sizeof(Vector8);
+					cur_ptr += sizeof(Vector8);
+				}
+
 				end_ptr = cur_ptr;
 				if (cur_ptr >= line_end_ptr)
 					ereport(ERROR,
@@ -4816,6 +5153,9 @@ endfield:
 
 /*
  * Read a binary attribute
+ *
+ * If flinfo is NULL the value is not converted, only copied to the data row
+ * sent to the Datanodes, and returned as NULL.
  */
 static Datum
 CopyReadBinaryAttribute(CopyState cstate,
@@ -4848,6 +5188,8 @@ CopyReadBinaryAttribute(CopyState cstate,
 	if (fld_size == -1)
 	{
 		*isnull = true;
+		if (flinfo == NULL)
+			return (Datum) 0;
 		return ReceiveFunctionCall(flinfo, NULL, typioparam, typmod);
 	}
 	if (fld_size < 0)
@@ -4875,6 +5217,12 @@ CopyReadBinaryAttribute(CopyState cstate,
 	}
 #endif
 
+	if (flinfo == NULL)
+	{
+		*isnull = true;
+		return (Datum) 0;
+	}
+
 	/* Call the column type's binary input converter */
 	result = ReceiveFunctionCall(flinfo, &cstate->attribute_buf,
 								 typioparam, typmod);
@@ -5287,6 +5635,7 @@ GetRemoteCopyOptions(CopyState cstate)
 	/* Then fill in structure */
 	res->rco_binary = cstate->binary;
 	res->rco_oids = cstate->oids;
+	res->rco_freeze = cstate->freeze;
 	res->rco_csv_mode = cstate->csv_mode;
 	if (cstate->delim)
 		res->rco_delim = pstrdup(cstate->delim);
@@ -5303,4 +5652,75 @@ GetRemoteCopyOptions(CopyState cstate)
 
 	return res;
 }
+
+/*
+ * Build the COPY TO statement of each Datanode for DATANODE_FILES. Every
+ * occurrence of %n in the file name or command is replaced by the name of
+ * the node, so that each node writes to a destination of its own. A
+ * replicated table is written only once, by its first node.
+ */
+static void
+BuildDataNodeCopyTo(CopyState cstate, const char *filename, bool is_program,
+					List *attnamelist)
+{
+	RelationLocInfo *rel_loc = cstate->remoteCopyState->rel_loc;
+	TupleDesc	tupDesc = RelationGetDescr(cstate->rel);
+	List	   *attnums = CopyGetAttnums(tupDesc, cstate->rel, attnamelist);
+	ListCell   *lc;
+
+	if (IsRelationReplicated(rel_loc))
+		cstate->datanode_list = list_make1_int(linitial_int(rel_loc->rl_nodeList));
+	else
+		cstate->datanode_list = list_copy(rel_loc->rl_nodeList);
+
+	if (!is_program && list_length(cstate->datanode_list) > 1 &&
+		strstr(filename, "%n") == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("file name of COPY DATANODE_FILES must contain %%n"),
+				 errhint("%%n is replaced by the name of each Datanode.")));
+
+	cstate->datanode_queries = NIL;
+	foreach(lc, cstate->datanode_list)
+	{
+		RemoteCopyData node_state;
+		RemoteCopyOptions *options;
+		Oid			nodeoid;
+		char	   *nodename;
+		StringInfoData target;
+		const char *p;
+
+		nodeoid = PGXCNodeGetNodeOid(lfirst_int(lc), PGXC_NODE_DATANODE);
+		nodename = get_pgxc_nodename(nodeoid);
+
+		initStringInfo(&target);
+		for (p = filename; *p; p++)
+		{
+			if (p[0] == '%' && p[1] == 'n')
+			{
+				appendStringInfoString(&target, nodename);
+				p++;
+			}
+			else
+				appendStringInfoChar(&target, *p);
+		}
+
+		options = GetRemoteCopyOptions(cstate);
+		if (is_program)
+			options->rco_target = psprintf("PROGRAM %s",
+										   quote_literal_cstr(target.data));
+		else
+			options->rco_target = quote_literal_cstr(target.data);
+
+		memset(&node_state, 0, sizeof(RemoteCopyData));
+		node_state.is_from = false;
+		RemoteCopy_BuildStatement(&node_state, cstate->rel, options,
+								  attnamelist, attnums);
+		cstate->datanode_queries = lappend(cstate->datanode_queries,
+										   node_state.query_buf.data);
+
+		FreeRemoteCopyOptions(options);
+		pfree(target.data);
+	}
+}
 #endif
@@ -33,6 +33,7 @@
 #include "utils/builtins.h"
 #include "utils/json.h"
 #include "utils/lsyscache.h"
+#include "utils/memutils.h"
 #include "utils/rel.h"
 #include "utils/ruleutils.h"
 #include "utils/snapmgr.h"
@@ -89,6 +90,8 @@ static void show_sort_keys(SortState *sortstate, List *ancestors,
 			   ExplainState *es);
 static void show_simple_sort_keys(RemoteSubplanState *remotestate,
 			   List *ancestors, ExplainState *es);
+static void show_remote_instrumentation(RemoteSubplanState *remotestate,
+							ExplainState *es);
 static void show_merge_append_keys(MergeAppendState *mstate, List *ancestors,
 					   ExplainState *es);
 static void show_agg_keys(AggState *astate, List *ancestors,
@@ -602,6 +605,19 @@ ExplainOnePlan(PlannedStmt *plannedstmt, IntoClause *into, ExplainState *es,
 	if (es->analyze)
 		ExplainPrintTriggers(es, queryDesc);
 
+	/* Memory still held by the executor, which includes its hash tables */
+	if (es->summary && es->analyze)
+	{
+		long		memkb;
+
+		memkb = (MemoryContextMemAllocated(queryDesc->estate->es_query_cxt,
+										   true) + 1023) / 1024;
+		if (es->format == EXPLAIN_FORMAT_TEXT)
+			appendStringInfo(es->str, "Executor memory: %ldkB\n", memkb);
+		else
+			ExplainPropertyLong("Executor Memory", memkb, es);
+	}
+
 	/*
 	 * Close down the query and free resources.  Include time for this in the
 	 * total execution time (although it should be pretty minimal).
@@ -1048,7 +1064,10 @@ ExplainNode(PlanState *planstate, List *ancestors,
 			pname = sname = "Materialize";
 			break;
 		case T_Sort:
-			pname = sname = "Sort";
+			if (((Sort *) plan)->numPresortedCols > 0)
+				pname = sname = "Incremental Sort";
+			else
+				pname = sname = "Sort";
 			break;
 		case T_Group:
 			pname = sname = "Group";
@@ -1547,6 +1566,21 @@ ExplainNode(PlanState *planstate, List *ancestors,
 												planstate, ancestors,
 												false, es);
 						}
+						if (rsubplan->skewValues)
+						{
+							appendStringInfoSpaces(es->str, es->indent * 2);
+							appendStringInfo(es->str, "%s %d hot values\n",
+											 rsubplan->skewBroadcast ?
+											 "Broadcast" : "Spread",
+											 list_length(rsubplan->skewValues));
+						}
+						if (rsubplan->bloomKeyNo > 0)
+						{
+							appendStringInfoSpaces(es->str, es->indent * 2);
+							appendStringInfo(es->str,
+											 "Filtered by join key %d\n",
+											 rsubplan->bloomKeyNo);
+						}
 					}
 				}
 
@@ -1554,6 +1588,38 @@ ExplainNode(PlanState *planstate, List *ancestors,
 				if (es->verbose)
 					show_simple_sort_keys((RemoteSubplanState *)planstate,
 										  ancestors, es);
+
+				/* report how many rows were requested at a time */
+				if (es->analyze && rsubplan->cursor)
+				{
+					ResponseCombiner *combiner =
+						&((RemoteSubplanState *) planstate)->combiner;
+
+					if (combiner->fetch_size_initial > 0)
+					{
+						if (es->format == EXPLAIN_FORMAT_TEXT)
+						{
+							appendStringInfoSpaces(es->str, es->indent * 2);
+							appendStringInfo(es->str,
+											 "Remote Fetch Size: %d..%d rows\n",
+											 combiner->fetch_size_initial,
+											 combiner->fetch_size);
+						}
+						else
+						{
+							ExplainPropertyInteger("Initial Fetch Size",
+												   combiner->fetch_size_initial,
+												   es);
+							ExplainPropertyInteger("Final Fetch Size",
+												   combiner->fetch_size, es);
+						}
+					}
+				}
+
+				/* add figures reported by the nodes */
+				if (es->analyze)
+					show_remote_instrumentation((RemoteSubplanState *) planstate,
+												es);
 			}
 			break;
 #endif
@@ -2085,6 +2151,10 @@ show_sort_keys(SortState *sortstate, List *ancestors, ExplainState *es)
 						 plan->sortOperators, plan->collations,
 						 plan->nullsFirst,
 						 ancestors, es);
+	show_sort_group_keys((PlanState *) sortstate, "Presorted Key",
+						 plan->numPresortedCols, plan->sortColIdx,
+						 NULL, NULL, NULL,
+						 ancestors, es);
 }
 
 /*
@@ -2109,6 +2179,132 @@ show_simple_sort_keys(RemoteSubplanState *planstate, List *ancestors, ExplainSta
 						 ancestors, es);
 }
 
+/*
+ * Show the execution statistics each node reported for the fragment below a
+ * RemoteSubplan, and the spread of them across the nodes, to tell the skew.
+ */
+static void
+show_remote_instrumentation(RemoteSubplanState *remotestate, ExplainState *es)
+{
+	ListCell   *lc;
+	int			nnodes = 0;
+	double		min_rows = 0.0,
+				max_rows = 0.0,
+				sum_rows = 0.0;
+	double		min_time = 0.0,
+				max_time = 0.0,
+				sum_time = 0.0;
+
+	if (remotestate->remote_instr == NIL)
+		return;
+
+	ExplainOpenGroup("Remote Nodes", "Remote Nodes", false, es);
+	foreach(lc, remotestate->remote_instr)
+	{
+		RemoteInstrumentation *instr = (RemoteInstrumentation *) lfirst(lc);
+		char	   *nodename = get_pgxc_nodename(instr->nodeoid);
+		double		nloops = instr->nloops;
+		double		startup_ms = 0.0;
+		double		total_ms = 0.0;
+		double		rows = 0.0;
+
+		if (nloops > 0)
+		{
+			startup_ms = 1000.0 * instr->startup / nloops;
+			total_ms = 1000.0 * instr->total / nloops;
+			rows = instr->ntuples / nloops;
+		}
+
+		if (nnodes == 0 || rows < min_rows)
+			min_rows = rows;
+		if (nnodes == 0 || rows > max_rows)
+			max_rows = rows;
+		if (nnodes == 0 || total_ms < min_time)
+			min_time = total_ms;
+		if (nnodes == 0 || total_ms > max_time)
+			max_time = total_ms;
+		sum_rows += rows;
+		sum_time += total_ms;
+		nnodes++;
+
+		ExplainOpenGroup("Remote Node", NULL, true, es);
+		if (es->format == EXPLAIN_FORMAT_TEXT)
+		{
+			appendStringInfoSpaces(es->str, es->indent * 2);
+			if (nloops <= 0)
+				appendStringInfo(es->str, "Node %s: never executed\n",
+								 nodename);
+			else if (es->timing)
+				appendStringInfo(es->str,
+								 "Node %s: actual time=%.3f..%.3f rows=%.0f loops=%.0f\n",
+								 nodename, startup_ms, total_ms, rows, nloops);
+			else
+				appendStringInfo(es->str,
+								 "Node %s: actual rows=%.0f loops=%.0f\n",
+								 nodename, rows, nloops);
+			if (es->buffers)
+			{
+				es->indent++;
+				show_buffer_usage(es, &instr->bufusage);
+				es->indent--;
+			}
+			if (es->summary && nloops > 0)
+			{
+				appendStringInfoSpaces(es->str, es->indent * 2 + 2);
+				appendStringInfo(es->str, "Memory: %ldkB\n",
+								 (long) ((instr->memory + 1023) / 1024));
+			}
+		}
+		else
+		{
+			ExplainPropertyText("Node Name", nodename, es);
+			if (es->timing)
+			{
+				ExplainPropertyFloat("Actual Startup Time", startup_ms, 3, es);
+				ExplainPropertyFloat("Actual Total Time", total_ms, 3, es);
+			}
+			ExplainPropertyFloat("Actual Rows", rows, 0, es);
+			ExplainPropertyFloat("Actual Loops", nloops, 0, es);
+			if (es->buffers)
+				show_buffer_usage(es, &instr->bufusage);
+			if (es->summary)
+				ExplainPropertyLong("Memory",
+									(long) ((instr->memory + 1023) / 1024), es);
+		}
+		ExplainCloseGroup("Remote Node", NULL, true, es);
+	}
+	ExplainCloseGroup("Remote Nodes", "Remote Nodes", false, es);
+
+	if (nnodes < 2)
+		return;
+
+	if (es->format == EXPLAIN_FORMAT_TEXT)
+	{
+		appendStringInfoSpaces(es->str, es->indent * 2);
+		appendStringInfo(es->str, "Node Rows: min=%.0f avg=%.0f max=%.0f\n",
+						 min_rows, sum_rows / nnodes, max_rows);
+		if (es->timing)
+		{
+			appendStringInfoSpaces(es->str, es->indent * 2);
+			appendStringInfo(es->str,
+							 "Node Time: min=%.3f avg=%.3f max=%.3f\n",
+							 min_time, sum_time / nnodes, max_time);
+		}
+	}
+	else
+	{
+		ExplainPropertyFloat("Min Node Rows", min_rows, 0, es);
+		ExplainPropertyFloat("Avg Node Rows", sum_rows / nnodes, 0, es);
+		ExplainPropertyFloat("Max Node Rows", max_rows, 0, es);
+		if (es->timing)
+		{
+			ExplainPropertyFloat("Min Node Time", min_time, 3, es);
+			ExplainPropertyFloat("Avg Node Time", sum_time / nnodes, 3, es);
+			ExplainPropertyFloat("Max Node Time", max_time, 3, es);
+		}
+	}
+}
+
 /*
  * Likewise, for a MergeAppend node.
  */
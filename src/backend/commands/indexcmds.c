@@ -45,8 +45,13 @@
 #include "parser/parse_func.h"
 #include "parser/parse_oper.h"
 #ifdef PGXC
+#include "executor/executor.h"
+#include "funcapi.h"
+#include "nodes/makefuncs.h"
 #include "parser/parse_utilcmd.h"
+#include "pgxc/execRemote.h"
 #include "pgxc/pgxc.h"
+#include "pgxc/planner.h"
 #endif
 #include "storage/lmgr.h"
 #include "storage/proc.h"
@@ -2067,3 +2072,108 @@ ReindexMultipleTables(const char *objectName, ReindexObjectType objectKind,
 
 	MemoryContextDelete(private_context);
 }
+
+#ifdef PGXC
+/*
+ * pgxc_stat_get_progress_create_index
+ *
+ * Return the progress of the index builds running on all the Datanodes,
+ * as shown there by pg_stat_progress_create_index, backing
+ * pg_stat_progress_create_index_cluster.  The tables are identified by
+ * name, OIDs are not the same on all the nodes.
+ */
+Datum
+pgxc_stat_get_progress_create_index(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	RemoteQuery *step;
+	RemoteQueryState *node;
+	EState	   *estate;
+	TupleTableSlot *result;
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	if (!IS_PGXC_COORDINATOR)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("pgxc_stat_get_progress_create_index() can only be called on a Coordinator")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	step = makeNode(RemoteQuery);
+	step->combine_type = COMBINE_TYPE_NONE;
+	step->exec_nodes = NULL;
+	step->sql_statement =
+		"SELECT pgxc_node_str()::text, pid, datname, relid::regclass::text, "
+		"phase, tuples_scanned, tuples_loaded "
+		"FROM pg_stat_progress_create_index";
+	step->force_autocommit = false;
+	step->read_only = true;
+	step->exec_type = EXEC_ON_DATANODES;
+
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Var		   *var;
+
+		var = makeVar(1, i + 1,
+					  tupdesc->attrs[i]->atttypid,
+					  tupdesc->attrs[i]->atttypmod,
+					  InvalidOid,
+					  0);
+		step->scan.plan.targetlist = lappend(step->scan.plan.targetlist,
+											 makeTargetEntry((Expr *) var,
+															 i + 1,
+															 NULL,
+															 false));
+	}
+
+	estate = CreateExecutorState();
+
+	oldcontext = MemoryContextSwitchTo(estate->es_query_cxt);
+	estate->es_snapshot = GetActiveSnapshot();
+	node = ExecInitRemoteQuery(step, estate, 0);
+	MemoryContextSwitchTo(oldcontext);
+
+	result = ExecRemoteQuery((PlanState *) node);
+	while (result != NULL && !TupIsNull(result))
+	{
+		slot_getallattrs(result);
+		tuplestore_putvalues(tupstore, tupdesc, result->tts_values,
+							 result->tts_isnull);
+
+		result = ExecRemoteQuery((PlanState *) node);
+	}
+	ExecEndRemoteQuery(node);
+	FreeExecutorState(estate);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+#endif
@@ -39,8 +39,11 @@
 #include "nodes/makefuncs.h"
 #include "parser/parse_type.h"
 #include "storage/lmgr.h"
+#include "storage/lwlock.h"
 #include "storage/proc.h"
+#include "storage/shmem.h"
 #include "storage/smgr.h"
+#include "storage/spin.h"
 #include "utils/acl.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
@@ -75,6 +78,7 @@
 #ifdef XCP
 
 int			SequenceRangeVal = 1;
+int			SharedSequenceRanges = 0;
 #endif
 
 typedef struct sequence_magic
@@ -109,6 +113,57 @@ typedef SeqTableData *SeqTable;
 
 static HTAB *seqhashtab = NULL; /* hash table for SeqTable items */
 
+#ifdef XCP
+/*
+ * With shared_sequence_ranges set, the values a backend gets from GTM are not
+ * kept in its SeqTable but handed out to all the backends of the node through
+ * a SeqRange in shared memory. Besides the range being used, a SeqRange holds
+ * a range prefetched by the backend which saw the current one drop below a
+ * quarter of the lease, so that the other backends keep going meanwhile.
+ * The lease doubles when a range lasted less than a second and halves when
+ * it lasted more than three, within the CACHE and sequence_range bounds.
+ *
+ * The hash table is protected by SequenceRangeLock, the ranges by the
+ * spinlock of their entry.
+ */
+typedef struct SeqRangeKey
+{
+	Oid			dbid;
+	Oid			relid;
+} SeqRangeKey;
+
+typedef struct SeqRangeData
+{
+	SeqRangeKey	key;			/* hash key, must be first */
+	slock_t		mutex;
+	Oid			filenode;		/* relfilenode of the sequence the ranges are for */
+	int64		increment;
+	bool		cur_valid;		/* any values left in the current range? */
+	int64		cur_next;		/* next value of the current range */
+	int64		cur_max;		/* last value of the current range */
+	bool		next_valid;		/* is there a prefetched range? */
+	int64		next_first;
+	int64		next_max;
+	bool		refilling;		/* is a backend prefetching a range? */
+	int64		lease;			/* number of values to ask GTM for */
+	TimestampTz	lease_time;		/* when the current range was started */
+} SeqRangeData;
+
+typedef SeqRangeData *SeqRange;
+
+static HTAB *SeqRangeHash = NULL;
+
+static SeqRange seq_range_lookup(SeqTable elm, Relation seqrel, int64 incby,
+				 int64 cache);
+static bool seq_range_next(SeqTable elm, Relation seqrel, int64 incby,
+			   int64 cache, int64 *result, int64 *prefetch);
+static int64 seq_range_lease(SeqTable elm, Relation seqrel, int64 incby,
+				int64 cache);
+static void seq_range_install(SeqTable elm, Relation seqrel, int64 incby,
+				  int64 first, int64 max);
+static void seq_range_forget(Oid relid);
+#endif
+
 #ifdef PGXC
 /*
  * Arguments for callback of sequence drop on GTM
@@ -411,6 +466,9 @@ ResetSequence(Oid seq_relid)
 	/* Clear local cache so that we don't think we have cached numbers */
 	/* Note that we do not change the currval() state */
 	elm->cached = elm->last;
+#ifdef XCP
+	seq_range_forget(elm->relid);
+#endif
 
 	relation_close(seq_rel, NoLock);
 }
@@ -567,6 +625,9 @@ AlterSequence(ParseState *pstate, AlterSeqStmt *stmt)
 	/* Clear local cache so that we don't think we have cached numbers */
 	/* Note that we do not change the currval() state */
 	elm->cached = elm->last;
+#ifdef XCP
+	seq_range_forget(elm->relid);
+#endif
 
 	/* Now okay to update the on-disk tuple */
 #ifdef PGXC
@@ -694,6 +755,70 @@ nextval_oid(PG_FUNCTION_ARGS)
 	PG_RETURN_INT64(nextval_internal(relid, true));
 }
 
+#ifdef XCP
+/*
+ * Allocate a block of consecutive values of a sequence with a single GTM
+ * request, and return the first one.  Meant for clients loading many rows,
+ * which would otherwise call nextval once per row.  The values cached by
+ * the session or shared by the node are left alone, and so is lastval.
+ */
+Datum
+nextval_range_oid(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	int32		count = PG_GETARG_INT32(1);
+	SeqTable	elm;
+	Relation	seqrel;
+	HeapTuple	pgstuple;
+	int64		incby;
+	int64		first;
+	int64		rangemax;
+	char	   *seqname;
+
+	if (count < 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("number of sequence values must be positive")));
+
+	/* open and lock sequence */
+	init_sequence(relid, &elm, &seqrel);
+
+	if (pg_class_aclcheck(elm->relid, GetUserId(),
+						  ACL_USAGE | ACL_UPDATE) != ACLCHECK_OK)
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("permission denied for sequence %s",
+						RelationGetRelationName(seqrel))));
+
+	/* read-only transactions may only modify temp sequences */
+	if (!seqrel->rd_islocaltemp)
+		PreventCommandIfReadOnly("nextval()");
+
+	PreventCommandIfParallelMode("nextval()");
+
+	pgstuple = SearchSysCache1(SEQRELID, ObjectIdGetDatum(relid));
+	if (!HeapTupleIsValid(pgstuple))
+		elog(ERROR, "cache lookup failed for sequence %u", relid);
+	incby = ((Form_pg_sequence) GETSTRUCT(pgstuple))->seqincrement;
+	ReleaseSysCache(pgstuple);
+
+	seqname = GetGlobalSeqName(seqrel, NULL, NULL);
+	first = (int64) GetNextValGTM(seqname, count, &rangemax);
+	pfree(seqname);
+
+	/* GTM stops the range at the sequence boundary */
+	if ((rangemax - first) / incby + 1 < count)
+		ereport(ERROR,
+				(errcode(ERRCODE_SEQUENCE_GENERATOR_LIMIT_EXCEEDED),
+				 errmsg("nextval: sequence \"%s\" does not have %d values left before reaching its limit",
+						RelationGetRelationName(seqrel), count)));
+
+	relation_close(seqrel, NoLock);
+
+	PG_RETURN_INT64(first);
+}
+#endif
+
 int64
 nextval_internal(Oid relid, bool check_permissions)
 {
@@ -761,6 +886,35 @@ nextval_internal(Oid relid, bool check_permissions)
 	cycle = pgsform->seqcycle;
 	ReleaseSysCache(pgstuple);
 
+#ifdef XCP
+	/* Draw from the range shared by the backends of the node, if any */
+	if (SharedSequenceRanges > 0)
+	{
+		int64		prefetch;
+
+		if (seq_range_next(elm, seqrel, incby, cache, &result, &prefetch))
+		{
+			if (prefetch > 0)
+			{
+				char	   *seqname = GetGlobalSeqName(seqrel, NULL, NULL);
+				int64		first;
+				int64		rangemax;
+
+				first = (int64) GetNextValGTM(seqname, prefetch, &rangemax);
+				pfree(seqname);
+				seq_range_install(elm, seqrel, incby, first, rangemax);
+			}
+
+			elm->increment = incby;
+			elm->last = elm->cached = result;
+			elm->last_valid = true;
+			relation_close(seqrel, NoLock);
+			last_used_seq = elm;
+			return result;
+		}
+	}
+#endif
+
 	/* lock page' buffer and read tuple */
 	seq = read_seq_tuple(seqrel, &buf, &seqdatatuple);
 	page = BufferGetPage(buf);
@@ -768,8 +922,12 @@ nextval_internal(Oid relid, bool check_permissions)
 	{
 		int64 range = cache; /* how many values to ask from GTM? */
 		int64 rangemax; /* the max value returned from the GTM for our request */
+		int64 shared_lease = 0; /* lease of the shared range, if any */
 		char *seqname = GetGlobalSeqName(seqrel, NULL, NULL);
 
+		if (SharedSequenceRanges > 0)
+			shared_lease = seq_range_lease(elm, seqrel, incby, cache);
+
 		/*
 		 * Above, we still use the page as a locking mechanism to handle
 		 * concurrency
@@ -777,7 +935,9 @@ nextval_internal(Oid relid, bool check_permissions)
 		 * If the user has set a CACHE parameter, we use that. Else we pass in
 		 * the SequenceRangeVal value
 		 */
-		if (range == DEFAULT_CACHEVAL && SequenceRangeVal > range)
+		if (shared_lease > 0)
+			range = shared_lease;
+		else if (range == DEFAULT_CACHEVAL && SequenceRangeVal > range)
 		{
 			TimestampTz curtime = GetCurrentTimestamp();
 
@@ -842,6 +1002,14 @@ nextval_internal(Oid relid, bool check_permissions)
 		elm->cached = rangemax;		/* last fetched range max limit */
 		elm->last_valid = true;
 
+		/* or leave the rest of the range to the other backends */
+		if (shared_lease > 0)
+		{
+			if (result != rangemax)
+				seq_range_install(elm, seqrel, incby, result + incby, rangemax);
+			elm->cached = result;
+		}
+
 		last_used_seq = elm;
 	}
 
@@ -1183,6 +1351,9 @@ do_setval(Oid relid, int64 next, bool iscalled)
 	}
 	/* In any case, forget any future cached numbers */
 	elm->cached = elm->last;
+#ifdef XCP
+	seq_range_forget(elm->relid);
+#endif
 
 	/* check the comment above nextval_internal()'s equivalent call. */
 	if (RelationNeedsWAL(seqrel))
@@ -1313,6 +1484,268 @@ create_seq_hashtable(void)
 							 HASH_ELEM | HASH_BLOBS);
 }
 
+#ifdef XCP
+/*
+ * Report shared memory space needed by SequenceShmemInit
+ */
+Size
+SequenceShmemSize(void)
+{
+	if (SharedSequenceRanges <= 0)
+		return 0;
+
+	return hash_estimate_size(SharedSequenceRanges, sizeof(SeqRangeData));
+}
+
+/*
+ * Allocate the table of sequence ranges shared by the backends of the node
+ */
+void
+SequenceShmemInit(void)
+{
+	HASHCTL		info;
+
+	if (SharedSequenceRanges <= 0)
+		return;
+
+	MemSet(&info, 0, sizeof(info));
+	info.keysize = sizeof(SeqRangeKey);
+	info.entrysize = sizeof(SeqRangeData);
+
+	SeqRangeHash = ShmemInitHash("Sequence Ranges",
+								 SharedSequenceRanges,
+								 SharedSequenceRanges,
+								 &info,
+								 HASH_ELEM | HASH_BLOBS);
+}
+
+/*
+ * Find, or create, the shared range entry of a sequence. Returns NULL if the
+ * table is full, the backend then caches values for itself, as without
+ * shared_sequence_ranges.
+ *
+ * Entries are never removed, so the pointer stays valid without the lock.
+ */
+static SeqRange
+seq_range_lookup(SeqTable elm, Relation seqrel, int64 incby, int64 cache)
+{
+	SeqRangeKey key;
+	SeqRange	range;
+	bool		found;
+
+	key.dbid = MyDatabaseId;
+	key.relid = elm->relid;
+
+	LWLockAcquire(SequenceRangeLock, LW_SHARED);
+	range = (SeqRange) hash_search(SeqRangeHash, &key, HASH_FIND, NULL);
+	LWLockRelease(SequenceRangeLock);
+
+	if (range == NULL)
+	{
+		LWLockAcquire(SequenceRangeLock, LW_EXCLUSIVE);
+		range = (SeqRange) hash_search(SeqRangeHash, &key, HASH_ENTER_NULL,
+									   &found);
+		if (range != NULL && !found)
+		{
+			SpinLockInit(&range->mutex);
+			range->filenode = InvalidOid;
+			range->increment = 0;
+			range->cur_valid = false;
+			range->next_valid = false;
+			range->refilling = false;
+			range->lease = 0;
+			range->lease_time = 0;
+		}
+		LWLockRelease(SequenceRangeLock);
+	}
+
+	return range;
+}
+
+/*
+ * Throw away the ranges if they were leased for an earlier incarnation of
+ * the sequence. Must be called with the entry's mutex held.
+ */
+static void
+seq_range_check(SeqRange range, Relation seqrel, int64 incby)
+{
+	if (range->filenode != seqrel->rd_rel->relfilenode ||
+		range->increment != incby)
+	{
+		range->filenode = seqrel->rd_rel->relfilenode;
+		range->increment = incby;
+		range->cur_valid = false;
+		range->next_valid = false;
+		range->lease = 0;
+		range->lease_time = 0;
+	}
+}
+
+/*
+ * A new range is started, adapt the lease to how long the previous one
+ * lasted. Must be called with the entry's mutex held.
+ */
+static void
+seq_range_adapt(SeqRange range, TimestampTz now, int64 cache)
+{
+	int64		maxlease = Max((int64) SequenceRangeVal, cache);
+
+	if (range->lease_time != 0 &&
+		!TimestampDifferenceExceeds(range->lease_time, now, 1000))
+		range->lease *= 2;
+	else if (TimestampDifferenceExceeds(range->lease_time, now, 3000))
+		range->lease /= 2;
+
+	range->lease = Min(Max(range->lease, cache), maxlease);
+	range->lease_time = now;
+}
+
+/*
+ * Take the next value of the shared range of the sequence. Returns false if
+ * there is none left, the caller then gets one from GTM. *prefetch is set to
+ * the number of values to ask GTM for, if the caller is elected to refill
+ * the range before it runs out, zero otherwise.
+ */
+static bool
+seq_range_next(SeqTable elm, Relation seqrel, int64 incby, int64 cache,
+			   int64 *result, int64 *prefetch)
+{
+	SeqRange	range = seq_range_lookup(elm, seqrel, incby, cache);
+	TimestampTz now;
+	int64		remaining;
+
+	*prefetch = 0;
+	if (range == NULL)
+		return false;
+
+	now = GetCurrentTimestamp();
+
+	SpinLockAcquire(&range->mutex);
+	seq_range_check(range, seqrel, incby);
+
+	if (!range->cur_valid && range->next_valid)
+	{
+		range->cur_next = range->next_first;
+		range->cur_max = range->next_max;
+		range->cur_valid = true;
+		range->next_valid = false;
+		seq_range_adapt(range, now, cache);
+	}
+
+	if (!range->cur_valid)
+	{
+		SpinLockRelease(&range->mutex);
+		return false;
+	}
+
+	*result = range->cur_next;
+	if (range->cur_next == range->cur_max)
+		range->cur_valid = false;
+	else
+		range->cur_next += incby;
+
+	remaining = range->cur_valid ?
+		(range->cur_max - range->cur_next) / incby + 1 : 0;
+	if (!range->next_valid && !range->refilling &&
+		remaining <= range->lease / 4)
+	{
+		range->refilling = true;
+		*prefetch = range->lease;
+	}
+	SpinLockRelease(&range->mutex);
+
+	return true;
+}
+
+/*
+ * Number of values to ask GTM for when the shared range has run out, or
+ * zero if the sequence has no shared range.
+ */
+static int64
+seq_range_lease(SeqTable elm, Relation seqrel, int64 incby, int64 cache)
+{
+	SeqRange	range = seq_range_lookup(elm, seqrel, incby, cache);
+	TimestampTz now;
+	int64		lease;
+
+	if (range == NULL)
+		return 0;
+
+	now = GetCurrentTimestamp();
+
+	SpinLockAcquire(&range->mutex);
+	seq_range_check(range, seqrel, incby);
+	seq_range_adapt(range, now, cache);
+	lease = range->lease;
+	SpinLockRelease(&range->mutex);
+
+	return lease;
+}
+
+/*
+ * Hand out the values from first to max, obtained from GTM, to the backends
+ * of the node. If both the current and the prefetched range are still in
+ * use, which only happens when backends raced to refill, the values are
+ * skipped.
+ */
+static void
+seq_range_install(SeqTable elm, Relation seqrel, int64 incby,
+				  int64 first, int64 max)
+{
+	SeqRange	range = seq_range_lookup(elm, seqrel, incby, 0);
+
+	if (range == NULL)
+		return;
+
+	SpinLockAcquire(&range->mutex);
+	seq_range_check(range, seqrel, incby);
+	range->refilling = false;
+	if (!range->cur_valid)
+	{
+		range->cur_next = first;
+		range->cur_max = max;
+		range->cur_valid = true;
+	}
+	else if (!range->next_valid)
+	{
+		range->next_first = first;
+		range->next_max = max;
+		range->next_valid = true;
+	}
+	SpinLockRelease(&range->mutex);
+}
+
+/*
+ * The sequence was reset or altered, forget the values leased so far.
+ */
+static void
+seq_range_forget(Oid relid)
+{
+	SeqRangeKey key;
+	SeqRange	range;
+
+	if (SharedSequenceRanges <= 0)
+		return;
+
+	key.dbid = MyDatabaseId;
+	key.relid = relid;
+
+	LWLockAcquire(SequenceRangeLock, LW_SHARED);
+	range = (SeqRange) hash_search(SeqRangeHash, &key, HASH_FIND, NULL);
+	LWLockRelease(SequenceRangeLock);
+
+	if (range == NULL)
+		return;
+
+	SpinLockAcquire(&range->mutex);
+	range->cur_valid = false;
+	range->next_valid = false;
+	range->lease = 0;
+	range->lease_time = 0;
+	SpinLockRelease(&range->mutex);
+}
+#endif
+
 /*
  * Given a relation OID, open and lock the sequence.  p_elm and p_rel are
  * output parameters.
@@ -1832,8 +1832,11 @@ get_remote_relstat(char *nspname, char *relname, bool replicated,
  * Coordinator does not contain any data, so we never need to vacuum relations.
  * This function only updates optimizer statistics based on info from the
  * data nodes.
+ *
+ * Returns the number of tuples of the relation according to the data nodes,
+ * or -1 if none of them returned statistics.
  */
-void
+double
 vacuum_rel_coordinator(Relation onerel, bool is_outer)
 {
 	char 	   *nspname;
@@ -1934,6 +1937,10 @@ vacuum_rel_coordinator(Relation onerel, bool is_outer)
 							min_frozenxid,
 							InvalidMultiXactId,
 							is_outer);
+
+		return (double) num_tuples;
 	}
+
+	return -1;
 }
 #endif
@@ -41,21 +41,27 @@
 #include "access/heapam_xlog.h"
 #include "access/htup_details.h"
 #include "access/multixact.h"
+#include "access/parallel.h"
 #include "access/transam.h"
 #include "access/visibilitymap.h"
+#include "access/xact.h"
 #include "access/xlog.h"
 #include "catalog/catalog.h"
+#include "catalog/pg_am.h"
 #include "catalog/storage.h"
 #include "commands/dbcommands.h"
 #include "commands/progress.h"
 #include "commands/vacuum.h"
 #include "miscadmin.h"
+#include "optimizer/paths.h"
 #include "pgstat.h"
 #include "portability/instr_time.h"
 #include "postmaster/autovacuum.h"
 #include "storage/bufmgr.h"
+#include "storage/dsm_impl.h"
 #include "storage/freespace.h"
 #include "storage/lmgr.h"
+#include "storage/proc.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/pg_rusage.h"
@@ -103,6 +109,11 @@
  */
 #define PREFETCH_SIZE			((BlockNumber) 32)
 
+/*
+ * Key of the shared state in the DSM of a parallel index vacuum
+ */
+#define PARALLEL_VACUUM_KEY_SHARED		1
+
 typedef struct LVRelStats
 {
 	/* hasindex = true means two-pass strategy; false means one-pass */
@@ -129,8 +140,38 @@ typedef struct LVRelStats
 	int			num_index_scans;
 	TransactionId latestRemovedXid;
 	bool		lock_waiter_detected;
+	/* workers to vacuum the indexes with, dead_tuples is then in DSM */
+	int			nworkers;
+	dsm_segment *dead_tuples_seg;
 } LVRelStats;
 
+/*
+ * Index vacuum statistics shared with parallel workers
+ */
+typedef struct LVIndexStats
+{
+	bool		parallel_ok;	/* may be vacuumed by a worker */
+	bool		valid;			/* stats below are set */
+	IndexBulkDeleteResult stats;
+} LVIndexStats;
+
+/*
+ * State of a parallel index vacuum, in the DSM of the parallel context.
+ * Participants take the next index to vacuum from nextidx.
+ */
+typedef struct LVShared
+{
+	Oid			relid;
+	int			elevel;
+	double		num_heap_tuples;
+	int			cost_limit;		/* vacuum_cost_limit of each worker */
+	dsm_handle	dead_tuples_handle;
+	int			num_dead_tuples;
+	int			nindexes;
+	pg_atomic_uint32 nextidx;
+	LVIndexStats indstats[FLEXIBLE_ARRAY_MEMBER];
+} LVShared;
+
 
 /* A few variables that don't seem worth passing around as parameters */
 static int	elevel = -1;
@@ -151,6 +192,19 @@ static bool lazy_check_needs_freeze(Buffer buf, bool *hastup);
 static void lazy_vacuum_index(Relation indrel,
 				  IndexBulkDeleteResult **stats,
 				  LVRelStats *vacrelstats);
+static void lazy_vacuum_indexes(Relation *Irel, int nindexes,
+					IndexBulkDeleteResult **indstats,
+					Relation onerel, LVRelStats *vacrelstats);
+static bool lazy_index_parallel_ok(Relation indrel);
+static int	lazy_parallel_workers(Relation onerel, Relation *Irel,
+					  int nindexes);
+static void lazy_parallel_vacuum_indexes(Relation *Irel, int nindexes,
+							 IndexBulkDeleteResult **indstats,
+							 Relation onerel, LVRelStats *vacrelstats);
+static void lazy_vacuum_shared_index(Relation indrel, LVIndexStats *indstats,
+						 LVRelStats *vacrelstats);
+static void lazy_parallel_vacuum_loop(Relation *Irel, LVShared *shared,
+						  LVRelStats *vacrelstats);
 static void lazy_cleanup_index(Relation indrel,
 				   IndexBulkDeleteResult *stats,
 				   LVRelStats *vacrelstats);
@@ -504,6 +558,7 @@ lazy_scan_heap(Relation onerel, int options, LVRelStats *vacrelstats,
 	vacrelstats->nonempty_pages = 0;
 	vacrelstats->latestRemovedXid = InvalidTransactionId;
 
+	vacrelstats->nworkers = lazy_parallel_workers(onerel, Irel, nindexes);
 	lazy_space_alloc(vacrelstats, nblocks);
 	frozen = palloc(sizeof(xl_heap_freeze_tuple) * MaxHeapTuplesPerPage);
 
@@ -717,10 +772,7 @@ lazy_scan_heap(Relation onerel, int options, LVRelStats *vacrelstats,
 										 PROGRESS_VACUUM_PHASE_VACUUM_INDEX);
 
 			/* Remove index entries */
-			for (i = 0; i < nindexes; i++)
-				lazy_vacuum_index(Irel[i],
-								  &indstats[i],
-								  vacrelstats);
+			lazy_vacuum_indexes(Irel, nindexes, indstats, onerel, vacrelstats);
 
 			/*
 			 * Report that we are now vacuuming the heap.  We also increase
@@ -1296,10 +1348,7 @@ lazy_scan_heap(Relation onerel, int options, LVRelStats *vacrelstats,
 									 PROGRESS_VACUUM_PHASE_VACUUM_INDEX);
 
 		/* Remove index entries */
-		for (i = 0; i < nindexes; i++)
-			lazy_vacuum_index(Irel[i],
-							  &indstats[i],
-							  vacrelstats);
+		lazy_vacuum_indexes(Irel, nindexes, indstats, onerel, vacrelstats);
 
 		/* Report that we are now vacuuming the heap */
 		hvp_val[0] = PROGRESS_VACUUM_PHASE_VACUUM_HEAP;
@@ -1322,6 +1371,14 @@ lazy_scan_heap(Relation onerel, int options, LVRelStats *vacrelstats,
 	for (i = 0; i < nindexes; i++)
 		lazy_cleanup_index(Irel[i], indstats[i], vacrelstats);
 
+	/* The dead tuples are not needed any more */
+	if (vacrelstats->dead_tuples_seg)
+	{
+		dsm_detach(vacrelstats->dead_tuples_seg);
+		vacrelstats->dead_tuples_seg = NULL;
+		vacrelstats->dead_tuples = NULL;
+	}
+
 	/* If no indexes, make log report that lazy_vacuum_heap would've made */
 	if (vacuumed_pages)
 		ereport(elevel,
@@ -1617,6 +1674,271 @@ lazy_vacuum_index(Relation indrel,
 			 errdetail_internal("%s", pg_rusage_show(&ru0))));
 }
 
+/*
+ *	lazy_vacuum_indexes() -- vacuum all indexes of the relation.
+ */
+static void
+lazy_vacuum_indexes(Relation *Irel, int nindexes,
+					IndexBulkDeleteResult **indstats,
+					Relation onerel, LVRelStats *vacrelstats)
+{
+	int			i;
+
+	if (vacrelstats->nworkers > 0)
+	{
+		lazy_parallel_vacuum_indexes(Irel, nindexes, indstats, onerel,
+									 vacrelstats);
+		return;
+	}
+
+	for (i = 0; i < nindexes; i++)
+		lazy_vacuum_index(Irel[i],
+						  &indstats[i],
+						  vacrelstats);
+}
+
+/*
+ *	lazy_index_parallel_ok() -- may a parallel worker vacuum the index?
+ *
+ *		The statistics of the bulk delete are passed between processes as a
+ *		plain IndexBulkDeleteResult, which is only known to be all the built-in
+ *		access methods keep. Small indexes are not worth a worker.
+ */
+static bool
+lazy_index_parallel_ok(Relation indrel)
+{
+	switch (indrel->rd_rel->relam)
+	{
+		case BTREE_AM_OID:
+		case HASH_AM_OID:
+		case GIST_AM_OID:
+		case GIN_AM_OID:
+		case SPGIST_AM_OID:
+		case BRIN_AM_OID:
+			break;
+		default:
+			return false;
+	}
+
+	return RelationGetNumberOfBlocks(indrel) >=
+		(BlockNumber) min_parallel_index_scan_size;
+}
+
+/*
+ *	lazy_parallel_workers() -- number of workers to vacuum the indexes with
+ *
+ *		The leader vacuums one of the indexes itself. Workers can't see the
+ *		local buffers of temporary relations. Autovacuum workers stay serial,
+ *		so that autovacuum does not use up the parallel workers of queries.
+ */
+static int
+lazy_parallel_workers(Relation onerel, Relation *Irel, int nindexes)
+{
+	int			nparallel = 0;
+	int			i;
+
+	if (max_parallel_maintenance_workers == 0 || nindexes < 2 ||
+		IsAutoVacuumWorkerProcess() || !IsUnderPostmaster ||
+		RelationUsesLocalBuffers(onerel) ||
+		dynamic_shared_memory_type == DSM_IMPL_NONE)
+		return 0;
+
+	for (i = 0; i < nindexes; i++)
+	{
+		if (lazy_index_parallel_ok(Irel[i]))
+			nparallel++;
+	}
+
+	return Min(nparallel - 1, max_parallel_maintenance_workers);
+}
+
+/*
+ *	lazy_parallel_vacuum_indexes() -- vacuum the indexes with parallel workers
+ *
+ *		Each participant, the leader included, vacuums one index at a time,
+ *		reading the dead tuples from their DSM segment. The cost limit is
+ *		split between the participants, so that together they do not do more
+ *		I/O than a serial vacuum would.
+ */
+static void
+lazy_parallel_vacuum_indexes(Relation *Irel, int nindexes,
+							 IndexBulkDeleteResult **indstats,
+							 Relation onerel, LVRelStats *vacrelstats)
+{
+	ParallelContext *pcxt;
+	LVShared   *shared;
+	Size		size;
+	int			saved_cost_limit = VacuumCostLimit;
+	int			i;
+
+	EnterParallelMode();
+	pcxt = CreateParallelContext("postgres", "lazy_parallel_vacuum_main",
+								 vacrelstats->nworkers);
+
+	size = add_size(offsetof(LVShared, indstats),
+					mul_size(sizeof(LVIndexStats), nindexes));
+	shm_toc_estimate_chunk(&pcxt->estimator, size);
+	shm_toc_estimate_keys(&pcxt->estimator, 1);
+	InitializeParallelDSM(pcxt);
+
+	shared = (LVShared *) shm_toc_allocate(pcxt->toc, size);
+	shared->relid = RelationGetRelid(onerel);
+	shared->elevel = elevel;
+	shared->num_heap_tuples = vacrelstats->old_rel_tuples;
+	shared->cost_limit = Max(VacuumCostLimit / (vacrelstats->nworkers + 1), 1);
+	shared->dead_tuples_handle = dsm_segment_handle(vacrelstats->dead_tuples_seg);
+	shared->num_dead_tuples = vacrelstats->num_dead_tuples;
+	shared->nindexes = nindexes;
+	pg_atomic_init_u32(&shared->nextidx, 0);
+	for (i = 0; i < nindexes; i++)
+	{
+		LVIndexStats *s = &shared->indstats[i];
+
+		s->parallel_ok = lazy_index_parallel_ok(Irel[i]);
+		s->valid = (indstats[i] != NULL);
+		if (s->valid)
+			memcpy(&s->stats, indstats[i], sizeof(IndexBulkDeleteResult));
+	}
+	shm_toc_insert(pcxt->toc, PARALLEL_VACUUM_KEY_SHARED, shared);
+
+	LaunchParallelWorkers(pcxt);
+	ereport(elevel,
+			(errmsg(ngettext("launched %d parallel vacuum worker for index vacuuming (planned: %d)",
+							 "launched %d parallel vacuum workers for index vacuuming (planned: %d)",
+							 pcxt->nworkers_launched),
+					pcxt->nworkers_launched, vacrelstats->nworkers)));
+
+	if (pcxt->nworkers_launched > 0)
+		VacuumCostLimit = Max(saved_cost_limit / (pcxt->nworkers_launched + 1), 1);
+
+	/* First the indexes only we can do, then help with the others */
+	for (i = 0; i < nindexes; i++)
+	{
+		if (!shared->indstats[i].parallel_ok)
+			lazy_vacuum_shared_index(Irel[i], &shared->indstats[i],
+									 vacrelstats);
+	}
+	lazy_parallel_vacuum_loop(Irel, shared, vacrelstats);
+
+	WaitForParallelWorkersToFinish(pcxt);
+	VacuumCostLimit = saved_cost_limit;
+
+	for (i = 0; i < nindexes; i++)
+	{
+		LVIndexStats *s = &shared->indstats[i];
+
+		if (!s->valid)
+			continue;
+		if (indstats[i] == NULL)
+			indstats[i] = (IndexBulkDeleteResult *)
+				palloc(sizeof(IndexBulkDeleteResult));
+		memcpy(indstats[i], &s->stats, sizeof(IndexBulkDeleteResult));
+	}
+
+	DestroyParallelContext(pcxt);
+	ExitParallelMode();
+}
+
+/*
+ *	lazy_vacuum_shared_index() -- vacuum an index, keeping its statistics in
+ *		shared memory
+ */
+static void
+lazy_vacuum_shared_index(Relation indrel, LVIndexStats *indstats,
+						 LVRelStats *vacrelstats)
+{
+	IndexBulkDeleteResult *stats;
+
+	stats = indstats->valid ? &indstats->stats : NULL;
+	lazy_vacuum_index(indrel, &stats, vacrelstats);
+	if (stats == NULL)
+		return;
+
+	/* The access method allocates the result on the first pass */
+	if (stats != &indstats->stats)
+	{
+		memcpy(&indstats->stats, stats, sizeof(IndexBulkDeleteResult));
+		pfree(stats);
+	}
+	indstats->valid = true;
+}
+
+/*
+ *	lazy_parallel_vacuum_loop() -- vacuum indexes until none are left
+ */
+static void
+lazy_parallel_vacuum_loop(Relation *Irel, LVShared *shared,
+						  LVRelStats *vacrelstats)
+{
+	for (;;)
+	{
+		uint32		idx = pg_atomic_fetch_add_u32(&shared->nextidx, 1);
+
+		if (idx >= shared->nindexes)
+			break;
+		if (!shared->indstats[idx].parallel_ok)
+			continue;
+		lazy_vacuum_shared_index(Irel[idx], &shared->indstats[idx],
+								 vacrelstats);
+	}
+}
+
+/*
+ * lazy_parallel_vacuum_main -- entry point of a parallel vacuum worker
+ */
+void
+lazy_parallel_vacuum_main(dsm_segment *seg, shm_toc *toc)
+{
+	LVShared   *shared;
+	LVRelStats *vacrelstats;
+	dsm_segment *dead_tuples_seg;
+	Relation	onerel;
+	Relation   *Irel;
+	int			nindexes;
+
+	shared = (LVShared *) shm_toc_lookup(toc, PARALLEL_VACUUM_KEY_SHARED,
+										 false);
+
+	/* Let other vacuums ignore our snapshot, as they ignore the leader's */
+	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+	MyPgXact->vacuumFlags |= PROC_IN_VACUUM;
+	LWLockRelease(ProcArrayLock);
+
+	/* The leader holds the same locks, so these don't block */
+	onerel = heap_open(shared->relid, ShareUpdateExclusiveLock);
+	vac_open_indexes(onerel, RowExclusiveLock, &nindexes, &Irel);
+	if (nindexes != shared->nindexes)
+		elog(ERROR, "parallel vacuum worker found %d indexes of \"%s\", expected %d",
+			 nindexes, RelationGetRelationName(onerel), shared->nindexes);
+
+	dead_tuples_seg = dsm_attach(shared->dead_tuples_handle);
+	if (dead_tuples_seg == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("could not map dynamic shared memory segment")));
+
+	vacrelstats = (LVRelStats *) palloc0(sizeof(LVRelStats));
+	vacrelstats->hasindex = true;
+	vacrelstats->old_rel_tuples = shared->num_heap_tuples;
+	vacrelstats->num_dead_tuples = shared->num_dead_tuples;
+	vacrelstats->max_dead_tuples = shared->num_dead_tuples;
+	vacrelstats->dead_tuples = (ItemPointer)
+		dsm_segment_address(dead_tuples_seg);
+
+	elevel = shared->elevel;
+	vac_strategy = GetAccessStrategy(BAS_VACUUM);
+	VacuumCostActive = (VacuumCostDelay > 0);
+	VacuumCostBalance = 0;
+	VacuumCostLimit = shared->cost_limit;
+
+	lazy_parallel_vacuum_loop(Irel, shared, vacrelstats);
+
+	dsm_detach(dead_tuples_seg);
+	vac_close_indexes(nindexes, Irel, RowExclusiveLock);
+	heap_close(onerel, ShareUpdateExclusiveLock);
+	FreeAccessStrategy(vac_strategy);
+}
+
 /*
  *	lazy_cleanup_index() -- do post-vacuum cleanup for one index relation.
  */
@@ -2006,6 +2328,25 @@ lazy_space_alloc(LVRelStats *vacrelstats, BlockNumber relblocks)
 
 	vacrelstats->num_dead_tuples = 0;
 	vacrelstats->max_dead_tuples = (int) maxtuples;
+
+	/*
+	 * If the indexes are vacuumed in parallel, put the dead tuples where the
+	 * workers can read them. Vacuum them serially if there is no room.
+	 */
+	if (vacrelstats->nworkers > 0)
+	{
+		vacrelstats->dead_tuples_seg =
+			dsm_create(maxtuples * sizeof(ItemPointerData),
+					   DSM_CREATE_NULL_IF_MAXSEGMENTS);
+		if (vacrelstats->dead_tuples_seg)
+		{
+			vacrelstats->dead_tuples = (ItemPointer)
+				dsm_segment_address(vacrelstats->dead_tuples_seg);
+			return;
+		}
+		vacrelstats->nworkers = 0;
+	}
+
 	vacrelstats->dead_tuples = (ItemPointer)
 		palloc(maxtuples * sizeof(ItemPointerData));
 }
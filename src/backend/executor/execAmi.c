@@ -421,9 +421,12 @@ ExecSupportsMarkRestore(Path *pathnode)
 		case T_IndexScan:
 		case T_IndexOnlyScan:
 		case T_Material:
-		case T_Sort:
 			return true;
 
+		case T_Sort:
+			/* An incremental sort only has the current group at hand */
+			return castNode(SortPath, pathnode)->numPresortedCols == 0;
+
 		case T_CustomScan:
 			{
 				CustomPath *customPath = castNode(CustomPath, pathnode);
@@ -531,9 +534,11 @@ ExecSupportsBackwardScan(Plan *node)
 		case T_ValuesScan:
 		case T_CteScan:
 		case T_Material:
-		case T_Sort:
 			return true;
 
+		case T_Sort:
+			return ((Sort *) node)->numPresortedCols == 0;
+
 		case T_LockRows:
 		case T_Limit:
 			return ExecSupportsBackwardScan(outerPlan(node));
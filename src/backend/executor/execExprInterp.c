@@ -37,7 +37,9 @@
  * ExecReadyInterpretedExpr will choose to implement simple scalar Var
  * and Const expressions using special fast-path routines (ExecJust*).
  * Benchmarking shows anything more complex than those may as well use the
- * "full interpreter".
+ * "full interpreter".  The exception is a scan qual made of a single
+ * operator between Vars and Consts, by far the most common predicate on
+ * Datanodes, which also gets a fast-path routine.
  *
  * Complex or uncommon instructions are not implemented in-line in
  * ExecInterpExpr(), rather we call out to a helper function appearing later
@@ -149,6 +151,7 @@ static Datum ExecJustConst(ExprState *state, ExprContext *econtext, bool *isnull
 static Datum ExecJustAssignInnerVar(ExprState *state, ExprContext *econtext, bool *isnull);
 static Datum ExecJustAssignOuterVar(ExprState *state, ExprContext *econtext, bool *isnull);
 static Datum ExecJustAssignScanVar(ExprState *state, ExprContext *econtext, bool *isnull);
+static Datum ExecJustScanOpQual(ExprState *state, ExprContext *econtext, bool *isnull);
 
 
 /*
@@ -237,6 +240,26 @@ ExecReadyInterpretedExpr(ExprState *state)
 		state->evalfunc = ExecJustConst;
 		return;
 	}
+	else if (state->steps_len == 6 &&
+			 state->steps[0].opcode == EEOP_SCAN_FETCHSOME &&
+			 (state->steps[3].opcode == EEOP_FUNCEXPR ||
+			  state->steps[3].opcode == EEOP_FUNCEXPR_STRICT) &&
+			 state->steps[3].d.func.nargs == 2 &&
+			 state->steps[4].opcode == EEOP_QUAL)
+	{
+		ExprEvalOp	step1 = state->steps[1].opcode;
+		ExprEvalOp	step2 = state->steps[2].opcode;
+
+		/* ExecInitQual() of a single "Var op Const" or "Var op Var" clause */
+		if ((step1 == EEOP_SCAN_VAR_FIRST || step1 == EEOP_SCAN_VAR ||
+			 step1 == EEOP_CONST) &&
+			(step2 == EEOP_SCAN_VAR_FIRST || step2 == EEOP_SCAN_VAR ||
+			 step2 == EEOP_CONST))
+		{
+			state->evalfunc = ExecJustScanOpQual;
+			return;
+		}
+	}
 
 #if defined(EEO_USE_COMPUTED_GOTO)
 
@@ -1786,6 +1809,61 @@ ExecJustAssignScanVar(ExprState *state, ExprContext *econtext, bool *isnull)
 	return 0;
 }
 
+/*
+ * Qual made of a two-argument function (an operator) over scan Vars and
+ * Consts.  The argument steps evaluate directly into the function's fcinfo,
+ * as in ExecInterpExpr(), followed by the EEOP_QUAL check.
+ */
+static Datum
+ExecJustScanOpQual(ExprState *state, ExprContext *econtext, bool *isnull)
+{
+	ExprEvalStep *funcop = &state->steps[3];
+	FunctionCallInfo fcinfo = funcop->d.func.fcinfo_data;
+	TupleTableSlot *slot = econtext->ecxt_scantuple;
+	Datum		d;
+	int			i;
+
+	for (i = 1; i <= 2; i++)
+	{
+		ExprEvalStep *op = &state->steps[i];
+
+		if (op->opcode == EEOP_CONST)
+		{
+			*op->resnull = op->d.constval.isnull;
+			*op->resvalue = op->d.constval.value;
+			continue;
+		}
+
+		/* See ExecInterpExpr()'s comments for EEOP_INNER_VAR_FIRST */
+		if (op->opcode == EEOP_SCAN_VAR_FIRST)
+		{
+			CheckVarSlotCompatibility(slot, op->d.var.attnum + 1,
+									  op->d.var.vartype);
+			op->opcode = EEOP_SCAN_VAR;
+		}
+
+		/* See comments in ExecJustInnerVarFirst */
+		*op->resvalue = slot_getattr(slot, op->d.var.attnum + 1, op->resnull);
+	}
+
+	/* A strict function yields NULL, hence false, on any NULL argument */
+	if (funcop->opcode == EEOP_FUNCEXPR_STRICT &&
+		(fcinfo->argnull[0] || fcinfo->argnull[1]))
+	{
+		*isnull = false;
+		return BoolGetDatum(false);
+	}
+
+	fcinfo->isnull = false;
+	d = (funcop->d.func.fn_addr) (fcinfo);
+
+	/* See EEOP_QUAL, false and NULL both reject the row */
+	*isnull = false;
+	if (fcinfo->isnull || !DatumGetBool(d))
+		return BoolGetDatum(false);
+	return d;
+}
+
 
 /*
  * Do one-time initialization of interpretation machinery.
@@ -48,6 +48,7 @@
 #include "commands/matview.h"
 #include "commands/trigger.h"
 #include "executor/execdebug.h"
+#include "executor/execSample.h"
 #include "foreign/fdwapi.h"
 #include "mb/pg_wchar.h"
 #include "miscadmin.h"
@@ -70,6 +71,7 @@
 #endif
 #ifdef XCP
 #include "access/gtm.h"
+#include "pgxc/admission.h"
 #include "pgxc/execRemote.h"
 #include "pgxc/poolmgr.h"
 #endif
@@ -201,6 +203,11 @@ standard_ExecutorStart(QueryDesc *queryDesc, int eflags)
 	estate = CreateExecutorState();
 	queryDesc->estate = estate;
 
+#ifdef XCP
+	/* Wait until the Datanodes have room for the fragments of the query */
+	AdmissionControlStart(queryDesc, eflags);
+#endif
+
 	oldcontext = MemoryContextSwitchTo(estate->es_query_cxt);
 
 	/*
@@ -209,6 +216,17 @@ standard_ExecutorStart(QueryDesc *queryDesc, int eflags)
 	 */
 	estate->es_param_list_info = queryDesc->params;
 
+#ifdef XCP
+	/*
+	 * The Bloom filter of the consumer is the last of the received parameters.
+	 * It is for the portal, not for the plan, and the plan should not send it
+	 * further down.
+	 */
+	if (queryDesc->plannedstmt->hasBloomParam && queryDesc->params &&
+			queryDesc->params->numParams >= queryDesc->plannedstmt->nParamRemote)
+		queryDesc->params->numParams = queryDesc->plannedstmt->nParamRemote - 1;
+#endif
+
 	if (queryDesc->plannedstmt->nParamExec > 0)
 #ifdef XCP
 	{
@@ -218,6 +236,9 @@ standard_ExecutorStart(QueryDesc *queryDesc, int eflags)
 		{
 			ParamListInfo extparams = estate->es_param_list_info;
 			int i = queryDesc->plannedstmt->nParamRemote;
+
+			if (queryDesc->plannedstmt->hasBloomParam)
+				i--;
 			while (--i >= 0 &&
 				queryDesc->plannedstmt->remoteparams[i].paramkind == PARAM_EXEC)
 			{
@@ -302,6 +323,9 @@ standard_ExecutorStart(QueryDesc *queryDesc, int eflags)
 	 */
 	InitPlan(queryDesc, eflags);
 
+	/* Set up the sampling profiler, if enabled */
+	ExecSampleStart(estate, queryDesc->planstate);
+
 	/*
 	 * Set up an AFTER-trigger statement context, unless told not to, or
 	 * unless it's EXPLAIN-only mode (when ExecutorFinish won't be called).
@@ -533,6 +557,10 @@ standard_ExecutorEnd(QueryDesc *queryDesc)
 	Assert(estate->es_finished ||
 		   (estate->es_top_eflags & EXEC_FLAG_EXPLAIN_ONLY));
 
+#ifdef XCP
+	AdmissionControlEnd(queryDesc);
+#endif
+
 	/*
 	 * Switch into per-query memory context to run ExecEndPlan
 	 */
@@ -73,6 +73,7 @@
  */
 #include "postgres.h"
 
+#include "executor/execSample.h"
 #include "executor/executor.h"
 #include "executor/nodeAgg.h"
 #include "executor/nodeAppend.h"
@@ -122,6 +123,7 @@
 
 static TupleTableSlot *ExecProcNodeFirst(PlanState *node);
 static TupleTableSlot *ExecProcNodeInstr(PlanState *node);
+static TupleTableSlot *ExecProcNodeSample(PlanState *node);
 
 
 /* ------------------------------------------------------------------------
@@ -521,7 +523,9 @@ ExecProcNodeFirst(PlanState *node)
 	 * does instrumentation.  Otherwise we can dispense with all wrappers and
 	 * have ExecProcNode() directly call the relevant function from now on.
 	 */
-	if (node->instrument)
+	if (node->state->es_sample)
+		node->ExecProcNode = ExecProcNodeSample;
+	else if (node->instrument)
 		node->ExecProcNode = ExecProcNodeInstr;
 	else
 		node->ExecProcNode = node->ExecProcNodeReal;
@@ -550,6 +554,46 @@ ExecProcNodeInstr(PlanState *node)
 }
 
 
+/*
+ * ExecProcNode wrapper used while executor_sample_interval is set, keeps
+ * track of the node executing for the sampling profiler, see execSample.c.
+ * A sample which is due when control enters or leaves the node is charged
+ * to the node which was running until then.
+ */
+static TupleTableSlot *
+ExecProcNodeSample(PlanState *node)
+{
+	uint32		save_queryid = ExecSampleQueryId;
+	int			save_plan_node_id = ExecSamplePlanNodeId;
+	NodeTag		save_node_tag = ExecSampleNodeTag;
+	TupleTableSlot *result;
+
+	if (ExecSamplePending)
+		ExecSampleTake();
+
+	ExecSampleQueryId = node->state->es_sample_queryid;
+	ExecSamplePlanNodeId = node->plan->plan_node_id;
+	ExecSampleNodeTag = nodeTag(node->plan);
+
+	if (node->instrument)
+		InstrStartNode(node->instrument);
+
+	result = node->ExecProcNodeReal(node);
+
+	if (node->instrument)
+		InstrStopNode(node->instrument, TupIsNull(result) ? 0.0 : 1.0);
+
+	if (ExecSamplePending)
+		ExecSampleTake();
+
+	ExecSampleQueryId = save_queryid;
+	ExecSamplePlanNodeId = save_plan_node_id;
+	ExecSampleNodeTag = save_node_tag;
+
+	return result;
+}
+
+
 /* ----------------------------------------------------------------
  *		MultiExecProcNode
  *
@@ -0,0 +1,214 @@
+/*-------------------------------------------------------------------------
+ *
+ * execPrune.c
+ *	  Execution-time pruning of the partitions scanned by Append and
+ *	  MergeAppend
+ *
+ * Constraint exclusion in the planner can only use restrictions whose
+ * values are known when planning.  The generic plan of a prepared statement
+ * compares the partition key with a Param, and so does the inner side of a
+ * parameterized nested loop with the values of the outer row, so all their
+ * partitions stay in the plan.  For such children the planner saves the
+ * constraints of the partition, including the partition constraint derived
+ * from its bounds, along with the restrictions involving Params or stable
+ * functions.  Here the parts of the restrictions that do not depend on the
+ * scanned row are evaluated once their values are known, and the proof that
+ * the restrictions refute the constraints is tried again.  Subplans whose
+ * constraints are refuted are not scanned.
+ *
+ * The values of nested loop and correlated subplan parameters are set by
+ * the node above before it rescans us, so those are only used after they
+ * showed up in a rescan's changed parameters.  External parameters and the
+ * output of initplans are available from the start.
+ *
+ * Portions Copyright (c) 1996-2017, PostgreSQL Global Development Group
+ * Portions Copyright (c) 2010-2012 Postgres-XC Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/execPrune.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "executor/execPrune.h"
+#include "executor/executor.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/predtest.h"
+#include "optimizer/var.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+
+static bool prune_collect_params_walker(Node *node, Bitmapset **paramids);
+static bool prune_unknown_param_walker(Node *node,
+						   PartitionPruneState *prunestate);
+static Node *prune_eval_mutator(Node *node, PartitionPruneState *prunestate);
+
+/*
+ * ExecInitPartitionPrune
+ *	  Set up the pruning of the subplans of an Append or MergeAppend node,
+ *	  given the per-subplan lists the planner saved.
+ *
+ * The parent node must have an ExprContext to evaluate the restrictions.
+ */
+PartitionPruneState *
+ExecInitPartitionPrune(PlanState *parent, List *constraints, List *quals)
+{
+	PartitionPruneState *prunestate;
+
+	Assert(list_length(constraints) == list_length(quals));
+	Assert(parent->ps_ExprContext != NULL);
+
+	prunestate = (PartitionPruneState *) palloc0(sizeof(PartitionPruneState));
+	prunestate->parent = parent;
+	prunestate->nplans = list_length(quals);
+	prunestate->constraints = constraints;
+	prunestate->quals = quals;
+	(void) prune_collect_params_walker((Node *) quals,
+									   &prunestate->execparams);
+	prunestate->validparams = NULL;
+	prunestate->prune_context = AllocSetContextCreate(CurrentMemoryContext,
+													  "Partition prune",
+													  ALLOCSET_SMALL_SIZES);
+
+	return prunestate;
+}
+
+/*
+ * ExecPartitionPruneParamsChanged
+ *	  Called on rescan with the parameters changed since the last scan,
+ *	  returns whether the subplans should be pruned again.
+ */
+bool
+ExecPartitionPruneParamsChanged(PartitionPruneState *prunestate,
+								Bitmapset *chgParam)
+{
+	if (!bms_overlap(chgParam, prunestate->execparams))
+		return false;
+
+	prunestate->validparams = bms_add_members(prunestate->validparams,
+											  bms_intersect(chgParam,
+												 prunestate->execparams));
+	return true;
+}
+
+/*
+ * ExecPartitionPrune
+ *	  Set pruned[i] for each subplan i that cannot return any row with the
+ *	  current parameter values.
+ */
+void
+ExecPartitionPrune(PartitionPruneState *prunestate, bool *pruned)
+{
+	ExprContext *econtext = prunestate->parent->ps_ExprContext;
+	MemoryContext oldcontext;
+	ListCell   *lcc;
+	ListCell   *lcq;
+	int			i = 0;
+
+	oldcontext = MemoryContextSwitchTo(prunestate->prune_context);
+
+	forboth(lcc, prunestate->constraints, lcq, prunestate->quals)
+	{
+		List	   *constraint = (List *) lfirst(lcc);
+		List	   *qual = (List *) lfirst(lcq);
+
+		pruned[i] = false;
+		if (qual != NIL)
+		{
+			qual = (List *) prune_eval_mutator((Node *) qual, prunestate);
+			pruned[i] = predicate_refuted_by(constraint, qual, false);
+		}
+		i++;
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextReset(prunestate->prune_context);
+	ResetExprContext(econtext);
+}
+
+/*
+ * Collect the ids of the PARAM_EXEC Params of an expression tree
+ */
+static bool
+prune_collect_params_walker(Node *node, Bitmapset **paramids)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Param))
+	{
+		Param	   *param = (Param *) node;
+
+		if (param->paramkind == PARAM_EXEC)
+			*paramids = bms_add_member(*paramids, param->paramid);
+		return false;
+	}
+	return expression_tree_walker(node, prune_collect_params_walker,
+								  (void *) paramids);
+}
+
+/*
+ * Check whether an expression tree uses a PARAM_EXEC Param whose value is
+ * not known yet.  The output parameters of initplans are computed on
+ * demand, so they are always known.
+ */
+static bool
+prune_unknown_param_walker(Node *node, PartitionPruneState *prunestate)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Param))
+	{
+		Param	   *param = (Param *) node;
+		ParamExecData *prm;
+
+		if (param->paramkind != PARAM_EXEC)
+			return false;
+		if (bms_is_member(param->paramid, prunestate->validparams))
+			return false;
+		prm = &prunestate->parent->ps_ExprContext->ecxt_param_exec_vals[param->paramid];
+		return prm->execPlan == NULL;
+	}
+	return expression_tree_walker(node, prune_unknown_param_walker,
+								  (void *) prunestate);
+}
+
+/*
+ * Replace the subexpressions that do not reference the scanned row by their
+ * current value.
+ *
+ * The planner only keeps restrictions without volatile functions, so the
+ * value cannot change during the scan.
+ */
+static Node *
+prune_eval_mutator(Node *node, PartitionPruneState *prunestate)
+{
+	if (node == NULL)
+		return NULL;
+
+	if (!IsA(node, List) && !IsA(node, Const) &&
+		!contain_var_clause(node) &&
+		!prune_unknown_param_walker(node, prunestate))
+	{
+		ExprContext *econtext = prunestate->parent->ps_ExprContext;
+		ExprState  *exprstate;
+		Oid			consttype = exprType(node);
+		int16		typlen;
+		bool		typbyval;
+		Datum		value;
+		bool		isnull;
+
+		exprstate = ExecInitExpr((Expr *) node, prunestate->parent);
+		value = ExecEvalExprSwitchContext(exprstate, econtext, &isnull);
+		get_typlenbyval(consttype, &typlen, &typbyval);
+
+		return (Node *) makeConst(consttype, exprTypmod(node),
+								  exprCollation(node), (int) typlen, value,
+								  isnull, typbyval);
+	}
+
+	return expression_tree_mutator(node, prune_eval_mutator,
+								   (void *) prunestate);
+}
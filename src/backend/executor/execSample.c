@@ -0,0 +1,554 @@
+/*-------------------------------------------------------------------------
+ *
+ * execSample.c
+ *	  Sampling profiler of the plan nodes being executed
+ *
+ * With executor_sample_interval set, every backend arms a timer when it
+ * starts a query, and ExecProcNodeFirst() installs a wrapper on all the
+ * plan nodes which keeps track of the node currently executing. The timer
+ * handler only flags that a sample is due; the wrapper notices it the next
+ * time control enters or leaves a node, and charges the sample to the node
+ * which was running, in a hash table in shared memory keyed by database,
+ * query id and plan node id. The timer is rearmed at the same time, so no
+ * timer runs in a backend which is not executing.
+ *
+ * The query id is the one of the plannedstmt, which is only set when a
+ * module such as pg_stat_statements computes it. On a Datanode, the
+ * fragments of a distributed query carry the query id of the Coordinator
+ * query, and keep the plan node ids of the Coordinator plan, so samples of
+ * all the nodes of the cluster can be matched, see
+ * pg_stat_executor_samples_cluster.
+ *
+ * Portions Copyright (c) 1996-2017, PostgreSQL Global Development Group
+ * Portions Copyright (c) 2010-2012 Postgres-XC Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/executor/execSample.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "commands/dbcommands.h"
+#include "executor/execSample.h"
+#include "executor/executor.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+#include "utils/timeout.h"
+#include "utils/timestamp.h"
+#ifdef PGXC
+#include "catalog/pgxc_node.h"
+#include "nodes/makefuncs.h"
+#include "pgxc/execRemote.h"
+#include "pgxc/pgxc.h"
+#include "pgxc/planner.h"
+#include "utils/snapmgr.h"
+#endif
+
+/* Number of distinct plan nodes the samples are kept for */
+#define EXEC_SAMPLE_MAX_ENTRIES		4096
+
+typedef struct ExecSampleKey
+{
+	Oid			dbid;
+	uint32		queryid;
+	int			plan_node_id;
+} ExecSampleKey;
+
+typedef struct ExecSampleEntry
+{
+	ExecSampleKey key;			/* hash key of entry - MUST BE FIRST */
+	NodeTag		node_tag;		/* type of the plan node */
+	uint64		samples;		/* samples taken while it was running */
+} ExecSampleEntry;
+
+/* Protected by ExecSampleLock */
+static HTAB *ExecSampleHash = NULL;
+
+int			ExecSampleInterval = 0;
+
+uint32		ExecSampleQueryId = 0;
+int			ExecSamplePlanNodeId = -1;
+NodeTag		ExecSampleNodeTag = T_Invalid;
+
+volatile sig_atomic_t ExecSamplePending = false;
+static volatile TimestampTz ExecSampleFiredAt = 0;
+
+static const char *ExecSampleNodeName(NodeTag tag);
+
+Size
+ExecSampleShmemSize(void)
+{
+	return hash_estimate_size(EXEC_SAMPLE_MAX_ENTRIES,
+							  sizeof(ExecSampleEntry));
+}
+
+void
+ExecSampleShmemInit(void)
+{
+	HASHCTL		info;
+
+	MemSet(&info, 0, sizeof(info));
+	info.keysize = sizeof(ExecSampleKey);
+	info.entrysize = sizeof(ExecSampleEntry);
+
+	ExecSampleHash = ShmemInitHash("Executor Samples",
+								   EXEC_SAMPLE_MAX_ENTRIES,
+								   EXEC_SAMPLE_MAX_ENTRIES,
+								   &info,
+								   HASH_ELEM | HASH_BLOBS);
+}
+
+/*
+ * Timeout handler, runs in the signal handler.
+ */
+void
+ExecSampleTimeoutHandler(void)
+{
+	ExecSampleFiredAt = GetCurrentTimestamp();
+	ExecSamplePending = true;
+}
+
+/*
+ * Set up sampling of a query about to be executed.
+ */
+void
+ExecSampleStart(EState *estate, PlanState *planstate)
+{
+	if (ExecSampleInterval <= 0 ||
+		(estate->es_top_eflags & EXEC_FLAG_EXPLAIN_ONLY))
+		return;
+
+	estate->es_sample = true;
+	estate->es_sample_queryid = estate->es_plannedstmt->queryId;
+#ifdef PGXC
+	/* Statements shipped by a Coordinator are charged to its query */
+	if (estate->es_sample_queryid == 0 && IS_PGXC_DATANODE &&
+		IsConnFromCoord())
+		estate->es_sample_queryid = PGXCRemoteQueryId;
+#endif
+
+	/* Until the first node is entered, time goes to the top node */
+	ExecSampleQueryId = estate->es_sample_queryid;
+	ExecSamplePlanNodeId = planstate->plan->plan_node_id;
+	ExecSampleNodeTag = nodeTag(planstate->plan);
+
+	/*
+	 * The timer is not running if the backend was idle when it last fired,
+	 * or if an error disabled it; forget about that sample.
+	 */
+	if (!get_timeout_active(EXEC_SAMPLE_TIMEOUT))
+	{
+		ExecSamplePending = false;
+		enable_timeout_after(EXEC_SAMPLE_TIMEOUT, ExecSampleInterval);
+	}
+}
+
+/*
+ * Charge the sample that is due to the plan node executing, and rearm the
+ * timer.
+ */
+void
+ExecSampleTake(void)
+{
+	ExecSampleKey key;
+	ExecSampleEntry *entry;
+	uint64		nsamples = 1;
+	bool		found;
+
+	ExecSamplePending = false;
+
+	/*
+	 * The node may have kept running through several intervals before
+	 * control got back to a wrapper, they all belong to it.
+	 */
+	if (ExecSampleInterval > 0)
+	{
+		long		secs;
+		int			usecs;
+
+		TimestampDifference(ExecSampleFiredAt, GetCurrentTimestamp(),
+							&secs, &usecs);
+		nsamples += (secs * 1000L + usecs / 1000) / ExecSampleInterval;
+
+		enable_timeout_after(EXEC_SAMPLE_TIMEOUT, ExecSampleInterval);
+	}
+
+	MemSet(&key, 0, sizeof(key));
+	key.dbid = MyDatabaseId;
+	key.queryid = ExecSampleQueryId;
+	key.plan_node_id = ExecSamplePlanNodeId;
+
+	LWLockAcquire(ExecSampleLock, LW_EXCLUSIVE);
+	/* Samples of new nodes are lost once the table is full */
+	entry = (ExecSampleEntry *) hash_search(ExecSampleHash, &key,
+											HASH_ENTER_NULL, &found);
+	if (entry)
+	{
+		if (!found)
+		{
+			entry->node_tag = ExecSampleNodeTag;
+			entry->samples = 0;
+		}
+		entry->samples += nsamples;
+	}
+	LWLockRelease(ExecSampleLock);
+}
+
+/*
+ * Name of a plan node type, as EXPLAIN shows it.
+ */
+static const char *
+ExecSampleNodeName(NodeTag tag)
+{
+	switch (tag)
+	{
+		case T_Result:
+			return "Result";
+		case T_ProjectSet:
+			return "ProjectSet";
+		case T_ModifyTable:
+			return "ModifyTable";
+		case T_Append:
+			return "Append";
+		case T_MergeAppend:
+			return "Merge Append";
+		case T_RecursiveUnion:
+			return "Recursive Union";
+		case T_BitmapAnd:
+			return "BitmapAnd";
+		case T_BitmapOr:
+			return "BitmapOr";
+		case T_SeqScan:
+			return "Seq Scan";
+		case T_SampleScan:
+			return "Sample Scan";
+		case T_IndexScan:
+			return "Index Scan";
+		case T_IndexOnlyScan:
+			return "Index Only Scan";
+		case T_BitmapIndexScan:
+			return "Bitmap Index Scan";
+		case T_BitmapHeapScan:
+			return "Bitmap Heap Scan";
+		case T_TidScan:
+			return "Tid Scan";
+		case T_SubqueryScan:
+			return "Subquery Scan";
+		case T_FunctionScan:
+			return "Function Scan";
+		case T_ValuesScan:
+			return "Values Scan";
+		case T_TableFuncScan:
+			return "Table Function Scan";
+		case T_CteScan:
+			return "CTE Scan";
+		case T_NamedTuplestoreScan:
+			return "Named Tuplestore Scan";
+		case T_WorkTableScan:
+			return "WorkTable Scan";
+		case T_ForeignScan:
+			return "Foreign Scan";
+		case T_CustomScan:
+			return "Custom Scan";
+		case T_NestLoop:
+			return "Nested Loop";
+		case T_MergeJoin:
+			return "Merge Join";
+		case T_HashJoin:
+			return "Hash Join";
+		case T_Material:
+			return "Materialize";
+		case T_Sort:
+			return "Sort";
+		case T_Group:
+			return "Group";
+		case T_Agg:
+			return "Aggregate";
+		case T_WindowAgg:
+			return "WindowAgg";
+		case T_Unique:
+			return "Unique";
+		case T_Gather:
+			return "Gather";
+		case T_GatherMerge:
+			return "Gather Merge";
+		case T_Hash:
+			return "Hash";
+		case T_SetOp:
+			return "SetOp";
+		case T_LockRows:
+			return "LockRows";
+		case T_Limit:
+			return "Limit";
+#ifdef PGXC
+		case T_RemoteQuery:
+			return "Remote Fast Query Execution";
+#endif
+#ifdef XCP
+		case T_RemoteSubplan:
+			return "Remote Subquery Scan";
+#endif
+		default:
+			return "???";
+	}
+}
+
+/*
+ * pg_stat_get_executor_samples
+ *
+ * Return the samples taken on the local node, one row per plan node.
+ */
+Datum
+pg_stat_get_executor_samples(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_EXECUTOR_SAMPLES_COLS	5
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	HASH_SEQ_STATUS hash_seq;
+	ExecSampleEntry *entry;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	LWLockAcquire(ExecSampleLock, LW_SHARED);
+	hash_seq_init(&hash_seq, ExecSampleHash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	{
+		Datum		values[PG_STAT_GET_EXECUTOR_SAMPLES_COLS];
+		bool		nulls[PG_STAT_GET_EXECUTOR_SAMPLES_COLS];
+
+		MemSet(nulls, 0, sizeof(nulls));
+
+		values[0] = ObjectIdGetDatum(entry->key.dbid);
+		values[1] = Int64GetDatum((int64) entry->key.queryid);
+		values[2] = Int32GetDatum(entry->key.plan_node_id);
+		values[3] = CStringGetTextDatum(ExecSampleNodeName(entry->node_tag));
+		values[4] = Int64GetDatum((int64) entry->samples);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+	LWLockRelease(ExecSampleLock);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_stat_reset_executor_samples
+ *
+ * Discard the samples taken on the local node.
+ */
+Datum
+pg_stat_reset_executor_samples(PG_FUNCTION_ARGS)
+{
+	HASH_SEQ_STATUS hash_seq;
+	ExecSampleEntry *entry;
+
+	LWLockAcquire(ExecSampleLock, LW_EXCLUSIVE);
+	hash_seq_init(&hash_seq, ExecSampleHash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+		hash_search(ExecSampleHash, &entry->key, HASH_REMOVE, NULL);
+	LWLockRelease(ExecSampleLock);
+
+	PG_RETURN_VOID();
+}
+
+#ifdef PGXC
+/*
+ * Run a query over pg_stat_executor_samples on all the Coordinators or
+ * Datanodes but this one, and add the rows it returns to tupstore.
+ */
+static void
+exec_sample_gather_remote(Tuplestorestate *tupstore, TupleDesc tupdesc,
+						  RemoteQueryExecType exec_type)
+{
+	RemoteQuery *step;
+	RemoteQueryState *node;
+	EState	   *estate;
+	TupleTableSlot *result;
+	MemoryContext oldcontext;
+	int			i;
+
+	step = makeNode(RemoteQuery);
+	step->combine_type = COMBINE_TYPE_NONE;
+	step->exec_nodes = NULL;
+	step->sql_statement =
+		"SELECT pgxc_node_str()::text, datname, queryid, plan_node_id, "
+		"node_type, samples FROM pg_stat_executor_samples";
+	step->force_autocommit = false;
+	step->read_only = true;
+	step->exec_type = exec_type;
+
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Var		   *var;
+
+		var = makeVar(1, i + 1,
+					  tupdesc->attrs[i]->atttypid,
+					  tupdesc->attrs[i]->atttypmod,
+					  InvalidOid,
+					  0);
+		step->scan.plan.targetlist = lappend(step->scan.plan.targetlist,
+											 makeTargetEntry((Expr *) var,
+															 i + 1,
+															 NULL,
+															 false));
+	}
+
+	estate = CreateExecutorState();
+
+	oldcontext = MemoryContextSwitchTo(estate->es_query_cxt);
+	estate->es_snapshot = GetActiveSnapshot();
+	node = ExecInitRemoteQuery(step, estate, 0);
+	MemoryContextSwitchTo(oldcontext);
+
+	result = ExecRemoteQuery((PlanState *) node);
+	while (result != NULL && !TupIsNull(result))
+	{
+		slot_getallattrs(result);
+		tuplestore_putvalues(tupstore, tupdesc, result->tts_values,
+							 result->tts_isnull);
+
+		result = ExecRemoteQuery((PlanState *) node);
+	}
+	ExecEndRemoteQuery(node);
+	FreeExecutorState(estate);
+}
+
+/*
+ * pgxc_stat_get_executor_samples
+ *
+ * Return the samples taken on all the nodes of the cluster, one row per
+ * node and plan node, backing pg_stat_executor_samples_cluster.
+ */
+Datum
+pgxc_stat_get_executor_samples(PG_FUNCTION_ARGS)
+{
+#define PGXC_STAT_GET_EXECUTOR_SAMPLES_COLS	6
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	HASH_SEQ_STATUS hash_seq;
+	ExecSampleEntry *entry;
+	List	   *local = NIL;
+	ListCell   *lc;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	if (!IS_PGXC_COORDINATOR)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("pgxc_stat_get_executor_samples() can only be called on a Coordinator")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/*
+	 * Copy the local entries first, looking up database names must not be
+	 * done while holding the lock.
+	 */
+	LWLockAcquire(ExecSampleLock, LW_SHARED);
+	hash_seq_init(&hash_seq, ExecSampleHash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	{
+		ExecSampleEntry *copy = (ExecSampleEntry *) palloc(sizeof(ExecSampleEntry));
+
+		memcpy(copy, entry, sizeof(ExecSampleEntry));
+		local = lappend(local, copy);
+	}
+	LWLockRelease(ExecSampleLock);
+
+	foreach(lc, local)
+	{
+		Datum		values[PGXC_STAT_GET_EXECUTOR_SAMPLES_COLS];
+		bool		nulls[PGXC_STAT_GET_EXECUTOR_SAMPLES_COLS];
+		char	   *datname;
+		NameData	datnamedata;
+
+		entry = (ExecSampleEntry *) lfirst(lc);
+		MemSet(nulls, 0, sizeof(nulls));
+
+		values[0] = CStringGetTextDatum(PGXCNodeName);
+		datname = get_database_name(entry->key.dbid);
+		if (datname)
+		{
+			namestrcpy(&datnamedata, datname);
+			values[1] = NameGetDatum(&datnamedata);
+		}
+		else
+			nulls[1] = true;
+		values[2] = Int64GetDatum((int64) entry->key.queryid);
+		values[3] = Int32GetDatum(entry->key.plan_node_id);
+		values[4] = CStringGetTextDatum(ExecSampleNodeName(entry->node_tag));
+		values[5] = Int64GetDatum((int64) entry->samples);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+	list_free_deep(local);
+
+	/* Only the Coordinator the client is connected to gathers */
+	if (IsConnFromApp())
+	{
+		exec_sample_gather_remote(tupstore, tupdesc, EXEC_ON_COORDS);
+		exec_sample_gather_remote(tupstore, tupdesc, EXEC_ON_DATANODES);
+	}
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+#endif
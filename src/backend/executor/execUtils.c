@@ -37,6 +37,9 @@
  *		GetAttributeByName		Runtime extraction of columns from tuples.
  *		GetAttributeByNum
  *
+ *		ExecQueryMemoryUsed		Memory accounting of the running query.
+ *		ExecCheckQueryMemory
+ *
  *	 NOTES
  *		This file has traditionally been the place to stick misc.
  *		executor support stuff that doesn't really go anyplace else.
@@ -51,12 +54,18 @@
 #include "nodes/nodeFuncs.h"
 #include "parser/parsetree.h"
 #include "storage/lmgr.h"
+#include "tcop/pquery.h"
 #include "utils/builtins.h"
 #include "utils/memutils.h"
+#include "utils/portal.h"
 #include "utils/rel.h"
 #include "utils/typcache.h"
 
 
+/* GUC parameter: memory a query may use, in kB, -1 means no limit */
+int			query_memory_limit = -1;
+
+
 static void ShutdownExprContext(ExprContext *econtext, bool isCommit);
 
 
@@ -137,6 +146,8 @@ CreateExecutorState(void)
 
 	estate->es_top_eflags = 0;
 	estate->es_instrument = 0;
+	estate->es_sample = false;
+	estate->es_sample_queryid = 0;
 	estate->es_finished = false;
 
 	estate->es_exprcontexts = NIL;
@@ -1019,3 +1030,63 @@ ExecCleanTargetListLength(List *targetlist)
 	}
 	return len;
 }
+
+/*
+ * ExecQueryMemoryUsed
+ *
+ * Memory held by the running query: that of its portal, which also holds
+ * the tuplestores that outlive the executor, or that of the executor state
+ * if the query does not run in the active portal, e.g. under SPI.  estate
+ * may be NULL if the caller runs in the portal.
+ *
+ * This walks the memory context tree, callers should only look at it every
+ * now and then.
+ */
+Size
+ExecQueryMemoryUsed(EState *estate)
+{
+	MemoryContext portalcxt = NULL;
+	MemoryContext cxt;
+
+	if (ActivePortal)
+		portalcxt = PortalGetHeapMemory(ActivePortal);
+
+	if (estate == NULL)
+		return portalcxt ? MemoryContextMemAllocated(portalcxt, true) : 0;
+
+	for (cxt = estate->es_query_cxt; cxt != NULL; cxt = cxt->parent)
+	{
+		if (cxt == portalcxt)
+			return MemoryContextMemAllocated(portalcxt, true);
+	}
+	return MemoryContextMemAllocated(estate->es_query_cxt, true);
+}
+
+/*
+ * ExecCheckQueryMemory
+ *
+ * Check the running query against query_memory_limit.  If it is over the
+ * limit, return true if the caller can spill to disk, so that it does;
+ * otherwise cancel the query before it exhausts the memory of the node.
+ */
+bool
+ExecCheckQueryMemory(EState *estate, bool canspill)
+{
+	Size		used;
+
+	if (query_memory_limit < 0)
+		return false;
+
+	used = ExecQueryMemoryUsed(estate);
+	if (used <= (Size) query_memory_limit * 1024L)
+		return false;
+
+	if (canspill)
+		return true;
+
+	ereport(ERROR,
+			(errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
+			 errmsg("query memory exceeds query_memory_limit (%dkB)",
+					query_memory_limit)));
+	return false;				/* keep compiler quiet */
+}
@@ -136,6 +136,20 @@
  *	  We can also support AGG_HASHED with multiple hash tables and no sorting
  *	  at all.
  *
+ *	  Spilling hashed aggregation:
+ *
+ *	  If the planner's group count estimate was too low, a plain AGG_HASHED
+ *	  node with a single hash table could grow far past work_mem.  To avoid
+ *	  that, we keep a running estimate of the table's size, and once it
+ *	  exceeds work_mem we stop creating new groups: input tuples belonging to
+ *	  groups already in the table are still aggregated, while the rest are
+ *	  written to a tuplestore (which itself spills to a temp file).  After the
+ *	  groups in memory have been returned, the hash table is emptied and
+ *	  refilled from the tuplestore, and so on until no tuples are deferred.
+ *	  Each pass completes at least one group, so this always terminates.
+ *	  AGG_MIXED and multiple hash tables are not handled; the planner keeps
+ *	  choosing those only when it expects them to fit.
+ *
  *	  From the perspective of aggregate transition and final functions, the
  *	  only issue regarding grouping sets is this: a single call site (flinfo)
  *	  of an aggregate function may be used for updating several different
@@ -214,6 +228,7 @@
 #include "catalog/pg_type.h"
 #include "executor/executor.h"
 #include "executor/nodeAgg.h"
+#include "executor/nodeSeqscan.h"
 #include "miscadmin.h"
 #include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
@@ -227,8 +242,13 @@
 #include "utils/memutils.h"
 #include "utils/syscache.h"
 #include "utils/tuplesort.h"
+#include "utils/tuplestore.h"
 #include "utils/datum.h"
+#include "utils/fmgroids.h"
+
 
+/* Size of the chunks the per-group states of hash entries are carved from */
+#define HASH_PERGROUP_CHUNK_SIZE	(32 * 1024L)
 
 /*
  * AggStatePerTransData - per aggregate state value information
@@ -282,6 +302,9 @@ typedef struct AggStatePerTransData
 	/* Oid of the state transition or combine function */
 	Oid			transfn_oid;
 
+	/* Is transfn the int8inc of COUNT(*) or COUNT(x)? */
+	bool		transfn_is_count;
+
 	/* Oid of the serialization function or InvalidOid */
 	Oid			serialfn_oid;
 
@@ -558,6 +581,7 @@ static TupleTableSlot *project_aggregates(AggState *aggstate);
 static Bitmapset *find_unaggregated_cols(AggState *aggstate);
 static bool find_unaggregated_cols_walker(Node *node, Bitmapset **colnos);
 static void build_hash_table(AggState *aggstate);
+static AggStatePerGroup alloc_hash_pergroup(AggState *aggstate);
 static TupleHashEntryData *lookup_hash_entry(AggState *aggstate);
 static AggStatePerGroup *lookup_hash_entries(AggState *aggstate);
 static TupleTableSlot *agg_retrieve_direct(AggState *aggstate);
@@ -893,6 +917,26 @@ advance_transition_function(AggState *aggstate,
 		}
 	}
 
+#ifdef USE_FLOAT8_BYVAL
+	/*
+	 * COUNT(*) and COUNT(x) are the most frequent aggregates of scan-heavy
+	 * Datanode fragments, and their transition function merely adds one to
+	 * a pass-by-value int8. Do that here rather than through the function
+	 * call interface, once per input row. See int8inc().
+	 */
+	if (pertrans->transfn_is_count && !pergroupstate->transValueIsNull)
+	{
+		int64		count = DatumGetInt64(pergroupstate->transValue);
+
+		if (count == PG_INT64_MAX)
+			ereport(ERROR,
+					(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+					 errmsg("bigint out of range")));
+		pergroupstate->transValue = Int64GetDatum(count + 1);
+		return;
+	}
+#endif
+
 	/* We run the transition functions in per-input-tuple memory context */
 	oldContext = MemoryContextSwitchTo(aggstate->tmpcontext->ecxt_per_tuple_memory);
 
@@ -1881,6 +1925,41 @@ build_hash_table(AggState *aggstate)
 												 tmpmem,
 												 DO_AGGSPLIT_SKIPFINAL(aggstate->aggsplit));
 	}
+
+	aggstate->hash_mem_used = 0;
+	aggstate->hash_spill_mode = false;
+	aggstate->hash_pergroup_chunk = NULL;
+	aggstate->hash_pergroup_free = 0;
+}
+
+/*
+ * Allocate the per-group states of a new hash table entry.
+ *
+ * They are only ever released all together, when the hashcontext is reset,
+ * so carve them out of large chunks instead of palloc'ing each of them:
+ * that saves the chunk header and power-of-two rounding of every entry.
+ */
+static AggStatePerGroup
+alloc_hash_pergroup(AggState *aggstate)
+{
+	Size		size = MAXALIGN(Max(sizeof(AggStatePerGroupData) * aggstate->numtrans, 1));
+	char	   *result;
+
+	if (size > aggstate->hash_pergroup_free)
+	{
+		Size		chunksize = Max(size, HASH_PERGROUP_CHUNK_SIZE);
+
+		aggstate->hash_pergroup_chunk =
+			MemoryContextAlloc(aggstate->hashcontext->ecxt_per_tuple_memory,
+							   chunksize);
+		aggstate->hash_pergroup_free = chunksize;
+	}
+
+	result = aggstate->hash_pergroup_chunk;
+	aggstate->hash_pergroup_chunk += size;
+	aggstate->hash_pergroup_free -= size;
+
+	return (AggStatePerGroup) result;
 }
 
 /*
@@ -2024,6 +2103,9 @@ hash_agg_entry_size(int numAggs)
  * set (which the caller must have selected - note that initialize_aggregate
  * depends on this).
  *
+ * In hash_spill_mode no new entries are created, and NULL is returned if the
+ * tuple's group is not already present.
+ *
  * When called, CurrentMemoryContext should be the per-query context.
  */
 static TupleHashEntryData *
@@ -2050,13 +2132,31 @@ lookup_hash_entry(AggState *aggstate)
 	ExecStoreVirtualTuple(hashslot);
 
 	/* find or create the hashtable entry using the filtered tuple */
+	if (aggstate->hash_spill_mode)
+		return LookupTupleHashEntry(perhash->hashtable, hashslot, NULL);
+
 	entry = LookupTupleHashEntry(perhash->hashtable, hashslot, &isnew);
 
 	if (isnew)
 	{
-		entry->additional = (AggStatePerGroup)
-			MemoryContextAlloc(perhash->hashtable->tablecxt,
-							   sizeof(AggStatePerGroupData) * aggstate->numtrans);
+		/*
+		 * Like the planner's estimate, this doesn't count pass-by-reference
+		 * transition values, which we can't track cheaply.
+		 */
+		aggstate->hash_mem_used += hash_agg_entry_size(aggstate->numtrans) +
+			MAXALIGN(entry->firstTuple->t_len);
+
+		entry->additional = alloc_hash_pergroup(aggstate);
+
+		/*
+		 * Keep within query_memory_limit as well: spill from now on if this
+		 * node can, otherwise the check cancels the query.
+		 */
+		if (query_memory_limit >= 0 &&
+			++aggstate->hash_new_groups % QUERY_MEMORY_CHECK_INTERVAL == 0 &&
+			ExecCheckQueryMemory(aggstate->ss.ps.state,
+								 aggstate->hash_spill_ok))
+			aggstate->hash_spill_mode = true;
 		/* initialize aggregates for new tuple group */
 		initialize_aggregates(aggstate, (AggStatePerGroup) entry->additional,
 							  -1);
@@ -2154,6 +2254,9 @@ agg_retrieve_direct(AggState *aggstate)
 	int			nextSetSize;
 	int			numReset;
 	int			i;
+#ifdef USE_FLOAT8_BYVAL
+	uint64		ntuples;
+#endif
 
 	/*
 	 * get state info from node
@@ -2296,6 +2399,34 @@ agg_retrieve_direct(AggState *aggstate)
 			Assert(aggstate->projected_set < numGroupingSets);
 			Assert(nextSetSize > 0 || aggstate->input_done);
 		}
+#ifdef USE_FLOAT8_BYVAL
+		else if (aggstate->count_fastpath &&
+				 ExecSeqScanCount(castNode(SeqScanState, outerPlanState(aggstate)),
+								  &ntuples))
+		{
+			/*
+			 * The input is a plain sequential scan, and all we aggregate is
+			 * count(*), so advance the count by the number of tuples the scan
+			 * has without fetching them.  Like advance_transition_function,
+			 * this relies on the int8 state being pass-by-value.
+			 */
+			int64		count;
+
+			aggstate->projected_set = 0;
+			initialize_aggregates(aggstate, pergroup, numReset);
+
+			Assert(!pergroup[0].transValueIsNull);
+			count = DatumGetInt64(pergroup[0].transValue);
+			if (ntuples > (uint64) (PG_INT64_MAX - count))
+				ereport(ERROR,
+						(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+						 errmsg("bigint out of range")));
+			pergroup[0].transValue = Int64GetDatum(count + (int64) ntuples);
+
+			aggstate->agg_done = true;
+			econtext->ecxt_outertuple = firstSlot;
+		}
+#endif
 		else
 		{
 			/*
@@ -2497,21 +2628,66 @@ agg_fill_hash_table(AggState *aggstate)
 
 	/*
 	 * Process each outer-plan tuple, and then fetch the next one, until we
-	 * exhaust the outer plan.
+	 * exhaust the outer plan.  On later passes of a spilling aggregate, the
+	 * input is the tuples deferred by the previous pass instead.
 	 */
 	for (;;)
 	{
 		AggStatePerGroup *pergroups;
 
-		outerslot = fetch_input_tuple(aggstate);
-		if (TupIsNull(outerslot))
-			break;
+		if (aggstate->hash_spill_in)
+		{
+			outerslot = aggstate->hash_spill_slot;
+			if (!tuplestore_gettupleslot(aggstate->hash_spill_in, true, false,
+										 outerslot))
+				break;
+		}
+		else
+		{
+			outerslot = fetch_input_tuple(aggstate);
+			if (TupIsNull(outerslot))
+				break;
+		}
 
 		/* set up for lookup_hash_entries and advance_aggregates */
 		tmpcontext->ecxt_outertuple = outerslot;
 
-		/* Find or build hashtable entries */
-		pergroups = lookup_hash_entries(aggstate);
+		/* Switch to spilling once the hash table has grown too large */
+		if (aggstate->hash_spill_ok && !aggstate->hash_spill_mode &&
+			aggstate->hash_mem_used > work_mem * 1024L)
+			aggstate->hash_spill_mode = true;
+
+		if (aggstate->hash_spill_mode)
+		{
+			TupleHashEntryData *entry;
+
+			select_current_set(aggstate, 0, true);
+			entry = lookup_hash_entry(aggstate);
+			if (entry == NULL)
+			{
+				/* Group isn't in memory; defer the tuple to the next pass */
+				if (aggstate->hash_spill_out == NULL)
+				{
+					MemoryContext oldcontext;
+
+					oldcontext = MemoryContextSwitchTo(aggstate->ss.ps.state->es_query_cxt);
+					aggstate->hash_spill_out =
+						tuplestore_begin_heap(false, false, work_mem);
+					MemoryContextSwitchTo(oldcontext);
+				}
+				tuplestore_puttupleslot(aggstate->hash_spill_out, outerslot);
+				aggstate->hash_spilled = true;
+				ResetExprContext(aggstate->tmpcontext);
+				continue;
+			}
+			pergroups = aggstate->hash_pergroup;
+			pergroups[0] = (AggStatePerGroup) entry->additional;
+		}
+		else
+		{
+			/* Find or build hashtable entries */
+			pergroups = lookup_hash_entries(aggstate);
+		}
 
 		/* Advance the aggregates */
 		if (DO_AGGSPLIT_COMBINE(aggstate->aggsplit))
@@ -2526,6 +2702,13 @@ agg_fill_hash_table(AggState *aggstate)
 		ResetExprContext(aggstate->tmpcontext);
 	}
 
+	/* This pass's input has been consumed */
+	if (aggstate->hash_spill_in)
+	{
+		tuplestore_end(aggstate->hash_spill_in);
+		aggstate->hash_spill_in = NULL;
+	}
+
 	aggstate->table_filled = true;
 	/* Initialize to walk the first hash table */
 	select_current_set(aggstate, 0, true);
@@ -2595,6 +2778,22 @@ agg_retrieve_hash_table(AggState *aggstate)
 
 				continue;
 			}
+			else if (aggstate->hash_spill_out != NULL)
+			{
+				/*
+				 * All groups in memory have been returned, but some input was
+				 * deferred.  Empty the hash table and aggregate the deferred
+				 * tuples into it, which may in turn defer some of them again.
+				 */
+				ReScanExprContext(aggstate->hashcontext);
+				build_hash_table(aggstate);
+				aggstate->hash_spill_in = aggstate->hash_spill_out;
+				aggstate->hash_spill_out = NULL;
+				agg_fill_hash_table(aggstate);
+
+				perhash = &aggstate->perhash[aggstate->current_set];
+				continue;
+			}
 			else
 			{
 				/* No more hashtables, so done */
@@ -3014,6 +3213,18 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 		find_hash_columns(aggstate);
 		build_hash_table(aggstate);
 		aggstate->table_filled = false;
+
+		/*
+		 * Only a plain hashed aggregate with one hash table can spill; see
+		 * the file header comment.
+		 */
+		if (node->aggstrategy == AGG_HASHED && numHashes == 1)
+		{
+			aggstate->hash_spill_ok = true;
+			aggstate->hash_spill_slot = ExecInitExtraTupleSlot(estate);
+			ExecSetSlotDescriptor(aggstate->hash_spill_slot,
+								  ExecGetResultType(outerPlanState(aggstate)));
+		}
 	}
 
 	if (node->aggstrategy != AGG_HASHED)
@@ -3392,6 +3603,27 @@ ExecInitAgg(Agg *node, EState *estate, int eflags)
 												 NULL);
 	ExecSetSlotDescriptor(aggstate->evalslot, aggstate->evaldesc);
 
+	/*
+	 * A count(*) straight over a sequential scan without quals, such as the
+	 * Datanode part of count(*) on a distributed table, only needs to know
+	 * how many tuples the scan returns.  See agg_retrieve_direct.
+	 */
+	aggstate->count_fastpath = false;
+	if (node->aggstrategy == AGG_PLAIN && node->groupingSets == NIL &&
+		!DO_AGGSPLIT_COMBINE(aggstate->aggsplit) &&
+		aggstate->numtrans == 1 &&
+		IsA(outerPlan, SeqScan) && outerPlan->qual == NIL &&
+		!outerPlan->parallel_aware)
+	{
+		AggStatePerTrans pertrans = &pertransstates[0];
+
+		aggstate->count_fastpath = (pertrans->transfn_oid == F_INT8INC &&
+									pertrans->aggref->aggstar &&
+									pertrans->aggref->aggfilter == NULL &&
+									pertrans->aggref->aggdistinct == NIL &&
+									pertrans->aggref->aggorder == NIL);
+	}
+
 	return aggstate;
 }
 
@@ -3428,6 +3660,8 @@ build_pertrans_for_aggref(AggStatePerTrans pertrans,
 	pertrans->aggref = aggref;
 	pertrans->aggCollation = aggref->inputcollid;
 	pertrans->transfn_oid = aggtransfn;
+	pertrans->transfn_is_count = (aggtransfn == F_INT8INC ||
+								  aggtransfn == F_INT8INC_ANY);
 	pertrans->serialfn_oid = aggserialfn;
 	pertrans->deserialfn_oid = aggdeserialfn;
 	pertrans->initValue = initValue;
@@ -3858,6 +4092,12 @@ ExecEndAgg(AggState *node)
 	if (node->sort_out)
 		tuplesort_end(node->sort_out);
 
+	/* Likewise any tuplestores of deferred hashed input */
+	if (node->hash_spill_in)
+		tuplestore_end(node->hash_spill_in);
+	if (node->hash_spill_out)
+		tuplestore_end(node->hash_spill_out);
+
 	for (transno = 0; transno < node->numtrans; transno++)
 	{
 		AggStatePerTrans pertrans = &node->pertrans[transno];
@@ -3916,9 +4156,11 @@ ExecReScanAgg(AggState *node)
 		 * If we do have the hash table, and the subplan does not have any
 		 * parameter changes, and none of our own parameter changes affect
 		 * input expressions of the aggregated functions, then we can just
-		 * rescan the existing hash table; no need to build it again.
+		 * rescan the existing hash table; no need to build it again.  That
+		 * doesn't work if input was spilled, since the table then holds only
+		 * the groups of the last pass.
 		 */
-		if (outerPlan->chgParam == NULL &&
+		if (!node->hash_spilled && outerPlan->chgParam == NULL &&
 			!bms_overlap(node->ss.ps.chgParam, aggnode->aggParams))
 		{
 			ResetTupleHashIterator(node->perhash[0].hashtable,
@@ -3979,6 +4221,18 @@ ExecReScanAgg(AggState *node)
 		/* Rebuild an empty hash table */
 		build_hash_table(node);
 		node->table_filled = false;
+		/* Discard any deferred input of an unfinished spilling scan */
+		if (node->hash_spill_in)
+		{
+			tuplestore_end(node->hash_spill_in);
+			node->hash_spill_in = NULL;
+		}
+		if (node->hash_spill_out)
+		{
+			tuplestore_end(node->hash_spill_out);
+			node->hash_spill_out = NULL;
+		}
+		node->hash_spilled = false;
 		/* iterator will be reset when the table is filled */
 	}
 
@@ -58,6 +58,7 @@
 #include "postgres.h"
 
 #include "executor/execdebug.h"
+#include "executor/execPrune.h"
 #include "executor/nodeAppend.h"
 #include "miscadmin.h"
 
@@ -83,6 +84,18 @@ exec_append_initialize_next(AppendState *appendstate)
 	 */
 	whichplan = appendstate->as_whichplan;
 
+	/* Step over the subplans pruned for the current parameters */
+	if (appendstate->as_pruned != NULL)
+	{
+		int			step;
+
+		step = ScanDirectionIsForward(appendstate->ps.state->es_direction) ? 1 : -1;
+		while (whichplan >= 0 && whichplan < appendstate->as_nplans &&
+			   appendstate->as_pruned[whichplan])
+			whichplan += step;
+		appendstate->as_whichplan = whichplan;
+	}
+
 	if (whichplan < 0)
 	{
 		/*
@@ -156,8 +169,19 @@ ExecInitAppend(Append *node, EState *estate, int eflags)
 	 * Miscellaneous initialization
 	 *
 	 * Append plans don't have expression contexts because they never call
-	 * ExecQual or ExecProject.
+	 * ExecQual or ExecProject, except to evaluate the restrictions used to
+	 * prune the subplans.
 	 */
+	if (node->part_prune_quals != NIL && !(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+	{
+		ExecAssignExprContext(estate, &appendstate->ps);
+		appendstate->as_prunestate =
+			ExecInitPartitionPrune(&appendstate->ps,
+								   node->part_prune_constraints,
+								   node->part_prune_quals);
+		appendstate->as_pruned = (bool *) palloc0(nplans * sizeof(bool));
+		ExecPartitionPrune(appendstate->as_prunestate, appendstate->as_pruned);
+	}
 
 	/*
 	 * append nodes still have Result slots, which hold pointers to tuples, so
@@ -211,6 +235,14 @@ ExecAppend(PlanState *pstate)
 
 		CHECK_FOR_INTERRUPTS();
 
+		/*
+		 * A rescan may have pruned the subplan we stopped at
+		 */
+		if (node->as_pruned != NULL &&
+			node->as_pruned[node->as_whichplan] &&
+			!exec_append_initialize_next(node))
+			return ExecClearTuple(node->ps.ps_ResultTupleSlot);
+
 		/*
 		 * figure out which subplan we are currently processing
 		 */
@@ -273,6 +305,9 @@ ExecEndAppend(AppendState *node)
 	 */
 	for (i = 0; i < nplans; i++)
 		ExecEndNode(appendplans[i]);
+
+	if (node->ps.ps_ExprContext)
+		ExecFreeExprContext(&node->ps);
 }
 
 void
@@ -280,6 +315,12 @@ ExecReScanAppend(AppendState *node)
 {
 	int			i;
 
+	/* New parameter values may prune a different set of subplans */
+	if (node->as_prunestate != NULL && node->ps.chgParam != NULL &&
+		ExecPartitionPruneParamsChanged(node->as_prunestate,
+										node->ps.chgParam))
+		ExecPartitionPrune(node->as_prunestate, node->as_pruned);
+
 	for (i = 0; i < node->as_nplans; i++)
 	{
 		PlanState  *subnode = node->appendplans[i];
@@ -293,9 +334,11 @@ ExecReScanAppend(AppendState *node)
 
 		/*
 		 * If chgParam of subnode is not null then plan will be re-scanned by
-		 * first ExecProcNode.
+		 * first ExecProcNode.  A pruned subplan is rescanned once it is no
+		 * longer pruned.
 		 */
-		if (subnode->chgParam == NULL)
+		if (subnode->chgParam == NULL &&
+			!(node->as_pruned != NULL && node->as_pruned[i]))
 			ExecReScan(subnode);
 	}
 	node->as_whichplan = 0;
@@ -32,6 +32,8 @@
 #include "executor/nodeHash.h"
 #include "executor/nodeHashjoin.h"
 #include "miscadmin.h"
+#include "pgxc/locator.h"
+#include "pgxc/squeue.h"
 #include "utils/dynahash.h"
 #include "utils/memutils.h"
 #include "utils/lsyscache.h"
@@ -47,6 +49,7 @@ static void ExecHashSkewTableInsert(HashJoinTable hashtable,
 						uint32 hashvalue,
 						int bucketNumber);
 static void ExecHashRemoveNextSkewBucket(HashJoinTable hashtable);
+static void ExecHashFilterAdd(HashState *node, ExprContext *econtext);
 
 static void *dense_alloc(HashJoinTable hashtable, Size size);
 
@@ -68,6 +71,14 @@ ExecHash(PlanState *pstate)
  *
  *		build hash table for hashjoin, doing partitioning if more
  *		than one batch is required.
+ *
+ *		The hash table is private to this backend.  Under a Gather, each
+ *		parallel worker therefore builds its own complete copy of the
+ *		inner relation's table; sharing one table between workers would
+ *		need it (and the batch files) to live in DSA memory, with the
+ *		workers stepping through build, batch growth and probing in
+ *		lock-step.  The planner charges every worker the full build cost,
+ *		so it only picks such plans when the inner side is cheap enough.
  * ----------------------------------------------------------------
  */
 Node *
@@ -96,6 +107,10 @@ MultiExecHash(HashState *node)
 	hashkeys = node->hashkeys;
 	econtext = node->ps.ps_ExprContext;
 
+	/* Keys of previous scan are of no interest */
+	if (node->filter)
+		memset(VARDATA(node->filter), 0, SQUEUE_FILTER_SIZE);
+
 	/*
 	 * get all inner tuples and insert into the hash table (or temp files)
 	 */
@@ -112,6 +127,9 @@ MultiExecHash(HashState *node)
 		{
 			int			bucketNumber;
 
+			if (node->filterKeyNo > 0)
+				ExecHashFilterAdd(node, econtext);
+
 			bucketNumber = ExecHashGetSkewBucket(hashtable, hashvalue);
 			if (bucketNumber != INVALID_SKEW_BUCKET_NO)
 			{
@@ -152,6 +170,37 @@ MultiExecHash(HashState *node)
 	return NULL;
 }
 
+/*
+ * ExecHashFilterAdd
+ *		Add the filter key of the inner tuple to the Bloom filter of the keys.
+ *
+ * The filter is sent to the producers of the outer side of the join, so it
+ * uses the same hash of the key the producers use to distribute the rows.
+ */
+static void
+ExecHashFilterAdd(HashState *node, ExprContext *econtext)
+{
+	ExprState  *keyexpr = (ExprState *) list_nth(node->hashkeys,
+												 node->filterKeyNo - 1);
+	MemoryContext oldContext;
+	Datum		keyval;
+	bool		isNull;
+
+	if (node->filter == NULL)
+	{
+		node->filter = (bytea *) MemoryContextAllocZero(node->ps.state->es_query_cxt,
+														VARHDRSZ + SQUEUE_FILTER_SIZE);
+		SET_VARSIZE(node->filter, VARHDRSZ + SQUEUE_FILTER_SIZE);
+	}
+
+	oldContext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+	keyval = ExecEvalExpr(keyexpr, econtext, &isNull);
+	if (!isNull)
+		SharedQueueFilterAdd(VARDATA(node->filter),
+							 DistribKeyHash(node->filterKeyType, keyval));
+	MemoryContextSwitchTo(oldContext);
+}
+
 /* ----------------------------------------------------------------
  *		ExecInitHash
  *
@@ -1088,6 +1137,13 @@ ExecScanHashBucket(HashJoinState *hjstate,
 		{
 			TupleTableSlot *inntuple;
 
+			/*
+			 * Evaluating the join quals takes a while, so start fetching the
+			 * next tuple of the chain in case they fail.
+			 */
+			if (hashTuple->next != NULL)
+				pg_prefetch(hashTuple->next);
+
 			/* insert hashtable's tuple into exec slot so ExecQual sees it */
 			inntuple = ExecStoreMinimalTuple(HJTUPLE_MINTUPLE(hashTuple),
 											 hjstate->hj_HashTupleSlot,
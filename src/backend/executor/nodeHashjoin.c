@@ -21,6 +21,8 @@
 #include "executor/nodeHash.h"
 #include "executor/nodeHashjoin.h"
 #include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
+#include "pgxc/execRemote.h"
 #include "utils/memutils.h"
 
 
@@ -140,7 +142,8 @@ ExecHashJoin(PlanState *pstate)
 				}
 				else if (HJ_FILL_OUTER(node) ||
 						 (outerNode->plan->startup_cost < hashNode->ps.plan->total_cost &&
-						  !node->hj_OuterNotEmpty))
+						  !node->hj_OuterNotEmpty &&
+						  hashNode->filterKeyNo == 0))
 				{
 					node->hj_FirstOuterTupleSlot = ExecProcNode(outerNode);
 					if (TupIsNull(node->hj_FirstOuterTupleSlot))
@@ -168,6 +171,14 @@ ExecHashJoin(PlanState *pstate)
 				hashNode->hashtable = hashtable;
 				(void) MultiExecProcNode((PlanState *) hashNode);
 
+				/*
+				 * Let the outer side know the keys it should send us, before
+				 * it starts.
+				 */
+				if (hashNode->filterKeyNo > 0)
+					((RemoteSubplanState *) outerNode)->bloomFilter =
+						hashNode->filter;
+
 				/*
 				 * If the inner relation is completely empty, and we're not
 				 * doing a left outer join, we can quit without scanning the
@@ -534,6 +545,23 @@ ExecInitHashJoin(HashJoin *node, EState *estate, int eflags)
 	/* child Hash node needs to evaluate inner hash keys, too */
 	((HashState *) innerPlanState(hjstate))->hashkeys = rclauses;
 
+	/*
+	 * If the outer side is redistributed on one of the hash keys, and the
+	 * planner found it worth, the Hash node collects the Bloom filter of the
+	 * key, and the remote producers do not send the rows which can not match.
+	 */
+	if (IsA(outerPlanState(hjstate), RemoteSubplanState) &&
+		!((RemoteSubplanState *) outerPlanState(hjstate))->local_exec &&
+		((RemoteSubplan *) outerNode)->bloomKeyNo > 0)
+	{
+		HashState  *hstate = (HashState *) innerPlanState(hjstate);
+		ExprState  *keyexpr;
+
+		hstate->filterKeyNo = ((RemoteSubplan *) outerNode)->bloomKeyNo;
+		keyexpr = (ExprState *) list_nth(rclauses, hstate->filterKeyNo - 1);
+		hstate->filterKeyType = exprType((Node *) keyexpr->expr);
+	}
+
 	hjstate->hj_JoinState = HJ_BUILD_HASHTABLE;
 	hjstate->hj_MatchedOuter = false;
 	hjstate->hj_OuterNotEmpty = false;
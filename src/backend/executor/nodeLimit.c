@@ -25,6 +25,9 @@
 #include "executor/nodeLimit.h"
 #include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
+#ifdef XCP
+#include "pgxc/execRemote.h"
+#endif
 
 static void recompute_limits(LimitState *node);
 static void pass_down_bound(LimitState *node, PlanState *child_node);
@@ -308,6 +311,8 @@ recompute_limits(LimitState *node)
  * since the MergeAppend surely need read no more than that many tuples from
  * any one input.  We also have to be prepared to look through a Result,
  * since the planner might stick one atop MergeAppend for projection purposes.
+ * In Postgres-XL a RemoteSubplan is told the bound too, since it need not
+ * fetch more than that many tuples from any one remote node.
  *
  * This is a bit of a kluge, but we don't have any more-abstract way of
  * communicating between the two nodes; and it doesn't seem worth trying
@@ -355,6 +360,25 @@ pass_down_bound(LimitState *node, PlanState *child_node)
 		if (outerPlanState(child_node))
 			pass_down_bound(node, outerPlanState(child_node));
 	}
+#ifdef XCP
+	else if (IsA(child_node, RemoteSubplanState))
+	{
+		/*
+		 * Remote nodes need not send more rows than we are going to return,
+		 * the subplan requests no more than that from each of them.
+		 */
+		RemoteSubplanState *rsState = (RemoteSubplanState *) child_node;
+		int64		tuples_needed = node->count + node->offset;
+
+		if (node->noCount || tuples_needed < 0)
+			rsState->tuples_bounded = false;
+		else
+		{
+			rsState->tuples_bounded = true;
+			rsState->tuples_needed = tuples_needed;
+		}
+	}
+#endif
 }
 
 /* ----------------------------------------------------------------
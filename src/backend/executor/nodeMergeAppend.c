@@ -39,6 +39,7 @@
 #include "postgres.h"
 
 #include "executor/execdebug.h"
+#include "executor/execPrune.h"
 #include "executor/nodeMergeAppend.h"
 #include "lib/binaryheap.h"
 #include "miscadmin.h"
@@ -102,8 +103,19 @@ ExecInitMergeAppend(MergeAppend *node, EState *estate, int eflags)
 	 * Miscellaneous initialization
 	 *
 	 * MergeAppend plans don't have expression contexts because they never
-	 * call ExecQual or ExecProject.
+	 * call ExecQual or ExecProject, except to evaluate the restrictions used
+	 * to prune the subplans.
 	 */
+	if (node->part_prune_quals != NIL && !(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+	{
+		ExecAssignExprContext(estate, &mergestate->ps);
+		mergestate->ms_prunestate =
+			ExecInitPartitionPrune(&mergestate->ps,
+								   node->part_prune_constraints,
+								   node->part_prune_quals);
+		mergestate->ms_pruned = (bool *) palloc0(nplans * sizeof(bool));
+		ExecPartitionPrune(mergestate->ms_prunestate, mergestate->ms_pruned);
+	}
 
 	/*
 	 * MergeAppend nodes do have Result slots, which hold pointers to tuples,
@@ -188,6 +200,8 @@ ExecMergeAppend(PlanState *pstate)
 		 */
 		for (i = 0; i < node->ms_nplans; i++)
 		{
+			if (node->ms_pruned != NULL && node->ms_pruned[i])
+				continue;
 			node->ms_slots[i] = ExecProcNode(node->mergeplans[i]);
 			if (!TupIsNull(node->ms_slots[i]))
 				binaryheap_add_unordered(node->ms_heap, Int32GetDatum(i));
@@ -292,6 +306,9 @@ ExecEndMergeAppend(MergeAppendState *node)
 	 */
 	for (i = 0; i < nplans; i++)
 		ExecEndNode(mergeplans[i]);
+
+	if (node->ps.ps_ExprContext)
+		ExecFreeExprContext(&node->ps);
 }
 
 void
@@ -299,6 +316,12 @@ ExecReScanMergeAppend(MergeAppendState *node)
 {
 	int			i;
 
+	/* New parameter values may prune a different set of subplans */
+	if (node->ms_prunestate != NULL && node->ps.chgParam != NULL &&
+		ExecPartitionPruneParamsChanged(node->ms_prunestate,
+										node->ps.chgParam))
+		ExecPartitionPrune(node->ms_prunestate, node->ms_pruned);
+
 	for (i = 0; i < node->ms_nplans; i++)
 	{
 		PlanState  *subnode = node->mergeplans[i];
@@ -312,9 +335,11 @@ ExecReScanMergeAppend(MergeAppendState *node)
 
 		/*
 		 * If chgParam of subnode is not null then plan will be re-scanned by
-		 * first ExecProcNode.
+		 * first ExecProcNode.  A pruned subplan is rescanned once it is no
+		 * longer pruned.
 		 */
-		if (subnode->chgParam == NULL)
+		if (subnode->chgParam == NULL &&
+			!(node->ms_pruned != NULL && node->ms_pruned[i]))
 			ExecReScan(subnode);
 	}
 	binaryheap_reset(node->ms_heap);
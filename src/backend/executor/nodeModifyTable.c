@@ -47,6 +47,9 @@
 #include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
 #include "parser/parsetree.h"
+#ifdef XCP
+#include "pgxc/pgxc.h"
+#endif
 #include "storage/bufmgr.h"
 #include "storage/lmgr.h"
 #include "utils/builtins.h"
@@ -600,7 +603,11 @@ ExecInsert(ModifyTableState *mtstate,
 			 */
 			newId = heap_insert(resultRelationDesc, tuple,
 								estate->es_output_cid,
+#ifdef XCP
+								0, mtstate->mt_bistate);
+#else
 								0, NULL);
+#endif
 
 			/* insert index entries for tuple */
 			if (resultRelInfo->ri_NumIndices > 0)
@@ -1934,6 +1941,25 @@ ExecInitModifyTable(ModifyTable *node, EState *estate, int eflags)
 		mtstate->mt_partition_tuple_slot = partition_tuple_slot;
 	}
 
+#ifdef XCP
+	/*
+	 * A Datanode running INSERT ... SELECT whose rows are redistributed
+	 * from the other Datanodes receives a stream of tuples for the same
+	 * relation, like COPY FROM does. Use a bulk insert state so that heap
+	 * pages are filled one after the other through a ring buffer instead of
+	 * looking up free space and flooding shared buffers for every row. This
+	 * is not done with tuple routing, where consecutive rows may go to
+	 * different relations, nor with ON CONFLICT.
+	 */
+	mtstate->mt_bistate = NULL;
+	if (IS_PGXC_DATANODE && operation == CMD_INSERT && nplans == 1 &&
+		IsA(linitial(node->plans), RemoteSubplan) &&
+		node->onConflictAction == ONCONFLICT_NONE &&
+		mtstate->mt_partition_dispatch_info == NULL &&
+		mtstate->resultRelInfo->ri_FdwRoutine == NULL)
+		mtstate->mt_bistate = GetBulkInsertState();
+#endif
+
 	/* Build state for collecting transition tuples */
 	ExecSetupTransitionCaptureState(mtstate, estate);
 
@@ -2322,6 +2348,11 @@ ExecEndModifyTable(ModifyTableState *node)
 	if (node->mt_transition_capture != NULL)
 		DestroyTransitionCaptureState(node->mt_transition_capture);
 
+#ifdef XCP
+	if (node->mt_bistate)
+		FreeBulkInsertState(node->mt_bistate);
+#endif
+
 	/*
 	 * Allow any FDWs to shut down
 	 */
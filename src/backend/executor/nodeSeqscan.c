@@ -19,6 +19,7 @@
  *		ExecInitSeqScan			creates and initializes a seqscan node.
  *		ExecEndSeqScan			releases any storage allocated.
  *		ExecReScanSeqScan		rescans the relation
+ *		ExecSeqScanCount		counts the tuples the scan would return
  *
  *		ExecSeqScanEstimate		estimates DSM space needed for parallel scan
  *		ExecSeqScanInitializeDSM initialize DSM for parallel scan
@@ -27,7 +28,9 @@
 #include "postgres.h"
 
 #include "access/relscan.h"
+#include "access/heapam.h"
 #include "executor/execdebug.h"
+#include "executor/instrument.h"
 #include "executor/nodeSeqscan.h"
 #include "utils/rel.h"
 
@@ -131,6 +134,48 @@ ExecSeqScan(PlanState *pstate)
 					(ExecScanRecheckMtd) SeqRecheck);
 }
 
+/* ----------------------------------------------------------------
+ *		ExecSeqScanCount(node, count)
+ *
+ *		Counts the tuples the scan would return, without returning
+ *		them.  This is only possible for a scan without quals that has
+ *		not started yet; returns false if the scan cannot be counted
+ *		this way, in which case it must be run as usual.
+ * ----------------------------------------------------------------
+ */
+bool
+ExecSeqScanCount(SeqScanState *node, uint64 *count)
+{
+	HeapScanDesc scandesc = node->ss.ss_currentScanDesc;
+	EState	   *estate = node->ss.ps.state;
+
+	if (node->ss.ps.qual != NULL || estate->es_epqTuple != NULL)
+		return false;
+
+	if (scandesc == NULL)
+	{
+		scandesc = heap_beginscan(node->ss.ss_currentRelation,
+								  estate->es_snapshot,
+								  0, NULL);
+		node->ss.ss_currentScanDesc = scandesc;
+	}
+
+	/* heap_count_tuples needs a serial page-at-a-time scan */
+	if (!scandesc->rs_pageatatime || scandesc->rs_parallel != NULL ||
+		scandesc->rs_inited)
+		return false;
+
+	if (node->ss.ps.instrument)
+		InstrStartNode(node->ss.ps.instrument);
+
+	*count = heap_count_tuples(scandesc);
+
+	if (node->ss.ps.instrument)
+		InstrStopNode(node->ss.ps.instrument, (double) *count);
+
+	return true;
+}
+
 /* ----------------------------------------------------------------
  *		InitScanRelation
  *
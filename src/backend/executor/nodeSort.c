@@ -21,6 +21,11 @@
 #include "utils/tuplesort.h"
 
 
+static TupleTableSlot *ExecIncrementalSort(PlanState *pstate);
+static bool presorted_keys_equal(SortState *node, TupleTableSlot *a,
+					 TupleTableSlot *b);
+
+
 /* ----------------------------------------------------------------
  *		ExecSort
  *
@@ -145,6 +150,150 @@ ExecSort(PlanState *pstate)
 	return slot;
 }
 
+/* ----------------------------------------------------------------
+ *		ExecIncrementalSort
+ *
+ *		Used instead of ExecSort when the input is already sorted by the
+ *		first numPresortedCols sort keys.  Only tuples with equal values in
+ *		those columns need sorting among themselves, so we read and sort
+ *		one such group at a time, and return it before reading any further.
+ *		The first tuple read from the next group is kept in group_pivot.
+ *
+ *		This keeps memory use down to the largest group, and lets a LIMIT
+ *		above us stop without reading the whole input.  Backward scan and
+ *		mark/restore are not supported.
+ * ----------------------------------------------------------------
+ */
+static TupleTableSlot *
+ExecIncrementalSort(PlanState *pstate)
+{
+	SortState  *node = castNode(SortState, pstate);
+	Sort	   *plannode = (Sort *) node->ss.ps.plan;
+	EState	   *estate = node->ss.ps.state;
+	PlanState  *outerNode = outerPlanState(node);
+	Tuplesortstate *tuplesortstate = (Tuplesortstate *) node->tuplesortstate;
+	TupleTableSlot *slot = node->ss.ps.ps_ResultTupleSlot;
+	ScanDirection dir;
+
+	CHECK_FOR_INTERRUPTS();
+
+	Assert(ScanDirectionIsForward(estate->es_direction));
+
+	/* Return the next tuple of the current group, if there is one */
+	if (node->sort_Done)
+	{
+		if (tuplesort_gettupleslot(tuplesortstate, true, false, slot, NULL))
+		{
+			node->tuples_returned++;
+			return slot;
+		}
+
+		/* Stop if there are no more groups, or no more tuples are needed */
+		if (node->incr_input_done ||
+			(node->bounded && node->tuples_returned >= node->bound))
+			return slot;
+
+		tuplesort_end(tuplesortstate);
+		node->tuplesortstate = NULL;
+	}
+
+	SO1_printf("ExecIncrementalSort: %s\n",
+			   "sorting next group");
+
+	dir = estate->es_direction;
+	estate->es_direction = ForwardScanDirection;
+
+	tuplesortstate = tuplesort_begin_heap(ExecGetResultType(outerNode),
+										  plannode->numCols,
+										  plannode->sortColIdx,
+										  plannode->sortOperators,
+										  plannode->collations,
+										  plannode->nullsFirst,
+										  work_mem,
+										  false);
+	if (node->bounded)
+		tuplesort_set_bound(tuplesortstate,
+							node->bound - node->tuples_returned);
+	node->tuplesortstate = (void *) tuplesortstate;
+
+	/* The group starts with the tuple that ended the previous one */
+	if (TupIsNull(node->group_pivot))
+	{
+		TupleTableSlot *first = ExecProcNode(outerNode);
+
+		if (TupIsNull(first))
+			node->incr_input_done = true;
+		else
+			ExecCopySlot(node->group_pivot, first);
+	}
+
+	if (!node->incr_input_done)
+	{
+		tuplesort_puttupleslot(tuplesortstate, node->group_pivot);
+
+		for (;;)
+		{
+			TupleTableSlot *outerslot = ExecProcNode(outerNode);
+
+			if (TupIsNull(outerslot))
+			{
+				node->incr_input_done = true;
+				ExecClearTuple(node->group_pivot);
+				break;
+			}
+
+			if (!presorted_keys_equal(node, node->group_pivot, outerslot))
+			{
+				/* Start of the next group; keep it for the next call */
+				ExecCopySlot(node->group_pivot, outerslot);
+				break;
+			}
+
+			tuplesort_puttupleslot(tuplesortstate, outerslot);
+		}
+	}
+
+	tuplesort_performsort(tuplesortstate);
+
+	estate->es_direction = dir;
+
+	node->sort_Done = true;
+	node->bounded_Done = node->bounded;
+	node->bound_Done = node->bound;
+
+	if (tuplesort_gettupleslot(tuplesortstate, true, false, slot, NULL))
+		node->tuples_returned++;
+	return slot;
+}
+
+/*
+ * Do two tuples have equal values in all the presorted columns?
+ */
+static bool
+presorted_keys_equal(SortState *node, TupleTableSlot *a, TupleTableSlot *b)
+{
+	Sort	   *plannode = (Sort *) node->ss.ps.plan;
+	int			i;
+
+	for (i = 0; i < plannode->numPresortedCols; i++)
+	{
+		AttrNumber	attno = plannode->sortColIdx[i];
+		Datum		datum1,
+					datum2;
+		bool		isnull1,
+					isnull2;
+
+		datum1 = slot_getattr(a, attno, &isnull1);
+		datum2 = slot_getattr(b, attno, &isnull2);
+
+		if (ApplySortComparator(datum1, isnull1, datum2, isnull2,
+								&node->presortedKeys[i]) != 0)
+			return false;
+	}
+
+	return true;
+}
+
 /* ----------------------------------------------------------------
  *		ExecInitSort
  *
@@ -181,6 +330,38 @@ ExecInitSort(Sort *node, EState *estate, int eflags)
 	sortstate->sort_Done = false;
 	sortstate->tuplesortstate = NULL;
 
+	/*
+	 * An incremental sort can't scan backward or mark/restore, so the planner
+	 * must not have used it where that is needed.  It never needs random
+	 * access since each group is only sorted once.
+	 */
+	if (node->numPresortedCols > 0)
+	{
+		int			i;
+
+		Assert(!(eflags & (EXEC_FLAG_BACKWARD | EXEC_FLAG_MARK)));
+
+		sortstate->ss.ps.ExecProcNode = ExecIncrementalSort;
+		sortstate->randomAccess = false;
+		sortstate->incr_input_done = false;
+		sortstate->tuples_returned = 0;
+
+		sortstate->presortedKeys = (SortSupport)
+			palloc0(node->numPresortedCols * sizeof(SortSupportData));
+		for (i = 0; i < node->numPresortedCols; i++)
+		{
+			SortSupport ssup = &sortstate->presortedKeys[i];
+
+			ssup->ssup_cxt = CurrentMemoryContext;
+			ssup->ssup_collation = node->collations[i];
+			ssup->ssup_nulls_first = node->nullsFirst[i];
+			ssup->ssup_attno = node->sortColIdx[i];
+			ssup->abbreviate = false;
+
+			PrepareSortSupportFromOrderingOp(node->sortOperators[i], ssup);
+		}
+	}
+
 	/*
 	 * Miscellaneous initialization
 	 *
@@ -214,6 +395,13 @@ ExecInitSort(Sort *node, EState *estate, int eflags)
 	ExecAssignScanTypeFromOuterPlan(&sortstate->ss);
 	sortstate->ss.ps.ps_ProjInfo = NULL;
 
+	if (node->numPresortedCols > 0)
+	{
+		sortstate->group_pivot = ExecInitExtraTupleSlot(estate);
+		ExecSetSlotDescriptor(sortstate->group_pivot,
+							  ExecGetResultType(outerPlanState(sortstate)));
+	}
+
 	SO1_printf("ExecInitSort: %s\n",
 			   "sort node initialized");
 
@@ -236,6 +424,8 @@ ExecEndSort(SortState *node)
 	ExecClearTuple(node->ss.ss_ScanTupleSlot);
 	/* must drop pointer to sort result tuple */
 	ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
+	if (node->group_pivot)
+		ExecClearTuple(node->group_pivot);
 
 	/*
 	 * Release tuplesort resources
@@ -324,6 +514,14 @@ ExecReScanSort(SortState *node)
 		tuplesort_end((Tuplesortstate *) node->tuplesortstate);
 		node->tuplesortstate = NULL;
 
+		/* an incremental sort starts over from the first group */
+		if (node->group_pivot)
+		{
+			ExecClearTuple(node->group_pivot);
+			node->incr_input_done = false;
+			node->tuples_returned = 0;
+		}
+
 		/*
 		 * if chgParam of subnode is not null then plan will be re-scanned by
 		 * first ExecProcNode.
@@ -17,8 +17,10 @@
 #include "miscadmin.h"
 
 #include "executor/producerReceiver.h"
+#include "lib/stringinfo.h"
 #include "pgxc/nodemgr.h"
 #include "tcop/pquery.h"
+#include "utils/guc.h"
 #include "utils/tuplestore.h"
 
 typedef struct
@@ -36,9 +38,14 @@ typedef struct
 	Tuplestorestate **tstores;	/* storage to buffer data if destination queue
 								 * is full */
 	TupleDesc typeinfo;			/* description of received tuples */
+	bool usefilter;				/* consumers may give Bloom filters of the
+								 * keys they are interested in */
+	char *selffilter;			/* Bloom filter of the self consumer */
 	long tcount;
 	long selfcount;
 	long othercount;
+	long filteredcount;			/* tuples not sent because of the filters */
+	long *conscount;			/* tuples sent to each consumer */
 } ProducerState;
 
 
@@ -70,6 +77,41 @@ producerStartupReceiver(DestReceiver *self, int operation, TupleDesc typeinfo)
 		(*myState->consumer->rStartup) (myState->consumer, operation, typeinfo);
 }
 
+/*
+ * Check if the tuple with the specified distribution key may find a match at
+ * the consumer. The hash of the key is calculated on the first call for the
+ * tuple.
+ */
+static bool
+producerFilterPass(ProducerState *myState, int consumerIdx, Datum value,
+				   bool isnull, uint32 *hash, bool *hashed)
+{
+	const char *filter;
+
+	if (consumerIdx == SQ_CONS_SELF)
+		filter = myState->selffilter;
+	else
+		filter = SharedQueueGetFilter(myState->squeue, consumerIdx);
+
+	/* Consumer has not told what it needs, send everything */
+	if (filter == NULL)
+		return true;
+
+	/* NULL never matches the join key */
+	if (isnull)
+		return false;
+
+	if (!*hashed)
+	{
+		Oid			keytype;
+
+		keytype = myState->typeinfo->attrs[myState->distKey - 1]->atttypid;
+		*hash = DistribKeyHash(keytype, value);
+		*hashed = true;
+	}
+	return SharedQueueFilterTest(filter, *hash);
+}
+
 /*
  * Receive a tuple from the executor and dispatch it to the proper consumer
  */
@@ -80,6 +122,8 @@ producerReceiveSlot(TupleTableSlot *slot, DestReceiver *self)
 	Datum		value;
 	bool		isnull;
 	int 		ncount, i;
+	uint32		hash = 0;
+	bool		hashed = false;
 
 	if (myState->distKey == InvalidAttrNumber)
 	{
@@ -100,6 +144,13 @@ producerReceiveSlot(TupleTableSlot *slot, DestReceiver *self)
 		{
 			continue;
 		}
+		else if (myState->usefilter &&
+				 !producerFilterPass(myState, consumerIdx, value, isnull,
+									 &hash, &hashed))
+		{
+			myState->filteredcount++;
+			continue;
+		}
 		else if (consumerIdx == SQ_CONS_SELF)
 		{
 			Assert(myState->consumer);
@@ -121,6 +172,7 @@ producerReceiveSlot(TupleTableSlot *slot, DestReceiver *self)
 							 &myState->tstores[consumerIdx], myState->tmpcxt);
 			MemoryContextSwitchTo(savecontext);
 			myState->othercount++;
+			myState->conscount[consumerIdx]++;
 		}
 	}
 
@@ -151,6 +203,24 @@ producerDestroyReceiver(DestReceiver *self)
 
 	elog(DEBUG2, "Producer stats: total %ld tuples, %ld tuples to self, %ld to other nodes",
 		 myState->tcount, myState->selfcount, myState->othercount);
+	if (myState->usefilter)
+		elog(DEBUG2, "Producer stats: %ld tuples not sent because of join key filters",
+			 myState->filteredcount);
+
+	/* Break down by consumer, to tell how even the distribution was */
+	if (myState->conscount &&
+		(log_min_messages <= DEBUG2 || client_min_messages <= DEBUG2))
+	{
+		StringInfoData buf;
+		int			i;
+
+		initStringInfo(&buf);
+		for (i = 0; i < NumDataNodes; i++)
+			if (myState->conscount[i] > 0)
+				appendStringInfo(&buf, " %d:%ld", i, myState->conscount[i]);
+		elog(DEBUG2, "Producer stats: tuples per consumer%s", buf.data);
+		pfree(buf.data);
+	}
 
 	if (myState->consumer)
 		(*myState->consumer->rDestroy) (myState->consumer);
@@ -211,6 +281,7 @@ CreateProducerDestReceiver(void)
 	self->tcount = 0;
 	self->selfcount = 0;
 	self->othercount = 0;
+	self->filteredcount = 0;
 
 	return (DestReceiver *) self;
 }
@@ -236,8 +307,34 @@ SetProducerDestReceiverParams(DestReceiver *self,
 	/* Create workspace */
 	myState->distNodes = (int *) getLocatorResults(locator);
 	if (squeue)
+	{
 		myState->tstores = (Tuplestorestate **)
 			palloc0(NumDataNodes * sizeof(Tuplestorestate *));
+		myState->conscount = (long *) palloc0(NumDataNodes * sizeof(long));
+	}
+}
+
+
+/*
+ * Let the consumers filter the tuples by the distribution key. The self
+ * consumer passes its filter here, may be NULL, others put it into the shared
+ * queue when they bind. Producer makes a copy of the filter.
+ */
+void
+SetProducerDestReceiverFilter(DestReceiver *self, const char *selffilter)
+{
+	ProducerState *myState = (ProducerState *) self;
+
+	Assert(myState->pub.mydest == DestProducer);
+	Assert(myState->distKey != InvalidAttrNumber);
+	myState->usefilter = true;
+	if (selffilter)
+	{
+		myState->selffilter = palloc(SQUEUE_FILTER_SIZE);
+		memcpy(myState->selffilter, selffilter, SQUEUE_FILTER_SIZE);
+	}
+	else
+		myState->selffilter = NULL;
 }
 
 
@@ -90,6 +90,9 @@
 #endif
 
 #include "common/ip.h"
+#ifdef PGXC
+#include "common/pg_lzcompress.h"
+#endif
 #include "libpq/libpq.h"
 #include "miscadmin.h"
 #include "storage/ipc.h"
@@ -143,6 +146,21 @@ static char PqRecvBuffer[PQ_RECV_BUFFER_SIZE];
 static int	PqRecvPointer;		/* Next index to read a byte from PqRecvBuffer */
 static int	PqRecvLength;		/* End of data available in PqRecvBuffer */
 
+#ifdef PGXC
+/*
+ * Compressed stream state.  When compression is enabled, the data flushed
+ * from PqSendBuffer is compressed frame by frame into PqZSendBuffer, and the
+ * data read from the socket is collected in PqZRecvBuffer until a complete
+ * frame can be decompressed into PqRecvBuffer.
+ */
+static bool PqCompression = false;
+static char *PqZSendBuffer;
+static int	PqZSendPointer;		/* End of the frame in PqZSendBuffer */
+static int	PqZSendStart;		/* Next index to send a byte in PqZSendBuffer */
+static char	PqZRecvBuffer[2 * PQ_FRAME_MAXSZ];
+static int	PqZRecvLength;		/* End of data available in PqZRecvBuffer */
+#endif
+
 /*
  * Message status
  */
@@ -164,6 +182,7 @@ static void socket_startcopyout(void);
 static void socket_endcopyout(bool errorAbort);
 static int	internal_putbytes(const char *s, size_t len);
 static int	internal_flush(void);
+static int	internal_send(char *buf, int *start, int end);
 
 #ifdef HAVE_UNIX_SOCKETS
 static int	Lock_AF_UNIX(char *unixSocketDir, char *unixSocketPath);
@@ -929,6 +948,72 @@ socket_set_nonblocking(bool nonblocking)
 	MyProcPort->noblock = nonblocking;
 }
 
+#ifdef PGXC
+/* --------------------------------
+ *		pq_recvbuf_compressed - load some bytes into the input buffer,
+ *			decompressing them from the frames read from the socket
+ *
+ *		returns 0 if OK, EOF if trouble
+ * --------------------------------
+ */
+static int
+pq_recvbuf_compressed(void)
+{
+	for (;;)
+	{
+		int			framelen;
+		int			rawlen;
+		int			r;
+
+		framelen = pq_frame_length(PqZRecvBuffer, PqZRecvLength, &rawlen);
+		if (framelen < 0)
+			goto corrupted;
+		if (framelen > 0)
+		{
+			/* Leave the frame for later if it does not fit */
+			if (rawlen > PQ_RECV_BUFFER_SIZE - PqRecvLength)
+			{
+				if (PqRecvLength > 0)
+					return 0;
+				goto corrupted;
+			}
+			if (pq_decompress_frame(PqZRecvBuffer,
+									PqRecvBuffer + PqRecvLength) < 0)
+				goto corrupted;
+			PqRecvLength += rawlen;
+			PqZRecvLength -= framelen;
+			if (PqZRecvLength > 0)
+				memmove(PqZRecvBuffer, PqZRecvBuffer + framelen,
+						PqZRecvLength);
+			return 0;
+		}
+
+		r = secure_read(MyProcPort, PqZRecvBuffer + PqZRecvLength,
+						sizeof(PqZRecvBuffer) - PqZRecvLength);
+
+		if (r < 0)
+		{
+			if (errno == EINTR)
+				continue;		/* Ok if interrupted */
+
+			ereport(COMMERROR,
+					(errcode_for_socket_access(),
+					 errmsg("could not receive data from client: %m")));
+			return EOF;
+		}
+		if (r == 0)
+			return EOF;
+		PqZRecvLength += r;
+	}
+
+corrupted:
+	ereport(COMMERROR,
+			(errcode(ERRCODE_PROTOCOL_VIOLATION),
+			 errmsg("invalid compressed frame received from client")));
+	return EOF;
+}
+#endif
+
 /* --------------------------------
  *		pq_recvbuf - load some bytes into the input buffer
  *
@@ -955,6 +1040,11 @@ pq_recvbuf(void)
 	/* Ensure that we're in blocking mode */
 	socket_set_nonblocking(false);
 
+#ifdef PGXC
+	if (PqCompression)
+		return pq_recvbuf_compressed();
+#endif
+
 	/* Can fill buffer from PqRecvLength and upwards */
 	for (;;)
 	{
@@ -1042,6 +1132,10 @@ pq_getbyte_if_available(unsigned char *c)
 	int			r;
 
 	Assert(PqCommReadingMsg);
+#ifdef PGXC
+	/* Only used by walsender, which never talks compressed stream */
+	Assert(!PqCompression);
+#endif
 
 	if (PqRecvPointer < PqRecvLength)
 	{
@@ -1420,11 +1514,70 @@ socket_flush(void)
  */
 static int
 internal_flush(void)
+{
+#ifdef PGXC
+	if (PqCompression)
+	{
+		for (;;)
+		{
+			/* Compress next chunk of the pending data, if previous is sent */
+			if (PqZSendStart == PqZSendPointer)
+			{
+				int			len = PqSendPointer - PqSendStart;
+
+				if (len == 0)
+					break;
+				len = Min(len, PQ_FRAME_RAWSZ);
+				PqZSendPointer = pq_compress_frame(PqSendBuffer + PqSendStart,
+												   len, PqZSendBuffer);
+				PqZSendStart = 0;
+				PqSendStart += len;
+			}
+
+			if (internal_send(PqZSendBuffer, &PqZSendStart, PqZSendPointer))
+			{
+				PqZSendStart = PqZSendPointer = 0;
+				PqSendStart = PqSendPointer = 0;
+				return EOF;
+			}
+
+			/* Would block */
+			if (PqZSendStart < PqZSendPointer)
+				return 0;
+		}
+
+		PqZSendStart = PqZSendPointer = 0;
+		PqSendStart = PqSendPointer = 0;
+		return 0;
+	}
+#endif
+
+	if (internal_send(PqSendBuffer, &PqSendStart, PqSendPointer))
+	{
+		PqSendStart = PqSendPointer = 0;
+		return EOF;
+	}
+
+	if (PqSendStart == PqSendPointer)
+		PqSendStart = PqSendPointer = 0;
+	return 0;
+}
+
+/* --------------------------------
+ *		internal_send - send data from buf, starting at *start up to end
+ *
+ * *start is advanced past the data sent.  Returns 0 if OK (meaning
+ * everything was sent, or operation would block and the socket is in
+ * non-blocking mode), or EOF if trouble.
+ * --------------------------------
+ */
+static int
+internal_send(char *buf, int *start, int end)
 {
 	static int	last_reported_send_errno = 0;
 
-	char	   *bufptr = PqSendBuffer + PqSendStart;
-	char	   *bufend = PqSendBuffer + PqSendPointer;
+	char	   *bufptr = buf + *start;
+	char	   *bufend = buf + end;
 
 	while (bufptr < bufend)
 	{
@@ -1465,12 +1618,11 @@ internal_flush(void)
 			}
 
 			/*
-			 * We drop the buffered data anyway so that processing can
-			 * continue, even though we'll probably quit soon. We also set a
-			 * flag that'll cause the next CHECK_FOR_INTERRUPTS to terminate
-			 * the connection.
+			 * The caller drops the buffered data anyway so that processing
+			 * can continue, even though we'll probably quit soon. We also
+			 * set a flag that'll cause the next CHECK_FOR_INTERRUPTS to
+			 * terminate the connection.
 			 */
-			PqSendStart = PqSendPointer = 0;
 			ClientConnectionLost = 1;
 			InterruptPending = 1;
 			return EOF;
@@ -1478,10 +1630,9 @@ internal_flush(void)
 
 		last_reported_send_errno = 0;	/* reset after any successful send */
 		bufptr += r;
-		PqSendStart += r;
+		*start += r;
 	}
 
-	PqSendStart = PqSendPointer = 0;
 	return 0;
 }
 
@@ -1497,7 +1648,7 @@ socket_flush_if_writable(void)
 	int			res;
 
 	/* Quick exit if nothing to do */
-	if (PqSendPointer == PqSendStart)
+	if (!socket_is_send_pending())
 		return 0;
 
 	/* No-op if reentrant call */
@@ -1520,6 +1671,10 @@ socket_flush_if_writable(void)
 static bool
 socket_is_send_pending(void)
 {
+#ifdef PGXC
+	if (PqZSendStart < PqZSendPointer)
+		return true;
+#endif
 	return (PqSendStart < PqSendPointer);
 }
 
@@ -1926,3 +2081,117 @@ pq_setkeepalivescount(int count, Port *port)
 
 	return STATUS_OK;
 }
+
+#ifdef PGXC
+/*
+ * pq_enable_compression - compress the stream to and from the client
+ *
+ * Used on connections from other nodes of the cluster, if the node opening
+ * the connection requested that.  Compression starts right after the first
+ * ReadyForQuery is flushed, the startup exchange is not compressed.
+ */
+void
+pq_enable_compression(void)
+{
+	if (PqCompression)
+		return;
+
+	PqZSendBuffer = MemoryContextAlloc(TopMemoryContext, PQ_FRAME_MAXSZ);
+	PqZSendPointer = PqZSendStart = 0;
+	PqZRecvLength = 0;
+	PqCompression = true;
+}
+
+/*
+ * pq_compress_frame - compress len bytes at src into a stream frame
+ *
+ * The frame header consists of the length of the data, and the length of
+ * the compressed data, both as network byte order int32.  If the data does
+ * not compress the lengths are equal and the data is stored as is.
+ * The frame buffer must have room for PQ_FRAME_MAXSZ bytes, len must not
+ * exceed PQ_FRAME_RAWSZ.  Returns the total length of the frame.
+ */
+int
+pq_compress_frame(const char *src, int len, char *frame)
+{
+	int32		complen;
+	uint32		n32;
+
+	Assert(len > 0 && len <= PQ_FRAME_RAWSZ);
+
+	complen = pglz_compress(src, len, frame + PQ_FRAME_HDRSZ,
+							PGLZ_strategy_default);
+	if (complen < 0 || complen >= len)
+	{
+		memcpy(frame + PQ_FRAME_HDRSZ, src, len);
+		complen = len;
+	}
+
+	n32 = htonl((uint32) len);
+	memcpy(frame, &n32, 4);
+	n32 = htonl((uint32) complen);
+	memcpy(frame + 4, &n32, 4);
+
+	return PQ_FRAME_HDRSZ + complen;
+}
+
+/*
+ * pq_frame_length - check whether buf contains a complete stream frame
+ *
+ * Returns the total length of the frame, and sets *rawlen to the length of
+ * the data in it, if the first len bytes of buf contain the complete frame.
+ * Returns 0 if more data is needed, -1 if the frame header is invalid.
+ */
+int
+pq_frame_length(const char *buf, int len, int *rawlen)
+{
+	uint32		n32;
+	int			complen;
+
+	if (len < PQ_FRAME_HDRSZ)
+		return 0;
+
+	memcpy(&n32, buf, 4);
+	*rawlen = (int) ntohl(n32);
+	memcpy(&n32, buf + 4, 4);
+	complen = (int) ntohl(n32);
+
+	if (*rawlen <= 0 || *rawlen > PQ_FRAME_RAWSZ ||
+		complen <= 0 || complen > *rawlen)
+		return -1;
+
+	if (len < PQ_FRAME_HDRSZ + complen)
+		return 0;
+	return PQ_FRAME_HDRSZ + complen;
+}
+
+/*
+ * pq_decompress_frame - extract the data of a complete stream frame
+ *
+ * dest must have room for the data length of the frame, as reported by
+ * pq_frame_length().  Returns the data length, or -1 if the frame is
+ * corrupted.
+ */
+int
+pq_decompress_frame(const char *frame, char *dest)
+{
+	uint32		n32;
+	int			rawlen;
+	int			complen;
+
+	memcpy(&n32, frame, 4);
+	rawlen = (int) ntohl(n32);
+	memcpy(&n32, frame + 4, 4);
+	complen = (int) ntohl(n32);
+
+	if (complen == rawlen)
+	{
+		memcpy(dest, frame + PQ_FRAME_HDRSZ, rawlen);
+		return rawlen;
+	}
+
+	if (pglz_decompress(frame + PQ_FRAME_HDRSZ, complen, dest, rawlen) != rawlen)
+		return -1;
+	return rawlen;
+}
+#endif
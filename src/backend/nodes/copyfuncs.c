@@ -116,6 +116,12 @@ _copyPlannedStmt(const PlannedStmt *from)
 	COPY_SCALAR_FIELD(distributionKey);
 	COPY_NODE_FIELD(distributionNodes);
 	COPY_NODE_FIELD(distributionRestrict);
+	COPY_NODE_FIELD(skewValues);
+	COPY_SCALAR_FIELD(skewEqfunc);
+	COPY_SCALAR_FIELD(skewCollation);
+	COPY_SCALAR_FIELD(skewBroadcast);
+	COPY_SCALAR_FIELD(hasBloomParam);
+	COPY_SCALAR_FIELD(instrumentOptions);
 #endif
 	COPY_NODE_FIELD(utilityStmt);
 	COPY_LOCATION_FIELD(stmt_location);
@@ -261,6 +267,8 @@ _copyAppend(const Append *from)
 	 */
 	COPY_NODE_FIELD(partitioned_rels);
 	COPY_NODE_FIELD(appendplans);
+	COPY_NODE_FIELD(part_prune_constraints);
+	COPY_NODE_FIELD(part_prune_quals);
 
 	return newnode;
 }
@@ -283,6 +291,8 @@ _copyMergeAppend(const MergeAppend *from)
 	 */
 	COPY_NODE_FIELD(partitioned_rels);
 	COPY_NODE_FIELD(mergeplans);
+	COPY_NODE_FIELD(part_prune_constraints);
+	COPY_NODE_FIELD(part_prune_quals);
 	COPY_SCALAR_FIELD(numCols);
 	COPY_POINTER_FIELD(sortColIdx, from->numCols * sizeof(AttrNumber));
 	COPY_POINTER_FIELD(sortOperators, from->numCols * sizeof(Oid));
@@ -951,6 +961,7 @@ _copySort(const Sort *from)
 	COPY_POINTER_FIELD(sortOperators, from->numCols * sizeof(Oid));
 	COPY_POINTER_FIELD(collations, from->numCols * sizeof(Oid));
 	COPY_POINTER_FIELD(nullsFirst, from->numCols * sizeof(bool));
+	COPY_SCALAR_FIELD(numPresortedCols);
 
 	return newnode;
 }
@@ -1321,8 +1332,17 @@ _copyRemoteSubplan(const RemoteSubplan *from)
 	COPY_SCALAR_FIELD(distributionKey);
 	COPY_NODE_FIELD(distributionNodes);
 	COPY_NODE_FIELD(distributionRestrict);
+	COPY_NODE_FIELD(skewValues);
+	COPY_SCALAR_FIELD(skewEqfunc);
+	COPY_SCALAR_FIELD(skewCollation);
+	COPY_SCALAR_FIELD(skewBroadcast);
 	COPY_NODE_FIELD(nodeList);
 	COPY_SCALAR_FIELD(execOnAll);
+	COPY_NODE_FIELD(execNodesExpr);
+	COPY_SCALAR_FIELD(execNodesType);
+	COPY_NODE_FIELD(execNodesMap);
+	COPY_SCALAR_FIELD(bloomKeyNo);
+	COPY_SCALAR_FIELD(memoize);
 	COPY_NODE_FIELD(sort);
 	COPY_STRING_FIELD(cursor);
 	COPY_SCALAR_FIELD(unique);
@@ -1342,6 +1362,11 @@ _copyDistribution(const Distribution *from)
 	COPY_NODE_FIELD(distributionExpr);
 	COPY_BITMAPSET_FIELD(nodes);
 	COPY_BITMAPSET_FIELD(restrictNodes);
+	COPY_NODE_FIELD(restrictExpr);
+	COPY_NODE_FIELD(skewValues);
+	COPY_SCALAR_FIELD(skewEqfunc);
+	COPY_SCALAR_FIELD(skewCollation);
+	COPY_SCALAR_FIELD(skewBroadcast);
 
 	return newnode;
 }
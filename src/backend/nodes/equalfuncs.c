@@ -2838,6 +2838,8 @@ _equalDistribution(const Distribution *a, const Distribution *b,
 		return equalVarExceptVarno(a->distributionExpr, b->distributionExpr);
 	else
 		COMPARE_NODE_FIELD(distributionExpr);
+	COMPARE_NODE_FIELD(skewValues);
+	COMPARE_SCALAR_FIELD(skewBroadcast);
 
 	return true;
 }
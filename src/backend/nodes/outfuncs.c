@@ -35,7 +35,9 @@
 #include "miscadmin.h"
 #include "catalog/namespace.h"
 #include "pgxc/execRemote.h"
+#include "utils/hsearch.h"
 #include "utils/lsyscache.h"
+#include "utils/memutils.h"
 #endif
 #include "utils/datum.h"
 #ifdef PGXC
@@ -54,10 +56,98 @@
  * Later we may want to add extra parameter in nodeToString() function
  */
 static bool portable_output = false;
+
+/*
+ * A plan references the same few functions, operators and data types over
+ * and over, and encoding each of them takes several catalog lookups. While
+ * in portable mode remember the text already emitted for an object, and
+ * copy it when the object is referenced again.
+ */
+typedef struct PortableSymbolKey
+{
+	Oid			kind;			/* 'f'unction, 'o'perator or 't'ype */
+	Oid			oid;
+} PortableSymbolKey;
+
+typedef struct PortableSymbol
+{
+	PortableSymbolKey key;
+	char	   *text;
+} PortableSymbol;
+
+static MemoryContext portable_symbol_context = NULL;
+static HTAB *portable_symbols = NULL;
+
 void
 set_portable_output(bool value)
 {
 	portable_output = value;
+
+	/* Catalog may change before the next plan is written, start afresh */
+	if (portable_symbol_context)
+	{
+		MemoryContextDelete(portable_symbol_context);
+		portable_symbol_context = NULL;
+		portable_symbols = NULL;
+	}
+}
+
+/*
+ * Append the text remembered for the object, if any
+ */
+static bool
+outPortableCached(StringInfo str, char kind, Oid oid)
+{
+	PortableSymbolKey key;
+	PortableSymbol *symbol;
+
+	if (portable_symbols == NULL)
+		return false;
+
+	key.kind = (Oid) kind;
+	key.oid = oid;
+	symbol = (PortableSymbol *) hash_search(portable_symbols, &key,
+											HASH_FIND, NULL);
+	if (symbol == NULL)
+		return false;
+
+	appendStringInfoString(str, symbol->text);
+	return true;
+}
+
+/*
+ * Remember what has been appended to str since offset start as the
+ * encoding of the object
+ */
+static void
+outPortableRemember(StringInfo str, int start, char kind, Oid oid)
+{
+	PortableSymbolKey key;
+	PortableSymbol *symbol;
+	bool		found;
+
+	if (portable_symbols == NULL)
+	{
+		HASHCTL		ctl;
+
+		portable_symbol_context = AllocSetContextCreate(TopMemoryContext,
+														"Portable symbols",
+														ALLOCSET_SMALL_SIZES);
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(PortableSymbolKey);
+		ctl.entrysize = sizeof(PortableSymbol);
+		ctl.hcxt = portable_symbol_context;
+		portable_symbols = hash_create("Portable symbols", 64, &ctl,
+									   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	key.kind = (Oid) kind;
+	key.oid = oid;
+	symbol = (PortableSymbol *) hash_search(portable_symbols, &key,
+											HASH_ENTER, &found);
+	if (!found)
+		symbol->text = MemoryContextStrdup(portable_symbol_context,
+										   str->data + start);
 }
 #endif
 #include "utils/rel.h"
@@ -180,14 +270,25 @@ static void outChar(StringInfo str, char c);
 	}  while (0)
 
 #define WRITE_TYPID_INTERNAL(typid) \
-	(outToken(str, OidIsValid(typid) ? NSP_NAME(get_typ_namespace(typid)) : NULL), \
-	 appendStringInfoChar(str, ' '), \
-	 outToken(str, OidIsValid(typid) ? get_typ_name(typid) : NULL))
+	do { \
+		if (!OidIsValid(typid)) \
+			appendStringInfoString(str, "<> <>"); \
+		else if (!outPortableCached(str, 't', (typid))) \
+		{ \
+			int start = str->len; \
+			outToken(str, NSP_NAME(get_typ_namespace(typid))); \
+			appendStringInfoChar(str, ' '); \
+			outToken(str, get_typ_name(typid)); \
+			outPortableRemember(str, start, 't', (typid)); \
+		} \
+	} while (0)
 
 /* write an OID which is a data type OID */
 #define WRITE_TYPID_FIELD(fldname) \
-	(appendStringInfo(str, " :" CppAsString(fldname) " "), \
-	 WRITE_TYPID_INTERNAL(node->fldname))
+	do { \
+		appendStringInfo(str, " :" CppAsString(fldname) " "); \
+		WRITE_TYPID_INTERNAL(node->fldname); \
+	} while (0)
 
 #define WRITE_TYPID_LIST_FIELD(fldname) \
 	do { \
@@ -214,10 +315,13 @@ static void outChar(StringInfo str, char c);
 #define WRITE_FUNCID_FIELD(fldname) \
 	do { \
 		appendStringInfo(str, " :" CppAsString(fldname) " "); \
-		if (OidIsValid(node->fldname)) \
+		if (!OidIsValid(node->fldname)) \
+			appendStringInfo(str, "<> <> 0"); \
+		else if (!outPortableCached(str, 'f', node->fldname)) \
 		{ \
 			Oid *argtypes; \
 			int i, nargs; \
+			int start = str->len; \
 			outToken(str, NSP_NAME(get_func_namespace(node->fldname))); \
 			appendStringInfoChar(str, ' '); \
 			outToken(str, get_func_name(node->fldname)); \
@@ -231,18 +335,20 @@ static void outChar(StringInfo str, char c);
 				appendStringInfoChar(str, ' '); \
 				outToken(str, get_typ_name(argtypes[i])); \
 			} \
+			outPortableRemember(str, start, 'f', node->fldname); \
 		} \
-		else \
-			appendStringInfo(str, "<> <> 0"); \
 	} while (0)
 
 /* write an OID which is an operator OID */
 #define WRITE_OPERID_FIELD(fldname) \
 	do { \
 		appendStringInfo(str, " :" CppAsString(fldname) " "); \
-		if (OidIsValid(node->fldname)) \
+		if (!OidIsValid(node->fldname)) \
+			appendStringInfo(str, "<> <> <> <> <> <>"); \
+		else if (!outPortableCached(str, 'o', node->fldname)) \
 		{ \
 			Oid oprleft, oprright; \
+			int start = str->len; \
 			outToken(str, NSP_NAME(get_opnamespace(node->fldname))); \
 			appendStringInfoChar(str, ' '); \
 			outToken(str, get_opname(node->fldname)); \
@@ -258,9 +364,8 @@ static void outChar(StringInfo str, char c);
 			appendStringInfoChar(str, ' '); \
 			outToken(str, OidIsValid(oprright) ? get_typ_name(oprright) : NULL); \
 			appendStringInfoChar(str, ' '); \
+			outPortableRemember(str, start, 'o', node->fldname); \
 		} \
-		else \
-			appendStringInfo(str, "<> <> <> <> <> <>"); \
 	} while (0)
 
 /* write an OID which is a collation OID */
@@ -625,6 +730,8 @@ _outAppend(StringInfo str, const Append *node)
 
 	WRITE_NODE_FIELD(partitioned_rels);
 	WRITE_NODE_FIELD(appendplans);
+	WRITE_NODE_FIELD(part_prune_constraints);
+	WRITE_NODE_FIELD(part_prune_quals);
 }
 
 static void
@@ -638,6 +745,8 @@ _outMergeAppend(StringInfo str, const MergeAppend *node)
 
 	WRITE_NODE_FIELD(partitioned_rels);
 	WRITE_NODE_FIELD(mergeplans);
+	WRITE_NODE_FIELD(part_prune_constraints);
+	WRITE_NODE_FIELD(part_prune_quals);
 
 	WRITE_INT_FIELD(numCols);
 
@@ -1404,6 +1513,8 @@ _outSort(StringInfo str, const Sort *node)
 	appendStringInfoString(str, " :nullsFirst");
 	for (i = 0; i < node->numCols; i++)
 		appendStringInfo(str, " %s", booltostr(node->nullsFirst[i]));
+
+	WRITE_INT_FIELD(numPresortedCols);
 }
 
 static void
@@ -1554,8 +1665,25 @@ _outRemoteSubplan(StringInfo str, const RemoteSubplan *node)
 	WRITE_INT_FIELD(distributionKey);
 	WRITE_NODE_FIELD(distributionNodes);
 	WRITE_NODE_FIELD(distributionRestrict);
+	WRITE_NODE_FIELD(skewValues);
+	if (portable_output)
+	{
+		WRITE_FUNCID_FIELD(skewEqfunc);
+		WRITE_COLLID_FIELD(skewCollation);
+	}
+	else
+	{
+		WRITE_OID_FIELD(skewEqfunc);
+		WRITE_OID_FIELD(skewCollation);
+	}
+	WRITE_BOOL_FIELD(skewBroadcast);
 	WRITE_NODE_FIELD(nodeList);
 	WRITE_BOOL_FIELD(execOnAll);
+	WRITE_NODE_FIELD(execNodesExpr);
+	WRITE_CHAR_FIELD(execNodesType);
+	WRITE_NODE_FIELD(execNodesMap);
+	WRITE_INT_FIELD(bloomKeyNo);
+	WRITE_BOOL_FIELD(memoize);
 	WRITE_NODE_FIELD(sort);
 	WRITE_STRING_FIELD(cursor);
 	WRITE_INT_FIELD(unique);
@@ -1607,6 +1735,22 @@ _outRemoteStmt(StringInfo str, const RemoteStmt *node)
 	WRITE_INT_FIELD(distributionKey);
 	WRITE_NODE_FIELD(distributionNodes);
 	WRITE_NODE_FIELD(distributionRestrict);
+	WRITE_NODE_FIELD(skewValues);
+	if (portable_output)
+	{
+		WRITE_FUNCID_FIELD(skewEqfunc);
+		WRITE_COLLID_FIELD(skewCollation);
+	}
+	else
+	{
+		WRITE_OID_FIELD(skewEqfunc);
+		WRITE_OID_FIELD(skewCollation);
+	}
+	WRITE_BOOL_FIELD(skewBroadcast);
+	WRITE_BOOL_FIELD(hasBloomParam);
+	WRITE_BOOL_FIELD(parallelModeNeeded);
+	WRITE_INT_FIELD(instrumentOptions);
+	WRITE_UINT_FIELD(queryId);
 }
 
 static void
@@ -3042,6 +3186,7 @@ _outSortPath(StringInfo str, const SortPath *node)
 	_outPathInfo(str, (const Path *) node);
 
 	WRITE_NODE_FIELD(subpath);
+	WRITE_INT_FIELD(numPresortedCols);
 }
 
 static void
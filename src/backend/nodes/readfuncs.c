@@ -45,7 +45,9 @@
 #include "nodes/plannodes.h"
 #include "pgxc/execRemote.h"
 #include "utils/builtins.h"
+#include "utils/hsearch.h"
 #include "utils/lsyscache.h"
+#include "utils/memutils.h"
 
 
 /*
@@ -59,13 +61,111 @@
  * Later we may want to add extra parameter in stringToNode() function
  */
 static bool portable_input = false;
+
+/*
+ * Resolving a function or an operator identifier takes a catalog lookup for
+ * the object itself and for every type of its signature, and a plan tends
+ * to reference the same few of them over and over. While in portable mode
+ * remember the OIDs the identifiers have been resolved to, keyed by their
+ * text. Longer identifiers are always resolved.
+ */
+#define PORTABLE_SYMBOL_KEYLEN	256
+
+typedef struct PortableSymbol
+{
+	char		key[PORTABLE_SYMBOL_KEYLEN];	/* kind + identifier text */
+	Oid			oid;
+} PortableSymbol;
+
+static MemoryContext portable_symbol_context = NULL;
+static HTAB *portable_symbols = NULL;
+
 bool
 set_portable_input(bool value)
 {
 	bool old_portable_input = portable_input;
 	portable_input = value;
+
+	/* Catalog may change before the next plan is read, start afresh */
+	if (portable_symbol_context)
+	{
+		MemoryContextDelete(portable_symbol_context);
+		portable_symbol_context = NULL;
+		portable_symbols = NULL;
+	}
 	return old_portable_input;
 }
+
+/*
+ * Build the memo key of the identifier text between start and end.
+ * Returns false if the identifier is too long to be remembered.
+ */
+static bool
+readPortableKey(char *key, char kind, const char *start, const char *end)
+{
+	int			len = end - start;
+
+	if (len + 2 > PORTABLE_SYMBOL_KEYLEN)
+		return false;
+	key[0] = kind;
+	memcpy(key + 1, start, len);
+	key[len + 1] = '\0';
+	return true;
+}
+
+/*
+ * Look up the OID an identifier has already been resolved to
+ */
+static bool
+readPortableCached(char kind, const char *start, const char *end, Oid *oid)
+{
+	char		key[PORTABLE_SYMBOL_KEYLEN];
+	PortableSymbol *symbol;
+
+	if (portable_symbols == NULL || !readPortableKey(key, kind, start, end))
+		return false;
+
+	symbol = (PortableSymbol *) hash_search(portable_symbols, key,
+											HASH_FIND, NULL);
+	if (symbol == NULL)
+		return false;
+
+	*oid = symbol->oid;
+	return true;
+}
+
+/*
+ * Remember the OID the identifier has been resolved to
+ */
+static void
+readPortableRemember(char kind, const char *start, const char *end, Oid oid)
+{
+	char		key[PORTABLE_SYMBOL_KEYLEN];
+	PortableSymbol *symbol;
+
+	/* Do not remember failures, they are reported at every reference */
+	if (!OidIsValid(oid) || !readPortableKey(key, kind, start, end))
+		return;
+
+	if (portable_symbols == NULL)
+	{
+		HASHCTL		ctl;
+
+		portable_symbol_context = AllocSetContextCreate(TopMemoryContext,
+														"Portable symbols",
+														ALLOCSET_SMALL_SIZES);
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = PORTABLE_SYMBOL_KEYLEN;
+		ctl.entrysize = sizeof(PortableSymbol);
+		ctl.hcxt = portable_symbol_context;
+		portable_symbols = hash_create("Portable symbols", 64, &ctl,
+									   HASH_ELEM | HASH_CONTEXT);
+	}
+
+	symbol = (PortableSymbol *) hash_search(portable_symbols, key,
+											HASH_ENTER, NULL);
+	symbol->oid = oid;
+}
 #endif /* XCP */
 
 /*
@@ -299,8 +399,10 @@ set_portable_input(bool value)
 		char       *funcname; /* function name */ \
 		int 		nargs; /* number of arguments */ \
 		Oid		   *argtypes; /* argument types */ \
+		const char *symstart; /* identifier text */ \
 		token = pg_strtok(&length);		/* skip :fldname */ \
 		token = pg_strtok(&length); /* get nspname */ \
+		symstart = token; \
 		nspname = nullable_string(token, length); \
 		token = pg_strtok(&length); /* get funcname */ \
 		funcname = nullable_string(token, length); \
@@ -309,21 +411,28 @@ set_portable_input(bool value)
 		if (funcname) \
 		{ \
 			int	i; \
-			argtypes = palloc(nargs * sizeof(Oid)); \
+			char **typnspnames = palloc(nargs * sizeof(char *)); \
+			char **typnames = palloc(nargs * sizeof(char *)); \
+			Oid funcid; \
 			for (i = 0; i < nargs; i++) \
 			{ \
-				char *typnspname; /* argument type namespace */ \
-				char *typname; /* argument type name */ \
 				token = pg_strtok(&length); /* get type nspname */ \
-				typnspname = nullable_string(token, length); \
+				typnspnames[i] = nullable_string(token, length); \
 				token = pg_strtok(&length); /* get type name */ \
-				typname = nullable_string(token, length); \
-				argtypes[i] = get_typname_typid(typname, \
-												NSP_OID(typnspname)); \
+				typnames[i] = nullable_string(token, length); \
 			} \
-			local_node->fldname = get_funcid(funcname, \
-											 buildoidvector(argtypes, nargs), \
-											 NSP_OID(nspname)); \
+			if (!readPortableCached('f', symstart, token + length, &funcid)) \
+			{ \
+				argtypes = palloc(nargs * sizeof(Oid)); \
+				for (i = 0; i < nargs; i++) \
+					argtypes[i] = get_typname_typid(typnames[i], \
+													NSP_OID(typnspnames[i])); \
+				funcid = get_funcid(funcname, \
+									buildoidvector(argtypes, nargs), \
+									NSP_OID(nspname)); \
+				readPortableRemember('f', symstart, token + length, funcid); \
+			} \
+			local_node->fldname = funcid; \
 		} \
 		else \
 			local_node->fldname = InvalidOid; \
@@ -340,8 +449,10 @@ set_portable_input(bool value)
 		char	   *rightnspname; /* right type namespace */ \
 		char	   *rightname; /* right type name */ \
 		Oid			oprright; /* right type */ \
+		const char *symstart; /* identifier text */ \
 		token = pg_strtok(&length);		/* skip :fldname */ \
 		token = pg_strtok(&length); /* get nspname */ \
+		symstart = token; \
 		nspname = nullable_string(token, length); \
 		token = pg_strtok(&length); /* get operator name */ \
 		oprname = nullable_string(token, length); \
@@ -355,20 +466,24 @@ set_portable_input(bool value)
 		rightname = nullable_string(token, length); \
 		if (oprname) \
 		{ \
-			if (leftname) \
-				oprleft = get_typname_typid(leftname, \
-											NSP_OID(leftnspname)); \
-			else \
-				oprleft = InvalidOid; \
-			if (rightname) \
-				oprright = get_typname_typid(rightname, \
-											 NSP_OID(rightnspname)); \
-			else \
-				oprright = InvalidOid; \
-			local_node->fldname = get_operid(oprname, \
-											 oprleft, \
-											 oprright, \
-											 NSP_OID(nspname)); \
+			Oid oprid; \
+			if (!readPortableCached('o', symstart, token + length, &oprid)) \
+			{ \
+				if (leftname) \
+					oprleft = get_typname_typid(leftname, \
+												NSP_OID(leftnspname)); \
+				else \
+					oprleft = InvalidOid; \
+				if (rightname) \
+					oprright = get_typname_typid(rightname, \
+												 NSP_OID(rightnspname)); \
+				else \
+					oprright = InvalidOid; \
+				oprid = get_operid(oprname, oprleft, oprright, \
+								   NSP_OID(nspname)); \
+				readPortableRemember('o', symstart, token + length, oprid); \
+			} \
+			local_node->fldname = oprid; \
 		} \
 		else \
 			local_node->fldname = InvalidOid; \
@@ -2298,6 +2413,8 @@ _readAppend(void)
 
 	READ_NODE_FIELD(partitioned_rels);
 	READ_NODE_FIELD(appendplans);
+	READ_NODE_FIELD(part_prune_constraints);
+	READ_NODE_FIELD(part_prune_quals);
 
 	READ_DONE();
 }
@@ -2315,6 +2432,8 @@ _readMergeAppend(void)
 
 	READ_NODE_FIELD(partitioned_rels);
 	READ_NODE_FIELD(mergeplans);
+	READ_NODE_FIELD(part_prune_constraints);
+	READ_NODE_FIELD(part_prune_quals);
 	READ_INT_FIELD(numCols);
 	READ_ATTRNUMBER_ARRAY(sortColIdx, local_node->numCols);
 
@@ -2968,6 +3087,8 @@ _readSort(void)
 		local_node->nullsFirst[i] = strtobool(token);
 	}
 
+	READ_INT_FIELD(numPresortedCols);
+
 	READ_DONE();
 }
 
@@ -3626,8 +3747,25 @@ _readRemoteSubplan(void)
 	READ_INT_FIELD(distributionKey);
 	READ_NODE_FIELD(distributionNodes);
 	READ_NODE_FIELD(distributionRestrict);
+	READ_NODE_FIELD(skewValues);
+	if (portable_input)
+	{
+		READ_FUNCID_FIELD(skewEqfunc);
+		READ_COLLID_FIELD(skewCollation);
+	}
+	else
+	{
+		READ_OID_FIELD(skewEqfunc);
+		READ_OID_FIELD(skewCollation);
+	}
+	READ_BOOL_FIELD(skewBroadcast);
 	READ_NODE_FIELD(nodeList);
 	READ_BOOL_FIELD(execOnAll);
+	READ_NODE_FIELD(execNodesExpr);
+	READ_CHAR_FIELD(execNodesType);
+	READ_NODE_FIELD(execNodesMap);
+	READ_INT_FIELD(bloomKeyNo);
+	READ_BOOL_FIELD(memoize);
 	READ_NODE_FIELD(sort);
 	READ_STRING_FIELD(cursor);
 	READ_INT_FIELD(unique);
@@ -3702,6 +3840,22 @@ _readRemoteStmt(void)
 	READ_INT_FIELD(distributionKey);
 	READ_NODE_FIELD(distributionNodes);
 	READ_NODE_FIELD(distributionRestrict);
+	READ_NODE_FIELD(skewValues);
+	if (portable_input)
+	{
+		READ_FUNCID_FIELD(skewEqfunc);
+		READ_COLLID_FIELD(skewCollation);
+	}
+	else
+	{
+		READ_OID_FIELD(skewEqfunc);
+		READ_OID_FIELD(skewCollation);
+	}
+	READ_BOOL_FIELD(skewBroadcast);
+	READ_BOOL_FIELD(hasBloomParam);
+	READ_BOOL_FIELD(parallelModeNeeded);
+	READ_INT_FIELD(instrumentOptions);
+	READ_UINT_FIELD(queryId);
 
 	READ_DONE();
 }
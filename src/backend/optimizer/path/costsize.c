@@ -80,6 +80,7 @@
 #include "access/amapi.h"
 #include "access/htup_details.h"
 #include "access/tsmapi.h"
+#include "catalog/pgxc_node.h"
 #include "executor/executor.h"
 #include "executor/nodeHash.h"
 #include "miscadmin.h"
@@ -93,6 +94,13 @@
 #include "optimizer/planmain.h"
 #include "optimizer/restrictinfo.h"
 #include "parser/parsetree.h"
+#ifdef XCP
+#include "pgxc/locator.h"
+#include "pgxc/nodemgr.h"
+#include "pgxc/pgxc.h"
+#include "pgxc/pgxcnode.h"
+#include "pgxc/poolmgr.h"
+#endif
 #include "utils/lsyscache.h"
 #include "utils/selfuncs.h"
 #include "utils/spccache.h"
@@ -110,6 +118,8 @@ double		cpu_operator_cost = DEFAULT_CPU_OPERATOR_COST;
 #ifdef XCP
 double		network_byte_cost = DEFAULT_NETWORK_BYTE_COST;
 double		remote_query_cost = DEFAULT_REMOTE_QUERY_COST;
+double		network_compression_ratio = DEFAULT_NETWORK_COMPRESSION_RATIO;
+double		network_cross_zone_factor = DEFAULT_NETWORK_CROSS_ZONE_FACTOR;
 #endif
 double		parallel_tuple_cost = DEFAULT_PARALLEL_TUPLE_COST;
 double		parallel_setup_cost = DEFAULT_PARALLEL_SETUP_COST;
@@ -132,7 +142,16 @@ bool		enable_material = true;
 bool		enable_mergejoin = true;
 bool		enable_hashjoin = true;
 bool		enable_fast_query_shipping = true;
+bool		enable_broadcast_join = false;
+bool		enable_bloom_filter = false;
+bool		enable_remote_memoize = false;
 bool		enable_gathermerge = true;
+bool		enable_incremental_sort = true;
+bool		enable_partition_wise_join = false;
+bool		enable_cte_inline = false;
+bool		enable_scalar_sublink_join = true;
+bool		enable_window_redistribution = false;
+bool		enable_grouping_redistribution = false;
 
 typedef struct
 {
@@ -144,6 +163,10 @@ static List *extract_nonindex_conditions(List *qual_clauses, List *indexquals);
 static MergeScanSelCache *cached_scansel(PlannerInfo *root,
 			   RestrictInfo *rinfo,
 			   PathKey *pathkey);
+static void cost_tuplesort(Cost *startup_cost, Cost *run_cost,
+			   double tuples, int width,
+			   Cost comparison_cost, int sort_mem,
+			   double limit_tuples);
 static void cost_rescan(PlannerInfo *root, Path *path,
 			Cost *rescan_startup_cost, Cost *rescan_total_cost);
 static bool cost_qual_eval_walker(Node *node, cost_qual_eval_context *context);
@@ -1602,67 +1625,24 @@ cost_recursive_union(Path *runion, Path *nrterm, Path *rterm)
 }
 
 /*
- * cost_sort
- *	  Determines and returns the cost of sorting a relation, including
- *	  the cost of reading the input data.
- *
- * If the total volume of data to sort is less than sort_mem, we will do
- * an in-memory sort, which requires no I/O and about t*log2(t) tuple
- * comparisons for t tuples.
- *
- * If the total volume exceeds sort_mem, we switch to a tape-style merge
- * algorithm.  There will still be about t*log2(t) tuple comparisons in
- * total, but we will also need to write and read each tuple once per
- * merge pass.  We expect about ceil(logM(r)) merge passes where r is the
- * number of initial runs formed and M is the merge order used by tuplesort.c.
- * Since the average initial run should be about sort_mem, we have
- *		disk traffic = 2 * relsize * ceil(logM(p / sort_mem))
- *		cpu = comparison_cost * t * log2(t)
- *
- * If the sort is bounded (i.e., only the first k result tuples are needed)
- * and k tuples can fit into sort_mem, we use a heap method that keeps only
- * k tuples in the heap; this will require about t*log2(k) tuple comparisons.
- *
- * The disk traffic is assumed to be 3/4ths sequential and 1/4th random
- * accesses (XXX can't we refine that guess?)
- *
- * By default, we charge two operator evals per tuple comparison, which should
- * be in the right ballpark in most cases.  The caller can tweak this by
- * specifying nonzero comparison_cost; typically that's used for any extra
- * work that has to be done to prepare the inputs to the comparison operators.
- *
- * 'pathkeys' is a list of sort keys
- * 'input_cost' is the total cost for reading the input data
- * 'tuples' is the number of tuples in the relation
- * 'width' is the average tuple width in bytes
- * 'comparison_cost' is the extra cost per comparison, if any
- * 'sort_mem' is the number of kilobytes of work memory allowed for the sort
- * 'limit_tuples' is the bound on the number of output tuples; -1 if no bound
- *
- * NOTE: some callers currently pass NIL for pathkeys because they
- * can't conveniently supply the sort keys.  Since this routine doesn't
- * currently do anything with pathkeys anyway, that doesn't matter...
- * but if it ever does, it should react gracefully to lack of key data.
- * (Actually, the thing we'd most likely be interested in is just the number
- * of sort keys, which all callers *could* supply.)
+ * cost_tuplesort
+ *	  Determines the cost of sorting 'tuples' tuples of the given width with
+ *	  tuplesort.c, not including reading the input.  This is the guts of
+ *	  cost_sort; see there for details.
  */
-void
-cost_sort(Path *path, PlannerInfo *root,
-		  List *pathkeys, Cost input_cost, double tuples, int width,
-		  Cost comparison_cost, int sort_mem,
-		  double limit_tuples)
+static void
+cost_tuplesort(Cost *startup_cost, Cost *run_cost,
+			   double tuples, int width,
+			   Cost comparison_cost, int sort_mem,
+			   double limit_tuples)
 {
-	Cost		startup_cost = input_cost;
-	Cost		run_cost = 0;
 	double		input_bytes = relation_byte_size(tuples, width);
 	double		output_bytes;
 	double		output_tuples;
 	long		sort_mem_bytes = sort_mem * 1024L;
 
-	if (!enable_sort)
-		startup_cost += disable_cost;
-
-	path->rows = tuples;
+	*startup_cost = 0;
+	*run_cost = 0;
 
 	/*
 	 * We want to be sure the cost of a sort is never estimated as zero, even
@@ -1702,7 +1682,7 @@ cost_sort(Path *path, PlannerInfo *root,
 		 *
 		 * Assume about N log2 N comparisons
 		 */
-		startup_cost += comparison_cost * tuples * LOG2(tuples);
+		*startup_cost += comparison_cost * tuples * LOG2(tuples);
 
 		/* Disk costs */
 
@@ -1713,7 +1693,7 @@ cost_sort(Path *path, PlannerInfo *root,
 			log_runs = 1.0;
 		npageaccesses = 2.0 * npages * log_runs;
 		/* Assume 3/4ths of accesses are sequential, 1/4th are not */
-		startup_cost += npageaccesses *
+		*startup_cost += npageaccesses *
 			(seq_page_cost * 0.75 + random_page_cost * 0.25);
 	}
 	else if (tuples > 2 * output_tuples || input_bytes > sort_mem_bytes)
@@ -1724,12 +1704,12 @@ cost_sort(Path *path, PlannerInfo *root,
 		 * factor is a bit higher than for quicksort.  Tweak it so that the
 		 * cost curve is continuous at the crossover point.
 		 */
-		startup_cost += comparison_cost * tuples * LOG2(2.0 * output_tuples);
+		*startup_cost += comparison_cost * tuples * LOG2(2.0 * output_tuples);
 	}
 	else
 	{
 		/* We'll use plain quicksort on all the input tuples */
-		startup_cost += comparison_cost * tuples * LOG2(tuples);
+		*startup_cost += comparison_cost * tuples * LOG2(tuples);
 	}
 
 	/*
@@ -1740,7 +1720,158 @@ cost_sort(Path *path, PlannerInfo *root,
 	 * here --- the upper LIMIT will pro-rate the run cost so we'd be double
 	 * counting the LIMIT otherwise.
 	 */
-	run_cost += cpu_operator_cost * tuples;
+	*run_cost += cpu_operator_cost * tuples;
+
+}
+
+/*
+ * cost_sort
+ *	  Determines and returns the cost of sorting a relation, including
+ *	  the cost of reading the input data.
+ *
+ * If the total volume of data to sort is less than sort_mem, we will do
+ * an in-memory sort, which requires no I/O and about t*log2(t) tuple
+ * comparisons for t tuples.
+ *
+ * If the total volume exceeds sort_mem, we switch to a tape-style merge
+ * algorithm.  There will still be about t*log2(t) tuple comparisons in
+ * total, but we will also need to write and read each tuple once per
+ * merge pass.  We expect about ceil(logM(r)) merge passes where r is the
+ * number of initial runs formed and M is the merge order used by tuplesort.c.
+ * Since the average initial run should be about sort_mem, we have
+ *		disk traffic = 2 * relsize * ceil(logM(p / sort_mem))
+ *		cpu = comparison_cost * t * log2(t)
+ *
+ * If the sort is bounded (i.e., only the first k result tuples are needed)
+ * and k tuples can fit into sort_mem, we use a heap method that keeps only
+ * k tuples in the heap; this will require about t*log2(k) tuple comparisons.
+ *
+ * The disk traffic is assumed to be 3/4ths sequential and 1/4th random
+ * accesses (XXX can't we refine that guess?)
+ *
+ * By default, we charge two operator evals per tuple comparison, which should
+ * be in the right ballpark in most cases.  The caller can tweak this by
+ * specifying nonzero comparison_cost; typically that's used for any extra
+ * work that has to be done to prepare the inputs to the comparison operators.
+ *
+ * 'pathkeys' is a list of sort keys
+ * 'input_cost' is the total cost for reading the input data
+ * 'tuples' is the number of tuples in the relation
+ * 'width' is the average tuple width in bytes
+ * 'comparison_cost' is the extra cost per comparison, if any
+ * 'sort_mem' is the number of kilobytes of work memory allowed for the sort
+ * 'limit_tuples' is the bound on the number of output tuples; -1 if no bound
+ *
+ * NOTE: some callers currently pass NIL for pathkeys because they
+ * can't conveniently supply the sort keys.  Since this routine doesn't
+ * currently do anything with pathkeys anyway, that doesn't matter...
+ * but if it ever does, it should react gracefully to lack of key data.
+ * (Actually, the thing we'd most likely be interested in is just the number
+ * of sort keys, which all callers *could* supply.)
+ */
+void
+cost_sort(Path *path, PlannerInfo *root,
+		  List *pathkeys, Cost input_cost, double tuples, int width,
+		  Cost comparison_cost, int sort_mem,
+		  double limit_tuples)
+{
+	Cost		startup_cost = input_cost;
+	Cost		sort_startup_cost;
+	Cost		sort_run_cost;
+
+	if (!enable_sort)
+		startup_cost += disable_cost;
+
+	path->rows = tuples;
+
+	cost_tuplesort(&sort_startup_cost, &sort_run_cost,
+				   tuples, width, comparison_cost, sort_mem,
+				   limit_tuples);
+
+	path->startup_cost = startup_cost + sort_startup_cost;
+	path->total_cost = path->startup_cost + sort_run_cost;
+}
+
+/*
+ * cost_incremental_sort
+ *	  Determines and returns the cost of a Sort whose input is already sorted
+ *	  by the first 'presorted_keys' of 'pathkeys'.
+ *
+ * Such a sort reads and sorts one group of tuples with equal presorted keys
+ * at a time, so it only needs to have read and sorted the first group before
+ * returning its first tuple.  We estimate the number of groups from the
+ * presorted keys, and charge a separate tuplesort for each of them plus a
+ * comparison per input tuple to find the group boundaries.
+ *
+ * The arguments are as for cost_sort, except that the input cost is given as
+ * separate startup and total costs.
+ */
+void
+cost_incremental_sort(Path *path, PlannerInfo *root,
+					  List *pathkeys, int presorted_keys,
+					  Cost input_startup_cost, Cost input_total_cost,
+					  double input_tuples, int width,
+					  Cost comparison_cost, int sort_mem,
+					  double limit_tuples)
+{
+	Cost		startup_cost = input_startup_cost;
+	Cost		input_run_cost = input_total_cost - input_startup_cost;
+	Cost		run_cost;
+	Cost		group_startup_cost;
+	Cost		group_run_cost;
+	double		input_groups;
+	double		group_tuples;
+	List	   *presortedExprs = NIL;
+	ListCell   *l;
+	int			i = 0;
+
+	Assert(presorted_keys > 0 && presorted_keys < list_length(pathkeys));
+
+	if (!enable_sort)
+		startup_cost += disable_cost;
+
+	path->rows = input_tuples;
+
+	/* Mustn't do log(0) in cost_tuplesort, nor divide by zero below */
+	if (input_tuples < 2.0)
+		input_tuples = 2.0;
+
+	/* Estimate the number of groups with equal presorted keys */
+	foreach(l, pathkeys)
+	{
+		PathKey    *key = (PathKey *) lfirst(l);
+		EquivalenceMember *member = (EquivalenceMember *)
+		linitial(key->pk_eclass->ec_members);
+
+		presortedExprs = lappend(presortedExprs, member->em_expr);
+
+		if (++i >= presorted_keys)
+			break;
+	}
+
+	input_groups = estimate_num_groups(root, presortedExprs, input_tuples,
+									   NULL);
+	group_tuples = input_tuples / input_groups;
+
+	/*
+	 * Cost of sorting one average group.  A LIMIT applies to the whole
+	 * output, so don't let it shrink the per-group sort.
+	 */
+	cost_tuplesort(&group_startup_cost, &group_run_cost,
+				   group_tuples, width, comparison_cost, sort_mem,
+				   -1.0);
+
+	/* Input for the first group has to be read and sorted before returning */
+	startup_cost += group_startup_cost + input_run_cost / input_groups;
+
+	/* The remaining groups get read and sorted as output proceeds */
+	run_cost = group_run_cost +
+		(group_startup_cost + group_run_cost) * (input_groups - 1) +
+		input_run_cost * (1.0 - 1.0 / input_groups);
+
+	/* Each input tuple is compared with the group's first one */
+	run_cost += (cpu_tuple_cost + presorted_keys * cpu_operator_cost) *
+		input_tuples;
 
 	path->startup_cost = startup_cost;
 	path->total_cost = startup_cost + run_cost;
@@ -5081,13 +5212,92 @@ page_size(double tuples, int width)
 }
 
 #ifdef XCP
+/*
+ * distribution_node_oids
+ *	  Returns palloc'd array of the nodes holding the data of a distribution.
+ *	  Data that is not distributed is on the local Coordinator.
+ */
+static Oid *
+distribution_node_oids(Distribution *distribution, int *count)
+{
+	Oid		   *oids;
+	int			i;
+
+	if (distribution == NULL || bms_is_empty(distribution->nodes))
+	{
+		oids = (Oid *) palloc(sizeof(Oid));
+		oids[0] = get_pgxc_nodeoid(PGXCNodeName);
+		*count = 1;
+		return oids;
+	}
+
+	oids = (Oid *) palloc(bms_num_members(distribution->nodes) * sizeof(Oid));
+	*count = 0;
+	i = -1;
+	while ((i = bms_next_member(distribution->nodes, i)) >= 0)
+		oids[(*count)++] = PGXCNodeGetNodeOid(i, PGXC_NODE_DATANODE);
+
+	return oids;
+}
+
+/*
+ * network_zone_factor
+ *	  Returns the factor to apply to network_byte_cost for data moved from the
+ *	  source to the target distribution, taking into account how much of the
+ *	  traffic crosses network zones (see the ZONE option of CREATE NODE).
+ *
+ * Every source node sends to every target node, except that only one node
+ * of a replicated source sends its copy, and we assume the closest one.
+ */
+static double
+network_zone_factor(Distribution *source, Distribution *target)
+{
+	Oid		   *senders;
+	Oid		   *receivers;
+	int			nsenders;
+	int			nreceivers;
+	double		cross;
+
+	if (network_cross_zone_factor == 1.0)
+		return 1.0;
+
+	senders = distribution_node_oids(source, &nsenders);
+	receivers = distribution_node_oids(target, &nreceivers);
+
+	if (source && IsLocatorReplicated(source->distributionType))
+	{
+		int			i;
+
+		cross = 1.0;
+		for (i = 0; i < nsenders; i++)
+			cross = Min(cross, PgxcNodeCrossZoneFraction(&senders[i], 1,
+														 receivers,
+														 nreceivers));
+	}
+	else
+		cross = PgxcNodeCrossZoneFraction(senders, nsenders,
+										  receivers, nreceivers);
+
+	pfree(senders);
+	pfree(receivers);
+
+	return 1.0 + cross * (network_cross_zone_factor - 1.0);
+}
+
+/*
+ * cost_remote_subplan
+ *	  Determines and returns the cost of moving the data of the input path
+ *	  from the source distribution to the one of the path.
+ */
 void
 cost_remote_subplan(Path *path,
 			  Cost input_startup_cost, Cost input_total_cost,
-			  double tuples, int width, int replication)
+			  double tuples, int width, int replication,
+			  Distribution *source)
 {
 	Cost		startup_cost = input_startup_cost + remote_query_cost;
 	Cost		run_cost = input_total_cost - input_startup_cost;
+	double		byte_cost;
 
 	path->rows = tuples;
 
@@ -5097,9 +5307,17 @@ cost_remote_subplan(Path *path,
 	run_cost += 2 * cpu_operator_cost * tuples;
 
 	/*
-	 * Estimate cost of sending data over network
+	 * Estimate cost of sending data over network, only the compressed data
+	 * goes over the wire if connections are compressed.
 	 */
-	run_cost += network_byte_cost * tuples * width * replication;
+	byte_cost = network_byte_cost *
+		network_zone_factor(source, path->distribution);
+
+	if (NetworkCompression)
+		run_cost += byte_cost * network_compression_ratio *
+			tuples * width * replication;
+	else
+		run_cost += byte_cost * tuples * width * replication;
 
 	path->startup_cost = startup_cost;
 	path->total_cost = startup_cost + run_cost;
@@ -14,10 +14,18 @@
  */
 #include "postgres.h"
 
+#include "access/heapam.h"
+#include "catalog/partition.h"
+#include "catalog/pg_class.h"
+#include "optimizer/clauses.h"
+#include "optimizer/cost.h"
 #include "optimizer/joininfo.h"
 #include "optimizer/pathnode.h"
 #include "optimizer/paths.h"
+#include "optimizer/prep.h"
+#include "parser/parsetree.h"
 #include "utils/memutils.h"
+#include "utils/rel.h"
 
 
 static void make_rels_by_clause_joins(PlannerInfo *root,
@@ -35,6 +43,21 @@ static bool restriction_is_constant_false(List *restrictlist,
 static void populate_joinrel_with_paths(PlannerInfo *root, RelOptInfo *rel1,
 							RelOptInfo *rel2, RelOptInfo *joinrel,
 							SpecialJoinInfo *sjinfo, List *restrictlist);
+static void try_partition_wise_join(PlannerInfo *root, RelOptInfo *rel1,
+						RelOptInfo *rel2, RelOptInfo *joinrel,
+						SpecialJoinInfo *parent_sjinfo,
+						List *parent_restrictlist);
+static bool partition_keys_match(PartitionKey key1, PartitionKey key2);
+static bool have_partkey_equi_join(RelOptInfo *rel1, RelOptInfo *rel2,
+					   PartitionKey key1, PartitionKey key2,
+					   JoinType jointype, List *restrictlist);
+static AppendRelInfo **find_partition_appinfos(PlannerInfo *root,
+						RelOptInfo *rel, PartitionDesc partdesc);
+static SpecialJoinInfo *build_child_join_sjinfo(PlannerInfo *root,
+						SpecialJoinInfo *parent_sjinfo,
+						AppendRelInfo *appinfo1, AppendRelInfo *appinfo2);
+static Relids adjust_child_relids(Relids relids, AppendRelInfo *appinfo1,
+					AppendRelInfo *appinfo2);
 
 
 /*
@@ -731,6 +754,9 @@ make_join_rel(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2)
 	populate_joinrel_with_paths(root, rel1, rel2, joinrel, sjinfo,
 								restrictlist);
 
+	/* Also consider joining the partitions pairwise */
+	try_partition_wise_join(root, rel1, rel2, joinrel, sjinfo, restrictlist);
+
 	bms_free(joinrelids);
 
 	return joinrel;
@@ -895,6 +921,356 @@ populate_joinrel_with_paths(PlannerInfo *root, RelOptInfo *rel1,
 }
 
 
+/*
+ * try_partition_wise_join
+ *	  Consider joining two partitioned tables partition by partition.
+ *
+ * When both sides are partitioned the same way, with the same bounds, and
+ * the join equates their partition keys, a row of one partition can only
+ * join rows of the partition with the same bounds on the other side.  The
+ * join can then be done as an Append of the joins of matching partitions,
+ * which need smaller hash tables and sorts than the join of the whole
+ * tables, and, when the partitions are colocated, still run entirely on
+ * the datanodes.
+ *
+ * Only joins of two partitioned base relations whose partitions are all
+ * leaf tables are considered, and the joins of the partitions do not take
+ * part in any further join; a plan joining a third relation uses the Append
+ * as a whole.
+ */
+static void
+try_partition_wise_join(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2,
+						RelOptInfo *joinrel, SpecialJoinInfo *parent_sjinfo,
+						List *parent_restrictlist)
+{
+	RangeTblEntry *rte1;
+	RangeTblEntry *rte2;
+	Relation	parent1;
+	Relation	parent2;
+	AppendRelInfo **appinfos1 = NULL;
+	AppendRelInfo **appinfos2 = NULL;
+	int			nparts = 0;
+	List	   *subpaths = NIL;
+	int			i;
+
+	if (!enable_partition_wise_join || is_dummy_rel(joinrel))
+		return;
+
+	if (rel1->reloptkind != RELOPT_BASEREL ||
+		rel2->reloptkind != RELOPT_BASEREL)
+		return;
+
+	/*
+	 * The translation of the join to the partitions does not deal with
+	 * placeholders or lateral references.
+	 */
+	if (root->placeholder_list != NIL || root->hasLateralRTEs)
+		return;
+
+	rte1 = planner_rt_fetch(rel1->relid, root);
+	rte2 = planner_rt_fetch(rel2->relid, root);
+	if (rte1->rtekind != RTE_RELATION || !rte1->inh ||
+		rte1->relkind != RELKIND_PARTITIONED_TABLE ||
+		rte2->rtekind != RTE_RELATION || !rte2->inh ||
+		rte2->relkind != RELKIND_PARTITIONED_TABLE)
+		return;
+
+	/* The planner already holds locks on both tables */
+	parent1 = heap_open(rte1->relid, NoLock);
+	parent2 = heap_open(rte2->relid, NoLock);
+
+	if (partition_keys_match(RelationGetPartitionKey(parent1),
+							 RelationGetPartitionKey(parent2)) &&
+		partition_bounds_equal(RelationGetPartitionKey(parent1),
+							   RelationGetPartitionDesc(parent1)->boundinfo,
+							   RelationGetPartitionDesc(parent2)->boundinfo) &&
+		have_partkey_equi_join(rel1, rel2,
+							   RelationGetPartitionKey(parent1),
+							   RelationGetPartitionKey(parent2),
+							   parent_sjinfo->jointype, parent_restrictlist))
+	{
+		nparts = RelationGetPartitionDesc(parent1)->nparts;
+		appinfos1 = find_partition_appinfos(root, rel1,
+											RelationGetPartitionDesc(parent1));
+		appinfos2 = find_partition_appinfos(root, rel2,
+											RelationGetPartitionDesc(parent2));
+	}
+
+	heap_close(parent1, NoLock);
+	heap_close(parent2, NoLock);
+
+	if (appinfos1 == NULL || appinfos2 == NULL)
+		return;
+
+	/*
+	 * Equal bounds list the partitions in the same order, join the ones at
+	 * the same position.
+	 */
+	for (i = 0; i < nparts; i++)
+	{
+		RelOptInfo *child1 = find_base_rel(root, appinfos1[i]->child_relid);
+		RelOptInfo *child2 = find_base_rel(root, appinfos2[i]->child_relid);
+		RelOptInfo *child_joinrel;
+		SpecialJoinInfo *sjinfo;
+		List	   *restrictlist;
+		Path	   *path;
+
+		restrictlist = (List *) adjust_appendrel_attrs(root,
+											   (Node *) parent_restrictlist,
+													   appinfos1[i]);
+		restrictlist = (List *) adjust_appendrel_attrs(root,
+													   (Node *) restrictlist,
+													   appinfos2[i]);
+		sjinfo = build_child_join_sjinfo(root, parent_sjinfo,
+										 appinfos1[i], appinfos2[i]);
+
+		child_joinrel = build_child_join_rel(root, child1, child2, joinrel,
+											 restrictlist, sjinfo,
+											 appinfos1[i], appinfos2[i]);
+		populate_joinrel_with_paths(root, child1, child2, child_joinrel,
+									sjinfo, restrictlist);
+
+		/* An empty join of two partitions adds nothing to the Append */
+		if (is_dummy_rel(child_joinrel))
+			continue;
+
+		if (child_joinrel->pathlist == NIL)
+			return;
+		set_cheapest(child_joinrel);
+
+		/*
+		 * All members of the Append must have the same parameterization,
+		 * the parent join is only given an unparameterized one.
+		 */
+		path = child_joinrel->cheapest_total_path;
+		if (path == NULL || !bms_is_empty(PATH_REQ_OUTER(path)))
+			return;
+
+		subpaths = lappend(subpaths, path);
+	}
+
+	if (subpaths == NIL)
+		return;
+
+	add_path(joinrel, (Path *) create_append_path(joinrel, subpaths, NULL,
+												  0, NIL));
+}
+
+/*
+ * partition_keys_match
+ *	  Check that two tables are partitioned the same way, on plain columns.
+ */
+static bool
+partition_keys_match(PartitionKey key1, PartitionKey key2)
+{
+	int			i;
+
+	if (key1 == NULL || key2 == NULL)
+		return false;
+
+	if (key1->strategy != key2->strategy ||
+		key1->partnatts != key2->partnatts)
+		return false;
+
+	for (i = 0; i < key1->partnatts; i++)
+	{
+		/* Expressions would have to be matched against the join clauses */
+		if (key1->partattrs[i] == 0 || key2->partattrs[i] == 0)
+			return false;
+
+		if (key1->parttypid[i] != key2->parttypid[i] ||
+			key1->partopfamily[i] != key2->partopfamily[i] ||
+			key1->partcollation[i] != key2->partcollation[i])
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * have_partkey_equi_join
+ *	  Check that the join clauses equate each column of the partition key of
+ *	  rel1 to the same column of the partition key of rel2, using equality
+ *	  of the operator family the tables are partitioned by.
+ */
+static bool
+have_partkey_equi_join(RelOptInfo *rel1, RelOptInfo *rel2,
+					   PartitionKey key1, PartitionKey key2,
+					   JoinType jointype, List *restrictlist)
+{
+	bool		matched[PARTITION_MAX_KEYS];
+	ListCell   *lc;
+	int			i;
+
+	memset(matched, 0, sizeof(matched));
+
+	foreach(lc, restrictlist)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+		OpExpr	   *opexpr;
+		Expr	   *left;
+		Expr	   *right;
+
+		/* Conditions of an outer join above this one do not count */
+		if (IS_OUTER_JOIN(jointype) && rinfo->is_pushed_down)
+			continue;
+
+		/* Only mergejoinable equalities can match partition keys */
+		if (!rinfo->can_join || rinfo->mergeopfamilies == NIL)
+			continue;
+
+		opexpr = (OpExpr *) rinfo->clause;
+		if (!is_opclause(opexpr) || list_length(opexpr->args) != 2)
+			continue;
+
+		left = (Expr *) linitial(opexpr->args);
+		right = (Expr *) lsecond(opexpr->args);
+		while (IsA(left, RelabelType))
+			left = ((RelabelType *) left)->arg;
+		while (IsA(right, RelabelType))
+			right = ((RelabelType *) right)->arg;
+
+		if (!IsA(left, Var) || !IsA(right, Var))
+			continue;
+
+		if (((Var *) left)->varno == rel2->relid)
+		{
+			Expr	   *tmp = left;
+
+			left = right;
+			right = tmp;
+		}
+		if (((Var *) left)->varno != rel1->relid ||
+			((Var *) right)->varno != rel2->relid)
+			continue;
+
+		for (i = 0; i < key1->partnatts; i++)
+		{
+			if (key1->partattrs[i] == ((Var *) left)->varattno &&
+				key2->partattrs[i] == ((Var *) right)->varattno &&
+				list_member_oid(rinfo->mergeopfamilies, key1->partopfamily[i]))
+				matched[i] = true;
+		}
+	}
+
+	for (i = 0; i < key1->partnatts; i++)
+	{
+		if (!matched[i])
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * find_partition_appinfos
+ *	  Returns the AppendRelInfos of the partitions of a partitioned base rel,
+ *	  in the order of the partition descriptor, or NULL if some partition is
+ *	  not a leaf table scanned directly by the rel.
+ */
+static AppendRelInfo **
+find_partition_appinfos(PlannerInfo *root, RelOptInfo *rel,
+						PartitionDesc partdesc)
+{
+	AppendRelInfo **appinfos;
+	int			nfound = 0;
+	ListCell   *lc;
+
+	if (partdesc == NULL || partdesc->nparts == 0)
+		return NULL;
+
+	appinfos = (AppendRelInfo **)
+		palloc0(partdesc->nparts * sizeof(AppendRelInfo *));
+
+	foreach(lc, root->append_rel_list)
+	{
+		AppendRelInfo *appinfo = (AppendRelInfo *) lfirst(lc);
+		RangeTblEntry *childrte;
+		int			i;
+
+		if (appinfo->parent_relid != rel->relid)
+			continue;
+
+		childrte = planner_rt_fetch(appinfo->child_relid, root);
+		for (i = 0; i < partdesc->nparts; i++)
+		{
+			if (partdesc->oids[i] == childrte->relid)
+				break;
+		}
+
+		/* A leaf of a partitioned partition is not in the descriptor */
+		if (i >= partdesc->nparts || appinfos[i] != NULL)
+		{
+			pfree(appinfos);
+			return NULL;
+		}
+
+		appinfos[i] = appinfo;
+		nfound++;
+	}
+
+	if (nfound != partdesc->nparts)
+	{
+		pfree(appinfos);
+		return NULL;
+	}
+
+	return appinfos;
+}
+
+/*
+ * build_child_join_sjinfo
+ *	  Translate the SpecialJoinInfo of a join of partitioned tables to the
+ *	  join of two of their partitions.
+ */
+static SpecialJoinInfo *
+build_child_join_sjinfo(PlannerInfo *root, SpecialJoinInfo *parent_sjinfo,
+						AppendRelInfo *appinfo1, AppendRelInfo *appinfo2)
+{
+	SpecialJoinInfo *sjinfo = makeNode(SpecialJoinInfo);
+
+	memcpy(sjinfo, parent_sjinfo, sizeof(SpecialJoinInfo));
+	sjinfo->min_lefthand = adjust_child_relids(parent_sjinfo->min_lefthand,
+											   appinfo1, appinfo2);
+	sjinfo->min_righthand = adjust_child_relids(parent_sjinfo->min_righthand,
+												appinfo1, appinfo2);
+	sjinfo->syn_lefthand = adjust_child_relids(parent_sjinfo->syn_lefthand,
+											   appinfo1, appinfo2);
+	sjinfo->syn_righthand = adjust_child_relids(parent_sjinfo->syn_righthand,
+												appinfo1, appinfo2);
+	sjinfo->semi_rhs_exprs = (List *)
+		adjust_appendrel_attrs(root, (Node *) parent_sjinfo->semi_rhs_exprs,
+							   appinfo1);
+	sjinfo->semi_rhs_exprs = (List *)
+		adjust_appendrel_attrs(root, (Node *) sjinfo->semi_rhs_exprs,
+							   appinfo2);
+
+	return sjinfo;
+}
+
+/*
+ * adjust_child_relids
+ *	  Substitute the partitions for their parents in a Relids set.
+ */
+static Relids
+adjust_child_relids(Relids relids, AppendRelInfo *appinfo1,
+					AppendRelInfo *appinfo2)
+{
+	relids = bms_copy(relids);
+	if (bms_is_member(appinfo1->parent_relid, relids))
+	{
+		relids = bms_del_member(relids, appinfo1->parent_relid);
+		relids = bms_add_member(relids, appinfo1->child_relid);
+	}
+	if (bms_is_member(appinfo2->parent_relid, relids))
+	{
+		relids = bms_del_member(relids, appinfo2->parent_relid);
+		relids = bms_add_member(relids, appinfo2->child_relid);
+	}
+	return relids;
+}
+
+
 /*
  * have_join_order_restriction
  *		Detect whether the two relations should be joined to satisfy
@@ -47,6 +47,7 @@
 #include "access/htup_details.h"
 #include "access/gtm.h"
 #include "parser/parse_coerce.h"
+#include "pgxc/distadvisor.h"
 #include "pgxc/pgxc.h"
 #include "pgxc/pgxcnode.h"
 #include "pgxc/planner.h"
@@ -102,6 +103,9 @@ static Plan *create_gating_plan(PlannerInfo *root, Path *path, Plan *plan,
 static Plan *create_join_plan(PlannerInfo *root, JoinPath *best_path);
 static Plan *create_append_plan(PlannerInfo *root, AppendPath *best_path);
 static Plan *create_merge_append_plan(PlannerInfo *root, MergeAppendPath *best_path);
+static void make_partition_prune_quals(PlannerInfo *root, List *subpaths,
+						   List **constraints, List **quals);
+static bool contain_param_walker(Node *node, void *context);
 static Result *create_result_plan(PlannerInfo *root, ResultPath *best_path);
 #ifdef XCP
 static void adjust_subplan_distribution(PlannerInfo *root, Distribution *pathd,
@@ -317,6 +321,7 @@ static GatherMerge *create_gather_merge_plan(PlannerInfo *root,
 static int add_sort_column(AttrNumber colIdx, Oid sortOp, Oid coll,
 				bool nulls_first,int numCols, AttrNumber *sortColIdx,
 				Oid *sortOperators, Oid *collations, bool *nullsFirst);
+static void set_hashjoin_bloom_filter(HashJoin *join_plan);
 #endif
 
 static RemoteSubplan *find_push_down_plan(Plan *plan, bool force);
@@ -1099,6 +1104,10 @@ create_append_plan(PlannerInfo *root, AppendPath *best_path)
 
 	plan = make_append(subplans, tlist, best_path->partitioned_rels);
 
+	make_partition_prune_quals(root, best_path->subpaths,
+							   &plan->part_prune_constraints,
+							   &plan->part_prune_quals);
+
 	copy_generic_path_info(&plan->plan, (Path *) best_path);
 
 	return (Plan *) plan;
@@ -1208,9 +1217,123 @@ create_merge_append_plan(PlannerInfo *root, MergeAppendPath *best_path)
 	node->partitioned_rels = best_path->partitioned_rels;
 	node->mergeplans = subplans;
 
+	make_partition_prune_quals(root, best_path->subpaths,
+							   &node->part_prune_constraints,
+							   &node->part_prune_quals);
+
 	return (Plan *) node;
 }
 
+/*
+ * make_partition_prune_quals
+ *	  Collect what the executor needs to prune the children of an Append or
+ *	  MergeAppend of partitions, when their restrictions become known only
+ *	  at execution time.
+ *
+ * Constraint exclusion cannot use the restrictions comparing the partition
+ * key with a Param or with a stable function, such as those of the generic
+ * plan of a prepared statement or the join clauses pushed down into the
+ * inner side of a parameterized nested loop.  For each partition having such
+ * restrictions we return the constraints of the partition and its
+ * restrictions, with any outer Vars replaced by nestloop Params, for
+ * execPrune.c to try the proof again with the actual values.  Both lists
+ * have one member per subpath, NIL for those which cannot be pruned; if
+ * none can, both are NIL.
+ *
+ * Must be called after the plans of the subpaths were created, so that the
+ * nestloop Params are the same as those of the child scans.
+ */
+static void
+make_partition_prune_quals(PlannerInfo *root, List *subpaths,
+						   List **constraints, List **quals)
+{
+	bool		found = false;
+	ListCell   *lc;
+
+	*constraints = NIL;
+	*quals = NIL;
+
+	if (constraint_exclusion == CONSTRAINT_EXCLUSION_OFF)
+		return;
+
+	foreach(lc, subpaths)
+	{
+		Path	   *subpath = (Path *) lfirst(lc);
+		RelOptInfo *rel = subpath->parent;
+		List	   *childconstraints = NIL;
+		List	   *childquals = NIL;
+
+		if (rel->reloptkind == RELOPT_OTHER_MEMBER_REL &&
+			rel->rtekind == RTE_RELATION)
+		{
+			List	   *clauses;
+			bool		runtime = false;
+			ListCell   *lc2;
+
+			clauses = extract_actual_clauses(rel->baserestrictinfo, false);
+			if (subpath->param_info)
+			{
+				List	   *joinclauses;
+
+				joinclauses =
+					extract_actual_clauses(subpath->param_info->ppi_clauses,
+										   false);
+				joinclauses = (List *)
+					replace_nestloop_params(root, (Node *) joinclauses);
+				clauses = list_concat(clauses, joinclauses);
+			}
+
+			/* Values of volatile functions may change during the scan */
+			foreach(lc2, clauses)
+			{
+				Node	   *clause = (Node *) lfirst(lc2);
+
+				if (contain_volatile_functions(clause) ||
+					contain_subplans(clause))
+					continue;
+
+				if (contain_mutable_functions(clause) ||
+					contain_param_walker(clause, NULL))
+					runtime = true;
+				childquals = lappend(childquals, clause);
+			}
+
+			/* Otherwise constraint exclusion already had its chance */
+			if (runtime)
+				childconstraints =
+					get_relation_exclusion_constraints(root, rel,
+											 planner_rt_fetch(rel->relid, root));
+			if (childconstraints != NIL)
+				found = true;
+			else
+				childquals = NIL;
+		}
+
+		*constraints = lappend(*constraints, childconstraints);
+		*quals = lappend(*quals, childquals);
+	}
+
+	if (!found)
+	{
+		*constraints = NIL;
+		*quals = NIL;
+	}
+}
+
+/*
+ * contain_param_walker
+ *	  Check whether an expression contains any Param
+ */
+static bool
+contain_param_walker(Node *node, void *context)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Param))
+		return true;
+	return expression_tree_walker(node, contain_param_walker, context);
+}
+
 /*
  * create_result_plan
  *	  Create a Result plan for 'best_path'.
@@ -1706,6 +1829,13 @@ create_sort_plan(PlannerInfo *root, SortPath *best_path, int flags)
 
 	plan = make_sort_from_pathkeys(subplan, best_path->path.pathkeys);
 
+	/*
+	 * The leading sort columns match the leading pathkeys, unless some
+	 * redundant column was dropped; sort fully in that unlikely case.
+	 */
+	if (plan->numCols == list_length(best_path->path.pathkeys))
+		plan->numPresortedCols = best_path->numPresortedCols;
+
 	copy_generic_path_info(&plan->plan, (Path *) best_path);
 
 	return plan;
@@ -2619,6 +2749,25 @@ create_remotescan_plan(PlannerInfo *root,
 
 	copy_generic_path_info(&plan->scan.plan, (Path *) best_path);
 
+	/* Charge rows moved by hash or modulo to the distribution column */
+	if (IS_PGXC_COORDINATOR && best_path->path.distribution &&
+		(best_path->path.distribution->distributionType == LOCATOR_TYPE_HASH ||
+		 best_path->path.distribution->distributionType == LOCATOR_TYPE_MODULO))
+		DistAdvisorRecord(root, best_path->path.distribution->distributionExpr,
+						  best_path->path.rows,
+						  best_path->path.pathtarget->width);
+
+	/*
+	 * Rows of a read-only query depend only on the parameter values, so the
+	 * executor may reuse them when the subplan is rescanned with values it
+	 * has seen before.
+	 */
+	plan->memoize = enable_remote_memoize &&
+		root->parse->commandType == CMD_SELECT &&
+		!root->parse->hasModifyingCTE &&
+		root->parse->rowMarks == NIL &&
+		!contain_volatile_functions((Node *) root->parse);
+
 	/* restore current restrict */
 	bms_free(root->curOuterRestrict);
 	root->curOuterRestrict = saverestrict;
@@ -4482,9 +4631,92 @@ create_hashjoin_plan(PlannerInfo *root,
 
 	copy_generic_path_info(&join_plan->join.plan, &best_path->jpath.path);
 
+#ifdef XCP
+	set_hashjoin_bloom_filter(join_plan);
+#endif
+
 	return join_plan;
 }
 
+#ifdef XCP
+/*
+ * set_hashjoin_bloom_filter
+ *	  Decide if the Hash Join should send the Bloom filter of its inner keys
+ *	  down to the producers of the redistributed outer side.
+ *
+ * That is possible if the outer side is hash distributed on the outer argument
+ * of one of the hash clauses, and the inner argument is of the same type, so
+ * the producers can hash their rows the same way.  It pays off if the inner
+ * side is small enough for the filter to be selective, and the join throws
+ * away a good part of the outer rows.
+ */
+static void
+set_hashjoin_bloom_filter(HashJoin *join_plan)
+{
+	Plan	   *outer_plan = outerPlan(join_plan);
+	Plan	   *inner_plan = innerPlan(join_plan);
+	RemoteSubplan *rsp;
+	TargetEntry *tle;
+	Node	   *distexpr;
+	ListCell   *lc;
+	int			keyno;
+
+	if (!enable_bloom_filter)
+		return;
+
+	/* Unmatched outer rows must not be needed */
+	if (join_plan->join.jointype != JOIN_INNER &&
+		join_plan->join.jointype != JOIN_SEMI &&
+		join_plan->join.jointype != JOIN_RIGHT)
+		return;
+
+	if (!IsA(outer_plan, RemoteSubplan))
+		return;
+	rsp = (RemoteSubplan *) outer_plan;
+	if ((rsp->distributionType != LOCATOR_TYPE_HASH &&
+		 rsp->distributionType != LOCATOR_TYPE_MODULO) ||
+		rsp->distributionKey == InvalidAttrNumber ||
+		rsp->distributionNodes == NIL)
+		return;
+
+	/* Inner keys of one node should fit to the filter */
+	if (inner_plan->plan_rows >
+			(double) SQUEUE_FILTER_KEYS * list_length(rsp->distributionNodes))
+		return;
+
+	if (join_plan->join.plan.plan_rows > outer_plan->plan_rows * 0.5)
+		return;
+
+	tle = get_tle_by_resno(rsp->scan.plan.lefttree->targetlist,
+						   rsp->distributionKey);
+	if (tle == NULL)
+		return;
+	distexpr = (Node *) tle->expr;
+	if (IsA(distexpr, RelabelType))
+		distexpr = (Node *) ((RelabelType *) distexpr)->arg;
+
+	keyno = 0;
+	foreach(lc, join_plan->hashclauses)
+	{
+		OpExpr	   *clause = (OpExpr *) lfirst(lc);
+		Node	   *outerarg = (Node *) linitial(clause->args);
+		Node	   *innerarg = (Node *) lsecond(clause->args);
+
+		keyno++;
+		if (IsA(outerarg, RelabelType))
+			outerarg = (Node *) ((RelabelType *) outerarg)->arg;
+
+		if (equal(outerarg, distexpr) &&
+			exprType(innerarg) == exprType((Node *) tle->expr) &&
+			IsTypeHashDistributable(exprType(innerarg)))
+		{
+			rsp->bloomKeyNo = keyno;
+			return;
+		}
+	}
+}
+#endif
+
 
 /*****************************************************************************
  *
@@ -5642,6 +5874,11 @@ make_remotesubplan(PlannerInfo *root,
 		}
 		else
 			node->distributionRestrict = list_copy(node->distributionNodes);
+
+		node->skewValues = resultDistribution->skewValues;
+		node->skewEqfunc = resultDistribution->skewEqfunc;
+		node->skewCollation = resultDistribution->skewCollation;
+		node->skewBroadcast = resultDistribution->skewBroadcast;
 	}
 	else
 	{
@@ -5663,6 +5900,18 @@ make_remotesubplan(PlannerInfo *root,
 		bms_free(tmpset);
 		node->execOnAll = list_length(node->nodeList) == 1 ||
 				!IsLocatorReplicated(execDistribution->distributionType);
+
+		/* Let the executor restrict the nodes further, if possible */
+		if (execDistribution->restrictExpr && list_length(node->nodeList) > 1)
+		{
+			node->execNodesExpr = copyObject(execDistribution->restrictExpr);
+			node->execNodesType = execDistribution->distributionType;
+			node->execNodesMap = NIL;
+			tmpset = bms_copy(execDistribution->nodes);
+			while ((nodenum = bms_first_member(tmpset)) >= 0)
+				node->execNodesMap = lappend_int(node->execNodesMap, nodenum);
+			bms_free(tmpset);
+		}
 	}
 	else
 	{
@@ -6154,6 +6403,7 @@ make_sort(Plan *lefttree, int numCols,
 	node->sortOperators = sortOperators;
 	node->collations = collations;
 	node->nullsFirst = nullsFirst;
+	node->numPresortedCols = 0;
 
 	return node;
 }
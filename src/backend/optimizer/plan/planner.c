@@ -56,6 +56,7 @@
 #include "utils/rel.h"
 #ifdef PGXC
 #include "commands/prepare.h"
+#include "pgxc/locator.h"
 #include "pgxc/pgxc.h"
 #include "pgxc/planner.h"
 #endif
@@ -197,7 +198,16 @@ static bool groupingsets_distribution_match(PlannerInfo *root, Query *parse,
 static Path *adjust_path_distribution(PlannerInfo *root, Query *parse,
 					  Path *path);
 static bool can_push_down_grouping(PlannerInfo *root, Query *parse, Path *path);
-static bool can_push_down_window(PlannerInfo *root, Path *path);
+static Distribution *grouping_redistribution(Query *parse, Path *path);
+static void add_redistributed_final_agg_paths(PlannerInfo *root,
+					  RelOptInfo *grouped_rel, Path *partial_path,
+					  PathTarget *target, AggClauseCosts *agg_final_costs,
+					  double dNumGroups, bool can_sort, bool can_hash);
+static bool can_push_down_window(PlannerInfo *root, Path *path,
+					 WindowClause *wc, List *tlist);
+static Distribution *window_redistribution(Path *path, WindowClause *wc,
+					  List *tlist);
+static bool is_extern_param_expr(Node *node);
 static void adjust_paths_for_srfs(PlannerInfo *root, RelOptInfo *rel,
 					  List *targets, List *targets_contain_srfs);
 
@@ -2166,9 +2176,13 @@ grouping_planner(PlannerInfo *root, bool inheritance_update,
 				 * here. So this works well in case of constant expressions such as
 				 *
 				 *     SELECT .. LIMIT (1024 * 1024);
+				 *
+				 * LIMIT ALL or NULL gives zero count_est, there is nothing to
+				 * push down then. Negative sum means it has overflown.
 				 */
 				if (parse->limitCount && IsA(parse->limitCount, Const) &&
-					((parse->limitOffset == NULL) || IsA(parse->limitOffset, Const)))
+					((parse->limitOffset == NULL) || IsA(parse->limitOffset, Const)) &&
+					count_est > 0 && offset_est + count_est > 0)
 				{
 					Node *limitCount = (Node *) makeConst(INT8OID, -1,
 												   InvalidOid,
@@ -2181,6 +2195,20 @@ grouping_planner(PlannerInfo *root, bool inheritance_update,
 											  limitCount, /* LIMIT + OFFSET */
 											  0, offset_est + count_est);
 				}
+				/*
+				 * In generic plans of prepared statements the LIMIT is often
+				 * a parameter. The values of external parameters are sent to
+				 * the remote nodes, so the LIMIT can be pushed down as is, if
+				 * there is no OFFSET to add to it.
+				 */
+				else if (parse->limitCount && parse->limitOffset == NULL &&
+						 is_extern_param_expr(parse->limitCount))
+				{
+					path = (Path *) create_limit_path(root, final_rel, path,
+											  NULL,
+											  copyObject(parse->limitCount),
+											  0, count_est);
+				}
 
 				path = create_remotesubplan_path(root, path, NULL);
 			}
@@ -4596,6 +4624,13 @@ create_grouping_paths(PlannerInfo *root,
 														&agg_partial_costs,
 														dNumPartialGroups);
 
+						/* Also try to finalize on the remote nodes */
+						add_redistributed_final_agg_paths(root, grouped_rel,
+														  path, target,
+														  &agg_final_costs,
+														  dNumGroups,
+														  can_sort, can_hash);
+
 						path = create_remotesubplan_path(root, path, NULL);
 
 						/*
@@ -4697,6 +4732,13 @@ create_grouping_paths(PlannerInfo *root,
 					/* keep partially aggregated path for the can_sort branch */
 					agg_path = path;
 
+					/* Also try to finalize on the remote nodes */
+					add_redistributed_final_agg_paths(root, grouped_rel,
+													  agg_path, target,
+													  &agg_final_costs,
+													  dNumGroups,
+													  can_sort, can_hash);
+
 					path = create_remotesubplan_path(root, path, NULL);
 
 					/* Generate paths with both hash and sort second phase. */
@@ -5283,6 +5325,27 @@ create_one_window_path(PlannerInfo *root,
 												   wc,
 												   tlist);
 
+		/*
+		 * If the rows of a window partition may be spread over several
+		 * nodes, try to send them to the same node by redistributing along
+		 * one of the PARTITION BY keys, so that the window can still be
+		 * evaluated on the remote nodes, in parallel.  The redistributed
+		 * rows arrive in no particular order.  This is not costed against
+		 * evaluating the window on the coordinator, so it is only done when
+		 * enable_window_redistribution says so.
+		 */
+		if (enable_window_redistribution &&
+			!can_push_down_window(root, path, wc, tlist))
+		{
+			Distribution *distribution = window_redistribution(path, wc, tlist);
+
+			if (distribution != NULL)
+			{
+				path = create_remotesubplan_path(root, path, distribution);
+				path->pathkeys = NIL;
+			}
+		}
+
 		/* Sort if necessary */
 		if (!pathkeys_contained_in(window_pathkeys, path->pathkeys))
 		{
@@ -5319,8 +5382,8 @@ create_one_window_path(PlannerInfo *root,
 			window_target = output_target;
 		}
 
-		/* We can't really push down window functions for now. */
-		if (!can_push_down_window(root, path))
+		/* Otherwise evaluate the window on the coordinator. */
+		if (!can_push_down_window(root, path, wc, tlist))
 			path = create_remotesubplan_path(root, path, NULL);
 
 		path = (Path *)
@@ -5608,11 +5671,14 @@ create_ordered_paths(PlannerInfo *root,
 
 	foreach(lc, input_rel->pathlist)
 	{
-		Path	   *path = (Path *) lfirst(lc);
+		Path	   *input_path = (Path *) lfirst(lc);
+		Path	   *path = input_path;
 		bool		is_sorted;
+		int			presorted_keys;
 
-		is_sorted = pathkeys_contained_in(root->sort_pathkeys,
-										  path->pathkeys);
+		is_sorted = pathkeys_count_contained_in(root->sort_pathkeys,
+												path->pathkeys,
+												&presorted_keys);
 		if (path == cheapest_input_path || is_sorted)
 		{
 			if (!is_sorted)
@@ -5632,6 +5698,28 @@ create_ordered_paths(PlannerInfo *root,
 
 			add_path(ordered_rel, path);
 		}
+
+		/*
+		 * A path already sorted by some leading keys, such as a merge of
+		 * sorted Datanode results, can be sorted incrementally.  That avoids
+		 * reading all of the input before returning the first row.
+		 */
+		if (!is_sorted && presorted_keys > 0 && enable_incremental_sort)
+		{
+			path = (Path *) create_incremental_sort_path(root,
+														 ordered_rel,
+														 input_path,
+														 root->sort_pathkeys,
+														 presorted_keys,
+														 limit_tuples);
+
+			/* Add projection step if needed */
+			if (path->pathtarget != target)
+				path = apply_projection_to_path(root, ordered_rel,
+												path, target);
+
+			add_path(ordered_rel, path);
+		}
 	}
 
 	/*
@@ -6821,6 +6909,127 @@ grouping_distribution_match(PlannerInfo *root, Query *parse, Path *path,
 	return matches_key;
 }
 
+/*
+ * grouping_redistribution
+ * 	Build distribution sending partial groups along one of the grouping keys.
+ *
+ * With the partially aggregated rows redistributed this way, groups on
+ * different nodes do not overlap, so the final phase may run on the remote
+ * nodes too, instead of collecting all partial groups on the coordinator.
+ *
+ * Returns NULL if no grouping key can be used to redistribute the rows.
+ */
+static Distribution *
+grouping_redistribution(Query *parse, Path *path)
+{
+	Distribution *distribution;
+	ListCell   *lc;
+
+	/* Plain aggregation produces a single group, nothing to distribute */
+	if (parse->groupClause == NIL)
+		return NULL;
+
+	/* Only distributed data may be redistributed */
+	if (path->distribution == NULL ||
+		IsLocatorReplicated(path->distribution->distributionType))
+		return NULL;
+
+	foreach(lc, parse->groupClause)
+	{
+		SortGroupClause *sgc = (SortGroupClause *) lfirst(lc);
+		TargetEntry *te = get_sortgroupclause_tle(sgc, parse->targetList);
+		Oid			keytype = exprType((Node *) te->expr);
+		char		distType;
+
+		if (IsTypeHashDistributable(keytype))
+			distType = LOCATOR_TYPE_HASH;
+		else if (IsTypeModuloDistributable(keytype))
+			distType = LOCATOR_TYPE_MODULO;
+		else
+			continue;
+
+		distribution = makeNode(Distribution);
+		distribution->distributionType = distType;
+		distribution->nodes = bms_copy(path->distribution->nodes);
+		distribution->restrictNodes = NULL;
+		distribution->distributionExpr = (Node *) te->expr;
+
+		return distribution;
+	}
+
+	return NULL;
+}
+
+/*
+ * add_redistributed_final_agg_paths
+ * 	Add paths finalizing partial aggregates on the remote nodes.
+ *
+ * The partially aggregated rows are redistributed along a grouping key, and
+ * combined and finalized where they arrive. The finalized groups keep that
+ * distribution, so only one row per group is sent to the coordinator.
+ */
+static void
+add_redistributed_final_agg_paths(PlannerInfo *root, RelOptInfo *grouped_rel,
+					  Path *partial_path, PathTarget *target,
+					  AggClauseCosts *agg_final_costs, double dNumGroups,
+					  bool can_sort, bool can_hash)
+{
+	Query	   *parse = root->parse;
+	Distribution *distribution;
+	Path	   *path;
+
+	/*
+	 * Collecting the finalized groups on the coordinator is not costed, so
+	 * these paths would always look as cheap as finalizing there; only add
+	 * them when asked for.
+	 */
+	if (!enable_grouping_redistribution)
+		return;
+
+	distribution = grouping_redistribution(parse, partial_path);
+	if (distribution == NULL)
+		return;
+
+	path = create_remotesubplan_path(root, partial_path, distribution);
+
+	/* The redistributed rows arrive in no particular order */
+	path->pathkeys = NIL;
+
+	if (can_hash)
+		add_path(grouped_rel, (Path *)
+				 create_agg_path(root,
+								 grouped_rel,
+								 path,
+								 target,
+								 AGG_HASHED,
+								 AGGSPLIT_FINAL_DESERIAL,
+								 parse->groupClause,
+								 (List *) parse->havingQual,
+								 agg_final_costs,
+								 dNumGroups));
+
+	if (can_sort)
+	{
+		path = (Path *) create_sort_path(root,
+										 grouped_rel,
+										 path,
+										 root->group_pathkeys,
+										 -1.0);
+
+		add_path(grouped_rel, (Path *)
+				 create_agg_path(root,
+								 grouped_rel,
+								 path,
+								 target,
+								 AGG_SORTED,
+								 AGGSPLIT_FINAL_DESERIAL,
+								 parse->groupClause,
+								 (List *) parse->havingQual,
+								 agg_final_costs,
+								 dNumGroups));
+	}
+}
+
 /*
  * get_partitioned_child_rels
  *		Returns a list of the RT indexes of the partitioned child relations
@@ -7057,12 +7266,98 @@ can_push_down_grouping(PlannerInfo *root, Query *parse, Path *path)
 	return grouping_distribution_match(root, parse, path, parse->groupClause);
 }
 
+/*
+ * can_push_down_window
+ * 	Check if the window can be evaluated on the remote nodes.
+ *
+ * That is the case when all rows of each window partition are on the same
+ * node, which is guaranteed if the distribution key is one of the PARTITION
+ * BY keys, just like for grouping (see grouping_distribution_match).
+ */
 static bool
-can_push_down_window(PlannerInfo *root, Path *path)
+can_push_down_window(PlannerInfo *root, Path *path, WindowClause *wc,
+					 List *tlist)
 {
-	/*  */
-	if (! path->distribution)
+	Distribution *distribution = path->distribution;
+	ListCell   *lc;
+
+	if (distribution == NULL ||
+		IsLocatorReplicated(distribution->distributionType))
 		return true;
 
+	if (distribution->distributionExpr == NULL)
+		return false;
+
+	foreach(lc, wc->partitionClause)
+	{
+		SortGroupClause *sgc = (SortGroupClause *) lfirst(lc);
+		TargetEntry *te = get_sortgroupclause_tle(sgc, tlist);
+
+		if (equal(te->expr, distribution->distributionExpr))
+			return true;
+	}
+
 	return false;
 }
+
+/*
+ * window_redistribution
+ * 	Build distribution sending rows along one of the PARTITION BY keys.
+ *
+ * Returns NULL if there is no PARTITION BY key the rows can be distributed
+ * by, in which case the window has to be evaluated on the coordinator.
+ */
+static Distribution *
+window_redistribution(Path *path, WindowClause *wc, List *tlist)
+{
+	Distribution *distribution;
+	ListCell   *lc;
+
+	/* Only distributed data may be redistributed */
+	if (path->distribution == NULL ||
+		IsLocatorReplicated(path->distribution->distributionType))
+		return NULL;
+
+	foreach(lc, wc->partitionClause)
+	{
+		SortGroupClause *sgc = (SortGroupClause *) lfirst(lc);
+		TargetEntry *te = get_sortgroupclause_tle(sgc, tlist);
+		Oid			keytype = exprType((Node *) te->expr);
+		char		distType;
+
+		if (IsTypeHashDistributable(keytype))
+			distType = LOCATOR_TYPE_HASH;
+		else if (IsTypeModuloDistributable(keytype))
+			distType = LOCATOR_TYPE_MODULO;
+		else
+			continue;
+
+		distribution = makeNode(Distribution);
+		distribution->distributionType = distType;
+		distribution->nodes = bms_copy(path->distribution->nodes);
+		distribution->restrictNodes = NULL;
+		distribution->distributionExpr = (Node *) te->expr;
+
+		return distribution;
+	}
+
+	return NULL;
+}
+
+/*
+ * is_extern_param_expr
+ *	  Check if the expression is an external parameter, possibly under an
+ *	  implicit cast.
+ */
+static bool
+is_extern_param_expr(Node *node)
+{
+	if (IsA(node, RelabelType))
+		node = (Node *) ((RelabelType *) node)->arg;
+	else if (IsA(node, FuncExpr) &&
+			 ((FuncExpr *) node)->funcformat == COERCE_IMPLICIT_CAST &&
+			 list_length(((FuncExpr *) node)->args) == 1)
+		node = (Node *) linitial(((FuncExpr *) node)->args);
+
+	return IsA(node, Param) && ((Param *) node)->paramkind == PARAM_EXTERN;
+}
@@ -960,6 +960,12 @@ set_plan_refs(PlannerInfo *root, Plan *plan, int rtoffset)
 				{
 					lfirst_int(l) += rtoffset;
 				}
+				splan->part_prune_constraints = (List *)
+					fix_scan_expr(root, (Node *) splan->part_prune_constraints,
+								  rtoffset);
+				splan->part_prune_quals = (List *)
+					fix_scan_expr(root, (Node *) splan->part_prune_quals,
+								  rtoffset);
 				foreach(l, splan->appendplans)
 				{
 					lfirst(l) = set_plan_refs(root,
@@ -982,6 +988,12 @@ set_plan_refs(PlannerInfo *root, Plan *plan, int rtoffset)
 				{
 					lfirst_int(l) += rtoffset;
 				}
+				splan->part_prune_constraints = (List *)
+					fix_scan_expr(root, (Node *) splan->part_prune_constraints,
+								  rtoffset);
+				splan->part_prune_quals = (List *)
+					fix_scan_expr(root, (Node *) splan->part_prune_quals,
+								  rtoffset);
 				foreach(l, splan->mergeplans)
 				{
 					lfirst(l) = set_plan_refs(root,
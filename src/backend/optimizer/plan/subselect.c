@@ -15,6 +15,7 @@
 #include "postgres.h"
 
 #include "access/htup_details.h"
+#include "catalog/pg_aggregate.h"
 #include "catalog/pg_operator.h"
 #include "catalog/pg_type.h"
 #include "executor/executor.h"
@@ -29,6 +30,8 @@
 #include "optimizer/prep.h"
 #include "optimizer/subselect.h"
 #include "optimizer/var.h"
+#include "parser/parse_clause.h"
+#include "parser/parse_oper.h"
 #include "parser/parse_relation.h"
 #include "rewrite/rewriteManip.h"
 #include "utils/builtins.h"
@@ -56,7 +59,18 @@ typedef struct finalize_primnode_context
 	Bitmapset  *paramids;		/* Non-local PARAM_EXEC paramids found */
 } finalize_primnode_context;
 
+typedef struct inline_cte_walker_context
+{
+	const char *ctename;		/* name and relative level of target CTE */
+	int			levelsup;
+	int			refcount;		/* number of remaining references */
+	Query	   *ctequery;		/* query to substitute */
+} inline_cte_walker_context;
+
 
+static void inline_cte(PlannerInfo *root, CommonTableExpr *cte);
+static bool inline_cte_walker(Node *node, inline_cte_walker_context *context);
+static void inline_cte_rtable(List *rtable, inline_cte_walker_context *context);
 static Node *build_subplan(PlannerInfo *root, Plan *plan, PlannerInfo *subroot,
 			  List *plan_params,
 			  SubLinkType subLinkType, int subLinkId,
@@ -75,6 +89,7 @@ static bool subplan_is_hashable(Plan *plan);
 static bool testexpr_is_hashable(Node *testexpr);
 static bool hash_ok_operator(OpExpr *expr);
 static bool simplify_EXISTS_query(PlannerInfo *root, Query *query);
+static bool aggregate_is_null_on_empty(Aggref *aggref);
 static Query *convert_EXISTS_to_ANY(PlannerInfo *root, Query *subselect,
 					  Node **testexpr, List **paramIds);
 static Node *replace_correlation_vars_mutator(Node *node, PlannerInfo *root);
@@ -1194,6 +1209,38 @@ SS_process_ctes(PlannerInfo *root)
 			continue;
 		}
 
+		/*
+		 * Inline a side-effect-free SELECT CTE that is referenced just once
+		 * into the referencing query, as a subquery.  Planning it as an
+		 * initPlan does not save anything then, and in Postgres-XL it means
+		 * gathering the whole CTE result on the coordinator, along with
+		 * everything joined to it.  As a subquery it is planned together
+		 * with the rest of the query, so it can run on the datanodes next to
+		 * the tables it is joined with, and quals can be pushed into it.
+		 *
+		 * A CTE with FOR UPDATE/SHARE is not side-effect-free: it locks all
+		 * the rows it returns, and quals pushed into it would change which
+		 * those are.
+		 *
+		 * Only CTEs of a SELECT are inlined.  The rows an INSERT, UPDATE or
+		 * DELETE reads from a CTE are sent to the nodes of the target table
+		 * anyway, so there is no transfer to save by inlining them.
+		 */
+		if (enable_cte_inline &&
+			root->parse->commandType == CMD_SELECT &&
+			cte->cterefcount == 1 &&
+			!cte->cterecursive &&
+			cmdType == CMD_SELECT &&
+			!((Query *) cte->ctequery)->hasModifyingCTE &&
+			((Query *) cte->ctequery)->rowMarks == NIL &&
+			!contain_volatile_functions(cte->ctequery))
+		{
+			inline_cte(root, cte);
+			/* Make a dummy entry in cte_plan_ids */
+			root->cte_plan_ids = lappend_int(root->cte_plan_ids, -1);
+			continue;
+		}
+
 		/*
 		 * Copy the source Query node.  Probably not necessary, but let's keep
 		 * this similar to make_subplan.
@@ -1311,6 +1358,96 @@ SS_process_ctes(PlannerInfo *root)
 	}
 }
 
+/*
+ * inline_cte: convert RTE_CTE references to given CTE into RTE_SUBQUERYs
+ */
+static void
+inline_cte(PlannerInfo *root, CommonTableExpr *cte)
+{
+	struct inline_cte_walker_context context;
+
+	context.ctename = cte->ctename;
+	/* Start at levelsup = -1 because we'll immediately increment it */
+	context.levelsup = -1;
+	context.refcount = cte->cterefcount;
+	context.ctequery = castNode(Query, cte->ctequery);
+
+	(void) inline_cte_walker((Node *) root->parse, &context);
+
+	/* Assert we replaced all references */
+	Assert(context.refcount == 0);
+}
+
+static bool
+inline_cte_walker(Node *node, inline_cte_walker_context *context)
+{
+	if (node == NULL)
+		return false;
+	if (IsA(node, Query))
+	{
+		Query	   *query = (Query *) node;
+
+		context->levelsup++;
+
+		/*
+		 * Visit the contents of the query's RTEs before replacing the
+		 * references among them, so that we don't descend into the newly
+		 * inlined CTE query.
+		 */
+		(void) query_tree_walker(query, inline_cte_walker, context, 0);
+		inline_cte_rtable(query->rtable, context);
+
+		context->levelsup--;
+
+		return false;
+	}
+
+	return expression_tree_walker(node, inline_cte_walker, context);
+}
+
+static void
+inline_cte_rtable(List *rtable, inline_cte_walker_context *context)
+{
+	ListCell   *lc;
+
+	foreach(lc, rtable)
+	{
+		RangeTblEntry *rte = (RangeTblEntry *) lfirst(lc);
+		Query	   *newquery;
+
+		if (rte->rtekind != RTE_CTE ||
+			strcmp(rte->ctename, context->ctename) != 0 ||
+			rte->ctelevelsup != context->levelsup)
+			continue;
+
+		/*
+		 * Found a reference to replace.  Generate a copy of the CTE query
+		 * with appropriate level adjustment for outer references (e.g., to
+		 * other CTEs).
+		 */
+		newquery = copyObject(context->ctequery);
+
+		if (context->levelsup > 0)
+			IncrementVarSublevelsUp((Node *) newquery, context->levelsup, 1);
+
+		/* Convert the RTE_CTE RTE into a RTE_SUBQUERY */
+		rte->rtekind = RTE_SUBQUERY;
+		rte->subquery = newquery;
+		rte->security_barrier = false;
+
+		/* Zero out CTE-specific fields */
+		rte->ctename = NULL;
+		rte->ctelevelsup = 0;
+		rte->self_reference = false;
+		rte->coltypes = NIL;
+		rte->coltypmods = NIL;
+		rte->colcollations = NIL;
+
+		/* Count the number of replacements we've done */
+		context->refcount--;
+	}
+}
+
 /*
  * convert_ANY_sublink_to_join: try to convert an ANY SubLink to a join
  *
@@ -1598,6 +1735,288 @@ convert_EXISTS_sublink_to_join(PlannerInfo *root, SubLink *sublink,
 	return result;
 }
 
+/*
+ * convert_EXPR_sublink_to_join: try to convert a comparison with a correlated
+ * scalar aggregate subquery to a join
+ *
+ * The case handled is a top-level WHERE clause such as
+ *
+ *		x op (SELECT agg(...) FROM ... WHERE inner_key = outer_key AND ...)
+ *
+ * where the correlation consists only of equalities between the subquery's
+ * own columns and the parent query's.  The sub-select is turned into a
+ * subquery RTE grouped by the inner keys, and the clause becomes an inner
+ * join against it, on the keys and on the original comparison with the
+ * aggregate replaced by the subquery's output column.  Instead of running
+ * the subquery once per outer row, which in Postgres-XL means a round trip
+ * to the datanodes for each of them, the aggregation is done just once and
+ * the join can be executed on the datanodes with redistribution.
+ *
+ * An outer row for which the subquery would find no rows has no partner in
+ * the grouped subquery, and so disappears from the join.  This is only right
+ * if the original clause would have rejected that row too, so we require the
+ * aggregate to return NULL on empty input (which rules out count()), and the
+ * operator to be strict.
+ *
+ * On success, returns a JoinExpr with larg = NULL, which the caller must
+ * fill in as for convert_ANY_sublink_to_join; else NULL.
+ */
+JoinExpr *
+convert_EXPR_sublink_to_join(PlannerInfo *root, OpExpr *opexpr,
+							 Relids available_rels)
+{
+	JoinExpr   *result;
+	Query	   *parse = root->parse;
+	SubLink    *sublink;
+	Query	   *subselect;
+	TargetEntry *aggtle;
+	int			sublink_argno;
+	List	   *inner_quals = NIL;
+	List	   *join_quals = NIL;
+	List	   *keys = NIL;
+	ListCell   *lc;
+	int			rtindex;
+	RangeTblEntry *rte;
+	RangeTblRef *rtr;
+	OpExpr	   *newop;
+	ParseState *pstate;
+
+	/* The plain per-row SubPlan is cheap enough without remote nodes */
+	if (!enable_scalar_sublink_join || !IS_PGXC_COORDINATOR)
+		return NULL;
+
+	/* Exactly one of the operands must be a scalar sub-select */
+	if (list_length(opexpr->args) != 2)
+		return NULL;
+	if (IsA(linitial(opexpr->args), SubLink))
+		sublink_argno = 0;
+	else if (IsA(lsecond(opexpr->args), SubLink))
+		sublink_argno = 1;
+	else
+		return NULL;
+	sublink = (SubLink *) list_nth(opexpr->args, sublink_argno);
+	if (sublink->subLinkType != EXPR_SUBLINK ||
+		IsA(list_nth(opexpr->args, 1 - sublink_argno), SubLink))
+		return NULL;
+
+	if (!op_strict(opexpr->opno) ||
+		contain_volatile_functions(list_nth(opexpr->args, 1 - sublink_argno)))
+		return NULL;
+
+	/*
+	 * The sub-select must be a plain aggregate query, producing exactly one
+	 * row no matter what.
+	 */
+	subselect = (Query *) sublink->subselect;
+	if (subselect->commandType != CMD_SELECT ||
+		!subselect->hasAggs ||
+		subselect->groupClause ||
+		subselect->groupingSets ||
+		subselect->havingQual ||
+		subselect->hasWindowFuncs ||
+		subselect->hasTargetSRFs ||
+		subselect->hasSubLinks ||
+		subselect->hasModifyingCTE ||
+		subselect->distinctClause ||
+		subselect->limitOffset ||
+		subselect->limitCount ||
+		subselect->setOperations ||
+		subselect->cteList ||
+		subselect->rowMarks ||
+		subselect->jointree->fromlist == NIL ||
+		list_length(subselect->targetList) != 1)
+		return NULL;
+
+	aggtle = (TargetEntry *) linitial(subselect->targetList);
+	if (aggtle->resjunk || !IsA(aggtle->expr, Aggref) ||
+		((Aggref *) aggtle->expr)->agglevelsup != 0 ||
+		!aggregate_is_null_on_empty((Aggref *) aggtle->expr))
+		return NULL;
+
+	/*
+	 * Copy the subquery so we can modify it safely (see comments in
+	 * make_subplan).
+	 */
+	subselect = copyObject(subselect);
+	aggtle = (TargetEntry *) linitial(subselect->targetList);
+
+	/*
+	 * Split the WHERE clause into the correlation equalities and the rest.
+	 * Each equality must compare an expression of the sub-select's own
+	 * columns with an expression of the parent query's columns, using the
+	 * default equality operator of their common type, so that grouping by
+	 * the inner expression yields at most one group per outer row.
+	 */
+	foreach(lc, make_ands_implicit((Expr *) subselect->jointree->quals))
+	{
+		Node	   *qual = (Node *) lfirst(lc);
+		OpExpr	   *eqop = (OpExpr *) qual;
+		Node	   *inner;
+		Node	   *outer;
+		int			inner_argno;
+		Oid			keytype;
+		Oid			sortop;
+		Oid			default_eqop;
+		bool		hashable;
+		TargetEntry *keytle;
+		SortGroupClause *grpcl;
+
+		if (!contain_vars_of_level(qual, 1))
+		{
+			inner_quals = lappend(inner_quals, qual);
+			continue;
+		}
+
+		if (!IsA(qual, OpExpr) || list_length(eqop->args) != 2 ||
+			contain_volatile_functions(qual))
+			return NULL;
+
+		inner = (Node *) linitial(eqop->args);
+		outer = (Node *) lsecond(eqop->args);
+		inner_argno = 0;
+		if (contain_vars_of_level(inner, 1))
+		{
+			inner = (Node *) lsecond(eqop->args);
+			outer = (Node *) linitial(eqop->args);
+			inner_argno = 1;
+		}
+		if (contain_vars_of_level(inner, 1) ||
+			!contain_vars_of_level(inner, 0) ||
+			contain_vars_of_level(outer, 0) ||
+			contain_aggs_of_level(outer, 0))
+			return NULL;
+
+		keytype = exprType(inner);
+		if (exprType(outer) != keytype)
+			return NULL;
+		get_sort_group_operators(keytype, false, false, false,
+								 &sortop, &default_eqop, NULL, &hashable);
+		if (eqop->opno != default_eqop ||
+			(!OidIsValid(sortop) && !hashable))
+			return NULL;
+
+		/* Group the sub-select by the inner expression, and output it */
+		keytle = makeTargetEntry((Expr *) copyObject(inner),
+								 list_length(subselect->targetList) + 1,
+								 pstrdup("?column?"),
+								 false);
+		subselect->targetList = lappend(subselect->targetList, keytle);
+
+		grpcl = makeNode(SortGroupClause);
+		grpcl->tleSortGroupRef = assignSortGroupRef(keytle,
+													subselect->targetList);
+		grpcl->eqop = default_eqop;
+		grpcl->sortop = sortop;
+		grpcl->nulls_first = false;
+		grpcl->hashable = hashable;
+		subselect->groupClause = lappend(subselect->groupClause, grpcl);
+
+		keys = lappend(keys, list_make3(eqop, makeInteger(inner_argno), keytle));
+	}
+
+	/* No correlation, no join */
+	if (keys == NIL)
+		return NULL;
+
+	subselect->jointree->quals = inner_quals ?
+		(Node *) make_ands_explicit(inner_quals) : NULL;
+
+	/*
+	 * Nothing else of the sub-select may refer to the parent query.  (Vars of
+	 * higher levels should be okay, though.)
+	 */
+	if (contain_vars_of_level((Node *) subselect, 1))
+		return NULL;
+
+	/* Create a dummy ParseState for addRangeTableEntryForSubquery */
+	pstate = make_parsestate(NULL);
+
+	/*
+	 * Okay, pull up the sub-select into upper range table.  As in
+	 * convert_ANY_sublink_to_join, the outer query can't have references to
+	 * it other than the Vars we build below.
+	 */
+	rte = addRangeTableEntryForSubquery(pstate,
+										subselect,
+										makeAlias("EXPR_subquery", NIL),
+										false,
+										false);
+	parse->rtable = lappend(parse->rtable, rte);
+	rtindex = list_length(parse->rtable);
+
+	rtr = makeNode(RangeTblRef);
+	rtr->rtindex = rtindex;
+
+	/* The original comparison, against the aggregate's output column */
+	newop = (OpExpr *) copyObject(opexpr);
+	list_nth_cell(newop->args, sublink_argno)->data.ptr_value =
+		makeVarFromTargetEntry(rtindex, aggtle);
+	join_quals = lappend(join_quals, newop);
+
+	/* And the correlation equalities, against the grouping columns */
+	foreach(lc, keys)
+	{
+		List	   *key = (List *) lfirst(lc);
+		OpExpr	   *eqop = (OpExpr *) copyObject(linitial(key));
+		int			inner_argno = intVal(lsecond(key));
+		TargetEntry *keytle = (TargetEntry *) lthird(key);
+		Node	   *outer;
+
+		outer = (Node *) list_nth(eqop->args, 1 - inner_argno);
+		IncrementVarSublevelsUp(outer, -1, 1);
+		list_nth_cell(eqop->args, inner_argno)->data.ptr_value =
+			makeVarFromTargetEntry(rtindex, keytle);
+		join_quals = lappend(join_quals, eqop);
+	}
+
+	/* The parent query's side may only reference available_rels */
+	if (!bms_is_subset(pull_varnos((Node *) join_quals), available_rels))
+		return NULL;
+
+	/*
+	 * And finally, build the JoinExpr node.
+	 */
+	result = makeNode(JoinExpr);
+	result->jointype = JOIN_INNER;
+	result->isNatural = false;
+	result->larg = NULL;		/* caller must fill this in */
+	result->rarg = (Node *) rtr;
+	result->usingClause = NIL;
+	result->quals = (Node *) make_ands_explicit(join_quals);
+	result->alias = NULL;
+	result->rtindex = 0;		/* we don't need an RTE for it */
+
+	return result;
+}
+
+/*
+ * aggregate_is_null_on_empty: does the aggregate return NULL for no rows?
+ *
+ * That's the case when the transition state starts out NULL, and there is
+ * either no final function or a strict one.
+ */
+static bool
+aggregate_is_null_on_empty(Aggref *aggref)
+{
+	HeapTuple	aggTuple;
+	Form_pg_aggregate aggform;
+	bool		result;
+
+	aggTuple = SearchSysCache1(AGGFNOID, ObjectIdGetDatum(aggref->aggfnoid));
+	if (!HeapTupleIsValid(aggTuple))
+		elog(ERROR, "cache lookup failed for aggregate %u", aggref->aggfnoid);
+	aggform = (Form_pg_aggregate) GETSTRUCT(aggTuple);
+
+	(void) SysCacheGetAttr(AGGFNOID, aggTuple, Anum_pg_aggregate_agginitval,
+						   &result);
+	if (result && OidIsValid(aggform->aggfinalfn))
+		result = func_strict(aggform->aggfinalfn);
+
+	ReleaseSysCache(aggTuple);
+
+	return result;
+}
+
 /*
  * simplify_EXISTS_query: remove any useless stuff in an EXISTS's subquery
  *
@@ -2625,6 +3044,8 @@ finalize_plan(PlannerInfo *root, Plan *plan, Bitmapset *valid_params,
 			{
 				ListCell   *l;
 
+				finalize_primnode((Node *) ((Append *) plan)->part_prune_quals,
+								  &context);
 				foreach(l, ((Append *) plan)->appendplans)
 				{
 					context.paramids =
@@ -2641,6 +3062,8 @@ finalize_plan(PlannerInfo *root, Plan *plan, Bitmapset *valid_params,
 			{
 				ListCell   *l;
 
+				finalize_primnode((Node *) ((MergeAppend *) plan)->part_prune_quals,
+								  &context);
 				foreach(l, ((MergeAppend *) plan)->mergeplans)
 				{
 					context.paramids =
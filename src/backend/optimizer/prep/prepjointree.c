@@ -522,6 +522,42 @@ pull_up_sublinks_qual_recurse(PlannerInfo *root, Node *node,
 		/* Else return it unmodified */
 		return node;
 	}
+	if (IsA(node, OpExpr))
+	{
+		/* Is it a comparison with a convertible scalar sub-select? */
+		JoinExpr   *j;
+		Relids		child_rels;
+
+		if ((j = convert_EXPR_sublink_to_join(root, (OpExpr *) node,
+											  available_rels1)) != NULL)
+		{
+			/* Yes; insert the new join node into the join tree */
+			j->larg = *jtlink1;
+			*jtlink1 = (Node *) j;
+			/* Recursively process pulled-up jointree nodes */
+			j->rarg = pull_up_sublinks_jointree_recurse(root,
+														j->rarg,
+														&child_rels);
+			/* Return NULL representing constant TRUE */
+			return NULL;
+		}
+		if (available_rels2 != NULL &&
+			(j = convert_EXPR_sublink_to_join(root, (OpExpr *) node,
+											  available_rels2)) != NULL)
+		{
+			/* Yes; insert the new join node into the join tree */
+			j->larg = *jtlink2;
+			*jtlink2 = (Node *) j;
+			/* Recursively process pulled-up jointree nodes */
+			j->rarg = pull_up_sublinks_jointree_recurse(root,
+														j->rarg,
+														&child_rels);
+			/* Return NULL representing constant TRUE */
+			return NULL;
+		}
+		/* Else return it unmodified */
+		return node;
+	}
 	if (and_clause(node))
 	{
 		/* Recurse into AND clause */
@@ -31,10 +31,12 @@
 #include "utils/selfuncs.h"
 #ifdef XCP
 #include "access/heapam.h"
+#include "catalog/pg_statistic.h"
 #include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
 #include "pgxc/locator.h"
 #include "pgxc/nodemgr.h"
+#include "utils/datum.h"
 #include "utils/rel.h"
 #endif
 
@@ -61,6 +63,12 @@ static void restrict_distribution(PlannerInfo *root, RestrictInfo *ri,
 static Path *redistribute_path(PlannerInfo *root, Path *subpath, List *pathkeys,
 				  char distributionType, Node* distributionExpr,
 				  Bitmapset *nodes, Bitmapset *restrictNodes);
+static Path *broadcast_path(PlannerInfo *root, Path *subpath, List *pathkeys,
+			   Distribution *target);
+static JoinPath *flatCopyJoinPath(JoinPath *pathnode);
+static List *get_skewed_values(PlannerInfo *root, Node *expr, int numnodes);
+static void set_path_skew(Path *path, List *skewValues, Oid eqfunc,
+			  Oid collation, bool broadcast);
 static void set_scanpath_distribution(PlannerInfo *root, RelOptInfo *rel, Path *pathnode);
 static List *set_joinpath_distribution(PlannerInfo *root, JoinPath *pathnode);
 extern void PoolPingNodes(void);
@@ -1060,6 +1068,16 @@ restrict_distribution(PlannerInfo *root, RestrictInfo *ri,
 				other = (Expr *) eval_const_expressions(root, (Node *) other);
 				if (IsA(other, Const))
 					constExpr = (Const *) other;
+				/*
+				 * The value of an external parameter is not known until the
+				 * generic plan is executed, then the executor restricts the
+				 * nodes itself.
+				 */
+				else if (IsA(other, Param) &&
+						 ((Param *) other)->paramkind == PARAM_EXTERN &&
+						 ((Param *) other)->paramtype == keytype &&
+						 distribution->restrictExpr == NULL)
+					distribution->restrictExpr = (Node *) other;
 			}
 		}
 	}
@@ -1241,7 +1259,8 @@ create_remotesubplan_path(PlannerInfo *root, Path *subpath,
 	cost_remote_subplan((Path *) pathnode, subpath->startup_cost,
 						subpath->total_cost, subpath->rows, rel->reltarget->width,
 						(subdistribution && IsLocatorReplicated(subdistribution->distributionType)) ?
-						bms_num_members(subdistribution->nodes) : 1);
+						bms_num_members(subdistribution->nodes) : 1,
+						subdistribution);
 
 	return (Path *) pathnode;
 }
@@ -1308,7 +1327,8 @@ redistribute_path(PlannerInfo *root, Path *subpath, List *pathkeys,
 		cost_remote_subplan((Path *) pathnode, subpath->startup_cost,
 							subpath->total_cost, subpath->rows, rel->reltarget->width,
 							IsLocatorReplicated(distributionType) ?
-									bms_num_members(nodes) : 1);
+									bms_num_members(nodes) : 1,
+							subpath->distribution);
 		mpath->subpath = (Path *) pathnode;
 		cost_material(&mpath->path,
 					  pathnode->path.startup_cost,
@@ -1373,12 +1393,150 @@ redistribute_path(PlannerInfo *root, Path *subpath, List *pathkeys,
 							input_startup_cost, input_total_cost,
 							subpath->rows, rel->reltarget->width,
 							IsLocatorReplicated(distributionType) ?
-									bms_num_members(nodes) : 1);
+									bms_num_members(nodes) : 1,
+							subpath->distribution);
 		return (Path *) pathnode;
 	}
 }
 
 
+/*
+ * broadcast_path
+ * 	Replicates the path on the fly to all nodes of the target distribution.
+ *
+ * The path is used by an alternate join path, while the original join path
+ * still references it and may be redistributed afterwards. Since
+ * redistribute_path() modifies a MaterialPath and a RemoteSubPath under it
+ * in place, work on copies of them.
+ */
+static Path *
+broadcast_path(PlannerInfo *root, Path *subpath, List *pathkeys,
+			   Distribution *target)
+{
+	if (IsA(subpath, MaterialPath))
+	{
+		MaterialPath *mpath = makeNode(MaterialPath);
+
+		memcpy(mpath, subpath, sizeof(MaterialPath));
+		if (IsA(mpath->subpath, RemoteSubPath))
+		{
+			RemoteSubPath *rpath = makeNode(RemoteSubPath);
+
+			memcpy(rpath, mpath->subpath, sizeof(RemoteSubPath));
+			mpath->subpath = (Path *) rpath;
+		}
+		subpath = (Path *) mpath;
+	}
+
+	return redistribute_path(root, subpath, pathkeys,
+							 LOCATOR_TYPE_REPLICATED, NULL,
+							 bms_copy(target->nodes),
+							 bms_copy(target->restrictNodes));
+}
+
+
+/*
+ * get_skewed_values
+ * 	Returns values of the expression too frequent to be hashed to one node.
+ *
+ * A value is hot if its frequency, according to the most common values
+ * statistics, is above the share of one node. Returns a list of Consts.
+ */
+static List *
+get_skewed_values(PlannerInfo *root, Node *expr, int numnodes)
+{
+	VariableStatData vardata;
+	AttStatsSlot sslot;
+	List	   *result = NIL;
+
+	if (numnodes < 2)
+		return NIL;
+
+	examine_variable(root, expr, 0, &vardata);
+	if (HeapTupleIsValid(vardata.statsTuple) &&
+		get_attstatsslot(&sslot, vardata.statsTuple,
+						 STATISTIC_KIND_MCV, InvalidOid,
+						 ATTSTATSSLOT_VALUES | ATTSTATSSLOT_NUMBERS))
+	{
+		int16		typlen;
+		bool		typbyval;
+		int			i;
+
+		get_typlenbyval(vardata.atttype, &typlen, &typbyval);
+		for (i = 0; i < sslot.nvalues && i < sslot.nnumbers; i++)
+		{
+			if (sslot.numbers[i] * numnodes <= 1.0)
+				continue;
+
+			result = lappend(result,
+							 makeConst(vardata.atttype,
+									   vardata.atttypmod,
+									   exprCollation(expr),
+									   typlen,
+									   datumCopy(sslot.values[i],
+												 typbyval, typlen),
+									   false,
+									   typbyval));
+		}
+		free_attstatsslot(&sslot);
+	}
+	ReleaseVariableStats(vardata);
+
+	return result;
+}
+
+
+/*
+ * set_path_skew
+ * 	Sets hot values on the distribution of a redistributed path.
+ */
+static void
+set_path_skew(Path *path, List *skewValues, Oid eqfunc, Oid collation,
+			  bool broadcast)
+{
+	Distribution *distribution = path->distribution;
+
+	distribution->skewValues = skewValues;
+	distribution->skewEqfunc = eqfunc;
+	distribution->skewCollation = collation;
+	distribution->skewBroadcast = broadcast;
+
+	/* redistribute_path() places RemoteSubPath under a MaterialPath */
+	if (IsA(path, MaterialPath))
+		set_path_skew(((MaterialPath *) path)->subpath, skewValues, eqfunc,
+					  collation, broadcast);
+}
+
+
+/*
+ * flatCopyJoinPath
+ * 	Makes a shallow copy of the join path, to build an alternate of it.
+ */
+static JoinPath *
+flatCopyJoinPath(JoinPath *pathnode)
+{
+	JoinPath   *newnode;
+	Size		size;
+
+	switch (nodeTag(pathnode))
+	{
+		case T_MergePath:
+			size = sizeof(MergePath);
+			break;
+		case T_HashPath:
+			size = sizeof(HashPath);
+			break;
+		default:
+			size = sizeof(NestPath);
+			break;
+	}
+
+	newnode = (JoinPath *) palloc(size);
+	memcpy(newnode, pathnode, size);
+	return newnode;
+}
+
+
 /*
  * Analyze join parameters and set distribution of the join node.
  * If there are possible alternate distributions the respective pathes are
@@ -1507,13 +1665,16 @@ set_joinpath_distribution(PlannerInfo *root, JoinPath *pathnode)
 			innerd->distributionType == outerd->distributionType &&
 			innerd->distributionExpr &&
 			outerd->distributionExpr &&
-			bms_equal(innerd->nodes, outerd->nodes))
+			bms_equal(innerd->nodes, outerd->nodes) &&
+			IsDistColumnTypeColocated(innerd->distributionType,
+									  exprType(innerd->distributionExpr),
+									  exprType(outerd->distributionExpr)))
 	{
 		ListCell   *lc;
 
 		/*
-		 * Make sure distribution functions are the same, for now they depend
-		 * on data type
+		 * Distribution functions depend on data type, the check above made
+		 * sure they place equal keys of both sides on the same node.
 		 */
 
 		/*
@@ -1665,67 +1826,70 @@ not_allowed_join:
 	 * one of the subplan is replicated. If replication of any or all subplans
 	 * is possible, return resulting plans as alternates. Try to distribute all
 	 * by has as main variant.
+	 *
+	 * Broadcasting a subplan sends it to every node of the other one, while
+	 * the other one stays in place, so it pays off when that subplan is much
+	 * smaller, e.g. a filtered dimension table joined to a fact table.
+	 * cost_remote_subplan() charges the network cost once per target node.
 	 */
-
-#ifdef NOT_USED	
-	/* These join types allow replicated inner */
-	if (outerd &&
-			(pathnode->jointype == JOIN_INNER ||
-			 pathnode->jointype == JOIN_LEFT ||
-			 pathnode->jointype == JOIN_SEMI ||
-			 pathnode->jointype == JOIN_ANTI))
+	if (enable_broadcast_join && innerd && outerd)
 	{
-		/*
-		 * Since we discard all alternate pathes except one it is OK if all they
-		 * reference the same objects
-		 */
-		JoinPath *altpath = flatCopyJoinPath(pathnode);
-		/* Redistribute inner subquery */
-		altpath->innerjoinpath = redistribute_path(
-				root,
-				altpath->innerjoinpath,
-				innerpathkeys,
-				LOCATOR_TYPE_REPLICATED,
-				NULL,
-				bms_copy(outerd->nodes),
-				bms_copy(outerd->restrictNodes));
-		targetd = makeNode(Distribution);
-		targetd->distributionType = outerd->distributionType;
-		targetd->nodes = bms_copy(outerd->nodes);
-		targetd->restrictNodes = bms_copy(outerd->restrictNodes);
-		targetd->distributionExpr = outerd->distributionExpr;
-		altpath->path.distribution = targetd;
-		alternate = lappend(alternate, altpath);
-	}
+		/* These join types allow replicated inner */
+		if (pathnode->jointype == JOIN_INNER ||
+				pathnode->jointype == JOIN_LEFT ||
+				pathnode->jointype == JOIN_SEMI ||
+				pathnode->jointype == JOIN_ANTI)
+		{
+			/*
+			 * Since we discard all alternate pathes except one it is OK if
+			 * all they reference the same objects
+			 */
+			JoinPath *altpath = flatCopyJoinPath(pathnode);
 
-	/* These join types allow replicated outer */
-	if (innerd &&
-			(pathnode->jointype == JOIN_INNER ||
-			 pathnode->jointype == JOIN_RIGHT))
-	{
-		/*
-		 * Since we discard all alternate pathes except one it is OK if all they
-		 * reference the same objects
-		 */
-		JoinPath *altpath = flatCopyJoinPath(pathnode);
-		/* Redistribute inner subquery */
-		altpath->outerjoinpath = redistribute_path(
-				root,
-				altpath->outerjoinpath,
-				outerpathkeys,
-				LOCATOR_TYPE_REPLICATED,
-				NULL,
-				bms_copy(innerd->nodes),
-				bms_copy(innerd->restrictNodes));
-		targetd = makeNode(Distribution);
-		targetd->distributionType = innerd->distributionType;
-		targetd->nodes = bms_copy(innerd->nodes);
-		targetd->restrictNodes = bms_copy(innerd->restrictNodes);
-		targetd->distributionExpr = innerd->distributionExpr;
-		altpath->path.distribution = targetd;
-		alternate = lappend(alternate, altpath);
+			/* Broadcast inner subquery */
+			altpath->innerjoinpath = broadcast_path(root,
+													altpath->innerjoinpath,
+													innerpathkeys,
+													outerd);
+			if (IsA(altpath, MergePath))
+				((MergePath *) altpath)->innersortkeys = NIL;
+
+			targetd = makeNode(Distribution);
+			targetd->distributionType = outerd->distributionType;
+			targetd->nodes = bms_copy(outerd->nodes);
+			targetd->restrictNodes = bms_copy(outerd->restrictNodes);
+			targetd->distributionExpr = outerd->distributionExpr;
+			altpath->path.distribution = targetd;
+			alternate = lappend(alternate, altpath);
+		}
+
+		/* These join types allow replicated outer */
+		if (pathnode->jointype == JOIN_INNER ||
+				pathnode->jointype == JOIN_RIGHT)
+		{
+			/*
+			 * Since we discard all alternate pathes except one it is OK if
+			 * all they reference the same objects
+			 */
+			JoinPath *altpath = flatCopyJoinPath(pathnode);
+
+			/* Broadcast outer subquery */
+			altpath->outerjoinpath = broadcast_path(root,
+													altpath->outerjoinpath,
+													outerpathkeys,
+													innerd);
+			if (IsA(altpath, MergePath))
+				((MergePath *) altpath)->outersortkeys = NIL;
+
+			targetd = makeNode(Distribution);
+			targetd->distributionType = innerd->distributionType;
+			targetd->nodes = bms_copy(innerd->nodes);
+			targetd->restrictNodes = bms_copy(innerd->restrictNodes);
+			targetd->distributionExpr = innerd->distributionExpr;
+			altpath->path.distribution = targetd;
+			alternate = lappend(alternate, altpath);
+		}
 	}
-#endif
 
 	/*
 	 * Redistribute subplans to make them compatible.
@@ -1738,6 +1902,7 @@ not_allowed_join:
 		Expr		   *new_inner_key = NULL;
 		Expr		   *new_outer_key = NULL;
 		char			distType = LOCATOR_TYPE_NONE;
+		List		   *skewValues = NIL;
 		ListCell 	   *lc;
 
 		/*
@@ -1992,6 +2157,35 @@ not_allowed_join:
 				if (IsA(pathnode, MergePath))
 					((MergePath*)pathnode)->outersortkeys = NIL;
 			}
+
+			/*
+			 * If both parts are redistributed and the outer key has hot
+			 * values, spread outer rows holding them over the nodes, and
+			 * send inner rows holding them to all nodes, so they do not all
+			 * end up on one node. Every outer row still meets all its inner
+			 * matches exactly once, which is not true for inner rows, so
+			 * this is not possible if the inner part is preserved.
+			 */
+			if (new_inner_key && new_outer_key &&
+					(pathnode->jointype == JOIN_INNER ||
+					 pathnode->jointype == JOIN_LEFT ||
+					 pathnode->jointype == JOIN_SEMI ||
+					 pathnode->jointype == JOIN_ANTI))
+			{
+				skewValues = get_skewed_values(root, (Node *) new_outer_key,
+											   bms_num_members(nodes));
+				if (skewValues)
+				{
+					OpExpr	   *opexpr = (OpExpr *) preferred->clause;
+					Oid			eqfunc = get_opcode(opexpr->opno);
+
+					set_path_skew(pathnode->outerjoinpath, skewValues, eqfunc,
+								  opexpr->inputcollid, false);
+					set_path_skew(pathnode->innerjoinpath, skewValues, eqfunc,
+								  opexpr->inputcollid, true);
+				}
+			}
+
 			targetd = makeNode(Distribution);
 			targetd->distributionType = distType;
 			targetd->nodes = nodes;
@@ -2022,6 +2216,9 @@ not_allowed_join:
 			else if (pathnode->jointype == JOIN_RIGHT)
 				targetd->distributionExpr =
 						pathnode->innerjoinpath->distribution->distributionExpr;
+			else if (skewValues)
+				/* rows with hot values may be on any node */
+				targetd->distributionExpr = NULL;
 			else
 				targetd->distributionExpr =
 						pathnode->outerjoinpath->distribution->distributionExpr;
@@ -4008,6 +4205,7 @@ create_sort_path(PlannerInfo *root,
 	pathnode->path.distribution = copyObject(subpath->distribution);
 
 	pathnode->subpath = subpath;
+	pathnode->numPresortedCols = 0;
 
 	cost_sort(&pathnode->path, root, pathkeys,
 			  subpath->total_cost,
@@ -4019,6 +4217,54 @@ create_sort_path(PlannerInfo *root,
 	return pathnode;
 }
 
+/*
+ * create_incremental_sort_path
+ *	  Creates a pathnode that represents sorting a path that is already
+ *	  sorted by some leading keys of the desired order.
+ *
+ * 'presorted_keys' is the number of leading 'pathkeys' that subpath is
+ * already sorted by; it must be more than zero and less than all of them.
+ * The other arguments are as for create_sort_path.
+ */
+SortPath *
+create_incremental_sort_path(PlannerInfo *root,
+							 RelOptInfo *rel,
+							 Path *subpath,
+							 List *pathkeys,
+							 int presorted_keys,
+							 double limit_tuples)
+{
+	SortPath   *pathnode = makeNode(SortPath);
+
+	pathnode->path.pathtype = T_Sort;
+	pathnode->path.parent = rel;
+	/* Sort doesn't project, so use source path's pathtarget */
+	pathnode->path.pathtarget = subpath->pathtarget;
+	/* For now, assume we are above any joins, so no parameterization */
+	pathnode->path.param_info = NULL;
+	pathnode->path.parallel_aware = false;
+	pathnode->path.parallel_safe = rel->consider_parallel &&
+		subpath->parallel_safe;
+	pathnode->path.parallel_workers = subpath->parallel_workers;
+	pathnode->path.pathkeys = pathkeys;
+
+	/* distribution is the same as in the subpath */
+	pathnode->path.distribution = copyObject(subpath->distribution);
+
+	pathnode->subpath = subpath;
+	pathnode->numPresortedCols = presorted_keys;
+
+	cost_incremental_sort(&pathnode->path, root, pathkeys, presorted_keys,
+						  subpath->startup_cost,
+						  subpath->total_cost,
+						  subpath->rows,
+						  subpath->pathtarget->width,
+						  0.0,
+						  work_mem, limit_tuples);
+
+	return pathnode;
+}
+
 /*
  * create_group_path
  *	  Creates a pathnode that represents performing grouping of presorted input
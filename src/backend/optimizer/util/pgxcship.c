@@ -107,7 +107,7 @@ extern void PoolPingNodes(void);
 static bool pgxc_is_func_shippable(Oid funcid);
 /* Check equijoin conditions on given relations */
 static Expr *pgxc_find_dist_equijoin_qual(Relids varnos_1, Relids varnos_2,
-								Oid distcol_type, Node *quals, List *rtable);
+								char locatortype, Node *quals, List *rtable);
 /* Merge given execution nodes based on join shippability conditions */
 static ExecNodes *pgxc_merge_exec_nodes(ExecNodes *en1, ExecNodes *en2);
 /* Check if given Query includes distribution column */
@@ -120,6 +120,7 @@ static void pgxc_set_shippability_reason(Shippability_context *context,
 										 ShippabilityStat reason);
 static void pgxc_reset_shippability_reason(Shippability_context *context,
 										   ShippabilityStat reason);
+static bool pgxc_shippability_is_shape_only(Shippability_context *context);
 
 /* Evaluation of shippability */
 static bool pgxc_shippability_walker(Node *node, Shippability_context *sc_context);
@@ -1304,6 +1305,26 @@ pgxc_query_contains_only_pg_catalog(List *rtable)
 }
 
 
+/*
+ * pgxc_shippability_is_shape_only
+ * Check whether the walker found a reason which makes the query unshippable
+ * irrespective of the constants and parameter values appearing in it. Such
+ * reasons depend only upon the query tree and the catalogs (functions, types,
+ * relations), unlike SS_NO_NODES, SS_NEED_SINGLENODE or SS_VARLEVEL which may
+ * change with the nodes chosen for a particular set of constants.
+ */
+static bool
+pgxc_shippability_is_shape_only(Shippability_context *context)
+{
+	return pgxc_test_shippability_reason(context, SS_UNSHIPPABLE_EXPR) ||
+		pgxc_test_shippability_reason(context, SS_UNSUPPORTED_EXPR) ||
+		pgxc_test_shippability_reason(context, SS_UNSHIPPABLE_TYPE) ||
+		pgxc_test_shippability_reason(context, SS_UNSHIPPABLE_TRIGGER) ||
+		pgxc_test_shippability_reason(context, SS_NEEDS_COORD) ||
+		pgxc_test_shippability_reason(context, SS_UPDATES_DISTRIBUTION_COLUMN);
+}
+
+
 /*
  * pgxc_is_query_shippable
  * This function calls the query walker to analyse the query to gather
@@ -1316,6 +1337,20 @@ pgxc_query_contains_only_pg_catalog(List *rtable)
  */
 ExecNodes *
 pgxc_is_query_shippable(Query *query, int query_level)
+{
+	return pgxc_query_shippability(query, query_level, NULL);
+}
+
+
+/*
+ * pgxc_query_shippability
+ * Same as pgxc_is_query_shippable(), but when shape_unshippable is not NULL it
+ * is set to true if the query is unshippable for reasons which do not depend
+ * on the constants in the query, so that the caller may remember the decision
+ * for other queries of the same shape.
+ */
+ExecNodes *
+pgxc_query_shippability(Query *query, int query_level, bool *shape_unshippable)
 {
 	Shippability_context sc_context;
 	ExecNodes	*exec_nodes;
@@ -1335,6 +1370,9 @@ pgxc_is_query_shippable(Query *query, int query_level)
 	 */
 	pgxc_shippability_walker((Node *)query, &sc_context);
 
+	if (shape_unshippable)
+		*shape_unshippable = pgxc_shippability_is_shape_only(&sc_context);
+
 	exec_nodes = sc_context.sc_exec_nodes;
 	/*
 	 * The shippability context contains two ExecNodes, one for the subLinks
@@ -1488,7 +1526,7 @@ pgxc_is_func_shippable(Oid funcid)
  */
 static Expr *
 pgxc_find_dist_equijoin_qual(Relids varnos_1,
-		Relids varnos_2, Oid distcol_type, Node *quals, List *rtable)
+		Relids varnos_2, char locatortype, Node *quals, List *rtable)
 {
 	List		*lquals;
 	ListCell	*qcell;
@@ -1533,12 +1571,14 @@ pgxc_find_dist_equijoin_qual(Relids varnos_1,
 			continue;
 
 		/*
-		 * If the data types of both the columns are not same, continue. Hash
-		 * and Modulo of a the same bytes will be same if the data types are
-		 * same. So, only when the data types of the columns are same, we can
+		 * If equal values of the columns are not distributed to the same
+		 * node, continue. Hash and Modulo of a the same bytes will be same if
+		 * the data types are same, and a few types share the hash function.
+		 * So, only when the data types of the columns are colocated, we can
 		 * ship a distributed JOIN to the Datanodes
 		 */
-		if (exprType((Node *)lvar) != exprType((Node *)rvar))
+		if (!IsDistColumnTypeColocated(locatortype, exprType((Node *)lvar),
+									   exprType((Node *)rvar)))
 			continue;
 
 		/* if the vars do not correspond to the required varnos, continue. */
@@ -1774,7 +1814,8 @@ pgxc_is_join_shippable(ExecNodes *inner_en, ExecNodes *outer_en, Relids in_relid
 			IsExecNodesDistributedByValue(inner_en))
 		{
 			Expr *equi_join_expr = pgxc_find_dist_equijoin_qual(in_relids,
-													out_relids, InvalidOid,
+													out_relids,
+													inner_en->baselocatortype,
 													(Node *)join_quals, rtables);
 			if (equi_join_expr && pgxc_is_expr_shippable(equi_join_expr, NULL))
 				merge_nodes = true;
@@ -1371,7 +1371,6 @@ relation_excluded_by_constraints(PlannerInfo *root,
 								 RelOptInfo *rel, RangeTblEntry *rte)
 {
 	List	   *safe_restrictions;
-	List	   *constraint_pred;
 	List	   *safe_constraints;
 	ListCell   *lc;
 
@@ -1431,6 +1430,41 @@ relation_excluded_by_constraints(PlannerInfo *root,
 	if (rte->rtekind != RTE_RELATION || rte->inh)
 		return false;
 
+	safe_constraints = get_relation_exclusion_constraints(root, rel, rte);
+
+	/*
+	 * The constraints are effectively ANDed together, so we can just try to
+	 * refute the entire collection at once.  This may allow us to make proofs
+	 * that would fail if we took them individually.
+	 *
+	 * Note: we use rel->baserestrictinfo, not safe_restrictions as might seem
+	 * an obvious optimization.  Some of the clauses might be OR clauses that
+	 * have volatile and nonvolatile subclauses, and it's OK to make
+	 * deductions with the nonvolatile parts.
+	 */
+	if (predicate_refuted_by(safe_constraints, rel->baserestrictinfo, false))
+		return true;
+
+	return false;
+}
+
+/*
+ * get_relation_exclusion_constraints
+ *
+ * Returns the constraints of a plain relation which restrictions can be
+ * checked against to prove that the relation need not be scanned: its
+ * validated CHECK constraints, its partition constraint and "col IS NOT
+ * NULL" for its attnotnull columns.  The execution-time pruning of Append
+ * children uses this as well.
+ */
+List *
+get_relation_exclusion_constraints(PlannerInfo *root, RelOptInfo *rel,
+								   RangeTblEntry *rte)
+{
+	List	   *constraint_pred;
+	List	   *safe_constraints;
+	ListCell   *lc;
+
 	/*
 	 * OK to fetch the constraint expressions.  Include "col IS NOT NULL"
 	 * expressions for attnotnull columns, in case we can refute those.
@@ -1453,20 +1487,7 @@ relation_excluded_by_constraints(PlannerInfo *root,
 			safe_constraints = lappend(safe_constraints, pred);
 	}
 
-	/*
-	 * The constraints are effectively ANDed together, so we can just try to
-	 * refute the entire collection at once.  This may allow us to make proofs
-	 * that would fail if we took them individually.
-	 *
-	 * Note: we use rel->baserestrictinfo, not safe_restrictions as might seem
-	 * an obvious optimization.  Some of the clauses might be OR clauses that
-	 * have volatile and nonvolatile subclauses, and it's OK to make
-	 * deductions with the nonvolatile parts.
-	 */
-	if (predicate_refuted_by(safe_constraints, rel->baserestrictinfo, false))
-		return true;
-
-	return false;
+	return safe_constraints;
 }
 
 
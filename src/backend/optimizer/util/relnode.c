@@ -23,6 +23,7 @@
 #include "optimizer/paths.h"
 #include "optimizer/placeholder.h"
 #include "optimizer/plancat.h"
+#include "optimizer/prep.h"
 #include "optimizer/restrictinfo.h"
 #include "optimizer/tlist.h"
 #include "utils/hsearch.h"
@@ -620,6 +621,96 @@ build_join_rel(PlannerInfo *root,
 	return joinrel;
 }
 
+/*
+ * build_child_join_rel
+ *	  Builds the relation entry of a join between two partitions, joined as
+ *	  part of the join of their partitioned parents.
+ *
+ * 'outer_rel' and 'inner_rel' are the partitions and 'appinfo1' and
+ * 'appinfo2' translate their parents' Vars to theirs.  'parent_joinrel' is
+ * the join of the parents, 'restrictlist' its restrictlist already
+ * translated to the partitions.
+ *
+ * The child join's target list is the parent's translated, so that an
+ * Append of child joins produces the parent join's columns in order.  The
+ * child join is not entered in the join lists of the PlannerInfo: it is
+ * only ever looked at through the Append built for the parent.
+ */
+RelOptInfo *
+build_child_join_rel(PlannerInfo *root,
+					 RelOptInfo *outer_rel,
+					 RelOptInfo *inner_rel,
+					 RelOptInfo *parent_joinrel,
+					 List *restrictlist,
+					 SpecialJoinInfo *sjinfo,
+					 AppendRelInfo *appinfo1,
+					 AppendRelInfo *appinfo2)
+{
+	RelOptInfo *joinrel = makeNode(RelOptInfo);
+	List	   *exprs;
+
+	joinrel->reloptkind = RELOPT_JOINREL;
+	joinrel->relids = bms_union(outer_rel->relids, inner_rel->relids);
+	joinrel->rows = 0;
+	joinrel->consider_startup = (root->tuple_fraction > 0);
+	joinrel->consider_param_startup = false;
+	joinrel->consider_parallel = false;
+	joinrel->reltarget = create_empty_pathtarget();
+	joinrel->pathlist = NIL;
+	joinrel->ppilist = NIL;
+	joinrel->partial_pathlist = NIL;
+	joinrel->cheapest_startup_path = NULL;
+	joinrel->cheapest_total_path = NULL;
+	joinrel->cheapest_unique_path = NULL;
+	joinrel->cheapest_parameterized_paths = NIL;
+	joinrel->direct_lateral_relids = NULL;
+	joinrel->lateral_relids = NULL;
+	joinrel->relid = 0;			/* indicates not a baserel */
+	joinrel->rtekind = RTE_JOIN;
+	joinrel->min_attr = 0;
+	joinrel->max_attr = 0;
+	joinrel->attr_needed = NULL;
+	joinrel->attr_widths = NULL;
+	joinrel->lateral_vars = NIL;
+	joinrel->lateral_referencers = NULL;
+	joinrel->indexlist = NIL;
+	joinrel->statlist = NIL;
+	joinrel->pages = 0;
+	joinrel->tuples = 0;
+	joinrel->allvisfrac = 0;
+	joinrel->subroot = NULL;
+	joinrel->subplan_params = NIL;
+	joinrel->rel_parallel_workers = -1;
+	joinrel->serverid = InvalidOid;
+	joinrel->userid = InvalidOid;
+	joinrel->useridiscurrent = false;
+	joinrel->fdwroutine = NULL;
+	joinrel->fdw_private = NULL;
+	joinrel->unique_for_rels = NIL;
+	joinrel->non_unique_for_rels = NIL;
+	joinrel->baserestrictinfo = NIL;
+	joinrel->baserestrictcost.startup = 0;
+	joinrel->baserestrictcost.per_tuple = 0;
+	joinrel->baserestrict_min_security = UINT_MAX;
+	/* The child join is not joined any further, so it needs no joininfo */
+	joinrel->joininfo = NIL;
+	joinrel->has_eclass_joins = false;
+	joinrel->top_parent_relids = bms_copy(parent_joinrel->relids);
+
+	exprs = (List *) adjust_appendrel_attrs(root,
+									(Node *) parent_joinrel->reltarget->exprs,
+											appinfo1);
+	exprs = (List *) adjust_appendrel_attrs(root, (Node *) exprs, appinfo2);
+	joinrel->reltarget->exprs = exprs;
+	joinrel->reltarget->cost = parent_joinrel->reltarget->cost;
+	joinrel->reltarget->width = parent_joinrel->reltarget->width;
+
+	set_joinrel_size_estimates(root, joinrel, outer_rel, inner_rel,
+							   sjinfo, restrictlist);
+
+	return joinrel;
+}
+
 /*
  * min_join_parameterization
  *
@@ -3978,6 +3978,8 @@ OptDistributeByInternal:  DISTRIBUTE BY OptDistributeType '(' name ')'
 						n->disttype = DISTTYPE_MODULO;
 					else if (strcmp($3, "hash") == 0)
 						n->disttype = DISTTYPE_HASH;
+					else if (strcmp($3, "bucket") == 0)
+						n->disttype = DISTTYPE_BUCKET;
 					else
                         ereport(ERROR,
                                 (errcode(ERRCODE_SYNTAX_ERROR),
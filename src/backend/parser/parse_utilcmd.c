@@ -414,6 +414,11 @@ transformCreateStmt(CreateStmt *stmt, const char *queryString)
 					stmt->distributeby->colname =
 							pstrdup(rel->rd_locator_info->partAttrName);
 					break;
+				case LOCATOR_TYPE_BUCKET:
+					stmt->distributeby->disttype = DISTTYPE_BUCKET;
+					stmt->distributeby->colname =
+							pstrdup(rel->rd_locator_info->partAttrName);
+					break;
 				case LOCATOR_TYPE_REPLICATED:
 					stmt->distributeby->disttype = DISTTYPE_REPLICATION;
 					break;
@@ -3621,7 +3626,8 @@ CheckLocalIndexColumn (char loctype, char *partcolname, char *indexcolname)
 			ereport(ERROR,
 					(errcode(ERRCODE_INVALID_COLUMN_REFERENCE),
 					errmsg("Cannot locally enforce a unique index on round robin distributed table.")));
-	else if (loctype == LOCATOR_TYPE_HASH || loctype == LOCATOR_TYPE_MODULO)
+	else if (loctype == LOCATOR_TYPE_HASH || loctype == LOCATOR_TYPE_MODULO ||
+			 loctype == LOCATOR_TYPE_BUCKET)
 	{
 		if (partcolname && indexcolname && strcmp(partcolname, indexcolname) == 0)
 			return true;
@@ -3957,6 +3963,10 @@ checkLocalFKConstraints(CreateStmtContext *cxt)
 							cxt->distributeby->disttype = DISTTYPE_MODULO;
 							cxt->distributeby->colname = pstrdup(lattr);
 							break;
+						case LOCATOR_TYPE_BUCKET:
+							cxt->distributeby->disttype = DISTTYPE_BUCKET;
+							cxt->distributeby->colname = pstrdup(lattr);
+							break;
 						default:
 							/* can not happen ?*/
 							ereport(ERROR,
@@ -4,6 +4,16 @@
  *
  *	  Barrier handling for PITR
  *
+ * A barrier is a point in the WAL of every node at which no distributed
+ * commit is in progress, so it is consistent across the cluster. Commits
+ * only have to be held while the barrier records are inserted: the nodes
+ * flush them to disk once commits have resumed. Besides
+ * serving as a recovery target, each node remembers the last barriers it
+ * wrote or replayed. A Coordinator whose Datanode definitions point to hot
+ * standbys (datanode_standby_reads) passes the latest barrier it knows of
+ * down to them, and they wait until they have replayed it before taking a
+ * snapshot, see StandbyWaitForBarrier.
+ *
  *
  * Portions Copyright (c) 1996-2009, PostgreSQL Global Development Group
  * Portions Copyright (c) 2010-2012 Postgres-XC Development Group
@@ -17,21 +27,64 @@
 #include "postgres.h"
 #include "access/gtm.h"
 #include "access/xlog_internal.h"
+#include "funcapi.h"
 #include "libpq/libpq.h"
 #include "libpq/pqformat.h"
+#include "miscadmin.h"
+#include "pgstat.h"
 #include "pgxc/barrier.h"
 #include "pgxc/execRemote.h"
 #include "pgxc/locator.h"
 #include "pgxc/pgxc.h"
 #include "nodes/nodes.h"
 #include "pgxc/pgxcnode.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
 #include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
 #include "tcop/dest.h"
+#include "utils/builtins.h"
+#include "utils/pg_lsn.h"
+#include "utils/timestamp.h"
+
+/* Number of barriers each node remembers */
+#define BARRIER_HISTORY_SIZE	64
+
+typedef struct BarrierHistoryEntry
+{
+	char		id[NAMEDATALEN];	/* truncated like GUC values sent down */
+	XLogRecPtr	lsn;			/* end of the barrier record */
+	TimestampTz time;			/* when it was written or replayed */
+} BarrierHistoryEntry;
+
+typedef struct BarrierCtlData
+{
+	slock_t		mutex;
+	uint64		count;			/* barriers remembered so far */
+	BarrierHistoryEntry history[BARRIER_HISTORY_SIZE];
+} BarrierCtlData;
+
+static BarrierCtlData *BarrierCtl = NULL;
+
+/* GUC parameters */
+char	   *StandbyReadBarrier = NULL;
+int			StandbyReadBarrierTimeout = 10000;
+bool		DatanodeStandbyReads = false;
+
+/* Last barrier this backend saw replayed */
+static char StandbyReachedBarrier[NAMEDATALEN];
+
+/* Barrier record inserted by this backend and not flushed yet */
+static XLogRecPtr BarrierFlushPtr = InvalidXLogRecPtr;
 
 static const char *generate_barrier_id(const char *id);
 static PGXCNodeAllHandles *PrepareBarrier(const char *id);
 static void ExecuteBarrier(const char *id);
 static void EndBarrier(PGXCNodeAllHandles *handles, const char *id);
+static void FlushBarrier(const char *id);
+static void BarrierRemember(const char *id, XLogRecPtr lsn);
+static bool BarrierKnown(const char *id);
 
 /*
  * Prepare ourselves for an incoming BARRIER. We must disable all new 2PC
@@ -102,9 +155,11 @@ ProcessCreateBarrierEnd(const char *id)
 }
 
 /*
- * Execute the CREATE BARRIER command. Write a BARRIER WAL record and flush the
- * WAL buffers to disk before returning to the caller. Writing the WAL record
- * does not guarantee successful completion of the barrier command.
+ * Execute the CREATE BARRIER command. Write a BARRIER WAL record and return
+ * to the caller. Its position in the WAL is all that matters while the
+ * Coordinators hold their commits, the record is flushed to disk by the
+ * CREATE BARRIER FLUSH message sent once they have resumed. Writing the WAL
+ * record does not guarantee successful completion of the barrier command.
  */
 void
 ProcessCreateBarrierExecute(const char *id)
@@ -120,9 +175,36 @@ ProcessCreateBarrierExecute(const char *id)
 		XLogRecPtr recptr;
 
 		XLogBeginInsert();
-		XLogRegisterData((char *) &id, strlen(id) + 1);
+		XLogRegisterData((char *) id, strlen(id) + 1);
 		recptr = XLogInsert(RM_BARRIER_ID, XLOG_BARRIER_CREATE);
-		XLogFlush(recptr);
+		BarrierFlushPtr = recptr;
+		BarrierRemember(id, recptr);
+	}
+
+	pq_beginmessage(&buf, 'b');
+	pq_sendstring(&buf, id);
+	pq_endmessage(&buf);
+	pq_flush();
+}
+
+/*
+ * Flush the BARRIER WAL record written by CREATE BARRIER EXECUTE to disk.
+ */
+void
+ProcessCreateBarrierFlush(const char *id)
+{
+	StringInfoData buf;
+
+	if (!IsConnFromCoord())
+		ereport(ERROR,
+				(errcode(ERRCODE_INTERNAL_ERROR),
+				 errmsg("The CREATE BARRIER FLUSH message is expected to "
+						"arrive from a Coordinator")));
+
+	if (!XLogRecPtrIsInvalid(BarrierFlushPtr))
+	{
+		XLogFlush(BarrierFlushPtr);
+		BarrierFlushPtr = InvalidXLogRecPtr;
 	}
 
 	pq_beginmessage(&buf, 'b');
@@ -234,8 +316,8 @@ CheckBarrierCommandStatus(PGXCNodeAllHandles *conn_handles, const char *id,
 		if (handle_response(handle, NULL) != RESPONSE_BARRIER_OK)
 			ereport(ERROR,
 					(errcode(ERRCODE_INTERNAL_ERROR),
-					 errmsg("CREATE BARRIER PREPARE command failed "
-						 	"with error %s", handle->error)));
+					 errmsg("CREATE BARRIER %s command failed "
+						 	"with error %s", command, handle->error)));
 	}
 
 	elog(DEBUG2, "Successfully completed CREATE BARRIER <%s> %s command on "
@@ -338,11 +420,11 @@ PrepareBarrier(const char *id)
 }
 
 /*
- * Execute the barrier command on all the components, including Datanodes and
- * Coordinators.
+ * Send a CREATE BARRIER EXECUTE or FLUSH request to all the Datanodes and the
+ * Coordinators, and check they all completed it.
  */
 static void
-ExecuteBarrier(const char *id)
+SendBarrierRequest(char command, const char *id, const char *what)
 {
 	List *barrierDataNodeList = GetAllDataNodes();
 	List *barrierCoordList = GetAllCoordNodes();
@@ -353,10 +435,10 @@ ExecuteBarrier(const char *id)
 
 	conn_handles = get_handles(barrierDataNodeList, barrierCoordList, false, true);
 
-	elog(DEBUG2, "Sending CREATE BARRIER <%s> EXECUTE message to "
-				 "Datanodes and Coordinator", id);
+	elog(DEBUG2, "Sending CREATE BARRIER <%s> %s message to "
+				 "Datanodes and Coordinator", id, what);
 	/*
-	 * Send a CREATE BARRIER request to all the Datanodes and the Coordinators
+	 * Send the request to all the Datanodes and the Coordinators
 	 */
 	for (conn = 0; conn < conn_handles->co_conn_count + conn_handles->dn_conn_count; conn++)
 	{
@@ -371,8 +453,8 @@ ExecuteBarrier(const char *id)
 		if (handle->state != DN_CONNECTION_STATE_IDLE)
 			ereport(ERROR,
 					(errcode(ERRCODE_INTERNAL_ERROR),
-					 errmsg("Failed to send CREATE BARRIER EXECUTE request "
-						 	"to the node")));
+					 errmsg("Failed to send CREATE BARRIER %s request "
+						 	"to the node", what)));
 
 		barrier_idlen = strlen(id) + 1;
 
@@ -393,7 +475,7 @@ ExecuteBarrier(const char *id)
 		memcpy(handle->outBuffer + handle->outEnd, &msglen, 4);
 		handle->outEnd += 4;
 
-		handle->outBuffer[handle->outEnd++] = CREATE_BARRIER_EXECUTE;
+		handle->outBuffer[handle->outEnd++] = command;
 
 		memcpy(handle->outBuffer + handle->outEnd, id, barrier_idlen);
 		handle->outEnd += barrier_idlen;
@@ -402,24 +484,49 @@ ExecuteBarrier(const char *id)
 		pgxc_node_flush(handle);
 	}
 
-	CheckBarrierCommandStatus(conn_handles, id, "EXECUTE");
+	CheckBarrierCommandStatus(conn_handles, id, what);
 
 	pfree_pgxc_all_handles(conn_handles);
+}
+
+/*
+ * Execute the barrier command on all the components, including Datanodes and
+ * Coordinators.
+ */
+static void
+ExecuteBarrier(const char *id)
+{
+	SendBarrierRequest(CREATE_BARRIER_EXECUTE, id, "EXECUTE");
 
 	/*
-	 * Also WAL log the BARRIER locally and flush the WAL buffers to disk
+	 * Also WAL log the BARRIER locally, it is flushed by FlushBarrier
 	 */
 	{
 		XLogRecPtr recptr;
 
 		XLogBeginInsert();
-		XLogRegisterData((char *) &id, strlen(id) + 1);
+		XLogRegisterData((char *) id, strlen(id) + 1);
 
 		recptr = XLogInsert(RM_BARRIER_ID, XLOG_BARRIER_CREATE);
-		XLogFlush(recptr);
+		BarrierFlushPtr = recptr;
+		BarrierRemember(id, recptr);
 	}
 }
 
+/*
+ * Flush the barrier records to disk on all the components. This is done once
+ * commits have resumed, so that they are not held while the nodes wait for
+ * their WAL to be written out.
+ */
+static void
+FlushBarrier(const char *id)
+{
+	SendBarrierRequest(CREATE_BARRIER_FLUSH, id, "FLUSH");
+
+	XLogFlush(BarrierFlushPtr);
+	BarrierFlushPtr = InvalidXLogRecPtr;
+}
+
 /*
  * Resume 2PC commits on the local as well as remote Coordinators.
  */
@@ -477,6 +584,12 @@ RequestBarrier(const char *id, char *completionTag)
 	 * Step three. Inform Coordinators about a successfully completed barrier
 	 */
 	EndBarrier(prepared_handles, barrier_id);
+
+	/*
+	 * Step four. Make the barrier records durable, commits are not held any
+	 * more
+	 */
+	FlushBarrier(barrier_id);
 	/* Finally report the barrier to GTM to backup its restart point */
 	ReportBarrierGTM(barrier_id);
 
@@ -490,6 +603,205 @@ RequestBarrier(const char *id, char *completionTag)
 void
 barrier_redo(XLogReaderState *record)
 {
-	/* Nothing to do */
-	return;
+	/* Let the sessions waiting for it know the barrier was replayed */
+	BarrierRemember(XLogRecGetData(record), record->EndRecPtr);
+}
+
+Size
+BarrierShmemSize(void)
+{
+	return sizeof(BarrierCtlData);
+}
+
+void
+BarrierShmemInit(void)
+{
+	bool		found;
+
+	BarrierCtl = (BarrierCtlData *)
+		ShmemInitStruct("Barrier History", BarrierShmemSize(), &found);
+
+	if (!found)
+	{
+		MemSet(BarrierCtl, 0, BarrierShmemSize());
+		SpinLockInit(&BarrierCtl->mutex);
+	}
+}
+
+/*
+ * Add a barrier written or replayed by this node to the history.
+ */
+static void
+BarrierRemember(const char *id, XLogRecPtr lsn)
+{
+	BarrierHistoryEntry *entry;
+
+	SpinLockAcquire(&BarrierCtl->mutex);
+	entry = &BarrierCtl->history[BarrierCtl->count % BARRIER_HISTORY_SIZE];
+	strlcpy(entry->id, id, NAMEDATALEN);
+	entry->lsn = lsn;
+	entry->time = GetCurrentTimestamp();
+	BarrierCtl->count++;
+	SpinLockRelease(&BarrierCtl->mutex);
+}
+
+/*
+ * Is the barrier in the history of this node?
+ */
+static bool
+BarrierKnown(const char *id)
+{
+	bool		known = false;
+	uint64		i;
+
+	SpinLockAcquire(&BarrierCtl->mutex);
+	for (i = 0; i < Min(BarrierCtl->count, BARRIER_HISTORY_SIZE); i++)
+	{
+		if (strncmp(BarrierCtl->history[i].id, id, NAMEDATALEN - 1) == 0)
+		{
+			known = true;
+			break;
+		}
+	}
+	SpinLockRelease(&BarrierCtl->mutex);
+
+	return known;
+}
+
+/*
+ * Copy the id of the last barrier of this node into barrier_id, which must
+ * have room for NAMEDATALEN bytes. Returns false if there is none.
+ */
+bool
+BarrierGetLatest(char *barrier_id)
+{
+	bool		found = false;
+
+	SpinLockAcquire(&BarrierCtl->mutex);
+	if (BarrierCtl->count > 0)
+	{
+		strlcpy(barrier_id,
+				BarrierCtl->history[(BarrierCtl->count - 1) %
+									BARRIER_HISTORY_SIZE].id,
+				NAMEDATALEN);
+		found = true;
+	}
+	SpinLockRelease(&BarrierCtl->mutex);
+
+	return found;
+}
+
+/*
+ * Wait until this hot standby has replayed the barrier set in
+ * standby_read_barrier, so that a snapshot taken afterwards sees all the
+ * transactions committed in the cluster before the barrier. A standby which
+ * restarted only knows about the barriers it replayed since.
+ */
+void
+StandbyWaitForBarrier(void)
+{
+	TimestampTz start = 0;
+
+	if (strncmp(StandbyReachedBarrier, StandbyReadBarrier,
+				NAMEDATALEN - 1) == 0)
+		return;
+
+	while (!BarrierKnown(StandbyReadBarrier))
+	{
+		int			rc;
+
+		if (start == 0)
+			start = GetCurrentTimestamp();
+		else if (StandbyReadBarrierTimeout > 0 &&
+				 TimestampDifferenceExceeds(start, GetCurrentTimestamp(),
+											StandbyReadBarrierTimeout))
+			ereport(ERROR,
+					(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
+					 errmsg("hot standby has not replayed barrier \"%s\" yet",
+							StandbyReadBarrier),
+					 errhint("Increase standby_read_barrier_timeout, or read from the primary.")));
+
+		rc = WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					   10L, WAIT_EVENT_BARRIER_REPLAY);
+		ResetLatch(MyLatch);
+
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	strlcpy(StandbyReachedBarrier, StandbyReadBarrier, NAMEDATALEN);
+}
+
+/*
+ * pgxc_barrier_history
+ *
+ * Return the last barriers written or, on a hot standby, replayed by this
+ * node, oldest first.
+ */
+Datum
+pgxc_barrier_history(PG_FUNCTION_ARGS)
+{
+#define PGXC_BARRIER_HISTORY_COLS	3
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	BarrierHistoryEntry history[BARRIER_HISTORY_SIZE];
+	uint64		count;
+	int			nentries;
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	SpinLockAcquire(&BarrierCtl->mutex);
+	memcpy(history, BarrierCtl->history, sizeof(history));
+	count = BarrierCtl->count;
+	SpinLockRelease(&BarrierCtl->mutex);
+
+	nentries = (int) Min(count, BARRIER_HISTORY_SIZE);
+	for (i = 0; i < nentries; i++)
+	{
+		BarrierHistoryEntry *entry;
+		Datum		values[PGXC_BARRIER_HISTORY_COLS];
+		bool		nulls[PGXC_BARRIER_HISTORY_COLS];
+
+		entry = &history[(count - nentries + i) % BARRIER_HISTORY_SIZE];
+		MemSet(nulls, 0, sizeof(nulls));
+
+		values[0] = CStringGetTextDatum(entry->id);
+		values[1] = LSNGetDatum(entry->lsn);
+		values[2] = TimestampTzGetDatum(entry->time);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
 }
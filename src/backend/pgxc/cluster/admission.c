@@ -0,0 +1,412 @@
+/*-------------------------------------------------------------------------
+ *
+ * admission.c
+ *
+ *	  Admission control of distributed queries on a Coordinator
+ *
+ * Analytic queries fan out RemoteSubplan fragments to every Datanode, and
+ * each fragment holds a connection, a shared queue when it redistributes its
+ * output and up to work_mem for each of its sorts and hash tables on every
+ * node it runs on. When too many such queries run at once the Datanodes run
+ * out of shared queues, connections or memory, and queries fail or thrash.
+ *
+ * Before a query is started the Coordinator estimates from the plan the
+ * number of fragments, shared queues and memory it needs on the Datanodes.
+ * The estimates of the running queries are summed up in shared memory, and
+ * while the sum would exceed admission_max_fragments,
+ * admission_max_shared_queues or admission_max_memory the query waits. The
+ * waiting queries are admitted in the order of their admission_priority, and
+ * of their arrival within a priority, so a big query is not overtaken
+ * forever by smaller ones. A query needing more than a limit by itself is
+ * admitted once nothing else is running.
+ *
+ * The limits are enforced by each Coordinator on its own queries, so they
+ * should be set to the share of the cluster's capacity the Coordinator may
+ * use. Queries started while the session already holds an admission, like
+ * those run by functions, are not counted again, so they never wait for
+ * their caller. The admission is given back when the query ends, or at the
+ * end of the transaction if it fails.
+ *
+ * Portions Copyright (c) 1996-2011, PostgreSQL Global Development Group
+ * Portions Copyright (c) 2010-2012 Postgres-XC Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/pgxc/cluster/admission.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "executor/executor.h"
+#include "miscadmin.h"
+#include "nodes/plannodes.h"
+#include "pgstat.h"
+#include "pgxc/admission.h"
+#include "pgxc/pgxc.h"
+#include "pgxc/planner.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lwlock.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+
+/* GUC parameters */
+int			AdmissionMaxFragments = 0;
+int			AdmissionMaxSharedQueues = 0;
+int			AdmissionMaxMemory = 0;
+int			AdmissionPriorityClass = ADMISSION_PRIORITY_NORMAL;
+
+#define AdmissionControlEnabled() \
+	(AdmissionMaxFragments > 0 || AdmissionMaxSharedQueues > 0 || \
+	 AdmissionMaxMemory > 0)
+
+/* Estimated Datanode resources of a query */
+typedef struct AdmissionCost
+{
+	int64		fragments;		/* fragment executions on the nodes */
+	int64		queues;			/* shared queues */
+	int64		memory;			/* kB */
+} AdmissionCost;
+
+/*
+ * Admission state of a backend, indexed by its PGPROC number. A slot is
+ * either idle, waiting, or admitted with its cost added to the totals.
+ */
+typedef struct AdmissionSlot
+{
+	bool		waiting;
+	bool		admitted;
+	int			priority;
+	uint64		seqno;			/* order of arrival */
+	AdmissionCost cost;
+} AdmissionSlot;
+
+typedef struct AdmissionControlData
+{
+	AdmissionCost used;			/* sum of the admitted costs */
+	int			nwaiting;
+	uint64		next_seqno;
+	AdmissionSlot slots[FLEXIBLE_ARRAY_MEMBER];
+} AdmissionControlData;
+
+/* Protected by AdmissionControlLock */
+static AdmissionControlData *AdmissionCtl = NULL;
+
+/* Executor state of the query holding the admission of this backend */
+static EState *admitted_estate = NULL;
+/* Our slot is in use, waiting or admitted */
+static bool admission_busy = false;
+
+static void admission_estimate(Node *node, int nnodes, AdmissionCost *cost);
+static bool admission_fits(AdmissionSlot *slot);
+static void admission_wake_next(void);
+static void admission_release(void);
+
+Size
+AdmissionControlShmemSize(void)
+{
+	return add_size(offsetof(AdmissionControlData, slots),
+					mul_size(MaxBackends, sizeof(AdmissionSlot)));
+}
+
+void
+AdmissionControlShmemInit(void)
+{
+	bool		found;
+
+	AdmissionCtl = (AdmissionControlData *)
+		ShmemInitStruct("Admission Control Data", AdmissionControlShmemSize(),
+						&found);
+
+	if (!found)
+		memset(AdmissionCtl, 0, AdmissionControlShmemSize());
+}
+
+/*
+ * Add up the resources the plan tree needs on the Datanodes. nnodes is the
+ * number of nodes the enclosing fragment runs on, zero on the Coordinator.
+ * Every node keeping a sort, a hash table or a tuple store may use up to
+ * work_mem on each of these nodes.
+ */
+static void
+admission_estimate(Node *node, int nnodes, AdmissionCost *cost)
+{
+	if (node == NULL)
+		return;
+
+	if (IsA(node, List))
+	{
+		ListCell   *lc;
+
+		foreach(lc, (List *) node)
+			admission_estimate(lfirst(lc), nnodes, cost);
+		return;
+	}
+
+	switch (nodeTag(node))
+	{
+		case T_RemoteSubplan:
+			{
+				RemoteSubplan *rsplan = (RemoteSubplan *) node;
+
+				/* Replicated subplans run on one node, or right here */
+				if (rsplan->execOnAll)
+					nnodes = list_length(rsplan->nodeList);
+				else
+					nnodes = rsplan->nodeList ? 1 : 0;
+
+				cost->fragments += nnodes;
+				/* Producers redistributing their output bind a shared queue */
+				if (rsplan->distributionNodes)
+					cost->queues += nnodes;
+			}
+			break;
+		case T_Sort:
+		case T_Hash:
+		case T_Material:
+		case T_WindowAgg:
+		case T_RecursiveUnion:
+			cost->memory += (int64) work_mem * nnodes;
+			break;
+		case T_Agg:
+			if (((Agg *) node)->aggstrategy == AGG_HASHED ||
+				((Agg *) node)->aggstrategy == AGG_MIXED)
+				cost->memory += (int64) work_mem * nnodes;
+			break;
+		case T_SetOp:
+			if (((SetOp *) node)->strategy == SETOP_HASHED)
+				cost->memory += (int64) work_mem * nnodes;
+			break;
+		default:
+			break;
+	}
+
+	admission_estimate((Node *) ((Plan *) node)->lefttree, nnodes, cost);
+	admission_estimate((Node *) ((Plan *) node)->righttree, nnodes, cost);
+	switch (nodeTag(node))
+	{
+		case T_Append:
+			admission_estimate((Node *) ((Append *) node)->appendplans,
+							   nnodes, cost);
+			break;
+		case T_MergeAppend:
+			admission_estimate((Node *) ((MergeAppend *) node)->mergeplans,
+							   nnodes, cost);
+			break;
+		case T_ModifyTable:
+			admission_estimate((Node *) ((ModifyTable *) node)->plans,
+							   nnodes, cost);
+			break;
+		case T_BitmapAnd:
+			admission_estimate((Node *) ((BitmapAnd *) node)->bitmapplans,
+							   nnodes, cost);
+			break;
+		case T_BitmapOr:
+			admission_estimate((Node *) ((BitmapOr *) node)->bitmapplans,
+							   nnodes, cost);
+			break;
+		case T_SubqueryScan:
+			admission_estimate((Node *) ((SubqueryScan *) node)->subplan,
+							   nnodes, cost);
+			break;
+		case T_CustomScan:
+			admission_estimate((Node *) ((CustomScan *) node)->custom_plans,
+							   nnodes, cost);
+			break;
+		default:
+			break;
+	}
+}
+
+/*
+ * Check whether the waiting slot may be admitted: it is first in line and
+ * its cost fits under the limits, or nothing else is running.
+ */
+static bool
+admission_fits(AdmissionSlot *slot)
+{
+	AdmissionCost *used = &AdmissionCtl->used;
+	int			i;
+
+	for (i = 0; AdmissionCtl->nwaiting > 1 && i < MaxBackends; i++)
+	{
+		AdmissionSlot *other = &AdmissionCtl->slots[i];
+
+		if (!other->waiting || other == slot)
+			continue;
+		if (other->priority > slot->priority ||
+			(other->priority == slot->priority && other->seqno < slot->seqno))
+			return false;
+	}
+
+	if (used->fragments == 0 && used->queues == 0 && used->memory == 0)
+		return true;
+
+	if (AdmissionMaxFragments > 0 &&
+		used->fragments + slot->cost.fragments > AdmissionMaxFragments)
+		return false;
+	if (AdmissionMaxSharedQueues > 0 &&
+		used->queues + slot->cost.queues > AdmissionMaxSharedQueues)
+		return false;
+	if (AdmissionMaxMemory > 0 &&
+		used->memory + slot->cost.memory > AdmissionMaxMemory)
+		return false;
+
+	return true;
+}
+
+/*
+ * Wake up the first waiting backend in line to let it check if it fits.
+ * Each backend admitted passes this on, so the following ones get admitted
+ * as long as there is room. Must be called with AdmissionControlLock held.
+ */
+static void
+admission_wake_next(void)
+{
+	AdmissionSlot *best = NULL;
+	int			bestno = -1;
+	int			i;
+
+	if (AdmissionCtl->nwaiting == 0)
+		return;
+
+	for (i = 0; i < MaxBackends; i++)
+	{
+		AdmissionSlot *slot = &AdmissionCtl->slots[i];
+
+		if (!slot->waiting)
+			continue;
+		if (best == NULL || slot->priority > best->priority ||
+			(slot->priority == best->priority && slot->seqno < best->seqno))
+		{
+			best = slot;
+			bestno = i;
+		}
+	}
+
+	if (best != NULL)
+		SetLatch(&ProcGlobal->allProcs[bestno].procLatch);
+}
+
+/*
+ * Wait until the query is admitted, if it runs fragments on the Datanodes
+ * and admission control is on. Called by ExecutorStart before the plan is
+ * initialized, that is, before any fragment is started.
+ */
+void
+AdmissionControlStart(QueryDesc *queryDesc, int eflags)
+{
+	AdmissionCost cost;
+	AdmissionSlot *slot;
+	ListCell   *lc;
+
+	if (!AdmissionControlEnabled() || AdmissionCtl == NULL ||
+		!IS_PGXC_LOCAL_COORDINATOR || (eflags & EXEC_FLAG_EXPLAIN_ONLY) ||
+		MyProc == NULL || MyProc->pgprocno >= MaxBackends)
+		return;
+
+	/* Covered by the admission of an outer query */
+	if (admission_busy)
+		return;
+
+	memset(&cost, 0, sizeof(cost));
+	admission_estimate((Node *) queryDesc->plannedstmt->planTree, 0, &cost);
+	foreach(lc, queryDesc->plannedstmt->subplans)
+		admission_estimate((Node *) lfirst(lc), 0, &cost);
+
+	if (cost.fragments == 0)
+		return;
+
+	slot = &AdmissionCtl->slots[MyProc->pgprocno];
+
+	LWLockAcquire(AdmissionControlLock, LW_EXCLUSIVE);
+	slot->cost = cost;
+	slot->priority = AdmissionPriorityClass;
+	slot->seqno = AdmissionCtl->next_seqno++;
+	slot->waiting = true;
+	slot->admitted = false;
+	AdmissionCtl->nwaiting++;
+	admission_busy = true;
+
+	while (!admission_fits(slot))
+	{
+		int			rc;
+
+		LWLockRelease(AdmissionControlLock);
+
+		elog(DEBUG1, "waiting for admission of query needing "
+			 INT64_FORMAT " fragments, " INT64_FORMAT " shared queues and "
+			 INT64_FORMAT " kB", cost.fragments, cost.queues, cost.memory);
+
+		rc = WaitLatch(MyLatch, WL_LATCH_SET | WL_POSTMASTER_DEATH, -1,
+					   WAIT_EVENT_ADMISSION_CONTROL);
+		ResetLatch(MyLatch);
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+
+		/* Canceled waits are cleaned up at the end of the transaction */
+		CHECK_FOR_INTERRUPTS();
+
+		LWLockAcquire(AdmissionControlLock, LW_EXCLUSIVE);
+	}
+
+	slot->waiting = false;
+	slot->admitted = true;
+	AdmissionCtl->nwaiting--;
+	AdmissionCtl->used.fragments += cost.fragments;
+	AdmissionCtl->used.queues += cost.queues;
+	AdmissionCtl->used.memory += cost.memory;
+	admission_wake_next();
+	LWLockRelease(AdmissionControlLock);
+
+	admitted_estate = queryDesc->estate;
+}
+
+/*
+ * Withdraw our slot, waiting or admitted, and let the next query in.
+ */
+static void
+admission_release(void)
+{
+	AdmissionSlot *slot = &AdmissionCtl->slots[MyProc->pgprocno];
+
+	LWLockAcquire(AdmissionControlLock, LW_EXCLUSIVE);
+	if (slot->waiting)
+		AdmissionCtl->nwaiting--;
+	if (slot->admitted)
+	{
+		AdmissionCtl->used.fragments -= slot->cost.fragments;
+		AdmissionCtl->used.queues -= slot->cost.queues;
+		AdmissionCtl->used.memory -= slot->cost.memory;
+	}
+	slot->waiting = false;
+	slot->admitted = false;
+	admission_wake_next();
+	LWLockRelease(AdmissionControlLock);
+
+	admission_busy = false;
+	admitted_estate = NULL;
+}
+
+/*
+ * Called by ExecutorEnd, gives the admission back if the query holds it.
+ */
+void
+AdmissionControlEnd(QueryDesc *queryDesc)
+{
+	if (admission_busy && admitted_estate != NULL &&
+		queryDesc->estate == admitted_estate)
+		admission_release();
+}
+
+/*
+ * Give back the admission of a query which has not ended, or withdraw from
+ * the queue if the wait was interrupted.
+ */
+void
+AtEOXact_AdmissionControl(void)
+{
+	if (admission_busy)
+		admission_release();
+}
@@ -147,7 +147,8 @@ RemoteCopy_BuildStatement(RemoteCopyData *state,
 	if (state->is_from)
 		appendStringInfoString(&state->query_buf, " FROM STDIN");
 	else
-		appendStringInfoString(&state->query_buf, " TO STDOUT");
+		appendStringInfo(&state->query_buf, " TO %s",
+						 options->rco_target ? options->rco_target : "STDOUT");
 
 	if (options->rco_binary)
 		appendStringInfoString(&state->query_buf, " BINARY");
@@ -155,6 +156,13 @@ RemoteCopy_BuildStatement(RemoteCopyData *state,
 	if (options->rco_oids)
 		appendStringInfoString(&state->query_buf, " OIDS");
 
+	/*
+	 * The table has been created or truncated in the same transaction on the
+	 * Datanodes, so they can load it frozen as well.
+	 */
+	if (options->rco_freeze)
+		appendStringInfoString(&state->query_buf, " FREEZE");
+
 	if (options->rco_delim)
 	{
 		if ((!options->rco_csv_mode && options->rco_delim[0] != '\t')
@@ -235,6 +243,7 @@ makeRemoteCopyOptions(void)
 	RemoteCopyOptions *res = (RemoteCopyOptions *) palloc(sizeof(RemoteCopyOptions));
 	res->rco_binary = false;
 	res->rco_oids = false;
+	res->rco_freeze = false;
 	res->rco_csv_mode = false;
 	res->rco_delim = NULL;
 	res->rco_null_print = NULL;
@@ -242,6 +251,7 @@ makeRemoteCopyOptions(void)
 	res->rco_escape = NULL;
 	res->rco_force_quote = NIL;
 	res->rco_force_notnull = NIL;
+	res->rco_target = NULL;
 	return res;
 }
 
@@ -270,6 +280,8 @@ FreeRemoteCopyOptions(RemoteCopyOptions *options)
 		list_free(options->rco_force_quote);
 	if (options->rco_force_notnull)
 		list_free(options->rco_force_notnull);
+	if (options->rco_target)
+		pfree(options->rco_target);
 
 	/* Then finish the work */
 	pfree(options);
@@ -66,6 +66,13 @@ struct _Locator
 	 */
 	int			(*locatefunc) (Locator *self, Datum value, bool isnull,
 								bool *hasprimary);
+	/*
+	 * Determine target node indexes for array of values, set only if the
+	 * locator always returns exactly one node for a value.
+	 */
+	void		(*locatebatchfunc) (Locator *self, int nvalues, Datum *values,
+									bool *nulls, int *indexes);
+	char		locatorType;
 	Oid			dataType; 		/* values of that type are passed to locateNodes function */
 	LocatorListType listType;
 	bool		primary;
@@ -74,10 +81,21 @@ struct _Locator
 	int			roundRobinNode; /* for LOCATOR_TYPE_RROBIN */
 	LocatorHashFunc	hashfunc; /* for LOCATOR_TYPE_HASH */
 	int 		valuelen; /* 1, 2 or 4 for LOCATOR_TYPE_MODULO */
+	int		   *bucketMap; /* bucket to node index for LOCATOR_TYPE_BUCKET */
 
 	int			nodeCount; /* How many nodes are in the map */
+	int			nodeMask; /* nodeCount - 1 if it is a power of 2, otherwise -1 */
 	void	   *nodeMap; /* map index to node reference according to listType */
 	void	   *results; /* array to output results */
+
+	/* hot values, located apart from the others, see setLocatorSkew */
+	int			nskew;
+	Datum	   *skewValues;
+	FmgrInfo	skewEqfunc;
+	Oid			skewCollation;
+	bool		skewBroadcast;
+	int			(*skewLocatefunc) (Locator *self, Datum value, bool isnull,
+								   bool *hasprimary);
 };
 #endif
 
@@ -102,15 +120,110 @@ static int locate_modulo_insert(Locator *self, Datum value, bool isnull,
 			  bool *hasprimary);
 static int locate_modulo_select(Locator *self, Datum value, bool isnull,
 			  bool *hasprimary);
+static void locate_roundrobin_batch(Locator *self, int nvalues, Datum *values,
+			  bool *nulls, int *indexes);
+static void locate_hash_batch(Locator *self, int nvalues, Datum *values,
+			  bool *nulls, int *indexes);
+static void locate_modulo_batch(Locator *self, int nvalues, Datum *values,
+			  bool *nulls, int *indexes);
+static int locate_skewed(Locator *self, Datum value, bool isnull,
+			  bool *hasprimary);
+static void locator_set_result(Locator *self, int pos, int index);
+static void locator_set_bucket_keys(Locator *self, uint32 *nodekeys);
 static Expr * pgxc_find_distcol_expr(Index varno,
 					   AttrNumber attrNum,
 					   Node *quals);
 #endif
+static int	GetLeastLoadedNode(int *members, int nmembers);
+static int	cmp_latency(const void *a, const void *b);
+
+
+/*
+ * cmp_latency
+ *	  qsort comparator for connect latencies.
+ */
+static int
+cmp_latency(const void *a, const void *b)
+{
+	int			la = *(const int *) a;
+	int			lb = *(const int *) b;
+
+	return (la > lb) - (la < lb);
+}
+
+/*
+ * GetLeastLoadedNode
+ *	  Pick the least loaded healthy Datanode from the given array.
+ *
+ * The load is the number of connections to the node in use, and the
+ * average time to open a new connection, both as seen by the pooler of
+ * this Coordinator (see PgxcNodeUpdateLoad). Unhealthy nodes and nodes
+ * with latency more than twice the median latency of the candidates are
+ * skipped, unless that would leave no candidates. Of the remaining nodes,
+ * one of those with the fewest connections in use is picked randomly, so
+ * that reads are still spread when the nodes are idle.
+ */
+static int
+GetLeastLoadedNode(int *members, int nmembers)
+{
+	List	   *nodes = NIL;
+	bool		healthy[nmembers];
+	int			active[nmembers];
+	int			latency[nmembers];
+	int			sorted[nmembers];
+	int			candidates[nmembers];
+	int			ncandidates = 0;
+	int			nlatencies = 0;
+	int			median = 0;
+	int			minactive = INT_MAX;
+	int			i;
+
+	for (i = 0; i < nmembers; i++)
+		nodes = lappend_int(nodes, members[i]);
+	PgxcNodeDnListLoad(nodes, healthy, active, latency);
+	list_free(nodes);
+
+	/* median latency of the healthy nodes, if known */
+	for (i = 0; i < nmembers; i++)
+		if (healthy[i] && latency[i] > 0)
+			sorted[nlatencies++] = latency[i];
+	if (nlatencies > 0)
+	{
+		qsort(sorted, nlatencies, sizeof(int), cmp_latency);
+		median = sorted[nlatencies / 2];
+	}
+
+	for (i = 0; i < nmembers; i++)
+	{
+		if (!healthy[i])
+			continue;
+		if (median > 0 && latency[i] > 2 * median)
+			continue;
+		minactive = Min(minactive, active[i]);
+	}
+
+	for (i = 0; i < nmembers; i++)
+	{
+		if (!healthy[i])
+			continue;
+		if (median > 0 && latency[i] > 2 * median)
+			continue;
+		if (active[i] == minactive)
+			candidates[ncandidates++] = members[i];
+	}
+
+	/* no healthy node, so just pick any */
+	if (ncandidates == 0)
+		return members[((unsigned int) random()) % nmembers];
+
+	return candidates[((unsigned int) random()) % ncandidates];
+}
 
 
 /*
  * GetPreferredReplicationNode
  * Pick any Datanode from given list, however fetch a preferred node first.
+ * Without a preferred node, pick the least loaded one.
  */
 List *
 GetPreferredReplicationNode(List *relNodes)
@@ -137,15 +250,23 @@ GetPreferredReplicationNode(List *relNodes)
 			break;
 	}
 	if (nodeid < 0)
-		return list_make1_int(list_nth_int(relNodes,
-					((unsigned int) random()) % list_length(relNodes)));
+	{
+		int			nmembers = 0;
+		int			members[list_length(relNodes)];
+
+		foreach(item, relNodes)
+			members[nmembers++] = lfirst_int(item);
+
+		return list_make1_int(GetLeastLoadedNode(members, nmembers));
+	}
 
 	return list_make1_int(nodeid);
 }
 
 /*
  * GetAnyDataNode
- * Pick any data node from given set, but try a preferred node
+ * Pick any data node from given set, but try a preferred node. Among the
+ * preferred (or all) nodes, pick the least loaded one.
  */
 int
 GetAnyDataNode(Bitmapset *nodes)
@@ -189,9 +310,10 @@ GetAnyDataNode(Bitmapset *nodes)
 	 * previous returned index for load balancing the distribution won't be
 	 * flat, because small set will probably reset saved value, and lower
 	 * indexes will be picked up more often.
-	 * So we just get a random value from 0..nmembers-1.
+	 * So we pick the least loaded node, and a random one among equally
+	 * loaded nodes.
 	 */
-	return members[((unsigned int) random()) % nmembers];
+	return GetLeastLoadedNode(members, nmembers);
 }
 
 /*
@@ -206,6 +328,88 @@ compute_modulo(uint64 numerator, uint64 denominator)
 	return numerator % denominator;
 }
 
+#ifdef XCP
+/*
+ * locator_modulo
+ *	Computes modulo of the value by number of locator nodes.
+ */
+static inline int
+locator_modulo(Locator *self, uint64 value)
+{
+	if (self->nodeMask >= 0)
+		return (int) (value & self->nodeMask);
+
+	return compute_modulo(value, self->nodeCount);
+}
+
+/*
+ * locator_hash_index
+ *	Determines node index of the hash value for a hash or bucket locator.
+ *	A NULL value is assigned the first bucket, or the first node.
+ */
+static inline int
+locator_hash_index(Locator *self, uint32 hash32)
+{
+	Assert(self->bucketMap || self->locatorType != LOCATOR_TYPE_BUCKET);
+
+	if (self->bucketMap)
+		return self->bucketMap[hash32 & (HASH_SIZE - 1)];
+
+	return locator_modulo(self, hash32);
+}
+
+static inline int
+locator_null_index(Locator *self)
+{
+	return self->bucketMap ? self->bucketMap[0] : 0;
+}
+
+/*
+ * locator_hash
+ *	Computes hash of the value for a hash locator.
+ *	Hashing of mostly used distribution types is done inline, the result is
+ *	the same as of their hash functions.
+ */
+static inline uint32
+locator_hash(Locator *self, Datum value)
+{
+	switch (self->dataType)
+	{
+		case INT4OID:
+		case ABSTIMEOID:
+		case RELTIMEOID:
+		case DATEOID:
+			return DatumGetUInt32(hash_uint32(DatumGetInt32(value)));
+		case INT8OID:
+		case CASHOID:
+			{
+				int64		val = DatumGetInt64(value);
+				uint32		lohalf = (uint32) val;
+				uint32		hihalf = (uint32) (val >> 32);
+
+				/* see hashint8() */
+				lohalf ^= (val >= 0) ? hihalf : ~hihalf;
+				return DatumGetUInt32(hash_uint32(lohalf));
+			}
+		case VARCHAROID:
+		case TEXTOID:
+			{
+				text	   *key = DatumGetTextPP(value);
+				uint32		hash32;
+
+				hash32 = DatumGetUInt32(hash_any((unsigned char *) VARDATA_ANY(key),
+												 VARSIZE_ANY_EXHDR(key)));
+				if ((Pointer) key != DatumGetPointer(value))
+					pfree(key);
+				return hash32;
+			}
+		default:
+			return (uint32) DatumGetInt32(DirectFunctionCall1(self->hashfunc,
+															  value));
+	}
+}
+#endif
+
 /*
  * GetRelationDistColumn - Returns the name of the hash or modulo distribution column
  * First hash distribution is checked
@@ -235,6 +439,19 @@ IsTypeHashDistributable(Oid col_type)
 	return (hash_func_ptr(col_type) != NULL);
 }
 
+/*
+ * DistribKeyHash
+ *	Returns the hash of a value of a hash distributable data type.
+ */
+uint32
+DistribKeyHash(Oid col_type, Datum value)
+{
+	LocatorHashFunc hashfunc = hash_func_ptr(col_type);
+
+	Assert(hashfunc != NULL);
+	return (uint32) DatumGetInt32(DirectFunctionCall1(hashfunc, value));
+}
+
 /*
  * GetRelationHashColumn - return hash column for relation.
  *
@@ -247,7 +464,8 @@ GetRelationHashColumn(RelationLocInfo * rel_loc_info)
 
 	if (rel_loc_info == NULL)
 		column_str = NULL;
-	else if (rel_loc_info->locatorType != LOCATOR_TYPE_HASH)
+	else if (rel_loc_info->locatorType != LOCATOR_TYPE_HASH &&
+			 rel_loc_info->locatorType != LOCATOR_TYPE_BUCKET)
 		column_str = NULL;
 	else
 	{
@@ -296,6 +514,50 @@ IsTypeModuloDistributable(Oid col_type)
 	return (modulo_value_len(col_type) != -1);
 }
 
+/*
+ * hash_colocation_type
+ *	Returns the colocation class of a hash distributable data type: equal
+ *	values of the types of the same class are hashed to the same value.
+ *	The integer types follow hashint8(), which agrees with hashint4() and
+ *	hashint2() for the values they can hold, and varchar is hashed as text.
+ */
+static Oid
+hash_colocation_type(Oid dataType)
+{
+	switch (dataType)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+			return INT8OID;
+		case VARCHAROID:
+		case TEXTOID:
+			return TEXTOID;
+		default:
+			return dataType;
+	}
+}
+
+/*
+ * IsDistColumnTypeColocated
+ *	Returns whether two relations distributed by the given locator type
+ *	over the same nodes, with distribution columns of the given types, place
+ *	rows having equal distribution key values on the same node. Only hash
+ *	distribution is tolerant to different types, modulo works on the binary
+ *	value of the key and its width matters for negative values.
+ */
+bool
+IsDistColumnTypeColocated(char locatorType, Oid type1, Oid type2)
+{
+	if (type1 == type2)
+		return true;
+
+	if (locatorType == LOCATOR_TYPE_HASH || locatorType == LOCATOR_TYPE_BUCKET)
+		return hash_colocation_type(type1) == hash_colocation_type(type2);
+
+	return false;
+}
+
 /*
  * GetRelationModuloColumn - return modulo column for relation.
  *
@@ -433,6 +695,9 @@ ConvertToLocatorType(int disttype)
 		case DISTTYPE_MODULO:
 			loctype = LOCATOR_TYPE_MODULO;
 			break;
+		case DISTTYPE_BUCKET:
+			loctype = LOCATOR_TYPE_BUCKET;
+			break;
 		default:
 			ereport(ERROR,
 					(errcode(ERRCODE_WRONG_OBJECT_TYPE),
@@ -758,6 +1023,145 @@ hash_func_ptr(Oid dataType)
 }
 
 
+/*
+ * Bucket distribution
+ *
+ * Values of a bucket distributed table are hashed into HASH_SIZE buckets and
+ * every bucket is stored on one node, the node having highest score for the
+ * bucket, where the score mixes the node identifier with the bucket number
+ * (rendezvous hashing). So the map depends on the set of nodes only, not on
+ * their order or number: a node added to the table takes over a share of
+ * buckets from each of the other nodes, leaving the rest in place, and a
+ * node removed from the table hands over its own buckets only.
+ *
+ * Building the map takes HASH_SIZE * nnodes hash computations, so the most
+ * recently used maps are cached.
+ */
+#define BUCKET_MAP_CACHE_SIZE 8
+
+typedef struct BucketMapCacheEntry
+{
+	int			nnodes;			/* -1 if the entry is not valid */
+	uint32	   *nodekeys;
+	int			map[HASH_SIZE];
+} BucketMapCacheEntry;
+
+static BucketMapCacheEntry *bucketMapCache[BUCKET_MAP_CACHE_SIZE];
+static int	bucketMapCacheNext = 0;
+
+static inline uint32
+bucket_score(uint32 nodekey, int bucket)
+{
+	return DatumGetUInt32(hash_uint32(nodekey ^ ((uint32) bucket * 0x9E3779B9)));
+}
+
+/*
+ * GetBucketMap
+ *	Write the owner of each bucket, as a position in the nodekeys array, to
+ *	the map array of HASH_SIZE elements. The nodekeys are the identifiers of
+ *	the nodes of the table (pgxc_node.node_id).
+ */
+void
+GetBucketMap(int nnodes, const uint32 *nodekeys, int *map)
+{
+	BucketMapCacheEntry *entry;
+	int			bucket;
+	int			i;
+
+	Assert(nnodes > 0);
+
+	for (i = 0; i < BUCKET_MAP_CACHE_SIZE; i++)
+	{
+		entry = bucketMapCache[i];
+		if (entry && entry->nnodes == nnodes &&
+			memcmp(entry->nodekeys, nodekeys, nnodes * sizeof(uint32)) == 0)
+		{
+			memcpy(map, entry->map, HASH_SIZE * sizeof(int));
+			return;
+		}
+	}
+
+	/* Not found, build the map in place of the oldest cache entry */
+	entry = bucketMapCache[bucketMapCacheNext];
+	if (entry == NULL)
+	{
+		entry = (BucketMapCacheEntry *)
+			MemoryContextAlloc(TopMemoryContext, sizeof(BucketMapCacheEntry));
+		entry->nodekeys = NULL;
+		bucketMapCache[bucketMapCacheNext] = entry;
+	}
+	entry->nnodes = -1;
+	if (entry->nodekeys)
+		pfree(entry->nodekeys);
+	entry->nodekeys = (uint32 *)
+		MemoryContextAlloc(TopMemoryContext, nnodes * sizeof(uint32));
+	memcpy(entry->nodekeys, nodekeys, nnodes * sizeof(uint32));
+	bucketMapCacheNext = (bucketMapCacheNext + 1) % BUCKET_MAP_CACHE_SIZE;
+
+	for (bucket = 0; bucket < HASH_SIZE; bucket++)
+	{
+		int			best = 0;
+		uint32		bestscore = bucket_score(nodekeys[0], bucket);
+
+		for (i = 1; i < nnodes; i++)
+		{
+			uint32		score = bucket_score(nodekeys[i], bucket);
+
+			/* Ties are unlikely, but must be resolved regardless of order */
+			if (score > bestscore ||
+				(score == bestscore && nodekeys[i] > nodekeys[best]))
+			{
+				best = i;
+				bestscore = score;
+			}
+		}
+		entry->map[bucket] = best;
+	}
+	entry->nnodes = nnodes;
+
+	memcpy(map, entry->map, HASH_SIZE * sizeof(int));
+}
+
+
+/*
+ * Set up bucket map of the locator from the identifiers of its nodes
+ */
+static void
+locator_set_bucket_keys(Locator *self, uint32 *nodekeys)
+{
+	if (self->bucketMap == NULL)
+		self->bucketMap = (int *) palloc(HASH_SIZE * sizeof(int));
+	GetBucketMap(self->nodeCount, nodekeys, self->bucketMap);
+}
+
+
+/*
+ * Bucket locator needs to know which nodes are behind its node map. That is
+ * known if the node map is a list of Datanode indexes, Oids or connection
+ * handles, otherwise the caller has to tell it, passing the list of Datanode
+ * indexes corresponding to the node map.
+ */
+void
+setLocatorBucketNodes(Locator *self, List *nodeList)
+{
+	uint32	   *nodekeys;
+	ListCell   *lc;
+	int			i;
+
+	if (self->locatorType != LOCATOR_TYPE_BUCKET)
+		return;
+
+	Assert(list_length(nodeList) == self->nodeCount);
+	nodekeys = (uint32 *) palloc(self->nodeCount * sizeof(uint32));
+	i = 0;
+	foreach(lc, nodeList)
+		nodekeys[i++] = get_pgxc_node_id(PGXCNodeGetNodeOid(lfirst_int(lc),
+														PGXC_NODE_DATANODE));
+	locator_set_bucket_keys(self, nodekeys);
+	pfree(nodekeys);
+}
+
+
 Locator *
 createLocator(char locatorType, RelationAccessType accessType,
 			  Oid dataType, LocatorListType listType, int nodeCount,
@@ -766,12 +1170,18 @@ createLocator(char locatorType, RelationAccessType accessType,
 	Locator    *locator;
 	ListCell   *lc;
 	void 	   *nodeMap = NULL;
+	bool		nodeIndexes = false;
 	int 		i;
 
 	locator = (Locator *) palloc(sizeof(Locator));
+	locator->locatorType = locatorType;
 	locator->dataType = dataType;
 	locator->listType = listType;
 	locator->nodeCount = nodeCount;
+	locator->locatebatchfunc = NULL;
+	locator->nskew = 0;
+	locator->skewValues = NULL;
+	locator->bucketMap = NULL;
 	/* Create node map */
 	switch (listType)
 	{
@@ -806,6 +1216,7 @@ createLocator(char locatorType, RelationAccessType accessType,
 				foreach(lc, l)
 					*intptr++ = lfirst_int(lc);
 				locator->listType = LOCATOR_LIST_INT;
+				nodeIndexes = true;
 			}
 			else if (IsA(l, OidList))
 			{
@@ -833,6 +1244,16 @@ createLocator(char locatorType, RelationAccessType accessType,
 			break;
 		}
 	}
+	/*
+	 * Modulo by power of 2 is just a bit mask, which is much cheaper than
+	 * division.
+	 */
+	if (locator->nodeCount > 0 &&
+			(locator->nodeCount & (locator->nodeCount - 1)) == 0)
+		locator->nodeMask = locator->nodeCount - 1;
+	else
+		locator->nodeMask = -1;
+
 	/*
 	 * Determine locatefunc, allocate results, set up parameters
 	 * specific to locator type
@@ -886,6 +1307,7 @@ createLocator(char locatorType, RelationAccessType accessType,
 			if (accessType == RELATION_ACCESS_INSERT)
 			{
 				locator->locatefunc = locate_roundrobin;
+				locator->locatebatchfunc = locate_roundrobin_batch;
 				locator->nodeMap = nodeMap;
 				switch (locator->listType)
 				{
@@ -924,9 +1346,11 @@ createLocator(char locatorType, RelationAccessType accessType,
 			}
 			break;
 		case LOCATOR_TYPE_HASH:
+		case LOCATOR_TYPE_BUCKET:
 			if (accessType == RELATION_ACCESS_INSERT)
 			{
 				locator->locatefunc = locate_hash_insert;
+				locator->locatebatchfunc = locate_hash_batch;
 				locator->nodeMap = nodeMap;
 				switch (locator->listType)
 				{
@@ -973,11 +1397,35 @@ createLocator(char locatorType, RelationAccessType accessType,
 			if (locator->hashfunc == NULL)
 				ereport(ERROR, (errmsg("Error: unsupported data type for HASH locator: %d\n",
 								   dataType)));
+
+			/* Build the bucket map if the nodes behind the node map are known */
+			if (locatorType == LOCATOR_TYPE_BUCKET && locator->nodeCount > 0 &&
+				(nodeIndexes || locator->listType == LOCATOR_LIST_OID ||
+				 locator->listType == LOCATOR_LIST_POINTER))
+			{
+				uint32	   *nodekeys;
+
+				nodekeys = (uint32 *) palloc(locator->nodeCount * sizeof(uint32));
+				for (i = 0; i < locator->nodeCount; i++)
+				{
+					if (nodeIndexes)
+						nodekeys[i] = get_pgxc_node_id(
+								PGXCNodeGetNodeOid(((int *) nodeMap)[i],
+												   PGXC_NODE_DATANODE));
+					else if (locator->listType == LOCATOR_LIST_OID)
+						nodekeys[i] = get_pgxc_node_id(((Oid *) nodeMap)[i]);
+					else
+						nodekeys[i] = ((PGXCNodeHandle **) nodeMap)[i]->nodeid;
+				}
+				locator_set_bucket_keys(locator, nodekeys);
+				pfree(nodekeys);
+			}
 			break;
 		case LOCATOR_TYPE_MODULO:
 			if (accessType == RELATION_ACCESS_INSERT)
 			{
 				locator->locatefunc = locate_modulo_insert;
+				locator->locatebatchfunc = locate_modulo_batch;
 				locator->nodeMap = nodeMap;
 				switch (locator->listType)
 				{
@@ -1047,10 +1495,150 @@ freeLocator(Locator *locator)
 	 */
 	if (locator->results != locator->nodeMap)
 		pfree(locator->results);
+	if (locator->skewValues)
+		pfree(locator->skewValues);
+	if (locator->bucketMap)
+		pfree(locator->bucketMap);
 	pfree(locator);
 }
 
 
+/*
+ * Make the locator handle hot values apart from the others: rows holding one
+ * of skewValues, a list of Consts compared using the eqfunc function, are
+ * sent to all the nodes if broadcast is true, or spread over the nodes in
+ * round robin manner otherwise. Other values are located as before.
+ *
+ * The result array may be reallocated, so the caller should get it again
+ * with getLocatorResults() afterwards.
+ */
+void
+setLocatorSkew(Locator *self, List *skewValues, Oid eqfunc, Oid collation,
+			   bool broadcast)
+{
+	ListCell   *lc;
+	int			i;
+
+	if (skewValues == NIL || self->nodeCount == 0)
+		return;
+
+	self->nskew = list_length(skewValues);
+	self->skewValues = (Datum *) palloc(self->nskew * sizeof(Datum));
+	i = 0;
+	foreach(lc, skewValues)
+	{
+		Const	   *skewValue = (Const *) lfirst(lc);
+
+		Assert(IsA(skewValue, Const) && !skewValue->constisnull);
+		self->skewValues[i++] = skewValue->constvalue;
+	}
+	fmgr_info(eqfunc, &self->skewEqfunc);
+	self->skewCollation = collation;
+	self->skewBroadcast = broadcast;
+
+	/* Broadcast writes all the nodes to the result array */
+	if (broadcast && self->results != self->nodeMap)
+	{
+		Size		elemsize;
+
+		switch (self->listType)
+		{
+			case LOCATOR_LIST_OID:
+				elemsize = sizeof(Oid);
+				break;
+			case LOCATOR_LIST_POINTER:
+				elemsize = sizeof(void *);
+				break;
+			default:
+				elemsize = sizeof(int);
+				break;
+		}
+		pfree(self->results);
+		self->results = palloc(self->nodeCount * elemsize);
+	}
+
+	/* randomize choice of the initial node */
+	self->roundRobinNode = (abs(rand()) % self->nodeCount) - 1;
+
+	/* Values are no longer located one by one */
+	self->skewLocatefunc = self->locatefunc;
+	self->locatefunc = locate_skewed;
+	self->locatebatchfunc = NULL;
+}
+
+
+/*
+ * Write node reference of the node map index to the result array position
+ */
+static void
+locator_set_result(Locator *self, int pos, int index)
+{
+	switch (self->listType)
+	{
+		case LOCATOR_LIST_NONE:
+			((int *) self->results)[pos] = index;
+			break;
+		case LOCATOR_LIST_INT:
+			((int *) self->results)[pos] = ((int *) self->nodeMap)[index];
+			break;
+		case LOCATOR_LIST_OID:
+			((Oid *) self->results)[pos] = ((Oid *) self->nodeMap)[index];
+			break;
+		case LOCATOR_LIST_POINTER:
+			((void **) self->results)[pos] = ((void **) self->nodeMap)[index];
+			break;
+		case LOCATOR_LIST_LIST:
+			/* Should never happen */
+			Assert(false);
+			break;
+	}
+}
+
+
+/*
+ * Locate hot values to all nodes or to the next node in round robin manner,
+ * other values as the locator would do without them.
+ */
+static int
+locate_skewed(Locator *self, Datum value, bool isnull,
+			  bool *hasprimary)
+{
+	int			i;
+
+	if (!isnull)
+	{
+		for (i = 0; i < self->nskew; i++)
+		{
+			if (!DatumGetBool(FunctionCall2Coll(&self->skewEqfunc,
+												self->skewCollation,
+												value,
+												self->skewValues[i])))
+				continue;
+
+			if (hasprimary)
+				*hasprimary = false;
+
+			if (self->skewBroadcast)
+			{
+				int			j;
+
+				if (self->results != self->nodeMap)
+					for (j = 0; j < self->nodeCount; j++)
+						locator_set_result(self, j, j);
+				return self->nodeCount;
+			}
+
+			if (++self->roundRobinNode >= self->nodeCount)
+				self->roundRobinNode = 0;
+			locator_set_result(self, 0, self->roundRobinNode);
+			return 1;
+		}
+	}
+
+	return (*self->skewLocatefunc) (self, value, isnull, hasprimary);
+}
+
+
 /*
  * Each time return the same predefined results
  */
@@ -1154,14 +1742,14 @@ locate_hash_insert(Locator *self, Datum value, bool isnull,
 	if (hasprimary)
 		*hasprimary = false;
 	if (isnull)
-		index = 0;
+		index = locator_null_index(self);
 	else
 	{
 		unsigned int hash32;
 
-		hash32 = (unsigned int) DatumGetInt32(DirectFunctionCall1(self->hashfunc, value));
+		hash32 = locator_hash(self, value);
 
-		index = compute_modulo(hash32, self->nodeCount);
+		index = locator_hash_index(self, hash32);
 	}
 	switch (self->listType)
 	{
@@ -1229,9 +1817,9 @@ locate_hash_select(Locator *self, Datum value, bool isnull,
 		unsigned int hash32;
 		int 		 index;
 
-		hash32 = (unsigned int) DatumGetInt32(DirectFunctionCall1(self->hashfunc, value));
+		hash32 = locator_hash(self, value);
 
-		index = compute_modulo(hash32, self->nodeCount);
+		index = locator_hash_index(self, hash32);
 		switch (self->listType)
 		{
 			case LOCATOR_LIST_NONE:
@@ -1283,7 +1871,7 @@ locate_modulo_insert(Locator *self, Datum value, bool isnull,
 		else
 			val = 0;
 
-		index = compute_modulo(val, self->nodeCount);
+		index = locator_modulo(self, val);
 	}
 	switch (self->listType)
 	{
@@ -1362,7 +1950,7 @@ locate_modulo_select(Locator *self, Datum value, bool isnull,
 		else
 			val = 0;
 
-		index = compute_modulo(val, self->nodeCount);
+		index = locator_modulo(self, val);
 
 		switch (self->listType)
 		{
@@ -1388,6 +1976,101 @@ locate_modulo_select(Locator *self, Datum value, bool isnull,
 }
 
 
+/*
+ * Batch version of locate_roundrobin
+ */
+static void
+locate_roundrobin_batch(Locator *self, int nvalues, Datum *values,
+						bool *nulls, int *indexes)
+{
+	int			node = self->roundRobinNode;
+	int			i;
+
+	for (i = 0; i < nvalues; i++)
+	{
+		if (++node >= self->nodeCount)
+			node = 0;
+		indexes[i] = node;
+	}
+	self->roundRobinNode = node;
+}
+
+
+/*
+ * Batch version of locate_hash_insert
+ */
+static void
+locate_hash_batch(Locator *self, int nvalues, Datum *values,
+				  bool *nulls, int *indexes)
+{
+	int			i;
+
+	switch (self->dataType)
+	{
+		case INT4OID:
+			/* The most common case, keep the loop tight */
+			for (i = 0; i < nvalues; i++)
+			{
+				uint32		hash32;
+
+				if (nulls[i])
+				{
+					indexes[i] = locator_null_index(self);
+					continue;
+				}
+				hash32 = DatumGetUInt32(hash_uint32(DatumGetInt32(values[i])));
+				indexes[i] = locator_hash_index(self, hash32);
+			}
+			break;
+		default:
+			for (i = 0; i < nvalues; i++)
+			{
+				if (nulls[i])
+					indexes[i] = locator_null_index(self);
+				else
+					indexes[i] = locator_hash_index(self,
+													locator_hash(self, values[i]));
+			}
+			break;
+	}
+}
+
+
+/*
+ * Batch version of locate_modulo_insert
+ */
+static void
+locate_modulo_batch(Locator *self, int nvalues, Datum *values,
+					bool *nulls, int *indexes)
+{
+	int			i;
+
+	for (i = 0; i < nvalues; i++)
+	{
+		uint64		val;
+
+		if (nulls[i])
+		{
+			indexes[i] = 0;
+			continue;
+		}
+
+		if (self->valuelen == 8)
+			val = (uint64) (GET_8_BYTES(values[i]));
+		else if (self->valuelen == 4)
+			val = (uint64) (GET_4_BYTES(values[i]));
+		else if (self->valuelen == 2)
+			val = (uint64) (GET_2_BYTES(values[i]));
+		else if (self->valuelen == 1)
+			val = (uint64) (GET_1_BYTE(values[i]));
+		else
+			val = 0;
+
+		indexes[i] = locator_modulo(self, val);
+	}
+}
+
+
 int
 GET_NODES(Locator *self, Datum value, bool isnull, bool *hasprimary)
 {
@@ -1395,6 +2078,31 @@ GET_NODES(Locator *self, Datum value, bool isnull, bool *hasprimary)
 }
 
 
+/*
+ * Returns true if the locator can determine target nodes for a batch of
+ * values, that is if there is always exactly one target node for a value.
+ */
+bool
+canLocateBatch(Locator *self)
+{
+	return self->locatebatchfunc != NULL;
+}
+
+
+/*
+ * Determine target nodes for array of values.
+ * Index of target node of each value, referencing the node map, is written
+ * to the indexes array.
+ */
+void
+GET_NODES_BATCH(Locator *self, int nvalues, Datum *values, bool *nulls,
+				int *indexes)
+{
+	Assert(self->locatebatchfunc);
+	(*self->locatebatchfunc) (self, nvalues, values, nulls, indexes);
+}
+
+
 void *
 getLocatorResults(Locator *self)
 {
@@ -1486,6 +2194,14 @@ GetRelationNodes(RelationLocInfo *rel_loc_info, Datum valueForDistCol,
  * A wrapper around GetRelationNodes to reduce the node list by looking at the
  * quals. varno is assumed to be the varno of reloid inside the quals. No check
  * is made to see if that's correct.
+ *
+ * Only an equality on the distribution column can prune nodes.  Quals on
+ * other columns, even ones strongly correlated with the node a row lands on,
+ * are left to each Datanode, where BRIN or other indexes prune locally.
+ * Pruning on them here would need per-node summaries of the column kept
+ * current on the Coordinators, and every write on a Datanode that widened a
+ * summary would have to reach all Coordinators before its transaction
+ * commits, or a plan could skip a node holding matching rows.
  */
 ExecNodes *
 GetRelationNodesByQuals(Oid reloid, RelationLocInfo *rel_loc_info,
@@ -21,15 +21,20 @@
 #include "catalog/pg_type.h"
 #include "catalog/pgxc_node.h"
 #include "commands/tablecmds.h"
+#include "executor/spi.h"
 #include "pgxc/copyops.h"
 #include "pgxc/execRemote.h"
 #include "pgxc/pgxc.h"
 #include "pgxc/redistrib.h"
 #include "pgxc/remotecopy.h"
+#include "utils/builtins.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
 #include "utils/snapmgr.h"
 
+/* Number of COPY messages sent down at once when redistributing */
+#define REDISTRIB_BATCH_SIZE 1000
+
 #define IsCommandTypePreUpdate(x) (x == CATALOG_UPDATE_BEFORE || \
 								   x == CATALOG_UPDATE_BOTH)
 #define IsCommandTypePostUpdate(x) (x == CATALOG_UPDATE_AFTER || \
@@ -40,9 +45,16 @@ static void distrib_execute_query(char *sql, bool is_temp, ExecNodes *exec_nodes
 static void distrib_execute_command(RedistribState *distribState, RedistribCommand *command);
 static void distrib_copy_to(RedistribState *distribState);
 static void distrib_copy_from(RedistribState *distribState, ExecNodes *exec_nodes);
+static void distrib_copy_batch(RemoteCopyData *copyState, int nbatch,
+				   char **data, int *lens, Datum *values, bool *nulls,
+				   int *indexes);
 static void distrib_truncate(RedistribState *distribState, ExecNodes *exec_nodes);
 static void distrib_reindex(RedistribState *distribState, ExecNodes *exec_nodes);
 static void distrib_delete_hash(RedistribState *distribState, ExecNodes *exec_nodes);
+static void distrib_delete_bucket(RedistribState *distribState, ExecNodes *exec_nodes);
+static void distrib_stage_out(RedistribState *distribState);
+static void distrib_stage_in(RedistribState *distribState);
+static void distrib_execute_spi(char *sql, int expected);
 
 /* Functions used to build the command list */
 static void pgxc_redist_build_entry(RedistribState *distribState,
@@ -55,8 +67,18 @@ static void pgxc_redist_build_replicate_to_distrib(RedistribState *distribState,
 								RelationLocInfo *oldLocInfo,
 								RelationLocInfo *newLocInfo);
 
-static void pgxc_redist_build_default(RedistribState *distribState);
+static void pgxc_redist_build_bucket(RedistribState *distribState,
+								RelationLocInfo *oldLocInfo,
+								RelationLocInfo *newLocInfo);
+static void pgxc_redist_build_default(RedistribState *distribState,
+								RelationLocInfo *newLocInfo);
+static bool pgxc_redist_build_staging(RedistribState *distribState,
+								RelationLocInfo *newLocInfo);
 static void pgxc_redist_add_reindex(RedistribState *distribState);
+static bool pgxc_redist_bucket_expr(StringInfo buf, Relation rel,
+								RelationLocInfo *locInfo);
+static void pgxc_redist_bucket_map(List *nodeList, int *map, uint32 **nodekeys);
+static void pgxc_redist_bucket_array(StringInfo buf, bool *buckets);
 
 
 /*
@@ -134,10 +156,13 @@ pgxc_redist_build_entry(RedistribState *distribState,
 	/* Evaluate cases for replicated to distributed tables */
 	pgxc_redist_build_replicate_to_distrib(distribState, oldLocInfo, newLocInfo);
 
+	/* Evaluate cases for bucket distributed tables */
+	pgxc_redist_build_bucket(distribState, oldLocInfo, newLocInfo);
+
 	/* PGXCTODO: perform more complex builds of command list */
 
 	/* Fallback to default */
-	pgxc_redist_build_default(distribState);
+	pgxc_redist_build_default(distribState, newLocInfo);
 }
 
 
@@ -191,18 +216,15 @@ pgxc_redist_build_replicate_to_distrib(RedistribState *distribState,
 	 * is sufficient so leave here.
 	 */
 	if (list_length(newLocInfo->rl_nodeList) == 1)
-	{
-		/* Add REINDEX command if necessary */
-		pgxc_redist_add_reindex(distribState);
 		return;
-	}
 
 	/*
 	 * If we are here we are sure that redistribution only requires to delete data on remote
 	 * nodes on the new subset of nodes. So launch to remote nodes a DELETE command that only
 	 * eliminates the data not verifying the new hashing condition.
 	 */
-	if (newLocInfo->locatorType == LOCATOR_TYPE_HASH)
+	if (newLocInfo->locatorType == LOCATOR_TYPE_HASH ||
+		newLocInfo->locatorType == LOCATOR_TYPE_BUCKET)
 	{
 		ExecNodes *execNodes = makeNode(ExecNodes);
 		execNodes->nodeList = newLocInfo->rl_nodeList;
@@ -284,8 +306,305 @@ pgxc_redist_build_replicate(RedistribState *distribState,
 					 makeRedistribCommand(DISTRIB_COPY_FROM, CATALOG_UPDATE_AFTER, execNodes));
 	}
 
-	/* Add REINDEX command if necessary */
-	pgxc_redist_add_reindex(distribState);
+	/*
+	 * No REINDEX: the nodes kept are not touched and the new ones have their
+	 * indexes built by COPY FROM.
+	 */
+}
+
+
+/*
+ * pgxc_redist_build_bucket
+ * Build redistribution command list for a bucket distributed table whose set
+ * of nodes is changed. The owner of a bucket depends only on the set of
+ * nodes, so the buckets staying on their node are not touched at all: only
+ * the rows of the buckets whose owner changes are fetched, deleted where they
+ * were and sent to their new owner.
+ */
+static void
+pgxc_redist_build_bucket(RedistribState *distribState,
+						 RelationLocInfo *oldLocInfo,
+						 RelationLocInfo *newLocInfo)
+{
+	Relation	rel;
+	int		   *oldMap;
+	int		   *newMap;
+	uint32	   *oldKeys;
+	uint32	   *newKeys;
+	bool	   *moved;
+	bool		anyMoved = false;
+	List	   *removedNodes;
+	List	   *deleteNodes = NIL;
+	StringInfoData buf;
+	bool		direct;
+	int			bucket;
+
+	/* If a command list has already been built, nothing to do */
+	if (list_length(distribState->commands) != 0)
+		return;
+
+	/* Only the set of nodes of the table may change */
+	if (oldLocInfo->locatorType != LOCATOR_TYPE_BUCKET ||
+		newLocInfo->locatorType != LOCATOR_TYPE_BUCKET ||
+		oldLocInfo->partAttrNum != newLocInfo->partAttrNum)
+		return;
+
+	rel = relation_open(distribState->relid, NoLock);
+
+	/* Build the expression of the bucket of a row */
+	initStringInfo(&buf);
+	if (!pgxc_redist_bucket_expr(&buf, rel, newLocInfo))
+	{
+		/* Turn back to default */
+		relation_close(rel, NoLock);
+		pfree(buf.data);
+		return;
+	}
+	relation_close(rel, NoLock);
+
+	/* Find out the buckets changing owner */
+	oldMap = (int *) palloc(HASH_SIZE * sizeof(int));
+	newMap = (int *) palloc(HASH_SIZE * sizeof(int));
+	pgxc_redist_bucket_map(oldLocInfo->rl_nodeList, oldMap, &oldKeys);
+	pgxc_redist_bucket_map(newLocInfo->rl_nodeList, newMap, &newKeys);
+
+	moved = (bool *) palloc0(HASH_SIZE * sizeof(bool));
+	for (bucket = 0; bucket < HASH_SIZE; bucket++)
+	{
+		int			oldOwner = oldMap[bucket];
+
+		if (oldKeys[oldOwner] == newKeys[newMap[bucket]])
+			continue;
+
+		moved[bucket] = true;
+		anyMoved = true;
+
+		/* The old owner has to delete the bucket if it stays in the table */
+		if (list_member_int(newLocInfo->rl_nodeList,
+							list_nth_int(oldLocInfo->rl_nodeList, oldOwner)))
+			deleteNodes = list_append_unique_int(deleteNodes,
+						list_nth_int(oldLocInfo->rl_nodeList, oldOwner));
+	}
+
+	pfree(oldMap);
+	pfree(newMap);
+	pfree(oldKeys);
+	pfree(newKeys);
+
+	/*
+	 * A node added to the table winning no bucket is very unlikely, just turn
+	 * back to default then.
+	 */
+	if (!anyMoved)
+	{
+		pfree(moved);
+		pfree(buf.data);
+		return;
+	}
+
+	/* Nodes removed have lost all of their buckets */
+	removedNodes = list_difference_int(oldLocInfo->rl_nodeList,
+									   newLocInfo->rl_nodeList);
+
+	/* Build the qual selecting the rows moved */
+	appendStringInfoString(&buf, " = ANY (");
+	pgxc_redist_bucket_array(&buf, moved);
+	appendStringInfoChar(&buf, ')');
+	distribState->bucketQual = buf.data;
+
+	/*
+	 * Fetch the rows moved, directly to the new owners if possible and to
+	 * Coordinator otherwise.
+	 */
+	direct = pgxc_redist_build_staging(distribState, newLocInfo);
+	distribState->commands = lappend(distribState->commands,
+					 makeRedistribCommand(direct ? DISTRIB_STAGE_OUT : DISTRIB_COPY_TO,
+										  CATALOG_UPDATE_BEFORE, NULL));
+
+	/* Nodes removed have to be truncated */
+	if (removedNodes != NIL)
+	{
+		ExecNodes *execNodes = makeNode(ExecNodes);
+		execNodes->nodeList = removedNodes;
+		distribState->commands = lappend(distribState->commands,
+					 makeRedistribCommand(DISTRIB_TRUNCATE, CATALOG_UPDATE_BEFORE, execNodes));
+	}
+
+	/* Nodes kept delete the buckets they hand over */
+	if (deleteNodes != NIL)
+	{
+		ExecNodes *execNodes = makeNode(ExecNodes);
+		execNodes->nodeList = deleteNodes;
+		distribState->commands = lappend(distribState->commands,
+					 makeRedistribCommand(DISTRIB_DELETE_BUCKET, CATALOG_UPDATE_BEFORE, execNodes));
+	}
+
+	/*
+	 * Send the rows to their new owners. The locator of the new distribution
+	 * never sends a row to the node it has been fetched from.
+	 */
+	distribState->commands = lappend(distribState->commands,
+					 makeRedistribCommand(direct ? DISTRIB_STAGE_IN : DISTRIB_COPY_FROM,
+										  CATALOG_UPDATE_AFTER, NULL));
+
+	/* The DELETE leaves dead index entries behind */
+	if (deleteNodes != NIL)
+		pgxc_redist_add_reindex(distribState);
+
+	pfree(moved);
+}
+
+
+/*
+ * pgxc_redist_bucket_expr
+ * Append to buf the SQL expression computing the bucket of a row of a table
+ * distributed by bucket, the same way the locator does. Rows with NULL value
+ * are placed in the first bucket. Returns false if the distribution column
+ * could not be hashed remotely.
+ */
+static bool
+pgxc_redist_bucket_expr(StringInfo buf, Relation rel, RelationLocInfo *locInfo)
+{
+	TupleDesc	tupDesc = RelationGetDescr(rel);
+	Oid			hashtype;
+	char	   *hashfuncname;
+
+	hashtype = tupDesc->attrs[locInfo->partAttrNum - 1]->atttypid;
+	hashfuncname = get_compute_hash_function(hashtype, LOCATOR_TYPE_HASH);
+	if (hashfuncname == NULL)
+		return false;
+
+	/* See distrib_delete_hash about the modulo 2^32 computation */
+	appendStringInfo(buf, "COALESCE(((2^32 + %s(%s))::bigint %% (2^32)::bigint) %% %d, 0)",
+					 hashfuncname, quote_identifier(locInfo->partAttrName),
+					 HASH_SIZE);
+	return true;
+}
+
+
+/*
+ * pgxc_redist_bucket_map
+ * Compute the bucket map of a list of Datanodes. The identifiers of the nodes
+ * are returned in nodekeys, palloc'd.
+ */
+static void
+pgxc_redist_bucket_map(List *nodeList, int *map, uint32 **nodekeys)
+{
+	ListCell   *lc;
+	int			i = 0;
+
+	*nodekeys = (uint32 *) palloc(list_length(nodeList) * sizeof(uint32));
+	foreach(lc, nodeList)
+		(*nodekeys)[i++] = get_pgxc_node_id(PGXCNodeGetNodeOid(lfirst_int(lc),
+														PGXC_NODE_DATANODE));
+	GetBucketMap(list_length(nodeList), *nodekeys, map);
+}
+
+
+/*
+ * pgxc_redist_bucket_array
+ * Append to buf the integer array literal of the buckets set in buckets.
+ */
+static void
+pgxc_redist_bucket_array(StringInfo buf, bool *buckets)
+{
+	bool		first = true;
+	int			bucket;
+
+	appendStringInfoString(buf, "'{");
+	for (bucket = 0; bucket < HASH_SIZE; bucket++)
+	{
+		if (!buckets[bucket])
+			continue;
+		if (!first)
+			appendStringInfoChar(buf, ',');
+		appendStringInfo(buf, "%d", bucket);
+		first = false;
+	}
+	appendStringInfoString(buf, "}'::integer[]");
+}
+
+
+/*
+ * pgxc_redist_build_staging
+ * Check if the data can be moved directly between Datanodes, through a
+ * staging table distributed the new way: INSERT ... SELECT from the table
+ * to the staging table is planned as any other redistribution, Datanodes
+ * sending the rows to their new Datanode over shared queues, then after the
+ * catalog update the rows are moved back with INSERT ... SELECT again, which
+ * is local on each Datanode as both tables are distributed the same way.
+ * The data never goes through Coordinator. Temporary tables and tables with
+ * children keep going through Coordinator.
+ */
+static bool
+pgxc_redist_build_staging(RedistribState *distribState,
+						  RelationLocInfo *newLocInfo)
+{
+	Relation	rel;
+	StringInfoData buf;
+	ListCell   *lc;
+	bool		first = true;
+	char		relname[NAMEDATALEN];
+
+	if (IsTempTable(distribState->relid))
+		return false;
+
+	rel = relation_open(distribState->relid, NoLock);
+	if (rel->rd_rel->relkind != RELKIND_RELATION ||
+		rel->rd_rel->relhassubclass)
+	{
+		relation_close(rel, NoLock);
+		return false;
+	}
+
+	initStringInfo(&buf);
+	switch (newLocInfo->locatorType)
+	{
+		case LOCATOR_TYPE_HASH:
+			appendStringInfo(&buf, "DISTRIBUTE BY HASH (%s)",
+							 quote_identifier(newLocInfo->partAttrName));
+			break;
+		case LOCATOR_TYPE_MODULO:
+			appendStringInfo(&buf, "DISTRIBUTE BY MODULO (%s)",
+							 quote_identifier(newLocInfo->partAttrName));
+			break;
+		case LOCATOR_TYPE_BUCKET:
+			appendStringInfo(&buf, "DISTRIBUTE BY BUCKET (%s)",
+							 quote_identifier(newLocInfo->partAttrName));
+			break;
+		case LOCATOR_TYPE_RROBIN:
+			appendStringInfoString(&buf, "DISTRIBUTE BY ROUNDROBIN");
+			break;
+		case LOCATOR_TYPE_REPLICATED:
+			appendStringInfoString(&buf, "DISTRIBUTE BY REPLICATION");
+			break;
+		default:
+			relation_close(rel, NoLock);
+			pfree(buf.data);
+			return false;
+	}
+
+	appendStringInfoString(&buf, " TO NODE (");
+	foreach(lc, newLocInfo->rl_nodeList)
+	{
+		Oid			nodeoid = PGXCNodeGetNodeOid(lfirst_int(lc),
+												 PGXC_NODE_DATANODE);
+
+		if (!first)
+			appendStringInfoString(&buf, ", ");
+		appendStringInfoString(&buf, quote_identifier(get_pgxc_nodename(nodeoid)));
+		first = false;
+	}
+	appendStringInfoChar(&buf, ')');
+	distribState->stagingDistrib = buf.data;
+
+	/* Staging table is created next to the table */
+	snprintf(relname, NAMEDATALEN, "pgxc_redistrib_%u", distribState->relid);
+	distribState->stagingName = quote_qualified_identifier(
+			get_namespace_name(RelationGetNamespace(rel)), relname);
+
+	relation_close(rel, NoLock);
+	return true;
 }
 
 
@@ -293,14 +612,28 @@ pgxc_redist_build_replicate(RedistribState *distribState,
  * pgxc_redist_build_default
  * Build a default list consisting of
  * COPY TO -> TRUNCATE -> COPY FROM ( -> REINDEX )
+ * or, if the data can be moved between Datanodes directly,
+ * STAGE OUT -> TRUNCATE -> STAGE IN
  */
 static void
-pgxc_redist_build_default(RedistribState *distribState)
+pgxc_redist_build_default(RedistribState *distribState,
+						  RelationLocInfo *newLocInfo)
 {
 	/* If a command list has already been built, nothing to do */
 	if (list_length(distribState->commands) != 0)
 		return;
 
+	if (pgxc_redist_build_staging(distribState, newLocInfo))
+	{
+		distribState->commands = lappend(distribState->commands,
+					 makeRedistribCommand(DISTRIB_STAGE_OUT, CATALOG_UPDATE_BEFORE, NULL));
+		distribState->commands = lappend(distribState->commands,
+					 makeRedistribCommand(DISTRIB_TRUNCATE, CATALOG_UPDATE_BEFORE, NULL));
+		distribState->commands = lappend(distribState->commands,
+					 makeRedistribCommand(DISTRIB_STAGE_IN, CATALOG_UPDATE_AFTER, NULL));
+		return;
+	}
+
 	/* COPY TO command */
 	distribState->commands = lappend(distribState->commands,
 					 makeRedistribCommand(DISTRIB_COPY_TO, CATALOG_UPDATE_BEFORE, NULL));
@@ -311,14 +644,18 @@ pgxc_redist_build_default(RedistribState *distribState)
 	distribState->commands = lappend(distribState->commands,
 					 makeRedistribCommand(DISTRIB_COPY_FROM, CATALOG_UPDATE_AFTER, NULL));
 
-	/* REINDEX command */
-	pgxc_redist_add_reindex(distribState);
+	/*
+	 * No REINDEX: TRUNCATE empties the indexes and COPY FROM fills them in
+	 * again, rebuilding them would only keep the table locked longer.
+	 */
 }
 
 
 /*
  * pgxc_redist_build_reindex
- * Add a reindex command if necessary
+ * Add a reindex command if necessary. This is only worth it after a partial
+ * DELETE, which leaves the indexes full of dead entries; where data is
+ * reloaded with COPY FROM the indexes are maintained as the rows come in.
  */
 static void
 pgxc_redist_add_reindex(RedistribState *distribState)
@@ -375,6 +712,18 @@ distrib_execute_command(RedistribState *distribState, RedistribCommand *command)
 			distrib_delete_hash(distribState, command->execNodes);
 			command_str = "Redistribution step: delete tuples";
 			break;
+		case DISTRIB_DELETE_BUCKET:
+			distrib_delete_bucket(distribState, command->execNodes);
+			command_str = "Redistribution step: delete moved buckets";
+			break;
+		case DISTRIB_STAGE_OUT:
+			distrib_stage_out(distribState);
+			command_str = "Redistribution step: move tuples to staging table";
+			break;
+		case DISTRIB_STAGE_IN:
+			distrib_stage_in(distribState);
+			command_str = "Redistribution step: move tuples from staging table";
+			break;
 		case DISTRIB_NONE:
 		default:
 			Assert(0); /* Should not happen */
@@ -417,6 +766,23 @@ distrib_copy_to(RedistribState *distribState)
 	RemoteCopy_GetRelationLoc(copyState, rel, NIL);
 	RemoteCopy_BuildStatement(copyState, rel, options, NIL, NIL);
 
+	/*
+	 * Fetch only the rows moved if they are known. SELECT * returns the same
+	 * columns as COPY of the whole relation does.
+	 */
+	if (distribState->bucketQual)
+	{
+		resetStringInfo(&copyState->query_buf);
+		appendStringInfo(&copyState->query_buf,
+						 "COPY (SELECT * FROM %s WHERE %s) TO STDOUT",
+						 rel->rd_backend == MyBackendId ?
+						 quote_identifier(RelationGetRelationName(rel)) :
+						 quote_qualified_identifier(
+								get_namespace_name(RelationGetNamespace(rel)),
+								RelationGetRelationName(rel)),
+						 distribState->bucketQual);
+	}
+
 	/* Inform client of operation being done */
 	ereport(DEBUG1,
 			(errmsg("Copying data for relation \"%s.%s\"",
@@ -447,6 +813,33 @@ distrib_copy_to(RedistribState *distribState)
 }
 
 
+/*
+ * distrib_copy_batch
+ * Send collected COPY messages to remote nodes, target nodes of all the
+ * messages are determined at once. The messages are freed.
+ */
+static void
+distrib_copy_batch(RemoteCopyData *copyState, int nbatch, char **data,
+				   int *lens, Datum *values, bool *nulls, int *indexes)
+{
+	PGXCNodeHandle **connections;
+	int			i;
+
+	GET_NODES_BATCH(copyState->locator, nbatch, values, nulls, indexes);
+
+	connections = (PGXCNodeHandle **) getLocatorNodeMap(copyState->locator);
+	for (i = 0; i < nbatch; i++)
+	{
+		if (DataNodeCopyIn(data[i], lens[i], 1, &connections[indexes[i]],
+						   false))
+			ereport(ERROR,
+					(errcode(ERRCODE_CONNECTION_EXCEPTION),
+					 errmsg("Copy failed on a data node")));
+		pfree(data[i]);
+	}
+}
+
+
 /*
  * PGXCDistribTableCopyFrom
  * Execute commands related to COPY FROM
@@ -466,6 +859,13 @@ distrib_copy_from(RedistribState *distribState, ExecNodes *exec_nodes)
 	FmgrInfo 	in_function;
 	Oid 		typioparam;
 	int 		typmod = 0;
+	/* Messages collected to be sent down at once */
+	int			nbatch = 0;
+	char	  **batchData = NULL;
+	int		   *batchLens = NULL;
+	Datum	   *batchValues = NULL;
+	bool	   *batchNulls = NULL;
+	int		   *batchIndexes = NULL;
 
 	/* Nothing to do if on remote node */
 	if (IS_PGXC_DATANODE || IsConnFromCoord())
@@ -529,6 +929,19 @@ distrib_copy_from(RedistribState *distribState, ExecNodes *exec_nodes)
 
 	DataNodeCopyBegin(copyState);
 
+	/*
+	 * If the locator supports it, collect the messages and determine their
+	 * target nodes all at once.
+	 */
+	if (canLocateBatch(copyState->locator))
+	{
+		batchData = (char **) palloc(REDISTRIB_BATCH_SIZE * sizeof(char *));
+		batchLens = (int *) palloc(REDISTRIB_BATCH_SIZE * sizeof(int));
+		batchValues = (Datum *) palloc(REDISTRIB_BATCH_SIZE * sizeof(Datum));
+		batchNulls = (bool *) palloc(REDISTRIB_BATCH_SIZE * sizeof(bool));
+		batchIndexes = (int *) palloc(REDISTRIB_BATCH_SIZE * sizeof(int));
+	}
+
 	/* Send each COPY message stored to remote nodes */
 	while (true)
 	{
@@ -571,6 +984,21 @@ distrib_copy_from(RedistribState *distribState, ExecNodes *exec_nodes)
 			pfree(fields);
 		}
 
+		if (batchData)
+		{
+			batchData[nbatch] = data;
+			batchLens[nbatch] = len;
+			batchValues[nbatch] = value;
+			batchNulls[nbatch] = is_null;
+			if (++nbatch == REDISTRIB_BATCH_SIZE)
+			{
+				distrib_copy_batch(copyState, nbatch, batchData, batchLens,
+								   batchValues, batchNulls, batchIndexes);
+				nbatch = 0;
+			}
+			continue;
+		}
+
 		if (DataNodeCopyIn(data, len,
 						   GET_NODES(copyState->locator, value, is_null, NULL),
 						   (PGXCNodeHandle**)
@@ -583,6 +1011,12 @@ distrib_copy_from(RedistribState *distribState, ExecNodes *exec_nodes)
 		/* Clean up */
 		pfree(data);
 	}
+
+	/* Send remaining messages */
+	if (nbatch > 0)
+		distrib_copy_batch(copyState, nbatch, batchData, batchLens,
+						   batchValues, batchNulls, batchIndexes);
+
 	DataNodeCopyFinish(getLocatorNodeCount(copyState->locator),
 			(PGXCNodeHandle **) getLocatorNodeMap(copyState->locator));
 
@@ -745,7 +1179,8 @@ distrib_delete_hash(RedistribState *distribState, ExecNodes *exec_nodes)
 		hashfuncname = get_compute_hash_function(hashtype, locinfo->locatorType);
 
 		/* Get distribution column name */
-		if (locinfo->locatorType == LOCATOR_TYPE_HASH)
+		if (locinfo->locatorType == LOCATOR_TYPE_HASH ||
+			locinfo->locatorType == LOCATOR_TYPE_BUCKET)
 			colname = GetRelationHashColumn(locinfo);
 		else if (locinfo->locatorType == LOCATOR_TYPE_MODULO)
 			colname = GetRelationModuloColumn(locinfo);
@@ -784,7 +1219,32 @@ distrib_delete_hash(RedistribState *distribState, ExecNodes *exec_nodes)
 		 * all the time, this is determined implicitely by get_compute_hash_function.
 		 */
 		buf2 = makeStringInfo();
-		if (hashfuncname)
+		if (locinfo->locatorType == LOCATOR_TYPE_BUCKET)
+		{
+			/* Keep the buckets owned by the node */
+			int		   *map = (int *) palloc(HASH_SIZE * sizeof(int));
+			bool	   *owned = (bool *) palloc(HASH_SIZE * sizeof(bool));
+			uint32	   *nodekeys;
+			int			bucket;
+
+			pgxc_redist_bucket_map(locinfo->rl_nodeList, map, &nodekeys);
+			for (bucket = 0; bucket < HASH_SIZE; bucket++)
+				owned[bucket] = (map[bucket] == nodepos);
+
+			appendStringInfo(buf2, "%s WHERE ", buf->data);
+			if (!pgxc_redist_bucket_expr(buf2, rel, locinfo))
+				ereport(ERROR,
+						(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+						 errmsg("Incorrect redistribution operation")));
+			appendStringInfoString(buf2, " <> ALL (");
+			pgxc_redist_bucket_array(buf2, owned);
+			appendStringInfoChar(buf2, ')');
+
+			pfree(map);
+			pfree(owned);
+			pfree(nodekeys);
+		}
+		else if (hashfuncname)
 			appendStringInfo(buf2, "%s WHERE ((2^32 + %s(%s))::bigint %% (2^32)::bigint) %% %d != %d",
 							 buf->data, hashfuncname, colname,
 							 list_length(locinfo->rl_nodeList), nodepos);
@@ -808,6 +1268,161 @@ distrib_delete_hash(RedistribState *distribState, ExecNodes *exec_nodes)
 }
 
 
+/*
+ * distrib_delete_bucket
+ * Delete the rows of the buckets moved to other nodes, determined when
+ * building the command list, from the nodes holding them.
+ */
+static void
+distrib_delete_bucket(RedistribState *distribState, ExecNodes *exec_nodes)
+{
+	Relation	rel;
+	StringInfoData buf;
+	Oid			relOid = distribState->relid;
+
+	/* Nothing to do if on remote node */
+	if (IS_PGXC_DATANODE || IsConnFromCoord())
+		return;
+
+	Assert(distribState->bucketQual);
+
+	/* A sufficient lock level needs to be taken at a higher level */
+	rel = relation_open(relOid, NoLock);
+
+	/* Inform client of operation being done */
+	ereport(DEBUG1,
+			(errmsg("Deleting moved buckets of \"%s.%s\"",
+					get_namespace_name(RelationGetNamespace(rel)),
+					RelationGetRelationName(rel))));
+
+	initStringInfo(&buf);
+	appendStringInfo(&buf, "DELETE FROM %s.%s WHERE %s",
+					 get_namespace_name(RelationGetNamespace(rel)),
+					 RelationGetRelationName(rel),
+					 distribState->bucketQual);
+
+	relation_close(rel, NoLock);
+
+	/* Execute the query */
+	distrib_execute_query(buf.data, IsTempTable(relOid), exec_nodes);
+
+	pfree(buf.data);
+}
+
+
+/*
+ * distrib_stage_out
+ * Create the staging table, distributed the new way, and move to it the rows
+ * of the table, all of them or those matching the bucket qual. The rows are
+ * sent by the Datanodes holding them to the Datanodes of the staging table.
+ */
+static void
+distrib_stage_out(RedistribState *distribState)
+{
+	Relation	rel;
+	StringInfoData buf;
+	char	   *relname;
+
+	/* Nothing to do if on remote node */
+	if (IS_PGXC_DATANODE || IsConnFromCoord())
+		return;
+
+	/* A sufficient lock level needs to be taken at a higher level */
+	rel = relation_open(distribState->relid, NoLock);
+	relname = quote_qualified_identifier(
+			get_namespace_name(RelationGetNamespace(rel)),
+			RelationGetRelationName(rel));
+
+	/* Inform client of operation being done */
+	ereport(DEBUG1,
+			(errmsg("Moving data of relation %s to %s",
+					relname, distribState->stagingName)));
+
+	relation_close(rel, NoLock);
+
+	initStringInfo(&buf);
+	appendStringInfo(&buf, "CREATE TABLE %s (LIKE %s) %s",
+					 distribState->stagingName, relname,
+					 distribState->stagingDistrib);
+	distrib_execute_spi(buf.data, SPI_OK_UTILITY);
+
+	resetStringInfo(&buf);
+	appendStringInfo(&buf, "INSERT INTO %s SELECT * FROM ONLY %s",
+					 distribState->stagingName, relname);
+	if (distribState->bucketQual)
+		appendStringInfo(&buf, " WHERE %s", distribState->bucketQual);
+	distrib_execute_spi(buf.data, SPI_OK_INSERT);
+
+	pfree(buf.data);
+}
+
+
+/*
+ * distrib_stage_in
+ * Move the rows back from the staging table to the table, now distributed
+ * the same way, and drop the staging table.
+ */
+static void
+distrib_stage_in(RedistribState *distribState)
+{
+	Relation	rel;
+	StringInfoData buf;
+	char	   *relname;
+
+	/* Nothing to do if on remote node */
+	if (IS_PGXC_DATANODE || IsConnFromCoord())
+		return;
+
+	/* A sufficient lock level needs to be taken at a higher level */
+	rel = relation_open(distribState->relid, NoLock);
+	relname = quote_qualified_identifier(
+			get_namespace_name(RelationGetNamespace(rel)),
+			RelationGetRelationName(rel));
+
+	/* Inform client of operation being done */
+	ereport(DEBUG1,
+			(errmsg("Moving data of relation %s from %s",
+					relname, distribState->stagingName)));
+
+	relation_close(rel, NoLock);
+
+	initStringInfo(&buf);
+	appendStringInfo(&buf, "INSERT INTO %s SELECT * FROM %s",
+					 relname, distribState->stagingName);
+	distrib_execute_spi(buf.data, SPI_OK_INSERT);
+
+	resetStringInfo(&buf);
+	appendStringInfo(&buf, "DROP TABLE %s", distribState->stagingName);
+	distrib_execute_spi(buf.data, SPI_OK_UTILITY);
+
+	pfree(buf.data);
+}
+
+
+/*
+ * distrib_execute_spi
+ * Execute a query planned as any other, on Coordinator
+ */
+static void
+distrib_execute_spi(char *sql, int expected)
+{
+	int			ret;
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "SPI_connect failed");
+
+	ret = SPI_execute(sql, false, 0);
+	if (ret != expected)
+		elog(ERROR, "SPI_execute failed: %s", sql);
+
+	if (SPI_finish() != SPI_OK_FINISH)
+		elog(ERROR, "SPI_finish failed");
+
+	/* Be sure to advance the command counter after the last command */
+	CommandCounterIncrement();
+}
+
+
 /*
  * makeRedistribState
  * Build a distribution state operator
@@ -819,6 +1434,9 @@ makeRedistribState(Oid relOid)
 	res->relid = relOid;
 	res->commands = NIL;
 	res->store = NULL;
+	res->bucketQual = NULL;
+	res->stagingName = NULL;
+	res->stagingDistrib = NULL;
 	return res;
 }
 
@@ -842,6 +1460,12 @@ FreeRedistribState(RedistribState *state)
 		list_free(state->commands);
 	if (state->store)
 		tuplestore_end(state->store);
+	if (state->bucketQual)
+		pfree(state->bucketQual);
+	if (state->stagingName)
+		pfree(state->stagingName);
+	if (state->stagingDistrib)
+		pfree(state->stagingDistrib);
 	pfree(state);
 }
 
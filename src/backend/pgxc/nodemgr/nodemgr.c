@@ -40,6 +40,7 @@
 
 static Datum generate_node_id(const char *node_name);
 static void count_coords_datanodes(Relation rel, int *num_coord, int *num_dns);
+static void update_preferred_nodes(void);
 
 /*
  * GUC parameters.
@@ -60,6 +61,13 @@ static int	   *shmemNumDataNodes;
 NodeDefinition *coDefs;
 NodeDefinition *dnDefs;
 
+/*
+ * Whether the node tables have been loaded from pgxc_node. Backends starting
+ * up use the tables as they are once this is set, they are only read again
+ * from the catalog on request, i.e. by pgxc_pool_reload.
+ */
+static bool	   *shmemNodeTablesValid;
+
 /*
  * NodeTablesInit
  *	Initializes shared memory tables of Coordinators and Datanodes.
@@ -92,7 +100,11 @@ NodeTablesShmemInit(void)
 		*shmemNumCoords = 0;
 		/* Mark nodeishealthy true at init time for all */
 		for (i = 0; i < MaxCoords; i++)
+		{
 			coDefs[i].nodeishealthy = true;
+			coDefs[i].nodeactive = 0;
+			coDefs[i].nodelatency = 0;
+		}
 	}
 
 	/* Same for Datanodes */
@@ -110,8 +122,17 @@ NodeTablesShmemInit(void)
 		*shmemNumDataNodes = 0;
 		/* Mark nodeishealthy true at init time for all */
 		for (i = 0; i < MaxDataNodes; i++)
+		{
 			dnDefs[i].nodeishealthy = true;
+			dnDefs[i].nodeactive = 0;
+			dnDefs[i].nodelatency = 0;
+		}
 	}
+
+	shmemNodeTablesValid = ShmemInitStruct("Node Table State", sizeof(bool),
+										   &found);
+	if (!found)
+		*shmemNodeTablesValid = false;
 }
 
 
@@ -130,7 +151,7 @@ NodeTablesShmemSize(void)
 	dn_size = mul_size(sizeof(NodeDefinition), MaxDataNodes);
 	dn_size = add_size(dn_size, sizeof(int));
 
-	return add_size(co_size, dn_size);
+	return add_size(add_size(co_size, dn_size), sizeof(bool));
 }
 
 /*
@@ -140,7 +161,7 @@ NodeTablesShmemSize(void)
 static void
 check_node_options(const char *node_name, List *options, char **node_host,
 			int *node_port, char *node_type,
-			bool *is_primary, bool *is_preferred)
+			bool *is_primary, bool *is_preferred, char **node_zone)
 {
 	ListCell   *option;
 
@@ -192,6 +213,15 @@ check_node_options(const char *node_name, List *options, char **node_host,
 		{
 			*is_preferred = defGetBoolean(defel);
 		}
+		else if (strcmp(defel->defname, "zone") == 0)
+		{
+			*node_zone = defGetString(defel);
+
+			if (strlen(*node_zone) >= NAMEDATALEN)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("zone value is too long")));
+		}
 		else
 		{
 			ereport(ERROR,
@@ -422,8 +452,10 @@ PgxcNodeListAndCount(void)
 
 		/* Populate the definition */
 		node->nodeoid = HeapTupleGetOid(tuple);
+		node->nodeid = nodeForm->node_id;
 		memcpy(&node->nodename, &nodeForm->node_name, NAMEDATALEN);
 		memcpy(&node->nodehost, &nodeForm->node_host, NAMEDATALEN);
+		memcpy(&node->nodezone, &nodeForm->node_zone, NAMEDATALEN);
 		node->nodeport = nodeForm->node_port;
 		node->nodeisprimary = nodeForm->nodeis_primary;
 		node->nodeispreferred = nodeForm->nodeis_preferred;
@@ -433,11 +465,15 @@ PgxcNodeListAndCount(void)
 		 * entry for a nodeoid, we mark it as healthy
 		 */
 		node->nodeishealthy = true;
+		node->nodeactive = 0;
+		node->nodelatency = 0;
 		for (i = 0; i < numNodes; i++)
 		{
 			if (nodes[i].nodeoid == node->nodeoid)
 			{
 				node->nodeishealthy = nodes[i].nodeishealthy;
+				node->nodeactive = nodes[i].nodeactive;
+				node->nodelatency = nodes[i].nodelatency;
 				break;
 			}
 		}
@@ -457,7 +493,58 @@ PgxcNodeListAndCount(void)
 	if (*shmemNumDataNodes > 1)
 		qsort(dnDefs, *shmemNumDataNodes, sizeof(NodeDefinition), cmp_nodes);
 
+	*shmemNodeTablesValid = true;
+
+	LWLockRelease(NodeTableLock);
+}
+
+/*
+ * PgxcNodeEnsureLoaded
+ *
+ * Load the node definitions into the shared memory tables, unless some
+ * backend already did.  Unlike PgxcNodeListAndCount this does not scan
+ * pgxc_node once the tables are loaded, so that session startup does not
+ * depend on the number of nodes in the cluster.
+ */
+void
+PgxcNodeEnsureLoaded(void)
+{
+	bool		valid;
+
+	LWLockAcquire(NodeTableLock, LW_SHARED);
+	valid = *shmemNodeTablesValid;
 	LWLockRelease(NodeTableLock);
+
+	if (!valid)
+		PgxcNodeListAndCount();
+}
+
+/*
+ * update_preferred_nodes
+ *
+ * Set the session's primary and preferred datanodes from the node table.
+ * The caller holds NodeTableLock.
+ */
+static void
+update_preferred_nodes(void)
+{
+	int i;
+
+	/* Initialize primary and preferred node information */
+	primary_data_node = InvalidOid;
+	num_preferred_data_nodes = 0;
+
+	for (i = 0; i < *shmemNumDataNodes; i++)
+	{
+		if (dnDefs[i].nodeisprimary)
+			primary_data_node = dnDefs[i].nodeoid;
+
+		if (dnDefs[i].nodeispreferred)
+		{
+			preferred_data_node[num_preferred_data_nodes] = dnDefs[i].nodeoid;
+			num_preferred_data_nodes++;
+		}
+	}
 }
 
 
@@ -504,25 +591,38 @@ PgxcNodeGetOids(Oid **coOids, Oid **dnOids,
 
 	/* Update also preferred and primary node informations if requested */
 	if (update_preferred)
-	{
-		int i;
+		update_preferred_nodes();
 
-		/* Initialize primary and preferred node information */
-		primary_data_node = InvalidOid;
-		num_preferred_data_nodes = 0;
+	LWLockRelease(NodeTableLock);
+}
 
-		for (i = 0; i < *shmemNumDataNodes; i++)
-		{
-			if (dnDefs[i].nodeisprimary)
-				primary_data_node = dnDefs[i].nodeoid;
+/*
+ * PgxcNodeGetDefinitions
+ *
+ * Like PgxcNodeGetOids, but returns palloc'ed copies of the whole node
+ * definitions, taken consistently under a single lock.
+ */
+void
+PgxcNodeGetDefinitions(NodeDefinition **coNodes, NodeDefinition **dnNodes,
+					   int *num_coords, int *num_dns, bool update_preferred)
+{
+	LWLockAcquire(NodeTableLock, LW_SHARED);
 
-			if (dnDefs[i].nodeispreferred)
-			{
-				preferred_data_node[num_preferred_data_nodes] = dnDefs[i].nodeoid;
-				num_preferred_data_nodes++;
-			}
-		}
-	}
+	*num_coords = *shmemNumCoords;
+	*num_dns = *shmemNumDataNodes;
+
+	*coNodes = (NodeDefinition *)
+		palloc(*shmemNumCoords * sizeof(NodeDefinition));
+	if (*shmemNumCoords > 0)
+		memcpy(*coNodes, coDefs, *shmemNumCoords * sizeof(NodeDefinition));
+
+	*dnNodes = (NodeDefinition *)
+		palloc(*shmemNumDataNodes * sizeof(NodeDefinition));
+	if (*shmemNumDataNodes > 0)
+		memcpy(*dnNodes, dnDefs, *shmemNumDataNodes * sizeof(NodeDefinition));
+
+	if (update_preferred)
+		update_preferred_nodes();
 
 	LWLockRelease(NodeTableLock);
 }
@@ -614,6 +714,82 @@ PgxcNodeDnListHealth(List *nodeList, bool *healthmap)
 	LWLockRelease(NodeTableLock);
 }
 
+/*
+ * Consult the shared memory NodeDefinition structures and fetch the
+ * health, number of connections in use and connect latency of the
+ * Datanodes in the list. Any of the arrays may be NULL.
+ */
+void
+PgxcNodeDnListLoad(List *nodeList, bool *healthmap, int *activemap,
+				   int *latencymap)
+{
+	ListCell *lc;
+	int index = 0;
+
+	LWLockAcquire(NodeTableLock, LW_SHARED);
+	foreach(lc, nodeList)
+	{
+		int node = lfirst_int(lc);
+
+		if (node < 0 || node >= *shmemNumDataNodes)
+		{
+			LWLockRelease(NodeTableLock);
+			ereport(ERROR,
+					(errcode(ERRCODE_UNDEFINED_OBJECT),
+					 errmsg("PGXC load not found for datanode with index (%d)",
+						 node)));
+		}
+		if (healthmap)
+			healthmap[index] = dnDefs[node].nodeishealthy;
+		if (activemap)
+			activemap[index] = dnDefs[node].nodeactive;
+		if (latencymap)
+			latencymap[index] = dnDefs[node].nodelatency;
+		index++;
+	}
+	LWLockRelease(NodeTableLock);
+}
+
+/*
+ * Publish the load of a node, as seen by the pooler, in the shared memory
+ * node table.
+ *
+ * The pooler is the only process writing these values, and readers are
+ * fine with slightly stale values, so a shared lock (protecting against
+ * the table being rebuilt) is enough.
+ */
+void
+PgxcNodeUpdateLoad(Oid node, int active, int latency)
+{
+	int				i;
+
+	LWLockAcquire(NodeTableLock, LW_SHARED);
+
+	for (i = 0; i < *shmemNumDataNodes; i++)
+	{
+		if (dnDefs[i].nodeoid == node)
+		{
+			dnDefs[i].nodeactive = active;
+			dnDefs[i].nodelatency = latency;
+			LWLockRelease(NodeTableLock);
+			return;
+		}
+	}
+
+	for (i = 0; i < *shmemNumCoords; i++)
+	{
+		if (coDefs[i].nodeoid == node)
+		{
+			coDefs[i].nodeactive = active;
+			coDefs[i].nodelatency = latency;
+			LWLockRelease(NodeTableLock);
+			return;
+		}
+	}
+
+	LWLockRelease(NodeTableLock);
+}
+
 /*
  * Find node definition in the shared memory node table.
  * The structure is a copy palloc'ed in current memory context.
@@ -661,19 +837,108 @@ PgxcNodeGetDefinition(Oid node)
 	return NULL;
 }
 
+/*
+ * Find the network zone of the node in the shared memory node table.
+ * Returns NULL if the node is unknown or has no zone set.
+ * Caller must hold NodeTableLock.
+ */
+static const char *
+find_node_zone(Oid node)
+{
+	int				i;
+
+	for (i = 0; i < *shmemNumDataNodes; i++)
+		if (dnDefs[i].nodeoid == node)
+			return NameStr(dnDefs[i].nodezone)[0] ?
+					NameStr(dnDefs[i].nodezone) : NULL;
+
+	for (i = 0; i < *shmemNumCoords; i++)
+		if (coDefs[i].nodeoid == node)
+			return NameStr(coDefs[i].nodezone)[0] ?
+					NameStr(coDefs[i].nodezone) : NULL;
+
+	return NULL;
+}
+
+/*
+ * PgxcNodeCrossZoneFraction
+ *
+ * Fraction of the sender -> receiver pairs of the given nodes which are
+ * located in different network zones. A node without zone is assumed to be
+ * close to every other node.
+ */
+double
+PgxcNodeCrossZoneFraction(Oid *senders, int nsenders,
+						  Oid *receivers, int nreceivers)
+{
+	const char	  **rzones;
+	int				i, j;
+	int				cross = 0;
+
+	if (nsenders == 0 || nreceivers == 0)
+		return 0.0;
+
+	rzones = (const char **) palloc(nreceivers * sizeof(char *));
+
+	LWLockAcquire(NodeTableLock, LW_SHARED);
+
+	for (j = 0; j < nreceivers; j++)
+		rzones[j] = find_node_zone(receivers[j]);
+
+	for (i = 0; i < nsenders; i++)
+	{
+		const char *szone = find_node_zone(senders[i]);
+
+		if (szone == NULL)
+			continue;
+
+		for (j = 0; j < nreceivers; j++)
+			if (rzones[j] && strcmp(szone, rzones[j]) != 0)
+				cross++;
+	}
+
+	LWLockRelease(NodeTableLock);
+
+	pfree(rzones);
+
+	return (double) cross / ((double) nsenders * nreceivers);
+}
+
 /*
  * Update health status of a node in the shared memory node table.
  *
- * We could try to optimize this by checking if the ishealthy value
- * is already the same as the passed in one.. but if the cluster is
- * impaired, dunno how much such optimizations are worth. So keeping
- * it simple for now
+ * The pooler reports the node as healthy whenever it hands out a connection
+ * to it, so in the common case the status does not change. Check that under
+ * a shared lock first, so that acquiring connections to many nodes does not
+ * serialize all the backends reading the node table.
  */
 bool
 PgxcNodeUpdateHealth(Oid node, bool status)
 {
 	int				i;
 
+	LWLockAcquire(NodeTableLock, LW_SHARED);
+
+	for (i = 0; i < *shmemNumDataNodes; i++)
+	{
+		if (dnDefs[i].nodeoid == node && dnDefs[i].nodeishealthy == status)
+		{
+			LWLockRelease(NodeTableLock);
+			return true;
+		}
+	}
+
+	for (i = 0; i < *shmemNumCoords; i++)
+	{
+		if (coDefs[i].nodeoid == node && coDefs[i].nodeishealthy == status)
+		{
+			LWLockRelease(NodeTableLock);
+			return true;
+		}
+	}
+
+	LWLockRelease(NodeTableLock);
+
 	LWLockAcquire(NodeTableLock, LW_EXCLUSIVE);
 
 	/* search through the Datanodes first */
@@ -723,6 +988,7 @@ PgxcNodeCreate(CreateNodeStmt *stmt)
 	int		i;
 	/* Options with default values */
 	char	   *node_host = NULL;
+	char	   *node_zone = "";
 	char		node_type = PGXC_NODE_NONE;
 	int			node_port = 0;
 	bool		is_primary = false;
@@ -753,7 +1019,7 @@ PgxcNodeCreate(CreateNodeStmt *stmt)
 	/* Filter options */
 	check_node_options(node_name, stmt->options, &node_host,
 				&node_port, &node_type,
-				&is_primary, &is_preferred);
+				&is_primary, &is_preferred, &node_zone);
 
 	/* Compute node identifier */
 	node_id = generate_node_id(node_name);
@@ -837,6 +1103,7 @@ PgxcNodeCreate(CreateNodeStmt *stmt)
 	values[Anum_pgxc_node_is_primary - 1] = BoolGetDatum(is_primary);
 	values[Anum_pgxc_node_is_preferred - 1] = BoolGetDatum(is_preferred);
 	values[Anum_pgxc_node_id - 1] = node_id;
+	values[Anum_pgxc_node_zone - 1] = DirectFunctionCall1(namein, CStringGetDatum(node_zone));
 
 	htup = heap_form_tuple(pgxcnodesrel->rd_att, values, nulls);
 
@@ -855,6 +1122,7 @@ PgxcNodeAlter(AlterNodeStmt *stmt)
 {
 	const char *node_name = stmt->node_name;
 	char	   *node_host;
+	char	   *node_zone;
 	char		node_type;
 	int			node_port;
 	bool		is_preferred;
@@ -894,6 +1162,7 @@ PgxcNodeAlter(AlterNodeStmt *stmt)
 	 * so set up values.
 	 */
 	node_host = get_pgxc_nodehost(nodeOid);
+	node_zone = get_pgxc_nodezone(nodeOid);
 	node_port = get_pgxc_nodeport(nodeOid);
 	is_preferred = is_pgxc_nodepreferred(nodeOid);
 	is_primary = is_pgxc_nodeprimary(nodeOid);
@@ -903,7 +1172,7 @@ PgxcNodeAlter(AlterNodeStmt *stmt)
 	/* Filter options */
 	check_node_options(node_name, stmt->options, &node_host,
 				&node_port, &node_type,
-				&is_primary, &is_preferred);
+				&is_primary, &is_preferred, &node_zone);
 
 	/*
 	 * Two nodes cannot be primary at the same time. If the primary
@@ -958,6 +1227,9 @@ PgxcNodeAlter(AlterNodeStmt *stmt)
 	new_record_repl[Anum_pgxc_node_is_preferred - 1] = true;
 	new_record[Anum_pgxc_node_id - 1] = UInt32GetDatum(node_id);
 	new_record_repl[Anum_pgxc_node_id - 1] = true;
+	new_record[Anum_pgxc_node_zone - 1] =
+		DirectFunctionCall1(namein, CStringGetDatum(node_zone));
+	new_record_repl[Anum_pgxc_node_zone - 1] = true;
 
 	/* Update relation */
 	newtup = heap_modify_tuple(oldtup, RelationGetDescr(rel),
@@ -0,0 +1,225 @@
+/*-------------------------------------------------------------------------
+ *
+ * distadvisor.c
+ *	  Statistics of the redistributions planned, by distribution column
+ *
+ * Whenever the planner of a Coordinator puts a RemoteSubplan redistributing
+ * rows by hash or modulo of a table column into a final plan, it charges
+ * the estimated number and size of those rows to the column, in a hash
+ * table in shared memory keyed by database, relation and attribute number.
+ * Rows redistributed by a column would not have to move if the table was
+ * distributed by that column, so the columns with the most bytes charged
+ * are the candidate distribution keys, see pg_stat_redistributions.
+ *
+ * Only plans actually created are counted, not the alternatives considered
+ * by the planner, but a cached plan is counted once however many times it
+ * is executed.  The figures are planner estimates.
+ *
+ * Portions Copyright (c) 1996-2017, PostgreSQL Global Development Group
+ * Portions Copyright (c) 2010-2012 Postgres-XC Development Group
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/pgxc/plan/distadvisor.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "nodes/relation.h"
+#include "parser/parsetree.h"
+#include "pgxc/distadvisor.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+
+/* Number of distinct columns the redistributions are kept for */
+#define DIST_ADVISOR_MAX_ENTRIES	4096
+
+typedef struct DistAdvisorKey
+{
+	Oid			dbid;
+	Oid			relid;
+	AttrNumber	attnum;
+} DistAdvisorKey;
+
+typedef struct DistAdvisorEntry
+{
+	DistAdvisorKey key;			/* hash key of entry - MUST BE FIRST */
+	uint64		redistributions;	/* plans redistributing by the column */
+	double		rows;			/* estimated rows moved by those plans */
+	double		bytes;			/* estimated bytes moved by those plans */
+} DistAdvisorEntry;
+
+/* Protected by DistAdvisorLock */
+static HTAB *DistAdvisorHash = NULL;
+
+Size
+DistAdvisorShmemSize(void)
+{
+	return hash_estimate_size(DIST_ADVISOR_MAX_ENTRIES,
+							  sizeof(DistAdvisorEntry));
+}
+
+void
+DistAdvisorShmemInit(void)
+{
+	HASHCTL		info;
+
+	MemSet(&info, 0, sizeof(info));
+	info.keysize = sizeof(DistAdvisorKey);
+	info.entrysize = sizeof(DistAdvisorEntry);
+
+	DistAdvisorHash = ShmemInitHash("Redistribution Statistics",
+									DIST_ADVISOR_MAX_ENTRIES,
+									DIST_ADVISOR_MAX_ENTRIES,
+									&info,
+									HASH_ELEM | HASH_BLOBS);
+}
+
+/*
+ * Charge a planned redistribution of rows of the given width by
+ * distributionExpr.  Nothing is recorded unless the expression is a plain
+ * column of a table of the query.
+ */
+void
+DistAdvisorRecord(PlannerInfo *root, Node *distributionExpr,
+				  double rows, int width)
+{
+	Var		   *var;
+	RangeTblEntry *rte;
+	DistAdvisorKey key;
+	DistAdvisorEntry *entry;
+	bool		found;
+
+	while (distributionExpr && IsA(distributionExpr, RelabelType))
+		distributionExpr = (Node *) ((RelabelType *) distributionExpr)->arg;
+
+	if (distributionExpr == NULL || !IsA(distributionExpr, Var))
+		return;
+
+	var = (Var *) distributionExpr;
+	if (var->varlevelsup != 0 || var->varattno <= 0 ||
+		var->varno < 1 || var->varno >= root->simple_rel_array_size)
+		return;
+
+	rte = planner_rt_fetch(var->varno, root);
+	if (rte->rtekind != RTE_RELATION)
+		return;
+
+	MemSet(&key, 0, sizeof(key));
+	key.dbid = MyDatabaseId;
+	key.relid = rte->relid;
+	key.attnum = var->varattno;
+
+	LWLockAcquire(DistAdvisorLock, LW_EXCLUSIVE);
+	/* Redistributions by new columns are lost once the table is full */
+	entry = (DistAdvisorEntry *) hash_search(DistAdvisorHash, &key,
+											 HASH_ENTER_NULL, &found);
+	if (entry)
+	{
+		if (!found)
+		{
+			entry->redistributions = 0;
+			entry->rows = 0;
+			entry->bytes = 0;
+		}
+		entry->redistributions++;
+		entry->rows += rows;
+		entry->bytes += rows * width;
+	}
+	LWLockRelease(DistAdvisorLock);
+}
+
+/*
+ * pg_stat_get_redistributions
+ *
+ * Return the redistributions recorded for the columns of the current
+ * database, one row per column.
+ */
+Datum
+pg_stat_get_redistributions(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_REDISTRIBUTIONS_COLS	5
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	HASH_SEQ_STATUS hash_seq;
+	DistAdvisorEntry *entry;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	LWLockAcquire(DistAdvisorLock, LW_SHARED);
+	hash_seq_init(&hash_seq, DistAdvisorHash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+	{
+		Datum		values[PG_STAT_GET_REDISTRIBUTIONS_COLS];
+		bool		nulls[PG_STAT_GET_REDISTRIBUTIONS_COLS];
+
+		if (entry->key.dbid != MyDatabaseId)
+			continue;
+
+		MemSet(nulls, 0, sizeof(nulls));
+
+		values[0] = ObjectIdGetDatum(entry->key.relid);
+		values[1] = Int16GetDatum(entry->key.attnum);
+		values[2] = Int64GetDatum((int64) entry->redistributions);
+		values[3] = Float8GetDatum(entry->rows);
+		values[4] = Float8GetDatum(entry->bytes);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+	LWLockRelease(DistAdvisorLock);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * pg_stat_reset_redistributions
+ *
+ * Discard the redistributions recorded for all the databases.
+ */
+Datum
+pg_stat_reset_redistributions(PG_FUNCTION_ARGS)
+{
+	HASH_SEQ_STATUS hash_seq;
+	DistAdvisorEntry *entry;
+
+	LWLockAcquire(DistAdvisorLock, LW_EXCLUSIVE);
+	hash_seq_init(&hash_seq, DistAdvisorHash);
+	while ((entry = hash_seq_search(&hash_seq)) != NULL)
+		hash_search(DistAdvisorHash, &entry->key, HASH_REMOVE, NULL);
+	LWLockRelease(DistAdvisorLock);
+
+	PG_RETURN_VOID();
+}
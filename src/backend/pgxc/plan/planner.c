@@ -59,6 +59,19 @@
 #include "commands/tablecmds.h"
 #include "utils/timestamp.h"
 #include "utils/date.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+
+
+/*
+ * Query shapes, identified by their queryId, which the FQS walker has found to
+ * be unshippable irrespective of the constants in them. Only the negative
+ * decision is remembered: the nodes a shippable query goes to depend upon the
+ * constants, which the queryId deliberately ignores.
+ */
+#define FQS_CACHE_SIZE		1024
+
+static HTAB *FQSUnshippableCache = NULL;
 
 
 static bool contains_temp_tables(List *rtable);
@@ -68,6 +81,10 @@ static RemoteQuery *pgxc_FQS_create_remote_plan(Query *query,
 												ExecNodes *exec_nodes,
 												bool is_exec_direct);
 static CombineType get_plan_combine_type(CmdType commandType, char baselocatortype);
+static bool fqs_cache_lookup(Query *query);
+static void fqs_cache_remember(Query *query);
+static void FQSCacheRelCallback(Datum arg, Oid relid);
+static void FQSCacheSysCallback(Datum arg, int cacheid, uint32 hashvalue);
 
 #ifdef XCP
 /*
@@ -235,6 +252,82 @@ pgxc_planner(Query *query, int cursorOptions, ParamListInfo boundParams)
 	return result;
 }
 
+/*
+ * FQS cache invalidation callbacks. Any change to a relation (including its
+ * distribution in pgxc_class), function or type may turn an unshippable query
+ * shape into a shippable one, so simply forget everything.
+ */
+static void
+FQSCacheRelCallback(Datum arg, Oid relid)
+{
+	FQSCacheSysCallback(arg, 0, 0);
+}
+
+static void
+FQSCacheSysCallback(Datum arg, int cacheid, uint32 hashvalue)
+{
+	if (FQSUnshippableCache)
+	{
+		hash_destroy(FQSUnshippableCache);
+		FQSUnshippableCache = NULL;
+	}
+}
+
+/*
+ * fqs_cache_lookup
+ * Return true if the shape of the given query is known to be unshippable.
+ */
+static bool
+fqs_cache_lookup(Query *query)
+{
+	if (query->queryId == 0 || FQSUnshippableCache == NULL)
+		return false;
+
+	return hash_search(FQSUnshippableCache, &query->queryId,
+					   HASH_FIND, NULL) != NULL;
+}
+
+/*
+ * fqs_cache_remember
+ * Record that the shape of the given query can never be shipped.
+ */
+static void
+fqs_cache_remember(Query *query)
+{
+	static bool callbacks_registered = false;
+
+	if (query->queryId == 0)
+		return;
+
+	if (!callbacks_registered)
+	{
+		CacheRegisterRelcacheCallback(FQSCacheRelCallback, (Datum) 0);
+		CacheRegisterSyscacheCallback(PROCOID, FQSCacheSysCallback, (Datum) 0);
+		CacheRegisterSyscacheCallback(TYPEOID, FQSCacheSysCallback, (Datum) 0);
+		callbacks_registered = true;
+	}
+
+	/* Start afresh once the cache is full, rather than tracking usage */
+	if (FQSUnshippableCache &&
+		hash_get_num_entries(FQSUnshippableCache) >= FQS_CACHE_SIZE)
+		FQSCacheSysCallback((Datum) 0, 0, 0);
+
+	if (FQSUnshippableCache == NULL)
+	{
+		HASHCTL		ctl;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(uint32);
+		ctl.entrysize = sizeof(uint32);
+		ctl.hcxt = CacheMemoryContext;
+		FQSUnshippableCache = hash_create("FQS unshippable query shapes",
+										  FQS_CACHE_SIZE, &ctl,
+										  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	(void) hash_search(FQSUnshippableCache, &query->queryId, HASH_ENTER, NULL);
+}
+
 /*
  * pgxc_FQS_planner
  * The routine tries to see if the statement can be completely evaluated on the
@@ -267,6 +360,7 @@ pgxc_FQS_planner(Query *query, int cursorOptions, ParamListInfo boundParams)
 	PlannerInfo		*root;
 	ExecNodes		*exec_nodes;
 	Plan			*top_plan;
+	bool			shape_unshippable = false;
 
 	/* Try by-passing standard planner, if fast query shipping is enabled */
 	if (!enable_fast_query_shipping)
@@ -284,13 +378,24 @@ pgxc_FQS_planner(Query *query, int cursorOptions, ParamListInfo boundParams)
 			return NULL;
 	}
 
+	/*
+	 * Repeated query shapes already known to be unshippable need not be
+	 * walked again.
+	 */
+	if (fqs_cache_lookup(query))
+		return NULL;
+
 	/*
 	 * If the query can not be or need not be shipped to the Datanodes, don't
 	 * create any plan here. standard_planner() will take care of it.
 	 */
-	exec_nodes = pgxc_is_query_shippable(query, 0);
+	exec_nodes = pgxc_query_shippability(query, 0, &shape_unshippable);
 	if (exec_nodes == NULL)
+	{
+		if (shape_unshippable)
+			fqs_cache_remember(query);
 		return NULL;
+	}
 
 	glob = makeNode(PlannerGlobal);
 	glob->boundParams = boundParams;
@@ -0,0 +1,691 @@
+/*-------------------------------------------------------------------------
+ *
+ * commitbatcher.c
+ *
+ *	  Coordinator-side batching of COMMIT PREPARED commands
+ *
+ * When a distributed transaction is committed, the session sends COMMIT
+ * PREPARED down to every node involved and waits for the responses. At high
+ * commit rates these round trips add up, while the Datanodes are able to
+ * group WAL flushes of concurrent commits anyway. The commit batcher is a
+ * background worker serving one database. Sessions post their COMMIT PREPARED
+ * requests to shared memory and wait; the batcher picks up everything queued,
+ * pipelines the commands over its own connections to the nodes and wakes up
+ * the sessions when the responses are received.
+ *
+ * Batchers are started on demand, up to max_commit_batchers, and exit after
+ * being idle for a while. If no batcher is available the session just runs
+ * COMMIT PREPARED itself.
+ *
+ * With async_commit_prepared the session does not wait for the batcher and
+ * acknowledges the commit once the decision is durable, that is, the local
+ * node or the one-phase participant has committed. The outcome of the request
+ * is collected before the session talks to the remote nodes next time, so it
+ * always sees its own changes. Other sessions may not see the changes on the
+ * nodes where COMMIT PREPARED has not completed yet, even though GTM reports
+ * the transaction as committed.
+ *
+ * Portions Copyright (c) 1996-2011, PostgreSQL Global Development Group
+ * Portions Copyright (c) 2010-2012 Postgres-XC Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/pgxc/pool/commitbatcher.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/xact.h"
+#include "catalog/pgxc_node.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "pgxc/commitbatcher.h"
+#include "pgxc/execRemote.h"
+#include "pgxc/nodemgr.h"
+#include "pgxc/pgxc.h"
+#include "pgxc/pgxcnode.h"
+#include "pgxc/poolmgr.h"
+#include "pgxc/xc_maintenance_mode.h"
+#include "postmaster/bgworker.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "tcop/tcopprot.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+/* GUC parameters */
+int			MaxCommitBatchers = 0;
+bool		AsyncCommitPrepared = false;
+
+/* Batcher exits if it has not received requests for that long, ms */
+#define COMMIT_BATCHER_IDLE_TIMEOUT		60000
+/* Batcher slot is reused if worker has not started in that time, ms */
+#define COMMIT_BATCHER_START_TIMEOUT	10000
+#define COMMIT_BATCHER_ERRMSG_LEN		256
+
+/* Request states */
+#define CB_REQUEST_FREE		0
+#define CB_REQUEST_QUEUED	1
+#define CB_REQUEST_RUNNING	2
+#define CB_REQUEST_DONE		3
+#define CB_REQUEST_FAILED	4
+#define CB_REQUEST_REJECTED	5
+
+typedef struct CommitBatcherSlot
+{
+	Oid			dboid;			/* database served, InvalidOid if free */
+	pid_t		pid;			/* worker PID, 0 until it has started */
+	int			procno;			/* worker's PGPROC number */
+	TimestampTz launch_time;	/* when the worker was registered */
+} CommitBatcherSlot;
+
+/*
+ * Request of a session. Every backend has its own request slot, indexed by
+ * its PGPROC number, since the session waits until the request is completed.
+ * The variable size data is node OIDs, Datanodes first, followed by the gid.
+ */
+typedef struct CommitBatcherRequest
+{
+	int			status;
+	Oid			dboid;
+	int			procno;
+	GlobalTransactionId gxid;
+	int			ndatanodes;
+	int			ncoords;
+	char		errmsg[COMMIT_BATCHER_ERRMSG_LEN];
+	char		data[FLEXIBLE_ARRAY_MEMBER];
+} CommitBatcherRequest;
+
+typedef struct CommitBatcherCtlData
+{
+	slock_t		mutex;			/* protects all the fields and requests */
+	int			maxnodes;		/* room for node OIDs in a request */
+	int			gidsize;		/* room for the gid in a request */
+	Size		request_size;	/* size of a request slot */
+	CommitBatcherSlot batchers[FLEXIBLE_ARRAY_MEMBER];
+} CommitBatcherCtlData;
+
+static CommitBatcherCtlData *CommitBatcherCtl = NULL;
+static char *CommitBatcherRequests = NULL;
+
+/* Our request is submitted with no wait and its outcome is not collected */
+static bool commit_batcher_pending = false;
+static bool commit_batcher_exit_registered = false;
+
+#define CommitBatcherRequestGet(i) \
+	((CommitBatcherRequest *) (CommitBatcherRequests + \
+							   (i) * CommitBatcherCtl->request_size))
+#define CommitBatcherRequestNodes(req) ((Oid *) (req)->data)
+#define CommitBatcherRequestGid(req) \
+	((req)->data + CommitBatcherCtl->maxnodes * sizeof(Oid))
+
+static Size
+commit_batcher_request_size(void)
+{
+	int			maxnodes = MaxDataNodes + MaxCoords;
+
+	/* Same as the limit of the two-phase state, see twophase.c */
+	return MAXALIGN(offsetof(CommitBatcherRequest, data) +
+					maxnodes * sizeof(Oid) + 200 + maxnodes * 15);
+}
+
+Size
+CommitBatcherShmemSize(void)
+{
+	Size		size;
+
+	if (MaxCommitBatchers <= 0)
+		return 0;
+
+	size = offsetof(CommitBatcherCtlData, batchers);
+	size = add_size(size, mul_size(MaxCommitBatchers,
+								   sizeof(CommitBatcherSlot)));
+	size = MAXALIGN(size);
+	size = add_size(size, mul_size(MaxBackends, commit_batcher_request_size()));
+	return size;
+}
+
+void
+CommitBatcherShmemInit(void)
+{
+	bool		found;
+	Size		ctlsize;
+	int			i;
+
+	if (MaxCommitBatchers <= 0)
+		return;
+
+	ctlsize = MAXALIGN(offsetof(CommitBatcherCtlData, batchers) +
+					   MaxCommitBatchers * sizeof(CommitBatcherSlot));
+
+	CommitBatcherCtl = (CommitBatcherCtlData *)
+		ShmemInitStruct("Commit Batcher Data", CommitBatcherShmemSize(),
+						&found);
+	CommitBatcherRequests = ((char *) CommitBatcherCtl) + ctlsize;
+
+	if (!found)
+	{
+		SpinLockInit(&CommitBatcherCtl->mutex);
+		CommitBatcherCtl->maxnodes = MaxDataNodes + MaxCoords;
+		CommitBatcherCtl->gidsize = 200 + CommitBatcherCtl->maxnodes * 15;
+		CommitBatcherCtl->request_size = commit_batcher_request_size();
+		for (i = 0; i < MaxCommitBatchers; i++)
+		{
+			CommitBatcherCtl->batchers[i].dboid = InvalidOid;
+			CommitBatcherCtl->batchers[i].pid = 0;
+		}
+		for (i = 0; i < MaxBackends; i++)
+			CommitBatcherRequestGet(i)->status = CB_REQUEST_FREE;
+	}
+}
+
+/*
+ * Find running batcher for the current database. If there is none try to
+ * start it, it will be available for subsequent requests.
+ * Returns batcher slot number or -1.
+ */
+static int
+commit_batcher_lookup(void)
+{
+	BackgroundWorker bgw;
+	TimestampTz now = GetCurrentTimestamp();
+	int			launch_slot = -1;
+	int			i;
+
+	SpinLockAcquire(&CommitBatcherCtl->mutex);
+	for (i = 0; i < MaxCommitBatchers; i++)
+	{
+		CommitBatcherSlot *slot = &CommitBatcherCtl->batchers[i];
+
+		if (slot->dboid != MyDatabaseId)
+			continue;
+
+		if (slot->pid != 0)
+		{
+			SpinLockRelease(&CommitBatcherCtl->mutex);
+			return i;
+		}
+
+		/* Being started, unless it is taking too long */
+		if (!TimestampDifferenceExceeds(slot->launch_time, now,
+										COMMIT_BATCHER_START_TIMEOUT))
+		{
+			SpinLockRelease(&CommitBatcherCtl->mutex);
+			return -1;
+		}
+		launch_slot = i;
+		break;
+	}
+
+	/* Not found, take a free slot */
+	for (i = 0; launch_slot < 0 && i < MaxCommitBatchers; i++)
+	{
+		if (CommitBatcherCtl->batchers[i].dboid == InvalidOid)
+			launch_slot = i;
+	}
+
+	if (launch_slot < 0)
+	{
+		/* All the batchers are busy with other databases */
+		SpinLockRelease(&CommitBatcherCtl->mutex);
+		return -1;
+	}
+
+	CommitBatcherCtl->batchers[launch_slot].dboid = MyDatabaseId;
+	CommitBatcherCtl->batchers[launch_slot].pid = 0;
+	CommitBatcherCtl->batchers[launch_slot].launch_time = now;
+	SpinLockRelease(&CommitBatcherCtl->mutex);
+
+	memset(&bgw, 0, sizeof(bgw));
+	bgw.bgw_flags = BGWORKER_SHMEM_ACCESS |
+		BGWORKER_BACKEND_DATABASE_CONNECTION;
+	bgw.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	snprintf(bgw.bgw_library_name, BGW_MAXLEN, "postgres");
+	snprintf(bgw.bgw_function_name, BGW_MAXLEN, "CommitBatcherMain");
+	snprintf(bgw.bgw_name, BGW_MAXLEN,
+			 "commit batcher for database %u", MyDatabaseId);
+	bgw.bgw_restart_time = BGW_NEVER_RESTART;
+	bgw.bgw_notify_pid = 0;
+	bgw.bgw_main_arg = Int32GetDatum(launch_slot);
+
+	if (!RegisterDynamicBackgroundWorker(&bgw, NULL))
+	{
+		SpinLockAcquire(&CommitBatcherCtl->mutex);
+		if (CommitBatcherCtl->batchers[launch_slot].pid == 0)
+			CommitBatcherCtl->batchers[launch_slot].dboid = InvalidOid;
+		SpinLockRelease(&CommitBatcherCtl->mutex);
+		elog(DEBUG1, "could not start commit batcher: out of background "
+			 "worker slots");
+	}
+
+	return -1;
+}
+
+/*
+ * Wait until the batcher has completed our request, returns the final status.
+ * We can not bail out when the request is picked up, the commit is going on,
+ * so do not allow to cancel the wait.
+ */
+static int
+commit_batcher_wait(CommitBatcherRequest *req)
+{
+	int			status;
+
+	HOLD_INTERRUPTS();
+	for (;;)
+	{
+		int			rc;
+
+		SpinLockAcquire(&CommitBatcherCtl->mutex);
+		status = req->status;
+		SpinLockRelease(&CommitBatcherCtl->mutex);
+
+		if (status != CB_REQUEST_QUEUED && status != CB_REQUEST_RUNNING)
+			break;
+
+		rc = WaitLatch(MyLatch, WL_LATCH_SET | WL_POSTMASTER_DEATH, -1L,
+					   WAIT_EVENT_COMMIT_BATCHER);
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+		ResetLatch(MyLatch);
+	}
+	RESUME_INTERRUPTS();
+
+	return status;
+}
+
+/*
+ * Convert the request to the form of RemoteCommitPreparedBatch item.
+ */
+static void
+commit_batcher_request_item(CommitBatcherRequest *req,
+							RemoteCommitPrepared *item)
+{
+	Oid		   *nodes = CommitBatcherRequestNodes(req);
+	int			j;
+
+	item->gid = CommitBatcherRequestGid(req);
+	item->gxid = req->gxid;
+	for (j = 0; j < req->ndatanodes + req->ncoords; j++)
+	{
+		char		nodetype = PGXC_NODE_NONE;
+		int			nodeIndex = PGXCNodeGetNodeId(nodes[j], &nodetype);
+
+		if (nodeIndex < 0)
+		{
+			item->errmsg = psprintf("node %u is not defined", nodes[j]);
+			break;
+		}
+		if (nodetype == PGXC_NODE_COORDINATOR)
+			item->coordlist = lappend_int(item->coordlist, nodeIndex);
+		else
+			item->nodelist = lappend_int(item->nodelist, nodeIndex);
+	}
+	/* Do not send commands for the bad request */
+	if (item->errmsg)
+	{
+		list_free(item->nodelist);
+		list_free(item->coordlist);
+		item->nodelist = item->coordlist = NIL;
+	}
+}
+
+/*
+ * Collect the outcome of the request submitted with no wait. Failures are
+ * reported as warnings, the client has been told the transaction is committed
+ * already. If the batcher has exited before it picked up the request run
+ * COMMIT PREPARED ourselves, unless we are exiting.
+ */
+static void
+commit_batcher_finish_pending(bool resolve)
+{
+	CommitBatcherRequest *req;
+	char	   *gid;
+	char	   *failure = NULL;
+	int			status;
+
+	if (!commit_batcher_pending)
+		return;
+	commit_batcher_pending = false;
+
+	req = CommitBatcherRequestGet(MyProc->pgprocno);
+	status = commit_batcher_wait(req);
+	gid = pstrdup(CommitBatcherRequestGid(req));
+
+	if (status == CB_REQUEST_FAILED)
+		failure = pstrdup(req->errmsg);
+	else if (status == CB_REQUEST_REJECTED)
+	{
+		if (resolve)
+		{
+			RemoteCommitPrepared item;
+
+			memset(&item, 0, sizeof(item));
+			commit_batcher_request_item(req, &item);
+			item.gid = gid;
+			RemoteCommitPreparedBatch(&item, 1);
+			failure = item.errmsg;
+		}
+		else
+			failure = "commit batcher has exited";
+	}
+
+	SpinLockAcquire(&CommitBatcherCtl->mutex);
+	req->status = CB_REQUEST_FREE;
+	SpinLockRelease(&CommitBatcherCtl->mutex);
+
+	if (failure)
+		ereport(WARNING,
+				(errmsg("failed to COMMIT PREPARED transaction %s: %s",
+						gid, failure),
+				 errhint("Run pgxc_clean to complete the transaction.")));
+	pfree(gid);
+}
+
+static void
+commit_batcher_atexit(int code, Datum arg)
+{
+	commit_batcher_finish_pending(false);
+}
+
+/*
+ * Called before the session sends anything to the remote nodes.
+ */
+void
+CommitBatcherWaitPending(void)
+{
+	if (commit_batcher_pending)
+		commit_batcher_finish_pending(true);
+}
+
+/*
+ * Submit COMMIT PREPARED of the transaction on the specified nodes to the
+ * commit batcher and wait until it is completed. If wait is false return
+ * as soon as the request is queued, see CommitBatcherWaitPending.
+ * Returns false if batcher is not available, the caller should commit prepared
+ * transaction itself.
+ * Throws error if COMMIT PREPARED has failed.
+ */
+bool
+CommitBatcherSubmit(const char *prepareGID, List *nodelist, List *coordlist,
+					GlobalTransactionId gxid, bool wait)
+{
+	CommitBatcherRequest *req;
+	CommitBatcherSlot *batcher;
+	Oid		   *nodes;
+	ListCell   *lc;
+	int			slot;
+	int			procno = -1;
+	int			status;
+	int			i;
+
+	if (CommitBatcherCtl == NULL || !IsUnderPostmaster ||
+		IsBackgroundWorker || xc_maintenance_mode ||
+		MyProc == NULL || MyProc->pgprocno >= MaxBackends)
+		return false;
+
+	if (strlen(prepareGID) >= CommitBatcherCtl->gidsize ||
+		list_length(nodelist) + list_length(coordlist) >
+		CommitBatcherCtl->maxnodes)
+		return false;
+
+	CommitBatcherWaitPending();
+
+	slot = commit_batcher_lookup();
+	if (slot < 0)
+		return false;
+	batcher = &CommitBatcherCtl->batchers[slot];
+
+	/* The request is not visible to the batcher until it is queued */
+	req = CommitBatcherRequestGet(MyProc->pgprocno);
+	Assert(req->status == CB_REQUEST_FREE);
+	req->dboid = MyDatabaseId;
+	req->procno = MyProc->pgprocno;
+	req->gxid = gxid;
+	req->ndatanodes = list_length(nodelist);
+	req->ncoords = list_length(coordlist);
+	req->errmsg[0] = '\0';
+	nodes = CommitBatcherRequestNodes(req);
+	i = 0;
+	foreach(lc, nodelist)
+		nodes[i++] = PGXCNodeGetNodeOid(lfirst_int(lc), PGXC_NODE_DATANODE);
+	foreach(lc, coordlist)
+		nodes[i++] = PGXCNodeGetNodeOid(lfirst_int(lc), PGXC_NODE_COORDINATOR);
+	strcpy(CommitBatcherRequestGid(req), prepareGID);
+
+	/* Batcher might have exited in the meantime */
+	SpinLockAcquire(&CommitBatcherCtl->mutex);
+	if (batcher->dboid == MyDatabaseId && batcher->pid != 0)
+	{
+		req->status = CB_REQUEST_QUEUED;
+		procno = batcher->procno;
+	}
+	SpinLockRelease(&CommitBatcherCtl->mutex);
+
+	if (procno < 0)
+		return false;
+
+	SetLatch(&ProcGlobal->allProcs[procno].procLatch);
+
+	if (!wait)
+	{
+		commit_batcher_pending = true;
+		if (!commit_batcher_exit_registered)
+		{
+			before_shmem_exit(commit_batcher_atexit, 0);
+			commit_batcher_exit_registered = true;
+		}
+		return true;
+	}
+
+	status = commit_batcher_wait(req);
+
+	SpinLockAcquire(&CommitBatcherCtl->mutex);
+	req->status = CB_REQUEST_FREE;
+	SpinLockRelease(&CommitBatcherCtl->mutex);
+
+	if (status == CB_REQUEST_FAILED)
+		ereport(ERROR,
+				(errcode(ERRCODE_INTERNAL_ERROR),
+				 errmsg("failed to COMMIT PREPARED transaction %s: %s",
+						prepareGID, req->errmsg)));
+
+	/* Batcher has exited before it picked up the request */
+	if (status == CB_REQUEST_REJECTED)
+		return false;
+
+	return true;
+}
+
+/*
+ * Complete request. Called with mutex held, the caller should wake up the
+ * session when the mutex is released.
+ */
+static void
+commit_batcher_complete(CommitBatcherRequest *req, const char *errmsg)
+{
+	if (errmsg)
+	{
+		strlcpy(req->errmsg, errmsg, COMMIT_BATCHER_ERRMSG_LEN);
+		req->status = CB_REQUEST_FAILED;
+	}
+	else
+		req->status = CB_REQUEST_DONE;
+}
+
+/*
+ * On exit release the slot and fail requests in progress, we do not know if
+ * they are committed, the sessions will report error. Requests not picked up
+ * yet are returned to the sessions.
+ */
+static void
+commit_batcher_shutdown(int code, Datum arg)
+{
+	int			slot = DatumGetInt32(arg);
+	int		   *procnos;
+	int			count = 0;
+	int			i;
+
+	procnos = (int *) MemoryContextAlloc(TopMemoryContext,
+										 MaxBackends * sizeof(int));
+
+	SpinLockAcquire(&CommitBatcherCtl->mutex);
+	if (CommitBatcherCtl->batchers[slot].pid == MyProcPid)
+	{
+		for (i = 0; i < MaxBackends; i++)
+		{
+			CommitBatcherRequest *req = CommitBatcherRequestGet(i);
+
+			if (req->dboid != CommitBatcherCtl->batchers[slot].dboid)
+				continue;
+
+			if (req->status == CB_REQUEST_RUNNING)
+				commit_batcher_complete(req, "commit batcher has exited, "
+										"transaction outcome is unknown");
+			else if (req->status == CB_REQUEST_QUEUED)
+				req->status = CB_REQUEST_REJECTED;
+			else
+				continue;
+			procnos[count++] = req->procno;
+		}
+		CommitBatcherCtl->batchers[slot].dboid = InvalidOid;
+		CommitBatcherCtl->batchers[slot].pid = 0;
+	}
+	SpinLockRelease(&CommitBatcherCtl->mutex);
+
+	for (i = 0; i < count; i++)
+		SetLatch(&ProcGlobal->allProcs[procnos[i]].procLatch);
+}
+
+/*
+ * Run COMMIT PREPARED for the requests picked up by the batcher
+ */
+static void
+commit_batcher_process(int *reqnos, int count)
+{
+	RemoteCommitPrepared *items;
+	int			i;
+
+	StartTransactionCommand();
+
+	items = (RemoteCommitPrepared *) palloc0(count * sizeof(RemoteCommitPrepared));
+	/* Running requests are not changed by anybody else */
+	for (i = 0; i < count; i++)
+		commit_batcher_request_item(CommitBatcherRequestGet(reqnos[i]),
+									&items[i]);
+
+	RemoteCommitPreparedBatch(items, count);
+
+	SpinLockAcquire(&CommitBatcherCtl->mutex);
+	for (i = 0; i < count; i++)
+		commit_batcher_complete(CommitBatcherRequestGet(reqnos[i]),
+								items[i].errmsg);
+	SpinLockRelease(&CommitBatcherCtl->mutex);
+
+	/* Request slot number is the PGPROC number of the requester */
+	for (i = 0; i < count; i++)
+		SetLatch(&ProcGlobal->allProcs[reqnos[i]].procLatch);
+
+	CommitTransactionCommand();
+}
+
+/*
+ * Main entry point of the commit batcher
+ */
+void
+CommitBatcherMain(Datum main_arg)
+{
+	int			slot = DatumGetInt32(main_arg);
+	int		   *reqnos;
+	Oid			dboid;
+	TimestampTz last_activity;
+
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	SpinLockAcquire(&CommitBatcherCtl->mutex);
+	dboid = CommitBatcherCtl->batchers[slot].dboid;
+	SpinLockRelease(&CommitBatcherCtl->mutex);
+
+	if (!OidIsValid(dboid))
+		proc_exit(0);
+
+	BackgroundWorkerInitializeConnectionByOid(dboid, InvalidOid);
+
+	SpinLockAcquire(&CommitBatcherCtl->mutex);
+	if (CommitBatcherCtl->batchers[slot].dboid != dboid ||
+		CommitBatcherCtl->batchers[slot].pid != 0)
+	{
+		/* Slot has been given to somebody else */
+		SpinLockRelease(&CommitBatcherCtl->mutex);
+		proc_exit(0);
+	}
+	CommitBatcherCtl->batchers[slot].pid = MyProcPid;
+	CommitBatcherCtl->batchers[slot].procno = MyProc->pgprocno;
+	SpinLockRelease(&CommitBatcherCtl->mutex);
+
+	before_shmem_exit(commit_batcher_shutdown, Int32GetDatum(slot));
+
+	/* Keep the connections to the nodes between the batches */
+	PersistentConnections = true;
+
+	StartTransactionCommand();
+	InitMultinodeExecutor(false);
+	CommitTransactionCommand();
+
+	reqnos = (int *) MemoryContextAlloc(TopMemoryContext,
+										MaxBackends * sizeof(int));
+	last_activity = GetCurrentTimestamp();
+
+	for (;;)
+	{
+		int			count = 0;
+		int			i;
+		int			rc;
+
+		CHECK_FOR_INTERRUPTS();
+
+		/* Pick up everything queued */
+		SpinLockAcquire(&CommitBatcherCtl->mutex);
+		for (i = 0; i < MaxBackends; i++)
+		{
+			CommitBatcherRequest *req = CommitBatcherRequestGet(i);
+
+			if (req->status == CB_REQUEST_QUEUED && req->dboid == dboid)
+			{
+				req->status = CB_REQUEST_RUNNING;
+				reqnos[count++] = i;
+			}
+		}
+		if (count == 0 &&
+			TimestampDifferenceExceeds(last_activity, GetCurrentTimestamp(),
+									   COMMIT_BATCHER_IDLE_TIMEOUT))
+		{
+			/* Nothing is queued and nobody could queue without the slot */
+			CommitBatcherCtl->batchers[slot].dboid = InvalidOid;
+			CommitBatcherCtl->batchers[slot].pid = 0;
+			SpinLockRelease(&CommitBatcherCtl->mutex);
+			proc_exit(0);
+		}
+		SpinLockRelease(&CommitBatcherCtl->mutex);
+
+		if (count > 0)
+		{
+			commit_batcher_process(reqnos, count);
+			last_activity = GetCurrentTimestamp();
+			continue;
+		}
+
+		rc = WaitLatch(MyLatch,
+					   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					   COMMIT_BATCHER_IDLE_TIMEOUT,
+					   WAIT_EVENT_COMMIT_BATCHER_MAIN);
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+		ResetLatch(MyLatch);
+	}
+}
@@ -18,6 +18,7 @@
 
 #include <time.h>
 #include "postgres.h"
+#include "access/hash.h"
 #include "access/twophase.h"
 #include "access/gtm.h"
 #include "access/sysattr.h"
@@ -27,10 +28,15 @@
 #include "catalog/pg_type.h"
 #include "catalog/pgxc_node.h"
 #include "commands/prepare.h"
+#include "common/sha2.h"
 #include "executor/executor.h"
 #include "gtm/gtm_c.h"
+#include "lib/binaryheap.h"
 #include "libpq/libpq.h"
+#include "libpq/pqformat.h"
 #include "miscadmin.h"
+#include "pgxc/barrier.h"
+#include "pgxc/commitbatcher.h"
 #include "pgxc/execRemote.h"
 #include "tcop/tcopprot.h"
 #include "executor/nodeSubplan.h"
@@ -45,10 +51,12 @@
 #include "storage/ipc.h"
 #include "storage/proc.h"
 #include "utils/datum.h"
+#include "utils/hsearch.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/pg_rusage.h"
-#include "utils/tuplesort.h"
+#include "utils/resowner.h"
+#include "utils/sortsupport.h"
 #include "utils/snapmgr.h"
 #include "utils/builtins.h"
 #include "pgxc/locator.h"
@@ -70,6 +78,9 @@
 
 /* Declarations used by guc.c */
 int PGXLRemoteFetchSize;
+int PGXLRemoteBatchSize;
+bool PGXLRemotePipeline;
+int RemoteSubplanDigestMinSize;
 
 typedef struct
 {
@@ -85,12 +96,21 @@ struct find_params_context
 };
 
 /*
- * Buffer size does not affect performance significantly, just do not allow
- * connection buffer grows infinitely
+ * COPY data rows are collected in the connection buffer and sent down once
+ * it reaches this size. Each flush costs a poll for errors and a send, so the
+ * buffer should be large enough for small rows, but do not allow connection
+ * buffer grows infinitely
  */
-#define COPY_BUFFER_SIZE 8192
+#define COPY_BUFFER_SIZE 65536
 #define PRIMARY_NODE_WRITEAHEAD 1024 * 1024
 
+/*
+ * Cursors of a RemoteSubplan first fetch 1/REMOTE_FETCH_RAMP of
+ * pgxl_remote_fetch_size rows, and double the amount with every further
+ * request up to REMOTE_FETCH_RAMP times pgxl_remote_fetch_size.
+ */
+#define REMOTE_FETCH_RAMP	8
+
 /*
  * Flag to track if a temporary object is accessed by the current transaction
  */
@@ -112,17 +132,27 @@ static bool pgxc_start_command_on_connection(PGXCNodeHandle *connection,
 
 static void pgxc_node_remote_count(int *dnCount, int dnNodeIds[],
 		int *coordCount, int coordNodeIds[]);
-static char *pgxc_node_remote_prepare(char *prepareGID, bool localNode);
+static PGXCNodeHandle *pgxc_node_onephase_participant(PGXCNodeAllHandles *handles);
+static char *pgxc_node_remote_prepare(char *prepareGID, bool localNode,
+						 bool onephase, bool start_gtm);
 static bool pgxc_node_remote_finish(char *prepareGID, bool commit,
 						char *nodestring, GlobalTransactionId gxid,
-						GlobalTransactionId prepare_gxid);
+						GlobalTransactionId prepare_gxid, bool async);
 static void pgxc_node_remote_commit(void);
 static void pgxc_node_remote_abort(void);
 static void pgxc_connections_cleanup(ResponseCombiner *combiner);
+static void FreeRowBuffers(ResponseCombiner *combiner);
+static void remote_fetch_grow(ResponseCombiner *combiner);
 
 static void pgxc_node_report_error(ResponseCombiner *combiner);
 
 static bool determine_param_types(Plan *plan,  struct find_params_context *context);
+static bool subplan_has_gather(Plan *plan);
+static void pgxc_node_send_missing_plans(int conn_count,
+							 PGXCNodeHandle **connections,
+							 const char *cursor, const char *planstr,
+							 const uint8 *digest,
+							 short num_params, Oid *param_types);
 
 #define REMOVE_CURR_CONN(combiner) \
 	if ((combiner)->current_conn < --((combiner)->conn_count)) \
@@ -244,12 +274,19 @@ InitResponseCombiner(ResponseCombiner *combiner, int node_count,
 	combiner->probing_primary = false;
 	combiner->returning_node = InvalidOid;
 	combiner->currentRow = NULL;
-	combiner->rowBuffer = NIL;
+	combiner->rowBufferCount = 0;
+	combiner->rowBufferRows = 0;
+	combiner->rowBufferNodes = NULL;
+	combiner->rowBuffers = NULL;
 	combiner->tapenodes = NULL;
 	combiner->merge_sort = false;
 	combiner->extended_query = false;
-	combiner->tapemarks = NULL;
-	combiner->tuplesortstate = NULL;
+	combiner->mergestate = NULL;
+	combiner->fetch_size = PGXLRemoteFetchSize;
+	combiner->fetch_size_initial = 0;
+	combiner->fetch_is_bound = false;
+	combiner->fetch_rows = 0;
+	combiner->fetch_bytes = 0;
 	combiner->cursor = NULL;
 	combiner->update_cursor = NULL;
 	combiner->cursor_count = 0;
@@ -839,6 +876,85 @@ HandleDatanodeCommandId(ResponseCombiner *combiner, char *msg_body, size_t len)
 		SetReceivedCommandId(cid);
 }
 
+/*
+ * HandleRemoteInstrumentation ('i') message from a Datanode connection
+ *
+ * Datanode reports execution statistics of the fragment it ran under EXPLAIN
+ * ANALYZE.  Keep them in the RemoteSubplanState, EXPLAIN prints them out.
+ * Figures of subsequent executions on the same node are summed up.
+ */
+static void
+HandleRemoteInstrumentation(ResponseCombiner *combiner, PGXCNodeHandle *conn,
+							char *msg_body, size_t len)
+{
+	RemoteSubplanState *planstate;
+	RemoteInstrumentation *instr;
+	RemoteInstrumentation *prev = NULL;
+	StringInfoData buf;
+	MemoryContext oldcontext;
+	ListCell   *lc;
+
+	/* Statistics are only requested by RemoteSubplan */
+	if (combiner == NULL || !IsA(combiner, RemoteSubplanState))
+		return;
+	planstate = (RemoteSubplanState *) combiner;
+
+	buf.data = msg_body;
+	buf.len = len;
+	buf.maxlen = len;
+	buf.cursor = 0;
+
+	oldcontext = MemoryContextSwitchTo(combiner->ss.ps.state->es_query_cxt);
+	instr = (RemoteInstrumentation *) palloc0(sizeof(RemoteInstrumentation));
+	instr->nodeoid = conn->nodeoid;
+	instr->startup = pq_getmsgfloat8(&buf);
+	instr->total = pq_getmsgfloat8(&buf);
+	instr->ntuples = pq_getmsgfloat8(&buf);
+	instr->nloops = pq_getmsgfloat8(&buf);
+	instr->bufusage.shared_blks_hit = pq_getmsgint64(&buf);
+	instr->bufusage.shared_blks_read = pq_getmsgint64(&buf);
+	instr->bufusage.shared_blks_dirtied = pq_getmsgint64(&buf);
+	instr->bufusage.shared_blks_written = pq_getmsgint64(&buf);
+	instr->bufusage.local_blks_hit = pq_getmsgint64(&buf);
+	instr->bufusage.local_blks_read = pq_getmsgint64(&buf);
+	instr->bufusage.local_blks_dirtied = pq_getmsgint64(&buf);
+	instr->bufusage.local_blks_written = pq_getmsgint64(&buf);
+	instr->bufusage.temp_blks_read = pq_getmsgint64(&buf);
+	instr->bufusage.temp_blks_written = pq_getmsgint64(&buf);
+	instr->memory = pq_getmsgint64(&buf);
+	pq_getmsgend(&buf);
+
+	foreach(lc, planstate->remote_instr)
+	{
+		prev = (RemoteInstrumentation *) lfirst(lc);
+		if (prev->nodeoid == instr->nodeoid)
+			break;
+		prev = NULL;
+	}
+	if (prev)
+	{
+		prev->startup += instr->startup;
+		prev->total += instr->total;
+		prev->ntuples += instr->ntuples;
+		prev->nloops += instr->nloops;
+		prev->bufusage.shared_blks_hit += instr->bufusage.shared_blks_hit;
+		prev->bufusage.shared_blks_read += instr->bufusage.shared_blks_read;
+		prev->bufusage.shared_blks_dirtied += instr->bufusage.shared_blks_dirtied;
+		prev->bufusage.shared_blks_written += instr->bufusage.shared_blks_written;
+		prev->bufusage.local_blks_hit += instr->bufusage.local_blks_hit;
+		prev->bufusage.local_blks_read += instr->bufusage.local_blks_read;
+		prev->bufusage.local_blks_dirtied += instr->bufusage.local_blks_dirtied;
+		prev->bufusage.local_blks_written += instr->bufusage.local_blks_written;
+		prev->bufusage.temp_blks_read += instr->bufusage.temp_blks_read;
+		prev->bufusage.temp_blks_written += instr->bufusage.temp_blks_written;
+		prev->memory = Max(prev->memory, instr->memory);
+		pfree(instr);
+	}
+	else
+		planstate->remote_instr = lappend(planstate->remote_instr, instr);
+	MemoryContextSwitchTo(oldcontext);
+}
+
 /*
  * Record waited-for XIDs received from the remote nodes into the transaction
  * state
@@ -936,8 +1052,7 @@ CloseCombiner(ResponseCombiner *combiner)
 		pfree(combiner->cursor_connections);
 	if (combiner->tapenodes)
 		pfree(combiner->tapenodes);
-	if (combiner->tapemarks)
-		pfree(combiner->tapemarks);
+	FreeRowBuffers(combiner);
 }
 
 /*
@@ -953,6 +1068,147 @@ ValidateAndCloseCombiner(ResponseCombiner *combiner)
 	return valid;
 }
 
+/*
+ * Find the row buffer of the specified node, create new if requested.
+ * Returns NULL if the node has no buffer and create is false.
+ */
+static Tuplestorestate *
+GetRowBuffer(ResponseCombiner *combiner, Oid nodeoid, bool create)
+{
+	Tuplestorestate *rowbuffer;
+	ResourceOwner oldowner;
+	MemoryContext oldcontext;
+	int			i;
+
+	for (i = 0; i < combiner->rowBufferCount; i++)
+	{
+		if (combiner->rowBufferNodes[i] == nodeoid)
+			return combiner->rowBuffers[i];
+	}
+
+	if (!create)
+		return NULL;
+
+	oldcontext = MemoryContextSwitchTo(combiner->ss.ps.ps_ResultTupleSlot->tts_mcxt);
+	if (combiner->rowBuffers == NULL)
+	{
+		combiner->rowBufferNodes = (Oid *) palloc(sizeof(Oid));
+		combiner->rowBuffers = (Tuplestorestate **)
+				palloc(sizeof(Tuplestorestate *));
+	}
+	else
+	{
+		combiner->rowBufferNodes = (Oid *)
+				repalloc(combiner->rowBufferNodes,
+						 (combiner->rowBufferCount + 1) * sizeof(Oid));
+		combiner->rowBuffers = (Tuplestorestate **)
+				repalloc(combiner->rowBuffers,
+						 (combiner->rowBufferCount + 1) * sizeof(Tuplestorestate *));
+	}
+
+	/*
+	 * Buffering is often done on behalf of other portal, which is
+	 * trying to control the connection, and that portal may be closed
+	 * before the rows are consumed. So attach temporary file of the
+	 * buffer to the transaction rather then to the current portal.
+	 */
+	oldowner = CurrentResourceOwner;
+	if (TopTransactionResourceOwner)
+		CurrentResourceOwner = TopTransactionResourceOwner;
+	rowbuffer = tuplestore_begin_datarow(false, work_mem, NULL);
+	CurrentResourceOwner = oldowner;
+
+	/*
+	 * Rows are written using the default read pointer and read using
+	 * dedicated one, rows already read are trimmed off.
+	 */
+	tuplestore_set_eflags(rowbuffer, 0);
+	tuplestore_alloc_read_pointer(rowbuffer, 0);
+
+	combiner->rowBufferNodes[combiner->rowBufferCount] = nodeoid;
+	combiner->rowBuffers[combiner->rowBufferCount] = rowbuffer;
+	combiner->rowBufferCount++;
+	MemoryContextSwitchTo(oldcontext);
+
+	return rowbuffer;
+}
+
+/*
+ * Buffer the data row, the row is copied, so caller may free it
+ */
+static void
+BufferDataRow(ResponseCombiner *combiner, RemoteDataRow datarow)
+{
+	Tuplestorestate *rowbuffer = GetRowBuffer(combiner, datarow->msgnode, true);
+
+	tuplestore_putdatarow(rowbuffer, datarow);
+	combiner->rowBufferRows++;
+}
+
+/*
+ * Get next buffered data row from the specified node, or from any node if
+ * nodeoid is InvalidOid. Returns NULL if no such rows are buffered.
+ * Returned row is allocated in the memory context of the result slot.
+ */
+static RemoteDataRow
+GetBufferedDataRow(ResponseCombiner *combiner, Oid nodeoid)
+{
+	MemoryContext oldcontext;
+	RemoteDataRow datarow = NULL;
+	int			i;
+
+	if (combiner->rowBufferRows == 0)
+		return NULL;
+
+	oldcontext = MemoryContextSwitchTo(combiner->ss.ps.ps_ResultTupleSlot->tts_mcxt);
+	for (i = 0; i < combiner->rowBufferCount; i++)
+	{
+		Tuplestorestate *rowbuffer = combiner->rowBuffers[i];
+
+		if (OidIsValid(nodeoid) && combiner->rowBufferNodes[i] != nodeoid)
+			continue;
+
+		tuplestore_select_read_pointer(rowbuffer, 1);
+		datarow = tuplestore_getdatarow(rowbuffer);
+		tuplestore_select_read_pointer(rowbuffer, 0);
+
+		if (datarow)
+		{
+			combiner->rowBufferRows--;
+			tuplestore_trim(rowbuffer);
+			break;
+		}
+
+		/* The buffer is drained, release memory and temporary file */
+		tuplestore_clear(rowbuffer);
+		if (OidIsValid(nodeoid))
+			break;
+	}
+	MemoryContextSwitchTo(oldcontext);
+
+	return datarow;
+}
+
+/*
+ * Discard buffered rows and release the buffers
+ */
+static void
+FreeRowBuffers(ResponseCombiner *combiner)
+{
+	int			i;
+
+	for (i = 0; i < combiner->rowBufferCount; i++)
+		tuplestore_end(combiner->rowBuffers[i]);
+	if (combiner->rowBufferNodes)
+		pfree(combiner->rowBufferNodes);
+	if (combiner->rowBuffers)
+		pfree(combiner->rowBuffers);
+	combiner->rowBufferCount = 0;
+	combiner->rowBufferRows = 0;
+	combiner->rowBufferNodes = NULL;
+	combiner->rowBuffers = NULL;
+}
+
 /*
  * It is possible if multiple steps share the same Datanode connection, when
  * executor is running multi-step query or client is running multiple queries
@@ -997,23 +1253,6 @@ BufferConnection(PGXCNodeHandle *conn)
 	}
 	Assert(combiner->current_conn < combiner->conn_count);
 
-	if (combiner->tapemarks == NULL)
-		combiner->tapemarks = (ListCell**) palloc0(combiner->conn_count * sizeof(ListCell*));
-
-	/*
-	 * If current bookmark for the current tape is not set it means either
-	 * first row in the buffer is from the current tape or no rows from
-	 * the tape in the buffer, so if first row is not from current
-	 * connection bookmark the last cell in the list.
-	 */
-	if (combiner->tapemarks[combiner->current_conn] == NULL &&
-			list_length(combiner->rowBuffer) > 0)
-	{
-		RemoteDataRow dataRow = (RemoteDataRow) linitial(combiner->rowBuffer);
-		if (dataRow->msgnode != conn->nodeoid)
-			combiner->tapemarks[combiner->current_conn] = list_tail(combiner->rowBuffer);
-	}
-
 	/*
 	 * Buffer data rows until data node return number of rows specified by the
 	 * fetch_size parameter of last Execute message (PortalSuspended message)
@@ -1026,8 +1265,8 @@ BufferConnection(PGXCNodeHandle *conn)
 		/* Move to buffer currentRow (received from the data node) */
 		if (combiner->currentRow)
 		{
-			combiner->rowBuffer = lappend(combiner->rowBuffer,
-										  combiner->currentRow);
+			BufferDataRow(combiner, combiner->currentRow);
+			pfree(combiner->currentRow);
 			combiner->currentRow = NULL;
 		}
 
@@ -1078,12 +1317,10 @@ BufferConnection(PGXCNodeHandle *conn)
 			 * number was this connection, but we need this info to find proper
 			 * tuple in the buffer if we are doing merge sort. So store node
 			 * number in special array.
-			 * NB: We can not test if combiner->tuplesortstate is set here:
-			 * connection may require buffering inside tuplesort_begin_merge
-			 * - while pre-read rows from the tapes, one of the tapes may be
-			 * the local connection with RemoteSubplan in the tree. The
-			 * combiner->tuplesortstate is set only after tuplesort_begin_merge
-			 * returns.
+			 * NB: We can not test if the merge is running here: connection
+			 * may require buffering before the merge reads the first rows
+			 * from the tapes, or while it reads them, if one of the tapes is
+			 * the local connection with RemoteSubplan in the tree.
 			 */
 			if (combiner->merge_sort)
 			{
@@ -1139,12 +1376,26 @@ BufferConnection(PGXCNodeHandle *conn)
 /*
  * copy the datarow from combiner to the given slot, in the slot's memory
  * context
+ *
+ * If the row already lives there, as is the case for rows taken from the
+ * row buffer and usually also for rows just read from the connection, the
+ * slot takes it over as it is.  Combined with printtup sending DataRow
+ * based tuples unchanged, that relays the rows of a pass-through query to
+ * the client without copying them around.
  */
 static void
 CopyDataRowTupleToSlot(ResponseCombiner *combiner, TupleTableSlot *slot)
 {
 	RemoteDataRow 	datarow;
 	MemoryContext	oldcontext;
+
+	if (GetMemoryChunkContext(combiner->currentRow) == slot->tts_mcxt)
+	{
+		ExecStoreDataRowTuple(combiner->currentRow, slot, true);
+		combiner->currentRow = NULL;
+		return;
+	}
+
 	oldcontext = MemoryContextSwitchTo(slot->tts_mcxt);
 	datarow = (RemoteDataRow) palloc(sizeof(RemoteDataRowData) + combiner->currentRow->msglen);
 	datarow->msgnode = combiner->currentRow->msgnode;
@@ -1156,6 +1407,35 @@ CopyDataRowTupleToSlot(ResponseCombiner *combiner, TupleTableSlot *slot)
 	MemoryContextSwitchTo(oldcontext);
 }
 
+/*
+ * Called before asking a suspended cursor for more rows: the consumer wants
+ * more than we fetched so far, so double the size of the next request.  Do
+ * not go over REMOTE_FETCH_RAMP times pgxl_remote_fetch_size, nor over what
+ * fits in work_mem, given the average size of the rows received so far, as
+ * the rows may have to be buffered when several nodes are read or the
+ * connection is needed for something else.
+ */
+static void
+remote_fetch_grow(ResponseCombiner *combiner)
+{
+	int64		limit;
+
+	if (combiner->fetch_is_bound || combiner->fetch_size <= 0)
+		return;
+
+	limit = (int64) PGXLRemoteFetchSize * REMOTE_FETCH_RAMP;
+	if (combiner->fetch_rows > 0)
+	{
+		int64		width = Max(combiner->fetch_bytes / combiner->fetch_rows, 1);
+
+		limit = Min(limit, work_mem * 1024L / width);
+	}
+	limit = Max(limit, PGXLRemoteFetchSize);
+
+	if (combiner->fetch_size < limit)
+		combiner->fetch_size = (int) Min((int64) combiner->fetch_size * 2, limit);
+}
+
 
 /*
  * FetchTuple
@@ -1167,7 +1447,7 @@ CopyDataRowTupleToSlot(ResponseCombiner *combiner, TupleTableSlot *slot)
  * connection defined by combiner->current_conn, or NULL slot if no more tuple
  * are available from the connection. Otherwise it returns tuple from any
  * connection or NULL slot if no more available connections.
- * 		Function looks into combiner->rowBuffer before accessing connection
+ * 		Function looks into combiner->rowBuffers before accessing connection
  * and return a tuple from there if found.
  * 		Function may wait while more data arrive from the data nodes. If there
  * is a locally executed subplan function advance it and buffer resulting rows
@@ -1248,80 +1528,14 @@ FetchTuple(ResponseCombiner *combiner)
 	 * When we are performing merge sort we need to get from the buffer record
 	 * from the connection marked as "current". Otherwise get first.
 	 */
-	if (list_length(combiner->rowBuffer) > 0)
+	if (combiner->rowBufferRows > 0)
 	{
-		RemoteDataRow dataRow;
-
 		Assert(combiner->currentRow == NULL);
 
 		if (combiner->merge_sort)
-		{
-			ListCell *lc;
-			ListCell *prev;
-
 			elog(DEBUG1, "Getting buffered tuple from node %x", nodeOid);
-
-			prev = combiner->tapemarks[combiner->current_conn];
-			if (prev)
-			{
-				/*
-				 * Start looking through the list from the bookmark.
-				 * Probably the first cell we check contains row from the needed
-				 * node. Otherwise continue scanning until we encounter one,
-				 * advancing prev pointer as well.
-				 */
-				while((lc = lnext(prev)) != NULL)
-				{
-					dataRow = (RemoteDataRow) lfirst(lc);
-					if (dataRow->msgnode == nodeOid)
-					{
-						combiner->currentRow = dataRow;
-						break;
-					}
-					prev = lc;
-				}
-			}
-			else
-			{
-				/*
-				 * Either needed row is the first in the buffer or no such row
-				 */
-				lc = list_head(combiner->rowBuffer);
-				dataRow = (RemoteDataRow) lfirst(lc);
-				if (dataRow->msgnode == nodeOid)
-					combiner->currentRow = dataRow;
-				else
-					lc = NULL;
-			}
-			if (lc)
-			{
-				/*
-				 * Delete cell from the buffer. Before we delete we must check
-				 * the bookmarks, if the cell is a bookmark for any tape.
-				 * If it is the case we are deleting last row of the current
-				 * block from the current tape. That tape should have bookmark
-				 * like current, and current bookmark will be advanced when we
-				 * read the tape once again.
-				 */
-				int i;
-				for (i = 0; i < combiner->conn_count; i++)
-				{
-					if (combiner->tapemarks[i] == lc)
-						combiner->tapemarks[i] = prev;
-				}
-				elog(DEBUG1, "Found buffered tuple from node %x", nodeOid);
-				combiner->rowBuffer = list_delete_cell(combiner->rowBuffer,
-													   lc, prev);
-			}
-			elog(DEBUG1, "Update tapemark");
-			combiner->tapemarks[combiner->current_conn] = prev;
-		}
-		else
-		{
-			dataRow = (RemoteDataRow) linitial(combiner->rowBuffer);
-			combiner->currentRow = dataRow;
-			combiner->rowBuffer = list_delete_first(combiner->rowBuffer);
-		}
+		combiner->currentRow = GetBufferedDataRow(combiner,
+							combiner->merge_sort ? nodeOid : InvalidOid);
 	}
 
 	/* If we have node message in the currentRow slot, and it is from a proper
@@ -1359,7 +1573,24 @@ FetchTuple(ResponseCombiner *combiner)
 				return NULL;
 			}
 
-			if (pgxc_node_send_execute(conn, combiner->cursor, PGXLRemoteFetchSize) != 0)
+			/* The node has given us all we may need */
+			if (combiner->fetch_is_bound)
+			{
+				if (combiner->merge_sort)
+				{
+					combiner->connections[combiner->current_conn] = NULL;
+					return NULL;
+				}
+				REMOVE_CURR_CONN(combiner);
+				if (combiner->conn_count == 0)
+					return NULL;
+				conn = combiner->connections[combiner->current_conn];
+				combiner->current_conn_rows_consumed = 0;
+				continue;
+			}
+
+			remote_fetch_grow(combiner);
+			if (pgxc_node_send_execute(conn, combiner->cursor, combiner->fetch_size) != 0)
 			{
 				ereport(ERROR,
 						(errcode(ERRCODE_INTERNAL_ERROR),
@@ -1385,6 +1616,8 @@ FetchTuple(ResponseCombiner *combiner)
 		res = handle_response(conn, combiner);
 		if (res == RESPONSE_DATAROW)
 		{
+			combiner->fetch_rows++;
+			combiner->fetch_bytes += combiner->currentRow->msglen;
 			slot = combiner->ss.ps.ps_ResultTupleSlot;
 			CopyDataRowTupleToSlot(combiner, slot);
 			combiner->current_conn_rows_consumed++;
@@ -1407,7 +1640,64 @@ FetchTuple(ResponseCombiner *combiner)
 		}
 		else if (res == RESPONSE_EOF)
 		{
-			/* incomplete message, read more */
+			/*
+			 * Incomplete message, read more. Unless we have to stay on the
+			 * current connection, wait on all of them and go on with
+			 * whichever has a message first, instead of blocking on the
+			 * current one while the others may have data ready.
+			 */
+			if (!combiner->merge_sort && !combiner->probing_primary &&
+				combiner->conn_count > 1)
+			{
+				int			i;
+
+				if (pgxc_node_receive(combiner->conn_count,
+									  combiner->connections, NULL))
+					ereport(ERROR,
+							(errcode(ERRCODE_INTERNAL_ERROR),
+							 errmsg("Failed to receive more data from data nodes")));
+
+				if (!HAS_MESSAGE_BUFFERED(conn))
+				{
+					for (i = 0; i < combiner->conn_count; i++)
+					{
+						if (HAS_MESSAGE_BUFFERED(combiner->connections[i]))
+						{
+							combiner->current_conn = i;
+							combiner->current_conn_rows_consumed = 0;
+							conn = combiner->connections[i];
+							break;
+						}
+					}
+				}
+				continue;
+			}
+
+			/*
+			 * Merge has to stay on the current connection, but with cursors
+			 * the amount of data coming from a node is limited by the fetch
+			 * size, so read whatever arrives on the other connections while
+			 * waiting. The nodes do not have to wait for us to drain their
+			 * sockets, and their rows are there when the merge needs them.
+			 */
+			if (combiner->merge_sort && combiner->extended_query &&
+				combiner->conn_count > 1)
+			{
+				PGXCNodeHandle *active[combiner->conn_count];
+				int			nactive = 0;
+				int			i;
+
+				for (i = 0; i < combiner->conn_count; i++)
+					if (combiner->connections[i])
+						active[nactive++] = combiner->connections[i];
+
+				if (pgxc_node_receive(nactive, active, NULL))
+					ereport(ERROR,
+							(errcode(ERRCODE_INTERNAL_ERROR),
+							 errmsg("Failed to receive more data from data nodes")));
+				continue;
+			}
+
 			if (pgxc_node_receive(1, &conn, NULL))
 				ereport(ERROR,
 						(errcode(ERRCODE_INTERNAL_ERROR),
@@ -1416,6 +1706,26 @@ FetchTuple(ResponseCombiner *combiner)
 		}
 		else if (res == RESPONSE_SUSPENDED)
 		{
+			/*
+			 * If the parent needs no more rows than we have requested, the
+			 * node has given us all it can contribute. Leave the portal
+			 * suspended, it is closed when the subplan ends.
+			 */
+			if (combiner->fetch_is_bound && !combiner->probing_primary)
+			{
+				if (combiner->merge_sort)
+				{
+					combiner->connections[combiner->current_conn] = NULL;
+					return NULL;
+				}
+				REMOVE_CURR_CONN(combiner);
+				if (combiner->conn_count == 0)
+					return NULL;
+				conn = combiner->connections[combiner->current_conn];
+				combiner->current_conn_rows_consumed = 0;
+				continue;
+			}
+
 			/*
 			 * If we are doing merge sort or probing primary node we should
 			 * remain on the same node, so query next portion immediately.
@@ -1423,7 +1733,8 @@ FetchTuple(ResponseCombiner *combiner)
 			 */
 			if (combiner->merge_sort || combiner->probing_primary)
 			{
-				if (pgxc_node_send_execute(conn, combiner->cursor, PGXLRemoteFetchSize) != 0)
+				remote_fetch_grow(combiner);
+				if (pgxc_node_send_execute(conn, combiner->cursor, combiner->fetch_size) != 0)
 					ereport(ERROR,
 							(errcode(ERRCODE_INTERNAL_ERROR),
 							 errmsg("Failed to send execute cursor '%s' to node %u", combiner->cursor, conn->nodeoid)));
@@ -1442,7 +1753,8 @@ FetchTuple(ResponseCombiner *combiner)
 			 * Tell the node to fetch data in background, next loop when we 
 			 * pgxc_node_receive, data is already there, so we can run faster
 			 * */
-			if (pgxc_node_send_execute(conn, combiner->cursor, PGXLRemoteFetchSize) != 0)
+			remote_fetch_grow(combiner);
+			if (pgxc_node_send_execute(conn, combiner->cursor, combiner->fetch_size) != 0)
 			{
 				ereport(ERROR,
 						(errcode(ERRCODE_INTERNAL_ERROR),
@@ -1555,6 +1867,174 @@ FetchTuple(ResponseCombiner *combiner)
 }
 
 
+/*
+ * State of the merge of sorted results coming from multiple nodes.
+ *
+ * There is a slot holding the current tuple of every connection, and a binary
+ * heap of the connection numbers ordered by these tuples. A connection is
+ * read only when its tuple has been returned, so the merge fetches no more
+ * rows than the caller needs.
+ */
+typedef struct RemoteMergeState
+{
+	int			nslots;			/* number of merged connections */
+	TupleTableSlot **slots;		/* current tuple of each connection */
+	binaryheap *heap;			/* connections ordered by current tuples */
+	int			nkeys;
+	SortSupport sortkeys;
+	bool		initialized;	/* the first tuples are read */
+} RemoteMergeState;
+
+/*
+ * Compare the current tuples of the connections. The binaryheap has the
+ * largest element on top, so the result is reversed.
+ */
+static int
+remote_merge_compare(Datum a, Datum b, void *arg)
+{
+	RemoteMergeState *ms = (RemoteMergeState *) arg;
+	TupleTableSlot *s1 = ms->slots[DatumGetInt32(a)];
+	TupleTableSlot *s2 = ms->slots[DatumGetInt32(b)];
+	int			nkey;
+
+	for (nkey = 0; nkey < ms->nkeys; nkey++)
+	{
+		SortSupport sortKey = ms->sortkeys + nkey;
+		AttrNumber	attno = sortKey->ssup_attno;
+		Datum		datum1,
+					datum2;
+		bool		isNull1,
+					isNull2;
+		int			compare;
+
+		datum1 = slot_getattr(s1, attno, &isNull1);
+		datum2 = slot_getattr(s2, attno, &isNull2);
+
+		compare = ApplySortComparator(datum1, isNull1,
+									  datum2, isNull2,
+									  sortKey);
+		if (compare != 0)
+			return -compare;
+	}
+	return 0;
+}
+
+/*
+ * Read next tuple of the connection into its slot. Returns false if the
+ * connection has no more tuples.
+ */
+static bool
+remote_merge_fetch(ResponseCombiner *combiner, RemoteMergeState *ms, int tape)
+{
+	TupleTableSlot *slot;
+
+	combiner->current_conn = tape;
+	slot = FetchTuple(combiner);
+	if (TupIsNull(slot))
+	{
+		ExecClearTuple(ms->slots[tape]);
+		return false;
+	}
+	ExecStoreMinimalTuple(ExecCopySlotMinimalTuple(slot), ms->slots[tape],
+						  true);
+	return true;
+}
+
+/*
+ * Set up merge of the tuples coming from the combiner connections, which are
+ * sorted according to the sort description.
+ */
+static void
+remote_merge_begin(ResponseCombiner *combiner, TupleDesc tupDesc,
+				   SimpleSort *sort)
+{
+	RemoteMergeState *ms;
+	int			i;
+
+	ms = (RemoteMergeState *) palloc(sizeof(RemoteMergeState));
+	ms->nslots = combiner->conn_count;
+	ms->slots = (TupleTableSlot **)
+		palloc(ms->nslots * sizeof(TupleTableSlot *));
+	for (i = 0; i < ms->nslots; i++)
+		ms->slots[i] = MakeSingleTupleTableSlot(tupDesc);
+	ms->heap = binaryheap_allocate(ms->nslots, remote_merge_compare, ms);
+
+	ms->nkeys = sort->numCols;
+	ms->sortkeys = (SortSupport) palloc0(ms->nkeys * sizeof(SortSupportData));
+	for (i = 0; i < ms->nkeys; i++)
+	{
+		SortSupport sortKey = ms->sortkeys + i;
+
+		sortKey->ssup_cxt = CurrentMemoryContext;
+		sortKey->ssup_collation = sort->sortCollations[i];
+		sortKey->ssup_nulls_first = sort->nullsFirst[i];
+		sortKey->ssup_attno = sort->sortColIdx[i];
+
+		PrepareSortSupportFromOrderingOp(sort->sortOperators[i], sortKey);
+	}
+	ms->initialized = false;
+
+	combiner->mergestate = ms;
+}
+
+/*
+ * Return next tuple of the merge in the result slot, or NULL if all the
+ * connections are done. The tuple stays valid until the next call.
+ */
+static TupleTableSlot *
+remote_merge_next(ResponseCombiner *combiner)
+{
+	RemoteMergeState *ms = (RemoteMergeState *) combiner->mergestate;
+	TupleTableSlot *resultslot = combiner->ss.ps.ps_ResultTupleSlot;
+	int			tape;
+
+	if (!ms->initialized)
+	{
+		for (tape = 0; tape < ms->nslots; tape++)
+			if (remote_merge_fetch(combiner, ms, tape))
+				binaryheap_add_unordered(ms->heap, Int32GetDatum(tape));
+		binaryheap_build(ms->heap);
+		ms->initialized = true;
+	}
+	else if (!binaryheap_empty(ms->heap))
+	{
+		/* The tuple returned last time was on top, replace it */
+		tape = DatumGetInt32(binaryheap_first(ms->heap));
+		if (remote_merge_fetch(combiner, ms, tape))
+			binaryheap_replace_first(ms->heap, Int32GetDatum(tape));
+		else
+			(void) binaryheap_remove_first(ms->heap);
+	}
+
+	if (binaryheap_empty(ms->heap))
+		return NULL;
+
+	tape = DatumGetInt32(binaryheap_first(ms->heap));
+	return ExecStoreMinimalTuple(ms->slots[tape]->tts_mintuple, resultslot,
+								 false);
+}
+
+/*
+ * Release the merge resources
+ */
+static void
+remote_merge_end(ResponseCombiner *combiner)
+{
+	RemoteMergeState *ms = (RemoteMergeState *) combiner->mergestate;
+	int			i;
+
+	/* Result slot may reference the tuple of a merge slot */
+	ExecClearTuple(combiner->ss.ps.ps_ResultTupleSlot);
+	for (i = 0; i < ms->nslots; i++)
+		ExecDropSingleTupleTableSlot(ms->slots[i]);
+	pfree(ms->slots);
+	binaryheap_free(ms->heap);
+	pfree(ms->sortkeys);
+	pfree(ms);
+	combiner->mergestate = NULL;
+}
+
+
 /*
  * Handle responses from the Datanode connections
  */
@@ -1785,6 +2265,9 @@ handle_response(PGXCNodeHandle *conn, ResponseCombiner *combiner)
 			case 'M':			/* Command Id */
 				HandleDatanodeCommandId(combiner, msg, msg_len);
 				break;
+			case 'i':			/* Instrumentation */
+				HandleRemoteInstrumentation(combiner, conn, msg, msg_len);
+				break;
 			case 'b':
 				PGXCNodeSetConnectionState(conn, DN_CONNECTION_STATE_IDLE);
 				return RESPONSE_BARRIER_OK;
@@ -1946,114 +2429,28 @@ pgxc_node_begin(int conn_count, PGXCNodeHandle **connections,
 	sprintf(lxid, "%u", MyProc->lxid);
 	PGXCNodeSetParam(true, "coordinator_lxid", lxid, 0);
 
-	/* after transactions are started send down local set commands */
-	init_str = PGXCNodeGetTransactionParamStr();
-	if (init_str)
-	{
-		for (i = 0; i < new_count; i++)
-		{
-			pgxc_node_set_query(new_connections[i], init_str);
-		}
-	}
-
-	/* No problem, let's get going */
-	return 0;
-}
-
-
-/*
- * Execute DISCARD ALL command on all allocated nodes to remove all session
- * specific stuff before releasing them to pool for reuse by other sessions.
- */
-static void
-pgxc_node_remote_cleanup_all(void)
-{
-	PGXCNodeAllHandles *handles = get_current_handles();
-	PGXCNodeHandle *new_connections[handles->co_conn_count + handles->dn_conn_count];
-	int				new_conn_count = 0;
-	int				i;
-	char		   *resetcmd = "RESET ALL;"
-							   "RESET SESSION AUTHORIZATION;"
-							   "RESET transaction_isolation;"
-							   "RESET global_session";
-
-	elog(DEBUG5, "pgxc_node_remote_cleanup_all - handles->co_conn_count %d,"
-			"handles->dn_conn_count %d", handles->co_conn_count,
-			handles->dn_conn_count);
-	/*
-	 * We must handle reader and writer connections both since even a read-only
-	 * needs to be cleaned up.
-	 */
-	if (handles->co_conn_count + handles->dn_conn_count == 0)
-		return;
-
 	/*
-	 * Send down snapshot followed by DISCARD ALL command.
+	 * If the Datanodes are hot standbys, have them wait until they replayed
+	 * the latest barrier, so they see at least what was committed before it
 	 */
-	for (i = 0; i < handles->co_conn_count; i++)
+	if (DatanodeStandbyReads)
 	{
-		PGXCNodeHandle *handle = handles->coord_handles[i];
-
-		/* At this point connection should be in IDLE state */
-		if (handle->state != DN_CONNECTION_STATE_IDLE)
-		{
-			PGXCNodeSetConnectionState(handle, DN_CONNECTION_STATE_ERROR_FATAL);
-			continue;
-		}
+		char		barrier_id[NAMEDATALEN];
 
-		/*
-		 * We must go ahead and release connections anyway, so do not throw
-		 * an error if we have a problem here.
-		 */
-		if (pgxc_node_send_query(handle, resetcmd))
-		{
-			ereport(WARNING,
-					(errcode(ERRCODE_INTERNAL_ERROR),
-					 errmsg("Failed to clean up data nodes")));
-			PGXCNodeSetConnectionState(handle, DN_CONNECTION_STATE_ERROR_FATAL);
-			continue;
-		}
-		new_connections[new_conn_count++] = handle;
-		handle->combiner = NULL;
+		if (BarrierGetLatest(barrier_id))
+			PGXCNodeSetParam(true, "standby_read_barrier", barrier_id, 0);
 	}
-	for (i = 0; i < handles->dn_conn_count; i++)
-	{
-		PGXCNodeHandle *handle = handles->datanode_handles[i];
-
-		/* At this point connection should be in IDLE state */
-		if (handle->state != DN_CONNECTION_STATE_IDLE)
-		{
-			PGXCNodeSetConnectionState(handle, DN_CONNECTION_STATE_ERROR_FATAL);
-			continue;
-		}
 
-		/*
-		 * We must go ahead and release connections anyway, so do not throw
-		 * an error if we have a problem here.
-		 */
-		if (pgxc_node_send_query(handle, resetcmd))
-		{
-			ereport(WARNING,
-					(errcode(ERRCODE_INTERNAL_ERROR),
-					 errmsg("Failed to clean up data nodes")));
-			PGXCNodeSetConnectionState(handle, DN_CONNECTION_STATE_ERROR_FATAL);
-			continue;
-		}
-		new_connections[new_conn_count++] = handle;
-		handle->combiner = NULL;
-	}
+	/* after transactions are started send down local set commands */
+	init_str = PGXCNodeGetTransactionParamStr();
+	if (init_str)
+		pgxc_node_set_query_multi(new_count, new_connections, init_str);
 
-	if (new_conn_count)
-	{
-		ResponseCombiner combiner;
-		InitResponseCombiner(&combiner, new_conn_count, COMBINE_TYPE_NONE);
-		/* Receive responses */
-		pgxc_node_receive_responses(new_conn_count, new_connections, NULL, &combiner);
-		CloseCombiner(&combiner);
-	}
-	pfree_pgxc_all_handles(handles);
+	/* No problem, let's get going */
+	return 0;
 }
 
+
 /*
  * Count how many coordinators and datanodes are involved in this transaction
  * so that we can save that information in the GID
@@ -2103,10 +2500,62 @@ pgxc_node_remote_count(int *dnCount, int dnNodeIds[],
 	}
 }
 
+/*
+ * Pick the remote node which is going to be committed with one-phase commit
+ * after all the other writers are prepared. That is the last writer found,
+ * Datanodes are preferred over Coordinators.
+ * Returns NULL if there is no suitable node.
+ */
+static PGXCNodeHandle *
+pgxc_node_onephase_participant(PGXCNodeAllHandles *handles)
+{
+	PGXCNodeHandle *result = NULL;
+	int				i;
+
+	for (i = 0; i < handles->co_conn_count; i++)
+	{
+		PGXCNodeHandle *conn = handles->coord_handles[i];
+
+		if (conn->sock == NO_SOCKET)
+			continue;
+
+		pgxc_node_wait_syncs(conn);
+
+		if (conn->transaction_status == 'T' && !conn->read_only)
+			result = conn;
+	}
+
+	for (i = 0; i < handles->dn_conn_count; i++)
+	{
+		PGXCNodeHandle *conn = handles->datanode_handles[i];
+
+		if (conn->sock == NO_SOCKET)
+			continue;
+
+		pgxc_node_wait_syncs(conn);
+
+		if (conn->transaction_status == 'T' && !conn->read_only)
+			result = conn;
+	}
+
+	return result;
+}
+
 /*
  * Prepare nodes which ran write operations during the transaction.
  * Read only remote transactions are committed and connections are released
  * back to the pool.
+ * If onephase is true one of the writers is not prepared, rather it is
+ * committed with plain COMMIT after all other writers have been successfully
+ * prepared. That saves a round trip and a fsync on that node. If that commit
+ * fails the prepared transactions are rolled back, if it succeeds the caller
+ * must commit prepared transactions on the returned nodes. If the outcome of
+ * the last commit is unknown the prepared transactions are left in place, to
+ * be resolved by pgxc_clean, which sees the transaction committed or aborted
+ * on the last node.
+ * If start_gtm is true the node list is sent to GTM as soon as PREPARE
+ * commands are sent, and GTM response is read after the nodes have responded,
+ * so GTM and the nodes are working at the same time.
  * Function returns the list of nodes where transaction is prepared, including
  * local node, if requested, in format expected by the GTM server.
  * If something went wrong the function tries to abort prepared transactions on
@@ -2115,7 +2564,8 @@ pgxc_node_remote_count(int *dnCount, int dnNodeIds[],
  * After completion remote connection handles are released.
  */
 static char *
-pgxc_node_remote_prepare(char *prepareGID, bool localNode)
+pgxc_node_remote_prepare(char *prepareGID, bool localNode, bool onephase,
+						 bool start_gtm)
 {
 	bool 			isOK = true;
 	StringInfoData 	nodestr;
@@ -2128,11 +2578,16 @@ pgxc_node_remote_prepare(char *prepareGID, bool localNode)
 	PGXCNodeHandle *connections[MaxDataNodes + MaxCoords];
 	int				conn_count = 0;
 	PGXCNodeAllHandles *handles = get_current_handles();
+	PGXCNodeHandle *onephase_conn = NULL;
+	int				result;
 
 	initStringInfo(&nodestr);
 	if (localNode)
 		appendStringInfoString(&nodestr, PGXCNodeName);
 
+	if (onephase)
+		onephase_conn = pgxc_node_onephase_participant(handles);
+
 	sprintf(prepare_cmd, "PREPARE TRANSACTION '%s'", prepareGID);
 
 	for (i = 0; i < handles->dn_conn_count; i++)
@@ -2154,7 +2609,14 @@ pgxc_node_remote_prepare(char *prepareGID, bool localNode)
 		 */
 		if (conn->sock == NO_SOCKET)
 			continue;
-		else if (conn->transaction_status == 'T')
+
+		pgxc_node_wait_syncs(conn);
+
+		/* Committed separately, when others are prepared */
+		if (conn == onephase_conn)
+			continue;
+
+		if (conn->transaction_status == 'T')
 		{
 			/* Read in any pending input */
 			if (conn->state != DN_CONNECTION_STATE_IDLE)
@@ -2245,7 +2707,14 @@ pgxc_node_remote_prepare(char *prepareGID, bool localNode)
 		 */
 		if (conn->sock == NO_SOCKET)
 			continue;
-		else if (conn->transaction_status == 'T')
+
+		pgxc_node_wait_syncs(conn);
+
+		/* Committed separately, when others are prepared */
+		if (conn == onephase_conn)
+			continue;
+
+		if (conn->transaction_status == 'T')
 		{
 			if (conn->read_only)
 			{
@@ -2318,40 +2787,105 @@ pgxc_node_remote_prepare(char *prepareGID, bool localNode)
 	if (!isOK)
 		goto prepare_err;
 
-	/* exit if nothing has been prepared */
-	if (conn_count > 0)
-	{
-		int result;
+	/* Save the node list and gid on GTM, while the nodes are preparing */
+	if (start_gtm)
+		StartPreparedTranGTMAsync(GetTopGlobalTransactionId(), prepareGID,
+								  nodestr.data);
+
+	/* exit if nothing has been prepared */
+	if (conn_count > 0)
+	{
+		/*
+		 * Receive and check for any errors. In case of errors, we don't bail out
+		 * just yet. We first go through the list of connections and look for
+		 * errors on each connection. This is important to ensure that we run
+		 * an appropriate ROLLBACK command later on (prepared transactions must be
+		 * rolled back with ROLLBACK PREPARED commands).
+		 *
+		 * PGXCTODO - There doesn't seem to be a solid mechanism to track errors on
+		 * individual connections. The transaction_status field doesn't get set
+		 * every time there is an error on the connection. The combiner mechanism is
+		 * good for parallel proessing, but I think we should have a leak-proof
+		 * mechanism to track connection status
+		 */
+		InitResponseCombiner(&combiner, conn_count, COMBINE_TYPE_NONE);
+		/* Receive responses */
+		result = pgxc_node_receive_responses(conn_count, connections, NULL, &combiner);
+		if (result || !validate_combiner(&combiner))
+			goto prepare_err;
+		else
+			CloseCombiner(&combiner);
+	}
+
+	/*
+	 * All other participants are prepared, commit the last one.
+	 */
+	if (onephase_conn)
+	{
+		PGXCNodeHandle *conn = onephase_conn;
+
+		/* Read in any pending input */
+		if (conn->state != DN_CONNECTION_STATE_IDLE)
+			BufferConnection(conn);
+
+		if (pgxc_node_send_query(conn, commit_cmd))
+		{
+			/*
+			 * The command has not reached the node, so the transaction is
+			 * going to be rolled back there. Roll back prepared transactions.
+			 */
+			ereport(WARNING,
+					(errcode(ERRCODE_INTERNAL_ERROR),
+					 errmsg("failed to send COMMIT command to "
+						"the node %u", conn->nodeoid)));
+			isOK = false;
+			goto prepare_err;
+		}
+
 		/*
-		 * Receive and check for any errors. In case of errors, we don't bail out
-		 * just yet. We first go through the list of connections and look for
-		 * errors on each connection. This is important to ensure that we run
-		 * an appropriate ROLLBACK command later on (prepared transactions must be
-		 * rolled back with ROLLBACK PREPARED commands).
-		 *
-		 * PGXCTODO - There doesn't seem to be a solid mechanism to track errors on
-		 * individual connections. The transaction_status field doesn't get set
-		 * every time there is an error on the connection. The combiner mechanism is
-		 * good for parallel proessing, but I think we should have a leak-proof
-		 * mechanism to track connection status
+		 * The response handler resets the flag if remote node reports
+		 * ROLLBACK or error, so if it is still set after the response has been
+		 * received the transaction is committed on the node.
 		 */
-		InitResponseCombiner(&combiner, conn_count, COMBINE_TYPE_NONE);
-		/* Receive responses */
-		result = pgxc_node_receive_responses(conn_count, connections, NULL, &combiner);
-		if (result || !validate_combiner(&combiner))
+		conn->ck_resp_rollback = true;
+		InitResponseCombiner(&combiner, 1, COMBINE_TYPE_NONE);
+		result = pgxc_node_receive_responses(1, &conn, NULL, &combiner);
+		if (!result && (!conn->ck_resp_rollback || combiner.errorMessage))
 			goto prepare_err;
-		else
+		conn->ck_resp_rollback = false;
+		if (result || !validate_combiner(&combiner))
+		{
+			/*
+			 * We do not know if the node has committed, so we can neither
+			 * commit nor roll back prepared transactions. Leave them for
+			 * pgxc_clean.
+			 */
+			for (i = 0; i < conn_count; i++)
+				connections[i]->ck_resp_rollback = false;
 			CloseCombiner(&combiner);
+			ereport(ERROR,
+					(errcode(ERRCODE_INTERNAL_ERROR),
+					 errmsg("failed to receive COMMIT response from the node %u",
+							conn->nodeoid),
+					 errdetail("Transaction %s is left prepared on the other "
+							   "nodes.", prepareGID),
+					 errhint("Run pgxc_clean to resolve the transaction.")));
+		}
+		CloseCombiner(&combiner);
+	}
 
+	if (start_gtm)
+		StartPreparedTranGTMWait();
+
+	if (conn_count > 0 || onephase_conn)
+	{
 		/* Before exit clean the flag, to avoid unnecessary checks */
 		for (i = 0; i < conn_count; i++)
 			connections[i]->ck_resp_rollback = false;
 
 		pfree_pgxc_all_handles(handles);
-		if (!temp_object_included && !PersistentConnections)
+		if (!temp_object_included && !PersistentConnections && !hold_handles())
 		{
-			/* Clean up remote sessions */
-			pgxc_node_remote_cleanup_all();
 			release_handles();
 		}
 	}
@@ -2480,10 +3014,8 @@ prepare_err:
 		CloseCombiner(&combiner2);
 	}
 
-	if (!temp_object_included && !PersistentConnections)
+	if (!temp_object_included && !PersistentConnections && !hold_handles())
 	{
-		/* Clean up remote sessions */
-		pgxc_node_remote_cleanup_all();
 		release_handles();
 	}
 
@@ -2537,6 +3069,8 @@ pgxc_node_remote_commit(void)
 		if (conn->sock == NO_SOCKET)
 			continue;
 
+		pgxc_node_wait_syncs(conn);
+
 		/*
 		 * We do not need to commit remote node if it is not in transaction.
 		 * If transaction is in error state the commit command will cause
@@ -2575,6 +3109,8 @@ pgxc_node_remote_commit(void)
 		if (conn->sock == NO_SOCKET)
 			continue;
 
+		pgxc_node_wait_syncs(conn);
+
 		/*
 		 * We do not need to commit remote node if it is not in transaction.
 		 * If transaction is in error state the commit command will cause
@@ -2629,10 +3165,8 @@ pgxc_node_remote_commit(void)
 					 errmsg("Failed to COMMIT the transaction on one or more nodes")));
 	}
 
-	if (!temp_object_included && !PersistentConnections)
+	if (!temp_object_included && !PersistentConnections && !hold_handles())
 	{
-		/* Clean up remote sessions */
-		pgxc_node_remote_cleanup_all();
 		release_handles();
 	}
 
@@ -2672,6 +3206,8 @@ pgxc_node_remote_abort(void)
 		if (conn->sock == NO_SOCKET)
 			continue;
 
+		pgxc_node_wait_syncs(conn);
+
 		elog(DEBUG5, "node %s, conn->transaction_status %c",
 				conn->nodename,
 				conn->transaction_status);
@@ -2717,6 +3253,8 @@ pgxc_node_remote_abort(void)
 		if (conn->sock == NO_SOCKET)
 			continue;
 
+		pgxc_node_wait_syncs(conn);
+
 		if (conn->transaction_status != 'I')
 		{
 			/* Send SYNC if the remote session is expecting one */
@@ -3064,6 +3602,90 @@ DataNodeCopyStore(PGXCNodeHandle** copy_connections,
 }
 
 
+/*
+ * Run COPY TO on the given Datanodes, each of them writing its own part of
+ * the data to a file or program of its own. queries holds the statement to
+ * send to each of the nodes of nodelist. Nothing but the command tags flows
+ * back to the Coordinator, the sum of their row counts is returned.
+ */
+uint64
+DataNodeCopyToFiles(List *nodelist, List *queries)
+{
+	PGXCNodeAllHandles *pgxc_handles;
+	PGXCNodeHandle **connections;
+	ResponseCombiner combiner;
+	EState	   *estate;
+	Snapshot	snapshot = GetActiveSnapshot();
+	GlobalTransactionId gxid;
+	bool		need_tran_block;
+	bool		error;
+	uint64		processed;
+	ListCell   *lc;
+	int			conn_count = list_length(nodelist);
+	int			i;
+
+	Assert(list_length(queries) == conn_count);
+
+	pgxc_handles = get_handles(nodelist, NULL, false, true);
+	connections = pgxc_handles->datanode_handles;
+	Assert(pgxc_handles->dn_conn_count == conn_count);
+	pfree(pgxc_handles);
+
+	need_tran_block = (conn_count > 1) || (TransactionBlockStatusCode() == 'T');
+
+	/* Gather statistics */
+	stat_statement();
+	stat_transaction(conn_count);
+
+	gxid = GetCurrentTransactionId();
+
+	if (pgxc_node_begin(conn_count, connections, gxid, need_tran_block, false, PGXC_NODE_DATANODE))
+		ereport(ERROR,
+				(errcode(ERRCODE_INTERNAL_ERROR),
+				 errmsg("Could not begin transaction on data nodes.")));
+
+	i = 0;
+	foreach(lc, queries)
+	{
+		PGXCNodeHandle *handle = connections[i++];
+
+		CHECK_OWNERSHIP(handle, NULL);
+
+		if (snapshot && pgxc_node_send_snapshot(handle, snapshot))
+			ereport(ERROR,
+					(errcode(ERRCODE_INTERNAL_ERROR),
+					 errmsg("Failed to send snapshot to node %s",
+							handle->nodename)));
+		if (pgxc_node_send_query(handle, (char *) lfirst(lc)) != 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_INTERNAL_ERROR),
+					 errmsg("Failed to send command to node %s",
+							handle->nodename)));
+	}
+
+	/* The row counts of the command tags are summed up into the EState */
+	estate = CreateExecutorState();
+	InitResponseCombiner(&combiner, conn_count, COMBINE_TYPE_SUM);
+	memset(&combiner, 0, sizeof(ScanState));
+	combiner.ss.ps.state = estate;
+
+	error = (pgxc_node_receive_responses(conn_count, connections, NULL, &combiner) != 0);
+	processed = estate->es_processed;
+	FreeExecutorState(estate);
+	combiner.ss.ps.state = NULL;
+	pfree(connections);
+
+	if (combiner.errorMessage)
+		pgxc_node_report_error(&combiner);
+	if (!ValidateAndCloseCombiner(&combiner) || error)
+		ereport(ERROR,
+				(errcode(ERRCODE_INTERNAL_ERROR),
+				 errmsg("Failed to run COPY on the Datanodes")));
+
+	return processed;
+}
+
+
 /*
  * Finish copy process on all connections
  */
@@ -3322,6 +3944,7 @@ pgxc_start_command_on_connection(PGXCNodeHandle *connection,
 	CommandId	cid;
 	ResponseCombiner *combiner = (ResponseCombiner *) remotestate;
 	RemoteQuery	*step = (RemoteQuery *) combiner->ss.ps.plan;
+	EState	   *estate;
 	CHECK_OWNERSHIP(connection, combiner);
 
 	elog(DEBUG5, "pgxc_start_command_on_connection - node %s, state %d",
@@ -3337,6 +3960,17 @@ pgxc_start_command_on_connection(PGXCNodeHandle *connection,
 	if (pgxc_node_send_cmd_id(connection, cid) < 0 )
 		return false;
 
+	/*
+	 * Let the remote node account the statement under the identifier of the
+	 * query it was generated for.
+	 */
+	estate = combiner->ss.ps.state;
+	if (estate && estate->es_plannedstmt &&
+		estate->es_plannedstmt->queryId != 0 &&
+		pgxc_node_send_query_id(connection,
+								estate->es_plannedstmt->queryId) < 0)
+		return false;
+
 	if (snapshot && pgxc_node_send_snapshot(connection, snapshot))
 		return false;
 	if (step->statement || step->cursor || remotestate->rqs_num_params)
@@ -3405,6 +4039,8 @@ ExecRemoteUtility(RemoteQuery *node)
 	GlobalTransactionId gxid = InvalidGlobalTransactionId;
 	Snapshot snapshot = NULL;
 	PGXCNodeAllHandles *pgxc_connections;
+	PGXCNodeHandle **connections;
+	int			conn_count;
 	int			co_conn_count;
 	int			dn_conn_count;
 	bool		need_tran_block;
@@ -3460,172 +4096,100 @@ ExecRemoteUtility(RemoteQuery *node)
 				(errcode(ERRCODE_INTERNAL_ERROR),
 				 errmsg("Failed to get next transaction ID")));
 
+	/*
+	 * Datanodes and Coordinators are handled as a single set of connections,
+	 * so that the transaction is started everywhere in one round trip and
+	 * the command runs on all the nodes at the same time.
+	 */
+	conn_count = dn_conn_count + co_conn_count;
+	connections = (PGXCNodeHandle **)
+		palloc(conn_count * sizeof(PGXCNodeHandle *));
+	if (dn_conn_count > 0)
+		memcpy(connections, pgxc_connections->datanode_handles,
+			   dn_conn_count * sizeof(PGXCNodeHandle *));
+	if (co_conn_count > 0)
+		memcpy(connections + dn_conn_count, pgxc_connections->coord_handles,
+			   co_conn_count * sizeof(PGXCNodeHandle *));
+
+	if (pgxc_node_begin(conn_count, connections,
+				gxid, need_tran_block, false, PGXC_NODE_NONE))
+		ereport(ERROR,
+				(errcode(ERRCODE_INTERNAL_ERROR),
+				 errmsg("Could not begin transaction on remote nodes")));
+	for (i = 0; i < conn_count; i++)
 	{
-		if (pgxc_node_begin(dn_conn_count, pgxc_connections->datanode_handles,
-					gxid, need_tran_block, false, PGXC_NODE_DATANODE))
+		PGXCNodeHandle *conn = connections[i];
+
+		if (conn->state == DN_CONNECTION_STATE_QUERY)
+			BufferConnection(conn);
+		if (snapshot && pgxc_node_send_snapshot(conn, snapshot))
+		{
 			ereport(ERROR,
 					(errcode(ERRCODE_INTERNAL_ERROR),
-					 errmsg("Could not begin transaction on Datanodes")));
-		for (i = 0; i < dn_conn_count; i++)
+					 errmsg("Failed to send snapshot to %s",
+							i < dn_conn_count ? "Datanodes" : "coordinators")));
+		}
+		if (pgxc_node_send_cmd_id(conn, cid) < 0)
 		{
-			PGXCNodeHandle *conn = pgxc_connections->datanode_handles[i];
-
-			if (conn->state == DN_CONNECTION_STATE_QUERY)
-				BufferConnection(conn);
-			if (snapshot && pgxc_node_send_snapshot(conn, snapshot))
-			{
-				ereport(ERROR,
-						(errcode(ERRCODE_INTERNAL_ERROR),
-						 errmsg("Failed to send snapshot to Datanodes")));
-			}
-			if (pgxc_node_send_cmd_id(conn, cid) < 0)
-			{
-				ereport(ERROR,
-						(errcode(ERRCODE_INTERNAL_ERROR),
-						 errmsg("Failed to send command ID to Datanodes")));
-			}
+			ereport(ERROR,
+					(errcode(ERRCODE_INTERNAL_ERROR),
+					 errmsg("Failed to send command ID to %s",
+							i < dn_conn_count ? "Datanodes" : "coordinators")));
+		}
 
-			if (pgxc_node_send_query(conn, node->sql_statement) != 0)
-			{
-				ereport(ERROR,
-						(errcode(ERRCODE_INTERNAL_ERROR),
-						 errmsg("Failed to send command to Datanodes")));
-			}
+		if (pgxc_node_send_query(conn, node->sql_statement) != 0)
+		{
+			ereport(ERROR,
+					(errcode(ERRCODE_INTERNAL_ERROR),
+					 errmsg("Failed to send command to %s",
+							i < dn_conn_count ? "Datanodes" : "coordinators")));
 		}
 	}
 
+	/*
+	 * Collect the completions from whichever nodes answer first.  We do not
+	 * expect nodes returning tuples when running utility command.
+	 * If we got EOF, move to the next connection, will receive more
+	 * data on the next iteration.
+	 */
+	while (conn_count > 0)
 	{
-		if (pgxc_node_begin(co_conn_count, pgxc_connections->coord_handles,
-					gxid, need_tran_block, false, PGXC_NODE_COORDINATOR))
-			ereport(ERROR,
-					(errcode(ERRCODE_INTERNAL_ERROR),
-					 errmsg("Could not begin transaction on coordinators")));
-		/* Now send it to Coordinators if necessary */
-		for (i = 0; i < co_conn_count; i++)
+		int i = 0;
+
+		if (pgxc_node_receive(conn_count, connections, NULL))
+			break;
+
+		while (i < conn_count)
 		{
-			if (snapshot && pgxc_node_send_snapshot(pgxc_connections->coord_handles[i], snapshot))
+			PGXCNodeHandle *conn = connections[i];
+			int res = handle_response(conn, combiner);
+			if (res == RESPONSE_EOF)
 			{
-				ereport(ERROR,
-						(errcode(ERRCODE_INTERNAL_ERROR),
-						 errmsg("Failed to send command to coordinators")));
+				i++;
 			}
-			if (pgxc_node_send_cmd_id(pgxc_connections->coord_handles[i], cid) < 0)
+			else if (res == RESPONSE_COMPLETE)
 			{
-				ereport(ERROR,
-						(errcode(ERRCODE_INTERNAL_ERROR),
-						 errmsg("Failed to send command ID to Datanodes")));
+				/* Ignore, wait for ReadyForQuery */
 			}
-
-			if (pgxc_node_send_query(pgxc_connections->coord_handles[i], node->sql_statement) != 0)
+			else if (res == RESPONSE_ERROR)
 			{
-				ereport(ERROR,
-						(errcode(ERRCODE_INTERNAL_ERROR),
-						 errmsg("Failed to send command to coordinators")));
+				/* Ignore, wait for ReadyForQuery */
 			}
-		}
-	}
-
-	/*
-	 * Stop if all commands are completed or we got a data row and
-	 * initialized state node for subsequent invocations
-	 */
-	{
-		while (dn_conn_count > 0)
-		{
-			int i = 0;
-
-			if (pgxc_node_receive(dn_conn_count, pgxc_connections->datanode_handles, NULL))
-				break;
-			/*
-			 * Handle input from the Datanodes.
-			 * We do not expect Datanodes returning tuples when running utility
-			 * command.
-			 * If we got EOF, move to the next connection, will receive more
-			 * data on the next iteration.
-			 */
-			while (i < dn_conn_count)
+			else if (res == RESPONSE_READY)
 			{
-				PGXCNodeHandle *conn = pgxc_connections->datanode_handles[i];
-				int res = handle_response(conn, combiner);
-				if (res == RESPONSE_EOF)
-				{
-					i++;
-				}
-				else if (res == RESPONSE_COMPLETE)
-				{
-					/* Ignore, wait for ReadyForQuery */
-				}
-				else if (res == RESPONSE_ERROR)
-				{
-					/* Ignore, wait for ReadyForQuery */
-				}
-				else if (res == RESPONSE_READY)
-				{
-					if (i < --dn_conn_count)
-						pgxc_connections->datanode_handles[i] =
-							pgxc_connections->datanode_handles[dn_conn_count];
-				}
-				else if (res == RESPONSE_TUPDESC)
-				{
-					ereport(ERROR,
-							(errcode(ERRCODE_INTERNAL_ERROR),
-							 errmsg("Unexpected response from Datanode")));
-				}
-				else if (res == RESPONSE_DATAROW)
-				{
-					ereport(ERROR,
-							(errcode(ERRCODE_INTERNAL_ERROR),
-							 errmsg("Unexpected response from Datanode")));
-				}
+				if (i < --conn_count)
+					connections[i] = connections[conn_count];
 			}
-		}
-	}
-
-	/* Make the same for Coordinators */
-	{
-		while (co_conn_count > 0)
-		{
-			int i = 0;
-
-			if (pgxc_node_receive(co_conn_count, pgxc_connections->coord_handles, NULL))
-				break;
-
-			while (i < co_conn_count)
+			else if (res == RESPONSE_TUPDESC || res == RESPONSE_DATAROW)
 			{
-				int res = handle_response(pgxc_connections->coord_handles[i], combiner);
-				if (res == RESPONSE_EOF)
-				{
-					i++;
-				}
-				else if (res == RESPONSE_COMPLETE)
-				{
-					/* Ignore, wait for ReadyForQuery */
-				}
-				else if (res == RESPONSE_ERROR)
-				{
-					/* Ignore, wait for ReadyForQuery */
-				}
-				else if (res == RESPONSE_READY)
-				{
-					if (i < --co_conn_count)
-						pgxc_connections->coord_handles[i] =
-							 pgxc_connections->coord_handles[co_conn_count];
-				}
-				else if (res == RESPONSE_TUPDESC)
-				{
-					ereport(ERROR,
-							(errcode(ERRCODE_INTERNAL_ERROR),
-							 errmsg("Unexpected response from coordinator")));
-				}
-				else if (res == RESPONSE_DATAROW)
-				{
-					ereport(ERROR,
-							(errcode(ERRCODE_INTERNAL_ERROR),
-							 errmsg("Unexpected response from coordinator")));
-				}
+				ereport(ERROR,
+						(errcode(ERRCODE_INTERNAL_ERROR),
+						 errmsg("Unexpected response from node %s",
+								conn->nodename)));
 			}
 		}
 	}
+	pfree(connections);
 
 	/*
 	 * We have processed all responses from nodes and if we have
@@ -3969,7 +4533,8 @@ PreCommit_Remote(char *prepareGID, char *nodestring, bool preparedLocalNode)
 		Assert(preparedLocalNode);
 		pgxc_node_remote_finish(prepareGID, true, nodestring,
 								GetAuxilliaryTransactionId(),
-								GetTopGlobalTransactionId());
+								GetTopGlobalTransactionId(),
+								AsyncCommitPrepared);
 
 	}
 	else
@@ -4116,8 +4681,6 @@ PreAbort_Remote(void)
 	elog(DEBUG5, "temp_object_included %d", temp_object_included);
 	if (!temp_object_included)
 	{
-		/* Clean up remote sessions */
-		pgxc_node_remote_cleanup_all();
 		release_handles();
 	}
 
@@ -4138,7 +4701,9 @@ PreAbort_Remote(void)
  * sent (connections marked as not read-only).
  * If that is explicit PREPARE (issued by client) notify GTM.
  * In case of implicit PREPARE not involving local node (ex. caused by
- * INSERT, UPDATE or DELETE) commit prepared transaction immediately.
+ * INSERT, UPDATE or DELETE) commit prepared transaction immediately; in that
+ * case one of the writers is committed with one-phase commit instead of being
+ * prepared.
  * Return list of node names where transaction was actually prepared, include
  * the name of the local node if localNode is true.
  */
@@ -4162,13 +4727,11 @@ PrePrepare_Remote(char *prepareGID, bool localNode, bool implicit)
 		return NULL;
 	}
 
+	/* If that is explicit PREPARE the node list and gid are saved on GTM */
 	nodestring = pgxc_node_remote_prepare(prepareGID,
-												!implicit || localNode);
-
-	if (!implicit && IS_PGXC_LOCAL_COORDINATOR)
-		/* Save the node list and gid on GTM. */
-		StartPreparedTranGTM(GetTopGlobalTransactionId(), prepareGID,
-							 nodestring);
+										  !implicit || localNode,
+										  implicit && !localNode,
+										  !implicit && IS_PGXC_LOCAL_COORDINATOR);
 
 	/*
 	 * If no need to commit on local node go ahead and commit prepared
@@ -4178,7 +4741,8 @@ PrePrepare_Remote(char *prepareGID, bool localNode, bool implicit)
 	{
 		pgxc_node_remote_finish(prepareGID, true, nodestring,
 								GetAuxilliaryTransactionId(),
-								GetTopGlobalTransactionId());
+								GetTopGlobalTransactionId(),
+								AsyncCommitPrepared);
 		pfree(nodestring);
 		nodestring = NULL;
 	}
@@ -4321,14 +4885,13 @@ FinishRemotePreparedTransaction(char *prepareGID, bool commit)
 		else
 		{
 			pgxc_node_remote_abort();
-			RollbackTranGTM(prepare_gxid);
-			RollbackTranGTM(gxid);
+			RollbackTranGTMPair(prepare_gxid, gxid);
 		}
 		return false;
 	}
 
 	prepared_local = pgxc_node_remote_finish(prepareGID, commit, nodestring,
-											 gxid, prepare_gxid);
+											 gxid, prepare_gxid, false);
 
 	if (commit)
 	{
@@ -4341,8 +4904,7 @@ FinishRemotePreparedTransaction(char *prepareGID, bool commit)
 	}
 	else
 	{
-		RollbackTranGTM(prepare_gxid);
-		RollbackTranGTM(gxid);
+		RollbackTranGTMPair(prepare_gxid, gxid);
 	}
 
 	return prepared_local;
@@ -4352,11 +4914,13 @@ FinishRemotePreparedTransaction(char *prepareGID, bool commit)
 /*
  * Complete previously prepared transactions on remote nodes.
  * Release remote connection after completion.
+ * If async is true the commit may be left to the commit batcher, the caller
+ * must make sure the commit decision is durable by then.
  */
 static bool
 pgxc_node_remote_finish(char *prepareGID, bool commit,
 						char *nodestring, GlobalTransactionId gxid,
-						GlobalTransactionId prepare_gxid)
+						GlobalTransactionId prepare_gxid, bool async)
 {
 	char			   *finish_cmd;
 	PGXCNodeHandle	   *connections[MaxCoords + MaxDataNodes];
@@ -4404,6 +4968,11 @@ pgxc_node_remote_finish(char *prepareGID, bool commit,
 	if (nodelist == NIL && coordlist == NIL)
 		return prepared_local;
 
+	/* Let the commit batcher of the database do the job, if available */
+	if (commit &&
+		CommitBatcherSubmit(prepareGID, nodelist, coordlist, gxid, !async))
+		return prepared_local;
+
 	pgxc_handles = get_handles(nodelist, coordlist, false, true);
 
 	finish_cmd = (char *) palloc(64 + strlen(prepareGID));
@@ -4468,40 +5037,217 @@ pgxc_node_remote_finish(char *prepareGID, bool commit,
 		}
 		else
 		{
-			/* Read responses from these */
-			connections[conn_count++] = conn;
+			/* Read responses from these */
+			connections[conn_count++] = conn;
+		}
+	}
+
+	if (conn_count)
+	{
+		InitResponseCombiner(&combiner, conn_count, COMBINE_TYPE_NONE);
+		/* Receive responses */
+		if (pgxc_node_receive_responses(conn_count, connections, NULL, &combiner) ||
+				!validate_combiner(&combiner))
+		{
+			if (combiner.errorMessage)
+				pgxc_node_report_error(&combiner);
+			else
+				ereport(ERROR,
+						(errcode(ERRCODE_INTERNAL_ERROR),
+						 errmsg("Failed to COMMIT the transaction on one or more nodes")));
+		}
+		else
+			CloseCombiner(&combiner);
+	}
+
+	if (!temp_object_included && !PersistentConnections && !hold_handles())
+	{
+		release_handles();
+	}
+
+	pfree_pgxc_all_handles(pgxc_handles);
+	pfree(finish_cmd);
+
+	return prepared_local;
+}
+
+/*
+ * Run COMMIT PREPARED for a number of transactions prepared by different
+ * sessions. Commands to the same node are sent one after another without
+ * waiting for responses, then the responses are read in the same order, so
+ * the whole batch takes one round trip to each node involved.
+ * Errors are not thrown, the error message is returned in the errmsg field of
+ * the failed item. Items which have errmsg already set are skipped.
+ */
+void
+RemoteCommitPreparedBatch(RemoteCommitPrepared *items, int count)
+{
+	List			   *nodelist = NIL;
+	List			   *coordlist = NIL;
+	PGXCNodeAllHandles *pgxc_handles;
+	PGXCNodeHandle	  **dn_conns;
+	PGXCNodeHandle	  **co_conns;
+	bool			   *dn_broken;
+	bool			   *co_broken;
+	PGXCNodeHandle	   *connections[MaxCoords + MaxDataNodes];
+	bool				failed = false;
+	ListCell		   *lc;
+	int					i, j;
+
+	dn_conns = (PGXCNodeHandle **) palloc0(NumDataNodes * sizeof(PGXCNodeHandle *));
+	co_conns = (PGXCNodeHandle **) palloc0(NumCoords * sizeof(PGXCNodeHandle *));
+	dn_broken = (bool *) palloc0(NumDataNodes * sizeof(bool));
+	co_broken = (bool *) palloc0(NumCoords * sizeof(bool));
+
+	/* Get handles of all the nodes involved */
+	for (j = 0; j < count; j++)
+	{
+		foreach(lc, items[j].nodelist)
+		{
+			if (!dn_broken[lfirst_int(lc)])
+				nodelist = lappend_int(nodelist, lfirst_int(lc));
+			dn_broken[lfirst_int(lc)] = true;
+		}
+		foreach(lc, items[j].coordlist)
+		{
+			if (!co_broken[lfirst_int(lc)])
+				coordlist = lappend_int(coordlist, lfirst_int(lc));
+			co_broken[lfirst_int(lc)] = true;
+		}
+	}
+	memset(dn_broken, 0, NumDataNodes * sizeof(bool));
+	memset(co_broken, 0, NumCoords * sizeof(bool));
+
+	pgxc_handles = get_handles(nodelist, coordlist, false, true);
+	i = 0;
+	foreach(lc, nodelist)
+		dn_conns[lfirst_int(lc)] = pgxc_handles->datanode_handles[i++];
+	i = 0;
+	foreach(lc, coordlist)
+		co_conns[lfirst_int(lc)] = pgxc_handles->coord_handles[i++];
+
+	/*
+	 * Send down all the commands. Connection becomes busy after the first
+	 * command is sent, but following commands are just queued up behind it,
+	 * so we make it look idle for the send functions.
+	 */
+	for (j = 0; j < count; j++)
+	{
+		char   *finish_cmd = psprintf("COMMIT PREPARED '%s'", items[j].gid);
+
+		for (i = 0; i < list_length(items[j].nodelist) +
+				list_length(items[j].coordlist); i++)
+		{
+			PGXCNodeHandle *conn;
+			bool		   *broken;
+			int				nodeIndex;
+
+			if (i < list_length(items[j].nodelist))
+			{
+				nodeIndex = list_nth_int(items[j].nodelist, i);
+				conn = dn_conns[nodeIndex];
+				broken = &dn_broken[nodeIndex];
+			}
+			else
+			{
+				nodeIndex = list_nth_int(items[j].coordlist,
+										 i - list_length(items[j].nodelist));
+				conn = co_conns[nodeIndex];
+				broken = &co_broken[nodeIndex];
+			}
+
+			if (!*broken && conn->state == DN_CONNECTION_STATE_QUERY)
+				PGXCNodeSetConnectionState(conn, DN_CONNECTION_STATE_IDLE);
+
+			if (*broken ||
+				pgxc_node_send_gxid(conn, items[j].gxid) ||
+				pgxc_node_send_query(conn, finish_cmd))
+			{
+				*broken = true;
+				if (items[j].errmsg == NULL)
+					items[j].errmsg = psprintf("failed to send COMMIT PREPARED "
+											   "command to the node %u",
+											   conn->nodeoid);
+			}
 		}
+		pfree(finish_cmd);
 	}
 
-	if (conn_count)
+	/*
+	 * Read responses. Each connection returns them in the order the commands
+	 * were sent, so read response to one command from every node of an item
+	 * before proceeding with the next item.
+	 */
+	for (j = 0; j < count; j++)
 	{
-		InitResponseCombiner(&combiner, conn_count, COMBINE_TYPE_NONE);
-		/* Receive responses */
-		if (pgxc_node_receive_responses(conn_count, connections, NULL, &combiner) ||
-				!validate_combiner(&combiner))
+		ResponseCombiner combiner;
+		int				conn_count = 0;
+		bool			lost = false;
+
+		foreach(lc, items[j].nodelist)
 		{
-			if (combiner.errorMessage)
-				pgxc_node_report_error(&combiner);
+			if (dn_broken[lfirst_int(lc)])
+				lost = true;
 			else
-				ereport(ERROR,
-						(errcode(ERRCODE_INTERNAL_ERROR),
-						 errmsg("Failed to COMMIT the transaction on one or more nodes")));
+				connections[conn_count++] = dn_conns[lfirst_int(lc)];
+		}
+		foreach(lc, items[j].coordlist)
+		{
+			if (co_broken[lfirst_int(lc)])
+				lost = true;
+			else
+				connections[conn_count++] = co_conns[lfirst_int(lc)];
 		}
-		else
-			CloseCombiner(&combiner);
-	}
 
-	if (!temp_object_included && !PersistentConnections)
-	{
-		/* Clean up remote sessions */
-		pgxc_node_remote_cleanup_all();
-		release_handles();
+		if (lost)
+			failed = true;
+		if (lost && items[j].errmsg == NULL)
+			items[j].errmsg = pstrdup("connection to the remote node is lost");
+
+		if (conn_count == 0)
+			continue;
+
+		/* Previous item made them idle */
+		for (i = 0; i < conn_count; i++)
+			PGXCNodeSetConnectionState(connections[i],
+									   DN_CONNECTION_STATE_QUERY);
+
+		InitResponseCombiner(&combiner, conn_count, COMBINE_TYPE_NONE);
+		if (pgxc_node_receive_responses(conn_count, connections, NULL,
+										&combiner))
+		{
+			/* Out of sync with these connections, do not use them anymore */
+			foreach(lc, items[j].nodelist)
+				dn_broken[lfirst_int(lc)] = true;
+			foreach(lc, items[j].coordlist)
+				co_broken[lfirst_int(lc)] = true;
+			failed = true;
+			if (items[j].errmsg == NULL)
+				items[j].errmsg = pstrdup("failed to receive COMMIT PREPARED "
+										  "response");
+		}
+		else if (!validate_combiner(&combiner))
+		{
+			if (items[j].errmsg == NULL)
+				items[j].errmsg = pstrdup(combiner.errorMessage ?
+										  combiner.errorMessage :
+										  "failed to COMMIT PREPARED on one "
+										  "or more nodes");
+		}
+		CloseCombiner(&combiner);
 	}
 
 	pfree_pgxc_all_handles(pgxc_handles);
-	pfree(finish_cmd);
+	/* Get rid of broken connections */
+	if (failed)
+		release_handles();
 
-	return prepared_local;
+	pfree(dn_conns);
+	pfree(co_conns);
+	pfree(dn_broken);
+	pfree(co_broken);
+	list_free(nodelist);
+	list_free(coordlist);
 }
 
 /*****************************************************************************
@@ -4678,14 +5424,21 @@ ExecRemoteQuery(PlanState *pstate)
 				pgxc_node_report_error(combiner);
 		}
 
+		/*
+		 * Once the primary node is done, the other nodes can not deadlock
+		 * on each other any more. Start the transaction on all of them at
+		 * once, so that we wait for a single round of responses instead of
+		 * one per node, and then send the command to all of them.
+		 */
+		if (pgxc_node_begin(regular_conn_count, connections, gxid,
+							need_tran_block, step->read_only,
+							PGXC_NODE_DATANODE))
+			ereport(ERROR,
+					(errcode(ERRCODE_INTERNAL_ERROR),
+					 errmsg("Could not begin transaction on data node.")));
+
 		for (i = 0; i < regular_conn_count; i++)
 		{
-			if (pgxc_node_begin(1, &connections[i], gxid, need_tran_block,
-								step->read_only, PGXC_NODE_DATANODE))
-				ereport(ERROR,
-						(errcode(ERRCODE_INTERNAL_ERROR),
-						 errmsg("Could not begin transaction on data node.")));
-
 			/* If explicit transaction is needed gxid is already sent */
 			if (!pgxc_start_command_on_connection(connections[i], node, snapshot))
 			{
@@ -4726,26 +5479,16 @@ ExecRemoteQuery(PlanState *pstate)
 
 			/*
 			 * First message is already in the buffer
-			 * Further fetch will be under tuplesort control
-			 * If query does not produce rows tuplesort will not
-			 * be initialized
+			 * Further fetch will be under merge control
 			 */
-			combiner->tuplesortstate = tuplesort_begin_merge(
-								   resultslot->tts_tupleDescriptor,
-								   sort->numCols,
-								   sort->sortColIdx,
-								   sort->sortOperators,
-								   sort->sortCollations,
-								   sort->nullsFirst,
-								   combiner,
-								   work_mem);
+			remote_merge_begin(combiner, resultslot->tts_tupleDescriptor,
+							   sort);
 		}
 	}
 
-	if (combiner->tuplesortstate)
+	if (combiner->mergestate)
 	{
-		if (tuplesort_gettupleslot((Tuplesortstate *) combiner->tuplesortstate,
-									  true, true, resultslot, NULL))
+		if (remote_merge_next(combiner))
 			return resultslot;
 		else
 			ExecClearTuple(resultslot);
@@ -4810,8 +5553,7 @@ static void
 pgxc_connections_cleanup(ResponseCombiner *combiner)
 {
 	/* clean up the buffer */
-	list_free_deep(combiner->rowBuffer);
-	combiner->rowBuffer = NIL;
+	FreeRowBuffers(combiner);
 
 	/*
 	 * Read in and discard remaining data from the connections, if any
@@ -4871,35 +5613,16 @@ pgxc_connections_cleanup(ResponseCombiner *combiner)
 	}
 
 	/*
-	 * Release tuplesort resources
+	 * Release merge resources
 	 */
-	if (combiner->tuplesortstate)
+	if (combiner->mergestate)
 	{
-		/*
-		 * Free these before tuplesort_end, because these arrays may appear
-		 * in the tuplesort's memory context, tuplesort_end deletes this
-		 * context and may invalidate the memory.
-		 * We still want to free them here, because these may be in different
-		 * context.
-		 */
 		if (combiner->tapenodes)
 		{
 			pfree(combiner->tapenodes);
 			combiner->tapenodes = NULL;
 		}
-		if (combiner->tapemarks)
-		{
-			pfree(combiner->tapemarks);
-			combiner->tapemarks = NULL;
-		}
-		/*
-		 * tuplesort_end invalidates minimal tuple if it is in the slot because
-		 * deletes the TupleSort memory context, causing seg fault later when
-		 * releasing tuple table
-		 */
-		ExecClearTuple(combiner->ss.ps.ps_ResultTupleSlot);
-		tuplesort_end((Tuplesortstate *) combiner->tuplesortstate);
-		combiner->tuplesortstate = NULL;
+		remote_merge_end(combiner);
 	}
 }
 
@@ -5290,6 +6013,96 @@ determine_param_types(Plan *plan,  struct find_params_context *context)
 }
 
 
+/*
+ * Restrict execution nodes of the subplan to those the value of its
+ * execNodesExpr, an external parameter, is located to. This way a generic
+ * plan contacts the same nodes as a plan built for the parameter value.
+ */
+static List *
+restrict_exec_nodes(RemoteSubplan *node, EState *estate, List *execNodes)
+{
+	Param		   *param = (Param *) node->execNodesExpr;
+	ParamListInfo	paramLI = estate->es_param_list_info;
+	ParamExternData *prm;
+	Locator		   *locator;
+	int			   *nodenums;
+	int				count;
+	int				i;
+	List		   *result = NIL;
+
+	if (!IsA(param, Param) || paramLI == NULL ||
+			param->paramid <= 0 || param->paramid > paramLI->numParams)
+		return execNodes;
+
+	prm = &paramLI->params[param->paramid - 1];
+	if (!OidIsValid(prm->ptype) && paramLI->paramFetch != NULL)
+		(*paramLI->paramFetch) (paramLI, param->paramid);
+	if (prm->ptype != param->paramtype)
+		return execNodes;
+
+	locator = createLocator(node->execNodesType,
+							RELATION_ACCESS_READ,
+							param->paramtype,
+							LOCATOR_LIST_LIST,
+							0,
+							(void *) node->execNodesMap,
+							(void **) &nodenums,
+							false);
+	count = GET_NODES(locator, prm->value, prm->isnull, NULL);
+	for (i = 0; i < count; i++)
+		if (list_member_int(execNodes, nodenums[i]))
+			result = lappend_int(result, nodenums[i]);
+	freeLocator(locator);
+
+	/* Parameter may refer to a node excluded already, keep the list then */
+	if (result == NIL)
+		return execNodes;
+
+	list_free(execNodes);
+	return result;
+}
+
+/*
+ * Does the plan fragment to be run by a RemoteSubplan contain a Gather or
+ * Gather Merge node?  Nested RemoteSubplans are separate fragments and are
+ * not looked into.
+ */
+static bool
+subplan_has_gather(Plan *plan)
+{
+	ListCell   *lc;
+
+	if (plan == NULL)
+		return false;
+
+	switch (nodeTag(plan))
+	{
+		case T_Gather:
+		case T_GatherMerge:
+			return true;
+		case T_RemoteSubplan:
+			return false;
+		case T_Append:
+			foreach(lc, ((Append *) plan)->appendplans)
+				if (subplan_has_gather((Plan *) lfirst(lc)))
+					return true;
+			break;
+		case T_MergeAppend:
+			foreach(lc, ((MergeAppend *) plan)->mergeplans)
+				if (subplan_has_gather((Plan *) lfirst(lc)))
+					return true;
+			break;
+		case T_SubqueryScan:
+			return subplan_has_gather(((SubqueryScan *) plan)->subplan);
+		default:
+			break;
+	}
+
+	return subplan_has_gather(plan->lefttree) ||
+		subplan_has_gather(plan->righttree);
+}
+
+
 RemoteSubplanState *
 ExecInitRemoteSubplan(RemoteSubplan *node, EState *estate, int eflags)
 {
@@ -5327,6 +6140,13 @@ ExecInitRemoteSubplan(RemoteSubplan *node, EState *estate, int eflags)
 		remotestate->execOnAll = true;
 	}
 	remotestate->execNodes = list_copy(node->nodeList);
+	/*
+	 * Parameters sent down to the datanodes are the same, so only the
+	 * coordinator needs to restrict the nodes.
+	 */
+	if (node->execNodesExpr && !IS_PGXC_DATANODE)
+		remotestate->execNodes = restrict_exec_nodes(node, estate,
+													 remotestate->execNodes);
 	InitResponseCombiner(combiner, 0, combineType);
 	combiner->ss.ps.plan = (Plan *) node;
 	combiner->ss.ps.state = estate;
@@ -5396,6 +6216,17 @@ ExecInitRemoteSubplan(RemoteSubplan *node, EState *estate, int eflags)
 		}
 	}
 
+	/*
+	 * Rows returned for the parameter values seen before may be replayed
+	 * from the cache. The cache itself is set up on the first rescan, a
+	 * subplan which is never rescanned does not need it. The rows filtered
+	 * by a Bloom filter depend on the filter too, so do not cache these.
+	 */
+	remotestate->memoize = node->memoize && !remotestate->local_exec &&
+		combineType == COMBINE_TYPE_NONE && node->bloomKeyNo == 0 &&
+		!bms_is_empty(node->scan.plan.allParam) &&
+		!(eflags & EXEC_FLAG_EXPLAIN_ONLY);
+
 	/*
 	 * If we are going to execute subplan locally or doing explain initialize
 	 * the subplan. Otherwise have remote node doing that.
@@ -5425,6 +6256,19 @@ ExecInitRemoteSubplan(RemoteSubplan *node, EState *estate, int eflags)
 												 (void *) node->distributionNodes,
 												 (void **) &remotestate->dest_nodes,
 												 false);
+
+			/*
+			 * Rows with hot values have to be kept wherever they are
+			 * broadcast. When they are spread, the other side of the join
+			 * has them everywhere, so the hash distribution is fine.
+			 */
+			if (node->skewValues && node->skewBroadcast)
+			{
+				setLocatorSkew(remotestate->locator, node->skewValues,
+							   node->skewEqfunc, node->skewCollation, true);
+				remotestate->dest_nodes =
+						(int *) getLocatorResults(remotestate->locator);
+			}
 		}
 		else
 			remotestate->locator = NULL;
@@ -5479,6 +6323,9 @@ ExecInitRemoteSubplan(RemoteSubplan *node, EState *estate, int eflags)
 		ext_params = estate->es_param_list_info;
 		rstmt.nParamRemote = (ext_params ? ext_params->numParams : 0) +
 				bms_num_members(node->scan.plan.allParam);
+		rstmt.hasBloomParam = (node->bloomKeyNo > 0);
+		if (rstmt.hasBloomParam)
+			rstmt.nParamRemote++;
 		if (rstmt.nParamRemote > 0)
 		{
 			Bitmapset *tmpset;
@@ -5489,6 +6336,7 @@ ExecInitRemoteSubplan(RemoteSubplan *node, EState *estate, int eflags)
 			rstmt.remoteparams = (RemoteParam *) palloc(rstmt.nParamRemote *
 														sizeof(RemoteParam));
 			paramno = 0;
+			rstmt.nParamRemote = 0;
 			if (ext_params)
 			{
 				for (i = 0; i < ext_params->numParams; i++)
@@ -5589,6 +6437,19 @@ ExecInitRemoteSubplan(RemoteSubplan *node, EState *estate, int eflags)
 					bms_free(context.defineParams);
 				}
 			}
+
+			/*
+			 * The Bloom filter of the join keys goes last, after it is built
+			 * by the parent Hash Join. It is a PARAM_EXTERN with no number.
+			 */
+			if (rstmt.hasBloomParam)
+			{
+				paramno = rstmt.nParamRemote++;
+				rstmt.remoteparams[paramno].paramkind = PARAM_EXTERN;
+				rstmt.remoteparams[paramno].paramid = 0;
+				rstmt.remoteparams[paramno].paramtype = BYTEAOID;
+				rstmt.remoteparams[paramno].paramused = 1;
+			}
 			remotestate->nParamRemote = rstmt.nParamRemote;
 			remotestate->remoteparams = rstmt.remoteparams;
 		}
@@ -5599,6 +6460,32 @@ ExecInitRemoteSubplan(RemoteSubplan *node, EState *estate, int eflags)
 		rstmt.distributionType = node->distributionType;
 		rstmt.distributionNodes = node->distributionNodes;
 		rstmt.distributionRestrict = node->distributionRestrict;
+		rstmt.skewValues = node->skewValues;
+		rstmt.skewEqfunc = node->skewEqfunc;
+		rstmt.skewCollation = node->skewCollation;
+		rstmt.skewBroadcast = node->skewBroadcast;
+
+		/*
+		 * Let the Datanode start parallel workers for Gather nodes of a
+		 * read-only fragment.  The executor there still runs it serially if
+		 * the fragment is fetched in batches, as SharedQueue producers are.
+		 */
+		rstmt.parallelModeNeeded = rstmt.commandType == CMD_SELECT &&
+			subplan_has_gather(rstmt.planTree);
+
+		/*
+		 * Under EXPLAIN ANALYZE ask the Datanodes to instrument the fragment
+		 * and report the figures back before CommandComplete.  Nested
+		 * fragments are consumed through shared queues by other Datanodes,
+		 * and there is nobody to report to, so only do it at the top.
+		 */
+		rstmt.instrumentOptions = IS_PGXC_DATANODE ? 0 : estate->es_instrument;
+
+		/*
+		 * Let the Datanodes account the fragment under the identifier of the
+		 * query it belongs to, rather than under one of its own.
+		 */
+		rstmt.queryId = estate->es_plannedstmt->queryId;
 
 		/*
 		 * A try-catch block to ensure that we don't leave behind a stale state
@@ -5657,6 +6544,10 @@ ExecFinishInitRemoteSubplan(RemoteSubplanState *node)
 	int 				i;
 	bool				is_read_only;
 	char				cursor[NAMEDATALEN];
+	uint8				digest[PG_SHA256_DIGEST_LENGTH];
+	pg_sha256_ctx		ctx;
+	size_t				planlen;
+	bool				send_digest;
 
 	/*
 	 * Name is required to store plan as a statement
@@ -5716,6 +6607,17 @@ ExecFinishInitRemoteSubplan(RemoteSubplanState *node)
 		for (i = 0; i < node->nParamRemote; i++)
 			paramtypes[i] = node->remoteparams[i].paramtype;
 	}
+	/*
+	 * Datanodes cache decoded plans by digest. Large plans are sent as the
+	 * digest only, and the body is sent to the nodes that ask for it.
+	 */
+	planlen = strlen(node->subplanstr);
+	pg_sha256_init(&ctx);
+	pg_sha256_update(&ctx, (const uint8 *) node->subplanstr, planlen);
+	pg_sha256_final(&ctx, digest);
+	send_digest = RemoteSubplanDigestMinSize >= 0 &&
+		planlen >= (size_t) RemoteSubplanDigestMinSize;
+
 	/* send down subplan */
 	snapshot = GetActiveSnapshot();
 	timestamp = GetCurrentGTMStartTimestamp();
@@ -5728,16 +6630,21 @@ ExecFinishInitRemoteSubplan(RemoteSubplanState *node)
 	is_read_only = IS_PGXC_DATANODE ||
 			!IsA(outerPlan(plan), ModifyTable);
 
+	/*
+	 * Start the transaction on all the nodes at once, waiting for a single
+	 * round of responses. A replicated ModifyTable still runs on the primary
+	 * node first, that is done when the subplan is executed.
+	 */
+	if (pgxc_node_begin(combiner->conn_count, combiner->connections, gxid,
+						true, is_read_only, PGXC_NODE_DATANODE))
+		ereport(ERROR,
+				(errcode(ERRCODE_INTERNAL_ERROR),
+				 errmsg("Could not begin transaction on data node.")));
+
 	for (i = 0; i < combiner->conn_count; i++)
 	{
 		PGXCNodeHandle *connection = combiner->connections[i];
 
-		if (pgxc_node_begin(1, &connection, gxid, true,
-							is_read_only, PGXC_NODE_DATANODE))
-			ereport(ERROR,
-					(errcode(ERRCODE_INTERNAL_ERROR),
-					 errmsg("Could not begin transaction on data node.")));
-
 		if (pgxc_node_send_timestamp(connection, timestamp))
 		{
 			combiner->conn_count = 0;
@@ -5763,7 +6670,8 @@ ExecFinishInitRemoteSubplan(RemoteSubplanState *node)
 					 errmsg("Failed to send command ID to data nodes")));
 		}
 		pgxc_node_send_plan(connection, cursor, "Remote Subplan",
-							node->subplanstr, node->nParamRemote, paramtypes);
+							send_digest ? "" : node->subplanstr, digest,
+							node->nParamRemote, paramtypes);
 		if (pgxc_node_flush(connection))
 		{
 			combiner->conn_count = 0;
@@ -5773,6 +6681,99 @@ ExecFinishInitRemoteSubplan(RemoteSubplanState *node)
 					 errmsg("Failed to send subplan to data nodes")));
 		}
 	}
+
+	if (send_digest)
+		pgxc_node_send_missing_plans(combiner->conn_count,
+									 combiner->connections,
+									 cursor, node->subplanstr, digest,
+									 node->nParamRemote, paramtypes);
+}
+
+
+/*
+ * Wait for the Datanodes to answer the plan digest sent down and send the
+ * plan body to those which do not have it cached. ParseComplete and the body
+ * request are consumed here, anything else is left in the buffer for regular
+ * response processing.
+ */
+static void
+pgxc_node_send_missing_plans(int conn_count, PGXCNodeHandle **connections,
+							 const char *cursor, const char *planstr,
+							 const uint8 *digest,
+							 short num_params, Oid *param_types)
+{
+	PGXCNodeHandle **pending;
+	int			npending = 0;
+	int			i;
+
+	pending = (PGXCNodeHandle **) palloc(conn_count * sizeof(PGXCNodeHandle *));
+	for (i = 0; i < conn_count; i++)
+	{
+		/* Make pgxc_node_receive() wait on the connection */
+		PGXCNodeSetConnectionState(connections[i], DN_CONNECTION_STATE_QUERY);
+		pending[npending++] = connections[i];
+	}
+
+	while (npending > 0)
+	{
+		if (pgxc_node_receive(npending, pending, NULL))
+			ereport(ERROR,
+					(errcode(ERRCODE_INTERNAL_ERROR),
+					 errmsg("Failed to receive subplan response from data nodes")));
+
+		i = 0;
+		while (i < npending)
+		{
+			PGXCNodeHandle *conn = pending[i];
+			size_t		saveStart = conn->inStart;
+			size_t		saveCursor = conn->inCursor;
+			char		msg_type;
+			int			msg_len;
+			char	   *msg;
+
+			if (conn->state == DN_CONNECTION_STATE_ERROR_FATAL)
+				ereport(ERROR,
+						(errcode(ERRCODE_INTERNAL_ERROR),
+						 errmsg("Failed to receive subplan response from data node %s",
+								conn->nodename)));
+
+			msg_type = get_message(conn, &msg_len, &msg);
+			if (msg_type == '\0')
+			{
+				/* Not there yet, wait for more data */
+				i++;
+				continue;
+			}
+
+			if (msg_type == 'h')
+			{
+				/* Datanode does not have the plan, send the body */
+				PGXCNodeSetConnectionState(conn, DN_CONNECTION_STATE_IDLE);
+				if (pgxc_node_send_plan(conn, cursor, "Remote Subplan",
+										planstr, digest,
+										num_params, param_types) ||
+						pgxc_node_flush(conn))
+					ereport(ERROR,
+							(errcode(ERRCODE_INTERNAL_ERROR),
+							 errmsg("Failed to send subplan to data node %s",
+									conn->nodename)));
+			}
+			else if (msg_type != '1')
+			{
+				/*
+				 * Most likely an error. Put the message back, it is reported
+				 * when the results are read.
+				 */
+				conn->inStart = saveStart;
+				conn->inCursor = saveCursor;
+			}
+
+			PGXCNodeSetConnectionState(conn, DN_CONNECTION_STATE_IDLE);
+			pending[i] = pending[--npending];
+		}
+	}
+
+	pfree(pending);
 }
 
 
@@ -5823,7 +6824,8 @@ append_param_data(StringInfo buf, Oid ptype, int pused, Datum value, bool isnull
 
 
 static int encode_parameters(int nparams, RemoteParam *remoteparams,
-							 PlanState *planstate, char** result)
+							 PlanState *planstate, bytea *bloomFilter,
+							 char** result)
 {
 	EState 		   *estate = planstate->state;
 	StringInfoData	buf;
@@ -5851,7 +6853,14 @@ static int encode_parameters(int nparams, RemoteParam *remoteparams,
 		RemoteParam *rparam = &remoteparams[i];
 		int ptype = rparam->paramtype;
 		int pused = rparam->paramused;
-		if (rparam->paramkind == PARAM_EXTERN)
+		if (rparam->paramkind == PARAM_EXTERN && rparam->paramid == 0)
+		{
+			/* Bloom filter of the join keys, NULL if not built */
+			append_param_data(&buf, ptype, pused,
+							  PointerGetDatum(bloomFilter),
+							  bloomFilter == NULL);
+		}
+		else if (rparam->paramkind == PARAM_EXTERN)
 		{
 			ParamExternData *param;
 			param = &(estate->es_param_list_info->params[rparam->paramid - 1]);
@@ -5884,6 +6893,156 @@ static int encode_parameters(int nparams, RemoteParam *remoteparams,
 }
 
 
+/*
+ * Cache of the rows returned by a rescanned RemoteSubplan.
+ *
+ * The key is the parameter values encoded as they are sent to the remote
+ * nodes, so the same values always find the same entry. An entry is only
+ * looked up once it is complete, an interrupted scan drops the rows it has
+ * collected. The cache is kept within work_mem, when a new row does not fit
+ * the least recently used complete entries are evicted, and if that is not
+ * enough the entry being filled is dropped.
+ */
+typedef struct RemoteMemoKey
+{
+	char	   *data;
+	int			len;
+} RemoteMemoKey;
+
+typedef struct RemoteMemoEntry
+{
+	RemoteMemoKey key;			/* copy of the hash key */
+	List	   *tuples;			/* list of MinimalTuples */
+	Size		size;			/* memory used by the entry */
+	bool		complete;		/* all rows have been received */
+	dlist_node	lru;			/* link in memo_lru, if complete */
+} RemoteMemoEntry;
+
+/*
+ * The cache is probed on every rescan, that is once per outer row of a
+ * nested loop, so it uses an open addressing table with the hash values
+ * stored in the buckets. Buckets move as the table changes, hence they
+ * only point to the entries, which are referenced from elsewhere.
+ */
+typedef struct RemoteMemoBucket
+{
+	RemoteMemoKey key;
+	uint32		hash;
+	char		status;
+	RemoteMemoEntry *entry;
+} RemoteMemoBucket;
+
+#define SH_PREFIX remotememo
+#define SH_ELEMENT_TYPE RemoteMemoBucket
+#define SH_KEY_TYPE RemoteMemoKey
+#define SH_KEY key
+#define SH_HASH_KEY(tb, k) \
+	DatumGetUInt32(hash_any((const unsigned char *) (k).data, (k).len))
+#define SH_EQUAL(tb, a, b) \
+	((a).len == (b).len && memcmp((a).data, (b).data, (a).len) == 0)
+#define SH_SCOPE static inline
+#define SH_STORE_HASH
+#define SH_GET_HASH(tb, a) a->hash
+#define SH_DECLARE
+#define SH_DEFINE
+#include "lib/simplehash.h"
+
+static void
+memo_init(RemoteSubplanState *node)
+{
+	node->memo_cxt = AllocSetContextCreate(node->combiner.ss.ps.state->es_query_cxt,
+										   "RemoteSubplan cache",
+										   ALLOCSET_DEFAULT_SIZES);
+	node->memo_table = remotememo_create(node->memo_cxt, 256, NULL);
+	dlist_init(&node->memo_lru);
+	node->memo_size = 0;
+}
+
+static void
+memo_remove(RemoteSubplanState *node, RemoteMemoEntry *entry)
+{
+	list_free_deep(entry->tuples);
+	node->memo_size -= entry->size;
+	if (entry->complete)
+		dlist_delete(&entry->lru);
+	remotememo_delete(node->memo_table, entry->key);
+	pfree(entry->key.data);
+	pfree(entry);
+}
+
+/*
+ * Look up the rows for the given parameter values. On a hit the entry is
+ * returned, otherwise a new entry is started to collect the rows of the
+ * coming scan and NULL is returned.
+ */
+static RemoteMemoEntry *
+memo_lookup(RemoteSubplanState *node, char *paramdata, int paramlen)
+{
+	RemoteMemoKey key;
+	RemoteMemoBucket *bucket;
+	RemoteMemoEntry *entry;
+	bool		found;
+
+	key.data = paramdata;
+	key.len = paramlen;
+	bucket = remotememo_insert(node->memo_table, key, &found);
+	if (found)
+	{
+		entry = bucket->entry;
+		/* Incomplete entries are dropped on rescan */
+		Assert(entry->complete);
+		dlist_delete(&entry->lru);
+		dlist_push_tail(&node->memo_lru, &entry->lru);
+		return entry;
+	}
+
+	entry = (RemoteMemoEntry *) MemoryContextAlloc(node->memo_cxt,
+												   sizeof(RemoteMemoEntry));
+	entry->key.data = MemoryContextAlloc(node->memo_cxt, paramlen);
+	entry->key.len = paramlen;
+	memcpy(entry->key.data, paramdata, paramlen);
+	/* The bucket must not keep pointing to the caller's buffer */
+	bucket->key = entry->key;
+	bucket->entry = entry;
+	entry->tuples = NIL;
+	entry->size = sizeof(RemoteMemoEntry) + paramlen;
+	entry->complete = false;
+	node->memo_size += entry->size;
+	node->memo_fill = entry;
+	return NULL;
+}
+
+static void
+memo_add_tuple(RemoteSubplanState *node, TupleTableSlot *slot)
+{
+	RemoteMemoEntry *entry = node->memo_fill;
+	MemoryContext oldcontext;
+	MinimalTuple tuple;
+	Size		size;
+
+	oldcontext = MemoryContextSwitchTo(node->memo_cxt);
+	tuple = ExecCopySlotMinimalTuple(slot);
+	entry->tuples = lappend(entry->tuples, tuple);
+	MemoryContextSwitchTo(oldcontext);
+
+	size = GetMemoryChunkSpace(tuple) + sizeof(ListCell);
+	entry->size += size;
+	node->memo_size += size;
+
+	while (node->memo_size > work_mem * 1024L &&
+		   !dlist_is_empty(&node->memo_lru))
+		memo_remove(node, dlist_head_element(RemoteMemoEntry, lru,
+											 &node->memo_lru));
+
+	/* The rows for these values alone do not fit, give up on them */
+	if (node->memo_size > work_mem * 1024L)
+	{
+		memo_remove(node, entry);
+		node->memo_fill = NULL;
+	}
+}
+
+
 TupleTableSlot *
 ExecRemoteSubplan(PlanState *pstate)
 {
@@ -5895,6 +7054,18 @@ ExecRemoteSubplan(PlanState *pstate)
 	struct rusage	start_r;
 	struct timeval		start_t;
 
+replay_memo:
+	if (node->memo_replay)
+	{
+		MinimalTuple tuple;
+
+		if (node->memo_next == NULL)
+			return NULL;
+		tuple = (MinimalTuple) lfirst(node->memo_next);
+		node->memo_next = lnext(node->memo_next);
+		return ExecStoreMinimalTuple(tuple, resultslot, false);
+	}
+
 	/* 
 	 * We allow combiner->conn_count == 0 after node initialization
 	 * if we figured out that current node won't receive any result
@@ -5931,7 +7102,30 @@ primary_mode_phase_two:
 
 		if (plan->cursor)
 		{
+			/*
+			 * If the parent Limit needs fewer rows than the fetch size, ask
+			 * for just that many. A node which gave us that many rows is
+			 * not asked for more.
+			 */
 			fetch = PGXLRemoteFetchSize;
+			combiner->fetch_is_bound = false;
+			if (node->tuples_bounded &&
+				(fetch <= 0 || node->tuples_needed <= fetch))
+			{
+				fetch = (int) Max(node->tuples_needed, 1);
+				combiner->fetch_is_bound = true;
+			}
+			else if (fetch > 0)
+			{
+				/*
+				 * Start small, so a consumer which stops early does not make
+				 * the nodes produce and ship rows it never reads.  The size
+				 * grows as more rows are asked for, see remote_fetch_grow.
+				 */
+				fetch = Max(fetch / REMOTE_FETCH_RAMP, 1);
+			}
+			combiner->fetch_size = fetch;
+			combiner->fetch_size_initial = fetch;
 			if (plan->unique)
 				snprintf(cursor, NAMEDATALEN, "%s_%d", plan->cursor, plan->unique);
 			else
@@ -5944,12 +7138,31 @@ primary_mode_phase_two:
 		 * Send down all available parameters, if any is used by the plan
 		 */
 		if (estate->es_param_list_info ||
-				!bms_is_empty(plan->scan.plan.allParam))
+				!bms_is_empty(plan->scan.plan.allParam) ||
+				plan->bloomKeyNo > 0)
 			paramlen = encode_parameters(node->nParamRemote,
 										 node->remoteparams,
 										 &combiner->ss.ps,
+										 node->bloomFilter,
 										 &paramdata);
 
+		/*
+		 * Replay the rows if these parameter values have been seen before,
+		 * otherwise remember the rows coming from the remote nodes. The
+		 * remote portal is left as is, the next rescan rebinds it.
+		 */
+		if (node->memo_cxt && !primary_mode && !node->tuples_bounded)
+		{
+			RemoteMemoEntry *entry = memo_lookup(node, paramdata, paramlen);
+
+			if (entry)
+			{
+				node->memo_replay = entry;
+				node->memo_next = list_head(entry->tuples);
+				goto replay_memo;
+			}
+		}
+
 		/*
 		 * The subplan being rescanned, need to restore connections and
 		 * re-bind the portal
@@ -6127,18 +7340,11 @@ primary_mode_phase_two:
 		if (combiner->merge_sort)
 		{
 			/*
-			 * Requests are already made and sorter can fetch tuples to populate
-			 * sort buffer.
+			 * Requests are already made and merge can fetch tuples from the
+			 * connections as it needs them.
 			 */
-			combiner->tuplesortstate = tuplesort_begin_merge(
-									   resultslot->tts_tupleDescriptor,
-									   plan->sort->numCols,
-									   plan->sort->sortColIdx,
-									   plan->sort->sortOperators,
-									   plan->sort->sortCollations,
-									   plan->sort->nullsFirst,
-									   combiner,
-									   work_mem);
+			remote_merge_begin(combiner, resultslot->tts_tupleDescriptor,
+							   plan->sort);
 		}
 		if (primary_mode)
 		{
@@ -6154,11 +7360,12 @@ primary_mode_phase_two:
 			node->bound = true;
 	}
 
-	if (combiner->tuplesortstate)
+	if (combiner->mergestate)
 	{
-		if (tuplesort_gettupleslot((Tuplesortstate *) combiner->tuplesortstate,
-								   true, true, resultslot, NULL))
+		if (remote_merge_next(combiner))
 		{
+			if (node->memo_fill)
+				memo_add_tuple(node, resultslot);
 			if (log_remotesubplan_stats)
 				ShowUsageCommon("ExecRemoteSubplan", &start_r, &start_t);
 			return resultslot;
@@ -6169,6 +7376,8 @@ primary_mode_phase_two:
 		TupleTableSlot *slot = FetchTuple(combiner);
 		if (!TupIsNull(slot))
 		{
+			if (node->memo_fill)
+				memo_add_tuple(node, slot);
 			if (log_remotesubplan_stats)
 				ShowUsageCommon("ExecRemoteSubplan", &start_r, &start_t);
 			return slot;
@@ -6180,6 +7389,14 @@ primary_mode_phase_two:
 	if (combiner->errorMessage)
 		pgxc_node_report_error(combiner);
 
+	/* All rows are received, the entry may be used from now on */
+	if (node->memo_fill)
+	{
+		node->memo_fill->complete = true;
+		dlist_push_tail(&node->memo_lru, &node->memo_fill->lru);
+		node->memo_fill = NULL;
+	}
+
 	if (log_remotesubplan_stats)
 		ShowUsageCommon("ExecRemoteSubplan", &start_r, &start_t);
 
@@ -6187,11 +7404,30 @@ primary_mode_phase_two:
 }
 
 
+/*
+ * Every rescan with new parameter values rebinds the remote portal, which
+ * costs one round trip to the remote nodes. Repeated values are answered
+ * from the cache, see memo_lookup. Values are not batched for several
+ * rescans: the plan on the remote side takes one value per parameter, and
+ * returning the rows of many parameter sets at once would need the plan
+ * rewritten to scan an array of values and tag each row with its set,
+ * besides a parent join which could consume such rows.
+ */
 void
 ExecReScanRemoteSubplan(RemoteSubplanState *node)
 {
 	ResponseCombiner *combiner = (ResponseCombiner *)node;
 
+	/* Rows of an interrupted scan are not the full result, drop them */
+	if (node->memo_fill)
+	{
+		memo_remove(node, node->memo_fill);
+		node->memo_fill = NULL;
+	}
+	node->memo_replay = NULL;
+	if (node->memoize && node->memo_cxt == NULL)
+		memo_init(node);
+
 	/*
 	 * If we haven't queried remote nodes yet, just return. If outerplan'
 	 * chgParam is not NULL then it will be re-scanned by ExecProcNode,
@@ -6238,6 +7474,8 @@ ExecEndRemoteSubplan(RemoteSubplanState *node)
 		ExecEndNode(outerPlanState(node));
 	if (node->locator)
 		freeLocator(node->locator);
+	if (node->memo_cxt)
+		MemoryContextDelete(node->memo_cxt);
 
 	/*
 	 * Consume any possible pending input
@@ -6328,7 +7566,8 @@ ExecEndRemoteSubplan(RemoteSubplanState *node)
 	}
 
 	/* Close statements, even if they never were bound */
-	for (i = 0; i < combiner->conn_count; i++)
+	i = 0;
+	while (i < combiner->conn_count)
 	{
 		PGXCNodeHandle *conn;
 		char			cursor[NAMEDATALEN];
@@ -6351,6 +7590,27 @@ ExecEndRemoteSubplan(RemoteSubplanState *node)
 			ereport(ERROR,
 					(errcode(ERRCODE_INTERNAL_ERROR),
 					 errmsg("Failed to close data node statement")));
+
+		/*
+		 * If all the responses are already received we do not have to wait
+		 * for ReadyForQuery, it will be consumed along with responses to
+		 * the commands sent down next.
+		 */
+		if (PGXLRemotePipeline && conn->state == DN_CONNECTION_STATE_IDLE)
+		{
+			if (pgxc_node_send_sync(conn) != 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_INTERNAL_ERROR),
+						 errmsg("Failed to synchronize data node")));
+			conn->pendingSyncs++;
+			conn->combiner = NULL;
+			/* Nothing to wait for, remove from the list */
+			if (i < --combiner->conn_count)
+				combiner->connections[i] =
+						combiner->connections[combiner->conn_count];
+			continue;
+		}
+
 		/* Send SYNC and wait for ReadyForQuery */
 		if (pgxc_node_send_sync(conn) != 0)
 			ereport(ERROR,
@@ -6363,6 +7623,7 @@ ExecEndRemoteSubplan(RemoteSubplanState *node)
 		 * cleared.
 		 */
 		PGXCNodeSetConnectionState(conn, DN_CONNECTION_STATE_CLOSE);
+		i++;
 	}
 
 	while (combiner->conn_count > 0)
@@ -0,0 +1,661 @@
+/*-------------------------------------------------------------------------
+ *
+ * globaldeadlock.c
+ *
+ *	  Detection of deadlocks spanning multiple nodes
+ *
+ * The deadlock detector of every node only sees the lock waits of that node.
+ * Two distributed sessions updating rows on different Datanodes in opposite
+ * order wait for each other on different nodes, and each of the nodes sees
+ * just a plain lock wait. Such deadlocks used to be resolved only by
+ * lock_timeout or statement_timeout.
+ *
+ * The global deadlock detector is a background worker running on every
+ * Coordinator. Each global_deadlock_check_interval it collects the lock wait
+ * edges from all the nodes, with both ends mapped to the distributed session
+ * they belong to, builds the wait-for graph of the sessions and looks for
+ * cycles. The edges are not collected from all the nodes at the same moment,
+ * so a cycle is acted upon only if it is found in two consecutive rounds.
+ *
+ * The victim of a cycle is chosen by the same rule on every Coordinator, and
+ * it is canceled by the detector of the Coordinator the session belongs to.
+ * Cancellation of the statement makes the session abort the transaction on
+ * all the nodes, which releases the locks.
+ *
+ * Portions Copyright (c) 1996-2011, PostgreSQL Global Development Group
+ * Portions Copyright (c) 2010-2012 Postgres-XC Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/pgxc/pool/globaldeadlock.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <signal.h>
+
+#include "access/xact.h"
+#include "catalog/pg_type.h"
+#include "catalog/pgxc_node.h"
+#include "executor/executor.h"
+#include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "pgstat.h"
+#include "pgxc/execRemote.h"
+#include "pgxc/globaldeadlock.h"
+#include "pgxc/nodemgr.h"
+#include "pgxc/pgxc.h"
+#include "pgxc/pgxcnode.h"
+#include "pgxc/planner.h"
+#include "pgxc/poolmgr.h"
+#include "postmaster/bgworker.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/proc.h"
+#include "storage/procarray.h"
+#include "tcop/tcopprot.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/snapmgr.h"
+
+/* GUC parameters */
+int			GlobalDeadlockCheckInterval = 1000;
+
+/* Query run on the remote nodes to get their lock wait edges */
+#define GLOBAL_DEADLOCK_EDGES_QUERY \
+	"SELECT * FROM pg_catalog.pgxc_lock_wait_edges()"
+
+/* Distributed session: vertex of the wait-for graph */
+typedef struct GlobalSessionKey
+{
+	NameData	node;
+	int			pid;
+} GlobalSessionKey;
+
+typedef struct GlobalSessionEntry
+{
+	GlobalSessionKey key;		/* hash key, must be first */
+	int			index;			/* position in the vertex array */
+} GlobalSessionEntry;
+
+typedef struct GlobalSessionVertex
+{
+	GlobalSessionKey key;
+	bool		is_coordinator;	/* can be chosen as victim */
+	bool		removed;		/* victim of a cycle found earlier */
+	int			state;			/* DFS state, see below */
+	List	   *waits_for;		/* indexes of the vertices waited for */
+} GlobalSessionVertex;
+
+#define GDD_UNVISITED	0
+#define GDD_ON_STACK	1
+#define GDD_DONE		2
+
+typedef struct WaitForGraph
+{
+	GlobalSessionVertex *vertices;
+	int			nvertices;
+	int		   *path;			/* DFS stack */
+	int			pathlen;
+} WaitForGraph;
+
+/* Victims found in the previous round, in TopMemoryContext */
+static GlobalSessionKey *prev_victims = NULL;
+static int	prev_nvictims = 0;
+
+static volatile sig_atomic_t got_SIGHUP = false;
+
+static void gdd_sighup(SIGNAL_ARGS);
+static void gdd_session_of(int pid, Name node, int *session_pid);
+static void gdd_add_edge(GlobalWaitEdge **edges, int *nedges, int *maxedges,
+			 Name waiter_node, int waiter_pid,
+			 Name holder_node, int holder_pid);
+static void gdd_collect_remote(RemoteQueryExecType exec_type, List *nodelist,
+				   GlobalWaitEdge **edges, int *nedges, int *maxedges);
+static int	gdd_find_cycle(WaitForGraph *graph, int v);
+static int	gdd_choose_victim(WaitForGraph *graph, int start, StringInfo cycle);
+static void gdd_check(MemoryContext roundcxt);
+
+
+/*
+ * Identify the distributed session of a local backend. Backends of a
+ * distributed session started by a remote Coordinator have the session id
+ * exposed in PGPROC; others are local sessions of this node.
+ */
+static void
+gdd_session_of(int pid, Name node, int *session_pid)
+{
+	Oid			coordId;
+	int			coordPid;
+
+	GetGlobalSessionInfo(pid, &coordId, &coordPid);
+	if (OidIsValid(coordId) && coordPid != 0)
+	{
+		namestrcpy(node, get_pgxc_nodename(coordId));
+		*session_pid = coordPid;
+	}
+	else
+	{
+		namestrcpy(node, PGXCNodeName);
+		*session_pid = pid;
+	}
+}
+
+static void
+gdd_add_edge(GlobalWaitEdge **edges, int *nedges, int *maxedges,
+			 Name waiter_node, int waiter_pid,
+			 Name holder_node, int holder_pid)
+{
+	GlobalWaitEdge *edge;
+
+	if (*nedges >= *maxedges)
+	{
+		*maxedges = Max(*maxedges * 2, 16);
+		if (*edges)
+			*edges = (GlobalWaitEdge *)
+				repalloc(*edges, *maxedges * sizeof(GlobalWaitEdge));
+		else
+			*edges = (GlobalWaitEdge *)
+				palloc(*maxedges * sizeof(GlobalWaitEdge));
+	}
+
+	edge = &(*edges)[(*nedges)++];
+	namecpy(&edge->waiter_node, waiter_node);
+	edge->waiter_pid = waiter_pid;
+	namecpy(&edge->holder_node, holder_node);
+	edge->holder_pid = holder_pid;
+}
+
+/*
+ * GetLocalWaitEdges
+ *
+ * Return the lock waits of this node as edges between distributed sessions.
+ * Waits between the backends of the same distributed session are not
+ * reported, they never block each other. Prepared transactions are not
+ * reported either; they do not wait for anything.
+ *
+ * Backends are checked for a lock wait without locking first, so when nobody
+ * waits this costs a scan of the PGPROC array and nothing more.
+ */
+GlobalWaitEdge *
+GetLocalWaitEdges(int *nedges)
+{
+	GlobalWaitEdge *edges = NULL;
+	int			maxedges = 0;
+	int			i;
+
+	*nedges = 0;
+
+	for (i = 0; i < MaxBackends; i++)
+	{
+		volatile PGPROC *proc = &ProcGlobal->allProcs[i];
+		int			pid = proc->pid;
+		ArrayType  *blockers;
+		Datum	   *elems;
+		int			nelems;
+		NameData	waiter_node;
+		int			waiter_pid;
+		int			j;
+
+		if (pid == 0 || proc->waitLock == NULL)
+			continue;
+
+		blockers = DatumGetArrayTypeP(DirectFunctionCall1(pg_blocking_pids,
+														  Int32GetDatum(pid)));
+		deconstruct_array(blockers, INT4OID, sizeof(int32), true, 'i',
+						  &elems, NULL, &nelems);
+		if (nelems == 0)
+			continue;
+
+		gdd_session_of(pid, &waiter_node, &waiter_pid);
+		for (j = 0; j < nelems; j++)
+		{
+			int			holder = DatumGetInt32(elems[j]);
+			NameData	holder_node;
+			int			holder_pid;
+
+			if (holder == 0)
+				continue;
+
+			gdd_session_of(holder, &holder_node, &holder_pid);
+			if (holder_pid == waiter_pid &&
+				strcmp(NameStr(holder_node), NameStr(waiter_node)) == 0)
+				continue;
+
+			gdd_add_edge(&edges, nedges, &maxedges,
+						 &waiter_node, waiter_pid, &holder_node, holder_pid);
+		}
+	}
+
+	return edges;
+}
+
+/*
+ * Run GLOBAL_DEADLOCK_EDGES_QUERY on the specified nodes and append the
+ * results to the edge array.
+ */
+static void
+gdd_collect_remote(RemoteQueryExecType exec_type, List *nodelist,
+				   GlobalWaitEdge **edges, int *nedges, int *maxedges)
+{
+	EState	   *estate;
+	MemoryContext oldcontext;
+	RemoteQuery *plan;
+	RemoteQueryState *pstate;
+	TupleTableSlot *result;
+	int			i;
+
+	if (nodelist == NIL)
+		return;
+
+	plan = makeNode(RemoteQuery);
+	plan->combine_type = COMBINE_TYPE_NONE;
+	plan->exec_nodes = makeNode(ExecNodes);
+	plan->exec_nodes->nodeList = nodelist;
+	plan->exec_type = exec_type;
+	plan->sql_statement = GLOBAL_DEADLOCK_EDGES_QUERY;
+	plan->force_autocommit = false;
+	for (i = 1; i <= 4; i++)
+	{
+		Var		   *var = makeVar(1, i, (i % 2) ? NAMEOID : INT4OID,
+								  -1, InvalidOid, 0);
+
+		plan->scan.plan.targetlist = lappend(plan->scan.plan.targetlist,
+											 makeTargetEntry((Expr *) var, i,
+															 NULL, false));
+	}
+
+	estate = CreateExecutorState();
+	oldcontext = MemoryContextSwitchTo(estate->es_query_cxt);
+	estate->es_snapshot = GetActiveSnapshot();
+	pstate = ExecInitRemoteQuery(plan, estate, 0);
+	MemoryContextSwitchTo(oldcontext);
+
+	result = ExecRemoteQuery((PlanState *) pstate);
+	while (result != NULL && !TupIsNull(result))
+	{
+		slot_getallattrs(result);
+		if (!result->tts_isnull[0] && !result->tts_isnull[1] &&
+			!result->tts_isnull[2] && !result->tts_isnull[3])
+			gdd_add_edge(edges, nedges, maxedges,
+						 DatumGetName(result->tts_values[0]),
+						 DatumGetInt32(result->tts_values[1]),
+						 DatumGetName(result->tts_values[2]),
+						 DatumGetInt32(result->tts_values[3]));
+		result = ExecRemoteQuery((PlanState *) pstate);
+	}
+	ExecEndRemoteQuery(pstate);
+	FreeExecutorState(estate);
+}
+
+/*
+ * Depth-first search from vertex v. Returns the start of the cycle in
+ * graph->path if one is found, -1 otherwise.
+ */
+static int
+gdd_find_cycle(WaitForGraph *graph, int v)
+{
+	GlobalSessionVertex *vertex = &graph->vertices[v];
+	ListCell   *lc;
+
+	check_stack_depth();
+
+	vertex->state = GDD_ON_STACK;
+	graph->path[graph->pathlen++] = v;
+
+	foreach(lc, vertex->waits_for)
+	{
+		int			w = lfirst_int(lc);
+		GlobalSessionVertex *next = &graph->vertices[w];
+		int			start;
+
+		if (next->removed)
+			continue;
+
+		if (next->state == GDD_ON_STACK)
+		{
+			for (start = graph->pathlen - 1; start >= 0; start--)
+				if (graph->path[start] == w)
+					return start;
+			Assert(false);
+		}
+
+		if (next->state == GDD_UNVISITED)
+		{
+			start = gdd_find_cycle(graph, w);
+			if (start >= 0)
+				return start;
+		}
+	}
+
+	vertex->state = GDD_DONE;
+	graph->pathlen--;
+	return -1;
+}
+
+/*
+ * Choose the victim of the cycle found on the DFS stack from position start.
+ * Every Coordinator chooses the same one: the session with the greatest
+ * Coordinator name and pid. Only Coordinator sessions can be canceled, a
+ * cycle of local Datanode sessions is a local deadlock and is not ours to
+ * resolve. Returns the vertex index or -1.
+ */
+static int
+gdd_choose_victim(WaitForGraph *graph, int start, StringInfo cycle)
+{
+	int			victim = -1;
+	int			i;
+
+	resetStringInfo(cycle);
+	for (i = start; i < graph->pathlen; i++)
+	{
+		int			v = graph->path[i];
+		GlobalSessionVertex *vertex = &graph->vertices[v];
+
+		appendStringInfo(cycle, "%s/%d -> ",
+						 NameStr(vertex->key.node), vertex->key.pid);
+
+		if (!vertex->is_coordinator)
+			continue;
+
+		if (victim < 0)
+			victim = v;
+		else
+		{
+			GlobalSessionVertex *current = &graph->vertices[victim];
+			int			cmp = strcmp(NameStr(vertex->key.node),
+									 NameStr(current->key.node));
+
+			if (cmp > 0 || (cmp == 0 && vertex->key.pid > current->key.pid))
+				victim = v;
+		}
+	}
+	appendStringInfo(cycle, "%s/%d",
+					 NameStr(graph->vertices[graph->path[start]].key.node),
+					 graph->vertices[graph->path[start]].key.pid);
+
+	return victim;
+}
+
+/*
+ * One round of the global deadlock detection
+ */
+static void
+gdd_check(MemoryContext roundcxt)
+{
+	MemoryContext oldcontext;
+	GlobalWaitEdge *edges;
+	int			nedges;
+	int			maxedges;
+	Oid		   *coOids;
+	Oid		   *dnOids;
+	int			numCoords;
+	int			numDNodes;
+	Oid			myoid;
+	List	   *dnlist = NIL;
+	List	   *colist = NIL;
+	HASHCTL		ctl;
+	HTAB	   *sessions;
+	WaitForGraph graph;
+	GlobalSessionKey *victims;
+	int			nvictims = 0;
+	StringInfoData cycle;
+	int			i;
+
+	StartTransactionCommand();
+	PushActiveSnapshot(GetTransactionSnapshot());
+	oldcontext = MemoryContextSwitchTo(roundcxt);
+
+	edges = GetLocalWaitEdges(&nedges);
+	maxedges = nedges;
+
+	PgxcNodeGetOids(&coOids, &dnOids, &numCoords, &numDNodes, false);
+	myoid = get_pgxc_nodeoid(PGXCNodeName);
+	for (i = 0; i < numDNodes; i++)
+	{
+		int			nodeid = PGXCNodeGetNodeId(dnOids[i], NULL);
+
+		if (nodeid >= 0)
+			dnlist = lappend_int(dnlist, nodeid);
+	}
+	for (i = 0; i < numCoords; i++)
+	{
+		char		ntype = PGXC_NODE_COORDINATOR;
+		int			nodeid;
+
+		if (coOids[i] == myoid)
+			continue;
+		nodeid = PGXCNodeGetNodeId(coOids[i], &ntype);
+		if (nodeid >= 0)
+			colist = lappend_int(colist, nodeid);
+	}
+
+	gdd_collect_remote(EXEC_ON_DATANODES, dnlist, &edges, &nedges, &maxedges);
+	gdd_collect_remote(EXEC_ON_COORDS, colist, &edges, &nedges, &maxedges);
+
+	/* Build the graph */
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(GlobalSessionKey);
+	ctl.entrysize = sizeof(GlobalSessionEntry);
+	ctl.hcxt = roundcxt;
+	sessions = hash_create("global deadlock detector sessions",
+						   Max(nedges, 16), &ctl,
+						   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	graph.vertices = (GlobalSessionVertex *)
+		palloc0(Max(2 * nedges, 1) * sizeof(GlobalSessionVertex));
+	graph.nvertices = 0;
+	for (i = 0; i < nedges; i++)
+	{
+		int			ends[2];
+		int			j;
+
+		for (j = 0; j < 2; j++)
+		{
+			GlobalSessionKey key;
+			GlobalSessionEntry *entry;
+			bool		found;
+
+			memset(&key, 0, sizeof(key));
+			namecpy(&key.node, j ? &edges[i].holder_node : &edges[i].waiter_node);
+			key.pid = j ? edges[i].holder_pid : edges[i].waiter_pid;
+
+			entry = (GlobalSessionEntry *) hash_search(sessions, &key,
+													   HASH_ENTER, &found);
+			if (!found)
+			{
+				GlobalSessionVertex *vertex = &graph.vertices[graph.nvertices];
+				char		ntype = PGXC_NODE_NONE;
+
+				entry->index = graph.nvertices++;
+				vertex->key = key;
+				PGXCNodeGetNodeIdFromName(NameStr(key.node), &ntype);
+				vertex->is_coordinator = (ntype == PGXC_NODE_COORDINATOR);
+			}
+			ends[j] = entry->index;
+		}
+		graph.vertices[ends[0]].waits_for =
+			lappend_int(graph.vertices[ends[0]].waits_for, ends[1]);
+	}
+	graph.path = (int *) palloc(Max(graph.nvertices, 1) * sizeof(int));
+	victims = (GlobalSessionKey *)
+		palloc(Max(graph.nvertices, 1) * sizeof(GlobalSessionKey));
+
+	/*
+	 * Find the cycles. After a victim is chosen it is taken out of the graph
+	 * and the search is restarted, so that overlapping cycles are resolved
+	 * by a single victim whenever possible.
+	 */
+	initStringInfo(&cycle);
+	for (;;)
+	{
+		int			start = -1;
+		int			victim;
+		int			v;
+
+		for (v = 0; v < graph.nvertices; v++)
+			graph.vertices[v].state = GDD_UNVISITED;
+		graph.pathlen = 0;
+
+		for (v = 0; v < graph.nvertices && start < 0; v++)
+		{
+			if (graph.vertices[v].removed ||
+				graph.vertices[v].state != GDD_UNVISITED)
+				continue;
+			graph.pathlen = 0;
+			start = gdd_find_cycle(&graph, v);
+		}
+		if (start < 0)
+			break;
+
+		victim = gdd_choose_victim(&graph, start, &cycle);
+		if (victim < 0)
+		{
+			/* Nothing to cancel, just break the cycle */
+			graph.vertices[graph.path[start]].removed = true;
+			continue;
+		}
+		graph.vertices[victim].removed = true;
+		victims[nvictims++] = graph.vertices[victim].key;
+
+		/* Act only if the same victim was found last time */
+		if (strcmp(NameStr(graph.vertices[victim].key.node), PGXCNodeName) != 0)
+			continue;
+		for (i = 0; i < prev_nvictims; i++)
+		{
+			if (prev_victims[i].pid == graph.vertices[victim].key.pid &&
+				strcmp(NameStr(prev_victims[i].node), PGXCNodeName) == 0)
+				break;
+		}
+		if (i < prev_nvictims)
+		{
+			int			pid = graph.vertices[victim].key.pid;
+
+			if (BackendPidGetProc(pid) != NULL)
+			{
+				ereport(LOG,
+						(errmsg("global deadlock detected, canceling statement of process %d",
+								pid),
+						 errdetail("Wait-for cycle of sessions: %s.",
+								   cycle.data)));
+				kill(pid, SIGINT);
+			}
+		}
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+	PopActiveSnapshot();
+	CommitTransactionCommand();
+
+	/* Remember the victims for the next round */
+	if (prev_victims)
+		pfree(prev_victims);
+	prev_victims = NULL;
+	prev_nvictims = nvictims;
+	if (nvictims > 0)
+	{
+		prev_victims = (GlobalSessionKey *)
+			MemoryContextAlloc(TopMemoryContext,
+							   nvictims * sizeof(GlobalSessionKey));
+		memcpy(prev_victims, victims, nvictims * sizeof(GlobalSessionKey));
+	}
+
+	MemoryContextReset(roundcxt);
+}
+
+static void
+gdd_sighup(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_SIGHUP = true;
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
+
+/*
+ * Register the detector, called by the postmaster of a Coordinator
+ */
+void
+GlobalDeadlockDetectorRegister(void)
+{
+	BackgroundWorker bgw;
+
+	memset(&bgw, 0, sizeof(bgw));
+	bgw.bgw_flags = BGWORKER_SHMEM_ACCESS |
+		BGWORKER_BACKEND_DATABASE_CONNECTION;
+	bgw.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	snprintf(bgw.bgw_library_name, BGW_MAXLEN, "postgres");
+	snprintf(bgw.bgw_function_name, BGW_MAXLEN, "GlobalDeadlockDetectorMain");
+	snprintf(bgw.bgw_name, BGW_MAXLEN, "global deadlock detector");
+	bgw.bgw_restart_time = 10;
+	bgw.bgw_notify_pid = 0;
+	bgw.bgw_main_arg = (Datum) 0;
+
+	RegisterBackgroundWorker(&bgw);
+}
+
+/*
+ * Main entry point of the global deadlock detector
+ */
+void
+GlobalDeadlockDetectorMain(Datum main_arg)
+{
+	MemoryContext roundcxt;
+
+	pqsignal(SIGHUP, gdd_sighup);
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	/* Lock waits are seen by the backends connected to any database */
+	BackgroundWorkerInitializeConnection("postgres", NULL);
+
+	/* Keep the connections to the nodes between the rounds */
+	PersistentConnections = true;
+
+	StartTransactionCommand();
+	InitMultinodeExecutor(false);
+	CommitTransactionCommand();
+
+	roundcxt = AllocSetContextCreate(TopMemoryContext,
+									 "Global deadlock detector",
+									 ALLOCSET_DEFAULT_SIZES);
+
+	for (;;)
+	{
+		int			rc;
+
+		rc = WaitLatch(MyLatch,
+					   WL_LATCH_SET | WL_POSTMASTER_DEATH |
+					   (GlobalDeadlockCheckInterval > 0 ? WL_TIMEOUT : 0),
+					   GlobalDeadlockCheckInterval,
+					   WAIT_EVENT_GLOBAL_DEADLOCK_DETECTOR_MAIN);
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+		ResetLatch(MyLatch);
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (got_SIGHUP)
+		{
+			got_SIGHUP = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		if (GlobalDeadlockCheckInterval <= 0)
+		{
+			if (prev_victims)
+				pfree(prev_victims);
+			prev_victims = NULL;
+			prev_nvictims = 0;
+			continue;
+		}
+
+		gdd_check(roundcxt);
+	}
+}
@@ -22,6 +22,7 @@
  * get_handles         - acquire handles to all specified nodes
  * get_current_handles - return already acquired handles
  * release_handles     - release all connection (back to pool)
+ * hold_handles        - keep connections past the end of the transaction
  *
  *
  * node handle management
@@ -73,6 +74,7 @@
  * misc functions
  * --------------
  * pgxc_node_set_query  - send SET by simple protocol, wait for "ready"
+ * pgxc_node_set_query_multi - same for a set of connections at once
  * pgxc_node_flush      - flush all data from the output buffer
  *
  *
@@ -117,6 +119,7 @@
 #include <errno.h>
 
 #include "access/gtm.h"
+#include "access/hash.h"
 #include "access/transam.h"
 #include "access/xact.h"
 #include "access/htup_details.h"
@@ -124,9 +127,13 @@
 #include "catalog/pg_collation.h"
 #include "catalog/pgxc_node.h"
 #include "commands/prepare.h"
+#include "common/sha2.h"
 #include "gtm/gtm_c.h"
+#include "libpq/libpq.h"
 #include "miscadmin.h"
 #include "nodes/nodes.h"
+#include "pgstat.h"
+#include "pgxc/commitbatcher.h"
 #include "pgxc/execRemote.h"
 #include "pgxc/locator.h"
 #include "pgxc/nodemgr.h"
@@ -135,6 +142,7 @@
 #include "pgxc/pgxcnode.h"
 #include "pgxc/poolmgr.h"
 #include "storage/ipc.h"
+#include "storage/latch.h"
 #include "storage/lwlock.h"
 #include "tcop/dest.h"
 #include "utils/builtins.h"
@@ -151,6 +159,13 @@
 
 #define CMD_ID_MSG_LEN 8
 
+/*
+ * The input buffer of a connection which keeps filling it up on every read
+ * is grown up to this size, so that bulk streams take fewer recv() calls.
+ */
+#define MAX_READ_BUFFER_SIZE	(128 * 1024)
+#define QUERY_ID_MSG_LEN 8
+
 /* Number of connections held */
 static int	datanode_count = 0;
 static int	coord_count = 0;
@@ -172,6 +187,14 @@ int 		NumCoords;
 
 volatile bool HandlesInvalidatePending = false;
 volatile bool HandlesRefreshPending = false;
+volatile bool HandlesReleasePending = false;
+
+/* Connections kept past the end of the transaction, see hold_handles */
+static bool handles_held = false;
+
+/* Protocol bytes sent to and received from other nodes by this backend */
+uint64		PGXCNodeBytesSent = 0;
+uint64		PGXCNodeBytesReceived = 0;
 
 /*
  * Session/transaction parameters that need to to be set on new connections.
@@ -181,6 +204,28 @@ static List	*local_param_list = NIL;
 static StringInfo	session_params;
 static StringInfo	local_params;
 
+/*
+ * Version of the session parameters, incremented whenever they change. The
+ * pooler tags connections with it, so that we know whether a connection we
+ * get from the pool still has our session parameters set.
+ */
+static int	session_params_version = 1;
+
+/*
+ * Hash of the SET commands for the session parameters, not including the
+ * ones identifying the session (global_session, parentPGXCPid). Sessions
+ * with the same parameters have the same fingerprint, and the pooler hands
+ * connections set up by one of them to another, which then only needs to
+ * set its identity. Valid while session_params is built.
+ */
+static uint32 session_params_fingerprint = 0;
+
+/* Reset a pooled connection that was set up for some other session */
+#define REMOTE_SESSION_RESET	"RESET ALL;" \
+								"RESET SESSION AUTHORIZATION;" \
+								"RESET transaction_isolation;" \
+								"RESET global_session;"
+
 typedef struct
 {
 	NameData name;
@@ -193,16 +238,28 @@ static bool DoInvalidateRemoteHandles(void);
 static bool DoRefreshRemoteHandles(void);
 
 static void pgxc_node_init(PGXCNodeHandle *handle, int sock,
-		bool global_session, int pid);
+		bool global_session, int pid, int session_state);
+static void pgxc_node_send_setup(PGXCNodeHandle *handle, const char *query);
+static uint32 PGXCNodeGetSessionFingerprint(void);
+static char *PGXCNodeGetSessionIdentStr(void);
+static void pgxc_node_alloc_buffers(PGXCNodeHandle *handle);
 static void pgxc_node_free(PGXCNodeHandle *handle);
 static void pgxc_node_all_free(void);
+static void pgxc_node_reset_wait_set(void);
 
 static int	get_int(PGXCNodeHandle * conn, size_t len, int *out);
 static int	get_char(PGXCNodeHandle * conn, char *out);
+static void expand_datarow_batch(PGXCNodeHandle *conn, int len);
+static int	pgxc_node_recv(PGXCNodeHandle *conn);
+static int	send_buffer(PGXCNodeHandle *handle, char *ptr, int len);
 
 
 /*
  * Initialize empty PGXCNodeHandle struct
+ *
+ * The buffers are not allocated here, but by pgxc_node_alloc_buffers when
+ * the handle gets its first connection. Most sessions only ever talk to a
+ * few of the nodes, and should not pay for buffers of all of them.
  */
 static void
 init_pgxc_handle(PGXCNodeHandle *pgxc_handle)
@@ -213,26 +270,53 @@ init_pgxc_handle(PGXCNodeHandle *pgxc_handle)
 	 */
 	pgxc_handle->sock = NO_SOCKET;
 
-	/* Initialise buffers */
 	pgxc_handle->error = NULL;
-	pgxc_handle->outSize = 16 * 1024;
-	pgxc_handle->outBuffer = (char *) palloc(pgxc_handle->outSize);
-	pgxc_handle->inSize = 16 * 1024;
-
-	pgxc_handle->inBuffer = (char *) palloc(pgxc_handle->inSize);
+	pgxc_handle->outSize = 0;
+	pgxc_handle->outBuffer = NULL;
+	pgxc_handle->inSize = 0;
+	pgxc_handle->inBuffer = NULL;
 	pgxc_handle->combiner = NULL;
 	pgxc_handle->inStart = 0;
 	pgxc_handle->inEnd = 0;
 	pgxc_handle->inCursor = 0;
 	pgxc_handle->outEnd = 0;
 	pgxc_handle->needSync = false;
+	pgxc_handle->pendingSyncs = 0;
+	pgxc_handle->pendingSetup = 0;
+
+	/* Pooler makes all connections compressed or none */
+	pgxc_handle->compressed = NetworkCompression;
+	pgxc_handle->zInEnd = 0;
+	pgxc_handle->zInBuffer = NULL;
+	pgxc_handle->zOutBuffer = NULL;
+}
+
+/*
+ * Allocate the buffers of a handle about to be connected, unless it already
+ * has them from an earlier connection. They live as long as the handle.
+ */
+static void
+pgxc_node_alloc_buffers(PGXCNodeHandle *handle)
+{
+	MemoryContext	oldcontext;
+
+	if (handle->outBuffer != NULL)
+		return;
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+
+	handle->outSize = 16 * 1024;
+	handle->outBuffer = (char *) palloc(handle->outSize);
+	handle->inSize = 16 * 1024;
+	handle->inBuffer = (char *) palloc(handle->inSize);
 
-	if (pgxc_handle->outBuffer == NULL || pgxc_handle->inBuffer == NULL)
+	if (handle->compressed)
 	{
-		ereport(ERROR,
-				(errcode(ERRCODE_OUT_OF_MEMORY),
-				 errmsg("out of memory")));
+		handle->zInBuffer = (char *) palloc(2 * PQ_FRAME_MAXSZ);
+		handle->zOutBuffer = (char *) palloc(PQ_FRAME_MAXSZ);
 	}
+
+	MemoryContextSwitchTo(oldcontext);
 }
 
 
@@ -241,7 +325,10 @@ init_pgxc_handle(PGXCNodeHandle *pgxc_handle)
  *	  Initialize datanode and coordinator handles.
  *
  * Acquires list of nodes from the node manager, and initializes handle
- * for each one.
+ * for each one. The node definitions are read from the shared memory
+ * node table, which is loaded from pgxc_node only by the first session
+ * and on forced reinitialization (pgxc_pool_reload); the handles get
+ * their buffers when first connected.
  *
  * Also determines PGXCNodeId to index in the proper array of handles
  * (co_handles or dn_handles), depending on the type of this node.
@@ -250,7 +337,7 @@ void
 InitMultinodeExecutor(bool is_force)
 {
 	int				count;
-	Oid				*coOids, *dnOids;
+	NodeDefinition	*coNodes, *dnNodes;
 	MemoryContext	oldcontext;
 
 	/* Free all the existing information first */
@@ -262,11 +349,18 @@ InitMultinodeExecutor(bool is_force)
 		co_handles != NULL)
 		return;
 
-	/* Update node table in the shared memory */
-	PgxcNodeListAndCount();
+	/*
+	 * Update node table in the shared memory. Only forced reinitialization
+	 * reads the catalog again, new sessions use what is there already.
+	 */
+	if (is_force)
+		PgxcNodeListAndCount();
+	else
+		PgxcNodeEnsureLoaded();
 
-	/* Get classified list of node Oids */
-	PgxcNodeGetOids(&coOids, &dnOids, &NumCoords, &NumDataNodes, true);
+	/* Get classified list of node definitions */
+	PgxcNodeGetDefinitions(&coNodes, &dnNodes, &NumCoords, &NumDataNodes,
+						   true);
 
 	/*
 	 * Coordinator and datanode handles should be available during all the
@@ -292,24 +386,24 @@ InitMultinodeExecutor(bool is_force)
 	for (count = 0; count < NumDataNodes; count++)
 	{
 		init_pgxc_handle(&dn_handles[count]);
-		dn_handles[count].nodeoid = dnOids[count];
-		dn_handles[count].nodeid = get_pgxc_node_id(dnOids[count]);
-		strncpy(dn_handles[count].nodename, get_pgxc_nodename(dnOids[count]),
+		dn_handles[count].nodeoid = dnNodes[count].nodeoid;
+		dn_handles[count].nodeid = dnNodes[count].nodeid;
+		strncpy(dn_handles[count].nodename, NameStr(dnNodes[count].nodename),
 				NAMEDATALEN);
-		strncpy(dn_handles[count].nodehost, get_pgxc_nodehost(dnOids[count]),
+		strncpy(dn_handles[count].nodehost, NameStr(dnNodes[count].nodehost),
 				NAMEDATALEN);
-		dn_handles[count].nodeport = get_pgxc_nodeport(dnOids[count]);
+		dn_handles[count].nodeport = dnNodes[count].nodeport;
 	}
 	for (count = 0; count < NumCoords; count++)
 	{
 		init_pgxc_handle(&co_handles[count]);
-		co_handles[count].nodeoid = coOids[count];
-		co_handles[count].nodeid = get_pgxc_node_id(coOids[count]);
-		strncpy(co_handles[count].nodename, get_pgxc_nodename(coOids[count]),
+		co_handles[count].nodeoid = coNodes[count].nodeoid;
+		co_handles[count].nodeid = coNodes[count].nodeid;
+		strncpy(co_handles[count].nodename, NameStr(coNodes[count].nodename),
 				NAMEDATALEN);
-		strncpy(co_handles[count].nodehost, get_pgxc_nodehost(coOids[count]),
+		strncpy(co_handles[count].nodehost, NameStr(coNodes[count].nodehost),
 				NAMEDATALEN);
-		co_handles[count].nodeport = get_pgxc_nodeport(coOids[count]);
+		co_handles[count].nodeport = coNodes[count].nodeport;
 	}
 
 	datanode_count = 0;
@@ -318,6 +412,9 @@ InitMultinodeExecutor(bool is_force)
 
 	MemoryContextSwitchTo(oldcontext);
 
+	pfree(coNodes);
+	pfree(dnNodes);
+
 	/*
 	 * Determine index of a handle representing this node, either in the
 	 * coordinator or datanode handles, depending on the type of this
@@ -331,8 +428,7 @@ InitMultinodeExecutor(bool is_force)
 	{
 		for (count = 0; count < NumCoords; count++)
 		{
-			if (pg_strcasecmp(PGXCNodeName,
-					   get_pgxc_nodename(co_handles[count].nodeoid)) == 0)
+			if (pg_strcasecmp(PGXCNodeName, co_handles[count].nodename) == 0)
 				PGXCNodeId = count + 1;
 		}
 	}
@@ -340,8 +436,7 @@ InitMultinodeExecutor(bool is_force)
 	{
 		for (count = 0; count < NumDataNodes; count++)
 		{
-			if (pg_strcasecmp(PGXCNodeName,
-					   get_pgxc_nodename(dn_handles[count].nodeoid)) == 0)
+			if (pg_strcasecmp(PGXCNodeName, dn_handles[count].nodename) == 0)
 				PGXCNodeId = count + 1;
 		}
 	}
@@ -359,7 +454,10 @@ static void
 pgxc_node_free(PGXCNodeHandle *handle)
 {
 	if (handle->sock != NO_SOCKET)
+	{
+		pgxc_node_reset_wait_set();
 		close(handle->sock);
+	}
 	handle->sock = NO_SOCKET;
 }
 
@@ -404,6 +502,8 @@ pgxc_node_all_free(void)
 	dn_handles = NULL;
 	HandlesInvalidatePending = false;
 	HandlesRefreshPending = false;
+	HandlesReleasePending = false;
+	handles_held = false;
 }
 
 /*
@@ -414,10 +514,13 @@ pgxc_node_all_free(void)
  * session string to the remote node.
  */
 static void
-pgxc_node_init(PGXCNodeHandle *handle, int sock, bool global_session, int pid)
+pgxc_node_init(PGXCNodeHandle *handle, int sock, bool global_session, int pid,
+			   int session_state)
 {
 	char *init_str;
 
+	pgxc_node_alloc_buffers(handle);
+
 	handle->sock = sock;
 	handle->backend_pid = pid;
 	handle->transaction_status = 'I';
@@ -433,23 +536,177 @@ pgxc_node_init(PGXCNodeHandle *handle, int sock, bool global_session, int pid)
 	handle->inStart = 0;
 	handle->inEnd = 0;
 	handle->inCursor = 0;
+	handle->zInEnd = 0;
 	handle->needSync = false;
+	handle->pendingSyncs = 0;
+	handle->pendingSetup = 0;
 
 	/*
 	 * We got a new connection, set on the remote node the session parameters
 	 * if defined. The transaction parameter should be sent after BEGIN.
+	 *
+	 * Pooled connections keep the session state of the last session that
+	 * used them, so there is nothing to do if that was us and we did not
+	 * change the parameters since. If it was some other session with the
+	 * same parameters we only need to set our identity, otherwise reset the
+	 * connection first (in the same message).
+	 *
+	 * The commands are not sent right away, they go down along with the
+	 * first command sent to the connection, and the responses are skipped
+	 * by get_message(), so the setup does not cost a round trip.
 	 */
 	if (global_session)
 	{
+		if (session_state == POOL_SESSION_CURRENT)
+			return;
+
 		init_str = PGXCNodeGetSessionParamStr();
-		if (init_str)
+		if (session_state == POOL_SESSION_MATCHING)
+		{
+			char   *ident_str = PGXCNodeGetSessionIdentStr();
+
+			pgxc_node_send_setup(handle, ident_str);
+			pfree(ident_str);
+		}
+		else if (session_state == POOL_SESSION_DIRTY)
+		{
+			char   *reset_str;
+
+			reset_str = psprintf("%s%s", REMOTE_SESSION_RESET,
+								 init_str ? init_str : "");
+			pgxc_node_send_setup(handle, reset_str);
+			pfree(reset_str);
+		}
+		else if (init_str)
 		{
-			pgxc_node_set_query(handle, init_str);
+			pgxc_node_send_setup(handle, init_str);
 		}
 	}
+	else if (session_state == POOL_SESSION_DIRTY)
+		pgxc_node_send_setup(handle, REMOTE_SESSION_RESET);
+}
+
+
+/*
+ * pgxc_node_send_setup
+ *	  Queue the session setup query in the output buffer of a new connection.
+ *
+ * The query is sent along with the first command sent to the connection.
+ * get_message() skips the responses up to and including the ReadyForQuery.
+ */
+static void
+pgxc_node_send_setup(PGXCNodeHandle *handle, const char *query)
+{
+	int			strLen = strlen(query) + 1;
+	int			msgLen = 4 + strLen;
+
+	if (ensure_out_buffer_capacity(handle->outEnd + 1 + msgLen, handle) != 0)
+	{
+		add_error_message(handle, "out of memory");
+		PGXCNodeSetConnectionState(handle, DN_CONNECTION_STATE_ERROR_FATAL);
+		return;
+	}
+
+	handle->outBuffer[handle->outEnd++] = 'Q';
+	msgLen = htonl(msgLen);
+	memcpy(handle->outBuffer + handle->outEnd, &msgLen, 4);
+	handle->outEnd += 4;
+	memcpy(handle->outBuffer + handle->outEnd, query, strLen);
+	handle->outEnd += strLen;
+
+	handle->pendingSetup++;
 }
 
 
+/*
+ * Wait event set used by pgxc_node_receive(). It is kept across the calls as
+ * long as the same sockets are waited on, so waiting on many connections does
+ * not cost setting up the whole set every time. The process latch is at
+ * position 0, the sockets follow in the order of recv_wait_socks.
+ */
+static WaitEventSet *recv_wait_set = NULL;
+static pgsocket *recv_wait_socks = NULL;
+static int	recv_wait_nsocks = 0;
+
+/*
+ * pgxc_node_reset_wait_set
+ *	  Forget the wait event set, because one of its sockets is closed or
+ *	  about to be closed. The descriptor may be reused for a new connection,
+ *	  which would not be registered in the set.
+ */
+static void
+pgxc_node_reset_wait_set(void)
+{
+	if (recv_wait_set)
+		FreeWaitEventSet(recv_wait_set);
+	recv_wait_set = NULL;
+	recv_wait_nsocks = 0;
+}
+
+/*
+ * pgxc_node_get_wait_set
+ *	  Get the wait event set for the specified sockets, rebuilding it if it
+ *	  was set up for some other sockets.
+ */
+static WaitEventSet *
+pgxc_node_get_wait_set(pgsocket *socks, int nsocks)
+{
+	int			i;
+
+	if (recv_wait_set && recv_wait_nsocks == nsocks &&
+		memcmp(recv_wait_socks, socks, nsocks * sizeof(pgsocket)) == 0)
+		return recv_wait_set;
+
+	pgxc_node_reset_wait_set();
+
+	if (recv_wait_socks)
+		pfree(recv_wait_socks);
+	recv_wait_socks = (pgsocket *) MemoryContextAlloc(TopMemoryContext,
+												nsocks * sizeof(pgsocket));
+	memcpy(recv_wait_socks, socks, nsocks * sizeof(pgsocket));
+
+	recv_wait_set = CreateWaitEventSet(TopMemoryContext, nsocks + 1);
+	AddWaitEventToSet(recv_wait_set, WL_LATCH_SET, PGINVALID_SOCKET,
+					  MyLatch, NULL);
+	for (i = 0; i < nsocks; i++)
+		AddWaitEventToSet(recv_wait_set, WL_SOCKET_READABLE, socks[i],
+						  NULL, NULL);
+	recv_wait_nsocks = nsocks;
+
+	return recv_wait_set;
+}
+
+/*
+ * pgxc_node_wait_event
+ *	  Wait event to report while waiting on the given connections: tell
+ * waits on Datanodes from waits on Coordinators, unless both are involved.
+ */
+static uint32
+pgxc_node_wait_event(PGXCNodeHandle **connections, int *conn_idx, int nconns)
+{
+	bool		datanodes = false;
+	bool		coordinators = false;
+	int			i;
+
+	for (i = 0; i < nconns; i++)
+	{
+		PGXCNodeHandle *conn = connections[conn_idx[i]];
+
+		if (dn_handles && conn >= dn_handles && conn < dn_handles + NumDataNodes)
+			datanodes = true;
+		else if (co_handles && conn >= co_handles && conn < co_handles + NumCoords)
+			coordinators = true;
+		else
+			return WAIT_EVENT_REMOTE_NODE_READ;
+	}
+
+	if (datanodes && !coordinators)
+		return WAIT_EVENT_REMOTE_DATANODE_READ;
+	if (coordinators && !datanodes)
+		return WAIT_EVENT_REMOTE_COORDINATOR_READ;
+	return WAIT_EVENT_REMOTE_NODE_READ;
+}
+
 /*
  * pgxc_node_receive
  *	  Wait while at least one of the connections has data available, and
@@ -463,10 +720,14 @@ pgxc_node_receive(const int conn_count,
 #define NO_ERROR_OCCURED	false
 	int		i,
 			sockets_to_poll,
-			poll_val;
+			nevents;
 	bool	is_msg_buffered;
 	long 	timeout_ms;
-	struct	pollfd pool_fd[conn_count];
+	uint32	wait_event;
+	pgsocket socks[conn_count];
+	int		conn_idx[conn_count];
+	WaitEvent events[conn_count + 1];
+	WaitEventSet *set;
 
 	/* sockets to be polled index */
 	sockets_to_poll = 0;
@@ -486,17 +747,13 @@ pgxc_node_receive(const int conn_count,
 	{
 		/* If connection finished sending do not wait input from it */
 		if (connections[i]->state == DN_CONNECTION_STATE_IDLE || HAS_MESSAGE_BUFFERED(connections[i]))
-		{
-			pool_fd[i].fd = -1;
-			pool_fd[i].events = 0;
 			continue;
-		}
 
-		/* prepare select params */
+		/* prepare wait params */
 		if (connections[i]->sock > 0)
 		{
-			pool_fd[i].fd = connections[i]->sock;
-			pool_fd[i].events = POLLIN | POLLPRI | POLLRDNORM | POLLRDBAND;
+			socks[sockets_to_poll] = connections[i]->sock;
+			conn_idx[sockets_to_poll] = i;
 			sockets_to_poll++;
 		}
 		else
@@ -504,8 +761,6 @@ pgxc_node_receive(const int conn_count,
 			/* flag as bad, it will be removed from the list */
 			PGXCNodeSetConnectionState(connections[i],
 					DN_CONNECTION_STATE_ERROR_FATAL);
-			pool_fd[i].fd = -1;
-			pool_fd[i].events = 0;
 		}
 	}
 
@@ -525,22 +780,15 @@ pgxc_node_receive(const int conn_count,
 	else
 		timeout_ms = (timeout->tv_sec * (uint64_t) 1000) + (timeout->tv_usec / 1000);
 
+	set = pgxc_node_get_wait_set(socks, sockets_to_poll);
+	wait_event = pgxc_node_wait_event(connections, conn_idx, sockets_to_poll);
+
 retry:
 	CHECK_FOR_INTERRUPTS();
-	poll_val  = poll(pool_fd, conn_count, timeout_ms);
-	if (poll_val < 0)
-	{
-		/* error - retry if EINTR */
-		if (errno == EINTR  || errno == EAGAIN)
-			goto retry;
+	nevents = WaitEventSetWait(set, timeout_ms, events, sockets_to_poll + 1,
+							   wait_event);
 
-		elog(WARNING, "poll() error: %d", errno);
-		if (errno)
-			return ERROR_OCCURED;
-		return NO_ERROR_OCCURED;
-	}
-
-	if (poll_val == 0)
+	if (nevents == 0)
 	{
 		/* Handle timeout */
 		elog(DEBUG1, "timeout %ld while waiting for any response from %d connections", timeout_ms,conn_count);
@@ -550,57 +798,55 @@ retry:
 		return NO_ERROR_OCCURED;
 	}
 
+	/* Woken up by the latch only, check for interrupts and wait again */
+	if (nevents == 1 && events[0].events & WL_LATCH_SET)
+	{
+		ResetLatch(MyLatch);
+		goto retry;
+	}
+
 	/* read data */
-	for (i = 0; i < conn_count; i++)
+	for (i = 0; i < nevents; i++)
 	{
-		PGXCNodeHandle *conn = connections[i];
+		PGXCNodeHandle *conn;
+		int			read_status;
 
-		if( pool_fd[i].fd == -1 )
+		if (events[i].events & WL_LATCH_SET)
+		{
+			ResetLatch(MyLatch);
 			continue;
+		}
 
-		if ( pool_fd[i].fd == conn->sock )
-		{
-			if( pool_fd[i].revents & POLLIN )
-			{
-				int	read_status = pgxc_node_read_data(conn, true);
-				if ( read_status == EOF || read_status < 0 )
-				{
-					/* Can not read - no more actions, just discard connection */
-					PGXCNodeSetConnectionState(conn,
-							DN_CONNECTION_STATE_ERROR_FATAL);
-					add_error_message(conn, "unexpected EOF on datanode connection.");
-					elog(WARNING, "unexpected EOF on datanode oid connection: %d", conn->nodeoid);
+		Assert(events[i].pos > 0 && events[i].pos <= sockets_to_poll);
+		conn = connections[conn_idx[events[i].pos - 1]];
 
-					/*
-					 * before returning, also update the shared health
-					 * status field to indicate that this node could be
-					 * possibly unavailable.
-					 *
-					 * Note that this error could be due to a stale handle
-					 * and it's possible that another backend might have
-					 * already updated the health status OR the node
-					 * might have already come back since the last disruption
-					 */
-					PoolPingNodeRecheck(conn->nodeoid);
+		/*
+		 * Errors and hangups are reported as readable, and reading fails
+		 * then.
+		 */
+		read_status = pgxc_node_read_data(conn, true);
+		if ( read_status == EOF || read_status < 0 )
+		{
+			/* Can not read - no more actions, just discard connection */
+			PGXCNodeSetConnectionState(conn,
+					DN_CONNECTION_STATE_ERROR_FATAL);
+			add_error_message(conn, "unexpected EOF on datanode connection.");
+			elog(WARNING, "unexpected EOF on datanode oid connection: %d", conn->nodeoid);
 
-					/* Should we read from the other connections before returning? */
-					return ERROR_OCCURED;
-				}
+			/*
+			 * before returning, also update the shared health
+			 * status field to indicate that this node could be
+			 * possibly unavailable.
+			 *
+			 * Note that this error could be due to a stale handle
+			 * and it's possible that another backend might have
+			 * already updated the health status OR the node
+			 * might have already come back since the last disruption
+			 */
+			PoolPingNodeRecheck(conn->nodeoid);
 
-			}
-			else if (
-					(pool_fd[i].revents & POLLERR) ||
-					(pool_fd[i].revents & POLLHUP) ||
-					(pool_fd[i].revents & POLLNVAL)
-					)
-			{
-				PGXCNodeSetConnectionState(connections[i],
-						DN_CONNECTION_STATE_ERROR_FATAL);
-				add_error_message(conn, "unexpected network error on datanode connection");
-				elog(WARNING, "unexpected EOF on datanode oid connection: %d with event %d", conn->nodeoid,pool_fd[i].revents);
-				/* Should we check/read from the other connections before returning? */
-				return ERROR_OCCURED;
-			}
+			/* Should we read from the other connections before returning? */
+			return ERROR_OCCURED;
 		}
 	}
 	return NO_ERROR_OCCURED;
@@ -616,6 +862,7 @@ pgxc_node_read_data(PGXCNodeHandle *conn, bool close_if_error)
 {
 	int			someread = 0;
 	int			nread;
+	int			nwanted;
 
 	if (conn->sock < 0)
 	{
@@ -667,8 +914,8 @@ pgxc_node_read_data(PGXCNodeHandle *conn, bool close_if_error)
 	}
 
 retry:
-	nread = recv(conn->sock, conn->inBuffer + conn->inEnd,
-				 conn->inSize - conn->inEnd, 0);
+	nwanted = conn->inSize - conn->inEnd;
+	nread = pgxc_node_recv(conn);
 
 	if (nread < 0)
 	{
@@ -700,6 +947,7 @@ retry:
 				PGXCNodeSetConnectionState(conn,
 						DN_CONNECTION_STATE_ERROR_FATAL);	/* No more connection to
 															* backend */
+				pgxc_node_reset_wait_set();
 				closesocket(conn->sock);
 				conn->sock = NO_SOCKET;
 			}
@@ -715,6 +963,17 @@ retry:
 	if (nread > 0)
 	{
 		conn->inEnd += nread;
+		PGXCNodeBytesReceived += nread;
+
+		/*
+		 * The kernel had at least as much data as we had room for, so the
+		 * node is probably streaming faster than we read it a buffer-load
+		 * at a time.  Let the following reads take more per call.
+		 */
+		if (!conn->compressed && nread == nwanted &&
+			conn->inSize < MAX_READ_BUFFER_SIZE)
+			(void) ensure_in_buffer_capacity(Min(conn->inSize * 2,
+												 MAX_READ_BUFFER_SIZE), conn);
 
 		/*
 		 * Hack to deal with the fact that some kernels will only give us back
@@ -751,6 +1010,69 @@ retry:
 }
 
 
+/*
+ * pgxc_node_recv
+ *	  Receive data from the node into the input buffer of the connection.
+ *
+ * Works like recv(). On compressed connection data is read into zInBuffer
+ * first, and all complete frames are decompressed into the input buffer,
+ * enlarging it if needed, so no received data is left behind out of sight of
+ * poll(). If there is no complete frame yet, fails with EAGAIN.
+ */
+static int
+pgxc_node_recv(PGXCNodeHandle *conn)
+{
+	int			nread;
+	int			ndecoded = 0;
+	size_t		pos = 0;
+
+	if (!conn->compressed)
+		return recv(conn->sock, conn->inBuffer + conn->inEnd,
+					conn->inSize - conn->inEnd, 0);
+
+	nread = recv(conn->sock, conn->zInBuffer + conn->zInEnd,
+				 2 * PQ_FRAME_MAXSZ - conn->zInEnd, 0);
+	if (nread <= 0)
+		return nread;
+	conn->zInEnd += nread;
+
+	for (;;)
+	{
+		int			framelen;
+		int			rawlen;
+
+		framelen = pq_frame_length(conn->zInBuffer + pos,
+								   conn->zInEnd - pos, &rawlen);
+		if (framelen == 0)
+			break;
+		if (framelen < 0 ||
+			ensure_in_buffer_capacity(conn->inEnd + ndecoded + rawlen, conn) != 0 ||
+			pq_decompress_frame(conn->zInBuffer + pos,
+								conn->inBuffer + conn->inEnd + ndecoded) < 0)
+		{
+			conn->zInEnd = 0;
+			errno = EIO;
+			return -1;
+		}
+		ndecoded += rawlen;
+		pos += framelen;
+	}
+
+	/* Keep the incomplete frame */
+	if (pos > 0)
+	{
+		conn->zInEnd -= pos;
+		memmove(conn->zInBuffer, conn->zInBuffer + pos, conn->zInEnd);
+	}
+
+	if (ndecoded == 0)
+	{
+		errno = EAGAIN;
+		return -1;
+	}
+	return ndecoded;
+}
+
 /*
  * Get one character from the connection buffer and advance cursor.
  *
@@ -875,6 +1197,51 @@ get_message(PGXCNodeHandle *conn, int *len, char **msg)
 		return '\0';
 	}
 
+	/*
+	 * DataRow batch, replace it in the buffer with the DataRow messages it is
+	 * made of and start over.
+	 */
+	if (msgtype == 'B')
+	{
+		expand_datarow_batch(conn, *len);
+		return get_message(conn, len, msg);
+	}
+
+	/*
+	 * Responses to the session setup query sent down ahead of the first
+	 * command (see pgxc_node_send_setup), skip them. The connection can not
+	 * be used if the setup failed.
+	 */
+	if (conn->pendingSetup > 0)
+	{
+		if (msgtype == 'E')
+		{
+			add_error_message(conn, "failed to set up session on remote node");
+			PGXCNodeSetConnectionState(conn, DN_CONNECTION_STATE_ERROR_FATAL);
+		}
+		else if (msgtype == 'Z')
+		{
+			conn->transaction_status = conn->inBuffer[conn->inCursor];
+			conn->pendingSetup--;
+		}
+		conn->inCursor += *len;
+		conn->inStart = conn->inCursor;
+		return get_message(conn, len, msg);
+	}
+
+	/*
+	 * ReadyForQuery responding to a Sync nobody waited for, just remember
+	 * the transaction status and proceed to the next message.
+	 */
+	if (msgtype == 'Z' && conn->pendingSyncs > 0)
+	{
+		conn->transaction_status = conn->inBuffer[conn->inCursor];
+		conn->inCursor += *len;
+		conn->inStart = conn->inCursor;
+		conn->pendingSyncs--;
+		return get_message(conn, len, msg);
+	}
+
 	/* Great, the whole message in the buffer. */
 	*msg = conn->inBuffer + conn->inCursor;
 	conn->inCursor += *len;
@@ -883,6 +1250,155 @@ get_message(PGXCNodeHandle *conn, int *len, char **msg)
 }
 
 
+/*
+ * expand_datarow_batch
+ *	  Convert the DataRow batch message at the read position of the input
+ *	  buffer to the sequence of DataRow messages it is made of.
+ *
+ * The batch message (see printtup_flush_batch) stores the rows column by
+ * column. The DataRow messages are built in a separate buffer and then
+ * replace the batch message in the input buffer, so subsequent get_message()
+ * calls return them one by one as if the remote node sent them like that.
+ *
+ * On entry the cursor points to the batch message body of the length len,
+ * on exit it points to the beginning of the first DataRow message.
+ */
+static void
+expand_datarow_batch(PGXCNodeHandle *conn, int len)
+{
+	char	   *batch = conn->inBuffer + conn->inCursor;
+	char	   *ptr;
+	char	   *end = batch + len;
+	uint16		n16;
+	uint32		n32;
+	int			natts;
+	int			nrows;
+	int			nullslen;
+	int		   *rowlens;
+	int		   *cursors;
+	char	   *rows;
+	size_t		total;
+	size_t		tail;
+	int			i;
+	int			r;
+
+	if (len < 6)
+		goto corrupted;
+	memcpy(&n16, batch, 2);
+	natts = ntohs(n16);
+	memcpy(&n32, batch + 2, 4);
+	nrows = (int) ntohl(n32);
+	if (nrows <= 0)
+		goto corrupted;
+	nullslen = (nrows + 7) / 8;
+
+	/*
+	 * First pass: validate the message and determine the size of each row.
+	 * A DataRow message takes message type, length and attribute count,
+	 * each attribute is length followed by the value, if not NULL.
+	 */
+	rowlens = (int *) palloc(nrows * sizeof(int));
+	for (r = 0; r < nrows; r++)
+		rowlens[r] = 1 + 4 + 2;
+	ptr = batch + 6;
+	for (i = 0; i < natts; i++)
+	{
+		bits8	   *nulls = (bits8 *) ptr;
+
+		if (end - ptr < nullslen)
+			goto corrupted;
+		ptr += nullslen;
+		for (r = 0; r < nrows; r++)
+		{
+			int32		vlen;
+
+			rowlens[r] += 4;
+			if (nulls[r >> 3] & (1 << (r & 7)))
+				continue;
+			if (end - ptr < 4)
+				goto corrupted;
+			memcpy(&n32, ptr, 4);
+			vlen = (int32) ntohl(n32);
+			if (vlen < 0 || end - ptr - 4 < vlen)
+				goto corrupted;
+			rowlens[r] += vlen;
+			ptr += 4 + vlen;
+		}
+	}
+
+	/*
+	 * Second pass: write out the message headers, then walk the columns
+	 * again, appending values to the rows they belong to.
+	 */
+	total = 0;
+	cursors = (int *) palloc(nrows * sizeof(int));
+	for (r = 0; r < nrows; r++)
+	{
+		cursors[r] = total;
+		total += rowlens[r];
+	}
+	rows = (char *) palloc(total);
+	for (r = 0; r < nrows; r++)
+	{
+		char	   *row = rows + cursors[r];
+
+		row[0] = 'D';
+		n32 = htonl((uint32) (rowlens[r] - 1));
+		memcpy(row + 1, &n32, 4);
+		n16 = htons((uint16) natts);
+		memcpy(row + 5, &n16, 2);
+		cursors[r] += 7;
+	}
+	ptr = batch + 6;
+	for (i = 0; i < natts; i++)
+	{
+		bits8	   *nulls = (bits8 *) ptr;
+
+		ptr += nullslen;
+		for (r = 0; r < nrows; r++)
+		{
+			int32		vlen;
+
+			if (nulls[r >> 3] & (1 << (r & 7)))
+			{
+				n32 = htonl((uint32) -1);
+				memcpy(rows + cursors[r], &n32, 4);
+				cursors[r] += 4;
+				continue;
+			}
+			memcpy(&n32, ptr, 4);
+			vlen = (int32) ntohl(n32);
+			memcpy(rows + cursors[r], ptr, 4 + vlen);
+			cursors[r] += 4 + vlen;
+			ptr += 4 + vlen;
+		}
+	}
+
+	/* Replace the batch message, keep whatever is received after it */
+	tail = conn->inEnd - (conn->inCursor + len);
+	if (ensure_in_buffer_capacity(conn->inStart + total + tail, conn) != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+	memmove(conn->inBuffer + conn->inStart + total,
+			conn->inBuffer + conn->inCursor + len, tail);
+	memcpy(conn->inBuffer + conn->inStart, rows, total);
+	conn->inEnd = conn->inStart + total + tail;
+	conn->inCursor = conn->inStart;
+
+	pfree(rows);
+	pfree(cursors);
+	pfree(rowlens);
+	return;
+
+corrupted:
+	ereport(ERROR,
+			(errcode(ERRCODE_PROTOCOL_VIOLATION),
+			 errmsg("invalid DataRow batch message from node %s",
+					conn->nodename)));
+}
+
+
 /*
  * release_handles
  *	  Release all node connections back to pool and free the memory.
@@ -918,6 +1434,8 @@ release_handles(void)
 
 		if (handle->sock != NO_SOCKET)
 		{
+			pgxc_node_wait_syncs(handle);
+
 			/*
 			 * Connections at this point should be completely inactive,
 			 * otherwise abaandon them. We can not allow not cleaned up
@@ -948,6 +1466,8 @@ release_handles(void)
 
 			if (handle->sock != NO_SOCKET)
 			{
+				pgxc_node_wait_syncs(handle);
+
 				/*
 				 * Connections at this point should be completely inactive,
 				 * otherwise abaandon them. We can not allow not cleaned up
@@ -973,6 +1493,82 @@ release_handles(void)
 
 	datanode_count = 0;
 	coord_count = 0;
+	handles_held = false;
+	HandlesReleasePending = false;
+}
+
+/*
+ * hold_handles
+ *	  Keep the node connections of the session at the end of a transaction.
+ *
+ * OLTP sessions tend to run transaction after transaction on the same nodes,
+ * and giving the connections back to the pool at each commit only to ask for
+ * them again at the next statement costs two round trips to the pooler.
+ * With session_connection_hold_time set, a Coordinator session keeps them
+ * instead, and releases them once it has been idle for that long, or when
+ * the pooler runs short of connections to one of the nodes and asks for
+ * them (see HandlesReleasePending).
+ *
+ * Returns false if the caller should release the connections now.
+ */
+bool
+hold_handles(void)
+{
+	int			i;
+
+	if (SessionConnectionHoldTime <= 0 || !IS_PGXC_COORDINATOR)
+		return false;
+
+	if (HandlesInvalidatePending || HandlesReleasePending)
+		return false;
+
+	if (datanode_count == 0 && coord_count == 0)
+		return false;
+
+	/* Connections not cleaned up are dropped by release_handles */
+	for (i = 0; i < NumDataNodes; i++)
+	{
+		PGXCNodeHandle *handle = &dn_handles[i];
+
+		if (handle->sock != NO_SOCKET &&
+			(handle->state != DN_CONNECTION_STATE_IDLE ||
+			 handle->transaction_status != 'I' ||
+			 handle->outEnd > 0 || handle->ck_resp_rollback))
+			return false;
+	}
+	for (i = 0; i < NumCoords; i++)
+	{
+		PGXCNodeHandle *handle = &co_handles[i];
+
+		if (handle->sock != NO_SOCKET &&
+			(handle->state != DN_CONNECTION_STATE_IDLE ||
+			 handle->transaction_status != 'I' ||
+			 handle->outEnd > 0 || handle->ck_resp_rollback))
+			return false;
+	}
+
+	handles_held = true;
+	return true;
+}
+
+/*
+ * Are we keeping node connections between transactions?
+ */
+bool
+HandlesHeld(void)
+{
+	return handles_held && (datanode_count > 0 || coord_count > 0);
+}
+
+/*
+ * Timeout handler releasing the connections held by an idle session.
+ */
+void
+HeldHandlesTimeoutHandler(void)
+{
+	HandlesReleasePending = true;
+	InterruptPending = true;
+	SetLatch(MyLatch);
 }
 
 /*
@@ -1109,9 +1705,46 @@ ensure_out_buffer_capacity(size_t bytes_needed, PGXCNodeHandle *handle)
 int
 send_some(PGXCNodeHandle *handle, int len)
 {
-	char	   *ptr = handle->outBuffer;
-	int			remaining = handle->outEnd;
-	int			result = 0;
+	if (handle->compressed)
+	{
+		char	   *ptr = handle->outBuffer;
+		int			left = len;
+
+		/* Compress and send the data frame by frame */
+		while (left > 0)
+		{
+			int			chunk = Min(left, PQ_FRAME_RAWSZ);
+			int			framelen;
+
+			framelen = pq_compress_frame(ptr, chunk, handle->zOutBuffer);
+			if (send_buffer(handle, handle->zOutBuffer, framelen) < 0)
+				return -1;
+			ptr += chunk;
+			left -= chunk;
+		}
+	}
+	else if (send_buffer(handle, handle->outBuffer, len) < 0)
+		return -1;
+
+	PGXCNodeBytesSent += len;
+
+	/* shift the remaining contents of the buffer */
+	if (handle->outEnd > len)
+		memmove(handle->outBuffer, handle->outBuffer + len,
+				handle->outEnd - len);
+	handle->outEnd -= len;
+
+	return 0;
+}
+
+/*
+ * send_buffer
+ *	  Send len bytes at ptr over the handle, waiting for the socket to accept
+ *	  them if necessary.
+ */
+static int
+send_buffer(PGXCNodeHandle *handle, char *ptr, int len)
+{
 
 	/* while there's still data to send */
 	while (len > 0)
@@ -1179,7 +1812,6 @@ send_some(PGXCNodeHandle *handle, int len)
 		{
 			ptr += sent;
 			len -= sent;
-			remaining -= sent;
 		}
 
 		if (len > 0)
@@ -1223,12 +1855,7 @@ send_some(PGXCNodeHandle *handle, int len)
 		}
 	}
 
-	/* shift the remaining contents of the buffer */
-	if (remaining > 0)
-		memmove(handle->outBuffer, ptr, remaining);
-	handle->outEnd = remaining;
-
-	return result;
+	return 0;
 }
 
 /*
@@ -1323,10 +1950,15 @@ pgxc_node_send_parse(PGXCNodeHandle * handle, const char* statement,
 /*
  * pgxc_node_send_plan
  *	  Send PLAN message down to the datanode.
+ *
+ * The digest identifies the plan in the datanode's plan cache. If planstr is
+ * empty only the digest is sent, and the datanode replies with ParseComplete
+ * if it has the plan cached, or asks for the plan body otherwise.
  */
 int
 pgxc_node_send_plan(PGXCNodeHandle * handle, const char *statement,
 					const char *query, const char *planstr,
+					const uint8 *digest,
 					short num_params, Oid *param_types)
 {
 	int			stmtLen;
@@ -1356,8 +1988,9 @@ pgxc_node_send_plan(PGXCNodeHandle * handle, const char *statement,
 		paramTypes[i] = format_type_be(param_types[i]);
 		paramTypeLen += strlen(paramTypes[i]) + 1;
 	}
-	/* size + pnameLen + queryLen + parameters */
-	msgLen = 4 + queryLen + stmtLen + planLen + paramTypeLen;
+	/* size + pnameLen + queryLen + parameters + digest */
+	msgLen = 4 + queryLen + stmtLen + planLen + paramTypeLen +
+		PG_SHA256_DIGEST_LENGTH;
 
 	/* msgType + msgLen */
 	if (ensure_out_buffer_capacity(handle->outEnd + 1 + msgLen, handle) != 0)
@@ -1397,6 +2030,9 @@ pgxc_node_send_plan(PGXCNodeHandle * handle, const char *statement,
 		pfree(paramTypes[i]);
 	}
 	pfree(paramTypes);
+	/* plan digest */
+	memcpy(handle->outBuffer + handle->outEnd, digest, PG_SHA256_DIGEST_LENGTH);
+	handle->outEnd += PG_SHA256_DIGEST_LENGTH;
 
 	handle->in_extended_query = true;
  	return 0;
@@ -1878,6 +2514,39 @@ pgxc_node_send_cmd_id(PGXCNodeHandle *handle, CommandId cid)
 	return 0;
 }
 
+/*
+ * pgxc_node_send_query_id
+ *	  Send down the query identifier the next statement should be accounted
+ *	  under, see PGXCRemoteQueryId.
+ */
+int
+pgxc_node_send_query_id(PGXCNodeHandle *handle, uint32 queryId)
+{
+	int			msglen = QUERY_ID_MSG_LEN;
+	uint32		n32;
+
+	/* Invalid connection state, return error */
+	if (handle->state != DN_CONNECTION_STATE_IDLE)
+		return EOF;
+
+	/* msgType + msgLen */
+	if (ensure_out_buffer_capacity(handle->outEnd + 1 + msglen, handle) != 0)
+	{
+		add_error_message(handle, "out of memory");
+		return EOF;
+	}
+
+	handle->outBuffer[handle->outEnd++] = 'q';
+	msglen = htonl(msglen);
+	memcpy(handle->outBuffer + handle->outEnd, &msglen, 4);
+	handle->outEnd += 4;
+	n32 = htonl(queryId);
+	memcpy(handle->outBuffer + handle->outEnd, &n32, 4);
+	handle->outEnd += 4;
+
+	return 0;
+}
+
 /*
  * pgxc_node_send_snapshot
  *	  Send the snapshot down to the remote node.
@@ -2077,13 +2746,14 @@ get_any_handle(List *datanodelist)
 					/* The node is requested */
 					List   *allocate = list_make1_int(node);
 					int	   *pids;
+					int	   *states;
 					int    *fds = PoolManagerGetConnections(allocate, NIL,
-							&pids);
+							session_params_version,
+							PGXCNodeGetSessionFingerprint(), &pids, &states);
 					PGXCNodeHandle		*node_handle;
 
 					if (!fds)
 					{
-						Assert(pids != NULL);
 						ereport(ERROR,
 								(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
 								 errmsg("Failed to get pooled connections"),
@@ -2097,7 +2767,7 @@ get_any_handle(List *datanodelist)
 									 "parameters")));
 					}
 					node_handle = &dn_handles[node];
-					pgxc_node_init(node_handle, fds[0], true, pids[0]);
+					pgxc_node_init(node_handle, fds[0], true, pids[0], states[0]);
 					datanode_count++;
 
 					elog(DEBUG1, "Established a connection with datanode \"%s\","
@@ -2156,6 +2826,9 @@ get_handles(List *datanodelist, List *coordlist, bool is_coord_only_query, bool
 					(errcode(ERRCODE_QUERY_CANCELED),
 					 errmsg("canceling transaction due to cluster configuration reset by administrator command")));
 
+	/* Make sure our previous commit is completed on the nodes */
+	CommitBatcherWaitPending();
+
 	result = (PGXCNodeAllHandles *) palloc(sizeof(PGXCNodeAllHandles));
 	if (!result)
 	{
@@ -2311,7 +2984,11 @@ get_handles(List *datanodelist, List *coordlist, bool is_coord_only_query, bool
 	{
 		int	j = 0;
 		int *pids;
-		int	*fds = PoolManagerGetConnections(dn_allocate, co_allocate, &pids);
+		int *states;
+		int	*fds = PoolManagerGetConnections(dn_allocate, co_allocate,
+										is_global_session ? session_params_version : 0,
+										is_global_session ? PGXCNodeGetSessionFingerprint() : 0,
+										&pids, &states);
 
 		if (!fds)
 		{
@@ -2346,6 +3023,7 @@ get_handles(List *datanodelist, List *coordlist, bool is_coord_only_query, bool
 			{
 				int			node = lfirst_int(node_list_item);
 				int			fdsock = fds[j];
+				int			session_state = states[j];
 				int			be_pid = pids[j++];
 
 				if (node < 0 || node >= NumDataNodes)
@@ -2356,7 +3034,8 @@ get_handles(List *datanodelist, List *coordlist, bool is_coord_only_query, bool
 				}
 
 				node_handle = &dn_handles[node];
-				pgxc_node_init(node_handle, fdsock, is_global_session, be_pid);
+				pgxc_node_init(node_handle, fdsock, is_global_session, be_pid,
+							   session_state);
 				dn_handles[node] = *node_handle;
 				datanode_count++;
 
@@ -2373,6 +3052,7 @@ get_handles(List *datanodelist, List *coordlist, bool is_coord_only_query, bool
 			{
 				int			node = lfirst_int(node_list_item);
 				int			be_pid = pids[j];
+				int			session_state = states[j];
 				int			fdsock = fds[j++];
 
 				if (node < 0 || node >= NumCoords)
@@ -2383,7 +3063,8 @@ get_handles(List *datanodelist, List *coordlist, bool is_coord_only_query, bool
 				}
 
 				node_handle = &co_handles[node];
-				pgxc_node_init(node_handle, fdsock, is_global_session, be_pid);
+				pgxc_node_init(node_handle, fdsock, is_global_session, be_pid,
+							   session_state);
 				co_handles[node] = *node_handle;
 				coord_count++;
 
@@ -2395,6 +3076,7 @@ get_handles(List *datanodelist, List *coordlist, bool is_coord_only_query, bool
 		}
 
 		pfree(fds);
+		pfree(states);
 
 		if (co_allocate)
 			list_free(co_allocate);
@@ -2662,6 +3344,7 @@ PGXCNodeSetParam(bool local, const char *name, const char *value, int flags)
 		param_list = session_param_list;
 		if (session_params)
 			resetStringInfo(session_params);
+		session_params_version++;
 		oldcontext = MemoryContextSwitchTo(TopMemoryContext);
 	}
 
@@ -2705,6 +3388,10 @@ PGXCNodeSetParam(bool local, const char *name, const char *value, int flags)
 void
 PGXCNodeResetParams(bool only_local)
 {
+	/* pooled connections no longer have our session parameters */
+	if (!only_local)
+		session_params_version++;
+
 	if (!only_local && session_param_list)
 	{
 		/* need to explicitly pfree session stuff, it is in TopMemoryContext */
@@ -2788,10 +3475,19 @@ PGXCNodeGetSessionParamStr(void)
 	/* If the parameter string is empty, build it up. */
 	if (session_params->len == 0)
 	{
+		int			start;
+
 		if (IS_PGXC_COORDINATOR)
 			appendStringInfo(session_params, "SET global_session TO %s_%d;",
 							 PGXCNodeName, MyProcPid);
+		start = session_params->len;
 		get_set_command(session_param_list, session_params, false);
+		session_params_fingerprint =
+			DatumGetUInt32(hash_any((unsigned char *) session_params->data + start,
+									session_params->len - start));
+		/* zero means no fingerprint */
+		if (session_params_fingerprint == 0)
+			session_params_fingerprint = 1;
 		appendStringInfo(session_params, "SET parentPGXCPid TO %d;",
 							 MyProcPid);
 	}
@@ -2799,6 +3495,37 @@ PGXCNodeGetSessionParamStr(void)
 }
 
 
+/*
+ * PGXCNodeGetSessionFingerprint
+ *	  Returns the fingerprint of the session parameters (see
+ *	  session_params_fingerprint).
+ */
+static uint32
+PGXCNodeGetSessionFingerprint(void)
+{
+	/* make sure the fingerprint is valid */
+	(void) PGXCNodeGetSessionParamStr();
+
+	return session_params_fingerprint;
+}
+
+
+/*
+ * PGXCNodeGetSessionIdentStr
+ *	  Returns SET commands identifying the session on a remote node, enough
+ *	  to take over a connection set up by another session with the same
+ *	  parameters.
+ */
+static char *
+PGXCNodeGetSessionIdentStr(void)
+{
+	if (IS_PGXC_COORDINATOR)
+		return psprintf("SET global_session TO %s_%d;SET parentPGXCPid TO %d;",
+						PGXCNodeName, MyProcPid, MyProcPid);
+	return psprintf("SET parentPGXCPid TO %d;", MyProcPid);
+}
+
+
 /*
  * PGXCNodeGetTransactionParamStr
  *	  Returns SET commands needed to initialize transaction on a remote node.
@@ -2844,25 +3571,118 @@ PGXCNodeGetTransactionParamStr(void)
 void
 pgxc_node_set_query(PGXCNodeHandle *handle, const char *set_query)
 {
-	pgxc_node_send_query(handle, set_query);
+	pgxc_node_set_query_multi(1, &handle, set_query);
+}
+
+
+/*
+ * pgxc_node_set_query_multi
+ *	  Same as pgxc_node_set_query for a number of connections.  The query is
+ *	  sent down to all of them before waiting for any, so that the nodes run
+ *	  it concurrently instead of one round trip after the other.
+ */
+void
+pgxc_node_set_query_multi(int count, PGXCNodeHandle **handles,
+						  const char *set_query)
+{
+	int			i;
+
+	for (i = 0; i < count; i++)
+		pgxc_node_send_query(handles[i], set_query);
 
 	/*
 	 * Now read responses until ReadyForQuery.
 	 * XXX We may need to handle possible errors here.
 	 */
-	for (;;)
+	for (i = 0; i < count; i++)
+	{
+		PGXCNodeHandle *handle = handles[i];
+
+		for (;;)
+		{
+			char	msgtype;
+			int 	msglen;
+			char   *msg;
+			/*
+			 * If we are in the process of shutting down, we
+			 * may be rolling back, and the buffer may contain other messages.
+			 * We want to avoid a procarray exception
+			 * as well as an error stack overflow.
+			 */
+			if (proc_exit_inprogress)
+				PGXCNodeSetConnectionState(handle, DN_CONNECTION_STATE_ERROR_FATAL);
+
+			/* don't read from from the connection if there is a fatal error */
+			if (handle->state == DN_CONNECTION_STATE_ERROR_FATAL)
+				break;
+
+			/* No data available, read more */
+			if (!HAS_MESSAGE_BUFFERED(handle))
+			{
+				pgxc_node_receive(1, &handle, NULL);
+				continue;
+			}
+			msgtype = get_message(handle, &msglen, &msg);
+
+			/*
+			 * Ignore any response except ErrorResponse and ReadyForQuery
+			 */
+
+			if (msgtype == 'E')	/* ErrorResponse */
+			{
+				handle->error = pstrdup(msg);
+				PGXCNodeSetConnectionState(handle, DN_CONNECTION_STATE_ERROR_FATAL);
+				break;
+			}
+
+			if (msgtype == 'Z') /* ReadyForQuery */
+			{
+				handle->transaction_status = msg[0];
+				PGXCNodeSetConnectionState(handle, DN_CONNECTION_STATE_IDLE);
+				handle->combiner = NULL;
+				break;
+			}
+		}
+	}
+}
+
+
+/*
+ * pgxc_node_wait_syncs
+ *	  Read in responses to the Sync messages sent down without waiting.
+ *	  Connection should not have an active query.
+ *
+ * Until the responses are read in the connection's transaction_status and
+ * state reflect the moment the Syncs were sent, and errors they report go
+ * unnoticed. So call this before looking at them, e.g. to decide how to end
+ * the remote transaction, and before releasing the connection to the pool.
+ */
+void
+pgxc_node_wait_syncs(PGXCNodeHandle *handle)
+{
+	/*
+	 * Nothing to do if connection is busy, responses will be consumed when
+	 * the current response is read in.
+	 */
+	if ((handle->pendingSyncs == 0 && handle->pendingSetup == 0) ||
+			handle->state != DN_CONNECTION_STATE_IDLE)
+		return;
+
+	/* The session setup may still be in the buffer if nothing was sent */
+	if (pgxc_node_flush(handle))
+	{
+		PGXCNodeSetConnectionState(handle, DN_CONNECTION_STATE_ERROR_FATAL);
+		return;
+	}
+
+	/* Make pgxc_node_receive() wait on the connection */
+	PGXCNodeSetConnectionState(handle, DN_CONNECTION_STATE_CLOSE);
+
+	while (handle->pendingSyncs > 0 || handle->pendingSetup > 0)
 	{
 		char	msgtype;
 		int 	msglen;
 		char   *msg;
-		/*
-		 * If we are in the process of shutting down, we
-		 * may be rolling back, and the buffer may contain other messages.
-		 * We want to avoid a procarray exception
-		 * as well as an error stack overflow.
-		 */
-		if (proc_exit_inprogress)
-			PGXCNodeSetConnectionState(handle, DN_CONNECTION_STATE_ERROR_FATAL);
 
 		/* don't read from from the connection if there is a fatal error */
 		if (handle->state == DN_CONNECTION_STATE_ERROR_FATAL)
@@ -2871,30 +3691,26 @@ pgxc_node_set_query(PGXCNodeHandle *handle, const char *set_query)
 		/* No data available, read more */
 		if (!HAS_MESSAGE_BUFFERED(handle))
 		{
-			pgxc_node_receive(1, &handle, NULL);
+			if (pgxc_node_receive(1, &handle, NULL))
+				PGXCNodeSetConnectionState(handle,
+										   DN_CONNECTION_STATE_ERROR_FATAL);
 			continue;
 		}
-		msgtype = get_message(handle, &msglen, &msg);
 
-		/*
-		 * Ignore any response except ErrorResponse and ReadyForQuery
-		 */
+		/* get_message() consumes ReadyForQuery itself */
+		msgtype = get_message(handle, &msglen, &msg);
 
-		if (msgtype == 'E')	/* ErrorResponse */
+		/* Ignore anything except ErrorResponse, CloseComplete is expected */
+		if (msgtype == 'E')
 		{
 			handle->error = pstrdup(msg);
 			PGXCNodeSetConnectionState(handle, DN_CONNECTION_STATE_ERROR_FATAL);
 			break;
 		}
-
-		if (msgtype == 'Z') /* ReadyForQuery */
-		{
-			handle->transaction_status = msg[0];
-			PGXCNodeSetConnectionState(handle, DN_CONNECTION_STATE_IDLE);
-			handle->combiner = NULL;
-			break;
-		}
 	}
+
+	if (handle->state == DN_CONNECTION_STATE_CLOSE)
+		PGXCNodeSetConnectionState(handle, DN_CONNECTION_STATE_IDLE);
 }
 
 
@@ -2910,12 +3726,21 @@ RequestRefreshRemoteHandles(void)
 	HandlesRefreshPending = true;
 }
 
+void
+RequestReleaseRemoteHandles(void)
+{
+	HandlesReleasePending = true;
+}
+
 bool
 PoolerMessagesPending(void)
 {
 	if (HandlesRefreshPending)
 		return true;
 
+	if (HandlesReleasePending)
+		return true;
+
 	return false;
 }
 
@@ -2931,6 +3756,7 @@ DoInvalidateRemoteHandles(void)
 
 	HandlesInvalidatePending = false;
 	HandlesRefreshPending = false;
+	handles_held = false;
 
 	for (i = 0; i < NumCoords; i++)
 	{
@@ -3306,5 +4132,15 @@ HandlePoolerMessages(void)
 		elog(LOG, "Backend (%u), doing handles refresh",
 			 MyBackendId);
 	}
+
+	/*
+	 * Connections used by the current transaction are given back at its
+	 * end, as hold_handles sees the request.
+	 */
+	if (HandlesReleasePending && !IsTransactionOrTransactionBlock())
+	{
+		HandlesReleasePending = false;
+		release_handles();
+	}
 	return;
 }
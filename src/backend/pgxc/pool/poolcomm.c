@@ -496,34 +496,50 @@ pool_putmessage(PoolPort *port, char msgtype, const char *s, size_t len)
 	return 0;
 }
 
-/* message code('f'), size(8), node_count */
-#define SEND_MSG_BUFFER_SIZE 9
+/* message code('f'), size, node_count, then PID and session state per node */
+#define SEND_MSG_HEADER_SIZE 9
+#define SEND_MSG_BUFFER_SIZE(count) (SEND_MSG_HEADER_SIZE + (count) * 8)
 /* message code('s'), result */
 #define SEND_RES_BUFFER_SIZE 5
 #define SEND_PID_BUFFER_SIZE (5 + (MaxConnections - 1) * 4)
 
 /*
- * Build up a message carrying file descriptors or process numbers and send them over specified
- * connection
+ * Build up a message carrying file descriptors of connections, along with
+ * PIDs of the remote backends and session states of the connections, and
+ * send it over specified connection.
+ *
+ * Everything is sent in a single message, so handing connections to a
+ * session costs a single sendmsg/recvmsg pair. A count of zero tells the
+ * session we failed to acquire the connections.
  */
 int
-pool_sendfds(PoolPort *port, int *fds, int count)
+pool_sendconns(PoolPort *port, int *fds, int *pids, int *states, int count)
 {
 	struct iovec iov[1];
 	struct msghdr msg;
-	char		buf[SEND_MSG_BUFFER_SIZE];
+	int			buflen = SEND_MSG_BUFFER_SIZE(count);
+	char		buf[buflen];
 	uint		n32;
+	int			i;
 	int                     controllen =  CMSG_LEN(count * sizeof(int));
 	struct cmsghdr *cmptr = NULL;
 
 	buf[0] = 'f';
-	n32 = htonl((uint32) 8);
+	n32 = htonl((uint32) (buflen - 1));
 	memcpy(buf + 1, &n32, 4);
 	n32 = htonl((uint32) count);
 	memcpy(buf + 5, &n32, 4);
 
+	for (i = 0; i < count; i++)
+	{
+		n32 = htonl((uint32) pids[i]);
+		memcpy(buf + SEND_MSG_HEADER_SIZE + i * 8, &n32, 4);
+		n32 = htonl((uint32) states[i]);
+		memcpy(buf + SEND_MSG_HEADER_SIZE + i * 8 + 4, &n32, 4);
+	}
+
 	iov[0].iov_base = buf;
-	iov[0].iov_len = SEND_MSG_BUFFER_SIZE;
+	iov[0].iov_len = buflen;
 	msg.msg_iov = iov;
 	msg.msg_iovlen = 1;
 	msg.msg_name = NULL;
@@ -546,7 +562,7 @@ pool_sendfds(PoolPort *port, int *fds, int count)
 		memcpy(CMSG_DATA(CMSG_FIRSTHDR(&msg)), fds, count * sizeof(int));
 	}
 
-	if (sendmsg(Socket(*port), &msg, 0) != SEND_MSG_BUFFER_SIZE)
+	if (sendmsg(Socket(*port), &msg, 0) != buflen)
 	{
 		if (cmptr)
 			free(cmptr);
@@ -561,14 +577,17 @@ pool_sendfds(PoolPort *port, int *fds, int count)
 
 
 /*
- * Read a message from the specified connection carrying file descriptors
+ * Read a message from the specified connection carrying file descriptors,
+ * PIDs of the remote backends and session states of the connections.
  */
 int
-pool_recvfds(PoolPort *port, int *fds, int count)
+pool_recvconns(PoolPort *port, int *fds, int *pids, int *states, int count)
 {
 	int			r;
+	int			i;
 	uint		n32;
-	char		buf[SEND_MSG_BUFFER_SIZE];
+	int			buflen = SEND_MSG_BUFFER_SIZE(count);
+	char		buf[buflen];
 	struct iovec iov[1];
 	struct msghdr msg;
 	int                     controllen = CMSG_LEN(count * sizeof(int));
@@ -578,7 +597,7 @@ pool_recvfds(PoolPort *port, int *fds, int count)
 		return EOF;
 
 	iov[0].iov_base = buf;
-	iov[0].iov_len = SEND_MSG_BUFFER_SIZE;
+	iov[0].iov_len = buflen;
 	msg.msg_iov = iov;
 	msg.msg_iovlen = 1;
 	msg.msg_name = NULL;
@@ -601,7 +620,7 @@ pool_recvfds(PoolPort *port, int *fds, int count)
 	{
 		goto failure;
 	}
-	else if (r != SEND_MSG_BUFFER_SIZE)
+	else if (r < SEND_MSG_HEADER_SIZE)
 	{
 		ereport(ERROR,
 				(errcode(ERRCODE_PROTOCOL_VIOLATION),
@@ -618,16 +637,6 @@ pool_recvfds(PoolPort *port, int *fds, int count)
 		goto failure;
 	}
 
-	memcpy(&n32, buf + 1, 4);
-	n32 = ntohl(n32);
-	if (n32 != 8)
-	{
-		ereport(ERROR,
-				(errcode(ERRCODE_PROTOCOL_VIOLATION),
-				 errmsg("invalid message size")));
-		goto failure;
-	}
-
 	/*
 	 * If connection count is 0 it means pool does not have connections
 	 * to  fulfill request. Otherwise number of returned connections
@@ -652,6 +661,24 @@ pool_recvfds(PoolPort *port, int *fds, int count)
 		goto failure;
 	}
 
+	memcpy(&n32, buf + 1, 4);
+	n32 = ntohl(n32);
+	if (n32 != buflen - 1 || r != buflen)
+	{
+		ereport(ERROR,
+				(errcode(ERRCODE_PROTOCOL_VIOLATION),
+				 errmsg("invalid message size")));
+		goto failure;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		memcpy(&n32, buf + SEND_MSG_HEADER_SIZE + i * 8, 4);
+		pids[i] = (int) ntohl(n32);
+		memcpy(&n32, buf + SEND_MSG_HEADER_SIZE + i * 8 + 4, 4);
+		states[i] = (int) ntohl(n32);
+	}
+
 	memcpy(fds, CMSG_DATA(CMSG_FIRSTHDR(&msg)), count * sizeof(int));
 	free(cmptr);
 	return 0;
@@ -188,7 +188,7 @@
  * constructing connection strings, opening/closing connections, pinging
  * nodes, etc.
  *
- * - PGXCNodeConnect    - open libpq connection using connection string
+ * - PGXCNodeConnectStart - start non-blocking libpq connection
  * - PGXCNodePing       - ping node using connection string
  * - PGXCNodeClose      - close libpq connection
  * - PGXCNodeConnected  - verify connection status
@@ -258,8 +258,14 @@
 #include "pgxc/pgxc.h"
 #include "pgxc/poolmgr.h"
 #include "pgxc/poolutils.h"
+#include "pgstat.h"
 #include "postmaster/postmaster.h"		/* For UnixSocketDir */
+#include "port/atomics.h"
+#include "storage/fd.h"
 #include "storage/procarray.h"
+#include "storage/procsignal.h"
+#include "storage/shmem.h"
+#include "utils/timestamp.h"
 #include "utils/varlena.h"
 
 #include "../interfaces/libpq/libpq-fe.h"
@@ -269,9 +275,13 @@
 /* Configuration options */
 int			PoolConnKeepAlive = 600;
 int			PoolMaintenanceTimeout = 30;
+int			PoolConnectTimeout = 10;
 int			MaxPoolSize = 100;
+int			MinPoolSize = 0;
 int			PoolerPort = 6667;
 bool		PersistentConnections = false;
+int			SessionConnectionHoldTime = 0;
+bool		NetworkCompression = false;
 
 /* Flag to tell if we are Postgres-XC pooler process */
 static bool am_pgxc_pooler = false;
@@ -329,6 +339,63 @@ static DatabasePool *databasePools = NULL;
 static int	agentCount = 0;
 static PoolAgent **poolAgents;
 
+/* Last serial number assigned to an agent */
+static uint32 agentSerial = 0;
+
+/*
+ * Database pools to prefill when the pooler starts, as recorded by the
+ * previous pooler (see pools_save_state). One entry per node pool.
+ */
+typedef struct
+{
+	char	   *database;
+	char	   *user_name;
+	char	   *pgoptions;
+	Oid			nodeoid;
+} PoolPrefillEntry;
+
+static List *poolPrefillList = NIL;
+
+/*
+ * Load of the nodes, as seen by this pooler - number of connections handed
+ * out to the sessions, and moving average of the time needed to open a new
+ * connection. Published in the shared node table (PgxcNodeUpdateLoad) for
+ * the planner to pick the least loaded node for reads of replicated tables.
+ */
+typedef struct
+{
+	Oid			nodeoid;
+	int			active;
+	int			latency;		/* microseconds */
+	bool		dirty;			/* not published yet */
+} PoolNodeStats;
+
+static HTAB *poolNodeStats = NULL;
+static bool poolNodeStatsDirty = false;
+
+/*
+ * Pooler statistics in shared memory (see PoolerNodeStats). The pooler is
+ * the only writer, it increments changecount before and after each update so
+ * that readers can retry until they get a consistent copy.
+ */
+typedef struct
+{
+	uint32		changecount;
+	TimestampTz	stats_reset;		/* pooler start */
+	int			nnodes;				/* number of entries used */
+	PoolerNodeStats nodes[FLEXIBLE_ARRAY_MEMBER];
+} PoolerStatsData;
+
+static PoolerStatsData *PoolerStats = NULL;
+
+const int	PoolWaitBucketBounds[POOL_WAIT_BUCKETS - 1] = {
+	100, 1000, 5000, 10000, 50000, 100000, 1000000
+};
+
+/* File with the busiest pools, and how many database pools it lists */
+#define POOLER_STATE_FILE		PGSTAT_STAT_PERMANENT_DIRECTORY "/pooler.state"
+#define POOLER_STATE_MAX_POOLS	32
+
 /*
  * A connection to the pool manager (essentially a PQ connection).
  */
@@ -361,9 +428,17 @@ static bool remove_all_agent_references(Oid nodeoid);
 static DatabasePool *find_database_pool(const char *database, const char *user_name, const char *pgoptions);
 static DatabasePool *remove_database_pool(const char *database, const char *user_name);
 static int *agent_acquire_connections(PoolAgent *agent, List *datanodelist,
-		List *coordlist, int **connectionpids);
+		List *coordlist, int session_version, uint32 session_fingerprint,
+		int **connectionpids, int **states);
+static int agent_session_state(PoolAgent *agent, PGXCNodePoolSlot *slot,
+		int session_version, uint32 session_fingerprint);
+static void prefer_session_slot(DatabasePool *dbPool, Oid node,
+		PoolAgent *agent, int session_version, uint32 session_fingerprint);
 static int cancel_query_on_connections(PoolAgent *agent, List *datanodelist, List *coordlist);
 static PGXCNodePoolSlot *acquire_connection(DatabasePool *dbPool, Oid node);
+static void reclaim_held_connections(DatabasePool *dbPool, Oid node);
+static bool check_slot(PGXCNodePoolSlot *slot);
+static PGXCNodePool *prepare_node_pool(DatabasePool *dbPool, Oid node);
 static void agent_release_connections(PoolAgent *agent, bool force_destroy);
 static void release_connection(DatabasePool *dbPool, PGXCNodePoolSlot *slot,
 							   Oid node, bool force_destroy);
@@ -371,9 +446,26 @@ static void release_connection(DatabasePool *dbPool, PGXCNodePoolSlot *slot,
 static void destroy_slot(PGXCNodePoolSlot *slot);
 static void destroy_node_pool(PGXCNodePool *node_pool);
 
+static PGXCNodePool *lookup_node_pool(DatabasePool *dbPool, Oid node);
 static PGXCNodePool *grow_pool(DatabasePool *dbPool, Oid node);
+static int connect_node_pools(DatabasePool *dbPool, PGXCNodePool **pools,
+							  int npools);
 static bool shrink_pool(DatabasePool *pool);
 static void pools_maintenance(void);
+static void warm_database_pool(DatabasePool *dbPool, bool include_empty);
+static void pools_warm(void);
+static void pools_save_state(void);
+static void pools_load_state(void);
+static void pools_prefill(void);
+static PoolNodeStats *node_stats(Oid node);
+static void node_stats_add_active(Oid node, int delta);
+static void node_stats_add_latency(Oid node, TimestampTz start);
+static void node_stats_recount(void);
+static void node_stats_publish(void);
+static PoolerNodeStats *pooler_stats_begin(Oid node);
+static void pooler_stats_end(void);
+static void pooler_stats_count_wait(PoolAgent *agent, List *datanodelist,
+						List *coordlist, TimestampTz start);
 
 static void PoolerLoop(void);
 static void PoolManagerConnect(const char *database, const char *user_name,
@@ -387,6 +479,7 @@ static int *abort_pids(int *count,
 					   const char *database,
 					   const char *user_name);
 static char *build_node_conn_str(Oid node, DatabasePool *dbPool);
+static char *node_conn_host(const char *host);
 
 /* Signal handlers */
 static void pooler_die(SIGNAL_ARGS);
@@ -399,7 +492,7 @@ static void TryPingUnhealthyNode(Oid nodeoid);
 static char *PGXCNodeConnStr(char *host, int port, char *dbname, char *user,
 							 char *pgoptions,
 							 char *remote_type, char *parent_node);
-static NODE_CONNECTION *PGXCNodeConnect(char *connstr);
+static NODE_CONNECTION *PGXCNodeConnectStart(char *connstr);
 static void PGXCNodeClose(NODE_CONNECTION * conn);
 static int PGXCNodeConnected(NODE_CONNECTION * conn);
 static int PGXCNodePing(const char *connstr);
@@ -745,6 +838,11 @@ agent_create(void)
 	agent->coord_connections = NULL;
 	agent->pid = 0;
 
+	/* zero is reserved for connections not tagged by any agent */
+	if (++agentSerial == 0)
+		++agentSerial;
+	agent->serial = agentSerial;
+
 	/* Append new agent to the list */
 	poolAgents[agentCount++] = agent;
 
@@ -1202,13 +1300,17 @@ PoolManagerDisconnect(void)
  * It also provides array of PIDs of the backends (on remote nodes).
  */
 int *
-PoolManagerGetConnections(List *datanodelist, List *coordlist, int **pids)
+PoolManagerGetConnections(List *datanodelist, List *coordlist,
+						  int session_version, uint32 session_fingerprint,
+						  int **pids, int **states)
 {
 	int			i;
 	ListCell   *nodelist_item;
 	int		   *fds;
+	int			r;
 	int			totlen = list_length(datanodelist) + list_length(coordlist);
-	int			nodes[totlen + 2]; /* node OIDs + two node counts */
+	int			nodes[totlen + 4]; /* node OIDs + two node counts + version
+									* + fingerprint */
 
 	/* Make sure we're connected to the pool manager. */
 	if (poolHandle == NULL)
@@ -1223,6 +1325,8 @@ PoolManagerGetConnections(List *datanodelist, List *coordlist, int **pids)
 	 * - datanode OIDs
 	 * - number of coordinators
 	 * - coordinator OIDs
+	 * - version of the session state (0 if none is needed)
+	 * - fingerprint of the session parameters (0 if none)
 	 * 
 	 * The datanode list may be empty when the query does not need talk
 	 * to datanodes (e.g. sequence DDL).
@@ -1250,11 +1354,14 @@ PoolManagerGetConnections(List *datanodelist, List *coordlist, int **pids)
 		}
 	}
 
+	nodes[i++] = htonl(session_version);
+	nodes[i++] = htonl(session_fingerprint);
+
 	/*
 	 * Send the encoded datanode/coordinator OIDs to the pool manager,
 	 * flush the message nd wait for the response.
 	 */
-	pool_putmessage(&poolHandle->port, 'g', (char *) nodes, sizeof(int) * (totlen + 2));
+	pool_putmessage(&poolHandle->port, 'g', (char *) nodes, sizeof(int) * (totlen + 4));
 	pool_flush(&poolHandle->port);
 
 	/* Allocate memory for file descriptors (node connections). */
@@ -1266,20 +1373,25 @@ PoolManagerGetConnections(List *datanodelist, List *coordlist, int **pids)
 				 errmsg("out of memory")));
 	}
 
-	/* receive file descriptors */
-	if (pool_recvfds(&poolHandle->port, fds, totlen))
+	*pids = (int *) palloc(sizeof(int) * totlen);
+	*states = (int *) palloc(sizeof(int) * totlen);
+
+	/*
+	 * Receive file descriptors, along with PIDs of the remote backends and
+	 * the session state of the connections (POOL_SESSION_*), all in a single
+	 * message.
+	 */
+	pgstat_report_wait_start(WAIT_EVENT_POOLER_GET_CONNECTIONS);
+	r = pool_recvconns(&poolHandle->port, fds, *pids, *states, totlen);
+	pgstat_report_wait_end();
+	if (r)
 	{
 		elog(WARNING, "failed to receive file descriptors for connections");
 		pfree(fds);
-		fds = NULL;
-	}
-
-	/* receive PIDs for remote backends */
-	if (pool_recvpids(&poolHandle->port, pids) != totlen)
-	{
-		elog(WARNING, "failed to receive PIDs of remote backends");
 		pfree(*pids);
 		*pids = NULL;
+		pfree(*states);
+		*states = NULL;
 		return NULL;
 	}
 
@@ -1661,8 +1773,11 @@ static void
 handle_get_connections(PoolAgent * agent, StringInfo s)
 {
 	int		i;
-	int	   *fds, *pids = NULL;
+	int	   *fds, *pids = NULL, *states = NULL;
 	int		datanodecount, coordcount;
+	int		session_version;
+	uint32	session_fingerprint;
+	TimestampTz start;
 	List   *datanodelist = NIL;
 	List   *coordlist = NIL;
 
@@ -1674,9 +1789,11 @@ handle_get_connections(PoolAgent * agent, StringInfo s)
 	 * - List of Datanodes = NumPoolDataNodes * 4B (max)
 	 * - Number of Coordinators sent = 4B
 	 * - List of Coordinators = NumPoolCoords * 4B (max)
+	 * - Version of the session state = 4B
+	 * - Fingerprint of the session parameters = 4B
 	 */
 
-	pool_getmessage(&agent->port, s, 4 * agent->num_dn_connections + 4 * agent->num_coord_connections + 12);
+	pool_getmessage(&agent->port, s, 4 * agent->num_dn_connections + 4 * agent->num_coord_connections + 20);
 
 	/* decode the datanode OIDs */
 	datanodecount = pq_getmsgint(s, 4);
@@ -1691,6 +1808,9 @@ handle_get_connections(PoolAgent * agent, StringInfo s)
 	for (i = 0; i < coordcount; i++)
 		coordlist = lappend_int(coordlist, pq_getmsgint(s, 4));
 
+	session_version = pq_getmsgint(s, 4);
+	session_fingerprint = (uint32) pq_getmsgint(s, 4);
+
 	pq_getmsgend(s);
 
 	Assert(datanodecount >= 0 && coordcount >= 0);
@@ -1699,20 +1819,29 @@ handle_get_connections(PoolAgent * agent, StringInfo s)
 	 * In case of error agent_acquire_connections will log the error and
 	 * return NULL.
 	 */
-	fds = agent_acquire_connections(agent, datanodelist, coordlist, &pids);
+	start = GetCurrentTimestamp();
+	fds = agent_acquire_connections(agent, datanodelist, coordlist,
+									session_version, session_fingerprint,
+									&pids, &states);
+	if (fds)
+		pooler_stats_count_wait(agent, datanodelist, coordlist, start);
 
 	list_free(datanodelist);
 	list_free(coordlist);
 
-	/* Send the file descriptors back, along with the correct count. */
-	pool_sendfds(&agent->port, fds, fds ? datanodecount + coordcount : 0);
+	/*
+	 * Send the file descriptors back, along with the correct count, PIDs of
+	 * the remote backends serving the connections and the session state the
+	 * connections are in.
+	 */
+	pool_sendconns(&agent->port, fds, pids, states,
+				   fds ? datanodecount + coordcount : 0);
 	if (fds)
 		pfree(fds);
-
-	/* Also send PIDs of the remote backends serving the connections. */
-	pool_sendpids(&agent->port, pids, pids ? datanodecount + coordcount : 0);
 	if (pids)
 		pfree(pids);
+	if (states)
+		pfree(states);
 }
 
 /*
@@ -1887,16 +2016,20 @@ agent_handle_input(PoolAgent * agent, StringInfo s)
  *
  * Returns an array of file descriptors representing the connections, with
  * order matching the datanode/coordinator list. Also returns an array of
- * backend PIDs, handling those connections (on the remote nodes).
+ * backend PIDs, handling those connections (on the remote nodes), and an
+ * array of session states of the connections (see agent_session_state).
  */
 static int *
 agent_acquire_connections(PoolAgent *agent, List *datanodelist,
-		List *coordlist, int **pids)
+		List *coordlist, int session_version, uint32 session_fingerprint,
+		int **pids, int **states)
 {
 	int			i;
 	int		   *result;
 	ListCell   *nodelist_item;
 	MemoryContext oldcontext;
+	PGXCNodePool **pools;
+	int			npools;
 
 	Assert(agent);
 
@@ -1941,12 +2074,72 @@ agent_acquire_connections(PoolAgent *agent, List *datanodelist,
 				 errmsg("out of memory")));
 	}
 
+	*states = (int *) palloc((list_length(datanodelist) + list_length(coordlist)) * sizeof(int));
+
 	/*
 	 * Make sure the results (connections) are allocated in the memory
 	 * context for the DatabasePool.
 	 */
 	oldcontext = MemoryContextSwitchTo(agent->pool->mcxt);
 
+	/*
+	 * Open the connections missing in the node pools concurrently, so that
+	 * a session needing connections to many nodes does not wait for each
+	 * of them in turn. Broken connections are discarded first, so that
+	 * they are replaced in the same batch. The loops below then simply
+	 * pick up the free slots (and deal with nodes we failed to connect
+	 * to, retrying them one by one).
+	 */
+	pools = (PGXCNodePool **) palloc((list_length(datanodelist) + list_length(coordlist)) * sizeof(PGXCNodePool *));
+	npools = 0;
+
+	foreach(nodelist_item, datanodelist)
+	{
+		int			node = lfirst_int(nodelist_item);
+
+		if (agent->dn_connections[node] == NULL)
+		{
+			PGXCNodePool *nodePool = prepare_node_pool(agent->pool,
+													   agent->dn_conn_oids[node]);
+
+			if (nodePool->freeSize == 0)
+			{
+				PoolerNodeStats *stats = pooler_stats_begin(nodePool->nodeoid);
+
+				if (stats)
+					stats->misses++;
+				pooler_stats_end();
+				pools[npools++] = nodePool;
+			}
+		}
+	}
+
+	foreach(nodelist_item, coordlist)
+	{
+		int			node = lfirst_int(nodelist_item);
+
+		if (agent->coord_connections[node] == NULL)
+		{
+			PGXCNodePool *nodePool = prepare_node_pool(agent->pool,
+													   agent->coord_conn_oids[node]);
+
+			if (nodePool->freeSize == 0)
+			{
+				PoolerNodeStats *stats = pooler_stats_begin(nodePool->nodeoid);
+
+				if (stats)
+					stats->misses++;
+				pooler_stats_end();
+				pools[npools++] = nodePool;
+			}
+		}
+	}
+
+	if (npools > 0)
+		connect_node_pools(agent->pool, pools, npools);
+
+	pfree(pools);
+
 	/* first open connections to the datanodes */
 	i = 0;
 	foreach(nodelist_item, datanodelist)
@@ -1956,8 +2149,11 @@ agent_acquire_connections(PoolAgent *agent, List *datanodelist,
 		/* Acquire from the pool if none */
 		if (agent->dn_connections[node] == NULL)
 		{
-			PGXCNodePoolSlot *slot = acquire_connection(agent->pool,
-														agent->dn_conn_oids[node]);
+			PGXCNodePoolSlot *slot;
+
+			prefer_session_slot(agent->pool, agent->dn_conn_oids[node], agent,
+								session_version, session_fingerprint);
+			slot = acquire_connection(agent->pool, agent->dn_conn_oids[node]);
 
 			/* Handle failure */
 			if (slot == NULL)
@@ -1982,6 +2178,9 @@ agent_acquire_connections(PoolAgent *agent, List *datanodelist,
 		}
 
 		result[i] = PQsocket((PGconn *) agent->dn_connections[node]->conn);
+		(*states)[i] = agent_session_state(agent, agent->dn_connections[node],
+										   session_version,
+										   session_fingerprint);
 		(*pids)[i++] = ((PGconn *) agent->dn_connections[node]->conn)->be_pid;
 	}
 
@@ -1996,7 +2195,11 @@ agent_acquire_connections(PoolAgent *agent, List *datanodelist,
 		/* Acquire from the pool if none */
 		if (agent->coord_connections[node] == NULL)
 		{
-			PGXCNodePoolSlot *slot = acquire_connection(agent->pool, agent->coord_conn_oids[node]);
+			PGXCNodePoolSlot *slot;
+
+			prefer_session_slot(agent->pool, agent->coord_conn_oids[node], agent,
+								session_version, session_fingerprint);
+			slot = acquire_connection(agent->pool, agent->coord_conn_oids[node]);
 
 			/* Handle failure */
 			if (slot == NULL)
@@ -2021,6 +2224,9 @@ agent_acquire_connections(PoolAgent *agent, List *datanodelist,
 		}
 
 		result[i] = PQsocket((PGconn *) agent->coord_connections[node]->conn);
+		(*states)[i] = agent_session_state(agent, agent->coord_connections[node],
+										   session_version,
+										   session_fingerprint);
 		(*pids)[i++] = ((PGconn *) agent->coord_connections[node]->conn)->be_pid;
 	}
 
@@ -2032,6 +2238,101 @@ agent_acquire_connections(PoolAgent *agent, List *datanodelist,
 	return result;
 }
 
+/*
+ * agent_session_state
+ *	  Determine session state of a connection handed to the agent.
+ *
+ * The connections are not reset when released back to the pool, so that
+ * a session running many short transactions does not have to reset and
+ * set up the remote session over and over. Instead each slot remembers
+ * the agent (and version of its session parameters, as sent by the
+ * backend) for which the remote session was set up, and the backend only
+ * sends the reset and SET commands when the connection does not already
+ * have its current parameters (see pgxc_node_init). The slot also keeps
+ * the fingerprint of the session parameters, so a session taking over a
+ * connection set up by another session with the same parameters only has
+ * to set its identity.
+ *
+ * The slot is tagged with the new state the session is about to put it
+ * in. A session_version of zero means the session does not need any
+ * session parameters, and will only reset the connection if needed.
+ */
+static int
+agent_session_state(PoolAgent *agent, PGXCNodePoolSlot *slot,
+					int session_version, uint32 session_fingerprint)
+{
+	int			state;
+
+	if (slot->session_owner == 0)
+		state = POOL_SESSION_CLEAN;
+	else if (session_version > 0 &&
+			 slot->session_owner == agent->serial &&
+			 slot->session_version == session_version)
+		state = POOL_SESSION_CURRENT;
+	else if (session_version > 0 && session_fingerprint != 0 &&
+			 slot->session_fingerprint == session_fingerprint)
+		state = POOL_SESSION_MATCHING;
+	else
+		state = POOL_SESSION_DIRTY;
+
+	slot->session_owner = (session_version > 0) ? agent->serial : 0;
+	slot->session_version = session_version;
+	slot->session_fingerprint = (session_version > 0) ? session_fingerprint : 0;
+
+	return state;
+}
+
+
+/*
+ * prefer_session_slot
+ *	  Move the free connection needing the least session setup to the top
+ *	  of the node pool, where acquire_connection() picks it up.
+ *
+ * A connection still set up for the agent is the best choice, then one set
+ * up by another session with the same session parameters. Otherwise the
+ * most recently released connection is used, as before.
+ */
+static void
+prefer_session_slot(DatabasePool *dbPool, Oid node, PoolAgent *agent,
+					int session_version, uint32 session_fingerprint)
+{
+	PGXCNodePool *nodePool;
+	int			best = -1;
+	int			i;
+
+	if (session_version == 0)
+		return;
+
+	nodePool = (PGXCNodePool *) hash_search(dbPool->nodePools, &node,
+											HASH_FIND, NULL);
+	if (nodePool == NULL || nodePool->freeSize < 2)
+		return;
+
+	for (i = nodePool->freeSize - 1; i >= 0; i--)
+	{
+		PGXCNodePoolSlot *slot = nodePool->slot[i];
+
+		if (slot->session_owner == agent->serial &&
+			slot->session_version == session_version)
+		{
+			best = i;
+			break;
+		}
+		if (best < 0 && session_fingerprint != 0 &&
+			slot->session_fingerprint == session_fingerprint)
+			best = i;
+	}
+
+	if (best >= 0 && best != nodePool->freeSize - 1)
+	{
+		PGXCNodePoolSlot *slot = nodePool->slot[best];
+
+		nodePool->slot[best] = nodePool->slot[nodePool->freeSize - 1];
+		nodePool->slot[nodePool->freeSize - 1] = slot;
+	}
+}
+
+
 /*
  * cancel_query_on_connections
  *	  Cancel query running on connections managed by a PoolAgent.
@@ -2820,50 +3121,26 @@ acquire_connection(DatabasePool *dbPool, Oid node)
 	 * coordinators when creating or dropping databases.
 	 */
 	if (nodePool == NULL || nodePool->freeSize == 0)
+	{
+		PoolerNodeStats *stats = pooler_stats_begin(node);
+
+		if (stats)
+			stats->misses++;
+		pooler_stats_end();
+
 		nodePool = grow_pool(dbPool, node);
+	}
 
 	slot = NULL;
 
 	/* check available connections */
 	while (nodePool && nodePool->freeSize > 0)
 	{
-		int			poll_result;
-
 		slot = nodePool->slot[--(nodePool->freeSize)];
 
-	retry:
-		if (PQsocket((PGconn *) slot->conn) > 0)
-		{
-			/*
-			 * Check if the connection is ok, destroy the connection
-			 * slot if there is a problem.
-			 *
-			 * XXX Not sure how expensive this is, but perhaps we should
-			 * check the connections differently (not in the hot path
-			 * when requesting the connection, when every instruction
-			 * makes a difference). This seems particularly pointless
-			 * when the connection was just opened by grow_pool().
-			 *
-			 * XXX Perhaps we can do this only when the connection is
-			 * old enough (e.g. using slot->released)?
-			 */
-			poll_result = pqReadReady((PGconn *) slot->conn);
-
-			/* ok, no data - we have a working connection */
-			if (poll_result == 0)
-				break;
-
-			/* something went wrong - retry, if possible */
-			if (poll_result < 0)
-			{
-				if (errno == EAGAIN || errno == EINTR)
-					goto retry;
-
-				elog(WARNING, "Error in checking connection, errno = %d", errno);
-			}
-			else
-				elog(WARNING, "Unexpected data on connection, cleaning.");
-		}
+		/* ok, we have a working connection */
+		if (check_slot(slot))
+			break;
 
 		destroy_slot(slot);
 		slot = NULL;
@@ -2879,6 +3156,10 @@ acquire_connection(DatabasePool *dbPool, Oid node)
 	{
 		elog(WARNING, "can not connect to node %u", node);
 
+		/* Let the next requests have the connections idle sessions hold */
+		if (nodePool && nodePool->size >= MaxPoolSize)
+			reclaim_held_connections(dbPool, node);
+
 		/*
 		 * Before returning, update the node health status in shared
 		 * memory to indicate this node is down.
@@ -2889,16 +3170,106 @@ acquire_connection(DatabasePool *dbPool, Oid node)
 			elog(WARNING, "Health map updated to reflect DOWN node (%u)", node);
 	}
 	else
+	{
 		/*
 		 * XXX Is this necessary? Isn't this just another source of latency
 		 * in the connection-acquisition path?
 		 */
 		PgxcNodeUpdateHealth(node, true);
 
+		node_stats_add_active(node, 1);
+	}
+
 	return slot;
 }
 
 
+/*
+ * reclaim_held_connections
+ *	  Ask the sessions holding a connection to a node to release it.
+ *
+ * Sessions with session_connection_hold_time set keep their connections
+ * between transactions. When the node pool is exhausted, signal all the
+ * sessions of the pool that have a connection to the node; those that are
+ * idle give their connections back right away, the others at the end of
+ * their current transaction.
+ */
+static void
+reclaim_held_connections(DatabasePool *dbPool, Oid node)
+{
+	int			i,
+				j;
+
+	for (i = 0; i < agentCount; i++)
+	{
+		PoolAgent  *agent = poolAgents[i];
+		bool		holds = false;
+
+		if (agent->pool != dbPool || agent->pid == 0)
+			continue;
+
+		for (j = 0; j < agent->num_dn_connections && !holds; j++)
+			holds = (agent->dn_conn_oids[j] == node &&
+					 agent->dn_connections[j] != NULL);
+		for (j = 0; j < agent->num_coord_connections && !holds; j++)
+			holds = (agent->coord_conn_oids[j] == node &&
+					 agent->coord_connections[j] != NULL);
+
+		if (holds)
+			(void) SendProcSignal(agent->pid, PROCSIG_PGXCPOOL_RELEASE,
+								  InvalidBackendId);
+	}
+}
+
+
+/*
+ * check_slot
+ *	  Check that a pooled connection is still usable.
+ *
+ * There should be no data waiting on an idle connection. Anything else
+ * means the remote backend terminated, or the connection is broken.
+ *
+ * XXX Not sure how expensive this is, but perhaps we should check the
+ * connections differently (not in the hot path when requesting the
+ * connection, when every instruction makes a difference). This seems
+ * particularly pointless when the connection was just opened by
+ * grow_pool().
+ *
+ * XXX Perhaps we can do this only when the connection is old enough
+ * (e.g. using slot->released)?
+ */
+static bool
+check_slot(PGXCNodePoolSlot *slot)
+{
+	int			poll_result;
+
+	if (PQsocket((PGconn *) slot->conn) <= 0)
+		return false;
+
+	for (;;)
+	{
+		poll_result = pqReadReady((PGconn *) slot->conn);
+
+		/* ok, no data - we have a working connection */
+		if (poll_result == 0)
+			return true;
+
+		/* something went wrong - retry, if possible */
+		if (poll_result < 0)
+		{
+			if (errno == EAGAIN || errno == EINTR)
+				continue;
+
+			elog(WARNING, "Error in checking connection, errno = %d", errno);
+		}
+		else
+			elog(WARNING, "Unexpected data on connection, cleaning.");
+
+		return false;
+	}
+}
+
+
 /*
  * release_connection
  *	  Return a connection to a pool, or close it entirely.
@@ -2918,6 +3289,8 @@ release_connection(DatabasePool *dbPool, PGXCNodePoolSlot *slot,
 	Assert(slot);
 	Assert(OidIsValid(node));
 
+	node_stats_add_active(node, -1);
+
 	nodePool = (PGXCNodePool *) hash_search(dbPool->nodePools, &node,
 											HASH_FIND, NULL);
 
@@ -2963,17 +3336,12 @@ release_connection(DatabasePool *dbPool, PGXCNodePoolSlot *slot,
 
 
 /*
- * grow_pool
- *	  Increase size of a pool for a particular node if needed.
- *
- * If the node pool (for the specified node) does not exist, it will be
- * created automatically.
+ * lookup_node_pool
+ *	  Find the pool for a particular node, create it if needed.
  */
 static PGXCNodePool *
-grow_pool(DatabasePool *dbPool, Oid node)
+lookup_node_pool(DatabasePool *dbPool, Oid node)
 {
-	/* if error try to release idle connections and try again */
-	bool 			tryagain = true;
 	PGXCNodePool   *nodePool;
 	bool			found;
 
@@ -3014,6 +3382,50 @@ grow_pool(DatabasePool *dbPool, Oid node)
 		nodePool->size = 0;
 	}
 
+	return nodePool;
+}
+
+
+/*
+ * prepare_node_pool
+ *	  Lookup node pool and discard broken connections on top of it.
+ *
+ * The connection handed out next is the last free one, so make sure it
+ * is usable. When no usable connection remains, the caller opens a new one
+ * (possibly along with connections to other nodes).
+ */
+static PGXCNodePool *
+prepare_node_pool(DatabasePool *dbPool, Oid node)
+{
+	PGXCNodePool   *nodePool = lookup_node_pool(dbPool, node);
+
+	while (nodePool->freeSize > 0 &&
+		   !check_slot(nodePool->slot[nodePool->freeSize - 1]))
+	{
+		destroy_slot(nodePool->slot[--(nodePool->freeSize)]);
+		(nodePool->size)--;
+	}
+
+	return nodePool;
+}
+
+
+/*
+ * grow_pool
+ *	  Increase size of a pool for a particular node if needed.
+ *
+ * If the node pool (for the specified node) does not exist, it will be
+ * created automatically.
+ */
+static PGXCNodePool *
+grow_pool(DatabasePool *dbPool, Oid node)
+{
+	/* if error try to release idle connections and try again */
+	bool 			tryagain = true;
+	PGXCNodePool   *nodePool;
+
+	nodePool = lookup_node_pool(dbPool, node);
+
 	/*
 	 * If there are no free connections, try to create one. But do not
 	 * exceed MaxPoolSize, i.e. the maximum number of connections in
@@ -3021,23 +3433,97 @@ grow_pool(DatabasePool *dbPool, Oid node)
 	 */
 	while (nodePool->freeSize == 0 && nodePool->size < MaxPoolSize)
 	{
-		PGXCNodePoolSlot *slot;
+		if (connect_node_pools(dbPool, &nodePool, 1) > 0)
+			continue;
 
-		/* Allocate new slot */
-		slot = (PGXCNodePoolSlot *) palloc(sizeof(PGXCNodePoolSlot));
-		if (slot == NULL)
+		/*
+		 * If we failed to connect, probably number of connections on
+		 * the target node reached max_connections. Release idle from
+		 * this node, and retry.
+		 *
+		 * We do not want to enter endless loop here, so we only try
+		 * releasing idle connections once.
+		 *
+		 * It is not safe to run the maintenance from a pool with no
+		 * active connections, as the maintenance might kill the pool.
+		 *
+		 * XXX Maybe temporarily marking the pool, so that it does not
+		 * get removed (pinned=true) would do the trick?
+		 */
+		if (tryagain && nodePool->size > nodePool->freeSize)
 		{
-			ereport(ERROR,
-					(errcode(ERRCODE_OUT_OF_MEMORY),
-					 errmsg("out of memory")));
+			pools_maintenance();
+			tryagain = false;
+			continue;
 		}
+		break;
+	}
+
+	return nodePool;
+}
+
+
+/*
+ * connect_node_pools
+ *	  Open one new connection for each of the node pools without a free one.
+ *
+ * The connections are started with PQconnectStart and then all driven
+ * through the libpq state machine in a single poll() loop, so the time
+ * needed to open connections to several nodes is the time needed by the
+ * slowest one, not the sum of all of them. A node that does not complete
+ * the handshake within pool_connect_timeout is given up on.
+ *
+ * Pools that reached MaxPoolSize are skipped. Returns the number of
+ * connections added to the pools.
+ */
+static int
+connect_node_pools(DatabasePool *dbPool, PGXCNodePool **pools, int npools)
+{
+	PGXCNodePoolSlot  **slots;
+	PostgresPollingStatusType *states;
+	TimestampTz			start = GetCurrentTimestamp();
+	struct pollfd	   *pollfds;
+	int				   *pollidx;
+	int					pending = 0;
+	int					connected = 0;
+	time_t				deadline;
+	int					i;
+
+	slots = (PGXCNodePoolSlot **) palloc0(npools * sizeof(PGXCNodePoolSlot *));
+	states = (PostgresPollingStatusType *)
+		palloc(npools * sizeof(PostgresPollingStatusType));
+	pollfds = (struct pollfd *) palloc(npools * sizeof(struct pollfd));
+	pollidx = (int *) palloc(npools * sizeof(int));
+
+	/* Start the connections */
+	for (i = 0; i < npools; i++)
+	{
+		PGXCNodePool	   *nodePool = pools[i];
+		PGXCNodePoolSlot   *slot;
+		PoolerNodeStats	   *stats;
+
+		if (nodePool->size >= MaxPoolSize)
+		{
+			stats = pooler_stats_begin(nodePool->nodeoid);
+			if (stats)
+				stats->exhausted++;
+			pooler_stats_end();
+			continue;
+		}
+
+		slot = (PGXCNodePoolSlot *) palloc(sizeof(PGXCNodePoolSlot));
 
 		/* If connection fails, be sure that slot is destroyed cleanly */
 		slot->xc_cancelConn = NULL;
 
-		/* Establish connection */
-		slot->conn = PGXCNodeConnect(nodePool->connstr);
-		if (!PGXCNodeConnected(slot->conn))
+		/* New connection is in the default session state */
+		slot->session_owner = 0;
+		slot->session_version = 0;
+		slot->session_fingerprint = 0;
+
+		slot->conn = PGXCNodeConnectStart(nodePool->connstr);
+		if (slot->conn == NULL ||
+			PQstatus((PGconn *) slot->conn) == CONNECTION_BAD)
 		{
 			ereport(LOG,
 					(errcode(ERRCODE_CONNECTION_FAILURE),
@@ -3045,32 +3531,111 @@ grow_pool(DatabasePool *dbPool, Oid node)
 						  " connection error (%s)",
 						  nodePool->connstr,
 						  PQerrorMessage((PGconn*) slot->conn))));
-
 			destroy_slot(slot);
-
-			/*
-			 * If we failed to connect, probably number of connections on
-			 * the target node reached max_connections. Release idle from
-			 * this node, and retry.
-			 *
-			 * We do not want to enter endless loop here, so we only try
-			 * releasing idle connections once.
-			 *
-			 * It is not safe to run the maintenance from a pool with no
-			 * active connections, as the maintenance might kill the pool.
-			 *
-			 * XXX Maybe temporarily marking the pool, so that it does not
-			 * get removed (pinned=true) would do the trick?
-			 */
-			if (tryagain && nodePool->size > nodePool->freeSize)
-			{
-				pools_maintenance();
-				tryagain = false;
-				continue;
-			}
-			break;
+			stats = pooler_stats_begin(nodePool->nodeoid);
+			if (stats)
+				stats->connect_failures++;
+			pooler_stats_end();
+			continue;
 		}
 
+		/* libpq expects us to wait for the socket to become writable */
+		slots[i] = slot;
+		states[i] = PGRES_POLLING_WRITING;
+		pending++;
+	}
+
+	deadline = time(NULL) + PoolConnectTimeout;
+
+	/* Drive all the pending connections at once */
+	while (pending > 0)
+	{
+		int			nfds = 0;
+		int			timeout = -1;
+		int			rc;
+
+		for (i = 0; i < npools; i++)
+		{
+			if (slots[i] == NULL || states[i] == PGRES_POLLING_OK)
+				continue;
+
+			pollfds[nfds].fd = PQsocket((PGconn *) slots[i]->conn);
+			pollfds[nfds].events =
+				(states[i] == PGRES_POLLING_READING) ? POLLIN : POLLOUT;
+			pollfds[nfds].revents = 0;
+			pollidx[nfds++] = i;
+		}
+
+		if (PoolConnectTimeout > 0)
+		{
+			time_t		now = time(NULL);
+
+			timeout = (now < deadline) ? (int) (deadline - now) * 1000 : 0;
+		}
+
+		rc = poll(pollfds, nfds, timeout);
+		if (rc < 0 && errno == EINTR)
+			continue;
+
+		for (i = 0; i < nfds; i++)
+		{
+			int					idx = pollidx[i];
+			PGXCNodePoolSlot   *slot = slots[idx];
+			PoolerNodeStats	   *stats;
+
+			/* Nothing happened on this socket yet, unless we are giving up */
+			if (rc > 0 && pollfds[i].revents == 0)
+				continue;
+
+			if (rc > 0)
+				states[idx] = PQconnectPoll((PGconn *) slot->conn);
+			else
+				states[idx] = PGRES_POLLING_FAILED;
+
+			if (states[idx] == PGRES_POLLING_READING ||
+				states[idx] == PGRES_POLLING_WRITING)
+				continue;
+
+			pending--;
+
+			stats = pooler_stats_begin(pools[idx]->nodeoid);
+
+			if (states[idx] == PGRES_POLLING_OK &&
+				PGXCNodeConnected(slot->conn))
+			{
+				if (stats)
+					stats->connects++;
+				pooler_stats_end();
+				node_stats_add_latency(pools[idx]->nodeoid, start);
+				continue;
+			}
+
+			if (stats)
+				stats->connect_failures++;
+			pooler_stats_end();
+
+			ereport(LOG,
+					(errcode(ERRCODE_CONNECTION_FAILURE),
+					 errmsg("failed to connect to node, connection string (%s),"
+						  " connection error (%s)",
+						  pools[idx]->connstr,
+						  rc == 0 ? "timeout expired" :
+						  PQerrorMessage((PGconn*) slot->conn))));
+
+			destroy_slot(slot);
+			slots[idx] = NULL;
+		}
+	}
+
+	/* Insert the established connections into the node pools */
+	for (i = 0; i < npools; i++)
+	{
+		PGXCNodePool	   *nodePool = pools[i];
+		PGXCNodePoolSlot   *slot = slots[i];
+
+		if (slot == NULL)
+			continue;
+
 		slot->xc_cancelConn = (NODE_CANCEL *) PQgetCancel((PGconn *)slot->conn);
 		slot->released = time(NULL);
 
@@ -3087,14 +3652,19 @@ grow_pool(DatabasePool *dbPool, Oid node)
 
 		/* Increase the size of the node pool. */
 		(nodePool->size)++;
+		connected++;
 
-		elog(DEBUG1, "Pooler: increased pool size to %d for pool %s (%u)",
+		elog(DEBUG1, "Pooler: increased pool size to %d for pool %s",
 			 nodePool->size,
-			 nodePool->connstr,
-			 node);
+			 nodePool->connstr);
 	}
 
-	return nodePool;
+	pfree(slots);
+	pfree(states);
+	pfree(pollfds);
+	pfree(pollidx);
+
+	return connected;
 }
 
 
@@ -3227,6 +3797,19 @@ PoolerLoop(void)
 
 	initStringInfo(&input_message);
 
+	/* Remember the pools to prefill once the nodes are known */
+	pools_load_state();
+
+	/* Start the statistics afresh */
+	PoolerStats->changecount++;
+	pg_write_barrier();
+	PoolerStats->nnodes = 0;
+	MemSet(PoolerStats->nodes, 0,
+		   sizeof(PoolerNodeStats) * (MaxCoords + MaxDataNodes));
+	PoolerStats->stats_reset = GetCurrentTimestamp();
+	pg_write_barrier();
+	PoolerStats->changecount++;
+
 	pool_fd[0].fd = server_fd;
 	pool_fd[0].events = POLLIN; 
 
@@ -3294,6 +3877,9 @@ PoolerLoop(void)
 
 		if (shutdown_requested)
 		{
+			/* Record the busiest pools for the next pooler */
+			pools_save_state();
+
 			for (i = agentCount - 1; agentCount > 0 && i >= 0; i--)
 			{
 				PoolAgent  *agent = poolAgents[i];
@@ -3338,12 +3924,20 @@ PoolerLoop(void)
 			/* New session without an existing agent. */
 			if (pool_fd[0].revents & POLLIN)
 				agent_create();
+
+			/* Let the planner know about the current load of the nodes */
+			node_stats_publish();
 		}
 		else if (retval == 0)
 		{
 			/* maintenance timeout */
 			pools_maintenance();
 			PoolPingNodes();
+			pools_prefill();
+			pools_warm();
+			pools_save_state();
+			node_stats_recount();
+			node_stats_publish();
 			last_maintenance = time(NULL);
 		}
 	}
@@ -3511,6 +4105,7 @@ static char *
 build_node_conn_str(Oid node, DatabasePool *dbPool)
 {
 	NodeDefinition *nodeDef;
+	char 		   *host;
 	char 		   *connstr;
 
 	nodeDef = PgxcNodeGetDefinition(node);
@@ -3520,18 +4115,69 @@ build_node_conn_str(Oid node, DatabasePool *dbPool)
 		return NULL;
 	}
 
-	connstr = PGXCNodeConnStr(NameStr(nodeDef->nodehost),
+	host = node_conn_host(NameStr(nodeDef->nodehost));
+	connstr = PGXCNodeConnStr(host,
 							  nodeDef->nodeport,
 							  dbPool->database,
 							  dbPool->user_name,
 							  dbPool->pgoptions,
 							  IS_PGXC_COORDINATOR ? "coordinator" : "datanode",
 							  PGXCNodeName);
+	pfree(host);
 	pfree(nodeDef);
 
 	return connstr;
 }
 
+/*
+ * node_conn_host
+ *	  Host to connect to for a node defined on the given host.
+ *
+ * A node defined on a loopback address runs on this host, and is reached
+ * more cheaply through a Unix-domain socket than through the TCP stack.  We
+ * do not know where that node keeps its socket, but the nodes of a host
+ * usually share the socket directory, so try our own first.  libpq goes on
+ * with the next host of the list if nobody listens on the socket.
+ */
+static char *
+node_conn_host(const char *host)
+{
+	char	   *result = NULL;
+
+#ifdef HAVE_UNIX_SOCKETS
+	if (Unix_socket_directories &&
+		(strcmp(host, "localhost") == 0 ||
+		 strcmp(host, "127.0.0.1") == 0 ||
+		 strcmp(host, "::1") == 0))
+	{
+		char	   *rawstring;
+		List	   *elemlist;
+
+		/* Need a modifiable copy of Unix_socket_directories */
+		rawstring = pstrdup(Unix_socket_directories);
+
+		if (SplitDirectoriesString(rawstring, ',', &elemlist) &&
+			elemlist != NIL)
+		{
+			char	   *socketdir = (char *) linitial(elemlist);
+
+			/* The directory goes into the connection string unquoted */
+			if (is_absolute_path(socketdir) &&
+				strpbrk(socketdir, " ,'\\") == NULL)
+				result = psprintf("%s,%s", socketdir, host);
+		}
+
+		list_free_deep(elemlist);
+		pfree(rawstring);
+	}
+#endif
+
+	if (result == NULL)
+		result = pstrdup(host);
+
+	return result;
+}
+
 /*
  * shrink_pool
  *	  Close connections unused for more than PooledConnKeepAlive seconds.
@@ -3563,10 +4209,18 @@ shrink_pool(DatabasePool *pool)
 		{
 			PGXCNodePoolSlot *slot = nodePool->slot[i];
 
-			if (difftime(now, slot->released) > PoolConnKeepAlive)
+			/* keep min_pool_size connections warm */
+			if (difftime(now, slot->released) > PoolConnKeepAlive &&
+				nodePool->size > MinPoolSize)
 			{
+				PoolerNodeStats *stats;
+
 				/* connection is idle for long, close it */
 				destroy_slot(slot);
+				stats = pooler_stats_begin(nodePool->nodeoid);
+				if (stats)
+					stats->closed++;
+				pooler_stats_end();
 				/* reduce pool size and total number of connections */
 				(nodePool->freeSize)--;
 				(nodePool->size)--;
@@ -3660,6 +4314,588 @@ pools_maintenance(void)
 			difftime(time(NULL), now), count);
 }
 
+/*
+ * warm_database_pool
+ *	  Open connections in node pools smaller than min_pool_size.
+ *
+ * All the node pools are grown at once (one connection per node pool in
+ * each round), so that warming many nodes takes about as long as a single
+ * connection setup per round. We stop on the first round in which no
+ * connection could be opened, e.g. when the nodes are down.
+ *
+ * Empty node pools are only warmed with include_empty. Otherwise they are
+ * left to be removed by the regular maintenance, as the node pool may get
+ * emptied e.g. because the database was dropped or the node failed.
+ */
+static void
+warm_database_pool(DatabasePool *dbPool, bool include_empty)
+{
+	MemoryContext	oldcontext;
+	PGXCNodePool  **pools;
+	int				target = Min(MinPoolSize, MaxPoolSize);
+
+	oldcontext = MemoryContextSwitchTo(dbPool->mcxt);
+
+	pools = (PGXCNodePool **) palloc(hash_get_num_entries(dbPool->nodePools) *
+									 sizeof(PGXCNodePool *));
+
+	for (;;)
+	{
+		HASH_SEQ_STATUS hseq_status;
+		PGXCNodePool   *nodePool;
+		int				npools = 0;
+
+		hash_seq_init(&hseq_status, dbPool->nodePools);
+		while ((nodePool = (PGXCNodePool *) hash_seq_search(&hseq_status)))
+		{
+			if (nodePool->size < target &&
+				(include_empty || nodePool->size > 0))
+				pools[npools++] = nodePool;
+		}
+
+		if (npools == 0 || connect_node_pools(dbPool, pools, npools) == 0)
+			break;
+	}
+
+	pfree(pools);
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * pools_warm
+ *	  Keep at least min_pool_size connections in all node pools in use.
+ */
+static void
+pools_warm(void)
+{
+	DatabasePool   *dbPool;
+
+	if (MinPoolSize <= 0)
+		return;
+
+	for (dbPool = databasePools; dbPool; dbPool = dbPool->next)
+		warm_database_pool(dbPool, false);
+}
+
+/*
+ * pools_save_state
+ *	  Record the busiest database pools, so that the pooler can prefill
+ *	  them after restart.
+ *
+ * The file has one line per node pool, with tab-separated database name,
+ * user name, connection options and node OID. Only POOLER_STATE_MAX_POOLS
+ * database pools with the most open connections are recorded.
+ */
+static void
+pools_save_state(void)
+{
+	DatabasePool   *dbPool;
+	DatabasePool   *busiest[POOLER_STATE_MAX_POOLS];
+	int				sizes[POOLER_STATE_MAX_POOLS];
+	int				count = 0;
+	int				i;
+	FILE		   *fp;
+	const char	   *tmpfile = POOLER_STATE_FILE ".tmp";
+
+	if (MinPoolSize <= 0)
+		return;
+
+	/* pick the busiest database pools, sorted by the number of connections */
+	for (dbPool = databasePools; dbPool; dbPool = dbPool->next)
+	{
+		HASH_SEQ_STATUS hseq_status;
+		PGXCNodePool   *nodePool;
+		int				size = 0;
+
+		hash_seq_init(&hseq_status, dbPool->nodePools);
+		while ((nodePool = (PGXCNodePool *) hash_seq_search(&hseq_status)))
+			size += nodePool->size;
+
+		if (size == 0)
+			continue;
+
+		for (i = count; i > 0 && sizes[i - 1] < size; i--)
+		{
+			if (i < POOLER_STATE_MAX_POOLS)
+			{
+				busiest[i] = busiest[i - 1];
+				sizes[i] = sizes[i - 1];
+			}
+		}
+
+		if (i < POOLER_STATE_MAX_POOLS)
+		{
+			busiest[i] = dbPool;
+			sizes[i] = size;
+			count = Min(count + 1, POOLER_STATE_MAX_POOLS);
+		}
+	}
+
+	fp = AllocateFile(tmpfile, PG_BINARY_W);
+	if (fp == NULL)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", tmpfile)));
+		return;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		HASH_SEQ_STATUS hseq_status;
+		PGXCNodePool   *nodePool;
+
+		hash_seq_init(&hseq_status, busiest[i]->nodePools);
+		while ((nodePool = (PGXCNodePool *) hash_seq_search(&hseq_status)))
+		{
+			if (nodePool->size == 0)
+				continue;
+
+			fprintf(fp, "%s\t%s\t%s\t%u\n",
+					busiest[i]->database, busiest[i]->user_name,
+					busiest[i]->pgoptions ? busiest[i]->pgoptions : "",
+					nodePool->nodeoid);
+		}
+	}
+
+	if (ferror(fp) | FreeFile(fp))
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not write file \"%s\": %m", tmpfile)));
+		unlink(tmpfile);
+		return;
+	}
+
+	(void) durable_rename(tmpfile, POOLER_STATE_FILE, LOG);
+}
+
+/*
+ * pools_load_state
+ *	  Read the pools recorded by pools_save_state into poolPrefillList.
+ *
+ * Malformed lines are silently skipped, the file is only a hint.
+ */
+static void
+pools_load_state(void)
+{
+	FILE		   *fp;
+	char			line[MAXPGPATH * 4];
+	MemoryContext	oldcontext;
+
+	if (MinPoolSize <= 0)
+		return;
+
+	fp = AllocateFile(POOLER_STATE_FILE, PG_BINARY_R);
+	if (fp == NULL)
+		return;
+
+	oldcontext = MemoryContextSwitchTo(PoolerCoreContext);
+
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		char	   *fields[4];
+		char	   *pos = line;
+		int			nfields = 0;
+		PoolPrefillEntry *entry;
+
+		if (strchr(line, '\n') == NULL)
+			continue;
+		*strchr(line, '\n') = '\0';
+
+		while (nfields < 4)
+		{
+			fields[nfields++] = pos;
+			pos = strchr(pos, '\t');
+			if (pos == NULL)
+				break;
+			*pos++ = '\0';
+		}
+
+		if (nfields != 4 || pos != NULL)
+			continue;
+
+		entry = (PoolPrefillEntry *) palloc(sizeof(PoolPrefillEntry));
+		entry->database = pstrdup(fields[0]);
+		entry->user_name = pstrdup(fields[1]);
+		entry->pgoptions = pstrdup(fields[2]);
+		entry->nodeoid = (Oid) strtoul(fields[3], NULL, 10);
+
+		poolPrefillList = lappend(poolPrefillList, entry);
+	}
+
+	FreeFile(fp);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	elog(DEBUG1, "Pooler: loaded %d node pools to prefill",
+		 list_length(poolPrefillList));
+}
+
+/*
+ * pools_prefill
+ *	  Create and warm up the pools recorded by the previous pooler.
+ *
+ * The node definitions may not be loaded into the shared memory yet when
+ * the pooler starts, so we keep trying on each maintenance cycle until
+ * there are some nodes defined. Entries for nodes that do not exist
+ * (anymore) are discarded.
+ */
+static void
+pools_prefill(void)
+{
+	ListCell	   *lc;
+	List		   *warmed = NIL;
+	Oid			   *coOids;
+	Oid			   *dnOids;
+	int				numCo;
+	int				numDn;
+
+	if (poolPrefillList == NIL)
+		return;
+
+	PgxcNodeGetOids(&coOids, &dnOids, &numCo, &numDn, false);
+	pfree(coOids);
+	pfree(dnOids);
+
+	if (numCo + numDn == 0)
+		return;
+
+	foreach(lc, poolPrefillList)
+	{
+		PoolPrefillEntry *entry = (PoolPrefillEntry *) lfirst(lc);
+		DatabasePool   *dbPool;
+		NodeDefinition *nodeDef;
+		MemoryContext	oldcontext;
+
+		nodeDef = PgxcNodeGetDefinition(entry->nodeoid);
+		if (nodeDef == NULL)
+			continue;
+		pfree(nodeDef);
+
+		dbPool = find_database_pool(entry->database, entry->user_name,
+									entry->pgoptions);
+		if (dbPool == NULL)
+			dbPool = create_database_pool(entry->database, entry->user_name,
+										  entry->pgoptions);
+
+		oldcontext = MemoryContextSwitchTo(dbPool->mcxt);
+		lookup_node_pool(dbPool, entry->nodeoid);
+		MemoryContextSwitchTo(oldcontext);
+
+		warmed = list_append_unique_ptr(warmed, dbPool);
+	}
+
+	/* open the connections to all the nodes of a database pool at once */
+	if (MinPoolSize > 0)
+	{
+		foreach(lc, warmed)
+			warm_database_pool((DatabasePool *) lfirst(lc), true);
+	}
+
+	list_free(warmed);
+	list_free_deep(poolPrefillList);
+	poolPrefillList = NIL;
+}
+
+/*
+ * node_stats
+ *	  Lookup load statistics of a node, create the entry if needed.
+ */
+static PoolNodeStats *
+node_stats(Oid node)
+{
+	PoolNodeStats  *stats;
+	bool			found;
+
+	if (poolNodeStats == NULL)
+	{
+		HASHCTL		hinfo;
+
+		MemSet(&hinfo, 0, sizeof(hinfo));
+		hinfo.keysize = sizeof(Oid);
+		hinfo.entrysize = sizeof(PoolNodeStats);
+		hinfo.hcxt = PoolerCoreContext;
+
+		poolNodeStats = hash_create("Pooler Node Stats",
+									MaxDataNodes + MaxCoords, &hinfo,
+									HASH_ELEM | HASH_CONTEXT | HASH_BLOBS);
+	}
+
+	stats = (PoolNodeStats *) hash_search(poolNodeStats, &node,
+										  HASH_ENTER, &found);
+	if (!found)
+	{
+		stats->active = 0;
+		stats->latency = 0;
+		stats->dirty = false;
+	}
+
+	return stats;
+}
+
+/*
+ * node_stats_add_active
+ *	  Track a connection to the node handed out to (or returned by) a session.
+ */
+static void
+node_stats_add_active(Oid node, int delta)
+{
+	PoolNodeStats  *stats = node_stats(node);
+
+	stats->active = Max(stats->active + delta, 0);
+	stats->dirty = true;
+	poolNodeStatsDirty = true;
+}
+
+/*
+ * node_stats_add_latency
+ *	  Account for a new connection to the node, started at the given time.
+ *
+ * The latency is an exponential moving average, so that a node that got
+ * slow is noticed after a few connections.
+ */
+static void
+node_stats_add_latency(Oid node, TimestampTz start)
+{
+	PoolNodeStats  *stats = node_stats(node);
+	long			secs;
+	int				usecs;
+	int				latency;
+
+	TimestampDifference(start, GetCurrentTimestamp(), &secs, &usecs);
+	latency = (int) Min(secs * 1000000L + usecs, (long) INT_MAX);
+
+	if (stats->latency == 0)
+		stats->latency = Max(latency, 1);
+	else
+		stats->latency += (latency - stats->latency) / 5;
+
+	stats->dirty = true;
+	poolNodeStatsDirty = true;
+}
+
+/*
+ * node_stats_recount
+ *	  Recompute number of connections in use from the agents.
+ *
+ * The counters are maintained incrementally, but connections may also go
+ * away without being released (e.g. when the node definitions change), so
+ * let the maintenance fix any drift.
+ */
+static void
+node_stats_recount(void)
+{
+	HASH_SEQ_STATUS hseq_status;
+	PoolNodeStats  *stats;
+	int				i,
+					j;
+
+	if (poolNodeStats == NULL)
+		return;
+
+	hash_seq_init(&hseq_status, poolNodeStats);
+	while ((stats = (PoolNodeStats *) hash_seq_search(&hseq_status)))
+	{
+		if (stats->active != 0)
+			stats->dirty = true;
+		stats->active = 0;
+	}
+
+	for (i = 0; i < agentCount; i++)
+	{
+		PoolAgent  *agent = poolAgents[i];
+
+		for (j = 0; j < agent->num_dn_connections; j++)
+			if (agent->dn_connections && agent->dn_connections[j])
+				node_stats(agent->dn_conn_oids[j])->active++;
+
+		for (j = 0; j < agent->num_coord_connections; j++)
+			if (agent->coord_connections && agent->coord_connections[j])
+				node_stats(agent->coord_conn_oids[j])->active++;
+	}
+
+	hash_seq_init(&hseq_status, poolNodeStats);
+	while ((stats = (PoolNodeStats *) hash_seq_search(&hseq_status)))
+		if (stats->active != 0)
+			stats->dirty = true;
+
+	poolNodeStatsDirty = true;
+}
+
+/*
+ * node_stats_publish
+ *	  Copy the changed node statistics to the shared node table.
+ */
+static void
+node_stats_publish(void)
+{
+	HASH_SEQ_STATUS hseq_status;
+	PoolNodeStats  *stats;
+
+	if (!poolNodeStatsDirty)
+		return;
+
+	hash_seq_init(&hseq_status, poolNodeStats);
+	while ((stats = (PoolNodeStats *) hash_seq_search(&hseq_status)))
+	{
+		if (!stats->dirty)
+			continue;
+
+		PgxcNodeUpdateLoad(stats->nodeoid, stats->active, stats->latency);
+		stats->dirty = false;
+	}
+
+	poolNodeStatsDirty = false;
+}
+
+/*
+ * PoolerShmemSize
+ *	  Size of the shared memory for the pooler statistics.
+ */
+Size
+PoolerShmemSize(void)
+{
+	return add_size(offsetof(PoolerStatsData, nodes),
+					mul_size(sizeof(PoolerNodeStats), MaxCoords + MaxDataNodes));
+}
+
+/*
+ * PoolerShmemInit
+ *	  Allocate and reset the pooler statistics in shared memory.
+ */
+void
+PoolerShmemInit(void)
+{
+	bool		found;
+
+	PoolerStats = ShmemInitStruct("Pooler Stats", PoolerShmemSize(), &found);
+
+	if (!found)
+		MemSet(PoolerStats, 0, PoolerShmemSize());
+}
+
+/*
+ * pooler_stats_begin
+ *	  Start updating statistics of the node, returns NULL if there is no
+ *	  room for it. Must be followed by pooler_stats_end().
+ */
+static PoolerNodeStats *
+pooler_stats_begin(Oid node)
+{
+	int			i;
+
+	PoolerStats->changecount++;
+	pg_write_barrier();
+
+	for (i = 0; i < PoolerStats->nnodes; i++)
+		if (PoolerStats->nodes[i].nodeoid == node)
+			return &PoolerStats->nodes[i];
+
+	if (PoolerStats->nnodes >= MaxCoords + MaxDataNodes)
+		return NULL;
+
+	PoolerStats->nodes[i].nodeoid = node;
+	PoolerStats->nnodes++;
+
+	return &PoolerStats->nodes[i];
+}
+
+static void
+pooler_stats_end(void)
+{
+	pg_write_barrier();
+	PoolerStats->changecount++;
+}
+
+/*
+ * pooler_stats_count_wait
+ *	  Account for a connection request served, for each node requested.
+ */
+static void
+pooler_stats_count_wait(PoolAgent *agent, List *datanodelist,
+						List *coordlist, TimestampTz start)
+{
+	long		secs;
+	int			usecs;
+	int64		wait;
+	int			bucket;
+	ListCell   *lc;
+
+	TimestampDifference(start, GetCurrentTimestamp(), &secs, &usecs);
+	wait = (int64) secs * 1000000 + usecs;
+
+	for (bucket = 0; bucket < POOL_WAIT_BUCKETS - 1; bucket++)
+		if (wait < PoolWaitBucketBounds[bucket])
+			break;
+
+	foreach(lc, datanodelist)
+	{
+		PoolerNodeStats *stats;
+
+		stats = pooler_stats_begin(agent->dn_conn_oids[lfirst_int(lc)]);
+		if (stats)
+		{
+			stats->requests++;
+			stats->wait_time += wait;
+			stats->wait_hist[bucket]++;
+		}
+		pooler_stats_end();
+	}
+
+	foreach(lc, coordlist)
+	{
+		PoolerNodeStats *stats;
+
+		stats = pooler_stats_begin(agent->coord_conn_oids[lfirst_int(lc)]);
+		if (stats)
+		{
+			stats->requests++;
+			stats->wait_time += wait;
+			stats->wait_hist[bucket]++;
+		}
+		pooler_stats_end();
+	}
+}
+
+/*
+ * PoolerGetStats
+ *	  Get a consistent copy of the pooler statistics, allocated in the
+ *	  current memory context. Returns the number of nodes.
+ */
+int
+PoolerGetStats(PoolerNodeStats **stats, TimestampTz *stats_reset)
+{
+	Size		size = mul_size(sizeof(PoolerNodeStats), MaxCoords + MaxDataNodes);
+	PoolerNodeStats *copy = (PoolerNodeStats *) palloc(size);
+	int			nnodes;
+
+	for (;;)
+	{
+		uint32		before;
+		uint32		after;
+
+		before = PoolerStats->changecount;
+		pg_read_barrier();
+
+		nnodes = PoolerStats->nnodes;
+		memcpy(copy, PoolerStats->nodes, nnodes * sizeof(PoolerNodeStats));
+		*stats_reset = PoolerStats->stats_reset;
+
+		pg_read_barrier();
+		after = PoolerStats->changecount;
+
+		if (before == after && (before & 1) == 0)
+			break;
+
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	*stats = copy;
+	return nnodes;
+}
+
 bool
 check_persistent_connections(bool *newval, void **extra, GucSource source)
 {
@@ -3696,8 +4932,9 @@ PGXCNodeConnStr(char *host, int port, char *dbname,
 	 * XXX What's application remote type?
 	 */
 	num = snprintf(connstr, sizeof(connstr),
-				   "host=%s port=%d dbname=%s user=%s application_name='pgxc:%s' sslmode=disable options='-c remotetype=%s -c parentnode=%s %s'",
+				   "host=%s port=%d dbname=%s user=%s application_name='pgxc:%s' sslmode=disable options='-c remotetype=%s -c parentnode=%s%s %s'",
 				   host, port, dbname, user, parent_node, remote_type, parent_node,
+				   NetworkCompression ? " -c remotecompression=on" : "",
 				   pgoptions);
 
 	/* Check for overflow */
@@ -3715,16 +4952,19 @@ PGXCNodeConnStr(char *host, int port, char *dbname,
 
 
 /*
- * PGXCNodeConnect
- *	  Connect to a Datanode using a constructed connection string.
+ * PGXCNodeConnectStart
+ *	  Start connecting to a node using a constructed connection string.
+ *
+ * The connection is established in non-blocking mode, and has to be
+ * completed by polling it with PQconnectPoll (see connect_node_pools).
  */
 static NODE_CONNECTION *
-PGXCNodeConnect(char *connstr)
+PGXCNodeConnectStart(char *connstr)
 {
 	PGconn	   *conn;
 
 	/* Delegate call to the pglib */
-	conn = PQconnectdb(connstr);
+	conn = PQconnectStart(connstr);
 	return (NODE_CONNECTION *) conn;
 }
 
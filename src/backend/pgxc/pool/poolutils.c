@@ -28,13 +28,16 @@
 #include "pgxc/pgxcnode.h"
 #include "access/gtm.h"
 #include "access/xact.h"
+#include "catalog/pg_type.h"
 #include "catalog/pgxc_node.h"
 #include "commands/dbcommands.h"
 #include "commands/prepare.h"
+#include "funcapi.h"
 #include "storage/ipc.h"
 #include "storage/procarray.h"
 #include "storage/latch.h"
 #include "utils/acl.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
@@ -62,6 +65,90 @@ pgxc_pool_check(PG_FUNCTION_ARGS)
 	PG_RETURN_BOOL(PoolManagerCheckConnectionInfo());
 }
 
+/*
+ * pg_stat_get_pooler
+ *
+ * Return the statistics the pooler keeps for each remote node, backing the
+ * pg_stat_pooler view.
+ */
+Datum
+pg_stat_get_pooler(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_POOLER_COLS	10
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	PoolerNodeStats *stats;
+	TimestampTz stats_reset;
+	int			nnodes;
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	nnodes = PoolerGetStats(&stats, &stats_reset);
+
+	for (i = 0; i < nnodes; i++)
+	{
+		PoolerNodeStats *node = &stats[i];
+		Datum		values[PG_STAT_GET_POOLER_COLS];
+		bool		nulls[PG_STAT_GET_POOLER_COLS];
+		Datum		hist[POOL_WAIT_BUCKETS];
+		int			j;
+
+		MemSet(nulls, 0, sizeof(nulls));
+
+		for (j = 0; j < POOL_WAIT_BUCKETS; j++)
+			hist[j] = Int64GetDatum(node->wait_hist[j]);
+
+		values[0] = ObjectIdGetDatum(node->nodeoid);
+		values[1] = Int64GetDatum(node->requests);
+		values[2] = Int64GetDatum(node->misses);
+		values[3] = Int64GetDatum(node->connects);
+		values[4] = Int64GetDatum(node->connect_failures);
+		values[5] = Int64GetDatum(node->exhausted);
+		values[6] = Int64GetDatum(node->closed);
+		values[7] = Float8GetDatum((double) node->wait_time / 1000.0);
+		values[8] = PointerGetDatum(construct_array(hist, POOL_WAIT_BUCKETS,
+													INT8OID, sizeof(int64),
+													FLOAT8PASSBYVAL, 'd'));
+		if (stats_reset == 0)
+			nulls[9] = true;
+		else
+			values[9] = TimestampTzGetDatum(stats_reset);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
 /*
  * pgxc_pool_reload
  *
@@ -102,6 +189,13 @@ pgxc_pool_reload(PG_FUNCTION_ARGS)
 				(errcode(ERRCODE_ACTIVE_SQL_TRANSACTION),
 				 errmsg("pgxc_pool_reload cannot run inside a transaction block")));
 
+	/*
+	 * Sessions take the node definitions from the shared memory table as
+	 * they are, read pgxc_node again so that changes made since they were
+	 * loaded are picked up.
+	 */
+	PgxcNodeListAndCount();
+
 	/*
 	 * Always check if we can get away with a LESS destructive refresh
 	 * operation.
@@ -432,3 +526,24 @@ HandlePoolerRefresh(void)
 	/* make sure the event is processed in due course */
 	SetLatch(MyLatch);
 }
+
+/*
+ * HandlePoolerRelease
+ *
+ * This is called when PROCSIG_PGXCPOOL_RELEASE is activated, the pooler
+ * has run out of connections to a node this session holds one to.  Give
+ * the connections held between transactions back to the pool.
+ */
+void
+HandlePoolerRelease(void)
+{
+	if (proc_exit_inprogress)
+		return;
+
+	InterruptPending = true;
+
+	RequestReleaseRemoteHandles();
+
+	/* make sure the event is processed in due course */
+	SetLatch(MyLatch);
+}
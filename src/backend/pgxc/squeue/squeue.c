@@ -19,34 +19,45 @@
  */
 
 #include <sys/time.h>
+#include <unistd.h>
 #include "postgres.h"
 
 #include "miscadmin.h"
 #include "access/gtm.h"
 #include "catalog/pgxc_node.h"
 #include "commands/prepare.h"
+#include "common/pg_lzcompress.h"
 #include "executor/executor.h"
+#include "funcapi.h"
 #include "nodes/pg_list.h"
 #include "pgxc/nodemgr.h"
 #include "pgxc/pgxc.h"
 #include "pgxc/pgxcnode.h"
 #include "pgxc/squeue.h"
+#include "port/atomics.h"
+#include "portability/instr_time.h"
+#include "storage/dsm.h"
+#include "storage/fd.h"
 #include "storage/latch.h"
 #include "storage/lwlock.h"
 #include "storage/shmem.h"
+#include "utils/builtins.h"
 #include "utils/hsearch.h"
+#include "utils/memutils.h"
 #include "utils/resowner.h"
 #include "pgstat.h"
 
 
 int NSQueues = 64;
 int SQueueSize = 64;
+bool SQueueSpill = false;
+bool SQueueDynamic = false;
 
 #define LONG_TUPLE -42
 
 typedef struct ConsumerSync
 {
-	LWLock	   *cs_lwlock; 		/* Synchronize access to the consumer queue */
+	LWLock	   *cs_lwlock; 		/* Synchronize consumer status changes */
 	Latch 		cs_latch; 	/* The latch consumer is waiting on */
 } ConsumerSync;
 
@@ -82,20 +93,73 @@ typedef struct
 	 * Queue state. The queue is a cyclic queue where stored tuples in the
 	 * DataRow format, first goes the lengths of the tuple in host format,
 	 * because it never sent over network followed by tuple bytes.
+	 * Each consumer queue has exactly one producer and one consumer, so it is
+	 * organized as a lock-free single-producer/single-consumer ring. The
+	 * cs_qhead is the total number of bytes ever written to the queue and it
+	 * is advanced by the producer only, the cs_qtail is the total number of
+	 * bytes ever read and it is advanced by the consumer only. The position
+	 * in the ring is the counter value modulo cs_qlength. The cs_ntuples is
+	 * incremented by the producer after the tuple is completely written and
+	 * decremented by the consumer after the tuple is completely read, so it
+	 * is what publishes data to the other side. The cs_lwlock is only needed
+	 * to synchronize changes of the consumer status.
 	 */
-	int			cs_ntuples; 	/* Number of tuples in the queue */
+	pg_atomic_uint32 cs_ntuples; 	/* Number of tuples in the queue */
 	int			cs_status;	 	/* See CONSUMER_* defines above */
-	char	   *cs_qstart;		/* Where consumer queue begins */
+	/*
+	 * Where consumer queue begins. The queue may be located in a dynamic
+	 * shared memory segment, which is mapped to different addresses in
+	 * different processes, so the producer and consumer each store their
+	 * own pointer to the queue when binding. These are the only processes
+	 * accessing the queue data.
+	 */
+	Size		cs_qoffset;		/* Offset of the queue in the queue memory */
+	char	   *cs_pstart;		/* Queue start as mapped by the producer */
+	char	   *cs_cstart;		/* Queue start as mapped by the consumer */
 	int			cs_qlength;		/* The size of the consumer queue */
-	int			cs_qreadpos;	/* The read position in the consumer queue */
-	int			cs_qwritepos;	/* The write position in the consumer queue */
-#ifdef SQUEUE_STAT
-	long 		stat_writes;
-	long		stat_reads;
-	long 		stat_buff_writes;
-	long		stat_buff_reads;
-	long		stat_buff_returns;
-#endif
+	pg_atomic_uint64 cs_qhead;	/* Bytes written to the consumer queue */
+	pg_atomic_uint64 cs_qtail;	/* Bytes read from the consumer queue */
+	/*
+	 * Spill state. If shared_queue_spill is enabled and the consumer falls
+	 * behind, the producer writes the tuples buffered locally to a temporary
+	 * file in compressed batches, and the consumer reads them from the file
+	 * directly. The cs_spill_head is the size of complete batches in the file
+	 * advanced by the producer only, the cs_spill_tail is the offset of the
+	 * batch the consumer is reading, it is advanced by the consumer only when
+	 * the batch is completely read. The consumer always prefers the queue, and
+	 * the producer does not write to the queue until the spill file is
+	 * drained, so the tuple order is preserved. The spill file is a temporary
+	 * file of the producer, counted against its temp_file_limit, and removed
+	 * when the producer closes it or when its resource owner is released on
+	 * error. The producer publishes the path for the consumer to open the
+	 * file before it advances the spill head for the first time.
+	 */
+	pg_atomic_uint64 cs_spill_head;	/* Bytes of batches in the spill file */
+	pg_atomic_uint64 cs_spill_tail;	/* Offset of the batch being read */
+	int			cs_spill_pos;	/* Position in the batch being read */
+	int			cs_buffered;	/* Tuples buffered locally by the producer */
+	uint64		cs_spill_bytes;	/* Total bytes written to the spill file */
+	uint64		cs_spill_tuples; /* Total tuples written to the spill file */
+	File		cs_spill_file;	/* Spill file as opened by the producer, or 0 */
+	char		cs_spill_path[MAXPGPATH]; /* Path of the spill file */
+	/*
+	 * Bloom filter of the join keys the consumer is going to match the rows
+	 * against, the producer does not send rows with other keys. The filter
+	 * is written once by the consumer when it binds, before it sets
+	 * cs_filter_set, and the producer does not look at it until then.
+	 */
+	pg_atomic_uint32 cs_filter_set;
+	char		cs_filter[SQUEUE_FILTER_SIZE];
+	/*
+	 * Statistics shown by pg_stat_shared_queues. Each counter is advanced
+	 * either by the producer or by the consumer only, see SQ_STAT_INC.
+	 */
+	pg_atomic_uint64 stat_writes;		/* Tuples written by the producer */
+	pg_atomic_uint64 stat_reads;		/* Tuples read by the consumer */
+	pg_atomic_uint64 stat_buff_writes;	/* Tuples buffered by the producer */
+	pg_atomic_uint64 stat_buff_reads;	/* Buffered tuples moved to the queue */
+	pg_atomic_uint64 stat_buff_returns;	/* Buffered tuples put back */
+	pg_atomic_uint64 stat_long_tuples;	/* Tuples pushed through in parts */
 } ConsState;
 
 /* Shared queue header */
@@ -107,10 +171,15 @@ typedef struct SQueueHeader
 	int			sq_nodeid;		/* Node id of the producer parent */
 	SQueueSync *sq_sync;        /* Associated sinchronization objects */
 	int			sq_refcnt;		/* Reference count to this entry */
-#ifdef SQUEUE_STAT
-	bool		stat_finish;
-	long		stat_paused;
-#endif
+	bool		sq_spill;		/* Producer may use spill files */
+	dsm_handle	sq_dsm;			/* Segment holding consumer queues, or
+								 * DSM_HANDLE_INVALID if they follow the
+								 * header */
+	Size		sq_dsmsize;		/* Size of the segment */
+	bool		stat_finish;	/* Producer has reported finishing */
+	pg_atomic_uint64 stat_paused;	/* Times the producer paused */
+	pg_atomic_uint64 stat_wait_time;	/* Microseconds the producer waited
+										 * for the consumers */
 	int			sq_nconsumers;	/* Number of consumers */
 	ConsState 	sq_consumers[0];/* variable length array */
 } SQueueHeader;
@@ -128,6 +197,52 @@ static LWLockPadded *SQueueLocks = NULL;
  */
 static void *SQueueSyncs;
 
+/*
+ * If dynamic_shared_queues is enabled consumer queues are allocated in DSM
+ * segments when the shared queue is acquired. Segments of retired shared
+ * queues are kept in the pool for reuse, up to SQUEUE_DSM_POOL_SIZE of them.
+ * The pool is protected by SQueuesLock.
+ */
+typedef struct SQueueDsmPool
+{
+	int			sdp_nsegs;		/* Number of pooled segments */
+	struct
+	{
+		dsm_handle	handle;
+		Size		size;
+	}			sdp_segs[FLEXIBLE_ARRAY_MEMBER];
+} SQueueDsmPool;
+
+static SQueueDsmPool *SQueueDsm = NULL;
+
+#define SQUEUE_DSM_POOL_SIZE Max(NUM_SQUEUES / 4, 4)
+
+#define SQUEUE_DSM_POOL_SHMEM_SIZE \
+	add_size(offsetof(SQueueDsmPool, sdp_segs), \
+			 mul_size(SQUEUE_DSM_POOL_SIZE, \
+					  sizeof(((SQueueDsmPool *) NULL)->sdp_segs[0])))
+
+/* Smallest queue memory allocated per consumer */
+#define SQUEUE_DSM_MIN_SIZE (8 * BLCKSZ)
+
+/*
+ * The segments this backend is attached to. The mappings are kept until the
+ * backend is done with all the shared queues in the segment, so the same
+ * segment is not attached twice if producer and consumer share the process.
+ */
+typedef struct SQueueMapping
+{
+	dsm_handle	handle;
+	dsm_segment *seg;
+	int			refcount;
+} SQueueMapping;
+
+static List *SQueueMappings = NIL;
+
+/* Size of the shared queue hash entry */
+#define SQUEUE_ENTRY_SIZE \
+	(SQueueDynamic ? SQUEUE_HDR_SIZE(MaxDataNodes) : SQUEUE_SIZE)
+
 #define SQUEUE_SYNC_SIZE \
 	(sizeof(SQueueSync) + (MaxDataNodes-1) * sizeof(ConsumerSync))
 
@@ -137,57 +252,76 @@ static void *SQueueSyncs;
 #define SQUEUE_HDR_SIZE(nconsumers) \
 	(sizeof(SQueueHeader) + (nconsumers) * sizeof(ConsState))
 
-#define QUEUE_FREE_SPACE(cstate) \
-	((cstate)->cs_ntuples > 0 ? \
-		((cstate)->cs_qreadpos >= (cstate)->cs_qwritepos ? \
-			(cstate)->cs_qreadpos - (cstate)->cs_qwritepos : \
-			(cstate)->cs_qlength + (cstate)->cs_qreadpos \
-								 - (cstate)->cs_qwritepos) \
-		: (cstate)->cs_qlength)
-
-#define QUEUE_WRITE(cstate, len, buf) \
-	do \
-	{ \
-		if ((cstate)->cs_qwritepos + (len) <= (cstate)->cs_qlength) \
-		{ \
-			memcpy((cstate)->cs_qstart + (cstate)->cs_qwritepos, buf, len); \
-			(cstate)->cs_qwritepos += (len); \
-			if ((cstate)->cs_qwritepos == (cstate)->cs_qlength) \
-				(cstate)->cs_qwritepos = 0; \
-		} \
-		else \
-		{ \
-			int part = (cstate)->cs_qlength - (cstate)->cs_qwritepos; \
-			memcpy((cstate)->cs_qstart + (cstate)->cs_qwritepos, buf, part); \
-			(cstate)->cs_qwritepos = (len) - part; \
-			memcpy((cstate)->cs_qstart, (buf) + part, (cstate)->cs_qwritepos); \
-		} \
-	} while(0)
-
-
-#define QUEUE_READ(cstate, len, buf) \
-	do \
-	{ \
-		if ((cstate)->cs_qreadpos + (len) <= (cstate)->cs_qlength) \
-		{ \
-			memcpy(buf, (cstate)->cs_qstart + (cstate)->cs_qreadpos, len); \
-			(cstate)->cs_qreadpos += (len); \
-			if ((cstate)->cs_qreadpos == (cstate)->cs_qlength) \
-				(cstate)->cs_qreadpos = 0; \
-		} \
-		else \
-		{ \
-			int part = (cstate)->cs_qlength - (cstate)->cs_qreadpos; \
-			memcpy(buf, (cstate)->cs_qstart + (cstate)->cs_qreadpos, part); \
-			(cstate)->cs_qreadpos = (len) - part; \
-			memcpy((buf) + part, (cstate)->cs_qstart, (cstate)->cs_qreadpos); \
-		} \
-	} while(0)
+/*
+ * Number of tuples in the consumer queue, or LONG_TUPLE if the consumer is
+ * waiting for the next portion of a long tuple.
+ */
+#define QUEUE_NTUPLES(cstate) \
+	((int32) pg_atomic_read_u32(&(cstate)->cs_ntuples))
+
+#define QUEUE_USED_SPACE(cstate) \
+	((int) (pg_atomic_read_u64(&(cstate)->cs_qhead) - \
+			pg_atomic_read_u64(&(cstate)->cs_qtail)))
+
+/*
+ * Advance a statistics counter. Every counter has a single writer, so it is
+ * updated without a locked instruction, and readers see either the old or
+ * the new value.
+ */
+#define SQ_STAT_ADD(counter, n) \
+	pg_atomic_write_u64(&(counter), pg_atomic_read_u64(&(counter)) + (n))
+#define SQ_STAT_INC(counter) SQ_STAT_ADD(counter, 1)
+
+/* True if the consumer has read everything from the spill file */
+#define SPILL_DRAINED(cstate) \
+	(pg_atomic_read_u64(&(cstate)->cs_spill_head) == \
+	 pg_atomic_read_u64(&(cstate)->cs_spill_tail))
+
+/*
+ * Flush the tuples buffered by the producer to the spill file when that many
+ * are accumulated. The batch size in bytes is limited by the consumer queue
+ * length, larger amount of buffered data is written out as multiple batches.
+ */
+#define SPILL_BATCH_TUPLES 1024
+
+/* Header of a batch in the spill file, followed by the batch data */
+typedef struct SpillBatchHeader
+{
+	int32		sb_rawlen;		/* Length of the batch data */
+	int32		sb_complen;		/* Length of the compressed batch data, or -1
+								 * if stored uncompressed */
+	int32		sb_ntuples;		/* Number of tuples in the batch */
+} SpillBatchHeader;
+
+/*
+ * The batch the consumer is currently reading from the spill file, kept
+ * decompressed in backend local memory.
+ */
+static SharedQueue sq_spill_squeue = NULL;
+static int		sq_spill_consumer = -1;
+static uint64	sq_spill_offset = 0;
+static char	   *sq_spill_data = NULL;
+static int		sq_spill_datalen = 0;
+static int		sq_spill_batchlen = 0;
 
+static inline int sq_free_space(ConsState *cstate);
+static inline void sq_queue_write(ConsState *cstate, int len, const char *buf);
+static inline void sq_queue_read(ConsState *cstate, int len, char *buf);
 
 static bool sq_push_long_tuple(ConsState *cstate, RemoteDataRow datarow);
-static void sq_pull_long_tuple(ConsState *cstate, RemoteDataRow datarow,
-							   int consumerIdx, SQueueSync *sqsync);
+static void sq_pull_long_tuple(SharedQueue squeue, RemoteDataRow datarow,
+							   int consumerIdx);
+static void sq_spill_flush(SharedQueue squeue, int consumerIdx,
+			   TupleTableSlot *tmpslot, Tuplestorestate *tuplestore);
+static void sq_spill_read(SharedQueue squeue, int consumerIdx,
+			  TupleTableSlot *slot);
+static void sq_spill_reset(void);
+static Size sq_dsm_allocate(const char *sqname, int ncons, double rows,
+				int width, dsm_handle *handle);
+static void sq_dsm_put(dsm_handle handle, Size size);
+static void sq_dsm_release(SharedQueue sq);
+static char *sq_attach(SharedQueue sq);
+static void sq_detach(SharedQueue sq);
 
 /*
  * SharedQueuesInit
@@ -202,7 +336,7 @@ SharedQueuesInit(void)
 	bool 	found;
 
 	info.keysize = SQUEUE_KEYSIZE;
-	info.entrysize = SQUEUE_SIZE;
+	info.entrysize = SQUEUE_ENTRY_SIZE;
 
 	/*
 	 * Create hash table of fixed size to avoid running out of
@@ -213,6 +347,15 @@ SharedQueuesInit(void)
 	SharedQueues = ShmemInitHash("Shared Queues", NUM_SQUEUES,
 								 NUM_SQUEUES, &info, hash_flags);
 
+	if (SQueueDynamic)
+	{
+		SQueueDsm = (SQueueDsmPool *) ShmemInitStruct("Shared Queues DSM Pool",
+													  SQUEUE_DSM_POOL_SHMEM_SIZE,
+													  &found);
+		if (!found)
+			SQueueDsm->sdp_nsegs = 0;
+	}
+
 	/*
 	 * Synchronization stuff is in separate structure because we need to
 	 * initialize all items now while in the postmaster.
@@ -272,7 +415,9 @@ SharedQueueShmemSize(void)
 	Size sqs_size;
 
 	sqs_size = mul_size(NUM_SQUEUES, SQUEUE_SYNC_SIZE);
-	return add_size(sqs_size, hash_estimate_size(NUM_SQUEUES, SQUEUE_SIZE));
+	if (SQueueDynamic)
+		sqs_size = add_size(sqs_size, SQUEUE_DSM_POOL_SHMEM_SIZE);
+	return add_size(sqs_size, hash_estimate_size(NUM_SQUEUES, SQUEUE_ENTRY_SIZE));
 }
 
 /*
@@ -282,13 +427,17 @@ SharedQueueShmemSize(void)
  * registered on the Datanode. The number of consumers is known at this point,
  * so shared queue may be formatted during reservation. The first process that
  * is acquiring the shared queue on the Datanode does the formatting.
+ * The rows and width are the planner's estimates for the producing subplan,
+ * they are used to size the queue if dynamic_shared_queues is enabled.
  */
 void
-SharedQueueAcquire(const char *sqname, int ncons)
+SharedQueueAcquire(const char *sqname, int ncons, double rows, int width)
 {
 	bool		found;
 	SharedQueue sq;
 	int trycount = 0;
+	dsm_handle	dsm = DSM_HANDLE_INVALID;
+	Size		dsmsize = 0;
 
 	Assert(IsConnFromDatanode());
 	Assert(ncons > 0);
@@ -303,17 +452,29 @@ tryagain:
 	PGXC_PARENT_NODE_ID = PGXCNodeGetNodeIdFromName(PGXC_PARENT_NODE,
 			&PGXC_PARENT_NODE_TYPE);
 
-	sq = (SharedQueue) hash_search(SharedQueues, sqname, HASH_ENTER, &found);
+	/*
+	 * The DSM segment of a new queue is set up before the queue is entered
+	 * into the hash table, so failing to get one leaves nothing behind.
+	 */
+	if (SQueueDynamic &&
+		hash_search(SharedQueues, sqname, HASH_FIND, NULL) == NULL)
+		dsmsize = sq_dsm_allocate(sqname, ncons, rows, width, &dsm);
+
+	sq = (SharedQueue) hash_search(SharedQueues, sqname, HASH_ENTER_NULL,
+								   &found);
 	if (!sq)
+	{
+		sq_dsm_put(dsm, dsmsize);
 		ereport(ERROR, (errcode(ERRCODE_INTERNAL_ERROR),
 				errmsg("out of shared queue, please increase shared_queues")));
+	}
 
 	/* First process acquiring queue should format it */
 	if (!found)
 	{
 		int		qsize;   /* Size of one queue */
 		int		i;
-		char   *heapPtr;
+		Size	offset;
 
 		elog(DEBUG1, "Create a new SQueue %s and format it for %d consumers", sqname, ncons);
 
@@ -321,10 +482,12 @@ tryagain:
 		sq->sq_pid = 0;
 		sq->sq_nodeid = -1;
 		sq->sq_refcnt = 1;
-#ifdef SQUEUE_STAT
+		sq->sq_spill = false;
+		sq->sq_dsm = dsm;
+		sq->sq_dsmsize = dsmsize;
 		sq->stat_finish = false;
-		sq->stat_paused = 0;
-#endif
+		pg_atomic_init_u64(&sq->stat_paused, 0);
+		pg_atomic_init_u64(&sq->stat_wait_time, 0);
 		/*
 		 * Assign sync object (latches to wait on)
 		 * XXX We may want to optimize this and do smart search instead of
@@ -344,12 +507,20 @@ tryagain:
 		Assert(sq->sq_sync != NULL);
 
 		sq->sq_nconsumers = ncons;
-		/* Determine queue size for a single consumer */
-		qsize = (SQUEUE_SIZE - SQUEUE_HDR_SIZE(sq->sq_nconsumers)) / sq->sq_nconsumers;
+		if (SQueueDynamic)
+		{
+			/* Consumer queues are in the DSM segment */
+			qsize = sq->sq_dsmsize / sq->sq_nconsumers;
+			offset = 0;
+		}
+		else
+		{
+			/* Determine queue size for a single consumer */
+			qsize = (SQUEUE_SIZE - SQUEUE_HDR_SIZE(sq->sq_nconsumers)) / sq->sq_nconsumers;
+			/* Skip header */
+			offset = SQUEUE_HDR_SIZE(sq->sq_nconsumers);
+		}
 
-		heapPtr = (char *) sq;
-		/* Skip header */
-		heapPtr += SQUEUE_HDR_SIZE(sq->sq_nconsumers);
 		/* Set up consumer queues */
 		for (i = 0; i < ncons; i++)
 		{
@@ -357,15 +528,32 @@ tryagain:
 
 			cstate->cs_pid = 0;
 			cstate->cs_node = -1;
-			cstate->cs_ntuples = 0;
+			pg_atomic_init_u32(&cstate->cs_ntuples, 0);
 			cstate->cs_status = CONSUMER_ACTIVE;
-			cstate->cs_qstart = heapPtr;
+			cstate->cs_qoffset = offset;
+			cstate->cs_pstart = NULL;
+			cstate->cs_cstart = NULL;
 			cstate->cs_qlength = qsize;
-			cstate->cs_qreadpos = 0;
-			cstate->cs_qwritepos = 0;
-			heapPtr += qsize;
+			pg_atomic_init_u64(&cstate->cs_qhead, 0);
+			pg_atomic_init_u64(&cstate->cs_qtail, 0);
+			pg_atomic_init_u64(&cstate->cs_spill_head, 0);
+			pg_atomic_init_u64(&cstate->cs_spill_tail, 0);
+			cstate->cs_spill_pos = 0;
+			cstate->cs_buffered = 0;
+			cstate->cs_spill_bytes = 0;
+			cstate->cs_spill_tuples = 0;
+			cstate->cs_spill_file = 0;
+			cstate->cs_spill_path[0] = '\0';
+			pg_atomic_init_u32(&cstate->cs_filter_set, 0);
+			pg_atomic_init_u64(&cstate->stat_writes, 0);
+			pg_atomic_init_u64(&cstate->stat_reads, 0);
+			pg_atomic_init_u64(&cstate->stat_buff_writes, 0);
+			pg_atomic_init_u64(&cstate->stat_buff_reads, 0);
+			pg_atomic_init_u64(&cstate->stat_buff_returns, 0);
+			pg_atomic_init_u64(&cstate->stat_long_tuples, 0);
+			offset += qsize;
 		}
-		Assert(heapPtr <= ((char *) sq) + SQUEUE_SIZE);
+		Assert(SQueueDynamic ? offset <= sq->sq_dsmsize : offset <= SQUEUE_SIZE);
 	}
 	else
 	{
@@ -382,7 +570,7 @@ tryagain:
 					sqname, i,
 					sq->sq_consumers[i].cs_pid, 
 					sq->sq_consumers[i].cs_node, 
-					sq->sq_consumers[i].cs_ntuples, 
+					QUEUE_NTUPLES(&sq->sq_consumers[i]),
 					sq->sq_consumers[i].cs_status); 
 		}
 
@@ -491,6 +679,7 @@ SharedQueueBind(const char *sqname, List *consNodes,
 		/* Producer */
 		int		i;
 		ListCell *lc;
+		char   *base;
 
 		Assert(consMap);
 
@@ -500,8 +689,15 @@ SharedQueueBind(const char *sqname, List *consNodes,
 		/* Initialize the shared queue */
 		sq->sq_pid = MyProcPid;
 		sq->sq_nodeid = PGXC_PARENT_NODE_ID;
+		sq->sq_spill = SQueueSpill;
 		OwnLatch(&sq->sq_sync->sqs_producer_latch);
 
+		/* Producer writes to all the consumer queues */
+		base = sq_attach(sq);
+		for (i = 0; i < sq->sq_nconsumers; i++)
+			sq->sq_consumers[i].cs_pstart = base +
+				sq->sq_consumers[i].cs_qoffset;
+
 		i = 0;
 		foreach(lc, distNodes)
 		{
@@ -664,6 +860,8 @@ SharedQueueBind(const char *sqname, List *consNodes,
 
 						/* Set up the consumer */
 						cstate->cs_pid = MyProcPid;
+						cstate->cs_cstart = sq_attach(sq) + cstate->cs_qoffset;
+						sq_spill_reset();
 
 						elog(DEBUG1, "SQueue %s, consumer at %d, status %d - "
 								"setting up consumer node %d, pid %d",
@@ -747,28 +945,40 @@ SharedQueueDump(SharedQueue squeue, int consumerIdx,
 					squeue->sq_key);
 			break;
 		}
-#ifdef SQUEUE_STAT
-		cstate->stat_buff_reads++;
-#endif
+		SQ_STAT_INC(cstate->stat_buff_reads);
 
 		/* The slot should contain a data row */
 		Assert(tmpslot->tts_datarow);
 
 		/* check if queue has enough room for the data */
-		if (QUEUE_FREE_SPACE(cstate) < sizeof(int) + tmpslot->tts_datarow->msglen)
+		if (sq_free_space(cstate) < sizeof(int) + tmpslot->tts_datarow->msglen)
 		{
 			/*
 			 * If stored tuple does not fit empty queue we are entering special
 			 * procedure of pushing it through.
 			 */
-			if (cstate->cs_ntuples <= 0)
+			if (QUEUE_NTUPLES(cstate) <= 0)
 			{
+				bool done;
+
+				/*
+				 * If spill file is allowed do not bother pushing the long
+				 * tuple through, put it and everything after it to the spill
+				 * file and let the consumer read it from there.
+				 */
+				if (squeue->sq_spill)
+				{
+					tuplestore_copy_read_pointer(tuplestore, 0, 1);
+					sq_spill_flush(squeue, consumerIdx, tmpslot, tuplestore);
+					return true;
+				}
+
 				/*
 				 * If pushing throw is completed wake up and proceed to next
 				 * tuple, there could be enough space in the consumer queue to
 				 * fit more.
 				 */
-				bool done = sq_push_long_tuple(cstate, tmpslot->tts_datarow);
+				done = sq_push_long_tuple(cstate, tmpslot->tts_datarow);
 
 				/*
 				 * sq_push_long_tuple writes some data anyway, so wake up
@@ -782,9 +992,7 @@ SharedQueueDump(SharedQueue squeue, int consumerIdx,
 
 			/* Restore read position to get same tuple next time */
 			tuplestore_copy_read_pointer(tuplestore, 0, 1);
-#ifdef SQUEUE_STAT
-			cstate->stat_buff_returns++;
-#endif
+			SQ_STAT_INC(cstate->stat_buff_returns);
 
 			/* We might advance the mark, try to truncate */
 			tuplestore_trim(tuplestore);
@@ -798,18 +1006,19 @@ SharedQueueDump(SharedQueue squeue, int consumerIdx,
 		else
 		{
 			/* Enqueue data */
-			QUEUE_WRITE(cstate, sizeof(int), (char *) &tmpslot->tts_datarow->msglen);
-			QUEUE_WRITE(cstate, tmpslot->tts_datarow->msglen, tmpslot->tts_datarow->msg);
+			sq_queue_write(cstate, sizeof(int), (char *) &tmpslot->tts_datarow->msglen);
+			sq_queue_write(cstate, tmpslot->tts_datarow->msglen, tmpslot->tts_datarow->msg);
 
 			/* Increment tuple counter. If it was 0 consumer may be waiting for
 			 * data so try to wake it up */
-			if ((cstate->cs_ntuples)++ == 0)
+			if (pg_atomic_fetch_add_u32(&cstate->cs_ntuples, 1) == 0)
 				SetLatch(&squeue->sq_sync->sqs_consumer_sync[consumerIdx].cs_latch);
 		}
 	}
 
 	/* Remove rows we have just read */
 	tuplestore_trim(tuplestore);
+	cstate->cs_buffered = 0;
 
 	/* prepare for writes, set read pointer 0 as active */
 	tuplestore_select_read_pointer(tuplestore, 0);
@@ -818,12 +1027,86 @@ SharedQueueDump(SharedQueue squeue, int consumerIdx,
 }
 
 
+/*
+ * SharedQueueSetFilter
+ *    Publish the Bloom filter of the join keys of the specified consumer, so
+ * the producer only sends it the rows which may find a match.
+ */
+void
+SharedQueueSetFilter(SharedQueue squeue, int consumerIdx, const char *filter)
+{
+	ConsState  *cstate = &(squeue->sq_consumers[consumerIdx]);
+
+	memcpy(cstate->cs_filter, filter, SQUEUE_FILTER_SIZE);
+	pg_write_barrier();
+	pg_atomic_write_u32(&cstate->cs_filter_set, 1);
+}
+
+
+/*
+ * SharedQueueGetFilter
+ *    Returns the Bloom filter of the join keys of the specified consumer, or
+ * NULL if the consumer has not provided one (yet).
+ */
+const char *
+SharedQueueGetFilter(SharedQueue squeue, int consumerIdx)
+{
+	ConsState  *cstate = &(squeue->sq_consumers[consumerIdx]);
+
+	if (pg_atomic_read_u32(&cstate->cs_filter_set) == 0)
+		return NULL;
+	pg_read_barrier();
+	return cstate->cs_filter;
+}
+
+
+/*
+ * The Bloom filter sets SQUEUE_FILTER_HASHES bits per key, derived from the
+ * 32-bit hash of the key using double hashing.
+ */
+#define SQUEUE_FILTER_BITS		(SQUEUE_FILTER_SIZE * BITS_PER_BYTE)
+#define SQUEUE_FILTER_HASHES	3
+
+void
+SharedQueueFilterAdd(char *filter, uint32 hash)
+{
+	uint32		h2 = ((hash >> 17) | (hash << 15)) | 1;
+	int			i;
+
+	for (i = 0; i < SQUEUE_FILTER_HASHES; i++)
+	{
+		uint32		bit = (hash + i * h2) % SQUEUE_FILTER_BITS;
+
+		filter[bit / BITS_PER_BYTE] |= (1 << (bit % BITS_PER_BYTE));
+	}
+}
+
+bool
+SharedQueueFilterTest(const char *filter, uint32 hash)
+{
+	uint32		h2 = ((hash >> 17) | (hash << 15)) | 1;
+	int			i;
+
+	for (i = 0; i < SQUEUE_FILTER_HASHES; i++)
+	{
+		uint32		bit = (hash + i * h2) % SQUEUE_FILTER_BITS;
+
+		if ((filter[bit / BITS_PER_BYTE] & (1 << (bit % BITS_PER_BYTE))) == 0)
+			return false;
+	}
+	return true;
+}
+
+
 /*
  * SharedQueueWrite
  *    Write data from the specified slot to the specified queue. If the
  * tuplestore passed in has tuples try and write them first.
  * If specified queue is full the tuple is put into the tuplestore which is
  * created if necessary
+ * The producer is the only writer of the consumer queue, so no lock is taken
+ * here. If the consumer changes its status concurrently we may write out a
+ * tuple nobody is going to read, which is harmless.
  */
 void
 SharedQueueWrite(SharedQueue squeue, int consumerIdx,
@@ -832,17 +1115,12 @@ SharedQueueWrite(SharedQueue squeue, int consumerIdx,
 {
 	ConsState  *cstate = &(squeue->sq_consumers[consumerIdx]);
 	SQueueSync *sqsync = squeue->sq_sync;
-	LWLockId    clwlock = sqsync->sqs_consumer_sync[consumerIdx].cs_lwlock;
 	RemoteDataRow datarow;
 	bool		free_datarow;
 
 	Assert(cstate->cs_qlength > 0);
 
-	LWLockAcquire(clwlock, LW_EXCLUSIVE);
-
-#ifdef SQUEUE_STAT
-	cstate->stat_writes++;
-#endif
+	SQ_STAT_INC(cstate->stat_writes);
 
 	/*
 	 * If we have anything in the local storage try to dump this first,
@@ -853,7 +1131,12 @@ SharedQueueWrite(SharedQueue squeue, int consumerIdx,
 	{
 		bool dumped = false;
 
-		if (QUEUE_FREE_SPACE(cstate) > cstate->cs_qlength / 2)
+		/*
+		 * Tuples in the local storage are newer then ones in the spill file,
+		 * so they can go to the queue only when the spill file is drained.
+		 */
+		if (SPILL_DRAINED(cstate) &&
+				sq_free_space(cstate) > cstate->cs_qlength / 2)
 		{
 			TupleTableSlot *tmpslot;
 
@@ -865,11 +1148,25 @@ SharedQueueWrite(SharedQueue squeue, int consumerIdx,
 		{
 			/* No room to even dump local store, append the tuple to the store
 			 * and exit */
-#ifdef SQUEUE_STAT
-			cstate->stat_buff_writes++;
-#endif
-			LWLockRelease(clwlock);
+			SQ_STAT_INC(cstate->stat_buff_writes);
 			tuplestore_puttupleslot(*tuplestore, slot);
+			/*
+			 * Consumer is behind, move buffered tuples to the spill file.
+			 * Do not wait for a full batch if the query is running out of
+			 * memory.
+			 */
+			if (squeue->sq_spill &&
+				(++(cstate->cs_buffered) >= SPILL_BATCH_TUPLES ||
+				 (query_memory_limit >= 0 &&
+				  cstate->cs_buffered % (SPILL_BATCH_TUPLES / 16) == 0 &&
+				  ExecCheckQueryMemory(NULL, true))))
+			{
+				TupleTableSlot *tmpslot;
+
+				tmpslot = MakeSingleTupleTableSlot(slot->tts_tupleDescriptor);
+				sq_spill_flush(squeue, consumerIdx, tmpslot, *tuplestore);
+				ExecDropSingleTupleTableSlot(tmpslot);
+			}
 			return;
 		}
 	}
@@ -889,10 +1186,10 @@ SharedQueueWrite(SharedQueue squeue, int consumerIdx,
 		datarow = ExecCopySlotDatarow(slot, tmpcxt);
 		free_datarow = true;
 	}
-	if (QUEUE_FREE_SPACE(cstate) < sizeof(int) + datarow->msglen)
+	if (!SPILL_DRAINED(cstate) ||
+			sq_free_space(cstate) < sizeof(int) + datarow->msglen)
 	{
 		/* Not enough room, store tuple locally */
-		LWLockRelease(clwlock);
 
 		/* clean up */
 		if (free_datarow)
@@ -904,10 +1201,10 @@ SharedQueueWrite(SharedQueue squeue, int consumerIdx,
 			int			ptrno;
 			char 		storename[64];
 
-#ifdef SQUEUE_STAT
-			elog(DEBUG1, "Start buffering %s node %d, %d tuples in queue, %ld writes and %ld reads so far",
-				 squeue->sq_key, cstate->cs_node, cstate->cs_ntuples, cstate->stat_writes, cstate->stat_reads);
-#endif
+			elog(DEBUG1, "Start buffering %s node %d, %d tuples in queue, " UINT64_FORMAT " writes and " UINT64_FORMAT " reads so far",
+				 squeue->sq_key, cstate->cs_node, QUEUE_NTUPLES(cstate),
+				 pg_atomic_read_u64(&cstate->stat_writes),
+				 pg_atomic_read_u64(&cstate->stat_reads));
 			*tuplestore = tuplestore_begin_datarow(false, work_mem, tmpcxt);
 			/* We need is to be able to remember/restore the read position */
 			snprintf(storename, 64, "%s node %d", squeue->sq_key, cstate->cs_node);
@@ -920,11 +1217,11 @@ SharedQueueWrite(SharedQueue squeue, int consumerIdx,
 			Assert(ptrno == 1);
 		}
 
-#ifdef SQUEUE_STAT
-		cstate->stat_buff_writes++;
-#endif
+		SQ_STAT_INC(cstate->stat_buff_writes);
 		/* Append the slot to the store... */
 		tuplestore_puttupleslot(*tuplestore, slot);
+		if (squeue->sq_spill)
+			cstate->cs_buffered++;
 
 		/* ... and exit */
 		return;
@@ -937,11 +1234,16 @@ SharedQueueWrite(SharedQueue squeue, int consumerIdx,
 			elog(DEBUG3, "SQueue %s, consumer is active, writing data",
 					squeue->sq_key);
 			/* write out the data */
-			QUEUE_WRITE(cstate, sizeof(int), (char *) &datarow->msglen);
-			QUEUE_WRITE(cstate, datarow->msglen, datarow->msg);
-			/* Increment tuple counter. If it was 0 consumer may be waiting for
-			 * data so try to wake it up */
-			if ((cstate->cs_ntuples)++ == 0)
+			sq_queue_write(cstate, sizeof(int), (char *) &datarow->msglen);
+			sq_queue_write(cstate, datarow->msglen, datarow->msg);
+			/*
+			 * Increment tuple counter, that makes the tuple visible to the
+			 * consumer. If it was 0 consumer may be waiting for data so try to
+			 * wake it up. Consumer that has something to read does not need
+			 * a wakeup, so latches are set once per batch of tuples rather
+			 * than per tuple.
+			 */
+			if (pg_atomic_fetch_add_u32(&cstate->cs_ntuples, 1) == 0)
 				SetLatch(&sqsync->sqs_consumer_sync[consumerIdx].cs_latch);
 		}
 		else
@@ -952,7 +1254,6 @@ SharedQueueWrite(SharedQueue squeue, int consumerIdx,
 		if (free_datarow)
 			pfree(datarow);
 	}
-	LWLockRelease(clwlock);
 }
 
 
@@ -976,49 +1277,50 @@ SharedQueueRead(SharedQueue squeue, int consumerIdx,
 	Assert(cstate->cs_qlength > 0);
 
 	/*
-	 * If we run out of produced data while reading, we would like to wake up
-	 * and tell the producer to produce more. But in order to ensure that the
-	 * producer does not miss the signal, we must obtain sufficient lock on the
-	 * queue. In order to allow multiple consumers to read from their
-	 * respective queues at the same time, we obtain a SHARED lock on the
-	 * queue. But the producer must obtain an EXCLUSIVE lock to ensure it does
-	 * not miss the signal.
-	 *
-	 * Again, important to follow strict lock ordering.
-	 */ 
-	LWLockAcquire(sqsync->sqs_producer_lwlock, LW_SHARED);
-	LWLockAcquire(sqsync->sqs_consumer_sync[consumerIdx].cs_lwlock, LW_EXCLUSIVE);
-
-	Assert(cstate->cs_status != CONSUMER_DONE);
-	while (cstate->cs_ntuples <= 0)
+	 * If there are tuples in the queue we can read one without any locking,
+	 * the consumer is the only process advancing the queue tail. Locks are
+	 * only needed if we run out of data and have to check the status or wait
+	 * for the producer.
+	 */
+	for (;;)
 	{
-		elog(DEBUG3, "SQueue %s, consumer node %d, pid %d, status %d - "
-				"no tuples in the queue", squeue->sq_key,
-				cstate->cs_node, cstate->cs_pid, cstate->cs_status);
-
-		if (cstate->cs_status == CONSUMER_EOF)
+		if (cstate->cs_status != CONSUMER_ERROR)
 		{
-			elog(DEBUG1, "SQueue %s, consumer node %d, pid %d, status %d - "
-					"EOF marked. Informing produer by setting CONSUMER_DONE",
-					squeue->sq_key,
-					cstate->cs_node, cstate->cs_pid, cstate->cs_status);
-
-			/* Inform producer the consumer have done the job */
-			cstate->cs_status = CONSUMER_DONE;
-			/* no need to receive notifications */
-			DisownLatch(&sqsync->sqs_consumer_sync[consumerIdx].cs_latch);
-			/* producer done the job and no more rows expected, clean up */
-			LWLockRelease(sqsync->sqs_consumer_sync[consumerIdx].cs_lwlock);
-			ExecClearTuple(slot);
-			/*
-			 * notify the producer, it may be waiting while consumers
-			 * are finishing
-			 */
-			SetLatch(&sqsync->sqs_producer_latch);
-			LWLockRelease(sqsync->sqs_producer_lwlock);
-			return true;
+			if (QUEUE_NTUPLES(cstate) > 0)
+				break;
+			/* The queue is empty, but producer may have spilled tuples */
+			if (!SPILL_DRAINED(cstate))
+			{
+				sq_spill_read(squeue, consumerIdx, slot);
+				SQ_STAT_INC(cstate->stat_reads);
+				return false;
+			}
 		}
-		else if (cstate->cs_status == CONSUMER_ERROR)
+
+		/*
+		 * If we run out of produced data while reading, we would like to wake
+		 * up and tell the producer to produce more. But in order to ensure
+		 * that the producer does not miss the signal, we must obtain
+		 * sufficient lock on the queue. In order to allow multiple consumers
+		 * to read from their respective queues at the same time, we obtain a
+		 * SHARED lock on the queue. But the producer must obtain an EXCLUSIVE
+		 * lock to ensure it does not miss the signal.
+		 *
+		 * Again, important to follow strict lock ordering.
+		 */
+		LWLockAcquire(sqsync->sqs_producer_lwlock, LW_SHARED);
+		LWLockAcquire(sqsync->sqs_consumer_sync[consumerIdx].cs_lwlock, LW_EXCLUSIVE);
+
+		Assert(cstate->cs_status != CONSUMER_DONE);
+
+		/*
+		 * Producer does not take the lock when it is writing to the queue,
+		 * so reset the latch before checking for data to not miss a wakeup.
+		 */
+		if (canwait)
+			ResetLatch(&sqsync->sqs_consumer_sync[consumerIdx].cs_latch);
+
+		if (cstate->cs_status == CONSUMER_ERROR)
 		{
 			elog(DEBUG1, "SQueue %s, consumer node %d, pid %d, status %d - "
 					"CONSUMER_ERROR set",
@@ -1045,10 +1347,46 @@ SharedQueueRead(SharedQueue squeue, int consumerIdx,
 						 squeue->sq_key,
 						 cstate->cs_node, cstate->cs_pid, cstate->cs_status)));
 		}
+
+		/* Producer managed to write something while we were locking */
+		if (QUEUE_NTUPLES(cstate) > 0 || !SPILL_DRAINED(cstate))
+		{
+			LWLockRelease(sqsync->sqs_consumer_sync[consumerIdx].cs_lwlock);
+			LWLockRelease(sqsync->sqs_producer_lwlock);
+			continue;
+		}
+
+		elog(DEBUG3, "SQueue %s, consumer node %d, pid %d, status %d - "
+				"no tuples in the queue", squeue->sq_key,
+				cstate->cs_node, cstate->cs_pid, cstate->cs_status);
+
+		if (cstate->cs_status == CONSUMER_EOF)
+		{
+			elog(DEBUG1, "SQueue %s, consumer node %d, pid %d, status %d - "
+					"EOF marked. Informing produer by setting CONSUMER_DONE",
+					squeue->sq_key,
+					cstate->cs_node, cstate->cs_pid, cstate->cs_status);
+
+			/* Inform producer the consumer have done the job */
+			cstate->cs_status = CONSUMER_DONE;
+			/* no need to receive notifications */
+			DisownLatch(&sqsync->sqs_consumer_sync[consumerIdx].cs_latch);
+			/* no more reads from the queue */
+			sq_detach(squeue);
+			/* producer done the job and no more rows expected, clean up */
+			LWLockRelease(sqsync->sqs_consumer_sync[consumerIdx].cs_lwlock);
+			ExecClearTuple(slot);
+			/*
+			 * notify the producer, it may be waiting while consumers
+			 * are finishing
+			 */
+			SetLatch(&sqsync->sqs_producer_latch);
+			LWLockRelease(sqsync->sqs_producer_lwlock);
+			return true;
+		}
 		if (canwait)
 		{
 			/* Prepare waiting on empty buffer */
-			ResetLatch(&sqsync->sqs_consumer_sync[consumerIdx].cs_latch);
 			LWLockRelease(sqsync->sqs_consumer_sync[consumerIdx].cs_lwlock);
 
 			elog(DEBUG3, "SQueue %s, consumer (node %d, pid %d, status %d) - "
@@ -1064,11 +1402,9 @@ SharedQueueRead(SharedQueue squeue, int consumerIdx,
 			/* Wait for notification about available info */
 			WaitLatch(&sqsync->sqs_consumer_sync[consumerIdx].cs_latch,
 					WL_LATCH_SET | WL_POSTMASTER_DEATH, -1,
-					WAIT_EVENT_MQ_INTERNAL);
+					WAIT_EVENT_SQUEUE_CONSUMER);
 
-			/* got the notification, restore lock and try again */
-			LWLockAcquire(sqsync->sqs_producer_lwlock, LW_SHARED);
-			LWLockAcquire(sqsync->sqs_consumer_sync[consumerIdx].cs_lwlock, LW_EXCLUSIVE);
+			/* got the notification, try again */
 		}
 		else
 		{
@@ -1088,26 +1424,21 @@ SharedQueueRead(SharedQueue squeue, int consumerIdx,
 			"%d queued tuples to read",
 			squeue->sq_key,
 			cstate->cs_node, cstate->cs_pid, cstate->cs_status,
-			cstate->cs_ntuples);
+			QUEUE_NTUPLES(cstate));
 
 	/* have at least one row, read it in and store to slot */
-	QUEUE_READ(cstate, sizeof(int), (char *) (&datalen));
+	sq_queue_read(cstate, sizeof(int), (char *) (&datalen));
 	datarow = (RemoteDataRow) palloc(sizeof(RemoteDataRowData) + datalen);
 	datarow->msgnode = InvalidOid;
 	datarow->msglen = datalen;
 	if (datalen > cstate->cs_qlength - sizeof(int))
-		sq_pull_long_tuple(cstate, datarow, consumerIdx, sqsync);
+		sq_pull_long_tuple(squeue, datarow, consumerIdx);
 	else
-		QUEUE_READ(cstate, datalen, datarow->msg);
+		sq_queue_read(cstate, datalen, datarow->msg);
 	ExecStoreDataRowTuple(datarow, slot, true);
-	(cstate->cs_ntuples)--;
-#ifdef SQUEUE_STAT
-	cstate->stat_reads++;
-#endif
-	/* sanity check */
-	Assert((cstate->cs_ntuples == 0) == (cstate->cs_qreadpos == cstate->cs_qwritepos));
-	LWLockRelease(sqsync->sqs_consumer_sync[consumerIdx].cs_lwlock);
-	LWLockRelease(sqsync->sqs_producer_lwlock);
+	/* Let the producer know the space is free */
+	pg_atomic_fetch_sub_u32(&cstate->cs_ntuples, 1);
+	SQ_STAT_INC(cstate->stat_reads);
 	return false;
 }
 
@@ -1163,11 +1494,13 @@ SharedQueueReset(SharedQueue squeue, int consumerIdx)
 						squeue->sq_key, i, cstate->cs_node, cstate->cs_pid,
 						cstate->cs_status);
 
+				/*
+				 * Consumer checks the status before reading next tuple, so
+				 * the tuples which may already be in the queue are discarded.
+				 * We do not touch the queue itself, the consumer may be
+				 * reading it right now.
+				 */
 				cstate->cs_status = CONSUMER_ERROR;
-				/* discard tuples which may already be in the queue */
-				cstate->cs_ntuples = 0;
-				/* keep consistent with cs_ntuples*/
-				cstate->cs_qreadpos = cstate->cs_qwritepos = 0;
 
 				/* wake up consumer if it is sleeping */
 				SetLatch(&sqsync->sqs_consumer_sync[i].cs_latch);
@@ -1204,7 +1537,10 @@ SharedQueueReset(SharedQueue squeue, int consumerIdx)
 			 * connected the latch is not owned
 			 */
 			if (cstate->cs_pid > 0)
+			{
 				DisownLatch(&sqsync->sqs_consumer_sync[consumerIdx].cs_latch);
+				sq_detach(squeue);
+			}
 			/*
 			 * notify the producer, it may be waiting while consumers
 			 * are finishing
@@ -1272,11 +1608,12 @@ SharedQueueDisconnectConsumer(const char *sqname)
 
 		if (cstate->cs_node == PGXC_PARENT_NODE_ID)
 		{
+			/*
+			 * Tuples which may already be in the queue won't ever be read.
+			 * The queue is left as is, the producer may be writing to it
+			 * right now.
+			 */
 			cstate->cs_status = CONSUMER_DONE;
-			/* discard tuples which may already be in the queue */
-			cstate->cs_ntuples = 0;
-			/* keep consistent with cs_ntuples*/
-			cstate->cs_qreadpos = cstate->cs_qwritepos = 0;
 		}
 		LWLockRelease(sqsync->sqs_consumer_sync[i].cs_lwlock);
 	}
@@ -1314,11 +1651,8 @@ SharedQueueResetNotConnected(SharedQueue squeue)
 			elog(DEBUG1, "SQueue %s, consumer at %d, consumer node %d, pid %d, "
 					"status %d is cancelled - marking CONSUMER_ERROR", squeue->sq_key, i,
 					cstate->cs_node, cstate->cs_pid, cstate->cs_status);
+			/* tuples which may already be in the queue won't ever be read */
 			cstate->cs_status = CONSUMER_DONE;
-			/* discard tuples which may already be in the queue */
-			cstate->cs_ntuples = 0;
-			/* keep consistent with cs_ntuples*/
-			cstate->cs_qreadpos = cstate->cs_qwritepos = 0;
 
 			/* wake up consumer if it is sleeping */
 			SetLatch(&sqsync->sqs_consumer_sync[i].cs_latch);
@@ -1337,10 +1671,18 @@ bool
 SharedQueueWaitOnProducerLatch(SharedQueue squeue, long timeout)
 {
 	SQueueSync *sqsync = squeue->sq_sync;
-	int rc = WaitLatch(&sqsync->sqs_producer_latch,
+	instr_time	start;
+	instr_time	duration;
+	int			rc;
+
+	INSTR_TIME_SET_CURRENT(start);
+	rc = WaitLatch(&sqsync->sqs_producer_latch,
 			WL_LATCH_SET | WL_POSTMASTER_DEATH | WL_TIMEOUT,
-			timeout, WAIT_EVENT_MQ_INTERNAL);
+			timeout, WAIT_EVENT_SQUEUE_PRODUCER);
 	ResetLatch(&sqsync->sqs_producer_latch);
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	SQ_STAT_ADD(squeue->stat_wait_time, INSTR_TIME_GET_MICROSEC(duration));
 	return (rc & WL_TIMEOUT);
 }
 
@@ -1349,11 +1691,12 @@ SharedQueueWaitOnProducerLatch(SharedQueue squeue, long timeout)
  * The producer can pause if all consumers have enough data to read while
  * producer is sleeping.
  * Obvoius case when the producer can not pause if at least one queue is empty.
+ * The queue state is read without locking, that is just a hint for the
+ * producer.
  */
 bool
 SharedQueueCanPause(SharedQueue squeue)
 {
-	SQueueSync *sqsync = squeue->sq_sync;
 	bool 		result = true;
 	int 		usedspace;
 	int			ncons;
@@ -1364,7 +1707,6 @@ SharedQueueCanPause(SharedQueue squeue)
 	for (i = 0; result && (i < squeue->sq_nconsumers); i++)
 	{
 		ConsState *cstate = &(squeue->sq_consumers[i]);
-		LWLockAcquire(sqsync->sqs_consumer_sync[i].cs_lwlock, LW_SHARED);
 		/*
 		 * Count only consumers that may be blocked.
 		 * If producer has finished scanning and pushing local buffers some
@@ -1373,14 +1715,10 @@ SharedQueueCanPause(SharedQueue squeue)
 		if (cstate->cs_status == CONSUMER_ACTIVE)
 		{
 			/* can not pause if some queue is empty */
-			result = (cstate->cs_ntuples > 0);
-			usedspace += (cstate->cs_qwritepos > cstate->cs_qreadpos ?
-							  cstate->cs_qwritepos - cstate->cs_qreadpos :
-							  cstate->cs_qlength + cstate->cs_qwritepos
-												 - cstate->cs_qreadpos);
+			result = (QUEUE_NTUPLES(cstate) > 0);
+			usedspace += QUEUE_USED_SPACE(cstate);
 			ncons++;
 		}
-		LWLockRelease(sqsync->sqs_consumer_sync[i].cs_lwlock);
 	}
 	
 	if (!ncons)
@@ -1391,10 +1729,8 @@ SharedQueueCanPause(SharedQueue squeue)
 	 */
 	if (result)
 		result = (usedspace / ncons > squeue->sq_consumers[0].cs_qlength / 2);
-#ifdef SQUEUE_STAT
 	if (result)
-		squeue->stat_paused++;
-#endif
+		SQ_STAT_INC(squeue->stat_paused);
 	return result;
 }
 
@@ -1415,11 +1751,14 @@ SharedQueueFinish(SharedQueue squeue, TupleDesc tupDesc,
 	{
 		ConsState *cstate = &squeue->sq_consumers[i];
 		LWLockAcquire(sqsync->sqs_consumer_sync[i].cs_lwlock, LW_EXCLUSIVE);
-#ifdef SQUEUE_STAT
 		if (!squeue->stat_finish)
-			elog(DEBUG1, "Finishing %s node %d, %ld writes and %ld reads so far, %ld buffer writes, %ld buffer reads, %ld tuples returned to buffer",
-				 squeue->sq_key, cstate->cs_node, cstate->stat_writes, cstate->stat_reads, cstate->stat_buff_writes, cstate->stat_buff_reads, cstate->stat_buff_returns);
-#endif
+			elog(DEBUG1, "Finishing %s node %d, " UINT64_FORMAT " writes and " UINT64_FORMAT " reads so far, " UINT64_FORMAT " buffer writes, " UINT64_FORMAT " buffer reads, " UINT64_FORMAT " tuples returned to buffer",
+				 squeue->sq_key, cstate->cs_node,
+				 pg_atomic_read_u64(&cstate->stat_writes),
+				 pg_atomic_read_u64(&cstate->stat_reads),
+				 pg_atomic_read_u64(&cstate->stat_buff_writes),
+				 pg_atomic_read_u64(&cstate->stat_buff_reads),
+				 pg_atomic_read_u64(&cstate->stat_buff_returns));
 		elog(DEBUG1, "SQueue %s finishing, consumer at %d, consumer node %d, pid %d, "
 				"status %d", squeue->sq_key, i,
 				cstate->cs_node, cstate->cs_pid, cstate->cs_status);
@@ -1444,7 +1783,8 @@ SharedQueueFinish(SharedQueue squeue, TupleDesc tupDesc,
 				 * allocation, that is not a cheap operation, so proceed if
 				 * target queue has enough space.
 				 */
-				if (QUEUE_FREE_SPACE(cstate) > cstate->cs_qlength / 2)
+				if (SPILL_DRAINED(cstate) &&
+						sq_free_space(cstate) > cstate->cs_qlength / 2)
 				{
 					if (tmpslot == NULL)
 						tmpslot = MakeSingleTupleTableSlot(tupDesc);
@@ -1463,6 +1803,23 @@ SharedQueueFinish(SharedQueue squeue, TupleDesc tupDesc,
 					 * to set producer latch.
 					 */
 				}
+
+				/*
+				 * If spill file is allowed, move the rest to the spill file,
+				 * we do not need to wait until consumer makes room in the
+				 * queue.
+				 */
+				if (tuplestore[i] && squeue->sq_spill)
+				{
+					if (tmpslot == NULL)
+						tmpslot = MakeSingleTupleTableSlot(tupDesc);
+					sq_spill_flush(squeue, i, tmpslot, tuplestore[i]);
+					tuplestore_end(tuplestore[i]);
+					tuplestore[i] = NULL;
+					cstate->cs_status = CONSUMER_EOF;
+					nstores--;
+					SetLatch(&sqsync->sqs_consumer_sync[i].cs_latch);
+				}
 			}
 		}
 		else
@@ -1483,9 +1840,7 @@ SharedQueueFinish(SharedQueue squeue, TupleDesc tupDesc,
 	if (tmpslot)
 		ExecDropSingleTupleTableSlot(tmpslot);
 
-#ifdef SQUEUE_STAT
 	squeue->stat_finish = true;
-#endif
 
 	return nstores;
 }
@@ -1508,6 +1863,8 @@ SharedQueueUnBind(SharedQueue squeue, bool failed)
 	int			wait_result = 0;
 	int         i                = 0;
 	int         consumer_running = 0;
+	instr_time	wait_start;
+	instr_time	wait_time;
 
 	elog(DEBUG1, "SQueue %s, unbinding the SQueue (failed: %c) - producer node %d, "
 			"pid %d, nconsumers %d", squeue->sq_key, failed ? 'T' : 'F',
@@ -1566,9 +1923,14 @@ CHECK:
 		elog(DEBUG1, "SQueue %s, wait while %d consumers finish, %d consumers"
 				"not yet bound", squeue->sq_key, c_count, unbound_count);
 		/* wait for a notification */
+		INSTR_TIME_SET_CURRENT(wait_start);
 		wait_result = WaitLatch(&sqsync->sqs_producer_latch,
 								WL_LATCH_SET | WL_POSTMASTER_DEATH | WL_TIMEOUT,
-								10000L, WAIT_EVENT_MQ_INTERNAL);
+								10000L, WAIT_EVENT_SQUEUE_FINISH);
+		INSTR_TIME_SET_CURRENT(wait_time);
+		INSTR_TIME_SUBTRACT(wait_time, wait_start);
+		SQ_STAT_ADD(squeue->stat_wait_time,
+					INSTR_TIME_GET_MICROSEC(wait_time));
 
 		/*
 		 * If we hit a timeout, reset the consumers which still hasn't
@@ -1583,9 +1945,8 @@ CHECK:
 		if (wait_result & WL_TIMEOUT)
 			SharedQueueResetNotConnected(squeue);
 	}
-#ifdef SQUEUE_STAT
-	elog(DEBUG1, "Producer %s is done, there were %ld pauses", squeue->sq_key, squeue->stat_paused);
-#endif
+	elog(DEBUG1, "Producer %s is done, there were " UINT64_FORMAT " pauses",
+		 squeue->sq_key, pg_atomic_read_u64(&squeue->stat_paused));
 	elog(DEBUG1, "SQueue %s, producer node %d, pid %d - unbound successfully",
 			squeue->sq_key, squeue->sq_nodeid, squeue->sq_pid);
 
@@ -1625,12 +1986,34 @@ CHECK:
 		goto CHECK;
 	}
 
+	/*
+	 * Consumers won't read spill files any more, close them, which removes
+	 * them. If the producer fails, portal cleanup gets here before the
+	 * resource owner is released, so the files are still ours to close.
+	 */
+	for (i = 0; i < squeue->sq_nconsumers; i++)
+	{
+		ConsState *cstate = &squeue->sq_consumers[i];
+
+		if (cstate->cs_spill_file > 0)
+		{
+			elog(DEBUG1, "SQueue %s, consumer node %d spilled " UINT64_FORMAT
+					" tuples, " UINT64_FORMAT " bytes", squeue->sq_key,
+					cstate->cs_node, cstate->cs_spill_tuples,
+					cstate->cs_spill_bytes);
+			FileClose(cstate->cs_spill_file);
+			cstate->cs_spill_file = 0;
+		}
+	}
+
 	/* All is done, clean up */
 	DisownLatch(&sqsync->sqs_producer_latch);
+	sq_detach(squeue);
 
 	if (--squeue->sq_refcnt == 0)
 	{
 		/* Now it is OK to remove hash table entry */
+		sq_dsm_release(squeue);
 		squeue->sq_sync = NULL;
 		sqsync->queue = NULL;
 		if (hash_search(SharedQueues, squeue->sq_key, HASH_REMOVE, NULL) != squeue)
@@ -1732,6 +2115,7 @@ SharedQueueRelease(const char *sqname)
 						if (cstate->cs_pid > 0)
 						{
 							DisownLatch(&sqsync->sqs_consumer_sync[i].cs_latch);
+							sq_detach(sq);
 							cstate->cs_pid = 0;
 						}
 						/*
@@ -1784,6 +2168,7 @@ done:
 	if (sq && --sq->sq_refcnt == 0)
 	{
 		/* Now it is OK to remove hash table entry */
+		sq_dsm_release(sq);
 		sq->sq_sync->queue = NULL;
 		sq->sq_sync = NULL;
 		if (hash_search(SharedQueues, sq->sq_key, HASH_REMOVE, NULL) != sq)
@@ -1817,6 +2202,193 @@ SharedQueuesCleanup(int code, Datum arg)
 }
 
 
+/*
+ * pg_stat_get_shared_queues
+ *    Return a row per consumer of every shared queue active on this node.
+ *    The counters are read without locking the queues, so the figures shown
+ *    for a consumer may be slightly out of step with each other.
+ */
+Datum
+pg_stat_get_shared_queues(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_SHARED_QUEUES_COLS	17
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	HASH_SEQ_STATUS status;
+	SharedQueue sq;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	LWLockAcquire(SQueuesLock, LW_SHARED);
+	hash_seq_init(&status, SharedQueues);
+	while ((sq = (SharedQueue) hash_seq_search(&status)) != NULL)
+	{
+		int			i;
+
+		for (i = 0; i < sq->sq_nconsumers; i++)
+		{
+			ConsState  *cstate = &sq->sq_consumers[i];
+			Datum		values[PG_STAT_GET_SHARED_QUEUES_COLS];
+			bool		nulls[PG_STAT_GET_SHARED_QUEUES_COLS];
+			const char *state;
+
+			MemSet(nulls, 0, sizeof(nulls));
+
+			values[0] = CStringGetTextDatum(sq->sq_key);
+			if (sq->sq_pid == 0)
+				nulls[1] = true;
+			else
+				values[1] = Int32GetDatum(sq->sq_pid);
+			if (sq->sq_nodeid < 0 || sq->sq_nodeid >= NumDataNodes)
+				nulls[2] = true;
+			else
+				values[2] = ObjectIdGetDatum(PGXCNodeGetNodeOid(sq->sq_nodeid,
+														PGXC_NODE_DATANODE));
+			if (cstate->cs_pid == 0)
+				nulls[3] = true;
+			else
+				values[3] = Int32GetDatum(cstate->cs_pid);
+			if (cstate->cs_node < 0 || cstate->cs_node >= NumDataNodes)
+				nulls[4] = true;
+			else
+				values[4] = ObjectIdGetDatum(PGXCNodeGetNodeOid(cstate->cs_node,
+														PGXC_NODE_DATANODE));
+			switch (cstate->cs_status)
+			{
+				case CONSUMER_ACTIVE:
+					state = "active";
+					break;
+				case CONSUMER_EOF:
+					state = "eof";
+					break;
+				case CONSUMER_ERROR:
+					state = "error";
+					break;
+				case CONSUMER_DONE:
+					state = "done";
+					break;
+				default:
+					state = "unknown";
+					break;
+			}
+			values[5] = CStringGetTextDatum(state);
+			values[6] = Int32GetDatum(cstate->cs_qlength);
+			values[7] = Int32GetDatum(QUEUE_USED_SPACE(cstate));
+			values[8] = Int32GetDatum(Max(QUEUE_NTUPLES(cstate), 0));
+			values[9] = Int64GetDatum(pg_atomic_read_u64(&cstate->stat_writes));
+			values[10] = Int64GetDatum(pg_atomic_read_u64(&cstate->stat_reads));
+			values[11] = Int64GetDatum(pg_atomic_read_u64(&cstate->stat_buff_writes));
+			values[12] = Int64GetDatum(pg_atomic_read_u64(&cstate->stat_long_tuples));
+			values[13] = Int64GetDatum(cstate->cs_spill_bytes);
+			values[14] = Int64GetDatum(cstate->cs_spill_tuples);
+			values[15] = Int64GetDatum(pg_atomic_read_u64(&sq->stat_paused));
+			values[16] = Float8GetDatum((double)
+						pg_atomic_read_u64(&sq->stat_wait_time) / 1000.0);
+
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		}
+	}
+	LWLockRelease(SQueuesLock);
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+
+/*
+ * sq_free_space
+ *    Return number of bytes the producer may write to the consumer queue.
+ *    Called by the producer only. The barrier makes sure we do not overwrite
+ *    queue data before the consumer is done reading it.
+ */
+static inline int
+sq_free_space(ConsState *cstate)
+{
+	int		used = QUEUE_USED_SPACE(cstate);
+
+	pg_memory_barrier();
+	return cstate->cs_qlength - used;
+}
+
+
+/*
+ * sq_queue_write
+ *    Copy len bytes to the consumer queue and advance the head. Called by the
+ *    producer only, the caller should make sure there is enough free space.
+ *    Data do not become visible to the consumer until cs_ntuples is changed.
+ */
+static inline void
+sq_queue_write(ConsState *cstate, int len, const char *buf)
+{
+	uint64	head = pg_atomic_read_u64(&cstate->cs_qhead);
+	int		pos = (int) (head % cstate->cs_qlength);
+
+	if (pos + len <= cstate->cs_qlength)
+		memcpy(cstate->cs_pstart + pos, buf, len);
+	else
+	{
+		int part = cstate->cs_qlength - pos;
+		memcpy(cstate->cs_pstart + pos, buf, part);
+		memcpy(cstate->cs_pstart, buf + part, len - part);
+	}
+	pg_atomic_write_u64(&cstate->cs_qhead, head + len);
+}
+
+
+/*
+ * sq_queue_read
+ *    Copy len bytes from the consumer queue and advance the tail. Called by
+ *    the consumer only, the caller should make sure the data is there.
+ *    The space does not become reusable by the producer until the tail is
+ *    advanced, and the barrier makes sure we have done reading by then.
+ */
+static inline void
+sq_queue_read(ConsState *cstate, int len, char *buf)
+{
+	uint64	tail = pg_atomic_read_u64(&cstate->cs_qtail);
+	int		pos = (int) (tail % cstate->cs_qlength);
+
+	pg_read_barrier();
+	if (pos + len <= cstate->cs_qlength)
+		memcpy(buf, cstate->cs_cstart + pos, len);
+	else
+	{
+		int part = cstate->cs_qlength - pos;
+		memcpy(buf, cstate->cs_cstart + pos, part);
+		memcpy(buf + part, cstate->cs_cstart, len - part);
+	}
+	pg_memory_barrier();
+	pg_atomic_write_u64(&cstate->cs_qtail, tail + len);
+}
+
+
 /*
  * sq_push_long_tuple
  *    Routine to push through the consumer state tuple longer the the consumer
@@ -1840,20 +2412,28 @@ SharedQueuesCleanup(int code, Datum arg)
 static bool
 sq_push_long_tuple(ConsState *cstate, RemoteDataRow datarow)
 {
-	if (cstate->cs_ntuples == 0)
+	int32	ntuples = QUEUE_NTUPLES(cstate);
+
+	/* Consumer must be done with the queue before we overwrite it */
+	pg_memory_barrier();
+
+	if (ntuples == 0)
 	{
 		/* the tuple is too big to fit the queue, start pushing it through */
 		int len;
+
+		SQ_STAT_INC(cstate->stat_long_tuples);
 		/*
 		 * Output actual message size, to prepare consumer:
 		 * allocate memory and set up transmission.
 		 */
-		QUEUE_WRITE(cstate, sizeof(int), (char *) &datarow->msglen);
+		sq_queue_write(cstate, sizeof(int), (char *) &datarow->msglen);
 		/* Output as much as possible */
 		len = cstate->cs_qlength - sizeof(int);
 		Assert(datarow->msglen > len);
-		QUEUE_WRITE(cstate, len, datarow->msg);
-		cstate->cs_ntuples = 1;
+		sq_queue_write(cstate, len, datarow->msg);
+		pg_write_barrier();
+		pg_atomic_write_u32(&cstate->cs_ntuples, 1);
 		return false;
 	}
 	else
@@ -1862,12 +2442,12 @@ sq_push_long_tuple(ConsState *cstate, RemoteDataRow datarow)
 		int	len;
 
 		/* Continue pushing through long tuple */
-		Assert(cstate->cs_ntuples == LONG_TUPLE);
+		Assert(ntuples == LONG_TUPLE);
 		/*
 		 * Consumer outputs number of bytes already read at the beginning of
 		 * the queue.
 		 */
-		memcpy(&offset, cstate->cs_qstart, sizeof(int));
+		memcpy(&offset, cstate->cs_pstart, sizeof(int));
 
 		Assert(offset > 0 && offset < datarow->msglen);
 
@@ -1877,20 +2457,22 @@ sq_push_long_tuple(ConsState *cstate, RemoteDataRow datarow)
 		 * We are sending remaining lengs just for sanity check at the consumer
 		 * side
 		 */
-		QUEUE_WRITE(cstate, sizeof(int), (char *) &len);
+		sq_queue_write(cstate, sizeof(int), (char *) &len);
 		if (len > cstate->cs_qlength - sizeof(int))
 		{
 			/* does not fit yet */
 			len = cstate->cs_qlength - sizeof(int);
-			QUEUE_WRITE(cstate, len, datarow->msg + offset);
-			cstate->cs_ntuples = 1;
+			sq_queue_write(cstate, len, datarow->msg + offset);
+			pg_write_barrier();
+			pg_atomic_write_u32(&cstate->cs_ntuples, 1);
 			return false;
 		}
 		else
 		{
 			/* now we are done */
-			QUEUE_WRITE(cstate, len, datarow->msg + offset);
-			cstate->cs_ntuples = 1;
+			sq_queue_write(cstate, len, datarow->msg + offset);
+			pg_write_barrier();
+			pg_atomic_write_u32(&cstate->cs_ntuples, 1);
 			return true;
 		}
 	}
@@ -1902,17 +2484,17 @@ sq_push_long_tuple(ConsState *cstate, RemoteDataRow datarow)
  *    Read in from the queue data of a long tuple which does not the queue.
  *    See sq_push_long_tuple for more details
  *
- *    The function is entered with LWLocks held on the consumer as well as
- *    procuder sync. The function exits with both of those locks held, even
- *    though internally it may release those locks before going to sleep.
+ *    The function is entered and exits without holding any locks, the queue
+ *    is read in the same lock-free manner as normal tuples are. If producer
+ *    fails while we are waiting for the next portion an error is reported.
  */
 static void
-sq_pull_long_tuple(ConsState *cstate, RemoteDataRow datarow,
-							   int consumerIdx, SQueueSync *sqsync)
+sq_pull_long_tuple(SharedQueue squeue, RemoteDataRow datarow, int consumerIdx)
 {
+	ConsState  *cstate = &(squeue->sq_consumers[consumerIdx]);
 	int offset = 0;
 	int len = datarow->msglen;
-	ConsumerSync *sync = &sqsync->sqs_consumer_sync[consumerIdx];
+	ConsumerSync *sync = &squeue->sq_sync->sqs_consumer_sync[consumerIdx];
 
 	for (;;)
 	{
@@ -1921,7 +2503,7 @@ sq_pull_long_tuple(ConsState *cstate, RemoteDataRow datarow,
 			len = cstate->cs_qlength - sizeof(int);
 
 		/* read data */
-		QUEUE_READ(cstate, len, datarow->msg + offset);
+		sq_queue_read(cstate, len, datarow->msg + offset);
 
 		/* remember how many we read already */
 		offset += len;
@@ -1931,39 +2513,45 @@ sq_pull_long_tuple(ConsState *cstate, RemoteDataRow datarow,
 			return;
 
 		/* need more, set up queue to accept data from the producer */
-		Assert(cstate->cs_ntuples == 1); /* allow exactly one incomplete tuple */
-		cstate->cs_ntuples = LONG_TUPLE; /* long tuple mode marker */
+		Assert(QUEUE_NTUPLES(cstate) == 1); /* allow exactly one incomplete tuple */
 		/* Inform producer how many bytes we have already */
-		memcpy(cstate->cs_qstart, &offset, sizeof(int));
-		/* Release locks and wait until producer supply more data */
-		while (cstate->cs_ntuples == LONG_TUPLE)
-		{
-			/*
-			 * First up wake the producer
-			 */
-			SetLatch(&sqsync->sqs_producer_latch);
+		memcpy(cstate->cs_cstart, &offset, sizeof(int));
+		pg_write_barrier();
+		/* long tuple mode marker */
+		pg_atomic_write_u32(&cstate->cs_ntuples, (uint32) LONG_TUPLE);
 
+		/* Wait until producer supply more data */
+		for (;;)
+		{
 			/*
-			 * We must reset the consumer latch while holding the lock to
-			 * ensure the producer can't change the state in between.
+			 * We must reset the consumer latch before checking the state to
+			 * ensure we do not miss the producer wakeup.
 			 */
 			ResetLatch(&sync->cs_latch);
 
-			/*
-			 * Now release all locks before going into a wait state
-			 */
-			LWLockRelease(sync->cs_lwlock);
-			LWLockRelease(sqsync->sqs_producer_lwlock);
+			if (QUEUE_NTUPLES(cstate) != LONG_TUPLE)
+				break;
+
+			if (cstate->cs_status == CONSUMER_ERROR)
+				ereport(ERROR,
+						(errcode(ERRCODE_PRODUCER_ERROR),
+						 errmsg("Failed to read from SQueue %s, "
+							 "consumer (node %d, pid %d, status %d) - "
+							 "CONSUMER_ERROR set",
+							 squeue->sq_key,
+							 cstate->cs_node, cstate->cs_pid, cstate->cs_status)));
+
+			/* Wake the producer */
+			SetLatch(&squeue->sq_sync->sqs_producer_latch);
 
 			/* Wait for notification about available info */
 			WaitLatch(&sync->cs_latch, WL_LATCH_SET | WL_POSTMASTER_DEATH, -1,
-					WAIT_EVENT_MQ_INTERNAL);
-			/* got the notification, restore lock and try again */
-			LWLockAcquire(sqsync->sqs_producer_lwlock, LW_SHARED);
-			LWLockAcquire(sync->cs_lwlock, LW_EXCLUSIVE);
+					WAIT_EVENT_SQUEUE_CONSUMER);
 		}
+		pg_read_barrier();
+
 		/* Read length of remaining data */
-		QUEUE_READ(cstate, sizeof(int), (char *) &len);
+		sq_queue_read(cstate, sizeof(int), (char *) &len);
 
 		/* Make sure we are doing the same tuple */
 		Assert(offset + len == datarow->msglen);
@@ -1971,3 +2559,422 @@ sq_pull_long_tuple(ConsState *cstate, RemoteDataRow datarow,
 		/* next iteration */
 	}
 }
+
+
+/*
+ * sq_spill_flush
+ *    Move all the tuples from the producer's local tuplestore to the spill
+ *    file of the consumer. Tuples are written in batches, each batch is
+ *    compressed if that saves space. Batches become visible to the consumer
+ *    when the spill head is advanced, after the data is written to the file.
+ *    The file is created on the first flush, in the temporary tablespace,
+ *    and it is tied to the current resource owner.
+ */
+static void
+sq_spill_flush(SharedQueue squeue, int consumerIdx,
+			   TupleTableSlot *tmpslot, Tuplestorestate *tuplestore)
+{
+	ConsState  *cstate = &(squeue->sq_consumers[consumerIdx]);
+	StringInfoData buf;
+	char	   *compbuf = NULL;
+	int			compbuflen = 0;
+	uint64		head = pg_atomic_read_u64(&cstate->cs_spill_head);
+	bool		eof = false;
+
+	if (cstate->cs_spill_file <= 0)
+	{
+		cstate->cs_spill_file = OpenTemporaryFile(false);
+		strlcpy(cstate->cs_spill_path, FilePathName(cstate->cs_spill_file),
+				MAXPGPATH);
+	}
+
+	initStringInfo(&buf);
+
+	/* See SharedQueueDump for details about the read pointers */
+	tuplestore_select_read_pointer(tuplestore, 1);
+
+	while (!eof)
+	{
+		SpillBatchHeader hdr;
+		char	   *data;
+		int			datalen;
+
+		resetStringInfo(&buf);
+		hdr.sb_ntuples = 0;
+
+		/* Collect the batch */
+		while (buf.len < cstate->cs_qlength)
+		{
+			if (!tuplestore_gettupleslot(tuplestore, true, false, tmpslot))
+			{
+				eof = true;
+				break;
+			}
+			Assert(tmpslot->tts_datarow);
+			appendBinaryStringInfo(&buf,
+								   (char *) &tmpslot->tts_datarow->msglen,
+								   sizeof(int));
+			appendBinaryStringInfo(&buf, tmpslot->tts_datarow->msg,
+								   tmpslot->tts_datarow->msglen);
+			hdr.sb_ntuples++;
+		}
+
+		if (hdr.sb_ntuples == 0)
+			break;
+
+		/* Compress the batch, store it as is if that does not help */
+		hdr.sb_rawlen = buf.len;
+		if (compbuflen < PGLZ_MAX_OUTPUT(buf.len))
+		{
+			if (compbuf)
+				pfree(compbuf);
+			compbuflen = PGLZ_MAX_OUTPUT(buf.len);
+			compbuf = palloc(compbuflen);
+		}
+		hdr.sb_complen = pglz_compress(buf.data, buf.len, compbuf,
+									   PGLZ_strategy_default);
+		if (hdr.sb_complen < 0)
+		{
+			data = buf.data;
+			datalen = buf.len;
+		}
+		else
+		{
+			data = compbuf;
+			datalen = hdr.sb_complen;
+		}
+
+		if (FileWrite(cstate->cs_spill_file, (char *) &hdr, sizeof(hdr),
+					  WAIT_EVENT_BUFFILE_WRITE) != sizeof(hdr) ||
+				FileWrite(cstate->cs_spill_file, data, datalen,
+						  WAIT_EVENT_BUFFILE_WRITE) != datalen)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not write to shared queue spill file \"%s\": %m",
+							cstate->cs_spill_path)));
+
+		head += sizeof(hdr) + datalen;
+		cstate->cs_spill_bytes += sizeof(hdr) + datalen;
+		cstate->cs_spill_tuples += hdr.sb_ntuples;
+
+		/* Make the batch visible to the consumer */
+		pg_write_barrier();
+		pg_atomic_write_u64(&cstate->cs_spill_head, head);
+		SetLatch(&squeue->sq_sync->sqs_consumer_sync[consumerIdx].cs_latch);
+	}
+
+	pfree(buf.data);
+	if (compbuf)
+		pfree(compbuf);
+
+	tuplestore_clear(tuplestore);
+	/* prepare for writes, set read pointer 0 as active */
+	tuplestore_select_read_pointer(tuplestore, 0);
+	cstate->cs_buffered = 0;
+}
+
+
+/*
+ * sq_spill_read
+ *    Read next tuple from the spill file of the consumer into the slot.
+ *    The caller should make sure the spill file is not drained. The batch is
+ *    read in and decompressed on first access, the consumer advances the spill
+ *    tail when the batch is completely read.
+ */
+static void
+sq_spill_read(SharedQueue squeue, int consumerIdx, TupleTableSlot *slot)
+{
+	ConsState  *cstate = &(squeue->sq_consumers[consumerIdx]);
+	uint64		tail = pg_atomic_read_u64(&cstate->cs_spill_tail);
+	RemoteDataRow datarow;
+	int			datalen;
+
+	if (sq_spill_data == NULL || sq_spill_squeue != squeue ||
+			sq_spill_consumer != consumerIdx || sq_spill_offset != tail)
+	{
+		char	   *path = cstate->cs_spill_path;
+		SpillBatchHeader hdr;
+		char	   *data;
+		int			fd;
+
+		sq_spill_reset();
+
+		/*
+		 * The spill head was read by the caller, make sure we see the data
+		 * and the path of the file
+		 */
+		pg_read_barrier();
+
+		fd = OpenTransientFile(path, O_RDONLY | PG_BINARY, 0);
+		if (fd < 0)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not open shared queue spill file \"%s\": %m",
+							path)));
+
+		pgstat_report_wait_start(WAIT_EVENT_BUFFILE_READ);
+		if (lseek(fd, (off_t) tail, SEEK_SET) != (off_t) tail ||
+				read(fd, &hdr, sizeof(hdr)) != sizeof(hdr))
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read shared queue spill file \"%s\": %m",
+							path)));
+
+		sq_spill_data = MemoryContextAlloc(TopMemoryContext, hdr.sb_rawlen);
+		datalen = hdr.sb_complen < 0 ? hdr.sb_rawlen : hdr.sb_complen;
+		data = hdr.sb_complen < 0 ? sq_spill_data : palloc(datalen);
+		if (read(fd, data, datalen) != datalen)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not read shared queue spill file \"%s\": %m",
+							path)));
+		pgstat_report_wait_end();
+		CloseTransientFile(fd);
+
+		if (hdr.sb_complen >= 0)
+		{
+			if (pglz_decompress(data, datalen, sq_spill_data,
+								hdr.sb_rawlen) != hdr.sb_rawlen)
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("compressed data is corrupted in shared queue spill file \"%s\"",
+								path)));
+			pfree(data);
+		}
+
+		sq_spill_squeue = squeue;
+		sq_spill_consumer = consumerIdx;
+		sq_spill_offset = tail;
+		sq_spill_datalen = hdr.sb_rawlen;
+		sq_spill_batchlen = sizeof(hdr) + datalen;
+	}
+
+	memcpy(&datalen, sq_spill_data + cstate->cs_spill_pos, sizeof(int));
+	datarow = (RemoteDataRow) palloc(sizeof(RemoteDataRowData) + datalen);
+	datarow->msgnode = InvalidOid;
+	datarow->msglen = datalen;
+	memcpy(datarow->msg, sq_spill_data + cstate->cs_spill_pos + sizeof(int),
+		   datalen);
+	ExecStoreDataRowTuple(datarow, slot, true);
+	cstate->cs_spill_pos += sizeof(int) + datalen;
+
+	/* Batch is done, let the producer know */
+	if (cstate->cs_spill_pos >= sq_spill_datalen)
+	{
+		cstate->cs_spill_pos = 0;
+		pg_atomic_write_u64(&cstate->cs_spill_tail, tail + sq_spill_batchlen);
+		sq_spill_reset();
+	}
+}
+
+
+/*
+ * sq_spill_reset
+ *    Discard the spill batch cached by the consumer.
+ */
+static void
+sq_spill_reset(void)
+{
+	if (sq_spill_data)
+		pfree(sq_spill_data);
+	sq_spill_data = NULL;
+	sq_spill_squeue = NULL;
+	sq_spill_consumer = -1;
+	sq_spill_offset = 0;
+	sq_spill_datalen = 0;
+	sq_spill_batchlen = 0;
+}
+
+
+/*
+ * sq_dsm_allocate
+ *    Set up DSM segment for the ncons consumer queues of the named shared
+ *    queue, return its size and set the handle. Queue size is estimated from
+ *    the expected amount of data, the estimate is rounded up to power of two
+ *    to make retired segments more likely to be reused, and the total is
+ *    capped by the size of a static shared queue. The segment is taken from
+ *    the pool if there is one fitting, otherwise new segment is created.
+ *    Caller should hold SQueuesLock.
+ */
+static Size
+sq_dsm_allocate(const char *sqname, int ncons, double rows, int width,
+				dsm_handle *handle)
+{
+	double		bytes;
+	Size		qsize;
+	Size		size;
+	int			best = -1;
+	int			i;
+	dsm_segment *seg;
+
+	/*
+	 * The tuples are spread between the consumers and the producer itself,
+	 * every tuple in the queue is prepended with its length.
+	 */
+	bytes = rows * (width + sizeof(int)) / (ncons + 1);
+	qsize = Min(SQUEUE_DSM_MIN_SIZE, SQUEUE_SIZE / ncons);
+	while (qsize < bytes && qsize * 2 * ncons <= SQUEUE_SIZE)
+		qsize *= 2;
+	size = qsize * ncons;
+
+	/* Find the smallest pooled segment that fits, but do not waste memory */
+	for (i = 0; i < SQueueDsm->sdp_nsegs; i++)
+	{
+		Size		segsize = SQueueDsm->sdp_segs[i].size;
+
+		if (segsize >= size && segsize <= 2 * size &&
+				(best < 0 || segsize < SQueueDsm->sdp_segs[best].size))
+			best = i;
+	}
+
+	if (best >= 0)
+	{
+		*handle = SQueueDsm->sdp_segs[best].handle;
+		size = SQueueDsm->sdp_segs[best].size;
+		SQueueDsm->sdp_segs[best] =
+			SQueueDsm->sdp_segs[--SQueueDsm->sdp_nsegs];
+		elog(DEBUG1, "SQueue %s reuses pooled segment of size %zu",
+			 sqname, size);
+		return size;
+	}
+
+	seg = dsm_create(size, DSM_CREATE_NULL_IF_MAXSEGMENTS);
+	if (seg == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_RESOURCES),
+				 errmsg("could not allocate memory for shared queue %s",
+						sqname),
+				 errhint("There are too many dynamic shared memory segments in use.")));
+
+	/*
+	 * The segment should survive until the shared queue is retired, even if
+	 * no process is attached. The processes binding to the queue will attach
+	 * to the segment separately.
+	 */
+	dsm_pin_segment(seg);
+	*handle = dsm_segment_handle(seg);
+	dsm_detach(seg);
+
+	elog(DEBUG1, "SQueue %s created segment of size %zu", sqname, size);
+	return size;
+}
+
+
+/*
+ * sq_dsm_put
+ *    Return the DSM segment to the pool, or destroy it if the pool is full.
+ *    Caller should hold SQueuesLock.
+ */
+static void
+sq_dsm_put(dsm_handle handle, Size size)
+{
+	if (handle == DSM_HANDLE_INVALID)
+		return;
+
+	if (SQueueDsm->sdp_nsegs < SQUEUE_DSM_POOL_SIZE)
+	{
+		SQueueDsm->sdp_segs[SQueueDsm->sdp_nsegs].handle = handle;
+		SQueueDsm->sdp_segs[SQueueDsm->sdp_nsegs].size = size;
+		SQueueDsm->sdp_nsegs++;
+	}
+	else
+		dsm_unpin_segment(handle);
+}
+
+
+/*
+ * sq_dsm_release
+ *    Release the DSM segment of the retired shared queue.
+ *    Caller should hold SQueuesLock.
+ */
+static void
+sq_dsm_release(SharedQueue sq)
+{
+	sq_dsm_put(sq->sq_dsm, sq->sq_dsmsize);
+	sq->sq_dsm = DSM_HANDLE_INVALID;
+	sq->sq_dsmsize = 0;
+}
+
+
+/*
+ * sq_attach
+ *    Return address of the memory where consumer queues of the shared queue
+ *    are located, attaching to the DSM segment if needed.
+ */
+static char *
+sq_attach(SharedQueue sq)
+{
+	SQueueMapping *map = NULL;
+	ListCell   *lc;
+
+	if (sq->sq_dsm == DSM_HANDLE_INVALID)
+		return (char *) sq;
+
+	foreach(lc, SQueueMappings)
+	{
+		SQueueMapping *m = (SQueueMapping *) lfirst(lc);
+
+		if (m->handle == sq->sq_dsm)
+		{
+			map = m;
+			break;
+		}
+	}
+
+	if (map == NULL)
+	{
+		MemoryContext oldcontext;
+		dsm_segment *seg;
+
+		seg = dsm_attach(sq->sq_dsm);
+		if (seg == NULL)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("could not map memory of shared queue %s",
+							sq->sq_key)));
+		/* Mapping is released explicitly when we are done with the queue */
+		dsm_pin_mapping(seg);
+
+		oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+		map = (SQueueMapping *) palloc(sizeof(SQueueMapping));
+		map->handle = sq->sq_dsm;
+		map->seg = seg;
+		map->refcount = 0;
+		SQueueMappings = lappend(SQueueMappings, map);
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	map->refcount++;
+	return (char *) dsm_segment_address(map->seg);
+}
+
+
+/*
+ * sq_detach
+ *    Release the reference to the consumer queues memory obtained by
+ *    sq_attach. The DSM segment is detached when the last reference is gone.
+ */
+static void
+sq_detach(SharedQueue sq)
+{
+	ListCell   *lc;
+
+	if (sq->sq_dsm == DSM_HANDLE_INVALID)
+		return;
+
+	foreach(lc, SQueueMappings)
+	{
+		SQueueMapping *map = (SQueueMapping *) lfirst(lc);
+
+		if (map->handle == sq->sq_dsm)
+		{
+			if (--map->refcount == 0)
+			{
+				dsm_detach(map->seg);
+				SQueueMappings = list_delete_ptr(SQueueMappings, map);
+				pfree(map);
+			}
+			return;
+		}
+	}
+}
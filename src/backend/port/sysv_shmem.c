@@ -24,6 +24,9 @@
 #include <sys/file.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 #ifdef HAVE_SYS_IPC_H
 #include <sys/ipc.h>
 #endif
@@ -536,6 +539,82 @@ AnonymousShmemDetach(int status, Datum arg)
 
 #endif							/* USE_ANONYMOUS_SHMEM */
 
+#if defined(USE_ANONYMOUS_SHMEM) && defined(__linux__) && defined(SYS_mbind)
+
+/* From linux/mempolicy.h */
+#define PG_MPOL_INTERLEAVE		3
+
+/* Highest number of NUMA nodes we handle */
+#define PG_MAX_NUMA_NODES		1024
+
+/*
+ * InterleaveSharedMemory --- spread the pages of a shared memory block over
+ * all online NUMA nodes
+ *
+ * This must be done before the pages are touched, later faults allocate the
+ * pages round-robin over the nodes by the policy set here. The kernel
+ * restricts the nodes to those allowed to the process. Failures are not
+ * fatal, the block just keeps the default placement.
+ */
+static void
+InterleaveSharedMemory(void *ptr, Size size)
+{
+	unsigned long nodemask[PG_MAX_NUMA_NODES / (8 * sizeof(unsigned long))];
+	const int	bits = 8 * sizeof(unsigned long);
+	FILE	   *file;
+	char		buf[1024];
+	char	   *p;
+	int			maxnode = -1;
+	int			nnodes = 0;
+
+	/* The file lists the nodes as ranges, like "0-3" or "0,2-3" */
+	file = AllocateFile("/sys/devices/system/node/online", "r");
+	if (file == NULL)
+	{
+		elog(DEBUG1, "could not read NUMA nodes, shared memory not interleaved: %m");
+		return;
+	}
+	if (fgets(buf, sizeof(buf), file) == NULL)
+		buf[0] = '\0';
+	FreeFile(file);
+
+	memset(nodemask, 0, sizeof(nodemask));
+	p = buf;
+	while (*p >= '0' && *p <= '9')
+	{
+		long		first;
+		long		last;
+		long		node;
+
+		first = last = strtol(p, &p, 10);
+		if (*p == '-')
+			last = strtol(p + 1, &p, 10);
+		for (node = first; node <= last && node < PG_MAX_NUMA_NODES; node++)
+		{
+			nodemask[node / bits] |= 1UL << (node % bits);
+			maxnode = Max(maxnode, (int) node);
+			nnodes++;
+		}
+		if (*p == ',')
+			p++;
+	}
+
+	if (nnodes <= 1)
+	{
+		elog(DEBUG1, "single NUMA node, shared memory not interleaved");
+		return;
+	}
+
+	/* The kernel expects one more than the highest node number */
+	if (syscall(SYS_mbind, ptr, size, PG_MPOL_INTERLEAVE, nodemask,
+				(unsigned long) maxnode + 2, 0) != 0)
+		elog(LOG, "could not interleave shared memory across NUMA nodes: %m");
+	else
+		elog(DEBUG1, "interleaved shared memory across %d NUMA nodes", nnodes);
+}
+
+#endif							/* USE_ANONYMOUS_SHMEM && __linux__ && SYS_mbind */
+
 /*
  * PGSharedMemoryCreate
  *
@@ -580,6 +659,11 @@ PGSharedMemoryCreate(Size size, bool makePrivate, int port,
 	AnonymousShmem = CreateAnonymousSegment(&size);
 	AnonymousShmemSize = size;
 
+#if defined(__linux__) && defined(SYS_mbind)
+	if (shared_memory_interleave)
+		InterleaveSharedMemory(AnonymousShmem, AnonymousShmemSize);
+#endif
+
 	/* Register on-exit routine to unmap the anonymous segment */
 	on_shmem_exit(AnonymousShmemDetach, (Datum) 0);
 
@@ -2692,6 +2692,10 @@ perform_work_item(AutoVacuumWorkItem *workitem)
 									ObjectIdGetDatum(workitem->avw_relation),
 									Int64GetDatum((int64) workitem->avw_blockNumber));
 				break;
+			case AVW_GINCleanPendingList:
+				DirectFunctionCall1(gin_clean_pending_list,
+									ObjectIdGetDatum(workitem->avw_relation));
+				break;
 			default:
 				elog(WARNING, "unrecognized work item found: type %d",
 					 workitem->avw_type);
@@ -3205,6 +3209,10 @@ autovac_report_workitem(AutoVacuumWorkItem *workitem,
 			snprintf(activity, MAX_AUTOVAC_ACTIV_LEN,
 					 "autovacuum: BRIN summarize");
 			break;
+		case AVW_GINCleanPendingList:
+			snprintf(activity, MAX_AUTOVAC_ACTIV_LEN,
+					 "autovacuum: GIN pending list cleanup");
+			break;
 	}
 
 	/*
@@ -3252,10 +3260,6 @@ AutoVacuumRequestWork(AutoVacuumWorkItemType type, Oid relationId,
 
 	LWLockAcquire(AutovacuumLock, LW_EXCLUSIVE);
 
-	/*
-	 * It may be useful to de-duplicate the list upon insertion.  For the only
-	 * currently existing caller, this is not necessary.
-	 */
 
 	/* First use in this process?  Set up DSA */
 	if (!AutoVacuumDSA)
@@ -3316,6 +3320,27 @@ AutoVacuumRequestWork(AutoVacuumWorkItemType type, Oid relationId,
 	workitems = (AutovacWorkItems *)
 		dsa_get_address(AutoVacuumDSA, AutoVacuumShmem->av_workitems);
 
+	/*
+	 * GIN indexes ask again as their pending list grows, so drop requests
+	 * that are already queued and not yet being worked on.
+	 */
+	for (wi_ptr = workitems->avs_usedItems; wi_ptr != InvalidDsaPointer;
+		 wi_ptr = workitem->avw_next)
+	{
+		workitem = dsa_get_address(AutoVacuumDSA, wi_ptr);
+		if (workitem->avw_type == type &&
+			workitem->avw_database == MyDatabaseId &&
+			workitem->avw_relation == relationId &&
+			workitem->avw_blockNumber == blkno &&
+			!workitem->avw_active)
+		{
+			LWLockRelease(AutovacuumLock);
+			dsa_detach(AutoVacuumDSA);
+			AutoVacuumDSA = NULL;
+			return;
+		}
+	}
+
 	/* If array is full, disregard the request */
 	if (workitems->avs_freeItems == InvalidDsaPointer)
 	{
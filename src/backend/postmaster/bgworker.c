@@ -18,6 +18,8 @@
 #include "access/parallel.h"
 #include "miscadmin.h"
 #include "pgstat.h"
+#include "pgxc/commitbatcher.h"
+#include "pgxc/globaldeadlock.h"
 #include "port/atomics.h"
 #include "postmaster/bgworker_internals.h"
 #include "postmaster/postmaster.h"
@@ -129,7 +131,15 @@ static const struct
 	},
 	{
 		"ApplyWorkerMain", ApplyWorkerMain
+	},
+#ifdef PGXC
+	{
+		"CommitBatcherMain", CommitBatcherMain
+	},
+	{
+		"GlobalDeadlockDetectorMain", GlobalDeadlockDetectorMain
 	}
+#endif
 };
 
 /* Private functions. */
@@ -139,6 +139,13 @@ static CheckpointerShmemStruct *CheckpointerShmem;
 /* interval for calling AbsorbFsyncRequests in CheckpointWriteDelay */
 #define WRITES_PER_ABSORB		1000
 
+/*
+ * Length of the naps CheckpointWriteDelay takes when ahead of schedule, and
+ * how many of them make up the interval of its other duties.
+ */
+#define CHECKPOINT_NAP_USECS	10000L
+#define NAPS_PER_DUTIES			10
+
 /*
  * GUC parameters
  */
@@ -676,6 +683,7 @@ void
 CheckpointWriteDelay(int flags, double progress)
 {
 	static int	absorb_counter = WRITES_PER_ABSORB;
+	static int	duties_counter = 0;
 
 	/* Do nothing if checkpoint is being executed by non-checkpointer process */
 	if (!AmCheckpointerProcess())
@@ -690,31 +698,42 @@ CheckpointWriteDelay(int flags, double progress)
 		!ImmediateCheckpointRequested() &&
 		IsCheckpointOnSchedule(progress))
 	{
-		if (got_SIGHUP)
+		if (--duties_counter <= 0)
 		{
-			got_SIGHUP = false;
-			ProcessConfigFile(PGC_SIGHUP);
-			/* update shmem copies of config variables */
-			UpdateSharedMemoryConfig();
-		}
+			if (got_SIGHUP)
+			{
+				got_SIGHUP = false;
+				ProcessConfigFile(PGC_SIGHUP);
+				/* update shmem copies of config variables */
+				UpdateSharedMemoryConfig();
+			}
 
-		AbsorbFsyncRequests();
-		absorb_counter = WRITES_PER_ABSORB;
+			AbsorbFsyncRequests();
+			absorb_counter = WRITES_PER_ABSORB;
 
-		CheckArchiveTimeout();
+			CheckArchiveTimeout();
 
-		/*
-		 * Report interim activity statistics to the stats collector.
-		 */
-		pgstat_send_bgwriter();
+			/*
+			 * Report interim activity statistics to the stats collector.
+			 */
+			pgstat_send_bgwriter();
+
+			duties_counter = NAPS_PER_DUTIES;
+		}
+		else if (--absorb_counter <= 0)
+		{
+			AbsorbFsyncRequests();
+			absorb_counter = WRITES_PER_ABSORB;
+		}
 
 		/*
-		 * This sleep used to be connected to bgwriter_delay, typically 200ms.
-		 * That resulted in more frequent wakeups if not much work to do.
-		 * Checkpointer and bgwriter are no longer related so take the Big
-		 * Sleep.
+		 * We nap after each write while ahead of schedule, and write at full
+		 * speed once behind. Long naps therefore turn into bursts of writes
+		 * catching up with the schedule, which show up as latency spikes
+		 * elsewhere. Short naps keep the writes spread evenly, while the
+		 * other duties above are still done only every 100ms or so.
 		 */
-		pg_usleep(100000L);
+		pg_usleep(CHECKPOINT_NAP_USECS);
 	}
 	else if (--absorb_counter <= 0)
 	{
@@ -4,6 +4,16 @@
  *
  * Postgres-XL Cluster Monitor
  *
+ * The cluster monitor reports the xmin of the node to GTM and keeps the
+ * global xmin it gets back. With cluster_monitor_health_interval set it also
+ * samples the health of the cluster: it pings the other nodes with PQping,
+ * which does not authenticate, and records the round trip along with the
+ * connections the pooler has in use to each of them, the latency of its
+ * last xmin report to GTM and the replication lag of the local node. The
+ * samples of the last rounds are kept in a ring in shared memory, shown by
+ * the pg_stat_cluster_health view and available to other code through
+ * ClusterMonitorGetNodeHealth.
+ *
  * Portions Copyright (c) 2015, 2ndQuadrant Ltd
  * Portions Copyright (c) 2012-2014, TransLattice, Inc.
  * Portions Copyright (c) 1996-2015, PostgreSQL Global Development Group
@@ -25,24 +35,33 @@
 #include "access/gtm.h"
 #include "access/transam.h"
 #include "access/xact.h"
+#include "catalog/pgxc_node.h"
+#include "funcapi.h"
 #include "gtm/gtm_c.h"
 #include "gtm/gtm_gxid.h"
 #include "libpq/pqsignal.h"
 #include "miscadmin.h"
+#include "pgxc/nodemgr.h"
 #include "pgxc/pgxc.h"
+#include "pgxc/poolmgr.h"
+#include "portability/instr_time.h"
 #include "postmaster/clustermon.h"
 #include "postmaster/fork_process.h"
 #include "postmaster/postmaster.h"
+#include "replication/walsender.h"
+#include "replication/walsender_private.h"
 #include "storage/ipc.h"
 #include "storage/proc.h"
 #include "storage/procarray.h"
 #include "storage/spin.h"
 #include "tcop/tcopprot.h"
+#include "utils/builtins.h"
 #include "utils/memutils.h"
 #include "utils/ps_status.h"
 #include "utils/timeout.h"
 #include "utils/timestamp.h"
 #include "pgstat.h"
+#include "../interfaces/libpq/libpq-fe.h"
 
 /* Flags to tell if we are in a clustermon process */
 static bool am_clustermon = false;
@@ -55,15 +74,67 @@ static volatile sig_atomic_t got_SIGTERM = false;
 static MemoryContext ClusterMonitorMemCxt;
 static ClusterMonitorCtlData *ClusterMonitorCtl = NULL; 
 
+/*
+ * Ring of the health samples. The cluster monitor is the only writer, it
+ * makes changecount odd while it adds a round, readers retry until they see
+ * the same even value before and after copying the samples.
+ */
+typedef struct ClusterHealthRing
+{
+	uint32		changecount;
+	int			size;			/* number of slots */
+	uint64		next;			/* samples written so far */
+	ClusterHealthSample samples[FLEXIBLE_ARRAY_MEMBER];
+} ClusterHealthRing;
+
+static ClusterHealthRing *ClusterHealth = NULL;
+
+/* Rounds of health samples kept */
+#define CLUSTER_HEALTH_ROUNDS			16
+/* Ping timeout, seconds, libpq does not accept less than 2 */
+#define CLUSTER_HEALTH_PING_TIMEOUT		2
+
+/* Latency and outcome of the last xmin report, sampled as GTM health */
+static int	cm_gtm_rtt = -1;
+static bool cm_gtm_reachable = false;
+
 static void cm_sighup_handler(SIGNAL_ARGS);
 static void cm_sigterm_handler(SIGNAL_ARGS);
 static void ClusterMonitorSetReportedGlobalXmin(GlobalTransactionId xmin);
 static void ClusterMonitorSetReportingGlobalXmin(GlobalTransactionId xmin);
+static void cm_sample_health(void);
 
 /* PID of clustser monitoring process */
 int			ClusterMonitorPid = 0;
 
-#define CLUSTER_MONITOR_NAPTIME	5
+/* GUC parameters */
+int			ClusterMonitorNaptime = 5000;
+int			ClusterMonitorXminThreshold = 1000;
+int			ClusterMonitorHealthInterval = 0;
+
+/*
+ * How often the local xmin is checked against the threshold, ms. This is a
+ * scan of the local proc array, much cheaper than a report to GTM.
+ */
+#define CLUSTER_MONITOR_POLL_INTERVAL	200
+/* Report interval is randomly varied by that many percent */
+#define CLUSTER_MONITOR_JITTER			10
+
+/*
+ * Time of the next regular report: report interval varied by the jitter, so
+ * nodes started together do not keep reporting to GTM at the same moment.
+ */
+static TimestampTz
+cm_next_report_time(void)
+{
+	long		interval = ClusterMonitorNaptime;
+	long		jitter = interval * CLUSTER_MONITOR_JITTER / 100;
+
+	if (jitter > 0)
+		interval += (long) (random() % (2 * jitter + 1)) - jitter;
+
+	return TimestampTzPlusMilliseconds(GetCurrentTimestamp(), interval);
+}
 
 /*
  * Main loop for the cluster monitor process.
@@ -79,6 +150,11 @@ ClusterMonitorInit(void)
 	GlobalTransactionId newOldestXmin;
 	GlobalTransactionId lastGlobalXmin;
 	GlobalTransactionId latestCompletedXid;
+	GlobalTransactionId lastReportedXmin = InvalidGlobalTransactionId;
+	TimestampTz next_report;
+	TimestampTz next_health;
+	instr_time	gtm_start;
+	instr_time	gtm_time;
 	int status;
 
 	am_clustermon = true;
@@ -191,17 +267,33 @@ ClusterMonitorInit(void)
 	SetConfigOption("statement_timeout", "0", PGC_SUSET, PGC_S_OVERRIDE);
 	SetConfigOption("lock_timeout", "0", PGC_SUSET, PGC_S_OVERRIDE);
 
+	/* Report right away */
+	next_report = GetCurrentTimestamp();
+	next_health = next_report;
+
 	/* loop until shutdown request */
 	while (!got_SIGTERM)
 	{
-		struct timeval nap;
+		long		secs;
+		int			usecs;
+		long		nap;
 		int			rc;
 
 		/*
-		 * Repeat at CLUSTER_MONITOR_NAPTIME seconds interval
+		 * Sleep until the next regular report is due, but wake up every
+		 * CLUSTER_MONITOR_POLL_INTERVAL to see if the local xmin has advanced
+		 * enough to report it earlier.
 		 */
-		nap.tv_sec = CLUSTER_MONITOR_NAPTIME;
-		nap.tv_usec = 0;
+		TimestampDifference(GetCurrentTimestamp(), next_report, &secs, &usecs);
+		nap = secs * 1000L + usecs / 1000;
+		if (ClusterMonitorXminThreshold > 0)
+			nap = Min(nap, CLUSTER_MONITOR_POLL_INTERVAL);
+		if (ClusterMonitorHealthInterval > 0)
+		{
+			TimestampDifference(GetCurrentTimestamp(), next_health,
+								&secs, &usecs);
+			nap = Min(nap, secs * 1000L + usecs / 1000);
+		}
 
 		/*
 		 * Wait until naptime expires or we get some type of signal (all the
@@ -209,7 +301,7 @@ ClusterMonitorInit(void)
 		 */
 		rc = WaitLatch(MyLatch,
 					   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
-					   (nap.tv_sec * 1000L) + (nap.tv_usec / 1000L),
+					   nap,
 					   WAIT_EVENT_CLUSTER_MONITOR_MAIN);
 
 		ResetLatch(MyLatch);
@@ -234,6 +326,37 @@ ClusterMonitorInit(void)
 			ProcessConfigFile(PGC_SIGHUP);
 		}
 
+		if (ClusterMonitorHealthInterval > 0 &&
+			GetCurrentTimestamp() >= next_health)
+		{
+			cm_sample_health();
+			next_health = TimestampTzPlusMilliseconds(GetCurrentTimestamp(),
+												ClusterMonitorHealthInterval);
+		}
+
+		/*
+		 * Between the regular reports only report if the local xmin has moved
+		 * at least ClusterMonitorXminThreshold transactions ahead, so the
+		 * global xmin follows closely when there is progress and GTM does
+		 * not get reports that change nothing.
+		 */
+		if (GetCurrentTimestamp() < next_report)
+		{
+			GlobalTransactionId localXmin;
+
+			if (ClusterMonitorXminThreshold <= 0 ||
+				!GlobalTransactionIdIsValid(lastReportedXmin))
+				continue;
+
+			localXmin = GetOldestXminInternal(NULL, 0, true,
+											  ClusterMonitorGetGlobalXmin());
+			if (!TransactionIdFollows(localXmin, lastReportedXmin) ||
+				(int32) (localXmin - lastReportedXmin) <
+				ClusterMonitorXminThreshold)
+				continue;
+		}
+		next_report = cm_next_report_time();
+
 		/*
 		 * Compute RecentGlobalXmin, report it to the GTM and sleep for the set
 		 * interval. Keep doing this forever
@@ -244,8 +367,15 @@ ClusterMonitorInit(void)
 		ClusterMonitorSetReportingGlobalXmin(oldestXmin);
 		LWLockRelease(ClusterMonitorLock);
 
-		if ((status = ReportGlobalXmin(oldestXmin, &newOldestXmin,
-						&latestCompletedXid)))
+		INSTR_TIME_SET_CURRENT(gtm_start);
+		status = ReportGlobalXmin(oldestXmin, &newOldestXmin,
+								  &latestCompletedXid);
+		INSTR_TIME_SET_CURRENT(gtm_time);
+		INSTR_TIME_SUBTRACT(gtm_time, gtm_start);
+		cm_gtm_rtt = (int) INSTR_TIME_GET_MICROSEC(gtm_time);
+		cm_gtm_reachable = (status != EOF && status != GTM_ERRCODE_UNKNOWN);
+
+		if (status)
 		{
 			elog(DEBUG1, "Failed (status %d) to report RecentGlobalXmin "
 					"- reported RecentGlobalXmin %d, received "
@@ -274,6 +404,7 @@ ClusterMonitorInit(void)
 						TransactionIdPrecedes(oldestXmin, latestCompletedXid))
 				{
 					SetLatestCompletedXid(latestCompletedXid);
+					next_report = GetCurrentTimestamp();
 					continue;
 				}
 			}
@@ -287,6 +418,7 @@ ClusterMonitorInit(void)
 
 			SetLatestCompletedXid(latestCompletedXid);
 			ClusterMonitorSetReportedGlobalXmin(oldestXmin);
+			lastReportedXmin = oldestXmin;
 			if (GlobalTransactionIdIsValid(newOldestXmin))
 				ClusterMonitorSetGlobalXmin(newOldestXmin);
 		}
@@ -340,11 +472,26 @@ IsClusterMonitorProcess(void)
 	return am_clustermon;
 }
 
+/* Room for the samples of all the nodes and GTM in each round */
+static int
+cm_health_ring_slots(void)
+{
+	return CLUSTER_HEALTH_ROUNDS * (MaxCoords + MaxDataNodes + 1);
+}
+
+static Size
+cm_health_ring_size(void)
+{
+	return add_size(offsetof(ClusterHealthRing, samples),
+					mul_size(cm_health_ring_slots(),
+							 sizeof(ClusterHealthSample)));
+}
+
 /* Report shared-memory space needed by ClusterMonitor */
 Size
 ClusterMonitorShmemSize(void)
 {
-	return sizeof (ClusterMonitorCtlData);
+	return add_size(sizeof (ClusterMonitorCtlData), cm_health_ring_size());
 }
 
 void
@@ -353,14 +500,321 @@ ClusterMonitorShmemInit(void)
 	bool		found;
 
 	ClusterMonitorCtl = (ClusterMonitorCtlData *)
-		ShmemInitStruct("Cluster Monitor Ctl", ClusterMonitorShmemSize(), &found);
+		ShmemInitStruct("Cluster Monitor Ctl", sizeof (ClusterMonitorCtlData),
+						&found);
 
 	if (!found)
 	{
 		/* First time through, so initialize */
-		MemSet(ClusterMonitorCtl, 0, ClusterMonitorShmemSize());
+		MemSet(ClusterMonitorCtl, 0, sizeof (ClusterMonitorCtlData));
 		SpinLockInit(&ClusterMonitorCtl->mutex);
 	}
+
+	ClusterHealth = (ClusterHealthRing *)
+		ShmemInitStruct("Cluster Monitor Health", cm_health_ring_size(),
+						&found);
+
+	if (!found)
+	{
+		MemSet(ClusterHealth, 0, offsetof(ClusterHealthRing, samples));
+		ClusterHealth->size = cm_health_ring_slots();
+	}
+}
+
+/*
+ * Ping a node, returns the round trip in microseconds.
+ */
+static int
+cm_ping_node(NodeDefinition *node, bool *reachable)
+{
+	char		connstr[256];
+	instr_time	start;
+	instr_time	duration;
+	PGPing		status;
+
+	snprintf(connstr, sizeof(connstr), "host='%s' port=%d connect_timeout=%d",
+			 NameStr(node->nodehost), node->nodeport,
+			 CLUSTER_HEALTH_PING_TIMEOUT);
+
+	INSTR_TIME_SET_CURRENT(start);
+	status = PQping(connstr);
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+
+	*reachable = (status == PQPING_OK);
+	return (int) INSTR_TIME_GET_MICROSEC(duration);
+}
+
+/*
+ * Largest replay lag of the standbys streaming from the local node.
+ */
+static TimeOffset
+cm_replication_lag(void)
+{
+	TimeOffset	lag = -1;
+	int			i;
+
+	if (WalSndCtl == NULL)
+		return -1;
+
+	for (i = 0; i < max_wal_senders; i++)
+	{
+		WalSnd	   *walsnd = &WalSndCtl->walsnds[i];
+		TimeOffset	applyLag = -1;
+
+		SpinLockAcquire(&walsnd->mutex);
+		if (walsnd->pid != 0)
+			applyLag = walsnd->applyLag;
+		SpinLockRelease(&walsnd->mutex);
+
+		lag = Max(lag, applyLag);
+	}
+
+	return lag;
+}
+
+/*
+ * Take a round of health samples and add it to the ring.
+ */
+static void
+cm_sample_health(void)
+{
+	Oid		   *coOids;
+	Oid		   *dnOids;
+	int			numCoords;
+	int			numDns;
+	ClusterHealthSample *samples;
+	int			nsamples = 0;
+	int			i;
+
+	PgxcNodeGetOids(&coOids, &dnOids, &numCoords, &numDns, false);
+	samples = (ClusterHealthSample *)
+		palloc((numCoords + numDns + 1) * sizeof(ClusterHealthSample));
+
+	for (i = 0; i < numCoords + numDns; i++)
+	{
+		Oid			nodeoid = i < numCoords ? coOids[i] : dnOids[i - numCoords];
+		ClusterHealthSample *sample = &samples[nsamples];
+		NodeDefinition *node = PgxcNodeGetDefinition(nodeoid);
+
+		/* dropped meanwhile */
+		if (node == NULL)
+			continue;
+
+		sample->nodeoid = nodeoid;
+		sample->node_type = i < numCoords ? PGXC_NODE_COORDINATOR :
+			PGXC_NODE_DATANODE;
+		if (PGXCNodeName && strcmp(NameStr(node->nodename), PGXCNodeName) == 0)
+		{
+			sample->reachable = true;
+			sample->rtt = -1;
+			sample->pool_active = -1;
+			sample->replication_lag = cm_replication_lag();
+		}
+		else
+		{
+			sample->rtt = cm_ping_node(node, &sample->reachable);
+			sample->pool_active = node->nodeactive;
+			sample->replication_lag = -1;
+		}
+		sample->sample_time = GetCurrentTimestamp();
+		nsamples++;
+		pfree(node);
+	}
+
+	if (cm_gtm_rtt >= 0)
+	{
+		ClusterHealthSample *sample = &samples[nsamples++];
+
+		sample->sample_time = GetCurrentTimestamp();
+		sample->nodeoid = InvalidOid;
+		sample->node_type = CLUSTER_HEALTH_GTM;
+		sample->reachable = cm_gtm_reachable;
+		sample->rtt = cm_gtm_rtt;
+		sample->pool_active = -1;
+		sample->replication_lag = -1;
+	}
+
+	ClusterHealth->changecount++;
+	pg_write_barrier();
+	for (i = 0; i < nsamples; i++)
+	{
+		ClusterHealth->samples[ClusterHealth->next % ClusterHealth->size] =
+			samples[i];
+		ClusterHealth->next++;
+	}
+	pg_write_barrier();
+	ClusterHealth->changecount++;
+
+	pfree(samples);
+	pfree(coOids);
+	pfree(dnOids);
+}
+
+/*
+ * Copy the health samples kept, oldest first. Returns the number of samples,
+ * allocated in the current memory context.
+ */
+int
+ClusterMonitorGetHealth(ClusterHealthSample **samples)
+{
+	ClusterHealthSample *copy;
+	int			size = ClusterHealth->size;
+	int			nsamples;
+
+	copy = (ClusterHealthSample *) palloc(size * sizeof(ClusterHealthSample));
+
+	for (;;)
+	{
+		uint32		before;
+		uint32		after;
+		uint64		next;
+		int			i;
+
+		before = ClusterHealth->changecount;
+		pg_read_barrier();
+
+		next = ClusterHealth->next;
+		nsamples = (int) Min(next, (uint64) size);
+		for (i = 0; i < nsamples; i++)
+			copy[i] = ClusterHealth->samples[(next - nsamples + i) % size];
+
+		pg_read_barrier();
+		after = ClusterHealth->changecount;
+
+		if (before == after && (before & 1) == 0)
+			break;
+
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	*samples = copy;
+	return nsamples;
+}
+
+/*
+ * Latest health sample of a node, for routing decisions. Returns false if
+ * the node is not known to be reachable; *rtt is set to its last ping round
+ * trip in microseconds, or -1 if there is none.
+ */
+bool
+ClusterMonitorGetNodeHealth(Oid nodeoid, int *rtt)
+{
+	ClusterHealthSample *samples;
+	int			nsamples;
+	bool		reachable = false;
+	int			i;
+
+	*rtt = -1;
+	nsamples = ClusterMonitorGetHealth(&samples);
+	for (i = nsamples - 1; i >= 0; i--)
+	{
+		if (samples[i].nodeoid == nodeoid &&
+			samples[i].node_type != CLUSTER_HEALTH_GTM)
+		{
+			reachable = samples[i].reachable;
+			*rtt = samples[i].rtt;
+			break;
+		}
+	}
+	pfree(samples);
+
+	return reachable;
+}
+
+/*
+ * pg_stat_get_cluster_health
+ *
+ * Return the health samples taken by the cluster monitor, backing the
+ * pg_stat_cluster_health view.
+ */
+Datum
+pg_stat_get_cluster_health(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_CLUSTER_HEALTH_COLS	8
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	ClusterHealthSample *samples;
+	int			nsamples;
+	int			i;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	nsamples = ClusterMonitorGetHealth(&samples);
+
+	for (i = 0; i < nsamples; i++)
+	{
+		ClusterHealthSample *sample = &samples[i];
+		Datum		values[PG_STAT_GET_CLUSTER_HEALTH_COLS];
+		bool		nulls[PG_STAT_GET_CLUSTER_HEALTH_COLS];
+
+		MemSet(nulls, 0, sizeof(nulls));
+
+		values[0] = TimestampTzGetDatum(sample->sample_time);
+		if (OidIsValid(sample->nodeoid))
+			values[1] = ObjectIdGetDatum(sample->nodeoid);
+		else
+			nulls[1] = true;
+		values[2] = CharGetDatum(sample->node_type);
+		values[3] = BoolGetDatum(sample->reachable);
+		if (sample->rtt >= 0)
+			values[4] = Float8GetDatum((double) sample->rtt / 1000.0);
+		else
+			nulls[4] = true;
+		if (sample->pool_active >= 0)
+		{
+			values[5] = Int32GetDatum(sample->pool_active);
+			values[6] = Float8GetDatum(MaxPoolSize > 0 ?
+									   (double) sample->pool_active /
+									   MaxPoolSize : 0.0);
+		}
+		else
+		{
+			nulls[5] = true;
+			nulls[6] = true;
+		}
+		if (sample->replication_lag >= 0)
+		{
+			Interval   *lag = (Interval *) palloc0(sizeof(Interval));
+
+			lag->time = sample->replication_lag;
+			values[7] = IntervalPGetDatum(lag);
+		}
+		else
+			nulls[7] = true;
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
 }
 
 GlobalTransactionId
@@ -3578,6 +3578,12 @@ pgstat_get_wait_activity(WaitEventActivity w)
 		case WAIT_EVENT_CLUSTER_MONITOR_MAIN:
 			event_name = "ClusterMonitorMain";
 			break;
+		case WAIT_EVENT_COMMIT_BATCHER_MAIN:
+			event_name = "CommitBatcherMain";
+			break;
+		case WAIT_EVENT_GLOBAL_DEADLOCK_DETECTOR_MAIN:
+			event_name = "GlobalDeadlockDetectorMain";
+			break;
 			/* no default case, so that compiler will warn */
 	}
 
@@ -3621,6 +3627,39 @@ pgstat_get_wait_client(WaitEventClient w)
 		case WAIT_EVENT_WAL_SENDER_WRITE_DATA:
 			event_name = "WalSenderWriteData";
 			break;
+		case WAIT_EVENT_REMOTE_NODE_READ:
+			event_name = "RemoteNodeRead";
+			break;
+		case WAIT_EVENT_REMOTE_COORDINATOR_READ:
+			event_name = "RemoteCoordinatorRead";
+			break;
+		case WAIT_EVENT_REMOTE_DATANODE_READ:
+			event_name = "RemoteDatanodeRead";
+			break;
+		case WAIT_EVENT_POOLER_GET_CONNECTIONS:
+			event_name = "PoolerGetConnections";
+			break;
+		case WAIT_EVENT_GTM_BEGIN:
+			event_name = "GTMBeginTransaction";
+			break;
+		case WAIT_EVENT_GTM_SNAPSHOT:
+			event_name = "GTMGetSnapshot";
+			break;
+		case WAIT_EVENT_GTM_COMMIT:
+			event_name = "GTMCommitTransaction";
+			break;
+		case WAIT_EVENT_GTM_ROLLBACK:
+			event_name = "GTMRollbackTransaction";
+			break;
+		case WAIT_EVENT_GTM_PREPARE:
+			event_name = "GTMPrepareTransaction";
+			break;
+		case WAIT_EVENT_GTM_START_PREPARED:
+			event_name = "GTMStartPreparedTransaction";
+			break;
+		case WAIT_EVENT_GTM_COMMIT_PREPARED:
+			event_name = "GTMCommitPreparedTransaction";
+			break;
 			/* no default case, so that compiler will warn */
 	}
 
@@ -3691,6 +3730,21 @@ pgstat_get_wait_ipc(WaitEventIPC w)
 		case WAIT_EVENT_SYNC_REP:
 			event_name = "SyncRep";
 			break;
+		case WAIT_EVENT_COMMIT_BATCHER:
+			event_name = "CommitBatcher";
+			break;
+		case WAIT_EVENT_SQUEUE_CONSUMER:
+			event_name = "SQueueConsumer";
+			break;
+		case WAIT_EVENT_SQUEUE_PRODUCER:
+			event_name = "SQueueProducer";
+			break;
+		case WAIT_EVENT_SQUEUE_FINISH:
+			event_name = "SQueueFinish";
+			break;
+		case WAIT_EVENT_ADMISSION_CONTROL:
+			event_name = "AdmissionControl";
+			break;
 			/* no default case, so that compiler will warn */
 	}
 
@@ -3719,6 +3773,9 @@ pgstat_get_wait_timeout(WaitEventTimeout w)
 		case WAIT_EVENT_RECOVERY_APPLY_DELAY:
 			event_name = "RecoveryApplyDelay";
 			break;
+		case WAIT_EVENT_BARRIER_REPLAY:
+			event_name = "BarrierReplay";
+			break;
 			/* no default case, so that compiler will warn */
 	}
 
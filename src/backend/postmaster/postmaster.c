@@ -114,6 +114,7 @@
 #include "pgxc/locator.h"
 #include "nodes/nodes.h"
 #include "pgxc/poolmgr.h"
+#include "pgxc/globaldeadlock.h"
 #include "access/gtm.h"
 #endif
 #include "pg_getopt.h"
@@ -548,6 +549,7 @@ typedef struct
 	bool		IsBinaryUpgrade;
 	int			max_safe_fds;
 	int			MaxBackends;
+	int			FastPathLockGroupsPerBackend;
 #ifdef WIN32
 	HANDLE		PostmasterHandle;
 	HANDLE		initial_signal_pipe;
@@ -603,6 +605,9 @@ bool isRestoreMode = false;
 
 int remoteConnType = REMOTE_CONN_APP;
 
+/* Compress the stream to and from the node that opened the connection */
+bool remoteCompression = false;
+
 /* key pair to be used as object id while using advisory lock for backup */
 Datum xc_lockForBackupKey1;
 Datum xc_lockForBackupKey2;
@@ -1071,6 +1076,12 @@ PostmasterMain(int argc, char *argv[])
 	 */
 	ApplyLauncherRegister();
 
+#ifdef PGXC
+	/* Global deadlocks are looked for by every Coordinator */
+	if (IS_PGXC_COORDINATOR)
+		GlobalDeadlockDetectorRegister();
+#endif
+
 	/*
 	 * process any libraries that should be preloaded at postmaster start
 	 */
@@ -6245,6 +6256,7 @@ save_backend_variables(BackendParameters *param, Port *port,
 	param->max_safe_fds = max_safe_fds;
 
 	param->MaxBackends = MaxBackends;
+	param->FastPathLockGroupsPerBackend = FastPathLockGroupsPerBackend;
 
 #ifdef WIN32
 	param->PostmasterHandle = PostmasterHandle;
@@ -6477,6 +6489,7 @@ restore_backend_variables(BackendParameters *param, Port *port)
 	max_safe_fds = param->max_safe_fds;
 
 	MaxBackends = param->MaxBackends;
+	FastPathLockGroupsPerBackend = param->FastPathLockGroupsPerBackend;
 
 #ifdef WIN32
 	PostmasterHandle = param->PostmasterHandle;
@@ -47,6 +47,17 @@
 
 #include "storage/fd.h"
 
+#ifdef XCP
+#include "executor/executor.h"
+#include "pgxc/execRemote.h"
+#include "pgxc/pgxc.h"
+#include "pgxc/planner.h"
+#include "utils/datum.h"
+#include "utils/hsearch.h"
+#include "utils/snapmgr.h"
+#include "utils/timestamp.h"
+#endif
+
 /* private date for writing out data */
 typedef struct DecodingOutputState
 {
@@ -421,3 +432,287 @@ pg_logical_emit_message_text(PG_FUNCTION_ARGS)
 	/* bytea and text are compatible */
 	return pg_logical_emit_message_bytea(fcinfo);
 }
+
+#ifdef XCP
+/* A change decoded on a Datanode, gathered by pgxc_logical_slot_changes */
+typedef struct ClusterChange
+{
+	Datum		node;
+	XLogRecPtr	lsn;
+	TransactionId xid;
+	TimestampTz commit_time;
+	bool		has_commit_time;
+	Datum		data;
+	int			seq;			/* order of arrival from its Datanode */
+} ClusterChange;
+
+/* Earliest commit time of a transaction over the Datanodes */
+typedef struct ClusterChangeXact
+{
+	TransactionId xid;			/* hash key */
+	TimestampTz commit_time;
+	bool		has_commit_time;
+} ClusterChangeXact;
+
+static int
+cluster_change_cmp(const void *a, const void *b)
+{
+	const ClusterChange *ca = (const ClusterChange *) a;
+	const ClusterChange *cb = (const ClusterChange *) b;
+	int			cmp;
+
+	/* Transactions with no commit time known go last, in GXID order */
+	if (ca->has_commit_time != cb->has_commit_time)
+		return ca->has_commit_time ? -1 : 1;
+	if (ca->has_commit_time && ca->commit_time != cb->commit_time)
+		return ca->commit_time < cb->commit_time ? -1 : 1;
+	if (ca->xid != cb->xid)
+		return TransactionIdPrecedes(ca->xid, cb->xid) ? -1 : 1;
+
+	/* Changes of a transaction are grouped by Datanode, in WAL order */
+	cmp = strcmp(NameStr(*DatumGetName(ca->node)),
+				 NameStr(*DatumGetName(cb->node)));
+	if (cmp != 0)
+		return cmp;
+	return ca->seq - cb->seq;
+}
+
+/*
+ * Decode the slot of the given name on all the Datanodes and return the
+ * changes merged in commit order of the transactions.
+ *
+ * The Datanodes decode their slot concurrently, as the RemoteQuery sends the
+ * request to all of them before reading any result. A transaction which
+ * wrote on several Datanodes is returned once, with the changes of each
+ * Datanode following each other. Transactions are ordered by their earliest
+ * commit time on the Datanodes, which is available where
+ * track_commit_timestamp is enabled, and by GXID otherwise.
+ */
+static Datum
+pgxc_logical_slot_changes(FunctionCallInfo fcinfo, bool confirm)
+{
+#define PGXC_LOGICAL_SLOT_CHANGES_COLS	5
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	Name		name;
+	Oid			typoutput;
+	bool		typisvarlena;
+	char	   *options;
+	StringInfoData sql;
+	RemoteQuery *step;
+	RemoteQueryState *node;
+	EState	   *estate;
+	TupleTableSlot *result;
+	HASHCTL		ctl;
+	HTAB	   *xacts;
+	ClusterChange *changes;
+	int			nchanges = 0;
+	int			maxchanges = 1024;
+	int			i;
+
+	check_permissions();
+
+	if (!IS_PGXC_COORDINATOR)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("cluster-wide logical decoding can only be used on a Coordinator")));
+
+	if (PG_ARGISNULL(0))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("slot name must not be null")));
+	name = PG_GETARG_NAME(0);
+
+	if (PG_ARGISNULL(2))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("options array must not be null")));
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	/* Request the changes from every Datanode */
+	getTypeOutputInfo(TEXTARRAYOID, &typoutput, &typisvarlena);
+	options = OidOutputFunctionCall(typoutput, PG_GETARG_DATUM(2));
+
+	initStringInfo(&sql);
+	appendStringInfo(&sql,
+					 "SELECT pgxc_node_str(), c.lsn, c.xid, "
+					 "CASE WHEN current_setting('track_commit_timestamp')::bool "
+					 "THEN pg_xact_commit_timestamp(c.xid) END, c.data "
+					 "FROM %s(%s, NULL, ",
+					 confirm ? "pg_logical_slot_get_changes" :
+					 "pg_logical_slot_peek_changes",
+					 quote_literal_cstr(NameStr(*name)));
+	if (PG_ARGISNULL(1))
+		appendStringInfoString(&sql, "NULL");
+	else
+		appendStringInfo(&sql, "%d", PG_GETARG_INT32(1));
+	appendStringInfo(&sql, ", VARIADIC %s::text[]) c",
+					 quote_literal_cstr(options));
+
+	step = makeNode(RemoteQuery);
+	step->combine_type = COMBINE_TYPE_NONE;
+	step->exec_nodes = NULL;
+	step->sql_statement = sql.data;
+	step->force_autocommit = false;
+	/* Consuming the changes of a slot does not write to the database */
+	step->read_only = true;
+	step->exec_type = EXEC_ON_DATANODES;
+
+	for (i = 0; i < PGXC_LOGICAL_SLOT_CHANGES_COLS; i++)
+	{
+		Var		   *var;
+
+		var = makeVar(1, i + 1,
+					  tupdesc->attrs[i]->atttypid,
+					  tupdesc->attrs[i]->atttypmod,
+					  InvalidOid,
+					  0);
+		step->scan.plan.targetlist = lappend(step->scan.plan.targetlist,
+											 makeTargetEntry((Expr *) var,
+															 i + 1,
+															 NULL,
+															 false));
+	}
+
+	MemSet(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(TransactionId);
+	ctl.entrysize = sizeof(ClusterChangeXact);
+	ctl.hcxt = per_query_ctx;
+	xacts = hash_create("Cluster Decoding Transactions", 256, &ctl,
+						HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	changes = (ClusterChange *) palloc(maxchanges * sizeof(ClusterChange));
+
+	MemoryContextSwitchTo(oldcontext);
+
+	estate = CreateExecutorState();
+
+	oldcontext = MemoryContextSwitchTo(estate->es_query_cxt);
+	estate->es_snapshot = GetActiveSnapshot();
+	node = ExecInitRemoteQuery(step, estate, 0);
+	MemoryContextSwitchTo(oldcontext);
+
+	result = ExecRemoteQuery((PlanState *) node);
+	while (result != NULL && !TupIsNull(result))
+	{
+		ClusterChange *change;
+		ClusterChangeXact *xact;
+		bool		found;
+
+		slot_getallattrs(result);
+
+		oldcontext = MemoryContextSwitchTo(per_query_ctx);
+		if (nchanges >= maxchanges)
+		{
+			maxchanges *= 2;
+			changes = (ClusterChange *)
+				repalloc_huge(changes, maxchanges * sizeof(ClusterChange));
+		}
+		change = &changes[nchanges];
+		change->node = datumCopy(result->tts_values[0], false, NAMEDATALEN);
+		change->lsn = DatumGetLSN(result->tts_values[1]);
+		change->xid = DatumGetTransactionId(result->tts_values[2]);
+		change->has_commit_time = !result->tts_isnull[3];
+		change->commit_time = change->has_commit_time ?
+			DatumGetTimestampTz(result->tts_values[3]) : 0;
+		change->data = datumCopy(result->tts_values[4], false, -1);
+		change->seq = nchanges++;
+		MemoryContextSwitchTo(oldcontext);
+
+		xact = (ClusterChangeXact *) hash_search(xacts, &change->xid,
+												 HASH_ENTER, &found);
+		if (!found)
+		{
+			xact->has_commit_time = change->has_commit_time;
+			xact->commit_time = change->commit_time;
+		}
+		else if (change->has_commit_time &&
+				 (!xact->has_commit_time ||
+				  change->commit_time < xact->commit_time))
+		{
+			xact->has_commit_time = true;
+			xact->commit_time = change->commit_time;
+		}
+
+		result = ExecRemoteQuery((PlanState *) node);
+	}
+	ExecEndRemoteQuery(node);
+	FreeExecutorState(estate);
+
+	/* Give every change the commit time of its transaction, and merge */
+	for (i = 0; i < nchanges; i++)
+	{
+		ClusterChangeXact *xact;
+
+		xact = (ClusterChangeXact *) hash_search(xacts, &changes[i].xid,
+												 HASH_FIND, NULL);
+		changes[i].has_commit_time = xact->has_commit_time;
+		changes[i].commit_time = xact->commit_time;
+	}
+	qsort(changes, nchanges, sizeof(ClusterChange), cluster_change_cmp);
+
+	for (i = 0; i < nchanges; i++)
+	{
+		Datum		values[PGXC_LOGICAL_SLOT_CHANGES_COLS];
+		bool		nulls[PGXC_LOGICAL_SLOT_CHANGES_COLS];
+
+		memset(nulls, 0, sizeof(nulls));
+		values[0] = changes[i].node;
+		values[1] = LSNGetDatum(changes[i].lsn);
+		values[2] = TransactionIdGetDatum(changes[i].xid);
+		values[3] = TimestampTzGetDatum(changes[i].commit_time);
+		nulls[3] = !changes[i].has_commit_time;
+		values[4] = changes[i].data;
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
+/*
+ * SQL function returning the changestream of all the Datanodes as text,
+ * consuming the data.
+ */
+Datum
+pgxc_logical_slot_get_changes(PG_FUNCTION_ARGS)
+{
+	return pgxc_logical_slot_changes(fcinfo, true);
+}
+
+/*
+ * SQL function returning the changestream of all the Datanodes as text,
+ * only peeking ahead.
+ */
+Datum
+pgxc_logical_slot_peek_changes(PG_FUNCTION_ARGS)
+{
+	return pgxc_logical_slot_changes(fcinfo, false);
+}
+#endif
@@ -129,6 +129,12 @@ int			backend_flush_after = 0;
  */
 int			target_prefetch_pages = 0;
 
+/*
+ * How many blocks a sequential heap scan prefetches ahead of the block it
+ * reads.  Zero leaves read-ahead to the kernel.
+ */
+int			seqscan_prefetch_pages = 0;
+
 /* local state for StartBufferIO and related functions */
 static BufferDesc *InProgressBuf = NULL;
 static bool IsForInput;
@@ -22,6 +22,12 @@
 
 #define INT_ACCESS_ONCE(var)	((int)(*((volatile int *)&(var))))
 
+/*
+ * Maximum number of consecutive buffers a backend claims from the clock hand
+ * at once, see ClockSweepTick().
+ */
+#define CLOCK_SWEEP_CHUNK	16
+
 
 /*
  * The shared freelist control information.
@@ -63,6 +69,13 @@ typedef struct
 /* Pointers to shared state */
 static BufferStrategyControl *StrategyControl = NULL;
 
+/*
+ * Part of the sweep claimed by this backend but not looked at yet, as
+ * positions in the nextVictimBuffer sequence.
+ */
+static uint32 sweepNext = 0;
+static uint32 sweepEnd = 0;
+
 /*
  * Private (non-shared) state for managing a ring of shared buffers to re-use.
  * This is currently the only kind of BufferAccessStrategy object, but someday
@@ -108,21 +121,36 @@ static void AddBufferToRing(BufferAccessStrategy strategy,
  *
  * Move the clock hand one buffer ahead of its current position and return the
  * id of the buffer now under the hand.
+ *
+ * With many backends sweeping, the atomic increment of the shared hand for
+ * every buffer looked at makes its cache line bounce between CPUs. So the
+ * hand is moved by up to CLOCK_SWEEP_CHUNK buffers at once, and the backend
+ * goes through the claimed buffers on its own. Small buffer pools keep
+ * moving the hand one buffer at a time, so that the sweep stays reasonably
+ * fair there.
  */
 static inline uint32
 ClockSweepTick(void)
 {
 	uint32		victim;
+	uint32		chunk;
+
+	if (sweepNext != sweepEnd)
+		return sweepNext++ % NBuffers;
+
+	chunk = Min(CLOCK_SWEEP_CHUNK, Max(NBuffers / 1024, 1));
 
 	/*
-	 * Atomically move hand ahead one buffer - if there's several processes
-	 * doing this, this can lead to buffers being returned slightly out of
-	 * apparent order.
+	 * Atomically move hand ahead - if there's several processes doing this,
+	 * this can lead to buffers being returned slightly out of apparent
+	 * order.
 	 */
 	victim =
-		pg_atomic_fetch_add_u32(&StrategyControl->nextVictimBuffer, 1);
+		pg_atomic_fetch_add_u32(&StrategyControl->nextVictimBuffer, chunk);
+	sweepNext = victim + 1;
+	sweepEnd = victim + chunk;
 
-	if (victim >= NBuffers)
+	if (victim + chunk > NBuffers)
 	{
 		uint32		originalVictim = victim;
 
@@ -134,14 +162,18 @@ ClockSweepTick(void)
 		 * completePasses to be incremented while holding the spinlock. We
 		 * need the spinlock so StrategySyncStart() can return a consistent
 		 * value consisting of nextVictimBuffer and completePasses.
+		 *
+		 * That is the case if our part of the sweep includes a multiple of
+		 * NBuffers other than zero.
 		 */
-		if (victim == 0)
+		if ((originalVictim + chunk - 1) / NBuffers >=
+			(originalVictim + NBuffers - 1) / NBuffers)
 		{
 			uint32		expected;
 			uint32		wrapped;
 			bool		success = false;
 
-			expected = originalVictim + 1;
+			expected = originalVictim + chunk;
 
 			while (!success)
 			{
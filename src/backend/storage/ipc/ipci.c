@@ -17,16 +17,22 @@
 
 #include "access/clog.h"
 #include "access/commit_ts.h"
+#include "access/gtm.h"
 #include "access/heapam.h"
 #include "access/multixact.h"
 #include "access/nbtree.h"
 #include "access/subtrans.h"
 #include "access/twophase.h"
 #include "commands/async.h"
+#include "commands/sequence.h"
+#include "executor/execSample.h"
 #include "miscadmin.h"
 #include "pgstat.h"
 #ifdef PGXC
+#include "pgxc/barrier.h"
 #include "pgxc/nodemgr.h"
+#include "pgxc/poolmgr.h"
+#include "pgxc/commitbatcher.h"
 #include "postmaster/clustermon.h"
 #endif
 #include "postmaster/autovacuum.h"
@@ -50,10 +56,13 @@
 #include "storage/procsignal.h"
 #include "storage/sinvaladt.h"
 #include "storage/spin.h"
+#include "utils/plancache.h"
 #ifdef XCP
 #include "pgxc/pgxc.h"
 #include "pgxc/squeue.h"
 #include "pgxc/pause.h"
+#include "pgxc/admission.h"
+#include "pgxc/distadvisor.h"
 #endif
 #include "utils/backend_random.h"
 #include "utils/snapmgr.h"
@@ -154,12 +163,21 @@ CreateSharedMemoryAndSemaphores(bool makePrivate, int port)
 		size = add_size(size, ReplicationOriginShmemSize());
 		size = add_size(size, WalSndShmemSize());
 		size = add_size(size, WalRcvShmemSize());
+		size = add_size(size, ExecSampleShmemSize());
+		size = add_size(size, DistAdvisorShmemSize());
 #ifdef XCP
 		if (IS_PGXC_DATANODE)
 			size = add_size(size, SharedQueueShmemSize());
 		if (IS_PGXC_COORDINATOR)
+		{
 			size = add_size(size, ClusterLockShmemSize());
+			size = add_size(size, AdmissionControlShmemSize());
+		}
 		size = add_size(size, ClusterMonitorShmemSize());
+		size = add_size(size, GTMShmemSize());
+		size = add_size(size, BarrierShmemSize());
+		size = add_size(size, SequenceShmemSize());
+		size = add_size(size, SharedRemoteSubplanShmemSize());
 #endif
 		size = add_size(size, ApplyLauncherShmemSize());
 		size = add_size(size, SnapMgrShmemSize());
@@ -168,6 +186,8 @@ CreateSharedMemoryAndSemaphores(bool makePrivate, int port)
 		size = add_size(size, AsyncShmemSize());
 #ifdef PGXC
 		size = add_size(size, NodeTablesShmemSize());
+		size = add_size(size, PoolerShmemSize());
+		size = add_size(size, CommitBatcherShmemSize());
 #endif
 
 		size = add_size(size, BackendRandomShmemSize());
@@ -286,6 +306,8 @@ CreateSharedMemoryAndSemaphores(bool makePrivate, int port)
 	WalSndShmemInit();
 	WalRcvShmemInit();
 	ApplyLauncherShmemInit();
+	ExecSampleShmemInit();
+	DistAdvisorShmemInit();
 
 #ifdef XCP
 	/*
@@ -294,8 +316,15 @@ CreateSharedMemoryAndSemaphores(bool makePrivate, int port)
 	if (IS_PGXC_DATANODE)
 		SharedQueuesInit();
 	if (IS_PGXC_COORDINATOR)
+	{
 		ClusterLockShmemInit();
+		AdmissionControlShmemInit();
+	}
 	ClusterMonitorShmemInit();
+	GTMShmemInit();
+	BarrierShmemInit();
+	SequenceShmemInit();
+	SharedRemoteSubplanShmemInit();
 #endif
 
 	/*
@@ -309,6 +338,8 @@ CreateSharedMemoryAndSemaphores(bool makePrivate, int port)
 
 #ifdef PGXC
 	NodeTablesShmemInit();
+	PoolerShmemInit();
+	CommitBatcherShmemInit();
 #endif
 
 
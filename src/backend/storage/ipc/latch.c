@@ -220,6 +220,7 @@ void
 InitLatch(volatile Latch *latch)
 {
 	latch->is_set = false;
+	latch->maybe_sleeping = false;
 	latch->owner_pid = MyProcPid;
 	latch->is_shared = false;
 
@@ -267,6 +268,7 @@ InitSharedLatch(volatile Latch *latch)
 #endif
 
 	latch->is_set = false;
+	latch->maybe_sleeping = false;
 	latch->owner_pid = 0;
 	latch->is_shared = true;
 }
@@ -433,6 +435,18 @@ SetLatch(volatile Latch *latch)
 
 	latch->is_set = true;
 
+	/*
+	 * Nobody needs waking up unless the owner announced that it is about to
+	 * block.  That saves a signal or a SetEvent() for every setting of a
+	 * latch whose owner is busy, which matters for latches that are set
+	 * often, like the ones of the shared queue producers and consumers.  The
+	 * barrier pairs with the one in WaitEventSetWait: either we see
+	 * maybe_sleeping set, or the waiter sees is_set before it blocks.
+	 */
+	pg_memory_barrier();
+	if (!latch->maybe_sleeping)
+		return;
+
 #ifndef WIN32
 
 	/*
@@ -975,7 +989,16 @@ WaitEventSetWait(WaitEventSet *set, long timeout,
 		 * will provide adequate synchronization on machines with weak memory
 		 * ordering, so that we cannot miss seeing is_set if a notification
 		 * has already been queued.
+		 *
+		 * SetLatch() only bothers to wake us up if maybe_sleeping is set, so
+		 * announce that before the final check of is_set.
 		 */
+		if (set->latch && !set->latch->is_set)
+		{
+			set->latch->maybe_sleeping = true;
+			pg_memory_barrier();
+		}
+
 		if (set->latch && set->latch->is_set)
 		{
 			occurred_events->fd = PGINVALID_SOCKET;
@@ -986,6 +1009,9 @@ WaitEventSetWait(WaitEventSet *set, long timeout,
 			occurred_events++;
 			returned_events++;
 
+			/* could have been set above */
+			set->latch->maybe_sleeping = false;
+
 			break;
 		}
 
@@ -997,6 +1023,9 @@ WaitEventSetWait(WaitEventSet *set, long timeout,
 		rc = WaitEventSetWaitBlock(set, cur_timeout,
 								   occurred_events, nevents);
 
+		if (set->latch)
+			set->latch->maybe_sleeping = false;
+
 		if (rc == -1)
 			break;				/* timeout occurred */
 		else
@@ -72,6 +72,7 @@
 #include "utils/builtins.h"
 #include "utils/rel.h"
 #include "utils/snapmgr.h"
+#include "utils/timestamp.h"
 #ifdef PGXC
 #include "pgxc/pgxc.h"
 #include "gtm/gtm.h"
@@ -185,6 +186,8 @@ typedef struct
 	int gxcnt;
 	int max_gxcnt;
 	TransactionId *gxip;
+	/* Cluster-wide xmin as known to the sender of the snapshot */
+	TransactionId gglobal_xmin;
 } GlobalSnapshotData;
 
 GlobalSnapshotData globalSnapshot = {
@@ -193,7 +196,8 @@ GlobalSnapshotData globalSnapshot = {
 	InvalidTransactionId,
 	0,
 	0,
-	NULL
+	NULL,
+	InvalidTransactionId
 };
 
 static void GetSnapshotFromGlobalSnapshot(Snapshot snapshot);
@@ -225,6 +229,15 @@ static void ProcArrayGroupClearXid(PGPROC *proc, TransactionId latestXid);
 int	GlobalSnapshotSource;
 #endif
 
+#ifdef PGXC
+/* GUC parameter, ms */
+int			snapshot_max_staleness = 0;
+
+/* When and in which transaction the last snapshot was obtained from GTM */
+static TimestampTz lastGTMSnapshotTime = 0;
+static LocalTransactionId lastGTMSnapshotLxid = InvalidLocalTransactionId;
+#endif
+
 /*
  * Report shared-memory space needed by CreateSharedProcArray.
  */
@@ -298,6 +311,9 @@ CreateSharedProcArray(void)
 		procArray->headKnownAssignedXids = 0;
 		SpinLockInit(&procArray->known_assigned_xids_lck);
 		procArray->lastOverflowedXid = InvalidTransactionId;
+
+		/* 0 is reserved for snapshots that were not computed locally */
+		ShmemVariableCache->xactCompletionCount = 1;
 	}
 
 	allProcs = ProcGlobal->allProcs;
@@ -405,6 +421,8 @@ ProcArrayRemove(PGPROC *proc, TransactionId latestXid)
 		if (TransactionIdPrecedes(ShmemVariableCache->latestCompletedXid,
 								  latestXid))
 			ShmemVariableCache->latestCompletedXid = latestXid;
+
+		ShmemVariableCache->xactCompletionCount++;
 	}
 	else
 	{
@@ -495,8 +513,15 @@ ProcArrayEndTransaction(PGPROC *proc, TransactionId latestXid)
 		 * estimate of global xmin, but that's OK.
 		 */
 #ifdef XCP
-		if (IsConnFromDatanode())
+		if (IsConnFromDatanode() &&
+			TransactionIdIsValid(allPgXact[proc->pgprocno].xid))
+		{
+			/* Cached snapshots must notice that the XID went away */
+			LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
 			allPgXact[proc->pgprocno].xid = InvalidTransactionId;
+			ShmemVariableCache->xactCompletionCount++;
+			LWLockRelease(ProcArrayLock);
+		}
 #endif
 		Assert(!TransactionIdIsValid(allPgXact[proc->pgprocno].xid));
 
@@ -537,6 +562,8 @@ ProcArrayEndTransactionInternal(PGPROC *proc, PGXACT *pgxact,
 	if (TransactionIdPrecedes(ShmemVariableCache->latestCompletedXid,
 							  latestXid))
 		ShmemVariableCache->latestCompletedXid = latestXid;
+
+	ShmemVariableCache->xactCompletionCount++;
 }
 
 /*
@@ -678,11 +705,17 @@ ProcArrayClearTransaction(PGPROC *proc)
 	PGXACT	   *pgxact = &allPgXact[proc->pgprocno];
 
 	/*
-	 * We can skip locking ProcArrayLock here, because this action does not
-	 * actually change anyone's view of the set of running XIDs: our entry is
-	 * duplicate with the gxact that has already been inserted into the
-	 * ProcArray.
+	 * This action does not actually change anyone's view of the set of
+	 * running XIDs: our entry is duplicate with the gxact that has already
+	 * been inserted into the ProcArray.  But GetSnapshotData leaves our own
+	 * XID out of our snapshots, so a snapshot we cached must not be reused
+	 * once the XID is no longer ours; hence the lock and the bump of the
+	 * completion count.
 	 */
+	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+
+	ShmemVariableCache->xactCompletionCount++;
+
 	pgxact->xid = InvalidTransactionId;
 	proc->lxid = InvalidLocalTransactionId;
 	pgxact->xmin = InvalidTransactionId;
@@ -695,8 +728,38 @@ ProcArrayClearTransaction(PGPROC *proc)
 	/* Clear the subtransaction-XID cache too */
 	pgxact->nxids = 0;
 	pgxact->overflowed = false;
+
+	LWLockRelease(ProcArrayLock);
 }
 
+#ifdef PGXC
+/*
+ * ProcArrayNoteAssignedXid -- called after MyPgXact advertises a new XID
+ *
+ * A locally assigned XID always follows latestCompletedXid, so it lands at
+ * or above the xmax of any snapshot GetSnapshotData has cached.  A GXID
+ * obtained from GTM or adopted from the coordinator does not: it may be
+ * older than XIDs of other global transactions that already completed
+ * here.  A cached snapshot with a greater xmax would miss such an XID, so
+ * make the cached snapshots recompute by bumping the completion count.
+ *
+ * The XID has been stored before we look at latestCompletedXid, so a
+ * snapshot cached with this xmax after our check does include it.
+ */
+void
+ProcArrayNoteAssignedXid(TransactionId xid)
+{
+	pg_memory_barrier();
+
+	if (TransactionIdFollows(xid, ShmemVariableCache->latestCompletedXid))
+		return;
+
+	LWLockAcquire(ProcArrayLock, LW_EXCLUSIVE);
+	ShmemVariableCache->xactCompletionCount++;
+	LWLockRelease(ProcArrayLock);
+}
+#endif
+
 /*
  * ProcArrayInitRecovery -- initialize recovery xid mgmt environment
  *
@@ -1687,7 +1750,10 @@ GetSnapshotData(Snapshot snapshot, bool latest)
 		 * if possible.
 		 */
 		if (GetPGXCSnapshotData(snapshot, latest))
+		{
+			snapshot->snapXactCompletionCount = 0;
 			return snapshot;
+		}
 		/*
 		 * We only make one exception for using local snapshot and that's the
 		 * initdb time. When IsPostmasterEnvironment is true, snapshots must
@@ -1751,10 +1817,38 @@ GetSnapshotData(Snapshot snapshot, bool latest)
 	Assert(TransactionIdIsNormal(xmax));
 	TransactionIdAdvance(xmax);
 
+	/*
+	 * If no XID has left the proc array since we last built this snapshot,
+	 * and no XID has been added below its xmax (which on Postgres-XL takes
+	 * ProcArrayNoteAssignedXid to tell us), building it again would
+	 * give the same contents, so skip the scan over all the procs.  Our
+	 * xmin is then safe to advertise again: nothing it protects can have
+	 * been removed while the set of running XIDs stayed the same.  We keep
+	 * the global xmin computed last time, which can only be too old.
+	 */
+	if (snapshot->snapXactCompletionCount != 0 &&
+		snapshot->snapXactCompletionCount ==
+		ShmemVariableCache->xactCompletionCount &&
+		TransactionIdEquals(snapshot->xmax, xmax) &&
+		!snapshot->takenDuringRecovery && !RecoveryInProgress())
+	{
+		if (!TransactionIdIsValid(MyPgXact->xmin))
+			MyPgXact->xmin = TransactionXmin = snapshot->xmin;
+
+		LWLockRelease(ProcArrayLock);
+
+		RecentXmin = snapshot->xmin;
+		goto done;
+	}
+	snapshot->snapXactCompletionCount = ShmemVariableCache->xactCompletionCount;
+
 	/* initialize xmin calculation with xmax */
 	globalxmin = xmin = xmax;
 
 	snapshot->takenDuringRecovery = RecoveryInProgress();
+#ifdef XCP
+	snapshot->xip_sorted = false;
+#endif
 
 	if (!snapshot->takenDuringRecovery)
 	{
@@ -1942,14 +2036,15 @@ GetSnapshotData(Snapshot snapshot, bool latest)
 	snapshot->subxcnt = subcount;
 	snapshot->suboverflowed = suboverflowed;
 
-	snapshot->curcid = GetCurrentCommandId(false);
-
 #ifdef PGXC
 	if (!RecoveryInProgress())
 		elog(DEBUG1, "Local snapshot is built, xmin: %d, xmax: %d, xcnt: %d, RecentGlobalXmin: %d",
 			 xmin, xmax, count, globalxmin);
 #endif
 
+done:
+	snapshot->curcid = GetCurrentCommandId(false);
+
 	/*
 	 * This is a new snapshot, so set both refcounts are zero, and mark it as
 	 * not copied in persistent memory.
@@ -1976,7 +2071,7 @@ GetSnapshotData(Snapshot snapshot, bool latest)
 		 */
 		snapshot->lsn = GetXLogInsertRecPtr();
 		snapshot->whenTaken = GetSnapshotCurrentTimestamp();
-		MaintainOldSnapshotTimeMapping(snapshot->whenTaken, xmin);
+		MaintainOldSnapshotTimeMapping(snapshot->whenTaken, snapshot->xmin);
 	}
 
 	return snapshot;
@@ -3333,6 +3428,8 @@ XidCacheRemoveRunningXids(TransactionId xid,
 							  latestXid))
 		ShmemVariableCache->latestCompletedXid = latestXid;
 
+	ShmemVariableCache->xactCompletionCount++;
+
 	LWLockRelease(ProcArrayLock);
 }
 
@@ -3365,7 +3462,8 @@ DisplayXidCache(void)
  */
 void
 SetGlobalSnapshotData(TransactionId xmin, TransactionId xmax,
-		int xcnt, TransactionId *xip, SnapshotSource source)
+		int xcnt, TransactionId *xip, TransactionId global_xmin,
+		SnapshotSource source)
 {
 	if (globalSnapshot.max_gxcnt < xcnt)
 	{
@@ -3380,6 +3478,7 @@ SetGlobalSnapshotData(TransactionId xmin, TransactionId xmax,
 	globalSnapshot.gxmin = xmin;
 	globalSnapshot.gxmax = xmax;
 	globalSnapshot.gxcnt = xcnt;
+	globalSnapshot.gglobal_xmin = global_xmin;
 	memcpy(globalSnapshot.gxip, xip, sizeof (TransactionId) * xcnt);
 	elog (DEBUG1, "global snapshot info: gxmin: %d, gxmax: %d, gxcnt: %d", xmin, xmax, xcnt);
 }
@@ -3394,6 +3493,7 @@ UnsetGlobalSnapshotData(void)
 	globalSnapshot.gxmin = InvalidTransactionId;
 	globalSnapshot.gxmax = InvalidTransactionId;
 	globalSnapshot.gxcnt = 0;
+	globalSnapshot.gglobal_xmin = InvalidTransactionId;
 	elog (DEBUG1, "unset snapshot info");
 }
 
@@ -3507,10 +3607,65 @@ retry:
 		 */
 		RecentGlobalDataXmin = RecentGlobalXmin;
 		SetGlobalSnapshotData(gtm_snapshot->sn_xmin, gtm_snapshot->sn_xmax,
-				gtm_snapshot->sn_xcnt, gtm_snapshot->sn_xip, SNAPSHOT_DIRECT);
+				gtm_snapshot->sn_xcnt, gtm_snapshot->sn_xip,
+				InvalidTransactionId, SNAPSHOT_DIRECT);
+		GetSnapshotFromGlobalSnapshot(snapshot);
+
+		if (snapshot_max_staleness > 0)
+		{
+			lastGTMSnapshotTime = GetCurrentTimestamp();
+			lastGTMSnapshotLxid = MyProc->lxid;
+		}
+	}
+	LWLockRelease(ClusterMonitorLock);
+}
+
+/*
+ * Build the statement snapshot of a READ COMMITTED transaction from the last
+ * snapshot obtained from GTM, if that has been obtained by the same
+ * transaction no longer than snapshot_max_staleness ago. The statement may not
+ * see transactions committed in that interval, the user accepts that by
+ * setting the parameter. Own changes are always visible.
+ * Returns false if the snapshot should be obtained from GTM.
+ */
+bool
+GetStaleGlobalSnapshot(Snapshot snapshot)
+{
+	TransactionId reporting_xmin;
+	TransactionId global_xmin;
+	bool		result = false;
+
+	if (snapshot_max_staleness <= 0 || !IS_PGXC_LOCAL_COORDINATOR ||
+		GlobalSnapshotSource != GLOBAL_SNAPSHOT_SOURCE_GTM ||
+		RecoveryInProgress())
+		return false;
+
+	if (globalSnapshot.snapshot_source != SNAPSHOT_DIRECT ||
+		lastGTMSnapshotLxid != MyProc->lxid ||
+		TimestampDifferenceExceeds(lastGTMSnapshotTime, GetCurrentTimestamp(),
+								   snapshot_max_staleness))
+		return false;
+
+	/*
+	 * The transaction may have released its xmin since the snapshot was taken
+	 * and the horizon may have moved past the snapshot's xmin. Like in
+	 * GetSnapshotDataFromGTM, the snapshot is safe to use if its xmin is not
+	 * older than what we are reporting.
+	 */
+	LWLockAcquire(ClusterMonitorLock, LW_SHARED);
+	reporting_xmin = ClusterMonitorGetReportingGlobalXmin();
+	global_xmin = ClusterMonitorGetGlobalXmin();
+	if ((!TransactionIdIsValid(reporting_xmin) ||
+		 !TransactionIdPrecedes(globalSnapshot.gxmin, reporting_xmin)) &&
+		(!TransactionIdIsValid(global_xmin) ||
+		 !TransactionIdPrecedes(globalSnapshot.gxmin, global_xmin)))
+	{
 		GetSnapshotFromGlobalSnapshot(snapshot);
+		result = true;
 	}
 	LWLockRelease(ClusterMonitorLock);
+
+	return result;
 }
 
 static void
@@ -3609,6 +3764,20 @@ GetSnapshotFromGlobalSnapshot(Snapshot snapshot)
 					"advanced past the snapshot xmin (%d)",
 					global_xmin, globalSnapshot.gxmin);
 
+		/*
+		 * The Coordinator sends the cluster-wide xmin it knows along with the
+		 * snapshot. Our own copy is only refreshed when the Cluster Monitor
+		 * reports to GTM, so the Coordinator's one is often newer; use it to
+		 * let pruning and vacuum in this transaction get ahead sooner. It can
+		 * never be past the xmin of a snapshot the Coordinator hands out.
+		 */
+		if (globalSnapshot.snapshot_source == SNAPSHOT_COORDINATOR &&
+			TransactionIdIsNormal(globalSnapshot.gglobal_xmin) &&
+			TransactionIdFollows(globalSnapshot.gglobal_xmin, global_xmin) &&
+			!TransactionIdFollows(globalSnapshot.gglobal_xmin,
+								  globalSnapshot.gxmin))
+			global_xmin = globalSnapshot.gglobal_xmin;
+
 		memcpy(snapshot->xip, globalSnapshot.gxip,
 				globalSnapshot.gxcnt * sizeof(TransactionId));
 		snapshot->curcid = GetCurrentCommandId(false);
@@ -3629,6 +3798,16 @@ GetSnapshotFromGlobalSnapshot(Snapshot snapshot)
 
 		LWLockRelease(ProcArrayLock);
 		/* End handling of local analyze XID in snapshots */
+
+		/*
+		 * A global snapshot lists the transactions running on the whole
+		 * cluster. Sort them once here so that XidInMVCCSnapshot can binary
+		 * search the array rather than scanning it for every tuple.
+		 */
+		if (snapshot->xcnt > 1)
+			qsort(snapshot->xip, snapshot->xcnt, sizeof(TransactionId),
+				  xidComparator);
+		snapshot->xip_sorted = true;
 	}
 	else
 		elog(ERROR, "Cannot set snapshot from global snapshot");
@@ -277,6 +277,9 @@ procsignal_sigusr1_handler(SIGNAL_ARGS)
 
 	if (CheckProcSignal(PROCSIG_PGXCPOOL_REFRESH))
 		HandlePoolerRefresh();
+
+	if (CheckProcSignal(PROCSIG_PGXCPOOL_RELEASE))
+		HandlePoolerRelease();
 #endif
 	if (CheckProcSignal(PROCSIG_PARALLEL_MESSAGE))
 		HandleParallelMessageInterrupt();
@@ -44,9 +44,9 @@
  * SICleanupQueue is called, and we try not to do that often.)
  *
  * In reality, the messages are stored in a circular buffer of MAXNUMMESSAGES
- * entries.  We translate MsgNum values into circular-buffer indexes by
- * computing MsgNum % MAXNUMMESSAGES (this should be fast as long as
- * MAXNUMMESSAGES is a constant and a power of 2).  As long as maxMsgNum
+ * entries, sized at startup from invalidation_queue_size.  We translate MsgNum
+ * values into circular-buffer indexes by masking with MAXNUMMESSAGES - 1
+ * (MAXNUMMESSAGES is always a power of 2).  As long as maxMsgNum
  * doesn't exceed minMsgNum by more than MAXNUMMESSAGES, we have enough space
  * in the buffer.  If the buffer does overflow, we recover by setting the
  * "reset" flag for each backend that has fallen too far behind.  A backend
@@ -70,6 +70,16 @@
  * of "stuck" backends, we won't need a lot of extra interrupts, since ones
  * that aren't stuck will propagate their interrupts to the next guy.
  *
+ * Most messages concern a single database, and a backend connected to some
+ * other database would ignore them anyway.  So before SICleanupQueue signals
+ * or resets a backend that is behind, it moves that backend's nextMsgNum past
+ * any pending messages that are of no interest to the backend's database.
+ * With many databases (or many tenants with their own DDL), a backend that
+ * has been idle in a quiet database then normally doesn't need to wake up or
+ * be reset at all.  Readers skip such messages as well.  smgr messages are
+ * never skipped, since any backend may have an smgr relation open for another
+ * database's relation, for instance after writing out a dirty buffer.
+ *
  * We would have problems if the MsgNum values overflow an integer, so
  * whenever minMsgNum exceeds MSGNUMWRAPAROUND, we subtract MSGNUMWRAPAROUND
  * from all the MsgNum variables simultaneously.  MSGNUMWRAPAROUND can be
@@ -108,10 +118,11 @@
  * Configurable parameters.
  *
  * MAXNUMMESSAGES: max number of shared-inval messages we can buffer.
- * Must be a power of 2 for speed.
+ * This is invalidation_queue_size rounded up to a power of 2, for speed.
  *
  * MSGNUMWRAPAROUND: how often to reduce MsgNum variables to avoid overflow.
- * Must be a multiple of MAXNUMMESSAGES.  Should be large.
+ * Must be a multiple of MAXNUMMESSAGES.  Should be large.  It also must leave
+ * room below INT_MAX for a full buffer, hence the cap on MAXNUMMESSAGES.
  *
  * CLEANUP_MIN: the minimum number of messages that must be in the buffer
  * before we bother to call SICleanupQueue.
@@ -128,13 +139,19 @@
  * per iteration.
  */
 
-#define MAXNUMMESSAGES 4096
-#define MSGNUMWRAPAROUND (MAXNUMMESSAGES * 262144)
+#define MAXNUMMESSAGES (shmInvalBuffer->numMessages)
+#define MAXNUMMESSAGES_LIMIT (1 << 20)
+#define MSGNUMWRAPAROUND (1 << 30)
 #define CLEANUP_MIN (MAXNUMMESSAGES / 2)
 #define CLEANUP_QUANTUM (MAXNUMMESSAGES / 16)
 #define SIG_THRESHOLD (MAXNUMMESSAGES / 2)
 #define WRITE_QUANTUM 64
 
+/* Circular-buffer index of a MsgNum */
+#define SI_BUFFER_INDEX(n) ((n) & (MAXNUMMESSAGES - 1))
+
+int			InvalidationQueueSize = 4096;
+
 /* Per-backend state in shared invalidation structure */
 typedef struct ProcState
 {
@@ -175,13 +192,15 @@ typedef struct SISeg
 	int			nextThreshold;	/* # of messages to call SICleanupQueue */
 	int			lastBackend;	/* index of last active procState entry, +1 */
 	int			maxBackends;	/* size of procState array */
+	int			numMessages;	/* size of buffer array, a power of 2 */
 
 	slock_t		msgnumLock;		/* spinlock protecting maxMsgNum */
 
 	/*
-	 * Circular buffer holding shared-inval messages
+	 * Circular buffer holding shared-inval messages, allocated right after
+	 * the procState array
 	 */
-	SharedInvalidationMessage buffer[MAXNUMMESSAGES];
+	SharedInvalidationMessage *buffer;
 
 	/*
 	 * Per-backend invalidation state info (has MaxBackends entries).
@@ -195,6 +214,10 @@ static SISeg *shmInvalBuffer;	/* pointer to the shared inval buffer */
 static LocalTransactionId nextLocalTransactionId;
 
 static void CleanupInvalidationState(int status, Datum arg);
+static int	SInvalQueueMessages(void);
+static bool SIMessageConcernsDatabase(const SharedInvalidationMessage *msg,
+						  Oid dbId);
+static void SIAdvancePastIrrelevant(SISeg *segP, ProcState *stateP);
 
 
 /*
@@ -207,10 +230,28 @@ SInvalShmemSize(void)
 
 	size = offsetof(SISeg, procState);
 	size = add_size(size, mul_size(sizeof(ProcState), MaxBackends));
+	size = MAXALIGN(size);
+	size = add_size(size, mul_size(sizeof(SharedInvalidationMessage),
+								   SInvalQueueMessages()));
 
 	return size;
 }
 
+/*
+ * Number of messages in the circular buffer: invalidation_queue_size rounded
+ * up to a power of 2.
+ */
+static int
+SInvalQueueMessages(void)
+{
+	int			n = 1;
+
+	while (n < InvalidationQueueSize && n < MAXNUMMESSAGES_LIMIT)
+		n <<= 1;
+
+	return n;
+}
+
 /*
  * CreateSharedInvalidationState
  *		Create and initialize the SI message buffer
@@ -233,6 +274,11 @@ CreateSharedInvalidationState(void)
 	shmInvalBuffer->nextThreshold = CLEANUP_MIN;
 	shmInvalBuffer->lastBackend = 0;
 	shmInvalBuffer->maxBackends = MaxBackends;
+	shmInvalBuffer->numMessages = SInvalQueueMessages();
+	shmInvalBuffer->buffer = (SharedInvalidationMessage *)
+		((char *) shmInvalBuffer +
+		 MAXALIGN(offsetof(SISeg, procState) +
+				  sizeof(ProcState) * MaxBackends));
 	SpinLockInit(&shmInvalBuffer->msgnumLock);
 
 	/* The buffer[] array is initially all unused, so we need not fill it */
@@ -480,7 +526,7 @@ SIInsertDataEntries(const SharedInvalidationMessage *data, int n)
 		max = segP->maxMsgNum;
 		while (nthistime-- > 0)
 		{
-			segP->buffer[max % MAXNUMMESSAGES] = *data++;
+			segP->buffer[SI_BUFFER_INDEX(max)] = *data++;
 			max++;
 		}
 
@@ -594,7 +640,8 @@ SIGetDataEntries(SharedInvalidationMessage *data, int datasize)
 
 	/*
 	 * Retrieve messages and advance backend's counter, until data array is
-	 * full or there are no more messages.
+	 * full or there are no more messages.  Messages for other databases are
+	 * passed over, we would ignore them anyway.
 	 *
 	 * There may be other backends that haven't read the message(s), so we
 	 * cannot delete them here.  SICleanupQueue() will eventually remove them
@@ -603,7 +650,11 @@ SIGetDataEntries(SharedInvalidationMessage *data, int datasize)
 	n = 0;
 	while (n < datasize && stateP->nextMsgNum < max)
 	{
-		data[n++] = segP->buffer[stateP->nextMsgNum % MAXNUMMESSAGES];
+		SharedInvalidationMessage *msg;
+
+		msg = &segP->buffer[SI_BUFFER_INDEX(stateP->nextMsgNum)];
+		if (SIMessageConcernsDatabase(msg, MyDatabaseId))
+			data[n++] = *msg;
 		stateP->nextMsgNum++;
 	}
 
@@ -623,6 +674,64 @@ SIGetDataEntries(SharedInvalidationMessage *data, int datasize)
 	return n;
 }
 
+/*
+ * SIMessageConcernsDatabase
+ *		Would a backend connected to dbId act on this message?
+ *
+ * This must agree with LocalExecuteInvalidationMessage.  An invalid dbId
+ * means the backend isn't bound to a database yet, and needs everything.
+ */
+static bool
+SIMessageConcernsDatabase(const SharedInvalidationMessage *msg, Oid dbId)
+{
+	Oid			msgDbId;
+
+	if (!OidIsValid(dbId))
+		return true;
+
+	if (msg->id >= 0)
+		msgDbId = msg->cc.dbId;
+	else if (msg->id == SHAREDINVALCATALOG_ID)
+		msgDbId = msg->cat.dbId;
+	else if (msg->id == SHAREDINVALRELCACHE_ID)
+		msgDbId = msg->rc.dbId;
+	else if (msg->id == SHAREDINVALRELMAP_ID)
+		msgDbId = msg->rm.dbId;
+	else if (msg->id == SHAREDINVALSNAPSHOT_ID)
+		msgDbId = msg->sn.dbId;
+	else
+		return true;			/* smgr, or unknown */
+
+	return msgDbId == InvalidOid || msgDbId == dbId;
+}
+
+/*
+ * SIAdvancePastIrrelevant
+ *		Move a backend's nextMsgNum past pending messages for other databases
+ *
+ * Caller must hold SInvalReadLock exclusively, so the backend isn't reading
+ * its messages concurrently, and SInvalWriteLock, so maxMsgNum is stable.
+ * The backend's databaseId is read without a lock; it is only ever changed
+ * from InvalidOid, in which case we see either value and are safe with both.
+ */
+static void
+SIAdvancePastIrrelevant(SISeg *segP, ProcState *stateP)
+{
+	Oid			dbId = stateP->proc ? stateP->proc->databaseId : InvalidOid;
+	int			max = segP->maxMsgNum;
+
+	if (!OidIsValid(dbId))
+		return;
+
+	while (stateP->nextMsgNum < max &&
+		   !SIMessageConcernsDatabase(&segP->buffer[SI_BUFFER_INDEX(stateP->nextMsgNum)],
+									  dbId))
+		stateP->nextMsgNum++;
+
+	if (stateP->nextMsgNum >= max)
+		stateP->signaled = false;
+}
+
 /*
  * SICleanupQueue
  *		Remove messages that have been consumed by all active backends
@@ -675,6 +784,16 @@ SICleanupQueue(bool callerHasWriteLock, int minFree)
 		if (stateP->procPid == 0 || stateP->resetState || stateP->sendOnly)
 			continue;
 
+		/*
+		 * If this backend is far enough behind to be signaled or reset, first
+		 * see whether the messages it hasn't read concern it at all.
+		 */
+		if (n < minsig || n < lowbound)
+		{
+			SIAdvancePastIrrelevant(segP, stateP);
+			n = stateP->nextMsgNum;
+		}
+
 		/*
 		 * If we must free some space and this backend is preventing it, force
 		 * him into reset state and then ignore until he catches up.
@@ -98,6 +98,7 @@ static void RemoveProcFromArray(int code, Datum arg);
 static void ProcKill(int code, Datum arg);
 static void AuxiliaryProcKill(int code, Datum arg);
 static void CheckDeadLock(void);
+static Size FastPathLockShmemPerProc(void);
 
 
 /*
@@ -123,6 +124,27 @@ ProcGlobalShmemSize(void)
 	size = add_size(size, mul_size(NUM_AUXILIARY_PROCS, sizeof(PGXACT)));
 	size = add_size(size, mul_size(max_prepared_xacts, sizeof(PGXACT)));
 
+	/* Fast-path lock arrays */
+	size = add_size(size, mul_size(MaxBackends + NUM_AUXILIARY_PROCS +
+								   max_prepared_xacts,
+								   FastPathLockShmemPerProc()));
+
+	return size;
+}
+
+/*
+ * Report shared-memory space needed for one PGPROC's fast-path lock arrays.
+ */
+static Size
+FastPathLockShmemPerProc(void)
+{
+	Size		size;
+
+	size = MAXALIGN(mul_size(FastPathLockGroupsPerBackend, sizeof(uint64)));
+	size = add_size(size,
+					MAXALIGN(mul_size(FastPathLockSlotsPerBackend(),
+									  sizeof(Oid))));
+
 	return size;
 }
 
@@ -168,6 +190,8 @@ InitProcGlobal(void)
 {
 	PGPROC	   *procs;
 	PGXACT	   *pgxacts;
+	char	   *fpPtr;
+	Size		fpSize = FastPathLockShmemPerProc();
 	int			i,
 				j;
 	bool		found;
@@ -218,9 +242,22 @@ InitProcGlobal(void)
 	MemSet(pgxacts, 0, TotalProcs * sizeof(PGXACT));
 	ProcGlobal->allPgXact = pgxacts;
 
+	/*
+	 * Allocate the fast-path lock arrays.  Their size depends on
+	 * max_locks_per_transaction, so they can't be embedded in PGPROC; each
+	 * PGPROC just points at its own piece of this chunk.
+	 */
+	fpPtr = (char *) ShmemAlloc(TotalProcs * fpSize);
+	MemSet(fpPtr, 0, TotalProcs * fpSize);
+
 	for (i = 0; i < TotalProcs; i++)
 	{
 		/* Common initialization for all PGPROCs, regardless of type. */
+		procs[i].fpLockBits = (uint64 *) fpPtr;
+		procs[i].fpRelId = (Oid *) (fpPtr +
+									MAXALIGN(FastPathLockGroupsPerBackend *
+											 sizeof(uint64)));
+		fpPtr += fpSize;
 
 		/*
 		 * Set up per-PGPROC semaphore, latch, and backendLock. Prepared xact
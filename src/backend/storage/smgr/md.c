@@ -560,6 +560,92 @@ mdextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 	Assert(_mdnblocks(reln, forknum, v) <= ((BlockNumber) RELSEG_SIZE));
 }
 
+/*
+ *	mdzeroextend() -- Add nblocks zero-filled blocks to the specified relation.
+ *
+ *		Like mdextend, but for many blocks at once, with one write per chunk
+ *		of MD_ZEROEXTEND_CHUNK blocks rather than one per block.  The new
+ *		blocks start at blocknum, which must be the current end of the
+ *		relation, and may span segment boundaries.
+ */
+#define MD_ZEROEXTEND_CHUNK		32
+
+void
+mdzeroextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			 int nblocks, bool skipFsync)
+{
+	static char *zerobuf = NULL;
+	BlockNumber curblocknum = blocknum;
+	int			remblocks = nblocks;
+
+	Assert(nblocks > 0);
+
+	/* This assert is too expensive to have on normally ... */
+#ifdef CHECK_WRITE_VS_EXTEND
+	Assert(blocknum >= mdnblocks(reln, forknum));
+#endif
+
+	/* See mdextend */
+	if ((uint64) blocknum + nblocks >= (uint64) InvalidBlockNumber)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("cannot extend file \"%s\" beyond %u blocks",
+						relpath(reln->smgr_rnode, forknum),
+						InvalidBlockNumber)));
+
+	if (zerobuf == NULL)
+		zerobuf = MemoryContextAllocZero(TopMemoryContext,
+										 MD_ZEROEXTEND_CHUNK * BLCKSZ);
+
+	while (remblocks > 0)
+	{
+		BlockNumber segstartblock = curblocknum % ((BlockNumber) RELSEG_SIZE);
+		off_t		seekpos = (off_t) BLCKSZ * segstartblock;
+		int			numblocks;
+		int			nbytes;
+		MdfdVec    *v;
+
+		/* Do not write past the end of the segment, nor the zero buffer */
+		numblocks = Min(remblocks, MD_ZEROEXTEND_CHUNK);
+		if (segstartblock + numblocks > RELSEG_SIZE)
+			numblocks = RELSEG_SIZE - segstartblock;
+
+		v = _mdfd_getseg(reln, forknum, curblocknum, skipFsync, EXTENSION_CREATE);
+
+		if (FileSeek(v->mdfd_vfd, seekpos, SEEK_SET) != seekpos)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not seek to block %u in file \"%s\": %m",
+							curblocknum, FilePathName(v->mdfd_vfd))));
+
+		if ((nbytes = FileWrite(v->mdfd_vfd, zerobuf, BLCKSZ * numblocks,
+								WAIT_EVENT_DATA_FILE_EXTEND)) != BLCKSZ * numblocks)
+		{
+			if (nbytes < 0)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not extend file \"%s\": %m",
+								FilePathName(v->mdfd_vfd)),
+						 errhint("Check free disk space.")));
+			/* short write: complain appropriately */
+			ereport(ERROR,
+					(errcode(ERRCODE_DISK_FULL),
+					 errmsg("could not extend file \"%s\": wrote only %d of %d bytes at block %u",
+							FilePathName(v->mdfd_vfd),
+							nbytes, BLCKSZ * numblocks, curblocknum),
+					 errhint("Check free disk space.")));
+		}
+
+		if (!skipFsync && !SmgrIsTemp(reln))
+			register_dirty_segment(reln, forknum, v);
+
+		Assert(_mdnblocks(reln, forknum, v) <= ((BlockNumber) RELSEG_SIZE));
+
+		remblocks -= numblocks;
+		curblocknum += numblocks;
+	}
+}
+
 /*
  *	mdopen() -- Open the specified relation.
  *
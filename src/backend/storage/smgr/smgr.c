@@ -47,6 +47,9 @@ typedef struct f_smgr
 								bool isRedo);
 	void		(*smgr_extend) (SMgrRelation reln, ForkNumber forknum,
 								BlockNumber blocknum, char *buffer, bool skipFsync);
+	void		(*smgr_zeroextend) (SMgrRelation reln, ForkNumber forknum,
+									BlockNumber blocknum, int nblocks,
+									bool skipFsync);
 	void		(*smgr_prefetch) (SMgrRelation reln, ForkNumber forknum,
 								  BlockNumber blocknum);
 	void		(*smgr_read) (SMgrRelation reln, ForkNumber forknum,
@@ -68,7 +71,7 @@ typedef struct f_smgr
 static const f_smgr smgrsw[] = {
 	/* magnetic disk */
 	{mdinit, NULL, mdclose, mdcreate, mdexists, mdunlink, mdextend,
-		mdprefetch, mdread, mdwrite, mdwriteback, mdnblocks, mdtruncate,
+		mdzeroextend, mdprefetch, mdread, mdwrite, mdwriteback, mdnblocks, mdtruncate,
 		mdimmedsync, mdpreckpt, mdsync, mdpostckpt
 	}
 };
@@ -604,6 +607,23 @@ smgrextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
 											   buffer, skipFsync);
 }
 
+/*
+ *	smgrzeroextend() -- Add new zero-filled blocks to a file.
+ *
+ *		Adds nblocks blocks starting at blocknum, which must be the current
+ *		EOF, in as few writes as possible.  This is meant for extending a
+ *		relation by many blocks at once; the caller is expected to read
+ *		the new blocks into buffers with RBM_ZERO_AND_LOCK and initialize
+ *		them there.
+ */
+void
+smgrzeroextend(SMgrRelation reln, ForkNumber forknum, BlockNumber blocknum,
+			   int nblocks, bool skipFsync)
+{
+	(*(smgrsw[reln->smgr_which].smgr_zeroextend)) (reln, forknum, blocknum,
+												   nblocks, skipFsync);
+}
+
 /*
  *	smgrprefetch() -- Initiate asynchronous read of the specified block of a relation.
  */
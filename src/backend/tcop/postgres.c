@@ -90,8 +90,10 @@
 #include "pgxc/poolmgr.h"
 #include "pgxc/pgxcnode.h"
 #ifdef XCP
+#include "common/sha2.h"
 #include "pgxc/pause.h"
 #include "pgxc/squeue.h"
+#include "utils/plancache.h"
 #endif
 #include "commands/copy.h"
 /* PGXC_DATANODE */
@@ -113,12 +115,20 @@ bool		Log_disconnections = false;
 
 int			log_statement = LOGSTMT_NONE;
 
+/* use the snapshot taken for planning to execute read-only queries */
+bool		reuse_planning_snapshot = true;
+
 /* GUC variable for maximum stack depth (measured in kilobytes) */
 int			max_stack_depth = 100;
 
 /* wait N seconds to allow attach from a debugger */
 int			PostAuthDelay = 0;
 
+#ifdef PGXC
+/* query identifier sent down by the Coordinator, see pgxc.h */
+uint32		PGXCRemoteQueryId = 0;
+#endif
+
 /* ----------------
  *		private variables
  * ----------------
@@ -591,6 +601,7 @@ SocketBackend(StringInfo inBuf)
 			break;
 #ifdef PGXC /* PGXC_DATANODE */
 		case 'M':				/* Command ID */
+		case 'q':				/* Query ID */
 		case 'g':				/* GXID */
 		case 's':				/* Snapshot */
 		case 't':				/* Timestamp */
@@ -1157,6 +1168,8 @@ exec_simple_query(const char *query_string)
 	{
 		RawStmt    *parsetree = lfirst_node(RawStmt, parsetree_item);
 		bool		snapshot_set = false;
+		Snapshot	plan_snapshot = InvalidSnapshot;
+		uint64		lock_waits = LockWaitCount;
 		const char *commandTag;
 		char		completionTag[COMPLETION_TAG_BUFSIZE];
 		List	   *querytree_list,
@@ -1231,6 +1244,29 @@ exec_simple_query(const char *query_string)
 		plantree_list = pg_plan_queries(querytree_list,
 										CURSOR_OPT_PARALLEL_OK, NULL);
 
+#ifdef PGXC
+		/*
+		 * Every snapshot of the Coordinator is a GTM round trip. In READ
+		 * COMMITTED a read-only query may run with the snapshot taken for
+		 * planning, it has been taken after the statement started. Do not do
+		 * that if we have waited for a lock, the query should see the changes
+		 * of the lock holder.
+		 */
+		if (snapshot_set && reuse_planning_snapshot &&
+			IS_PGXC_LOCAL_COORDINATOR && !IsolationUsesXactSnapshot() &&
+			lock_waits == LockWaitCount &&
+			list_length(plantree_list) == 1)
+		{
+			PlannedStmt *stmt = linitial_node(PlannedStmt, plantree_list);
+
+			if (stmt->commandType == CMD_SELECT &&
+				stmt->utilityStmt == NULL &&
+				!stmt->hasModifyingCTE &&
+				stmt->rowMarks == NIL)
+				plan_snapshot = RegisterSnapshot(GetActiveSnapshot());
+		}
+#endif
+
 		/* Done with the snapshot used for parsing/planning */
 		if (snapshot_set)
 			PopActiveSnapshot();
@@ -1280,7 +1316,9 @@ exec_simple_query(const char *query_string)
 		/*
 		 * Start the portal.  No parameters here.
 		 */
-		PortalStart(portal, NULL, 0, InvalidSnapshot);
+		PortalStart(portal, NULL, 0, plan_snapshot);
+		if (plan_snapshot)
+			UnregisterSnapshot(plan_snapshot);
 
 		/*
 		 * Select the appropriate output format: text unless we are doing a
@@ -1712,6 +1750,7 @@ static void
 exec_plan_message(const char *query_string,	/* source of the query */
 				  const char *stmt_name,		/* name for prepared stmt */
 				  const char *plan_string,		/* encoded plan to execute */
+				  const uint8 *plan_digest,		/* SHA-256 of the plan */
 				  char **paramTypeNames,	/* parameter type names */
 				  int numParams)		/* number of parameters */
 {
@@ -1720,6 +1759,7 @@ exec_plan_message(const char *query_string,	/* source of the query */
 	char		msec_str[32];
 	Oid		   *paramTypes = NULL;
 	CachedPlanSource *psrc;
+	bool		digest_only = (plan_string[0] == '\0');
 
 	/* coord name + remote node + whatever */
 	static char		commandTag[NAMEDATALEN + NAMEDATALEN + 128];
@@ -1751,6 +1791,34 @@ exec_plan_message(const char *query_string,	/* source of the query */
 	 */
 	start_xact_command();
 
+	/*
+	 * The Coordinator sent only the plan digest. If we do not have the plan
+	 * cached, and no other backend of this node has stored its body, ask for
+	 * the body, the Coordinator waits for the answer and sends the Plan
+	 * message again.
+	 */
+	if (digest_only && !HaveRemoteSubplan(plan_digest))
+	{
+		char	   *shared_plan;
+
+		oldcontext = MemoryContextSwitchTo(MessageContext);
+		shared_plan = FetchSharedRemoteSubplan(plan_digest);
+		MemoryContextSwitchTo(oldcontext);
+
+		if (shared_plan != NULL)
+			plan_string = shared_plan;
+		else
+		{
+			if (whereToSendOutput == DestRemote)
+			{
+				pq_putemptymessage('h');
+				pq_flush();
+			}
+			debug_query_string = NULL;
+			return;
+		}
+	}
+
 	/*
 	 * XXX
 	 * Postgres decides about memory context to use based on "named/unnamed"
@@ -1806,7 +1874,7 @@ exec_plan_message(const char *query_string,	/* source of the query */
 	 */
 	StorePreparedStatement(stmt_name, psrc, false, true);
 
-	SetRemoteSubplan(psrc, plan_string);
+	SetRemoteSubplan(psrc, plan_string, plan_digest);
 
 	MemoryContextSwitchTo(oldcontext);
 
@@ -1821,7 +1889,12 @@ exec_plan_message(const char *query_string,	/* source of the query */
 	 * Send ParseComplete.
 	 */
 	if (whereToSendOutput == DestRemote)
+	{
 		pq_putemptymessage('1');
+		/* The Coordinator sent only the digest and waits for the answer */
+		if (digest_only)
+			pq_flush();
+	}
 
 	/*
 	 * Emit duration logging if appropriate.
@@ -2233,6 +2306,50 @@ exec_bind_message(StringInfo input_message)
 	debug_query_string = NULL;
 }
 
+#ifdef XCP
+/*
+ * send_remote_instrumentation
+ *
+ * If the Coordinator runs the plan fragment under EXPLAIN ANALYZE send it
+ * the execution statistics of the fragment root, and the memory the portal
+ * holds, ahead of CommandComplete.
+ */
+static void
+send_remote_instrumentation(Portal portal)
+{
+	QueryDesc  *queryDesc = portal->queryDesc;
+	Instrumentation instr;
+	StringInfoData buf;
+
+	if (queryDesc == NULL || queryDesc->plannedstmt->instrumentOptions == 0 ||
+		queryDesc->planstate == NULL || queryDesc->planstate->instrument == NULL)
+		return;
+
+	/* Close the loop on a copy, the executor may still do that itself */
+	instr = *queryDesc->planstate->instrument;
+	InstrEndLoop(&instr);
+
+	pq_beginmessage(&buf, 'i');
+	pq_sendfloat8(&buf, instr.startup);
+	pq_sendfloat8(&buf, instr.total);
+	pq_sendfloat8(&buf, instr.ntuples);
+	pq_sendfloat8(&buf, instr.nloops);
+	pq_sendint64(&buf, instr.bufusage.shared_blks_hit);
+	pq_sendint64(&buf, instr.bufusage.shared_blks_read);
+	pq_sendint64(&buf, instr.bufusage.shared_blks_dirtied);
+	pq_sendint64(&buf, instr.bufusage.shared_blks_written);
+	pq_sendint64(&buf, instr.bufusage.local_blks_hit);
+	pq_sendint64(&buf, instr.bufusage.local_blks_read);
+	pq_sendint64(&buf, instr.bufusage.local_blks_dirtied);
+	pq_sendint64(&buf, instr.bufusage.local_blks_written);
+	pq_sendint64(&buf, instr.bufusage.temp_blks_read);
+	pq_sendint64(&buf, instr.bufusage.temp_blks_written);
+	pq_sendint64(&buf, (int64)
+				 MemoryContextMemAllocated(PortalGetHeapMemory(portal), true));
+	pq_endmessage(&buf);
+}
+#endif
+
 /*
  * exec_execute_message
  *
@@ -2412,6 +2529,12 @@ exec_execute_message(const char *portal_name, long max_rows)
 			CommandCounterIncrement();
 		}
 
+#ifdef XCP
+		if (IS_PGXC_DATANODE && whereToSendOutput == DestRemote &&
+			portal->strategy == PORTAL_ONE_SELECT)
+			send_remote_instrumentation(portal);
+#endif
+
 		/* Send appropriate CommandComplete to client */
 		EndCommand(completionTag, dest);
 	}
@@ -4055,6 +4178,9 @@ PostgresMain(int argc, char *argv[],
 	sigjmp_buf	local_sigjmp_buf;
 	volatile bool send_ready_for_query = true;
 	bool		disable_idle_in_transaction_timeout = false;
+#ifdef PGXC
+	bool		disable_held_handles_timeout = false;
+#endif
 
 #ifdef PGXC /* PGXC_DATANODE */
 	/* Snapshot info */
@@ -4402,6 +4528,10 @@ PostgresMain(int argc, char *argv[],
 		/* Prevent interrupts while cleaning up */
 		HOLD_INTERRUPTS();
 
+#ifdef PGXC
+		PGXCRemoteQueryId = 0;
+#endif
+
 		/*
 		 * Forget any pending QueryCancel request, since we're returning to
 		 * the idle loop anyway, and cancel any active timeout requests.  (In
@@ -4567,10 +4697,28 @@ PostgresMain(int argc, char *argv[],
 
 				set_ps_display("idle", false);
 				pgstat_report_activity(STATE_IDLE, NULL);
+
+#ifdef PGXC
+				/* Start the timer releasing the node connections held */
+				if (HandlesHeld())
+				{
+					disable_held_handles_timeout = true;
+					enable_timeout_after(HELD_HANDLES_TIMEOUT,
+										 SessionConnectionHoldTime * 1000);
+				}
+#endif
 			}
 
 			ReadyForQuery(whereToSendOutput);
 #ifdef XCP
+			/*
+			 * The node that opened the connection compresses the stream
+			 * once it gets the first ReadyForQuery, and so do we.
+			 */
+			if (remoteCompression && !IsConnFromApp() &&
+				whereToSendOutput == DestRemote)
+				pq_enable_compression();
+
 			/*
 			 * Before we read any new command we now should wait while all
 			 * already closed portals which are still producing finish their
@@ -4625,6 +4773,13 @@ PostgresMain(int argc, char *argv[],
 			disable_timeout(IDLE_IN_TRANSACTION_SESSION_TIMEOUT, false);
 			disable_idle_in_transaction_timeout = false;
 		}
+#ifdef PGXC
+		if (disable_held_handles_timeout)
+		{
+			disable_timeout(HELD_HANDLES_TIMEOUT, false);
+			disable_held_handles_timeout = false;
+		}
+#endif
 
 		/*
 		 * (6) check for any other interesting events that happened while we
@@ -4681,6 +4836,9 @@ PostgresMain(int argc, char *argv[],
 					else
 						exec_simple_query(query_string);
 
+#ifdef PGXC
+					PGXCRemoteQueryId = 0;
+#endif
 					send_ready_for_query = true;
 				}
 				break;
@@ -4732,6 +4890,7 @@ PostgresMain(int argc, char *argv[],
 					const char *stmt_name;
 					const char *query_string;
 					const char *plan_string;
+					uint8		plan_digest[PG_SHA256_DIGEST_LENGTH];
 					int			numParams;
 					char 	  **paramTypes = NULL;
 
@@ -4750,9 +4909,12 @@ PostgresMain(int argc, char *argv[],
 							paramTypes[i] = (char *)
 									pq_getmsgstring(&input_message);
 					}
+					pq_copymsgbytes(&input_message, (char *) plan_digest,
+									PG_SHA256_DIGEST_LENGTH);
 					pq_getmsgend(&input_message);
 
 					exec_plan_message(query_string, stmt_name, plan_string,
+									  plan_digest,
 									  paramTypes, numParams);
 				}
 				break;
@@ -4911,6 +5073,9 @@ PostgresMain(int argc, char *argv[],
 			case 'S':			/* sync */
 				pq_getmsgend(&input_message);
 				finish_xact_command();
+#ifdef PGXC
+				PGXCRemoteQueryId = 0;
+#endif
 				send_ready_for_query = true;
 				break;
 
@@ -4957,6 +5122,11 @@ PostgresMain(int argc, char *argv[],
 				}
 				break;
 
+			case 'q':			/* query id */
+				PGXCRemoteQueryId = (uint32) pq_getmsgint(&input_message, 4);
+				pq_getmsgend(&input_message);
+				break;
+
 			case 'g':			/* gxid */
 				{
 					/* Set the GXID we were passed down */
@@ -5000,7 +5170,7 @@ PostgresMain(int argc, char *argv[],
 					xip = NULL;
 				pq_getmsgend(&input_message);
 				SetGlobalSnapshotData(xmin, xmax, xcnt, xip,
-						SNAPSHOT_COORDINATOR);
+						RecentGlobalXmin, SNAPSHOT_COORDINATOR);
 				if (xip)
 					pfree(xip);
 				break;
@@ -5039,6 +5209,10 @@ PostgresMain(int argc, char *argv[],
 							ProcessCreateBarrierExecute(id);
 							break;
 
+						case CREATE_BARRIER_FLUSH:
+							ProcessCreateBarrierFlush(id);
+							break;
+
 						default:
 							ereport(ERROR,
 									(errcode(ERRCODE_INTERNAL_ERROR),
@@ -72,6 +72,10 @@ static uint64 DoPortalRunFetch(Portal portal,
 				 long count,
 				 DestReceiver *dest);
 static void DoPortalRewind(Portal portal);
+#ifdef XCP
+static const char *DistributedBloomFilter(PlannedStmt *stmt,
+					   ParamListInfo params);
+#endif
 
 /*
  * CreateQueryDesc
@@ -557,6 +561,35 @@ FetchStatementTargetList(Node *stmt)
 	return NIL;
 }
 
+#ifdef XCP
+/*
+ * DistributedBloomFilter
+ *		Returns the Bloom filter of the join keys the consumer is going to
+ *		match our rows against, or NULL if it did not send one.
+ *
+ * The filter comes as the last of the parameters the consumer sends down.
+ */
+static const char *
+DistributedBloomFilter(PlannedStmt *stmt, ParamListInfo params)
+{
+	ParamExternData *prm;
+	bytea	   *filter;
+
+	if (!stmt->hasBloomParam || params == NULL ||
+			params->numParams < stmt->nParamRemote)
+		return NULL;
+
+	prm = &params->params[stmt->nParamRemote - 1];
+	if (prm->isnull)
+		return NULL;
+
+	filter = DatumGetByteaPP(prm->value);
+	if (VARSIZE_ANY_EXHDR(filter) != SQUEUE_FILTER_SIZE)
+		return NULL;
+	return VARDATA_ANY(filter);
+}
+#endif
+
 /*
  * PortalStart
  *		Prepare a portal for execution.
@@ -590,6 +623,8 @@ PortalStart(Portal portal, ParamListInfo params,
 	MemoryContext oldContext;
 #ifdef XCP
 	QueryDesc  *queryDesc = NULL;
+	const char *filter;
+	int			nParamRemote;
 #else
 	QueryDesc  *queryDesc;
 #endif
@@ -664,8 +699,12 @@ PortalStart(Portal portal, ParamListInfo params,
 				 * here since queryDesc->plannedstmt->nParamExec may be used
 				 * just to allocate space for them and no actual values passed.
 				 */
-				if (queryDesc->plannedstmt->nParamRemote > 0 &&
-						queryDesc->plannedstmt->remoteparams[queryDesc->plannedstmt->nParamRemote-1].paramkind == PARAM_EXEC)
+				filter = DistributedBloomFilter(queryDesc->plannedstmt, params);
+				nParamRemote = queryDesc->plannedstmt->nParamRemote;
+				if (queryDesc->plannedstmt->hasBloomParam)
+					nParamRemote--;
+				if (nParamRemote > 0 &&
+						queryDesc->plannedstmt->remoteparams[nParamRemote-1].paramkind == PARAM_EXEC)
 				{
 					int 	   *consMap;
 					int 		len;
@@ -719,10 +758,20 @@ PortalStart(Portal portal, ParamListInfo params,
 							consMap,
 							NULL,
 							false);
+					setLocatorBucketNodes(locator,
+										  queryDesc->plannedstmt->distributionNodes);
+					if (queryDesc->plannedstmt->skewValues)
+						setLocatorSkew(locator,
+									   queryDesc->plannedstmt->skewValues,
+									   queryDesc->plannedstmt->skewEqfunc,
+									   queryDesc->plannedstmt->skewCollation,
+									   queryDesc->plannedstmt->skewBroadcast);
 					dest = CreateDestReceiver(DestProducer);
 					SetProducerDestReceiverParams(dest,
 							queryDesc->plannedstmt->distributionKey,
 							locator, queryDesc->squeue);
+					if (queryDesc->plannedstmt->hasBloomParam)
+						SetProducerDestReceiverFilter(dest, filter);
 					queryDesc->dest = dest;
 				}
 				else
@@ -786,16 +835,35 @@ PortalStart(Portal portal, ParamListInfo params,
 								consMap,
 								NULL,
 								false);
+						setLocatorBucketNodes(locator,
+											  queryDesc->plannedstmt->distributionNodes);
+						if (queryDesc->plannedstmt->skewValues)
+							setLocatorSkew(locator,
+										   queryDesc->plannedstmt->skewValues,
+										   queryDesc->plannedstmt->skewEqfunc,
+										   queryDesc->plannedstmt->skewCollation,
+										   queryDesc->plannedstmt->skewBroadcast);
 						dest = CreateDestReceiver(DestProducer);
 						SetProducerDestReceiverParams(dest,
 								queryDesc->plannedstmt->distributionKey,
 								locator, queryDesc->squeue);
+						if (queryDesc->plannedstmt->hasBloomParam)
+							SetProducerDestReceiverFilter(dest, filter);
 						queryDesc->dest = dest;
 
 						addProducingPortal(portal);
 					}
 					else
 					{
+						/*
+						 * Tell the producer which rows we need. It may have
+						 * sent us other rows already, they will be filtered
+						 * out by the join.
+						 */
+						if (filter)
+							SharedQueueSetFilter(queryDesc->squeue,
+												 queryDesc->myindex, filter);
+
 						/*
 						 * We do not need to initialize executor, but need
 						 * a tuple descriptor
@@ -835,7 +903,8 @@ PortalStart(Portal portal, ParamListInfo params,
 
 				/*
 				 * Create QueryDesc in portal's context; for the moment, set
-				 * the destination to DestNone.
+				 * the destination to DestNone.  A plan fragment is
+				 * instrumented if the Coordinator runs EXPLAIN ANALYZE.
 				 */
 				queryDesc = CreateQueryDesc(linitial_node(PlannedStmt, portal->stmts),
 											portal->sourceText,
@@ -844,7 +913,11 @@ PortalStart(Portal portal, ParamListInfo params,
 											None_Receiver,
 											params,
 											portal->queryEnv,
+#ifdef XCP
+											linitial_node(PlannedStmt, portal->stmts)->instrumentOptions);
+#else
 											0);
+#endif
 
 				/*
 				 * If it's a scrollable cursor, executor needs to support
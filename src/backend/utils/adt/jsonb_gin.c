@@ -16,11 +16,9 @@
 #include "access/gin.h"
 #include "access/hash.h"
 #include "access/stratnum.h"
-#include "catalog/pg_collation.h"
 #include "catalog/pg_type.h"
 #include "utils/builtins.h"
 #include "utils/jsonb.h"
-#include "utils/varlena.h"
 
 typedef struct PathHashStack
 {
@@ -54,8 +52,15 @@ gin_compare_jsonb(PG_FUNCTION_ARGS)
 	len1 = VARSIZE_ANY_EXHDR(arg1);
 	len2 = VARSIZE_ANY_EXHDR(arg2);
 
-	/* Compare text as bttextcmp does, but always using C collation */
-	result = varstr_cmp(a1p, len1, a2p, len2, C_COLLATION_OID);
+	/*
+	 * Compare text as bttextcmp does, but always using C collation.  This is
+	 * called for every key comparison while building, searching and sorting
+	 * extracted entries, so do the memcmp ourselves rather than going
+	 * through varstr_cmp and its collation lookup.
+	 */
+	result = memcmp(a1p, a2p, Min(len1, len2));
+	if (result == 0 && len1 != len2)
+		result = (len1 < len2) ? -1 : 1;
 
 	PG_FREE_IF_COPY(arg1, 0);
 	PG_FREE_IF_COPY(arg2, 1);
@@ -18,6 +18,7 @@
 #include "funcapi.h"
 #include "miscadmin.h"
 #ifdef PGXC
+#include "pgxc/globaldeadlock.h"
 #include "pgxc/pgxc.h"
 #include "pgxc/pgxcnode.h"
 #include "pgxc/nodemgr.h"
@@ -585,6 +586,72 @@ pg_safe_snapshot_blocking_pids(PG_FUNCTION_ARGS)
 										  sizeof(int32), true, 'i'));
 }
 
+#ifdef PGXC
+/*
+ * pgxc_lock_wait_edges - lock waits of this node between distributed sessions
+ *
+ * Each row tells that the session identified by waiter_node and waiter_pid
+ * waits for a lock held or requested ahead of it by the session of
+ * holder_node and holder_pid. The sessions are identified by their
+ * Coordinator, so the rows from all the nodes make up the global wait-for
+ * graph used by the global deadlock detector.
+ */
+Datum
+pgxc_lock_wait_edges(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *funcctx;
+	GlobalWaitEdge *edges;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		TupleDesc	tupdesc;
+		MemoryContext oldcontext;
+		int			nedges;
+
+		funcctx = SRF_FIRSTCALL_INIT();
+		oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+		tupdesc = CreateTemplateTupleDesc(4, false);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 1, "waiter_node",
+						   NAMEOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 2, "waiter_pid",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 3, "holder_node",
+						   NAMEOID, -1, 0);
+		TupleDescInitEntry(tupdesc, (AttrNumber) 4, "holder_pid",
+						   INT4OID, -1, 0);
+		funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+
+		funcctx->user_fctx = (void *) GetLocalWaitEdges(&nedges);
+		funcctx->max_calls = nedges;
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	funcctx = SRF_PERCALL_SETUP();
+	edges = (GlobalWaitEdge *) funcctx->user_fctx;
+
+	if (funcctx->call_cntr < funcctx->max_calls)
+	{
+		GlobalWaitEdge *edge = &edges[funcctx->call_cntr];
+		Datum		values[4];
+		bool		nulls[4];
+		HeapTuple	tuple;
+
+		MemSet(nulls, false, sizeof(nulls));
+		values[0] = NameGetDatum(&edge->waiter_node);
+		values[1] = Int32GetDatum(edge->waiter_pid);
+		values[2] = NameGetDatum(&edge->holder_node);
+		values[3] = Int32GetDatum(edge->holder_pid);
+
+		tuple = heap_form_tuple(funcctx->tuple_desc, values, nulls);
+		SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(tuple));
+	}
+
+	SRF_RETURN_DONE(funcctx);
+}
+#endif
+
 
 /*
  * pg_isolation_test_session_is_blocked - support function for isolationtester
@@ -6846,6 +6846,11 @@ get_utility_query_def(Query *query, deparse_context *context)
 							quote_identifier(stmt->distributeby->colname));
 					break;
 
+				case DISTTYPE_BUCKET:
+					appendStringInfo(buf, " DISTRIBUTE BY BUCKET(%s)",
+							quote_identifier(stmt->distributeby->colname));
+					break;
+
 				default:
 					ereport(ERROR, (errcode(ERRCODE_SYNTAX_ERROR),
 								errmsg("Invalid distribution type")));
@@ -36,6 +36,7 @@
 #include "utils/rel.h"
 #include "utils/resowner_private.h"
 #include "utils/syscache.h"
+#include "utils/timestamp.h"
 #include "utils/tqual.h"
 
 
@@ -72,6 +73,15 @@
 /* Cache management header --- pointer is NULL until created */
 static CatCacheHeader *CacheHdr = NULL;
 
+/*
+ * Entries that have not been looked up for this many seconds are removed
+ * instead of enlarging a full cache; -1 disables pruning.
+ */
+int			catalog_cache_prune_min_age = 300;
+
+/* Timestamp used to age entries, see SetCatCacheClock */
+TimestampTz catcacheclock = 0;
+
 
 static uint32 CatalogCacheComputeHashValue(CatCache *cache, int nkeys,
 							 ScanKey cur_skey);
@@ -83,6 +93,7 @@ static void CatCachePrintStats(int code, Datum arg);
 #endif
 static void CatCacheRemoveCTup(CatCache *cache, CatCTup *ct);
 static void CatCacheRemoveCList(CatCache *cache, CatCList *cl);
+static bool CatCacheCleanupOldEntries(CatCache *cp);
 static void CatalogCacheInitializeCache(CatCache *cache);
 static CatCTup *CatalogCacheCreateEntry(CatCache *cache, HeapTuple ntp,
 						uint32 hashValue, Index hashIndex,
@@ -380,6 +391,53 @@ CatCacheRemoveCTup(CatCache *cache, CatCTup *ct)
 	--CacheHdr->ch_ntup;
 }
 
+/*
+ *		CatCacheCleanupOldEntries
+ *
+ * Remove entries that haven't been looked up for catalog_cache_prune_min_age
+ * seconds.  Entries that are referenced, that belong to a CatCList, or that
+ * were used in the current transaction (which includes the entry our caller
+ * has just added) are left alone.  Returns true if anything was removed.
+ */
+static bool
+CatCacheCleanupOldEntries(CatCache *cp)
+{
+	int			nremoved = 0;
+	int			i;
+	long		age;
+	int			us;
+
+	if (catalog_cache_prune_min_age < 0)
+		return false;
+
+	for (i = 0; i < cp->cc_nbuckets; i++)
+	{
+		dlist_mutable_iter iter;
+
+		dlist_foreach_modify(iter, &cp->cc_bucket[i])
+		{
+			CatCTup    *ct = dlist_container(CatCTup, cache_elem, iter.cur);
+
+			if (ct->refcount > 0 || ct->c_list != NULL ||
+				ct->lastaccess == catcacheclock)
+				continue;
+
+			TimestampDifference(ct->lastaccess, catcacheclock, &age, &us);
+			if (age < catalog_cache_prune_min_age)
+				continue;
+
+			CatCacheRemoveCTup(cp, ct);
+			nremoved++;
+		}
+	}
+
+	if (nremoved > 0)
+		elog(DEBUG1, "pruned %d entries from catalog cache id %d for %s; %d tups, %d buckets",
+			 nremoved, cp->id, cp->cc_relname, cp->cc_ntup, cp->cc_nbuckets);
+
+	return nremoved > 0;
+}
+
 /*
  *		CatCacheRemoveCList
  *
@@ -1116,6 +1174,7 @@ SearchCatCache(CatCache *cache,
 		 * near the front of the hashbucket's list.)
 		 */
 		dlist_move_head(bucket, &ct->cache_elem);
+		ct->lastaccess = catcacheclock;
 
 		/*
 		 * If it's a positive entry, bump its refcount and return it. If it's
@@ -1661,6 +1720,7 @@ CatalogCacheCreateEntry(CatCache *cache, HeapTuple ntp,
 	ct->dead = false;
 	ct->negative = negative;
 	ct->hash_value = hashValue;
+	ct->lastaccess = catcacheclock;
 
 	dlist_push_head(&cache->cc_bucket[hashIndex], &ct->cache_elem);
 
@@ -1669,9 +1729,14 @@ CatalogCacheCreateEntry(CatCache *cache, HeapTuple ntp,
 
 	/*
 	 * If the hash table has become too full, enlarge the buckets array. Quite
-	 * arbitrarily, we enlarge when fill factor > 2.
+	 * arbitrarily, we enlarge when fill factor > 2.  Before doing that, try
+	 * to make room by throwing away entries nobody has used for a while, so
+	 * that a session which once touched many objects doesn't keep them all
+	 * around forever.
 	 */
-	if (cache->cc_ntup > cache->cc_nbuckets * 2)
+	if (cache->cc_ntup > cache->cc_nbuckets * 2 &&
+		(!CatCacheCleanupOldEntries(cache) ||
+		 cache->cc_ntup > cache->cc_nbuckets * 2))
 		RehashCatCache(cache);
 
 	return ct;
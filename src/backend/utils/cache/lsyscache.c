@@ -2548,6 +2548,29 @@ get_pgxc_nodehost(Oid nodeid)
 	return result;
 }
 
+/*
+ * get_pgxc_nodezone
+ *		Get node network zone for given Oid
+ */
+char *
+get_pgxc_nodezone(Oid nodeid)
+{
+	HeapTuple		tuple;
+	Form_pgxc_node	nodeForm;
+	char		   *result;
+
+	tuple = SearchSysCache1(PGXCNODEOID, ObjectIdGetDatum(nodeid));
+
+	if (!HeapTupleIsValid(tuple))
+			elog(ERROR, "cache lookup failed for node %u", nodeid);
+
+	nodeForm = (Form_pgxc_node) GETSTRUCT(tuple);
+	result = pstrdup(NameStr(nodeForm->node_zone));
+	ReleaseSysCache(tuple);
+
+	return result;
+}
+
 /*
  * is_pgxc_nodepreferred
  *		Determine if node is a preferred one
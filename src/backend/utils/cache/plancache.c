@@ -74,7 +74,13 @@
 #include "commands/prepare.h"
 #include "pgxc/execRemote.h"
 #ifdef XCP
+#include "common/sha2.h"
+#include "lib/ilist.h"
 #include "pgxc/squeue.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/dsa.h"
 #endif
 #include "pgxc/pgxc.h"
 #endif
@@ -96,6 +102,87 @@
  */
 static CachedPlanSource *first_saved_plan = NULL;
 
+#ifdef XCP
+/*
+ * Cache of decoded remote subplans, kept by a Datanode backend across
+ * statements and sessions served over the same pooled connection. It is
+ * keyed on the SHA-256 digest of the serialized plan, so when a Coordinator
+ * sends the same fragment again the Datanode copies the cached tree instead
+ * of running stringToNode(), which resolves every portable object reference
+ * through the catalogs. A Coordinator may also send just the digest and let
+ * the Datanode ask for the body if it does not have it.
+ * Entries are kept in LRU order, the least recently used is evicted when the
+ * cache is full. A relcache invalidation drops the entries referencing the
+ * relation, any other invalidation flushes the whole cache.
+ */
+typedef struct RemoteSubplanCacheEntry
+{
+	uint8		digest[PG_SHA256_DIGEST_LENGTH];	/* the key */
+	char	   *plan_string;	/* serialized plan, to verify the match */
+	RemoteStmt *rstmt;			/* decoded plan */
+	List	   *relids;			/* OIDs of the relations in the range table */
+	MemoryContext context;		/* holds everything above */
+	dlist_node	lru_node;		/* position in the LRU list */
+} RemoteSubplanCacheEntry;
+
+int			RemoteSubplanCacheSize = 256;
+
+static HTAB *RemoteSubplanCache = NULL;
+static dlist_head RemoteSubplanLRU = DLIST_STATIC_INIT(RemoteSubplanLRU);
+static MemoryContext RemoteSubplanCacheContext = NULL;
+static uint64 RemoteSubplanCacheGeneration = 0;
+
+static RemoteStmt *LookupRemoteSubplan(const char *plan_string,
+					const uint8 *digest);
+static void StoreRemoteSubplan(const char *plan_string, const uint8 *digest,
+				   RemoteStmt *rstmt);
+static void DropRemoteSubplanEntry(RemoteSubplanCacheEntry *entry);
+static void InvalidateRemoteSubplans(Oid relid);
+static void ResetRemoteSubplanCache(void);
+
+/*
+ * Store of serialized remote subplans shared by all backends of a Datanode.
+ * A backend freshly handed out by the pooler has an empty local cache, so
+ * without this it would ask the Coordinator for the body of every large
+ * fragment again. The serialized form only refers to objects by name, so it
+ * does not depend on the catalog state and needs no invalidation; it is
+ * content-addressed by the digest. Decoding still happens in each backend.
+ * Plan strings are kept in a DSA area created in place in the main shared
+ * memory segment and capped to its size, entries are evicted in
+ * approximate LRU order when it is full.
+ */
+typedef struct SharedSubplanEntry
+{
+	uint8		digest[PG_SHA256_DIGEST_LENGTH];	/* the key */
+	dsa_pointer plan_string;	/* NUL-terminated serialized plan */
+	uint64		lastused;		/* store clock at last use */
+} SharedSubplanEntry;
+
+typedef struct SharedSubplanStoreHeader
+{
+	uint64		clock;			/* advanced on each use of an entry */
+	int			nentries;		/* number of entries in the hash table */
+	/* the DSA area follows, at SharedSubplanAreaOffset */
+} SharedSubplanStoreHeader;
+
+#define SharedSubplanAreaOffset MAXALIGN(sizeof(SharedSubplanStoreHeader))
+#define SharedSubplanAreaPlace() \
+	((char *) SharedSubplanStore + SharedSubplanAreaOffset)
+
+int			SharedSubplanStoreSize = 4096; /* kB */
+
+static SharedSubplanStoreHeader *SharedSubplanStore = NULL;
+static HTAB *SharedSubplanHash = NULL;
+static dsa_area *SharedSubplanArea = NULL;
+
+static Size SharedSubplanAreaSize(void);
+static int	SharedSubplanMaxEntries(void);
+static void SharedSubplanAttach(void);
+static bool SharedSubplanEvict(void);
+static void StoreSharedRemoteSubplan(const char *plan_string,
+						 const uint8 *digest);
+#endif
+
 static void ReleaseGenericPlan(CachedPlanSource *plansource);
 static List *RevalidateCachedQuery(CachedPlanSource *plansource,
 					  QueryEnvironment *queryEnv);
@@ -1791,6 +1878,10 @@ PlanCacheRelCallback(Datum arg, Oid relid)
 {
 	CachedPlanSource *plansource;
 
+#ifdef XCP
+	InvalidateRemoteSubplans(relid);
+#endif
+
 	for (plansource = first_saved_plan; plansource; plansource = plansource->next_saved)
 	{
 		Assert(plansource->magic == CACHEDPLANSOURCE_MAGIC);
@@ -1856,6 +1947,10 @@ PlanCacheFuncCallback(Datum arg, int cacheid, uint32 hashvalue)
 {
 	CachedPlanSource *plansource;
 
+#ifdef XCP
+	ResetRemoteSubplanCache();
+#endif
+
 	for (plansource = first_saved_plan; plansource; plansource = plansource->next_saved)
 	{
 		ListCell   *lc;
@@ -1944,6 +2039,10 @@ ResetPlanCache(void)
 {
 	CachedPlanSource *plansource;
 
+#ifdef XCP
+	ResetRemoteSubplanCache();
+#endif
+
 	for (plansource = first_saved_plan; plansource; plansource = plansource->next_saved)
 	{
 		ListCell   *lc;
@@ -1990,13 +2089,16 @@ ResetPlanCache(void)
 
 #ifdef XCP
 void
-SetRemoteSubplan(CachedPlanSource *plansource, const char *plan_string)
+SetRemoteSubplan(CachedPlanSource *plansource, const char *plan_string,
+				 const uint8 *digest)
 {
 	CachedPlan 		   *plan;
 	MemoryContext 		plan_context;
 	MemoryContext 		oldcxt;
 	RemoteStmt 		   *rstmt;
 	PlannedStmt 	   *stmt;
+	uint8				local_digest[PG_SHA256_DIGEST_LENGTH];
+	uint64				generation;
 
 	Assert(IS_PGXC_DATANODE);
 	Assert(plansource->raw_parse_tree == NULL);
@@ -2026,18 +2128,61 @@ SetRemoteSubplan(CachedPlanSource *plansource, const char *plan_string)
 	 * else which gets reset in case of errors. But for now, this seems
 	 * enough.
 	 */
-	PG_TRY();
+	if (digest == NULL && RemoteSubplanCacheSize > 0)
 	{
-		set_portable_input(true);
-		rstmt = (RemoteStmt *) stringToNode((char *) plan_string);
+		pg_sha256_ctx ctx;
+
+		pg_sha256_init(&ctx);
+		pg_sha256_update(&ctx, (const uint8 *) plan_string,
+						 strlen(plan_string));
+		pg_sha256_final(&ctx, local_digest);
+		digest = local_digest;
 	}
-	PG_CATCH();
+
+	if (RemoteSubplanCacheSize > 0)
+		rstmt = LookupRemoteSubplan(plan_string, digest);
+	else
+		rstmt = NULL;
+
+	if (rstmt == NULL)
 	{
+		/* Only the digest is sent, caller should have checked the cache */
+		if (plan_string[0] == '\0')
+			ereport(ERROR,
+					(errcode(ERRCODE_INTERNAL_ERROR),
+					 errmsg("remote subplan is not cached")));
+
+		generation = RemoteSubplanCacheGeneration;
+
+		PG_TRY();
+		{
+			set_portable_input(true);
+			rstmt = (RemoteStmt *) stringToNode((char *) plan_string);
+		}
+		PG_CATCH();
+		{
+			set_portable_input(false);
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
 		set_portable_input(false);
-		PG_RE_THROW();
+
+		/*
+		 * Do not keep the plan if an invalidation was processed while it was
+		 * being decoded, it may reflect catalog state from before that.
+		 */
+		if (RemoteSubplanCacheSize > 0 &&
+				generation == RemoteSubplanCacheGeneration)
+			StoreRemoteSubplan(plan_string, digest, rstmt);
+
+		/*
+		 * Let other backends of this node have the body of fragments the
+		 * Coordinator would send as a digest only.
+		 */
+		if (digest != NULL && RemoteSubplanDigestMinSize >= 0 &&
+				strlen(plan_string) >= RemoteSubplanDigestMinSize)
+			StoreSharedRemoteSubplan(plan_string, digest);
 	}
-	PG_END_TRY();
-	set_portable_input(false);
 
 	stmt = makeNode(PlannedStmt);
 
@@ -2062,6 +2207,15 @@ SetRemoteSubplan(CachedPlanSource *plansource, const char *plan_string)
 	stmt->distributionKey = rstmt->distributionKey;
 	stmt->distributionNodes = rstmt->distributionNodes;
 	stmt->distributionRestrict = rstmt->distributionRestrict;
+	stmt->skewValues = rstmt->skewValues;
+	stmt->skewEqfunc = rstmt->skewEqfunc;
+	stmt->skewCollation = rstmt->skewCollation;
+	stmt->skewBroadcast = rstmt->skewBroadcast;
+	stmt->hasBloomParam = rstmt->hasBloomParam;
+	stmt->parallelModeNeeded = rstmt->parallelModeNeeded;
+	stmt->instrumentOptions = rstmt->instrumentOptions;
+	/* account the fragment for the query it is part of */
+	stmt->queryId = rstmt->queryId;
 
 	/*
 	 * Set up SharedQueue if intermediate results need to be distributed
@@ -2070,7 +2224,9 @@ SetRemoteSubplan(CachedPlanSource *plansource, const char *plan_string)
 	if (IsConnFromDatanode() && stmt->pname &&
 			list_length(stmt->distributionRestrict) > 1)
 		SharedQueueAcquire(stmt->pname,
-						   list_length(stmt->distributionRestrict) - 1);
+						   list_length(stmt->distributionRestrict) - 1,
+						   stmt->planTree->plan_rows,
+						   stmt->planTree->plan_width);
 
 	/*
 	 * Create and fill the CachedPlan struct within the new context.
@@ -2100,4 +2256,448 @@ SetRemoteSubplan(CachedPlanSource *plansource, const char *plan_string)
 
 	MemoryContextSwitchTo(oldcxt);
 }
+
+
+/*
+ * Make a copy of the RemoteStmt in the current memory context.
+ */
+static RemoteStmt *
+CopyRemoteStmt(RemoteStmt *from)
+{
+	RemoteStmt *newnode = makeNode(RemoteStmt);
+
+	newnode->commandType = from->commandType;
+	newnode->hasReturning = from->hasReturning;
+	newnode->planTree = copyObject(from->planTree);
+	newnode->rtable = copyObject(from->rtable);
+	newnode->resultRelations = copyObject(from->resultRelations);
+	newnode->subplans = copyObject(from->subplans);
+	newnode->nParamExec = from->nParamExec;
+	newnode->nParamRemote = from->nParamRemote;
+	if (from->nParamRemote > 0)
+	{
+		Size		size = from->nParamRemote * sizeof(RemoteParam);
+
+		newnode->remoteparams = (RemoteParam *) palloc(size);
+		memcpy(newnode->remoteparams, from->remoteparams, size);
+	}
+	else
+		newnode->remoteparams = NULL;
+	newnode->rowMarks = copyObject(from->rowMarks);
+	newnode->distributionType = from->distributionType;
+	newnode->distributionKey = from->distributionKey;
+	newnode->distributionNodes = copyObject(from->distributionNodes);
+	newnode->distributionRestrict = copyObject(from->distributionRestrict);
+	newnode->skewValues = copyObject(from->skewValues);
+	newnode->skewEqfunc = from->skewEqfunc;
+	newnode->skewCollation = from->skewCollation;
+	newnode->skewBroadcast = from->skewBroadcast;
+	newnode->hasBloomParam = from->hasBloomParam;
+	newnode->parallelModeNeeded = from->parallelModeNeeded;
+	newnode->instrumentOptions = from->instrumentOptions;
+	newnode->queryId = from->queryId;
+
+	return newnode;
+}
+
+
+/*
+ * Check if the remote subplan with the given digest is cached, so the
+ * Coordinator does not need to send the plan body.
+ */
+bool
+HaveRemoteSubplan(const uint8 *digest)
+{
+	if (RemoteSubplanCache == NULL || RemoteSubplanCacheSize <= 0)
+		return false;
+
+	return hash_search(RemoteSubplanCache, digest, HASH_FIND, NULL) != NULL;
+}
+
+
+/*
+ * Return a copy of the cached remote subplan matching the digest, made in the
+ * current memory context, or NULL if it is not cached. If the serialized plan
+ * is provided it must match the cached one.
+ */
+static RemoteStmt *
+LookupRemoteSubplan(const char *plan_string, const uint8 *digest)
+{
+	RemoteSubplanCacheEntry *entry;
+
+	if (RemoteSubplanCache == NULL)
+		return NULL;
+
+	entry = (RemoteSubplanCacheEntry *) hash_search(RemoteSubplanCache,
+													digest, HASH_FIND,
+													NULL);
+	if (entry == NULL)
+		return NULL;
+	if (plan_string[0] != '\0' && strcmp(entry->plan_string, plan_string) != 0)
+		return NULL;
+
+	dlist_move_head(&RemoteSubplanLRU, &entry->lru_node);
+
+	return CopyRemoteStmt(entry->rstmt);
+}
+
+
+/*
+ * Put a copy of the decoded remote subplan into the cache, evicting least
+ * recently used entries to stay within remote_subplan_cache_size.
+ */
+static void
+StoreRemoteSubplan(const char *plan_string, const uint8 *digest,
+				   RemoteStmt *rstmt)
+{
+	RemoteSubplanCacheEntry *entry;
+	MemoryContext context;
+	MemoryContext oldcxt;
+	List	   *relids = NIL;
+	ListCell   *lc;
+	bool		found;
+
+	if (RemoteSubplanCache == NULL)
+	{
+		HASHCTL		ctl;
+
+		RemoteSubplanCacheContext = AllocSetContextCreate(CacheMemoryContext,
+														  "RemoteSubplanCache",
+														  ALLOCSET_DEFAULT_SIZES);
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = PG_SHA256_DIGEST_LENGTH;
+		ctl.entrysize = sizeof(RemoteSubplanCacheEntry);
+		ctl.hcxt = RemoteSubplanCacheContext;
+		RemoteSubplanCache = hash_create("Remote subplan cache", 256, &ctl,
+										 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	/* Make room, a plan with the same digest but different text is replaced */
+	entry = (RemoteSubplanCacheEntry *) hash_search(RemoteSubplanCache,
+													digest, HASH_FIND,
+													NULL);
+	if (entry)
+		DropRemoteSubplanEntry(entry);
+	while (hash_get_num_entries(RemoteSubplanCache) >= RemoteSubplanCacheSize &&
+		   !dlist_is_empty(&RemoteSubplanLRU))
+		DropRemoteSubplanEntry(dlist_tail_element(RemoteSubplanCacheEntry,
+												  lru_node,
+												  &RemoteSubplanLRU));
+
+	/*
+	 * Copy the plan first so an out-of-memory error does not leave a
+	 * half-built entry in the hash table.
+	 */
+	context = AllocSetContextCreate(RemoteSubplanCacheContext,
+									"RemoteSubplan",
+									ALLOCSET_SMALL_SIZES);
+	oldcxt = MemoryContextSwitchTo(context);
+	PG_TRY();
+	{
+		plan_string = pstrdup(plan_string);
+		rstmt = CopyRemoteStmt(rstmt);
+		foreach(lc, rstmt->rtable)
+		{
+			RangeTblEntry *rte = (RangeTblEntry *) lfirst(lc);
+
+			if (rte->rtekind == RTE_RELATION)
+				relids = list_append_unique_oid(relids, rte->relid);
+		}
+	}
+	PG_CATCH();
+	{
+		MemoryContextSwitchTo(oldcxt);
+		MemoryContextDelete(context);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	MemoryContextSwitchTo(oldcxt);
+
+	entry = (RemoteSubplanCacheEntry *) hash_search(RemoteSubplanCache,
+													digest, HASH_ENTER,
+													&found);
+	Assert(!found);
+	entry->plan_string = (char *) plan_string;
+	entry->rstmt = rstmt;
+	entry->relids = relids;
+	entry->context = context;
+	dlist_push_head(&RemoteSubplanLRU, &entry->lru_node);
+}
+
+
+static void
+DropRemoteSubplanEntry(RemoteSubplanCacheEntry *entry)
+{
+	dlist_delete(&entry->lru_node);
+	MemoryContextDelete(entry->context);
+	hash_search(RemoteSubplanCache, entry->digest, HASH_REMOVE, NULL);
+}
+
+
+/*
+ * Forget cached remote subplans referencing the relation, or all of them if
+ * relid is InvalidOid.
+ */
+static void
+InvalidateRemoteSubplans(Oid relid)
+{
+	dlist_mutable_iter iter;
+
+	if (!OidIsValid(relid))
+	{
+		ResetRemoteSubplanCache();
+		return;
+	}
+
+	RemoteSubplanCacheGeneration++;
+
+	if (RemoteSubplanCache == NULL)
+		return;
+
+	dlist_foreach_modify(iter, &RemoteSubplanLRU)
+	{
+		RemoteSubplanCacheEntry *entry;
+
+		entry = dlist_container(RemoteSubplanCacheEntry, lru_node, iter.cur);
+		if (list_member_oid(entry->relids, relid))
+			DropRemoteSubplanEntry(entry);
+	}
+}
+
+
+/*
+ * Forget all cached remote subplans. Called on any invalidation that may
+ * affect how a serialized plan is resolved against the local catalogs.
+ */
+static void
+ResetRemoteSubplanCache(void)
+{
+	RemoteSubplanCacheGeneration++;
+
+	if (RemoteSubplanCache == NULL)
+		return;
+
+	while (!dlist_is_empty(&RemoteSubplanLRU))
+		DropRemoteSubplanEntry(dlist_tail_element(RemoteSubplanCacheEntry,
+												  lru_node,
+												  &RemoteSubplanLRU));
+}
+
+
+/*
+ * Report shared-memory space needed by SharedRemoteSubplanShmemInit.
+ */
+Size
+SharedRemoteSubplanShmemSize(void)
+{
+	Size		size;
+
+	if (!IS_PGXC_DATANODE || SharedSubplanStoreSize <= 0)
+		return 0;
+
+	size = add_size(SharedSubplanAreaOffset, SharedSubplanAreaSize());
+	size = add_size(size, hash_estimate_size(SharedSubplanMaxEntries(),
+											 sizeof(SharedSubplanEntry)));
+
+	return size;
+}
+
+
+/*
+ * Allocate and initialize the shared remote subplan store.
+ */
+void
+SharedRemoteSubplanShmemInit(void)
+{
+	HASHCTL		info;
+	bool		found;
+	int			nentries;
+
+	if (!IS_PGXC_DATANODE || SharedSubplanStoreSize <= 0)
+		return;
+
+	SharedSubplanStore = (SharedSubplanStoreHeader *)
+		ShmemInitStruct("Shared Remote Subplan Store",
+						SharedSubplanAreaOffset + SharedSubplanAreaSize(),
+						&found);
+	if (!found)
+	{
+		dsa_area   *area;
+
+		SharedSubplanStore->clock = 0;
+		SharedSubplanStore->nentries = 0;
+
+		/*
+		 * The area is never released, never let it grow beyond the space we
+		 * set aside for it. The handle of the creating process is of no use
+		 * to anyone, backends attach on first use.
+		 */
+		area = dsa_create_in_place(SharedSubplanAreaPlace(),
+								   SharedSubplanAreaSize(),
+								   LWTRANCHE_SHARED_SUBPLAN_STORE, NULL);
+		dsa_set_size_limit(area, SharedSubplanAreaSize());
+		dsa_detach(area);
+	}
+
+	nentries = SharedSubplanMaxEntries();
+	MemSet(&info, 0, sizeof(info));
+	info.keysize = PG_SHA256_DIGEST_LENGTH;
+	info.entrysize = sizeof(SharedSubplanEntry);
+	SharedSubplanHash = ShmemInitHash("Shared Remote Subplan Hash",
+									  nentries, nentries,
+									  &info, HASH_ELEM | HASH_BLOBS);
+}
+
+
+/*
+ * Return a copy of the serialized remote subplan with the given digest made
+ * in the current memory context, or NULL if no backend of this node has
+ * stored it.
+ */
+char *
+FetchSharedRemoteSubplan(const uint8 *digest)
+{
+	SharedSubplanEntry *entry;
+	char	   *result = NULL;
+
+	if (SharedSubplanStore == NULL)
+		return NULL;
+
+	SharedSubplanAttach();
+
+	LWLockAcquire(SharedSubplanStoreLock, LW_EXCLUSIVE);
+	entry = (SharedSubplanEntry *) hash_search(SharedSubplanHash, digest,
+											   HASH_FIND, NULL);
+	if (entry)
+	{
+		entry->lastused = ++SharedSubplanStore->clock;
+		result = pstrdup((char *) dsa_get_address(SharedSubplanArea,
+												  entry->plan_string));
+	}
+	LWLockRelease(SharedSubplanStoreLock);
+
+	return result;
+}
+
+
+/*
+ * Put the serialized remote subplan into the shared store, evicting the
+ * least recently used entries if it is full. Plans too large to leave room
+ * for others are not stored.
+ */
+static void
+StoreSharedRemoteSubplan(const char *plan_string, const uint8 *digest)
+{
+	SharedSubplanEntry *entry;
+	Size		len = strlen(plan_string) + 1;
+	dsa_pointer dp;
+	bool		found;
+
+	if (SharedSubplanStore == NULL || len > SharedSubplanAreaSize() / 8)
+		return;
+
+	SharedSubplanAttach();
+
+	LWLockAcquire(SharedSubplanStoreLock, LW_EXCLUSIVE);
+
+	entry = (SharedSubplanEntry *) hash_search(SharedSubplanHash, digest,
+											   HASH_FIND, NULL);
+	if (entry)
+	{
+		entry->lastused = ++SharedSubplanStore->clock;
+		LWLockRelease(SharedSubplanStoreLock);
+		return;
+	}
+
+	while (SharedSubplanStore->nentries >= SharedSubplanMaxEntries() &&
+		   SharedSubplanEvict())
+		;
+
+	for (;;)
+	{
+		dp = dsa_allocate_extended(SharedSubplanArea, len, DSA_ALLOC_NO_OOM);
+		if (DsaPointerIsValid(dp) || !SharedSubplanEvict())
+			break;
+	}
+
+	if (DsaPointerIsValid(dp))
+	{
+		memcpy(dsa_get_address(SharedSubplanArea, dp), plan_string, len);
+		entry = (SharedSubplanEntry *) hash_search(SharedSubplanHash, digest,
+												   HASH_ENTER, &found);
+		Assert(!found);
+		entry->plan_string = dp;
+		entry->lastused = ++SharedSubplanStore->clock;
+		SharedSubplanStore->nentries++;
+	}
+
+	LWLockRelease(SharedSubplanStoreLock);
+}
+
+
+/*
+ * Remove the least recently used entry of the shared store. Caller must hold
+ * SharedSubplanStoreLock exclusively. Returns false if the store is empty.
+ */
+static bool
+SharedSubplanEvict(void)
+{
+	HASH_SEQ_STATUS status;
+	SharedSubplanEntry *entry;
+	SharedSubplanEntry *victim = NULL;
+
+	hash_seq_init(&status, SharedSubplanHash);
+	while ((entry = (SharedSubplanEntry *) hash_seq_search(&status)) != NULL)
+	{
+		if (victim == NULL || entry->lastused < victim->lastused)
+			victim = entry;
+	}
+
+	if (victim == NULL)
+		return false;
+
+	dsa_free(SharedSubplanArea, victim->plan_string);
+	hash_search(SharedSubplanHash, victim->digest, HASH_REMOVE, NULL);
+	SharedSubplanStore->nentries--;
+
+	return true;
+}
+
+
+/*
+ * Attach to the DSA area of the shared store, if not done yet.
+ */
+static void
+SharedSubplanAttach(void)
+{
+	MemoryContext oldcxt;
+
+	if (SharedSubplanArea != NULL)
+		return;
+
+	oldcxt = MemoryContextSwitchTo(TopMemoryContext);
+	SharedSubplanArea = dsa_attach_in_place(SharedSubplanAreaPlace(), NULL);
+	MemoryContextSwitchTo(oldcxt);
+	on_shmem_exit(dsa_on_shmem_exit_release_in_place,
+				  PointerGetDatum(SharedSubplanAreaPlace()));
+}
+
+
+static Size
+SharedSubplanAreaSize(void)
+{
+	return Max(mul_size((Size) SharedSubplanStoreSize, 1024),
+			   dsa_minimum_size());
+}
+
+
+/*
+ * Plans stored here are mostly those above remote_subplan_digest_min_size,
+ * so a few kilobytes per entry is a fair guess.
+ */
+static int
+SharedSubplanMaxEntries(void)
+{
+	return Max(SharedSubplanAreaSize() / 4096, 64);
+}
 #endif
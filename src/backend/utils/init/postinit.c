@@ -32,6 +32,7 @@
 #include "catalog/pg_database.h"
 #include "catalog/pg_db_role_setting.h"
 #include "catalog/pg_tablespace.h"
+#include "executor/execSample.h"
 #include "libpq/auth.h"
 #include "libpq/libpq-be.h"
 #include "mb/pg_wchar.h"
@@ -39,6 +40,7 @@
 #include "pgstat.h"
 #ifdef XCP
 #include "pgxc/pgxc.h"
+#include "pgxc/pgxcnode.h"
 #include "postmaster/clustermon.h"
 #endif
 #include "postmaster/autovacuum.h"
@@ -488,7 +490,8 @@ pg_split_opts(char **argv, int *argcp, const char *optstr)
 }
 
 /*
- * Initialize MaxBackends value from config options.
+ * Initialize MaxBackends value from config options, along with the number
+ * of fast-path lock groups per backend.
  *
  * This must be called after modules have had the chance to register background
  * workers in shared_preload_libraries, and before shared memory size is
@@ -511,6 +514,17 @@ InitializeMaxBackends(void)
 	/* internal error because the values were all checked previously */
 	if (MaxBackends > MAX_BACKENDS)
 		elog(ERROR, "too many backends configured");
+
+	/*
+	 * Size the fast-path lock arrays from max_locks_per_transaction, which is
+	 * our best guess of how many relations a transaction is going to lock.
+	 * The number of groups is rounded up to a power of two.
+	 */
+	Assert(FastPathLockGroupsPerBackend == 0);
+	FastPathLockGroupsPerBackend = 1;
+	while (FastPathLockSlotsPerBackend() < max_locks_per_xact &&
+		   FastPathLockGroupsPerBackend < FP_LOCK_GROUPS_PER_BACKEND_MAX)
+		FastPathLockGroupsPerBackend *= 2;
 }
 
 /*
@@ -607,6 +621,8 @@ InitPostgres(const char *in_dbname, Oid dboid, const char *username,
 		RegisterTimeout(LOCK_TIMEOUT, LockTimeoutHandler);
 		RegisterTimeout(IDLE_IN_TRANSACTION_SESSION_TIMEOUT,
 						IdleInTransactionSessionTimeoutHandler);
+		RegisterTimeout(EXEC_SAMPLE_TIMEOUT, ExecSampleTimeoutHandler);
+		RegisterTimeout(HELD_HANDLES_TIMEOUT, HeldHandlesTimeoutHandler);
 	}
 
 	/*
@@ -38,6 +38,7 @@
 #include "access/twophase.h"
 #include "access/xact.h"
 #include "access/xlog_internal.h"
+#include "access/xlogprefetch.h"
 #include "catalog/namespace.h"
 #include "catalog/pg_authid.h"
 #include "commands/async.h"
@@ -46,6 +47,8 @@
 #include "commands/vacuum.h"
 #include "commands/variable.h"
 #include "commands/trigger.h"
+#include "executor/execSample.h"
+#include "executor/executor.h"
 #include "funcapi.h"
 #include "libpq/auth.h"
 #include "libpq/be-fsstubs.h"
@@ -65,6 +68,9 @@
 #include "commands/tablecmds.h"
 #include "commands/trigger.h"
 #include "nodes/nodes.h"
+#include "pgxc/admission.h"
+#include "pgxc/barrier.h"
+#include "pgxc/commitbatcher.h"
 #include "pgxc/execRemote.h"
 #include "pgxc/locator.h"
 #include "pgxc/planner.h"
@@ -83,6 +89,10 @@
 #include "postmaster/autovacuum.h"
 #include "postmaster/bgworker_internals.h"
 #include "postmaster/bgwriter.h"
+#ifdef PGXC
+#include "postmaster/clustermon.h"
+#include "pgxc/globaldeadlock.h"
+#endif
 #include "postmaster/postmaster.h"
 #include "postmaster/syslogger.h"
 #include "postmaster/walwriter.h"
@@ -93,6 +103,7 @@
 #include "replication/walsender.h"
 #include "storage/bufmgr.h"
 #include "storage/dsm_impl.h"
+#include "storage/sinvaladt.h"
 #include "storage/standby.h"
 #include "storage/fd.h"
 #include "storage/pg_shmem.h"
@@ -102,6 +113,7 @@
 #include "tsearch/ts_cache.h"
 #include "utils/builtins.h"
 #include "utils/bytea.h"
+#include "utils/catcache.h"
 #include "utils/guc_tables.h"
 #include "utils/memutils.h"
 #include "utils/pg_locale.h"
@@ -447,6 +459,13 @@ static const struct config_enum_entry global_snapshot_source_options[] = {
 	{"coordinator", GLOBAL_SNAPSHOT_SOURCE_COORDINATOR, true},
 	{NULL, 0, false}
 };
+
+static const struct config_enum_entry admission_priority_options[] = {
+	{"low", ADMISSION_PRIORITY_LOW, false},
+	{"normal", ADMISSION_PRIORITY_NORMAL, false},
+	{"high", ADMISSION_PRIORITY_HIGH, false},
+	{NULL, 0, false}
+};
 #endif
 
 static const struct config_enum_entry force_parallel_mode_options[] = {
@@ -549,6 +568,7 @@ int			ssl_renegotiation_limit;
  * need to be duplicated in all the different implementations of pg_shmem.c.
  */
 int			huge_pages;
+bool		shared_memory_interleave = false;
 
 /*
  * These variables are all dummies that don't do anything, except in some
@@ -988,6 +1008,69 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_broadcast_join", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of broadcasting a join subplan to the nodes of the other one."),
+			NULL
+		},
+		&enable_broadcast_join,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"enable_bloom_filter", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables filtering redistributed hash join input by the Bloom filter of the inner keys."),
+			NULL
+		},
+		&enable_bloom_filter,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"enable_cte_inline", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables inlining of WITH queries referenced only once."),
+			NULL
+		},
+		&enable_cte_inline,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"enable_scalar_sublink_join", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables planning comparisons with correlated aggregate sub-selects as joins."),
+			NULL
+		},
+		&enable_scalar_sublink_join,
+		true,
+		NULL, NULL, NULL
+	},
+	{
+		{"enable_window_redistribution", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables redistributing window input along a PARTITION BY key to evaluate the window on the datanodes."),
+			NULL
+		},
+		&enable_window_redistribution,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"enable_grouping_redistribution", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables finalizing aggregates on the datanodes after redistributing partial groups."),
+			NULL
+		},
+		&enable_grouping_redistribution,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"enable_remote_memoize", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables caching the results of rescanned remote subplans by their parameter values."),
+			NULL
+		},
+		&enable_remote_memoize,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		{"loose_constraints", PGC_USERSET, COORDINATORS,
 			gettext_noop("Relax enforcing of constraints"),
@@ -1000,6 +1083,16 @@ static struct config_bool ConfigureNamesBool[] =
 		false,
 		NULL, NULL, NULL
 	},
+	{
+		{"datanode_standby_reads", PGC_SIGHUP, COORDINATORS,
+			gettext_noop("Makes the Datanodes wait for the latest barrier."),
+			gettext_noop("Set it on a Coordinator whose Datanode definitions "
+						 "point to hot standbys.")
+		},
+		&DatanodeStandbyReads,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		{"gtm_backup_barrier", PGC_SUSET, QUERY_TUNING_METHOD,
 			gettext_noop("Enables coordinator to report barrier id to GTM for backup."),
@@ -1028,6 +1121,24 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"enable_incremental_sort", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables the planner's use of incremental sort steps."),
+			NULL
+		},
+		&enable_incremental_sort,
+		true,
+		NULL, NULL, NULL
+	},
+	{
+		{"enable_partition_wise_join", PGC_USERSET, QUERY_TUNING_METHOD,
+			gettext_noop("Enables joining partitioned tables partition by partition."),
+			NULL
+		},
+		&enable_partition_wise_join,
+		false,
+		NULL, NULL, NULL
+	},
 
 	{
 		{"geqo", PGC_USERSET, QUERY_TUNING_GEQO,
@@ -1331,6 +1442,48 @@ static struct config_bool ConfigureNamesBool[] =
 		false,
 		NULL, NULL, NULL
 	},
+	{
+		{"shared_queue_spill", PGC_USERSET, RESOURCES_MEM,
+			gettext_noop("Allows shared queue producers to spill tuples to disk "
+					"for consumers falling behind."),
+			NULL
+		},
+		&SQueueSpill,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"dynamic_shared_queues", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Allocates memory for shared queues on demand."),
+			gettext_noop("Shared queue memory is allocated in dynamic shared "
+					"memory segments sized by the expected amount of data, "
+					"instead of preallocating shared_queues of "
+					"shared_queue_size at server start.")
+		},
+		&SQueueDynamic,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"shared_memory_interleave", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Interleaves the main shared memory segment across NUMA nodes."),
+			NULL
+		},
+		&shared_memory_interleave,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"pgxl_remote_pipeline", PGC_USERSET, UNGROUPED,
+			gettext_noop("Does not wait for remote nodes to acknowledge end of "
+					"a finished query step."),
+			gettext_noop("Next commands are pipelined after the Sync message, "
+					"its response is consumed when it arrives.")
+		},
+		&PGXLRemotePipeline,
+		false,
+		NULL, NULL, NULL
+	},
 #endif
 #ifdef BTREE_BUILD_STATS
 	{
@@ -1553,6 +1706,16 @@ static struct config_bool ConfigureNamesBool[] =
 		true,
 		NULL, NULL, NULL
 	},
+	{
+		{"reuse_planning_snapshot", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Runs read-only queries with the snapshot taken for planning."),
+			gettext_noop("Saves a GTM round trip per query in READ COMMITTED "
+						 "transactions.")
+		},
+		&reuse_planning_snapshot,
+		true,
+		NULL, NULL, NULL
+	},
 	{
 		{"array_nulls", PGC_USERSET, COMPAT_OPTIONS_PREVIOUS,
 			gettext_noop("Enable input of NULL elements in arrays."),
@@ -1752,6 +1915,18 @@ static struct config_bool ConfigureNamesBool[] =
 		false,
 		check_persistent_connections, NULL, NULL
 	},
+	{
+		{"async_commit_prepared", PGC_USERSET, DATA_NODES,
+			gettext_noop("Does not wait for the remote nodes to complete "
+						 "COMMIT PREPARED."),
+			gettext_noop("The commit is acknowledged once it is durable, "
+						 "the commit batcher completes it on the remote "
+						 "nodes. Requires max_commit_batchers.")
+		},
+		&AsyncCommitPrepared,
+		false,
+		NULL, NULL, NULL
+	},
 	{
 		{"xc_maintenance_mode", PGC_SUSET, XC_HOUSEKEEPING_OPTIONS,
 		    gettext_noop("Turn on XC maintenance mode."),
@@ -1761,6 +1936,25 @@ static struct config_bool ConfigureNamesBool[] =
 		false,
 		check_pgxc_maintenance_mode, NULL, NULL
 	},
+	{
+		{"network_compression", PGC_POSTMASTER, DATA_NODES,
+			gettext_noop("Compresses the traffic on connections to other nodes."),
+			NULL
+		},
+		&NetworkCompression,
+		false,
+		NULL, NULL, NULL
+	},
+	{
+		{"remotecompression", PGC_BACKEND, CONN_AUTH,
+			gettext_noop("Compresses the traffic with the node which opened the connection."),
+			NULL,
+			GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE | GUC_DISALLOW_IN_FILE
+		},
+		&remoteCompression,
+		false,
+		NULL, NULL, NULL
+	},
 #endif
 
 	{
@@ -1938,6 +2132,19 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+#ifdef PGXC
+	{
+		{"global_deadlock_check_interval", PGC_SIGHUP, LOCK_MANAGEMENT,
+			gettext_noop("Sets the time between checks for deadlocks spanning multiple nodes."),
+			gettext_noop("A value of 0 turns off the check."),
+			GUC_UNIT_MS
+		},
+		&GlobalDeadlockCheckInterval,
+		1000, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+#endif
+
 	{
 		{"max_standby_archive_delay", PGC_SIGHUP, REPLICATION_STANDBY,
 			gettext_noop("Sets the maximum delay before canceling queries when a hot standby server is processing archived WAL data."),
@@ -2101,6 +2308,29 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"catalog_cache_prune_min_age", PGC_USERSET, RESOURCES_MEM,
+			gettext_noop("Sets the minimum unused duration of catalog cache entries before removal."),
+			gettext_noop("Unused entries are removed instead of enlarging a full cache. "
+						 "-1 disables pruning."),
+			GUC_UNIT_S
+		},
+		&catalog_cache_prune_min_age,
+		300, -1, INT_MAX / 1000,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"invalidation_queue_size", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the number of shared cache invalidation messages that can be queued."),
+			gettext_noop("Backends that fall further behind have to reset their caches. "
+						 "The value is rounded up to a power of 2.")
+		},
+		&InvalidationQueueSize,
+		4096, 4096, 1048576,
+		NULL, NULL, NULL
+	},
+
 	/*
 	 * We use the hopefully-safely-small value of 100kB as the compiled-in
 	 * default for max_stack_depth.  InitializeGUCOptions will increase it if
@@ -2128,6 +2358,19 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"query_memory_limit", PGC_SUSET, RESOURCES_MEM,
+			gettext_noop("Limits the total memory used by each query."),
+			gettext_noop("Hash aggregation and shared queues spill to disk "
+						 "early to stay within the limit, other queries "
+						 "exceeding it are canceled. -1 means no limit."),
+			GUC_UNIT_KB
+		},
+		&query_memory_limit,
+		-1, -1, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"vacuum_cost_page_hit", PGC_USERSET, RESOURCES_VACUUM_DELAY,
 			gettext_noop("Vacuum cost for a page found in the buffer cache."),
@@ -2273,6 +2516,20 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+#ifdef PGXC
+	{
+		{"snapshot_max_staleness", PGC_USERSET, CLIENT_CONN_STATEMENT,
+			gettext_noop("Sets the maximum age of a GTM snapshot reused by "
+						 "the statements of a READ COMMITTED transaction."),
+			gettext_noop("A value of 0 turns off the reuse."),
+			GUC_UNIT_MS
+		},
+		&snapshot_max_staleness,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+#endif
+
 	{
 		{"idle_in_transaction_session_timeout", PGC_USERSET, CLIENT_CONN_STATEMENT,
 			gettext_noop("Sets the maximum allowed duration of any idling transaction."),
@@ -2548,7 +2805,7 @@ static struct config_int ConfigureNamesInt[] =
 			/* we have no microseconds designation, so can't supply units here */
 		},
 		&CommitDelay,
-		0, 0, 100000,
+		0, -1, 100000,
 		NULL, NULL, NULL
 	},
 
@@ -2599,6 +2856,18 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"executor_sample_interval", PGC_SUSET, STATS_COLLECTOR,
+			gettext_noop("Sets the time between samples of the plan node "
+						 "being executed."),
+			gettext_noop("Zero disables sampling."),
+			GUC_UNIT_MS
+		},
+		&ExecSampleInterval,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"bgwriter_delay", PGC_SIGHUP, RESOURCES_BGWRITER,
 			gettext_noop("Background writer sleep time between rounds."),
@@ -2647,6 +2916,22 @@ static struct config_int ConfigureNamesInt[] =
 		check_effective_io_concurrency, assign_effective_io_concurrency, NULL
 	},
 
+	{
+		{"seqscan_prefetch_pages",
+			PGC_USERSET,
+			RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Number of pages a sequential scan prefetches ahead of the one it reads."),
+			gettext_noop("Zero leaves read-ahead to the operating system.")
+		},
+		&seqscan_prefetch_pages,
+#ifdef USE_PREFETCH
+		0, 0, MAX_IO_CONCURRENCY,
+#else
+		0, 0, 0,
+#endif
+		NULL, NULL, NULL
+	},
+
 	{
 		{"backend_flush_after", PGC_USERSET, RESOURCES_ASYNCHRONOUS,
 			gettext_noop("Number of pages after which previously performed writes are flushed to disk."),
@@ -2794,6 +3079,32 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"recovery_prefetch_distance", PGC_SIGHUP, REPLICATION_STANDBY,
+			gettext_noop("Sets how far ahead of replay to prefetch the data "
+						 "blocks referenced by WAL records."),
+			gettext_noop("0 disables prefetching during recovery."),
+			GUC_UNIT_KB
+		},
+		&RecoveryPrefetchDistance,
+		0, 0, 1024 * 1024,
+		NULL, NULL, NULL
+	},
+
+#ifdef PGXC
+	{
+		{"standby_read_barrier_timeout", PGC_USERSET, REPLICATION_STANDBY,
+			gettext_noop("Sets the maximum time to wait for the replay of "
+						 "standby_read_barrier."),
+			gettext_noop("A value of 0 waits forever."),
+			GUC_UNIT_MS
+		},
+		&StandbyReadBarrierTimeout,
+		10000, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+#endif
+
 	{
 		{"wal_segment_size", PGC_INTERNAL, PRESET_OPTIONS,
 			gettext_noop("Shows the number of pages per write ahead log segment."),
@@ -2887,6 +3198,16 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"max_parallel_maintenance_workers", PGC_USERSET, RESOURCES_ASYNCHRONOUS,
+			gettext_noop("Sets the maximum number of parallel processes per maintenance operation."),
+			NULL
+		},
+		&max_parallel_maintenance_workers,
+		2, 0, MAX_PARALLEL_WORKER_LIMIT,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"autovacuum_work_mem", PGC_SIGHUP, RESOURCES_MEM,
 			gettext_noop("Sets the maximum memory to be used by each autovacuum worker process."),
@@ -3049,6 +3370,17 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"shared_sequence_ranges", PGC_POSTMASTER, COORDINATORS,
+			gettext_noop("Sets the number of sequences whose values leased from GTM "
+						 "are shared by all the sessions of the node."),
+			gettext_noop("Zero lets each session keep the values it leased.")
+		},
+		&SharedSequenceRanges,
+		0, 0, INT_MAX / 2,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"pool_conn_keepalive", PGC_SIGHUP, DATA_NODES,
 			gettext_noop("Close connections if they are idle in the pool for that time."),
@@ -3071,6 +3403,62 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"pool_connect_timeout", PGC_SIGHUP, DATA_NODES,
+			gettext_noop("Maximum time the pooler waits for a new connection to a node."),
+			gettext_noop("A value of 0 turns the timeout off."),
+			GUC_UNIT_S
+		},
+		&PoolConnectTimeout,
+		10, 0, INT_MAX / 1000,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"session_connection_hold_time", PGC_USERSET, DATA_NODES,
+			gettext_noop("Sets how long an idle session keeps its connections to the other nodes."),
+			gettext_noop("The connections are given back to the pool earlier if it runs "
+						 "out of connections. A value of 0 releases them at the end of "
+						 "each transaction."),
+			GUC_UNIT_S
+		},
+		&SessionConnectionHoldTime,
+		0, 0, INT_MAX / 1000,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"remote_subplan_cache_size", PGC_SIGHUP, DATA_NODES,
+			gettext_noop("Sets the number of decoded remote subplans a Datanode session keeps."),
+			gettext_noop("A value of 0 turns the cache off.")
+		},
+		&RemoteSubplanCacheSize,
+		256, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"remote_subplan_digest_min_size", PGC_USERSET, DATA_NODES,
+			gettext_noop("Sets the size in bytes from which a remote subplan is sent as a digest first."),
+			gettext_noop("The plan body is sent only to the Datanodes that do not have "
+						 "it cached. A value of -1 always sends the body.")
+		},
+		&RemoteSubplanDigestMinSize,
+		8192, -1, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"shared_remote_subplan_cache_size", PGC_POSTMASTER, DATA_NODES,
+			gettext_noop("Sets the amount of shared memory a Datanode uses to keep remote subplans for all its backends."),
+			gettext_noop("A value of 0 turns the shared store off."),
+			GUC_UNIT_KB
+		},
+		&SharedSubplanStoreSize,
+		4096, 0, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"max_pool_size", PGC_SIGHUP, DATA_NODES,
 			gettext_noop("Max pool size."),
@@ -3082,6 +3470,18 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"min_pool_size", PGC_SIGHUP, DATA_NODES,
+			gettext_noop("Minimum number of connections kept open in each node pool."),
+			gettext_noop("The pooler opens the connections in the background and "
+						 "prefills the busiest pools on restart. "
+						 "A value of 0 turns this off.")
+		},
+		&MinPoolSize,
+		0, 0, 65535,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"pooler_port", PGC_POSTMASTER, DATA_NODES,
 			gettext_noop("Port of the Pool Manager."),
@@ -3102,6 +3502,50 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"gtm_standby_port", PGC_POSTMASTER, GTM,
+			gettext_noop("Port of the GTM standby."),
+			NULL
+		},
+		&GtmStandbyPort,
+		6666, 1, 65535,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"cluster_monitor_naptime", PGC_SIGHUP, GTM,
+			gettext_noop("Maximum time between two reports of the node's xmin to GTM."),
+			NULL,
+			GUC_UNIT_MS
+		},
+		&ClusterMonitorNaptime,
+		5000, 100, INT_MAX / 1000,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"cluster_monitor_xmin_threshold", PGC_SIGHUP, GTM,
+			gettext_noop("Number of transactions the node's xmin must advance by "
+						 "to be reported to GTM before the next regular report."),
+			gettext_noop("Zero reports only at cluster_monitor_naptime intervals.")
+		},
+		&ClusterMonitorXminThreshold,
+		1000, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"cluster_monitor_health_interval", PGC_SIGHUP, GTM,
+			gettext_noop("Time between the health samples of the cluster "
+						 "taken by the cluster monitor."),
+			gettext_noop("Zero disables health sampling."),
+			GUC_UNIT_MS
+		},
+		&ClusterMonitorHealthInterval,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"max_datanodes", PGC_POSTMASTER, DATA_NODES,
 			gettext_noop("Maximum number of Datanodes in the cluster."),
@@ -3124,6 +3568,56 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"max_commit_batchers", PGC_POSTMASTER, DATA_NODES,
+			gettext_noop("Maximum number of commit batcher processes."),
+			gettext_noop("Commit batchers run COMMIT PREPARED of concurrent "
+						 "sessions together, one batcher per database. "
+						 "A value of 0 turns this off.")
+		},
+		&MaxCommitBatchers,
+		0, 0, MAX_BACKENDS,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"admission_max_fragments", PGC_SIGHUP, COORDINATORS,
+			gettext_noop("Maximum number of remote fragments the queries of "
+						 "the Coordinator run at once."),
+			gettext_noop("A fragment counts once for every node it runs on. "
+						 "Queries exceeding the limit wait for admission. "
+						 "A value of 0 turns this limit off.")
+		},
+		&AdmissionMaxFragments,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"admission_max_shared_queues", PGC_SIGHUP, COORDINATORS,
+			gettext_noop("Maximum number of shared queues the queries of "
+						 "the Coordinator use at once on the Datanodes."),
+			gettext_noop("Queries exceeding the limit wait for admission. "
+						 "A value of 0 turns this limit off.")
+		},
+		&AdmissionMaxSharedQueues,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"admission_max_memory", PGC_SIGHUP, COORDINATORS,
+			gettext_noop("Maximum work memory the queries of the Coordinator "
+						 "use at once on the Datanodes."),
+			gettext_noop("Queries exceeding the limit wait for admission. "
+						 "A value of 0 turns this limit off."),
+			GUC_UNIT_KB
+		},
+		&AdmissionMaxMemory,
+		0, 0, MAX_KILOBYTES,
+		NULL, NULL, NULL
+	},
+
 #ifdef XCP
 	/*
 	 * Shared queues provide shared memory buffers to stream data from
@@ -3176,6 +3670,16 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"pgxl_remote_batch_size", PGC_USERSET, UNGROUPED,
+			gettext_noop("Number of tuples sent to a remote node in one batched message"),
+			gettext_noop("Zero sends every tuple in its own DataRow message.")
+		},
+		&PGXLRemoteBatchSize,
+		0, 0, 65536,
+		NULL, NULL, NULL
+	},
+
 #endif
 #endif /* PGXC */
 
@@ -3319,6 +3823,28 @@ static struct config_real ConfigureNamesReal[] =
 		&remote_query_cost,
 		DEFAULT_REMOTE_QUERY_COST, 0, DBL_MAX, NULL, NULL
 	},
+
+	{
+		{"network_compression_ratio", PGC_USERSET, QUERY_TUNING_COST,
+			gettext_noop("Sets the planner's estimate of the ratio of the "
+						 "compressed to the original size of data sent "
+						 "from remote node."),
+			NULL
+		},
+		&network_compression_ratio,
+		DEFAULT_NETWORK_COMPRESSION_RATIO, 0.01, 1.0, NULL, NULL
+	},
+
+	{
+		{"network_cross_zone_factor", PGC_USERSET, QUERY_TUNING_COST,
+			gettext_noop("Sets the planner's estimate of how much more "
+						 "expensive sending data between nodes in different "
+						 "network zones is."),
+			NULL
+		},
+		&network_cross_zone_factor,
+		DEFAULT_NETWORK_CROSS_ZONE_FACTOR, 1.0, DBL_MAX, NULL, NULL
+	},
 #endif
 
 	{
@@ -3944,6 +4470,16 @@ static struct config_string ConfigureNamesString[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"gtm_standby_host", PGC_POSTMASTER, GTM,
+			gettext_noop("Host name or address of the GTM standby to fail over to."),
+			gettext_noop("An empty string disables the failover.")
+		},
+		&GtmStandbyHost,
+		"",
+		NULL, NULL, NULL
+	},
+
 	{
 		{"pgxc_node_name", PGC_POSTMASTER, GTM,
 			gettext_noop("The Coordinator or Datanode name."),
@@ -3954,6 +4490,18 @@ static struct config_string ConfigureNamesString[] =
 		"",
 		NULL, NULL, NULL
 	},
+
+	{
+		{"standby_read_barrier", PGC_USERSET, REPLICATION_STANDBY,
+			gettext_noop("Sets the barrier a hot standby must have replayed "
+						 "before taking a snapshot."),
+			NULL,
+			GUC_IS_NAME | GUC_NOT_IN_SAMPLE
+		},
+		&StandbyReadBarrier,
+		"",
+		NULL, NULL, NULL
+	},
 #endif
 #ifdef XCP
 	{
@@ -4309,6 +4857,17 @@ static struct config_enum ConfigureNamesEnum[] =
 		GLOBAL_SNAPSHOT_SOURCE_GTM, global_snapshot_source_options,
 		NULL, NULL, NULL
 	},
+
+	{
+		{"admission_priority", PGC_SUSET, COORDINATORS,
+			gettext_noop("Sets the priority of queries waiting for admission."),
+			gettext_noop("Waiting queries of higher priority are admitted "
+						 "first, see admission_max_fragments.")
+		},
+		&AdmissionPriorityClass,
+		ADMISSION_PRIORITY_NORMAL, admission_priority_options,
+		NULL, NULL, NULL
+	},
 #endif
 	{
 		{"force_parallel_mode", PGC_USERSET, QUERY_TUNING_OTHER,
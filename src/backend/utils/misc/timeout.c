@@ -622,6 +622,15 @@ disable_all_timeouts(bool keep_indicators)
 	}
 }
 
+/*
+ * Return true if the timeout is active (enabled and not yet fired)
+ */
+bool
+get_timeout_active(TimeoutId id)
+{
+	return find_active_timeout(id) >= 0;
+}
+
 /*
  * Return the timeout's I've-been-fired indicator
  *
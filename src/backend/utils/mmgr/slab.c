@@ -289,6 +289,7 @@ SlabReset(MemoryContext context)
 #endif
 			free(block);
 			slab->nblocks--;
+			slab->header.mem_allocated -= slab->blockSize;
 		}
 	}
 
@@ -346,6 +347,8 @@ SlabAlloc(MemoryContext context, Size size)
 		if (block == NULL)
 			return NULL;
 
+		slab->header.mem_allocated += slab->blockSize;
+
 		block->nfree = slab->chunksPerBlock;
 		block->firstFreeChunk = 0;
 
@@ -538,6 +541,7 @@ SlabFree(MemoryContext context, void *pointer)
 	{
 		free(block);
 		slab->nblocks--;
+		slab->header.mem_allocated -= slab->blockSize;
 	}
 	else
 		dlist_push_head(&slab->freelist[block->nfree], &block->node);
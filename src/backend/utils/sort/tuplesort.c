@@ -131,6 +131,8 @@
 #include "access/hash.h"
 #include "catalog/index.h"
 #include "catalog/pg_am.h"
+#include "catalog/pg_opfamily.h"
+#include "catalog/pg_type.h"
 #include "commands/tablespace.h"
 #include "executor/executor.h"
 #include "miscadmin.h"
@@ -154,9 +156,6 @@
 #define INDEX_SORT		1
 #define DATUM_SORT		2
 #define CLUSTER_SORT	3
-#ifdef PGXC
-#define MERGE_SORT 4
-#endif
 
 /* GUC variables */
 #ifdef TRACE_SORT
@@ -293,9 +292,6 @@ struct Tuplesortstate
 	MemoryContext sortcontext;	/* memory context holding most sort data */
 	MemoryContext tuplecontext; /* sub-context of sortcontext for tuple data */
 	LogicalTapeSet *tapeset;	/* logtape.c object for tapes in a temp file */
-#ifdef PGXC
-	ResponseCombiner *combiner; /* tuple source, alternate to tapeset */
-#endif /* PGXC */
 
 	/*
 	 * These function pointers decouple the routines that must know what kind
@@ -466,6 +462,12 @@ struct Tuplesortstate
 	 */
 	SortSupport onlyKey;
 
+	/*
+	 * Length in bytes of onlyKey's integer type if it can be radix sorted, or
+	 * zero; see tuplesort_sort_memtuples().
+	 */
+	int			radixKeyLen;
+
 	/*
 	 * Additional state for managing "abbreviated key" sortsupport routines
 	 * (which currently may be used by all cases except the hash index case).
@@ -618,6 +620,8 @@ static void dumpbatch(Tuplesortstate *state, bool alltuples);
 static void make_bounded_heap(Tuplesortstate *state);
 static void sort_bounded_heap(Tuplesortstate *state);
 static void tuplesort_sort_memtuples(Tuplesortstate *state);
+static void set_radix_key(Tuplesortstate *state, Oid sortOperator);
+static bool radix_sort_memtuples(Tuplesortstate *state);
 static void tuplesort_heap_insert(Tuplesortstate *state, SortTuple *tuple,
 					  bool checkIndex);
 static void tuplesort_heap_replace_top(Tuplesortstate *state, SortTuple *tuple,
@@ -634,12 +638,6 @@ static void writetup_heap(Tuplesortstate *state, int tapenum,
 			  SortTuple *stup);
 static void readtup_heap(Tuplesortstate *state, SortTuple *stup,
 			 int tapenum, unsigned int len);
-#ifdef PGXC
-static unsigned int getlen_datanode(Tuplesortstate *state, int tapenum,
-				bool eofOK);
-static void readtup_datanode(Tuplesortstate *state, SortTuple *stup,
-				 int tapenum, unsigned int len);
-#endif
 static int comparetup_cluster(const SortTuple *a, const SortTuple *b,
 				   Tuplesortstate *state);
 static void copytup_cluster(Tuplesortstate *state, SortTuple *stup, void *tup);
@@ -848,7 +846,10 @@ tuplesort_begin_heap(TupleDesc tupDesc,
 	 * keys are typically only of value to pass-by-reference types.
 	 */
 	if (nkeys == 1 && !state->sortKeys->abbrev_converter)
+	{
 		state->onlyKey = state->sortKeys;
+		set_radix_key(state, sortOperators[0]);
+	}
 
 	MemoryContextSwitchTo(oldcontext);
 
@@ -1143,111 +1144,15 @@ tuplesort_begin_datum(Oid datumType, Oid sortOperator, Oid sortCollation,
 	 * keys are typically only of value to pass-by-reference types.
 	 */
 	if (!state->sortKeys->abbrev_converter)
-		state->onlyKey = state->sortKeys;
-
-	MemoryContextSwitchTo(oldcontext);
-
-	return state;
-}
-
-#ifdef PGXC
-/*
- * Tuples are coming from source where they are already sorted.
- * It is pretty much like sorting heap tuples but no need to load sorter.
- * Sorter initial status is final merge, and correct readtup and getlen
- * callbacks should be passed in.
- * Usage pattern of the merge sorter
- * tuplesort_begin_merge
- * while (tuple = tuplesort_gettuple())
- * {
- *     // process
- * }
- * tuplesort_end_merge
- */
-Tuplesortstate *
-tuplesort_begin_merge(TupleDesc tupDesc,
-					 int nkeys, AttrNumber *attNums,
-					 Oid *sortOperators, Oid *sortCollations, bool *nullsFirstFlags,
-					 ResponseCombiner *combiner,
-					 int workMem)
-{
-	Tuplesortstate *state = tuplesort_begin_common(workMem, false);
-	MemoryContext oldcontext;
-	int			i;
-
-	oldcontext = MemoryContextSwitchTo(state->sortcontext);
-
-	AssertArg(nkeys > 0);
-	AssertArg(combiner);
-
-#ifdef TRACE_SORT
-	if (trace_sort)
-		elog(LOG,
-			 "begin merge sort: nkeys = %d, workMem = %d", nkeys, workMem);
-#endif
-
-	state->nKeys = nkeys;
-
-	TRACE_POSTGRESQL_SORT_START(MERGE_SORT,
-								false,	/* no unique check */
-								nkeys,
-								workMem,
-								false);
-
-	state->combiner = combiner;
-	state->comparetup = comparetup_heap;
-	state->copytup = NULL;
-	state->writetup = NULL;
-	state->readtup = readtup_datanode;
-	state->getlen = getlen_datanode;
-
-	state->tuples = false;
-
-	state->tupDesc = tupDesc;	/* assume we need not copy tupDesc */
-	state->sortKeys = (SortSupport) palloc0(nkeys * sizeof(SortSupportData));
-
-	for (i = 0; i < nkeys; i++)
-	{
-		SortSupport sortKey = state->sortKeys + i;
-
-		AssertArg(attNums[i] != 0);
-		AssertArg(sortOperators[i] != 0);
-
-		sortKey->ssup_cxt = CurrentMemoryContext;
-		sortKey->ssup_collation = sortCollations[i];
-		sortKey->ssup_nulls_first = nullsFirstFlags[i];
-		sortKey->ssup_attno = attNums[i];
-
-		PrepareSortSupportFromOrderingOp(sortOperators[i], sortKey);
-	}
-
-	/*
-	 * logical tape in this case is a sorted stream
-	 */
-	state->maxTapes = combiner->conn_count;
-	state->tapeRange = combiner->conn_count;
-
-	state->mergeactive = (bool *) palloc0(combiner->conn_count * sizeof(bool));
-	state->tp_runs = (int *) palloc0(combiner->conn_count * sizeof(int));
-	state->tp_dummy = (int *) palloc0(combiner->conn_count * sizeof(int));
-	state->tp_tapenum = (int *) palloc0(combiner->conn_count * sizeof(int));
-	/* mark each stream (tape) has one run */
-	for (i = 0; i < combiner->conn_count; i++)
 	{
-		state->tp_runs[i] = 1;
-		state->tp_tapenum[i] = i;
+		state->onlyKey = state->sortKeys;
+		set_radix_key(state, sortOperator);
 	}
 
-	init_slab_allocator(state, 0);
-
-	beginmerge(state);
-	state->status = TSS_FINALMERGE;
-
 	MemoryContextSwitchTo(oldcontext);
 
 	return state;
 }
-#endif
 
 /*
  * tuplesort_set_bound
@@ -2216,14 +2121,8 @@ tuplesort_gettuple_common(Tuplesortstate *state, bool forward,
 					 * Rewind to free the read buffer.  It'd go away at the
 					 * end of the sort anyway, but better to release the
 					 * memory early.
-					 *
-					 * XXX PG10MERGE: In XL, we use tuplesort_begin_merge() to
-					 * merge tuples from datanode connections. We don't use
-					 * tapeset in that code path. The following fix helps that
-					 * case.
 					 */
-					if (state->tapeset)
-						LogicalTapeRewindForWrite(state->tapeset, srcTape);
+					LogicalTapeRewindForWrite(state->tapeset, srcTape);
 					return true;
 				}
 				newtup.tupindex = srcTape;
@@ -3556,8 +3455,14 @@ tuplesort_sort_memtuples(Tuplesortstate *state)
 	{
 		/* Can we use the single-key sort function? */
 		if (state->onlyKey != NULL)
+		{
+			/* Or better still, a radix sort of an integer key? */
+			if (state->radixKeyLen > 0 && radix_sort_memtuples(state))
+				return;
+
 			qsort_ssup(state->memtuples, state->memtupcount,
 					   state->onlyKey);
+		}
 		else
 			qsort_tuple(state->memtuples,
 						state->memtupcount,
@@ -3566,6 +3471,171 @@ tuplesort_sort_memtuples(Tuplesortstate *state)
 	}
 }
 
+/*
+ * Below this many tuples, quicksort is faster than a radix sort, which has
+ * to make several passes over the data and clear its counters.
+ */
+#define RADIX_SORT_MIN_TUPLES	1024
+
+/*
+ * Note whether the single sort key of a MinimalTuple or Datum sort is one
+ * radix_sort_memtuples() can handle: a pass-by-value integer type in the
+ * standard btree order, as is common for distribution and join keys.
+ */
+static void
+set_radix_key(Tuplesortstate *state, Oid sortOperator)
+{
+	Oid			opfamily;
+	Oid			opcintype;
+	int16		strategy;
+
+	state->radixKeyLen = 0;
+
+	if (!get_ordering_op_properties(sortOperator,
+									&opfamily, &opcintype, &strategy) ||
+		opfamily != INTEGER_BTREE_FAM_OID)
+		return;
+
+	switch (opcintype)
+	{
+		case INT2OID:
+			state->radixKeyLen = sizeof(int16);
+			break;
+		case INT4OID:
+			state->radixKeyLen = sizeof(int32);
+			break;
+#ifdef USE_FLOAT8_BYVAL
+		case INT8OID:
+			state->radixKeyLen = sizeof(int64);
+			break;
+#endif
+		default:
+			break;
+	}
+}
+
+/*
+ * Sort memtuples on their integer datum1 with an LSD radix sort, one byte
+ * per pass, instead of calling the comparator O(n log n) times.  Passes on
+ * bytes that are the same in all keys are skipped, so small values cost few
+ * passes.  NULLs are first moved to the end they sort at.
+ *
+ * The sort needs a second array as large as the tuples being sorted.  If
+ * that would exceed the remaining memory budget, or there are too few
+ * tuples to be worth it, return false and let the caller quicksort.
+ */
+static bool
+radix_sort_memtuples(Tuplesortstate *state)
+{
+	SortSupport ssup = state->onlyKey;
+	int			keylen = state->radixKeyLen;
+	uint64		signbit = UINT64CONST(1) << (keylen * BITS_PER_BYTE - 1);
+	uint64		keymask = (keylen == sizeof(int64)) ? ~UINT64CONST(0) :
+	((UINT64CONST(1) << (keylen * BITS_PER_BYTE)) - 1);
+	SortTuple  *tuples = state->memtuples;
+	SortTuple  *src;
+	SortTuple  *dst;
+	SortTuple  *buf;
+	int			lo = 0;
+	int			hi = state->memtupcount;
+	int			nnotnull;
+	int			pass;
+	int			i;
+	int			counts[sizeof(int64)][256];
+
+	if (state->memtupcount < RADIX_SORT_MIN_TUPLES ||
+		state->availMem < (int64) (state->memtupcount * sizeof(SortTuple)))
+		return false;
+
+	/* Move NULLs out of the way; they all compare equal */
+	i = 0;
+	while (i < hi)
+	{
+		if (tuples[i].isnull1)
+		{
+			SortTuple	tmp = tuples[i];
+
+			if (ssup->ssup_nulls_first)
+			{
+				tuples[i++] = tuples[lo];
+				tuples[lo++] = tmp;
+			}
+			else
+			{
+				tuples[i] = tuples[--hi];
+				tuples[hi] = tmp;
+			}
+		}
+		else
+			i++;
+	}
+
+	nnotnull = hi - lo;
+	if (nnotnull < 2)
+		return true;
+
+/*
+ * Map a key to an unsigned value in the same order: flip the sign bit, and
+ * invert everything for a descending sort.  Narrower integers are stored
+ * sign-extended in the Datum, so their low keylen bytes are what counts.
+ */
+#define RADIX_KEY(stup) \
+	((((uint64) (stup)->datum1 ^ signbit) & keymask) ^ \
+	 (ssup->ssup_reverse ? keymask : 0))
+
+	/* The values of all bytes can be counted in a single pass */
+	memset(counts, 0, sizeof(counts));
+	for (i = lo; i < hi; i++)
+	{
+		uint64		key = RADIX_KEY(&tuples[i]);
+
+		for (pass = 0; pass < keylen; pass++)
+			counts[pass][(key >> (pass * BITS_PER_BYTE)) & 0xFF]++;
+	}
+
+	buf = (SortTuple *) MemoryContextAllocHuge(state->sortcontext,
+											   nnotnull * sizeof(SortTuple));
+	src = tuples + lo;
+	dst = buf;
+
+	for (pass = 0; pass < keylen; pass++)
+	{
+		int		   *count = counts[pass];
+		int			shift = pass * BITS_PER_BYTE;
+		int			offset = 0;
+		int			b;
+		SortTuple  *tmp;
+
+		/* Skip the pass if every key has the same value here */
+		if (count[(RADIX_KEY(&src[0]) >> shift) & 0xFF] == nnotnull)
+			continue;
+
+		/* Turn the counts into starting offsets */
+		for (b = 0; b < 256; b++)
+		{
+			int			n = count[b];
+
+			count[b] = offset;
+			offset += n;
+		}
+
+		for (i = 0; i < nnotnull; i++)
+			dst[count[(RADIX_KEY(&src[i]) >> shift) & 0xFF]++] = src[i];
+
+		tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+#undef RADIX_KEY
+
+	if (src != tuples + lo)
+		memcpy(tuples + lo, src, nnotnull * sizeof(SortTuple));
+	pfree(buf);
+
+	return true;
+}
+
 /*
  * Insert a new tuple into an empty or existing heap, maintaining the
  * heap invariant.  Caller is responsible for ensuring there's room.
@@ -3946,54 +4016,6 @@ readtup_heap(Tuplesortstate *state, SortTuple *stup,
 								&stup->isnull1);
 }
 
-#ifdef PGXC
-static unsigned int
-getlen_datanode(Tuplesortstate *state, int tapenum, bool eofOK)
-{
-	ResponseCombiner *combiner = state->combiner;
-	TupleTableSlot   *dstslot = combiner->ss.ps.ps_ResultTupleSlot;
-	TupleTableSlot   *slot;
-
-	combiner->current_conn = tapenum;
-	slot = FetchTuple(combiner);
-	if (TupIsNull(slot))
-	{
-		if (eofOK)
-			return 0;
-		else
-			elog(ERROR, "unexpected end of data");
-	}
-
-	if (slot != dstslot)
-		ExecCopySlot(dstslot, slot);
-
-	return 1;
-}
-
-static void
-readtup_datanode(Tuplesortstate *state, SortTuple *stup,
-				 int tapenum, unsigned int len)
-{
-	TupleTableSlot *slot = state->combiner->ss.ps.ps_ResultTupleSlot;
-	MinimalTuple tuple;
-	HeapTupleData htup;
-
-	Assert(!TupIsNull(slot));
-
-	/* copy the tuple into sort storage */
-	tuple = ExecCopySlotMinimalTuple(slot);
-	stup->tuple = (void *) tuple;
-	USEMEM(state, GetMemoryChunkSpace(tuple));
-	/* set up first-column key value */
-	htup.t_len = tuple->t_len + MINIMAL_TUPLE_OFFSET;
-	htup.t_data = (HeapTupleHeader) ((char *) tuple - MINIMAL_TUPLE_OFFSET);
-	stup->datum1 = heap_getattr(&htup,
-								state->sortKeys[0].ssup_attno,
-								state->tupDesc,
-								&stup->isnull1);
-}
-#endif /* PGXC */
-
 /*
  * Routines specialized for the CLUSTER case (HeapTuple data, with
  * comparisons per a btree index definition)
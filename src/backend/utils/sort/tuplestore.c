@@ -1715,6 +1715,60 @@ tuplestore_begin_datarow(bool interXact, int maxKBytes,
 }
 
 
+/*
+ * Append a copy of the datarow to the store
+ */
+void
+tuplestore_putdatarow(Tuplestorestate *state, RemoteDataRow datarow)
+{
+	RemoteDataRow tuple;
+	MemoryContext oldcxt = MemoryContextSwitchTo(state->context);
+
+	Assert(state->format == TSF_DATAROW);
+
+	tuple = (RemoteDataRow) palloc(sizeof(RemoteDataRowData) + datarow->msglen);
+	tuple->msgnode = datarow->msgnode;
+	tuple->msglen = datarow->msglen;
+	memcpy(tuple->msg, datarow->msg, datarow->msglen);
+	USEMEM(state, GetMemoryChunkSpace(tuple));
+
+	tuplestore_puttuple_common(state, (void *) tuple);
+
+	MemoryContextSwitchTo(oldcxt);
+}
+
+
+/*
+ * Fetch next datarow from the store, NULL if no more.
+ * Returned datarow is always palloc'd in the current memory context and
+ * belongs to the caller.
+ */
+RemoteDataRow
+tuplestore_getdatarow(Tuplestorestate *state)
+{
+	bool		should_free;
+	RemoteDataRow datarow;
+	RemoteDataRow result;
+
+	Assert(state->format == TSF_DATAROW);
+
+	datarow = (RemoteDataRow) tuplestore_gettuple(state, true, &should_free);
+
+	/* done? */
+	if (!datarow)
+		return NULL;
+
+	result = (RemoteDataRow) palloc(sizeof(RemoteDataRowData) + datarow->msglen);
+	result->msgnode = datarow->msgnode;
+	result->msglen = datarow->msglen;
+	memcpy(result->msg, datarow->msg, datarow->msglen);
+	if (should_free)
+		pfree(datarow);
+
+	return result;
+}
+
+
 /*
  * Do we need this at all?
  */
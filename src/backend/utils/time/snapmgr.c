@@ -69,6 +69,7 @@
 #include "utils/syscache.h"
 #include "utils/tqual.h"
 #ifdef PGXC
+#include "pgxc/barrier.h"
 #include "pgxc/pgxc.h"
 #endif
 
@@ -245,6 +246,9 @@ typedef struct SerializedSnapshotData
 	int32		subxcnt;
 	bool		suboverflowed;
 	bool		takenDuringRecovery;
+#ifdef XCP
+	bool		xip_sorted;
+#endif
 	CommandId	curcid;
 	TimestampTz whenTaken;
 	XLogRecPtr	lsn;
@@ -318,6 +322,12 @@ GetTransactionSnapshot(void)
 		return HistoricSnapshot;
 	}
 
+#ifdef PGXC
+	/* A hot standby serving a Coordinator must have replayed its barrier */
+	if (StandbyReadBarrier[0] != '\0' && RecoveryInProgress())
+		StandbyWaitForBarrier();
+#endif
+
 	/* First call in transaction? */
 	if (!FirstSnapshotSet)
 	{
@@ -394,6 +404,16 @@ GetTransactionSnapshot(void)
 	/* Don't allow catalog snapshot to be older than xact snapshot. */
 	InvalidateCatalogSnapshot();
 
+#ifdef PGXC
+	/* A recent snapshot may do, if the user allows */
+	if (GetStaleGlobalSnapshot(&CurrentSnapshotData))
+	{
+		CurrentSnapshotData.snapXactCompletionCount = 0;
+		CurrentSnapshot = &CurrentSnapshotData;
+		return CurrentSnapshot;
+	}
+#endif
+
 	CurrentSnapshot = GetSnapshotData(&CurrentSnapshotData, false);
 
 	return CurrentSnapshot;
@@ -629,8 +649,14 @@ SetTransactionSnapshot(Snapshot sourcesnap, VirtualTransactionId *sourcevxid,
 		   sourcesnap->subxcnt * sizeof(TransactionId));
 	CurrentSnapshot->suboverflowed = sourcesnap->suboverflowed;
 	CurrentSnapshot->takenDuringRecovery = sourcesnap->takenDuringRecovery;
+#ifdef XCP
+	CurrentSnapshot->xip_sorted = sourcesnap->xip_sorted;
+#endif
 	/* NB: curcid should NOT be copied, it's a local matter */
 
+	/* The contents are no longer what GetSnapshotData computed */
+	CurrentSnapshot->snapXactCompletionCount = 0;
+
 	/*
 	 * Now we have to fix what GetSnapshotData did with MyPgXact->xmin and
 	 * TransactionXmin.  There is a race condition: to make sure we are not
@@ -1591,6 +1617,9 @@ ImportSnapshot(const char *idstr)
 	}
 
 	snapshot.takenDuringRecovery = parseIntFromText("rec:", &filebuf, path);
+#ifdef XCP
+	snapshot.xip_sorted = false;
+#endif
 
 	/*
 	 * Do some additional sanity checking, just to protect ourselves.  We
@@ -2118,6 +2147,9 @@ SerializeSnapshot(Snapshot snapshot, char *start_address)
 	serialized_snapshot.subxcnt = snapshot->subxcnt;
 	serialized_snapshot.suboverflowed = snapshot->suboverflowed;
 	serialized_snapshot.takenDuringRecovery = snapshot->takenDuringRecovery;
+#ifdef XCP
+	serialized_snapshot.xip_sorted = snapshot->xip_sorted;
+#endif
 	serialized_snapshot.curcid = snapshot->curcid;
 	serialized_snapshot.whenTaken = snapshot->whenTaken;
 	serialized_snapshot.lsn = snapshot->lsn;
@@ -2192,6 +2224,9 @@ RestoreSnapshot(char *start_address)
 	snapshot->subxcnt = serialized_snapshot.subxcnt;
 	snapshot->suboverflowed = serialized_snapshot.suboverflowed;
 	snapshot->takenDuringRecovery = serialized_snapshot.takenDuringRecovery;
+#ifdef XCP
+	snapshot->xip_sorted = serialized_snapshot.xip_sorted;
+#endif
 	snapshot->curcid = serialized_snapshot.curcid;
 	snapshot->whenTaken = serialized_snapshot.whenTaken;
 	snapshot->lsn = serialized_snapshot.lsn;
@@ -1070,6 +1070,15 @@ HeapTupleSatisfiesMVCC(HeapTuple htup, Snapshot snapshot,
 		else if (TransactionIdDidCommit(HeapTupleHeaderGetRawXmin(tuple)))
 			SetHintBits(tuple, buffer, HEAP_XMIN_COMMITTED,
 						HeapTupleHeaderGetRawXmin(tuple));
+#ifdef PGXC
+		/*
+		 * With async_commit_prepared the transaction may be committed on GTM
+		 * while still prepared here, waiting for COMMIT PREPARED. Treat it as
+		 * in progress and do not set the hint bit.
+		 */
+		else if (TransactionIdIsInProgress(HeapTupleHeaderGetRawXmin(tuple)))
+			return false;
+#endif
 		else
 		{
 			/* it must have aborted or crashed */
@@ -1136,6 +1145,11 @@ HeapTupleSatisfiesMVCC(HeapTuple htup, Snapshot snapshot,
 
 		if (!TransactionIdDidCommit(HeapTupleHeaderGetRawXmax(tuple)))
 		{
+#ifdef PGXC
+			/* Committed on GTM but still prepared here, see above */
+			if (TransactionIdIsInProgress(HeapTupleHeaderGetRawXmax(tuple)))
+				return true;
+#endif
 			/* it must have aborted or crashed */
 			SetHintBits(tuple, buffer, HEAP_XMAX_INVALID,
 						InvalidTransactionId);
@@ -1534,6 +1548,16 @@ XidInMVCCSnapshot(TransactionId xid, Snapshot snapshot)
 				return false;
 		}
 
+#ifdef XCP
+		/*
+		 * Global snapshots may list every transaction running in the cluster,
+		 * they are sorted so that the check does not grow with their size.
+		 */
+		if (snapshot->xip_sorted)
+			return bsearch(&xid, snapshot->xip, snapshot->xcnt,
+						   sizeof(TransactionId), xidComparator) != NULL;
+#endif
+
 		for (i = 0; i < snapshot->xcnt; i++)
 		{
 			if (TransactionIdEquals(xid, snapshot->xip[i]))
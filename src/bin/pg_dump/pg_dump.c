@@ -15519,6 +15519,12 @@ dumpTableSchema(Archive *fout, TableInfo *tbinfo)
 					appendPQExpBuffer(q, "\nDISTRIBUTE BY MODULO (%s)",
 									  fmtId(tbinfo->attnames[hashkey - 1]));
 				}
+				else if (tbinfo->pgxclocatortype == 'B')
+				{
+					int hashkey = tbinfo->pgxcattnum;
+					appendPQExpBuffer(q, "\nDISTRIBUTE BY BUCKET (%s)",
+									  fmtId(tbinfo->attnames[hashkey - 1]));
+				}
 			}
 			if (include_nodes &&
 				tbinfo->pgxc_node_names != NULL &&
@@ -2219,7 +2219,8 @@ dumpNodes(PGconn *conn)
 					" || ' , HOST = ' || chr(39) || node_host || chr(39)"
 					" || ', PORT = ' || node_port || (case when nodeis_primary='t'"
 					" then ', PRIMARY' else ' ' end) || (case when nodeis_preferred"
-					" then ', PREFERRED' else ' ' end) || ');' "
+					" then ', PREFERRED' else ' ' end) || (case when node_zone <> ''"
+					" then ', ZONE = ' || chr(39) || node_zone || chr(39) else ' ' end) || ');' "
 					" as node_query from pg_catalog.pgxc_node order by oid");
 
 	res = executeQuery(conn, query->data);
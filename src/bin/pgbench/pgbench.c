@@ -157,6 +157,19 @@ char	   *index_tablespace = NULL;
 
 #ifdef PGXC
 bool		use_branch = false;	/* use branch id in DDL and DML */
+
+/* distribution of the tables, set by --distribute */
+typedef enum
+{
+	DISTRIBUTE_DEFAULT,			/* by bid with -k, else left to the server */
+	DISTRIBUTE_HASH,
+	DISTRIBUTE_REPLICATION,
+	DISTRIBUTE_ROUNDROBIN
+} DistributeType;
+
+DistributeType distribute = DISTRIBUTE_DEFAULT;
+
+bool		report_2pc = false;	/* report the share of implicit 2PC */
 #endif
 /*
  * The scale factor at/beyond which 32bit integers are incapable of storing
@@ -354,6 +367,9 @@ typedef struct
 	instr_time	conn_time;
 	StatsData	stats;
 	int64		latency_late;	/* executed but late transactions */
+#ifdef PGXC
+	int64		implicit_2pc;	/* transactions committed with implicit 2PC */
+#endif
 } TState;
 
 #define INVALID_THREAD		((pthread_t) 0)
@@ -489,6 +505,77 @@ static const BuiltinScript builtin_script[] =
 		"\\set bid random(1, " CppAsString2(nbranches) " * :scale)\n"
 		"SELECT abalance FROM pgbench_accounts WHERE aid = :aid AND bid = :bid;\n",
 		true
+	},
+
+	/*
+	 * Workloads exercising the distributed execution paths: a transaction
+	 * touching a single Datanode, one moving money between two accounts
+	 * which usually live on different Datanodes and thus needs an implicit
+	 * two-phase commit, and a join which cannot be pushed down and makes the
+	 * Datanodes redistribute rows among themselves.
+	 */
+	{
+		"xl-single-shard",
+		"<builtin: single-shard update>",
+		"\\set aid random(1, " CppAsString2(naccounts) " * :scale)\n"
+		"\\set delta random(-5000, 5000)\n"
+		"BEGIN;\n"
+		"UPDATE pgbench_accounts SET abalance = abalance + :delta WHERE aid = :aid;\n"
+		"SELECT abalance FROM pgbench_accounts WHERE aid = :aid;\n"
+		"END;\n",
+		false
+	},
+	{
+		"xl-multi-shard",
+		"<builtin: multi-shard transfer>",
+		"\\set aid1 random(1, " CppAsString2(naccounts) " * :scale)\n"
+		"\\set aid2 random(1, " CppAsString2(naccounts) " * :scale)\n"
+		"\\set delta random(-5000, 5000)\n"
+		"BEGIN;\n"
+		"UPDATE pgbench_accounts SET abalance = abalance - :delta WHERE aid = :aid1;\n"
+		"UPDATE pgbench_accounts SET abalance = abalance + :delta WHERE aid = :aid2;\n"
+		"END;\n",
+		false
+	},
+	{
+		"xl-redistribute-join",
+		"<builtin: join needing redistribution>",
+		"\\set aid random(1, " CppAsString2(naccounts) " * :scale - 99)\n"
+		"SELECT count(*), sum(a.abalance) FROM pgbench_accounts a JOIN pgbench_tellers t ON t.tbalance = a.abalance WHERE a.aid BETWEEN :aid AND :aid + 99;\n",
+		false
+	},
+	{
+		"xl-single-shard",
+		"<builtin: single-shard update bid>",
+		"\\set aid random(1, " CppAsString2(naccounts) " * :scale)\n"
+		"\\set bid (:aid - 1) / " CppAsString2(naccounts) " + 1\n"
+		"\\set delta random(-5000, 5000)\n"
+		"BEGIN;\n"
+		"UPDATE pgbench_accounts SET abalance = abalance + :delta WHERE aid = :aid AND bid = :bid;\n"
+		"SELECT abalance FROM pgbench_accounts WHERE aid = :aid AND bid = :bid;\n"
+		"END;\n",
+		true
+	},
+	{
+		"xl-multi-shard",
+		"<builtin: multi-shard transfer bid>",
+		"\\set aid1 random(1, " CppAsString2(naccounts) " * :scale)\n"
+		"\\set bid1 (:aid1 - 1) / " CppAsString2(naccounts) " + 1\n"
+		"\\set aid2 random(1, " CppAsString2(naccounts) " * :scale)\n"
+		"\\set bid2 (:aid2 - 1) / " CppAsString2(naccounts) " + 1\n"
+		"\\set delta random(-5000, 5000)\n"
+		"BEGIN;\n"
+		"UPDATE pgbench_accounts SET abalance = abalance - :delta WHERE aid = :aid1 AND bid = :bid1;\n"
+		"UPDATE pgbench_accounts SET abalance = abalance + :delta WHERE aid = :aid2 AND bid = :bid2;\n"
+		"END;\n",
+		true
+	},
+	{
+		"xl-redistribute-join",
+		"<builtin: join needing redistribution>",
+		"\\set aid random(1, " CppAsString2(naccounts) " * :scale - 99)\n"
+		"SELECT count(*), sum(a.abalance) FROM pgbench_accounts a JOIN pgbench_tellers t ON t.tbalance = a.abalance WHERE a.aid BETWEEN :aid AND :aid + 99;\n",
+		true
 	}
 };
 
@@ -505,6 +592,9 @@ static void pgbench_error(const char *fmt,...) pg_attribute_printf(1, 2);
 static void addScript(ParsedScript script);
 static void *threadRun(void *arg);
 static void setalarm(int seconds);
+#ifdef PGXC
+static void collectImplicit2PC(TState *thread, CState *st);
+#endif
 
 
 /* callback functions for our flex lexer */
@@ -529,6 +619,10 @@ usage(void)
 		   "  -n, --no-vacuum          do not run VACUUM after initialization\n"
 		   "  -q, --quiet              quiet logging (one message each 5 seconds)\n"
 		   "  -s, --scale=NUM          scaling factor\n"
+#ifdef PGXC
+		   "  --distribute=hash|replication|roundrobin\n"
+		   "                           distribution of the tables\n"
+#endif
 		   "  --foreign-keys           create foreign key constraints between tables\n"
 		   "  --index-tablespace=TABLESPACE\n"
 		   "                           create indexes in the specified tablespace\n"
@@ -567,6 +661,9 @@ usage(void)
 		   "  --log-prefix=PREFIX      prefix for transaction time log file\n"
 		   "                           (default: \"pgbench_log\")\n"
 		   "  --progress-timestamp     use Unix epoch timestamps for progress\n"
+#ifdef PGXC
+		   "  --report-2pc             report transactions committed with implicit 2PC\n"
+#endif
 		   "  --sampling-rate=NUM      fraction of transactions to log (e.g., 0.01 for 1%%)\n"
 		   "\nCommon options:\n"
 		   "  -d, --debug              print debugging output\n"
@@ -2429,6 +2526,9 @@ doCustom(TState *thread, CState *st, StatsData *agg)
 
 				if (is_connect)
 				{
+#ifdef PGXC
+					collectImplicit2PC(thread, st);
+#endif
 					PQfinish(st->con);
 					st->con = NULL;
 					INSTR_TIME_SET_ZERO(now);
@@ -2470,6 +2570,9 @@ doCustom(TState *thread, CState *st, StatsData *agg)
 			case CSTATE_FINISHED:
 				if (st->con != NULL)
 				{
+#ifdef PGXC
+					collectImplicit2PC(thread, st);
+#endif
 					PQfinish(st->con);
 					st->con = NULL;
 				}
@@ -2603,6 +2706,34 @@ processXactStats(TState *thread, CState *st, instr_time *now,
 }
 
 
+#ifdef PGXC
+/*
+ * Add the number of transactions the backend of a client committed using an
+ * implicit two-phase commit to the counter of its thread.  To be called right
+ * before the connection is closed, as the counter is per session.
+ */
+static void
+collectImplicit2PC(TState *thread, CState *st)
+{
+	PGresult   *res;
+
+	if (!report_2pc || st->con == NULL ||
+		PQtransactionStatus(st->con) != PQTRANS_IDLE)
+		return;
+
+	res = PQexec(st->con, "SELECT pgxc_implicit_2pc_count()");
+	if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 1)
+		thread->implicit_2pc += strtoint64(PQgetvalue(res, 0, 0));
+	else
+	{
+		fprintf(stderr, "could not get implicit 2PC count: %s",
+				PQerrorMessage(st->con));
+		report_2pc = false;
+	}
+	PQclear(res);
+}
+#endif
+
 /* discard connections */
 static void
 disconnect_all(CState *state, int length)
@@ -2650,7 +2781,8 @@ init(bool is_no_vacuum)
 		const char *bigcols;	/* column decls if accountIDs are 64 bits */
 		int			declare_fillfactor;
 #ifdef PGXC
-		char	   *distribute_by;
+		char	   *distribute_by;	/* clause used with -k */
+		const char *hash_key;	/* column for --distribute=hash without -k */
 #endif
 	};
 	static const struct ddlinfo DDLs[] = {
@@ -2660,7 +2792,7 @@ init(bool is_no_vacuum)
 			"tid int,bid int,aid bigint,delta int,mtime timestamp,filler char(22)",
 			0
 #ifdef PGXC
-			, "distribute by hash (bid)"
+			, "distribute by hash (bid)", "aid"
 #endif
 		},
 		{
@@ -2669,7 +2801,7 @@ init(bool is_no_vacuum)
 			"tid int not null,bid int,tbalance int,filler char(84)",
 			1
 #ifdef PGXC
-			, "distribute by hash (bid)"
+			, "distribute by hash (bid)", "tid"
 #endif
 		},
 		{
@@ -2678,7 +2810,7 @@ init(bool is_no_vacuum)
 			"aid bigint not null,bid int,abalance int,filler char(84)",
 			1
 #ifdef PGXC
-			, "distribute by hash (bid)"
+			, "distribute by hash (bid)", "aid"
 #endif
 		},
 		{
@@ -2687,7 +2819,7 @@ init(bool is_no_vacuum)
 			"bid int not null,bbalance int,filler char(88)",
 			1
 #ifdef PGXC
-			, "distribute by hash (bid)"
+			, "distribute by hash (bid)", "bid"
 #endif
 		}
 	};
@@ -2710,6 +2842,13 @@ init(bool is_no_vacuum)
 		"alter table pgbench_tellers add primary key (tid,bid)",
 		"alter table pgbench_accounts add primary key (aid,bid)"
 	};
+
+	/* Unique indexes cannot be enforced on roundrobin tables */
+	static const char *const DDLINDEXes_roundrobin[] = {
+		"create index pgbench_branches_bid_idx on pgbench_branches (bid)",
+		"create index pgbench_tellers_tid_idx on pgbench_tellers (tid)",
+		"create index pgbench_accounts_aid_idx on pgbench_accounts (aid)"
+	};
 #endif
 
 	PGconn	   *con;
@@ -2759,7 +2898,20 @@ init(bool is_no_vacuum)
 
 #ifdef PGXC
 		/* Add distribution columns if necessary */
-		if (use_branch)
+		if (distribute == DISTRIBUTE_HASH && !use_branch)
+			snprintf(buffer, sizeof(buffer),
+					 "create%s table %s(%s)%s distribute by hash (%s)",
+					 unlogged_tables ? " unlogged" : "",
+					 ddl->table, cols, opts, ddl->hash_key);
+		else if (distribute == DISTRIBUTE_REPLICATION ||
+				 distribute == DISTRIBUTE_ROUNDROBIN)
+			snprintf(buffer, sizeof(buffer),
+					 "create%s table %s(%s)%s distribute by %s",
+					 unlogged_tables ? " unlogged" : "",
+					 ddl->table, cols, opts,
+					 distribute == DISTRIBUTE_REPLICATION ?
+					 "replication" : "roundrobin");
+		else if (use_branch)
 			snprintf(buffer, sizeof(buffer), "create%s table %s(%s)%s %s",
 					 unlogged_tables ? " unlogged" : "",
 					 ddl->table, cols, opts, ddl->distribute_by);
@@ -2896,7 +3048,29 @@ init(bool is_no_vacuum)
 	 * If all the tables are distributed according to bid, create an index on it
 	 * instead.
 	 */
-	if (use_branch)
+	if (distribute == DISTRIBUTE_ROUNDROBIN)
+	{
+		for (i = 0; i < lengthof(DDLINDEXes_roundrobin); i++)
+		{
+			char		buffer[256];
+
+			strlcpy(buffer, DDLINDEXes_roundrobin[i], sizeof(buffer));
+
+			if (index_tablespace != NULL)
+			{
+				char	   *escape_tablespace;
+
+				escape_tablespace = PQescapeIdentifier(con, index_tablespace,
+												   strlen(index_tablespace));
+				snprintf(buffer + strlen(buffer), sizeof(buffer) - strlen(buffer),
+						 " tablespace %s", escape_tablespace);
+				PQfreemem(escape_tablespace);
+			}
+
+			executeStatement(con, buffer);
+		}
+	}
+	else if (use_branch)
 	{
 		for (i = 0; i < lengthof(DDLAFTERs_bid); i++)
 		{
@@ -3669,6 +3843,21 @@ printResults(TState *threads, StatsData *total, instr_time total_time,
 	printf("tps = %f (including connections establishing)\n", tps_include);
 	printf("tps = %f (excluding connections establishing)\n", tps_exclude);
 
+#ifdef PGXC
+	if (report_2pc)
+	{
+		int64		implicit_2pc = 0;
+		int			i;
+
+		for (i = 0; i < nthreads; i++)
+			implicit_2pc += threads[i].implicit_2pc;
+
+		printf("number of transactions using implicit 2PC: " INT64_FORMAT " (%.3f%%)\n",
+			   implicit_2pc,
+			   total->cnt > 0 ? 100.0 * implicit_2pc / total->cnt : 0.0);
+	}
+#endif
+
 	/* Report per-script/command statistics */
 	if (per_script_stats || latency_limit || is_latencies)
 	{
@@ -3758,6 +3947,10 @@ main(int argc, char **argv)
 		{"aggregate-interval", required_argument, NULL, 5},
 		{"progress-timestamp", no_argument, NULL, 6},
 		{"log-prefix", required_argument, NULL, 7},
+#ifdef PGXC
+		{"distribute", required_argument, NULL, 8},
+		{"report-2pc", no_argument, NULL, 9},
+#endif
 		{NULL, 0, NULL, 0}
 	};
 
@@ -4120,6 +4313,26 @@ main(int argc, char **argv)
 				benchmarking_option_set = true;
 				logfile_prefix = pg_strdup(optarg);
 				break;
+#ifdef PGXC
+			case 8:				/* distribute */
+				initialization_option_set = true;
+				if (pg_strcasecmp(optarg, "hash") == 0)
+					distribute = DISTRIBUTE_HASH;
+				else if (pg_strcasecmp(optarg, "replication") == 0)
+					distribute = DISTRIBUTE_REPLICATION;
+				else if (pg_strcasecmp(optarg, "roundrobin") == 0)
+					distribute = DISTRIBUTE_ROUNDROBIN;
+				else
+				{
+					fprintf(stderr, "invalid distribution: \"%s\"\n", optarg);
+					exit(1);
+				}
+				break;
+			case 9:				/* report-2pc */
+				benchmarking_option_set = true;
+				report_2pc = true;
+				break;
+#endif
 			default:
 				fprintf(stderr, _("Try \"%s --help\" for more information.\n"), progname);
 				exit(1);
@@ -4136,7 +4349,16 @@ main(int argc, char **argv)
 
 	/* process the collected scripts */
 	for (i = 0; i < nscripts; i++)
-		process_builtin(findBuiltin(scripts[i], use_branch), weights[i]);
+	{
+		const BuiltinScript *bi = findBuiltin(scripts[i], use_branch);
+
+#ifdef PGXC
+		/* the distributed workloads are about the cost of 2PC */
+		if (strncmp(bi->name, "xl-", 3) == 0)
+			report_2pc = true;
+#endif
+		process_builtin(bi, weights[i]);
+	}
 
 	/* set default script if none */
 	if (num_scripts == 0 && !is_init_mode)
@@ -4422,6 +4644,9 @@ main(int argc, char **argv)
 		thread->random_state[2] = random();
 		thread->logfile = NULL; /* filled in later */
 		thread->latency_late = 0;
+#ifdef PGXC
+		thread->implicit_2pc = 0;
+#endif
 		initStats(&thread->stats, 0);
 
 		nclients_dealt += thread->nstate;
@@ -4613,6 +4838,9 @@ threadRun(void *arg)
 			{
 				/* interrupt client that has not started a transaction */
 				st->state = CSTATE_FINISHED;
+#ifdef PGXC
+				collectImplicit2PC(thread, st);
+#endif
 				PQfinish(st->con);
 				st->con = NULL;
 				remains--;
@@ -4856,6 +5084,10 @@ threadRun(void *arg)
 
 done:
 	INSTR_TIME_SET_CURRENT(start);
+#ifdef PGXC
+	for (i = 0; i < nstate; i++)
+		collectImplicit2PC(thread, &state[i]);
+#endif
 	disconnect_all(state, nstate);
 	INSTR_TIME_SET_CURRENT(end);
 	INSTR_TIME_ACCUM_DIFF(thread->conn_time, end, start);
@@ -31,6 +31,7 @@
 #define LOCATOR_TYPE_HASH 'H'
 #define LOCATOR_TYPE_RROBIN 'N'
 #define LOCATOR_TYPE_MODULO 'M'
+#define LOCATOR_TYPE_BUCKET 'B'
 #endif /* PGXC */
 
 static bool describeOneTableDetails(const char *schemaname,
@@ -2950,7 +2951,8 @@ describeOneTableDetails(const char *schemaname,
 							"WHEN '%c' THEN 'ROUND ROBIN' \n"
 							"WHEN '%c' THEN 'REPLICATION' \n"
 							"WHEN '%c' THEN 'HASH' \n"
-							"WHEN '%c' THEN 'MODULO' END || CASE pcattnum WHEN 0 THEN '' ELSE '('|| a.attname ||')' END as distype \n"
+							"WHEN '%c' THEN 'MODULO' \n"
+							"WHEN '%c' THEN 'BUCKET' END || CASE pcattnum WHEN 0 THEN '' ELSE '('|| a.attname ||')' END as distype \n"
 							", CASE array_length(nodeoids, 1) \n"
 								"WHEN nc.dn_cn THEN 'ALL DATANODES' \n"
 								"ELSE array_to_string(ARRAY( \n"
@@ -2964,6 +2966,7 @@ describeOneTableDetails(const char *schemaname,
 					, LOCATOR_TYPE_REPLICATED
 					, LOCATOR_TYPE_HASH
 					, LOCATOR_TYPE_MODULO
+					, LOCATOR_TYPE_BUCKET
 					, oid
 					, oid);
 			result = PSQLexec(buf.data);
@@ -734,17 +734,31 @@ pglz_decompress(const char *source, int32 slen, char *dest,
 					break;
 				}
 
+				/*
+				 * An offset of zero or reaching before the start of the
+				 * output can only come from corrupt input, and would make
+				 * the copy below loop forever or read outside the buffer.
+				 */
+				if (off == 0 || off > dp - (unsigned char *) dest)
+					return -1;
+
 				/*
 				 * Now we copy the bytes specified by the tag from OUTPUT to
-				 * OUTPUT. It is dangerous and platform dependent to use
-				 * memcpy() here, because the copied areas could overlap
-				 * extremely!
+				 * OUTPUT.  The areas overlap when the match is longer than
+				 * its offset, so memcpy() can't be used for the whole match
+				 * at once.  But the overlapping part just repeats the last
+				 * off bytes, so copy that in nonoverlapping chunks, each
+				 * twice as long as the previous as the repeated data grows.
 				 */
-				while (len--)
+				while (off < len)
 				{
-					*dp = dp[-off];
-					dp++;
+					memcpy(dp, dp - off, off);
+					len -= off;
+					dp += off;
+					off += off;
 				}
+				memcpy(dp, dp - off, len);
+				dp += len;
 			}
 			else
 			{
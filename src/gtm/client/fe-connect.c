@@ -59,6 +59,7 @@ static const GTMPQconninfoOption GTMPQconninfoOptions[] = {
 	{"remote_type", NULL},
 	{"postmaster", NULL},
 	{"client_id", NULL},
+	{"active_only", NULL},
 	/* Terminating entry --- MUST BE LAST */
 	{NULL, NULL}
 };
@@ -93,6 +94,29 @@ PQconnectGTM(const char *conninfo)
 	return conn;
 }
 
+/*
+ *		PQbufferedConnectGTM
+ *
+ * Returns a GTM_Conn* which is not connected to any server. Messages are
+ * built in it as usual, but each time it is flushed the buffered data is
+ * handed to flush_hook instead of being sent. No result can be received.
+ */
+GTM_Conn *
+PQbufferedConnectGTM(int remote_type, int (*flush_hook)(GTM_Conn *conn))
+{
+	GTM_Conn	   *conn = makeEmptyGTM_Conn();
+
+	if (conn == NULL)
+		return NULL;
+
+	conn->sock = -1;
+	conn->remote_type = remote_type;
+	conn->flush_hook = flush_hook;
+	conn->status = CONNECTION_OK;
+
+	return conn;
+}
+
 /*
  *		PQconnectGTMStart
  *
@@ -184,6 +208,8 @@ connectOptions1(GTM_Conn *conn, const char *conninfo)
 	conn->remote_type = tmp ? atoi(tmp) : GTM_NODE_DEFAULT;
 	tmp = conninfo_getval(connOptions, "client_id");
 	conn->my_id = tmp ? atoi(tmp) : 0;
+	tmp = conninfo_getval(connOptions, "active_only");
+	conn->active_only = tmp ? atoi(tmp) : 0;
 
 	/*
 	 * Free the option info - all is in conn now
@@ -686,6 +712,7 @@ keep_going:						/* We will come back to here until there is
 				strncpy(sp->sp_node_name, conn->gc_node_name, SP_NODE_NAME);
 				sp->sp_remotetype = conn->remote_type;
 				sp->sp_ispostmaster = conn->is_postmaster;
+				sp->sp_active_only = conn->active_only;
 				sp->sp_client_id = conn->my_id;
 
 				/*
@@ -916,6 +943,10 @@ freeGTM_Conn(GTM_Conn *conn)
 		/* Free last snapshot if defined */
 		if (conn->result->gr_snapshot.sn_xip)
 			free(conn->result->gr_snapshot.sn_xip);
+		if (conn->result->gr_delta_xip)
+			free(conn->result->gr_delta_xip);
+		if (conn->result->gr_stats)
+			free(conn->result->gr_stats);
 
 		/* Depending on result type there could be allocated data */
 		switch (conn->result->gr_type)
@@ -1328,6 +1359,14 @@ GTMPQispostmaster(const GTM_Conn *conn)
 	return conn->is_postmaster;
 }
 
+uint32
+GTMPQclientid(const GTM_Conn *conn)
+{
+	if (!conn)
+		return 0;
+	return conn->my_id;
+}
+
 char *
 GTMPQerrorMessage(const GTM_Conn *conn)
 {
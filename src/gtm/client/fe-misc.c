@@ -504,7 +504,7 @@ gtmpqPutMsgEnd(GTM_Conn *conn)
 	/* Make message eligible to send */
 	conn->outCount = conn->outMsgEnd;
 
-	if (conn->outCount >= 8192)
+	if (conn->outCount >= 8192 && conn->flush_hook == NULL)
 	{
 		int			toSend = conn->outCount - (conn->outCount % 8192);
 
@@ -844,6 +844,9 @@ gtmpqFlush(GTM_Conn *conn)
 	if (conn->Pfdebug)
 		fflush(conn->Pfdebug);
 
+	if (conn->flush_hook)
+		return conn->outCount > 0 ? conn->flush_hook(conn) : 0;
+
 	if (conn->outCount > 0)
 		return gtmpqSendSome(conn, conn->outCount);
 
@@ -41,6 +41,8 @@ static void handleSyncLoss(GTM_Conn *conn, char id, int msgLength);
 static GTM_Result *pqParseInput(GTM_Conn *conn);
 static int gtmpqParseSuccess(GTM_Conn *conn, GTM_Result *result);
 static int gtmpqReadSeqKey(GTM_SequenceKey seqkey, GTM_Conn *conn);
+static int gtmpqReadSnapshotDelta(GTM_Result *result, GTM_Conn *conn);
+static int gtmpqEnsureXipSize(GlobalTransactionId **xip, int *size, int count);
 
 /*
  * parseInput: if appropriate, parse input data from backend
@@ -297,7 +299,7 @@ GTMPQgetResult(GTM_Conn *conn)
 static int
 gtmpqParseSuccess(GTM_Conn *conn, GTM_Result *result)
 {
-	int xcnt, xsize;
+	int xcnt;
 	int i;
 	GlobalTransactionId *xip = NULL;
 
@@ -465,6 +467,15 @@ gtmpqParseSuccess(GTM_Conn *conn, GTM_Result *result)
 			}
 			break;
 
+		case SNAPSHOT_GET_DELTA_RESULT:
+			if (gtmpqReadSnapshotDelta(result, conn))
+			{
+				/* Make sure the next request asks for a full snapshot */
+				result->gr_snapshot_generation = 0;
+				result->gr_status = GTM_RESULT_ERROR;
+			}
+			break;
+
 		case SNAPSHOT_GXID_GET_RESULT:
 			if (gtmpqGetnchar((char *)&result->gr_resdata.grd_txn_snap_multi.txnhandle,
 						   sizeof (GTM_TransactionHandle), conn))
@@ -516,22 +527,21 @@ gtmpqParseSuccess(GTM_Conn *conn, GTM_Result *result)
 				break;
 			}
 
-			xsize = result->gr_xip_size;
-			xcnt = result->gr_snapshot.sn_xcnt;
-			xip = result->gr_snapshot.sn_xip;
+			/* Not a snapshot a delta could be applied on */
+			result->gr_snapshot_generation = 0;
 
-			if (!xip || xcnt > xsize)
+			/*
+			 * The xip array is kept across results and only grows, so that
+			 * the GXIDs are read straight into it without reallocating.
+			 */
+			xcnt = result->gr_snapshot.sn_xcnt;
+			if (gtmpqEnsureXipSize(&result->gr_snapshot.sn_xip,
+								   &result->gr_xip_size, xcnt))
 			{
-				if (!xip)
-					xip = (GlobalTransactionId *) malloc(sizeof(GlobalTransactionId) *
-														 GTM_MAX_GLOBAL_TRANSACTIONS);
-				else
-					xip = (GlobalTransactionId *) realloc(xip,
-									  sizeof(GlobalTransactionId) * xcnt);
-
-				result->gr_snapshot.sn_xip = xip;
-				result->gr_xip_size = xcnt;
+				result->gr_status = GTM_RESULT_ERROR;
+				break;
 			}
+			xip = result->gr_snapshot.sn_xip;
 
 			if (gtmpqGetnchar((char *)xip, sizeof(GlobalTransactionId) * xcnt, conn))
 			{
@@ -570,6 +580,30 @@ gtmpqParseSuccess(GTM_Conn *conn, GTM_Result *result)
 #endif
 			break;
 
+		case SEQUENCE_GET_NEXT_MULTI_RESULT:
+			if (gtmpqGetnchar((char *)&result->gr_resdata.grd_seq_multi.seq_count,
+						   sizeof (int), conn) ||
+				result->gr_resdata.grd_seq_multi.seq_count < 0 ||
+				result->gr_resdata.grd_seq_multi.seq_count > GTM_MAX_SEQUENCE_NEXT_MULTI)
+			{
+				result->gr_status = GTM_RESULT_ERROR;
+				break;
+			}
+			for (i = 0; i < result->gr_resdata.grd_seq_multi.seq_count; i++)
+			{
+				if (gtmpqGetnchar((char *)&result->gr_resdata.grd_seq_multi.status[i],
+							   sizeof (int), conn) ||
+					gtmpqGetnchar((char *)&result->gr_resdata.grd_seq_multi.seqval[i],
+							   sizeof (GTM_Sequence), conn) ||
+					gtmpqGetnchar((char *)&result->gr_resdata.grd_seq_multi.rangemax[i],
+							   sizeof (GTM_Sequence), conn))
+				{
+					result->gr_status = GTM_RESULT_ERROR;
+					break;
+				}
+			}
+			break;
+
 		case SEQUENCE_LIST_RESULT:
 			if (gtmpqGetInt(&result->gr_resdata.grd_seq_list.seq_count,
 					sizeof (int32), conn))
@@ -780,6 +814,76 @@ gtmpqParseSuccess(GTM_Conn *conn, GTM_Result *result)
 		case BARRIER_RESULT:
 			break;
 
+		case GET_STATS_RESULT:
+		{
+			int nsections;
+			int section;
+			int count = 0;
+
+			if (gtmpqGetInt(&nsections, sizeof (int32), conn))
+			{
+				result->gr_status = GTM_RESULT_ERROR;
+				break;
+			}
+
+			for (section = 0; section < nsections; section++)
+			{
+				char source[GTM_STATS_NAMELEN];
+				int len;
+				int nrows;
+				int row;
+
+				if (gtmpqGetInt(&len, sizeof (int32), conn) ||
+					len < 0 || len >= GTM_STATS_NAMELEN ||
+					gtmpqGetnchar(source, len, conn) ||
+					gtmpqGetInt(&nrows, sizeof (int32), conn))
+				{
+					result->gr_status = GTM_RESULT_ERROR;
+					break;
+				}
+				source[len] = '\0';
+
+				if (count + nrows > result->gr_stats_size)
+				{
+					GTM_StatsEntry *newstats;
+
+					newstats = (GTM_StatsEntry *)
+						realloc(result->gr_stats,
+								sizeof (GTM_StatsEntry) * (count + nrows));
+					if (newstats == NULL)
+					{
+						result->gr_status = GTM_RESULT_ERROR;
+						break;
+					}
+					result->gr_stats = newstats;
+					result->gr_stats_size = count + nrows;
+				}
+
+				for (row = 0; row < nrows; row++)
+				{
+					GTM_StatsEntry *entry = &result->gr_stats[count];
+
+					strcpy(entry->source, source);
+					if (gtmpqGetInt(&entry->kind, sizeof (int32), conn) ||
+						gtmpqGetInt(&len, sizeof (int32), conn) ||
+						len < 0 || len >= GTM_STATS_NAMELEN ||
+						gtmpqGetnchar(entry->name, len, conn) ||
+						gtmpqGetnchar((char *)&entry->counter,
+									  sizeof (GTM_StatsCounter), conn))
+					{
+						result->gr_status = GTM_RESULT_ERROR;
+						break;
+					}
+					entry->name[len] = '\0';
+					count++;
+				}
+				if (result->gr_status != GTM_RESULT_OK)
+					break;
+			}
+			result->gr_resdata.grd_stats_count = count;
+			break;
+		}
+
 		case REPORT_XMIN_RESULT:
 			if (gtmpqGetnchar((char *)&result->gr_resdata.grd_report_xmin.latest_completed_xid,
 							  sizeof (GlobalTransactionId), conn))
@@ -836,6 +940,141 @@ gtmpqReadSeqKey(GTM_SequenceKey seqkey, GTM_Conn *conn)
 	return 0;
 }
 
+/*
+ * Make sure the GXID array has space for at least count entries. Like the
+ * snapshot itself, the array is never freed while the connection is open.
+ */
+static int
+gtmpqEnsureXipSize(GlobalTransactionId **xip, int *size, int count)
+{
+	GlobalTransactionId *newxip;
+	int			newsize;
+
+	if (*xip != NULL && count <= *size)
+		return 0;
+
+	newsize = Max(count, GTM_MAX_GLOBAL_TRANSACTIONS);
+	newxip = (GlobalTransactionId *) realloc(*xip,
+								sizeof (GlobalTransactionId) * newsize);
+	if (newxip == NULL)
+		return ENOMEM;
+
+	*xip = newxip;
+	*size = newsize;
+	return 0;
+}
+
+/*
+ * Read the rest of a SNAPSHOT_GET_DELTA_RESULT message. The full snapshot
+ * replaces gr_snapshot, while the delta is applied on top of it, provided
+ * gr_snapshot is the one the delta was computed from.
+ *
+ * All the GXID arrays are sorted, which lets us apply the delta in place.
+ */
+static int
+gtmpqReadSnapshotDelta(GTM_Result *result, GTM_Conn *conn)
+{
+	GTM_Snapshot snapshot = &result->gr_snapshot;
+	uint64		generation;
+	uint64		base_generation;
+	GlobalTransactionId xmin;
+	GlobalTransactionId xmax;
+	GlobalTransactionId *removed;
+	GlobalTransactionId *added;
+	int			nremoved;
+	int			nadded;
+	int			xcnt;
+	int			ii;
+	int			jj;
+	int			kk;
+
+	if (gtmpqGetnchar((char *)&result->gr_resdata.grd_txn_snap_multi.txn_count,
+					  sizeof (int), conn) ||
+		gtmpqGetnchar((char *)result->gr_resdata.grd_txn_snap_multi.status,
+					  sizeof (int) * result->gr_resdata.grd_txn_snap_multi.txn_count,
+					  conn) ||
+		gtmpqGetnchar((char *)&generation, sizeof (generation), conn) ||
+		gtmpqGetnchar((char *)&base_generation, sizeof (base_generation), conn) ||
+		gtmpqGetnchar((char *)&xmin, sizeof (GlobalTransactionId), conn) ||
+		gtmpqGetnchar((char *)&xmax, sizeof (GlobalTransactionId), conn))
+		return EINVAL;
+
+	if (base_generation == 0)
+	{
+		/* Full snapshot */
+		if (gtmpqGetInt(&xcnt, sizeof (int32), conn) ||
+			xcnt < 0 ||
+			gtmpqEnsureXipSize(&snapshot->sn_xip, &result->gr_xip_size, xcnt) ||
+			gtmpqGetnchar((char *)snapshot->sn_xip,
+						  sizeof (GlobalTransactionId) * xcnt, conn))
+			return EINVAL;
+
+		snapshot->sn_xcnt = xcnt;
+		result->gr_delta_nremoved = result->gr_delta_nadded = 0;
+	}
+	else
+	{
+		/* Delta, read the removed and then the added GXIDs */
+		if (gtmpqGetInt(&nremoved, sizeof (int32), conn) ||
+			nremoved < 0 ||
+			gtmpqEnsureXipSize(&result->gr_delta_xip, &result->gr_delta_size,
+							   nremoved) ||
+			gtmpqGetnchar((char *)result->gr_delta_xip,
+						  sizeof (GlobalTransactionId) * nremoved, conn) ||
+			gtmpqGetInt(&nadded, sizeof (int32), conn) ||
+			nadded < 0 ||
+			gtmpqEnsureXipSize(&result->gr_delta_xip, &result->gr_delta_size,
+							   nremoved + nadded) ||
+			gtmpqGetnchar((char *)(result->gr_delta_xip + nremoved),
+						  sizeof (GlobalTransactionId) * nadded, conn))
+			return EINVAL;
+
+		result->gr_delta_nremoved = nremoved;
+		result->gr_delta_nadded = nadded;
+
+		/* The delta is useless unless we have its base snapshot */
+		if (result->gr_snapshot_generation != base_generation)
+			return EINVAL;
+
+		removed = result->gr_delta_xip;
+		added = result->gr_delta_xip + nremoved;
+
+		/* Squeeze out the removed GXIDs */
+		for (ii = 0, jj = 0, xcnt = 0; ii < snapshot->sn_xcnt; ii++)
+		{
+			if (jj < nremoved && snapshot->sn_xip[ii] == removed[jj])
+				jj++;
+			else
+				snapshot->sn_xip[xcnt++] = snapshot->sn_xip[ii];
+		}
+		if (jj != nremoved)
+			return EINVAL;
+
+		if (gtmpqEnsureXipSize(&snapshot->sn_xip, &result->gr_xip_size,
+							   xcnt + nadded))
+			return ENOMEM;
+
+		/* Merge in the added GXIDs, starting from the end */
+		ii = xcnt - 1;
+		jj = nadded - 1;
+		for (kk = xcnt + nadded - 1; jj >= 0; kk--)
+		{
+			if (ii >= 0 && snapshot->sn_xip[ii] > added[jj])
+				snapshot->sn_xip[kk] = snapshot->sn_xip[ii--];
+			else
+				snapshot->sn_xip[kk] = added[jj--];
+		}
+		snapshot->sn_xcnt = xcnt + nadded;
+	}
+
+	snapshot->sn_xmin = xmin;
+	snapshot->sn_xmax = xmax;
+	result->gr_snapshot_generation = generation;
+	result->gr_delta_base = base_generation;
+
+	return 0;
+}
+
 void
 gtmpqFreeResultData(GTM_Result *result, GTM_PGXCNodeType remote_type)
 {
@@ -879,6 +1118,7 @@ gtmpqFreeResultData(GTM_Result *result, GTM_PGXCNodeType remote_type)
 
 		case SNAPSHOT_GET_RESULT:
 		case SNAPSHOT_GXID_GET_RESULT:
+		case SNAPSHOT_GET_DELTA_RESULT:
 			/*
 			 * Lets not free the xip array in the snapshot since we may need it
 			 * again shortly
@@ -50,8 +50,14 @@ static int commit_prepared_transaction_internal(GTM_Conn *conn,
 												bool is_backup);
 static int start_prepared_transaction_internal(GTM_Conn *conn, GlobalTransactionId gxid, char *gid,
 											   char *nodestring, bool is_backup);
+static int start_prepared_transaction_send_internal(GTM_Conn *conn,
+						   GlobalTransactionId gxid, char *gid,
+						   char *nodestring, bool is_backup);
 static int prepare_transaction_internal(GTM_Conn *conn, GlobalTransactionId gxid, bool is_backup);
 static int abort_transaction_internal(GTM_Conn *conn, GlobalTransactionId gxid, bool is_backup);
+static int abort_transaction_send_internal(GTM_Conn *conn, GlobalTransactionId gxid,
+				bool is_backup);
+static GTM_Result *pipeline_get_result(GTM_Conn *conn);
 static int abort_transaction_multi_internal(GTM_Conn *conn, int txn_count, GlobalTransactionId *gxid,
 											int *txn_count_out, int *status_out, bool is_backup);
 static int open_sequence_internal(GTM_Conn *conn, GTM_SequenceKey key, GTM_Sequence increment,
@@ -314,6 +320,54 @@ send_failed:
 	return InvalidGlobalTransactionId;
 }
 
+/*
+ * get_gtm_stats()
+ *
+ * Fetch the request statistics of GTM and of the GTM proxies in between.
+ * Returns the number of rows, which are valid until the next request on the
+ * connection, or -1 on failure.
+ */
+int
+get_gtm_stats(GTM_Conn *conn, GTM_StatsEntry **entries)
+{
+	GTM_Result *res = NULL;
+	time_t finish_time;
+
+	 /* Start the message. */
+	if (gtmpqPutMsgStart('C', true, conn) ||
+		gtmpqPutInt(MSG_GET_STATS, sizeof (GTM_MessageType), conn))
+		goto send_failed;
+
+	/* Finish the message. */
+	if (gtmpqPutMsgEnd(conn))
+		goto send_failed;
+
+	/* Flush to ensure backend gets it. */
+	if (gtmpqFlush(conn))
+		goto send_failed;
+
+	finish_time = time(NULL) + CLIENT_GTM_TIMEOUT;
+	if (gtmpqWaitTimed(true, false, conn, finish_time) ||
+		gtmpqReadData(conn) < 0)
+		goto receive_failed;
+
+	if ((res = GTMPQgetResult(conn)) == NULL)
+		goto receive_failed;
+
+	if (res->gr_status != GTM_RESULT_OK)
+		return -1;
+
+	Assert(res->gr_type == GET_STATS_RESULT);
+	*entries = res->gr_stats;
+	return res->gr_resdata.grd_stats_count;
+
+receive_failed:
+send_failed:
+	conn->result = makeEmptyResultIfIsNull(conn->result);
+	conn->result->gr_status = GTM_RESULT_COMM_ERROR;
+	return -1;
+}
+
 /*
  * get_txn_gxid_list()
  *
@@ -841,9 +895,41 @@ bkup_abort_transaction(GTM_Conn *conn, GlobalTransactionId gxid)
 static int
 abort_transaction_internal(GTM_Conn *conn, GlobalTransactionId gxid, bool is_backup)
 {
-	GTM_Result *res = NULL;
-	time_t finish_time;
+	if (abort_transaction_send_internal(conn, gxid, is_backup))
+		return -1;
+
+	if (is_backup)
+	{
+		/* Flush to ensure backend gets it. */
+		if (gtmpqFlush(conn))
+			goto send_failed;
+		return GTM_RESULT_OK;
+	}
 
+	return abort_transaction_receive(conn, gxid);
+
+send_failed:
+	conn->result = makeEmptyResultIfIsNull(conn->result);
+	conn->result->gr_status = GTM_RESULT_COMM_ERROR;
+	return -1;
+}
+
+/*
+ * Queue a rollback message on the connection without sending it.  Several
+ * requests can be queued this way and go out together when the first of
+ * their results is read: abort_transaction_receive must then be called once
+ * per queued request, in the same order.
+ */
+int
+abort_transaction_send(GTM_Conn *conn, GlobalTransactionId gxid)
+{
+	return abort_transaction_send_internal(conn, gxid, false);
+}
+
+static int
+abort_transaction_send_internal(GTM_Conn *conn, GlobalTransactionId gxid,
+								bool is_backup)
+{
 	 /* Start the message. */
 	if (gtmpqPutMsgStart('C', true, conn) ||
 		gtmpqPutInt(is_backup ? MSG_BKUP_TXN_ROLLBACK : MSG_TXN_ROLLBACK, sizeof (GTM_MessageType), conn) ||
@@ -854,36 +940,59 @@ abort_transaction_internal(GTM_Conn *conn, GlobalTransactionId gxid, bool is_bac
 	if (gtmpqPutMsgEnd(conn))
 		goto send_failed;
 
-	/* Flush to ensure backend gets it. */
-	if (gtmpqFlush(conn))
-		goto send_failed;
+	return 0;
 
-	if (!is_backup)
-	{
-		finish_time = time(NULL) + CLIENT_GTM_TIMEOUT;
-		if (gtmpqWaitTimed(true, false, conn, finish_time) ||
-			gtmpqReadData(conn) < 0)
-			goto receive_failed;
+send_failed:
+	conn->result = makeEmptyResultIfIsNull(conn->result);
+	conn->result->gr_status = GTM_RESULT_COMM_ERROR;
+	return -1;
+}
 
-		if ((res = GTMPQgetResult(conn)) == NULL)
-			goto receive_failed;
+int
+abort_transaction_receive(GTM_Conn *conn, GlobalTransactionId gxid)
+{
+	GTM_Result *res = NULL;
 
-		if (res->gr_status == GTM_RESULT_OK)
-		{
-			Assert(res->gr_type == TXN_ROLLBACK_RESULT);
-			Assert(res->gr_resdata.grd_gxid == gxid);
-		}
+	if ((res = pipeline_get_result(conn)) == NULL)
+		goto receive_failed;
 
-		return res->gr_status;
+	if (res->gr_status == GTM_RESULT_OK)
+	{
+		Assert(res->gr_type == TXN_ROLLBACK_RESULT);
+		Assert(res->gr_resdata.grd_gxid == gxid);
 	}
-	return GTM_RESULT_OK;
+
+	return res->gr_status;
 
 receive_failed:
-send_failed:
 	conn->result = makeEmptyResultIfIsNull(conn->result);
 	conn->result->gr_status = GTM_RESULT_COMM_ERROR;
 	return -1;
+}
+
+/*
+ * Read the result of the oldest request still pending on the connection.
+ * Requests queued but not sent yet are flushed first.  When several requests
+ * were pipelined, the later results often arrive together with the first
+ * one, so only wait on the socket if nothing is buffered yet.
+ */
+static GTM_Result *
+pipeline_get_result(GTM_Conn *conn)
+{
+	time_t finish_time;
+
+	if (gtmpqFlush(conn))
+		return NULL;
+
+	if (conn->inStart >= conn->inEnd)
+	{
+		finish_time = time(NULL) + CLIENT_GTM_TIMEOUT;
+		if (gtmpqWaitTimed(true, false, conn, finish_time) ||
+			gtmpqReadData(conn) < 0)
+			return NULL;
+	}
 
+	return GTMPQgetResult(conn);
 }
 
 int
@@ -906,9 +1015,36 @@ static int
 start_prepared_transaction_internal(GTM_Conn *conn, GlobalTransactionId gxid, char *gid,
 						   char *nodestring, bool is_backup)
 {
-	GTM_Result *res = NULL;
-	time_t finish_time;
+	if (start_prepared_transaction_send_internal(conn, gxid, gid, nodestring,
+												 is_backup))
+		return -1;
+
+	if (is_backup)
+		return GTM_RESULT_OK;
 
+	return start_prepared_transaction_receive(conn, gxid);
+}
+
+/*
+ * Send start prepared message to GTM without waiting for the result, so the
+ * caller can do something useful, like collecting PREPARE responses from the
+ * Datanodes, while GTM is processing the request. The result must be read by
+ * start_prepared_transaction_receive before anything else is sent over the
+ * connection.
+ */
+int
+start_prepared_transaction_send(GTM_Conn *conn, GlobalTransactionId gxid, char *gid,
+								char *nodestring)
+{
+	return start_prepared_transaction_send_internal(conn, gxid, gid, nodestring,
+													false);
+}
+
+static int
+start_prepared_transaction_send_internal(GTM_Conn *conn, GlobalTransactionId gxid,
+										 char *gid, char *nodestring,
+										 bool is_backup)
+{
 	Assert(nodestring);
 
 	 /* Start the message. */
@@ -930,8 +1066,19 @@ start_prepared_transaction_internal(GTM_Conn *conn, GlobalTransactionId gxid, ch
 	if (gtmpqFlush(conn))
 		goto send_failed;
 
-	if (is_backup)
-		return GTM_RESULT_OK;
+	return 0;
+
+send_failed:
+	conn->result = makeEmptyResultIfIsNull(conn->result);
+	conn->result->gr_status = GTM_RESULT_COMM_ERROR;
+	return -1;
+}
+
+int
+start_prepared_transaction_receive(GTM_Conn *conn, GlobalTransactionId gxid)
+{
+	GTM_Result *res = NULL;
+	time_t finish_time;
 
 	finish_time = time(NULL) + CLIENT_GTM_TIMEOUT;
 	if (gtmpqWaitTimed(true, false, conn, finish_time) ||
@@ -950,7 +1097,6 @@ start_prepared_transaction_internal(GTM_Conn *conn, GlobalTransactionId gxid, ch
 	return res->gr_status;
 
 receive_failed:
-send_failed:
 	conn->result = makeEmptyResultIfIsNull(conn->result);
 	conn->result->gr_status = GTM_RESULT_COMM_ERROR;
 	return -1;
@@ -1078,16 +1224,27 @@ get_snapshot(GTM_Conn *conn, GlobalTransactionId gxid, bool canbe_grouped)
 	GTM_Result *res = NULL;
 	time_t finish_time;
 	GTM_ResultType res_type;
+	uint64 generation;
 
-	res_type = canbe_grouped ? SNAPSHOT_GET_MULTI_RESULT : SNAPSHOT_GET_RESULT;
+	res_type = canbe_grouped ? SNAPSHOT_GET_DELTA_RESULT : SNAPSHOT_GET_RESULT;
+
+	/*
+	 * Grouped requests also tell the generation of the last snapshot we
+	 * received, so that only the changes since then need to be sent.
+	 */
+	generation = conn->result ? conn->result->gr_snapshot_generation : 0;
 
 	 /* Start the message. */
 	if (gtmpqPutMsgStart('C', true, conn) ||
-		gtmpqPutInt(canbe_grouped ? MSG_SNAPSHOT_GET_MULTI : MSG_SNAPSHOT_GET, sizeof (GTM_MessageType), conn) ||
+		gtmpqPutInt(canbe_grouped ? MSG_SNAPSHOT_GET_DELTA : MSG_SNAPSHOT_GET, sizeof (GTM_MessageType), conn) ||
 		gtmpqPutInt(1, sizeof (int), conn) ||
 		gtmpqPutnchar((char *)&gxid, sizeof (GlobalTransactionId), conn))
 		goto send_failed;
 
+	if (canbe_grouped &&
+		gtmpqPutnchar((char *)&generation, sizeof (generation), conn))
+		goto send_failed;
+
 	/* Finish the message. */
 	if (gtmpqPutMsgEnd(conn))
 		goto send_failed;
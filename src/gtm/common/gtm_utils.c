@@ -71,11 +71,13 @@ static struct enum_name message_name_tab[] =
 	{MSG_SNAPSHOT_GET, "MSG_SNAPSHOT_GET"},
 	{MSG_SNAPSHOT_GET_MULTI, "MSG_SNAPSHOT_GET_MULTI"},
 	{MSG_SNAPSHOT_GXID_GET, "MSG_SNAPSHOT_GXID_GET"},
+	{MSG_SNAPSHOT_GET_DELTA, "MSG_SNAPSHOT_GET_DELTA"},
 	{MSG_SEQUENCE_INIT, "MSG_SEQUENCE_INIT"},
 	{MSG_BKUP_SEQUENCE_INIT, "MSG_BKUP_SEQUENCE_INIT"},
 	{MSG_SEQUENCE_GET_CURRENT, "MSG_SEQUENCE_GET_CURRENT"},
 	{MSG_SEQUENCE_GET_NEXT, "MSG_SEQUENCE_GET_NEXT"},
 	{MSG_BKUP_SEQUENCE_GET_NEXT, "MSG_BKUP_SEQUENCE_GET_NEXT"},
+	{MSG_SEQUENCE_GET_NEXT_MULTI, "MSG_SEQUENCE_GET_NEXT_MULTI"},
 	{MSG_SEQUENCE_GET_LAST, "MSG_SEQUENCE_GET_LAST"},
 	{MSG_SEQUENCE_SET_VAL, "MSG_SEQUENCE_SET_VAL"},
 	{MSG_BKUP_SEQUENCE_SET_VAL, "MSG_BKUP_SEQUENCE_SET_VAL"},
@@ -95,6 +97,9 @@ static struct enum_name message_name_tab[] =
 	{MSG_BKUP_TXN_BEGIN_GETGXID_AUTOVACUUM, "MSG_BKUP_TXN_BEGIN_GETGXID_AUTOVACUUM"},
 	{MSG_DATA_FLUSH, "MSG_DATA_FLUSH"},
 	{MSG_BACKEND_DISCONNECT, "MSG_BACKEND_DISCONNECT"},
+	{MSG_BARRIER, "MSG_BARRIER"},
+	{MSG_BKUP_BARRIER, "MSG_BKUP_BARRIER"},
+	{MSG_GET_STATS, "MSG_GET_STATS"},
 	{MSG_TYPE_COUNT, "MSG_TYPE_COUNT"},
 	{-1, NULL}
 };
@@ -126,9 +131,11 @@ static struct enum_name result_name_tab[] =
 	{SNAPSHOT_GET_RESULT, "SNAPSHOT_GET_RESULT"},
 	{SNAPSHOT_GET_MULTI_RESULT, "SNAPSHOT_GET_MULTI_RESULT"},
 	{SNAPSHOT_GXID_GET_RESULT, "SNAPSHOT_GXID_GET_RESULT"},
+	{SNAPSHOT_GET_DELTA_RESULT, "SNAPSHOT_GET_DELTA_RESULT"},
 	{SEQUENCE_INIT_RESULT, "SEQUENCE_INIT_RESULT"},
 	{SEQUENCE_GET_CURRENT_RESULT, "SEQUENCE_GET_CURRENT_RESULT"},
 	{SEQUENCE_GET_NEXT_RESULT, "SEQUENCE_GET_NEXT_RESULT"},
+	{SEQUENCE_GET_NEXT_MULTI_RESULT, "SEQUENCE_GET_NEXT_MULTI_RESULT"},
 	{SEQUENCE_GET_LAST_RESULT, "SEQUENCE_GET_LAST_RESULT"},
 	{SEQUENCE_SET_VAL_RESULT, "SEQUENCE_SET_VAL_RESULT"},
 	{SEQUENCE_RESET_RESULT, "SEQUENCE_RESET_RESULT"},
@@ -140,6 +147,8 @@ static struct enum_name result_name_tab[] =
 	{TXN_GET_ALL_PREPARED_RESULT, "TXN_GET_ALL_PREPARED_RESULT"},
 	{TXN_BEGIN_GETGXID_AUTOVACUUM_RESULT, "TXN_BEGIN_GETGXID_AUTOVACUUM_RESULT"},
 	{REPORT_XMIN_RESULT, "REPORT_XMIN_RESULT"},
+	{BARRIER_RESULT, "BARRIER_RESULT"},
+	{GET_STATS_RESULT, "GET_STATS_RESULT"},
 	{RESULT_TYPE_COUNT, "RESULT_TYPE_COUNT"},
 	{-1, NULL}
 };
@@ -0,0 +1,538 @@
+/*-------------------------------------------------------------------------
+ *
+ * gtm_bench --- throughput and latency benchmark of GTM and GTM proxy
+ *
+ * Every client opens its own connection and runs transactions made of one
+ * begin, a configurable number of snapshot and nextval requests, and one
+ * commit, back to back, until the duration elapses or the requested number
+ * of transactions is done.  The clients are spread over a number of
+ * threads, each thread running its clients in turn.  Pointing the
+ * benchmark at a GTM proxy instead of GTM measures the proxy path.
+ *
+ * Latencies are recorded in per-thread histograms with a resolution of
+ * 1 usec below 1 msec, 10 usec below 10 msec and 100 usec below 100 msec,
+ * so that percentiles can be reported without keeping every sample.
+ *
+ * Portions Copyright (c) 1996-2009, PostgreSQL Global Development Group
+ * Portions Copyright (c) 2010-2012 Postgres-XC Development Group
+ *
+ * src/gtm/gtm_bench/gtm_bench.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "gtm/gtm_c.h"
+#include "gtm/libpq-fe.h"
+#include "gtm/gtm_client.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "getopt_long.h"
+
+#define BENCH_SEQUENCE	"gtm_bench_seq"
+#define BENCH_NODE_NAME	"gtm_bench"
+
+/* Operations timed by the benchmark */
+typedef enum BenchOp
+{
+	OP_BEGIN,
+	OP_SNAPSHOT,
+	OP_NEXTVAL,
+	OP_COMMIT,
+	OP_COUNT
+} BenchOp;
+
+static const char *op_names[OP_COUNT] = {"begin", "snapshot", "nextval", "commit"};
+
+/* Latency histogram, see comment at the top of the file */
+#define HIST_BUCKETS	2801
+
+typedef struct BenchHist
+{
+	uint64		count;
+	uint64		total;			/* usec */
+	uint64		max;			/* usec */
+	uint64		buckets[HIST_BUCKETS];
+} BenchHist;
+
+typedef struct BenchClient
+{
+	int			id;
+	GTM_Conn   *conn;
+	int64		transactions;	/* done so far */
+} BenchClient;
+
+typedef struct BenchThread
+{
+	pthread_t	thread;
+	int			nclients;
+	BenchClient *clients;
+	BenchHist	hist[OP_COUNT];
+} BenchThread;
+
+static char *gtm_host = "localhost";
+static int	gtm_port = 6666;
+static int	nclients = 1;
+static int	nthreads = 1;
+static int	duration = 10;
+static int64 ntransactions = 0;
+static int	nsnapshots = 1;
+static int	nnextvals = 0;
+static bool	grouped = false;
+
+static uint64 end_time;
+
+/*
+ * Referenced by the GTM common and communication libraries, which are
+ * shared with the servers. The client library does not use them.
+ */
+pthread_key_t threadinfo_key;
+GTM_ThreadID TopMostThreadID;
+int			tcp_keepalives_idle = 0;
+int			tcp_keepalives_interval = 0;
+int			tcp_keepalives_count = 0;
+
+static void usage(const char *progname);
+static uint64 bench_now(void);
+static void hist_record(BenchHist *hist, uint64 usec);
+static void hist_add(BenchHist *dst, BenchHist *src);
+static uint64 hist_percentile(BenchHist *hist, double fraction);
+static GTM_Conn *bench_connect(void);
+static void bench_sequence(bool create);
+static void bench_transaction(BenchThread *thread, BenchClient *client);
+static void *bench_thread_main(void *arg);
+static void bench_report(BenchThread *threads, uint64 elapsed);
+
+static void
+usage(const char *progname)
+{
+	printf("%s benchmarks GTM or GTM proxy.\n\n", progname);
+	printf("Usage:\n  %s [OPTION]...\n\n", progname);
+	printf("Options:\n");
+	printf("  -h, --host=HOST          GTM or GTM proxy host (default \"localhost\")\n");
+	printf("  -p, --port=PORT          GTM or GTM proxy port (default 6666)\n");
+	printf("  -c, --client=NUM         number of concurrent clients (default 1)\n");
+	printf("  -j, --jobs=NUM           number of threads (default 1)\n");
+	printf("  -T, --time=NUM           duration of the benchmark in seconds (default 10)\n");
+	printf("  -t, --transactions=NUM   number of transactions each client runs\n");
+	printf("  -s, --snapshots=NUM      snapshots per transaction (default 1)\n");
+	printf("  -n, --nextvals=NUM       sequence values per transaction (default 0)\n");
+	printf("  -g, --grouped            let GTM proxy group snapshot requests\n");
+	printf("  -?, --help               show this help, then exit\n");
+}
+
+/* Current time in microseconds */
+static uint64
+bench_now(void)
+{
+	struct timeval tp;
+
+	gettimeofday(&tp, NULL);
+
+	return (uint64) tp.tv_sec * 1000000 + tp.tv_usec;
+}
+
+static int
+hist_bucket(uint64 usec)
+{
+	if (usec < 1000)
+		return (int) usec;
+	if (usec < 10000)
+		return 1000 + (int) ((usec - 1000) / 10);
+	if (usec < 100000)
+		return 1900 + (int) ((usec - 10000) / 100);
+	return HIST_BUCKETS - 1;
+}
+
+/* Upper bound of the latencies counted in a bucket */
+static uint64
+hist_bucket_bound(int bucket)
+{
+	if (bucket < 1000)
+		return bucket;
+	if (bucket < 1900)
+		return 1000 + (uint64) (bucket - 1000 + 1) * 10;
+	if (bucket < HIST_BUCKETS - 1)
+		return 10000 + (uint64) (bucket - 1900 + 1) * 100;
+	return 0;
+}
+
+static void
+hist_record(BenchHist *hist, uint64 usec)
+{
+	hist->count++;
+	hist->total += usec;
+	if (usec > hist->max)
+		hist->max = usec;
+	hist->buckets[hist_bucket(usec)]++;
+}
+
+static void
+hist_add(BenchHist *dst, BenchHist *src)
+{
+	int			i;
+
+	dst->count += src->count;
+	dst->total += src->total;
+	if (src->max > dst->max)
+		dst->max = src->max;
+	for (i = 0; i < HIST_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+}
+
+static uint64
+hist_percentile(BenchHist *hist, double fraction)
+{
+	uint64		target = (uint64) (hist->count * fraction);
+	uint64		seen = 0;
+	int			i;
+
+	if (target >= hist->count)
+		return hist->max;
+
+	for (i = 0; i < HIST_BUCKETS - 1; i++)
+	{
+		seen += hist->buckets[i];
+		if (seen > target)
+			return hist_bucket_bound(i);
+	}
+	return hist->max;
+}
+
+static GTM_Conn *
+bench_connect(void)
+{
+	char		conn_str[256];
+	GTM_Conn   *conn;
+
+	snprintf(conn_str, sizeof(conn_str), "host=%s port=%d node_name=%s",
+			 gtm_host, gtm_port, BENCH_NODE_NAME);
+
+	conn = PQconnectGTM(conn_str);
+	if (conn == NULL || GTMPQstatus(conn) != CONNECTION_OK)
+	{
+		fprintf(stderr, "could not connect to %s:%d: %s\n", gtm_host, gtm_port,
+				conn ? GTMPQerrorMessage(conn) : "connection failed");
+		exit(1);
+	}
+	return conn;
+}
+
+static void
+bench_sequence_key(GTM_SequenceKeyData *key)
+{
+	key->gsk_keylen = strlen(BENCH_SEQUENCE) + 1;
+	key->gsk_key = BENCH_SEQUENCE;
+	key->gsk_type = GTM_SEQ_FULL_NAME;
+}
+
+/*
+ * Create or drop the sequence used by nextval requests. A sequence left
+ * over by an interrupted run is replaced.
+ */
+static void
+bench_sequence(bool create)
+{
+	GTM_Conn   *conn = bench_connect();
+	GTM_SequenceKeyData key;
+
+	bench_sequence_key(&key);
+
+	if (create)
+	{
+		if (open_sequence(conn, &key, 1, 1, INT64CONST(0x7FFFFFFFFFFFFFFF), 1,
+						  true, InvalidGlobalTransactionId) < 0)
+		{
+			close_sequence(conn, &key, InvalidGlobalTransactionId);
+			if (open_sequence(conn, &key, 1, 1,
+							  INT64CONST(0x7FFFFFFFFFFFFFFF), 1, true,
+							  InvalidGlobalTransactionId) < 0)
+			{
+				fprintf(stderr, "could not create sequence \"%s\": %s\n",
+						BENCH_SEQUENCE, GTMPQerrorMessage(conn));
+				exit(1);
+			}
+		}
+	}
+	else
+		close_sequence(conn, &key, InvalidGlobalTransactionId);
+
+	GTMPQfinish(conn);
+}
+
+static void
+bench_failed(BenchClient *client, const char *what)
+{
+	fprintf(stderr, "client %d: %s failed: %s\n", client->id, what,
+			GTMPQerrorMessage(client->conn));
+	exit(1);
+}
+
+static void
+bench_transaction(BenchThread *thread, BenchClient *client)
+{
+	GTM_Timestamp timestamp;
+	GlobalTransactionId gxid;
+	GTM_SequenceKeyData key;
+	uint64		start;
+	uint64		now;
+	int			i;
+
+	bench_sequence_key(&key);
+
+	start = bench_now();
+	gxid = begin_transaction(client->conn, GTM_ISOLATION_RC, NULL, &timestamp);
+	if (!GlobalTransactionIdIsValid(gxid))
+		bench_failed(client, "begin");
+	now = bench_now();
+	hist_record(&thread->hist[OP_BEGIN], now - start);
+
+	for (i = 0; i < nsnapshots; i++)
+	{
+		start = now;
+		if (get_snapshot(client->conn, gxid, grouped) == NULL)
+			bench_failed(client, "snapshot");
+		now = bench_now();
+		hist_record(&thread->hist[OP_SNAPSHOT], now - start);
+	}
+
+	for (i = 0; i < nnextvals; i++)
+	{
+		GTM_Sequence result;
+		GTM_Sequence rangemax;
+
+		start = now;
+		if (get_next(client->conn, &key, BENCH_NODE_NAME, client->id, 1,
+					 &result, &rangemax) != GTM_RESULT_OK)
+			bench_failed(client, "nextval");
+		now = bench_now();
+		hist_record(&thread->hist[OP_NEXTVAL], now - start);
+	}
+
+	start = now;
+	if (commit_transaction(client->conn, gxid, 0, NULL) < 0)
+		bench_failed(client, "commit");
+	now = bench_now();
+	hist_record(&thread->hist[OP_COMMIT], now - start);
+
+	client->transactions++;
+}
+
+static void *
+bench_thread_main(void *arg)
+{
+	BenchThread *thread = (BenchThread *) arg;
+	int			running = thread->nclients;
+
+	while (running > 0)
+	{
+		int			i;
+
+		if (ntransactions == 0 && bench_now() >= end_time)
+			break;
+
+		running = 0;
+		for (i = 0; i < thread->nclients; i++)
+		{
+			BenchClient *client = &thread->clients[i];
+
+			if (ntransactions > 0 && client->transactions >= ntransactions)
+				continue;
+
+			bench_transaction(thread, client);
+			running++;
+		}
+	}
+	return NULL;
+}
+
+static void
+bench_report(BenchThread *threads, uint64 elapsed)
+{
+	BenchHist  *total;
+	int64		transactions = 0;
+	double		seconds = elapsed / 1000000.0;
+	int			i;
+	int			op;
+
+	total = (BenchHist *) calloc(OP_COUNT, sizeof(BenchHist));
+	if (total == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	for (i = 0; i < nthreads; i++)
+	{
+		int			j;
+
+		for (op = 0; op < OP_COUNT; op++)
+			hist_add(&total[op], &threads[i].hist[op]);
+		for (j = 0; j < threads[i].nclients; j++)
+			transactions += threads[i].clients[j].transactions;
+	}
+
+	printf("server: %s:%d\n", gtm_host, gtm_port);
+	printf("transaction: begin, %d snapshot(s)%s, %d nextval(s), commit\n",
+		   nsnapshots, grouped ? " grouped" : "", nnextvals);
+	printf("number of clients: %d\n", nclients);
+	printf("number of threads: %d\n", nthreads);
+	printf("duration: %.3f s\n", seconds);
+	printf("number of transactions: " INT64_FORMAT "\n", transactions);
+	printf("tps = %.1f\n\n", transactions / seconds);
+
+	printf("%-10s %12s %12s %10s %10s %10s %10s %10s\n", "operation",
+		   "count", "ops/s", "avg(us)", "p50(us)", "p90(us)", "p99(us)",
+		   "max(us)");
+	for (op = 0; op < OP_COUNT; op++)
+	{
+		BenchHist  *hist = &total[op];
+
+		if (hist->count == 0)
+			continue;
+
+		printf("%-10s %12lu %12.1f %10.1f %10lu %10lu %10lu %10lu\n",
+			   op_names[op], (unsigned long) hist->count,
+			   hist->count / seconds,
+			   (double) hist->total / hist->count,
+			   (unsigned long) hist_percentile(hist, 0.50),
+			   (unsigned long) hist_percentile(hist, 0.90),
+			   (unsigned long) hist_percentile(hist, 0.99),
+			   (unsigned long) hist->max);
+	}
+
+	free(total);
+}
+
+int
+main(int argc, char **argv)
+{
+	static struct option long_options[] = {
+		{"host", required_argument, NULL, 'h'},
+		{"port", required_argument, NULL, 'p'},
+		{"client", required_argument, NULL, 'c'},
+		{"jobs", required_argument, NULL, 'j'},
+		{"time", required_argument, NULL, 'T'},
+		{"transactions", required_argument, NULL, 't'},
+		{"snapshots", required_argument, NULL, 's'},
+		{"nextvals", required_argument, NULL, 'n'},
+		{"grouped", no_argument, NULL, 'g'},
+		{"help", no_argument, NULL, '?'},
+		{NULL, 0, NULL, 0}
+	};
+	const char *progname = argv[0];
+	BenchThread *threads;
+	BenchClient *clients;
+	uint64		start_time;
+	int			c;
+	int			i;
+
+	while ((c = getopt_long(argc, argv, "h:p:c:j:T:t:s:n:g?", long_options,
+							NULL)) != -1)
+	{
+		switch (c)
+		{
+			case 'h':
+				gtm_host = optarg;
+				break;
+			case 'p':
+				gtm_port = atoi(optarg);
+				break;
+			case 'c':
+				nclients = atoi(optarg);
+				break;
+			case 'j':
+				nthreads = atoi(optarg);
+				break;
+			case 'T':
+				duration = atoi(optarg);
+				break;
+			case 't':
+				ntransactions = atoll(optarg);
+				break;
+			case 's':
+				nsnapshots = atoi(optarg);
+				break;
+			case 'n':
+				nnextvals = atoi(optarg);
+				break;
+			case 'g':
+				grouped = true;
+				break;
+			case '?':
+				usage(progname);
+				exit(strcmp(argv[optind - 1], "-?") == 0 ||
+					 strcmp(argv[optind - 1], "--help") == 0 ? 0 : 1);
+		}
+	}
+
+	if (nclients <= 0 || nthreads <= 0 || duration <= 0 ||
+		ntransactions < 0 || nsnapshots < 0 || nnextvals < 0)
+	{
+		fprintf(stderr, "%s: invalid option value\n", progname);
+		exit(1);
+	}
+	if (nthreads > nclients)
+		nthreads = nclients;
+
+	threads = (BenchThread *) calloc(nthreads, sizeof(BenchThread));
+	clients = (BenchClient *) calloc(nclients, sizeof(BenchClient));
+	if (threads == NULL || clients == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	if (nnextvals > 0)
+		bench_sequence(true);
+
+	/* Connect all the clients before starting the clock */
+	for (i = 0; i < nclients; i++)
+	{
+		clients[i].id = i;
+		clients[i].conn = bench_connect();
+	}
+
+	/* Give each thread a contiguous slice of the clients */
+	for (i = 0; i < nthreads; i++)
+	{
+		int			first = (int) ((int64) nclients * i / nthreads);
+		int			last = (int) ((int64) nclients * (i + 1) / nthreads);
+
+		threads[i].clients = &clients[first];
+		threads[i].nclients = last - first;
+	}
+
+	start_time = bench_now();
+	end_time = start_time + (uint64) duration * 1000000;
+
+	for (i = 0; i < nthreads; i++)
+	{
+		if (pthread_create(&threads[i].thread, NULL, bench_thread_main,
+						   &threads[i]) != 0)
+		{
+			fprintf(stderr, "could not create thread\n");
+			exit(1);
+		}
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i].thread, NULL);
+
+	bench_report(threads, bench_now() - start_time);
+
+	for (i = 0; i < nclients; i++)
+		GTMPQfinish(clients[i].conn);
+
+	if (nnextvals > 0)
+		bench_sequence(false);
+
+	free(clients);
+	free(threads);
+
+	return 0;
+}
@@ -59,6 +59,7 @@
  *
  * message-level I/O (and old-style-COPY-OUT cruft):
  *		pq_putmessage	- send a normal message (suppressed in COPY OUT mode)
+ *		pq_putmessage_tail - send a message whose body ends with a large array
  *		pq_startcopyout - inform libpq that a COPY OUT transfer is beginning
  *		pq_endcopyout	- end a COPY OUT transfer
  *
@@ -76,6 +77,7 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #ifdef HAVE_NETINET_TCP_H
@@ -109,6 +111,9 @@ extern int         tcp_keepalives_count;
 /* Internal functions */
 static int	internal_putbytes(Port *myport, const char *s, size_t len);
 static int	internal_flush(Port *myport);
+static int	internal_putbytes_direct(Port *myport, const char *s, size_t len);
+
+static int	last_reported_send_errno = 0;
 
 /*
  * Streams -- wrapper around Unix socket system calls
@@ -811,8 +816,6 @@ pq_flush(Port *myport)
 static int
 internal_flush(Port *myport)
 {
-	static int	last_reported_send_errno = 0;
-
 	char	   *bufptr = myport->PqSendBuffer;
 	char	   *bufend = myport->PqSendBuffer + myport->PqSendPointer;
 
@@ -864,6 +867,75 @@ internal_flush(Port *myport)
 	return 0;
 }
 
+/*
+ * Like internal_putbytes, but if the data does not fit in the send buffer,
+ * send them straight from the caller's memory together with what is
+ * already buffered, instead of copying them through the buffer.
+ */
+static int
+internal_putbytes_direct(Port *myport, const char *s, size_t len)
+{
+	struct iovec iov[2];
+	int			first = 0;
+
+	if (myport->PqSendPointer + len <= PQ_BUFFER_SIZE)
+		return internal_putbytes(myport, s, len);
+
+	iov[0].iov_base = myport->PqSendBuffer;
+	iov[0].iov_len = myport->PqSendPointer;
+	iov[1].iov_base = (char *) s;
+	iov[1].iov_len = len;
+
+	while (iov[1].iov_len > 0)
+	{
+		ssize_t		r;
+
+		if (iov[0].iov_len == 0)
+			first = 1;
+
+		r = writev(myport->sock, iov + first, 2 - first);
+		myport->last_call = GTM_LastCall_SEND;
+
+		if (r <= 0)
+		{
+			myport->last_errno = errno;
+			if (errno == EINTR)
+				continue;		/* Ok if we were interrupted */
+
+			/* Same as internal_flush, report only once and drop the data */
+			if (errno != last_reported_send_errno)
+			{
+				last_reported_send_errno = errno;
+				ereport(COMMERROR,
+						(EACCES,
+						 errmsg("could not send data to client: %m")));
+			}
+			myport->PqSendPointer = 0;
+			return EOF;
+		}
+		else
+			myport->last_errno = 0;
+
+		last_reported_send_errno = 0;	/* reset after any successful send */
+
+		if (r < iov[first].iov_len || first == 1)
+		{
+			iov[first].iov_base = (char *) iov[first].iov_base + r;
+			iov[first].iov_len -= r;
+		}
+		else
+		{
+			r -= iov[0].iov_len;
+			iov[0].iov_len = 0;
+			iov[1].iov_base = (char *) iov[1].iov_base + r;
+			iov[1].iov_len -= r;
+		}
+	}
+
+	myport->PqSendPointer = 0;
+	return 0;
+}
+
 
 /* --------------------------------
  * Message-level I/O routines begin here.
@@ -918,6 +990,41 @@ fail:
 	return EOF;
 }
 
+/* --------------------------------
+ *		pq_putmessage_tail	- send a message whose body is s followed by tail
+ *
+ *		The tail is usually a large array the caller keeps anyway, like the
+ *		GXIDs of a snapshot. It is sent straight from the caller's memory
+ *		when it does not fit in the send buffer, so that the caller need
+ *		not assemble the whole message body first.
+ *
+ *		returns 0 if OK, EOF if trouble
+ * --------------------------------
+ */
+int
+pq_putmessage_tail(Port *myport, char msgtype, const char *s, size_t len,
+				   const char *tail, size_t taillen)
+{
+	uint32		n32;
+	if (msgtype)
+		if (internal_putbytes(myport, &msgtype, 1))
+			goto fail;
+
+	n32 = htonl((uint32) (len + taillen + 4));
+	if (internal_putbytes(myport, (char *) &n32, 4))
+		goto fail;
+
+	if (internal_putbytes(myport, s, len))
+		goto fail;
+
+	if (taillen > 0 && internal_putbytes_direct(myport, tail, taillen))
+		goto fail;
+	return 0;
+
+fail:
+	return EOF;
+}
+
 
 /*
  * Support for TCP Keepalive parameters
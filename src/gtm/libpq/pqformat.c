@@ -44,6 +44,7 @@
  *		pq_sendstring	- append a null-terminated text string (with conversion)
  *		pq_send_ascii_string - append a null-terminated text string (without conversion)
  *		pq_endmessage	- send the completed message to the frontend
+ *		pq_endmessage_tail - send the message with an array appended, uncopied
  * Note: it is also possible to append data to the StringInfo buffer using
  * the regular StringInfo routines, but this is discouraged since required
  * character set conversion may not occur.
@@ -347,6 +348,25 @@ pq_endmessage(Port *myport, StringInfo buf)
 	buf->data = NULL;
 }
 
+/* --------------------------------
+ *		pq_endmessage_tail	- send the message with tail appended to its body
+ *
+ * Same as pq_endmessage, but the last taillen bytes of the message body
+ * are sent from tail as they are, without being copied into buf first.
+ * --------------------------------
+ */
+void
+pq_endmessage_tail(Port *myport, StringInfo buf, const char *tail,
+				   size_t taillen)
+{
+	/* msgtype was saved in cursor field */
+	(void) pq_putmessage_tail(myport, buf->cursor, buf->data, buf->len,
+							  tail, taillen);
+	/* no need to complain about any failure, since pqcomm.c already did */
+	pfree(buf->data);
+	buf->data = NULL;
+}
+
 
 /* --------------------------------
  *		pq_puttextmessage - generate a character set-converted message in one step
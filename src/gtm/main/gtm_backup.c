@@ -3,18 +3,89 @@
 #include "gtm/gtm_txn.h"
 #include "gtm/gtm_seq.h"
 #include "gtm/gtm_backup.h"
+#include "gtm/gtm_xlog.h"
 #include "gtm/elog.h"
 
+#include <unistd.h>
+
 GTM_RWLock gtm_bkup_lock;
 bool gtm_need_bkup;
 
 extern char GTMControlFile[];
+extern char GTMControlFileTmp[];
+extern GTM_MutexLock control_lock;
+
+static void GTM_WriteCheckpoint(void);
+
+/*
+ * With the state log, the control file is a checkpoint: the log switches to
+ * a new segment, the control file is written aside, fsync'ed and renamed in
+ * place, and only then the previous segment is removed.
+ */
+static void GTM_WriteCheckpoint(void)
+{
+	FILE *f;
+
+	GTM_MutexLockAcquire(&control_lock);
 
+	GTM_RWLockAcquire(&gtm_bkup_lock, GTM_LOCKMODE_WRITE);
+	if (!gtm_need_bkup)
+	{
+		GTM_RWLockRelease(&gtm_bkup_lock);
+		GTM_MutexLockRelease(&control_lock);
+		return;
+	}
+	gtm_need_bkup = FALSE;
+	GTM_RWLockRelease(&gtm_bkup_lock);
 
+	GTM_XLogSwitch();
+
+	if ((f = fopen(GTMControlFileTmp, "w")) == NULL)
+	{
+		ereport(LOG, (errno,
+					  errmsg("Cannot open control file"),
+					  errhint("%s", strerror(errno))));
+		GTM_MutexLockRelease(&control_lock);
+		return;
+	}
+	GTM_WriteRestorePointVersion(f);
+	GTM_WriteRestorePointXid(f);
+	GTM_WriteRestorePointSeq(f);
+	if (fflush(f) != 0 || fsync(fileno(f)) != 0)
+	{
+		ereport(LOG, (errno,
+					  errmsg("Cannot write control file"),
+					  errhint("%s", strerror(errno))));
+		fclose(f);
+		GTM_MutexLockRelease(&control_lock);
+		return;
+	}
+	fclose(f);
+
+	if (rename(GTMControlFileTmp, GTMControlFile) != 0)
+	{
+		ereport(LOG, (errno,
+					  errmsg("Cannot rename control file"),
+					  errhint("%s", strerror(errno))));
+		GTM_MutexLockRelease(&control_lock);
+		return;
+	}
+	GTM_XLogRemoveOld();
+
+	GTM_MutexLockRelease(&control_lock);
+}
 
 void GTM_WriteRestorePoint(void)
 {
-	FILE *f = fopen(GTMControlFile, "w");
+	FILE *f;
+
+	if (GTMStateLog)
+	{
+		GTM_WriteCheckpoint();
+		return;
+	}
+
+	f = fopen(GTMControlFile, "w");
 
 	if (f == NULL)
 	{
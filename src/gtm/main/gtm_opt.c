@@ -42,6 +42,8 @@ const char *config_filename = CONFIG_FILENAME;
 extern char *NodeName;
 extern char *ListenAddresses;
 extern bool Backup_synchronously;
+extern bool GTMStandbyStreaming;
+extern bool GTMStateLog;
 extern int GTMPortNumber;
 extern char *active_addr;
 extern int active_port;
@@ -52,6 +54,7 @@ extern int log_min_messages;
 extern int tcp_keepalives_idle;
 extern int tcp_keepalives_count;
 extern int tcp_keepalives_interval;
+extern int GTMWorkerThreads;
 extern char *GTMDataDir;
 
 
@@ -132,6 +135,24 @@ struct config_bool ConfigureNamesBool[] =
 		&Backup_synchronously,
 		false, false, NULL
 	},
+	{
+		{GTM_OPTNAME_STANDBY_STREAM, GTMC_STARTUP,
+		   gettext_noop("Ships backups to GTM-Standby from a dedicated thread, in batches."),
+		   gettext_noop("Default value is off."),
+		   0
+		},
+		&GTMStandbyStreaming,
+		false, false, NULL
+	},
+	{
+		{GTM_OPTNAME_STATE_LOG, GTMC_STARTUP,
+		   gettext_noop("Logs GXID and sequence reservations to an fsync'ed state log."),
+		   gettext_noop("Default value is off."),
+		   0
+		},
+		&GTMStateLog,
+		false, false, NULL
+	},
 	/* End-of-list marker */
 	{
 		{NULL, 0, NULL, NULL, 0}, NULL, false, false, NULL
@@ -191,6 +212,16 @@ struct config_int ConfigureNamesInt[] =
 		0, 0, INT_MAX,
 		0, NULL
 	},
+	{
+		{GTM_OPTNAME_WORKER_THREADS, GTMC_STARTUP,
+			gettext_noop("Number of worker threads serving client connections."),
+			gettext_noop("Zero starts a dedicated thread for each connection."),
+			0
+		},
+		&GTMWorkerThreads,
+		0, 0, INT_MAX,
+		0, NULL
+	},
 	/* End-of-list marker */
 	{
 		{NULL, 0, NULL, NULL, 0}, NULL, 0, 0, 0, 0, NULL
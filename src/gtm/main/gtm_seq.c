@@ -31,22 +31,69 @@
 
 extern bool Backup_synchronously;
 
+#define SEQ_HASH_INIT_SIZE		1024
+#define SEQ_HASH_FILL_FACTOR	4
+#define SEQ_DB_INDEX_SIZE		256
+
 typedef struct GTM_SeqInfoHashBucket
 {
 	gtm_List   *shb_list;
 	GTM_RWLock	shb_lock;
 } GTM_SeqInfoHashBucket;
 
+/*
+ * Bucket of the secondary index of sequences by database, the sequences are
+ * chained through their gs_dbnext/gs_dbprev links.
+ */
+typedef struct GTM_SeqDBIndexBucket
+{
+	GTM_SeqInfo *sdb_head;
+	GTM_RWLock	sdb_lock;
+} GTM_SeqDBIndexBucket;
+
+/*
+ * The sequences are kept in a hash table of sht_nbuckets buckets, doubled
+ * when there are more than SEQ_HASH_FILL_FACTOR sequences per bucket. The
+ * hash value of each sequence is computed once and kept in gs_hash, so that
+ * lookups compare keys only when the hashes match and the table can be
+ * resized without hashing the keys again.
+ *
+ * Lookups, additions and removals hold sht_lock in read mode and lock only
+ * the buckets they touch. Resizing the table, renaming a sequence or
+ * dropping the sequences of a database is rare enough to hold sht_lock in
+ * write mode, and then needs no bucket lock. Locks are taken in this order:
+ * sht_lock, hash bucket, database index bucket, sequence.
+ */
+typedef struct GTM_SeqInfoHashTable
+{
+	GTM_RWLock	sht_lock;
+	uint32		sht_nbuckets;	/* always a power of 2 */
+	GTM_SeqInfoHashBucket *sht_buckets;
+	GTM_MutexLock sht_count_lock;
+	uint32		sht_count;		/* number of sequences in the table */
+	GTM_SeqDBIndexBucket sht_dbindex[SEQ_DB_INDEX_SIZE];
+} GTM_SeqInfoHashTable;
+
 typedef struct GTM_SeqAlteredInfo
 {
 	GTM_SequenceKey	curr_key;
 	GTM_SequenceKey	prev_key;
 } GTM_SeqAlteredInfo;
  
-#define SEQ_HASH_TABLE_SIZE		1024
-static GTM_SeqInfoHashBucket GTMSequences[SEQ_HASH_TABLE_SIZE];
+static GTM_SeqInfoHashTable GTMSequences;
+
+#define SEQ_HASH_BUCKET(hash) \
+	(&GTMSequences.sht_buckets[(hash) & (GTMSequences.sht_nbuckets - 1)])
+#define SEQ_DB_INDEX_BUCKET(dbhash) \
+	(&GTMSequences.sht_dbindex[(dbhash) % SEQ_DB_INDEX_SIZE])
 
+static uint32 seq_hash_bytes(const char *key, int len);
 static uint32 seq_gethash(GTM_SequenceKey key);
+static uint32 seq_getdbhash(GTM_SequenceKey key);
+static void seq_count_sequences(int delta);
+static void seq_grow_hashtable(void);
+static void seq_dbindex_link(GTM_SeqInfo *seqinfo);
+static void seq_dbindex_unlink(GTM_SeqInfo *seqinfo);
 static bool seq_keys_equal(GTM_SequenceKey key1, GTM_SequenceKey key2);
 static bool seq_key_dbname_equal(GTM_SequenceKey nsp, GTM_SequenceKey seq);
 static GTM_SeqInfo *seq_find_seqinfo(GTM_SequenceKey seqkey);
@@ -57,25 +104,164 @@ static int seq_rename_seqinfo(GTM_SeqInfo *seqinfo, GTM_SequenceKey newkey);
 static GTM_SequenceKey seq_copy_key_context(GTM_SequenceKey key,
 		MemoryContext context);
 static GTM_SequenceKey seq_copy_key(GTM_SequenceKey key);
+static bool seq_drop_one_with_dbkey(GTM_SeqInfo *seqinfo, int *res);
 static int seq_drop_with_dbkey(GTM_SequenceKey nsp);
 static bool GTM_NeedSeqRestoreUpdateInternal(GTM_SeqInfo *seqinfo);
+static bool seq_need_reservation(GTM_SeqInfo *seqinfo);
+static void advance_gs_value(GTM_SeqInfo *seqinfo);
 
 static GTM_Sequence get_rangemax(GTM_SeqInfo *seqinfo, GTM_Sequence range);
 
+/*
+ * FNV-1a hash of the given bytes
+ */
+static uint32
+seq_hash_bytes(const char *key, int len)
+{
+	uint32 hash = 2166136261U;
+	int ii;
+
+	for (ii = 0; ii < len; ii++)
+	{
+		hash ^= (unsigned char) key[ii];
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
 /*
  * Get the hash value given the sequence key
- *
- * XXX This should probably be replaced by a better hash function.
  */
 static uint32
 seq_gethash(GTM_SequenceKey key)
 {
-	uint32 total = 0;
-	int ii;
+	return seq_hash_bytes(key->gsk_key, key->gsk_keylen);
+}
+
+/*
+ * Get the hash value of the database part of the sequence key, that is what
+ * precedes the first dot. Database names containing a dot are not handled
+ * by the index, see seq_drop_with_dbkey.
+ */
+static uint32
+seq_getdbhash(GTM_SequenceKey key)
+{
+	char *dot = memchr(key->gsk_key, '.', key->gsk_keylen);
+
+	return seq_hash_bytes(key->gsk_key,
+						  dot ? dot - key->gsk_key : key->gsk_keylen);
+}
+
+/*
+ * Account for added or removed sequences
+ */
+static void
+seq_count_sequences(int delta)
+{
+	GTM_MutexLockAcquire(&GTMSequences.sht_count_lock);
+	GTMSequences.sht_count += delta;
+	GTM_MutexLockRelease(&GTMSequences.sht_count_lock);
+}
+
+/*
+ * Double the number of hash buckets if the table got too full.
+ */
+static void
+seq_grow_hashtable(void)
+{
+	GTM_SeqInfoHashBucket *newbuckets;
+	uint32 newnbuckets;
+	uint32 ii;
+	MemoryContext oldContext;
+
+	GTM_RWLockAcquire(&GTMSequences.sht_lock, GTM_LOCKMODE_WRITE);
+
+	/* Somebody else may have done it meanwhile */
+	if (GTMSequences.sht_count <=
+			GTMSequences.sht_nbuckets * SEQ_HASH_FILL_FACTOR)
+	{
+		GTM_RWLockRelease(&GTMSequences.sht_lock);
+		return;
+	}
+
+	newnbuckets = GTMSequences.sht_nbuckets * 2;
+
+	/*
+	 * Must use TopMostMemoryContext since the hash bucket links can survive
+	 * forever
+	 */
+	oldContext = MemoryContextSwitchTo(TopMostMemoryContext);
+
+	newbuckets = (GTM_SeqInfoHashBucket *)
+		palloc(newnbuckets * sizeof(GTM_SeqInfoHashBucket));
+	for (ii = 0; ii < newnbuckets; ii++)
+	{
+		newbuckets[ii].shb_list = gtm_NIL;
+		GTM_RWLockInit(&newbuckets[ii].shb_lock);
+	}
+
+	for (ii = 0; ii < GTMSequences.sht_nbuckets; ii++)
+	{
+		GTM_SeqInfoHashBucket *bucket = &GTMSequences.sht_buckets[ii];
+		gtm_ListCell *elem;
+
+		gtm_foreach(elem, bucket->shb_list)
+		{
+			GTM_SeqInfo *seqinfo = (GTM_SeqInfo *) gtm_lfirst(elem);
+			GTM_SeqInfoHashBucket *newbucket =
+				&newbuckets[seqinfo->gs_hash & (newnbuckets - 1)];
+
+			newbucket->shb_list = gtm_lappend(newbucket->shb_list, seqinfo);
+		}
+		gtm_list_free(bucket->shb_list);
+		GTM_RWLockDestroy(&bucket->shb_lock);
+	}
+	pfree(GTMSequences.sht_buckets);
+
+	MemoryContextSwitchTo(oldContext);
 
-	for (ii = 0; ii < key->gsk_keylen; ii++)
-		total += key->gsk_key[ii];
-	return (total % SEQ_HASH_TABLE_SIZE);
+	GTMSequences.sht_buckets = newbuckets;
+	GTMSequences.sht_nbuckets = newnbuckets;
+
+	elog(DEBUG1, "Sequence hash table grown to %u buckets", newnbuckets);
+
+	GTM_RWLockRelease(&GTMSequences.sht_lock);
+}
+
+/*
+ * Link the sequence into its database index bucket, the caller must hold
+ * the bucket lock or sht_lock in write mode.
+ */
+static void
+seq_dbindex_link(GTM_SeqInfo *seqinfo)
+{
+	GTM_SeqDBIndexBucket *dbbucket = SEQ_DB_INDEX_BUCKET(seqinfo->gs_dbhash);
+
+	seqinfo->gs_dbprev = NULL;
+	seqinfo->gs_dbnext = dbbucket->sdb_head;
+	if (dbbucket->sdb_head)
+		dbbucket->sdb_head->gs_dbprev = seqinfo;
+	dbbucket->sdb_head = seqinfo;
+}
+
+/*
+ * Unlink the sequence from its database index bucket, with the same locking
+ * as seq_dbindex_link.
+ */
+static void
+seq_dbindex_unlink(GTM_SeqInfo *seqinfo)
+{
+	GTM_SeqDBIndexBucket *dbbucket = SEQ_DB_INDEX_BUCKET(seqinfo->gs_dbhash);
+
+	if (seqinfo->gs_dbprev)
+		seqinfo->gs_dbprev->gs_dbnext = seqinfo->gs_dbnext;
+	else if (dbbucket->sdb_head == seqinfo)
+		dbbucket->sdb_head = seqinfo->gs_dbnext;
+	else
+		return;					/* not linked */
+	if (seqinfo->gs_dbnext)
+		seqinfo->gs_dbnext->gs_dbprev = seqinfo->gs_dbprev;
+	seqinfo->gs_dbnext = seqinfo->gs_dbprev = NULL;
 }
 
 /*
@@ -106,14 +292,17 @@ seq_find_seqinfo(GTM_SequenceKey seqkey)
 	gtm_ListCell *elem;
 	GTM_SeqInfo *curr_seqinfo = NULL;
 
-	bucket = &GTMSequences[hash];
+	GTM_RWLockAcquire(&GTMSequences.sht_lock, GTM_LOCKMODE_READ);
+
+	bucket = SEQ_HASH_BUCKET(hash);
 
 	GTM_RWLockAcquire(&bucket->shb_lock, GTM_LOCKMODE_READ);
 
 	gtm_foreach(elem, bucket->shb_list)
 	{
 		curr_seqinfo = (GTM_SeqInfo *) gtm_lfirst(elem);
-		if (seq_keys_equal(curr_seqinfo->gs_key, seqkey))
+		if (curr_seqinfo->gs_hash == hash &&
+			seq_keys_equal(curr_seqinfo->gs_key, seqkey))
 			break;
 		curr_seqinfo = NULL;
 	}
@@ -125,6 +314,8 @@ seq_find_seqinfo(GTM_SequenceKey seqkey)
 		{
 			elog(LOG, "Sequence not active");
 			GTM_RWLockRelease(&curr_seqinfo->gs_lock);
+			GTM_RWLockRelease(&bucket->shb_lock);
+			GTM_RWLockRelease(&GTMSequences.sht_lock);
 			return NULL;
 		}
 		Assert(curr_seqinfo->gs_ref_count != SEQ_MAX_REFCOUNT);
@@ -132,6 +323,7 @@ seq_find_seqinfo(GTM_SequenceKey seqkey)
 		GTM_RWLockRelease(&curr_seqinfo->gs_lock);
 	}
 	GTM_RWLockRelease(&bucket->shb_lock);
+	GTM_RWLockRelease(&GTMSequences.sht_lock);
 
 	return curr_seqinfo;
 }
@@ -169,9 +361,18 @@ seq_add_seqinfo(GTM_SeqInfo *seqinfo)
 {
 	uint32 hash = seq_gethash(seqinfo->gs_key);
 	GTM_SeqInfoHashBucket	*bucket;
+	GTM_SeqDBIndexBucket	*dbbucket;
 	gtm_ListCell *elem;
+	MemoryContext oldContext;
+	bool grow;
+
+	seqinfo->gs_hash = hash;
+	seqinfo->gs_dbhash = seq_getdbhash(seqinfo->gs_key);
+	seqinfo->gs_dbnext = seqinfo->gs_dbprev = NULL;
 
-	bucket = &GTMSequences[hash];
+	GTM_RWLockAcquire(&GTMSequences.sht_lock, GTM_LOCKMODE_READ);
+
+	bucket = SEQ_HASH_BUCKET(hash);
 
 	GTM_RWLockAcquire(&bucket->shb_lock, GTM_LOCKMODE_WRITE);
 
@@ -180,9 +381,11 @@ seq_add_seqinfo(GTM_SeqInfo *seqinfo)
 		GTM_SeqInfo *curr_seqinfo = NULL;
 		curr_seqinfo = (GTM_SeqInfo *) gtm_lfirst(elem);
 
-		if (seq_keys_equal(curr_seqinfo->gs_key, seqinfo->gs_key))
+		if (curr_seqinfo->gs_hash == hash &&
+			seq_keys_equal(curr_seqinfo->gs_key, seqinfo->gs_key))
 		{
 			GTM_RWLockRelease(&bucket->shb_lock);
+			GTM_RWLockRelease(&GTMSequences.sht_lock);
 			ereport(LOG,
 					(EEXIST,
 					 errmsg("Sequence with the given key already exists")));
@@ -193,9 +396,28 @@ seq_add_seqinfo(GTM_SeqInfo *seqinfo)
 	/*
 	 * Safe to add the structure to the list
 	 */
+	oldContext = MemoryContextSwitchTo(TopMostMemoryContext);
 	bucket->shb_list = gtm_lappend(bucket->shb_list, seqinfo);
+	MemoryContextSwitchTo(oldContext);
+
+	dbbucket = SEQ_DB_INDEX_BUCKET(seqinfo->gs_dbhash);
+	GTM_RWLockAcquire(&dbbucket->sdb_lock, GTM_LOCKMODE_WRITE);
+	seq_dbindex_link(seqinfo);
+	GTM_RWLockRelease(&dbbucket->sdb_lock);
+
 	GTM_RWLockRelease(&bucket->shb_lock);
 
+	GTM_MutexLockAcquire(&GTMSequences.sht_count_lock);
+	GTMSequences.sht_count++;
+	grow = (GTMSequences.sht_count >
+			GTMSequences.sht_nbuckets * SEQ_HASH_FILL_FACTOR);
+	GTM_MutexLockRelease(&GTMSequences.sht_count_lock);
+
+	GTM_RWLockRelease(&GTMSequences.sht_lock);
+
+	if (grow)
+		seq_grow_hashtable();
+
 	return 0;
 }
 
@@ -207,25 +429,38 @@ seq_add_seqinfo(GTM_SeqInfo *seqinfo)
 static int
 seq_remove_seqinfo(GTM_SeqInfo *seqinfo)
 {
-	uint32 hash = seq_gethash(seqinfo->gs_key);
 	GTM_SeqInfoHashBucket	*bucket;
+	GTM_SeqDBIndexBucket	*dbbucket;
+
+	GTM_RWLockAcquire(&GTMSequences.sht_lock, GTM_LOCKMODE_READ);
 
-	bucket = &GTMSequences[hash];
+	bucket = SEQ_HASH_BUCKET(seqinfo->gs_hash);
+	dbbucket = SEQ_DB_INDEX_BUCKET(seqinfo->gs_dbhash);
 
 	GTM_RWLockAcquire(&bucket->shb_lock, GTM_LOCKMODE_WRITE);
+	GTM_RWLockAcquire(&dbbucket->sdb_lock, GTM_LOCKMODE_WRITE);
 	GTM_RWLockAcquire(&seqinfo->gs_lock, GTM_LOCKMODE_WRITE);
 
 	if (seqinfo->gs_ref_count > 1)
 	{
 		seqinfo->gs_state = SEQ_STATE_DELETED;
 		GTM_RWLockRelease(&seqinfo->gs_lock);
+		GTM_RWLockRelease(&dbbucket->sdb_lock);
 		GTM_RWLockRelease(&bucket->shb_lock);
+		GTM_RWLockRelease(&GTMSequences.sht_lock);
 		return EBUSY;
 	}
 
-	bucket->shb_list = gtm_list_delete(bucket->shb_list, seqinfo);
+	if (gtm_list_member_ptr(bucket->shb_list, seqinfo))
+	{
+		bucket->shb_list = gtm_list_delete(bucket->shb_list, seqinfo);
+		seq_count_sequences(-1);
+	}
+	seq_dbindex_unlink(seqinfo);
 	GTM_RWLockRelease(&seqinfo->gs_lock);
+	GTM_RWLockRelease(&dbbucket->sdb_lock);
 	GTM_RWLockRelease(&bucket->shb_lock);
+	GTM_RWLockRelease(&GTMSequences.sht_lock);
 
 	return 0;
 }
@@ -239,35 +474,20 @@ seq_remove_seqinfo(GTM_SeqInfo *seqinfo)
 static int
 seq_rename_seqinfo(GTM_SeqInfo *seqinfo, GTM_SequenceKey newkey)
 {
-	uint32 oldhash = seq_gethash(seqinfo->gs_key);
 	uint32 newhash = seq_gethash(newkey);
 	GTM_SeqInfoHashBucket	*oldbucket;
 	GTM_SeqInfoHashBucket	*newbucket;
 	gtm_ListCell *elem;
 	MemoryContext oldContext;
 
-	oldbucket = &GTMSequences[oldhash];
-	newbucket = &GTMSequences[newhash];
-
 	/*
-	 * We must lock both old and new hash buckets. To avoid deadlock, we must
-	 * ensure that we don't try to lock the same bucket twice (in case old and
-	 * new keys are mapped to the same bucket) and also lock them in the same
-	 * order.
+	 * Renames are rare, lock the whole table rather than both buckets and
+	 * both database index buckets.
 	 */
-	if (oldhash < newhash)
-	{
-		GTM_RWLockAcquire(&oldbucket->shb_lock, GTM_LOCKMODE_WRITE);
-		GTM_RWLockAcquire(&newbucket->shb_lock, GTM_LOCKMODE_WRITE);
-	}
-	else if (oldhash > newhash)
-	{
-		GTM_RWLockAcquire(&newbucket->shb_lock, GTM_LOCKMODE_WRITE);
-		GTM_RWLockAcquire(&oldbucket->shb_lock, GTM_LOCKMODE_WRITE);
-	}
-	else
-		/* old and new buckets are just the same */
-		GTM_RWLockAcquire(&newbucket->shb_lock, GTM_LOCKMODE_WRITE);
+	GTM_RWLockAcquire(&GTMSequences.sht_lock, GTM_LOCKMODE_WRITE);
+
+	oldbucket = SEQ_HASH_BUCKET(seqinfo->gs_hash);
+	newbucket = SEQ_HASH_BUCKET(newhash);
 
 	GTM_RWLockAcquire(&seqinfo->gs_lock, GTM_LOCKMODE_WRITE);
 
@@ -276,16 +496,11 @@ seq_rename_seqinfo(GTM_SeqInfo *seqinfo, GTM_SequenceKey newkey)
 		GTM_SeqInfo *curr_seqinfo = NULL;
 		curr_seqinfo = (GTM_SeqInfo *) gtm_lfirst(elem);
 
-		if (seq_keys_equal(curr_seqinfo->gs_key, newkey))
+		if (curr_seqinfo->gs_hash == newhash &&
+			seq_keys_equal(curr_seqinfo->gs_key, newkey))
 		{
 			GTM_RWLockRelease(&seqinfo->gs_lock);
-			GTM_RWLockRelease(&newbucket->shb_lock);
-			/*
-			 * Release oldbucket lock but only if its not same as the new
-			 * bucket
-			 * */
-			if (oldhash != newhash)
-				GTM_RWLockRelease(&oldbucket->shb_lock);
+			GTM_RWLockRelease(&GTMSequences.sht_lock);
 			ereport(LOG,
 					(EEXIST,
 					 errmsg("Sequence with the given key already exists")));
@@ -303,11 +518,13 @@ seq_rename_seqinfo(GTM_SeqInfo *seqinfo, GTM_SequenceKey newkey)
 	newbucket->shb_list = gtm_lappend(newbucket->shb_list, seqinfo);
 	MemoryContextSwitchTo(oldContext);
 
+	seqinfo->gs_hash = newhash;
+	seq_dbindex_unlink(seqinfo);
+	seqinfo->gs_dbhash = seq_getdbhash(seqinfo->gs_key);
+	seq_dbindex_link(seqinfo);
+
 	GTM_RWLockRelease(&seqinfo->gs_lock);
-	GTM_RWLockRelease(&newbucket->shb_lock);
-	/* Release oldbucket lock but only if its not same as the new bucket */
-	if (oldhash != newhash)
-		GTM_RWLockRelease(&oldbucket->shb_lock);
+	GTM_RWLockRelease(&GTMSequences.sht_lock);
 
 	return 0;
 
@@ -453,6 +670,7 @@ GTM_SeqOpen(GTM_SequenceKey seqkey,
 	seqinfo->gs_last_values = NULL;
 
 	seqinfo->gs_backedUpValue = seqinfo->gs_value;
+	seqinfo->gs_backedUpLSN = InvalidGTMXLogPtr;
 
 	if ((errcode = seq_add_seqinfo(seqinfo)))
 	{
@@ -568,6 +786,7 @@ GTM_SeqRestore(GTM_SequenceKey seqkey,
 	seqinfo->gs_last_values = NULL;
 	seqinfo->gs_value = curval;
 	seqinfo->gs_backedUpValue = seqinfo->gs_value;
+	seqinfo->gs_backedUpLSN = InvalidGTMXLogPtr;
 
 	/*
 	 * Should we wrap around ?
@@ -677,80 +896,108 @@ seq_key_dbname_equal(GTM_SequenceKey nsp, GTM_SequenceKey seq)
 	return (memcmp(nsp->gsk_key, seq->gsk_key, nsp->gsk_keylen - 1) == 0);
 }
 
+/*
+ * Remove the sequence from the store on behalf of seq_drop_with_dbkey, the
+ * caller holds sht_lock in write mode. Returns true if the sequence was
+ * removed, false if it is in use and only marked for deletion, in which
+ * case *res is set to EBUSY.
+ */
+static bool
+seq_drop_one_with_dbkey(GTM_SeqInfo *seqinfo, int *res)
+{
+	GTM_SeqInfoHashBucket *bucket = SEQ_HASH_BUCKET(seqinfo->gs_hash);
+	bool deleted = false;
+
+	GTM_RWLockAcquire(&seqinfo->gs_lock, GTM_LOCKMODE_WRITE);
+
+	if (seqinfo->gs_ref_count > 1)
+	{
+		seqinfo->gs_state = SEQ_STATE_DELETED;
+
+		/* can not happen, be checked before called */
+		elog(LOG,"Sequence %s is in use, mark for deletion only",
+				 seqinfo->gs_key->gsk_key);
+
+		/*
+		 * Continue to delete other sequences linked to this dbname,
+		 * sequences in use are deleted later.
+		 */
+		*res = EBUSY;
+	}
+	else
+	{
+		/* Sequence is not is busy state, it can be deleted safely */
+
+		bucket->shb_list = gtm_list_delete(bucket->shb_list, seqinfo);
+		seq_dbindex_unlink(seqinfo);
+		GTMSequences.sht_count--;
+		elog(DEBUG1, "Sequence %s was deleted from GTM",
+				  seqinfo->gs_key->gsk_key);
+
+		deleted = true;
+	}
+	GTM_RWLockRelease(&seqinfo->gs_lock);
+
+	return deleted;
+}
+
 /*
  * Remove all sequences with given key depending on its type.
+ *
+ * Only the sequences sharing the database index bucket of the given database
+ * are examined. A database name containing a dot is not what the sequence
+ * keys were indexed by, all the sequences are examined then.
  */
 static int
 seq_drop_with_dbkey(GTM_SequenceKey nsp)
 {
-	int ii = 0;
-	GTM_SeqInfoHashBucket *bucket;
-	gtm_ListCell *cell, *prev;
-	GTM_SeqInfo *curr_seqinfo = NULL;
+	GTM_SeqInfo *curr_seqinfo;
+	GTM_SeqInfo *next_seqinfo;
 	int res = 0;
-	bool deleted;
 
-	for(ii = 0; ii < SEQ_HASH_TABLE_SIZE; ii++)
-	{
-		bucket = &GTMSequences[ii];
+	GTM_RWLockAcquire(&GTMSequences.sht_lock, GTM_LOCKMODE_WRITE);
 
-		GTM_RWLockAcquire(&bucket->shb_lock, GTM_LOCKMODE_READ);
+	if (memchr(nsp->gsk_key, '.', nsp->gsk_keylen - 1) == NULL)
+	{
+		uint32 dbhash = seq_hash_bytes(nsp->gsk_key, nsp->gsk_keylen - 1);
+		GTM_SeqDBIndexBucket *dbbucket = SEQ_DB_INDEX_BUCKET(dbhash);
 
-		prev = NULL;
-		cell = gtm_list_head(bucket->shb_list);
-		while (cell != NULL)
+		for (curr_seqinfo = dbbucket->sdb_head; curr_seqinfo != NULL;
+			 curr_seqinfo = next_seqinfo)
 		{
-			curr_seqinfo = (GTM_SeqInfo *) gtm_lfirst(cell);
-			deleted = false;
-
-			if (seq_key_dbname_equal(nsp, curr_seqinfo->gs_key))
-			{
-				GTM_RWLockAcquire(&curr_seqinfo->gs_lock, GTM_LOCKMODE_WRITE);
-
-				if (curr_seqinfo->gs_ref_count > 1)
-				{
-					curr_seqinfo->gs_state = SEQ_STATE_DELETED;
-
-					/* can not happen, be checked before called */
-					elog(LOG,"Sequence %s is in use, mark for deletion only",
-							 curr_seqinfo->gs_key->gsk_key);
+			next_seqinfo = curr_seqinfo->gs_dbnext;
 
-					/*
-					 * Continue to delete other sequences linked to this dbname,
-					 * sequences in use are deleted later.
-					 */
-					res = EBUSY;
-				}
-				else
-				{
-					/* Sequence is not is busy state, it can be deleted safely */
+			if (curr_seqinfo->gs_dbhash == dbhash &&
+				seq_key_dbname_equal(nsp, curr_seqinfo->gs_key))
+				seq_drop_one_with_dbkey(curr_seqinfo, &res);
+		}
+	}
+	else
+	{
+		uint32 ii;
 
-					bucket->shb_list = gtm_list_delete_cell(bucket->shb_list, cell, prev);
-					elog(DEBUG1, "Sequence %s was deleted from GTM",
-							  curr_seqinfo->gs_key->gsk_key);
+		for (ii = 0; ii < GTMSequences.sht_nbuckets; ii++)
+		{
+			GTM_SeqInfoHashBucket *bucket = &GTMSequences.sht_buckets[ii];
+			gtm_ListCell *cell, *next;
 
-					deleted = true;
-				}
-				GTM_RWLockRelease(&curr_seqinfo->gs_lock);
-			}
-			if (deleted)
+			for (cell = gtm_list_head(bucket->shb_list); cell != NULL;
+				 cell = next)
 			{
-				if (prev)
-					cell = gtm_lnext(prev);
-				else
-					cell = gtm_list_head(bucket->shb_list);
-			}
-			else
-			{
-				prev = cell;
-				cell = gtm_lnext(cell);
+				next = gtm_lnext(cell);
+				curr_seqinfo = (GTM_SeqInfo *) gtm_lfirst(cell);
+
+				if (seq_key_dbname_equal(nsp, curr_seqinfo->gs_key))
+					seq_drop_one_with_dbkey(curr_seqinfo, &res);
 			}
 		}
-		GTM_RWLockRelease(&bucket->shb_lock);
 	}
 
+	GTM_RWLockRelease(&GTMSequences.sht_lock);
+
 	return res;
 }
+
 /*
  * Rename an existing sequence with a new name
  */
@@ -940,6 +1187,7 @@ GTM_SeqGetNext(GTM_SequenceKey seqkey, char *coord_name,
 			   GTM_Sequence *result, GTM_Sequence *rangemax)
 {
 	GTM_SeqInfo *seqinfo = seq_find_seqinfo(seqkey);
+	GTM_XLogPtr backedUpLSN;
 
 	if (seqinfo == NULL)
 	{
@@ -1032,8 +1280,24 @@ GTM_SeqGetNext(GTM_SequenceKey seqkey, char *coord_name,
 	 */
 	seq_set_lastval(seqinfo, coord_name, coord_procid, *rangemax);
 	seqinfo->gs_value = *rangemax;
+
+	/*
+	 * With the state log, values are reserved RestoreDuration increments
+	 * ahead with a log record, which must be durable before any value past
+	 * the previous reservation is handed out.
+	 */
+	if (GTMStateLog && seq_need_reservation(seqinfo))
+	{
+		advance_gs_value(seqinfo);
+		seqinfo->gs_backedUpLSN = GTM_XLogInsertSeq(seqinfo->gs_key,
+													seqinfo->gs_backedUpValue);
+	}
+	backedUpLSN = seqinfo->gs_backedUpLSN;
+
 	GTM_RWLockRelease(&seqinfo->gs_lock);
 	seq_release_seqinfo(seqinfo);
+
+	GTM_XLogFlush(backedUpLSN);
 	return 0;
 }
 
@@ -1118,10 +1382,24 @@ GTM_InitSeqManager(void)
 {
 	int ii;
 
-	for (ii = 0; ii < SEQ_HASH_TABLE_SIZE; ii++)
+	GTM_RWLockInit(&GTMSequences.sht_lock);
+	GTM_MutexLockInit(&GTMSequences.sht_count_lock);
+	GTMSequences.sht_count = 0;
+	GTMSequences.sht_nbuckets = SEQ_HASH_INIT_SIZE;
+	GTMSequences.sht_buckets = (GTM_SeqInfoHashBucket *)
+		MemoryContextAlloc(TopMostMemoryContext,
+						   SEQ_HASH_INIT_SIZE * sizeof(GTM_SeqInfoHashBucket));
+
+	for (ii = 0; ii < SEQ_HASH_INIT_SIZE; ii++)
 	{
-		GTMSequences[ii].shb_list = gtm_NIL;
-		GTM_RWLockInit(&GTMSequences[ii].shb_lock);
+		GTMSequences.sht_buckets[ii].shb_list = gtm_NIL;
+		GTM_RWLockInit(&GTMSequences.sht_buckets[ii].shb_lock);
+	}
+
+	for (ii = 0; ii < SEQ_DB_INDEX_SIZE; ii++)
+	{
+		GTMSequences.sht_dbindex[ii].sdb_head = NULL;
+		GTM_RWLockInit(&GTMSequences.sht_dbindex[ii].sdb_lock);
 	}
 }
 
@@ -1215,7 +1493,7 @@ ProcessSequenceInitCommand(Port *myport, StringInfo message, bool is_backup)
 
 			/* Sync */
 			if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-				gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+				gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 			elog(DEBUG1, "open_sequence() returns rc %d.", rc);
 		}
@@ -1332,7 +1610,7 @@ ProcessSequenceAlterCommand(Port *myport, StringInfo message, bool is_backup)
 
 			/* Sync */
 			if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-				gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+				gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 			elog(DEBUG1, "alter_sequence() returns rc %d.", rc);
 		}
@@ -1380,19 +1658,22 @@ ProcessSequenceListCommand(Port *myport, StringInfo message)
 			(EPERM,
 			 errmsg("Operation not permitted under the standby mode.")));
 
+	GTM_RWLockAcquire(&GTMSequences.sht_lock, GTM_LOCKMODE_READ);
+
+	/* Size the array for the sequences there are, it may still have to grow */
 	seq_count = 0;
-	seq_maxcount = 1024;
+	seq_maxcount = Max(GTMSequences.sht_count, 1024);
 	seq_list = (GTM_SeqInfo **) palloc(seq_maxcount * sizeof(GTM_SeqInfo *));;
 
 	/*
 	 * Store pointers to all GTM_SeqInfo in the hash buckets into an array.
 	 */
-	for (i = 0 ; i < SEQ_HASH_TABLE_SIZE ; i++)
+	for (i = 0 ; i < GTMSequences.sht_nbuckets ; i++)
 	{
 		GTM_SeqInfoHashBucket *b;
 		gtm_ListCell *elem;
 
-		b = &GTMSequences[i];
+		b = &GTMSequences.sht_buckets[i];
 
 		GTM_RWLockAcquire(&b->shb_lock, GTM_LOCKMODE_READ);
 
@@ -1432,6 +1713,8 @@ ProcessSequenceListCommand(Port *myport, StringInfo message)
 		GTM_RWLockRelease(&b->shb_lock);
 	}
 
+	GTM_RWLockRelease(&GTMSequences.sht_lock);
+
 	pq_getmsgend(message);
 
 	pq_beginmessage(&buf, 'S');
@@ -1614,12 +1897,13 @@ ProcessSequenceGetNextCommand(Port *myport, StringInfo message, bool is_backup)
 
 			/* Sync */
 			if (Backup_synchronously &&(myport->remote_type != GTM_NODE_GTM_PROXY))
-				gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+				gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 			elog(DEBUG1, "get_next() returns GTM_Sequence %ld.", loc_seq);
 		}
-		/* Save control file info */
-        SaveControlInfo();
+		/* Save control file info, unless the state log has it */
+		if (!GTMStateLog)
+			SaveControlInfo();
 
 		/* Respond to the client */
 		pq_beginmessage(&buf, 'S');
@@ -1648,6 +1932,124 @@ ProcessSequenceGetNextCommand(Port *myport, StringInfo message, bool is_backup)
 	}
 }
 
+/*
+ * Process MSG_SEQUENCE_GET_NEXT_MULTI message
+ *
+ * This is a group of MSG_SEQUENCE_GET_NEXT requests, as collected by the GTM
+ * proxy. Each request is served independently and gets its own status, so a
+ * sequence running out of values does not fail the others. The standby still
+ * receives one MSG_BKUP_SEQUENCE_GET_NEXT per request.
+ */
+void
+ProcessSequenceGetNextMultiCommand(Port *myport, StringInfo message)
+{
+	GTM_SequenceKeyData seqkey[GTM_MAX_SEQUENCE_NEXT_MULTI];
+	char  *coord_name[GTM_MAX_SEQUENCE_NEXT_MULTI];
+	uint32 coord_procid[GTM_MAX_SEQUENCE_NEXT_MULTI];
+	GTM_Sequence range[GTM_MAX_SEQUENCE_NEXT_MULTI];
+	GTM_Sequence seqval[GTM_MAX_SEQUENCE_NEXT_MULTI];
+	GTM_Sequence rangemax[GTM_MAX_SEQUENCE_NEXT_MULTI];
+	int status[GTM_MAX_SEQUENCE_NEXT_MULTI];
+	StringInfoData buf;
+	int seq_count;
+	int ii;
+
+	seq_count = pq_getmsgint(message, sizeof (int));
+	if (seq_count <= 0 || seq_count > GTM_MAX_SEQUENCE_NEXT_MULTI)
+		ereport(ERROR,
+				(EINVAL,
+				 errmsg("Invalid number of sequences %d", seq_count)));
+
+	for (ii = 0; ii < seq_count; ii++)
+	{
+		uint32 coord_namelen;
+
+		seqkey[ii].gsk_keylen = pq_getmsgint(message, sizeof (seqkey[ii].gsk_keylen));
+		seqkey[ii].gsk_key = (char *)pq_getmsgbytes(message, seqkey[ii].gsk_keylen);
+
+		coord_namelen = pq_getmsgint(message, sizeof(coord_namelen));
+		if (coord_namelen > 0)
+			coord_name[ii] = (char *)pq_getmsgbytes(message, coord_namelen);
+		else
+			coord_name[ii] = NULL;
+		coord_procid[ii] = pq_getmsgint(message, sizeof(coord_procid[ii]));
+		memcpy(&range[ii], pq_getmsgbytes(message, sizeof (GTM_Sequence)),
+			   sizeof (GTM_Sequence));
+	}
+	pq_getmsgend(message);
+
+	for (ii = 0; ii < seq_count; ii++)
+	{
+		seqval[ii] = rangemax[ii] = InvalidSequenceValue;
+		if (GTM_SeqGetNext(&seqkey[ii], coord_name[ii], coord_procid[ii],
+						   range[ii], &seqval[ii], &rangemax[ii]))
+			status[ii] = STATUS_ERROR;
+		else
+			status[ii] = STATUS_OK;
+
+		elog(DEBUG1, "Getting next value %ld for sequence %s", seqval[ii],
+			 seqkey[ii].gsk_key);
+	}
+
+	/* Backup first */
+	if (GetMyThreadInfo->thr_conn->standby)
+	{
+		elog(DEBUG1, "calling get_next() for standby GTM %p.", GetMyThreadInfo->thr_conn->standby);
+
+		for (ii = 0; ii < seq_count; ii++)
+		{
+			GTM_Sequence loc_seq;
+			GTM_Sequence loc_rangemax;
+			GTM_Conn *oldconn = GetMyThreadInfo->thr_conn->standby;
+			int count = 0;
+
+			if (status[ii] != STATUS_OK)
+				continue;
+
+		retry:
+			bkup_get_next(GetMyThreadInfo->thr_conn->standby, &seqkey[ii],
+						  coord_name[ii], coord_procid[ii],
+						  range[ii], &loc_seq, &loc_rangemax);
+
+			if (gtm_standby_check_communication_error(&count, oldconn))
+				goto retry;
+		}
+
+		/* Sync */
+		if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
+			gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
+	}
+	/* Save control file info, unless the state log has it */
+	if (!GTMStateLog)
+		SaveControlInfo();
+
+	/* Respond to the client */
+	pq_beginmessage(&buf, 'S');
+	pq_sendint(&buf, SEQUENCE_GET_NEXT_MULTI_RESULT, 4);
+	if (myport->remote_type == GTM_NODE_GTM_PROXY)
+	{
+		GTM_ProxyMsgHeader proxyhdr;
+		proxyhdr.ph_conid = myport->conn_id;
+		pq_sendbytes(&buf, (char *)&proxyhdr, sizeof (GTM_ProxyMsgHeader));
+	}
+	pq_sendbytes(&buf, (char *)&seq_count, sizeof (seq_count));
+	for (ii = 0; ii < seq_count; ii++)
+	{
+		pq_sendbytes(&buf, (char *)&status[ii], sizeof (int));
+		pq_sendbytes(&buf, (char *)&seqval[ii], sizeof (GTM_Sequence));
+		pq_sendbytes(&buf, (char *)&rangemax[ii], sizeof (GTM_Sequence));
+	}
+	pq_endmessage(myport, &buf);
+
+	if (myport->remote_type != GTM_NODE_GTM_PROXY)
+	{
+		/* Flush to the standby first */
+		if (GetMyThreadInfo->thr_conn->standby)
+			gtmpqFlush(GetMyThreadInfo->thr_conn->standby);
+		pq_flush(myport);
+	}
+}
+
 /*
  * Process MSG_SEQUENCE_SET_VAL/MSG_BKUP_SEQUENCE_SET_VAL message
  *
@@ -1727,7 +2129,7 @@ ProcessSequenceSetValCommand(Port *myport, StringInfo message, bool is_backup)
 
 			/* Sync */
 			if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-				gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+				gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 			elog(DEBUG1, "set_val() returns rc %d.", rc);
 		}
@@ -1800,7 +2202,7 @@ ProcessSequenceResetCommand(Port *myport, StringInfo message, bool is_backup)
 
 			/* Sync */
 			if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-				gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+				gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 			elog(DEBUG1, "reset_sequence() returns rc %d.", rc);
 		}
@@ -1885,7 +2287,7 @@ ProcessSequenceCloseCommand(Port *myport, StringInfo message, bool is_backup)
 
 			/* Sync */
 			if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-				gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+				gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 			elog(DEBUG1, "close_sequence() returns rc %d.", rc);
 		}
@@ -1986,7 +2388,7 @@ ProcessSequenceRenameCommand(Port *myport, StringInfo message, bool is_backup)
 
 			/* Sync */
 			if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-				gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+				gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 			elog(DEBUG1, "rename_sequence() returns rc %d.", rc);
 		}
@@ -2158,6 +2560,47 @@ static GTM_Sequence distanceToBackedUpSeqValue(GTM_SeqInfo *seqinfo)
 	return 0;
 }
 
+/*
+ * Has the sequence reached the value it is reserved up to?
+ */
+static bool
+seq_need_reservation(GTM_SeqInfo *seqinfo)
+{
+	GTM_Sequence distance = distanceToBackedUpSeqValue(seqinfo);
+
+	if (SEQ_IS_ASCENDING(seqinfo))
+		return (distance < seqinfo->gs_increment_by);
+	else
+		return (distance > seqinfo->gs_increment_by);
+}
+
+/*
+ * Replay a sequence reservation of the state log, at startup. Reservations
+ * older than the control file would move the sequence backwards, they are
+ * ignored.
+ */
+void
+GTM_RestoreSeqReservation(GTM_SequenceKey seqkey, GTM_Sequence value)
+{
+	GTM_SeqInfo *seqinfo = seq_find_seqinfo(seqkey);
+
+	if (seqinfo == NULL)
+		return;
+
+	GTM_RWLockAcquire(&seqinfo->gs_lock, GTM_LOCKMODE_WRITE);
+	if (!SEQ_IS_CALLED(seqinfo) ||
+		(SEQ_IS_ASCENDING(seqinfo) ? value > seqinfo->gs_value :
+		 value < seqinfo->gs_value))
+	{
+		elog(DEBUG1, "Restoring reserved value %ld of sequence %s from the state log",
+			 value, seqinfo->gs_key->gsk_key);
+		seqinfo->gs_value = seqinfo->gs_backedUpValue = value;
+		seqinfo->gs_called = true;
+	}
+	GTM_RWLockRelease(&seqinfo->gs_lock);
+	seq_release_seqinfo(seqinfo);
+}
+
 bool GTM_NeedSeqRestoreUpdate(GTM_SequenceKey seqkey)
 {
 	GTM_SeqInfo *seqinfo = seq_find_seqinfo(seqkey);
@@ -2188,12 +2631,15 @@ GTM_SaveSeqInfo2(FILE *ctlf, bool isBackup)
 	GTM_SeqInfoHashBucket *bucket;
 	gtm_ListCell *elem;
 	GTM_SeqInfo *seqinfo = NULL;
-	int hash;
+	uint32 hash;
 	char buffer[1024];
+	GTM_Sequence value;
 
-	for (hash = 0; hash < SEQ_HASH_TABLE_SIZE; hash++)
+	GTM_RWLockAcquire(&GTMSequences.sht_lock, GTM_LOCKMODE_READ);
+
+	for (hash = 0; hash < GTMSequences.sht_nbuckets; hash++)
 	{
-		bucket = &GTMSequences[hash];
+		bucket = &GTMSequences.sht_buckets[hash];
 
 		GTM_RWLockAcquire(&bucket->shb_lock, GTM_LOCKMODE_READ);
 
@@ -2208,9 +2654,18 @@ GTM_SaveSeqInfo2(FILE *ctlf, bool isBackup)
 
 			GTM_RWLockAcquire(&seqinfo->gs_lock, GTM_LOCKMODE_READ);
 
+			/*
+			 * With the state log, a sequence may have gone past its last
+			 * reservation, after setval for instance.
+			 */
+			if (isBackup && GTMStateLog && seq_need_reservation(seqinfo))
+				value = seqinfo->gs_value;
+			else
+				value = isBackup ? seqinfo->gs_backedUpValue : seqinfo->gs_value;
+
 			encode_seq_key(seqinfo->gs_key, buffer);
 			fprintf(ctlf, "%s\t%ld\t%ld\t%ld\t%ld\t%ld\t%c\t%c\t%x\n",
-					buffer, isBackup ? seqinfo->gs_backedUpValue : seqinfo->gs_value,
+					buffer, value,
 					seqinfo->gs_init_value, seqinfo->gs_increment_by,
 					seqinfo->gs_min_value, seqinfo->gs_max_value,
 					(seqinfo->gs_cycle ? 't' : 'f'),
@@ -2222,6 +2677,8 @@ GTM_SaveSeqInfo2(FILE *ctlf, bool isBackup)
 		GTM_RWLockRelease(&bucket->shb_lock);
 	}
 
+	GTM_RWLockRelease(&GTMSequences.sht_lock);
+
 }
 
 void GTM_SaveSeqInfo(FILE *ctlf)
@@ -2268,11 +2725,13 @@ GTM_UpdateRestorePointSeq(void)
 	GTM_SeqInfoHashBucket *bucket;
 	gtm_ListCell *elem;
 	GTM_SeqInfo *seqinfo = NULL;
-	int hash;
+	uint32 hash;
 
-	for (hash = 0; hash < SEQ_HASH_TABLE_SIZE; hash++)
+	GTM_RWLockAcquire(&GTMSequences.sht_lock, GTM_LOCKMODE_READ);
+
+	for (hash = 0; hash < GTMSequences.sht_nbuckets; hash++)
 	{
-		bucket = &GTMSequences[hash];
+		bucket = &GTMSequences.sht_buckets[hash];
 
 		GTM_RWLockAcquire(&bucket->shb_lock, GTM_LOCKMODE_READ);
 
@@ -2293,12 +2752,16 @@ GTM_UpdateRestorePointSeq(void)
 		GTM_RWLockRelease(&bucket->shb_lock);
 	}
 
+	GTM_RWLockRelease(&GTMSequences.sht_lock);
+
 }
 
 
 void GTM_WriteRestorePointSeq(FILE *ctlf)
 {
-	GTM_UpdateRestorePointSeq();
+	/* With the state log, the reservations are durable already */
+	if (!GTMStateLog)
+		GTM_UpdateRestorePointSeq();
 	GTM_SaveSeqInfo2(ctlf, TRUE);
 }
 
@@ -2314,9 +2777,11 @@ GTM_CleanupSeqSession(char *coord_name, int coord_procid)
 	elog(DEBUG1, "Clean up Sequences used in session %s:%d",
 			coord_name, coord_procid);
 
-	for (i = 0; i < SEQ_HASH_TABLE_SIZE; i++)
+	GTM_RWLockAcquire(&GTMSequences.sht_lock, GTM_LOCKMODE_READ);
+
+	for (i = 0; i < GTMSequences.sht_nbuckets; i++)
 	{
-		GTM_SeqInfoHashBucket *bucket = &GTMSequences[i];
+		GTM_SeqInfoHashBucket *bucket = &GTMSequences.sht_buckets[i];
 		gtm_ListCell *elem;
 		GTM_SeqInfo *curr_seqinfo;
 
@@ -2361,6 +2826,8 @@ GTM_CleanupSeqSession(char *coord_name, int coord_procid)
 		}
 		GTM_RWLockRelease(&bucket->shb_lock);
 	}
+
+	GTM_RWLockRelease(&GTMSequences.sht_lock);
 }
 
 /*
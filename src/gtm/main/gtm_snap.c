@@ -28,15 +28,26 @@
  * for all transactions in the request. As computing the snapshot is quite
  * expensive, this is a major benefit.
  *
+ * Beyond that, the last snapshot built is cached along with the snapshot
+ * generation of GTMTransactions, which advances only when the result might
+ * change. Requests arriving before another transaction completes, from any
+ * client, get a copy of the cached snapshot.
+ *
  * There are also two functions handling the communication with GTM clients
  * (either nodes or GTM proxies):
  *
  *		ProcessGetSnapshotCommand
  *		ProcessGetSnapshotCommandMulti
+ *		ProcessGetSnapshotCommandDelta
  *
  * These functions are responsible for parsing of network messages, and then
  * simply call GTM_GetTransactionSnapshot with the proper arguments.
  *
+ * The cache also keeps a few older snapshots, and the GXIDs of all cached
+ * snapshots are sorted. A client sending the generation of the snapshot it
+ * already has with MSG_SNAPSHOT_GET_DELTA then only receives the GXIDs that
+ * were removed or added since, as long as that snapshot is still cached.
+ *
  *
  * Memory management (GTM_SnapshotData)
  * ------------------------------------
@@ -95,6 +106,247 @@
 #include "gtm/libpq-int.h"
 #include "gtm/pqformat.h"
 
+/*
+ * Number of recently built snapshots kept in the cache. Only the latest one
+ * is handed out, the older ones are the bases MSG_SNAPSHOT_GET_DELTA can
+ * compute a delta from.
+ */
+#define GTM_SNAPSHOT_HISTORY	8
+
+typedef struct GTM_CachedSnapshot
+{
+	uint64				cs_generation;		/* 0 when the entry is unused */
+	GTM_SnapshotData	cs_snapshot;
+	GlobalTransactionId	cs_xip[GTM_MAX_GLOBAL_TRANSACTIONS];
+} GTM_CachedSnapshot;
+
+/*
+ * Cache of the last snapshots built, each tagged with the snapshot generation
+ * of GTMTransactions it was built at. They hold exactly the data sent to the
+ * clients, so as long as no transaction completes, snapshot requests are
+ * served with a copy of the current entry and never walk the list of open
+ * transactions.
+ */
+typedef struct GTM_SnapshotCache
+{
+	GTM_RWLock			sc_lock;
+	int					sc_current;			/* latest entry in sc_history */
+	GTM_CachedSnapshot	sc_history[GTM_SNAPSHOT_HISTORY];
+} GTM_SnapshotCache;
+
+static GTM_SnapshotCache GTMSnapshotCache;
+
+static void GTM_BuildSnapshotData(GTM_Snapshot snapshot);
+static void GTM_CopySnapshotData(GTM_Snapshot dst, GTM_Snapshot src);
+static bool GTM_GetSnapshotDelta(uint64 base_generation, GTM_Snapshot snapshot,
+					 GlobalTransactionId *removed, int *nremoved,
+					 GlobalTransactionId *added, int *nadded);
+static int gxid_cmp(const void *a, const void *b);
+
+/*
+ * Initialize the snapshot cache. Must be called before any snapshot is
+ * requested.
+ */
+void
+GTM_InitSnapshotCache(void)
+{
+	int			ii;
+
+	GTM_RWLockInit(&GTMSnapshotCache.sc_lock);
+	GTMSnapshotCache.sc_current = 0;
+	for (ii = 0; ii < GTM_SNAPSHOT_HISTORY; ii++)
+	{
+		GTM_CachedSnapshot *entry = &GTMSnapshotCache.sc_history[ii];
+
+		entry->cs_generation = 0;
+		entry->cs_snapshot.sn_xip = entry->cs_xip;
+	}
+}
+
+/*
+ * qsort comparator for GXIDs. Snapshots only need some total order for the
+ * deltas to be computed by merging, so wraparound does not matter here.
+ */
+static int
+gxid_cmp(const void *a, const void *b)
+{
+	GlobalTransactionId xa = *(const GlobalTransactionId *) a;
+	GlobalTransactionId xb = *(const GlobalTransactionId *) b;
+
+	if (xa < xb)
+		return -1;
+	if (xa > xb)
+		return 1;
+	return 0;
+}
+
+/*
+ * Compute xmin, xmax and the running GXIDs from the list of open
+ * transactions. The caller must hold TransArrayLock.
+ */
+static void
+GTM_BuildSnapshotData(GTM_Snapshot snapshot)
+{
+	GlobalTransactionId xmin;
+	GlobalTransactionId xmax;
+	GlobalTransactionId globalxmin;
+	int			count = 0;
+	gtm_ListCell *elem = NULL;
+
+	/* xmax is always latestCompletedXid + 1 */
+	xmax = GTMTransactions.gt_latestCompletedXid;
+	Assert(GlobalTransactionIdIsNormal(xmax));
+	GlobalTransactionIdAdvance(xmax);
+
+	/* initialize xmin calculation with xmax */
+	globalxmin = xmin = xmax;
+
+	/*
+	 * Spin over transaction list checking xid, xmin, and subxids.  The goal is to
+	 * gather all active xids and find the lowest xmin
+	 */
+	gtm_foreach(elem, GTMTransactions.gt_open_transactions)
+	{
+		volatile GTM_TransactionInfo *gtm_txninfo = (GTM_TransactionInfo *)gtm_lfirst(elem);
+		GlobalTransactionId xid;
+
+		/* Don't take into account LAZY VACUUMs */
+		if (gtm_txninfo->gti_vacuum)
+			continue;
+
+		/* Update globalxmin to be the smallest valid xmin */
+		xid = gtm_txninfo->gti_xmin;		/* fetch just once */
+		if (GlobalTransactionIdIsNormal(xid) &&
+			GlobalTransactionIdPrecedes(xid, globalxmin))
+			globalxmin = xid;
+
+		/* Fetch xid just once - see GetNewTransactionId */
+		xid = gtm_txninfo->gti_gxid;
+
+		/*
+		 * If the transaction has been assigned an xid < xmax we add it to the
+		 * snapshot, and update xmin if necessary.	There's no need to store
+		 * XIDs >= xmax, since we'll treat them as running anyway.  We don't
+		 * bother to examine their subxids either.
+		 *
+		 * We don't include our own XID (if any) in the snapshot, but we must
+		 * include it into xmin.
+		 */
+		if (GlobalTransactionIdIsNormal(xid))
+		{
+			/*
+			 * Unlike Postgres, we include the GXID of the current transaction
+			 * as well in the snapshot. This is necessary because the same
+			 * snapshot is shared by multiple backends through GTM proxy and
+			 * the GXID will vary for each backend.
+			 *
+			 * XXX We should confirm that this does not have any adverse effect
+			 * on the MVCC visibility and check if any changes are related to
+			 * the MVCC checks because of the change
+			 */
+			if (GlobalTransactionIdFollowsOrEquals(xid, xmax))
+				continue;
+			if (GlobalTransactionIdPrecedes(xid, xmin))
+				xmin = xid;
+			snapshot->sn_xip[count++] = xid;
+		}
+	}
+
+	/*
+	 * Update globalxmin to include actual process xids.  This is a slightly
+	 * different way of computing it than GetOldestXmin uses, but should give
+	 * the same result.
+	 */
+	if (GlobalTransactionIdPrecedes(xmin, globalxmin))
+		globalxmin = xmin;
+
+
+	/* Keep the GXIDs sorted, so that deltas can be computed by merging */
+	qsort(snapshot->sn_xip, count, sizeof (GlobalTransactionId), gxid_cmp);
+
+	snapshot->sn_xmin = xmin;
+	snapshot->sn_xmax = xmax;
+	snapshot->sn_xcnt = count;
+}
+
+/*
+ * Copy snapshot data into a snapshot with a preallocated sn_xip array.
+ */
+static void
+GTM_CopySnapshotData(GTM_Snapshot dst, GTM_Snapshot src)
+{
+	dst->sn_xmin = src->sn_xmin;
+	dst->sn_xmax = src->sn_xmax;
+	dst->sn_xcnt = src->sn_xcnt;
+	memcpy(dst->sn_xip, src->sn_xip,
+		   sizeof (GlobalTransactionId) * src->sn_xcnt);
+}
+
+/*
+ * Compute the GXIDs removed from and added to the snapshot of the given base
+ * generation to get the (newer) snapshot passed in. The output arrays need
+ * space for snapshot->sn_xcnt entries.
+ *
+ * Returns false if the base snapshot is no longer in the cache, or if the
+ * delta would not be smaller than the snapshot itself. The caller should then
+ * send the full snapshot.
+ */
+static bool
+GTM_GetSnapshotDelta(uint64 base_generation, GTM_Snapshot snapshot,
+					 GlobalTransactionId *removed, int *nremoved,
+					 GlobalTransactionId *added, int *nadded)
+{
+	GTM_Snapshot base = NULL;
+	bool		found = true;
+	int			ii;
+	int			jj;
+	int			limit = snapshot->sn_xcnt;
+
+	*nremoved = *nadded = 0;
+
+	if (base_generation == 0)
+		return false;
+
+	GTM_RWLockAcquire(&GTMSnapshotCache.sc_lock, GTM_LOCKMODE_READ);
+
+	for (ii = 0; ii < GTM_SNAPSHOT_HISTORY; ii++)
+	{
+		if (GTMSnapshotCache.sc_history[ii].cs_generation == base_generation)
+		{
+			base = &GTMSnapshotCache.sc_history[ii].cs_snapshot;
+			break;
+		}
+	}
+
+	if (base == NULL)
+	{
+		GTM_RWLockRelease(&GTMSnapshotCache.sc_lock);
+		return false;
+	}
+
+	/* Both arrays are sorted, so a single merge pass finds the differences */
+	ii = jj = 0;
+	while (found && (ii < base->sn_xcnt || jj < snapshot->sn_xcnt))
+	{
+		if (*nremoved + *nadded >= limit)
+			found = false;
+		else if (jj >= snapshot->sn_xcnt ||
+				 (ii < base->sn_xcnt && base->sn_xip[ii] < snapshot->sn_xip[jj]))
+			removed[(*nremoved)++] = base->sn_xip[ii++];
+		else if (ii >= base->sn_xcnt || snapshot->sn_xip[jj] < base->sn_xip[ii])
+			added[(*nadded)++] = snapshot->sn_xip[jj++];
+		else
+		{
+			ii++;
+			jj++;
+		}
+	}
+
+	GTM_RWLockRelease(&GTMSnapshotCache.sc_lock);
+
+	return found && (*nremoved + *nadded < limit);
+}
+
 /*
  * GTM_GetTransactionSnapshot
  *		Compute and store snapshot(s) for specified transactions.
@@ -125,13 +377,13 @@
  * not statically allocated (see xip allocation below).
  */
 static GTM_Snapshot
-GTM_GetTransactionSnapshot(GTM_TransactionHandle handle[], int txn_count, int *status)
+GTM_GetTransactionSnapshot(GTM_TransactionHandle handle[], int txn_count,
+						   int *status, uint64 *snapshot_generation)
 {
 	GlobalTransactionId xmin;
-	GlobalTransactionId xmax;
-	GlobalTransactionId globalxmin;
-	int			count = 0;
-	gtm_ListCell *elem = NULL;
+	uint64		generation;
+	bool		cached = false;
+	GTM_CachedSnapshot *entry;
 	int ii;
 
 	/*
@@ -205,77 +457,46 @@ GTM_GetTransactionSnapshot(GTM_TransactionHandle handle[], int txn_count, int *s
 	 */
 	GTM_RWLockAcquire(&GTMTransactions.gt_TransArrayLock, GTM_LOCKMODE_READ);
 
-	/* xmax is always latestCompletedXid + 1 */
-	xmax = GTMTransactions.gt_latestCompletedXid;
-	Assert(GlobalTransactionIdIsNormal(xmax));
-	GlobalTransactionIdAdvance(xmax);
-
-	/* initialize xmin calculation with xmax */
-	globalxmin = xmin = xmax;
+	generation = GTMTransactions.gt_snapshot_generation;
 
 	/*
-	 * Spin over transaction list checking xid, xmin, and subxids.  The goal is to
-	 * gather all active xids and find the lowest xmin
+	 * If nothing changed since the cached snapshot was built, just copy it.
 	 */
-	gtm_foreach(elem, GTMTransactions.gt_open_transactions)
+	GTM_RWLockAcquire(&GTMSnapshotCache.sc_lock, GTM_LOCKMODE_READ);
+	entry = &GTMSnapshotCache.sc_history[GTMSnapshotCache.sc_current];
+	if (entry->cs_generation == generation)
 	{
-		volatile GTM_TransactionInfo *gtm_txninfo = (GTM_TransactionInfo *)gtm_lfirst(elem);
-		GlobalTransactionId xid;
-
-		/* Don't take into account LAZY VACUUMs */
-		if (gtm_txninfo->gti_vacuum)
-			continue;
-
-		/* Update globalxmin to be the smallest valid xmin */
-		xid = gtm_txninfo->gti_xmin;		/* fetch just once */
-		if (GlobalTransactionIdIsNormal(xid) &&
-			GlobalTransactionIdPrecedes(xid, globalxmin))
-			globalxmin = xid;
-
-		/* Fetch xid just once - see GetNewTransactionId */
-		xid = gtm_txninfo->gti_gxid;
+		GTM_CopySnapshotData(snapshot, &entry->cs_snapshot);
+		cached = true;
+	}
+	GTM_RWLockRelease(&GTMSnapshotCache.sc_lock);
 
+	if (!cached)
+	{
 		/*
-		 * If the transaction has been assigned an xid < xmax we add it to the
-		 * snapshot, and update xmin if necessary.	There's no need to store
-		 * XIDs >= xmax, since we'll treat them as running anyway.  We don't
-		 * bother to examine their subxids either.
-		 *
-		 * We don't include our own XID (if any) in the snapshot, but we must
-		 * include it into xmin.
+		 * Build the snapshot directly in the cache, replacing the oldest
+		 * entry. Requests arriving meanwhile wait for the lock and then reuse
+		 * the result, instead of walking the list of open transactions once
+		 * more.
 		 */
-		if (GlobalTransactionIdIsNormal(xid))
+		GTM_RWLockAcquire(&GTMSnapshotCache.sc_lock, GTM_LOCKMODE_WRITE);
+		entry = &GTMSnapshotCache.sc_history[GTMSnapshotCache.sc_current];
+		if (entry->cs_generation != generation)
 		{
-			/*
-			 * Unlike Postgres, we include the GXID of the current transaction
-			 * as well in the snapshot. This is necessary because the same
-			 * snapshot is shared by multiple backends through GTM proxy and
-			 * the GXID will vary for each backend.
-			 *
-			 * XXX We should confirm that this does not have any adverse effect
-			 * on the MVCC visibility and check if any changes are related to
-			 * the MVCC checks because of the change
-			 */
-			if (GlobalTransactionIdFollowsOrEquals(xid, xmax))
-				continue;
-			if (GlobalTransactionIdPrecedes(xid, xmin))
-				xmin = xid;
-			snapshot->sn_xip[count++] = xid;
+			GTMSnapshotCache.sc_current =
+				(GTMSnapshotCache.sc_current + 1) % GTM_SNAPSHOT_HISTORY;
+			entry = &GTMSnapshotCache.sc_history[GTMSnapshotCache.sc_current];
+			GTM_BuildSnapshotData(&entry->cs_snapshot);
+			entry->cs_generation = generation;
 		}
+		GTM_CopySnapshotData(snapshot, &entry->cs_snapshot);
+		GTM_RWLockRelease(&GTMSnapshotCache.sc_lock);
 	}
 
-	/*
-	 * Update globalxmin to include actual process xids.  This is a slightly
-	 * different way of computing it than GetOldestXmin uses, but should give
-	 * the same result.
-	 */
-	if (GlobalTransactionIdPrecedes(xmin, globalxmin))
-		globalxmin = xmin;
+	if (snapshot_generation)
+		*snapshot_generation = generation;
 
-
-	snapshot->sn_xmin = xmin;
-	snapshot->sn_xmax = xmax;
-	snapshot->sn_xcnt = count;
+	xmin = snapshot->sn_xmin;
 
 	/*
 	 * Now, before the proc array lock is released, set the xmin in the txninfo
@@ -318,11 +539,7 @@ GTM_GetTransactionSnapshot(GTM_TransactionHandle handle[], int txn_count, int *s
 						if (mysnap->sn_xip == NULL)
 							ereport(ERROR, (ENOMEM, errmsg("out of memory")));
 					}
-					mysnap->sn_xmin = snapshot->sn_xmin;
-					mysnap->sn_xmax = snapshot->sn_xmax;
-					mysnap->sn_xcnt = snapshot->sn_xcnt;
-					memcpy(mysnap->sn_xip, snapshot->sn_xip,
-							sizeof (GlobalTransactionId) * snapshot->sn_xcnt);
+					GTM_CopySnapshotData(mysnap, snapshot);
 				}
 				mygtm_txninfo->gti_snapshot_set = true;
 			}
@@ -339,11 +556,7 @@ GTM_GetTransactionSnapshot(GTM_TransactionHandle handle[], int txn_count, int *s
 				if (mysnap->sn_xip == NULL)
 					ereport(ERROR, (ENOMEM, errmsg("out of memory")));
 			}
-			mysnap->sn_xmin = snapshot->sn_xmin;
-			mysnap->sn_xmax = snapshot->sn_xmax;
-			mysnap->sn_xcnt = snapshot->sn_xcnt;
-			memcpy(mysnap->sn_xip, snapshot->sn_xip,
-					sizeof (GlobalTransactionId) * snapshot->sn_xcnt);
+			GTM_CopySnapshotData(mysnap, snapshot);
 		}
 
 		if ((mygtm_txninfo != NULL) &&
@@ -402,13 +615,16 @@ ProcessGetSnapshotCommand(Port *myport, StringInfo message, bool get_gxid)
 	/*
 	 * Get a fresh snapshot
 	 */
-	if ((snapshot = GTM_GetTransactionSnapshot(&txn, 1, &status)) == NULL)
+	if ((snapshot = GTM_GetTransactionSnapshot(&txn, 1, &status, NULL)) == NULL)
 		ereport(ERROR,
 				(EINVAL,
 				 errmsg("Failed to get a snapshot")));
 
 	MemoryContextSwitchTo(oldContext);
 
+	gtm_stat_record(&GetMyThreadInfo->thr_stats.gts_snapshots,
+					snapshot->sn_xcnt);
+
 	pq_beginmessage(&buf, 'S');
 	pq_sendint(&buf, get_gxid ? SNAPSHOT_GXID_GET_RESULT : SNAPSHOT_GET_RESULT, 4);
 	if (myport->remote_type == GTM_NODE_GTM_PROXY)
@@ -423,13 +639,132 @@ ProcessGetSnapshotCommand(Port *myport, StringInfo message, bool get_gxid)
 	pq_sendbytes(&buf, (char *)&snapshot->sn_xmin, sizeof (GlobalTransactionId));
 	pq_sendbytes(&buf, (char *)&snapshot->sn_xmax, sizeof (GlobalTransactionId));
 	pq_sendint(&buf, snapshot->sn_xcnt, sizeof (int));
-	pq_sendbytes(&buf, (char *)snapshot->sn_xip,
-				 sizeof(GlobalTransactionId) * snapshot->sn_xcnt);
-	pq_endmessage(myport, &buf);
+	/* The GXIDs go out straight from the snapshot */
+	pq_endmessage_tail(myport, &buf, (char *)snapshot->sn_xip,
+					   sizeof(GlobalTransactionId) * snapshot->sn_xcnt);
+
+	if (myport->remote_type != GTM_NODE_GTM_PROXY)
+		pq_flush(myport);
+
+	return;
+}
+
+/*
+ * Process MSG_SNAPSHOT_GET_DELTA command
+ *
+ * Same as MSG_SNAPSHOT_GET_MULTI, except that the client also sends the
+ * generation of the last snapshot it received. If that snapshot is still
+ * cached, we only send the GXIDs removed from it and added to it, otherwise
+ * (or if the delta is not any smaller) the full snapshot. Either way the
+ * reply carries the generation of the new snapshot, for the next request.
+ */
+void
+ProcessGetSnapshotCommandDelta(Port *myport, StringInfo message)
+{
+	StringInfoData buf;
+	GTM_TransactionHandle txn[GTM_MAX_GLOBAL_TRANSACTIONS];
+	GlobalTransactionId gxid[GTM_MAX_GLOBAL_TRANSACTIONS];
+	GTM_Snapshot snapshot;
+	MemoryContext oldContext;
+	uint64		generation;
+	uint64		base_generation;
+	GlobalTransactionId *removed;
+	GlobalTransactionId *added;
+	int			nremoved;
+	int			nadded;
+	int txn_count;
+	int ii;
+	int status[GTM_MAX_GLOBAL_TRANSACTIONS];
+	const char *data;
+
+	txn_count = pq_getmsgint(message, sizeof (int));
+
+	for (ii = 0; ii < txn_count; ii++)
+	{
+		data = pq_getmsgbytes(message, sizeof (gxid[ii]));
+		if (data == NULL)
+			ereport(ERROR,
+					(EPROTO,
+					 errmsg("Message does not contain valid GXID")));
+		memcpy(&gxid[ii], data, sizeof (gxid[ii]));
+		txn[ii] = GTM_GXIDToHandle(gxid[ii]);
+	}
+
+	data = pq_getmsgbytes(message, sizeof (base_generation));
+	if (data == NULL)
+		ereport(ERROR,
+				(EPROTO,
+				 errmsg("Message does not contain valid snapshot generation")));
+	memcpy(&base_generation, data, sizeof (base_generation));
+
+	pq_getmsgend(message);
+
+	oldContext = MemoryContextSwitchTo(TopMostMemoryContext);
+
+	/*
+	 * Get a fresh snapshot
+	 */
+	if ((snapshot = GTM_GetTransactionSnapshot(txn, txn_count, status,
+											   &generation)) == NULL)
+		ereport(ERROR,
+				(EINVAL,
+				 errmsg("Failed to get a snapshot")));
+
+	MemoryContextSwitchTo(oldContext);
+
+	gtm_stat_record(&GetMyThreadInfo->thr_stats.gts_snapshots,
+					snapshot->sn_xcnt);
+
+	removed = (GlobalTransactionId *)
+		palloc(sizeof (GlobalTransactionId) * Max(snapshot->sn_xcnt, 1));
+	added = (GlobalTransactionId *)
+		palloc(sizeof (GlobalTransactionId) * Max(snapshot->sn_xcnt, 1));
+
+	/* Nothing to send at all if the client already has this snapshot */
+	if (base_generation == generation)
+		nremoved = nadded = 0;
+	else if (!GTM_GetSnapshotDelta(base_generation, snapshot,
+								   removed, &nremoved, added, &nadded))
+		base_generation = 0;
+
+	pq_beginmessage(&buf, 'S');
+	pq_sendint(&buf, SNAPSHOT_GET_DELTA_RESULT, 4);
+	if (myport->remote_type == GTM_NODE_GTM_PROXY)
+	{
+		GTM_ProxyMsgHeader proxyhdr;
+		proxyhdr.ph_conid = myport->conn_id;
+		pq_sendbytes(&buf, (char *)&proxyhdr, sizeof (GTM_ProxyMsgHeader));
+	}
+	pq_sendbytes(&buf, (char *)&txn_count, sizeof(txn_count));
+	pq_sendbytes(&buf, (char *)status, sizeof(int) * txn_count);
+	pq_sendbytes(&buf, (char *)&generation, sizeof (generation));
+	pq_sendbytes(&buf, (char *)&base_generation, sizeof (base_generation));
+	pq_sendbytes(&buf, (char *)&snapshot->sn_xmin, sizeof (GlobalTransactionId));
+	pq_sendbytes(&buf, (char *)&snapshot->sn_xmax, sizeof (GlobalTransactionId));
+	if (base_generation == 0)
+	{
+		pq_sendint(&buf, snapshot->sn_xcnt, sizeof (int));
+		/* The GXIDs go out straight from the snapshot */
+		pq_endmessage_tail(myport, &buf, (char *)snapshot->sn_xip,
+						   sizeof(GlobalTransactionId) * snapshot->sn_xcnt);
+	}
+	else
+	{
+		pq_sendint(&buf, nremoved, sizeof (int));
+		pq_sendbytes(&buf, (char *)removed,
+					 sizeof(GlobalTransactionId) * nremoved);
+		pq_sendint(&buf, nadded, sizeof (int));
+		pq_sendbytes(&buf, (char *)added,
+					 sizeof(GlobalTransactionId) * nadded);
+		pq_endmessage(myport, &buf);
+	}
 
 	if (myport->remote_type != GTM_NODE_GTM_PROXY)
 		pq_flush(myport);
 
+	pfree(removed);
+	pfree(added);
+
 	return;
 }
 
@@ -468,13 +803,16 @@ ProcessGetSnapshotCommandMulti(Port *myport, StringInfo message)
 	/*
 	 * Get a fresh snapshot
 	 */
-	if ((snapshot = GTM_GetTransactionSnapshot(txn, txn_count, status)) == NULL)
+	if ((snapshot = GTM_GetTransactionSnapshot(txn, txn_count, status, NULL)) == NULL)
 		ereport(ERROR,
 				(EINVAL,
 				 errmsg("Failed to get a snapshot")));
 
 	MemoryContextSwitchTo(oldContext);
 
+	gtm_stat_record(&GetMyThreadInfo->thr_stats.gts_snapshots,
+					snapshot->sn_xcnt);
+
 	pq_beginmessage(&buf, 'S');
 	pq_sendint(&buf, SNAPSHOT_GET_MULTI_RESULT, 4);
 	if (myport->remote_type == GTM_NODE_GTM_PROXY)
@@ -488,9 +826,9 @@ ProcessGetSnapshotCommandMulti(Port *myport, StringInfo message)
 	pq_sendbytes(&buf, (char *)&snapshot->sn_xmin, sizeof (GlobalTransactionId));
 	pq_sendbytes(&buf, (char *)&snapshot->sn_xmax, sizeof (GlobalTransactionId));
 	pq_sendint(&buf, snapshot->sn_xcnt, sizeof (int));
-	pq_sendbytes(&buf, (char *)snapshot->sn_xip,
-				 sizeof(GlobalTransactionId) * snapshot->sn_xcnt);
-	pq_endmessage(myport, &buf);
+	/* The GXIDs go out straight from the snapshot */
+	pq_endmessage_tail(myport, &buf, (char *)snapshot->sn_xip,
+					   sizeof(GlobalTransactionId) * snapshot->sn_xcnt);
 
 	if (myport->remote_type != GTM_NODE_GTM_PROXY)
 		pq_flush(myport);
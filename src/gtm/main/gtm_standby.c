@@ -23,6 +23,7 @@
 #include "gtm/gtm_seq.h"
 #include "gtm/gtm_serialize.h"
 #include "gtm/gtm_utils.h"
+#include "gtm/libpq-int.h"
 #include "gtm/register.h"
 
 GTM_Conn *GTM_ActiveConn = NULL;
@@ -31,10 +32,43 @@ static char standbyNodeName[NI_MAXHOST];
 static int standbyPortNumber;
 static char *standbyDataDir;
 
+/*
+ * Replication stream to the GTM standby, used with standby_stream = on.
+ *
+ * Threads serving clients then do not connect to the standby themselves.
+ * Their backup messages are built in a connection without socket, which
+ * appends them to the stream buffer when flushed. A dedicated thread ships
+ * whatever accumulated over its own connection to the standby at once and,
+ * with synchronous_backup, confirms the whole batch with a single
+ * MSG_SYNC_STANDBY round trip. gtm_standby_sync() then only waits until the
+ * batch holding the messages of the caller is confirmed, so concurrent
+ * requests share the round trip, like a group commit.
+ *
+ * Positions are byte offsets since the start of the stream.
+ */
+typedef struct GTM_StandbyStream
+{
+	GTM_MutexLock	ss_lock;
+	GTM_CV			ss_data_cv;		/* signaled when data is appended */
+	GTM_CV			ss_confirm_cv;	/* broadcast when a batch is confirmed */
+	char		   *ss_buf;			/* appended, not yet shipped */
+	int				ss_len;
+	int				ss_size;
+	uint64			ss_appended;	/* position at the end of ss_buf */
+	uint64			ss_confirmed;	/* position confirmed by the standby */
+} GTM_StandbyStream;
+
+static GTM_StandbyStream GTMStandbyStream;
+
 static GTM_Conn * gtm_standby_connect_to_standby_int(int *report_needed);
 static GTM_Conn *gtm_standby_connectToActiveGTM(void);
+static int gtm_standby_stream_append(GTM_Conn *conn);
+static int gtm_standby_stream_send(GTM_Conn *standby, const char *data, int len);
+static void *gtm_standby_stream_main(void *argp);
 
 extern char *NodeName;		/* Defined in main.c */
+extern bool Backup_synchronously;
+extern bool GTMStandbyStreaming;
 
 int
 gtm_standby_start_startup(void)
@@ -180,11 +214,14 @@ gtm_standby_restore_gxid(void)
 			GTMTransactions.gt_open_transactions =
 					gtm_lappend(GTMTransactions.gt_open_transactions,
 							&GTMTransactions.gt_transactions_array[handle]);
+			GTM_GXIDIndexInsert(&GTMTransactions.gt_transactions_array[handle]);
 		}
 	}
 
 	dump_transactions_elog(&GTMTransactions, num_txn);
 
+	GTMTransactions.gt_snapshot_generation++;
+
 	GTM_RWLockRelease(&GTMTransactions.gt_TransArrayLock);
 	GTM_RWLockRelease(&GTMTransactions.gt_XidGenLock);
 
@@ -361,6 +398,17 @@ gtm_standby_connect_to_standby(void)
 	GTM_Conn *conn;
 	int report;
 
+	/*
+	 * With the replication stream, only the stream thread talks to the
+	 * standby. Everybody else gets a connection feeding the stream.
+	 */
+	if (GTMStandbyStreaming)
+	{
+		if (Recovery_IsStandby() || find_standby_node_info() == NULL)
+			return NULL;
+		return PQbufferedConnectGTM(GTM_NODE_GTM, gtm_standby_stream_append);
+	}
+
 	conn = gtm_standby_connect_to_standby_int(&report);
 
 	return conn;
@@ -474,6 +522,212 @@ gtm_standby_check_communication_error(int *retry_count, GTM_Conn *oldconn)
 	return false;
 }
 
+/*
+ * Make sure all the backup messages sent through the given standby
+ * connection reached the standby. This replaces gtm_sync_standby() on the
+ * request path, which with the replication stream waits for the batch
+ * holding our messages to be confirmed instead of doing a round trip.
+ */
+int
+gtm_standby_sync(GTM_Conn *conn)
+{
+	uint64		position;
+
+	if (conn->flush_hook == NULL)
+		return gtm_sync_standby(conn);
+
+	if (gtmpqFlush(conn))
+		return -1;
+
+	position = GetMyThreadInfo->thr_standby_position;
+
+	GTM_MutexLockAcquire(&GTMStandbyStream.ss_lock);
+	while (GTMStandbyStream.ss_confirmed < position)
+		GTM_CVWait(&GTMStandbyStream.ss_confirm_cv, &GTMStandbyStream.ss_lock);
+	GTM_MutexLockRelease(&GTMStandbyStream.ss_lock);
+
+	return 0;
+}
+
+/*
+ * Flush hook of the connections feeding the replication stream: move the
+ * buffered messages to the stream and wake up the stream thread.
+ */
+static int
+gtm_standby_stream_append(GTM_Conn *conn)
+{
+	GTM_StandbyStream *stream = &GTMStandbyStream;
+
+	GTM_MutexLockAcquire(&stream->ss_lock);
+
+	if (stream->ss_len + conn->outCount > stream->ss_size)
+	{
+		int			newsize = Max(stream->ss_size * 2,
+								  stream->ss_len + conn->outCount);
+		char	   *newbuf = (char *) realloc(stream->ss_buf, newsize);
+
+		if (newbuf == NULL)
+		{
+			GTM_MutexLockRelease(&stream->ss_lock);
+			return -1;
+		}
+		stream->ss_buf = newbuf;
+		stream->ss_size = newsize;
+	}
+
+	memcpy(stream->ss_buf + stream->ss_len, conn->outBuffer, conn->outCount);
+	stream->ss_len += conn->outCount;
+	stream->ss_appended += conn->outCount;
+	GetMyThreadInfo->thr_standby_position = stream->ss_appended;
+
+	GTM_CVSignal(&stream->ss_data_cv);
+	GTM_MutexLockRelease(&stream->ss_lock);
+
+	conn->outCount = 0;
+
+	return 0;
+}
+
+/*
+ * Send already serialized messages over a connection to the standby.
+ */
+static int
+gtm_standby_stream_send(GTM_Conn *standby, const char *data, int len)
+{
+	if (gtmpqCheckOutBufferSpace(standby->outCount + len, standby))
+		return EOF;
+
+	memcpy(standby->outBuffer + standby->outCount, data, len);
+	standby->outCount += len;
+
+	return gtmpqFlush(standby);
+}
+
+/*
+ * Start the thread shipping the replication stream. Called once by the main
+ * thread, when standby_stream is on.
+ */
+void
+gtm_standby_start_stream(void)
+{
+	GTM_MutexLockInit(&GTMStandbyStream.ss_lock);
+	GTM_CVInit(&GTMStandbyStream.ss_data_cv);
+	GTM_CVInit(&GTMStandbyStream.ss_confirm_cv);
+
+	if (GTM_ThreadCreate(NULL, gtm_standby_stream_main) == NULL)
+		ereport(FATAL,
+				(EAGAIN,
+				 errmsg("could not start the standby stream thread")));
+}
+
+/*
+ * Main routine of the stream thread.
+ *
+ * The thread does not take its thread lock, so a backup for a new standby,
+ * which locks out all other threads, does not stop it from confirming the
+ * messages other threads are waiting for while holding their lock.
+ */
+static void *
+gtm_standby_stream_main(void *argp)
+{
+	GTM_StandbyStream *stream = &GTMStandbyStream;
+	GTM_Conn   *standby = NULL;
+	uint32		generation = 0;
+	char	   *batch = NULL;
+	int			batch_size = 0;
+	volatile int len = 0;
+	volatile uint64 position = 0;
+	sigjmp_buf	local_sigjmp_buf;
+
+	elog(DEBUG1, "Starting the standby stream thread");
+
+	if (sigsetjmp(local_sigjmp_buf, 1) != 0)
+	{
+		EmitErrorReport(NULL);
+		FlushErrorState();
+
+		/* Don't trust the connection, and give up on the batch */
+		if (standby)
+			GTMPQfinish(standby);
+		standby = NULL;
+		len = 0;
+
+		GTM_MutexLockAcquire(&stream->ss_lock);
+		stream->ss_confirmed = position;
+		GTM_CVBcast(&stream->ss_confirm_cv);
+		GTM_MutexLockRelease(&stream->ss_lock);
+	}
+
+	PG_exception_stack = &local_sigjmp_buf;
+
+	for (;;)
+	{
+		bool		shipped = false;
+		char	   *buf;
+		int			size;
+		int			retry;
+
+		/* Take everything appended so far, leaving an empty buffer */
+		GTM_MutexLockAcquire(&stream->ss_lock);
+		while (stream->ss_len == 0)
+			GTM_CVWait(&stream->ss_data_cv, &stream->ss_lock);
+
+		buf = stream->ss_buf;
+		size = stream->ss_size;
+		stream->ss_buf = batch;
+		stream->ss_size = batch_size;
+		batch = buf;
+		batch_size = size;
+		len = stream->ss_len;
+		stream->ss_len = 0;
+		position = stream->ss_appended;
+		GTM_MutexLockRelease(&stream->ss_lock);
+
+		/* A new standby registered since we connected */
+		if (standby && generation != GTMThreads->gt_standby_generation)
+		{
+			GTMPQfinish(standby);
+			standby = NULL;
+		}
+
+		for (retry = 0; retry < 2 && !shipped; retry++)
+		{
+			if (standby == NULL)
+			{
+				int			report;
+
+				generation = GTMThreads->gt_standby_generation;
+				standby = gtm_standby_connect_to_standby_int(&report);
+				if (standby == NULL)
+					break;
+			}
+
+			if (gtm_standby_stream_send(standby, batch, len) == 0 &&
+				(!Backup_synchronously || gtm_sync_standby(standby) == 0))
+				shipped = true;
+			else
+			{
+				GTMPQfinish(standby);
+				standby = NULL;
+			}
+		}
+
+		if (!shipped && find_standby_node_info() != NULL)
+			elog(LOG, "could not send %d bytes of backup data to GTM standby", len);
+
+		/*
+		 * Waiters are released even if the standby is gone, like a failed
+		 * gtm_sync_standby() does not hold the reply to the client either.
+		 */
+		GTM_MutexLockAcquire(&stream->ss_lock);
+		stream->ss_confirmed = position;
+		GTM_CVBcast(&stream->ss_confirm_cv);
+		GTM_MutexLockRelease(&stream->ss_lock);
+	}
+
+	return NULL;
+}
+
 int
 gtm_standby_begin_backup(void)
 {
@@ -1,6 +1,13 @@
 /*-------------------------------------------------------------------------
  *
  * gtm_stat.c
+ *		Request statistics of GTM
+ *
+ * Every thread counts the requests it served in its own GTM_ThreadStats,
+ * without any locking. MSG_GET_STATS sums up the counters of all the
+ * running threads, plus those of the threads which already exited, and
+ * sends them back as one section of rows, see gtm_stat.h. A GTM proxy
+ * relaying the request adds a section of its own in front.
  *
  * Portions Copyright (c) 1996-2009, PostgreSQL Global Development Group
  * Portions Copyright (c) 1994, Regents of the University of California
@@ -8,30 +15,152 @@
  *
  *
  * IDENTIFICATION
- *	  $PostgreSQL$
+ *	  src/gtm/main/gtm_stat.c
  *
  *-------------------------------------------------------------------------
  */
+#include <sys/time.h>
+
 #include "gtm/gtm_c.h"
 #include "gtm/gtm.h"
+#include "gtm/gtm_stat.h"
+#include "gtm/gtm_utils.h"
+#include "gtm/libpq.h"
+#include "gtm/pqformat.h"
 
-uint32	GTM_Message_Stats[MSG_MAX_MESSAGE_TYPE];
-uint32	GTM_Result_Stats[GTM_MAX_RESULT_TYPE];
+/* Counters of the threads which exited, protected by GTMThreads->gt_lock */
+static GTM_ThreadStats RetiredStats;
 
-void
-gtm_msgstat_increment(int type)
+static void GTM_StatsAddThread(GTM_ThreadStats *dst, GTM_ThreadStats *src);
+static void GTM_StatsSendRow(StringInfo buf, int kind, const char *name,
+				 GTM_StatsCounter *counter);
+
+/*
+ * Current time in microseconds. GTM_TimestampGetCurrent() only has a
+ * resolution of seconds without integer timestamps.
+ */
+uint64
+GTM_StatNow(void)
 {
-	GTM_Message_Stats[type]++;
+	struct timeval tp;
+
+	gettimeofday(&tp, NULL);
+
+	return (uint64) tp.tv_sec * 1000000 + tp.tv_usec;
 }
 
+/*
+ * Keep the counters of an exiting thread. Must be called with
+ * GTMThreads->gt_lock held in write mode.
+ */
 void
-gtm_resultstat_increment(int type)
+GTM_StatsRetire(GTM_ThreadStats *stats)
+{
+	GTM_StatsAddThread(&RetiredStats, stats);
+}
+
+static void
+GTM_StatsAddThread(GTM_ThreadStats *dst, GTM_ThreadStats *src)
+{
+	int			ii;
+
+	for (ii = 0; ii < MSG_TYPE_COUNT; ii++)
+		gtm_stat_add(&dst->gts_messages[ii], &src->gts_messages[ii]);
+	gtm_stat_add(&dst->gts_snapshots, &src->gts_snapshots);
+}
+
+static void
+GTM_StatsSendRow(StringInfo buf, int kind, const char *name,
+				 GTM_StatsCounter *counter)
 {
-	GTM_Result_Stats[type]++;
+	int			len = strlen(name);
+
+	pq_sendint(buf, kind, sizeof (int));
+	pq_sendint(buf, len, sizeof (int));
+	pq_sendbytes(buf, name, len);
+	pq_sendbytes(buf, (char *)counter, sizeof (GTM_StatsCounter));
 }
 
+/*
+ * Process MSG_GET_STATS message
+ */
 void
-gtm_print_stats(void)
+ProcessGetStatsCommand(Port *myport, StringInfo message)
 {
+	StringInfoData buf;
+	GTM_ThreadStats *total;
+	GTM_StatsCounter queue;
+	GTM_StatsCounter threads;
+	int			nrows = 0;
+	int			ii;
+
+	pq_getmsgend(message);
+
+	/* Too big for the stack of a GTM thread */
+	total = (GTM_ThreadStats *) palloc(sizeof (GTM_ThreadStats));
+	memset(&queue, 0, sizeof (queue));
+	memset(&threads, 0, sizeof (threads));
+
+	GTM_RWLockAcquire(&GTMThreads->gt_lock, GTM_LOCKMODE_READ);
+	memcpy(total, &RetiredStats, sizeof (GTM_ThreadStats));
+	for (ii = 0; ii < GTMThreads->gt_array_size; ii++)
+	{
+		GTM_ThreadInfo *thrinfo = GTMThreads->gt_threads[ii];
+
+		if (thrinfo == NULL)
+			continue;
+
+		GTM_StatsAddThread(total, &thrinfo->thr_stats);
+		threads.count++;
+		if (thrinfo->thr_stats.gts_busy)
+			queue.count++;
+	}
+	GTM_RWLockRelease(&GTMThreads->gt_lock);
+
+	for (ii = 0; ii < MSG_TYPE_COUNT; ii++)
+		if (total->gts_messages[ii].count > 0)
+			nrows++;
+	nrows += 3;
+
+	pq_beginmessage(&buf, 'S');
+	pq_sendint(&buf, GET_STATS_RESULT, 4);
+	if (myport->remote_type == GTM_NODE_GTM_PROXY)
+	{
+		GTM_ProxyMsgHeader proxyhdr;
+		proxyhdr.ph_conid = myport->conn_id;
+		pq_sendbytes(&buf, (char *)&proxyhdr, sizeof (GTM_ProxyMsgHeader));
+	}
+
+	/* A single section, the proxies add theirs */
+	pq_sendint(&buf, 1, sizeof (int));
+	pq_sendint(&buf, strlen("gtm"), sizeof (int));
+	pq_sendbytes(&buf, "gtm", strlen("gtm"));
+	pq_sendint(&buf, nrows, sizeof (int));
+
+	for (ii = 0; ii < MSG_TYPE_COUNT; ii++)
+	{
+		char	   *name;
+
+		if (total->gts_messages[ii].count == 0)
+			continue;
+
+		name = gtm_util_message_name(ii);
+		if (name == NULL)
+			name = "UNKNOWN";
+		else if (strncmp(name, "MSG_", 4) == 0)
+			name += 4;
+		GTM_StatsSendRow(&buf, GTM_STATS_MESSAGE, name,
+						 &total->gts_messages[ii]);
+	}
+	GTM_StatsSendRow(&buf, GTM_STATS_SNAPSHOT, "SNAPSHOT_SIZE",
+					 &total->gts_snapshots);
+	GTM_StatsSendRow(&buf, GTM_STATS_QUEUE, "BUSY_THREADS", &queue);
+	GTM_StatsSendRow(&buf, GTM_STATS_QUEUE, "THREADS", &threads);
+
+	pq_endmessage(myport, &buf);
+
+	if (myport->remote_type != GTM_NODE_GTM_PROXY)
+		pq_flush(myport);
 
+	pfree(total);
 }
@@ -150,6 +150,23 @@ GTM_ThreadAdd(GTM_ThreadInfo *thrinfo)
 	return ii;
 }
 
+/*
+ * Assign a client identifier to a connection which is not served by a
+ * dedicated thread. See GTM_ThreadAdd for how these identifiers are used.
+ */
+uint32
+GTM_AssignClientIdentifier(void)
+{
+	uint32 client_id;
+
+	GTM_RWLockAcquire(&GTMThreads->gt_lock, GTM_LOCKMODE_WRITE);
+	client_id = GTMThreads->gt_next_client_id;
+	GTMThreads->gt_next_client_id = GTM_CLIENT_ID_NEXT(GTMThreads->gt_next_client_id);
+	GTM_RWLockRelease(&GTMThreads->gt_lock);
+
+	return client_id;
+}
+
 int
 GTM_ThreadRemove(GTM_ThreadInfo *thrinfo)
 {
@@ -171,6 +188,7 @@ GTM_ThreadRemove(GTM_ThreadInfo *thrinfo)
 
 	GTMThreads->gt_threads[ii] = NULL;
 	GTMThreads->gt_thread_count--;
+	GTM_StatsRetire(&thrinfo->thr_stats);
 	GTM_RWLockRelease(&GTMThreads->gt_lock);
 
 	pfree(thrinfo);
@@ -320,37 +338,15 @@ GTM_ThreadCleanup(void *argp)
 	}
 
 	/*
-	 * Close a connection to GTM standby.
+	 * Close the connection we are serving, if any. An idle worker thread of
+	 * the connection pool has none.
 	 */
-	if (thrinfo->thr_conn->standby)
+	if (thrinfo->thr_conn)
 	{
-		elog(DEBUG1, "Closing a connection to the GTM standby.");
-
-		GTMPQfinish(thrinfo->thr_conn->standby);
-		thrinfo->thr_conn->standby = NULL;
+		GTM_ConnectionClose(thrinfo->thr_conn);
+		thrinfo->thr_conn = NULL;
 	}
 
-	/*
-	 * TODO Close the open connection.
-	 */
-	StreamClose(thrinfo->thr_conn->con_port->sock);
-
-	/* Free the node_name in the port */
-	if (thrinfo->thr_conn->con_port->node_name != NULL)
-		/* 
-		 * We don't have to reset pointer to NULL her because ConnFree() 
-		 * frees this structure next.
-		 */
-		pfree(thrinfo->thr_conn->con_port->node_name);
-
-	/* Free the port */
-	ConnFree(thrinfo->thr_conn->con_port);
-	thrinfo->thr_conn->con_port = NULL;
-
-	/* Free the connection info structure */
-	pfree(thrinfo->thr_conn);
-	thrinfo->thr_conn = NULL;
-
 	/*
 	 * Switch to the memory context of the main process so that we can free up
 	 * our memory contextes easily.
@@ -389,6 +385,46 @@ GTM_ThreadCleanup(void *argp)
 	return;
 }
 
+/*
+ * Close the client connection, along with its connection to the GTM standby,
+ * and free the connection info structure.
+ */
+void
+GTM_ConnectionClose(GTM_ConnectionInfo *conninfo)
+{
+	/*
+	 * Close a connection to GTM standby.
+	 */
+	if (conninfo->standby)
+	{
+		elog(DEBUG1, "Closing a connection to the GTM standby.");
+
+		GTMPQfinish(conninfo->standby);
+		conninfo->standby = NULL;
+	}
+
+	/*
+	 * Closing the socket also removes it from the worker poll set, if it
+	 * was ever added there.
+	 */
+	StreamClose(conninfo->con_port->sock);
+
+	/* Free the node_name in the port */
+	if (conninfo->con_port->node_name != NULL)
+		/* 
+		 * We don't have to reset pointer to NULL her because ConnFree() 
+		 * frees this structure next.
+		 */
+		pfree(conninfo->con_port->node_name);
+
+	/* Free the port */
+	ConnFree(conninfo->con_port);
+	conninfo->con_port = NULL;
+
+	/* Free the connection info structure */
+	pfree(conninfo);
+}
+
 /*
  * A wrapper around the start routine of the thread. This helps us doing any
  * initialization and setting up cleanup handlers before the main routine is
@@ -130,6 +130,7 @@
  */
 #include "gtm/gtm_txn.h"
 
+#include <time.h>
 #include <unistd.h>
 #include "gtm/assert.h"
 #include "gtm/elog.h"
@@ -163,6 +164,14 @@ static bool GTM_NeedXidRestoreUpdate(void);
 GlobalTransactionId ControlXid;  /* last one written to control file */
 GTM_Transactions GTMTransactions;
 
+typedef struct GTM_GXIDIndexShard
+{
+	GTM_RWLock				gs_lock;
+	GTM_TransactionHandle	gs_buckets[GTM_GXID_INDEX_BUCKETS];
+} GTM_GXIDIndexShard;
+
+static GTM_GXIDIndexShard GTMGXIDIndex[GTM_GXID_INDEX_SHARDS];
+
 /*
  * GTM_InitTxnManager
  *	Initializes the internal data structures used by GTM.
@@ -182,9 +191,20 @@ GTM_InitTxnManager(void)
 	{
 		GTM_TransactionInfo *gtm_txninfo = &GTMTransactions.gt_transactions_array[ii];
 		gtm_txninfo->gti_in_use = false;
+		gtm_txninfo->gti_gxid_next = InvalidTransactionHandle;
 		GTM_RWLockInit(&gtm_txninfo->gti_lock);
 	}
 
+	for (ii = 0; ii < GTM_GXID_INDEX_SHARDS; ii++)
+	{
+		GTM_GXIDIndexShard *shard = &GTMGXIDIndex[ii];
+		int jj;
+
+		for (jj = 0; jj < GTM_GXID_INDEX_BUCKETS; jj++)
+			shard->gs_buckets[jj] = InvalidTransactionHandle;
+		GTM_RWLockInit(&shard->gs_lock);
+	}
+
 	/*
 	 * XXX When GTM is stopped and restarted, it must start assinging GXIDs
 	 * greater than the previously assigned values. If it was a clean shutdown,
@@ -195,6 +215,7 @@ GTM_InitTxnManager(void)
 	 * Restarts after a clean shutdown is handled by GTM_RestoreTxnInfo.
 	 */
 	GTMTransactions.gt_nextXid = FirstNormalGlobalTransactionId;
+	GTMTransactions.gt_backedUpLSN = InvalidGTMXLogPtr;
 
 	/*
 	 * XXX The gt_oldestXid is the cluster level oldest Xid
@@ -231,6 +252,13 @@ GTM_InitTxnManager(void)
 	GTMTransactions.gt_open_transactions = gtm_NIL;
 	GTMTransactions.gt_lastslot = -1;
 
+	/*
+	 * Snapshot generations are remembered by clients, to ask for deltas.
+	 * Start from the current time so that generations issued by different
+	 * GTM instances, or by this one before a restart, never collide.
+	 */
+	GTMTransactions.gt_snapshot_generation = ((uint64) time(NULL)) << 32;
+
 	GTMTransactions.gt_gtm_state = GTM_STARTING;
 
 	ControlXid = FirstNormalGlobalTransactionId;
@@ -238,39 +266,105 @@ GTM_InitTxnManager(void)
 	return;
 }
 
+/*
+ * GTM_GXIDIndexShardFor
+ *		Return the index shard and the bucket (within it) for a GXID.
+ *
+ * GXIDs are assigned sequentially, so consecutive ones are spread over the
+ * shards first and then over the buckets of each shard.
+ */
+static GTM_GXIDIndexShard *
+GTM_GXIDIndexShardFor(GlobalTransactionId gxid, int *bucket)
+{
+	*bucket = (gxid / GTM_GXID_INDEX_SHARDS) % GTM_GXID_INDEX_BUCKETS;
+	return &GTMGXIDIndex[gxid % GTM_GXID_INDEX_SHARDS];
+}
+
+/*
+ * GTM_GXIDIndexInsert
+ *		Make the transaction findable by its (just assigned) GXID.
+ */
+void
+GTM_GXIDIndexInsert(GTM_TransactionInfo *gtm_txninfo)
+{
+	GTM_GXIDIndexShard *shard;
+	int bucket;
+
+	if (!GlobalTransactionIdIsValid(gtm_txninfo->gti_gxid))
+		return;
+
+	shard = GTM_GXIDIndexShardFor(gtm_txninfo->gti_gxid, &bucket);
+
+	GTM_RWLockAcquire(&shard->gs_lock, GTM_LOCKMODE_WRITE);
+	gtm_txninfo->gti_gxid_next = shard->gs_buckets[bucket];
+	shard->gs_buckets[bucket] = gtm_txninfo->gti_handle;
+	GTM_RWLockRelease(&shard->gs_lock);
+}
+
+/*
+ * GTM_GXIDIndexRemove
+ *		Remove the transaction from the GXID index, if it is there.
+ */
+void
+GTM_GXIDIndexRemove(GTM_TransactionInfo *gtm_txninfo)
+{
+	GTM_GXIDIndexShard *shard;
+	GTM_TransactionHandle *link;
+	int bucket;
+
+	if (!GlobalTransactionIdIsValid(gtm_txninfo->gti_gxid))
+		return;
+
+	shard = GTM_GXIDIndexShardFor(gtm_txninfo->gti_gxid, &bucket);
+
+	GTM_RWLockAcquire(&shard->gs_lock, GTM_LOCKMODE_WRITE);
+	for (link = &shard->gs_buckets[bucket];
+		 *link != InvalidTransactionHandle;
+		 link = &GTMTransactions.gt_transactions_array[*link].gti_gxid_next)
+	{
+		if (*link == gtm_txninfo->gti_handle)
+		{
+			*link = gtm_txninfo->gti_gxid_next;
+			break;
+		}
+	}
+	gtm_txninfo->gti_gxid_next = InvalidTransactionHandle;
+	GTM_RWLockRelease(&shard->gs_lock);
+}
+
 /*
  * GTM_GXIDToHandle_Internal
  *		Given the GXID, find handle of the corresponding global transaction.
  *
- * We simply walk the list of open transactions until we find a match.
- *
- * XXX I wonder if this might be an issue, as the search is linear and we
- * may have up to 16k global transactions (by default). In that case we
- * should change this to use a hash table (or so) to speed the lookup.
+ * Only the index shard the GXID belongs to is locked, and only the handles
+ * sharing its bucket are visited.
  */
 static GTM_TransactionHandle
 GTM_GXIDToHandle_Internal(GlobalTransactionId gxid, bool warn)
 {
-	gtm_ListCell *elem = NULL;
-   	GTM_TransactionInfo *gtm_txninfo = NULL;
+	GTM_GXIDIndexShard *shard;
+	GTM_TransactionHandle handle;
+	int bucket;
 
 	if (!GlobalTransactionIdIsValid(gxid))
 		return InvalidTransactionHandle;
 
-	GTM_RWLockAcquire(&GTMTransactions.gt_TransArrayLock, GTM_LOCKMODE_READ);
+	shard = GTM_GXIDIndexShardFor(gxid, &bucket);
 
-	gtm_foreach(elem, GTMTransactions.gt_open_transactions)
+	GTM_RWLockAcquire(&shard->gs_lock, GTM_LOCKMODE_READ);
+
+	for (handle = shard->gs_buckets[bucket];
+		 handle != InvalidTransactionHandle;
+		 handle = GTMTransactions.gt_transactions_array[handle].gti_gxid_next)
 	{
-		gtm_txninfo = (GTM_TransactionInfo *)gtm_lfirst(elem);
-		if (GlobalTransactionIdEquals(gtm_txninfo->gti_gxid, gxid))
+		if (GlobalTransactionIdEquals(GTMTransactions.gt_transactions_array[handle].gti_gxid, gxid))
 			break;
-		gtm_txninfo = NULL;
 	}
 
-	GTM_RWLockRelease(&GTMTransactions.gt_TransArrayLock);
+	GTM_RWLockRelease(&shard->gs_lock);
 
-	if (gtm_txninfo != NULL)
-		return gtm_txninfo->gti_handle;
+	if (handle != InvalidTransactionHandle)
+		return handle;
 	else
 	{
 		if (warn)
@@ -469,6 +563,8 @@ GTM_RemoveTransInfoMulti(GTM_TransactionInfo *gtm_txninfo[], int txn_count)
 		GTM_TransactionInfo_Clean(gtm_txninfo[ii]);
 	}
 
+	GTMTransactions.gt_snapshot_generation++;
+
 	GTM_RWLockRelease(&GTMTransactions.gt_TransArrayLock);
 }
 
@@ -531,6 +627,8 @@ GTM_RemoveAllTransInfos(uint32 client_id, int backend_id)
 			 */
 			GTM_TransactionInfo_Clean(gtm_txninfo);
 
+			GTMTransactions.gt_snapshot_generation++;
+
 			/* move to next cell in the list */
 			if (prev)
 				cell = gtm_lnext(prev);
@@ -610,7 +708,11 @@ GTM_SetDoVacuum(GTM_TransactionHandle handle)
 	if (gtm_txninfo == NULL)
 		ereport(ERROR, (EINVAL, errmsg("Invalid transaction handle")));
 
+	/* The GXID may already be part of cached snapshots */
+	GTM_RWLockAcquire(&GTMTransactions.gt_TransArrayLock, GTM_LOCKMODE_WRITE);
 	gtm_txninfo->gti_vacuum = true;
+	GTMTransactions.gt_snapshot_generation++;
+	GTM_RWLockRelease(&GTMTransactions.gt_TransArrayLock);
 	return true;
 }
 
@@ -652,6 +754,7 @@ GTM_GetGlobalTransactionIdMulti(GTM_TransactionHandle handles[], int txn_count,
 	int ii;
 	int new_handles_count = 0;
 	bool save_control = false;
+	GTM_XLogPtr backedUpLSN;
 
 	elog(DEBUG1, "GTM_GetGlobalTransactionIdMulti: generate GXIDs for %d transactions", txn_count);
 
@@ -731,6 +834,7 @@ GTM_GetGlobalTransactionIdMulti(GTM_TransactionHandle handles[], int txn_count,
 				gtm_txninfo->gti_global_session_id, xid);
 
 		gxids[ii] = gtm_txninfo->gti_gxid = xid;
+		GTM_GXIDIndexInsert(gtm_txninfo);
 
 		/* only return the new handles when requested */
 		if (new_handles)
@@ -739,9 +843,9 @@ GTM_GetGlobalTransactionIdMulti(GTM_TransactionHandle handles[], int txn_count,
 
 	/*
 	 * Periodically write the xid and sequence info out to the control file.
-	 * Try and handle wrapping, too.
+	 * Try and handle wrapping, too. The state log makes that unnecessary.
 	 */
-	if (GlobalTransactionIdIsValid(xid) &&
+	if (!GTMStateLog && GlobalTransactionIdIsValid(xid) &&
 			(xid - ControlXid > CONTROL_INTERVAL || xid < ControlXid))
 	{
 		save_control = true;
@@ -749,10 +853,33 @@ GTM_GetGlobalTransactionIdMulti(GTM_TransactionHandle handles[], int txn_count,
 	}
 
 	if (GTM_NeedXidRestoreUpdate())
-		GTM_SetNeedBackup();
+	{
+		/*
+		 * With the state log, reserve the next RestoreDuration GXIDs with a
+		 * log record rather than rewriting the control file.
+		 */
+		if (GTMStateLog)
+		{
+			GlobalTransactionId next = GTMTransactions.gt_nextXid;
+
+			if (MaxGlobalTransactionId - next > RestoreDuration)
+				GTMTransactions.gt_backedUpXid = next + RestoreDuration;
+			else
+				GTMTransactions.gt_backedUpXid = FirstNormalGlobalTransactionId +
+					(RestoreDuration - (MaxGlobalTransactionId - next));
+			GTMTransactions.gt_backedUpLSN =
+				GTM_XLogInsertXid(GTMTransactions.gt_backedUpXid);
+		}
+		else
+			GTM_SetNeedBackup();
+	}
+	backedUpLSN = GTMTransactions.gt_backedUpLSN;
 
 	GTM_RWLockRelease(&GTMTransactions.gt_XidGenLock);
 
+	/* The GXIDs handed out must be covered by a durable reservation */
+	GTM_XLogFlush(backedUpLSN);
+
 	/* save control info when not holding the XidGenLock */
 	if (save_control)
 		SaveControlInfo();
@@ -1161,6 +1288,8 @@ GTM_TransactionInfo_Clean(GTM_TransactionInfo *gtm_txninfo)
 	gtm_txninfo->gti_created_seqs = gtm_NIL;
 	gtm_txninfo->gti_altered_seqs = gtm_NIL;
 
+	GTM_GXIDIndexRemove(gtm_txninfo);
+
 	gtm_txninfo->gti_state = GTM_TXN_ABORTED;
 	gtm_txninfo->gti_in_use = false;
 	gtm_txninfo->gti_snapshot_set = false;
@@ -1595,6 +1724,7 @@ GTM_BkupBeginTransactionGetGXIDMulti(GlobalTransactionId *gxid,
 	{
 		gtm_txninfo = GTM_HandleToTransactionInfo(txn[ii]);
 		gtm_txninfo->gti_gxid = gxid[ii];
+		GTM_GXIDIndexInsert(gtm_txninfo);
 		if (global_sessionid[ii])
 			strncpy(gtm_txninfo->gti_global_session_id, global_sessionid[ii],
 					GTM_MAX_SESSION_ID_LEN);
@@ -1613,6 +1743,9 @@ GTM_BkupBeginTransactionGetGXIDMulti(GlobalTransactionId *gxid,
 		xid = GTMTransactions.gt_nextXid;
 	}
 
+	/* GXIDs backed up from the master may be below the snapshot xmax */
+	GTMTransactions.gt_snapshot_generation++;
+
 	/*
 	 * Periodically write the xid and sequence info out to the control file.
 	 * Try and handle wrapping, too.
@@ -1697,7 +1830,7 @@ ProcessBeginTransactionCommand(Port *myport, StringInfo message)
 				GetMyThreadInfo->thr_client_id, timestamp);
 		/* Synch. with standby */
 		if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-			gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+			gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 	}
 
 	pq_beginmessage(&buf, 'S');
@@ -1820,7 +1953,7 @@ retry:
 
 		/* Sync */
 		if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-			gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+			gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 	}
 	/* Respond to the client */
@@ -1955,7 +2088,7 @@ ProcessBeginTransactionGetGXIDAutovacuumCommand(Port *myport, StringInfo message
 
 		/* Sync */
 		if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-			gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+			gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 		elog(DEBUG1, "begin_transaction_autovacuum() GXID=%d done.", _gxid);
 	}
@@ -2069,7 +2202,7 @@ retry:
 
 		/* Sync */
 		if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-			gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+			gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 		elog(DEBUG1, "begin_transaction_multi() rc=%d done.", _rc);
 	}
@@ -2203,7 +2336,7 @@ ProcessCommitTransactionCommand(Port *myport, StringInfo message, bool is_backup
 
 			/* Sync */
 			if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-				gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+				gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 			elog(DEBUG1, "commit_transaction() rc=%d done.", _rc);
 		}
@@ -2318,7 +2451,7 @@ ProcessCommitPreparedTransactionCommand(Port *myport, StringInfo message, bool i
 
 			/* Sync */
 			if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-				gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+				gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 			elog(DEBUG1, "commit_prepared_transaction() rc=%d done.", _rc);
 		}
@@ -2598,7 +2731,7 @@ ProcessRollbackTransactionCommand(Port *myport, StringInfo message, bool is_back
 
 			/* Sync */
 			if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-				gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+				gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 			elog(DEBUG1, "abort_transaction() GXID=%d done.", gxid);
 		}
@@ -2690,7 +2823,7 @@ ProcessCommitTransactionCommandMulti(Port *myport, StringInfo message, bool is_b
 				goto retry;
 			/* Sync */
 			if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-				gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+				gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 			elog(DEBUG1, "commit_transaction_multi() rc=%d done.", _rc);
 		}
@@ -2779,7 +2912,7 @@ ProcessRollbackTransactionCommandMulti(Port *myport, StringInfo message, bool is
 
 			/* Sync */
 			if (Backup_synchronously &&(myport->remote_type != GTM_NODE_GTM_PROXY))
-				gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+				gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 			elog(DEBUG1, "abort_transaction_multi() rc=%d done.", _rc);
 		}
@@ -2881,7 +3014,7 @@ ProcessStartPreparedTransactionCommand(Port *myport, StringInfo message, bool is
 
 			/* Sync */
 			if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-				gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+				gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 			elog(DEBUG1, "start_prepared_transaction() rc=%d done.", _rc);
 		}
@@ -2961,7 +3094,7 @@ ProcessPrepareTransactionCommand(Port *myport, StringInfo message, bool is_backu
 
 			/* Sync */
 			if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-				gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+				gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 			elog(DEBUG1, "prepare_transaction() GXID=%d done.", gxid);
 		}
@@ -3143,7 +3276,10 @@ ProcessReportXminCommand(Port *myport, StringInfo message, bool is_backup)
 		pq_sendbytes(&buf, (char *)&global_xmin, sizeof (GlobalTransactionId));
 		pq_sendbytes(&buf, (char *)&errcode, sizeof (errcode));
 		pq_endmessage(myport, &buf);
-		pq_flush(myport);
+
+		/* A proxy asks for the responses to all its reports at once */
+		if (myport->remote_type != GTM_NODE_GTM_PROXY)
+			pq_flush(myport);
 	}
 }
 
@@ -3165,6 +3301,19 @@ bool GTM_NeedXidRestoreUpdate(void)
 	return(GlobalTransactionIdPrecedesOrEquals(GTMTransactions.gt_backedUpXid, GTMTransactions.gt_nextXid));
 }
 
+/*
+ * Replay a GXID reservation of the state log, at startup
+ */
+void
+GTM_RestoreXidReservation(GlobalTransactionId gxid)
+{
+	if (GlobalTransactionIdFollows(gxid, GTMTransactions.gt_nextXid))
+	{
+		elog(DEBUG1, "Restoring reserved GXID %u from the state log", gxid);
+		GTMTransactions.gt_nextXid = gxid;
+	}
+}
+
 /*
  * GTM_RememberCreatedSequence
  *		Remember a sequence created by a given transaction (GXID).
@@ -0,0 +1,382 @@
+/*-------------------------------------------------------------------------
+ *
+ * gtm_xlog.c
+ *		Append-only log of the GTM state reservations
+ *
+ * Restart safety of GXIDs and sequence values relies on reserving values
+ * ahead of those handed out, and persisting the reservations. Without the
+ * log every reservation rewrites the whole control file. With state_log on,
+ * a reservation is a small record appended to gtm.xlog instead, and the
+ * thread making it waits for the record to be fsync'ed before replying.
+ * Threads waiting together share a single fsync.
+ *
+ * The control file remains the checkpoint of the state. Writing it switches
+ * to a new log segment, the previous one is removed once the control file
+ * is safely in place. At startup the records of both segments are replayed
+ * on top of the control file. Records only ever move values forward, so
+ * replaying one that the control file already covers is harmless.
+ *
+ * Portions Copyright (c) 1996-2010, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ * Portions Copyright (c) 2010-2012 Postgres-XC Development Group
+ *
+ *
+ * IDENTIFICATION
+ *		src/gtm/main/gtm_xlog.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "gtm/gtm_c.h"
+#include "gtm/gtm.h"
+#include "gtm/gtm_lock.h"
+#include "gtm/gtm_txn.h"
+#include "gtm/gtm_seq.h"
+#include "gtm/gtm_backup.h"
+#include "gtm/gtm_xlog.h"
+#include "gtm/elog.h"
+
+extern char *GTMDataDir;
+
+/*
+ * A record is laid out as: total length (uint32), checksum (uint32), type
+ * (uint8), then the payload. For XID records the payload is the reserved
+ * GXID, for sequence records the reserved value followed by the key.
+ */
+#define GTM_XLOG_HEADER_SIZE	(sizeof(uint32) * 2 + sizeof(uint8))
+#define GTM_XLOG_MAX_RECORD		(GTM_XLOG_HEADER_SIZE + sizeof(GTM_Sequence) + \
+								 GTM_MAX_SEQKEY_LENGTH)
+
+#define GTM_XLOG_XID			1
+#define GTM_XLOG_SEQ			2
+
+bool		GTMStateLog = false;
+
+static char XLogPath[MAXPGPATH];
+static char XLogOldPath[MAXPGPATH];
+static int	XLogFd = -1;
+
+/* Insert position and size of the current segment, under XLogInsertLock */
+static GTM_MutexLock XLogInsertLock;
+static GTM_XLogPtr XLogInsertPtr = InvalidGTMXLogPtr;
+static uint32 XLogSegmentSize = 0;
+
+/* Flushed position, under XLogFlushLock */
+static GTM_MutexLock XLogFlushLock;
+static GTM_CV XLogFlushCV;
+static GTM_XLogPtr XLogFlushPtr = InvalidGTMXLogPtr;
+static bool XLogFlushing = false;
+
+static uint32 xlog_checksum(const char *rec, uint32 len);
+static GTM_XLogPtr xlog_insert(char *rec, uint32 len);
+static void xlog_replay_file(const char *path);
+static int xlog_open(void);
+
+/*
+ * FNV-1a checksum of a record, with its checksum field taken as zero
+ */
+static uint32
+xlog_checksum(const char *rec, uint32 len)
+{
+	uint32 check = 2166136261U;
+	uint32 ii;
+
+	for (ii = 0; ii < len; ii++)
+	{
+		unsigned char c = rec[ii];
+
+		if (ii >= sizeof(uint32) && ii < sizeof(uint32) * 2)
+			c = 0;
+		check ^= c;
+		check *= 16777619U;
+	}
+	return check;
+}
+
+static int
+xlog_open(void)
+{
+	return open(XLogPath, O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR);
+}
+
+/*
+ * Open the log, after replaying it if asked to. Called at startup, once the
+ * control file has been read.
+ */
+void
+GTM_XLogStartup(bool replay)
+{
+	if (!GTMStateLog)
+		return;
+
+	snprintf(XLogPath, MAXPGPATH, "%s/%s", GTMDataDir, GTM_XLOG_FILE);
+	snprintf(XLogOldPath, MAXPGPATH, "%s/%s", GTMDataDir, GTM_XLOG_OLD_FILE);
+
+	GTM_MutexLockInit(&XLogInsertLock);
+	GTM_MutexLockInit(&XLogFlushLock);
+	GTM_CVInit(&XLogFlushCV);
+
+	if (replay)
+	{
+		xlog_replay_file(XLogOldPath);
+		xlog_replay_file(XLogPath);
+	}
+
+	if ((XLogFd = xlog_open()) < 0)
+		ereport(FATAL,
+				(errno,
+				 errmsg("could not open GTM log file \"%s\": %s",
+						XLogPath, strerror(errno))));
+}
+
+/*
+ * Apply the records of a log segment. A torn or corrupted record ends the
+ * replay of the segment, it was never acknowledged.
+ */
+static void
+xlog_replay_file(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	char rec[GTM_XLOG_MAX_RECORD];
+	int nrecs = 0;
+
+	if (f == NULL)
+		return;
+
+	for (;;)
+	{
+		uint32 len;
+		uint32 check;
+		uint8 type;
+
+		if (fread(rec, GTM_XLOG_HEADER_SIZE, 1, f) != 1)
+			break;
+		memcpy(&len, rec, sizeof(uint32));
+		memcpy(&check, rec + sizeof(uint32), sizeof(uint32));
+		type = rec[sizeof(uint32) * 2];
+
+		if (len <= GTM_XLOG_HEADER_SIZE || len > GTM_XLOG_MAX_RECORD ||
+			fread(rec + GTM_XLOG_HEADER_SIZE,
+				  len - GTM_XLOG_HEADER_SIZE, 1, f) != 1 ||
+			xlog_checksum(rec, len) != check)
+		{
+			elog(LOG, "GTM log file \"%s\" ends with an invalid record",
+				 path);
+			break;
+		}
+
+		if (type == GTM_XLOG_XID &&
+			len == GTM_XLOG_HEADER_SIZE + sizeof(GlobalTransactionId))
+		{
+			GlobalTransactionId gxid;
+
+			memcpy(&gxid, rec + GTM_XLOG_HEADER_SIZE, sizeof(gxid));
+			GTM_RestoreXidReservation(gxid);
+		}
+		else if (type == GTM_XLOG_SEQ &&
+				 len > GTM_XLOG_HEADER_SIZE + sizeof(GTM_Sequence))
+		{
+			GTM_SequenceKeyData seqkey;
+			GTM_Sequence value;
+
+			memcpy(&value, rec + GTM_XLOG_HEADER_SIZE, sizeof(value));
+			seqkey.gsk_key = rec + GTM_XLOG_HEADER_SIZE + sizeof(value);
+			seqkey.gsk_keylen = len - GTM_XLOG_HEADER_SIZE - sizeof(value);
+			seqkey.gsk_type = GTM_SEQ_FULL_NAME;
+			GTM_RestoreSeqReservation(&seqkey, value);
+		}
+		else
+		{
+			elog(LOG, "GTM log file \"%s\" has an unknown record type %d",
+				 path, type);
+			break;
+		}
+		nrecs++;
+	}
+
+	fclose(f);
+	elog(LOG, "Replayed %d records of GTM log file \"%s\"", nrecs, path);
+}
+
+/*
+ * Append a record whose payload is already in place, return the position
+ * just past it.
+ */
+static GTM_XLogPtr
+xlog_insert(char *rec, uint32 len)
+{
+	GTM_XLogPtr ptr;
+	uint32 check;
+	bool checkpoint;
+
+	memcpy(rec, &len, sizeof(uint32));
+	check = xlog_checksum(rec, len);
+	memcpy(rec + sizeof(uint32), &check, sizeof(uint32));
+
+	GTM_MutexLockAcquire(&XLogInsertLock);
+	if (write(XLogFd, rec, len) != len)
+	{
+		GTM_MutexLockRelease(&XLogInsertLock);
+		ereport(FATAL,
+				(errno,
+				 errmsg("could not write GTM log file \"%s\": %s",
+						XLogPath, strerror(errno))));
+	}
+	XLogInsertPtr += len;
+	ptr = XLogInsertPtr;
+	XLogSegmentSize += len;
+	checkpoint = (XLogSegmentSize >= GTM_XLOG_CHECKPOINT_SIZE);
+	GTM_MutexLockRelease(&XLogInsertLock);
+
+	/* The control file gets written once the current message is processed */
+	if (checkpoint)
+		GTM_SetNeedBackup();
+
+	return ptr;
+}
+
+/*
+ * Log the GXID reserved up to
+ */
+GTM_XLogPtr
+GTM_XLogInsertXid(GlobalTransactionId gxid)
+{
+	char rec[GTM_XLOG_MAX_RECORD];
+
+	rec[sizeof(uint32) * 2] = GTM_XLOG_XID;
+	memcpy(rec + GTM_XLOG_HEADER_SIZE, &gxid, sizeof(gxid));
+
+	return xlog_insert(rec, GTM_XLOG_HEADER_SIZE + sizeof(gxid));
+}
+
+/*
+ * Log the value a sequence is reserved up to
+ */
+GTM_XLogPtr
+GTM_XLogInsertSeq(GTM_SequenceKey seqkey, GTM_Sequence value)
+{
+	char rec[GTM_XLOG_MAX_RECORD];
+	uint32 keylen = Min(seqkey->gsk_keylen, GTM_MAX_SEQKEY_LENGTH);
+
+	rec[sizeof(uint32) * 2] = GTM_XLOG_SEQ;
+	memcpy(rec + GTM_XLOG_HEADER_SIZE, &value, sizeof(value));
+	memcpy(rec + GTM_XLOG_HEADER_SIZE + sizeof(value), seqkey->gsk_key, keylen);
+
+	return xlog_insert(rec, GTM_XLOG_HEADER_SIZE + sizeof(value) + keylen);
+}
+
+/*
+ * Wait until the log is fsync'ed up to ptr.
+ *
+ * The first thread to find the log not flushed far enough fsyncs everything
+ * inserted so far on behalf of all the others, which wait for it to finish
+ * and then check again.
+ */
+void
+GTM_XLogFlush(GTM_XLogPtr ptr)
+{
+	if (!GTMStateLog || ptr == InvalidGTMXLogPtr)
+		return;
+
+	GTM_MutexLockAcquire(&XLogFlushLock);
+	while (XLogFlushPtr < ptr)
+	{
+		GTM_XLogPtr target;
+		int fd;
+
+		if (XLogFlushing)
+		{
+			GTM_CVWait(&XLogFlushCV, &XLogFlushLock);
+			continue;
+		}
+		XLogFlushing = true;
+		GTM_MutexLockRelease(&XLogFlushLock);
+
+		GTM_MutexLockAcquire(&XLogInsertLock);
+		target = XLogInsertPtr;
+		fd = XLogFd;
+		GTM_MutexLockRelease(&XLogInsertLock);
+
+		if (fsync(fd) != 0)
+			ereport(FATAL,
+					(errno,
+					 errmsg("could not fsync GTM log file \"%s\": %s",
+							XLogPath, strerror(errno))));
+
+		GTM_MutexLockAcquire(&XLogFlushLock);
+		XLogFlushing = false;
+		if (XLogFlushPtr < target)
+			XLogFlushPtr = target;
+		GTM_CVBcast(&XLogFlushCV);
+	}
+	GTM_MutexLockRelease(&XLogFlushLock);
+}
+
+/*
+ * Start a new log segment, before the control file is written. Everything
+ * logged so far is flushed, and kept in the old segment until the control
+ * file is in place.
+ */
+void
+GTM_XLogSwitch(void)
+{
+	if (!GTMStateLog || XLogFd < 0)
+		return;
+
+	/* No flush may be in progress on the segment being closed */
+	GTM_MutexLockAcquire(&XLogFlushLock);
+	while (XLogFlushing)
+		GTM_CVWait(&XLogFlushCV, &XLogFlushLock);
+
+	GTM_MutexLockAcquire(&XLogInsertLock);
+	if (fsync(XLogFd) != 0)
+		ereport(FATAL,
+				(errno,
+				 errmsg("could not fsync GTM log file \"%s\": %s",
+						XLogPath, strerror(errno))));
+
+	/*
+	 * If the old segment is still there, the previous checkpoint did not
+	 * complete. Keep appending to the current segment rather than losing the
+	 * old one, the records are replayed harmlessly if need be.
+	 */
+	if (access(XLogOldPath, F_OK) != 0)
+	{
+		close(XLogFd);
+
+		if (rename(XLogPath, XLogOldPath) != 0)
+			ereport(FATAL,
+					(errno,
+					 errmsg("could not rename GTM log file \"%s\": %s",
+							XLogPath, strerror(errno))));
+		if ((XLogFd = xlog_open()) < 0)
+			ereport(FATAL,
+					(errno,
+					 errmsg("could not open GTM log file \"%s\": %s",
+							XLogPath, strerror(errno))));
+		XLogSegmentSize = 0;
+	}
+	XLogFlushPtr = XLogInsertPtr;
+	GTM_MutexLockRelease(&XLogInsertLock);
+
+	GTM_CVBcast(&XLogFlushCV);
+	GTM_MutexLockRelease(&XLogFlushLock);
+}
+
+/*
+ * The control file written after GTM_XLogSwitch is in place, the previous
+ * segment is not needed anymore.
+ */
+void
+GTM_XLogRemoveOld(void)
+{
+	if (!GTMStateLog || XLogFd < 0)
+		return;
+
+	if (unlink(XLogOldPath) != 0 && errno != ENOENT)
+		elog(LOG, "could not remove GTM log file \"%s\": %s",
+			 XLogOldPath, strerror(errno));
+}
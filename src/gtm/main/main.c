@@ -26,6 +26,9 @@
 #include <stdio.h>
 
 #include "gtm/gtm_c.h"
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 #include "gtm/path.h"
 #include "gtm/gtm.h"
 #include "gtm/elog.h"
@@ -48,6 +51,7 @@
 #include "gtm/gtm_opt.h"
 #include "gtm/gtm_utils.h"
 #include "gtm/gtm_backup.h"
+#include "gtm/gtm_xlog.h"
 
 extern int	optind;
 extern char *optarg;
@@ -70,6 +74,8 @@ int 		active_port;
 int			tcp_keepalives_idle;
 int			tcp_keepalives_interval;
 int			tcp_keepalives_count;
+int			GTMWorkerThreads = 0;
+bool		GTMStandbyStreaming = false;
 char		*error_reporter;
 char		*status_reader;
 bool		isStartUp;
@@ -94,12 +100,23 @@ static int	ListenSocket[MAXLISTEN];
 pthread_key_t	threadinfo_key;
 static bool		GTMAbortPending = false;
 
+#ifdef HAVE_SYS_EPOLL_H
+/* Poll set of the connections served by the worker pool, see GTM_WorkerMain */
+static int		GTMWorkerPollFd = -1;
+static int		GTMWorkersRunning = 0;
+static GTM_MutexLock	GTMWorkerLock;
+#endif
+
 static void GTM_SaveVersion(FILE *ctlf);
 
 static Port *ConnCreate(int serverFd);
 static int ServerLoop(void);
 static int initMasks(fd_set *rmask);
 void *GTM_ThreadMain(void *argp);
+#ifdef HAVE_SYS_EPOLL_H
+static void *GTM_WorkerMain(void *argp);
+static void GTM_StartWorkerThreads(void);
+#endif
 static int GTMAddConnection(Port *port, GTM_Conn *standby);
 static int ReadCommand(Port *myport, StringInfo inBuf);
 
@@ -229,6 +246,7 @@ BaseInit()
 	DebugFileOpen();
 
 	GTM_InitTxnManager();
+	GTM_InitSnapshotCache();
 	GTM_InitSeqManager();
 	GTM_InitNodeManager();
 }
@@ -314,6 +332,17 @@ SaveControlInfo(void)
 {
 	FILE	   *ctlf;
 
+	/*
+	 * With the state log, the control file holds the reservations only, it
+	 * is written as a checkpoint of the log.
+	 */
+	if (GTMStateLog)
+	{
+		GTM_SetNeedBackup();
+		GTM_WriteRestorePoint();
+		return;
+	}
+
 	GTM_MutexLockAcquire(&control_lock);
 
 	ctlf = fopen(GTMControlFileTmp, "w");
@@ -653,6 +682,9 @@ main(int argc, char *argv[])
 			exit(1);
 		}
 		elog(LOG, "Restoring sequences from the active-GTM succeeded.");
+
+		/* The state restored from the active-GTM supersedes the local log */
+		GTM_XLogStartup(false);
 	}
 	else
 	{
@@ -710,6 +742,9 @@ main(int argc, char *argv[])
 			fclose(ctlf);
 
 		GTM_MutexLockRelease(&control_lock);
+
+		/* Replay the reservations made after the last checkpoint */
+		GTM_XLogStartup(true);
 	}
 
 	/* Backup the restore point */
@@ -829,9 +864,30 @@ main(int argc, char *argv[])
 		elog(DEBUG1, "Startup connection with the active-GTM closed.");
 	}
 
+	/*
+	 * Set up the poll set shared by worker threads, if configured. The
+	 * workers themselves are started by ServerLoop.
+	 */
+	if (GTMWorkerThreads > 0)
+	{
+#ifdef HAVE_SYS_EPOLL_H
+		GTM_MutexLockInit(&GTMWorkerLock);
+		GTMWorkerPollFd = epoll_create1(EPOLL_CLOEXEC);
+		if (GTMWorkerPollFd < 0)
+			ereport(FATAL,
+					(errno,
+					 errmsg("could not create epoll file descriptor: %m")));
+		elog(LOG, "Serving client connections with %d worker threads.",
+			 GTMWorkerThreads);
+#else
+		elog(LOG, "\"%s\" is not supported on this platform, starting a thread for each connection.",
+			 GTM_OPTNAME_WORKER_THREADS);
+#endif
+	}
+
 	/*
 	 * Accept any new connections. Fork a new thread for each incoming
-	 * connection
+	 * connection, or hand it to the worker pool.
 	 */
 	status = ServerLoop();
 
@@ -891,6 +947,24 @@ ServerLoop(void)
 
 	nSockets = initMasks(&readmask);
 
+#ifdef HAVE_SYS_EPOLL_H
+	/*
+	 * Worker threads must start with all signals blocked, like the threads
+	 * started for new connections below.
+	 */
+	if (GTMWorkerPollFd >= 0)
+	{
+		PG_SETMASK(&BlockSig);
+		GTM_StartWorkerThreads();
+	}
+#endif
+
+	if (GTMStandbyStreaming)
+	{
+		PG_SETMASK(&BlockSig);
+		gtm_standby_start_stream();
+	}
+
 	for (;;)
 	{
 		fd_set		rmask;
@@ -969,6 +1043,12 @@ ServerLoop(void)
 		 */
 		PG_SETMASK(&BlockSig);
 
+#ifdef HAVE_SYS_EPOLL_H
+		/* Replace any worker thread which exited on a FATAL error */
+		if (GTMWorkerPollFd >= 0)
+			GTM_StartWorkerThreads();
+#endif
+
 		/* Now check the select() result */
 		if (selres < 0)
 		{
@@ -1048,38 +1128,15 @@ initMasks(fd_set *rmask)
 }
 
 
-void *
-GTM_ThreadMain(void *argp)
+/*
+ * Process the startup packet of a new connection and send the client
+ * identifier back. thrinfo->thr_client_id must hold the identifier issued
+ * to the connection; it is replaced by the one resent by the client, if we
+ * accept that.
+ */
+static void
+GTM_ConnectionStartup(GTM_ThreadInfo *thrinfo)
 {
-	GTM_ThreadInfo *thrinfo = (GTM_ThreadInfo *)argp;
-	int qtype;
-	StringInfoData input_message;
-	sigjmp_buf  local_sigjmp_buf;
-
-	elog(DEBUG3, "Starting the connection helper thread");
-
-
-	/*
-	 * Create the memory context we will use in the main loop.
-	 *
-	 * MessageContext is reset once per iteration of the main loop, ie, upon
-	 * completion of processing of each command message from the client.
-	 *
-	 * This context is thread-specific
-	 */
-	MessageContext = AllocSetContextCreate(TopMemoryContext,
-										   "MessageContext",
-										   ALLOCSET_DEFAULT_MINSIZE,
-										   ALLOCSET_DEFAULT_INITSIZE,
-										   ALLOCSET_DEFAULT_MAXSIZE,
-										   false);
-
-	/*
-	 * Acquire the thread lock to prevent connection from GTM-Standby to update
-	 * GTM-Standby registration.
-	 */
-	GTM_RWLockAcquire(&thrinfo->thr_lock, GTM_LOCKMODE_WRITE);
-
 	{
 		/*
 		 * We expect a startup message at the very start. The message type is
@@ -1114,6 +1171,16 @@ GTM_ThreadMain(void *argp)
 			   sizeof (GTM_StartupPacket));
 		pq_getmsgend(&inBuf);
 
+		/*
+		 * A client which knows about both the GTM master and the standby asks
+		 * us to refuse the connection unless we are the active one, so that it
+		 * does not issue requests to a standby which has not been promoted.
+		 */
+		if (sp.sp_active_only && Recovery_IsStandby())
+			ereport(ERROR,
+					(EPERM,
+					 errmsg("GTM is running in STANDBY mode -- connection refused")));
+
 		GTM_RegisterPGXCNode(thrinfo->thr_conn->con_port, sp.sp_node_name);
 
 		thrinfo->thr_conn->con_port->remote_type = sp.sp_remotetype;
@@ -1149,6 +1216,156 @@ GTM_ThreadMain(void *argp)
 
 		elog(DEBUG3, "Sent connection authentication message to the client");
 	}
+}
+
+/*
+ * Check if GTM Standby info is upadted and connect to, or disconnect from,
+ * the standby on behalf of the connection being served.
+ */
+static void
+GTM_CheckStandbyConnection(GTM_ThreadInfo *thrinfo)
+{
+	GTM_ConnectionInfo *conninfo = thrinfo->thr_conn;
+
+	/*
+	 * A connection which sat idle in the worker pool while a new standby
+	 * registered still refers to the old one.
+	 */
+	if (conninfo->standby &&
+			conninfo->con_standby_generation != GTMThreads->gt_standby_generation)
+	{
+		GTMPQfinish(conninfo->standby);
+		conninfo->standby = NULL;
+	}
+
+	/*
+	 * Please note that we don't check if it is not in the standby mode to allow cascased standby.
+	 *
+	 * Also ensure that we don't try to connect just yet if we are
+	 * responsible for serving the BACKUP request from the standby.
+	 * Otherwise, this will lead to a deadlock
+	 */
+	if (GTMThreads->gt_standby_ready &&
+			conninfo->standby == NULL &&
+			thrinfo->thr_status != GTM_THREAD_BACKUP)
+	{
+		/* Connect to GTM-Standby */
+		conninfo->standby = gtm_standby_connect_to_standby();
+		conninfo->con_standby_generation = GTMThreads->gt_standby_generation;
+		if (conninfo->standby == NULL)
+			GTMThreads->gt_standby_ready = false;	/* This will make other threads to disconnect from
+													 * the standby, if needed.*/
+	}
+	else if (GTMThreads->gt_standby_ready == false && conninfo->standby)
+	{
+		/* Disconnect from GTM-Standby */
+		gtm_standby_disconnect_from_standby(conninfo->standby);
+		conninfo->standby = NULL;
+	}
+}
+
+/*
+ * Process one message read from the connection being served. Returns false
+ * if the client terminated the connection, in which case the transactions
+ * it left open have already been removed.
+ */
+static bool
+GTM_ProcessMessage(GTM_ThreadInfo *thrinfo, int qtype, StringInfo input_message)
+{
+	switch(qtype)
+	{
+		case 'C':
+			ProcessCommand(thrinfo->thr_conn->con_port, input_message);
+			break;
+
+		case 'X':
+			elog(DEBUG1, "Removing all transaction infos - qtype:X");
+		case EOF:
+			/*
+			 * Connection termination request
+			 * Remove all transactions opened within the connection. Note that
+			 * we don't remove transaction infos if we are a standby and
+			 * the transaction infos actually correspond to in-progress
+			 * transactions on the master
+			 */
+			elog(DEBUG1, "Removing all transaction infos - qtype:EOF");
+			if (!Recovery_IsStandby())
+				GTM_RemoveAllTransInfos(thrinfo->thr_client_id, -1);
+
+			/* Disconnect node if necessary */
+			Recovery_PGXCNodeDisconnect(thrinfo->thr_conn->con_port);
+			return false;
+
+		case 'F':
+			/*
+			 * Flush all the outgoing data on the wire. Consume the message
+			 * type field for sanity
+			 */
+			/* Sync with standby first */
+			if (thrinfo->thr_conn->standby)
+			{
+				if (Backup_synchronously)
+					gtm_standby_sync(thrinfo->thr_conn->standby);
+				else
+					gtmpqFlush(thrinfo->thr_conn->standby);
+			}
+			pq_getmsgint(input_message, sizeof (GTM_MessageType));
+			pq_getmsgend(input_message);
+			pq_flush(thrinfo->thr_conn->con_port);
+			break;
+
+		default:
+			/*
+			 * Remove all transactions opened by the client
+			 */
+			GTM_RemoveAllTransInfos(thrinfo->thr_client_id, -1);
+
+			/* Disconnect node if necessary */
+			Recovery_PGXCNodeDisconnect(thrinfo->thr_conn->con_port);
+
+			ereport(FATAL,
+					(EPROTO,
+					 errmsg("invalid frontend message type %d",
+							qtype)));
+			break;
+	}
+
+	return true;
+}
+
+void *
+GTM_ThreadMain(void *argp)
+{
+	GTM_ThreadInfo *thrinfo = (GTM_ThreadInfo *)argp;
+	int qtype;
+	StringInfoData input_message;
+	sigjmp_buf  local_sigjmp_buf;
+
+	elog(DEBUG3, "Starting the connection helper thread");
+
+
+	/*
+	 * Create the memory context we will use in the main loop.
+	 *
+	 * MessageContext is reset once per iteration of the main loop, ie, upon
+	 * completion of processing of each command message from the client.
+	 *
+	 * This context is thread-specific
+	 */
+	MessageContext = AllocSetContextCreate(TopMemoryContext,
+										   "MessageContext",
+										   ALLOCSET_DEFAULT_MINSIZE,
+										   ALLOCSET_DEFAULT_INITSIZE,
+										   ALLOCSET_DEFAULT_MAXSIZE,
+										   false);
+
+	/*
+	 * Acquire the thread lock to prevent connection from GTM-Standby to update
+	 * GTM-Standby registration.
+	 */
+	GTM_RWLockAcquire(&thrinfo->thr_lock, GTM_LOCKMODE_WRITE);
+
+	GTM_ConnectionStartup(thrinfo);
 
 	/*
 	 * Get the input_message in the TopMemoryContext so that we don't need to
@@ -1183,6 +1400,9 @@ GTM_ThreadMain(void *argp)
 		 * error recovery, such as adjusting the FE/BE protocol status.
 		 */
 
+		/* The failed command is not counted */
+		thrinfo->thr_stats.gts_busy = false;
+
 		/* Report the error to the client and/or server log */
 		if (thrinfo->thr_conn)
 			EmitErrorReport(thrinfo->thr_conn->con_port);
@@ -1229,106 +1449,253 @@ GTM_ThreadMain(void *argp)
 		qtype = ReadCommand(thrinfo->thr_conn->con_port, &input_message);
 
 		GTM_RWLockAcquire(&thrinfo->thr_lock, GTM_LOCKMODE_WRITE);
+
+		GTM_CheckStandbyConnection(thrinfo);
+
+		if (!GTM_ProcessMessage(thrinfo, qtype, &input_message))
+		{
+			GTM_RWLockRelease(&thrinfo->thr_lock);
+			pthread_exit(thrinfo);
+		}
+	}
+
+	/* can't get here because the above loop never exits */
+	Assert(false);
+
+	return thrinfo;
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+/*
+ * Hand a connection back to the worker pool, so that the next message on it
+ * is picked up by whichever worker thread becomes free first.
+ */
+static void
+GTM_WorkerRearmConnection(GTM_ConnectionInfo *conninfo)
+{
+	struct epoll_event event;
+
+	event.events = EPOLLIN | EPOLLONESHOT;
+	event.data.ptr = conninfo;
+
+	if (epoll_ctl(GTMWorkerPollFd, EPOLL_CTL_MOD, conninfo->con_port->sock,
+				  &event) < 0)
+		elog(LOG, "could not rearm client connection in the worker pool: %m");
+}
+
+/*
+ * Close the connection being served by a worker thread.
+ */
+static void
+GTM_WorkerCloseConnection(GTM_ThreadInfo *thrinfo)
+{
+	GTM_ConnectionInfo *conninfo = thrinfo->thr_conn;
+
+	thrinfo->thr_conn = NULL;
+	GTM_ConnectionClose(conninfo);
+}
+
+/*
+ * Cleanup routine of a worker thread, run when a FATAL error ends it. The
+ * main thread starts a replacement next time it wakes up.
+ */
+static void
+GTM_WorkerExit(void *argp)
+{
+	GTM_MutexLockAcquire(&GTMWorkerLock);
+	GTMWorkersRunning--;
+	GTM_MutexLockRelease(&GTMWorkerLock);
+}
+
+/*
+ * Main routine of a worker thread of the connection pool.
+ *
+ * All workers wait on one epoll set which holds every pooled connection
+ * registered with EPOLLONESHOT. The kernel hands each ready connection to
+ * exactly one waiting worker, so the ready list acts as the dispatch queue
+ * and no user-space queue or lock is needed. The worker serves all the
+ * messages buffered on the connection before rearming it, and keeps serving
+ * the same connection while it runs a backup for the standby, since all the
+ * other threads are locked out until that finishes.
+ */
+static void *
+GTM_WorkerMain(void *argp)
+{
+	GTM_ThreadInfo *thrinfo = (GTM_ThreadInfo *)argp;
+	int qtype;
+	StringInfoData input_message;
+	sigjmp_buf  local_sigjmp_buf;
+
+	elog(DEBUG3, "Starting a worker thread");
+
+	thrinfo->thr_conn = NULL;
+
+	/*
+	 * MessageContext is reset before each message, like in GTM_ThreadMain.
+	 */
+	MessageContext = AllocSetContextCreate(TopMemoryContext,
+										   "MessageContext",
+										   ALLOCSET_DEFAULT_MINSIZE,
+										   ALLOCSET_DEFAULT_INITSIZE,
+										   ALLOCSET_DEFAULT_MAXSIZE,
+										   false);
+
+	initStringInfo(&input_message);
+
+	pthread_cleanup_push(GTM_WorkerExit, thrinfo);
+
+	/*
+	 * The thread lock is held while serving a connection and released while
+	 * waiting for one, so that a backup for the standby can lock us out.
+	 */
+	GTM_RWLockAcquire(&thrinfo->thr_lock, GTM_LOCKMODE_WRITE);
+
+	if (sigsetjmp(local_sigjmp_buf, 1) != 0)
+	{
+		/* The failed command is not counted */
+		thrinfo->thr_stats.gts_busy = false;
+
+		/* Report the error to the client and/or server log */
+		if (thrinfo->thr_conn)
+			EmitErrorReport(thrinfo->thr_conn->con_port);
+		else
+			EmitErrorReport(NULL);
+
+		MemoryContextSwitchTo(TopMemoryContext);
+		FlushErrorState();
+
 		/*
-		 * Check if GTM Standby info is upadted
-		 * Maybe the following lines can be a separate function.   At present, this is done only here so
-		 * I'll leave them here.   K.Suzuki, Nov.29, 2011
-		 * Please note that we don't check if it is not in the standby mode to allow cascased standby.
-		 *
-		 * Also ensure that we don't try to connect just yet if we are
-		 * responsible for serving the BACKUP request from the standby.
-		 * Otherwise, this will lead to a deadlock
+		 * A connection which failed the startup handshake is closed, like the
+		 * dedicated thread would have exited. Others go back to the pool,
+		 * unless they are running a backup.
 		 */
-		if (GTMThreads->gt_standby_ready &&
-				thrinfo->thr_conn->standby == NULL &&
-				thrinfo->thr_status != GTM_THREAD_BACKUP)
+		if (thrinfo->thr_conn)
 		{
-			/* Connect to GTM-Standby */
-			thrinfo->thr_conn->standby = gtm_standby_connect_to_standby();
-			if (thrinfo->thr_conn->standby == NULL)
-				GTMThreads->gt_standby_ready = false;	/* This will make other threads to disconnect from
-														 * the standby, if needed.*/
+			if (!thrinfo->thr_conn->con_authenticated)
+				GTM_WorkerCloseConnection(thrinfo);
+			else if (thrinfo->thr_status != GTM_THREAD_BACKUP)
+			{
+				GTM_WorkerRearmConnection(thrinfo->thr_conn);
+				thrinfo->thr_conn = NULL;
+			}
 		}
-		else if (GTMThreads->gt_standby_ready == false && thrinfo->thr_conn->standby)
+	}
+
+	/* We can now handle ereport(ERROR) */
+	PG_exception_stack = &local_sigjmp_buf;
+
+	for (;;)
+	{
+		GTM_ConnectionInfo *conninfo;
+		Port	   *port;
+
+		if (thrinfo->thr_conn == NULL)
 		{
-			/* Disconnect from GTM-Standby */
-			gtm_standby_disconnect_from_standby(thrinfo->thr_conn->standby);
-			thrinfo->thr_conn->standby = NULL;
+			struct epoll_event event;
+			int			nevents;
+
+			GTM_RWLockRelease(&thrinfo->thr_lock);
+			nevents = epoll_wait(GTMWorkerPollFd, &event, 1, -1);
+			GTM_RWLockAcquire(&thrinfo->thr_lock, GTM_LOCKMODE_WRITE);
+
+			if (nevents < 0)
+			{
+				if (errno != EINTR)
+					elog(LOG, "epoll_wait() failed in worker thread: %m");
+				continue;
+			}
+			if (nevents == 0)
+				continue;
+
+			thrinfo->thr_conn = (GTM_ConnectionInfo *) event.data.ptr;
 		}
 
-		switch(qtype)
+		conninfo = thrinfo->thr_conn;
+		port = conninfo->con_port;
+		thrinfo->thr_client_id = conninfo->con_client_id;
+
+		MemoryContextSwitchTo(MessageContext);
+		MemoryContextResetAndDeleteChildren(MessageContext);
+
+		if (!conninfo->con_authenticated)
 		{
-			case 'C':
-				ProcessCommand(thrinfo->thr_conn->con_port, &input_message);
-				break;
+			GTM_ConnectionStartup(thrinfo);
+			conninfo->con_client_id = thrinfo->thr_client_id;
+			conninfo->con_authenticated = true;
 
-			case 'X':
-				elog(DEBUG1, "Removing all transaction infos - qtype:X");
-			case EOF:
-				/*
-				 * Connection termination request
-				 * Remove all transactions opened within the thread. Note that
-				 * we don't remove transaction infos if we are a standby and
-				 * the transaction infos actually correspond to in-progress
-				 * transactions on the master
-				 */
-				elog(DEBUG1, "Removing all transaction infos - qtype:EOF");
-				if (!Recovery_IsStandby())
-					GTM_RemoveAllTransInfos(thrinfo->thr_client_id, -1);
-
-				/* Disconnect node if necessary */
-				Recovery_PGXCNodeDisconnect(thrinfo->thr_conn->con_port);
-				GTM_RWLockRelease(&thrinfo->thr_lock);
-				pthread_exit(thrinfo);
-				break;
+			GTM_WorkerRearmConnection(conninfo);
+			thrinfo->thr_conn = NULL;
+			continue;
+		}
 
-			case 'F':
-				/*
-				 * Flush all the outgoing data on the wire. Consume the message
-				 * type field for sanity
-				 */
-				/* Sync with standby first */
-				if (thrinfo->thr_conn->standby)
-				{
-					if (Backup_synchronously)
-						gtm_sync_standby(thrinfo->thr_conn->standby);
-					else
-						gtmpqFlush(thrinfo->thr_conn->standby);
-				}
-				pq_getmsgint(&input_message, sizeof (GTM_MessageType));
-				pq_getmsgend(&input_message);
-				pq_flush(thrinfo->thr_conn->con_port);
-				break;
+		/*
+		 * Serve every message the client has already sent. Once the receive
+		 * buffer is drained, epoll tells us about any more data on the socket.
+		 */
+		do
+		{
+			MemoryContextSwitchTo(MessageContext);
+			MemoryContextResetAndDeleteChildren(MessageContext);
+			resetStringInfo(&input_message);
 
-			default:
-				/*
-				 * Remove all transactions opened by the client
-				 */
-				GTM_RemoveAllTransInfos(thrinfo->thr_client_id, -1);
+			qtype = ReadCommand(port, &input_message);
 
-				/* Disconnect node if necessary */
-				Recovery_PGXCNodeDisconnect(thrinfo->thr_conn->con_port);
+			GTM_CheckStandbyConnection(thrinfo);
 
-				ereport(FATAL,
-						(EPROTO,
-						 errmsg("invalid frontend message type %d",
-								qtype)));
+			if (!GTM_ProcessMessage(thrinfo, qtype, &input_message))
+			{
+				GTM_WorkerCloseConnection(thrinfo);
 				break;
-		}
+			}
+		} while (thrinfo->thr_status == GTM_THREAD_BACKUP ||
+				 port->PqRecvPointer < port->PqRecvLength);
 
+		if (thrinfo->thr_conn)
+		{
+			GTM_WorkerRearmConnection(conninfo);
+			thrinfo->thr_conn = NULL;
+		}
 	}
 
 	/* can't get here because the above loop never exits */
-	Assert(false);
+	pthread_cleanup_pop(1);
 
 	return thrinfo;
 }
 
+/*
+ * Start worker threads until the configured number are running. Called by
+ * the main thread at startup, and again later to replace workers which
+ * exited on a FATAL error.
+ */
+static void
+GTM_StartWorkerThreads(void)
+{
+	GTM_MutexLockAcquire(&GTMWorkerLock);
+	while (GTMWorkersRunning < GTMWorkerThreads)
+	{
+		if (GTM_ThreadCreate(NULL, GTM_WorkerMain) == NULL)
+		{
+			GTM_MutexLockRelease(&GTMWorkerLock);
+			ereport(LOG,
+					(EAGAIN,
+					 errmsg("could not start worker thread, %d of %d running",
+							GTMWorkersRunning, GTMWorkerThreads)));
+			return;
+		}
+		GTMWorkersRunning++;
+	}
+	GTM_MutexLockRelease(&GTMWorkerLock);
+}
+#endif
+
 void
 ProcessCommand(Port *myport, StringInfo input_message)
 {
 	GTM_MessageType mtype;
 	GTM_ProxyMsgHeader proxyhdr;
+	GTM_ThreadStats *stats = &GetMyThreadInfo->thr_stats;
+	uint64		start;
 
 	if (myport->remote_type == GTM_NODE_GTM_PROXY)
 		pq_copymsgbytes(input_message, (char *)&proxyhdr, sizeof (GTM_ProxyMsgHeader));
@@ -1344,6 +1711,9 @@ ProcessCommand(Port *myport, StringInfo input_message)
 	 */
 	elog(DEBUG1, "mtype = %s (%d).", gtm_util_message_name(mtype), (int)mtype);
 
+	stats->gts_busy = true;
+	start = GTM_StatNow();
+
 	switch (mtype)
 	{
 		case MSG_SYNC_STANDBY:
@@ -1402,6 +1772,7 @@ ProcessCommand(Port *myport, StringInfo input_message)
 		case MSG_SNAPSHOT_GET:
 		case MSG_SNAPSHOT_GXID_GET:
 		case MSG_SNAPSHOT_GET_MULTI:
+		case MSG_SNAPSHOT_GET_DELTA:
 			ProcessSnapshotCommand(myport, mtype, input_message);
 			break;
 
@@ -1410,6 +1781,7 @@ ProcessCommand(Port *myport, StringInfo input_message)
 		case MSG_SEQUENCE_GET_CURRENT:
 		case MSG_SEQUENCE_GET_NEXT:
 		case MSG_BKUP_SEQUENCE_GET_NEXT:
+		case MSG_SEQUENCE_GET_NEXT_MULTI:
 		case MSG_SEQUENCE_GET_LAST:
 		case MSG_SEQUENCE_SET_VAL:
 		case MSG_BKUP_SEQUENCE_SET_VAL:
@@ -1442,12 +1814,20 @@ ProcessCommand(Port *myport, StringInfo input_message)
 			ProcessPGXCNodeBackendDisconnect(myport, input_message);
 			break;
 
+		case MSG_GET_STATS:
+			ProcessGetStatsCommand(myport, input_message);
+			break;
+
 		default:
 			ereport(FATAL,
 					(EPROTO,
 					 errmsg("invalid frontend message type %d",
 							mtype)));
 	}
+
+	gtm_stat_record(&stats->gts_messages[mtype], GTM_StatNow() - start);
+	stats->gts_busy = false;
+
 	if (GTM_NeedBackup())
 		GTM_WriteRestorePoint();
 }
@@ -1467,6 +1847,34 @@ GTMAddConnection(Port *port, GTM_Conn *standby)
 	 */
 	if (standby != NULL)
 		conninfo->standby = standby;
+	conninfo->con_standby_generation = GTMThreads->gt_standby_generation;
+
+#ifdef HAVE_SYS_EPOLL_H
+	/*
+	 * With a worker pool, just add the connection to the poll set. One of the
+	 * workers will process the startup packet once it arrives.
+	 */
+	if (GTMWorkerPollFd >= 0)
+	{
+		struct epoll_event event;
+
+		conninfo->con_client_id = GTM_AssignClientIdentifier();
+
+		event.events = EPOLLIN | EPOLLONESHOT;
+		event.data.ptr = conninfo;
+
+		if (epoll_ctl(GTMWorkerPollFd, EPOLL_CTL_ADD, port->sock, &event) < 0)
+		{
+			ereport(LOG,
+					(errno,
+					 errmsg("could not add client connection to the worker pool: %m")));
+			pfree(conninfo);
+			return STATUS_ERROR;
+		}
+
+		return STATUS_OK;
+	}
+#endif
 
 	/*
 	 * XXX Start the thread
@@ -1562,7 +1970,7 @@ ProcessSyncStandbyCommand(Port *myport, GTM_MessageType mtype, StringInfo messag
 	pq_endmessage(myport, &buf);
 	/* Sync standby first */
 	if (GetMyThreadInfo->thr_conn->standby)
-		gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+		gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 	pq_flush(myport);
 }
 
@@ -1753,6 +2161,10 @@ ProcessSnapshotCommand(Port *myport, GTM_MessageType mtype, StringInfo message)
 			ProcessGetSnapshotCommandMulti(myport, message);
 			break;
 
+		case MSG_SNAPSHOT_GET_DELTA:
+			ProcessGetSnapshotCommandDelta(myport, message);
+			break;
+
 		case MSG_SNAPSHOT_GXID_GET:
 			ProcessGetSnapshotCommand(myport, message, true);
 			break;
@@ -1796,6 +2208,10 @@ ProcessSequenceCommand(Port *myport, GTM_MessageType mtype, StringInfo message)
 			ProcessSequenceGetNextCommand(myport, message, true);
 			break;
 
+		case MSG_SEQUENCE_GET_NEXT_MULTI:
+			ProcessSequenceGetNextMultiCommand(myport, message);
+			break;
+
 		case MSG_SEQUENCE_SET_VAL:
 			ProcessSequenceSetValCommand(myport, message, false);
 			break;
@@ -2268,7 +2684,7 @@ static void ProcessBarrierCommand(Port *myport, GTM_MessageType mtype, StringInf
 			goto retry;
 
 		if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-			gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+			gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 	}
 
 	GTM_WriteBarrierBackup(barrier_id);
@@ -2425,6 +2841,28 @@ GTM_SaveTxnInfo(FILE *ctlf)
 void
 GTM_WriteRestorePointXid(FILE *f)
 {
+	/*
+	 * With the state log, the GXIDs reserved are already durable, save the
+	 * reservation as is, or the next GXID if none was made since startup.
+	 */
+	if (GTMStateLog)
+	{
+		GlobalTransactionId saved_gxid;
+
+		GTM_RWLockAcquire(&GTMTransactions.gt_XidGenLock, GTM_LOCKMODE_READ);
+		if (GlobalTransactionIdFollows(GTMTransactions.gt_backedUpXid,
+									   GTMTransactions.gt_nextXid))
+			saved_gxid = GTMTransactions.gt_backedUpXid;
+		else
+			saved_gxid = GTMTransactions.gt_nextXid;
+		GTM_RWLockRelease(&GTMTransactions.gt_XidGenLock);
+
+		elog(DEBUG1, "Saving transaction restoration info, reserved gxid: %u", saved_gxid);
+		fprintf(f, "next_xid: %u\n", saved_gxid);
+		fprintf(f, "global_xmin: %u\n", saved_gxid);
+		return;
+	}
+
 	if ((MaxGlobalTransactionId - GTMTransactions.gt_nextXid) <= RestoreDuration)
 		GTMTransactions.gt_backedUpXid = GTMTransactions.gt_nextXid + RestoreDuration;
 	else
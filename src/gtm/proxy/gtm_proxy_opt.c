@@ -51,7 +51,10 @@ extern char *GTMServerHost;
 extern int GTMProxyPortNumber;
 extern int GTMConnectRetryInterval;
 extern int GTMServerPortNumber;
+extern char *GTMStandbyHost;
+extern int GTMStandbyPortNumber;
 extern int GTMProxyWorkerThreads;
+extern int GTMProxyBatchWindow;
 extern char *GTMProxyDataDir;
 extern char *GTMProxyConfigFileName;
 extern char *GTMConfigFileName;
@@ -165,6 +168,17 @@ struct config_int ConfigureNamesInt[] =
 		0, 0, INT_MAX,
 	    0, NULL
 	},
+	{
+		{
+			GTM_OPTNAME_GTM_STANDBY_PORT, GTMC_SIGHUP,
+			gettext_noop("GTM standby port number."),
+			NULL,
+			0
+		},
+		&GTMStandbyPortNumber,
+		0, 0, INT_MAX,
+	    0, NULL
+	},
 	{
 		{
 			GTM_OPTNAME_CONNECT_RETRY_INTERVAL, GTMC_SIGHUP,
@@ -220,6 +234,17 @@ struct config_int ConfigureNamesInt[] =
 		GTM_PROXY_DEFAULT_WORKERS, 1, INT_MAX,
 		0, NULL
 	},
+	{
+		{
+			GTM_OPTNAME_BATCH_WINDOW, GTMC_SIGHUP,
+			gettext_noop("Longest wait for more commands to group, in microseconds."),
+			gettext_noop("Zero disables the wait."),
+			0
+		},
+		&GTMProxyBatchWindow,
+		0, 0, 1000000,
+		0, NULL
+	},
 	/* End-of-list marker */
 	{
 		{NULL, 0, NULL, NULL, 0}, NULL, 0, 0, 0, 0, NULL
@@ -299,6 +324,18 @@ struct config_string ConfigureNamesString[] =
 		NULL, NULL
 	},
 
+	{
+		{
+			GTM_OPTNAME_GTM_STANDBY_HOST, GTMC_SIGHUP,
+			gettext_noop("Address of the GTM standby to fail over to."),
+			NULL,
+			0
+		},
+		&GTMStandbyHost,
+		NULL,
+		NULL, NULL
+	},
+
 	{
 		{
 			GTM_OPTNAME_LOG_FILE, GTMC_SIGHUP,
@@ -22,6 +22,7 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <arpa/inet.h>
 #include <getopt.h>
 
 #include "gtm/gtm_c.h"
@@ -40,6 +41,7 @@
 #include "gtm/gtm_txn.h"
 #include "gtm/gtm_seq.h"
 #include "gtm/gtm_msg.h"
+#include "gtm/gtm_utils.h"
 #include "gtm/libpq-int.h"
 #include "gtm/gtm_ip.h"
 #include "gtm/gtm_standby.h"
@@ -76,8 +78,23 @@ char		*GTMConfigFileName;
 char		*GTMServerHost;
 int			GTMServerPortNumber;
 
+/*
+ * GTM standby the worker threads fail over to when the connection to GTM is
+ * lost. The two servers are swapped once a thread has failed over, under
+ * GTMServerLock, so that the other threads go to the new GTM first.
+ */
+char		*GTMStandbyHost;
+int			GTMStandbyPortNumber;
+static GTM_MutexLock GTMServerLock;
+
 int			GTMConnectRetryInterval = 60;
 
+/*
+ * Longest time, in microseconds, a worker waits for more commands to group
+ * with the ones it has already read. Zero disables the wait.
+ */
+int			GTMProxyBatchWindow = 0;
+
 /*
  * Keepalives setup for the connection with GTM server
  */
@@ -151,6 +168,8 @@ static GTM_Conn *HandleGTMError(GTM_Conn *gtm_conn);
 static GTM_Conn *HandlePostCommand(GTMProxy_ConnectionInfo *conninfo, GTM_Conn *gtm_conn);
 static void ProcessTransactionCommand(GTMProxy_ConnectionInfo *conninfo,
 		GTM_Conn *gtm_conn, GTM_MessageType mtype, StringInfo message);
+static void ProcessSequenceCommand(GTMProxy_ConnectionInfo *conninfo,
+		GTM_Conn *gtm_conn, GTM_MessageType mtype, StringInfo message);
 static void ProcessSnapshotCommand(GTMProxy_ConnectionInfo *conninfo,
 		GTM_Conn *gtm_conn, GTM_MessageType mtype, StringInfo message);
 
@@ -162,6 +181,10 @@ static void GTMProxy_RegisterPGXCNode(GTMProxy_ConnectionInfo *conninfo,
 static void ProcessResponse(GTMProxy_ThreadInfo *thrinfo,
 		GTMProxy_CommandInfo *cmdinfo, GTM_Result *res);
 
+static int GTMProxy_ReadCommands(GTMProxy_ThreadInfo *thrinfo,
+		StringInfo input_message);
+static void GTMProxy_WaitForBatch(GTMProxy_ThreadInfo *thrinfo,
+		StringInfo input_message, int nread);
 static void GTMProxy_ProcessPendingCommands(GTMProxy_ThreadInfo *thrinfo);
 static void GTMProxy_CommandPending(GTMProxy_ConnectionInfo *conninfo,
 		GTM_MessageType mtype, GTMProxy_CommandData cmd_data);
@@ -181,6 +204,7 @@ static void workerThreadReconnectToGTM(void);
 #ifdef USE_ASSERT_CHECKING
 static bool IsProxiedMessage(GTM_MessageType mtype);
 #endif
+static void GTMProxy_SendStats(StringInfo buf);
 
 /*
  * One-time initialization. It's called immediately after the main process
@@ -267,6 +291,7 @@ BaseInit()
 	/* Initialize reconnect control lock */
 
 	GTM_RWLockInit(&ReconnectControlLock);
+	GTM_MutexLockInit(&GTMServerLock);
 
 	/* Register Proxy on GTM */
 	RegisterProxy(false);
@@ -1080,14 +1105,12 @@ void *
 GTMProxy_ThreadMain(void *argp)
 {
 	GTMProxy_ThreadInfo *thrinfo = (GTMProxy_ThreadInfo *)argp;
-	int qtype;
 	StringInfoData input_message;
 	sigjmp_buf  local_sigjmp_buf;
 	int32 saved_seqno = -1;
-	int ii, nrfds;
+	int ii, nrfds, nread, nbuffered;
 	char gtm_connect_string[1024];
 	int	first_turn = TRUE;	/* Used only to set longjmp target at the first turn of thread loop */
-	GTMProxy_CommandData cmd_data = {};
 
 	elog(DEBUG3, "Starting the connection helper thread");
 
@@ -1297,11 +1320,27 @@ GTMProxy_ThreadMain(void *argp)
 			}
 			GTM_MutexLockRelease(&thrinfo->thr_lock);
 
+			/*
+			 * Backends may pipeline several commands, and we read only one
+			 * of them per connection in each round.  The ones left behind
+			 * in the receive buffer will not wake up poll(), so don't wait
+			 * if there are any, and treat those connections as readable.
+			 */
+			nbuffered = 0;
+			for (ii = 0; ii < thrinfo->thr_conn_count; ii++)
+			{
+				int connIndx = thrinfo->thr_conn_map[ii];
+				Port *port = thrinfo->thr_all_conns[connIndx]->con_port;
+
+				if (port != NULL && port->PqRecvPointer < port->PqRecvLength)
+					nbuffered++;
+			}
+
 			while (true)
 			{
 				Enable_Longjmp();
 				nrfds = poll(thrinfo->thr_poll_fds, thrinfo->thr_conn_count,
-							poll_timeout_ms);
+							nbuffered > 0 ? 0 : poll_timeout_ms);
 				Disable_Longjmp();
 
 				if (nrfds < 0)
@@ -1314,6 +1353,19 @@ GTMProxy_ThreadMain(void *argp)
 					break;
 			}
 
+			for (ii = 0; nbuffered > 0 && ii < thrinfo->thr_conn_count; ii++)
+			{
+				int connIndx = thrinfo->thr_conn_map[ii];
+				Port *port = thrinfo->thr_all_conns[connIndx]->con_port;
+
+				if (port != NULL && port->PqRecvPointer < port->PqRecvLength &&
+					(thrinfo->thr_poll_fds[ii].revents & POLLIN) == 0)
+				{
+					thrinfo->thr_poll_fds[ii].revents |= POLLIN;
+					nrfds++;
+				}
+			}
+
 			if (nrfds == 0)
 				continue;
 
@@ -1370,70 +1422,13 @@ setjmp_again:
 
 		/*
 		 * Now, read command from each of the connections that has some data to
-		 * be read.
+		 * be read. Give other backends a chance to join the group when
+		 * several of them are active at the same time.
 		 */
-		for (ii = 0; ii < thrinfo->thr_conn_count; ii++)
-		{
-			int connIndx = thrinfo->thr_conn_map[ii];
-			GTMProxy_ConnectionInfo *conninfo = thrinfo->thr_all_conns[connIndx];
-			thrinfo->thr_conn = conninfo;
-
-			if (thrinfo->thr_poll_fds[ii].revents & POLLHUP)
-			{
-				/*
-				 * The fd has become invalid. The connection is broken. Add it
-				 * to the remove_list and cleanup at the end of this round of
-				 * cleanup.
-				 */
-				GTMProxy_CommandPending(thrinfo->thr_conn,
-							MSG_BACKEND_DISCONNECT, cmd_data);
-				continue;
-			}
-
-			if ((thrinfo->thr_any_backup[connIndx]) ||
-				(thrinfo->thr_poll_fds[ii].revents & POLLIN))
-			{
-				/*
-				 * (3) read a command (loop blocks here)
-				 */
-				qtype = ReadCommand(thrinfo->thr_conn, &input_message);
-
-				thrinfo->thr_poll_fds[ii].revents = 0;
-
-				switch(qtype)
-				{
-					case 'C':
-						ProcessCommand(thrinfo->thr_conn, thrinfo->thr_gtm_conn,
-								&input_message);
-						HandlePostCommand(thrinfo->thr_conn, thrinfo->thr_gtm_conn);
-						break;
-
-					case 'X':
-					case EOF:
-						/*
-						 * Connection termination request
-						 *
-						 * Close the socket and remember the connection
-						 * as disconnected. All such connections will be
-						 * removed after the command processing is over. We
-						 * can't remove it just yet because we pass the slot id
-						 * to the server to quickly find the backend connection
-						 * while processing proxied messages.
-						 */
-						GTMProxy_CommandPending(thrinfo->thr_conn,
-												MSG_BACKEND_DISCONNECT, cmd_data);
-						break;
-					default:
-						/*
-						 * Also disconnect if protocol error
-						 */
-						GTMProxy_HandleDisconnect(thrinfo->thr_conn, thrinfo->thr_gtm_conn);
-						elog(ERROR, "Unexpected message, or client disconnected abruptly.");
-						break;
-				}
-
-			}
-		}
+		memset(thrinfo->thr_conn_read, 0, sizeof (thrinfo->thr_conn_read));
+		nread = GTMProxy_ReadCommands(thrinfo, &input_message);
+		if (GTMProxyBatchWindow > 0)
+			GTMProxy_WaitForBatch(thrinfo, &input_message, nread);
 
 		/*
 		 * Ok. All the commands are processed. Commands which can be proxied
@@ -1525,6 +1520,132 @@ setjmp_again:
 	return thrinfo;
 }
 
+/*
+ * Read a command from each of the connections of this thread that has some
+ * data to be read, except those a command was already read from in this
+ * round. Returns the number of commands read.
+ */
+static int
+GTMProxy_ReadCommands(GTMProxy_ThreadInfo *thrinfo, StringInfo input_message)
+{
+	GTMProxy_CommandData cmd_data = {};
+	int qtype;
+	int nread = 0;
+	int ii;
+
+	for (ii = 0; ii < thrinfo->thr_conn_count; ii++)
+	{
+
+		int connIndx = thrinfo->thr_conn_map[ii];
+		GTMProxy_ConnectionInfo *conninfo = thrinfo->thr_all_conns[connIndx];
+		thrinfo->thr_conn = conninfo;
+
+		if (thrinfo->thr_conn_read[ii])
+			continue;
+
+		if (thrinfo->thr_poll_fds[ii].revents & POLLHUP)
+		{
+			thrinfo->thr_conn_read[ii] = true;
+
+			/*
+			 * The fd has become invalid. The connection is broken. Add it
+			 * to the remove_list and cleanup at the end of this round of
+			 * cleanup.
+			 */
+			GTMProxy_CommandPending(thrinfo->thr_conn,
+						MSG_BACKEND_DISCONNECT, cmd_data);
+			continue;
+		}
+
+		if ((thrinfo->thr_any_backup[connIndx]) ||
+			(thrinfo->thr_poll_fds[ii].revents & POLLIN))
+		{
+			/*
+			 * (3) read a command (loop blocks here)
+			 */
+			thrinfo->thr_conn_read[ii] = true;
+			nread++;
+			qtype = ReadCommand(thrinfo->thr_conn, input_message);
+
+			thrinfo->thr_poll_fds[ii].revents = 0;
+
+			switch(qtype)
+			{
+				case 'C':
+					ProcessCommand(thrinfo->thr_conn, thrinfo->thr_gtm_conn,
+							input_message);
+					HandlePostCommand(thrinfo->thr_conn, thrinfo->thr_gtm_conn);
+					break;
+
+				case 'X':
+				case EOF:
+					/*
+					 * Connection termination request
+					 *
+					 * Close the socket and remember the connection
+					 * as disconnected. All such connections will be
+					 * removed after the command processing is over. We
+					 * can't remove it just yet because we pass the slot id
+					 * to the server to quickly find the backend connection
+					 * while processing proxied messages.
+					 */
+					GTMProxy_CommandPending(thrinfo->thr_conn,
+											MSG_BACKEND_DISCONNECT, cmd_data);
+					break;
+				default:
+					/*
+					 * Also disconnect if protocol error
+					 */
+					GTMProxy_HandleDisconnect(thrinfo->thr_conn, thrinfo->thr_gtm_conn);
+					elog(ERROR, "Unexpected message, or client disconnected abruptly.");
+					break;
+			}
+
+		}
+	}
+
+	return nread;
+}
+
+/*
+ * Wait a little for more commands to group with the ones already read.
+ *
+ * Grouping only pays off when several backends are active at the same time,
+ * so there is no wait at all unless more than one command was read. The
+ * window then doubles, up to batch_window, as long as waiting brings in more
+ * commands and halves when it does not, so that a lightly loaded proxy does
+ * not pay for it.
+ */
+static void
+GTMProxy_WaitForBatch(GTMProxy_ThreadInfo *thrinfo, StringInfo input_message,
+		int nread)
+{
+	int nrfds;
+	int nmore = 0;
+
+	if (nread <= 1)
+	{
+		thrinfo->thr_batch_window /= 2;
+		return;
+	}
+
+	if (thrinfo->thr_batch_window <= 0)
+		thrinfo->thr_batch_window = Max(GTMProxyBatchWindow / 16, 1);
+	thrinfo->thr_batch_window = Min(thrinfo->thr_batch_window, GTMProxyBatchWindow);
+
+	pg_usleep(thrinfo->thr_batch_window);
+
+	nrfds = poll(thrinfo->thr_poll_fds, thrinfo->thr_conn_count, 0);
+	if (nrfds > 0)
+		nmore = GTMProxy_ReadCommands(thrinfo, input_message);
+
+	if (nmore > 0)
+		thrinfo->thr_batch_window = Min(thrinfo->thr_batch_window * 2,
+										GTMProxyBatchWindow);
+	else
+		thrinfo->thr_batch_window /= 2;
+}
+
 /*
  * Add the accepted connection to the pool
  */
@@ -1573,7 +1694,6 @@ ProcessCommand(GTMProxy_ConnectionInfo *conninfo, GTM_Conn *gtm_conn,
 		case MSG_SNAPSHOT_GET:
 		case MSG_SEQUENCE_INIT:
 		case MSG_SEQUENCE_GET_CURRENT:
-		case MSG_SEQUENCE_GET_NEXT:
 		case MSG_SEQUENCE_GET_LAST:
 		case MSG_SEQUENCE_SET_VAL:
 		case MSG_SEQUENCE_RESET:
@@ -1586,6 +1706,7 @@ ProcessCommand(GTMProxy_ConnectionInfo *conninfo, GTM_Conn *gtm_conn,
 		case MSG_REPORT_XMIN:
 		case MSG_NODE_REGISTER:
 		case MSG_NODE_UNREGISTER:
+		case MSG_GET_STATS:
 			GTMProxy_ProxyCommand(conninfo, gtm_conn, mtype, input_message);
 			break;
 
@@ -1598,10 +1719,15 @@ ProcessCommand(GTMProxy_ConnectionInfo *conninfo, GTM_Conn *gtm_conn,
 			break;
 
 		case MSG_SNAPSHOT_GET_MULTI:
+		case MSG_SNAPSHOT_GET_DELTA:
 		case MSG_SNAPSHOT_GXID_GET:
 			ProcessSnapshotCommand(conninfo, gtm_conn, mtype, input_message);
 			break;
 
+		case MSG_SEQUENCE_GET_NEXT:
+			ProcessSequenceCommand(conninfo, gtm_conn, mtype, input_message);
+			break;
+
 		default:
 			ereport(FATAL,
 					(EPROTO,
@@ -1636,35 +1762,65 @@ ProcessCommand(GTMProxy_ConnectionInfo *conninfo, GTM_Conn *gtm_conn,
 static GTM_Conn *
 HandleGTMError(GTM_Conn *gtm_conn)
 {
+	uint32		client_id = GTMPQclientid(gtm_conn);
+	int			attempt;
 
 	elog(NOTICE,
 		 "GTM communication error was detected.  Retrying connection, interval = %d.",
 		 GTMConnectRetryInterval);
-	for (;;)
+	for (attempt = 0;; attempt++)
 	{
 		char gtm_connect_string[1024];
+		bool has_standby = (GTMStandbyHost && GTMStandbyHost[0] != '\0');
+		bool other;
+		char *host;
+		int port;
 
-		/* Wait and retry reconnect */
-		elog(DEBUG1, "Waiting %d secs.", GTMConnectRetryInterval);
-		pg_usleep((long)GTMConnectRetryInterval * 1000000L);
+		/*
+		 * With a GTM standby configured, alternate between the two servers,
+		 * trying the other one first without waiting: the standby has a copy
+		 * of the transactions of the master, and refuses the connection until
+		 * it is promoted. The current one is retried after the usual wait.
+		 */
+		other = has_standby && (attempt % 2 == 0);
+		if (!other)
+		{
+			/* Wait and retry reconnect */
+			elog(DEBUG1, "Waiting %d secs.", GTMConnectRetryInterval);
+			pg_usleep((long)GTMConnectRetryInterval * 1000000L);
+		}
+
+		GTM_MutexLockAcquire(&GTMServerLock);
+		host = other ? GTMStandbyHost : GTMServerHost;
+		port = other ? GTMStandbyPortNumber : GTMServerPortNumber;
+		GTM_MutexLockRelease(&GTMServerLock);
 
 		/*
 		 * Connect retry
 		 * Because this proxy has been registered to current
-		 * GTM, we don't re-register it.
+		 * GTM, we don't re-register it.  A promoted standby has a backup of
+		 * the registration, and attaches the open transactions to the
+		 * resent client identifier.
 		 *
 		 * Please note that GTM-Proxy accepts "reconnect" from gtm_ctl
 		 * even while it is retrying to connect to GTM.
 		 */
-		elog(DEBUG1, "Try to reconnect to GTM");
+		elog(DEBUG1, "Try to reconnect to GTM on %s:%d", host, port);
 		/* Make sure RECONNECT command would not come while we reconnecting */
 		Disable_Longjmp();
 		/* Close and free previous connection object if still active */
 		GTMPQfinish(gtm_conn);
 		/* Reconnect */
-		sprintf(gtm_connect_string, "host=%s port=%d node_name=%s remote_type=%d",
-				GTMServerHost, GTMServerPortNumber, GTMProxyNodeName, GTM_NODE_GTM_PROXY);
+		snprintf(gtm_connect_string, sizeof(gtm_connect_string),
+				 "host=%s port=%d node_name=%s remote_type=%d active_only=%d client_id=%u",
+				 host, port, GTMProxyNodeName, GTM_NODE_GTM_PROXY,
+				 has_standby, client_id);
 		gtm_conn = PQconnectGTM(gtm_connect_string);
+		if (GTMPQstatus(gtm_conn) != CONNECTION_OK)
+		{
+			GTMPQfinish(gtm_conn);
+			gtm_conn = NULL;
+		}
 		/*
 		 * If reconnect succeeded the connection will be ready to use out of
 		 * there, otherwise thr_gtm_conn will be set to NULL preventing double
@@ -1674,6 +1830,21 @@ HandleGTMError(GTM_Conn *gtm_conn)
 		Enable_Longjmp();
 		if (gtm_conn)
 		{
+			/* Make the other threads go to the new GTM first */
+			if (other)
+			{
+				GTM_MutexLockAcquire(&GTMServerLock);
+				if (GTMStandbyHost == host)
+				{
+					GTMStandbyHost = GTMServerHost;
+					GTMStandbyPortNumber = GTMServerPortNumber;
+					GTMServerHost = host;
+					GTMServerPortNumber = port;
+				}
+				GTM_MutexLockRelease(&GTMServerLock);
+				elog(LOG, "Failed over to GTM on %s:%d.", host, port);
+			}
+
 			/* Success, update thread info and return new connection */
 			elog(NOTICE, "GTM connection retry succeeded.");
 			return gtm_conn;
@@ -1730,7 +1901,6 @@ IsProxiedMessage(GTM_MessageType mtype)
 		case MSG_SNAPSHOT_GXID_GET:
 		case MSG_SEQUENCE_INIT:
 		case MSG_SEQUENCE_GET_CURRENT:
-		case MSG_SEQUENCE_GET_NEXT:
 		case MSG_SEQUENCE_GET_LAST:
 		case MSG_SEQUENCE_SET_VAL:
 		case MSG_SEQUENCE_RESET:
@@ -1740,6 +1910,7 @@ IsProxiedMessage(GTM_MessageType mtype)
 		case MSG_SNAPSHOT_GET:
 		case MSG_TXN_COMMIT:
 		case MSG_BARRIER:
+		case MSG_GET_STATS:
 			return true;
 
 		default:
@@ -1748,6 +1919,63 @@ IsProxiedMessage(GTM_MessageType mtype)
 }
 #endif
 
+/*
+ * Append the statistics section of this proxy to a GET_STATS_RESULT: the
+ * number of commands sent to GTM in one message, by message type, summed
+ * over all the worker threads. The counters are only updated by their own
+ * thread, so the values read here may be slightly behind.
+ */
+static void
+GTMProxy_SendStats(StringInfo buf)
+{
+	GTM_StatsCounter batch[MSG_TYPE_COUNT];
+	int			namelen = Min(strlen(GTMProxyNodeName), GTM_STATS_NAMELEN - 1);
+	int			nrows = 0;
+	int			ii;
+	int			jj;
+
+	memset(batch, 0, sizeof (batch));
+
+	GTM_RWLockAcquire(&GTMProxyThreads->gt_lock, GTM_LOCKMODE_READ);
+	for (ii = 0; ii < GTMProxyThreads->gt_array_size; ii++)
+	{
+		GTMProxy_ThreadInfo *thrinfo = GTMProxyThreads->gt_threads[ii];
+
+		if (thrinfo == NULL)
+			continue;
+		for (jj = 0; jj < MSG_TYPE_COUNT; jj++)
+			gtm_stat_add(&batch[jj], &thrinfo->thr_batch_stats[jj]);
+	}
+	GTM_RWLockRelease(&GTMProxyThreads->gt_lock);
+
+	for (ii = 0; ii < MSG_TYPE_COUNT; ii++)
+		if (batch[ii].count > 0)
+			nrows++;
+
+	pq_sendint(buf, namelen, sizeof (int));
+	pq_sendbytes(buf, GTMProxyNodeName, namelen);
+	pq_sendint(buf, nrows, sizeof (int));
+
+	for (ii = 0; ii < MSG_TYPE_COUNT; ii++)
+	{
+		char	   *name;
+
+		if (batch[ii].count == 0)
+			continue;
+
+		name = gtm_util_message_name(ii);
+		if (name == NULL)
+			name = "UNKNOWN";
+		else if (strncmp(name, "MSG_", 4) == 0)
+			name += 4;
+
+		pq_sendint(buf, GTM_STATS_BATCH, sizeof (int));
+		pq_sendint(buf, strlen(name), sizeof (int));
+		pq_sendbytes(buf, name, strlen(name));
+		pq_sendbytes(buf, (char *)&batch[ii], sizeof (GTM_StatsCounter));
+	}
+}
+
 static void
 ProcessResponse(GTMProxy_ThreadInfo *thrinfo, GTMProxy_CommandInfo *cmdinfo,
 		GTM_Result *res)
@@ -1876,7 +2104,8 @@ ProcessResponse(GTMProxy_ThreadInfo *thrinfo, GTMProxy_CommandInfo *cmdinfo,
 
 		case MSG_SNAPSHOT_GET_MULTI:
 			if ((res->gr_type != SNAPSHOT_GET_RESULT) &&
-				(res->gr_type != SNAPSHOT_GET_MULTI_RESULT))
+				(res->gr_type != SNAPSHOT_GET_MULTI_RESULT) &&
+				(res->gr_type != SNAPSHOT_GET_DELTA_RESULT))
 			{
 				ReleaseCmdBackup(cmdinfo);
 				elog(ERROR, "Wrong result");
@@ -1890,7 +2119,59 @@ ProcessResponse(GTMProxy_ThreadInfo *thrinfo, GTMProxy_CommandInfo *cmdinfo,
 			}
 
 			status = res->gr_resdata.grd_txn_snap_multi.status[cmdinfo->ci_res_index];
-		   	if ((status == STATUS_OK) || (status == STATUS_NOT_FOUND))
+		   	if (((status == STATUS_OK) || (status == STATUS_NOT_FOUND)) &&
+				cmdinfo->ci_data.cd_snap.delta)
+			{
+				int txn_count = 1;
+				int status = STATUS_OK;
+				uint64 generation = res->gr_snapshot_generation;
+				uint64 base_generation;
+
+				/*
+				 * The backend gets no GXIDs at all if it already has this
+				 * snapshot, the delta we received if it has the same base
+				 * snapshot as we had, and the full snapshot otherwise.
+				 */
+				if (cmdinfo->ci_data.cd_snap.generation == generation)
+					base_generation = generation;
+				else if (res->gr_delta_base != 0 &&
+						 cmdinfo->ci_data.cd_snap.generation == res->gr_delta_base)
+					base_generation = res->gr_delta_base;
+				else
+					base_generation = 0;
+
+				pq_beginmessage(&buf, 'S');
+				pq_sendint(&buf, SNAPSHOT_GET_DELTA_RESULT, 4);
+				pq_sendbytes(&buf, (char *)&txn_count, sizeof (txn_count));
+				pq_sendbytes(&buf, (char *)&status, sizeof (status));
+				pq_sendbytes(&buf, (char *)&generation, sizeof (generation));
+				pq_sendbytes(&buf, (char *)&base_generation, sizeof (base_generation));
+				pq_sendbytes(&buf, (char *)&res->gr_snapshot.sn_xmin, sizeof (GlobalTransactionId));
+				pq_sendbytes(&buf, (char *)&res->gr_snapshot.sn_xmax, sizeof (GlobalTransactionId));
+				if (base_generation == 0)
+				{
+					pq_sendint(&buf, res->gr_snapshot.sn_xcnt, sizeof (int));
+					pq_sendbytes(&buf, (char *)res->gr_snapshot.sn_xip,
+								 sizeof(GlobalTransactionId) * res->gr_snapshot.sn_xcnt);
+				}
+				else if (base_generation == generation)
+				{
+					pq_sendint(&buf, 0, sizeof (int));
+					pq_sendint(&buf, 0, sizeof (int));
+				}
+				else
+				{
+					pq_sendint(&buf, res->gr_delta_nremoved, sizeof (int));
+					pq_sendbytes(&buf, (char *)res->gr_delta_xip,
+								 sizeof(GlobalTransactionId) * res->gr_delta_nremoved);
+					pq_sendint(&buf, res->gr_delta_nadded, sizeof (int));
+					pq_sendbytes(&buf, (char *)(res->gr_delta_xip + res->gr_delta_nremoved),
+								 sizeof(GlobalTransactionId) * res->gr_delta_nadded);
+				}
+				pq_endmessage(cmdinfo->ci_conn->con_port, &buf);
+				pq_flush(cmdinfo->ci_conn->con_port);
+			}
+		   	else if ((status == STATUS_OK) || (status == STATUS_NOT_FOUND))
 			{
 				int txn_count = 1;
 				int status = STATUS_OK;
@@ -1916,6 +2197,50 @@ ProcessResponse(GTMProxy_ThreadInfo *thrinfo, GTMProxy_CommandInfo *cmdinfo,
 			ReleaseCmdBackup(cmdinfo);
 			break;
 
+		case MSG_SEQUENCE_GET_NEXT:
+			if (res->gr_type != SEQUENCE_GET_NEXT_MULTI_RESULT)
+			{
+				ReleaseCmdBackup(cmdinfo);
+				elog(ERROR, "Wrong result");
+			}
+			/*
+			 * Grouped too. The server sends back the values in the order of
+			 * the requests, we add the sequence key from our copy of the
+			 * request.
+			 */
+			if (cmdinfo->ci_res_index >= res->gr_resdata.grd_seq_multi.seq_count)
+			{
+				ReleaseCmdBackup(cmdinfo);
+				elog(ERROR, "Too few sequence values");
+			}
+
+			if (res->gr_resdata.grd_seq_multi.status[cmdinfo->ci_res_index] == STATUS_OK)
+			{
+				StringInfo request = &thrinfo->thr_inBufData[cmdinfo->ci_conn->con_id];
+
+				pq_beginmessage(&buf, 'S');
+				pq_sendint(&buf, SEQUENCE_GET_NEXT_RESULT, 4);
+				pq_sendbytes(&buf, request->data + cmdinfo->ci_data.cd_seq.offset,
+							 sizeof (uint32) + cmdinfo->ci_data.cd_seq.keylen);
+				pq_sendbytes(&buf, (char *)&res->gr_resdata.grd_seq_multi.seqval[cmdinfo->ci_res_index],
+							 sizeof (GTM_Sequence));
+				pq_sendbytes(&buf, (char *)&res->gr_resdata.grd_seq_multi.rangemax[cmdinfo->ci_res_index],
+							 sizeof (GTM_Sequence));
+				pq_endmessage(cmdinfo->ci_conn->con_port, &buf);
+				pq_flush(cmdinfo->ci_conn->con_port);
+			}
+			else
+			{
+				ReleaseCmdBackup(cmdinfo);
+				thrinfo->thr_conn = cmdinfo->ci_conn;
+				ereport(ERROR2,
+						(ERANGE,
+						 errmsg("Can not get current value of the sequence")));
+			}
+			cmdinfo->ci_conn->con_pending_msg = MSG_TYPE_INVALID;
+			ReleaseCmdBackup(cmdinfo);
+			break;
+
 		case MSG_TXN_BEGIN:
 		case MSG_TXN_BEGIN_GETGXID_AUTOVACUUM:
 		case MSG_TXN_PREPARE:
@@ -1931,7 +2256,6 @@ ProcessResponse(GTMProxy_ThreadInfo *thrinfo, GTMProxy_CommandInfo *cmdinfo,
 		case MSG_SNAPSHOT_GXID_GET:
 		case MSG_SEQUENCE_INIT:
 		case MSG_SEQUENCE_GET_CURRENT:
-		case MSG_SEQUENCE_GET_NEXT:
 		case MSG_SEQUENCE_GET_LAST:
 		case MSG_SEQUENCE_SET_VAL:
 		case MSG_SEQUENCE_RESET:
@@ -1999,7 +2323,47 @@ ProcessResponse(GTMProxy_ThreadInfo *thrinfo, GTMProxy_CommandInfo *cmdinfo,
 			cmdinfo->ci_conn->con_pending_msg = MSG_TYPE_INVALID;
 			ReleaseCmdBackup(cmdinfo);
 			break;
-			
+
+		case MSG_GET_STATS:
+			Assert(IsProxiedMessage(cmdinfo->ci_mtype));
+			if ((res->gr_proxyhdr.ph_conid == InvalidGTMProxyConnID) ||
+				(res->gr_proxyhdr.ph_conid >= GTM_PROXY_MAX_CONNECTIONS) ||
+				(thrinfo->thr_all_conns[res->gr_proxyhdr.ph_conid] != cmdinfo->ci_conn))
+			{
+				ReleaseCmdBackup(cmdinfo);
+				elog(PANIC, "Invalid response or synchronization loss");
+			}
+
+			/*
+			 * Forward the sections of GTM (and of the proxies behind us),
+			 * with our own in front.
+			 */
+			if (res->gr_status == GTM_RESULT_OK &&
+				res->gr_msglen >= sizeof (int32))
+			{
+				int32	nsections;
+
+				memcpy(&nsections, res->gr_proxy_data, sizeof (int32));
+				nsections = ntohl(nsections);
+
+				pq_beginmessage(&buf, 'S');
+				pq_sendint(&buf, res->gr_type, 4);
+				pq_sendint(&buf, nsections + 1, sizeof (int));
+				GTMProxy_SendStats(&buf);
+				pq_sendbytes(&buf, res->gr_proxy_data + sizeof (int32),
+							 res->gr_msglen - sizeof (int32));
+			}
+			else
+			{
+				pq_beginmessage(&buf, 'E');
+				pq_sendbytes(&buf, res->gr_proxy_data, res->gr_msglen);
+			}
+			pq_endmessage(cmdinfo->ci_conn->con_port, &buf);
+			pq_flush(cmdinfo->ci_conn->con_port);
+			cmdinfo->ci_conn->con_pending_msg = MSG_TYPE_INVALID;
+			ReleaseCmdBackup(cmdinfo);
+			break;
+
 		default:
 			ReleaseCmdBackup(cmdinfo);
 			ereport(FATAL,
@@ -2163,6 +2527,7 @@ ProcessSnapshotCommand(GTMProxy_ConnectionInfo *conninfo, GTM_Conn *gtm_conn,
 	switch (mtype)
 	{
 		case MSG_SNAPSHOT_GET_MULTI:
+		case MSG_SNAPSHOT_GET_DELTA:
 			{
 				{
 					const char *data;
@@ -2175,9 +2540,26 @@ ProcessSnapshotCommand(GTMProxy_ConnectionInfo *conninfo, GTM_Conn *gtm_conn,
 								(EPROTO,
 								 errmsg("Message does not contain valid GXID")));
 					memcpy(&cmd_data.cd_snap.gxid, data, sizeof (GlobalTransactionId));
+
+					cmd_data.cd_snap.delta = (mtype == MSG_SNAPSHOT_GET_DELTA);
+					cmd_data.cd_snap.generation = 0;
+					if (cmd_data.cd_snap.delta)
+					{
+						data = pq_getmsgbytes(message, sizeof (uint64));
+						if (data == NULL)
+							ereport(ERROR,
+									(EPROTO,
+									 errmsg("Message does not contain valid snapshot generation")));
+						memcpy(&cmd_data.cd_snap.generation, data, sizeof (uint64));
+					}
 				}
 				pq_getmsgend(message);
-				GTMProxy_CommandPending(conninfo, mtype, cmd_data);
+
+				/*
+				 * Both kinds of requests are grouped together, the response
+				 * is then sent in the format each backend asked for.
+				 */
+				GTMProxy_CommandPending(conninfo, MSG_SNAPSHOT_GET_MULTI, cmd_data);
 			}
 			break;
 
@@ -2191,6 +2573,37 @@ ProcessSnapshotCommand(GTMProxy_ConnectionInfo *conninfo, GTM_Conn *gtm_conn,
 
 }
 
+static void
+ProcessSequenceCommand(GTMProxy_ConnectionInfo *conninfo, GTM_Conn *gtm_conn,
+		GTM_MessageType mtype, StringInfo message)
+{
+	GTMProxy_CommandData cmd_data;
+
+	switch (mtype)
+	{
+		case MSG_SEQUENCE_GET_NEXT:
+			/*
+			 * The request is sent to the server as it is. Its backup is kept
+			 * until the response is processed, so just remember where it is.
+			 */
+			cmd_data.cd_seq.offset = message->cursor;
+			cmd_data.cd_seq.len = pq_getmsgunreadlen(message);
+			cmd_data.cd_seq.keylen = pq_getmsgint(message, sizeof (uint32));
+			if (cmd_data.cd_seq.keylen < 0 ||
+				cmd_data.cd_seq.keylen > pq_getmsgunreadlen(message))
+				ereport(ERROR,
+						(EPROTO,
+						 errmsg("Message does not contain valid sequence key")));
+			(void) pq_getmsgbytes(message, pq_getmsgunreadlen(message));
+			pq_getmsgend(message);
+			GTMProxy_CommandPending(conninfo, mtype, cmd_data);
+			break;
+
+		default:
+			Assert(0);			/* Shouldn't come here.. keep compiler quiet */
+	}
+}
+
 /*
  * Proxy the incoming message to the GTM server after adding our own identifier
  * to it. The rest of the message is forwarded as it is without even reading
@@ -2397,6 +2810,9 @@ GTMProxy_ProcessPendingCommands(GTMProxy_ThreadInfo *thrinfo)
 				gtm_list_length(thrinfo->thr_pending_commands[ii]) == 0)
 			continue;
 
+		gtm_stat_record(&thrinfo->thr_batch_stats[ii],
+						gtm_list_length(thrinfo->thr_pending_commands[ii]));
+
 		/*
 		 * Start a new group message and fill in the headers
 		 */
@@ -2536,7 +2952,11 @@ GTMProxy_ProcessPendingCommands(GTMProxy_ThreadInfo *thrinfo)
 				break;
 
 			case MSG_SNAPSHOT_GET_MULTI:
-				if (gtmpqPutInt(MSG_SNAPSHOT_GET_MULTI, sizeof (GTM_MessageType), gtm_conn) ||
+				/*
+				 * Ask for a delta from the snapshot we received last time, it
+				 * is applied to gtm_conn->result when the response is parsed.
+				 */
+				if (gtmpqPutInt(MSG_SNAPSHOT_GET_DELTA, sizeof (GTM_MessageType), gtm_conn) ||
 					gtmpqPutInt(gtm_list_length(thrinfo->thr_pending_commands[ii]), sizeof(int), gtm_conn))
 					elog(ERROR, "Error sending data");
 
@@ -2546,12 +2966,20 @@ GTMProxy_ProcessPendingCommands(GTMProxy_ThreadInfo *thrinfo)
 					Assert(cmdinfo->ci_mtype == ii);
 					cmdinfo->ci_res_index = res_index++;
 					{
-						if (gtmpqPutnchar((char *)&cmdinfo->ci_data.cd_rc.gxid,
+						if (gtmpqPutnchar((char *)&cmdinfo->ci_data.cd_snap.gxid,
 								sizeof (GlobalTransactionId), gtm_conn))
 							elog(ERROR, "Error sending data");
 					}
 				}
 
+				{
+					uint64 generation = gtm_conn->result ?
+						gtm_conn->result->gr_snapshot_generation : 0;
+
+					if (gtmpqPutnchar((char *)&generation, sizeof (generation), gtm_conn))
+						elog(ERROR, "Error sending data");
+				}
+
 				/* Finish the message. */
 				Enable_Longjmp();
 				if (gtmpqPutMsgEnd(gtm_conn))
@@ -2575,6 +3003,50 @@ GTMProxy_ProcessPendingCommands(GTMProxy_ThreadInfo *thrinfo)
 				break;
 
 
+			case MSG_SEQUENCE_GET_NEXT:
+				/* A thread has no more connections than this */
+				if (gtm_list_length(thrinfo->thr_pending_commands[ii]) > GTM_MAX_SEQUENCE_NEXT_MULTI)
+					elog(ERROR, "Too many pending sequence requests");
+
+				if (gtmpqPutInt(MSG_SEQUENCE_GET_NEXT_MULTI, sizeof (GTM_MessageType), gtm_conn) ||
+					gtmpqPutInt(gtm_list_length(thrinfo->thr_pending_commands[ii]), sizeof(int), gtm_conn))
+					elog(ERROR, "Error sending data");
+
+				gtm_foreach (elem, thrinfo->thr_pending_commands[ii])
+				{
+					StringInfo request;
+
+					cmdinfo = (GTMProxy_CommandInfo *)gtm_lfirst(elem);
+					Assert(cmdinfo->ci_mtype == ii);
+					cmdinfo->ci_res_index = res_index++;
+					request = &thrinfo->thr_inBufData[cmdinfo->ci_conn->con_id];
+					if (gtmpqPutnchar(request->data + cmdinfo->ci_data.cd_seq.offset,
+								cmdinfo->ci_data.cd_seq.len, gtm_conn))
+						elog(ERROR, "Error sending data");
+				}
+
+				/* Finish the message. */
+				Enable_Longjmp();
+				if (gtmpqPutMsgEnd(gtm_conn))
+					elog(ERROR, "Error finishing the message");
+				Disable_Longjmp();
+
+				/*
+				 * Move the entire list to the processed command
+				 */
+				thrinfo->thr_processed_commands = gtm_list_concat(thrinfo->thr_processed_commands,
+						thrinfo->thr_pending_commands[ii]);
+				/*
+				 * Free the list header of the second list, unless
+				 * gtm_list_concat actually returned the second list as-is
+				 * because the first list was empty
+				 */
+				if ((thrinfo->thr_processed_commands != thrinfo->thr_pending_commands[ii]) &&
+					(thrinfo->thr_pending_commands[ii] != gtm_NIL))
+					pfree(thrinfo->thr_pending_commands[ii]);
+				thrinfo->thr_pending_commands[ii] = gtm_NIL;
+				break;
+
 			default:
 				elog(ERROR, "This message type (%d) can not be grouped together", ii);
 		}
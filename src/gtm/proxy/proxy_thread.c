@@ -341,6 +341,7 @@ GTMProxy_ThreadAddConnection(GTMProxy_ConnectionInfo *conninfo)
 {
 	GTMProxy_ThreadInfo *thrinfo = NULL;
 	GTMProxy_ConnID connIndx, ii;
+	uint32		worker;
 
 	/*
 	 * Get the next thread in the queue
@@ -353,12 +354,43 @@ GTMProxy_ThreadAddConnection(GTMProxy_ConnectionInfo *conninfo)
 	if (GTMProxyThreads->gt_next_worker == 0)
 		GTMProxyThreads->gt_next_worker = 1;
 
-	thrinfo = GTMProxyThreads->gt_threads[GTMProxyThreads->gt_next_worker];
+	/*
+	 * Plain round-robin lets the workers drift apart as the connections they
+	 * were given go away, and busy workers keep getting their share of new
+	 * connections. Starting from the next worker in turn, pick the one with
+	 * the fewest connections. The counts are read without the workers' locks;
+	 * they only guide the choice.
+	 */
+	worker = GTMProxyThreads->gt_next_worker;
+	for (ii = 0; ii < GTMProxyThreads->gt_thread_count - 1; ii++)
+	{
+		uint32		candidate;
+		GTMProxy_ThreadInfo *cand_thrinfo;
+
+		candidate = (GTMProxyThreads->gt_next_worker - 1 + ii) %
+			(GTMProxyThreads->gt_thread_count - 1) + 1;
+		cand_thrinfo = GTMProxyThreads->gt_threads[candidate];
+		if (cand_thrinfo == NULL)
+			continue;
+		if (thrinfo == NULL ||
+			cand_thrinfo->thr_conn_count < thrinfo->thr_conn_count)
+		{
+			thrinfo = cand_thrinfo;
+			worker = candidate;
+		}
+	}
+
+	if (thrinfo == NULL)
+	{
+		GTM_RWLockRelease(&GTMProxyThreads->gt_lock);
+		elog(LOG, "No worker thread to serve the connection");
+		return NULL;
+	}
 
 	/*
 	 * Set the next worker thread before releasing the lock
 	 */
-	GTMProxyThreads->gt_next_worker++;
+	GTMProxyThreads->gt_next_worker = worker + 1;
 	if (GTMProxyThreads->gt_next_worker == GTMProxyThreads->gt_thread_count)
 	   GTMProxyThreads->gt_next_worker = 1;
 
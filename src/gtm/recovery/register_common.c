@@ -945,6 +945,12 @@ GTM_InitNodeManager(void)
  */ 
 #define GTM_REPORT_XMIN_DELAY_THRESHOLD (600 * 1000)
 
+/*
+ * Reports received less than that many milliseconds after the last
+ * computation of GTM_GlobalXmin get that value back, see below.
+ */
+#define GTM_GLOBAL_XMIN_REUSE_INTERVAL	1000
+
 GlobalTransactionId
 GTM_HandleGlobalXmin(GTM_PGXCNodeType type, char *node_name,
 		GlobalTransactionId reported_xmin, int *errcode)
@@ -1078,6 +1084,28 @@ GTM_HandleGlobalXmin(GTM_PGXCNodeType type, char *node_name,
 	 * what we compute, we accept that calculation
 	 */
 	GTM_RWLockAcquire(&PGXCNodesLock, GTM_LOCKMODE_READ);
+
+	/*
+	 * Every node reports once per cluster monitor naptime, so with many
+	 * nodes the computation below, which goes through all the nodes and all
+	 * the open transactions, would run many times a second for very little
+	 * progress. A global xmin computed a moment ago is older than or equal
+	 * to the one we would compute now, and an older value is always safe to
+	 * hand out: it only holds back pruning on the node a little longer. The
+	 * xmin just reported is recorded above and taken into account by the
+	 * next computation.
+	 */
+	if (GlobalTransactionIdIsValid(GTM_GlobalXmin) &&
+		GTM_GlobalXminComputedTime != 0 &&
+		!GTM_TimestampDifferenceExceeds(GTM_GlobalXminComputedTime,
+										current_time,
+										GTM_GLOBAL_XMIN_REUSE_INTERVAL))
+	{
+		global_xmin = GTM_GlobalXmin;
+		GTM_RWLockRelease(&PGXCNodesLock);
+		return global_xmin;
+	}
+
 	num_nodes = pgxcnode_get_all(all_nodes, MAX_NODES, true);
 
 	for (ii = 0; ii < num_nodes; ii++)
@@ -1225,7 +1253,6 @@ GTM_HandleGlobalXmin(GTM_PGXCNodeType type, char *node_name,
 			elog(DEBUG1, "Computed new GTM_GlobalXmin %d, old value was %d",
 					global_xmin, GTM_GlobalXmin);
 			GTM_GlobalXmin = global_xmin;
-			GTM_GlobalXminComputedTime = current_time;
 		}
 		else if (GlobalTransactionIdFollows(GTM_GlobalXmin, global_xmin))
 		{
@@ -1234,6 +1261,7 @@ GTM_HandleGlobalXmin(GTM_PGXCNodeType type, char *node_name,
 					GTM_GlobalXmin, global_xmin);
 			global_xmin = GTM_GlobalXmin;
 		}
+		GTM_GlobalXminComputedTime = current_time;
 		GTM_RWLockRelease(&PGXCNodesLock);
 	}
 
@@ -155,6 +155,12 @@ ProcessPGXCNodeRegister(Port *myport, StringInfo message, bool is_backup)
 		 * Cascade standby may be allowed.
 		 */
 		GTM_DoForAllOtherThreads(finishStandbyConn);
+
+		/*
+		 * Connections idle in the worker pool are not attached to any
+		 * thread. Let them drop their standby connection lazily.
+		 */
+		GTMThreads->gt_standby_generation++;
 	}
 
 	if (Recovery_PGXCNodeRegister(type, node_name, port,
@@ -213,7 +219,7 @@ ProcessPGXCNodeRegister(Port *myport, StringInfo message, bool is_backup)
 				GTMThreads->gt_standby_ready = false;
 
 			if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-				gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+				gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 		}
 		/*
@@ -314,7 +320,7 @@ ProcessPGXCNodeUnregister(Port *myport, StringInfo message, bool is_backup)
 				goto retry;
 
 			if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-				gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+				gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 			elog(DEBUG1, "node_unregister() returns rc %d.", _rc);
 		}
@@ -564,7 +570,7 @@ ProcessPGXCRegisterSession(Port *myport, StringInfo message)
 			GTMThreads->gt_standby_ready = false;
 
 		if (Backup_synchronously && (myport->remote_type != GTM_NODE_GTM_PROXY))
-			gtm_sync_standby(GetMyThreadInfo->thr_conn->standby);
+			gtm_standby_sync(GetMyThreadInfo->thr_conn->standby);
 
 	}
 
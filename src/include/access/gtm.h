@@ -15,11 +15,15 @@
 /* Configuration variables */
 extern char *GtmHost;
 extern int GtmPort;
+extern char *GtmStandbyHost;
+extern int GtmStandbyPort;
 extern bool gtm_backup_barrier;
 
 extern bool IsXidFromGTM;
 extern GlobalTransactionId currentGxid;
 
+extern Size GTMShmemSize(void);
+extern void GTMShmemInit(void);
 extern bool IsGTMConnected(void);
 extern void InitGTM(void);
 extern void CloseGTM(void);
@@ -28,9 +32,15 @@ extern GlobalTransactionId BeginTranAutovacuumGTM(void);
 extern int CommitTranGTM(GlobalTransactionId gxid, int waited_xid_count,
 		GlobalTransactionId *waited_xids);
 extern int RollbackTranGTM(GlobalTransactionId gxid);
+extern int RollbackTranGTMPair(GlobalTransactionId gxid1,
+							   GlobalTransactionId gxid2);
 extern int StartPreparedTranGTM(GlobalTransactionId gxid,
 								char *gid,
 								char *nodestring);
+extern void StartPreparedTranGTMAsync(GlobalTransactionId gxid,
+									  char *gid,
+									  char *nodestring);
+extern int StartPreparedTranGTMWait(void);
 extern int PrepareTranGTM(GlobalTransactionId gxid);
 extern int GetGIDDataGTM(char *gid,
 						 GlobalTransactionId *gxid,
@@ -65,4 +75,7 @@ extern int ReportBarrierGTM(const char *barrier_id);
 extern int ReportGlobalXmin(GlobalTransactionId gxid,
 		GlobalTransactionId *global_xmin,
 		GlobalTransactionId *latest_completed_xid);
+/* Statistics */
+struct GTM_StatsEntry;
+extern int GetGTMStats(struct GTM_StatsEntry **entries);
 #endif /* ACCESS_GTM_H */
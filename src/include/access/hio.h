@@ -32,6 +32,7 @@ typedef struct BulkInsertStateData
 {
 	BufferAccessStrategy strategy;	/* our BULKWRITE strategy object */
 	Buffer		current_buf;	/* current insertion target page */
+	int			extend_by;		/* pages added at the last bulk extension */
 }			BulkInsertStateData;
 
 
@@ -41,5 +42,7 @@ extern Buffer RelationGetBufferForTuple(Relation relation, Size len,
 						  Buffer otherBuffer, int options,
 						  BulkInsertState bistate,
 						  Buffer *vmbuffer, Buffer *vmbuffer_other);
+extern void RelationAdjustUpdateFreeSpace(Relation relation, Size len,
+							  bool fits);
 
 #endif							/* HIO_H */
@@ -21,6 +21,8 @@
 #include "catalog/pg_index.h"
 #include "lib/stringinfo.h"
 #include "storage/bufmgr.h"
+#include "storage/dsm.h"
+#include "storage/shm_toc.h"
 
 /* There's room for a 16-bit vacuum cycle ID in BTPageOpaqueData */
 typedef uint16 BTCycleId;
@@ -549,11 +551,20 @@ extern bool btvalidate(Oid opclassoid);
  */
 typedef struct BTSpool BTSpool; /* opaque type known only within nbtsort.c */
 
+/* Tuples between two progress reports of an index build */
+#define BTREE_BUILD_PROGRESS_INTERVAL	1024
+
 extern BTSpool *_bt_spoolinit(Relation heap, Relation index,
 			  bool isunique, bool isdead);
 extern void _bt_spooldestroy(BTSpool *btspool);
 extern void _bt_spool(BTSpool *btspool, ItemPointer self,
 		  Datum *values, bool *isnull);
 extern void _bt_leafbuild(BTSpool *btspool, BTSpool *spool2);
+extern int _bt_parallel_workers(Relation heap, Relation index,
+					 struct IndexInfo *indexInfo);
+extern double _bt_parallel_build(Relation heap, Relation index,
+				   struct IndexInfo *indexInfo, int nworkers,
+				   double *indtuples);
+extern void _bt_parallel_build_main(dsm_segment *seg, shm_toc *toc);
 
 #endif							/* NBTREE_H */
@@ -138,6 +138,8 @@ typedef struct VariableCacheData
 	 */
 	TransactionId latestCompletedXid;	/* newest XID that has committed or
 										 * aborted */
+	uint64		xactCompletionCount;	/* bumped whenever an XID stops being
+										 * running in the proc array */
 
 	/*
 	 * These fields are protected by CLogTruncationLock
@@ -962,6 +962,16 @@ typedef NameData *Name;
 #define unlikely(x) ((x) != 0)
 #endif
 
+/*
+ * Hint that the memory at addr will be read soon, so that a cache miss on it
+ * can overlap with other work.  Like likely(), only for very hot paths.
+ */
+#if __GNUC__ >= 3
+#define pg_prefetch(addr)	__builtin_prefetch(addr)
+#else
+#define pg_prefetch(addr)	((void) 0)
+#endif
+
 
 /* ----------------------------------------------------------------
  *				Section 8:	random stuff
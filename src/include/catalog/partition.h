@@ -66,6 +66,8 @@ typedef struct PartitionDispatchData
 	TupleTableSlot *tupslot;
 	TupleConversionMap *tupmap;
 	int		   *indexes;
+	int			last_offset;	/* bound offset found for the last tuple
+								 * routed through this table, or -2 */
 } PartitionDispatchData;
 
 typedef struct PartitionDispatchData *PartitionDispatch;
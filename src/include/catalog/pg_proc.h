@@ -1767,6 +1767,8 @@ DESCR("does not match LIKE expression");
 /* SEQUENCE functions */
 DATA(insert OID = 1574 (  nextval			PGNSP PGUID 12 1 0 0 0 f f f f t f v u 1 0 20 "2205" _null_ _null_ _null_ _null_ _null_ nextval_oid _null_ _null_ _null_ ));
 DESCR("sequence next value");
+DATA(insert OID = 7023 (  nextval			PGNSP PGUID 12 1 0 0 0 f f f f t f v u 2 0 20 "2205 23" _null_ _null_ _null_ _null_ _null_ nextval_range_oid _null_ _null_ _null_ ));
+DESCR("first of a block of sequence values");
 DATA(insert OID = 1575 (  currval			PGNSP PGUID 12 1 0 0 0 f f f f t f v u 1 0 20 "2205" _null_ _null_ _null_ _null_ _null_ currval_oid _null_ _null_ _null_ ));
 DESCR("sequence current value");
 DATA(insert OID = 1576 (  setval			PGNSP PGUID 12 1 0 0 0 f f f f t f v u 2 0 20 "2205 20" _null_ _null_ _null_ _null_  _null_ setval_oid _null_ _null_ _null_ ));
@@ -5380,14 +5382,44 @@ DATA(insert OID = 7007 ( pgxc_pool_check	PGNSP PGUID 12 1 0 0 0 f f f f t f v u
 DESCR("check connection information consistency in pooler");
 DATA(insert OID = 7008 ( pgxc_pool_reload	PGNSP PGUID 12 1 0 0 0 f f f f t f v u 0 0 16 "" _null_ _null_ _null_ _null_ _null_ pgxc_pool_reload _null_ _null_ _null_ ));
 DESCR("reload connection information in pooler and reload server sessions");
+DATA(insert OID = 4126 ( pg_stat_get_pooler	PGNSP PGUID 12 1 10 0 0 f f f f f t v r 0 0 2249 "" "{26,20,20,20,20,20,20,701,1016,1184}" "{o,o,o,o,o,o,o,o,o,o}" "{nodeoid,requests,misses,connects,connect_failures,exhausted,closed,wait_time,wait_histogram,stats_reset}" _null_ _null_ pg_stat_get_pooler _null_ _null_ _null_ ));
+DESCR("statistics: connection pooler per remote node");
+DATA(insert OID = 7016 ( pg_stat_get_cluster_health	PGNSP PGUID 12 1 100 0 0 f f f f f t v r 0 0 2249 "" "{1184,26,18,16,701,23,701,1186}" "{o,o,o,o,o,o,o,o}" "{sample_time,nodeoid,node_type,reachable,rtt,pool_active,pool_saturation,replication_lag}" _null_ _null_ pg_stat_get_cluster_health _null_ _null_ _null_ ));
+DESCR("statistics: health samples taken by the cluster monitor");
+DATA(insert OID = 7017 ( pg_stat_get_executor_samples	PGNSP PGUID 12 1 100 0 0 f f f f f t v r 0 0 2249 "" "{26,20,23,25,20}" "{o,o,o,o,o}" "{dbid,queryid,plan_node_id,node_type,samples}" _null_ _null_ pg_stat_get_executor_samples _null_ _null_ _null_ ));
+DESCR("statistics: samples of the plan nodes executed on this node");
+DATA(insert OID = 7018 ( pg_stat_reset_executor_samples	PGNSP PGUID 12 1 0 0 0 f f f f f f v r 0 0 2278 "" _null_ _null_ _null_ _null_ _null_ pg_stat_reset_executor_samples _null_ _null_ _null_ ));
+DESCR("statistics: discard the samples of the plan nodes executed on this node");
+DATA(insert OID = 7019 ( pgxc_stat_get_executor_samples	PGNSP PGUID 12 1 1000 0 0 f f f f f t v r 0 0 2249 "" "{25,19,20,23,25,20}" "{o,o,o,o,o,o}" "{node_name,datname,queryid,plan_node_id,node_type,samples}" _null_ _null_ pgxc_stat_get_executor_samples _null_ _null_ _null_ ));
+DESCR("statistics: samples of the plan nodes executed on all the nodes");
+DATA(insert OID = 7025 ( pg_stat_get_redistributions	PGNSP PGUID 12 1 100 0 0 f f f f f t v r 0 0 2249 "" "{26,21,20,701,701}" "{o,o,o,o,o}" "{relid,attnum,redistributions,est_rows,est_bytes}" _null_ _null_ pg_stat_get_redistributions _null_ _null_ _null_ ));
+DESCR("statistics: redistributions planned by column of the current database");
+DATA(insert OID = 7026 ( pg_stat_reset_redistributions	PGNSP PGUID 12 1 0 0 0 f f f f f f v r 0 0 2278 "" _null_ _null_ _null_ _null_ _null_ pg_stat_reset_redistributions _null_ _null_ _null_ ));
+DESCR("statistics: discard the redistributions planned on this node");
+DATA(insert OID = 7027 ( pgxc_stat_get_progress_create_index	PGNSP PGUID 12 1 100 0 0 f f f f f t v r 0 0 2249 "" "{25,23,19,25,25,20,20}" "{o,o,o,o,o,o,o}" "{node_name,pid,datname,relname,phase,tuples_scanned,tuples_loaded}" _null_ _null_ pgxc_stat_get_progress_create_index _null_ _null_ _null_ ));
+DESCR("statistics: progress of the index builds on all the Datanodes");
+DATA(insert OID = 7020 ( pgxc_barrier_history	PGNSP PGUID 12 1 64 0 0 f f f f f t v r 0 0 2249 "" "{25,3220,1184}" "{o,o,o}" "{barrier_id,lsn,recorded_at}" _null_ _null_ pgxc_barrier_history _null_ _null_ _null_ ));
+DESCR("last barriers written or replayed by this node");
+DATA(insert OID = 7021 (  pgxc_logical_slot_get_changes PGNSP PGUID 12 1000 1000 25 0 f f f f f t v u 3 0 2249 "19 23 1009" "{19,23,1009,19,3220,28,1184,25}" "{i,i,v,o,o,o,o,o}" "{slot_name,upto_nchanges,options,node_name,lsn,xid,commit_time,data}" _null_ _null_ pgxc_logical_slot_get_changes _null_ _null_ _null_ ));
+DESCR("get changes from the logical replication slot of all the Datanodes, in commit order");
+DATA(insert OID = 7022 (  pgxc_logical_slot_peek_changes PGNSP PGUID 12 1000 1000 25 0 f f f f f t v u 3 0 2249 "19 23 1009" "{19,23,1009,19,3220,28,1184,25}" "{i,i,v,o,o,o,o,o}" "{slot_name,upto_nchanges,options,node_name,lsn,xid,commit_time,data}" _null_ _null_ pgxc_logical_slot_peek_changes _null_ _null_ _null_ ));
+DESCR("peek at changes from the logical replication slot of all the Datanodes, in commit order");
+DATA(insert OID = 7013 ( pg_stat_get_shared_queues	PGNSP PGUID 12 1 100 0 0 f f f f f t v r 0 0 2249 "" "{25,23,26,23,26,25,23,23,23,20,20,20,20,20,20,20,701}" "{o,o,o,o,o,o,o,o,o,o,o,o,o,o,o,o,o}" "{queue_name,producer_pid,producer_nodeoid,consumer_pid,consumer_nodeoid,status,queue_size,queue_used,queue_tuples,tuples_written,tuples_read,tuples_buffered,long_tuples,spill_bytes,spill_tuples,producer_pauses,producer_wait_time}" _null_ _null_ pg_stat_get_shared_queues _null_ _null_ _null_ ));
+DESCR("statistics: consumers of the shared queues active on this node");
+DATA(insert OID = 7014 ( pgxc_gtm_stats	PGNSP PGUID 12 1 100 0 0 f f f f t t v r 0 0 2249 "" "{25,25,25,20,20,20,1016}" "{o,o,o,o,o,o,o}" "{source,kind,name,count,total,max,histogram}" _null_ _null_ pgxc_gtm_stats _null_ _null_ _null_ ));
+DESCR("statistics: requests served by GTM and GTM proxy");
 DATA(insert OID = 7009 ( pgxc_node_str		PGNSP PGUID 12 1 0 0 0 f f f f t f s u 0 0 19 "" _null_ _null_ _null_ _null_ _null_ pgxc_node_str _null_ _null_ _null_ ));
 DESCR("get the name of the node");
 DATA(insert OID = 7010 (  pgxc_is_committed	PGNSP PGUID 12 1 1 0 0 f f f f t t s u 1 0 16 "28" _null_ _null_ _null_ _null_ _null_ pgxc_is_committed _null_ _null_ _null_ ));
 DESCR("is given GXID committed or aborted?");
 DATA(insert OID = 7024 (  pgxc_is_inprogress	PGNSP PGUID 12 1 1 0 0 f f f f t t s u 1 0 16 "28" _null_ _null_ _null_ _null_ _null_ pgxc_is_inprogress _null_ _null_ _null_ ));
 DESCR("is given GXID in progress?");
+DATA(insert OID = 7015 (  pgxc_implicit_2pc_count	PGNSP PGUID 12 1 0 0 0 f f f f t f v r 0 0 20 "" _null_ _null_ _null_ _null_ _null_ pgxc_implicit_2pc_count _null_ _null_ _null_ ));
+DESCR("number of transactions of the session committed with implicit two-phase commit");
 DATA(insert OID = 7011 ( pgxc_lock_for_backup PGNSP PGUID 12 1 0 0 0 f f f f t f v u 0 0 16 "" _null_ _null_ _null_ _null_ _null_ pgxc_lock_for_backup _null_ _null_ _null_ ));
 DESCR("lock the cluster for taking backup");
+DATA(insert OID = 7012 ( pgxc_lock_wait_edges PGNSP PGUID 12 1 100 0 0 f f f f t t v s 0 0 2249 "" "{19,23,19,23}" "{o,o,o,o}" "{waiter_node,waiter_pid,holder_node,holder_pid}" _null_ _null_ pgxc_lock_wait_edges _null_ _null_ _null_ ));
+DESCR("lock waits between distributed sessions on this node");
 #endif
 
 /* pg_upgrade support */
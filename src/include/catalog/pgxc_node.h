@@ -57,11 +57,17 @@ CATALOG(pgxc_node,9015) BKI_SHARED_RELATION
 	 * Node identifier to be used at places where a fixed length node identification is required
 	 */
 	int32		node_id;
+
+	/*
+	 * Network zone (rack, availability zone) the node is located in, empty
+	 * if unknown. Used to cost data movement between the nodes.
+	 */
+	NameData	node_zone;
 } FormData_pgxc_node;
 
 typedef FormData_pgxc_node *Form_pgxc_node;
 
-#define Natts_pgxc_node				7
+#define Natts_pgxc_node				8
 
 #define Anum_pgxc_node_name			1
 #define Anum_pgxc_node_type			2
@@ -70,6 +76,7 @@ typedef FormData_pgxc_node *Form_pgxc_node;
 #define Anum_pgxc_node_is_primary	5
 #define Anum_pgxc_node_is_preferred	6
 #define Anum_pgxc_node_id		7
+#define Anum_pgxc_node_zone		8
 
 /* Possible types of nodes */
 #define PGXC_NODE_COORDINATOR		'C'
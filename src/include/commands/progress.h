@@ -34,4 +34,16 @@
 #define PROGRESS_VACUUM_PHASE_TRUNCATE			5
 #define PROGRESS_VACUUM_PHASE_FINAL_CLEANUP		6
 
+/* Progress parameters for CREATE INDEX */
+#define PROGRESS_CREATEIDX_PHASE				0
+#define PROGRESS_CREATEIDX_INDEX_RELID			1
+#define PROGRESS_CREATEIDX_TUPLES_SCANNED		2
+#define PROGRESS_CREATEIDX_TUPLES_LOADED		3
+
+/* Phases of CREATE INDEX (as advertised via PROGRESS_CREATEIDX_PHASE) */
+#define PROGRESS_CREATEIDX_PHASE_BUILD			1
+#define PROGRESS_CREATEIDX_PHASE_SCAN_HEAP		2
+#define PROGRESS_CREATEIDX_PHASE_SORT			3
+#define PROGRESS_CREATEIDX_PHASE_LOAD			4
+
 #endif
@@ -75,6 +75,10 @@ extern void seq_mask(char *pagedata, BlockNumber blkno);
 #ifdef XCP
 #define DEFAULT_CACHEVAL	1
 extern int SequenceRangeVal;
+extern int SharedSequenceRanges;
+
+extern Size SequenceShmemSize(void);
+extern void SequenceShmemInit(void);
 #endif
 #ifdef PGXC
 /*
@@ -20,7 +20,9 @@
 #include "catalog/pg_type.h"
 #include "nodes/parsenodes.h"
 #include "storage/buf.h"
+#include "storage/dsm.h"
 #include "storage/lock.h"
+#include "storage/shm_toc.h"
 #include "utils/relcache.h"
 
 
@@ -188,11 +190,12 @@ extern void vacuum_set_xid_limits(Relation rel,
 extern void vac_update_datfrozenxid(void);
 extern void vacuum_delay_point(void);
 #ifdef XCP
-extern void vacuum_rel_coordinator(Relation onerel, bool is_outer);
+extern double vacuum_rel_coordinator(Relation onerel, bool is_outer);
 TargetEntry *make_relation_tle(Oid reloid, const char *relname, const char *column);
 #endif
 
 /* in commands/vacuumlazy.c */
+extern void lazy_parallel_vacuum_main(dsm_segment *seg, shm_toc *toc);
 extern void lazy_vacuum_rel(Relation onerel, int options,
 				VacuumParams *params, BufferAccessStrategy bstrategy);
 
@@ -0,0 +1,37 @@
+/*-------------------------------------------------------------------------
+ *
+ * execPrune.h
+ *	  Execution-time pruning of the partitions scanned by Append and
+ *	  MergeAppend
+ *
+ *
+ * Portions Copyright (c) 1996-2017, PostgreSQL Global Development Group
+ * Portions Copyright (c) 2010-2012 Postgres-XC Development Group
+ *
+ * src/include/executor/execPrune.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef EXECPRUNE_H
+#define EXECPRUNE_H
+
+#include "nodes/execnodes.h"
+
+typedef struct PartitionPruneState
+{
+	PlanState  *parent;			/* the Append or MergeAppend */
+	int			nplans;
+	List	   *constraints;	/* per subplan, constraints of the partition */
+	List	   *quals;			/* per subplan, restrictions to refute them */
+	Bitmapset  *execparams;		/* PARAM_EXEC ids used in the restrictions */
+	Bitmapset  *validparams;	/* those of them known to be set */
+	MemoryContext prune_context;	/* work space of a pruning pass */
+} PartitionPruneState;
+
+extern PartitionPruneState *ExecInitPartitionPrune(PlanState *parent,
+					   List *constraints, List *quals);
+extern bool ExecPartitionPruneParamsChanged(PartitionPruneState *prunestate,
+								Bitmapset *chgParam);
+extern void ExecPartitionPrune(PartitionPruneState *prunestate, bool *pruned);
+
+#endif							/* EXECPRUNE_H */
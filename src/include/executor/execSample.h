@@ -0,0 +1,42 @@
+/*-------------------------------------------------------------------------
+ *
+ * execSample.h
+ *	  Sampling profiler of the plan nodes being executed
+ *
+ *
+ * Portions Copyright (c) 1996-2017, PostgreSQL Global Development Group
+ * Portions Copyright (c) 2010-2012 Postgres-XC Development Group
+ *
+ * src/include/executor/execSample.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef EXECSAMPLE_H
+#define EXECSAMPLE_H
+
+#include <signal.h>
+
+#include "nodes/execnodes.h"
+
+/* GUC parameter */
+extern int	ExecSampleInterval;
+
+/*
+ * Plan node the backend is executing, maintained by the sampling
+ * ExecProcNode wrapper while executor_sample_interval is set.
+ */
+extern uint32 ExecSampleQueryId;
+extern int	ExecSamplePlanNodeId;
+extern NodeTag ExecSampleNodeTag;
+
+/* Set by the timer when a sample is due */
+extern volatile sig_atomic_t ExecSamplePending;
+
+extern Size ExecSampleShmemSize(void);
+extern void ExecSampleShmemInit(void);
+
+extern void ExecSampleTimeoutHandler(void);
+extern void ExecSampleStart(EState *estate, PlanState *planstate);
+extern void ExecSampleTake(void);
+
+#endif							/* EXECSAMPLE_H */
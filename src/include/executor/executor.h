@@ -532,6 +532,15 @@ extern Datum GetAttributeByNum(HeapTupleHeader tuple, AttrNumber attrno,
 extern int	ExecTargetListLength(List *targetlist);
 extern int	ExecCleanTargetListLength(List *targetlist);
 
+/* GUC parameter */
+extern int	query_memory_limit;
+
+/* Number of allocations between two checks of query_memory_limit */
+#define QUERY_MEMORY_CHECK_INTERVAL	1024
+
+extern Size ExecQueryMemoryUsed(EState *estate);
+extern bool ExecCheckQueryMemory(EState *estate, bool canspill);
+
 /*
  * prototypes from functions in execIndexing.c
  */
@@ -25,6 +25,8 @@ extern void SetProducerDestReceiverParams(DestReceiver *self,
 							  AttrNumber distKey,
 							  Locator *locator,
 							  SharedQueue squeue);
+extern void SetProducerDestReceiverFilter(DestReceiver *self,
+							  const char *selffilter);
 extern DestReceiver *SetSelfConsumerDestReceiver(DestReceiver *self,
 							DestReceiver *consumer);
 extern void SetProducerTempMemory(DestReceiver *self, MemoryContext tmpcxt);
@@ -24,6 +24,7 @@
 #include "gtm/gtm_conn.h"
 #include "gtm/elog.h"
 #include "gtm/gtm_list.h"
+#include "gtm/gtm_stat.h"
 
 extern char *GTMLogFile;
 
@@ -59,6 +60,9 @@ typedef struct GTM_ThreadInfo
 	GTM_RWLock			thr_lock;
 	gtm_List			*thr_cached_txninfo;
 	GTM_SnapshotData    thr_snapshot;
+	uint64				thr_standby_position;	/* end of our last message in the
+												 * standby replication stream */
+	GTM_ThreadStats		thr_stats;		/* see gtm_stat.c */
 
 	/*
 	 * Statically allocated XID array for the snapshot. Every thread will need
@@ -73,6 +77,7 @@ typedef struct GTM_Threads
 	uint32				gt_thread_count;
 	uint32				gt_array_size;
 	bool				gt_standby_ready;
+	uint32				gt_standby_generation;	/* bumped when a new standby registers */
 	GTM_ThreadInfo		**gt_threads;
 	uint32				gt_starting_client_id;
 	uint32				gt_next_client_id;
@@ -87,6 +92,8 @@ typedef struct GTM_RestoreContext {
 
 int GTM_ThreadAdd(GTM_ThreadInfo *thrinfo);
 int GTM_ThreadRemove(GTM_ThreadInfo *thrinfo);
+uint32 GTM_AssignClientIdentifier(void);
+void GTM_ConnectionClose(GTM_ConnectionInfo *conninfo);
 void ConnFree(Port *port);
 void GTM_DoForAllOtherThreads(void (* process_routine)(GTM_ThreadInfo *));
 void GTM_SetInitialAndNextClientIdentifierAtPromote(void);
@@ -100,6 +100,9 @@ typedef GTM_SequenceKeyData *GTM_SequenceKey;
 
 #define GTM_MAX_GLOBAL_TRANSACTIONS	16384
 
+/* Largest batch of MSG_SEQUENCE_GET_NEXT_MULTI requests */
+#define GTM_MAX_SEQUENCE_NEXT_MULTI	1024
+
 typedef enum GTM_IsolationLevel
 {
 	GTM_ISOLATION_SERIALIZABLE, /* serializable txn */
@@ -123,6 +126,7 @@ typedef struct GTM_StartupPacket {
 	char					sp_node_name[SP_NODE_NAME];
 	GTM_PGXCNodeType		sp_remotetype;
 	bool					sp_ispostmaster;
+	bool					sp_active_only;	/* refuse if not the active GTM */
 	uint32					sp_client_id;
 } GTM_StartupPacket;
 
@@ -19,6 +19,7 @@
 #include "gtm/gtm_seq.h"
 #include "gtm/gtm_txn.h"
 #include "gtm/gtm_msg.h"
+#include "gtm/gtm_stat.h"
 #include "gtm/register.h"
 #include "gtm/libpq-fe.h"
 
@@ -68,6 +69,14 @@ typedef union GTM_ResultData
 		GTM_SeqInfo			   *seq;
 	} grd_seq_list;								/* SEQUENCE_GET_LIST */
 
+	struct
+	{
+		int						seq_count;		/* SEQUENCE_GET_NEXT_MULTI */
+		int						status[GTM_MAX_SEQUENCE_NEXT_MULTI];
+		GTM_Sequence			seqval[GTM_MAX_SEQUENCE_NEXT_MULTI];
+		GTM_Sequence			rangemax[GTM_MAX_SEQUENCE_NEXT_MULTI];
+	} grd_seq_multi;
+
 	struct
 	{
 		int				txn_count; 				/* TXN_BEGIN_GETGXID_MULTI */
@@ -124,6 +133,8 @@ typedef union GTM_ResultData
 		int						errcode;
 	} grd_report_xmin;						/* REPORT_XMIN */
 
+	int					grd_stats_count;	/* GET_STATS */
+
 	/*
 	 * TODO
 	 * 	TXN_GET_STATUS
@@ -156,11 +167,32 @@ typedef struct GTM_Result
 	int					gr_xip_size;
 	GTM_SnapshotData	gr_snapshot;
 
+	/*
+	 * Generation of gr_snapshot as issued by GTM, or 0 if it was not received
+	 * through MSG_SNAPSHOT_GET_DELTA. A delta is always applied on top of it.
+	 * The GXIDs of the last delta received are kept in gr_delta_xip (removed
+	 * ones first), along with the generation they apply to, or 0 if the last
+	 * reply carried the full snapshot.
+	 */
+	uint64				gr_snapshot_generation;
+	uint64				gr_delta_base;
+	GlobalTransactionId	*gr_delta_xip;
+	int					gr_delta_size;
+	int					gr_delta_nremoved;
+	int					gr_delta_nadded;
+
 	/*
 	 * Similarly, keep the buffer for proxying data outside the union
 	 */
 	char		*gr_proxy_data;
 	int			gr_proxy_datalen;
+
+	/*
+	 * Rows of the last GET_STATS_RESULT, and the number of allocated ones.
+	 * The number of valid rows is in grd_stats_count.
+	 */
+	GTM_StatsEntry	*gr_stats;
+	int				gr_stats_size;
 } GTM_Result;
 
 /*
@@ -175,6 +207,7 @@ size_t get_node_list(GTM_Conn *, GTM_PGXCNodeInfo *, size_t);
 GlobalTransactionId get_next_gxid(GTM_Conn *);
 uint32 get_txn_gxid_list(GTM_Conn *, GTM_Transactions *);
 size_t get_sequence_list(GTM_Conn *, GTM_SeqInfo **);
+int get_gtm_stats(GTM_Conn *, GTM_StatsEntry **);
 
 /*
  * Transaction Management API
@@ -205,10 +238,15 @@ int commit_prepared_transaction(GTM_Conn *conn, GlobalTransactionId gxid,
 int bkup_commit_prepared_transaction(GTM_Conn *conn, GlobalTransactionId gxid, GlobalTransactionId prepared_gxid);
 int abort_transaction(GTM_Conn *conn, GlobalTransactionId gxid);
 int bkup_abort_transaction(GTM_Conn *conn, GlobalTransactionId gxid);
+int abort_transaction_send(GTM_Conn *conn, GlobalTransactionId gxid);
+int abort_transaction_receive(GTM_Conn *conn, GlobalTransactionId gxid);
 int start_prepared_transaction(GTM_Conn *conn, GlobalTransactionId gxid, char *gid,
 							   char *nodestring);
 int backup_start_prepared_transaction(GTM_Conn *conn, GlobalTransactionId gxid, char *gid,
 									  char *nodestring);
+int start_prepared_transaction_send(GTM_Conn *conn, GlobalTransactionId gxid, char *gid,
+									char *nodestring);
+int start_prepared_transaction_receive(GTM_Conn *conn, GlobalTransactionId gxid);
 int prepare_transaction(GTM_Conn *conn, GlobalTransactionId gxid);
 int bkup_prepare_transaction(GTM_Conn *conn, GlobalTransactionId gxid);
 int get_gid_data(GTM_Conn *conn, GTM_IsolationLevel isolevel, char *gid,
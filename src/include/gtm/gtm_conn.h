@@ -29,6 +29,13 @@ typedef struct GTM_ConnectionInfo
 
 	/* a connection object to the standby */
 	GTM_Conn				*standby;
+	uint32					con_standby_generation;
+
+	/*
+	 * Client identifier of a connection served by the worker pool. Dedicated
+	 * connection threads keep it in thr_client_id instead.
+	 */
+	uint32					con_client_id;
 } GTM_ConnectionInfo;
 
 typedef struct GTM_Connections
@@ -64,11 +64,13 @@ typedef enum GTM_MessageType
 	MSG_SNAPSHOT_GET,		/* Get a global snapshot */
 	MSG_SNAPSHOT_GET_MULTI,	/* Get multiple global snapshots */
 	MSG_SNAPSHOT_GXID_GET,	/* Get GXID and snapshot together */
+	MSG_SNAPSHOT_GET_DELTA,	/* Get snapshots as a delta from an earlier one */
 	MSG_SEQUENCE_INIT,		/* Initialize a new global sequence */
 	MSG_BKUP_SEQUENCE_INIT,	/* Backup of MSG_SEQUENCE_INIT */
 	MSG_SEQUENCE_GET_CURRENT,/* Get the current value of sequence */
 	MSG_SEQUENCE_GET_NEXT,		/* Get the next sequence value of sequence */
 	MSG_BKUP_SEQUENCE_GET_NEXT,	/* Backup of MSG_SEQUENCE_GET_NEXT */
+	MSG_SEQUENCE_GET_NEXT_MULTI,	/* Get the next values of multiple sequences */
 	MSG_SEQUENCE_GET_LAST,	/* Get the last sequence value of sequence */
 	MSG_SEQUENCE_SET_VAL,		/* Set values for sequence */
 	MSG_BKUP_SEQUENCE_SET_VAL,	/* Backup of MSG_SEQUENCE_SET_VAL */
@@ -90,6 +92,7 @@ typedef enum GTM_MessageType
 	MSG_BACKEND_DISCONNECT,			/* tell GTM that the backend diconnected from the proxy */
 	MSG_BARRIER,				/* Tell the barrier was issued */
 	MSG_BKUP_BARRIER,			/* Backup barrier to standby */
+	MSG_GET_STATS,				/* Get request statistics */
 
 	/*
 	 * Must be at the end
@@ -130,9 +133,11 @@ typedef enum GTM_ResultType
 	SNAPSHOT_GET_RESULT,
 	SNAPSHOT_GET_MULTI_RESULT,
 	SNAPSHOT_GXID_GET_RESULT,
+	SNAPSHOT_GET_DELTA_RESULT,
 	SEQUENCE_INIT_RESULT,
 	SEQUENCE_GET_CURRENT_RESULT,
 	SEQUENCE_GET_NEXT_RESULT,
+	SEQUENCE_GET_NEXT_MULTI_RESULT,
 	SEQUENCE_GET_LAST_RESULT,
 	SEQUENCE_SET_VAL_RESULT,
 	SEQUENCE_RESET_RESULT,
@@ -144,6 +149,7 @@ typedef enum GTM_ResultType
 	TXN_GET_ALL_PREPARED_RESULT,
 	TXN_BEGIN_GETGXID_AUTOVACUUM_RESULT,
 	BARRIER_RESULT,
+	GET_STATS_RESULT,
 	RESULT_TYPE_COUNT
 } GTM_ResultType;
 
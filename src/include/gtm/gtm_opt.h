@@ -330,12 +330,15 @@ const char *const config_type_names[] =\
 
 #define GTM_OPTNAME_ACTIVE_HOST			"active_host"
 #define GTM_OPTNAME_ACTIVE_PORT 		"active_port"
+#define GTM_OPTNAME_BATCH_WINDOW		"batch_window"
 #define GTM_OPTNAME_CONFIG_FILE			"config_file"
 #define GTM_OPTNAME_DATA_DIR			"data_dir"
 #define GTM_OPTNAME_ERROR_REPORTER		"error_reporter"
 #define GTM_OPTNAME_CONNECT_RETRY_INTERVAL "gtm_connect_retry_interval"
 #define GTM_OPTNAME_GTM_HOST			"gtm_host"
 #define GTM_OPTNAME_GTM_PORT			"gtm_port"
+#define GTM_OPTNAME_GTM_STANDBY_HOST	"gtm_standby_host"
+#define GTM_OPTNAME_GTM_STANDBY_PORT	"gtm_standby_port"
 #define GTM_OPTNAME_KEEPALIVES_IDLE		"keepalives_idle"
 #define GTM_OPTNAME_KEEPALIVES_INTERVAL	"keepalives_interval"
 #define GTM_OPTNAME_KEEPALIVES_COUNT	"keepalives_count"
@@ -345,6 +348,8 @@ const char *const config_type_names[] =\
 #define GTM_OPTNAME_NODENAME			"nodename"
 #define GTM_OPTNAME_PORT				"port"
 #define GTM_OPTNAME_STARTUP				"startup"
+#define GTM_OPTNAME_STANDBY_STREAM		"standby_stream"
+#define GTM_OPTNAME_STATE_LOG			"state_log"
 #define GTM_OPTNAME_STATUS_READER		"status_reader"
 #define GTM_OPTNAME_SYNCHRONOUS_BACKUP	"synchronous_backup"
 #define GTM_OPTNAME_WORKER_THREADS		"worker_threads"
@@ -25,6 +25,7 @@
 #include "gtm/elog.h"
 #include "gtm/gtm_list.h"
 #include "gtm/gtm_msg.h"
+#include "gtm/gtm_stat.h"
 #include "gtm/libpq-fe.h"
 
 extern char *GTMProxyLogFile;
@@ -99,9 +100,18 @@ typedef struct GTMProxy_ThreadInfo
 	int						thr_qtype[GTM_PROXY_MAX_CONNECTIONS];
 	StringInfoData			thr_inBufData[GTM_PROXY_MAX_CONNECTIONS];
 
+	/* Connections a command was read from in this round, by poll slot */
+	bool					thr_conn_read[GTM_PROXY_MAX_CONNECTIONS];
+
+	/* Current batching window in microseconds, see GTMProxy_WaitForBatch */
+	int						thr_batch_window;
+
 	gtm_List 					*thr_processed_commands;
 	gtm_List 					*thr_pending_commands[MSG_TYPE_COUNT];
 
+	/* Number of commands sent to GTM in one go, by message type */
+	GTM_StatsCounter		thr_batch_stats[MSG_TYPE_COUNT];
+
 	GTM_Conn				*thr_gtm_conn;		/* Connection to GTM */
 
 	/* Reconnect Info */
@@ -155,8 +165,17 @@ typedef union GTMProxy_CommandData
 	struct
 	{
 		GlobalTransactionId	gxid;
+		bool			delta;		/* MSG_SNAPSHOT_GET_DELTA? */
+		uint64			generation;	/* snapshot the backend already has */
 	} cd_snap;
 
+	struct
+	{
+		int				offset;		/* request body in the command backup */
+		int				len;
+		int				keylen;		/* sequence key length, at the start */
+	} cd_seq;
+
 	struct
 	{
 		GTM_PGXCNodeType	type;
@@ -18,6 +18,7 @@
 #include "gtm/stringinfo.h"
 #include "gtm/gtm_lock.h"
 #include "gtm/libpq-be.h"
+#include "gtm/gtm_xlog.h"
 
 /* Global sequence  related structures */
 
@@ -34,6 +35,7 @@ typedef struct GTM_SeqInfo
 	GTM_SequenceKey	gs_oldkey;
 	GTM_Sequence	gs_value;
 	GTM_Sequence	gs_backedUpValue;
+	GTM_XLogPtr		gs_backedUpLSN;	/* state log record of gs_backedUpValue */
 	GTM_Sequence	gs_init_value;
 	int32			gs_max_lastvals;
 	int32			gs_lastval_count;
@@ -45,6 +47,11 @@ typedef struct GTM_SeqInfo
 	bool			gs_called;
 	GlobalTransactionId	gs_created_gxid;
 
+	uint32			gs_hash;		/* hash of gs_key */
+	uint32			gs_dbhash;		/* hash of the database part of gs_key */
+	struct GTM_SeqInfo *gs_dbnext;	/* database index links */
+	struct GTM_SeqInfo *gs_dbprev;
+
 	int32			gs_ref_count;
 	int32			gs_state;
 	GTM_RWLock		gs_lock;
@@ -72,6 +79,7 @@ void GTM_InitSeqManager(void);
 void ProcessSequenceInitCommand(Port *myport, StringInfo message, bool is_backup);
 void ProcessSequenceGetCurrentCommand(Port *myport, StringInfo message);
 void ProcessSequenceGetNextCommand(Port *myport, StringInfo message, bool is_backup);
+void ProcessSequenceGetNextMultiCommand(Port *myport, StringInfo message);
 void ProcessSequenceSetValCommand(Port *myport, StringInfo message, bool is_backup);
 void ProcessSequenceResetCommand(Port *myport, StringInfo message, bool is_backup);
 void ProcessSequenceCloseCommand(Port *myport, StringInfo message, bool is_backup);
@@ -95,6 +103,7 @@ int GTM_SeqRestore(GTM_SequenceKey seqkey,
 void GTM_CleanupSeqSession(char *coord_name, int coord_procid);
 
 bool GTM_NeedSeqRestoreUpdate(GTM_SequenceKey seqkey);
+void GTM_RestoreSeqReservation(GTM_SequenceKey seqkey, GTM_Sequence value);
 void GTM_WriteRestorePointSeq(FILE *f);
 void GTM_SeqRemoveCreated(void *seqinfo);
 void GTM_SeqRestoreDropped(void *seqinfo);
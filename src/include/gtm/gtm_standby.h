@@ -38,6 +38,8 @@ int gtm_standby_activate_self(void);
 GTM_Conn *gtm_standby_connect_to_standby(void);
 void gtm_standby_disconnect_from_standby(GTM_Conn *conn);
 bool gtm_standby_check_communication_error(int *retry_count, GTM_Conn *oldconn);
+int gtm_standby_sync(GTM_Conn *conn);
+void gtm_standby_start_stream(void);
 
 GTM_PGXCNodeInfo *find_standby_node_info(void);
 
@@ -0,0 +1,106 @@
+/*-------------------------------------------------------------------------
+ *
+ * gtm_stat.h
+ *
+ *	  Request counters and latency histograms kept by GTM and GTM proxy
+ *
+ * Portions Copyright (c) 1996-2009, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ * Portions Copyright (c) 2010-2012 Postgres-XC Development Group
+ *
+ * src/include/gtm/gtm_stat.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef GTM_STAT_H
+#define GTM_STAT_H
+
+#include "gtm/gtm_c.h"
+#include "gtm/gtm_msg.h"
+#include "gtm/libpq-be.h"
+#include "gtm/stringinfo.h"
+
+/*
+ * Histograms use fixed, roughly logarithmic buckets. The same bounds serve
+ * latencies (in microseconds) and sizes (number of GXIDs in a snapshot or
+ * number of commands merged into a proxy batch): bucket i counts values
+ * below the i-th bound, the last bucket everything else.
+ */
+#define GTM_STATS_BUCKETS		8
+
+typedef struct GTM_StatsCounter
+{
+	uint64		count;			/* number of recorded values */
+	uint64		total;			/* sum of recorded values */
+	uint64		max;			/* largest recorded value */
+	uint64		hist[GTM_STATS_BUCKETS];
+} GTM_StatsCounter;
+
+/*
+ * Counters of a single GTM thread. Each thread only ever updates its own
+ * copy, so no locking is needed on the hot path; readers sum them up while
+ * holding the thread list lock and accept slightly torn values.
+ */
+typedef struct GTM_ThreadStats
+{
+	bool				gts_busy;		/* currently processing a command */
+	GTM_StatsCounter	gts_messages[MSG_TYPE_COUNT];	/* latency, usec */
+	GTM_StatsCounter	gts_snapshots;	/* GXIDs per snapshot */
+} GTM_ThreadStats;
+
+/* Kinds of rows reported by MSG_GET_STATS */
+typedef enum GTM_StatsKind
+{
+	GTM_STATS_MESSAGE,			/* request latency in GTM, usec */
+	GTM_STATS_SNAPSHOT,			/* snapshot size, GXIDs */
+	GTM_STATS_QUEUE,			/* worker thread usage, count only */
+	GTM_STATS_BATCH				/* commands per proxy batch */
+} GTM_StatsKind;
+
+#define GTM_STATS_NAMELEN		64
+
+/* One row of the MSG_GET_STATS result, as seen by the client */
+typedef struct GTM_StatsEntry
+{
+	char				source[GTM_STATS_NAMELEN];	/* "gtm" or proxy name */
+	int					kind;
+	char				name[GTM_STATS_NAMELEN];
+	GTM_StatsCounter	counter;
+} GTM_StatsEntry;
+
+static inline void
+gtm_stat_record(GTM_StatsCounter *counter, uint64 value)
+{
+	static const uint64 bounds[GTM_STATS_BUCKETS - 1] =
+		{10, 50, 100, 500, 1000, 5000, 10000};
+	int			bucket = 0;
+
+	while (bucket < GTM_STATS_BUCKETS - 1 && value >= bounds[bucket])
+		bucket++;
+
+	counter->count++;
+	counter->total += value;
+	if (value > counter->max)
+		counter->max = value;
+	counter->hist[bucket]++;
+}
+
+static inline void
+gtm_stat_add(GTM_StatsCounter *dst, const GTM_StatsCounter *src)
+{
+	int			i;
+
+	dst->count += src->count;
+	dst->total += src->total;
+	if (src->max > dst->max)
+		dst->max = src->max;
+	for (i = 0; i < GTM_STATS_BUCKETS; i++)
+		dst->hist[i] += src->hist[i];
+}
+
+/* GTM server side, see gtm_stat.c */
+extern uint64 GTM_StatNow(void);
+extern void GTM_StatsRetire(GTM_ThreadStats *stats);
+extern void ProcessGetStatsCommand(Port *myport, StringInfo message);
+
+#endif   /* GTM_STAT_H */
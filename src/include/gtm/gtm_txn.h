@@ -20,6 +20,7 @@
 #include "gtm/gtm_lock.h"
 #include "gtm/gtm_list.h"
 #include "gtm/stringinfo.h"
+#include "gtm/gtm_xlog.h"
 
 
 typedef int XidStatus;
@@ -44,6 +45,7 @@ extern void GTM_RestoreStart(FILE *ctlf, struct GTM_RestoreContext *context);
 extern void GTM_SaveTxnInfo(FILE *ctlf);
 extern void GTM_RestoreTxnInfo(FILE *ctlf, GlobalTransactionId next_gxid,
 						struct GTM_RestoreContext *context, bool force_xid);
+extern void GTM_RestoreXidReservation(GlobalTransactionId gxid);
 
 
 /* States of the GTM component */
@@ -90,6 +92,7 @@ typedef struct GTM_TransactionInfo
 
 	GTM_RWLock				gti_lock;
 	bool					gti_vacuum;
+	GTM_TransactionHandle	gti_gxid_next;	/* next handle in GXID index bucket */
 	gtm_List				*gti_created_seqs;
 	gtm_List				*gti_dropped_seqs;
 	gtm_List				*gti_altered_seqs;
@@ -114,6 +117,7 @@ typedef struct GTM_Transactions
 	 */
 	GlobalTransactionId gt_nextXid;		/* next XID to assign */
 	GlobalTransactionId gt_backedUpXid;	/* backed up, restoration point */
+	GTM_XLogPtr			gt_backedUpLSN;	/* state log record of gt_backedUpXid */
 
 	GlobalTransactionId gt_oldestXid;	/* cluster-wide minimum datfrozenxid */
 	GlobalTransactionId gt_xidVacLimit;	/* start forcing autovacuums here */
@@ -133,11 +137,31 @@ typedef struct GTM_Transactions
 	GTM_TransactionInfo	gt_transactions_array[GTM_MAX_GLOBAL_TRANSACTIONS];
 	gtm_List			*gt_open_transactions;
 
+	/*
+	 * Advanced whenever the snapshot computed by GTM_GetTransactionSnapshot
+	 * may change, i.e. when a transaction with a GXID leaves the list or
+	 * gt_latestCompletedXid moves. Assigning a GXID does not advance it, as
+	 * a fresh GXID is never below the snapshot xmax.
+	 */
+	uint64				gt_snapshot_generation;
+
 	GTM_RWLock			gt_TransArrayLock;
 } GTM_Transactions;
 
 extern GTM_Transactions	GTMTransactions;
 
+/*
+ * Index of open transactions by GXID. Handles hashing to the same bucket are
+ * chained through gti_gxid_next. The buckets are split into shards, each with
+ * its own lock, so looking up a GXID neither walks gt_open_transactions nor
+ * takes the TransArrayLock. A shard lock is always acquired last.
+ */
+#define GTM_GXID_INDEX_SHARDS			16
+#define GTM_GXID_INDEX_BUCKETS			(GTM_MAX_GLOBAL_TRANSACTIONS / GTM_GXID_INDEX_SHARDS)
+
+extern void GTM_GXIDIndexInsert(GTM_TransactionInfo *gtm_txninfo);
+extern void GTM_GXIDIndexRemove(GTM_TransactionInfo *gtm_txninfo);
+
 /*
  * Two hash tables will be maintained to quickly find the
  * GTM_TransactionInfo block given either the GXID or the GTM_TransactionHandle.
@@ -152,6 +176,7 @@ GTM_TransactionHandle GTM_GXIDToHandle(GlobalTransactionId gxid);
 
 /* Transaction Control */
 void GTM_InitTxnManager(void);
+void GTM_InitSnapshotCache(void);
 void GTM_RemoveAllTransInfos(uint32 client_id, int backend_id);
 uint32 GTM_GetLastClientIdentifier(void);
 
@@ -186,6 +211,7 @@ void ProcessBkupBeginTransactionGetGXIDCommandMulti(Port *myport, StringInfo mes
  */
 void ProcessGetSnapshotCommand(Port *myport, StringInfo message, bool get_gxid);
 void ProcessGetSnapshotCommandMulti(Port *myport, StringInfo message);
+void ProcessGetSnapshotCommandDelta(Port *myport, StringInfo message);
 void GTM_RememberDroppedSequence(GlobalTransactionId gxid, void *seq);
 void GTM_ForgetCreatedSequence(GlobalTransactionId gxid, void *seq);
 void GTM_RememberCreatedSequence(GlobalTransactionId gxid, void *seq);
@@ -0,0 +1,40 @@
+/*-------------------------------------------------------------------------
+ *
+ * gtm_xlog.h
+ *
+ *
+ * Portions Copyright (c) 1996-2009, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ * Portions Copyright (c) 2010-2013 Postgres-XC Development Group
+ *
+ * $PostgreSQL$
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef _GTM_XLOG_H
+#define _GTM_XLOG_H
+
+#include "gtm/gtm_c.h"
+
+/* Position in the state log, bytes inserted since GTM started */
+typedef uint64 GTM_XLogPtr;
+
+#define InvalidGTMXLogPtr		0
+
+#define GTM_XLOG_FILE			"gtm.xlog"
+#define GTM_XLOG_OLD_FILE		"gtm.xlog.old"
+
+/* Checkpoint once the log has grown this much */
+#define GTM_XLOG_CHECKPOINT_SIZE	(8 * 1024 * 1024)
+
+extern bool GTMStateLog;
+
+extern void GTM_XLogStartup(bool replay);
+extern GTM_XLogPtr GTM_XLogInsertXid(GlobalTransactionId gxid);
+extern GTM_XLogPtr GTM_XLogInsertSeq(GTM_SequenceKey seqkey,
+									 GTM_Sequence value);
+extern void GTM_XLogFlush(GTM_XLogPtr ptr);
+extern void GTM_XLogSwitch(void);
+extern void GTM_XLogRemoveOld(void);
+
+#endif /* _GTM_XLOG_H */
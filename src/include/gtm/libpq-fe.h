@@ -107,6 +107,10 @@ extern GTMClientPollingStatusType GTMPQconnectPoll(GTM_Conn *conn);
 /* Synchronous (blocking) */
 extern GTM_Conn *PQconnectGTM(const char *conninfo);
 
+/* make a connection without socket, for messages consumed by flush_hook */
+extern GTM_Conn *PQbufferedConnectGTM(int remote_type,
+					 int (*flush_hook)(GTM_Conn *conn));
+
 /* close the current connection and free the GTM_Conn data structure */
 extern void GTMPQfinish(GTM_Conn *conn);
 
@@ -120,6 +124,7 @@ extern char *GTMPQhost(const GTM_Conn *conn);
 extern char *GTMPQport(const GTM_Conn *conn);
 extern ConnStatusType GTMPQstatus(const GTM_Conn *conn);
 extern int GTMPQispostmaster(const GTM_Conn *conn);
+extern uint32 GTMPQclientid(const GTM_Conn *conn);
 extern char *GTMPQerrorMessage(const GTM_Conn *conn);
 extern int	GTMPQsocket(const GTM_Conn *conn);
 
@@ -46,6 +46,7 @@ struct gtm_conn
 	char		*gc_node_name;		/* PGXC Node Name */
 	int			remote_type;		/* is this a connection to/from a proxy ? */
 	int			is_postmaster;		/* is this connection to/from a postmaster instance */
+	int			active_only;		/* connect only if the server is the active GTM */
 	uint32		my_id;				/* unique identifier issued to us by GTM */
 
 	/* Optional file to write trace info to */
@@ -85,6 +86,12 @@ struct gtm_conn
 							 * msg has no length word */
 	int		outMsgEnd;		/* offset to msg end (so far) */
 
+	/*
+	 * If set, the connection has no socket. Flushing hands the buffered data
+	 * to this function instead, which returns 0 once it has taken all of it.
+	 */
+	int		(*flush_hook)(GTM_Conn *conn);
+
 	/* Buffer for current error message */
 	PQExpBufferData	errorMessage;		/* expansible string */
 
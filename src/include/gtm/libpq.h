@@ -43,5 +43,7 @@ extern int	pq_peekbyte(Port *myport);
 extern int	pq_putbytes(Port *myport, const char *s, size_t len);
 extern int	pq_flush(Port *myport);
 extern int	pq_putmessage(Port *myport, char msgtype, const char *s, size_t len);
+extern int	pq_putmessage_tail(Port *myport, char msgtype, const char *s,
+				   size_t len, const char *tail, size_t taillen);
 
 #endif   /* LIBPQ_H */
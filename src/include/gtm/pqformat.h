@@ -29,6 +29,8 @@ extern void pq_sendint64(StringInfo buf, int64 i);
 extern void pq_sendfloat4(StringInfo buf, float4 f);
 extern void pq_sendfloat8(StringInfo buf, float8 f);
 extern void pq_endmessage(Port *myport, StringInfo buf);
+extern void pq_endmessage_tail(Port *myport, StringInfo buf, const char *tail,
+				   size_t taillen);
 
 extern void pq_puttextmessage(Port *myport, char msgtype, const char *str);
 extern void pq_putemptymessage(Port *myport, char msgtype);
@@ -72,6 +72,22 @@ extern int	pq_peekbyte(void);
 extern int	pq_getbyte_if_available(unsigned char *c);
 extern int	pq_putbytes(const char *s, size_t len);
 
+#ifdef PGXC
+/*
+ * Framing of compressed streams between the nodes of the cluster: each frame
+ * carries up to PQ_FRAME_RAWSZ bytes of the stream, see pq_compress_frame().
+ * The frame buffer has room for PGLZ_MAX_OUTPUT(PQ_FRAME_RAWSZ) bytes.
+ */
+#define PQ_FRAME_HDRSZ		8
+#define PQ_FRAME_RAWSZ		8192
+#define PQ_FRAME_MAXSZ		(PQ_FRAME_HDRSZ + PQ_FRAME_RAWSZ + 4)
+
+extern void pq_enable_compression(void);
+extern int	pq_compress_frame(const char *src, int len, char *frame);
+extern int	pq_frame_length(const char *buf, int len, int *rawlen);
+extern int	pq_decompress_frame(const char *frame, char *dest);
+#endif
+
 /*
  * prototypes for functions in be-secure.c
  */
@@ -160,6 +160,7 @@ extern int	MaxBackends;
 extern int	MaxConnections;
 extern int	max_worker_processes;
 extern int	max_parallel_workers;
+extern int	max_parallel_maintenance_workers;
 
 extern PGDLLIMPORT int MyProcPid;
 extern PGDLLIMPORT pg_time_t MyStartTime;
@@ -478,6 +478,8 @@ typedef struct EState
 
 	int			es_top_eflags;	/* eflags passed to ExecutorStart */
 	int			es_instrument;	/* OR of InstrumentOption flags */
+	bool		es_sample;		/* sample the plan nodes being executed? */
+	uint32		es_sample_queryid;	/* query id the samples are charged to */
 	bool		es_finished;	/* true when ExecutorFinish is done */
 
 	List	   *es_exprcontexts;	/* List of ExprContexts within EState */
@@ -988,6 +990,10 @@ typedef struct ModifyTableState
 	/* controls transition table population */
 	TupleConversionMap **mt_transition_tupconv_maps;
 	/* Per plan/partition tuple conversion */
+#ifdef XCP
+	BulkInsertState mt_bistate;	/* bulk insert state for redistributed
+								 * INSERT ... SELECT, or NULL */
+#endif
 } ModifyTableState;
 
 /* ----------------
@@ -995,6 +1001,8 @@ typedef struct ModifyTableState
  *
  *		nplans			how many plans are in the array
  *		whichplan		which plan is being executed (0 .. n-1)
+ *		prunestate		execution-time partition pruning, or NULL
+ *		pruned			subplans not to scan, or NULL
  * ----------------
  */
 typedef struct AppendState
@@ -1003,6 +1011,8 @@ typedef struct AppendState
 	PlanState **appendplans;	/* array of PlanStates for my inputs */
 	int			as_nplans;
 	int			as_whichplan;
+	struct PartitionPruneState *as_prunestate;
+	bool	   *as_pruned;		/* array of length as_nplans */
 } AppendState;
 
 /* ----------------
@@ -1014,6 +1024,8 @@ typedef struct AppendState
  *		slots			current output tuple of each subplan
  *		heap			heap of active tuples
  *		initialized		true if we have fetched first tuple from each subplan
+ *		prunestate		execution-time partition pruning, or NULL
+ *		pruned			subplans not to scan, or NULL
  * ----------------
  */
 typedef struct MergeAppendState
@@ -1026,6 +1038,8 @@ typedef struct MergeAppendState
 	TupleTableSlot **ms_slots;	/* array of length ms_nplans */
 	struct binaryheap *ms_heap; /* binary heap of slot indices */
 	bool		ms_initialized; /* are subplans started? */
+	struct PartitionPruneState *ms_prunestate;
+	bool	   *ms_pruned;		/* array of length ms_nplans */
 } MergeAppendState;
 
 /* ----------------
@@ -1746,6 +1760,11 @@ typedef struct SortState
 	bool		bounded_Done;	/* value of bounded we did the sort with */
 	int64		bound_Done;		/* value of bound we did the sort with */
 	void	   *tuplesortstate; /* private state of tuplesort.c */
+	/* these fields are used only by an incremental sort: */
+	SortSupport presortedKeys;	/* comparators of the presorted columns */
+	TupleTableSlot *group_pivot;	/* first tuple of the next group */
+	bool		incr_input_done;	/* outer plan exhausted? */
+	int64		tuples_returned;	/* tuples returned so far, for bound */
 } SortState;
 
 /* ---------------------
@@ -1811,11 +1830,23 @@ typedef struct AggState
 	/* these fields are used in AGG_PLAIN and AGG_SORTED modes: */
 	AggStatePerGroup pergroup;	/* per-Aggref-per-group working state */
 	HeapTuple	grp_firstTuple; /* copy of first tuple of current group */
+	bool		count_fastpath; /* count(*) input by counting the scan? */
 	/* these fields are used in AGG_HASHED and AGG_MIXED modes: */
 	bool		table_filled;	/* hash table filled yet? */
 	int			num_hashes;
 	AggStatePerHash perhash;
 	AggStatePerGroup *hash_pergroup;	/* array of per-group pointers */
+	char	   *hash_pergroup_chunk;	/* space for per-group states ... */
+	Size		hash_pergroup_free; /* ... and how much of it is left */
+	/* these fields are used to spill AGG_HASHED input beyond work_mem: */
+	bool		hash_spill_ok;	/* may this node spill at all? */
+	bool		hash_spill_mode;	/* refusing new groups in this pass? */
+	bool		hash_spilled;	/* did any pass spill input tuples? */
+	Size		hash_mem_used;	/* estimated size of current hash table */
+	uint32		hash_new_groups;	/* groups added, to pace memory checks */
+	Tuplestorestate *hash_spill_in; /* input of the current pass, if any */
+	Tuplestorestate *hash_spill_out;	/* tuples deferred to the next pass */
+	TupleTableSlot *hash_spill_slot;	/* slot for reading hash_spill_in */
 	/* support for evaluation of agg inputs */
 	TupleTableSlot *evalslot;	/* slot for agg inputs */
 	ProjectionInfo *evalproj;	/* projection machinery */
@@ -1961,6 +1992,10 @@ typedef struct HashState
 	HashJoinTable hashtable;	/* hash table for the hashjoin */
 	List	   *hashkeys;		/* list of ExprState nodes */
 	/* hashkeys is same as parent's hj_InnerHashKeys */
+	int			filterKeyNo;	/* if nonzero, collect Bloom filter of the
+								 * hash key of this number */
+	Oid			filterKeyType;	/* data type of the filter key */
+	bytea	   *filter;			/* the Bloom filter */
 } HashState;
 
 /* ----------------
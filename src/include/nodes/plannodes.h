@@ -103,6 +103,14 @@ typedef struct PlannedStmt
 	AttrNumber  distributionKey;
 	List	   *distributionNodes;
 	List	   *distributionRestrict;
+	List	   *skewValues;		/* hot distribution key values */
+	Oid			skewEqfunc;
+	Oid			skewCollation;
+	bool		skewBroadcast;
+	bool		hasBloomParam;	/* last remote param is the Bloom filter of
+								 * the join keys of the consumer */
+	int			instrumentOptions;	/* instrument the fragment and report the
+									 * figures back to the consumer */
 #endif	
 
 	Node	   *utilityStmt;	/* non-null if this is utility stmt */
@@ -262,6 +270,9 @@ typedef struct Append
 	/* RT indexes of non-leaf tables in a partition tree */
 	List	   *partitioned_rels;
 	List	   *appendplans;
+	/* for execution-time pruning, one list per subplan, or NIL if none */
+	List	   *part_prune_constraints; /* constraints of the partition */
+	List	   *part_prune_quals;	/* restrictions that may refute them */
 } Append;
 
 /* ----------------
@@ -275,6 +286,9 @@ typedef struct MergeAppend
 	/* RT indexes of non-leaf tables in a partition tree */
 	List	   *partitioned_rels;
 	List	   *mergeplans;
+	/* for execution-time pruning, as in Append */
+	List	   *part_prune_constraints;
+	List	   *part_prune_quals;
 	/* remaining fields are just like the sort-key info in struct Sort */
 	int			numCols;		/* number of sort-key columns */
 	AttrNumber *sortColIdx;		/* their indexes in the target list */
@@ -761,6 +775,7 @@ typedef struct Sort
 	Oid		   *sortOperators;	/* OIDs of operators to sort them by */
 	Oid		   *collations;		/* OIDs of collations */
 	bool	   *nullsFirst;		/* NULLS FIRST/LAST directions */
+	int			numPresortedCols;	/* leading keys the input is sorted by */
 } Sort;
 
 /* ---------------
@@ -1493,7 +1493,8 @@ typedef enum DistributionType
 	DISTTYPE_REPLICATION,			/* Replicated */
 	DISTTYPE_HASH,				/* Hash partitioned */
 	DISTTYPE_ROUNDROBIN,			/* Round Robin */
-	DISTTYPE_MODULO				/* Modulo partitioned */
+	DISTTYPE_MODULO,			/* Modulo partitioned */
+	DISTTYPE_BUCKET				/* Hash partitioned into buckets */
 } DistributionType;
 
 /*----------
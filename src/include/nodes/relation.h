@@ -37,6 +37,20 @@ typedef struct Distribution
 	Node	   *distributionExpr;
 	Bitmapset  *nodes;
 	Bitmapset  *restrictNodes;
+	/*
+	 * External parameter the distributionExpr is restricted to, so the nodes
+	 * holding the data may be determined when executing a generic plan.
+	 */
+	Node	   *restrictExpr;
+	/*
+	 * Hot values of distributionExpr, Consts compared with skewEqfunc. Rows
+	 * holding one of them are sent to all nodes if skewBroadcast, or spread
+	 * over the nodes in round robin manner otherwise.
+	 */
+	List	   *skewValues;
+	Oid			skewEqfunc;
+	Oid			skewCollation;
+	bool		skewBroadcast;
 } Distribution;
 #endif
 
@@ -1463,6 +1477,7 @@ typedef struct SortPath
 {
 	Path		path;
 	Path	   *subpath;		/* path representing input source */
+	int			numPresortedCols;	/* # of leading pathkeys already sorted */
 } SortPath;
 
 /*
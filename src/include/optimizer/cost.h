@@ -30,6 +30,8 @@
 #ifdef XCP
 #define DEFAULT_NETWORK_BYTE_COST  0.001
 #define DEFAULT_REMOTE_QUERY_COST  100.0
+#define DEFAULT_NETWORK_COMPRESSION_RATIO  0.5
+#define DEFAULT_NETWORK_CROSS_ZONE_FACTOR  1.0
 #endif
 #define DEFAULT_PARALLEL_TUPLE_COST 0.1
 #define DEFAULT_PARALLEL_SETUP_COST  1000.0
@@ -58,6 +60,8 @@ extern PGDLLIMPORT double cpu_operator_cost;
 #ifdef XCP
 extern PGDLLIMPORT double network_byte_cost;
 extern PGDLLIMPORT double remote_query_cost;
+extern PGDLLIMPORT double network_compression_ratio;
+extern PGDLLIMPORT double network_cross_zone_factor;
 #endif
 extern PGDLLIMPORT double parallel_tuple_cost;
 extern PGDLLIMPORT double parallel_setup_cost;
@@ -76,7 +80,16 @@ extern bool enable_material;
 extern bool enable_mergejoin;
 extern bool enable_hashjoin;
 extern bool enable_fast_query_shipping;
+extern bool enable_broadcast_join;
+extern bool enable_bloom_filter;
+extern bool enable_remote_memoize;
 extern bool enable_gathermerge;
+extern bool enable_incremental_sort;
+extern bool enable_partition_wise_join;
+extern bool enable_cte_inline;
+extern bool enable_scalar_sublink_join;
+extern bool enable_window_redistribution;
+extern bool enable_grouping_redistribution;
 extern int	constraint_exclusion;
 
 extern double clamp_row_est(double nrows);
@@ -118,6 +131,12 @@ extern void cost_sort(Path *path, PlannerInfo *root,
 		  List *pathkeys, Cost input_cost, double tuples, int width,
 		  Cost comparison_cost, int sort_mem,
 		  double limit_tuples);
+extern void cost_incremental_sort(Path *path, PlannerInfo *root,
+					  List *pathkeys, int presorted_keys,
+					  Cost input_startup_cost, Cost input_total_cost,
+					  double input_tuples, int width,
+					  Cost comparison_cost, int sort_mem,
+					  double limit_tuples);
 extern void cost_merge_append(Path *path, PlannerInfo *root,
 				  List *pathkeys, int n_streams,
 				  Cost input_startup_cost, Cost input_total_cost,
@@ -173,7 +192,8 @@ extern void cost_qual_eval_node(QualCost *cost, Node *qual, PlannerInfo *root);
 #ifdef XCP
 extern void cost_remote_subplan(Path *path,
 			  Cost input_startup_cost, Cost input_total_cost,
-			  double tuples, int width, int replication);
+			  double tuples, int width, int replication,
+			  Distribution *source);
 #endif
 extern void compute_semi_anti_join_factors(PlannerInfo *root,
 							   RelOptInfo *outerrel,
@@ -23,6 +23,8 @@
 
 /* Determine if query is shippable */
 extern ExecNodes *pgxc_is_query_shippable(Query *query, int query_level);
+extern ExecNodes *pgxc_query_shippability(Query *query, int query_level,
+						bool *shape_unshippable);
 /* Determine if an expression is shippable */
 extern bool pgxc_is_expr_shippable(Expr *node, bool *has_aggs);
 
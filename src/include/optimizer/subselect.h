@@ -23,6 +23,9 @@ extern JoinExpr *convert_EXISTS_sublink_to_join(PlannerInfo *root,
 							   SubLink *sublink,
 							   bool under_not,
 							   Relids available_rels);
+extern JoinExpr *convert_EXPR_sublink_to_join(PlannerInfo *root,
+							 OpExpr *opexpr,
+							 Relids available_rels);
 extern Node *SS_replace_correlation_vars(PlannerInfo *root, Node *expr);
 extern Node *SS_process_sublinks(PlannerInfo *root, Node *expr, bool isQual);
 extern void SS_identify_outer_params(PlannerInfo *root);
@@ -771,7 +771,9 @@ typedef enum
 	WAIT_EVENT_WAL_RECEIVER_MAIN,
 	WAIT_EVENT_WAL_SENDER_MAIN,
 	WAIT_EVENT_WAL_WRITER_MAIN,
-	WAIT_EVENT_CLUSTER_MONITOR_MAIN
+	WAIT_EVENT_CLUSTER_MONITOR_MAIN,
+	WAIT_EVENT_COMMIT_BATCHER_MAIN,
+	WAIT_EVENT_GLOBAL_DEADLOCK_DETECTOR_MAIN
 } WaitEventActivity;
 
 /* ----------
@@ -791,7 +793,18 @@ typedef enum
 	WAIT_EVENT_SSL_OPEN_SERVER,
 	WAIT_EVENT_WAL_RECEIVER_WAIT_START,
 	WAIT_EVENT_WAL_SENDER_WAIT_WAL,
-	WAIT_EVENT_WAL_SENDER_WRITE_DATA
+	WAIT_EVENT_WAL_SENDER_WRITE_DATA,
+	WAIT_EVENT_REMOTE_NODE_READ,
+	WAIT_EVENT_REMOTE_COORDINATOR_READ,
+	WAIT_EVENT_REMOTE_DATANODE_READ,
+	WAIT_EVENT_POOLER_GET_CONNECTIONS,
+	WAIT_EVENT_GTM_BEGIN,
+	WAIT_EVENT_GTM_SNAPSHOT,
+	WAIT_EVENT_GTM_COMMIT,
+	WAIT_EVENT_GTM_ROLLBACK,
+	WAIT_EVENT_GTM_PREPARE,
+	WAIT_EVENT_GTM_START_PREPARED,
+	WAIT_EVENT_GTM_COMMIT_PREPARED
 } WaitEventClient;
 
 /* ----------
@@ -819,7 +832,12 @@ typedef enum
 	WAIT_EVENT_REPLICATION_ORIGIN_DROP,
 	WAIT_EVENT_REPLICATION_SLOT_DROP,
 	WAIT_EVENT_SAFE_SNAPSHOT,
-	WAIT_EVENT_SYNC_REP
+	WAIT_EVENT_SYNC_REP,
+	WAIT_EVENT_COMMIT_BATCHER,
+	WAIT_EVENT_SQUEUE_CONSUMER,
+	WAIT_EVENT_SQUEUE_PRODUCER,
+	WAIT_EVENT_SQUEUE_FINISH,
+	WAIT_EVENT_ADMISSION_CONTROL
 } WaitEventIPC;
 
 /* ----------
@@ -832,7 +850,8 @@ typedef enum
 {
 	WAIT_EVENT_BASE_BACKUP_THROTTLE = PG_WAIT_TIMEOUT,
 	WAIT_EVENT_PG_SLEEP,
-	WAIT_EVENT_RECOVERY_APPLY_DELAY
+	WAIT_EVENT_RECOVERY_APPLY_DELAY,
+	WAIT_EVENT_BARRIER_REPLAY
 } WaitEventTimeout;
 
 /* ----------
@@ -919,7 +938,8 @@ typedef enum
 typedef enum ProgressCommandType
 {
 	PROGRESS_COMMAND_INVALID,
-	PROGRESS_COMMAND_VACUUM
+	PROGRESS_COMMAND_VACUUM,
+	PROGRESS_COMMAND_CREATE_INDEX
 } ProgressCommandType;
 
 #define PGSTAT_NUM_PROGRESS_PARAM	10
@@ -0,0 +1,41 @@
+/*-------------------------------------------------------------------------
+ *
+ * admission.h
+ *
+ *		Admission control of distributed queries on a Coordinator
+ *
+ * Portions Copyright (c) 1996-2011, PostgreSQL Global Development Group
+ * Portions Copyright (c) 2010-2012 Postgres-XC Development Group
+ *
+ * src/include/pgxc/admission.h
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include "executor/execdesc.h"
+
+/* Priority classes of the queries waiting for admission */
+typedef enum
+{
+	ADMISSION_PRIORITY_LOW,
+	ADMISSION_PRIORITY_NORMAL,
+	ADMISSION_PRIORITY_HIGH
+} AdmissionPriority;
+
+/* GUC parameters */
+extern int	AdmissionMaxFragments;
+extern int	AdmissionMaxSharedQueues;
+extern int	AdmissionMaxMemory;
+extern int	AdmissionPriorityClass;
+
+extern Size AdmissionControlShmemSize(void);
+extern void AdmissionControlShmemInit(void);
+
+extern void AdmissionControlStart(QueryDesc *queryDesc, int eflags);
+extern void AdmissionControlEnd(QueryDesc *queryDesc);
+extern void AtEOXact_AdmissionControl(void);
+
+#endif   /* ADMISSION_H */
@@ -22,6 +22,7 @@
 #define CREATE_BARRIER_PREPARE	'P'
 #define CREATE_BARRIER_EXECUTE	'X'
 #define CREATE_BARRIER_END		'E'
+#define CREATE_BARRIER_FLUSH	'F'
 
 #define CREATE_BARRIER_PREPARE_DONE	'p'
 #define CREATE_BARRIER_EXECUTE_DONE	'x'
@@ -36,10 +37,21 @@ typedef struct xl_barrier
 extern void ProcessCreateBarrierPrepare(const char *id);
 extern void ProcessCreateBarrierEnd(const char *id);
 extern void ProcessCreateBarrierExecute(const char *id);
+extern void ProcessCreateBarrierFlush(const char *id);
+
+/* GUC parameters */
+extern char *StandbyReadBarrier;
+extern int	StandbyReadBarrierTimeout;
+extern bool DatanodeStandbyReads;
 
 extern void RequestBarrier(const char *id, char *completionTag);
 extern void barrier_redo(XLogReaderState *record);
 extern void barrier_desc(StringInfo buf, XLogReaderState *record);
 extern const char *barrier_identify(uint8 info);
 
+extern Size BarrierShmemSize(void);
+extern void BarrierShmemInit(void);
+extern bool BarrierGetLatest(char *barrier_id);
+extern void StandbyWaitForBarrier(void);
+
 #endif
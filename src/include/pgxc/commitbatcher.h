@@ -0,0 +1,34 @@
+/*-------------------------------------------------------------------------
+ *
+ * commitbatcher.h
+ *
+ *		Coordinator-side batching of COMMIT PREPARED commands
+ *
+ * Portions Copyright (c) 1996-2011, PostgreSQL Global Development Group
+ * Portions Copyright (c) 2010-2012 Postgres-XC Development Group
+ *
+ * src/include/pgxc/commitbatcher.h
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef COMMITBATCHER_H
+#define COMMITBATCHER_H
+
+#include "gtm/gtm_c.h"
+#include "nodes/pg_list.h"
+
+/* GUC parameters */
+extern int	MaxCommitBatchers;
+extern bool AsyncCommitPrepared;
+
+extern Size CommitBatcherShmemSize(void);
+extern void CommitBatcherShmemInit(void);
+
+extern bool CommitBatcherSubmit(const char *prepareGID, List *nodelist,
+					List *coordlist, GlobalTransactionId gxid, bool wait);
+extern void CommitBatcherWaitPending(void);
+
+extern void CommitBatcherMain(Datum main_arg);
+
+#endif   /* COMMITBATCHER_H */
@@ -0,0 +1,25 @@
+/*-------------------------------------------------------------------------
+ *
+ * distadvisor.h
+ *	  Statistics of the redistributions planned, by distribution column
+ *
+ *
+ * Portions Copyright (c) 1996-2017, PostgreSQL Global Development Group
+ * Portions Copyright (c) 2010-2012 Postgres-XC Development Group
+ *
+ * src/include/pgxc/distadvisor.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef DISTADVISOR_H
+#define DISTADVISOR_H
+
+#include "nodes/relation.h"
+
+extern Size DistAdvisorShmemSize(void);
+extern void DistAdvisorShmemInit(void);
+
+extern void DistAdvisorRecord(PlannerInfo *root, Node *distributionExpr,
+				  double rows, int width);
+
+#endif							/* DISTADVISOR_H */
@@ -26,6 +26,7 @@
 #endif
 #include "access/tupdesc.h"
 #include "executor/tuptable.h"
+#include "lib/ilist.h"
 #include "nodes/execnodes.h"
 #include "nodes/pg_list.h"
 #include "tcop/dest.h"
@@ -103,9 +104,16 @@ typedef struct ResponseCombiner
 	char	   *errorHint;				/* error hint to send back to client */
 	Oid			returning_node;			/* returning replicated node */
 	RemoteDataRow currentRow;			/* next data ro to be wrapped into a tuple */
-	/* TODO use a tuplestore as a rowbuffer */
-	List 	   *rowBuffer;				/* buffer where rows are stored when connection
-										 * should be cleaned for reuse by other RemoteQuery */
+	/*
+	 * Rows are buffered here when connection should be cleaned for reuse by
+	 * other RemoteQuery. There is a tuplestore per buffered node, so rows
+	 * of a tape can be found quickly when doing merge sort, and buffered
+	 * rows spill to disk if they do not fit in work_mem.
+	 */
+	int			rowBufferCount;			/* number of allocated row buffers */
+	int			rowBufferRows;			/* total number of buffered rows */
+	Oid		   *rowBufferNodes;			/* node of each row buffer */
+	Tuplestorestate **rowBuffers;		/* row buffers */
 	/*
 	 * To handle special case - if there is a simple sort and sort connection
 	 * is buffered. If EOF is reached on a connection it should be removed from
@@ -114,16 +122,16 @@ typedef struct ResponseCombiner
 	 * when buffering
 	 */
 	Oid 	   *tapenodes;
-	/*
-	 * If some tape (connection) is buffered, contains a reference on the cell
-	 * right before first row buffered from this tape, needed to speed up
-	 * access to the data
-	 */
-	ListCell  **tapemarks;
 	bool		merge_sort;             /* perform mergesort of node tuples */
 	bool		extended_query;         /* running extended query protocol */
 	bool		probing_primary;		/* trying replicated on primary node */
-	void	   *tuplesortstate;			/* for merge sort */
+	void	   *mergestate;				/* for merge sort */
+	int			fetch_size;				/* rows to request from a cursor */
+	int			fetch_size_initial;		/* fetch_size of the first request */
+	bool		fetch_is_bound;			/* fetch_size rows from any node are
+										 * all the rows we need */
+	uint64		fetch_rows;				/* rows received so far ... */
+	uint64		fetch_bytes;			/* ... and their total size */
 	/* COPY support */
 	RemoteCopyType remoteCopyType;
 	Tuplestorestate *tuplestorestate;
@@ -183,8 +191,38 @@ typedef struct RemoteSubplanState
 	bool 		execOnAll;
 	int			nParamRemote;	/* number of params sent from the master node */
 	RemoteParam *remoteparams;  /* parameter descriptors */
+	bytea	   *bloomFilter;	/* join keys filter set by the parent join */
+	bool		tuples_bounded;	/* parent Limit needs only tuples_needed */
+	int64		tuples_needed;
+	/* cache of the rows returned for each set of parameter values */
+	bool		memoize;		/* cache may be used */
+	MemoryContext memo_cxt;		/* holds the cache, NULL until first rescan */
+	struct remotememo_hash *memo_table;	/* entries by encoded parameter values */
+	dlist_head	memo_lru;		/* complete entries, least recently used first */
+	Size		memo_size;		/* memory used by the entries */
+	struct RemoteMemoEntry *memo_fill;		/* entry being filled, if any */
+	struct RemoteMemoEntry *memo_replay;	/* entry being returned, if any */
+	ListCell   *memo_next;		/* next row of memo_replay to return */
+	/* RemoteInstrumentation reported by the nodes under EXPLAIN ANALYZE */
+	List	   *remote_instr;
 } RemoteSubplanState;
 
+/*
+ * Execution statistics of the root of a plan fragment, as reported by the
+ * Datanode which ran it.
+ */
+typedef struct RemoteInstrumentation
+{
+	Oid			nodeoid;		/* node which ran the fragment */
+	double		startup;		/* total startup time, in seconds */
+	double		total;			/* total time, in seconds */
+	double		ntuples;		/* total tuples produced */
+	double		nloops;			/* number of run cycles */
+	BufferUsage bufusage;		/* buffer usage of the fragment */
+	int64		memory;			/* memory held by the query when the
+								 * fragment completed, in bytes */
+} RemoteInstrumentation;
+
 
 /*
  * Data needed to set up a PreparedStatement on the remote node and other data
@@ -222,9 +260,29 @@ typedef struct RemoteStmt
 	List	   *distributionNodes;
 
 	List	   *distributionRestrict;
+
+	List	   *skewValues;
+
+	Oid			skewEqfunc;
+
+	Oid			skewCollation;
+
+	bool		skewBroadcast;
+
+	bool		hasBloomParam;	/* last remote param is the Bloom filter */
+
+	bool		parallelModeNeeded; /* fragment contains Gather nodes */
+
+	int			instrumentOptions;	/* OR of InstrumentOption flags, set if
+									 * the fragment runs under EXPLAIN ANALYZE */
+
+	uint32		queryId;		/* query identifier of the Coordinator query */
 } RemoteStmt;
 
 extern int PGXLRemoteFetchSize;
+extern int PGXLRemoteBatchSize;
+extern bool PGXLRemotePipeline;
+extern int RemoteSubplanDigestMinSize;
 
 typedef void (*xact_callback) (bool isCommit, void *args);
 
@@ -237,6 +295,7 @@ extern uint64 DataNodeCopyOut(PGXCNodeHandle** copy_connections,
 							  int conn_count, FILE* copy_file);
 extern uint64 DataNodeCopyStore(PGXCNodeHandle** copy_connections,
 								int conn_count, Tuplestorestate* store);
+extern uint64 DataNodeCopyToFiles(List *nodelist, List *queries);
 extern void DataNodeCopyFinish(int conn_count, PGXCNodeHandle** connections);
 extern int DataNodeCopyInBinaryForAll(char *msg_buf, int len, int conn_count,
 									  PGXCNodeHandle** connections);
@@ -287,6 +346,21 @@ extern bool	PreAbort_Remote(void);
 extern void AtEOXact_Remote(void);
 extern bool IsTwoPhaseCommitRequired(bool localWrite);
 extern bool FinishRemotePreparedTransaction(char *prepareGID, bool commit);
+
+/*
+ * COMMIT PREPARED of one transaction, as requested from the commit batcher.
+ * Node lists contain node indexes, errmsg is set if the command has failed.
+ */
+typedef struct RemoteCommitPrepared
+{
+	char	   *gid;
+	GlobalTransactionId gxid;
+	List	   *nodelist;
+	List	   *coordlist;
+	char	   *errmsg;
+} RemoteCommitPrepared;
+
+extern void RemoteCommitPreparedBatch(RemoteCommitPrepared *items, int count);
 extern char *GetImplicit2PCGID(const char *implicit2PC_head, bool localWrite);
 
 extern void pgxc_all_success_nodes(ExecNodes **d_nodes, ExecNodes **c_nodes, char **failednodes_msg);
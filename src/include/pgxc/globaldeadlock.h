@@ -0,0 +1,38 @@
+/*-------------------------------------------------------------------------
+ *
+ * globaldeadlock.h
+ *
+ *		Detection of deadlocks spanning multiple nodes
+ *
+ * Portions Copyright (c) 1996-2011, PostgreSQL Global Development Group
+ * Portions Copyright (c) 2010-2012 Postgres-XC Development Group
+ *
+ * src/include/pgxc/globaldeadlock.h
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef GLOBALDEADLOCK_H
+#define GLOBALDEADLOCK_H
+
+/* GUC parameters */
+extern int	GlobalDeadlockCheckInterval;
+
+/*
+ * Edge of the wait-for graph. Both ends are distributed sessions identified
+ * by the name of their Coordinator and the pid of the session there.
+ */
+typedef struct GlobalWaitEdge
+{
+	NameData	waiter_node;
+	int			waiter_pid;
+	NameData	holder_node;
+	int			holder_pid;
+} GlobalWaitEdge;
+
+extern GlobalWaitEdge *GetLocalWaitEdges(int *nedges);
+
+extern void GlobalDeadlockDetectorRegister(void);
+extern void GlobalDeadlockDetectorMain(Datum main_arg);
+
+#endif   /* GLOBALDEADLOCK_H */
@@ -21,6 +21,7 @@
 #define LOCATOR_TYPE_RROBIN 'N'
 #define LOCATOR_TYPE_CUSTOM 'C'
 #define LOCATOR_TYPE_MODULO 'M'
+#define LOCATOR_TYPE_BUCKET 'B'
 #define LOCATOR_TYPE_NONE 'O'
 #define LOCATOR_TYPE_DISTRIBUTED 'D'	/* for distributed table without specific
 										 * scheme, e.g. result of JOIN of
@@ -37,9 +38,11 @@
 #define IsLocatorColumnDistributed(x) (x == LOCATOR_TYPE_HASH || \
 									   x == LOCATOR_TYPE_RROBIN || \
 									   x == LOCATOR_TYPE_MODULO || \
+									   x == LOCATOR_TYPE_BUCKET || \
 									   x == LOCATOR_TYPE_DISTRIBUTED)
 #define IsLocatorDistributedByValue(x) (x == LOCATOR_TYPE_HASH || \
 										x == LOCATOR_TYPE_MODULO || \
+										x == LOCATOR_TYPE_BUCKET || \
 										x == LOCATOR_TYPE_RANGE)
 
 #include "nodes/primnodes.h"
@@ -141,8 +144,15 @@ extern Locator *createLocator(char locatorType, RelationAccessType accessType,
 			  Oid dataType, LocatorListType listType, int nodeCount,
 			  void *nodeList, void **result, bool primary);
 extern void freeLocator(Locator *locator);
+extern void setLocatorSkew(Locator *self, List *skewValues, Oid eqfunc,
+			   Oid collation, bool broadcast);
+extern void setLocatorBucketNodes(Locator *self, List *nodeList);
+extern void GetBucketMap(int nnodes, const uint32 *nodekeys, int *map);
 
 extern int GET_NODES(Locator *self, Datum value, bool isnull, bool *hasprimary);
+extern bool canLocateBatch(Locator *self);
+extern void GET_NODES_BATCH(Locator *self, int nvalues, Datum *values,
+				bool *nulls, int *indexes);
 extern void *getLocatorResults(Locator *self);
 extern void *getLocatorNodeMap(Locator *self);
 extern int getLocatorNodeCount(Locator *self);
@@ -174,6 +184,7 @@ extern ExecNodes *GetRelationNodesByQuals(Oid reloid,
 										  RelationAccessType relaccess);
 
 extern bool IsTypeHashDistributable(Oid col_type);
+extern uint32 DistribKeyHash(Oid col_type, Datum value);
 extern List *GetAllDataNodes(void);
 extern List *GetAllCoordNodes(void);
 extern int GetAnyDataNode(Bitmapset *nodes);
@@ -181,6 +192,7 @@ extern void RelationBuildLocator(Relation rel);
 extern void FreeRelationLocInfo(RelationLocInfo *relationLocInfo);
 
 extern bool IsTypeModuloDistributable(Oid col_type);
+extern bool IsDistColumnTypeColocated(char locatorType, Oid type1, Oid type2);
 extern char *GetRelationModuloColumn(RelationLocInfo *rel_loc_info);
 extern char *GetRelationDistColumn(RelationLocInfo *rel_loc_info);
 extern bool IsDistColumnForRelId(Oid relid, char *part_col_name);
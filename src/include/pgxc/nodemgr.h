@@ -33,25 +33,39 @@ extern int 	NumCoords;
 typedef struct
 {
 	Oid 		nodeoid;
+	int32		nodeid;			/* pgxc_node.node_id */
 	NameData	nodename;
 	NameData	nodehost;
+	NameData	nodezone;
 	int			nodeport;
 	bool		nodeisprimary;
 	bool 		nodeispreferred;
 	bool		nodeishealthy;
+	int			nodeactive;		/* connections in use, as seen by pooler */
+	int			nodelatency;	/* average connect latency (microseconds) */
 } NodeDefinition;
 
 extern void NodeTablesShmemInit(void);
 extern Size NodeTablesShmemSize(void);
 
 extern void PgxcNodeListAndCount(void);
+extern void PgxcNodeEnsureLoaded(void);
 extern void PgxcNodeGetOids(Oid **coOids, Oid **dnOids,
 							int *num_coords, int *num_dns,
 							bool update_preferred);
+extern void PgxcNodeGetDefinitions(NodeDefinition **coNodes,
+							NodeDefinition **dnNodes,
+							int *num_coords, int *num_dns,
+							bool update_preferred);
 extern void PgxcNodeGetHealthMap(Oid *coOids, Oid *dnOids,
 				int *num_coords, int *num_dns, bool *coHealthMap,
 				bool *dnHealthMap);
 extern NodeDefinition *PgxcNodeGetDefinition(Oid node);
+extern void PgxcNodeUpdateLoad(Oid node, int active, int latency);
+extern void PgxcNodeDnListLoad(List *nodeList, bool *healthmap,
+				int *activemap, int *latencymap);
+extern double PgxcNodeCrossZoneFraction(Oid *senders, int nsenders,
+						  Oid *receivers, int nreceivers);
 extern void PgxcNodeAlter(AlterNodeStmt *stmt);
 extern void PgxcNodeCreate(CreateNodeStmt *stmt);
 extern void PgxcNodeRemove(DropNodeStmt *stmt);
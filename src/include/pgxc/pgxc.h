@@ -36,12 +36,19 @@ typedef enum
 
 /* Determine remote connection type for a PGXC backend */
 extern int		remoteConnType;
+extern bool		remoteCompression;
 
 /* Local node name and numer */
 extern char	*PGXCNodeName;
 extern int	PGXCNodeId;
 extern uint32	PGXCNodeIdentifier;
 
+/*
+ * Query identifier the Coordinator sent down for the statements of the
+ * current message, or 0. See pgxc_node_send_query_id.
+ */
+extern uint32	PGXCRemoteQueryId;
+
 extern Datum xc_lockForBackupKey1;
 extern Datum xc_lockForBackupKey2;
 
@@ -83,6 +83,14 @@ struct pgxc_node_handle
 	size_t		inStart;
 	size_t		inEnd;
 	size_t		inCursor;
+	/*
+	 * Compressed stream buffers, if network_compression is on: frames
+	 * received but not yet decompressed into inBuffer, and outgoing frame
+	 */
+	bool		compressed;
+	char	   *zInBuffer;
+	size_t		zInEnd;
+	char	   *zOutBuffer;
 	/*
 	 * Have a variable to enable/disable response checking and
 	 * if enable then read the result of response checking
@@ -93,6 +101,16 @@ struct pgxc_node_handle
 
 	bool		in_extended_query;
 	bool		needSync;
+	/*
+	 * Number of Sync messages sent down without waiting for ReadyForQuery.
+	 * These ReadyForQuery messages are consumed by get_message().
+	 */
+	int			pendingSyncs;
+	/*
+	 * Number of session setup queries sent down ahead of the first command
+	 * on the connection. Their responses are skipped by get_message().
+	 */
+	int			pendingSetup;
 };
 typedef struct pgxc_node_handle PGXCNodeHandle;
 
@@ -106,6 +124,10 @@ typedef struct
 	PGXCNodeHandle	  **coord_handles;	/* an array of Coordinator handles */
 } PGXCNodeAllHandles;
 
+/* Protocol bytes sent to and received from other nodes by this backend */
+extern uint64 PGXCNodeBytesSent;
+extern uint64 PGXCNodeBytesReceived;
+
 extern void InitMultinodeExecutor(bool is_force);
 
 /* Open/close connection routines (invoked from Pool Manager) */
@@ -123,6 +145,9 @@ extern PGXCNodeAllHandles *get_current_handles(void);
 extern void pfree_pgxc_all_handles(PGXCNodeAllHandles *handles);
 
 extern void release_handles(void);
+extern bool hold_handles(void);
+extern bool HandlesHeld(void);
+extern void HeldHandlesTimeoutHandler(void);
 
 extern int get_transaction_nodes(PGXCNodeHandle ** connections,
 								  char client_conn_type,
@@ -154,9 +179,11 @@ extern int	pgxc_node_send_query_extended(PGXCNodeHandle *handle, const char *que
 							  bool send_describe, int fetch_size);
 extern int  pgxc_node_send_plan(PGXCNodeHandle * handle, const char *statement,
 					const char *query, const char *planstr,
+					const uint8 *digest,
 					short num_params, Oid *param_types);
 extern int	pgxc_node_send_gxid(PGXCNodeHandle * handle, GlobalTransactionId gxid);
 extern int	pgxc_node_send_cmd_id(PGXCNodeHandle *handle, CommandId cid);
+extern int	pgxc_node_send_query_id(PGXCNodeHandle *handle, uint32 queryId);
 extern int	pgxc_node_send_snapshot(PGXCNodeHandle * handle, Snapshot snapshot);
 extern int	pgxc_node_send_timestamp(PGXCNodeHandle * handle, TimestampTz timestamp);
 
@@ -179,8 +206,12 @@ extern void PGXCNodeResetParams(bool only_local);
 extern char *PGXCNodeGetSessionParamStr(void);
 extern char *PGXCNodeGetTransactionParamStr(void);
 extern void pgxc_node_set_query(PGXCNodeHandle *handle, const char *set_query);
+extern void pgxc_node_set_query_multi(int count, PGXCNodeHandle **handles,
+						  const char *set_query);
+extern void pgxc_node_wait_syncs(PGXCNodeHandle *handle);
 extern void RequestInvalidateRemoteHandles(void);
 extern void RequestRefreshRemoteHandles(void);
+extern void RequestReleaseRemoteHandles(void);
 extern bool PoolerMessagesPending(void);
 extern void PGXCNodeSetConnectionState(PGXCNodeHandle *handle,
 		DNConnectionState new_state);
@@ -146,8 +146,31 @@ typedef struct
 	AttrNumber	distributionKey;
 	List 	   *distributionNodes;
 	List 	   *distributionRestrict;
+	List	   *skewValues;		/* hot distribution key values, see Distribution */
+	Oid			skewEqfunc;
+	Oid			skewCollation;
+	bool		skewBroadcast;
 	List 	   *nodeList;
 	bool 		execOnAll;
+	/*
+	 * If set, the subplan is executed only on the nodes of execNodesMap the
+	 * value of execNodesExpr is located to, according to execNodesType.
+	 */
+	Node	   *execNodesExpr;
+	char		execNodesType;
+	List	   *execNodesMap;
+	/*
+	 * If nonzero, the parent is a Hash Join, and its hash clause of this
+	 * number compares the distribution key to the inner side. The join then
+	 * sends down the Bloom filter of its inner keys, so the rows which can
+	 * not find a match are not sent over.
+	 */
+	int			bloomKeyNo;
+	/*
+	 * If set, the executor may cache the rows returned for each set of
+	 * parameter values and answer repeated rescans from that cache.
+	 */
+	bool		memoize;
 	SimpleSort *sort;
 	char	   *cursor;
 	int			unique;
@@ -188,6 +211,8 @@ extern List *AddRemoteQueryNode(List *stmts, const char *queryString,
 extern PlannedStmt *pgxc_planner(Query *query, int cursorOptions,
 		                                 ParamListInfo boundParams);
 extern ExecNodes *pgxc_is_query_shippable(Query *query, int query_level);
+extern ExecNodes *pgxc_query_shippability(Query *query, int query_level,
+						bool *shape_unshippable);
 
 
 #endif   /* PGXCPLANNER_H */
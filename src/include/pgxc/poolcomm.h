@@ -42,8 +42,10 @@ extern int	pool_getbytes(PoolPort *port, char *s, size_t len);
 extern int	pool_putmessage(PoolPort *port, char msgtype, const char *s, size_t len);
 extern int	pool_putbytes(PoolPort *port, const char *s, size_t len);
 extern int	pool_flush(PoolPort *port);
-extern int	pool_sendfds(PoolPort *port, int *fds, int count);
-extern int	pool_recvfds(PoolPort *port, int *fds, int count);
+extern int	pool_sendconns(PoolPort *port, int *fds, int *pids, int *states,
+						   int count);
+extern int	pool_recvconns(PoolPort *port, int *fds, int *pids, int *states,
+						   int count);
 extern int	pool_sendres(PoolPort *port, int res);
 extern int	pool_recvres(PoolPort *port);
 extern int	pool_sendpids(PoolPort *port, int *pids, int count);
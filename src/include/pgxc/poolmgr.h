@@ -32,6 +32,7 @@
 #include "storage/pmsignal.h"
 #include "utils/guc.h"
 #include "utils/hsearch.h"
+#include "utils/timestamp.h"
 
 #define MAX_IDLE_TIME 60
 
@@ -52,6 +53,11 @@ typedef struct
 	time_t		released;
 	NODE_CONNECTION *conn;
 	NODE_CANCEL	*xc_cancelConn;
+	uint32		session_owner;		/* agent whose session state is set up
+									 * on the connection, 0 if none */
+	int			session_version;	/* version of that session state */
+	uint32		session_fingerprint;	/* fingerprint of the session
+										 * parameters set up, 0 if none */
 } PGXCNodePoolSlot;
 
 /*
@@ -108,6 +114,8 @@ typedef struct
 {
 	/* Process ID of postmaster child process associated to pool agent */
 	int				pid;
+	/* unique identifier of the agent, used to tag the session state */
+	uint32			serial;
 	/* communication channel */
 	PoolPort		port;
 	DatabasePool   *pool;
@@ -125,9 +133,13 @@ typedef struct
  */
 extern int	PoolConnKeepAlive;
 extern int	PoolMaintenanceTimeout;
+extern int	PoolConnectTimeout;
 extern int	MaxPoolSize;
+extern int	MinPoolSize;
 extern int	PoolerPort;
 extern bool PersistentConnections;
+extern int	SessionConnectionHoldTime;
+extern bool NetworkCompression;
 
 /* Status inquiry functions */
 extern void PGXCPoolerProcessIam(void);
@@ -146,9 +158,26 @@ extern void PoolManagerDisconnect(void);
  */
 extern char *session_options(void);
 
+/*
+ * Session state of a pooled connection, as reported by
+ * PoolManagerGetConnections for each connection.
+ *
+ * Connections are not reset when returned to the pool. They keep the
+ * session parameters of the last session using them, until the next
+ * session picks them up and either finds its own parameters still in
+ * place, finds the same parameters set up by another session, or has to
+ * reset the connection first.
+ */
+#define POOL_SESSION_CURRENT	0	/* set up for the requesting session */
+#define POOL_SESSION_CLEAN		1	/* default session state */
+#define POOL_SESSION_DIRTY		2	/* set up for some other session */
+#define POOL_SESSION_MATCHING	3	/* set up for some other session with
+									 * the same session parameters */
+
 /* Get pooled connections to specified nodes */
 extern int *PoolManagerGetConnections(List *datanodelist, List *coordlist,
-		int **pids);
+		int session_version, uint32 session_fingerprint,
+		int **pids, int **states);
 
 /* Clean connections for the specified nodes (for dbname/user). */
 extern void PoolManagerCleanConnection(List *datanodelist, List *coordlist,
@@ -180,4 +209,34 @@ extern void PoolPingNodes(void);
 extern bool check_persistent_connections(bool *newval, void **extra,
 		GucSource source);
 
+/*
+ * Pooler statistics for one remote node, maintained by the pooler process
+ * in shared memory and exposed by the pg_stat_pooler view.
+ *
+ * The wait histogram counts the connection requests including the node by
+ * the time the pooler took to serve them, the bucket upper bounds (in
+ * microseconds) are in PoolWaitBucketBounds, the last bucket is unbounded.
+ */
+#define POOL_WAIT_BUCKETS	8
+
+typedef struct
+{
+	Oid			nodeoid;			/* InvalidOid if the entry is not used */
+	int64		requests;			/* connections requested by sessions */
+	int64		misses;				/* requests finding no idle connection */
+	int64		connects;			/* new connections opened */
+	int64		connect_failures;	/* failed attempts to open a connection */
+	int64		exhausted;			/* times the pool reached max_pool_size */
+	int64		closed;				/* idle connections closed */
+	int64		wait_time;			/* total wait of the requests, in
+									 * microseconds */
+	int64		wait_hist[POOL_WAIT_BUCKETS];
+} PoolerNodeStats;
+
+extern const int PoolWaitBucketBounds[POOL_WAIT_BUCKETS - 1];
+
+extern Size PoolerShmemSize(void);
+extern void PoolerShmemInit(void);
+extern int	PoolerGetStats(PoolerNodeStats **stats, TimestampTz *stats_reset);
+
 #endif
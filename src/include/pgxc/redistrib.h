@@ -26,6 +26,9 @@ typedef enum RedistribOperation {
 	DISTRIB_NONE,		/* Default operation */
 	DISTRIB_DELETE_HASH,	/* Perform a DELETE with hash value check */
 	DISTRIB_DELETE_MODULO,	/* Perform a DELETE with modulo value check */
+	DISTRIB_DELETE_BUCKET,	/* Perform a DELETE of the buckets moved away */
+	DISTRIB_STAGE_OUT,	/* Move data to a staging table of new distribution */
+	DISTRIB_STAGE_IN,	/* Move data back from the staging table */
 	DISTRIB_COPY_TO,	/* Perform a COPY TO */
 	DISTRIB_COPY_FROM,	/* Perform a COPY FROM */
 	DISTRIB_TRUNCATE,	/* Truncate relation */
@@ -65,6 +68,10 @@ typedef struct RedistribState {
 	Oid			relid;			/* Oid of relation redistributed */
 	List	   *commands;		/* List of commands */
 	Tuplestorestate *store;		/* Tuple store used for temporary data storage */
+	char	   *bucketQual;		/* If set, only the rows matching this qual
+								 * are moved, see pgxc_redist_build_bucket */
+	char	   *stagingName;	/* Staging table and its distribution, see */
+	char	   *stagingDistrib;	/* pgxc_redist_build_staging */
 } RedistribState;
 
 extern void PGXCRedistribTable(RedistribState *distribState, RedistribCatalog type);
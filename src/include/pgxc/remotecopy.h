@@ -50,6 +50,7 @@ typedef struct RemoteCopyData {
 typedef struct RemoteCopyOptions {
 	bool		rco_binary;			/* binary format? */
 	bool		rco_oids;			/* include OIDs? */
+	bool		rco_freeze;			/* freeze rows on loading? */
 	bool		rco_csv_mode;		/* Comma Separated Value format? */
 	char	   *rco_delim;			/* column delimiter (must be 1 byte) */
 	char	   *rco_null_print;		/* NULL marker string (server encoding!) */
@@ -57,6 +58,7 @@ typedef struct RemoteCopyOptions {
 	char	   *rco_escape;			/* CSV escape char (must be 1 byte) */
 	List	   *rco_force_quote;	/* list of column names */
 	List	   *rco_force_notnull;	/* list of column names */
+	char	   *rco_target;			/* COPY TO destination, NULL for STDOUT */
 } RemoteCopyOptions;
 
 extern void RemoteCopy_BuildStatement(RemoteCopyData *state,
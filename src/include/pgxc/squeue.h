@@ -23,6 +23,8 @@
 
 extern PGDLLIMPORT int NSQueues;
 extern PGDLLIMPORT int SQueueSize;
+extern PGDLLIMPORT bool SQueueSpill;
+extern PGDLLIMPORT bool SQueueDynamic;
 
 /* Fixed size of shared queue, maybe need to be GUC configurable */
 #define SQUEUE_SIZE ((long) SQueueSize * MaxDataNodes * 1024L)
@@ -34,11 +36,19 @@ extern PGDLLIMPORT int SQueueSize;
 #define SQ_CONS_SELF -1
 #define SQ_CONS_NONE -2
 
+/*
+ * Size of the Bloom filter of join keys a consumer may give to the producer,
+ * and the number of keys it is good for, with about 15% false positives.
+ */
+#define SQUEUE_FILTER_SIZE	1024
+#define SQUEUE_FILTER_KEYS	2048
+
 typedef struct SQueueHeader *SharedQueue;
 
 extern Size SharedQueueShmemSize(void);
 extern void SharedQueuesInit(void);
-extern void SharedQueueAcquire(const char *sqname, int ncons);
+extern void SharedQueueAcquire(const char *sqname, int ncons, double rows,
+				   int width);
 extern SharedQueue SharedQueueBind(const char *sqname, List *consNodes,
 				List *distNodes, int *myindex, int *consMap);
 extern void SharedQueueUnBind(SharedQueue squeue, bool failed);
@@ -58,5 +68,10 @@ extern void SharedQueueReset(SharedQueue squeue, int consumerIdx);
 extern void SharedQueueResetNotConnected(SharedQueue squeue);
 extern bool SharedQueueCanPause(SharedQueue squeue);
 extern bool SharedQueueWaitOnProducerLatch(SharedQueue squeue, long timeout);
+extern void SharedQueueSetFilter(SharedQueue squeue, int consumerIdx,
+					 const char *filter);
+extern const char *SharedQueueGetFilter(SharedQueue squeue, int consumerIdx);
+extern void SharedQueueFilterAdd(char *filter, uint32 hash);
+extern bool SharedQueueFilterTest(const char *filter, uint32 hash);
 
 #endif
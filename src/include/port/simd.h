@@ -0,0 +1,118 @@
+/*-------------------------------------------------------------------------
+ *
+ * simd.h
+ *	  Support for platform-specific vector operations.
+ *
+ * A Vector8 holds a block of bytes that is tested as a whole, so that loops
+ * looking for a few special byte values can skip over the regions without
+ * any of them many bytes at a time.  SSE2 is part of the x86-64 baseline,
+ * and Neon of the AArch64 one, so neither needs a runtime check.  On other
+ * platforms the same operations work on a uint64, using the usual bit
+ * tricks.
+ *
+ * Portions Copyright (c) 1996-2017, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/port/simd.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SIMD_H
+#define SIMD_H
+
+#if (defined(__x86_64__) || defined(_M_AMD64))
+/*
+ * SSE2 instructions are part of the spec for the 64-bit x86 ISA. We assume
+ * that compilers targeting this architecture understand SSE2 intrinsics.
+ */
+#include <emmintrin.h>
+#define USE_SSE2
+typedef __m128i Vector8;
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+/*
+ * We use the Neon instructions if the compiler provides access to them (as
+ * indicated by __ARM_NEON).  As with SSE2 on x86-64, they are part of the
+ * baseline of the 64-bit architecture.
+ */
+#include <arm_neon.h>
+#define USE_NEON
+typedef uint8x16_t Vector8;
+
+#else
+/*
+ * If no SIMD instructions are available, we can in some cases emulate vector
+ * operations using bitwise operations on unsigned integers.
+ */
+#define USE_NO_SIMD
+typedef uint64 Vector8;
+#endif
+
+/*
+ * Load a chunk of memory into the given vector.  The memory need not be
+ * aligned.
+ */
+static inline void
+vector8_load(Vector8 *v, const uint8 *s)
+{
+#if defined(USE_SSE2)
+	*v = _mm_loadu_si128((const __m128i *) s);
+#elif defined(USE_NEON)
+	*v = vld1q_u8(s);
+#else
+	memcpy(v, s, sizeof(Vector8));
+#endif
+}
+
+/*
+ * Create a vector with all elements set to the same value.
+ */
+static inline Vector8
+vector8_broadcast(const uint8 c)
+{
+#if defined(USE_SSE2)
+	return _mm_set1_epi8(c);
+#elif defined(USE_NEON)
+	return vdupq_n_u8(c);
+#else
+	return ~UINT64CONST(0) / 0xFF * c;
+#endif
+}
+
+/*
+ * Return true if the high bit of any element is set.
+ */
+static inline bool
+vector8_is_highbit_set(const Vector8 v)
+{
+#if defined(USE_SSE2)
+	return _mm_movemask_epi8(v) != 0;
+#elif defined(USE_NEON)
+	return vmaxvq_u8(v) > 0x7F;
+#else
+	return v & vector8_broadcast(0x80);
+#endif
+}
+
+/*
+ * Return true if any elements in the vector are equal to the given scalar.
+ */
+static inline bool
+vector8_has(const Vector8 v, const uint8 c)
+{
+#if defined(USE_SSE2)
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(v, vector8_broadcast(c))) != 0;
+#elif defined(USE_NEON)
+	return vmaxvq_u8(vceqq_u8(v, vector8_broadcast(c))) != 0;
+#else
+	uint64		x = v ^ vector8_broadcast(c);
+
+	/*
+	 * A byte of x is zero iff the corresponding byte of v equals c.  The well
+	 * known "haszero" expression is nonzero iff some byte of x is zero.
+	 */
+	return ((x - vector8_broadcast(0x01)) & ~x & vector8_broadcast(0x80)) != 0;
+#endif
+}
+
+#endif							/* SIMD_H */
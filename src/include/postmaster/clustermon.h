@@ -18,6 +18,7 @@
 
 #include "storage/s_lock.h"
 #include "gtm/gtm_c.h"
+#include "datatype/timestamp.h"
 
 typedef struct
 {
@@ -27,6 +28,30 @@ typedef struct
 	GlobalTransactionId	gtm_recent_global_xmin;
 } ClusterMonitorCtlData;
 
+/* node_type of the health samples of GTM */
+#define CLUSTER_HEALTH_GTM		'G'
+
+/*
+ * Health sample of a node, or of GTM, taken by the cluster monitor. The
+ * samples of the local node carry its replication lag, those of the other
+ * nodes the ping round trip and the connections the pooler has in use.
+ */
+typedef struct ClusterHealthSample
+{
+	TimestampTz	sample_time;
+	Oid			nodeoid;			/* InvalidOid for GTM */
+	char		node_type;			/* PGXC_NODE_* or CLUSTER_HEALTH_GTM */
+	bool		reachable;
+	int			rtt;				/* round trip, usec, -1 if not pinged */
+	int			pool_active;		/* -1 if not known */
+	TimeOffset	replication_lag;	/* usec, -1 if not known */
+} ClusterHealthSample;
+
+/* GUC parameters */
+extern int	ClusterMonitorNaptime;
+extern int	ClusterMonitorXminThreshold;
+extern int	ClusterMonitorHealthInterval;
+
 extern void ClusterMonitorShmemInit(void);
 extern Size ClusterMonitorShmemSize(void);
 
@@ -39,6 +64,8 @@ extern int	StartClusterMonitor(void);
 extern GlobalTransactionId ClusterMonitorGetGlobalXmin(void);
 extern void ClusterMonitorSetGlobalXmin(GlobalTransactionId xmin);
 extern GlobalTransactionId ClusterMonitorGetReportingGlobalXmin(void);
+extern int	ClusterMonitorGetHealth(ClusterHealthSample **samples);
+extern bool ClusterMonitorGetNodeHealth(Oid nodeoid, int *rtt);
 
 #ifdef EXEC_BACKEND
 extern void ClusterMonitorIAm(void);
@@ -59,6 +59,7 @@ extern int	bgwriter_lru_maxpages;
 extern double bgwriter_lru_multiplier;
 extern bool track_io_timing;
 extern int	target_prefetch_pages;
+extern int	seqscan_prefetch_pages;
 
 extern int	checkpoint_flush_after;
 extern int	backend_flush_after;
@@ -131,12 +131,26 @@ do { \
 	(checksum) = __tmp * FNV_PRIME ^ (__tmp >> 17); \
 } while (0)
 
+/*
+ * If configure found that the compiler supports the target attribute for
+ * AVX2 and AVX-512 and __builtin_cpu_supports, the block checksum is compiled
+ * also for those, where the 32 parallel sums fit in four or two vector
+ * registers, and every call picks the variant the CPU supports.  The source is
+ * the same for all of them, only the instructions the compiler may use differ,
+ * so they give the same result.
+ */
+#ifdef USE_AVX_CHECKSUM_WITH_RUNTIME_CHECK
+#define CHECKSUM_BLOCK_INLINE static inline __attribute__((always_inline))
+#else
+#define CHECKSUM_BLOCK_INLINE static inline
+#endif
+
 /*
  * Block checksum algorithm.  The data argument must be aligned on a 4-byte
  * boundary.
  */
-static uint32
-pg_checksum_block(char *data, uint32 size)
+CHECKSUM_BLOCK_INLINE uint32
+pg_checksum_block_internal(char *data, uint32 size)
 {
 	uint32		sums[N_SUMS];
 	uint32		(*dataArr)[N_SUMS] = (uint32 (*)[N_SUMS]) data;
@@ -167,6 +181,37 @@ pg_checksum_block(char *data, uint32 size)
 	return result;
 }
 
+#ifdef USE_AVX_CHECKSUM_WITH_RUNTIME_CHECK
+static uint32 __attribute__((target("avx512f")))
+pg_checksum_block_avx512(char *data, uint32 size)
+{
+	return pg_checksum_block_internal(data, size);
+}
+
+static uint32 __attribute__((target("avx2")))
+pg_checksum_block_avx2(char *data, uint32 size)
+{
+	return pg_checksum_block_internal(data, size);
+}
+
+/*
+ * The CPU check only reads what libgcc found out on startup, so it is cheap
+ * next to checksumming a page, and this header needs no state of its own.
+ */
+static uint32
+pg_checksum_block(char *data, uint32 size)
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return pg_checksum_block_avx512(data, size);
+	if (__builtin_cpu_supports("avx2"))
+		return pg_checksum_block_avx2(data, size);
+	return pg_checksum_block_internal(data, size);
+}
+#else
+#define pg_checksum_block(data, size) pg_checksum_block_internal(data, size)
+#endif
+
 /*
  * Compute the checksum for a Postgres page.  The page must be aligned on a
  * 4-byte boundary.
@@ -110,6 +110,7 @@
 typedef struct Latch
 {
 	sig_atomic_t is_set;
+	sig_atomic_t maybe_sleeping;	/* owner may be blocked in a wait */
 	bool		is_shared;
 	int			owner_pid;
 #ifdef WIN32
@@ -36,6 +36,8 @@ typedef struct PROC_QUEUE
 /* GUC variables */
 extern int	max_locks_per_xact;
 
+extern uint64 LockWaitCount;
+
 #ifdef LOCK_DEBUG
 extern int	Trace_lock_oidmin;
 extern bool Trace_locks;
@@ -110,8 +110,14 @@ extern PGDLLIMPORT int NamedLWLockTrancheRequests;
  * having this file include lock.h or bufmgr.h would be backwards.
  */
 
-/* Number of partitions of the shared buffer mapping hashtable */
-#define NUM_BUFFER_PARTITIONS  128
+/*
+ * Number of partitions of the shared buffer mapping hashtable.  Every buffer
+ * lookup takes one of these in shared mode, so with many CPUs the cache line
+ * of a busy partition lock is contended; more partitions spread that out.
+ * Nothing takes all of them at once, so this is not bound by
+ * MAX_SIMUL_LWLOCKS.
+ */
+#define NUM_BUFFER_PARTITIONS  512
 
 /* Number of partitions the shared lock tables are divided into */
 #define LOG2_NUM_LOCK_PARTITIONS  4
@@ -215,6 +221,7 @@ typedef enum BuiltinTrancheIds
 	LWTRANCHE_SHARED_QUEUES,
 	LWTRANCHE_PARALLEL_QUERY_DSA,
 	LWTRANCHE_TBM,
+	LWTRANCHE_SHARED_SUBPLAN_STORE,
 	LWTRANCHE_FIRST_USER_DEFINED
 }			BuiltinTrancheIds;
 
@@ -41,8 +41,9 @@ typedef struct PGShmemHeader	/* standard header for all Postgres shmem */
 #endif
 } PGShmemHeader;
 
-/* GUC variable */
+/* GUC variables */
 extern int	huge_pages;
+extern bool shared_memory_interleave;
 
 /* Possible values for huge_pages */
 typedef enum
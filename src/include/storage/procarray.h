@@ -73,6 +73,9 @@ extern void ProcArrayRemove(PGPROC *proc, TransactionId latestXid);
 
 extern void ProcArrayEndTransaction(PGPROC *proc, TransactionId latestXid);
 extern void ProcArrayClearTransaction(PGPROC *proc);
+#ifdef PGXC
+extern void ProcArrayNoteAssignedXid(TransactionId xid);
+#endif
 
 #ifdef PGXC  /* PGXC_DATANODE */
 typedef enum
@@ -84,9 +87,11 @@ typedef enum
 } SnapshotSource;
 
 extern void SetGlobalSnapshotData(TransactionId xmin, TransactionId xmax, int xcnt,
-		TransactionId *xip,
+		TransactionId *xip, TransactionId global_xmin,
 		SnapshotSource source);
 extern void UnsetGlobalSnapshotData(void);
+extern int	snapshot_max_staleness;
+extern bool GetStaleGlobalSnapshot(Snapshot snapshot);
 extern void ReloadConnInfoOnBackends(bool refresh_only);
 #endif /* PGXC */
 extern void ProcArrayInitRecovery(TransactionId initializedUptoXID);
@@ -44,6 +44,7 @@ typedef enum
 #ifdef PGXC
 	PROCSIG_PGXCPOOL_RELOAD,	/* abort current transaction and reconnect to pooler */
 	PROCSIG_PGXCPOOL_REFRESH,	/* refresh local view of connection handles */
+	PROCSIG_PGXCPOOL_RELEASE,	/* give back the connections held when idle */
 #endif
 	PROCSIG_PARALLEL_MESSAGE,	/* message from cooperating parallel backend */
 	PROCSIG_WALSND_INIT_STOPPING,	/* ask walsenders to prepare for shutdown  */
@@ -49,6 +49,7 @@ typedef enum
 } LogStmtLevel;
 
 extern int	log_statement;
+extern bool reuse_planning_snapshot;
 
 extern List *pg_parse_query(const char *query_string);
 extern List *pg_analyze_and_rewrite(RawStmt *parsetree,
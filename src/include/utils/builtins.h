@@ -142,6 +142,35 @@ extern char *quote_literal_cstr(const char *rawstr);
 /* backend/pgxc/pool/poolutils.c */
 extern Datum pgxc_pool_check(PG_FUNCTION_ARGS);
 extern Datum pgxc_pool_reload(PG_FUNCTION_ARGS);
+extern Datum pg_stat_get_pooler(PG_FUNCTION_ARGS);
+
+/* backend/pgxc/barrier/barrier.c */
+extern Datum pgxc_barrier_history(PG_FUNCTION_ARGS);
+
+/* backend/replication/logical/logicalfuncs.c */
+extern Datum pgxc_logical_slot_get_changes(PG_FUNCTION_ARGS);
+extern Datum pgxc_logical_slot_peek_changes(PG_FUNCTION_ARGS);
+
+/* backend/executor/execSample.c */
+extern Datum pg_stat_get_executor_samples(PG_FUNCTION_ARGS);
+extern Datum pg_stat_reset_executor_samples(PG_FUNCTION_ARGS);
+extern Datum pgxc_stat_get_executor_samples(PG_FUNCTION_ARGS);
+
+/* backend/commands/indexcmds.c */
+extern Datum pgxc_stat_get_progress_create_index(PG_FUNCTION_ARGS);
+
+/* backend/pgxc/plan/distadvisor.c */
+extern Datum pg_stat_get_redistributions(PG_FUNCTION_ARGS);
+extern Datum pg_stat_reset_redistributions(PG_FUNCTION_ARGS);
+
+/* backend/postmaster/clustermon.c */
+extern Datum pg_stat_get_cluster_health(PG_FUNCTION_ARGS);
+
+/* backend/pgxc/squeue/squeue.c */
+extern Datum pg_stat_get_shared_queues(PG_FUNCTION_ARGS);
+
+/* backend/access/transam/gtm.c */
+extern Datum pgxc_gtm_stats(PG_FUNCTION_ARGS);
 
 /* backend/access/transam/transam.c */
 extern Datum pgxc_is_committed(PG_FUNCTION_ARGS);
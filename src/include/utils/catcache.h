@@ -22,6 +22,7 @@
 
 #include "access/htup.h"
 #include "access/skey.h"
+#include "datatype/timestamp.h"
 #include "lib/ilist.h"
 #include "utils/relcache.h"
 
@@ -113,6 +114,7 @@ typedef struct catctup
 	bool		dead;			/* dead but not yet removed? */
 	bool		negative;		/* negative cache entry? */
 	uint32		hash_value;		/* hash value for this tuple's keys */
+	TimestampTz lastaccess;		/* catcacheclock at last search hit */
 	HeapTupleData tuple;		/* tuple management header */
 } CatCTup;
 
@@ -168,6 +170,21 @@ extern PGDLLIMPORT MemoryContext CacheMemoryContext;
 
 extern void CreateCacheMemoryContext(void);
 
+/* GUC parameter */
+extern int	catalog_cache_prune_min_age;
+
+/*
+ * Coarse clock used to age catcache entries.  It is advanced once per
+ * transaction rather than read on every lookup.
+ */
+extern TimestampTz catcacheclock;
+
+static inline void
+SetCatCacheClock(TimestampTz ts)
+{
+	catcacheclock = ts;
+}
+
 extern CatCache *InitCatCache(int id, Oid reloid, Oid indexoid,
 			 int nkeys, const int *key,
 			 int nbuckets);
@@ -185,6 +185,7 @@ extern uint32	get_pgxc_node_id(Oid nodeid);
 extern char	get_pgxc_nodetype(Oid nodeid);
 extern int	get_pgxc_nodeport(Oid nodeid);
 extern char *get_pgxc_nodehost(Oid nodeid);
+extern char *get_pgxc_nodezone(Oid nodeid);
 extern bool	is_pgxc_nodepreferred(Oid nodeid);
 extern bool	is_pgxc_nodeprimary(Oid nodeid);
 extern Oid	get_pgxc_groupoid(const char *groupname);
@@ -189,8 +189,16 @@ extern CachedPlan *GetCachedPlan(CachedPlanSource *plansource,
 			  QueryEnvironment *queryEnv);
 extern void ReleaseCachedPlan(CachedPlan *plan, bool useResOwner);
 #ifdef XCP
+extern int	RemoteSubplanCacheSize;
+extern int	SharedSubplanStoreSize;
+
 extern void SetRemoteSubplan(CachedPlanSource *plansource,
-				 const char *plan_string);
+				 const char *plan_string, const uint8 *digest);
+extern bool HaveRemoteSubplan(const uint8 *digest);
+
+extern Size SharedRemoteSubplanShmemSize(void);
+extern void SharedRemoteSubplanShmemInit(void);
+extern char *FetchSharedRemoteSubplan(const uint8 *digest);
 #endif
 
 #endif							/* PLANCACHE_H */
@@ -216,6 +216,13 @@ typedef struct RelationData
 	 */
 	Oid			rd_toastoid;	/* Real TOAST table's OID, or InvalidOid */
 
+	/*
+	 * Extra free space heap inserts leave on a page for later updates, on
+	 * top of what the fillfactor reserves.  It is learned from the updates
+	 * this backend does; see RelationAdjustUpdateFreeSpace in hio.c.
+	 */
+	Size		rd_updatefreespace;
+
 	/* use "struct" here to avoid needing to include pgstat.h: */
 	struct PgStat_TableStatus *pgstat_info; /* statistics collection area */
 #ifdef PGXC
@@ -289,6 +296,7 @@ typedef struct StdRdOptions
 
 #define HEAP_MIN_FILLFACTOR			10
 #define HEAP_DEFAULT_FILLFACTOR		100
+#define HEAP_MIN_ADAPTIVE_FILLFACTOR	70	/* see hio.c */
 
 /*
  * RelationGetFillFactor
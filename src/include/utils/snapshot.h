@@ -80,6 +80,9 @@ typedef struct SnapshotData
 #ifdef PGXC  /* PGXC_COORD */
 	uint32		max_xcnt;		/* Max # of xact in xip[] */
 #endif
+#ifdef XCP
+	bool		xip_sorted;		/* is xip[] sorted by xidComparator? */
+#endif
 
 	/*
 	 * For non-historic MVCC snapshots, this contains subxact IDs that are in
@@ -114,6 +117,12 @@ typedef struct SnapshotData
 
 	TimestampTz whenTaken;		/* timestamp when snapshot was taken */
 	XLogRecPtr	lsn;			/* position in the WAL stream when taken */
+
+	/*
+	 * xactCompletionCount when GetSnapshotData last computed the contents
+	 * from the local proc array, or 0 if they came from elsewhere.
+	 */
+	uint64		snapXactCompletionCount;
 } SnapshotData;
 
 /*
@@ -84,14 +84,6 @@ extern Tuplesortstate *tuplesort_begin_datum(Oid datumType,
 					  Oid sortOperator, Oid sortCollation,
 					  bool nullsFirstFlag,
 					  int workMem, bool randomAccess);
-#ifdef PGXC
-extern Tuplesortstate *tuplesort_begin_merge(TupleDesc tupDesc,
-					 int nkeys, AttrNumber *attNums,
-					 Oid *sortOperators, Oid *sortCollations, bool *nullsFirstFlags,
-					 struct ResponseCombiner *combiner,
-					 int workMem);
-#endif
-
 extern void tuplesort_set_bound(Tuplesortstate *state, int64 bound);
 
 extern void tuplesort_puttupleslot(Tuplesortstate *state,
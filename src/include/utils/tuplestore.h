@@ -93,6 +93,8 @@ extern void tuplestore_end(Tuplestorestate *state);
 extern Tuplestorestate *tuplestore_begin_datarow(bool interXact, int maxKBytes,
 						 MemoryContext tmpcxt);
 extern Tuplestorestate *tuplestore_begin_message(bool interXact, int maxKBytes);
+extern void tuplestore_putdatarow(Tuplestorestate *state, RemoteDataRow datarow);
+extern RemoteDataRow tuplestore_getdatarow(Tuplestorestate *state);
 extern void tuplestore_putmessage(Tuplestorestate *state, int len, char* msg);
 extern char *tuplestore_getmessage(Tuplestorestate *state, int *len);
 #endif
@@ -843,3 +843,23 @@ create aggregate my_half_sum(int4)
 select my_sum(one),my_half_sum(one) from (values(1),(2),(3),(4)) t(one);
 
 rollback;
+
+--
+-- Hashed aggregation beyond work_mem
+--
+-- The planner takes the 10000 groups here for 200, so it picks a hashed
+-- aggregate whose table grows past work_mem and has to defer the input of
+-- the groups it cannot add to later passes.
+set work_mem = '64kB';
+set enable_sort = off;
+explain (costs off)
+select g % 10000, count(*) from generate_series(1, 40000) g group by g % 10000;
+select count(*), sum(c), min(c), max(c), sum(s)
+from (select g % 10000 as k, count(*) as c, sum(g) as s
+      from generate_series(1, 40000) g group by g % 10000) ss;
+-- by-reference grouping keys and transition values
+select count(*), sum(c), sum(length(m))
+from (select (g % 10000)::text as k, count(*) as c, max(g::text) as m
+      from generate_series(1, 40000) g group by (g % 10000)::text) ss;
+reset enable_sort;
+reset work_mem;
@@ -741,3 +741,62 @@ insert into parted_minmax values (1,'12345');
 explain (costs off) select min(a), max(a) from parted_minmax where b = '12345';
 select min(a), max(a) from parted_minmax where b = '12345';
 drop table parted_minmax;
+
+--
+-- partition-wise join
+--
+create table pwj1 (a int, b int) partition by range (a);
+create table pwj1_p1 partition of pwj1 for values from (0) to (100);
+create table pwj1_p2 partition of pwj1 for values from (100) to (200);
+create table pwj1_p3 partition of pwj1 for values from (200) to (300);
+insert into pwj1 select i, i % 7 from generate_series(0, 299) i;
+create table pwj2 (a int, b int) partition by range (a);
+create table pwj2_p1 partition of pwj2 for values from (0) to (100);
+create table pwj2_p2 partition of pwj2 for values from (100) to (200);
+create table pwj2_p3 partition of pwj2 for values from (200) to (300);
+insert into pwj2 select i, i % 5 from generate_series(0, 299, 2) i;
+-- same partition key, different bounds
+create table pwj3 (a int, b int) partition by range (a);
+create table pwj3_p1 partition of pwj3 for values from (0) to (150);
+create table pwj3_p2 partition of pwj3 for values from (150) to (300);
+insert into pwj3 select i, i % 3 from generate_series(0, 299, 3) i;
+analyze pwj1;
+analyze pwj2;
+analyze pwj3;
+-- count the joins of a plan: one for whole tables, one per pair of partitions
+create function pwj_count_joins(query text) returns int as $$
+declare
+	plan_line text;
+	njoins int := 0;
+begin
+	for plan_line in execute 'explain (costs off) ' || query loop
+		if plan_line like '%Nested Loop%' then
+			njoins := njoins + 1;
+		end if;
+	end loop;
+	return njoins;
+end
+$$ language plpgsql;
+-- with nested loops only, joining the partitions pairwise is much cheaper
+set enable_hashjoin = off;
+set enable_mergejoin = off;
+set enable_partition_wise_join = on;
+select pwj_count_joins('select * from pwj1 t1 join pwj2 t2 on t1.a = t2.a');
+select pwj_count_joins('select * from pwj1 t1 left join pwj2 t2 on t1.a = t2.a');
+-- the bounds differ, or the join is not on the partition key
+select pwj_count_joins('select * from pwj1 t1 join pwj3 t3 on t1.a = t3.a');
+select pwj_count_joins('select * from pwj1 t1 join pwj2 t2 on t1.b = t2.a');
+select count(*), sum(t1.b), sum(t2.b)
+from pwj1 t1 join pwj2 t2 on t1.a = t2.a;
+select count(*), count(t2.a), sum(t1.b), sum(t2.b)
+from pwj1 t1 left join pwj2 t2 on t1.a = t2.a;
+reset enable_partition_wise_join;
+select pwj_count_joins('select * from pwj1 t1 join pwj2 t2 on t1.a = t2.a');
+select count(*), sum(t1.b), sum(t2.b)
+from pwj1 t1 join pwj2 t2 on t1.a = t2.a;
+select count(*), count(t2.a), sum(t1.b), sum(t2.b)
+from pwj1 t1 left join pwj2 t2 on t1.a = t2.a;
+reset enable_hashjoin;
+reset enable_mergejoin;
+drop function pwj_count_joins(text);
+drop table pwj1, pwj2, pwj3;
@@ -141,3 +141,21 @@ select sum(tenthous) as s1, sum(tenthous) + random()*0 as s2
 
 select sum(tenthous) as s1, sum(tenthous) + random()*0 as s2
   from tenk1 group by thousand order by thousand limit 3;
+
+-- an ORDER BY whose leading key the input is sorted by already sorts one
+-- group of rows with equal leading keys at a time
+explain (costs off)
+select * from generate_series(1000, 1, -1) with ordinality as t(v, n)
+order by n, v limit 5;
+set enable_incremental_sort = off;
+explain (costs off)
+select * from generate_series(1000, 1, -1) with ordinality as t(v, n)
+order by n, v limit 5;
+reset enable_incremental_sort;
+-- groups of several rows, whose second key runs against the input order
+select * from (select g / 4 as a, g % 4 as b from generate_series(1, 40) g
+               order by 1 offset 0) s
+order by a, b desc limit 10;
+select * from (select g / 4 as a, g % 4 as b from generate_series(1, 40) g
+               order by 1 offset 0) s
+order by a, b desc offset 30;
@@ -263,3 +263,67 @@ drop function sillysrf(int);
 -- (see bug #5084)
 select * from (values (2),(null),(1)) v(k) where k = k order by k;
 select * from (values (2),(null),(1)) v(k) where k = k order by k desc;
+
+-- sorts on a single int2, int4 or int8 key radix sort 1024 tuples or more
+-- and quicksort fewer; check whole tuple and datum sorts of both sizes
+-- against the comparator sort of the same values cast to numeric
+create function radix_data(n int) returns table (i2 int2, i4 int4, i8 int8)
+  as $$ select v::int2, v * 1000003, v * 1000000000007::int8
+        from (select case when g % 7 = 0 then null
+                     else (g * 7919) % (n / 2) - n / 4 end as v
+              from generate_series(1, n) g) s $$ language sql immutable;
+select n,
+  (select array_agg(i2) from (select i2 from radix_data(n) order by i2) s) =
+    (select array_agg(i2 order by i2::numeric) from radix_data(n)) and
+  (select array_agg(i2 order by i2) from radix_data(n)) =
+    (select array_agg(i2 order by i2::numeric) from radix_data(n)) as asc_nulls_last,
+  (select array_agg(i2) from (select i2 from radix_data(n) order by i2 nulls first) s) =
+    (select array_agg(i2 order by i2::numeric nulls first) from radix_data(n)) and
+  (select array_agg(i2 order by i2 nulls first) from radix_data(n)) =
+    (select array_agg(i2 order by i2::numeric nulls first) from radix_data(n)) as asc_nulls_first,
+  (select array_agg(i2) from (select i2 from radix_data(n) order by i2 desc) s) =
+    (select array_agg(i2 order by i2::numeric desc) from radix_data(n)) and
+  (select array_agg(i2 order by i2 desc) from radix_data(n)) =
+    (select array_agg(i2 order by i2::numeric desc) from radix_data(n)) as desc_nulls_first,
+  (select array_agg(i2) from (select i2 from radix_data(n) order by i2 desc nulls last) s) =
+    (select array_agg(i2 order by i2::numeric desc nulls last) from radix_data(n)) and
+  (select array_agg(i2 order by i2 desc nulls last) from radix_data(n)) =
+    (select array_agg(i2 order by i2::numeric desc nulls last) from radix_data(n)) as desc_nulls_last
+from (values (101), (2003)) v(n);
+select n,
+  (select array_agg(i4) from (select i4 from radix_data(n) order by i4) s) =
+    (select array_agg(i4 order by i4::numeric) from radix_data(n)) and
+  (select array_agg(i4 order by i4) from radix_data(n)) =
+    (select array_agg(i4 order by i4::numeric) from radix_data(n)) as asc_nulls_last,
+  (select array_agg(i4) from (select i4 from radix_data(n) order by i4 nulls first) s) =
+    (select array_agg(i4 order by i4::numeric nulls first) from radix_data(n)) and
+  (select array_agg(i4 order by i4 nulls first) from radix_data(n)) =
+    (select array_agg(i4 order by i4::numeric nulls first) from radix_data(n)) as asc_nulls_first,
+  (select array_agg(i4) from (select i4 from radix_data(n) order by i4 desc) s) =
+    (select array_agg(i4 order by i4::numeric desc) from radix_data(n)) and
+  (select array_agg(i4 order by i4 desc) from radix_data(n)) =
+    (select array_agg(i4 order by i4::numeric desc) from radix_data(n)) as desc_nulls_first,
+  (select array_agg(i4) from (select i4 from radix_data(n) order by i4 desc nulls last) s) =
+    (select array_agg(i4 order by i4::numeric desc nulls last) from radix_data(n)) and
+  (select array_agg(i4 order by i4 desc nulls last) from radix_data(n)) =
+    (select array_agg(i4 order by i4::numeric desc nulls last) from radix_data(n)) as desc_nulls_last
+from (values (101), (2003)) v(n);
+select n,
+  (select array_agg(i8) from (select i8 from radix_data(n) order by i8) s) =
+    (select array_agg(i8 order by i8::numeric) from radix_data(n)) and
+  (select array_agg(i8 order by i8) from radix_data(n)) =
+    (select array_agg(i8 order by i8::numeric) from radix_data(n)) as asc_nulls_last,
+  (select array_agg(i8) from (select i8 from radix_data(n) order by i8 nulls first) s) =
+    (select array_agg(i8 order by i8::numeric nulls first) from radix_data(n)) and
+  (select array_agg(i8 order by i8 nulls first) from radix_data(n)) =
+    (select array_agg(i8 order by i8::numeric nulls first) from radix_data(n)) as asc_nulls_first,
+  (select array_agg(i8) from (select i8 from radix_data(n) order by i8 desc) s) =
+    (select array_agg(i8 order by i8::numeric desc) from radix_data(n)) and
+  (select array_agg(i8 order by i8 desc) from radix_data(n)) =
+    (select array_agg(i8 order by i8::numeric desc) from radix_data(n)) as desc_nulls_first,
+  (select array_agg(i8) from (select i8 from radix_data(n) order by i8 desc nulls last) s) =
+    (select array_agg(i8 order by i8::numeric desc nulls last) from radix_data(n)) and
+  (select array_agg(i8 order by i8 desc nulls last) from radix_data(n)) =
+    (select array_agg(i8 order by i8::numeric desc nulls last) from radix_data(n)) as desc_nulls_last
+from (values (101), (2003)) v(n);
+drop function radix_data(int);
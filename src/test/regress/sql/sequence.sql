@@ -128,6 +128,14 @@ SELECT currval('sequence_test'::regclass);
 
 DROP SEQUENCE sequence_test;
 
+-- nextval(regclass, integer) allocates a block of values, returns the first
+CREATE SEQUENCE sequence_block INCREMENT BY 10;
+SELECT nextval('sequence_block', 3);
+SELECT nextval('sequence_block');
+SELECT nextval('sequence_block', 0);
+SELECT nextval('sequence_block', -5);
+DROP SEQUENCE sequence_block;
+
 -- renaming sequences
 CREATE SEQUENCE foo_seq;
 ALTER TABLE foo_seq RENAME TO foo_seq_new;
@@ -598,3 +598,60 @@ select * from
   where tattle(x, u);
 
 drop function tattle(x int, y int);
+
+--
+-- Comparisons with a correlated aggregate sub-select are planned as joins
+-- against the sub-select grouped by its correlation keys, if an outer row
+-- with no inner rows would be rejected anyway
+--
+create temp table sagg_outer (k int, x int);
+insert into sagg_outer values (1, 10), (2, 20), (3, 30), (4, 40), (5, 2);
+create temp table sagg_inner (k int, y int);
+insert into sagg_inner values (1, 10), (1, 5), (2, 15), (2, 20), (3, null),
+  (5, 1);
+create function sagg_count_subplans(query text) returns int as $$
+declare
+	plan_line text;
+	nsubplans int := 0;
+begin
+	for plan_line in execute 'explain (costs off) ' || query loop
+		if ltrim(plan_line) like 'SubPlan%' then
+			nsubplans := nsubplans + 1;
+		end if;
+	end loop;
+	return nsubplans;
+end
+$$ language plpgsql;
+-- max() and min() are null for k = 3, whose y is null, and k = 4, which
+-- has no inner rows
+select sagg_count_subplans('select * from sagg_outer o
+  where o.x = (select max(i.y) from sagg_inner i where i.k = o.k)');
+select * from sagg_outer o
+where o.x = (select max(i.y) from sagg_inner i where i.k = o.k)
+order by k;
+select sagg_count_subplans('select * from sagg_outer o
+  where (select min(i.y) from sagg_inner i where o.k = i.k) < o.x');
+select * from sagg_outer o
+where (select min(i.y) from sagg_inner i where o.k = i.k) < o.x
+order by k;
+-- count() is 0 for k = 4, which must be kept, so it stays a SubPlan
+select sagg_count_subplans('select * from sagg_outer o
+  where o.x > (select count(*) from sagg_inner i where i.k = o.k)');
+select * from sagg_outer o
+where o.x > (select count(*) from sagg_inner i where i.k = o.k)
+order by k;
+-- and so does a correlation other than equality
+select sagg_count_subplans('select * from sagg_outer o
+  where o.x >= (select max(i.y) from sagg_inner i where i.k < o.k)');
+select * from sagg_outer o
+where o.x >= (select max(i.y) from sagg_inner i where i.k < o.k)
+order by k;
+-- the conversion can be turned off
+set enable_scalar_sublink_join = off;
+select sagg_count_subplans('select * from sagg_outer o
+  where o.x = (select max(i.y) from sagg_inner i where i.k = o.k)');
+select * from sagg_outer o
+where o.x = (select max(i.y) from sagg_inner i where i.k = o.k)
+order by k;
+reset enable_scalar_sublink_join;
+drop function sagg_count_subplans(text);
@@ -74,3 +74,28 @@ VACUUM (ANALYZE) vacparted;
 VACUUM (FULL) vacparted;
 VACUUM (FREEZE) vacparted;
 DROP TABLE vacparted;
+
+-- a lone count(*) over a sequential scan counts the visible tuples of each
+-- page without fetching them; it must agree with count(a), which fetches
+-- them, whether or not the pages are all-visible
+CREATE TABLE vaccount (a int, b text);
+INSERT INTO vaccount SELECT i, 'row ' || i FROM generate_series(1, 1000) i;
+SELECT (SELECT count(*) FROM vaccount) AS count_star,
+       (SELECT count(a) FROM vaccount) AS count_a;
+VACUUM vaccount;
+SELECT (SELECT count(*) FROM vaccount) AS count_star,
+       (SELECT count(a) FROM vaccount) AS count_a;
+DELETE FROM vaccount WHERE a % 10 = 0;
+UPDATE vaccount SET b = 'updated' WHERE a % 10 = 1;
+SELECT (SELECT count(*) FROM vaccount) AS count_star,
+       (SELECT count(a) FROM vaccount) AS count_a;
+BEGIN;
+DELETE FROM vaccount WHERE a <= 100;
+INSERT INTO vaccount SELECT i, 'new ' || i FROM generate_series(1001, 1050) i;
+SELECT (SELECT count(*) FROM vaccount) AS count_star,
+       (SELECT count(a) FROM vaccount) AS count_a;
+ROLLBACK;
+VACUUM vaccount;
+SELECT (SELECT count(*) FROM vaccount) AS count_star,
+       (SELECT count(a) FROM vaccount) AS count_a;
+DROP TABLE vaccount;
@@ -995,6 +995,39 @@ EXPLAIN (VERBOSE, COSTS OFF, NODES OFF, NUM_NODES OFF)
 WITH wcte AS ( INSERT INTO int8_tbl VALUES ( 42, 47 ) RETURNING q2 )
 DELETE FROM a USING wcte WHERE aa = q2;
 
+--
+-- Inlining of WITH queries referenced once
+--
+
+CREATE TEMP TABLE cte_inline_tbl (a int, b int) DISTRIBUTE BY HASH (a);
+INSERT INTO cte_inline_tbl SELECT i, i % 10 FROM generate_series(1, 100) i;
+
+-- by default, every WITH query is an optimization fence
+EXPLAIN (COSTS OFF, NODES OFF)
+WITH q AS (SELECT * FROM cte_inline_tbl) SELECT * FROM q WHERE b = 1;
+WITH q AS (SELECT * FROM cte_inline_tbl) SELECT count(*), sum(a) FROM q WHERE b = 1;
+
+-- with enable_cte_inline, a WITH query referenced once is planned as a
+-- subquery
+SET enable_cte_inline = on;
+EXPLAIN (COSTS OFF, NODES OFF)
+WITH q AS (SELECT * FROM cte_inline_tbl) SELECT * FROM q WHERE b = 1;
+WITH q AS (SELECT * FROM cte_inline_tbl) SELECT count(*), sum(a) FROM q WHERE b = 1;
+
+-- referenced twice, it is computed once
+EXPLAIN (COSTS OFF, NODES OFF)
+WITH q AS (SELECT * FROM cte_inline_tbl)
+SELECT * FROM q WHERE b = 1 UNION ALL SELECT * FROM q WHERE b = 2;
+
+-- row marks make the WITH query an optimization fence
+EXPLAIN (COSTS OFF, NODES OFF)
+WITH q AS (SELECT * FROM cte_inline_tbl FOR UPDATE)
+SELECT * FROM q WHERE b = 1;
+
+WITH q AS (SELECT * FROM cte_inline_tbl FOR UPDATE)
+SELECT count(*), sum(a) FROM q WHERE b = 1;
+RESET enable_cte_inline;
+
 -- error cases
 
 -- data-modifying WITH tries to use its own output
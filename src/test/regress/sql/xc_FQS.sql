@@ -124,6 +124,11 @@ explain (verbose on, nodes off, costs off) select sum(val), avg(val), count(*) f
 -- should not get FQSed because of window functions
 select first_value(val) over (partition by val2 order by val) from tab1_hash;
 explain (verbose on, nodes off, costs off) select first_value(val) over (partition by val2 order by val) from tab1_hash;
+-- unless the rows are redistributed by the PARTITION BY key first
+set enable_window_redistribution to on;
+select first_value(val) over (partition by val2 order by val) from tab1_hash order by 1;
+explain (verbose on, nodes off, costs off) select first_value(val) over (partition by val2 order by val) from tab1_hash;
+reset enable_window_redistribution;
 -- should not get FQSed because of LIMIT clause
 select * from tab1_hash where val2 = 3 limit 1;
 explain (verbose on, nodes off, costs off) select * from tab1_hash where val2 = 3 limit 1;
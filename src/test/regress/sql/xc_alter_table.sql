@@ -190,3 +190,78 @@ SELECT * FROM xc_alter_table_3_v;
 ALTER TABLE xc_alter_table_3 ADD COLUMN b int, DISTRIBUTE BY HASH(a);
 -- Clean up
 DROP TABLE xc_alter_table_3 CASCADE;
+
+-- Distribution by bucket
+CREATE TABLE xc_alter_table_4 (a int, b text) DISTRIBUTE BY BUCKET(a);
+SELECT pclocatortype, pcattnum, pchashalgorithm, pchashbuckets FROM pgxc_class
+  WHERE pcrelid = 'xc_alter_table_4'::regclass;
+CREATE TABLE xc_alter_table_4_err (a point) DISTRIBUTE BY BUCKET(a);
+\d+ xc_alter_table_4
+INSERT INTO xc_alter_table_4 SELECT i, 'row ' || i FROM generate_series(1, 1000) i;
+INSERT INTO xc_alter_table_4 SELECT a, b FROM xc_alter_table_4;
+-- Rows are spread over the nodes, all rows of a value on the same node
+SELECT count(*), sum(a), count(DISTINCT xc_node_id) AS nodes FROM xc_alter_table_4;
+SELECT count(*) FROM (SELECT a FROM xc_alter_table_4
+  GROUP BY a HAVING count(DISTINCT xc_node_id) > 1) s;
+-- Lookups on the distribution column find the rows where they were inserted
+CREATE FUNCTION xc_alter_table_4_lookups() RETURNS int AS $$
+DECLARE
+	n int;
+	missed int := 0;
+BEGIN
+	FOR i IN 1..100 LOOP
+		EXECUTE 'SELECT count(*) FROM xc_alter_table_4 WHERE a = ' || i INTO n;
+		IF n <> 2 THEN
+			missed := missed + 1;
+		END IF;
+	END LOOP;
+	RETURN missed;
+END;
+$$ LANGUAGE plpgsql;
+SELECT xc_alter_table_4_lookups();
+-- Restore from the definition written by pg_dump gives the same placement
+CREATE TABLE xc_alter_table_5 (
+    a integer,
+    b text
+)
+DISTRIBUTE BY BUCKET (a);
+INSERT INTO xc_alter_table_5 SELECT a, b FROM xc_alter_table_4;
+SELECT c4.pclocatortype = c5.pclocatortype AND c4.pcattnum = c5.pcattnum AND
+       c4.nodeoids = c5.nodeoids AS same
+  FROM pgxc_class c4, pgxc_class c5
+  WHERE c4.pcrelid = 'xc_alter_table_4'::regclass AND
+        c5.pcrelid = 'xc_alter_table_5'::regclass;
+SELECT count(*) FROM (SELECT DISTINCT a, xc_node_id AS node FROM xc_alter_table_4) s4
+  JOIN (SELECT DISTINCT a, xc_node_id AS node FROM xc_alter_table_5) s5 USING (a, node);
+CREATE TABLE xc_alter_table_6 DISTRIBUTE BY BUCKET(a) AS SELECT * FROM xc_alter_table_4;
+SELECT pclocatortype FROM pgxc_class WHERE pcrelid = 'xc_alter_table_6'::regclass;
+-- Redistribution, keep the placement to check which rows move
+CREATE TABLE xc_alter_table_4_place AS
+  SELECT DISTINCT a, xc_node_id AS node FROM xc_alter_table_4;
+ALTER TABLE xc_alter_table_4 DELETE NODE (datanode_2);
+SELECT count(*), sum(a), count(DISTINCT xc_node_id) AS nodes FROM xc_alter_table_4;
+-- The node added back gets the same buckets again
+ALTER TABLE xc_alter_table_4 ADD NODE (datanode_2);
+SELECT count(*), sum(a), count(DISTINCT xc_node_id) AS nodes FROM xc_alter_table_4;
+SELECT count(*) FROM xc_alter_table_4_place
+  JOIN (SELECT DISTINCT a, xc_node_id AS node FROM xc_alter_table_4) s USING (a, node);
+SELECT xc_alter_table_4_lookups();
+-- From bucket to hash and back
+ALTER TABLE xc_alter_table_4 DISTRIBUTE BY HASH(a);
+SELECT pclocatortype FROM pgxc_class WHERE pcrelid = 'xc_alter_table_4'::regclass;
+SELECT count(*), sum(a), count(DISTINCT xc_node_id) AS nodes FROM xc_alter_table_4;
+ALTER TABLE xc_alter_table_4 DISTRIBUTE BY BUCKET(a);
+SELECT pclocatortype FROM pgxc_class WHERE pcrelid = 'xc_alter_table_4'::regclass;
+SELECT count(*) FROM xc_alter_table_4_place
+  JOIN (SELECT DISTINCT a, xc_node_id AS node FROM xc_alter_table_4) s USING (a, node);
+-- From replication to bucket
+ALTER TABLE xc_alter_table_4 DISTRIBUTE BY REPLICATION;
+SELECT count(*), sum(a), count(DISTINCT xc_node_id) AS nodes FROM xc_alter_table_4;
+ALTER TABLE xc_alter_table_4 DISTRIBUTE BY BUCKET(a);
+SELECT count(*), sum(a), count(DISTINCT xc_node_id) AS nodes FROM xc_alter_table_4;
+SELECT count(*) FROM xc_alter_table_4_place
+  JOIN (SELECT DISTINCT a, xc_node_id AS node FROM xc_alter_table_4) s USING (a, node);
+SELECT xc_alter_table_4_lookups();
+-- Clean up
+DROP FUNCTION xc_alter_table_4_lookups();
+DROP TABLE xc_alter_table_4, xc_alter_table_4_place, xc_alter_table_5, xc_alter_table_6;
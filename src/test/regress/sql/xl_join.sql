@@ -16,6 +16,47 @@ SELECT * FROM xl_join_t1
 	INNER JOIN xl_join_t2 ON xl_join_t1.val1 = xl_join_t2.val2 
 	INNER JOIN xl_join_t3 ON xl_join_t1.val1 = xl_join_t3.val1;
 
+-- Broadcast the small side of a join of tables not distributed by the join
+-- key, rather than redistribute both
+CREATE TABLE xl_join_fact (val1 int, val2 int);
+CREATE TABLE xl_join_dim (val1 int, val2 int);
+INSERT INTO xl_join_fact SELECT i, i % 100 FROM generate_series(1, 1000) i;
+INSERT INTO xl_join_dim VALUES (1, 1), (2, 2);
+ANALYZE xl_join_fact;
+ANALYZE xl_join_dim;
+
+-- Returns the distribution types of the remote subplans of the query
+CREATE FUNCTION xl_join_distributions(query text) RETURNS text AS $$
+DECLARE
+	plan_line text;
+	result text := '';
+BEGIN
+	FOR plan_line IN EXECUTE 'EXPLAIN (COSTS OFF) ' || query LOOP
+		IF ltrim(plan_line) LIKE 'Distribute results by%' THEN
+			result := result || substr(ltrim(plan_line), 23, 1);
+		END IF;
+	END LOOP;
+	RETURN result;
+END
+$$ LANGUAGE plpgsql;
+
+SET enable_broadcast_join TO off;
+SELECT xl_join_distributions('SELECT * FROM xl_join_fact f
+	INNER JOIN xl_join_dim d ON f.val2 = d.val2');
+SELECT count(*) FROM xl_join_fact f
+	INNER JOIN xl_join_dim d ON f.val2 = d.val2;
+
+SET enable_broadcast_join TO on;
+SELECT xl_join_distributions('SELECT * FROM xl_join_fact f
+	INNER JOIN xl_join_dim d ON f.val2 = d.val2');
+SELECT count(*) FROM xl_join_fact f
+	INNER JOIN xl_join_dim d ON f.val2 = d.val2;
+RESET enable_broadcast_join;
+
+DROP FUNCTION xl_join_distributions(text);
+DROP TABLE xl_join_fact;
+DROP TABLE xl_join_dim;
+
 DROP TABLE xl_join_t1;
 DROP TABLE xl_join_t2;
 DROP TABLE xl_join_t3;